@@ -0,0 +1,212 @@
+#pragma once
+
+#include <core/logger.h>
+
+#include <cuda_runtime.h>
+#include <mpi.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Helpers shared by the microbenchmarks: command line options,
+ * timing with CUDA events and the JSON report.
+ *
+ * Every benchmark executable accepts
+ *   --out <file>    write the JSON report there instead of stdout
+ *   --reps <n>      number of timed repetitions per case (default 50)
+ *   --warmup <n>    number of untimed repetitions per case (default 5)
+ *   --quick         only run the smallest case of every sweep
+ */
+struct BenchOptions
+{
+    std::string output;
+    int repetitions {50};
+    int warmup {5};
+    bool quick {false};
+
+    BenchOptions(int argc, char **argv)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            auto next = [&] () -> const char* {
+                if (i+1 >= argc) die("Option '%s' needs a value", arg.c_str());
+                return argv[++i];
+            };
+
+            if      (arg == "--out")    output      = next();
+            else if (arg == "--reps")   repetitions = atoi(next());
+            else if (arg == "--warmup") warmup      = atoi(next());
+            else if (arg == "--quick")  quick       = true;
+            else die("Unknown option '%s'", arg.c_str());
+        }
+
+        if (repetitions <= 0)
+            die("Need at least one repetition, got %d", repetitions);
+    }
+
+    /// the whole sweep, or only its first value with --quick
+    template <typename T>
+    std::vector<T> sweep(std::vector<T> values) const
+    {
+        if (quick) values.resize(1);
+        return values;
+    }
+};
+
+/// Time per repetition of one benchmark case, in milliseconds
+struct BenchStats
+{
+    double mean {0}, min {0}, max {0}, stddev {0};
+    int repetitions {0};
+};
+
+/// Statistics of the times of the repetitions of one case, in milliseconds
+inline BenchStats summarize(const std::vector<double>& times)
+{
+    BenchStats s;
+
+    s.repetitions = times.size();
+    s.min = *std::min_element(times.begin(), times.end());
+    s.max = *std::max_element(times.begin(), times.end());
+
+    for (auto t : times) s.mean += t;
+    s.mean /= times.size();
+
+    for (auto t : times) s.stddev += (t - s.mean) * (t - s.mean);
+    s.stddev = sqrt(s.stddev / times.size());
+
+    return s;
+}
+
+/**
+ * Run \p f \p warmup times, then time \p repetitions runs of it with CUDA events on \p stream.
+ * \p f may launch any number of kernels on \p stream; the stream is synchronized
+ * after every repetition, so that the timings also include the host side of the launches.
+ */
+template <class Function>
+BenchStats measure(const BenchOptions& opts, cudaStream_t stream, Function&& f)
+{
+    cudaEvent_t start, stop;
+    CUDA_Check( cudaEventCreate(&start) );
+    CUDA_Check( cudaEventCreate(&stop) );
+
+    for (int i = 0; i < opts.warmup; i++)
+        f();
+    CUDA_Check( cudaStreamSynchronize(stream) );
+
+    std::vector<double> times;
+    for (int i = 0; i < opts.repetitions; i++)
+    {
+        float ms = 0;
+        CUDA_Check( cudaEventRecord(start, stream) );
+        f();
+        CUDA_Check( cudaEventRecord(stop, stream) );
+        CUDA_Check( cudaEventSynchronize(stop) );
+        CUDA_Check( cudaEventElapsedTime(&ms, start, stop) );
+        times.push_back(ms);
+    }
+
+    CUDA_Check( cudaEventDestroy(start) );
+    CUDA_Check( cudaEventDestroy(stop) );
+
+    return summarize(times);
+}
+
+/**
+ * Collects the cases of one benchmark executable and writes them as
+ * \code
+ * { "suite": "...", "device": "...", "results": [
+ *     { "benchmark": "...", "params": { "density": 8, ... }, "items": 1000,
+ *       "mean_ms": ..., "min_ms": ..., "max_ms": ..., "stddev_ms": ..., "repetitions": 50 }, ... ] }
+ * \endcode
+ * \c items is the amount of work of the case, e.g. the number of particles,
+ * such that the throughput can be compared across sizes.
+ * Only rank 0 writes.
+ */
+class BenchReport
+{
+public:
+    using Params = std::vector<std::pair<std::string, double>>;
+
+    BenchReport(std::string suite, const BenchOptions& opts) :
+        suite(suite), output(opts.output)
+    {
+        int dev;
+        cudaDeviceProp prop;
+        CUDA_Check( cudaGetDevice(&dev) );
+        CUDA_Check( cudaGetDeviceProperties(&prop, dev) );
+        device = prop.name;
+
+        MPI_Check( MPI_Comm_rank(MPI_COMM_WORLD, &rank) );
+    }
+
+    ~BenchReport()
+    {
+        write();
+    }
+
+    void add(std::string benchmark, Params params, long items, BenchStats stats)
+    {
+        if (rank == 0)
+        {
+            fprintf(stderr, "%-28s", benchmark.c_str());
+            for (auto& p : params)
+                fprintf(stderr, " %s=%g", p.first.c_str(), p.second);
+            fprintf(stderr, " : %.4f ms (min %.4f), %.3g items/s\n",
+                    stats.mean, stats.min, stats.mean > 0 ? items / (stats.mean * 1e-3) : 0.0);
+        }
+
+        entries.push_back({benchmark, params, items, stats});
+    }
+
+private:
+    struct Entry
+    {
+        std::string benchmark;
+        Params params;
+        long items;
+        BenchStats stats;
+    };
+
+    std::string suite, output, device;
+    std::vector<Entry> entries;
+    int rank;
+
+    void write() const
+    {
+        if (rank != 0) return;
+
+        FILE *f = output.empty() ? stdout : fopen(output.c_str(), "w");
+        if (f == nullptr)
+        {
+            error("Could not open the benchmark report '%s'", output.c_str());
+            return;
+        }
+
+        fprintf(f, "{\n  \"suite\": \"%s\",\n  \"device\": \"%s\",\n  \"results\": [", suite.c_str(), device.c_str());
+
+        for (int i = 0; i < entries.size(); i++)
+        {
+            auto& e = entries[i];
+            fprintf(f, "%s\n    { \"benchmark\": \"%s\", \"params\": {", i > 0 ? "," : "", e.benchmark.c_str());
+
+            for (int j = 0; j < e.params.size(); j++)
+                fprintf(f, "%s \"%s\": %g", j > 0 ? "," : "", e.params[j].first.c_str(), e.params[j].second);
+
+            fprintf(f, " }, \"items\": %ld, \"mean_ms\": %g, \"min_ms\": %g, \"max_ms\": %g, \"stddev_ms\": %g, \"repetitions\": %d }",
+                    e.items, e.stats.mean, e.stats.min, e.stats.max, e.stats.stddev, e.stats.repetitions);
+        }
+
+        fprintf(f, "\n  ]\n}\n");
+
+        if (f != stdout) fclose(f);
+    }
+};
@@ -0,0 +1,53 @@
+#include "../bench.h"
+
+#include <core/celllist.h>
+#include <core/initial_conditions/uniform_ic.h>
+#include <core/logger.h>
+#include <core/pvs/particle_vector.h>
+
+Logger logger;
+
+static void benchBuild(BenchReport& report, const BenchOptions& opts,
+                       float L, float rc, float density, CellListOrdering ordering)
+{
+    const float3 length {L, L, L};
+    DomainInfo domain{length, {0,0,0}, length};
+    YmrState state(domain, 0.0f);
+
+    ParticleVector pv(&state, "pv", 1.0f);
+    UniformIC ic(density);
+    ic.exec(MPI_COMM_WORLD, &pv, 0);
+
+    PrimaryCellList cells(&pv, rc, length);
+    cells.setOrdering(ordering);
+    cells.build(0);
+
+    auto stats = measure(opts, 0, [&] () {
+        // force the rebuild, the particles stay sorted after the first one
+        pv.cellListStamp++;
+        cells.build(0);
+    });
+
+    report.add("celllist_build", { {"box", L}, {"rc", rc}, {"density", density}, {"ordering", (double) ordering} },
+               pv.local()->size(), stats);
+}
+
+int main(int argc, char **argv)
+{
+    MPI_Init(&argc, &argv);
+    logger.init(MPI_COMM_WORLD, "bench_celllists.log", 0);
+
+    {
+        BenchOptions opts(argc, argv);
+        BenchReport report("celllists", opts);
+
+        for (float L : opts.sweep<float>({16, 32, 64}))
+            for (float rc : opts.sweep<float>({1.0f, 1.5f}))
+                for (float density : opts.sweep<float>({4, 8, 16}))
+                    for (auto ordering : opts.sweep<CellListOrdering>({CellListOrdering::RowMajor, CellListOrdering::Morton}))
+                        benchBuild(report, opts, L, rc, density, ordering);
+    }
+
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,127 @@
+#include "../bench.h"
+
+#include <core/celllist.h>
+#include <core/initial_conditions/uniform_ic.h>
+#include <core/logger.h>
+#include <core/mpi/api.h>
+#include <core/pvs/particle_vector.h>
+#include <core/pvs/views/pv.h>
+#include <core/utils/kernel_launch.h>
+#include <core/utils/make_unique.h>
+
+Logger logger;
+
+/// move all the particles by \p dr, such that some of them leave the domain
+__global__ void shiftParticles(PVview view, float3 dr)
+{
+    const int pid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (pid >= view.size) return;
+
+    Particle p;
+    p.readCoordinate(view.particles, pid);
+    p.r += dr;
+    view.particles[2*pid] = p.r2Float4();
+}
+
+/**
+ * Pack, copy and unpack of the halo particles through SingleNodeEngine:
+ * the same kernels as in the MPI engines, without the messages
+ */
+static void benchHalo(BenchReport& report, const BenchOptions& opts, float L, float rc, float density, bool compression)
+{
+    const float3 length {L, L, L};
+    DomainInfo domain{length, {0,0,0}, length};
+    YmrState state(domain, 0.0f);
+
+    ParticleVector pv(&state, "pv", 1.0f);
+    UniformIC ic(density);
+    ic.exec(MPI_COMM_WORLD, &pv, 0);
+
+    PrimaryCellList cells(&pv, rc, length);
+    cells.build(0);
+
+    auto exchanger = std::make_unique<ParticleHaloExchanger>(false, compression);
+    exchanger->attach(&pv, &cells, {});
+    SingleNodeEngine engine(std::move(exchanger));
+
+    auto stats = measure(opts, 0, [&] () {
+        pv.haloValid = false;
+        engine.init(0);
+        engine.finalize(0);
+    });
+
+    report.add(compression ? "halo_exchange_compressed" : "halo_exchange",
+               { {"box", L}, {"rc", rc}, {"density", density} }, pv.halo()->size(), stats);
+}
+
+/**
+ * Redistribution after every particle moved by a fraction of the cell size.
+ * Moving the particles and rebuilding the cell-list is timed separately,
+ * such that the redistribution is the difference of the two cases.
+ */
+static void benchRedistribution(BenchReport& report, const BenchOptions& opts, float L, float rc, float density)
+{
+    const float3 length {L, L, L};
+    DomainInfo domain{length, {0,0,0}, length};
+    YmrState state(domain, 0.0f);
+
+    ParticleVector pv(&state, "pv", 1.0f);
+    UniformIC ic(density);
+    ic.exec(MPI_COMM_WORLD, &pv, 0);
+
+    PrimaryCellList cells(&pv, rc, length);
+    cells.build(0);
+
+    auto redistributor = std::make_unique<ParticleRedistributor>();
+    redistributor->attach(&pv, &cells);
+    SingleNodeEngine engine(std::move(redistributor));
+
+    const float3 dr = make_float3(0.1f * rc, 0.05f * rc, -0.07f * rc);
+    const int nthreads = 128;
+
+    auto move = [&] () {
+        PVview view(&pv, pv.local());
+        SAFE_KERNEL_LAUNCH(
+                shiftParticles,
+                getNblocks(view.size, nthreads), nthreads, 0, 0,
+                view, dr );
+
+        pv.cellListStamp++;
+        cells.build(0);
+    };
+
+    const BenchReport::Params params { {"box", L}, {"rc", rc}, {"density", density} };
+    const long np = pv.local()->size();
+
+    report.add("move_and_build", params, np, measure(opts, 0, move));
+
+    report.add("move_build_redistribute", params, np, measure(opts, 0, [&] () {
+        move();
+        pv.redistValid = false;
+        engine.init(0);
+        engine.finalize(0);
+    }));
+}
+
+int main(int argc, char **argv)
+{
+    MPI_Init(&argc, &argv);
+    logger.init(MPI_COMM_WORLD, "bench_exchange.log", 0);
+
+    {
+        BenchOptions opts(argc, argv);
+        BenchReport report("exchange", opts);
+
+        for (float L : opts.sweep<float>({16, 32, 64}))
+            for (float rc : opts.sweep<float>({1.0f, 1.5f}))
+                for (float density : opts.sweep<float>({4, 8, 16}))
+                {
+                    benchHalo(report, opts, L, rc, density, false);
+                    benchHalo(report, opts, L, rc, density, true);
+                    benchRedistribution(report, opts, L, rc, density);
+                }
+    }
+
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,432 @@
+#include "../bench.h"
+
+#include <core/celllist.h>
+#include <core/domain.h>
+#include <core/initial_conditions/uniform_ic.h>
+#include <core/logger.h>
+#include <core/mpi/api.h>
+#include <core/mpi/exchange_helpers.h>
+#include <core/mpi/fragments_mapping.h>
+#include <core/pvs/object_vector.h>
+#include <core/pvs/particle_vector.h>
+#include <core/pvs/views/pv.h>
+#include <core/utils/common.h>
+#include <core/utils/kernel_launch.h>
+#include <core/utils/make_unique.h>
+#include <core/ymero_state.h>
+
+#include <random>
+
+Logger logger;
+
+/**
+ * Exchange proxy: only the exchange phases of a simulation, to tune the communication
+ * on a new machine without running full simulations.
+ *
+ * Every rank of a periodic nranks3D grid holds a subdomain of size --local with particles
+ * of density --density, and --objects objects of --obj-size particles in balls of radius --obj-radius.
+ * The phases are the halo exchange of the particles, their redistribution after a fraction --migration
+ * of them left their subdomain, the halo exchange of the objects and the reverse exchange
+ * of the forces of the halo objects, of which a fraction --force-fraction is nonzero.
+ *
+ * Options, on top of the ones of every benchmark:
+ *   --ranks <x> <y> <z>     ranks per dimension, their product must be the number of ranks (default all along x)
+ *   --engine <name>         mpi, aggregated, neighbor or ipc (default mpi), a single rank always copies locally
+ *   --gpu-aware             GPU-aware MPI calls
+ *   --persistent-sizes      persistent requests for the sizes (mpi engine only)
+ *   --chunk <bytes>         largest message, 0 for no limit (mpi engine only)
+ *   --adaptive              adaptive transport (mpi engine only)
+ *   --sparse-forces         only send back the nonzero forces of the halo objects
+ *   --local <L>             size of the subdomain of every rank (default 16)
+ *   --rc <rc>               cutoff radius (default 1)
+ *   --density <d>           number density of the particles (default 8)
+ *   --migration <f>         fraction of the particles leaving their subdomain per redistribution (default 0.05)
+ *   --objects <n>           objects per rank (default 64)
+ *   --obj-size <n>          particles per object (default 500)
+ *   --obj-radius <r>        radius of the objects (default 2)
+ *   --force-fraction <f>    fraction of the halo objects particles with a nonzero force (default 1)
+ *
+ * Every phase is reported once with the bytes sent by all the ranks as items, and once per class of
+ * fragments (face, edge, corner) with the bytes and the number of non empty messages of this class.
+ * The time of a repetition is the largest over the ranks, all the classes of a phase share it.
+ * The benchmark names are <engine>/<phase>[/<class>], the items per second of the report are bytes per second
+ */
+struct ProxyOptions
+{
+    int3 nranks3D {0, 1, 1};
+    std::string engine {"mpi"};
+    bool gpuAwareMPI {false};
+    bool persistentSizes {false};
+    int chunkSize {0};
+    bool adaptiveTransport {false};
+    bool sparseForces {false};
+
+    float localSize {16.0f};
+    float rc {1.0f};
+    float density {8.0f};
+    float migration {0.05f};
+
+    int nObjects {64};
+    int objSize {500};
+    float objRadius {2.0f};
+    float forceFraction {1.0f};
+
+    /// takes the proxy options out of \p argv, the remaining ones are left for BenchOptions
+    ProxyOptions(int& argc, char **argv)
+    {
+        int nleft = 1;
+        for (int i = 1; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            auto next = [&] () -> const char* {
+                if (i+1 >= argc) die("Option '%s' needs a value", arg.c_str());
+                return argv[++i];
+            };
+
+            if      (arg == "--ranks")
+            {
+                nranks3D.x = atoi(next());
+                nranks3D.y = atoi(next());
+                nranks3D.z = atoi(next());
+            }
+            else if (arg == "--engine")           engine            = next();
+            else if (arg == "--gpu-aware")        gpuAwareMPI       = true;
+            else if (arg == "--persistent-sizes") persistentSizes   = true;
+            else if (arg == "--chunk")            chunkSize         = atoi(next());
+            else if (arg == "--adaptive")         adaptiveTransport = true;
+            else if (arg == "--sparse-forces")    sparseForces      = true;
+            else if (arg == "--local")            localSize         = atof(next());
+            else if (arg == "--rc")               rc                = atof(next());
+            else if (arg == "--density")          density           = atof(next());
+            else if (arg == "--migration")        migration         = atof(next());
+            else if (arg == "--objects")          nObjects          = atoi(next());
+            else if (arg == "--obj-size")         objSize           = atoi(next());
+            else if (arg == "--obj-radius")       objRadius         = atof(next());
+            else if (arg == "--force-fraction")   forceFraction     = atof(next());
+            else argv[nleft++] = argv[i];
+        }
+        argc = nleft;
+
+        if (migration < 0.0f || migration >= 1.0f)
+            die("The migration rate must be in [0, 1), got %g", migration);
+
+        if (engine != "mpi" && engine != "aggregated" && engine != "neighbor" && engine != "ipc")
+            die("Unknown exchange engine '%s', choose one of mpi, aggregated, neighbor or ipc", engine.c_str());
+    }
+};
+
+/// move all the particles by \p dr, such that some of them leave the domain
+__global__ void shiftParticles(PVview view, float3 dr)
+{
+    const int pid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (pid >= view.size) return;
+
+    Particle p;
+    p.readCoordinate(view.particles, pid);
+    p.r += dr;
+    view.particles[2*pid] = p.r2Float4();
+}
+
+/// nonzero forces on a fraction \p fraction of the particles, evenly spread, the others are cleared
+__global__ void setForces(int n, float fraction, float4 *forces)
+{
+    const int pid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (pid >= n) return;
+
+    const bool nonZero = floorf((pid+1) * fraction) > floorf(pid * fraction);
+    forces[pid] = nonZero ? make_float4(1.0f, -0.5f, 0.25f, 0.0f) : make_float4(0.0f);
+}
+
+/// bytes and non empty messages sent through one engine, per number of nonzero components of the fragment direction
+struct FragmentTraffic
+{
+    long long bytes[4] {0, 0, 0, 0};
+    long long messages[4] {0, 0, 0, 0};
+
+    long long totalBytes() const
+    {
+        return bytes[1] + bytes[2] + bytes[3];
+    }
+};
+
+/// what \p helper sent in the last exchange, summed over the ranks
+static FragmentTraffic getTraffic(ExchangeHelper *helper, MPI_Comm comm)
+{
+    FragmentTraffic traffic;
+
+    for (int i = 0; i < FragmentMapping::numFragments; i++)
+    {
+        if (i == FragmentMapping::bulkId) continue;
+
+        const int3 dir = FragmentMapping::getDir(i);
+        const int fragmentClass = abs(dir.x) + abs(dir.y) + abs(dir.z);
+        const long long bytes = (long long) helper->sendSizes[i] * helper->datumSize;
+
+        traffic.bytes[fragmentClass] += bytes;
+        if (bytes > 0) traffic.messages[fragmentClass]++;
+    }
+
+    MPI_Check( MPI_Allreduce(MPI_IN_PLACE, traffic.bytes,    4, MPI_LONG_LONG, MPI_SUM, comm) );
+    MPI_Check( MPI_Allreduce(MPI_IN_PLACE, traffic.messages, 4, MPI_LONG_LONG, MPI_SUM, comm) );
+
+    return traffic;
+}
+
+/**
+ * Time \p exchange, after the untimed \p prepare and a barrier, \p warmup times without recording.
+ * The time of a repetition is the longest over the ranks of \p comm
+ */
+template <class Prepare, class Exchange>
+static BenchStats measurePhase(const BenchOptions& opts, MPI_Comm comm, Prepare&& prepare, Exchange&& exchange)
+{
+    std::vector<double> times;
+
+    for (int i = 0; i < opts.warmup + opts.repetitions; i++)
+    {
+        prepare();
+        CUDA_Check( cudaStreamSynchronize(0) );
+        MPI_Check( MPI_Barrier(comm) );
+
+        const double start = MPI_Wtime();
+        exchange();
+        CUDA_Check( cudaStreamSynchronize(0) );
+        double ms = (MPI_Wtime() - start) * 1e3;
+
+        MPI_Check( MPI_Allreduce(MPI_IN_PLACE, &ms, 1, MPI_DOUBLE, MPI_MAX, comm) );
+        if (i >= opts.warmup) times.push_back(ms);
+    }
+
+    return summarize(times);
+}
+
+static std::unique_ptr<ExchangeEngine> makeEngine(const ProxyOptions& proxy, MPI_Comm cartComm, std::unique_ptr<ParticleExchanger> exch)
+{
+    if (proxy.nranks3D.x * proxy.nranks3D.y * proxy.nranks3D.z == 1)
+        return std::make_unique<SingleNodeEngine> (std::move(exch));
+
+    if (proxy.engine == "aggregated")
+        return std::make_unique<AggregatedMPIExchangeEngine> (std::move(exch), cartComm, proxy.gpuAwareMPI);
+
+    if (proxy.engine == "neighbor")
+        return std::make_unique<NeighborCollectiveEngine> (std::move(exch), cartComm, proxy.gpuAwareMPI);
+
+    if (proxy.engine == "ipc")
+        return std::make_unique<IPCExchangeEngine> (std::move(exch), cartComm, proxy.gpuAwareMPI);
+
+    return std::make_unique<MPIExchangeEngine> (std::move(exch), cartComm, proxy.gpuAwareMPI, proxy.persistentSizes,
+                                                proxy.chunkSize, proxy.adaptiveTransport);
+}
+
+/// \p nObjects balls of particles, their centers uniformly in the subdomain
+static void setupObjects(const ProxyOptions& proxy, const DomainInfo& domain, int rank, ObjectVector *ov)
+{
+    auto lov = ov->local();
+    auto& coosvels = lov->coosvels;
+
+    std::mt19937 gen(rank + 1);
+    std::uniform_real_distribution<float> udistr(0.0f, 1.0f);
+
+    for (int obj = 0; obj < proxy.nObjects; obj++)
+    {
+        const float3 com = make_float3(udistr(gen) - 0.5f, udistr(gen) - 0.5f, udistr(gen) - 0.5f) * domain.localSize;
+
+        for (int i = 0; i < proxy.objSize; i++)
+        {
+            float3 r;
+            do {
+                r = make_float3(2*udistr(gen) - 1, 2*udistr(gen) - 1, 2*udistr(gen) - 1);
+            } while (dot(r, r) > 1.0f);
+
+            const int pid = obj * proxy.objSize + i;
+
+            Particle p;
+            p.r  = com + proxy.objRadius * r;
+            p.u  = make_float3(0.0f);
+            p.i1 = pid;
+            p.i2 = rank;
+            coosvels[pid] = p;
+        }
+    }
+
+    coosvels.uploadToDevice(0);
+    lov->forces.clear(0);
+}
+
+class ExchangeProxy
+{
+public:
+    ExchangeProxy(const ProxyOptions& proxy, const BenchOptions& opts, MPI_Comm cartComm) :
+        proxy(proxy), opts(opts), cartComm(cartComm),
+        domain(createDomainInfo(cartComm, proxy.localSize * make_float3(proxy.nranks3D))),
+        state(domain, 0.0f),
+        pv(&state, "pv", 1.0f),
+        ov(&state, "ov", 1.0f, proxy.objSize, proxy.nObjects),
+        cells(&pv, proxy.rc, domain.localSize)
+    {
+        int rank;
+        MPI_Check( MPI_Comm_rank(cartComm, &rank) );
+
+        UniformIC ic(proxy.density);
+        ic.exec(cartComm, &pv, 0);
+        cells.build(0);
+
+        setupObjects(proxy, domain, rank, &ov);
+
+        auto haloImp     = std::make_unique<ParticleHaloExchanger>();
+        auto redistImp   = std::make_unique<ParticleRedistributor>();
+        auto objHaloImp  = std::make_unique<ObjectHaloExchanger>();
+        auto reverseImp  = std::make_unique<ObjectReverseExchanger>(objHaloImp.get(), proxy.sparseForces);
+
+        haloImp   ->attach(&pv, &cells, {});
+        redistImp ->attach(&pv, &cells);
+        objHaloImp->attach(&ov, proxy.rc, {});
+        reverseImp->attach(&ov, {ChannelNames::forces});
+
+        haloHelper    = haloImp   ->helpers[0].get();
+        redistHelper  = redistImp ->helpers[0].get();
+        objHaloHelper = objHaloImp->helpers[0].get();
+        reverseHelper = reverseImp->helpers[0].get();
+
+        halo    = makeEngine(proxy, cartComm, std::move(haloImp));
+        redist  = makeEngine(proxy, cartComm, std::move(redistImp));
+        objHalo = makeEngine(proxy, cartComm, std::move(objHaloImp));
+        reverse = makeEngine(proxy, cartComm, std::move(reverseImp));
+    }
+
+    void run(BenchReport& report)
+    {
+        const int nthreads = 128;
+
+        auto rebuild = [&] () {
+            pv.cellListStamp++;
+            cells.build(0);
+        };
+
+        // the particle halo, on cells rebuilt after the previous redistributions
+        add(report, "halo", haloHelper, measurePhase(opts, cartComm, rebuild, [&] () {
+            pv.haloValid = false;
+            halo->init(0);
+            halo->finalize(0);
+        }));
+
+        auto objHaloExchange = [&] () {
+            ov.haloValid = false;
+            objHalo->init(0);
+            objHalo->finalize(0);
+        };
+
+        add(report, "object_halo", objHaloHelper, measurePhase(opts, cartComm, [] () {}, objHaloExchange));
+
+        // the halo objects of the last exchange send their forces back
+        auto setHaloForces = [&] () {
+            auto lov = ov.halo();
+            const int n = lov->size();
+            SAFE_KERNEL_LAUNCH(
+                    setForces,
+                    getNblocks(n, nthreads), nthreads, 0, 0,
+                    n, proxy.forceFraction, (float4*) lov->forces.devPtr() );
+        };
+
+        add(report, "object_reverse", reverseHelper, measurePhase(opts, cartComm, setHaloForces, [&] () {
+            reverse->init(0);
+            reverse->finalize(0);
+        }));
+
+        // a shift along the diagonal by s moves a fraction 1 - (1 - s/L)^3 of the particles out
+        const float s = 1.0f - powf(1.0f - proxy.migration, 1.0f / 3.0f);
+        const float3 dr = s * domain.localSize;
+
+        auto move = [&] () {
+            PVview view(&pv, pv.local());
+            SAFE_KERNEL_LAUNCH(
+                    shiftParticles,
+                    getNblocks(view.size, nthreads), nthreads, 0, 0,
+                    view, dr );
+
+            rebuild();
+        };
+
+        add(report, "redistribution", redistHelper, measurePhase(opts, cartComm, move, [&] () {
+            pv.redistValid = false;
+            redist->init(0);
+            redist->finalize(0);
+        }));
+    }
+
+private:
+    const ProxyOptions& proxy;
+    const BenchOptions& opts;
+    MPI_Comm cartComm;
+
+    DomainInfo domain;
+    YmrState state;
+    ParticleVector pv;
+    ObjectVector ov;
+    PrimaryCellList cells;
+
+    ExchangeHelper *haloHelper, *redistHelper, *objHaloHelper, *reverseHelper;
+    std::unique_ptr<ExchangeEngine> halo, redist, objHalo, reverse;
+
+    void add(BenchReport& report, std::string phase, ExchangeHelper *helper, BenchStats stats)
+    {
+        const BenchReport::Params params {
+            {"ranks_x", proxy.nranks3D.x}, {"ranks_y", proxy.nranks3D.y}, {"ranks_z", proxy.nranks3D.z},
+            {"local", proxy.localSize}, {"rc", proxy.rc}, {"density", proxy.density}, {"migration", proxy.migration},
+            {"objects", proxy.nObjects}, {"obj_size", proxy.objSize}, {"force_fraction", proxy.forceFraction},
+            {"gpu_aware", proxy.gpuAwareMPI}, {"chunk", proxy.chunkSize}, {"sparse_forces", proxy.sparseForces} };
+
+        const auto traffic = getTraffic(helper, cartComm);
+        const std::string name = proxy.engine + "/" + phase;
+        const char *classNames[] = {"bulk", "face", "edge", "corner"};
+
+        report.add(name, params, traffic.totalBytes(), stats);
+
+        for (int c = 1; c <= 3; c++)
+        {
+            auto classParams = params;
+            classParams.push_back({"messages", traffic.messages[c]});
+            report.add(name + "/" + classNames[c], classParams, traffic.bytes[c], stats);
+        }
+    }
+};
+
+int main(int argc, char **argv)
+{
+    MPI_Init(&argc, &argv);
+    logger.init(MPI_COMM_WORLD, "bench_exchange_proxy.log", 0);
+
+    {
+        ProxyOptions proxy(argc, argv);
+        BenchOptions opts(argc, argv);
+
+        int nranks;
+        MPI_Check( MPI_Comm_size(MPI_COMM_WORLD, &nranks) );
+
+        if (proxy.nranks3D.x == 0)
+            proxy.nranks3D.x = nranks;
+
+        if (proxy.nranks3D.x * proxy.nranks3D.y * proxy.nranks3D.z != nranks)
+            die("The proxy runs on %d ranks, but %d x %d x %d were asked for",
+                nranks, proxy.nranks3D.x, proxy.nranks3D.y, proxy.nranks3D.z);
+
+        if (nranks == 1)
+            warn("A single rank exchanges with itself through local copies, the engine '%s' is not used",
+                 proxy.engine.c_str());
+
+        int dims[3]    = {proxy.nranks3D.x, proxy.nranks3D.y, proxy.nranks3D.z};
+        int periods[3] = {1, 1, 1};
+        MPI_Comm cartComm;
+        MPI_Check( MPI_Cart_create(MPI_COMM_WORLD, 3, dims, periods, 0, &cartComm) );
+
+        {
+            BenchReport report("exchange_proxy", opts);
+            ExchangeProxy exchangeProxy(proxy, opts, cartComm);
+            exchangeProxy.run(report);
+        }
+
+        MPI_Check( MPI_Comm_free(&cartComm) );
+    }
+
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,156 @@
+// the kernel variants are chosen by heuristics, reach in to pick them ourselves
+#define private   public
+#define protected public
+
+#include "../bench.h"
+
+#include <core/celllist.h>
+#include <core/initial_conditions/uniform_ic.h>
+#include <core/interactions/pairwise.impl.h>
+#include <core/interactions/pairwise_interactions/dpd.h>
+#include <core/logger.h>
+#include <core/pvs/particle_vector.h>
+
+Logger logger;
+
+static const float dt = 1e-3f;
+static const float adpd = 10.0f, gammadpd = 10.0f, kbT = 1.0f, powerdpd = 0.5f;
+
+/// self interactions of one particle vector: cell-lists, tiled and neighbor list kernels
+static void benchSelf(BenchReport& report, const BenchOptions& opts, float L, float rc, float density)
+{
+    const float3 length {L, L, L};
+    DomainInfo domain{length, {0,0,0}, length};
+    YmrState state(domain, dt);
+
+    ParticleVector pv(&state, "pv", 1.0f);
+    UniformIC ic(density);
+    ic.exec(MPI_COMM_WORLD, &pv, 0);
+
+    PrimaryCellList cells(&pv, rc, length);
+    cells.build(0);
+
+    const int np = pv.local()->size();
+    const BenchReport::Params params { {"box", L}, {"rc", rc}, {"density", density} };
+
+    for (auto kind : {"self_cells", "self_tiled", "self_neighbor_list"})
+    {
+        InteractionPair<PairwiseDPD> dpd(&state, "dpd", rc, PairwiseDPD(rc, adpd, gammadpd, kbT, dt, powerdpd));
+
+        const std::string k = kind;
+        if (k == "self_tiled")         dpd.useTiledKernels(true);
+        if (k == "self_neighbor_list") dpd.useNeighborList(0.2f * rc);
+
+        auto stats = measure(opts, 0, [&] () {
+            pv.local()->forces.clear(0);
+            dpd.local(&pv, &pv, &cells, &cells, 0);
+        });
+
+        report.add("dpd_" + k, params, np, stats);
+    }
+}
+
+/// interactions between two particle vectors, with each number of threads per particle
+static void benchExternal(BenchReport& report, const BenchOptions& opts, float L, float rc, float density)
+{
+    const float3 length {L, L, L};
+    DomainInfo domain{length, {0,0,0}, length};
+    YmrState state(domain, dt);
+
+    ParticleVector pv1(&state, "pv1", 1.0f), pv2(&state, "pv2", 1.0f);
+    UniformIC ic(0.5f * density);
+    ic.exec(MPI_COMM_WORLD, &pv1, 0);
+    ic.exec(MPI_COMM_WORLD, &pv2, 0);
+
+    PrimaryCellList cells1(&pv1, rc, length), cells2(&pv2, rc, length);
+    cells1.build(0);
+    cells2.build(0);
+
+    InteractionPair<PairwiseDPD> dpd(&state, "dpd", rc, PairwiseDPD(rc, adpd, gammadpd, kbT, dt, powerdpd));
+    auto& pair = dpd.getPairwiseInteraction(pv1.name, pv2.name);
+    pair.setup(pv1.local(), pv2.local(), &cells1, &cells2, &state);
+
+    auto dstView = cells1.getView<PVview>();
+    auto srcView = cells2.getView<PVview>();
+
+    for (int tpp : {1, 3, 9, 27})
+    {
+        auto stats = measure(opts, 0, [&] () {
+            pv1.local()->forces.clear(0);
+            pv2.local()->forces.clear(0);
+            dpd.launchExternal<InteractionOut::NeedAcc, InteractionOut::NeedAcc, InteractionMode::RowWise>
+                (tpp, 128, dstView, &cells2, srcView, pair.handler(), 0);
+        });
+
+        report.add("dpd_external_" + std::to_string(tpp) + "tpp",
+                   { {"box", L}, {"rc", rc}, {"density", density} }, dstView.size, stats);
+    }
+}
+
+/**
+ * Cost and gain of the cached copy of the positions (ParticleVector::usePackedPositions()):
+ * the build writes 16 more bytes per particle, the interaction then reads the positions from the copy.
+ * The copy pays off when the step (build and interaction) is faster with it
+ */
+static void benchPackedPositions(BenchReport& report, const BenchOptions& opts, float L, float rc, float density)
+{
+    const float3 length {L, L, L};
+    DomainInfo domain{length, {0,0,0}, length};
+    YmrState state(domain, dt);
+
+    ParticleVector pv(&state, "pv", 1.0f);
+    UniformIC ic(density);
+    ic.exec(MPI_COMM_WORLD, &pv, 0);
+
+    PrimaryCellList cells(&pv, rc, length);
+    cells.build(0);
+
+    InteractionPair<PairwiseDPD> dpd(&state, "dpd", rc, PairwiseDPD(rc, adpd, gammadpd, kbT, dt, powerdpd));
+
+    const int np = pv.local()->size();
+
+    for (bool packed : {false, true})
+    {
+        pv.usePackedPositions(packed);
+        const BenchReport::Params params { {"box", L}, {"rc", rc}, {"density", density}, {"packed", (double) packed} };
+
+        // force the rebuild, the particles stay sorted after the first one
+        auto build = measure(opts, 0, [&] () {
+            pv.cellListStamp++;
+            cells.build(0);
+        });
+
+        auto step = measure(opts, 0, [&] () {
+            pv.cellListStamp++;
+            cells.build(0);
+            pv.local()->forces.clear(0);
+            dpd.local(&pv, &pv, &cells, &cells, 0);
+        });
+
+        report.add("positions_build",     params, np, build);
+        report.add("positions_build_dpd", params, np, step);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    MPI_Init(&argc, &argv);
+    logger.init(MPI_COMM_WORLD, "bench_interaction.log", 0);
+
+    {
+        BenchOptions opts(argc, argv);
+        BenchReport report("interaction", opts);
+
+        for (float L : opts.sweep<float>({16, 32, 48}))
+            for (float rc : opts.sweep<float>({1.0f, 1.5f}))
+                for (float density : opts.sweep<float>({4, 8, 16}))
+                {
+                    benchSelf    (report, opts, L, rc, density);
+                    benchExternal(report, opts, L, rc, density);
+                    benchPackedPositions(report, opts, L, rc, density);
+                }
+    }
+
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,137 @@
+#include "../bench.h"
+
+#include <core/bouncers/from_mesh.h>
+#include <core/celllist.h>
+#include <core/initial_conditions/membrane_ic.h>
+#include <core/initial_conditions/uniform_ic.h>
+#include <core/interactions/factory.h>
+#include <core/logger.h>
+#include <core/mesh/membrane.h>
+#include <core/pvs/membrane_vector.h>
+#include <core/pvs/particle_vector.h>
+#include <core/utils/common.h>
+#include <core/utils/make_unique.h>
+
+Logger logger;
+
+/// relative to the bench folder, where "make run" starts the executables
+static const std::string meshFile = "../data/rbc_mesh.off";
+
+static const float dt = 1e-3f;
+
+static std::map<std::string, float> membraneParameters()
+{
+    return {
+        {"x0",     0.457f},
+        {"ka_tot", 4900.0f},
+        {"kv_tot", 7500.0f},
+        {"ka",     5000.0f},
+        {"ks",     22.0f},
+        {"mpow",   2.0f},
+        {"gammaC", 52.0f},
+        {"gammaT", 0.0f},
+        {"kBT",    0.0444f},
+        {"tot_area",   62.2242f},
+        {"tot_volume", 26.6649f},
+        {"kb",     44.4f},
+        {"theta",  6.97f},
+        {"C0",     0.0f},
+        {"DA0",    0.0f},
+        {"kad",    0.0f}
+    };
+}
+
+/// RBCs on a lattice with the given spacing, the number of objects is the sweep parameter
+static std::unique_ptr<MembraneVector> makeMembranes(YmrState *state, float spacing)
+{
+    auto mesh = std::make_shared<MembraneMesh>(meshFile);
+    auto ov = std::make_unique<MembraneVector>(state, "rbc", 1.0f, mesh);
+
+    MembraneIC ic(PyTypes::float3 {spacing, spacing, spacing}, true);
+    ic.exec(MPI_COMM_WORLD, ov.get(), 0);
+
+    return ov;
+}
+
+static void benchForces(BenchReport& report, const BenchOptions& opts, float L, float spacing, std::string bending)
+{
+    const float3 length {L, L, L};
+    DomainInfo domain{length, {0,0,0}, length};
+    YmrState state(domain, dt);
+
+    auto ov = makeMembranes(&state, spacing);
+
+    auto membrane = InteractionFactory::createInteractionMembrane(&state, "membrane", "wlc", bending,
+                                                                  membraneParameters(), false, 0.0f);
+    membrane->setPrerequisites(ov.get(), ov.get(), nullptr, nullptr);
+
+    auto stats = measure(opts, 0, [&] () {
+        ov->local()->forces.clear(0);
+        membrane->local(ov.get(), ov.get(), nullptr, nullptr, 0);
+    });
+
+    report.add("membrane_forces_" + bending, { {"box", L}, {"spacing", spacing}, {"objects", (double) ov->local()->nObjects} },
+               ov->local()->nObjects, stats);
+}
+
+/**
+ * Bounce of the solvent from the membranes.
+ * The old positions are the current ones, such that every repetition does the same work:
+ * the candidates search, which dominates, and the refinement finding no actual collisions.
+ */
+static void benchBounce(BenchReport& report, const BenchOptions& opts, float L, float spacing, float density, std::string broadphase)
+{
+    const float3 length {L, L, L};
+    const float rc = 1.0f;
+    DomainInfo domain{length, {0,0,0}, length};
+    YmrState state(domain, dt);
+
+    auto ov = makeMembranes(&state, spacing);
+
+    std::unique_ptr<Bouncer> bouncer = std::make_unique<BounceFromMesh>(&state, "bounce", 0.0f, broadphase);
+    bouncer->setup(ov.get());
+    ov->local()->getOldMeshVertices(0)->copy(ov->local()->coosvels, 0);
+
+    ParticleVector pv(&state, "solvent", 1.0f);
+    UniformIC ic(density);
+    ic.exec(MPI_COMM_WORLD, &pv, 0);
+
+    PrimaryCellList cells(&pv, rc, length);
+    cells.build(0);
+
+    bouncer->setPrerequisites(&pv);
+    pv.local()->extraPerParticle.getData<Particle>(ChannelNames::oldParts)->copy(pv.local()->coosvels, 0);
+
+    auto stats = measure(opts, 0, [&] () {
+        bouncer->bounceLocal(&pv, &cells, 0);
+    });
+
+    report.add("mesh_bounce_" + broadphase,
+               { {"box", L}, {"spacing", spacing}, {"objects", (double) ov->local()->nObjects}, {"density", density} },
+               pv.local()->size(), stats);
+}
+
+int main(int argc, char **argv)
+{
+    MPI_Init(&argc, &argv);
+    logger.init(MPI_COMM_WORLD, "bench_membrane.log", 0);
+
+    {
+        BenchOptions opts(argc, argv);
+        BenchReport report("membrane", opts);
+
+        for (float L : opts.sweep<float>({24, 48}))
+            for (float spacing : opts.sweep<float>({12, 8}))
+            {
+                for (auto bending : {"Kantor", "Juelicher"})
+                    benchForces(report, opts, L, spacing, bending);
+
+                for (float density : opts.sweep<float>({4, 8}))
+                    for (auto broadphase : {"cells", "bvh"})
+                        benchBounce(report, opts, L, spacing, density, broadphase);
+            }
+    }
+
+    MPI_Finalize();
+    return 0;
+}
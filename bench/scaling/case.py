@@ -0,0 +1,128 @@
+#!/usr/bin/env python
+
+"""
+One run of a scaling benchmark case, launched by run.py.
+
+Writes into the current folder:
+  stats.txt          time per step every --stats-every steps, see the Stats plugin
+  tasks_profile.json per-task timings of the scheduler, see start_task_profiling
+  meta.json          the parameters of the run and the wall time
+"""
+
+import ymero as ymr
+
+import argparse, json, os, time
+
+parser = argparse.ArgumentParser()
+parser.add_argument('--case',    choices=['dpd', 'poiseuille', 'rbc'], required=True)
+parser.add_argument('--ranks',   type=int,   nargs=3, required=True)
+parser.add_argument('--domain',  type=float, nargs=3, required=True)
+parser.add_argument('--nsteps',  type=int, default=1000)
+parser.add_argument('--profile-steps', type=int, default=100)
+parser.add_argument('--stats-every',   type=int, default=50)
+parser.add_argument('--mesh',    type=str, default='rbc_mesh.off')
+args = parser.parse_args()
+
+dt      = 0.001
+rc      = 1.0
+density = 8
+
+ranks  = tuple(args.ranks)
+domain = tuple(args.domain)
+
+u = ymr.ymero(ranks, domain, dt, debug_level=1, log_filename='log', no_splash=True)
+
+pv  = ymr.ParticleVectors.ParticleVector('solvent', mass = 1)
+ic  = ymr.InitialConditions.Uniform(density=density)
+u.registerParticleVector(pv, ic)
+
+dpd = ymr.Interactions.DPD('dpd', rc, a=10.0, gamma=10.0, kbt=1.0, power=0.5)
+u.registerInteraction(dpd)
+
+vv = ymr.Integrators.VelocityVerlet('vv')
+u.registerIntegrator(vv)
+
+if args.case == 'dpd':
+    u.setInteraction(dpd, pv, pv)
+    u.setIntegrator(vv, pv)
+
+elif args.case == 'poiseuille':
+    plate_lo = ymr.Walls.Plane("plate_lo", (0, 0, -1), (0, 0,              1))
+    plate_hi = ymr.Walls.Plane("plate_hi", (0, 0,  1), (0, 0,  domain[2] - 1))
+    u.registerWall(plate_lo, 0)
+    u.registerWall(plate_hi, 0)
+
+    frozen = u.makeFrozenWallParticles(pvName="plates", walls=[plate_lo, plate_hi], interactions=[dpd], integrator=vv, density=density)
+
+    u.setWall(plate_lo, pv)
+    u.setWall(plate_hi, pv)
+
+    for p in (pv, frozen):
+        u.setInteraction(dpd, p, pv)
+
+    vv_dp = ymr.Integrators.VelocityVerlet_withConstForce("vv_dp", (0.1, 0, 0))
+    u.registerIntegrator(vv_dp)
+    u.setIntegrator(vv_dp, pv)
+
+elif args.case == 'rbc':
+    mesh_rbc = ymr.ParticleVectors.MembraneMesh(args.mesh)
+    pv_rbc   = ymr.ParticleVectors.MembraneVector("rbc", mass=1.0, mesh=mesh_rbc)
+    # one RBC per 10^3 volume, about 15% hematocrit
+    ic_rbc   = ymr.InitialConditions.Membrane(spacing=(10.0, 10.0, 10.0), random_orientation=True)
+    u.registerParticleVector(pv_rbc, ic_rbc)
+
+    # the solvent after the membranes are in place, the inner one is removed
+    checker = ymr.BelongingCheckers.Mesh("rbc_checker")
+    u.registerObjectBelongingChecker(checker, pv_rbc)
+    u.applyObjectBelongingChecker(checker, pv, correct_every=0, inside="none")
+
+    prm_rbc = {
+        "x0"     : 0.457,
+        "ka_tot" : 4900.0,
+        "kv_tot" : 7500.0,
+        "ka"     : 5000,
+        "ks"     : 0.0444 / 0.000906667,
+        "mpow"   : 2.0,
+        "gammaC" : 52.0,
+        "gammaT" : 0.0,
+        "kBT"    : 0.0,
+        "tot_area"   : 62.2242,
+        "tot_volume" : 26.6649,
+        "kb"     : 44.4444,
+        "theta"  : 6.97
+    }
+
+    int_rbc = ymr.Interactions.MembraneForces("int_rbc", "wlc", "Kantor", **prm_rbc, stress_free=False)
+    u.registerInteraction(int_rbc)
+    u.setInteraction(int_rbc, pv_rbc, pv_rbc)
+
+    for p in (pv, pv_rbc):
+        u.setInteraction(dpd, p, pv)
+    u.setIntegrator(vv, pv)
+    u.setIntegrator(vv, pv_rbc)
+
+    bb = ymr.Bouncers.Mesh("bounce_rbc", kbt=0.0)
+    u.registerBouncer(bb)
+    u.setBouncer(bb, pv_rbc, pv)
+
+u.registerPlugins(ymr.Plugins.createStats('stats', "stats.txt", args.stats_every))
+
+# the first steps of the run, the 'min' column of the profile is free of startup transients
+u.start_task_profiling(args.profile_steps, "tasks_profile")
+
+tstart = time.time()
+u.run(args.nsteps)
+wall_time = time.time() - tstart
+
+if u.isMasterTask():
+    meta = {
+        "case"      : args.case,
+        "ranks"     : list(ranks),
+        "nranks"    : ranks[0] * ranks[1] * ranks[2],
+        "domain"    : list(domain),
+        "nsteps"    : args.nsteps,
+        "dt"        : dt,
+        "wall_time" : wall_time
+    }
+    with open("meta.json", "w") as f:
+        json.dump(meta, f, indent=2)
@@ -0,0 +1,153 @@
+#!/usr/bin/env python
+
+"""
+Strong and weak scaling of the end-to-end benchmark cases, see case.py.
+
+Every run is launched through ymr.run in its own folder under --out,
+with twice as many MPI ranks as simulation ranks (one postprocess rank each).
+The results of all the runs are collected in --out/results.json:
+steps per second, parallel efficiency and the per-task breakdown of the scheduler.
+
+    ./run.py --cases dpd rbc --ranks 1 2 4 8 --mode strong weak --out results_v1
+    ./run.py --compare results_v0/results.json results_v1/results.json
+"""
+
+import argparse, json, os, shutil, subprocess, sys
+
+here = os.path.dirname(os.path.abspath(__file__))
+
+# domain of one simulation rank in the weak scaling, and of the whole run in the strong one
+base_domains = {
+    'dpd'        : (32, 32, 32),
+    'poiseuille' : (32, 32, 32),
+    'rbc'        : (40, 40, 40),
+}
+
+def rank_layout(n):
+    """Split n ranks over 3 dimensions as evenly as possible, the largest along x."""
+    layout = [1, 1, 1]
+    f = 2
+    while n > 1:
+        while n % f != 0:
+            f += 1
+        n //= f
+        layout[layout.index(min(layout))] *= f
+    return tuple(sorted(layout, reverse=True))
+
+def domain_of(case, mode, layout):
+    base = base_domains[case]
+    if mode == 'strong':
+        return base
+    return tuple(b * r for b, r in zip(base, layout))
+
+def read_stats(fname, dt, warmup_steps):
+    """Average time per step (ms) of the Stats plugin, excluding the first records."""
+    times = []
+    with open(fname) as f:
+        for line in f:
+            if line.startswith('#'): continue
+            cols = line.split()
+            if len(cols) < 7: continue
+            if float(cols[0]) / dt < warmup_steps: continue
+            times.append(float(cols[6]))
+    if not times:
+        return None
+    return sum(times) / len(times)
+
+def launch(args, case, mode, n):
+    layout = rank_layout(n)
+    domain = domain_of(case, mode, layout)
+    folder = os.path.join(args.out, "%s_%s_%d" % (case, mode, n))
+    os.makedirs(folder, exist_ok=True)
+
+    if case == 'rbc':
+        shutil.copy(os.path.join(here, '..', '..', 'data', 'rbc_mesh.off'), folder)
+
+    cmd = [args.launcher, '--runargs', '-n %d' % (2*n), sys.executable, os.path.join(here, 'case.py'),
+           '--case', case,
+           '--ranks']  + [str(r) for r in layout] + \
+          ['--domain'] + [str(d) for d in domain] + \
+          ['--nsteps', str(args.nsteps),
+           '--profile-steps', str(args.profile_steps)]
+
+    print("Running %s: %s" % (folder, ' '.join(cmd)), flush=True)
+    subprocess.check_call(cmd, cwd=folder, stdout=subprocess.DEVNULL)
+
+    with open(os.path.join(folder, 'meta.json')) as f:
+        result = json.load(f)
+
+    result['mode'] = mode
+    result['ms_per_step'] = read_stats(os.path.join(folder, 'stats.txt'), result['dt'], args.warmup)
+    result['steps_per_second'] = 1000.0 / result['ms_per_step'] if result['ms_per_step'] else None
+
+    profile = os.path.join(folder, 'tasks_profile.json')
+    if os.path.exists(profile):
+        with open(profile) as f:
+            result['tasks'] = json.load(f)['tasks']
+
+    return result
+
+def add_efficiency(results):
+    """Efficiency relative to the smallest run of the same case and mode."""
+    for r in results:
+        same = [s for s in results if s['case'] == r['case'] and s['mode'] == r['mode'] and s['ms_per_step']]
+        if not same or not r['ms_per_step']:
+            continue
+        ref = min(same, key=lambda s: s['nranks'])
+        ratio = ref['ms_per_step'] / r['ms_per_step']
+        if r['mode'] == 'strong':
+            ratio *= ref['nranks'] / r['nranks']
+        r['efficiency'] = ratio
+
+def compare(old_fname, new_fname, threshold):
+    """Print the relative change of the time per step between two results files."""
+    def load(fname):
+        with open(fname) as f:
+            return {(r['case'], r['mode'], r['nranks']) : r for r in json.load(f)['runs']}
+
+    old, new = load(old_fname), load(new_fname)
+    regressions = 0
+
+    for key in sorted(set(old) & set(new)):
+        a, b = old[key]['ms_per_step'], new[key]['ms_per_step']
+        if not a or not b: continue
+        change = b / a - 1.0
+        flag = ''
+        if change > threshold:
+            flag = '  <-- slower'
+            regressions += 1
+        print("%-12s %-7s %4d ranks: %9.3f -> %9.3f ms/step (%+.1f%%)%s" %
+              (key[0], key[1], key[2], a, b, 100 * change, flag))
+
+    return regressions
+
+parser = argparse.ArgumentParser()
+parser.add_argument('--cases',    nargs='+', default=['dpd', 'poiseuille', 'rbc'], choices=sorted(base_domains.keys()))
+parser.add_argument('--ranks',    type=int, nargs='+', default=[1, 2, 4, 8])
+parser.add_argument('--mode',     nargs='+', default=['strong', 'weak'], choices=['strong', 'weak'])
+parser.add_argument('--nsteps',   type=int, default=1000)
+parser.add_argument('--warmup',   type=int, default=200, help='steps excluded from the time per step')
+parser.add_argument('--profile-steps', type=int, default=100)
+parser.add_argument('--launcher', type=str, default='ymr.run')
+parser.add_argument('--out',      type=str, default='scaling_results')
+parser.add_argument('--compare',  type=str, nargs=2, metavar=('OLD', 'NEW'), help='compare two results.json files and exit')
+parser.add_argument('--threshold', type=float, default=0.05, help='relative slowdown reported as a regression by --compare')
+args = parser.parse_args()
+
+if args.compare:
+    sys.exit(1 if compare(args.compare[0], args.compare[1], args.threshold) > 0 else 0)
+
+results = []
+for case in args.cases:
+    for mode in args.mode:
+        for n in args.ranks:
+            results.append(launch(args, case, mode, n))
+
+add_efficiency(results)
+
+with open(os.path.join(args.out, 'results.json'), 'w') as f:
+    json.dump({'runs' : results}, f, indent=2)
+
+for r in results:
+    print("%-12s %-7s %4d ranks: %9.3f ms/step, efficiency %.2f" %
+          (r['case'], r['mode'], r['nranks'], r['ms_per_step'] or 0, r.get('efficiency', 0)))
@@ -0,0 +1,71 @@
+#include "../bench.h"
+
+#include <core/celllist.h>
+#include <core/initial_conditions/uniform_ic.h>
+#include <core/logger.h>
+#include <core/pvs/particle_vector.h>
+#include <core/utils/common.h>
+#include <core/walls/factory.h>
+
+Logger logger;
+
+static const float dt = 1e-3f;
+
+/**
+ * Bounce of the particles from an SDF-based wall, only the boundary cells are visited.
+ * The old positions are the current ones, every repetition then does the same work.
+ */
+static void benchBounce(BenchReport& report, const BenchOptions& opts, std::string kind,
+                        float L, float rc, float density)
+{
+    const float3 length {L, L, L};
+    DomainInfo domain{length, {0,0,0}, length};
+    YmrState state(domain, dt);
+
+    std::shared_ptr<SDF_basedWall> wall;
+    if (kind == "sphere")
+        wall = WallFactory::createSphereWall(&state, "wall", PyTypes::float3 {0.5f*L, 0.5f*L, 0.5f*L}, 0.4f*L, true);
+    else
+        wall = WallFactory::createCylinderWall(&state, "wall", PyTypes::float2 {0.5f*L, 0.5f*L}, 0.4f*L, "z", true);
+
+    MPI_Comm comm = MPI_COMM_WORLD;
+    wall->setup(comm);
+
+    ParticleVector pv(&state, "pv", 1.0f);
+    UniformIC ic(density);
+    ic.exec(comm, &pv, 0);
+
+    PrimaryCellList cells(&pv, rc, length);
+    cells.build(0);
+
+    wall->setPrerequisites(&pv);
+    wall->attach(&pv, &cells);
+    pv.local()->extraPerParticle.getData<Particle>(ChannelNames::oldParts)->copy(pv.local()->coosvels, 0);
+
+    auto stats = measure(opts, 0, [&] () {
+        wall->bounce(0);
+    });
+
+    report.add("sdf_bounce_" + kind, { {"box", L}, {"rc", rc}, {"density", density} },
+               pv.local()->size(), stats);
+}
+
+int main(int argc, char **argv)
+{
+    MPI_Init(&argc, &argv);
+    logger.init(MPI_COMM_WORLD, "bench_walls.log", 0);
+
+    {
+        BenchOptions opts(argc, argv);
+        BenchReport report("walls", opts);
+
+        for (float L : opts.sweep<float>({16, 32, 64}))
+            for (float rc : opts.sweep<float>({1.0f, 1.5f}))
+                for (float density : opts.sweep<float>({4, 8, 16}))
+                    for (auto kind : {"sphere", "cylinder"})
+                        benchBounce(report, opts, kind, L, rc, density);
+    }
+
+    MPI_Finalize();
+    return 0;
+}
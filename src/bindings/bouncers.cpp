@@ -25,10 +25,17 @@ void exportBouncers(py::module& m)
             the new velocity of the bounced particles will be a random vector drawn from the Maxwell distibution of given temperature
             and added to the velocity of the mesh triangle at the collision point.
     )")
-        .def(py::init<const YmrState*, std::string, float>(), "state"_a, "name"_a, "kbt"_a=0.5, R"(
+        .def(py::init<const YmrState*, std::string, float, std::string>(),
+             "state"_a, "name"_a, "kbt"_a=0.5, "broadphase"_a="auto", R"(
             Args:
                 name: name of the bouncer
                 kbt:  Maxwell distribution temperature defining post-collision velocity
+                broadphase: how the candidate crossings are found:
+
+                    * **cells**: every triangle checks the particles of the cells it sweeps over
+                    * **bvh**: every particle queries a bounding volume hierarchy built over the swept triangles,
+                      faster for dense meshes, e.g. suspensions of many cells
+                    * **auto**: choose at every step based on the number of triangles per cell
         )");
         
     py::handlers_class<BounceFromRigidEllipsoid>(m, "Ellipsoid", pybounce, R"(
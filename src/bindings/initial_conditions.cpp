@@ -6,6 +6,7 @@
 #include <core/initial_conditions/membrane_ic.h>
 #include <core/initial_conditions/restart.h>
 #include <core/initial_conditions/rigid_ic.h>
+#include <core/initial_conditions/species_ic.h>
 #include <core/initial_conditions/uniform_ic.h>
 #include <core/initial_conditions/uniform_filtered_ic.h>
 #include <core/initial_conditions/uniform_sphere_ic.h>
@@ -49,6 +50,20 @@ void exportInitialConditions(py::module& m)
                 global_scale:
                     All the membranes will be scaled by that value. Useful to implement membranes growth so that they
                     can fill the space with high volume fraction                                        
+        ))")
+        .def(py::init<PyTypes::float3, bool, float>(), "spacing"_a, "random_orientation"_a=true, "global_scale"_a=1.0, R"(
+            Place the membranes at the nodes of a regular lattice filling the whole domain.
+            Each rank only generates the membranes of its own subdomain, which avoids passing a huge list of objects
+            for dense suspensions.
+
+            Args:
+                spacing:
+                    Approximate distance between the lattice nodes along each direction, adjusted to tile the domain exactly
+                random_orientation:
+                    Whether the membranes are rotated uniformly at random, otherwise they all keep the orientation of the mesh.
+                    The orientations do not depend on the number of ranks
+                global_scale:
+                    All the membranes will be scaled by that value
         )");
 
     py::handlers_class<RestartIC>(m, "Restart", pyic, R"(
@@ -111,9 +126,37 @@ void exportInitialConditions(py::module& m)
                 com_q:
                     List specifying initial Center-Of-Mass velocities of the bodies.               
                     One entry (list of 3 floats) in the list corresponds to one object 
+        ))")
+        .def(py::init<PyTypes::float3, bool, const PyTypes::VectorOfFloat3&>(),
+             "spacing"_a, "random_orientation"_a, "coords"_a, R"(
+            Place the objects at the nodes of a regular lattice filling the whole domain.
+            Each rank only generates the objects of its own subdomain, which avoids passing a huge list of objects
+            for dense suspensions.
+
+            Args:
+                spacing:
+                    Approximate distance between the lattice nodes along each direction, adjusted to tile the domain exactly
+                random_orientation:
+                    Whether the objects are rotated uniformly at random, otherwise they all keep the orientation of the template.
+                    The orientations do not depend on the number of ranks
+                coords:
+                    Template that describes the positions of the body particles before translation or        
+                    rotation is applied.       
+                    The number of coordinates must be the same as in number of particles per object
+                    in the corresponding PV
         )");
     
 
+    py::handlers_class<SpeciesIC>(m, "Species", pyic, R"(
+        Apply another initial condition, then set the species of every particle, see :any:`DPDMultiSpecies`.
+    )")
+        .def(py::init<std::shared_ptr<InitialConditions>, std::function<int(PyTypes::float3)>>(),
+             "ic"_a, "species"_a, R"(
+            Args:
+                ic: the initial condition creating the particles
+                species: given the position of a particle, returns its species, from 0 to 7
+        )");
+
     py::handlers_class<UniformIC>(m, "Uniform", pyic, R"(
         The particles will be generated with the desired number density uniformly at random in all the domain.
         These IC may be used with any Particle Vector, but only make sense for regular PV.
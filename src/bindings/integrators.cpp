@@ -1,3 +1,5 @@
+#include <pybind11/stl.h>
+
 #include <core/integrators/factory.h>
 #include <core/interactions/interface.h>
 
@@ -69,9 +71,16 @@ void exportIntegrators(py::module& m)
             where bold symbol means a vector, :math:`m` is a particle mass, and superscripts denote the time: :math:`\mathbf{x}^{k} = \mathbf{x}(k \, \Delta t)`
         )")
         .def(py::init(&IntegratorFactory::createVV),
-             "state"_a, "name"_a, R"(
+             "state"_a, "name"_a, "fused_cell_binning"_a=false, "fused_wall_bounce"_a=false, R"(
                 Args:
                     name: name of the integrator
+                    fused_cell_binning: count the particles per cell of the primary cell-list in the integration kernel,
+                        which saves one pass over the particles in the cell-list build.
+                        Ignored, with a warning, for the particle vectors bounced from walls or objects or subject to belonging corrections.
+                        Plugins must not move or remove the particles between the integration and the cell-list build
+                    fused_wall_bounce: bounce the particles from a stationary wall in the integration kernel instead of
+                        a separate pass over the boundary cells. Only the particles ending close to the wall evaluate the SDF.
+                        Ignored, with a warning, for the particle vectors with several walls or moving walls
             )");
         
     py::handlers_class<IntegratorVV<Forcing_ConstDP>>
@@ -83,11 +92,13 @@ void exportIntegrators(py::module& m)
                 \mathbf{a}^{n} &= \frac{1}{m} \left( \mathbf{F}(\mathbf{x}^{n}, \mathbf{v}^{n-1/2}) + \mathbf{F}_{extra} \right) \\
         )")
         .def(py::init(&IntegratorFactory::createVV_constDP),
-             "state"_a, "name"_a, "force"_a, R"(
+             "state"_a, "name"_a, "force"_a, "fused_cell_binning"_a=false, "fused_wall_bounce"_a=false, R"(
 
                 Args:
                     name: name of the integrator
                     force: :math:`\mathbf{F}_{extra}`
+                    fused_cell_binning: same as in :any:`VelocityVerlet`
+                    fused_wall_bounce: same as in :any:`VelocityVerlet`
             )");
         
     py::handlers_class<IntegratorVV<Forcing_PeriodicPoiseuille>>
@@ -98,7 +109,7 @@ void exportIntegrators(py::module& m)
             with force :math:`-F_{Poiseuille}`    
         )")
         .def(py::init(&IntegratorFactory::createVV_PeriodicPoiseuille),
-             "state"_a, "name"_a, "force"_a, "direction"_a, R"(                
+             "state"_a, "name"_a, "force"_a, "direction"_a, "fused_cell_binning"_a=false, "fused_wall_bounce"_a=false, R"(                
                 Args:
                     name: name of the integrator
                     force: force magnitude, :math:`F_{Poiseuille}`
@@ -106,6 +117,48 @@ void exportIntegrators(py::module& m)
                                if direction is \"x\", the sign changes along \"y\".
                                if direction is \"y\", the sign changes along \"z\".
                                if direction is \"z\", the sign changes along \"x\".
+                    fused_cell_binning: same as in :any:`VelocityVerlet`
+                    fused_wall_bounce: same as in :any:`VelocityVerlet`
+            )");
+
+    py::handlers_class<IntegratorVV<Forcing_Andersen>>
+        (m, "VelocityVerlet_withAndersenThermostat", pyint, R"(
+            Same as regular :any:`VelocityVerlet`, with an Andersen thermostat applied in the integration kernel:
+            after the kick, every particle gets a new velocity from the Maxwell distribution at temperature :math:`k_BT`
+            with probability :math:`1 - e^{-\nu \Delta t}`. This replaces a separate pass over the particles,
+            e.g. with :any:`Temperaturize`, which corresponds to :math:`\nu \to \infty`.
+        )")
+        .def(py::init(&IntegratorFactory::createVV_Andersen),
+             "state"_a, "name"_a, "kbt"_a, "frequency"_a, "seed"_a=42424242, "fused_cell_binning"_a=false, "fused_wall_bounce"_a=false, R"(
+                Args:
+                    name: name of the integrator
+                    kbt: temperature :math:`k_BT`
+                    frequency: collision frequency :math:`\nu`
+                    seed: seed of the counter-based random numbers, drawn per particle and per step
+                    fused_cell_binning: same as in :any:`VelocityVerlet`
+                    fused_wall_bounce: same as in :any:`VelocityVerlet`
+            )");
+
+    py::handlers_class<IntegratorVV<Forcing_Langevin>>
+        (m, "VelocityVerlet_withLangevinThermostat", pyint, R"(
+            Same as regular :any:`VelocityVerlet`, with a Langevin thermostat applied in the integration kernel:
+            after the kick, the velocities are rescaled towards the thermal ones and get the matching noise
+            
+            .. math::
+
+                \mathbf{v}^{n+1/2} \leftarrow c \, \mathbf{v}^{n+1/2} + \sqrt{(1 - c^2) \frac{k_BT}{m}} \, \boldsymbol{\xi}, \qquad c = e^{-\gamma \Delta t}
+
+            where :math:`\boldsymbol{\xi}` is normally distributed.
+        )")
+        .def(py::init(&IntegratorFactory::createVV_Langevin),
+             "state"_a, "name"_a, "kbt"_a, "gamma"_a, "seed"_a=42424242, "fused_cell_binning"_a=false, "fused_wall_bounce"_a=false, R"(
+                Args:
+                    name: name of the integrator
+                    kbt: temperature :math:`k_BT`
+                    gamma: friction rate :math:`\gamma`
+                    seed: seed of the counter-based random numbers, drawn per particle and per step
+                    fused_cell_binning: same as in :any:`VelocityVerlet`
+                    fused_wall_bounce: same as in :any:`VelocityVerlet`
             )");
 
     py::handlers_class<IntegratorSubStepMembrane>
@@ -127,5 +180,30 @@ void exportIntegrators(py::module& m)
                     The interaction will be set when setting this integrator to the :any:`MembraneVector`.
                 
             )");
+
+    py::handlers_class<IntegratorSubStep>
+        (m, "SubStep", pyint, R"(
+            Multiple time stepping (RESPA) with two levels: the forces of the simulation (slow forces) are kept constant
+            during the time step, while the particle vector is advanced in sub-steps with the fast interactions recomputed at each of them.
+            Any self interaction can be fast, e.g. membrane forces, or contact forces between the particles of the object vector.
+            Positions and velocity are updated using an internal velocity verlet integrator.
+        )")
+        .def(py::init(&IntegratorFactory::createSubStep),
+             "state"_a, "name"_a, "substeps"_a, "fastForces"_a, "max_displacement"_a = 0.0f, R"(
+                Args:
+                    name: name of the integrator
+                    substeps: number of sub steps, or their maximum number if **max_displacement** is positive
+                    fastForces: list of the fast interactions
+                    max_displacement: if positive, the number of sub steps is chosen at every time step such that
+                        the largest fast acceleration of the previous step moves a particle by less than this distance per sub step
+
+                .. warning::
+                    The fast interactions must not be set for the particle vector explicitely,
+                    they are set when setting this integrator to the particle vector.
+                    Only two levels are supported: all the fast interactions are recomputed at every sub step.
+                    The fast interactions do not see the halo: interactions other than :any:`MembraneForces`
+                    only act between the local particles during the sub steps, the contacts with the particles
+                    of the neighbouring ranks are missed.
+            )");
 }
 
@@ -2,24 +2,31 @@
 
 #include <core/interactions/interface.h>
 #include <core/interactions/dpd.h>
+#include <core/interactions/dpd_with_lj.h>
 #include <core/interactions/dpd_with_stress.h>
 #include <core/interactions/mdpd.h>
 #include <core/interactions/mdpd_with_stress.h>
 #include <core/interactions/lj.h>
 #include <core/interactions/lj_with_stress.h>
+#include <core/interactions/multi_species.h>
+#include <core/interactions/tabulated.h>
 #include <core/interactions/membrane_WLC_Kantor.h>
 #include <core/interactions/membrane_WLC_Juelicher.h>
+#include <core/interactions/rod.h>
 #include <core/interactions/factory.h>
 
 #include "bindings.h"
 #include "class_wrapper.h"
 
+#include <pybind11/functional.h>
+#include <pybind11/stl.h>
+
 using namespace pybind11::literals;
 
 static std::shared_ptr<InteractionMembrane>
 createInteractionMembrane(const YmrState *state, std::string name,
                           std::string shearDesc, std::string bendingDesc,
-                          bool stressFree, float growUntil, py::kwargs kwargs)
+                          bool stressFree, float growUntil, std::string precision, py::kwargs kwargs)
 {
     std::map<std::string, float> parameters;
 
@@ -36,7 +43,7 @@ createInteractionMembrane(const YmrState *state, std::string name,
     }    
     
     return InteractionFactory::createInteractionMembrane
-        (state, name, shearDesc, bendingDesc, parameters, stressFree, growUntil);
+        (state, name, shearDesc, bendingDesc, parameters, stressFree, growUntil, precision);
 }
 
 
@@ -69,6 +76,49 @@ void exportInteractions(py::module& m)
 {
     py::handlers_class<Interaction> pyInt(m, "Interaction", "Base interaction class");
 
+    pyInt.def("use_neighbor_list", &Interaction::useNeighborList, "skin"_a, R"(
+        Compute local interactions within one Particle Vector with a Verlet neighbor list instead of the cell-lists.
+        The list contains all the pairs closer than **rc** + **skin** and is rebuilt only when some particle
+        has moved further than **skin** / 2 since the last build.
+        Only available for pairwise interactions and Particle Vectors with primary cell-lists.
+
+        Args:
+            skin: extra distance added to the cut-off radius when building the list
+    )");
+
+    pyInt.def("use_tiled_kernels", &Interaction::useTiledKernels, "enabled"_a = true, R"(
+        Compute local interactions within one Particle Vector with one warp per cell, that stages the
+        neighbouring particles in shared memory instead of reading them from global memory in every thread.
+        The same applies to the local interactions between two Particle Vectors whose cell-lists have the same cell size.
+        Usually faster for dense particle vectors. Only available for pairwise interactions.
+
+        Args:
+            enabled: whether to use the tiled kernels
+    )");
+
+    pyInt.def("use_early_interior", &Interaction::useEarlyInterior, "enabled"_a = true, R"(
+        Compute the interactions within one Particle Vector in two passes: the interior of the subdomain right after
+        the local intermediate quantities, e.g. the densities, and the rest once the intermediate halo exchange is done.
+        Far enough from the boundary, the intermediate quantities do not depend on the halo, hence the interior does not
+        wait for the communication. The interior pass uses the tiled kernels.
+        Only available for :any:`SDPD` and :any:`MDPD`, and for the Particle Vectors whose intermediate interactions
+        all use the same cut-off radius; ignored otherwise.
+
+        Args:
+            enabled: whether to compute the interior early
+    )");
+
+    pyInt.def("use_compressed_storage", &Interaction::useCompressedStorage, "enabled"_a = true, "validate"_a = false, R"(
+        Read the neighbouring particles of the interactions between different Particle Vectors and with the halo
+        from a compressed copy: coordinates are stored as 16-bit fixed point numbers within the local domain and
+        velocities in half precision, which halves the memory traffic. Forces are still computed and accumulated in
+        single precision. Only available for the pairwise interactions that need coordinates and velocities only.
+
+        Args:
+            enabled: whether to use the compressed storage
+            validate: if True, also compute the forces in full precision and report the difference at every step (slow)
+    )");
+
     py::handlers_class<InteractionDPD> pyIntDPD(m, "DPD", pyInt, R"(
         Pairwise interaction with conservative part and dissipative + random part acting as a thermostat, see [Groot1997]_
     
@@ -95,8 +145,8 @@ void exportInteractions(py::module& m)
             J. Chem. Phys., 107(11), 4423-4435. `doi <https://doi.org/10.1063/1.474784>`_
     )");
 
-    pyIntDPD.def(py::init<const YmrState*, std::string, float, float, float, float, float>(),
-                 "state"_a, "name"_a, "rc"_a, "a"_a, "gamma"_a, "kbt"_a, "power"_a, R"(  
+    pyIntDPD.def(py::init<const YmrState*, std::string, float, float, float, float, float, bool>(),
+                 "state"_a, "name"_a, "rc"_a, "a"_a, "gamma"_a, "kbt"_a, "power"_a, "counter_rng"_a=false, R"(  
             Args:
                 name: name of the interaction
                     rc: interaction cut-off (no forces between particles further than **rc** apart)
@@ -104,6 +154,9 @@ void exportInteractions(py::module& m)
                     gamma: :math:`\gamma`
                     kbt: :math:`k_B T`
                     power: :math:`p` in the weight function
+                    counter_rng: draw :math:`\theta` with the Philox4x32-10 counter-based generator, keyed by the time step
+                        and the ids of the pair, instead of the logistic map. The random forces then only depend
+                        on the step and on the pair, and are reproduced exactly after a restart
     )");
 
     pyIntDPD.def("setSpecificPair", &InteractionDPD::setSpecificPair, 
@@ -118,8 +171,9 @@ void exportInteractions(py::module& m)
         wrapper of :any:`DPD` with, in addition, stress computation
     )");
 
-    pyIntDPDWithStress.def(py::init<const YmrState*, std::string, float, float, float, float, float, float>(),
-                           "state"_a, "name"_a, "rc"_a, "a"_a, "gamma"_a, "kbt"_a, "power"_a, "stressPeriod"_a, R"(  
+    pyIntDPDWithStress.def(py::init<const YmrState*, std::string, float, float, float, float, float, float, bool>(),
+                           "state"_a, "name"_a, "rc"_a, "a"_a, "gamma"_a, "kbt"_a, "power"_a, "stressPeriod"_a,
+                           "counter_rng"_a=false, R"(  
             Args:
                 name: name of the interaction
                 rc: interaction cut-off (no forces between particles further than **rc** apart)
@@ -128,8 +182,36 @@ void exportInteractions(py::module& m)
                 kbt: :math:`k_B T`
                 power: :math:`p` in the weight function
                 stressPeriod: compute the stresses every this period (in simulation time units)
+                counter_rng: see :any:`DPD`
+    )");
+
+    py::handlers_class<InteractionDPDWithLJ> pyIntDPDWithLJ(m, "DPDWithLJ", pyInt, R"(
+        Sum of the :any:`DPD` and :any:`LJ` forces, computed in a single pass over the neighbouring particles.
+        Equivalent to, but faster than, two separate interactions set between the same Particle Vectors.
+    )");
+
+    pyIntDPDWithLJ.def(py::init<const YmrState*, std::string, float, float, float, float, float, float, float, float, bool, bool>(),
+                       "state"_a, "name"_a, "rc"_a, "a"_a, "gamma"_a, "kbt"_a, "power"_a,
+                       "epsilon"_a, "sigma"_a, "max_force"_a=1000.0, "object_aware"_a, "counter_rng"_a=false, R"(
+            Args:
+                name: name of the interaction
+                rc: interaction cut-off (no forces between particles further than **rc** apart)
+                a: :math:`a`
+                gamma: :math:`\gamma`
+                kbt: :math:`k_B T`
+                power: :math:`p` in the weight function
+                epsilon: :math:`\varepsilon`
+                sigma: :math:`\sigma`
+                max_force: LJ force magnitude will be capped to not exceed **max_force**
+                object_aware: if True, LJ forces are not computed between the particles of the same object, see :any:`LJ`
+                counter_rng: see :any:`DPD`
     )");
 
+    pyIntDPDWithLJ.def("setSpecificPair", &InteractionDPDWithLJ::setSpecificPair,
+         "pv1"_a, "pv2"_a, "a"_a, "gamma"_a, "kbt"_a, "power"_a, "epsilon"_a, "sigma"_a, "max_force"_a, R"(
+            Override the interaction parameters for a specific pair of Particle Vectors
+         )");
+
     py::handlers_class<BasicInteractionDensity> pyIntDensity(m, "Density", pyInt, R"(
         Compute density of particles with a given kernel. 
     
@@ -154,6 +236,11 @@ void exportInteractions(py::module& m)
             .. math::
 
                 w_\rho(r) = \frac{21}{2\pi} \left( 1 - \frac{r}{r_c} \right)^4 \left( 1 + 4 \frac{r}{r_c} \right)
+
+        kernel "WendlandC2_tabulated":
+
+            the same as "WendlandC2", read from a table of 1024 linearly interpolated intervals
+            instead of being computed in every pair
     )");
     
     pyIntDensity.def(py::init(&InteractionFactory::createPairwiseDensity),
@@ -164,7 +251,8 @@ void exportInteractions(py::module& m)
             kernel: the density kernel to be used. possible choices are:
             
                 * MDPD
-                * WendlandC2            
+                * WendlandC2
+                * WendlandC2_tabulated
     )");
 
     py::handlers_class<InteractionMDPD> pyIntMDPD(m, "MDPD", pyInt, R"(
@@ -190,8 +278,8 @@ void exportInteractions(py::module& m)
            Physical Review E 68.6 (2003): 066702.`_
     )");
     
-    pyIntMDPD.def(py::init<const YmrState*, std::string, float, float, float, float, float, float, float>(),
-                  "state"_a, "name"_a, "rc"_a, "rd"_a, "a"_a, "b"_a, "gamma"_a, "kbt"_a, "power"_a, R"(  
+    pyIntMDPD.def(py::init<const YmrState*, std::string, float, float, float, float, float, float, float, int>(),
+                  "state"_a, "name"_a, "rc"_a, "rd"_a, "a"_a, "b"_a, "gamma"_a, "kbt"_a, "power"_a, "power_table"_a=0, R"(  
             Args:
                 name: name of the interaction
                     rc: interaction cut-off (no forces between particles further than **rc** apart)
@@ -201,6 +289,8 @@ void exportInteractions(py::module& m)
                     gamma: :math:`\gamma`
                     kbt: :math:`k_B T`
                     power: :math:`p` in the weight function
+                    power_table: if positive, the weight function is read from a table with this number of intervals
+                        instead of computing the power in every pair (default: 0)
     )");
 
     
@@ -209,8 +299,8 @@ void exportInteractions(py::module& m)
         wrapper of :any:`MDPD` with, in addition, stress computation
     )");
 
-    pyIntMDPDWithStress.def(py::init<const YmrState*, std::string, float, float, float, float, float, float, float, float>(),
-                            "state"_a, "name"_a, "rc"_a, "rd"_a, "a"_a, "b"_a, "gamma"_a, "kbt"_a, "power"_a, "stressPeriod"_a, R"(  
+    pyIntMDPDWithStress.def(py::init<const YmrState*, std::string, float, float, float, float, float, float, float, float, int>(),
+                            "state"_a, "name"_a, "rc"_a, "rd"_a, "a"_a, "b"_a, "gamma"_a, "kbt"_a, "power"_a, "stressPeriod"_a, "power_table"_a=0, R"(  
             Args:
                 name: name of the interaction
                 rc: interaction cut-off (no forces between particles further than **rc** apart)
@@ -221,6 +311,7 @@ void exportInteractions(py::module& m)
                 kbt: :math:`k_B T`
                 power: :math:`p` in the weight function
                 stressPeriod: compute the stresses every this period (in simulation time units)
+                power_table: number of intervals of the tabulated weight function, see :any:`MDPD`
     )");
 
 
@@ -298,7 +389,93 @@ void exportInteractions(py::module& m)
         "pv1"_a, "pv2"_a, "epsilon"_a, "sigma"_a, "max_force"_a, R"(
             Override some of the interaction parameters for a specific pair of Particle Vectors
         )");
+
+    pyIntLJ.def("use_object_broadphase", &InteractionLJ::useObjectBroadphase, "enabled"_a=true, R"(
+            Compute the forces between two Object Vectors per pair of objects whose bounding boxes are closer than the cut-off,
+            instead of over the cell-lists of all their particles.
+            In concentrated suspensions of large objects, most particles are then skipped without looking at their cells.
+            Only for object aware interactions, and not with the stresses.
+
+            Args:
+                enabled: whether to use the object broadphase
+        )");
         
+    py::handlers_class<InteractionTabulated> pyIntTabulated (m, "Tabulated", pyInt, R"(
+        Pairwise interaction with an arbitrary force law, given by the magnitude :math:`F(r)` of the force
+        at equally spaced distances from 0 to the cut-off and linearly interpolated in between:
+
+        .. math::
+
+            \mathbf{F}_{ij} = F(r_{ij}) \frac{\mathbf{r}_{ij}}{r_{ij}}
+
+        Positive values are repulsive. The force law is sampled once, new potentials can thus be tried
+        from python without recompiling, at about the cost of the built-in interactions.
+    )");
+
+    pyIntTabulated.def(py::init<const YmrState*, std::string, float, std::vector<float>>(),
+                       "state"_a, "name"_a, "rc"_a, "forces"_a, R"(
+            Args:
+                name: name of the interaction
+                rc: interaction cut-off (no forces between particles further than **rc** apart)
+                forces: values of :math:`F` at :math:`r = k\, r_c / (n-1)`, :math:`k = 0 \dots n-1`, with :math:`n \geq 2`
+    )");
+
+    pyIntTabulated.def(py::init([] (const YmrState *state, std::string name, float rc,
+                                    std::function<float(float)> force, int npoints) {
+                           std::vector<float> forces(npoints);
+                           for (int k = 0; k < npoints; k++)
+                               forces[k] = force(k * rc / (npoints - 1));
+                           return new InteractionTabulated(state, name, rc, forces);
+                       }),
+                       "state"_a, "name"_a, "rc"_a, "force"_a, "npoints"_a = 1024, R"(
+            Args:
+                name: name of the interaction
+                rc: interaction cut-off (no forces between particles further than **rc** apart)
+                force: python function giving :math:`F(r)`, sampled on **npoints** points from 0 to **rc**
+                npoints: size of the table
+    )");
+
+    pyIntTabulated.def("setSpecificPair", &InteractionTabulated::setSpecificPair,
+        "pv1"_a, "pv2"_a, "forces"_a, R"(
+            Use another table of the force for a specific pair of Particle Vectors
+        )");
+
+    py::handlers_class<InteractionDPDMultiSpecies> pyIntDPDMultiSpecies (m, "DPDMultiSpecies", pyInt, R"(
+        Same as :any:`DPD`, between particles of several species that may belong to the same Particle Vector.
+        The species of the particles is set by :any:`InitialConditions.Species` (0 by default) and the coefficients
+        are given per pair of species, such that all the species of a Particle Vector share one cell-list and one kernel.
+        At most 8 species are supported.
+    )");
+
+    pyIntDPDMultiSpecies.def(py::init<const YmrState*, std::string, float,
+                                      std::vector<std::vector<float>>, std::vector<std::vector<float>>,
+                                      float, std::vector<std::vector<float>>, bool>(),
+                             "state"_a, "name"_a, "rc"_a, "a"_a, "gamma"_a, "kbt"_a, "power"_a, "counter_rng"_a=false, R"(
+            Args:
+                name: name of the interaction
+                rc: interaction cut-off (no forces between particles further than **rc** apart)
+                a: symmetric matrix of :math:`a`, one row per species
+                gamma: symmetric matrix of :math:`\gamma`
+                kbt: :math:`k_B T`
+                power: symmetric matrix of :math:`p` in the weight function
+                counter_rng: see :any:`DPD`
+    )");
+
+    py::handlers_class<InteractionLJMultiSpecies> pyIntLJMultiSpecies (m, "LJMultiSpecies", pyInt, R"(
+        Same as :any:`LJ`, with :math:`\varepsilon` and :math:`\sigma` given per pair of species, see :any:`DPDMultiSpecies`.
+    )");
+
+    pyIntLJMultiSpecies.def(py::init<const YmrState*, std::string, float,
+                                     std::vector<std::vector<float>>, std::vector<std::vector<float>>, float>(),
+                            "state"_a, "name"_a, "rc"_a, "epsilon"_a, "sigma"_a, "max_force"_a=1000.0, R"(
+            Args:
+                name: name of the interaction
+                rc: interaction cut-off (no forces between particles further than **rc** apart)
+                epsilon: symmetric matrix of :math:`\varepsilon`, one row per species
+                sigma: symmetric matrix of :math:`\sigma`
+                max_force: force magnitude will be capped to not exceed **max_force**
+    )");
+
     py::handlers_class<InteractionLJWithStress> pyIntLJWithStress (m, "LJWithStress", pyIntLJ, R"(
         wrapper of :any:`LJ` with, in addition, stress computation
     )");
@@ -391,7 +568,7 @@ void exportInteractions(py::module& m)
 
     pyMembraneForces.def(py::init(&createInteractionMembrane),
                          "state"_a, "name"_a, "shear_desc"_a, "bending_desc"_a,
-                         "stress_free"_a=false, "grow_until"_a=0.f, R"( 
+                         "stress_free"_a=false, "grow_until"_a=0.f, "precision"_a="single", R"( 
              Args:
                  name: name of the interaction
                  shear_desc: a string describing what shear force is used
@@ -399,6 +576,9 @@ void exportInteractions(py::module& m)
                  stress_free: if True, stress Free shape is used for the shear parameters
                  grow_until: the size increases linearly in time from half of the provided mesh 
                              to its full size after that time; the parameters are scaled accordingly with time
+                 precision: 'single', or 'mixed' to compute the terms sensitive to round-off in double precision:
+                            the bending (dihedral) forces, the total area and volume constraints and the reductions they need.
+                            The bonds, triangles, viscous and random forces stay in single precision
 
              kwargs:
 
@@ -438,5 +618,36 @@ void exportInteractions(py::module& m)
                  * **kad**: area difference energy magnitude
                  * **DA0**: area difference at relaxed state divided by the offset of the leaflet midplanes
     )");
-}
 
+    py::handlers_class<InteractionRod> pyRodForces(m, "RodForces", pyInt, R"(
+        Internal forces of flagella-like filaments, stored as object vectors whose objects have :math:`5n+1` particles.
+        Every one of the :math:`n` segments of length :math:`l_0` is made of its first centerline particle :math:`5i`,
+        followed by 4 particles in the middle of the segment, on a square of side :math:`l_0 / \sqrt{2}` around the centerline;
+        the particle :math:`5n` ends the centerline.
+
+        The forces are composed of:
+            - harmonic bonds of stiffness :math:`k_s`, 15 per segment: between the two centerline particles, from both of them to the square,
+              the sides and the diagonals of the square. All are at rest in the geometry described above
+            - bending of the centerline, :math:`U_b = \frac{k_b}{2} \left( \theta_i - \theta_0 \right)^2`,
+              :math:`\theta_i` being the angle between the consecutive segments :math:`i` and :math:`i+1`
+            - twisting, :math:`U_t = \frac{k_t}{2} \left( \tau_i - \tau_0 \right)^2`,
+              :math:`\tau_i` being the dihedral angle between the first particles of the squares of the segments :math:`i` and :math:`i+1`,
+              around the centerline
+            - dissipation along the bonds, :math:`\mathbf{F}_{ij} = \gamma \frac{\left( \mathbf{u}_{ij} \cdot \mathbf{r}_{ij} \right)}{r_{ij}^2} \mathbf{r}_{ij}`
+
+        One warp computes all the forces of a filament, the filaments of all the rod interactions are computed in one launch.
+    )");
+
+    pyRodForces.def(py::init<const YmrState*, std::string, float, float, float, float, float, float, float>(),
+                    "state"_a, "name"_a, "l0"_a, "ks"_a, "kb"_a, "theta0"_a=0.f, "kt"_a=0.f, "tau0"_a=0.f, "gamma"_a=0.f, R"(
+            Args:
+                name: name of the interaction
+                l0: length of a segment
+                ks: stiffness of the bonds :math:`k_s`
+                kb: bending stiffness :math:`k_b`
+                theta0: equilibrium bending angle :math:`\theta_0`
+                kt: twisting stiffness :math:`k_t`
+                tau0: equilibrium twist angle :math:`\tau_0`
+                gamma: dissipation coefficient of the bonds :math:`\gamma`
+    )");
+}
@@ -19,11 +19,19 @@ void exportObjectBelongingCheckers(py::module& m)
         .. note:
             Checking if particles are inside or outside the mesh is a computationally expensive task,
             so it's best to perform checks at most every 1'000 - 10'000 time-steps.
+            With the bounding volume hierarchy (default), the cost per particle grows only as the logarithm of the number of triangles,
+            and much more frequent checks are affordable.
     )")
-        .def(py::init<const YmrState*, std::string>(),
-             "state"_a, "name"_a, R"(
+        .def(py::init<const YmrState*, std::string, bool, float>(),
+             "state"_a, "name"_a, "bvh"_a=true, "surface_shell"_a=0.0f, R"(
             Args:
                 name: name of the checker
+                bvh: if True, cast rays through a bounding volume hierarchy built over the triangles of all the objects;
+                    otherwise test the particles within the bounding box of each object against all of its triangles
+                surface_shell: if positive, the belonging corrections only test the particles closer than that to a membrane,
+                    the others keep the side they were found on by the previous correction. It must exceed the largest
+                    displacement of the particles relative to the membranes between two corrections, about
+                    correct_every * dt * vmax plus a small tolerance. Requires the bvh, not used for rigid objects
         )");
         
     py::handlers_class<EllipsoidBelongingChecker>(m, "Ellipsoid", pycheck, R"(
@@ -10,13 +10,101 @@
 #include <core/pvs/rigid_object_vector.h>
 #include <core/utils/pytypes.h>
 
+#include <pybind11/numpy.h>
 #include <pybind11/stl.h>
 
 namespace py = pybind11;
 using namespace pybind11::literals;
 
+/// where the components of a quantity of the local particles are, in the elements of a container
+struct ArrayLayout
+{
+    GPUcontainer *container;
+    int offset;        ///< bytes from the start of each element
+    int nComponents;
+    py::dtype dtype;
+};
+
+static ArrayLayout getArrayLayout(ParticleVector *pv, const std::string& name)
+{
+    auto lpv = pv->local();
+
+    // Particle is two float4: coordinates and int, velocities and int; Force is a float4
+    if (name == "coordinates") return {&lpv->coosvels, 0,                    3, py::dtype::of<float>()};
+    if (name == "velocities")  return {&lpv->coosvels, (int) sizeof(float4), 3, py::dtype::of<float>()};
+    if (name == "forces")      return {&lpv->forces,   0,                    3, py::dtype::of<float>()};
+
+    auto& manager = lpv->extraPerParticle;
+    if (!manager.checkChannelExists(name))
+        die("Particle vector '%s' has no channel '%s'", pv->name.c_str(), name.c_str());
+
+    const auto& desc = manager.getChannelDescOrDie(name);
+    auto container = desc.container.get();
+
+    switch (desc.dataType)
+    {
+    case DataType::_float_:    return {container, 0, 1, py::dtype::of<float>()};
+    case DataType::_double_:   return {container, 0, 1, py::dtype::of<double>()};
+    case DataType::_int_:      return {container, 0, 1, py::dtype::of<int>()};
+    case DataType::_float3_:   return {container, 0, 3, py::dtype::of<float>()};
+    case DataType::_float4_:   return {container, 0, 4, py::dtype::of<float>()};
+    case DataType::_double3_:  return {container, 0, 3, py::dtype::of<double>()};
+    case DataType::_double4_:  return {container, 0, 4, py::dtype::of<double>()};
+    case DataType::_Stress_:   return {container, 0, 6, py::dtype::of<float>()};
+    default:
+        die("Channel '%s' of particle vector '%s' has a type that can not be viewed from python",
+            name.c_str(), pv->name.c_str());
+    }
+
+    return {};
+}
+
+static std::vector<ssize_t> getShape(const ArrayLayout& layout)
+{
+    std::vector<ssize_t> shape = {layout.container->size()};
+    if (layout.nComponents > 1) shape.push_back(layout.nComponents);
+    return shape;
+}
+
+static std::vector<ssize_t> getStrides(const ArrayLayout& layout)
+{
+    std::vector<ssize_t> strides = {layout.container->datatype_size()};
+    if (layout.nComponents > 1) strides.push_back(layout.dtype.itemsize());
+    return strides;
+}
+
+/**
+ * Device memory of the local particles, exposed through
+ * ``__cuda_array_interface__`` to CuPy, Numba or PyTorch without copies
+ */
+struct DeviceArrayView
+{
+    ArrayLayout layout;
+
+    py::dict cudaArrayInterface() const
+    {
+        py::dict interface;
+        auto ptr = (size_t) layout.container->genericDevPtr() + layout.offset;
+        auto typestr = std::string("<") + layout.dtype.kind() + std::to_string(layout.dtype.itemsize());
+
+        interface["shape"]   = py::tuple(py::cast(getShape(layout)));
+        interface["strides"] = py::tuple(py::cast(getStrides(layout)));
+        interface["typestr"] = typestr;
+        interface["data"]    = py::make_tuple(ptr, false);
+        interface["version"] = 2;
+        return interface;
+    }
+};
+
 void exportParticleVectors(py::module& m)
 {
+    py::class_<DeviceArrayView>(m, "DeviceArrayView", R"(
+        View of a device array of a :any:`ParticleVector`, see :py:meth:`ParticleVector.get_device_array`.
+        Implements ``__cuda_array_interface__``, e.g. ``cupy.asarray(view)`` or ``numba.cuda.as_cuda_array(view)``
+        access the data in place.
+    )")
+        .def_property_readonly("__cuda_array_interface__", &DeviceArrayView::cudaArrayInterface);
+
     py::handlers_class<ParticleVector> pypv(m, "ParticleVector", R"(
         Basic particle vector, consists of identical disconnected particles.
     )");
@@ -56,6 +144,66 @@ void exportParticleVectors(py::module& m)
         .def("setForces",      &ParticleVector::setForces_vector, "forces"_a, R"(
             Args:
                 forces: A list of :math:`N \times 3` floats: 3 components of force for every of the N particles
+        )")
+        .def("get_device_array", [] (ParticleVector *pv, std::string name) {
+                CUDA_Check( cudaDeviceSynchronize() );
+                return DeviceArrayView{getArrayLayout(pv, name)};
+            }, "name"_a, py::keep_alive<0, 1>(), R"(
+            View of the device data of the local particles, without copy.
+            The view is only valid until the next call to :py:meth:`_ymero.ymero.run`, which may reallocate the data.
+
+            Args:
+                name: ``coordinates``, ``velocities``, ``forces`` or the name of an extra channel of the particles
+
+            Returns:
+                a :any:`DeviceArrayView` of shape N or :math:`N \times` components.
+                The coordinates are given in the local frame of the subdomain
+        )")
+        .def("get_host_array", [] (ParticleVector *pv, std::string name) {
+                auto layout = getArrayLayout(pv, name);
+                auto hostPtr = (char*) layout.container->genericHostPtr();
+
+                if (hostPtr == nullptr)
+                    die("Channel '%s' of particle vector '%s' is only stored on the device, use get_device_array",
+                        name.c_str(), pv->name.c_str());
+
+                const size_t nbytes = (size_t) layout.container->size() * layout.container->datatype_size();
+                CUDA_Check( cudaDeviceSynchronize() );
+                CUDA_Check( cudaMemcpy(hostPtr, layout.container->genericDevPtr(), nbytes, cudaMemcpyDeviceToHost) );
+
+                return py::array(layout.dtype, getShape(layout), getStrides(layout), hostPtr + layout.offset, py::cast(pv));
+            }, "name"_a, R"(
+            Download the data of the local particles to their host buffer and view it as a NumPy array, without further copy.
+            Changes of the array are not uploaded to the device.
+            The view is only valid until the next call to :py:meth:`_ymero.ymero.run`.
+
+            Args:
+                name: ``coordinates``, ``velocities`` or the name of an extra channel of the particles
+
+            Returns:
+                an array of shape N or :math:`N \times` components.
+                The coordinates are given in the local frame of the subdomain
+        )")
+        .def("set_static", &ParticleVector::setStatic, "enabled"_a=true, R"(
+            Declare that the particles never move, e.g. frozen particles, which are static by default.
+            Their cell-lists and halo are then only built once and the forces on them are not computed.
+            A static particle vector can not be integrated.
+
+            Args:
+                enabled: whether the particles are static
+        )")
+
+        .def("use_packed_positions", &ParticleVector::usePackedPositions, "enabled"_a=true, R"(
+            Keep a cached copy of the particle coordinates, written when the cell-lists are built.
+            The particles themselves are unchanged and remain the reference: the copy is only read
+            while it is up to date with the last cell-list build.
+            Passes that need only the positions (pairwise interactions, neighbor lists, belonging and SDF checks)
+            then read half of the data, at the cost of 16 bytes per particle and cell-list in memory
+            and 16 more bytes written per particle at each build.
+            Whether it pays off depends on the number of passes between two builds, see the interaction benchmark.
+
+            Args:
+                enabled: whether to keep the copy
         )");
 
     py::handlers_class<Mesh> pymesh(m, "Mesh", R"(
@@ -77,10 +225,17 @@ void exportParticleVectors(py::module& m)
         
     )")
         .def("getVertices", &Mesh::getVertices, R"(
-        returns the vertex coordinates of the mesh.
+        returns the vertex coordinates of the mesh, in the order of the input.
     )")
         .def("getTriangles", &Mesh::getTriangles, R"(
-        returns the vertex indices for each triangle of the mesh.
+        returns the vertex indices for each triangle of the mesh, referring to the order of the input.
+    )")
+        .def("getOriginalIds", &Mesh::getOriginalIds, R"(
+        The vertices are renumbered for memory locality when the mesh is created, 
+        the particles of the objects and the dumps follow the new order.
+        
+        Returns:
+            for each vertex of the mesh, its index in the input
     )");
 
     py::handlers_class<MembraneMesh>(m, "MembraneMesh", pymesh, R"(
@@ -150,6 +305,16 @@ void exportParticleVectors(py::module& m)
                     inertia: moment of inertia of the body in its principal axes. The principal axes of the mesh are assumed to be aligned with the default global *OXYZ* axes
                     object_size: number of particles per membrane, must be the same as the number of vertices of the mesh
                     mesh: :any:`MembraneMesh` object         
+        )")
+        .def("use_surface_layer", &RigidObjectVector::useSurfaceLayer, "thickness"_a, R"(
+            Only store the frozen particles within the given distance of the surface of the objects (the mesh, or the ellipsoid).
+            The other particles are kept outside by the bouncers and cannot interact with the interior ones
+            if the thickness is at least the largest cutoff radius: memory, integration and halo exchanges then scale with the surface.
+            The dropped particles still count in the mass of the objects, but do not appear in the particle dumps.
+            Must be called before registering the object vector with its initial conditions.
+
+            Args:
+                thickness: width of the stored layer, non-positive to store all the particles
         )");
         
     py::handlers_class<RigidEllipsoidObjectVector> (m, "RigidEllipsoidVector", pyrov, R"(
@@ -10,6 +10,54 @@
 
 using namespace pybind11::literals;
 
+/**
+ * Field values from a python callable: either called once per chunk of points
+ * with a (n, 3) numpy array of positions, returning n values, if \p vectorized;
+ * or once per point with a (x, y, z) tuple
+ */
+static FieldBatchFunction toFieldFunction(py::function func, bool vectorized)
+{
+    // the reference to the callable may be dropped without the GIL, e.g. at exit
+    std::shared_ptr<py::function> f(new py::function(std::move(func)), [](py::function *f) {
+        py::gil_scoped_acquire gil;
+        delete f;
+    });
+
+    return [f, vectorized](const std::vector<float3>& positions) {
+        py::gil_scoped_acquire gil;
+
+        const int n = positions.size();
+        std::vector<float> values(n);
+
+        if (vectorized)
+        {
+            py::array_t<float> coordinates({n, 3});
+            auto c = coordinates.mutable_unchecked<2>();
+            for (int i = 0; i < n; i++)
+            {
+                c(i, 0) = positions[i].x;
+                c(i, 1) = positions[i].y;
+                c(i, 2) = positions[i].z;
+            }
+
+            using Result = py::array_t<float, py::array::c_style | py::array::forcecast>;
+            auto result = Result::ensure( (*f)(coordinates) );
+
+            if (!result || result.size() != n)
+                die("Vectorized field function must return one value per point, %d points given", n);
+
+            std::copy(result.data(), result.data() + n, values.begin());
+        }
+        else
+        {
+            for (int i = 0; i < n; i++)
+                values[i] = (*f)(py::make_tuple(positions[i].x, positions[i].y, positions[i].z)).cast<float>();
+        }
+
+        return values;
+    };
+}
+
 void exportPlugins(py::module& m)
 {
     py::handlers_class<SimulationPlugin>  pysim(m, "SimulationPlugin", R"(
@@ -60,7 +108,7 @@ void exportPlugins(py::module& m)
     )");
 
     py::handlers_class<UniformCartesianDumper>(m, "UniformCartesianDumper", pypost, R"(
-        Postprocess side plugin of :any:`Average3D` or :any:`AverageRelative3D`.
+        Postprocess side plugin of :any:`Average3D`, :any:`AverageRelative3D` or :any:`LoadDiagnostics`.
         Responsible for performing the I/O.
     )")
         .def("get_channel_view", [] (const UniformCartesianDumper &dumper, std::string chname) {
@@ -91,6 +139,37 @@ void exportPlugins(py::module& m)
         This plugin removes particles from a set of :any:`ParticleVector` in a given region at a given mass rate.
     )");
     
+    py::handlers_class<EffectiveWallForcePlugin>(m, "EffectiveWallForce", pysim, R"(
+        This plugin replaces the frozen particles of a stationary wall by a tabulated effective force on the particles near it.
+        The profile is a function of the SDF :math:`d` of the particle, typically measured in a calibration run with frozen wall particles,
+        e.g. with :any:`WallForceCollector`. It gives a normal conservative force :math:`F_n(d)` and a friction coefficient :math:`\gamma(d)`,
+        the random force follows from the fluctuation-dissipation theorem:
+
+        .. math::
+
+            \mathbf{F} = -F_n(d) \, \mathbf{\nabla}_{sdf} - \gamma(d) \, \mathbf{u} + \sqrt{\frac{2 \gamma(d) k_BT}{\Delta t}} \, \boldsymbol{\xi}
+
+        The force vanishes below the smallest SDF of the profile and is clamped above the largest one.
+        The wall still needs its bouncer, and is assumed at rest.
+    )");
+
+    py::handlers_class<EnergySpectrumPlugin>(m, "EnergySpectrum", pysim, R"(
+        This plugin computes the shell-averaged kinetic energy spectrum :math:`E(k)` of the velocity of particle vectors
+        in place, without dumping the velocity field. The velocity is binned on the grid like in :any:`Average3D`,
+        then Fourier transformed over the whole domain on the GPU: each 1D transform is preceded by an exchange of the
+        grid blocks among the ranks of a row of the rank grid, such that every rank transforms complete lines of the grid.
+        The spectra of the samples are averaged between the dumps, only the 1D spectra are written,
+        normalized such that the sum of :math:`E(k) \, dk` is the mean of :math:`u^2 / 2` over the bins.
+
+        .. note::
+            All the subdomains must have the same number of bins
+    )");
+
+    py::handlers_class<EnergySpectrumDumper>(m, "EnergySpectrumDumper", pypost, R"(
+        Postprocess side plugin of :any:`EnergySpectrum`.
+        Responsible for performing the I/O.
+    )");
+
     py::handlers_class<ExchangePVSFluxPlanePlugin>(m, "ExchangePVSFluxPlane", pysim, R"(
         This plugin exchanges particles from a particle vector crossing a given plane to another particle vector.
         A particle with position x, y, z has crossed the plane if ax + by + cz + d >= 0, where a, b, c and d are the coefficient 
@@ -103,6 +182,28 @@ void exportPlugins(py::module& m)
         The forces are stored in an array of float3.
     )");
     
+    py::class_<GPUCallbackView>(m, "GPUCallbackView", R"(
+        Device data of the local particles given to the function of :any:`GPUCallback`.
+        The addresses are integers, e.g. for ``cupy.cuda.UnownedMemory`` or ``numba.cuda.from_cuda_array_interface``.
+    )")
+        .def_readonly("time",      &GPUCallbackView::time,      "current simulation time")
+        .def_readonly("step",      &GPUCallbackView::step,      "current time-step")
+        .def_readonly("size",      &GPUCallbackView::size,      "number of local particles")
+        .def_readonly("mass",      &GPUCallbackView::mass,      "mass of the particles")
+        .def_readonly("particles", &GPUCallbackView::particles, "address of the particles: 8 floats each, coordinates, 32 bits of id, velocities, 32 bits of id")
+        .def_readonly("forces",    &GPUCallbackView::forces,    "address of the forces: 4 floats each, the force and an unused int")
+        .def_readonly("channels",  &GPUCallbackView::channels,  "addresses of the requested extra channels, by name")
+        .def_readonly("stream",    &GPUCallbackView::stream,    "CUDA stream on which the kernels must be launched");
+
+    py::handlers_class<GPUCallbackPlugin>(m, "GPUCallback", pysim, R"(
+        This plugin calls a python function at a given stage of every time-step, with the device addresses of the data
+        of a :any:`ParticleVector`. The function may launch its own kernels on them, e.g. written with CuPy (including raw CUDA sources
+        compiled at runtime) or Numba, to prototype custom forcing or analysis on the GPU without copies nor recompiling.
+
+        The kernels must be launched on the given stream and must not synchronize the device.
+        The coordinates are in the local frame of the subdomain.
+    )");
+
     py::handlers_class<ImposeProfilePlugin>(m, "ImposeProfile", pysim, R"(
         This plugin will set the velocity of each particle inside a given domain to a target velocity with an additive term 
         drawn from Maxwell distribution of the given temperature. 
@@ -115,6 +216,16 @@ void exportPlugins(py::module& m)
         .def("set_target_velocity", &ImposeVelocityPlugin::setTargetVelocity);
 
     
+    py::handlers_class<IsosurfacePlugin>(m, "Isosurface", pysim, R"(
+        This plugin extracts an isosurface of a field sampled on a grid and dumps it as a triangle mesh in XDMF format.
+        The field is either the number density of the given particle vectors or the signed distance function of the given walls.
+        The surface is triangulated on the GPU with marching cubes, such that much less data is written than with the whole grid,
+        e.g. to track the interface between two fluids.
+
+        .. note::
+            This plugin is inactive if postprocess is disabled
+    )");
+
     py::handlers_class<MagneticOrientationPlugin>(m, "MagneticOrientation", pysim, R"(
         This plugin gives a magnetic moment :math:`\mathbf{M}` to every rigid objects in a given :any:`RigidObjectVector`.
         It also models a uniform magnetic field :math:`\mathbf{B}` (varying in time) and adds the induced torque to the objects according to:
@@ -167,6 +278,29 @@ void exportPlugins(py::module& m)
         Responsible for performing the I/O.
     )");
 
+    py::handlers_class<ObjectShapePlugin>(m, "ObjectShape", pysim, R"(
+        This plugin computes the shape of every object of an :any:`ObjectVector` with a mesh directly on the GPU:
+        the gyration tensor of its particles around the center of mass, the eigenvalues and principal axes of that tensor,
+        the area and the enclosed volume of the mesh and the Taylor deformation index :math:`(L - B) / (L + B)`,
+        where :math:`L` and :math:`B` are the square roots of the largest and the smallest eigenvalues.
+        Only the small per-object table is sent to the postprocess.
+
+        The file format is the following:
+
+        <object id> <simulation time> <COM>x3 <area> <volume> <gyration xx xy xz yy yz zz> <eigenvalues>x3 <axes>3x3 <deformation index>
+
+        The eigenvalues are in decreasing order, the axes are the unit eigenvectors in the same order.
+        The inertia tensor of an object of :math:`N` particles of mass :math:`m` is :math:`N m (\mathrm{tr}(G) I - G)`.
+
+        .. note::
+            This plugin is inactive if postprocess is disabled
+    )");
+
+    py::handlers_class<ObjectShapeDumper>(m, "ObjectShapeDumper", pypost, R"(
+        Postprocess side plugin of :any:`ObjectShape`.
+        Responsible for performing the I/O.
+    )");
+
     py::handlers_class<ParticleChannelSaverPlugin>(m, "ParticleChannelSaver", pysim, R"(
         This plugin creates an extra channel per particle inside the given particle vector with a given name.
         It copies the content of an extra channel of pv at each time step and make it accessible by other plugins.
@@ -201,6 +335,22 @@ void exportPlugins(py::module& m)
     )");
 
     
+    py::handlers_class<PerfCountersPlugin>(m, "PerfCounters", pysim, R"(
+        This plugin periodically reports performance counters of the simulation, summed over the ranks:
+        cell-list rebuilds, buffer reallocations, entities, bytes and messages exchanged by every exchanger,
+        mesh bounce candidates and collisions, and the number of pairs of particles closer than the cut-off
+        of the cell-lists of the given particle vectors (i.e. the interactions evaluated by the pairwise kernels).
+        The counters are reset after every report.
+
+        .. note::
+            Counting the pairs costs one pass over the neighbours of every particle, only at the report steps
+    )");
+
+    py::handlers_class<PerfCountersDumper>(m, "PerfCountersDumper", pypost, R"(
+        Postprocess side plugin of :any:`PerfCounters`.
+        Responsible for the reduction over the ranks and the I/O.
+    )");
+
     py::handlers_class<PinObjectPlugin>(m, "PinObject", pysim, R"(
         This plugin will impose given velocity as the center of mass velocity (by axis) of all the objects of the specified Object Vector.
         If the objects are rigid bodies, rotatation may be restricted with this plugin as well.
@@ -229,6 +379,57 @@ void exportPlugins(py::module& m)
     )");
 
 
+    py::handlers_class<LoadDiagnosticsPlugin>(m, "LoadDiagnostics", pysim, R"(
+        This plugin measures the load of every simulation rank, averaged over windows of time-steps,
+        and dumps it as a grid with one cell per rank, such that the imbalance can be looked at over the domain.
+        The dumps hold the density of particles and, per rank:
+
+        * **particles**, **objects**: local numbers of particles and objects
+        * **exchanged_bytes**: bytes sent by the halo exchangers and redistributors per time-step
+        * **step_ms**: host time per time-step
+        * **force_ms**, **halo_ms**, **bounce_ms**, **plugin_ms**, **integrate_ms**, **other_ms**: GPU time per time-step
+          of the tasks of every category, only while the tasks are profiled, see :py:meth:`_ymero.ymero.start_task_profiling`
+
+        .. note::
+            This plugin is inactive if postprocess is disabled
+    )");
+
+    py::handlers_class<ProbesPlugin>(m, "Probes", pysim, R"(
+        This plugin measures the number density and the velocity of a :any:`ParticleVector` at given points,
+        interpolated from the particles around them with the Lucy kernel
+        :math:`w(r) = (1 + 3 q) (1 - q)^3, \, q = r / r_k` of support :math:`r_k`.
+        The particles are found through the cell list of the :any:`ParticleVector`, which must therefore interact with something.
+        Only the values at the probes are sent to the postprocess, such that long time series are cheap.
+    )");
+
+    py::handlers_class<ProbesDumper>(m, "ProbesDumper", pypost, R"(
+        Postprocess side plugin of :any:`Probes`.
+        Responsible for performing the I/O.
+    )");
+
+    py::handlers_class<RadialDistributionPlugin>(m, "RadialDistribution", pysim, R"(
+        This plugin measures the radial distribution function :math:`g(r)` of a :any:`ParticleVector` up to a given distance,
+        without dumping the particles. The pairs are binned on the GPU through the cell list of the :any:`ParticleVector`,
+        which must therefore interact with something; the pairs across the subdomain boundaries are found in the halo.
+        The counts are only sent and reduced over the ranks at the dumps.
+    )");
+
+    py::handlers_class<RadialDistributionDumper>(m, "RadialDistributionDumper", pypost, R"(
+        Postprocess side plugin of :any:`RadialDistribution`.
+        Responsible for performing the I/O.
+    )");
+
+    py::handlers_class<VelocityDistributionPlugin>(m, "VelocityDistribution", pysim, R"(
+        This plugin measures the probability densities of the three components of the velocity of a :any:`ParticleVector`
+        in a given range, without dumping the particles. The velocities are binned on the GPU,
+        the counts are only sent and reduced over the ranks at the dumps.
+    )");
+
+    py::handlers_class<VelocityDistributionDumper>(m, "VelocityDistributionDumper", pypost, R"(
+        Postprocess side plugin of :any:`VelocityDistribution`.
+        Responsible for performing the I/O.
+    )");
+
     py::handlers_class<SimulationStats>(m, "SimulationStats", pysim, R"(
         This plugin will report aggregate quantities of all the particles in the simulation:
         total number of particles in the simulation, average temperature and momentum, maximum velocity magnutide of a particle
@@ -262,6 +463,19 @@ void exportPlugins(py::module& m)
     )");
 
 
+    py::handlers_class<TracerCorrelatorPlugin>(m, "TracerCorrelator", pysim, R"(
+        This plugin computes the mean square displacement and the velocity autocorrelation of tracer particles
+        of a given :any:`ParticleVector`, with a multiple-tau correlator kept on the device.
+        The tracers are the particles of global ids 0, stride, 2*stride, ...
+        The lags of level l are multiples of averaging^l samples; the levels above 0 correlate
+        averages over averaging^l successive samples.
+    )");
+
+    py::handlers_class<TracerCorrelatorDumper>(m, "TracerCorrelatorDumper", pypost, R"(
+        Postprocess side plugin of :any:`TracerCorrelator`.
+        Responsible for performing the I/O.
+    )");
+
     py::handlers_class<VelocityInletPlugin>(m, "VelocityInlet", pysim, R"(
         This plugin inserts particles in a given :any:`ParticleVector`.
         The particles are inserted on a given surface with given velocity inlet. 
@@ -348,10 +562,19 @@ void exportPlugins(py::module& m)
             torque: extra torque (per object)
     )");
 
-    m.def("__createDensityControl", &PluginFactory::createDensityControlPlugin, 
+    m.def("__createDensityControl",
+          [] (bool computeTask, const YmrState *state, std::string name, std::string fname, std::vector<ParticleVector*> pvs,
+              float targetDensity, py::function region, PyTypes::float3 resolution,
+              float levelLo, float levelHi, float levelSpace, float Kp, float Ki, float Kd,
+              int tuneEvery, int dumpEvery, int sampleEvery, bool vectorized) {
+              return PluginFactory::createDensityControlPlugin(computeTask, state, name, fname, pvs, targetDensity,
+                                                               toFieldFunction(region, vectorized), resolution,
+                                                               levelLo, levelHi, levelSpace, Kp, Ki, Kd,
+                                                               tuneEvery, dumpEvery, sampleEvery);
+          },
           "compute_task"_a, "state"_a, "name"_a, "file_name"_a, "pvs"_a, "target_density"_a,
           "region"_a, "resolution"_a, "level_lo"_a, "level_hi"_a, "level_space"_a,
-          "Kp"_a, "Ki"_a, "Kd"_a, "tune_every"_a, "dump_every"_a, "sample_every"_a, R"(
+          "Kp"_a, "Ki"_a, "Kd"_a, "tune_every"_a, "dump_every"_a, "sample_every"_a, "vectorized"_a=false, R"(
         Create :any:`DensityControlPlugin`
         
         Args:
@@ -369,11 +592,17 @@ void exportPlugins(py::module& m)
             tune_every: update the forces every this amount of time steps
             dump_every: dump densities and forces in file ``filename``
             sample_every: sample to average densities every this amount of time steps
+            vectorized: if True, **region** is called on (n, 3) numpy arrays of positions and returns n values
     )");
 
-    m.def("__createDensityOutlet", &PluginFactory::createDensityOutletPlugin, 
+    m.def("__createDensityOutlet",
+          [] (bool computeTask, const YmrState *state, std::string name, std::vector<ParticleVector*> pvs,
+              float numberDensity, py::function region, PyTypes::float3 resolution, bool vectorized) {
+              return PluginFactory::createDensityOutletPlugin(computeTask, state, name, pvs, numberDensity,
+                                                              toFieldFunction(region, vectorized), resolution);
+          },
           "compute_task"_a, "state"_a, "name"_a, "pvs"_a, "number_density"_a,
-          "region"_a, "resolution"_a, R"(
+          "region"_a, "resolution"_a, "vectorized"_a=false, R"(
         Create :any:`DensityOutletPlugin`
         
         Args:
@@ -382,12 +611,18 @@ void exportPlugins(py::module& m)
             number_density: maximum number_density in the region
             region: a function that is negative in the concerned region and positive outside
             resolution: grid resolution to represent the region field
+            vectorized: if True, **region** is called on (n, 3) numpy arrays of positions and returns n values
         
     )");
 
-    m.def("__createRateOutlet", &PluginFactory::createRateOutletPlugin, 
+    m.def("__createRateOutlet",
+          [] (bool computeTask, const YmrState *state, std::string name, std::vector<ParticleVector*> pvs,
+              float rate, py::function region, PyTypes::float3 resolution, bool vectorized) {
+              return PluginFactory::createRateOutletPlugin(computeTask, state, name, pvs, rate,
+                                                           toFieldFunction(region, vectorized), resolution);
+          },
           "compute_task"_a, "state"_a, "name"_a, "pvs"_a, "mass_rate"_a,
-          "region"_a, "resolution"_a, R"(
+          "region"_a, "resolution"_a, "vectorized"_a=false, R"(
         Create :any:`RateOutletPlugin`
         
         Args:
@@ -396,12 +631,14 @@ void exportPlugins(py::module& m)
             mass_rate: total outlet mass rate in the region
             region: a function that is negative in the concerned region and positive outside
             resolution: grid resolution to represent the region field
+            vectorized: if True, **region** is called on (n, 3) numpy arrays of positions and returns n values
         
     )");
     
     m.def("__createDumpAverage", &PluginFactory::createDumpAveragePlugin, 
           "compute_task"_a, "state"_a, "name"_a, "pvs"_a, "sample_every"_a, "dump_every"_a,
-          "bin_size"_a = PyTypes::float3{1.0, 1.0, 1.0}, "channels"_a, "path"_a = "xdmf/", R"(
+          "bin_size"_a = PyTypes::float3{1.0, 1.0, 1.0}, "channels"_a, "path"_a = "xdmf/", "compression"_a = "none",
+          "backend"_a = "file", "double_precision"_a = false, "reduce_axes"_a = "", "pyramid_levels"_a = 1, R"(
         Create :any:`Average3D` plugin
         
         Args:
@@ -411,6 +648,19 @@ void exportPlugins(py::module& m)
             dump_every: write files every this many time-steps 
             bin_size: bin size for sampling. The resulting quantities will be *cell-centered*
             path: Path and filename prefix for the dumps. For every dump two files will be created: <path>_NNNNN.xmf and <path>_NNNNN.h5
+            compression: HDF5 filter of the data, one of 'none', 'mappable', 'deflate[:level]' (level from 1 to 9) or 'zfp[:tolerance]' (lossy, absolute tolerance, floating point channels only).
+                'mappable' writes uncompressed, contiguous and 4096 bytes aligned datasets, with their offsets in the .xmf, for :py:mod:`ymero.xdmf`
+            backend: destination of the dumps, 'file' (default) or 'stream:<port file>' to send them
+                to an analysis job listening on the MPI port whose name is in <port file>
+            double_precision: add every sample directly to double precision accumulators on the GPU,
+                instead of binning it in single precision first. Slower on GPUs with slow double atomics,
+                but keeps the precision of averages over many samples
+            reduce_axes: axes to average over, e.g. 'xz' for a profile along y or 'z' for a plane.
+                The grid then has a single bin along them, the sums are reduced on the GPU within the subdomains
+                and over the ranks of the rank grid before being sent, which writes a 2D or a 1D grid
+            pyramid_levels: number of resolutions written at every dump. The level l > 0 is coarsened :math:`2^l` times
+                along every axis and written as <path>_NNNNN_l<l>[.xmf,.h5], the density being averaged over the finer bins
+                and the other channels weighted by it. The local resolution must be divisible by :math:`2^{l}`
             channels: list of pairs name - type.
                 Name is the channel (per particle) name. Always available channels are:
                     
@@ -437,8 +687,8 @@ void exportPlugins(py::module& m)
           "compute_task"_a, "state"_a, "name"_a, "pvs"_a,
           "relative_to_ov"_a, "relative_to_id"_a,
           "sample_every"_a, "dump_every"_a,
-          "bin_size"_a = PyTypes::float3{1.0, 1.0, 1.0}, "channels"_a, "path"_a = "xdmf/",
-          R"(
+          "bin_size"_a = PyTypes::float3{1.0, 1.0, 1.0}, "channels"_a, "path"_a = "xdmf/", "compression"_a = "none",
+          "backend"_a = "file", "double_precision"_a = false, R"(
               
         Create :any:`AverageRelative3D` plugin
                 
@@ -449,8 +699,23 @@ void exportPlugins(py::module& m)
             relative_to_id: take an object governing the frame of reference with the specific ID
     )");
 
+    m.def("__createEnergySpectrum", &PluginFactory::createEnergySpectrumPlugin,
+          "compute_task"_a, "state"_a, "name"_a, "pvs"_a, "sample_every"_a, "dump_every"_a,
+          "bin_size"_a = PyTypes::float3{1.0, 1.0, 1.0}, "path"_a = "spectra/", R"(
+        Create :any:`EnergySpectrum` plugin
+
+        Args:
+            name: name of the plugin, also the prefix of the files
+            pvs: list of :any:`ParticleVector` whose velocity is binned
+            sample_every: bin the velocity and compute its spectrum every this many time-steps
+            dump_every: write the mean spectrum of the samples since the previous dump every this many time-steps
+            bin_size: bin size of the grid, adjusted like in :any:`Average3D`
+            path: the folder in which the files <name>_NNNNN.txt are written, with the columns k, E(k)
+    )");
+
     m.def("__createDumpMesh", &PluginFactory::createDumpMeshPlugin, 
-          "compute_task"_a, "state"_a, "name"_a, "ov"_a, "dump_every"_a, "path"_a, R"(
+          "compute_task"_a, "state"_a, "name"_a, "ov"_a, "dump_every"_a, "path"_a, "backend"_a = "file",
+          "half_precision"_a = false, R"(
         Create :any:`MeshPlugin` plugin
         
         Args:
@@ -458,6 +723,11 @@ void exportPlugins(py::module& m)
             ov: :any:`ObjectVector` that we'll work with
             dump_every: write files every this many time-steps
             path: the files will look like this: <path>/<ov_name>_NNNNN.ply
+            backend: 'file' (default) for the ply files, 'xdmf' for XDMF files <path>/<ov_name>_NNNNN[.xmf,.h5]
+                which only hold the vertices and share the triangles written once to <path>/<ov_name>_topology_NNNNN.h5,
+                or 'stream:<port file>' to send the meshes to an analysis job, see the dump_particles plugin
+            half_precision: send the vertices to the postprocess relative to the center of their object in FP16,
+                which halves the traffic at the cost of a relative error of about 1e-3 of the object size
     )");
 
     m.def("__createDumpObjectStats", &PluginFactory::createDumpObjPosition, 
@@ -471,9 +741,21 @@ void exportPlugins(py::module& m)
             path: the files will look like this: <path>/<ov_name>_NNNNN.txt
     )");
 
+    m.def("__createObjectShape", &PluginFactory::createObjectShapePlugin,
+          "compute_task"_a, "state"_a, "name"_a, "ov"_a, "dump_every"_a, "path"_a = "shapes/", R"(
+        Create :any:`ObjectShape` plugin
+
+        Args:
+            name: name of the plugin
+            ov: :any:`ObjectVector` that we'll work with, its objects must have a mesh
+            dump_every: compute and write the shapes every this many time-steps
+            path: the folder in which the file <ov name>_shapes.txt is written
+    )");
+
     m.def("__createDumpParticles", &PluginFactory::createDumpParticlesPlugin, 
           "compute_task"_a, "state"_a, "name"_a, "pv"_a, "dump_every"_a,
-          "channels"_a, "path"_a, R"(
+          "channels"_a, "path"_a, "compression"_a = "none", "subfiles"_a = 0, "decimation"_a = 1, "filter"_a = "all",
+          "backend"_a = "file", R"(
         Create :any:`ParticleSenderPlugin` plugin
         
         Args:
@@ -481,6 +763,21 @@ void exportPlugins(py::module& m)
             pv: :any:`ParticleVector` that we'll work with
             dump_every: write files every this many time-steps 
             path: Path and filename prefix for the dumps. For every dump two files will be created: <path>_NNNNN.xmf and <path>_NNNNN.h5
+            compression: HDF5 filter of the data, one of 'none', 'mappable', 'deflate[:level]' (level from 1 to 9) or 'zfp[:tolerance]' (lossy, absolute tolerance, floating point channels only).
+                'mappable' writes uncompressed, contiguous and 4096 bytes aligned datasets, with their offsets in the .xmf, for :py:mod:`ymero.xdmf`
+            subfiles: number of HDF5 files per dump, written by as many groups of ranks and linked by a single .xmf file;
+                0 for a single shared file (default), -1 for one file per node
+            decimation: dump only every this many particles, in their order in memory
+            filter: reduction of the dumped particles, done on the GPU before sending them, one of
+
+                * 'all': no reduction (default)
+                * 'random:fraction': random subset of the particles, the same particle ids are kept at every dump
+                * 'region:x0,y0,z0,x1,y1,z1': particles inside this box, global coordinates
+                * 'speed:min': particles faster than min
+                * 'objects:fraction': random subset of whole objects, object vectors only
+
+            backend: destination of the dumps, 'file' (default) or 'stream:<port file>' to send them
+                to an analysis job listening on the MPI port whose name is in <port file>
             channels: list of pairs name - type.
                 Name is the channel (per particle) name.
                 The "velocity" and "id" channels are always activated.
@@ -495,7 +792,7 @@ void exportPlugins(py::module& m)
     
     m.def("__createDumpParticlesWithMesh", &PluginFactory::createDumpParticlesWithMeshPlugin, 
           "compute_task"_a, "state"_a, "name"_a, "ov"_a, "dump_every"_a,
-          "channels"_a, "path"_a, R"(
+          "channels"_a, "path"_a, "compression"_a = "none", "backend"_a = "file", R"(
         Create :any:`ParticleWithMeshSenderPlugin` plugin
         
         Args:
@@ -503,6 +800,10 @@ void exportPlugins(py::module& m)
             ov: :any:`ObjectVector` that we'll work with
             dump_every: write files every this many time-steps 
             path: Path and filename prefix for the dumps. For every dump two files will be created: <path>_NNNNN.xmf and <path>_NNNNN.h5
+            compression: HDF5 filter of the data, one of 'none', 'mappable', 'deflate[:level]' (level from 1 to 9) or 'zfp[:tolerance]' (lossy, absolute tolerance, floating point channels only).
+                'mappable' writes uncompressed, contiguous and 4096 bytes aligned datasets, with their offsets in the .xmf, for :py:mod:`ymero.xdmf`
+            backend: destination of the dumps, 'file' (default) or 'stream:<port file>' to send them
+                to an analysis job listening on the MPI port whose name is in <port file>
             channels: list of pairs name - type.
                 Name is the channel (per particle) name.
                 The "velocity" and "id" channels are always activated.
@@ -516,7 +817,7 @@ void exportPlugins(py::module& m)
     )");
     
     m.def("__createDumpXYZ", &PluginFactory::createDumpXYZPlugin, 
-          "compute_task"_a, "state"_a, "name"_a, "pv"_a, "dump_every"_a, "path"_a, R"(
+          "compute_task"_a, "state"_a, "name"_a, "pv"_a, "dump_every"_a, "path"_a, "decimation"_a = 1, R"(
         Create :any:`XYZPlugin` plugin
         
         Args:
@@ -524,6 +825,19 @@ void exportPlugins(py::module& m)
             pvs: list of :any:`ParticleVector` that we'll work with
             dump_every: write files every this many time-steps
             path: the files will look like this: <path>/<pv_name>_NNNNN.xyz
+            decimation: dump only every this many particles, in their order in memory
+    )");
+
+    m.def("__createEffectiveWallForce", &PluginFactory::createEffectiveWallForcePlugin,
+          "compute_task"_a, "state"_a, "name"_a, "pv"_a, "wall"_a, "profile"_a, "kBT"_a, R"(
+        Create :any:`EffectiveWallForce` plugin
+
+        Args:
+            name: name of the plugin
+            pv: :any:`ParticleVector` that we'll work with
+            wall: :any:`Wall` whose particles are replaced, must be SDF-based
+            profile: list of (sdf, F_n, gamma) entries by increasing sdf, resampled on a uniform table; negative sdf is in the fluid
+            kBT: temperature of the random force
     )");
 
     m.def("__createExchangePVSFluxPlane", &PluginFactory::createExchangePVSFluxPlanePlugin,
@@ -546,6 +860,20 @@ void exportPlugins(py::module& m)
             pv: :any:`ParticleVector` that we'll work with
     )");
 
+    m.def("__createGPUCallback", &PluginFactory::createGPUCallbackPlugin,
+          "compute_task"_a, "state"_a, "name"_a, "pv"_a, "stage"_a, "every"_a, "function"_a,
+          "channels"_a = std::vector<std::string>(), R"(
+        Create :any:`GPUCallback` plugin
+
+        Args:
+            name: name of the plugin
+            pv: :any:`ParticleVector` that we'll work with
+            stage: when to call the function: ``before_forces`` (e.g. to add forces) or ``after_integration``
+            every: call the function every this many time-steps
+            function: python function taking a :any:`GPUCallbackView`
+            channels: names of the extra channels of the particles whose addresses are given to the function
+    )");
+
     m.def("__createImposeProfile", &PluginFactory::createImposeProfilePlugin, 
           "compute_task"_a, "state"_a, "name"_a, "pv"_a, "low"_a, "high"_a, "velocity"_a, "kbt"_a, R"(
         Create :any:`ImposeProfile` plugin
@@ -572,6 +900,22 @@ void exportPlugins(py::module& m)
             velocity: target velocity
     )");
 
+    m.def("__createIsosurface", &PluginFactory::createIsosurfacePlugin,
+          "compute_task"_a, "state"_a, "name"_a, "h"_a, "iso_value"_a, "dump_every"_a, "path"_a,
+          "pvs"_a=std::vector<ParticleVector*>(), "walls"_a=std::vector<Wall*>(), R"(
+        Create :any:`Isosurface` plugin
+        
+        Args:
+            name: name of the plugin
+            h: spacing of the grid, it is adjusted such that the grid nodes span each subdomain
+            iso_value: value of the field on the extracted surface
+            dump_every: write files every this many time-steps
+            path: the files will look like this: <path>NNNNN.xmf
+            pvs: list of :any:`ParticleVector`, the field is the number density of their particles
+            walls: list of :any:`Wall` (sdf-based only), the field is their merged signed distance function;
+                exactly one of **pvs** and **walls** must be given
+    )");
+
     m.def("__createMagneticOrientation", &PluginFactory::createMagneticOrientationPlugin,
           "compute_task"_a, "state"_a, "name"_a, "rov"_a, "moment"_a, "magneticFunction"_a, R"(
         Create :any:`MagneticOrientation` plugin
@@ -590,7 +934,7 @@ void exportPlugins(py::module& m)
         Args:
             name: name of the plugin
             pv: :class:`ParticleVector` to which the force should be added
-            forces: array of forces, one force (3 floats) per vertex in a single mesh
+            forces: array of forces, one force (3 floats) per vertex in a single mesh, in the order of the input mesh
     )");
 
     m.def("__createParticleChannelSaver", &PluginFactory::createParticleChannelSaverPlugin, 
@@ -614,6 +958,18 @@ void exportPlugins(py::module& m)
             update_every: displacements are computed between positions separated by this amount of timesteps
     )");
 
+    m.def("__createPerfCounters", &PluginFactory::createPerfCountersPlugin,
+          "compute_task"_a, "state"_a, "name"_a, "pvs"_a, "every"_a, "filename"_a, R"(
+        Create :any:`PerfCounters` plugin
+
+        Args:
+            name: name of the plugin
+            pvs: list of :any:`ParticleVector` whose interacting pairs are counted
+            every: report every that many time-steps
+            filename: text file with one line per counter and report: step, time, counter name, total over the ranks,
+                total per step and maximum over the ranks per step
+    )");
+
     m.def("__createPinObject", &PluginFactory::createPinObjPlugin, 
           "compute_task"_a, "state"_a, "name"_a, "ov"_a, "dump_every"_a, "path"_a, "velocity"_a, "angular_velocity"_a, R"(
         Create :any:`PinObject` plugin
@@ -631,7 +987,7 @@ void exportPlugins(py::module& m)
 
     m.def("__createRadialVelocityControl", &PluginFactory::createRadialVelocityControlPlugin,
           "compute_task"_a, "state"_a, "name"_a, "filename"_a, "pvs"_a, "minRadius"_a, "maxRadius"_a, 
-          "sample_every"_a, "tune_every"_a, "dump_every"_a, "center"_a, "target_vel"_a, "Kp"_a, "Ki"_a, "Kd"_a, R"(
+          "sample_every"_a, "tune_every"_a, "dump_every"_a, "center"_a, "target_vel"_a, "Kp"_a, "Ki"_a, "Kd"_a, "lagged"_a=false, R"(
         Create :any:`VelocityControl` plugin
         
         Args:
@@ -645,16 +1001,84 @@ void exportPlugins(py::module& m)
             center: center of the radial coordinates
             target_vel: the target mean velocity of the particles at :math:`r=1`
             Kp, Ki, Kd: PID controller coefficients
+            lagged: apply the force of a tuning step as soon as it is reduced over the ranks, possibly a few steps later,
+                instead of waiting for it before the next forces
+    )");
+
+    m.def("__createLoadDiagnostics", &PluginFactory::createLoadDiagnosticsPlugin,
+          "compute_task"_a, "state"_a, "name"_a, "sample_every"_a, "dump_every"_a,
+          "path"_a = "load/", "compression"_a = "none", "backend"_a = "file", R"(
+        Create :any:`LoadDiagnostics` plugin
+
+        Args:
+            name: name of the plugin
+            sample_every: count the particles and objects every this many time-steps
+            dump_every: write the averages of the window every this many time-steps, a multiple of **sample_every**
+            path: Path and filename prefix for the dumps. For every dump two files will be created: <path>_NNNNN.xmf and <path>_NNNNN.h5
+            compression: HDF5 filter of the data, see :py:func:`createDumpAverage`
+            backend: destination of the dumps, see :py:func:`createDumpAverage`
+    )");
+
+    m.def("__createProbes", &PluginFactory::createProbesPlugin,
+          "compute_task"_a, "state"_a, "name"_a, "pv"_a, "probes"_a, "radius"_a = 1.0, "sample_every"_a, "dump_every"_a,
+          "path"_a = "probes/", R"(
+        Create :any:`Probes` plugin
+
+        Args:
+            name: name of the plugin
+            pv: :any:`ParticleVector` that we'll work with
+            probes: list of the points, in global coordinates
+            radius: support of the interpolation kernel
+            sample_every: sample the probes every this many time-steps
+            dump_every: send the samples every this many time-steps, a multiple of **sample_every**
+            path: the folder in which the file <pv name>_probes.txt is written.
+                Each line holds the time, then the number density and the 3 components of the velocity of every probe;
+                the velocity is 0 at the probes without any particle within **radius**
+    )");
+
+    m.def("__createRadialDistribution", &PluginFactory::createRadialDistributionPlugin,
+          "compute_task"_a, "state"_a, "name"_a, "pv"_a, "rmax"_a, "nbins"_a = 100, "sample_every"_a, "dump_every"_a,
+          "path"_a = "distributions/", R"(
+        Create :any:`RadialDistribution` plugin
+
+        Args:
+            name: name of the plugin
+            pv: :any:`ParticleVector` that we'll work with
+            rmax: largest distance, at most the largest cut-off radius of the interactions of **pv**
+            nbins: number of bins in [0, **rmax**], at most 12288
+            sample_every: bin the pairs every this many time-steps
+            dump_every: write the distribution of the samples since the previous dump every this many time-steps,
+                a multiple of **sample_every**
+            path: the folder in which the files <pv name>_rdf_NNNNN.txt are written, with the columns r, g(r)
+    )");
+
+    m.def("__createVelocityDistribution", &PluginFactory::createVelocityDistributionPlugin,
+          "compute_task"_a, "state"_a, "name"_a, "pv"_a, "vmax"_a, "nbins"_a = 100, "sample_every"_a, "dump_every"_a,
+          "path"_a = "distributions/", R"(
+        Create :any:`VelocityDistribution` plugin
+
+        Args:
+            name: name of the plugin
+            pv: :any:`ParticleVector` that we'll work with
+            vmax: the velocity components are binned in [-**vmax**, **vmax**], the faster ones in the first or the last bin
+            nbins: number of bins, at most 4096
+            sample_every: bin the velocities every this many time-steps
+            dump_every: write the densities of the samples since the previous dump every this many time-steps,
+                a multiple of **sample_every**
+            path: the folder in which the files <pv name>_velocities_NNNNN.txt are written, with the columns v, pdf of vx, vy, vz
     )");
 
     m.def("__createStats", &PluginFactory::createStatsPlugin,
-          "compute_task"_a, "state"_a, "name"_a, "filename"_a="", "every"_a, R"(
+          "compute_task"_a, "state"_a, "name"_a, "filename"_a="", "every"_a,
+          "samples_per_message"_a=1, "window_statistics"_a=false, R"(
         Create :any:`SimulationStats` plugin
         
         Args:
             name: name of the plugin
             filename: the stats will also be recorded to that file in a computer-friendly way
             every: report to standard output every that many time-steps
+            samples_per_message: the samples stay on the device and are sent to the postprocess by groups of that many
+            window_statistics: instead of every sample, report the mean, standard deviation, min and max of every group
     )");
 
     m.def("__createTemperaturize", &PluginFactory::createTemperaturizePlugin,
@@ -670,7 +1094,7 @@ void exportPlugins(py::module& m)
 
     m.def("__createVelocityControl", &PluginFactory::createVelocityControlPlugin,
           "compute_task"_a, "state"_a, "name"_a, "filename"_a, "pvs"_a, "low"_a, "high"_a,
-          "sample_every"_a, "tune_every"_a, "dump_every"_a, "target_vel"_a, "Kp"_a, "Ki"_a, "Kd"_a, R"(
+          "sample_every"_a, "tune_every"_a, "dump_every"_a, "target_vel"_a, "Kp"_a, "Ki"_a, "Kd"_a, "lagged"_a=false, R"(
         Create :any:`VelocityControl` plugin
         
         Args:
@@ -683,6 +1107,8 @@ void exportPlugins(py::module& m)
             dump_every: write files every this many time-steps
             target_vel: the target mean velocity of the particles in the domain of interest
             Kp, Ki, Kd: PID controller coefficients
+            lagged: apply the force of a tuning step as soon as it is reduced over the ranks, possibly a few steps later,
+                instead of waiting for it before the next forces
     )");
 
     m.def("__createVelocityInlet", &PluginFactory::createVelocityInletPlugin,
@@ -700,8 +1126,33 @@ void exportPlugins(py::module& m)
             kBT: temperature of the inserted solvent
     )");
 
-    m.def("__createVirialPressurePlugin", &PluginFactory::createVirialPressurePlugin,
-          "compute_task"_a, "state"_a, "name"_a, "pv"_a, "regionFunc"_a, "h"_a, "dump_every"_a, "path"_a, R"(
+    m.def("__createTracerCorrelator", &PluginFactory::createTracerCorrelatorPlugin,
+          "compute_task"_a, "state"_a, "name"_a, "pv"_a, "n_tracers"_a, "stride"_a, "sample_every"_a, "dump_every"_a,
+          "block_size"_a=16, "n_levels"_a=8, "averaging"_a=2, "path"_a="correlations/", R"(
+        Create :any:`TracerCorrelator` plugin
+
+        Args:
+            name: name of the plugin
+            pv: :any:`ParticleVector` that we'll work with
+            n_tracers: number of tracer particles
+            stride: the tracers are the particles of global ids multiple of this, below n_tracers * stride
+            sample_every: sample the tracers every this many time-steps
+            dump_every: write the correlations every this many time-steps
+            block_size: number of lags per level, a multiple of **averaging**
+            n_levels: number of levels of the correlator, at most 16
+            averaging: number of samples of a level averaged into the next one
+            path: the folder in which the file <pv name>_correlations.txt is rewritten.
+                Each line holds the lag, the MSD, the VACF and the number of samples of that lag
+    )");
+
+    m.def("__createVirialPressurePlugin",
+          [] (bool computeTask, const YmrState *state, std::string name, ParticleVector *pv,
+              py::function regionFunc, PyTypes::float3 h, int dumpEvery, std::string path, bool vectorized) {
+              return PluginFactory::createVirialPressurePlugin(computeTask, state, name, pv,
+                                                               toFieldFunction(regionFunc, vectorized), h, dumpEvery, path);
+          },
+          "compute_task"_a, "state"_a, "name"_a, "pv"_a, "regionFunc"_a, "h"_a, "dump_every"_a, "path"_a,
+          "vectorized"_a=false, R"(
         Create :any:`VirialPressure` plugin
         
         Args:
@@ -711,6 +1162,7 @@ void exportPlugins(py::module& m)
             h: grid size for representing the predicate onto a grid
             dump_every: report total pressure every this many time-steps
             path: the folder name in which the file will be dumped
+            vectorized: if True, **regionFunc** is called on (n, 3) numpy arrays of positions and returns n values
     )");
 
     m.def("__createWallRepulsion", &PluginFactory::createWallRepulsionPlugin, 
@@ -727,7 +1179,8 @@ void exportPlugins(py::module& m)
     )");
 
     m.def("__createWallForceCollector", &PluginFactory::createWallForceCollectorPlugin, 
-          "compute_task"_a, "state"_a, "name"_a, "wall"_a, "pvFrozen"_a, "sample_every"_a, "dump_every"_a, "filename"_a, R"(
+          "compute_task"_a, "state"_a, "name"_a, "wall"_a, "pvFrozen"_a, "sample_every"_a, "dump_every"_a, "filename"_a,
+          "window_statistics"_a=false, R"(
         Create :any:`WallForceCollector` plugin
         
         Args:
@@ -737,6 +1190,8 @@ void exportPlugins(py::module& m)
             sample_every: sample every this number of time steps
             dump_every: dump every this amount of timesteps
             filename: output filename
+            window_statistics: also dump the standard deviation, min and max of each force component
+                over the samples since the previous dump
     )");
 }
 
@@ -81,11 +81,38 @@ void exportWalls(py::module& m)
         Therefore the boundary is defined by the zero-level isosurface.
     )")
         .def(py::init(&WallFactory::createSDFWall),
-            "state"_a, "name"_a, "sdfFilename"_a, "h"_a = PyTypes::float3{0.25, 0.25, 0.25}, R"(
+            "state"_a, "name"_a, "sdfFilename"_a, "h"_a = PyTypes::float3{0.25, 0.25, 0.25}, "narrow_band"_a = 0.0f, "gradient_texture"_a = false,
+            "storage"_a = "float", "storage_band"_a = 0.0f, R"(
             Args:
                 name: name of the wall
                 sdfFilename: lower corner of the box
                 h: resolution of the resampled SDF. In order to have a more accurate SDF representation, the initial function is resampled on a finer grid. The lower this value is, the better the wall will be, however, the  more memory it will consume and the slower the execution will be
+                narrow_band: if positive, only store the SDF in the bricks of :math:`8^3` grid nodes within this distance of the surface, the SDF reads as plus or minus this value further away.
+                    Saves most of the memory of big geometries; should be a few cut-off radii, larger than the thickness of the frozen layer
+                gradient_texture: precompute the normals of the wall on the SDF grid at setup, such that the normals used by the wall repulsion
+                    take one texture fetch instead of six SDF evaluations. Stores four more floats per grid node
+                storage: precision of the SDF grid, 'float', or 16 bit textures interpolated by the texture units:
+                    'half' for half precision floats, 'normalized' for the SDF clamped to plus or minus **storage_band** and normalized to 16 bit integers.
+                    Half of the memory of 'float'; the error against 'float' is logged at setup, and a warning is issued if it exceeds 5% of the grid spacing.
+                    Not with the **narrow_band**
+                storage_band: distance from the surface where the 'normalized' SDF is kept, the SDF reads as plus or minus this value further away.
+                    The smaller, the more accurate; should be larger than the thickness of the frozen layer, like the **narrow_band**
+        )");
+        
+    py::handlers_class< SimpleStationaryWall<StationaryWall_Mesh> >(m, "MeshSDF", pywall, R"(
+        This wall is defined by a closed triangle mesh given in global coordinates, the wall being inside of it.
+        The SDF is computed on the GPU at setup, on a regular grid of the subdomain of each rank:
+        the distance is found through a bounding volume hierarchy over the triangles,
+        and the sign is given by the generalized winding number of the mesh, which tolerates small defects of the mesh.
+        No SDF file needs to be precomputed.
+    )")
+        .def(py::init(&WallFactory::createMeshWall),
+            "state"_a, "name"_a, "mesh"_a, "h"_a = PyTypes::float3{0.25, 0.25, 0.25}, "inside"_a = false, R"(
+            Args:
+                name: name of the wall
+                mesh: :any:`Mesh` object of the wall surface
+                h: resolution of the SDF grid, same as for :any:`SDF`
+                inside: whether the domain is inside the mesh or outside of it
         )");
         
     py::handlers_class< WallWithVelocity<StationaryWall_Cylinder, VelocityField_Rotate> >(m, "RotatingCylinder", pywall, R"(
@@ -102,6 +129,24 @@ void exportWalls(py::module& m)
                 inside: whether the domain is inside the cylinder or outside of it
         )");
         
+    py::handlers_class< RotatingSDFWall >(m, "RotatingSDF", pywall, R"(
+        Rigid wall described by an SDF file, see :any:`SDF`, rotating with constant angular velocity around an axis parallel to x, y or z.
+        The SDF is resampled once in the frame of the wall, the rotation is applied when evaluating it, such that the geometry may be arbitrary, e.g. an impeller.
+        The SDF file describes the wall at time 0; only its part within the largest cylinder around the rotation axis that fits in the domain is used.
+
+        The frozen particles of the wall must rotate with it: use an :any:`Rotate` integrator with the same center and angular velocity.
+        The particles are bounced from all the cells the wall sweeps during one revolution.
+    )")
+        .def(py::init(&WallFactory::createRotatingSDFWall),
+            "state"_a, "name"_a, "sdfFilename"_a, "center"_a, "omega"_a, "h"_a = PyTypes::float3{0.25, 0.25, 0.25}, R"(
+            Args:
+                name: name of the wall
+                sdfFilename: file with the SDF of the wall at time 0
+                center: point of the rotation axis
+                omega: angular velocity vector, along x, y or z
+                h: resolution of the resampled SDF, same as for :any:`SDF`
+        )");
+
     py::handlers_class< WallWithVelocity<StationaryWall_Plane, VelocityField_Translate> >(m, "MovingPlane", pywall, R"(
         Planar wall that is moving along itself with constant velocity.
         Can be used to produce Couette velocity profile in combination with 
@@ -12,6 +12,7 @@
 #include <core/initial_conditions/interface.h>
 #include <core/pvs/particle_vector.h>
 #include <core/pvs/object_vector.h>
+#include <core/rank_placement.h>
 
 #include "bindings.h"
 #include "class_wrapper.h"
@@ -24,19 +25,31 @@ void exportYmero(py::module& m)
         state of the simulation shared by all simulation objects.
     )");
     
+    py::class_<AsyncRun>(m, "AsyncRun", R"(
+        Handle of a run in progress, see :py:meth:`_ymero.ymero.run_async`
+    )")
+        .def("done", &AsyncRun::done, R"(
+             Returns:
+                 whether the run is complete, without blocking
+         )")
+        .def("wait", &AsyncRun::wait, py::call_guard<py::gil_scoped_release>(), R"(
+             Block until the run is complete, the other Python threads keep running meanwhile
+         )");
+
     py::class_<YMeRo>(m, "ymero", R"(
         Main coordination class, should only be one instance at a time
     )")
         .def(py::init( [] (PyTypes::int3 nranks, PyTypes::float3 domain, float dt,
                            std::string log, int debuglvl, int checkpoint,
-                           std::string restart, bool cudaMPI, bool noSplash, long comm) {
+                           std::string restart, bool cudaMPI, bool noSplash, long comm, std::string placement) {
 
-                if (comm == 0) return std::make_unique<YMeRo> (      nranks, domain, dt, log, debuglvl, checkpoint, restart, cudaMPI, noSplash);
-                else           return std::make_unique<YMeRo> (comm, nranks, domain, dt, log, debuglvl, checkpoint, restart, cudaMPI, noSplash);
+                if (comm == 0) return std::make_unique<YMeRo> (      nranks, domain, dt, log, debuglvl, checkpoint, restart, cudaMPI, noSplash, placement);
+                else           return std::make_unique<YMeRo> (comm, nranks, domain, dt, log, debuglvl, checkpoint, restart, cudaMPI, noSplash, placement);
             } ),
             py::return_value_policy::take_ownership,
             "nranks"_a, "domain"_a, "dt"_a, "log_filename"_a="log", "debug_level"_a=3, "checkpoint_every"_a=0,
-            "restart_folder"_a="restart/", "cuda_aware_mpi"_a=false, "no_splash"_a=false, "comm_ptr"_a=0, R"(
+            "restart_folder"_a="restart/", "cuda_aware_mpi"_a=false, "no_splash"_a=false, "comm_ptr"_a=0,
+            "rank_placement"_a="cartesian", R"(
                 Create the YMeRo coordinator.
                 
                 .. warning::
@@ -73,8 +86,51 @@ void exportYmero(py::module& m)
                     cuda_aware_mpi: enable CUDA Aware MPI. The MPI library must support that feature, otherwise it may fail.
                     no_splash: don't display the splash screen when at the start-up.
                     comm_ptr: pointer to communicator. By default MPI_COMM_WORLD will be used
+                    rank_placement: how the simulation tasks are placed on the grid of subdomains:
+
+                        * **cartesian**: in the order of the ranks of the communicator (default)
+                        * **node**: the tasks of each node take a compact block of subdomains, such that most of the halo exchanges stay within the nodes.
+                          Requires the same number of tasks on all the nodes, the default placement is used otherwise.
         )")
         
+        .def_static("choose_rank_grid", [] (int nranks, PyTypes::float3 domain, float rc,
+                                            std::vector<float> load, PyTypes::int3 loadResolution, PyTypes::int3 fixed) {
+
+                const auto choice = chooseRankGrid(nranks, make_float3(domain), rc, load,
+                                                   make_int3(loadResolution), make_int3(fixed));
+                py::dict result;
+                result["nranks"]        = PyTypes::int3 {choice.nranks3D.x, choice.nranks3D.y, choice.nranks3D.z};
+                result["max_work"]      = choice.maxWork;
+                result["mean_work"]     = choice.meanWork;
+                result["imbalance"]     = choice.maxWork / choice.meanWork;
+                result["halo_fraction"] = choice.haloFraction;
+                result["work"]          = choice.work;
+                return result;
+            },
+            "nranks"_a, "domain"_a, "rc"_a, "load"_a = std::vector<float>(), "load_resolution"_a = PyTypes::int3 {0, 0, 0},
+            "fixed"_a = PyTypes::int3 {0, 0, 0}, R"(
+            Choose the number of simulation tasks per axis to pass as ``nranks`` to the coordinator,
+            instead of picking the factorization of the number of tasks by hand.
+            Among all the factorizations of ``nranks``, the chosen one minimizes the estimated work of the most loaded task:
+            the particles in its subdomain and in its halo of width ``rc`` along the split axes.
+            Between equally loaded grids, the one with the smaller total halo is chosen.
+
+            Args:
+                nranks: total number of simulation tasks, without the postprocess tasks
+                domain: size of the simulation domain in x,y,z
+                rc: largest cutoff radius of the interactions
+                load: coarse estimate of the number density, or of the occupancy of the domain outside the walls,
+                    on a grid of ``load_resolution`` cells covering the domain, x index slowest. Uniform if empty
+                load_resolution: number of cells of ``load`` per axis
+                fixed: imposed number of tasks per axis, free if 0
+
+            Returns:
+                a dictionary with the chosen ``nranks``, the predicted ``work`` of every task (number of particles
+                including the halo, x index slowest), its ``max_work``, ``mean_work`` and ``imbalance`` and
+                the ``halo_fraction``, volume of the halo relative to the subdomain.
+                Meant to be logged by the script before creating the coordinator.
+        )")
+
         .def("registerParticleVector", &YMeRo::registerParticleVector,
             "pv"_a, "ic"_a=nullptr, "checkpoint_every"_a=0, R"(
             Register particle vector
@@ -119,11 +175,13 @@ void exportYmero(py::module& m)
         .def("getState",       &YMeRo::getYmrState,    "Return ymero state")
         
         .def("dumpWalls2XDMF",    &YMeRo::dumpWalls2XDMF,
-            "walls"_a, "h"_a, "filename"_a="xdmf/wall", R"(
+            "walls"_a, "h"_a, "filename"_a="xdmf/wall", "surface"_a=false, R"(
                 Write Signed Distance Function for the intersection of the provided walls (negative values are the 'inside' of the simulation)
                 
                 Args:
                     h: cell-size of the resulting grid                    
+                    surface: instead of the SDF on the grid, write the surface of the walls (zero level of the SDF)
+                        as a triangle mesh, extracted on the GPU by marching cubes
         )")        
 
         .def("computeVolumeInsideWalls", &YMeRo::computeVolumeInsideWalls,
@@ -157,12 +215,14 @@ void exportYmero(py::module& m)
         )")
         
         .def("makeFrozenWallParticles", &YMeRo::makeFrozenWallParticles,
-             "pvName"_a, "walls"_a, "interactions"_a, "integrator"_a, "density"_a, "nsteps"_a=1000, R"(
+             "pvName"_a, "walls"_a, "interactions"_a, "integrator"_a, "density"_a, "nsteps"_a=1000,
+             "tile_size"_a = PyTypes::float3{0, 0, 0}, "tile_cache"_a = "", R"(
                 Create particles frozen inside the walls.
                 
                 .. note::
                     A separate simulation will be run for every call to this function, which may take certain amount of time.
-                    If you want to save time, consider using restarting mechanism instead
+                    If you want to save time, consider using restarting mechanism instead,
+                    or equilibrate a small periodic tile with **tile_size** and keep it in **tile_cache**
                 
                 Args:
                     pvName: name of the created particle vector
@@ -171,6 +231,11 @@ void exportYmero(py::module& m)
                     integrator: this :any:`Integrator` will be used to construct the equilibrium particles distribution
                     density: target particle density
                     nsteps: run this many steps to achieve equilibrium
+                    tile_size: if positive, only equilibrate a periodic box of this size on one rank,
+                        which is then repeated over the whole domain before keeping the particles close to the walls.
+                        Should be a few cut-off radii large
+                    tile_cache: if not empty, file where the equilibrated tile is saved and read back by next calls with the same **tile_size**,
+                        even for other geometries
                             
                 Returns:
                     New :any:`ParticleVector` that will contain particles that are close to the wall boundary, but still inside the wall.
@@ -193,6 +258,11 @@ void exportYmero(py::module& m)
                     integrator: this :any:`Integrator` will be used to construct the equilibrium particles distribution
                     density: target particle density
                     nsteps: run this many steps to achieve equilibrium
+                    tile_size: if positive, only equilibrate a periodic box of this size on one rank,
+                        which is then repeated over the whole domain before keeping the particles close to the walls.
+                        Should be a few cut-off radii large
+                    tile_cache: if not empty, file where the equilibrated tile is saved and read back by next calls with the same **tile_size**,
+                        even for other geometries
                             
                 Returns:
                     New :any:`ParticleVector` that will contain particles that are close to the wall boundary, but still inside the wall.
@@ -217,6 +287,16 @@ void exportYmero(py::module& m)
         .def("isMasterTask",  &YMeRo::isMasterTask,  "Returns whether current task is the very first one")
         .def("start_profiler", &YMeRo::startProfiler, "Tells nvprof to start recording timeline")
         .def("stop_profiler",  &YMeRo::stopProfiler,  "Tells nvprof to stop recording timeline")
+        .def("set_nvtx_ranges", &YMeRo::setNvtxRanges, "enabled"_a = true, R"(
+             Push a named NVTX range around every task of the time-step, every phase of the MPI exchanges
+             (pack, send, wait, unpack) and every plugin hook, such that the Nsight Systems timeline shows
+             which task launched which kernels. The ranges are colored by category:
+             forces (green), halo and redistribution exchanges (blue), bounces (orange), plugins (purple),
+             integration (red), others (grey).
+
+             Args:
+                 enabled: whether to push the ranges
+         )")
         .def("save_dependency_graph_graphml",  &YMeRo::saveDependencyGraph_GraphML,
              "fname"_a, "current"_a = true, R"(
              Exports `GraphML <http://graphml.graphdrawing.org/>`_ file with task graph for the current simulation time-step
@@ -228,5 +308,694 @@ void exportYmero(py::module& m)
              .. warning::
                  if current is set to True, this must be called **after** :py:meth:`_ymero.ymero.run`.
          )")
-        .def("run", &YMeRo::run, "Run the simulation");
+        .def("set_task_graph_capture", &YMeRo::setTaskGraphCapture,
+             "enabled"_a = true, R"(
+             Replay the simple GPU-only tasks of every time-step (clearing and accumulating the channels)
+             from CUDA graphs instead of launching every kernel from the host. This reduces the launch overhead for small subdomains.
+             A new graph per task is captured whenever the particle buffers are reallocated or the particle numbers change.
+
+             Args:
+                 enabled: whether to use the CUDA graphs
+
+             .. note::
+                 Requires CUDA 10.1 or later; must be called **before** :py:meth:`_ymero.ymero.run`.
+         )")
+        .def("start_task_profiling", &YMeRo::startTaskProfiling,
+             "nsteps"_a = 100, "fname"_a = "tasks_profile", R"(
+             Time every task of the time-step with CUDA events during the next **nsteps** time-steps.
+             When done, a text report with per-task timings, stream assignment, waiting times and critical path is
+             written to **fname**.txt, the same timings as JSON to **fname**.json,
+             and the task graph annotated with the same data to **fname**.graphml.
+             Only the first simulation rank writes the files, but every rank prints its report to the log.
+
+             Args:
+                 nsteps: number of time-steps to profile
+                 fname: the output filename (without extension)
+         )")
+        .def("set_task_scheduling_policy", &YMeRo::setTaskSchedulingPolicy,
+             "policy"_a, "profile_steps"_a = 50, R"(
+             Choose how the ready tasks of the time-step are ordered.
+
+             Args:
+                 policy: one of
+
+                     * **priority**: the default; tasks with high priority go first
+                     * **critical_path**: the tasks are first profiled during **profile_steps** time-steps,
+                       then the tasks with the longest measured path to the end of the time-step go first.
+                       Tasks that post MPI requests (halo, reverse and redistribution exchanges) are always started
+                       as soon as they are ready, so that the communication is hidden behind the computations
+
+                 profile_steps: number of profiled time-steps before the critical_path policy is used
+         )")
+        .def("set_cell_list_ordering", &YMeRo::setCellListOrdering,
+             "pv"_a, "ordering"_a = "morton", R"(
+             Choose the order in which the cells of the cell-lists of a Particle Vector are stored.
+             The particles of Particle Vectors with primary cell-lists are stored in the same order.
+
+             Args:
+                 pv: the Particle Vector
+                 ordering: one of
+
+                     * **row_major**: the default; x is the fastest index, then y and z
+                     * **morton**: cells follow the Z-order curve, which improves the cache locality of the
+                       neighbouring cells on large subdomains
+
+             .. note::
+                 Must be called **before** :py:meth:`_ymero.ymero.run`.
+         )")
+        .def("set_cell_list_incremental", &YMeRo::setCellListIncremental,
+             "pv"_a, "max_moved_fraction"_a = 0.1, R"(
+             Build the cell-lists of a Particle Vector from their previous build: the particles still in the cell
+             they had at the previous build keep their relative order at the start of their cell, the others are
+             appended to their cells. Between two time-steps few particles change cell, the build then takes few
+             atomics and the particles and their channels only move by a few slots.
+             The order of the particles within a cell depends on their history.
+
+             Args:
+                 pv: the Particle Vector
+                 max_moved_fraction: when more particles than that fraction changed cell in a build,
+                     the next builds are done from scratch with the method of
+                     :py:meth:`_ymero.ymero.set_cell_list_build`, before trying again; 0 disables the incremental builds
+
+             .. note::
+                 Must be called **before** :py:meth:`_ymero.ymero.run`.
+         )")
+        .def("set_cell_list_build", &YMeRo::setCellListBuild,
+             "pv"_a, "method"_a = "auto", R"(
+             Choose how the particles of a Particle Vector are sorted by cell when its cell-lists are built.
+
+             Args:
+                 pv: the Particle Vector
+                 method: one of
+
+                     * **atomics**: the default; the particles are counted per cell with atomics and scattered
+                       to their cells. The order of the particles within a cell varies from a run to another
+                     * **radix_sort**: radix sort of the particles by cell id, without atomics.
+                       The sort is stable, the particles of a cell keep their relative order
+                     * **auto**: time both methods on the first builds and keep the faster one;
+                       the choice is made again when the number of particles changes by more than a factor of 2
+
+             .. note::
+                 Must be called **before** :py:meth:`_ymero.ymero.run`.
+         )")
+        .def("set_object_reordering", &YMeRo::setObjectReordering,
+             "ov"_a, "every"_a = 1000, R"(
+             Periodically sort the local objects of an Object Vector along the Morton curve of their centers of mass,
+             right after their redistribution. Otherwise the objects keep the order in which they were
+             inserted or received, and objects consecutive in memory end up scattered over the subdomain,
+             which hurts the locality of the bounce, the belonging checks and the packing of the halo objects.
+             All the per-particle and per-object channels are permuted, global ids of the objects included.
+
+             Args:
+                 ov: the Object Vector
+                 every: reorder every this many time-steps
+
+             .. note::
+                 Must be called **before** :py:meth:`_ymero.ymero.run`.
+         )")
+        .def("set_kernel_autotuning", &YMeRo::setKernelAutotuning,
+             "nsamples"_a = 5, "fname"_a = "kernels.tuning", R"(
+             Choose the kernel variants and block sizes of the pairwise interactions by timing them.
+             For every interaction, pair of Particle Vectors, local or halo part and order of magnitude of the number
+             of particles, each candidate is timed **nsamples** times during the first time-steps and the fastest one is used afterwards.
+             The results are stored in **fname** together with the GPU model, and reused without tuning by later runs on the same GPU model.
+
+             Args:
+                 nsamples: number of timings per candidate
+                 fname: file with the tuned configurations
+
+             .. note::
+                 Must be called **before** :py:meth:`_ymero.ymero.run`.
+         )")
+        .def("set_persistent_size_requests", &YMeRo::setPersistentSizeRequests, "enabled"_a = true, R"(
+             Exchange the sizes of the halo and redistribution messages with persistent MPI requests,
+             created once instead of one MPI_Irecv and MPI_Send per neighbour, exchanger and time-step.
+             This saves the setup cost of the small messages on networks where it is high.
+             Has no effect when running on a single rank.
+
+             Args:
+                 enabled: whether to use persistent requests
+
+             .. note::
+                 Must be called **before** :py:meth:`_ymero.ymero.run`.
+         )")
+        .def("set_aggregated_exchanges", &YMeRo::setAggregatedExchanges, "enabled"_a = true, R"(
+             Send one message per neighbouring rank for all the Particle Vectors of each halo or redistribution exchange,
+             instead of one per Particle Vector. The data are gathered into a contiguous buffer on the GPU
+             and scattered back on the receiving side.
+             Takes precedence over :py:meth:`set_persistent_size_requests`. Has no effect when running on a single rank.
+
+             Args:
+                 enabled: whether to aggregate the messages
+
+             .. note::
+                 Must be called **before** :py:meth:`_ymero.ymero.run`.
+         )")
+        .def("set_intranode_ipc_exchanges", &YMeRo::setIntraNodeIPCExchanges, "enabled"_a = true, R"(
+             Copy the halo and redistribution data to the neighbouring ranks of the same node directly from GPU to GPU
+             with CUDA IPC, instead of going through MPI. Requires peer access between the GPUs of the neighbours,
+             other neighbours are still exchanged with MPI. The sizes of the messages always go through MPI.
+             Ignored if :py:meth:`set_aggregated_exchanges` is enabled. Has no effect when running on a single rank.
+
+             Args:
+                 enabled: whether to use CUDA IPC within the nodes
+
+             .. note::
+                 Must be called **before** :py:meth:`_ymero.ymero.run`.
+         )")
+        .def("set_neighbor_collective_exchanges", &YMeRo::setNeighborCollectiveExchanges, "enabled"_a = true, R"(
+             Exchange the halos and redistributions with the MPI neighbourhood collectives over a graph of the neighbouring ranks:
+             one collective for the sizes of all the Particle Vectors, then one non-blocking collective per Particle Vector for the data.
+             The environment variable ``YMERO_NEIGHBOR_COLLECTIVES`` overrides this setting: ``0`` disables them, any other value enables them.
+             Ignored if :py:meth:`set_aggregated_exchanges` is enabled, takes precedence over :py:meth:`set_intranode_ipc_exchanges`.
+             Has no effect when running on a single rank.
+
+             Args:
+                 enabled: whether to use the neighbourhood collectives
+
+             .. note::
+                 Must be called **before** :py:meth:`_ymero.ymero.run`.
+         )")
+        .def("set_speculative_halo_packing", &YMeRo::setSpeculativeHaloPacking, "enabled"_a = true, R"(
+             Pack the halo particles while counting them, into slots of the send buffers sized from the largest halos seen so far.
+             The host then waits for the GPU once per halo exchange instead of twice, and the cell-lists are traversed once.
+             If a halo grows beyond its slot, the particles are packed again and the slot is enlarged.
+             Has no effect when running on a single rank.
+
+             Args:
+                 enabled: whether to pack the halos speculatively
+
+             .. note::
+                 Must be called **before** :py:meth:`_ymero.ymero.run`.
+         )")
+        .def("set_sorted_halos", &YMeRo::setSortedHalos, "enabled"_a = true, R"(
+             Sort the received halo particles by the cell of the local cell-list they are next to,
+             such that the neighbouring threads of the halo interaction kernels go through the same cells.
+             Costs one sort and one more unpacking of the halo per exchange.
+             The interactions do not depend on the order of the halo particles, up to round-off.
+
+             Args:
+                 enabled: whether to sort the halos
+
+             .. note::
+                 Must be called **before** :py:meth:`_ymero.ymero.run`.
+         )")
+        .def("set_sparse_reverse_forces", &YMeRo::setSparseReverseForces, "enabled"_a = true, R"(
+             Send back to their owners only the nonzero forces of the halo objects, with the index of their particle:
+             the objects barely crossing a face of the subdomain get forces on a few of their particles only.
+             The fragments where more than half of the forces are nonzero are sent dense as before.
+             Only for the object vectors sending back the forces of their particles and no other channel,
+             i.e. neither rigid objects nor surface halos. Costs one synchronization per reverse exchange.
+
+             Args:
+                 enabled: whether to send the forces sparse
+
+             .. note::
+                 Must be called **before** :py:meth:`_ymero.ymero.run`.
+         )")
+        .def("set_halo_compression", &YMeRo::setHaloCompression, "final"_a = true, "intermediate"_a = true, R"(
+             Send the coordinates and velocities of the halo particles in 16 bytes instead of 32:
+             coordinates are quantized on 16 bits over the subdomain, velocities are sent in half precision.
+             This is lossy: the halo particles are off by up to about (subdomain size) / 131070 in each direction,
+             and their velocities carry a relative error of about 1e-3.
+             Extra channels of the halo and the forces sent back to the objects are exchanged without loss.
+             Has no effect when running on a single rank.
+
+             Args:
+                 final: compress the halo used by the final interactions (forces)
+                 intermediate: compress the halo used by the intermediate interactions (e.g. densities)
+
+             .. note::
+                 Must be called **before** :py:meth:`_ymero.ymero.run`.
+         )")
+        .def("set_batched_redistribution", &YMeRo::setBatchedRedistribution, "enabled"_a = true, R"(
+             Find and pack the particles leaving the subdomain for all the Particle Vectors at once,
+             with one kernel launch and one synchronization instead of one per Particle Vector.
+             Combine with :py:meth:`set_aggregated_exchanges` to also send one message per neighbouring rank.
+
+             Args:
+                 enabled: whether to batch the redistribution
+
+             .. note::
+                 Must be called **before** :py:meth:`_ymero.ymero.run`.
+         )")
+        .def("set_early_redistribution", &YMeRo::setEarlyRedistribution, "enabled"_a = true, R"(
+             Integrate the particles of the cells at the boundary of the subdomains first, such that the
+             redistribution packs and sends the leaving particles while the interior is integrated.
+             Only applies to the Particle Vectors integrated with velocity-Verlet that are neither bounced
+             nor corrected after the integration. It is disabled when plugins act after the integration,
+             or with the device monitor or the adaptive time-step.
+
+             Args:
+                 enabled: whether to start the redistribution early
+
+             .. note::
+                 Must be called **before** :py:meth:`_ymero.ymero.run`.
+         )")
+        .def("set_overlapped_cell_lists", &YMeRo::setOverlappedCellLists, "enabled"_a = true, R"(
+             Count the particles staying in the subdomain into the cell-lists while the redistribution messages are in flight,
+             such that the cell-lists of the next time-step only have to bin the received particles before reordering.
+             Only for the Particle Vectors that are not Object Vectors.
+             The particles must not be moved or removed between the redistribution and the cell-lists,
+             so plugins acting before the cell-lists (e.g. outlets) must not be used together with it.
+
+             Args:
+                 enabled: whether to overlap the binning with the redistribution
+
+             .. note::
+                 Must be called **before** :py:meth:`_ymero.ymero.run`.
+         )")
+        .def("set_fused_object_bounce", &YMeRo::setFusedObjectBounce, "enabled"_a = true, R"(
+             Bounce the particles from the local and the halo objects in a single pass, once the halo objects are received,
+             instead of bouncing from the local objects first and from the halo objects afterwards.
+             The mesh bouncers then find, filter and resolve all the collisions with one set of kernel launches and
+             one collision table, the earliest collision of every particle being chosen among all the objects.
+             The other bouncers still bounce from the local and then from the halo objects, within the same task.
+             The bounce of the local objects can then not overlap with the exchange of the halo objects:
+             this pays off when the bounce is dominated by the launches and the synchronizations, i.e. with few objects per rank.
+
+             Args:
+                 enabled: whether to bounce from the local and the halo objects together
+
+             .. note::
+                 Must be called **before** :py:meth:`_ymero.ymero.run`.
+         )")
+        .def("set_exchange_chunk_size", &YMeRo::setExchangeChunkSize, "bytes"_a, R"(
+             Split the data sent to every neighbouring rank into messages of at most that many bytes.
+             Without CUDA-aware MPI, the chunks of large buffers are then copied to the host and sent one after the other,
+             so that the copies overlap with the transfer, and uploaded to the GPU as soon as they are received.
+             Only applies to the default MPI exchanges, i.e. not with :py:meth:`set_aggregated_exchanges` or :py:meth:`set_intranode_ipc_exchanges`.
+
+             Args:
+                 bytes: maximum size of a message, no limit if 0 (default)
+
+             .. note::
+                 Must be called **before** :py:meth:`_ymero.ymero.run`.
+         )")
+        .def("set_virtual_periodic_images", &YMeRo::setVirtualPeriodicImages, "enabled"_a = true, R"(
+             On a single rank, compute the pairwise interactions across the periodic boundaries directly from the local cell-lists:
+             the neighbouring cells beyond the boundary are the cells of the opposite side, with shifted coordinates.
+             The Particle Vectors whose interactions all support it then have no halo at all, which saves the packing and the copies;
+             the Object Vectors keep their halos for the bouncers and belonging checkers, but get no halo forces from these interactions.
+             Takes precedence over the neighbor lists, the tiled kernels and the compressed storage of these interactions.
+             Needs at least 3 cells per dimension. Has no effect when running on several ranks.
+
+             Args:
+                 enabled: whether to use the periodic images
+
+             .. note::
+                 Must be called **before** :py:meth:`_ymero.ymero.run`.
+         )")
+        .def("set_lazy_redistribution", &YMeRo::setLazyRedistribution, "skin"_a, R"(
+             Defer the redistribution of the particles: they may stay up to **skin** / 2 outside of the subdomain of their rank.
+             The boundary cells are checked on the GPU every time-step and all the ranks redistribute as soon as one particle went further.
+             The cell-lists are built with cells larger than the cut-offs by **skin** / 2, such that the halos still contain all the neighbours;
+             the integrators then do not bin the particles while moving them.
+             Mostly useful for slow flows, where the particles rarely leave their subdomain.
+
+             Args:
+                 skin: twice the distance the particles may go outside of the subdomain, 0 to redistribute every time-step (default)
+
+             .. note::
+                 Must be called **before** :py:meth:`_ymero.ymero.run`.
+         )")
+        .def("set_device_monitor", &YMeRo::setDeviceMonitor, "every"_a = 1, "max_displacement"_a = 0.0f, R"(
+             Check the particles on the GPU for non-finite forces and for displacements larger than **max_displacement** within one time-step.
+             The checks only set counters in mapped host memory, polled by the host without waiting for the GPU,
+             such that they do not slow the time-steps down and may run every time-step.
+             The simulation aborts a few time-steps after a failed check at most.
+             The wall checks of :py:meth:`registerWall` report their particles inside the walls the same way.
+
+             Args:
+                 every: check every this many time-steps, never if 0
+                 max_displacement: largest distance a particle may travel in one time-step, not checked if not positive
+
+             .. note::
+                 Must be called **before** :py:meth:`_ymero.ymero.run`.
+         )")
+        .def("set_background_wall_setup", &YMeRo::setBackgroundWallSetup, "enabled"_a = true, R"(
+             Read the SDF files of the walls registered from now on, and restart them, on a helper thread with its own communicator:
+             the script goes on meanwhile, e.g. with the generation of the initial conditions.
+             The walls are waited for when they are first needed, at the latest by :py:meth:`_ymero.ymero.run`.
+             Requires an MPI library providing ``MPI_THREAD_MULTIPLE``, otherwise the walls are set up when registered.
+             The duration of every setup phase of the first :py:meth:`_ymero.ymero.run` is logged in any case.
+
+             Args:
+                 enabled: whether to set the walls up in the background
+
+             .. note::
+                 Must be called **before** :py:meth:`registerWall`, on all the ranks.
+         )")
+        .def("set_adaptive_time_step", &YMeRo::setAdaptiveTimeStep,
+             "dt_min"_a, "dt_max"_a, "max_displacement"_a, "max_growth"_a = 1.1f, R"(
+             Adapt the time-step after every time-step instead of keeping the one given to the coordinator.
+             The largest velocity and acceleration of all the particles are reduced on the GPU after the integration
+             and over the ranks once the time-step is complete. The next time-step is the largest one with which
+             no particle travels further than **max_displacement**, neither by its velocity nor by its acceleration,
+             within the bounds. The random forces of the DPD-like interactions follow the time-step.
+
+             Args:
+                 dt_min: smallest time-step, used with a warning if the particles would need a smaller one
+                 dt_max: largest time-step
+                 max_displacement: largest distance a particle may travel in one time-step
+                 max_growth: largest factor by which the time-step grows from one time-step to the next
+
+             .. note::
+                 Must be called **before** :py:meth:`_ymero.ymero.run`.
+         )")
+        .def("set_adaptive_transport", &YMeRo::setAdaptiveTransport, "enabled"_a = true, R"(
+             With CUDA-aware MPI, choose for every message whether it is sent straight from the GPU or staged through the host,
+             depending on its size and whether the neighbouring rank is on the same node.
+             The latencies of both transports are measured during a few exchanges every 1000 exchanges, and the fastest one is used in between.
+             Only applies to the default MPI exchanges, i.e. not with :py:meth:`set_aggregated_exchanges`,
+             :py:meth:`set_neighbor_collective_exchanges` or :py:meth:`set_intranode_ipc_exchanges`.
+
+             Args:
+                 enabled: whether to choose the transport adaptively
+
+             .. note::
+                 Must be called **before** :py:meth:`_ymero.ymero.run`.
+         )")
+        .def("set_async_checkpoints", &YMeRo::setAsyncCheckpoints, "enabled"_a = true, R"(
+             Write the checkpoint files of the Particle Vectors from a background thread.
+             The data is copied to the host at the checkpoint time-step and the simulation proceeds while it is written;
+             the next checkpoint and the end of :py:meth:`_ymero.ymero.run` wait until the previous one is on the disk.
+             Requires an MPI library providing ``MPI_THREAD_MULTIPLE``, otherwise the checkpoints are written synchronously.
+
+             Args:
+                 enabled: whether to write the checkpoints asynchronously
+
+             .. note::
+                 Must be called **before** :py:meth:`_ymero.ymero.run`.
+         )")
+        .def("set_checkpoint_compression", &YMeRo::setCheckpointCompression, "compression"_a, R"(
+             Compress the HDF5 checkpoint files of the Particle Vectors.
+             Restarting from compressed files is transparent; ZFP requires the H5Z-ZFP plugin to be found by HDF5 for both.
+
+             Args:
+                 compression: one of 'none' (default), 'deflate[:level]' (level from 1 to 9) or 'zfp[:tolerance]' (lossy, absolute tolerance, floating point channels only)
+
+             .. note::
+                 Must be called **before** :py:meth:`_ymero.ymero.run`.
+         )")
+        .def("set_incremental_checkpoints", &YMeRo::setIncrementalCheckpoints, "enabled"_a = true, R"(
+             Do not write again the checkpoint files of the Particle Vectors whose data did not change since the previous checkpoint,
+             e.g. frozen wall particles. The changes are detected with a hash of the local data on every rank.
+             The file ``_checkpoint.manifest`` of the checkpoint folder lists the version of every file, which restarts follow.
+
+             Args:
+                 enabled: whether to skip the unchanged files
+
+             .. note::
+                 Must be called **before** :py:meth:`_ymero.ymero.run`.
+         )")
+        .def("set_checkpoint_staging", &YMeRo::setCheckpointStaging, "folder"_a, R"(
+             Write the checkpoint files of the Particle Vectors first into a node-local folder, e.g. on a local NVMe disk,
+             one file per rank in ``<folder>/rankNNNNN/``, then copy the checkpoint to the checkpoint folder
+             (in the background with :py:meth:`set_async_checkpoints`).
+             The file ``_checkpoint.staging`` of the checkpoint folder refers to the last staged checkpoint:
+             restarts read the staged files when every rank finds them in its local folder, e.g. on the same nodes,
+             and the checkpoint folder otherwise.
+
+             Args:
+                 folder: node-local folder, an empty string disables the staging
+
+             .. note::
+                 Must be called **before** :py:meth:`_ymero.ymero.run`.
+         )")
+        .def("set_raw_checkpoints", &YMeRo::setRawCheckpoints, "enabled"_a = true, R"(
+             Write the checkpoints of the Particle Vectors (not the Object Vectors) as raw binary files
+             read and written directly between the GPU and the disk, with GPUDirect Storage if YMeRo was built with cuFile
+             and the file system supports it. A small ``<name>.raw.json`` manifest describes every file.
+             Restarts take the raw checkpoint when there is one, they must run on the same domain and the same number of ranks.
+
+             Args:
+                 enabled: whether to write raw checkpoints
+
+             .. note::
+                 Must be called **before** :py:meth:`_ymero.ymero.run`.
+         )")
+        .def("set_preemption_checkpoint", &YMeRo::setPreemptionCheckpoint, "folder"_a, "signal"_a = 15, R"(
+             Stop the run with a minimal checkpoint when the job receives a preemption notice, **signal** (SIGTERM by default),
+             instead of being killed; all the ranks, postprocess included, catch the signal from now on.
+             The ranks agree on the notice at the end of a time-step through a non-blocking reduction, such that the
+             checkpoint is written one step after the last rank got the signal. Only the simulation state,
+             the Particle Vectors and the Object Vectors are written, the Particle Vectors as raw checkpoints
+             (see :py:meth:`set_raw_checkpoints`); bouncers, integrators, interactions, walls and plugins are skipped.
+             :py:meth:`run` then returns, the script should check :py:meth:`is_preempted` and exit.
+             The folder may be node-local storage, it must then be copied before the node is released.
+             A restart from it must run on the same domain and the same number of ranks.
+
+             Args:
+                 folder: where to write the checkpoint
+                 signal: number of the signal of the notice
+
+             .. note::
+                 Must be called **before** :py:meth:`_ymero.ymero.run`.
+         )")
+        .def("set_adaptive_checkpoints", &YMeRo::setAdaptiveCheckpoints, "mtbf"_a = 0.0, "wall_time_limit"_a = 0.0, R"(
+             Choose the steps of the checkpoints during the run instead of every **checkpoint_every** steps, which must then be 0.
+             The cost of the checkpoints and of the time-steps is measured on all the ranks, the slowest one counts.
+             The interval is Daly's estimate of the optimum :math:`\sqrt{2 C M} - C` for a checkpoint cost :math:`C`
+             and a mean time between failures :math:`M`, it is updated after every checkpoint and every 1000 steps.
+             The first checkpoint, which gives the first cost, is written after 100 steps.
+             With a wall-time limit, a checkpoint is also written such that it completes before the limit
+             with a margin of one checkpoint cost. The checkpoints go into the folder given to the coordinator.
+
+             Args:
+                 mtbf: mean time between failures in seconds, 0 to only checkpoint before the wall-time limit
+                 wall_time_limit: seconds from this call after which the job is killed, 0 for none
+
+             .. note::
+                 Must be called **before** :py:meth:`_ymero.ymero.run`.
+         )")
+        .def("is_preempted", &YMeRo::isPreempted, R"(
+             Returns:
+                 whether the last :py:meth:`run` stopped early on a preemption notice, see :py:meth:`set_preemption_checkpoint`
+         )")
+        .def("set_host_workers", &YMeRo::setHostWorkers, "threads"_a = 1, R"(
+             Run the tasks of the time-step that wait for MPI messages (the finalization of the halo exchanges and redistributions)
+             on helper threads, such that the main thread keeps launching the independent kernels meanwhile, e.g. the local forces.
+             Requires an MPI library providing ``MPI_THREAD_MULTIPLE``, otherwise all the tasks are launched from the main thread.
+
+             Args:
+                 threads: number of helper threads, 0 to launch everything from the main thread
+
+             .. note::
+                 Must be called **before** :py:meth:`_ymero.ymero.run`.
+         )")
+        .def("set_persistent_step_mode", &YMeRo::setPersistentStepMode, "steps_per_launch"_a = 100, R"(
+             Experimental: advance the particles by several time-steps per kernel launch, for the tiny subdomains
+             where a step is dominated by the launch overheads of the short kernels. One cooperative kernel bins the particles,
+             computes the DPD forces and integrates them at every step, with grid-wide synchronizations between these phases;
+             the task graph, and hence every other feature, is not executed.
+
+             Only a single rank with a single particle vector is supported, interacting with itself and its periodic images through a DPD
+             interaction with ``counter_rng=True``, integrated with velocity-Verlet without forcing,
+             without walls, bouncers, plugins, checkpoints or adaptive time step. The setup dies otherwise.
+
+             Args:
+                 steps_per_launch: time-steps per kernel launch, the host checks for preemption in between; 0 to run the task graph
+
+             .. note::
+                 Must be called **before** :py:meth:`_ymero.ymero.run`.
+         )")
+        .def("set_plugin_cost_report", &YMeRo::setPluginCostReport, "every"_a = 1000, R"(
+             Time every hook of every simulation plugin, on the host and on the device, and log the time of every plugin
+             as a fraction of the wall time of the steps, on the slowest rank. The postprocess side logs the time spent
+             executing the messages of every plugin at the end of the run.
+
+             Args:
+                 every: report period in steps, 0 to not measure the plugins
+
+             .. note::
+                 Must be called **before** :py:meth:`_ymero.ymero.run`.
+         )")
+        .def("set_plugin_budget", &YMeRo::setPluginBudget, "plugin"_a, "budget"_a, R"(
+             Limit the time a diagnostic plugin takes: at every report of :py:meth:`set_plugin_cost_report`, which must be enabled,
+             a plugin above its budget runs half as often. The steps are split in periods of the longest period of the hooks
+             of the plugin (e.g. its dump period), and the plugin runs one period out of 1, 2, 4, ...: its hooks are skipped
+             in the other ones. The plugin runs twice as often again when it falls under half of its budget. The adjustments are logged.
+             Only meant for the diagnostics, the plugins acting on the particles would change the physics.
+
+             Args:
+                 plugin: name of the simulation plugin
+                 budget: largest fraction of the step time, in [0, 1); 0 for no limit
+
+             .. note::
+                 Must be called **before** :py:meth:`_ymero.ymero.run`.
+         )")
+        .def("set_replicas", &YMeRo::setReplicas, "replicas"_a, R"(
+             Host ``replicas`` independent copies of the simulation on the same ranks and GPUs, e.g. for parameter sweeps
+             of small domains that would each use a small part of a GPU. Every replica has its own state and objects,
+             the time-steps of all the replicas are executed together: the kernels of one replica fill the GPU while
+             the tasks of the others wait. Only available without postprocess ranks.
+
+             The replica 0 is the current simulation, the other ones checkpoint in ``replicaNNN/`` inside the checkpoint folder.
+             The objects are created within, and the registrations and settings apply to, the replica chosen by :py:meth:`select_replica`.
+
+             Args:
+                 replicas: total number of replicas, including the current simulation
+
+             .. note::
+                 Must be called **before** :py:meth:`_ymero.ymero.run`, before creating the objects of the other replicas.
+         )")
+        .def("select_replica", &YMeRo::selectReplica, "index"_a, R"(
+             Choose the replica that the newly created objects belong to and that the registrations and settings apply to,
+             see :py:meth:`set_replicas`.
+
+             Args:
+                 index: of the replica, from 0
+         )")
+        .def("set_batched_plugin_messages", &YMeRo::setBatchedPluginMessages, "enabled"_a = true, "inflight"_a = 4, R"(
+             Send the messages of all the plugins to the postprocess ranks in one batch per time-step, instead of one pair
+             of messages per plugin. Up to ``inflight`` batches are sent asynchronously, the simulation only waits
+             for the postprocess when it is that many batches behind.
+
+             Args:
+                 enabled: whether to batch the plugin messages
+                 inflight: maximum number of batches in flight
+
+             .. note::
+                 Must be called **before** :py:meth:`_ymero.ymero.run`, with the same arguments on all the ranks.
+         )")
+        .def("set_threaded_postprocess", &YMeRo::setThreadedPostprocess, "enabled"_a = true, R"(
+             Execute the postprocess side of every plugin on its own thread of the postprocess ranks,
+             such that the dumps of different plugins are deserialized and written concurrently.
+             The messages of one plugin are still executed in order.
+             Requires an MPI library providing ``MPI_THREAD_MULTIPLE``, otherwise the plugins run on the main thread.
+
+             Args:
+                 enabled: whether to use one thread per plugin
+
+             .. note::
+                 Must be called **before** :py:meth:`_ymero.ymero.run`, with the same arguments on all the ranks.
+         )")
+        .def("set_static_halo_channels", &YMeRo::setStaticHaloChannels, "ov"_a, "channel_names"_a, R"(
+             Declare per-object channels of an Object Vector that do not change while the objects are in the halo of a neighbouring rank,
+             e.g. reference or persistent data. They are then sent only when an object enters the halo
+             instead of at every halo exchange, and kept by the receiving rank meanwhile.
+             The channels must not be shifted between the ranks.
+
+             Args:
+                 ov: the Object Vector
+                 channel_names: names of the per-object channels
+
+             .. note::
+                 Must be called **before** :py:meth:`_ymero.ymero.run`.
+         )")
+        .def("set_surface_halo", &YMeRo::setSurfaceHalo, "ov"_a, "enabled"_a = true, R"(
+             Send to the neighbouring ranks only the particles of an Object Vector within the cut-off radius of the subdomain faces,
+             instead of the whole objects close to the faces. This reduces the halo of large objects interacting only through
+             their surface, e.g. contact-only suspensions with the object-aware LJ interaction:
+             the object of a halo particle is still known from its global id.
+             The forces on the sent particles are sent back as usual.
+
+             The Object Vector must not be used by bouncers, belonging checkers, intermediate interactions
+             or static halo channels, which all need the whole objects.
+
+             Args:
+                 ov: the Object Vector
+                 enabled: whether to send only the surface particles
+
+             .. note::
+                 Must be called **before** :py:meth:`_ymero.ymero.run`.
+         )")
+        .def("set_load_balance_report_period", &YMeRo::setLoadBalanceReportPeriod, "every"_a, R"(
+             Periodically log how unevenly the work is spread over the ranks, measured by the number of local and halo particles,
+             and where the planes between the subdomains would have to be along each axis to balance it.
+             The subdomains themselves are not moved.
+
+             Args:
+                 every: report every this many time-steps, never if 0
+         )")
+        .def("set_memory_pooling", &YMeRo::setMemoryPooling, "enabled"_a = true, R"(
+             Choose how the device and pinned host memory of all the buffers is allocated.
+             With pooling (default), memory released by the buffers is kept and reused by the later allocations,
+             such that growing buffers does not synchronize the GPU. Without pooling, every allocation goes directly to CUDA.
+
+             Args:
+                 enabled: whether to use pooling; disabling it releases all the cached memory
+         )")
+        .def("set_managed_memory", &YMeRo::setManagedMemory, "enabled"_a=true, R"(
+             Allocate the GPU buffers created from now on in managed (unified) memory, preferably located on the GPU.
+             This allows e.g. :py:meth:`makeFrozenWallParticles` or initial conditions over large domains
+             to temporarily use more memory than the GPU has, at the cost of page migrations.
+             The managed buffers are prefetched to the GPU at the start of every :py:meth:`run`.
+             Switch it off again after the setup phase, such that the buffers of the time-steps are plain device memory.
+
+             Args:
+                 enabled: whether to allocate managed memory
+         )")
+        .def("set_memory_report_period", &YMeRo::setMemoryReportPeriod, "every"_a, R"(
+             Periodically log the GPU memory held by every simulation object and channel of this rank,
+             together with the memory lost to the growth policy of the buffers.
+
+             Args:
+                 every: report every this many time-steps, 0 to disable
+         )")
+        .def("set_async_logging", &YMeRo::setAsyncLogging, "enabled"_a=true, "max_per_site_per_second"_a=0, R"(
+             Write the log from a background thread: the calling threads only format the messages into a ring buffer,
+             and the file is flushed every few seconds instead of after every message at high debug levels.
+             The number of messages of each logging statement may also be limited, such that frequent debug output
+             does not flood the file system.
+
+             Args:
+                 enabled: whether to write the log asynchronously
+                 max_per_site_per_second: only keep that many messages per second of every logging statement
+                     (errors are always kept), 0 to keep everything
+
+             .. note::
+                 The pending messages are lost if the process is killed by a signal
+         )")
+        .def("set_buffer_shrink_policy", &YMeRo::setBufferShrinkPolicy,
+             "steps"_a=0, "threshold"_a=0.5, "at_checkpoint"_a=false, R"(
+             Give back the memory of the particle, cell-list and exchange buffers that became much larger than needed.
+             Buffers never shrink by default, so a transient increase of the number of particles
+             (e.g. in the halo) keeps the memory allocated for the rest of the simulation.
+
+             Args:
+                 steps: shrink a buffer when its size stayed below **threshold** of its capacity for that many consecutive time-steps, never if 0
+                 threshold: fraction of the capacity, in (0, 1]
+                 at_checkpoint: also shrink all the buffers after every checkpoint
+         )")
+        .def("get_memory_usage", &YMeRo::getMemoryUsage, R"(
+             Returns:
+                 GPU memory usage of this rank in bytes, as a dictionary with the owners
+                 (usually "<simulation object name>:<channel>") as keys and "total" for all of them.
+                 Each value is a dictionary with:
+
+                 * **current**: memory held now
+                 * **peak**: largest memory held since the start
+                 * **capacity**: memory requested by the buffers
+                 * **size**: memory that actually holds data
+         )")
+        .def("set_perf_counters", &YMeRo::setPerfCounters, "enabled"_a = true, R"(
+             Count events relevant to the performance on this rank, see :any:`PerfCounters` for the list.
+             The counters are accumulated until read with :py:meth:`get_perf_counters`.
+
+             Args:
+                 enabled: whether to count
+         )")
+        .def("get_perf_counters", &YMeRo::getPerfCounters, "reset"_a = true, R"(
+             Args:
+                 reset: set all the counters to zero after reading them
+
+             Returns:
+                 performance counters of this rank accumulated since the last reset, as a dictionary
+         )")
+        .def("run", &YMeRo::run, "Run the simulation")
+        .def("run_async", &YMeRo::runAsync, "nsteps"_a, R"(
+             Start running **nsteps** time-steps on a native thread, without holding the GIL, and return right away.
+             Python can meanwhile analyze the data of the previous runs while the GPU advances;
+             the Python callbacks of the simulation, if any, take the GIL when they are called.
+
+             Args:
+                 nsteps: number of time-steps
+
+             Returns:
+                 an :py:class:`AsyncRun` handle, to be waited for before any other call to the coordinator
+
+             .. note:: Needs MPI initialized with at least ``MPI_THREAD_SERIALIZED``, as done by the coordinator itself
+         )");
 }
@@ -5,15 +5,19 @@
 #include <core/pvs/rigid_ellipsoid_object_vector.h>
 #include <core/pvs/views/reov.h>
 #include <core/rigid_kernels/bounce.h>
+#include <core/rigid_kernels/ellipsoid_shell.h>
 #include <core/rigid_kernels/integration.h>
 #include <core/utils/kernel_launch.h>
+#include <core/utils/make_unique.h>
 
 /**
  * Create the bouncer
  * @param name unique bouncer name
  */
 BounceFromRigidEllipsoid::BounceFromRigidEllipsoid(const YmrState *state, std::string name) :
-    Bouncer(state, name)
+    Bouncer(state, name),
+    localShell(std::make_unique<EllipsoidShell>()),
+    haloShell (std::make_unique<EllipsoidShell>())
 {}
 
 BounceFromRigidEllipsoid::~BounceFromRigidEllipsoid() = default;
@@ -35,8 +39,8 @@ std::vector<std::string> BounceFromRigidEllipsoid::getChannelsToBeExchanged() co
 }
 
 /**
- * Calls ObjectVector::findExtentAndCOM and then calls
- * bounceEllipsoid() function
+ * Collects the cells close to the ellipsoid surfaces with EllipsoidShell
+ * and then calls bounceEllipsoid() function on them
  */
 void BounceFromRigidEllipsoid::exec(ParticleVector *pv, CellList *cl, bool local, cudaStream_t stream)
 {
@@ -49,8 +53,6 @@ void BounceFromRigidEllipsoid::exec(ParticleVector *pv, CellList *cl, bool local
           local ? reov->local()->nObjects : reov->halo()->nObjects, reov->name.c_str(),
           local ? "local objs" : "halo objs");
 
-    ov->findExtentAndCOM(stream, local ? ParticleVectorType::Local : ParticleVectorType::Halo);
-
     REOVviewWithOldMotion ovView(reov, local ? reov->local() : reov->halo());
     PVviewWithOldParticles pvView(pv, pv->local());
 
@@ -63,10 +65,13 @@ void BounceFromRigidEllipsoid::exec(ParticleVector *pv, CellList *cl, bool local
                 ovView );
     }
 
+    auto shell = local ? localShell.get() : haloShell.get();
+    shell->build(ovView, ovView.old_motions, cl->cellInfo(), ellipsoidBounceMargin, false, stream);
+
     SAFE_KERNEL_LAUNCH(
             bounceEllipsoid,
-            ovView.nObjects, nthreads, 2*nthreads*sizeof(int), stream,
-            ovView, pvView, cl->cellInfo(), state->dt );
+            getNblocks(shell->size(), nthreads), nthreads, 0, stream,
+            ovView, pvView, shell->size(), shell->devPtr(), cl->cellInfo(), state->dt );
 }
 
 
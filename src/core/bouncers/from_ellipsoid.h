@@ -2,6 +2,10 @@
 
 #include "interface.h"
 
+#include <memory>
+
+class EllipsoidShell;
+
 /**
  * Implements bounce-back from the analytical ellipsoid shapes
  */
@@ -19,4 +23,7 @@ public:
 protected:
 
     void exec(ParticleVector *pv, CellList *cl, bool local, cudaStream_t stream) override;
+
+    /// candidate cells, local and halo objects may be bounced concurrently
+    std::unique_ptr<EllipsoidShell> localShell, haloShell;
 };
@@ -5,19 +5,41 @@
 #include <core/pvs/object_vector.h>
 #include <core/pvs/particle_vector.h>
 #include <core/pvs/views/ov.h>
+#include <core/pvs/views/rov.h>
 #include <core/rigid_kernels/integration.h>
 #include <core/utils/kernel_launch.h>
+#include <core/utils/perf_counters.h>
+
+#include <algorithm>
+#include <cmath>
+
+static BounceFromMesh::Broadphase parseBroadphase(const std::string& name)
+{
+    if (name == "auto")  return BounceFromMesh::Broadphase::Auto;
+    if (name == "cells") return BounceFromMesh::Broadphase::Cells;
+    if (name == "bvh")   return BounceFromMesh::Broadphase::BVH;
+
+    die("Unknown broadphase '%s' of the mesh bouncer, expected 'auto', 'cells' or 'bvh'", name.c_str());
+    return BounceFromMesh::Broadphase::Auto;
+}
 
 /**
  * Create the bouncer
  * @param name unique bouncer name
  * @param kbT temperature which will be used to create a particle
  * velocity after the bounce, @see performBouncing()
+ * @param broadphase how to find the candidate collisions: "cells", "bvh",
+ * or "auto" to choose every step, @see useBVH()
  */
-BounceFromMesh::BounceFromMesh(const YmrState *state, std::string name, float kbT) :
+BounceFromMesh::BounceFromMesh(const YmrState *state, std::string name, float kbT, std::string broadphase) :
     Bouncer(state, name),
-    kbT(kbT)
-{}
+    sizes("bounce:" + name),
+    kbT(kbT),
+    broadphase(parseBroadphase(broadphase))
+{
+    coarseSlot = sizes.add<int>();
+    fineSlot   = sizes.add<int>();
+}
 
 BounceFromMesh::~BounceFromMesh() = default;
 
@@ -55,34 +77,134 @@ std::vector<std::string> BounceFromMesh::getChannelsToBeExchanged() const
         return {ChannelNames::oldParts};
 }
 
+/**
+ * Rough comparison of the number of particle-triangle checks:
+ * the cells sweep visits about 8 cells per triangle,
+ * a BVH query walks about 2*log2(#triangles) nodes per particle.
+ */
+bool BounceFromMesh::useBVH(ParticleVector *pv, CellList *cl, int totalTriangles) const
+{
+    if (broadphase != Broadphase::Auto)
+        return broadphase == Broadphase::BVH;
+
+    const float nParticles = pv->local()->size();
+    const float cellsWork = 8.0f * totalTriangles * nParticles / cl->totcells;
+    const float bvhWork   = 2.0f * nParticles * log2f(totalTriangles + 1.0f);
+
+    return bvhWork < cellsWork;
+}
+
+/**
+ * Handle the sizes of the tables of the previous bounce, gathered asynchronously in the mailbox:
+ * the previous step is done by now, the mailbox is not waited for in practice
+ */
+void BounceFromMesh::checkTableSizes()
+{
+    if (!sizesPending) return;
+
+    sizes.wait();
+    sizesPending = false;
+
+    const int nCoarse = *sizes.hostPtr<int>(coarseSlot);
+    const int nFine   = *sizes.hostPtr<int>(fineSlot);
+
+    debug("Found %d triangle collision candidates and %d precise collisions in the last bounce", nCoarse, nFine);
+    PerfCounters::add("bounce candidates: " + name, nCoarse);
+    PerfCounters::add("bounce collisions: " + name, nFine);
+
+    if (nCoarse > usedCapacity)
+        die("Found too many triangle collision candidates (%d, the table holds %d), collisions were lost: "
+            "something may be broken", nCoarse, usedCapacity);
+
+    if (usedTriangles > 0)
+        maxCollisionsPerTri = std::max(maxCollisionsPerTri, (float)nCoarse / usedTriangles);
+}
+
+int BounceFromMesh::tableCapacity(int totalTriangles) const
+{
+    const float perTriangle = maxCollisionsPerTri < 0.0f ? coarseCollisionsPerTri : collisionsHeadroom * maxCollisionsPerTri;
+    return std::max(minCollisionsCapacity, (int)std::ceil(perTriangle * totalTriangles));
+}
+
+static LocalObjectVector* getLocalObjects(ObjectVector *ov, ParticleVectorType type)
+{
+    return type == ParticleVectorType::Local ? ov->local() : ov->halo();
+}
+
+static LocalRigidObjectVector* getLocalObjects(RigidObjectVector *rov, ParticleVectorType type)
+{
+    return type == ParticleVectorType::Local ? rov->local() : rov->halo();
+}
+
+void BounceFromMesh::prepareObjects(ParticleVectorType type, cudaStream_t stream)
+{
+    ov->findExtentAndCOM(stream, type);
+
+    // FIXME this is a hack
+    if (rov)
+        getLocalObjects(rov, type)->getMeshForces(stream)->clear(stream);
+}
+
 /**
  * Bounce particles from objects with meshes
  */
 void BounceFromMesh::exec(ParticleVector *pv, CellList *cl, bool local, cudaStream_t stream)
 {
-    auto activeOV = local ? ov->local() : ov->halo();
+    const auto type = local ? ParticleVectorType::Local : ParticleVectorType::Halo;
+    auto activeOV = getLocalObjects(ov, type);
 
     debug("Bouncing %d '%s' particles from %d '%s' objects (%s)",
           pv->local()->size(), pv->name.c_str(),
           activeOV->nObjects,  ov->name.c_str(),
           local ? "local" : "halo");
 
-    ov->findExtentAndCOM(stream, local ? ParticleVectorType::Local : ParticleVectorType::Halo);
+    prepareObjects(type, stream);
+
+    OVviewWithNewOldVertices vertexView(ov, activeOV, stream);
+    bounce(pv, cl, vertexView, {type}, stream);
+}
+
+/**
+ * Same as the local and then the halo exec(), but the collisions with both
+ * are found, filtered and resolved together: one set of launches, one table, one download per step.
+ * The earliest collision of a particle is also chosen among the local and the halo triangles together
+ */
+void BounceFromMesh::execLocalAndHalo(ParticleVector *pv, CellList *cl, cudaStream_t stream)
+{
+    debug("Bouncing %d '%s' particles from %d local and %d halo '%s' objects",
+          pv->local()->size(), pv->name.c_str(),
+          ov->local()->nObjects, ov->halo()->nObjects, ov->name.c_str());
 
-    int totalTriangles = ov->mesh->getNtriangles() * activeOV->nObjects;
+    prepareObjects(ParticleVectorType::Local, stream);
+    prepareObjects(ParticleVectorType::Halo,  stream);
+
+    OVviewLocalAndHalo vertexView(OVviewWithNewOldVertices(ov, ov->local(), stream),
+                                  OVviewWithNewOldVertices(ov, ov->halo(),  stream));
+
+    bounce(pv, cl, vertexView, {ParticleVectorType::Local, ParticleVectorType::Halo}, stream);
+}
+
+template <class VertexView>
+void BounceFromMesh::bounce(ParticleVector *pv, CellList *cl, VertexView vertexView,
+                            const std::vector<ParticleVectorType>& types, cudaStream_t stream)
+{
+    int totalTriangles = ov->mesh->getNtriangles() * vertexView.nObjects;
     //int totalEdges = totalTriangles * 3 / 2;
 
+    // the sizes of the previous bounce tell how large the tables must be
+    checkTableSizes();
+    const bool firstBounce = maxCollisionsPerTri < 0.0f;
+
     // Set maximum possible number of _coarse_ and _fine_ collisions with triangles
-    // In case of crash, the estimate should be increased
-    int maxCoarseCollisions = coarseCollisionsPerTri * totalTriangles;
+    // The fine ones are a subset of the coarse ones, they can not overflow
+    const int maxCollisions = tableCapacity(totalTriangles);
     coarseTable.nCollisions.clear(stream);
-    coarseTable.collisionTable.resize_anew(maxCoarseCollisions);
-    TriangleTable devCoarseTable { maxCoarseCollisions, coarseTable.nCollisions.devPtr(), coarseTable.collisionTable.devPtr() };
+    coarseTable.collisionTable.resize_anew(maxCollisions);
+    TriangleTable devCoarseTable { maxCollisions, coarseTable.nCollisions.devPtr(), coarseTable.collisionTable.devPtr() };
 
-    int maxFineCollisions = fineCollisionsPerTri * totalTriangles;
     fineTable.nCollisions.clear(stream);
-    fineTable.collisionTable.resize_anew(maxFineCollisions);
-    TriangleTable devFineTable { maxFineCollisions, fineTable.nCollisions.devPtr(), fineTable.collisionTable.devPtr() };
+    fineTable.collisionTable.resize_anew(maxCollisions);
+    TriangleTable devFineTable { maxCollisions, fineTable.nCollisions.devPtr(), fineTable.collisionTable.devPtr() };
 
     // Setup collision times array. For speed and simplicity initial time will be 0,
     // and after the collisions detected its i-th element will be t_i-1.0f, where 0 <= t_i <= 1
@@ -92,68 +214,115 @@ void BounceFromMesh::exec(ParticleVector *pv, CellList *cl, bool local, cudaStre
 
     int nthreads = 128;
 
-    // FIXME this is a hack
-    if (rov)
+    PVviewWithOldParticles pvView(pv, pv->local());
+
+    // Step 1, find all the candidate collisions
+    if (rov != nullptr && useBVH(pv, cl, totalTriangles))
     {
-        if (local)
-            rov->local()->getMeshForces(stream)->clear(stream);
-        else
-            rov->halo()-> getMeshForces(stream)->clear(stream);
+        // the rigid meshes only move, the hierarchy in their frame is built once
+        const auto& bodyBVH = ov->mesh->getBodyFrameBVH(stream);
+        const int maxObjectsPerGrid = 65535;
+
+        // one launch per set of objects, the ids of the later sets are shifted
+        int objIdOffset = 0;
+        for (auto type : types)
+        {
+            auto lrov = getLocalObjects(rov, type);
+            ROVviewWithOldMotion rovView(rov, lrov);
+            OVviewWithNewOldVertices lovView(ov, lrov, stream);
+
+            const dim3 nblocks(getNblocks(pvView.size, nthreads), std::min(lrov->nObjects, maxObjectsPerGrid));
+
+            SAFE_KERNEL_LAUNCH(
+                    findBouncesInBodyBVH,
+                    nblocks, nthreads, 0, stream,
+                    rovView, lovView, pvView, ov->mesh.get(), bodyBVH.getView(),
+                    ov->mesh->getBodyRadius(), objIdOffset, devCoarseTable );
+
+            objIdOffset += lrov->nObjects;
+        }
     }
+    else if (useBVH(pv, cl, totalTriangles))
+    {
+        SAFE_KERNEL_LAUNCH(
+                computeSweptTriangleBoxes,
+                getNblocks(totalTriangles, nthreads), nthreads, 0, stream,
+                vertexView, ov->mesh.get(), bvh.leafBoxes(totalTriangles) );
 
+        // halo objects stick out of the domain, the codes are clamped anyways
+        const float3 margin = make_float3(cl->rc);
+        bvh.build(-0.5f * state->domain.localSize - margin, 0.5f * state->domain.localSize + margin, stream);
 
-    OVviewWithNewOldVertices vertexView(ov, activeOV, stream);
-    PVviewWithOldParticles pvView(pv, pv->local());
+        SAFE_KERNEL_LAUNCH(
+                findBouncesInBVH,
+                getNblocks(pvView.size, nthreads), nthreads, 0, stream,
+                vertexView, pvView, ov->mesh.get(), bvh.getView(), devCoarseTable );
+    }
+    else
+    {
+        SAFE_KERNEL_LAUNCH(
+                findBouncesInMesh,
+                getNblocks(totalTriangles, nthreads), nthreads, 0, stream,
+                vertexView, pvView, ov->mesh.get(), cl->cellInfo(), devCoarseTable );
+    }
 
-    // Step 1, find all the candidate collisions
-    SAFE_KERNEL_LAUNCH(
-            findBouncesInMesh,
-            getNblocks(totalTriangles, nthreads), nthreads, 0, stream,
-            vertexView, pvView, ov->mesh.get(), cl->cellInfo(), devCoarseTable );
+    // without any history, the guess has to be checked before using the table
+    if (firstBounce)
+    {
+        coarseTable.nCollisions.downloadFromDevice(stream);
 
-    coarseTable.nCollisions.downloadFromDevice(stream);
-    debug("Found %d triangle collision candidates", coarseTable.nCollisions[0]);
+        if (coarseTable.nCollisions[0] > maxCollisions)
+            die("Found too many triangle collision candidates (%d),"
+                "something may be broken or you need to increase the estimate", coarseTable.nCollisions[0]);
+    }
 
-    if (coarseTable.nCollisions[0] > maxCoarseCollisions)
-        die("Found too many triangle collision candidates (%d),"
-            "something may be broken or you need to increase the estimate", coarseTable.nCollisions[0]);
+    // The following kernels read the number of collisions on the device,
+    // they are launched for the capacity of the tables with at most that many blocks
+    const int maxBlocks = 1024;
+    const int nblocks = std::min(getNblocks(maxCollisions, nthreads), maxBlocks);
 
     // Step 2, filter the candidates
     SAFE_KERNEL_LAUNCH(
             refineCollisions,
-            getNblocks(coarseTable.nCollisions[0], nthreads), nthreads, 0, stream,
+            nblocks, nthreads, 0, stream,
             vertexView, pvView, ov->mesh.get(),
-            coarseTable.nCollisions[0], devCoarseTable.indices,
+            devCoarseTable.total, maxCollisions, devCoarseTable.indices,
             devFineTable, collisionTimes.devPtr() );
 
-    fineTable.nCollisions.downloadFromDevice(stream);
-    debug("Found %d precise triangle collisions", fineTable.nCollisions[0]);
-
-    if (fineTable.nCollisions[0] > maxFineCollisions)
-        die("Found too many precise triangle collisions (%d),"
-            "something may be broken or you need to increase the estimate", fineTable.nCollisions[0]);
-
-
     // Step 3, resolve the collisions
     SAFE_KERNEL_LAUNCH(
-            performBouncingTriangle,
-            getNblocks(fineTable.nCollisions[0], nthreads), nthreads, 0, stream,
+            performBouncingTriangles,
+            nblocks, nthreads, 0, stream,
             vertexView, pvView, ov->mesh.get(),
-            fineTable.nCollisions[0], devFineTable.indices, collisionTimes.devPtr(),
+            devFineTable.total, maxCollisions, devFineTable.indices, collisionTimes.devPtr(),
             state->dt, kbT, drand48(), drand48() );
 
+    // checked at the next bounce
+    sizes.collect(coarseSlot, coarseTable.nCollisions.devPtr());
+    sizes.collect(fineSlot,   fineTable.  nCollisions.devPtr());
+    sizes.post(stream);
+    sizesPending  = true;
+    usedCapacity  = maxCollisions;
+    usedTriangles = totalTriangles;
+
     if (rov != nullptr)
     {
-        // make a fake view with vertices instead of particles
-        ROVview view(rov, local ? rov->local() : rov->halo());
-        view.objSize = ov->mesh->getNvertices();
-        view.size = view.nObjects * view.objSize;
-        view.particles = vertexView.vertices;
-        view.forces = vertexView.vertexForces;
+        for (auto type : types)
+        {
+            auto lrov = getLocalObjects(rov, type);
+            OVviewWithNewOldVertices lovView(ov, lrov, stream);
 
-        SAFE_KERNEL_LAUNCH(
-                RigidIntegrationKernels::collectRigidForces,
-                getNblocks(view.size, 128), 128, 0, stream,
-                view );
+            // make a fake view with vertices instead of particles
+            ROVview view(rov, lrov);
+            view.objSize = ov->mesh->getNvertices();
+            view.size = view.nObjects * view.objSize;
+            view.particles = lovView.vertices;
+            view.forces = lovView.vertexForces;
+
+            SAFE_KERNEL_LAUNCH(
+                    RigidIntegrationKernels::collectRigidForces,
+                    getNblocks(view.size, 128), 128, 0, stream,
+                    view );
+        }
     }
 }
@@ -3,6 +3,9 @@
 #include "interface.h"
 
 #include <core/containers.h>
+#include <core/mesh/bvh.h>
+#include <core/pvs/particle_vector.h>
+#include <core/utils/scalar_mailbox.h>
 
 class RigidObjectVector;
 
@@ -10,12 +13,30 @@ class RigidObjectVector;
 /**
  * Implements bounce-back from deformable mesh.
  * Mesh vertices must be the particles in the ParicleVector
+ *
+ * Candidate collisions are found either by sweeping the cells around every triangle
+ * (one thread per triangle), or by querying a BVH over the swept triangles
+ * with the segment of every particle (one thread per particle).
+ * The latter has much more even work per thread when the triangles are dense.
+ * For rigid objects the BVH is built once in the frame of the mesh, see Mesh::getBodyFrameBVH(),
+ * and the particles are brought to the frame of every nearby object instead.
+ *
+ * When both the local and the halo objects are bounced at once, see execLocalAndHalo(),
+ * the halo objects are numbered after the local ones and all the collisions go through
+ * the same tables, with a single pass of the pipeline.
+ *
+ * The host never waits for the sizes of the collision tables: the kernels after the broadphase
+ * read them on the device, and the sizes are downloaded asynchronously and checked at the next bounce.
+ * The tables are sized from the largest number of candidates per triangle seen so far, with some headroom;
+ * only the first bounce, without any such history, checks them synchronously.
  */
 class BounceFromMesh : public Bouncer
 {
 public:
 
-    BounceFromMesh(const YmrState *state, std::string name, float kbT);
+    enum class Broadphase { Auto, Cells, BVH };
+
+    BounceFromMesh(const YmrState *state, std::string name, float kbT, std::string broadphase = "auto");
     ~BounceFromMesh();
 
     std::vector<std::string> getChannelsToBeExchanged() const override;
@@ -29,19 +50,45 @@ private:
     };
 
     /**
-     * Maximum supported number of collisions per step
-     * will be #bouncesPerTri * total number of triangles in mesh
+     * Initial guess of the maximum number of candidate collisions per triangle and step,
+     * until the actual numbers are known.
+     * The precise collisions are a subset of the candidates, their table has the same capacity
      */
     const float coarseCollisionsPerTri = 5.0f;
-    const float fineCollisionsPerTri = 1.0f;
+
+    /// the tables can hold that many times the largest number of candidates per triangle seen so far
+    const float collisionsHeadroom = 2.0f;
+    const int minCollisionsCapacity = 1024;
 
     CollisionTableWrapper<int2> coarseTable, fineTable;
     DeviceBuffer<int> collisionTimes;
 
+    float maxCollisionsPerTri {-1.0f};  ///< largest number of candidates per triangle seen so far, < 0 if none yet
+    int usedCapacity {0};               ///< of the tables in the last bounce
+    int usedTriangles {0};              ///< number of triangles in the last bounce
+    ScalarMailbox sizes;                ///< numbers of candidates and collisions of the last bounce
+    int coarseSlot, fineSlot;
+    bool sizesPending {false};
+
+    void checkTableSizes();
+    int tableCapacity(int totalTriangles) const;
+
     float kbT;
+    Broadphase broadphase;
+    BoundingVolumeHierarchy bvh;
 
     RigidObjectVector *rov;
 
+    bool useBVH(ParticleVector *pv, CellList *cl, int totalTriangles) const;
+
+    void prepareObjects(ParticleVectorType type, cudaStream_t stream);
+
+    /// the pipeline over the objects of \p types, seen through \p vertexView
+    template <class VertexView>
+    void bounce(ParticleVector *pv, CellList *cl, VertexView vertexView,
+                const std::vector<ParticleVectorType>& types, cudaStream_t stream);
+
     void exec(ParticleVector *pv, CellList *cl, bool local, cudaStream_t stream) override;
+    void execLocalAndHalo(ParticleVector *pv, CellList *cl, cudaStream_t stream) override;
     void setup(ObjectVector *ov) override;
 };
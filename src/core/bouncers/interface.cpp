@@ -28,3 +28,14 @@ void Bouncer::bounceHalo(ParticleVector *pv, CellList *cl, cudaStream_t stream)
 {
     exec(pv, cl, false, stream);
 }
+
+void Bouncer::bounceLocalAndHalo(ParticleVector *pv, CellList *cl, cudaStream_t stream)
+{
+    execLocalAndHalo(pv, cl, stream);
+}
+
+void Bouncer::execLocalAndHalo(ParticleVector *pv, CellList *cl, cudaStream_t stream)
+{
+    exec(pv, cl, true,  stream);
+    exec(pv, cl, false, stream);
+}
@@ -44,6 +44,9 @@ public:
     /// Interface to the private exec function for halo objects
     void bounceHalo (ParticleVector *pv, CellList *cl, cudaStream_t stream);
 
+    /// Interface to the private execLocalAndHalo function, bounce from the local and the halo objects at once
+    void bounceLocalAndHalo(ParticleVector *pv, CellList *cl, cudaStream_t stream);
+
     /// return list of extra channel names to be exchanged
     virtual std::vector<std::string> getChannelsToBeExchanged() const = 0;
 
@@ -67,4 +70,12 @@ protected:
      * @param stream cuda stream on which to execute
      */
     virtual void exec (ParticleVector *pv, CellList *cl, bool local, cudaStream_t stream) = 0;
+
+    /**
+     * Bounce from the local and then from the halo objects, called from \c Simulation
+     * once the halo objects are received, instead of the two separate exec().
+     * Default: two calls to exec(); bouncers that can treat both sets of objects
+     * in one pass should override it
+     */
+    virtual void execLocalAndHalo(ParticleVector *pv, CellList *cl, cudaStream_t stream);
 };
@@ -4,10 +4,14 @@
 #include <core/utils/cuda_common.h>
 #include <core/celllist.h>
 #include <core/bounce_solver.h>
+#include <core/mesh/bvh.h>
 
 #include <core/utils/cuda_rng.h>
 
 #include <core/pvs/views/ov.h>
+#include <core/pvs/views/rov.h>
+#include <core/rigid_kernels/quaternion.h>
+#include <core/rigid_kernels/rigid_motion.h>
 
 struct Triangle
 {
@@ -30,6 +34,9 @@ struct CollisionTable
 
 using TriangleTable = CollisionTable<int2>;
 
+// About maximum distance a particle can cover in one step
+const float sweepTolerance = 0.2f;
+
 
 __device__ inline Triangle readTriangle(float4* particles, int3 trid)
 {
@@ -39,6 +46,55 @@ __device__ inline Triangle readTriangle(float4* particles, int3 trid)
         f4tof3( particles[2*trid.z] ) };
 }
 
+/**
+ * The local and the halo objects of an object vector seen as one set of objects,
+ * the halo objects numbered after the local ones.
+ * The collisions with both then go through one pipeline and one collision table
+ */
+struct OVviewLocalAndHalo
+{
+    OVviewWithNewOldVertices local, halo;
+    int nObjects;
+    float mass;
+
+    OVviewLocalAndHalo(OVviewWithNewOldVertices local, OVviewWithNewOldVertices halo) :
+        local(local), halo(halo),
+        nObjects(local.nObjects + halo.nObjects),
+        mass(local.mass)
+    {}
+};
+
+/// current and previous positions of triangle \p triangle of object \p objId
+__device__ inline void readSweptTriangle(const OVviewWithNewOldVertices& objView, const MeshView& mesh,
+                                         int objId, int3 triangle, Triangle& tr, Triangle& trOld)
+{
+    tr    = readTriangle(objView.vertices     + 2 * mesh.nvertices*objId, triangle);
+    trOld = readTriangle(objView.old_vertices + 2 * mesh.nvertices*objId, triangle);
+}
+
+__device__ inline void readSweptTriangle(const OVviewLocalAndHalo& objView, const MeshView& mesh,
+                                         int objId, int3 triangle, Triangle& tr, Triangle& trOld)
+{
+    if (objId < objView.local.nObjects)
+        readSweptTriangle(objView.local, mesh, objId, triangle, tr, trOld);
+    else
+        readSweptTriangle(objView.halo,  mesh, objId - objView.local.nObjects, triangle, tr, trOld);
+}
+
+/// forces of the vertices of object \p objId
+__device__ inline float4* objectVertexForces(const OVviewWithNewOldVertices& objView, const MeshView& mesh, int objId)
+{
+    return objView.vertexForces + mesh.nvertices*objId;
+}
+
+__device__ inline float4* objectVertexForces(const OVviewLocalAndHalo& objView, const MeshView& mesh, int objId)
+{
+    if (objId < objView.local.nObjects)
+        return objectVertexForces(objView.local, mesh, objId);
+    else
+        return objectVertexForces(objView.halo,  mesh, objId - objView.local.nObjects);
+}
+
 
 
 __device__ inline bool segmentTriangleQuickCheck(
@@ -152,15 +208,15 @@ __device__ inline T fmax_vec(T v)
 
 
 //__launch_bounds__(128, 6)
+template <class VertexView>
 static __global__ void findBouncesInMesh(
-        OVviewWithNewOldVertices objView,
+        VertexView objView,
         PVviewWithOldParticles pvView,
         MeshView mesh,
         CellListInfo cinfo,
         TriangleTable triangleTable)
 {
-    // About maximum distance a particle can cover in one step
-    const float tol = 0.2f;
+    const float tol = sweepTolerance;
 
     // One THREAD per triangle
     const int gid = blockIdx.x * blockDim.x + threadIdx.x;
@@ -168,9 +224,9 @@ static __global__ void findBouncesInMesh(
     const int trid  = gid % mesh.ntriangles;
     if (objId >= objView.nObjects) return;
 
-    const int3 triangle = mesh.triangles[trid];
-    Triangle tr =    readTriangle(objView.vertices     + 2 * mesh.nvertices*objId, triangle);
-    Triangle trOld = readTriangle(objView.old_vertices + 2 * mesh.nvertices*objId, triangle);
+    const int3 triangle = mesh.getTriangle(trid);
+    Triangle tr, trOld;
+    readSweptTriangle(objView, mesh, objId, triangle, tr, trOld);
 
     const float3 lo = fmin_vec(trOld.v0, trOld.v1, trOld.v2, tr.v0, tr.v1, tr.v2);
     const float3 hi = fmax_vec(trOld.v0, trOld.v1, trOld.v2, tr.v0, tr.v1, tr.v2);
@@ -183,6 +239,17 @@ static __global__ void findBouncesInMesh(
     for (cid3.z = cidLow.z; cid3.z <= cidHigh.z; cid3.z++)
         for (cid3.y = cidLow.y; cid3.y <= cidHigh.y; cid3.y++)
             {
+                if (!cinfo.isRowMajor())
+                {
+                    for (cid3.x = cidLow.x; cid3.x <= cidHigh.x; cid3.x++)
+                    {
+                        const int cid = cinfo.encode(cid3);
+                        findBouncesInCell(cinfo.cellStarts[cid], cinfo.cellStarts[cid+1],
+                                          gid, tr, trOld, pvView, mesh, triangleTable);
+                    }
+                    continue;
+                }
+
                 cid3.x = cidLow.x;
                 int cidLo = max(cinfo.encode(cid3), 0);
 
@@ -196,6 +263,126 @@ static __global__ void findBouncesInMesh(
             }
 }
 
+//=================================================================================================================
+// Alternative broadphase: BVH over the swept triangles, one thread per particle
+//=================================================================================================================
+
+/**
+ * Box of each triangle over the time step, enlarged by #sweepTolerance.
+ * One thread per triangle, the leaf id is the global triangle id
+ */
+template <class VertexView>
+static __global__ void computeSweptTriangleBoxes(
+        VertexView objView,
+        MeshView mesh,
+        AABB *boxes)
+{
+    const int gid = blockIdx.x * blockDim.x + threadIdx.x;
+    const int objId = gid / mesh.ntriangles;
+    const int trid  = gid % mesh.ntriangles;
+    if (objId >= objView.nObjects) return;
+
+    const int3 triangle = mesh.getTriangle(trid);
+    Triangle tr, trOld;
+    readSweptTriangle(objView, mesh, objId, triangle, tr, trOld);
+
+    const float3 lo = fmin_vec(trOld.v0, trOld.v1, trOld.v2, tr.v0, tr.v1, tr.v2);
+    const float3 hi = fmax_vec(trOld.v0, trOld.v1, trOld.v2, tr.v0, tr.v1, tr.v2);
+
+    boxes[gid] = { lo - sweepTolerance, hi + sweepTolerance };
+}
+
+/**
+ * Same candidates as findBouncesInMesh(), but each particle
+ * queries the hierarchy with the box of its own segment
+ */
+template <class VertexView>
+static __global__ void findBouncesInBVH(
+        VertexView objView,
+        PVviewWithOldParticles pvView,
+        MeshView mesh,
+        BVHView bvh,
+        TriangleTable triangleTable)
+{
+    const int pid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (pid >= pvView.size) return;
+
+    Particle p, pOld;
+    p.   readCoordinate(pvView.particles, pid);
+    pOld.readCoordinate(pvView.old_particles, pid);
+
+    const AABB segment { fminf(p.r, pOld.r), fmaxf(p.r, pOld.r) };
+
+    bvh.traverse(
+        [&] (const AABB& box) {
+            return boxesOverlap(box, segment);
+        },
+        [&] (int gid) {
+            const int objId = gid / mesh.ntriangles;
+            const int trid  = gid % mesh.ntriangles;
+
+            const int3 triangle = mesh.getTriangle(trid);
+            Triangle tr, trOld;
+            readSweptTriangle(objView, mesh, objId, triangle, tr, trOld);
+
+            if (segmentTriangleQuickCheck(tr, trOld, p, pOld))
+                triangleTable.push_back({pid, gid});
+        });
+}
+
+/**
+ * Broadphase of the rigid objects: their mesh does not deform, the BVH is built once in the body frame.
+ * One thread per particle and object, the ends of the segment are brought to the body frame
+ * of the object with its old and new motions.
+ * The candidates are then checked against the triangles in the domain frame, like the other broadphases.
+ * The collisions are recorded with the object ids shifted by \p objIdOffset
+ */
+static __global__ void findBouncesInBodyBVH(
+        ROVviewWithOldMotion rovView,
+        OVviewWithNewOldVertices objView,
+        PVviewWithOldParticles pvView,
+        MeshView mesh,
+        BVHView bvh,
+        float bodyRadius, int objIdOffset,
+        TriangleTable triangleTable)
+{
+    const int pid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (pid >= pvView.size) return;
+
+    Particle p, pOld;
+    p.   readCoordinate(pvView.particles, pid);
+    pOld.readCoordinate(pvView.old_particles, pid);
+
+    const float reach = bodyRadius + sweepTolerance;
+
+    for (int objId = blockIdx.y; objId < objView.nObjects; objId += gridDim.y)
+    {
+        const auto motion    = toSingleMotion(rovView.motions[objId]);
+        const auto oldMotion = toSingleMotion(rovView.old_motions[objId]);
+
+        const float3 dr = p.r - motion.r;
+        if (dot(dr, dr) > reach*reach) continue;
+
+        const float3 r    = rotate(dr,                  invQ(motion.q));
+        const float3 rOld = rotate(pOld.r - oldMotion.r, invQ(oldMotion.q));
+
+        const AABB segment { fminf(r, rOld) - sweepTolerance, fmaxf(r, rOld) + sweepTolerance };
+
+        bvh.traverse(
+            [&] (const AABB& box) {
+                return boxesOverlap(box, segment);
+            },
+            [&] (int trid) {
+                const int3 triangle = mesh.getTriangle(trid);
+                Triangle tr =    readTriangle(objView.vertices     + 2 * mesh.nvertices*objId, triangle);
+                Triangle trOld = readTriangle(objView.old_vertices + 2 * mesh.nvertices*objId, triangle);
+
+                if (segmentTriangleQuickCheck(tr, trOld, p, pOld))
+                    triangleTable.push_back({pid, (objIdOffset + objId) * mesh.ntriangles + trid});
+            });
+    }
+}
+
 //=================================================================================================================
 // Filter the collisions better
 //=================================================================================================================
@@ -365,18 +552,25 @@ __device__ static float intersectSegmentWithTriangle(
     return -1.0f;
 }
 
-static __global__ void refineCollisions(
-        OVviewWithNewOldVertices objView,
-        PVviewWithOldParticles pvView,
-        MeshView mesh,
-        int nCoarseCollisions, int2* coarseTable,
-        TriangleTable fineTable,
-        int* collisionTimes)
+/**
+ * Number of entries of a collision table filled by a previous kernel, read on the device:
+ * the following kernels are launched for the capacity of the table and go over the entries with a grid-stride loop.
+ * The entries beyond the capacity were dropped, see CollisionTable::push_back()
+ */
+__device__ inline int tableSize(const int *total, int maxSize)
 {
-    const int gid = blockIdx.x * blockDim.x + threadIdx.x;
-    if (gid >= nCoarseCollisions) return;
+    return min(*total, maxSize);
+}
 
-    const int2 pid_trid = coarseTable[gid];
+template <class VertexView>
+__device__ inline void refineCollision(
+        const VertexView& objView,
+        const PVviewWithOldParticles& pvView,
+        const MeshView& mesh,
+        int2 pid_trid,
+        TriangleTable& fineTable,
+        int* collisionTimes)
+{
     int pid = pid_trid.x;
 
     Particle p   (pvView.particles,     pid);
@@ -385,9 +579,9 @@ static __global__ void refineCollisions(
     const int trid  = pid_trid.y % mesh.ntriangles;
     const int objId = pid_trid.y / mesh.ntriangles;
 
-    const int3 triangle = mesh.triangles[trid];
-    Triangle tr =    readTriangle(objView.vertices     + 2 * mesh.nvertices*objId, triangle);
-    Triangle trOld = readTriangle(objView.old_vertices + 2 * mesh.nvertices*objId, triangle);
+    const int3 triangle = mesh.getTriangle(trid);
+    Triangle tr, trOld;
+    readSweptTriangle(objView, mesh, objId, triangle, tr, trOld);
 
     float3 intPoint;
     Triangle intTriangle;
@@ -400,6 +594,21 @@ static __global__ void refineCollisions(
     fineTable.push_back(pid_trid);
 }
 
+template <class VertexView>
+static __global__ void refineCollisions(
+        VertexView objView,
+        PVviewWithOldParticles pvView,
+        MeshView mesh,
+        const int *nCoarseCollisions, int maxCoarseCollisions, int2* coarseTable,
+        TriangleTable fineTable,
+        int* collisionTimes)
+{
+    const int n = tableSize(nCoarseCollisions, maxCoarseCollisions);
+
+    for (int i = blockIdx.x * blockDim.x + threadIdx.x; i < n; i += gridDim.x * blockDim.x)
+        refineCollision(objView, pvView, mesh, coarseTable[i], fineTable, collisionTimes);
+}
+
 
 
 //=================================================================================================================
@@ -520,20 +729,17 @@ __device__ inline void triangleForces(
 }
 
 
-static __global__ void performBouncingTriangle(
-        OVviewWithNewOldVertices objView,
-        PVviewWithOldParticles pvView,
-        MeshView mesh,
-        int nCollisions, int2* collisionTable, int* collisionTimes,
+template <class VertexView>
+__device__ inline void performBouncingTriangle(
+        const VertexView& objView,
+        const PVviewWithOldParticles& pvView,
+        const MeshView& mesh,
+        int2 pid_trid, const int* collisionTimes,
         const float dt,
         float kbT, float seed1, float seed2)
 {
     const float eps = 5e-5f;
 
-    const int gid = blockIdx.x * blockDim.x + threadIdx.x;
-    if (gid >= nCollisions) return;
-
-    const int2 pid_trid = collisionTable[gid];
     int pid = pid_trid.x;
 
     Particle p   (pvView.particles,     pid);
@@ -545,9 +751,9 @@ static __global__ void performBouncingTriangle(
     const int trid  = pid_trid.y % mesh.ntriangles;
     const int objId = pid_trid.y / mesh.ntriangles;
 
-    const int3 triangle = mesh.triangles[trid];
-    Triangle tr =    readTriangle(objView.vertices     + 2 * mesh.nvertices*objId, triangle);
-    Triangle trOld = readTriangle(objView.old_vertices + 2 * mesh.nvertices*objId, triangle);
+    const int3 triangle = mesh.getTriangle(trid);
+    Triangle tr, trOld;
+    readSweptTriangle(objView, mesh, objId, triangle, tr, trOld);
 
     float3 intPoint;
     Triangle intTriangle;
@@ -582,7 +788,24 @@ static __global__ void performBouncingTriangle(
 
     corrP.write2Float4(pvView.particles, pid);
 
-    atomicAdd(objView.vertexForces + mesh.nvertices*objId + triangle.x, f0);
-    atomicAdd(objView.vertexForces + mesh.nvertices*objId + triangle.y, f1);
-    atomicAdd(objView.vertexForces + mesh.nvertices*objId + triangle.z, f2);
+    float4 *vertexForces = objectVertexForces(objView, mesh, objId);
+
+    atomicAdd(vertexForces + triangle.x, f0);
+    atomicAdd(vertexForces + triangle.y, f1);
+    atomicAdd(vertexForces + triangle.z, f2);
+}
+
+template <class VertexView>
+static __global__ void performBouncingTriangles(
+        VertexView objView,
+        PVviewWithOldParticles pvView,
+        MeshView mesh,
+        const int *nCollisions, int maxCollisions, int2* collisionTable, int* collisionTimes,
+        const float dt,
+        float kbT, float seed1, float seed2)
+{
+    const int n = tableSize(nCollisions, maxCollisions);
+
+    for (int i = blockIdx.x * blockDim.x + threadIdx.x; i < n; i += gridDim.x * blockDim.x)
+        performBouncingTriangle(objView, pvView, mesh, collisionTable[i], collisionTimes, dt, kbT, seed1, seed2);
 }
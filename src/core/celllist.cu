@@ -4,24 +4,33 @@
 #include <core/celllist.h>
 #include <core/utils/cuda_common.h>
 #include <core/utils/kernel_launch.h>
+#include <core/utils/perf_counters.h>
 #include <core/utils/typeMap.h>
 #include <core/logger.h>
 
+#include <extern/cub/cub/device/device_radix_sort.cuh>
 #include <extern/cub/cub/device/device_scan.cuh>
+#include <extern/cub/cub/iterator/transform_input_iterator.cuh>
+#include <extern/cub/cub/device/device_select.cuh>
+#include <extern/cub/cub/iterator/counting_input_iterator.cuh>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
 
 namespace CellListKernels
 {
 
-enum {INVALID = -1};
+enum {INVALID = -1, KEPT = -2};
 
 inline __device__ bool outgoingParticle(float4 pos)
 {
     return Float3_int(pos).isMarked();
 }
 
-__global__ void computeCellSizes(PVview view, CellListInfo cinfo)
+__global__ void computeCellSizes(PVview view, CellListInfo cinfo, int start)
 {
-    const int pid = blockIdx.x * blockDim.x + threadIdx.x;
+    const int pid = start + blockIdx.x * blockDim.x + threadIdx.x;
     if (pid >= view.size) return;
 
     float4 coo = readNoCache(view.particles + pid*2);
@@ -32,7 +41,7 @@ __global__ void computeCellSizes(PVview view, CellListInfo cinfo)
         atomicAdd(cinfo.cellSizes + cid, 1);
 }
 
-__global__ void reorderParticles(PVview view, CellListInfo cinfo, float4 *outParticles)
+__global__ void reorderParticles(PVview view, CellListInfo cinfo, float4 *outParticles, float4 *outPositions)
 {
     const int gid = blockIdx.x * blockDim.x + threadIdx.x;
     const int pid = gid / 2;
@@ -65,11 +74,220 @@ __global__ void reorderParticles(PVview view, CellListInfo cinfo, float4 *outPar
     {
         writeNoCache(outParticles + 2*dstId+sh, val);
         if (sh == 0) cinfo.order[pid] = dstId;
+        if (sh == 0 && outPositions != nullptr) writeNoCache(outPositions + dstId, val);
     }
     else if (sh == 0)
         cinfo.order[pid] = INVALID;
 }
 
+/// sort key of every particle: its cell, or totcells to put the outgoing particles past the last cell
+__global__ void computeCellKeys(PVview view, CellListInfo cinfo, int *keys, int *ids)
+{
+    const int pid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (pid >= view.size) return;
+
+    float4 coo = readNoCache(view.particles + pid*2);
+
+    keys[pid] = outgoingParticle(coo) ? cinfo.totcells : cinfo.getCellId(coo);
+    ids [pid] = pid;
+}
+
+/// first position in the sorted \p keys with a key not smaller than \p key
+__device__ inline int lowerBound(const int *keys, int n, int key)
+{
+    int lo = 0, hi = n;
+    while (lo < hi)
+    {
+        const int mid = (lo + hi) / 2;
+        if (keys[mid] < key) lo = mid + 1;
+        else                 hi = mid;
+    }
+    return lo;
+}
+
+/// one thread per cell; cellStarts[totcells] is the number of staying particles, the outgoing ones come after
+__global__ void cellStartsFromKeys(int n, const int *sortedKeys, CellListInfo cinfo)
+{
+    const int cid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (cid > cinfo.totcells) return;
+
+    const int start = lowerBound(sortedKeys, n, cid);
+    cinfo.cellStarts[cid] = start;
+
+    if (cid < cinfo.totcells)
+        cinfo.cellSizes[cid] = lowerBound(sortedKeys, n, cid+1) - start;
+}
+
+/// counterpart of reorderParticles() after the sort: the writes are contiguous, the reads follow the sorted ids
+__global__ void gatherSortedParticles(PVview view, const int *sortedIds, CellListInfo cinfo,
+                                      float4 *outParticles, float4 *outPositions)
+{
+    const int gid   = blockIdx.x * blockDim.x + threadIdx.x;
+    const int dstId = gid / 2;
+    const int sh    = gid % 2;  // sh = 0 copies coordinates, sh = 1 -- velocity
+    if (dstId >= view.size) return;
+
+    const int pid = sortedIds[dstId];
+
+    if (dstId >= cinfo.cellStarts[cinfo.totcells])
+    {
+        if (sh == 0) cinfo.order[pid] = INVALID;
+        return;
+    }
+
+    float4 val = readNoCache(view.particles + 2*pid+sh);
+    writeNoCache(outParticles + 2*dstId+sh, val);
+
+    if (sh == 0) cinfo.order[pid] = dstId;
+    if (sh == 0 && outPositions != nullptr) writeNoCache(outPositions + dstId, val);
+}
+
+/// what the incremental build needs of the previous build, see CellList::_buildIncremental()
+struct History
+{
+    const int *starts;   ///< cell starts of the previous build
+    const int *cells;    ///< cell of every slot of the previous build
+    const int *order;    ///< previous slot of every particle, nullptr if the particles are still in their slots
+    int orderSize;
+};
+
+/// slot of the particle \p pid in the previous build, INVALID if it was not there
+__device__ inline int previousSlot(const History& hist, int pid, int totcells)
+{
+    int slot = pid;
+    if (hist.order != nullptr)
+        slot = pid < hist.orderSize ? hist.order[pid] : INVALID;
+
+    return (slot >= 0 && slot < hist.starts[totcells]) ? slot : INVALID;
+}
+
+/**
+ * A particle is kept if it is still in the cell of its previous slot, it then claims that slot.
+ * The others are moved and counted per cell; the outgoing particles are neither
+ */
+__global__ void classifyParticles(PVview view, CellListInfo cinfo, History hist, int *keptSlots, int *cellFill, int *nMoved)
+{
+    const int pid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (pid >= view.size) return;
+
+    float4 coo = readNoCache(view.particles + pid*2);
+    if (outgoingParticle(coo)) return;
+
+    const int cid  = cinfo.getCellId(coo);
+    const int slot = previousSlot(hist, pid, cinfo.totcells);
+
+    if (slot != INVALID && hist.cells[slot] == cid)
+        keptSlots[slot] = pid;
+    else
+    {
+        atomicAdd(cellFill + cid, 1);
+        atomicAggInc(nMoved);
+    }
+}
+
+struct IsKept
+{
+    __device__ inline int operator()(int pid) const
+    {
+        return pid != INVALID;
+    }
+};
+
+/**
+ * One thread per cell. The kept particles of a cell are the same range of the previous slots,
+ * they come first in the cell and \p cellFill is set past them for placeMoved()
+ */
+__global__ void cellSizesFromHistory(CellListInfo cinfo, History hist, const int *keptPrefix, int *cellFill)
+{
+    const int cid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (cid > cinfo.totcells) return;
+
+    if (cid == cinfo.totcells)
+    {
+        cinfo.cellSizes[cid] = 0;
+        return;
+    }
+
+    const int nKept = keptPrefix[hist.starts[cid+1]] - keptPrefix[hist.starts[cid]];
+    cinfo.cellSizes[cid] = nKept + cellFill[cid];
+    cellFill[cid] = nKept;
+}
+
+/// counterpart of reorderParticles() for the moved and outgoing particles, the kept ones are left to placeKept()
+__global__ void placeMoved(PVview view, CellListInfo cinfo, History hist, const int *keptSlots, int *cellFill,
+                           float4 *outParticles, float4 *outPositions)
+{
+    const int gid = blockIdx.x * blockDim.x + threadIdx.x;
+    const int pid = gid / 2;
+    const int sh  = gid % 2;  // sh = 0 copies coordinates, sh = 1 -- velocity
+    if (pid >= view.size) return;
+
+    int dstId;
+    float4 val = readNoCache(view.particles+gid);
+
+    if (sh == 0)
+    {
+        // read before order[pid] is overwritten, by this thread only
+        const int slot = previousSlot(hist, pid, cinfo.totcells);
+
+        if (outgoingParticle(val))
+            dstId = INVALID;
+        else if (slot != INVALID && keptSlots[slot] == pid)
+            dstId = KEPT;
+        else
+        {
+            const int cid = cinfo.getCellId(val);
+            dstId = cinfo.cellStarts[cid] + atomicAdd(cellFill + cid, 1);
+        }
+    }
+
+    int otherDst = warpShflUp(dstId, 1);
+    if (sh == 1)
+        dstId = otherDst;
+
+    if (dstId >= 0)
+    {
+        writeNoCache(outParticles + 2*dstId+sh, val);
+        if (sh == 0) cinfo.order[pid] = dstId;
+        if (sh == 0 && outPositions != nullptr) writeNoCache(outPositions + dstId, val);
+    }
+    else if (sh == 0 && dstId == INVALID)
+        cinfo.order[pid] = INVALID;
+}
+
+/// the kept particles, two threads per previous slot: they keep their relative order in the cell
+__global__ void placeKept(int nSlots, PVview view, CellListInfo cinfo, History hist, const int *keptSlots, const int *keptPrefix,
+                          float4 *outParticles, float4 *outPositions)
+{
+    const int gid  = blockIdx.x * blockDim.x + threadIdx.x;
+    const int slot = gid / 2;
+    const int sh   = gid % 2;  // sh = 0 copies coordinates, sh = 1 -- velocity
+    if (slot >= nSlots) return;
+
+    const int pid = keptSlots[slot];
+    if (pid == INVALID) return;
+
+    const int cid   = hist.cells[slot];
+    const int dstId = cinfo.cellStarts[cid] + keptPrefix[slot] - keptPrefix[hist.starts[cid]];
+
+    float4 val = readNoCache(view.particles + 2*pid+sh);
+    writeNoCache(outParticles + 2*dstId+sh, val);
+
+    if (sh == 0) cinfo.order[pid] = dstId;
+    if (sh == 0 && outPositions != nullptr) writeNoCache(outPositions + dstId, val);
+}
+
+/// cell of every slot of the build, for the next incremental build
+__global__ void computeSlotCells(int nSlots, CellListInfo cinfo, int *cells)
+{
+    const int slot = blockIdx.x * blockDim.x + threadIdx.x;
+    if (slot >= nSlots) return;
+
+    // the last cell starting at or before the slot, it is not empty
+    cells[slot] = slot < cinfo.cellStarts[cinfo.totcells] ?
+        lowerBound(cinfo.cellStarts, cinfo.totcells + 1, slot + 1) - 1 : INVALID;
+}
+
 template <typename T>
 __global__ void reorderExtraDataPerParticle(int n, const T *inExtraData, CellListInfo cinfo, T *outExtraData)
 {
@@ -81,6 +299,42 @@ __global__ void reorderExtraDataPerParticle(int n, const T *inExtraData, CellLis
         outExtraData[dstId] = inExtraData[srcId];
 }
 
+/// source and destination of the persistent channels, reordered together by reorderChannels()
+struct ChannelTable
+{
+    int nChannels;
+    const int *sizes;          ///< in bytes, multiples of 4
+    char * const *src, * const *dst;
+};
+
+template <typename T>
+__device__ inline void copyElement(char *to, const char *from, int nchunks)
+{
+    for (int i = 0; i < nchunks; i++)
+        ((T*) to)[i] = ((const T*) from)[i];
+}
+
+/// all the channels of the table in one pass, each thread moves one particle through every channel
+__global__ void reorderChannels(int n, ChannelTable table, CellListInfo cinfo)
+{
+    const int srcId = blockIdx.x * blockDim.x + threadIdx.x;
+    if (srcId >= n) return;
+
+    const int dstId = cinfo.order[srcId];
+    if (dstId == INVALID) return;
+
+    for (int c = 0; c < table.nChannels; c++)
+    {
+        const int size = table.sizes[c];
+        const char *from = table.src[c] + (size_t) size * srcId;
+        char       *to   = table.dst[c] + (size_t) size * dstId;
+
+        if      (size % sizeof(int4) == 0) copyElement<int4>(to, from, size / sizeof(int4));
+        else if (size % sizeof(int2) == 0) copyElement<int2>(to, from, size / sizeof(int2));
+        else                               copyElement<int> (to, from, size / sizeof(int));
+    }
+}
+
 __global__ void addForcesKernel(PVview dstView, CellListInfo cinfo, PVview srcView)
 {
     int pid = blockIdx.x * blockDim.x + threadIdx.x;
@@ -104,6 +358,29 @@ __global__ void accumulateKernel(int n, T *dst, CellListInfo cinfo, const T *src
     dst[pid] += src[srcId];
 }
 
+struct NonEmptyCell
+{
+    const int *cellStarts;
+
+    __device__ inline bool operator()(int cid) const
+    {
+        return cellStarts[cid+1] > cellStarts[cid];
+    }
+};
+
+/// a coarse cell is the range of particles of one block of \p cellsPerBlock fine cells
+__global__ void deriveCoarseCells(int totcells, int cellsPerBlock, const int *fineStarts, int *cellStarts, int *cellSizes)
+{
+    const int cid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (cid > totcells) return;
+
+    const int start = fineStarts[cid * cellsPerBlock];
+    cellStarts[cid] = start;
+
+    if (cid < totcells)
+        cellSizes[cid] = fineStarts[(cid+1) * cellsPerBlock] - start;
+}
+
 } // namespace CellListKernels
 
 //=================================================================================
@@ -138,12 +415,14 @@ CellList::CellList(ParticleVector *pv, float rc, float3 localDomainSize) :
         particlesDataContainer(new LocalParticleVector(nullptr))
 {
     localPV = particlesDataContainer.get();
+    setOwner();
     
     cellSizes. resize_anew(totcells + 1);
     cellStarts.resize_anew(totcells + 1);
 
     cellSizes. clear(0);
     cellStarts.clear(0);
+    _initActiveCells();
     CUDA_Check( cudaStreamSynchronize(0) );
 
     debug("Initialized %s cell-list with %dx%dx%d cells and cut-off %f", pv->name.c_str(), ncells.x, ncells.y, ncells.z, this->rc);
@@ -154,18 +433,63 @@ CellList::CellList(ParticleVector *pv, int3 resolution, float3 localDomainSize)
         particlesDataContainer(new LocalParticleVector(nullptr))
 {
     localPV = particlesDataContainer.get();
+    setOwner();
     
     cellSizes. resize_anew(totcells + 1);
     cellStarts.resize_anew(totcells + 1);
 
     cellSizes. clear(0);
     cellStarts.clear(0);
+    _initActiveCells();
     CUDA_Check( cudaStreamSynchronize(0) );
 
     debug("Initialized %s cell-list with %dx%dx%d cells and cut-off %f", pv->name.c_str(), ncells.x, ncells.y, ncells.z, this->rc);
 }
 
-CellList::~CellList() = default;
+CellList::~CellList()
+{
+    if (activeCellsCounted != nullptr)
+        CUDA_Check( cudaEventDestroy(activeCellsCounted) );
+
+    if (movesCounted != nullptr)
+        CUDA_Check( cudaEventDestroy(movesCounted) );
+
+    for (auto& event : tuningEvents)
+        CUDA_Check( cudaEventDestroy(event) );
+}
+
+void CellList::setOwner()
+{
+    const std::string owner = makeName();
+
+    scanBuffer  .setOwner(owner + ":scan");
+    cellStarts  .setOwner(owner + ":cellStarts");
+    cellSizes   .setOwner(owner + ":cellSizes");
+    order       .setOwner(owner + ":order");
+    channelSizes.setOwner(owner + ":channels");
+    channelSrc  .setOwner(owner + ":channels");
+    channelDst  .setOwner(owner + ":channels");
+    rowToCellMap.setOwner(owner + ":ordering");
+    cellToRowMap.setOwner(owner + ":ordering");
+    selectBuffer.setOwner(owner + ":activeCells");
+    activeCells .setOwner(owner + ":activeCells");
+    nActiveCells.setOwner(owner + ":activeCells");
+    sortKeys    .setOwner(owner + ":sort");
+    sortedKeys  .setOwner(owner + ":sort");
+    sortIds     .setOwner(owner + ":sort");
+    sortedIds   .setOwner(owner + ":sort");
+    sortBuffer  .setOwner(owner + ":sort");
+
+    historyStarts .setOwner(owner + ":history");
+    historyCells  .setOwner(owner + ":history");
+    keptSlots     .setOwner(owner + ":history");
+    keptPrefix    .setOwner(owner + ":history");
+    cellFill      .setOwner(owner + ":history");
+    nMoved        .setOwner(owner + ":history");
+    keptScanBuffer.setOwner(owner + ":history");
+
+    particlesDataContainer->setOwner(owner);
+}
 
 bool CellList::_checkNeedBuild() const
 {
@@ -220,16 +544,63 @@ void CellList::_updateExtraDataChannels(cudaStream_t stream)
 
 void CellList::_computeCellSizes(cudaStream_t stream)
 {
-    debug2("%s : Computing cell sizes for %d particles", makeName().c_str(), pv->local()->size());
-    cellSizes.clear(stream);
+    PVview view(pv, pv->local());
+
+    // particles counted by binBulk() are still in place, only the arrivals are left
+    int start = 0;
+    if (binnedSize >= 0 && binnedSize <= view.size)
+        start = binnedSize;
+    else
+        cellSizes.clear(stream);
+
+    binnedSize = -1;
+
+    debug2("%s : Computing cell sizes for %d particles, %d already binned",
+           makeName().c_str(), view.size - start, start);
+
+    const int n = view.size - start;
+    if (n == 0) return;
+
+    const int nthreads = 128;
+    SAFE_KERNEL_LAUNCH(
+            CellListKernels::computeCellSizes,
+            getNblocks(n, nthreads), nthreads, 0, stream,
+            view, cellInfo(), start );
+}
+
+void CellList::binBulk(cudaStream_t stream)
+{
+    binnedSize = -1;
+
+    // the sort does not use the counts
+    if (buildMethod == CellListBuild::RadixSort) return;
 
     PVview view(pv, pv->local());
+    if (view.size == 0) return;
+
+    debug2("%s : Binning %d particles ahead of the build", makeName().c_str(), view.size);
+    cellSizes.clear(stream);
 
     const int nthreads = 128;
     SAFE_KERNEL_LAUNCH(
             CellListKernels::computeCellSizes,
             getNblocks(view.size, nthreads), nthreads, 0, stream,
-            view, cellInfo() );
+            view, cellInfo(), 0 );
+
+    binnedSize = view.size;
+}
+
+CellListInfo CellList::beginExternalBinning(cudaStream_t stream)
+{
+    binnedSize = -1;
+    cellSizes.clear(stream);
+    return cellInfo();
+}
+
+void CellList::endExternalBinning(int nBinned)
+{
+    debug2("%s : %d particles binned externally ahead of the build", makeName().c_str(), nBinned);
+    binnedSize = nBinned;
 }
 
 void CellList::_computeCellStarts(cudaStream_t stream)
@@ -247,6 +618,47 @@ void CellList::_computeCellStarts(cudaStream_t stream)
     							  cellSizes.devPtr(), cellStarts.devPtr(), totcells+1, stream);
 }
 
+void CellList::_initActiveCells()
+{
+    activeCells .resize_anew(totcells);
+    nActiveCells.resize_anew(1);
+    nActiveCells[0] = 0;
+    nActiveCells.uploadToDevice(0);
+
+    CUDA_Check( cudaEventCreateWithFlags(&activeCellsCounted, cudaEventDisableTiming) );
+}
+
+// The scan covers all the cells anyway, the compaction then costs one more pass over them
+void CellList::_compactActiveCells(cudaStream_t stream)
+{
+    CellListKernels::NonEmptyCell nonEmpty {cellStarts.devPtr()};
+    cub::CountingInputIterator<int> cellIds(0);
+
+    size_t bufSize = selectBuffer.size();
+
+    if (bufSize == 0)
+    {
+        cub::DeviceSelect::If(nullptr, bufSize, cellIds, activeCells.devPtr(), nActiveCells.devPtr(),
+                              totcells, nonEmpty, stream);
+        selectBuffer.resize_anew(bufSize);
+    }
+    cub::DeviceSelect::If(selectBuffer.devPtr(), bufSize, cellIds, activeCells.devPtr(), nActiveCells.devPtr(),
+                          totcells, nonEmpty, stream);
+
+    nActiveCells.downloadFromDevice(stream, ContainersSynch::Asynch);
+    CUDA_Check( cudaEventRecord(activeCellsCounted, stream) );
+}
+
+int CellList::getActiveCellsBound()
+{
+    const cudaError_t status = cudaEventQuery(activeCellsCounted);
+    if (status == cudaErrorNotReady)
+        return totcells;
+
+    CUDA_Check( status );
+    return nActiveCells[0];
+}
+
 void CellList::_reorderData(cudaStream_t stream)
 {
     debug2("Reordering %d %s particles", pv->local()->size(), pv->name.c_str());
@@ -257,11 +669,83 @@ void CellList::_reorderData(cudaStream_t stream)
     particlesDataContainer->resize_anew(view.size);
     cellSizes.clear(stream);
 
+    // packed positions are written in the same pass, while the coordinates are in registers
+    float4 *outPositions = nullptr;
+    if (pv->packedPositions)
+    {
+        particlesDataContainer->positions.resize_anew(view.size);
+        particlesDataContainer->positionsStamp = pv->cellListStamp;
+        outPositions = particlesDataContainer->positions.devPtr();
+    }
+
     const int nthreads = 128;
     SAFE_KERNEL_LAUNCH(
         CellListKernels::reorderParticles,
         getNblocks(2*view.size, nthreads), nthreads, 0, stream,
-        view, cellInfo(), (float4*)particlesDataContainer->coosvels.devPtr() );
+        view, cellInfo(), (float4*)particlesDataContainer->coosvels.devPtr(), outPositions );
+}
+
+void CellList::_sortByCell(cudaStream_t stream)
+{
+    PVview view(pv, pv->local());
+    const int n = view.size;
+
+    // counts of binBulk() or of an external binning are not needed
+    binnedSize = -1;
+
+    debug2("%s : Sorting %d particles by cell", makeName().c_str(), n);
+
+    sortKeys  .resize_anew(n);
+    sortedKeys.resize_anew(n);
+    sortIds   .resize_anew(n);
+    sortedIds .resize_anew(n);
+
+    const int nthreads = 128;
+    SAFE_KERNEL_LAUNCH(
+            CellListKernels::computeCellKeys,
+            getNblocks(n, nthreads), nthreads, 0, stream,
+            view, cellInfo(), sortKeys.devPtr(), sortIds.devPtr() );
+
+    // the keys go up to totcells included, the higher bits are all zero
+    int nbits = 1;
+    while ((1 << nbits) <= totcells) nbits++;
+
+    size_t bufSize = 0;
+    cub::DeviceRadixSort::SortPairs(nullptr, bufSize, sortKeys.devPtr(), sortedKeys.devPtr(),
+                                    sortIds.devPtr(), sortedIds.devPtr(), n, 0, nbits, stream);
+    sortBuffer.resize_anew(bufSize);
+    cub::DeviceRadixSort::SortPairs(sortBuffer.devPtr(), bufSize, sortKeys.devPtr(), sortedKeys.devPtr(),
+                                    sortIds.devPtr(), sortedIds.devPtr(), n, 0, nbits, stream);
+
+    SAFE_KERNEL_LAUNCH(
+            CellListKernels::cellStartsFromKeys,
+            getNblocks(totcells + 1, nthreads), nthreads, 0, stream,
+            n, sortedKeys.devPtr(), cellInfo() );
+}
+
+void CellList::_gatherSorted(cudaStream_t stream)
+{
+    debug2("Gathering %d sorted %s particles", pv->local()->size(), pv->name.c_str());
+
+    PVview view(pv, pv->local());
+
+    order.resize_anew(view.size);
+    particlesDataContainer->resize_anew(view.size);
+
+    float4 *outPositions = nullptr;
+    if (pv->packedPositions)
+    {
+        particlesDataContainer->positions.resize_anew(view.size);
+        particlesDataContainer->positionsStamp = pv->cellListStamp;
+        outPositions = particlesDataContainer->positions.devPtr();
+    }
+
+    const int nthreads = 128;
+    SAFE_KERNEL_LAUNCH(
+        CellListKernels::gatherSortedParticles,
+        getNblocks(2*view.size, nthreads), nthreads, 0, stream,
+        view, sortedIds.devPtr(), cellInfo(),
+        (float4*)particlesDataContainer->coosvels.devPtr(), outPositions );
 }
 
 template <typename T>
@@ -308,26 +792,301 @@ void CellList::_reorderExtraDataEntry(const std::string& channelName,
 
 }
 
+/**
+ * The persistent channels are moved by a single kernel walking a table of their pointers,
+ * instead of one launch per channel. The table is only uploaded when a pointer changed,
+ * i.e. after a reallocation or, for the primary cell-list, after the swap of the containers
+ */
 void CellList::_reorderPersistentData(cudaStream_t stream)
 {
-    auto srcExtraData = &pv->local()->extraPerParticle;
-    
-    for (const auto& namedChannel : srcExtraData->getSortedChannels()) {
+    auto& srcExtraData = pv->local()->extraPerParticle;
+    auto& dstExtraData = particlesDataContainer->extraPerParticle;
+    const int np = pv->local()->size();
+
+    int nChannels = 0;
+    bool needUpload = false;
+
+    for (const auto& namedChannel : srcExtraData.getSortedChannels())
+    {
         const auto& name = namedChannel.first;
         const auto& desc = namedChannel.second;
         if (desc->persistence != ExtraDataManager::PersistenceMode::Persistent) continue;
-        _reorderExtraDataEntry(name, desc, stream);
+
+        const int size = desc->container->datatype_size();
+        auto src = reinterpret_cast<char*>(desc->container->genericDevPtr());
+        auto dst = reinterpret_cast<char*>(dstExtraData.getGenericPtr(name));
+
+        if (channelSizes.size() <= nChannels)
+        {
+            channelSizes.resize(nChannels+1, stream);
+            channelSrc  .resize(nChannels+1, stream);
+            channelDst  .resize(nChannels+1, stream);
+            needUpload = true;
+        }
+
+        if (channelSizes[nChannels] != size || channelSrc[nChannels] != src || channelDst[nChannels] != dst)
+            needUpload = true;
+
+        channelSizes[nChannels] = size;
+        channelSrc  [nChannels] = src;
+        channelDst  [nChannels] = dst;
+        nChannels++;
     }
+
+    if (nChannels == 0) return;
+
+    if (needUpload)
+    {
+        channelSizes.uploadToDevice(stream);
+        channelSrc  .uploadToDevice(stream);
+        channelDst  .uploadToDevice(stream);
+    }
+
+    CellListKernels::ChannelTable table { nChannels, channelSizes.devPtr(), channelSrc.devPtr(), channelDst.devPtr() };
+
+    const int nthreads = 128;
+    SAFE_KERNEL_LAUNCH(
+        CellListKernels::reorderChannels,
+        getNblocks(np, nthreads), nthreads, 0, stream,
+        np, table, cellInfo() );
 }
 
-void CellList::_build(cudaStream_t stream)
+/**
+ * With CellListBuild::Auto the builds alternate between the two methods and are timed
+ * until nTuningBuilds builds are done, the first two being a warm-up (e.g. allocation of the buffers).
+ * The times are only read at the next build, once the device is past them
+ *
+ * @return index of the build to time, -1 if the build is not timed
+ */
+int CellList::_selectBuildMethod()
+{
+    if (buildMethod != CellListBuild::Auto)
+    {
+        useRadixSort = (buildMethod == CellListBuild::RadixSort);
+        return -1;
+    }
+
+    const int n = pv->local()->size();
+
+    if (tuningBuild == nTuningBuilds)
+    {
+        if (!tuned) _finishTuning();
+        if (n <= 2*tunedSize && 2*n >= tunedSize) return -1;
+
+        debug("%s : %d particles instead of %d, timing the build methods again", makeName().c_str(), n, tunedSize);
+        tuningBuild = 0;
+        tuned = false;
+    }
+
+    if (tuningEvents.empty())
+    {
+        tuningEvents.resize(2*nTuningBuilds);
+        for (auto& event : tuningEvents)
+            CUDA_Check( cudaEventCreate(&event) );
+    }
+
+    if (tuningBuild == 0) tunedSize = n;
+
+    useRadixSort = (tuningBuild % 2 == 1);
+    return tuningBuild++;
+}
+
+void CellList::_finishTuning()
+{
+    CUDA_Check( cudaEventSynchronize(tuningEvents.back()) );
+
+    float times[2] = {0.0f, 0.0f};
+    for (int i = 2; i < nTuningBuilds; i++)
+    {
+        float ms;
+        CUDA_Check( cudaEventElapsedTime(&ms, tuningEvents[2*i], tuningEvents[2*i+1]) );
+        times[i % 2] += ms;
+    }
+
+    useRadixSort = times[1] < times[0];
+    tuned = true;
+
+    info("%s : builds of %d particles take %.3f ms with atomics, %.3f ms with radix sort; using %s",
+         makeName().c_str(), tunedSize, 2.0f * times[0] / (nTuningBuilds-2), 2.0f * times[1] / (nTuningBuilds-2),
+         useRadixSort ? "radix sort" : "atomics");
+}
+
+/**
+ * The number of particles moved by the last incremental build is only read now, once the device is past it.
+ * Too many moves make the next nFullBuildsAfterFallback builds full ones
+ */
+bool CellList::_useIncremental()
+{
+    if (movesPending)
+    {
+        CUDA_Check( cudaEventSynchronize(movesCounted) );
+        movesPending = false;
+
+        const int moved = nMoved[0];
+        PerfCounters::add("cell-list moved particles: " + pv->name, moved);
+
+        if (moved > maxMovedFraction * movesOf)
+        {
+            debug("%s : %d of %d particles changed cell in the last build, building from scratch for the next %d builds",
+                  makeName().c_str(), moved, movesOf, nFullBuildsAfterFallback);
+            fullBuildsLeft = nFullBuildsAfterFallback;
+        }
+    }
+
+    if (maxMovedFraction <= 0.0f || !historyValid) return false;
+
+    if (fullBuildsLeft > 0)
+    {
+        fullBuildsLeft--;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Incremental build: the particles still in the cell of their slot of the previous build are kept,
+ * and stay in the same relative order at the start of their cell; the other ones are appended to their cells
+ * with atomics. Between two steps most particles are kept, the counting and the scattering then take
+ * few atomics, and the data moves by the few slots gained or lost by the cells before, keeping the accesses
+ * of the reorder kernels almost contiguous.
+ *
+ * The previous slot of a particle is its current slot if the particles were moved to their slots
+ * (primary cell-lists), its entry of the previous order otherwise. These slots only need to be distinct
+ * for the build to be correct: if the particles were reordered since, e.g. by the primary cell-list
+ * of the particle vector, fewer of them are kept
+ */
+void CellList::_buildIncremental(cudaStream_t stream)
 {
-    _computeCellSizes(stream);
+    PVview view(pv, pv->local());
+    const int n      = view.size;
+    const int nSlots = historyCells.size();
+
+    // counts of binBulk() or of an external binning are not needed
+    binnedSize = -1;
+
+    debug2("%s : Incremental build of %d particles from %d previous slots", makeName().c_str(), n, nSlots);
+    PerfCounters::add("cell-list incremental builds: " + pv->name);
+
+    keptSlots .resize_anew(nSlots + 1);
+    keptPrefix.resize_anew(nSlots + 1);
+    CUDA_Check( cudaMemsetAsync(keptSlots.devPtr(), 0xff, keptSlots.size() * sizeof(int), stream) );
+    cellFill.clear(stream);
+    nMoved  .clearDevice(stream);
+
+    // the previous order is still read to find the previous slots, unless the particles are in their slots
+    const bool inSlots = (localPV == pv->local());
+    if (inSlots) order.resize_anew(n);
+    else         order.resize(n, stream);
+
+    particlesDataContainer->resize_anew(n);
+
+    float4 *outPositions = nullptr;
+    if (pv->packedPositions)
+    {
+        particlesDataContainer->positions.resize_anew(n);
+        particlesDataContainer->positionsStamp = pv->cellListStamp;
+        outPositions = particlesDataContainer->positions.devPtr();
+    }
+
+    CellListKernels::History hist { historyStarts.devPtr(), historyCells.devPtr(),
+                                    inSlots ? nullptr : order.devPtr(), historyOrderSize };
+
+    const int nthreads = 128;
+    SAFE_KERNEL_LAUNCH(
+            CellListKernels::classifyParticles,
+            getNblocks(n, nthreads), nthreads, 0, stream,
+            view, cellInfo(), hist, keptSlots.devPtr(), cellFill.devPtr(), nMoved.devPtr() );
+
+    cub::TransformInputIterator<int, CellListKernels::IsKept, const int*> kept(keptSlots.devPtr(), CellListKernels::IsKept());
+
+    size_t bufSize = 0;
+    cub::DeviceScan::ExclusiveSum(nullptr, bufSize, kept, keptPrefix.devPtr(), nSlots + 1, stream);
+    keptScanBuffer.resize_anew(bufSize);
+    cub::DeviceScan::ExclusiveSum(keptScanBuffer.devPtr(), bufSize, kept, keptPrefix.devPtr(), nSlots + 1, stream);
+
+    SAFE_KERNEL_LAUNCH(
+            CellListKernels::cellSizesFromHistory,
+            getNblocks(totcells + 1, nthreads), nthreads, 0, stream,
+            cellInfo(), hist, keptPrefix.devPtr(), cellFill.devPtr() );
+
     _computeCellStarts(stream);
-    _reorderData(stream);
+    _compactActiveCells(stream);
+
+    // the moved particles first: they read their previous slot from the order that placeKept() overwrites
+    SAFE_KERNEL_LAUNCH(
+            CellListKernels::placeMoved,
+            getNblocks(2*n, nthreads), nthreads, 0, stream,
+            view, cellInfo(), hist, keptSlots.devPtr(), cellFill.devPtr(),
+            (float4*)particlesDataContainer->coosvels.devPtr(), outPositions );
+
+    SAFE_KERNEL_LAUNCH(
+            CellListKernels::placeKept,
+            getNblocks(2*nSlots, nthreads), nthreads, 0, stream,
+            nSlots, view, cellInfo(), hist, keptSlots.devPtr(), keptPrefix.devPtr(),
+            (float4*)particlesDataContainer->coosvels.devPtr(), outPositions );
+
+    nMoved.downloadFromDevice(stream, ContainersSynch::Asynch);
+    CUDA_Check( cudaEventRecord(movesCounted, stream) );
+    movesPending = true;
+    movesOf      = n;
+}
+
+/// cell starts and cell of every slot of the build just done, for the next incremental build
+void CellList::_recordHistory(cudaStream_t stream)
+{
+    const int n = pv->local()->size();
+
+    historyStarts.resize_anew(totcells + 1);
+    CUDA_Check( cudaMemcpyAsync(historyStarts.devPtr(), cellStarts.devPtr(), (totcells + 1) * sizeof(int),
+                                cudaMemcpyDeviceToDevice, stream) );
+
+    historyCells.resize_anew(n);
+
+    const int nthreads = 128;
+    SAFE_KERNEL_LAUNCH(
+            CellListKernels::computeSlotCells,
+            getNblocks(n, nthreads), nthreads, 0, stream,
+            n, cellInfo(), historyCells.devPtr() );
+
+    historyOrderSize = order.size();
+    historyValid = true;
+}
+
+void CellList::_build(cudaStream_t stream)
+{
+    if (_useIncremental())
+        _buildIncremental(stream);
+    else
+    {
+        const int timed = _selectBuildMethod();
+        if (timed >= 0) CUDA_Check( cudaEventRecord(tuningEvents[2*timed], stream) );
+
+        if (useRadixSort)
+            _sortByCell(stream);
+        else
+        {
+            _computeCellSizes(stream);
+            _computeCellStarts(stream);
+        }
+
+        _compactActiveCells(stream);
+
+        if (useRadixSort)
+            _gatherSorted(stream);
+        else
+            _reorderData(stream);
+
+        if (timed >= 0) CUDA_Check( cudaEventRecord(tuningEvents[2*timed+1], stream) );
+    }
+
     _reorderPersistentData(stream);
+
+    if (maxMovedFraction > 0.0f)
+        _recordHistory(stream);
     
     changedStamp = pv->cellListStamp;
+    nBuilds++;
 }
 
 CellListInfo CellList::cellInfo()
@@ -336,16 +1095,160 @@ CellListInfo CellList::cellInfo()
     CellListInfo::cellStarts = cellStarts.devPtr();
     CellListInfo::order      = order.devPtr();
 
+    const bool rowMajor = _isRowMajor();
+    CellListInfo::rowToCell  = rowMajor ? nullptr : rowToCellMap.devPtr();
+    CellListInfo::cellToRow  = rowMajor ? nullptr : cellToRowMap.devPtr();
+
+    CellListInfo::activeCells  = activeCells .devPtr();
+    CellListInfo::nActiveCells = nActiveCells.devPtr();
+
     return *((CellListInfo*)this);
 }
 
+// Interleave the bits of the three coordinates
+static uint64_t mortonCode(int ix, int iy, int iz)
+{
+    auto spread = [] (uint64_t x) {
+        x &= 0x1fffff;
+        x = (x | x << 32) & 0x1f00000000ffff;
+        x = (x | x << 16) & 0x1f0000ff0000ff;
+        x = (x | x <<  8) & 0x100f00f00f00f00f;
+        x = (x | x <<  4) & 0x10c30c30c30c30c3;
+        x = (x | x <<  2) & 0x1249249249249249;
+        return x;
+    };
+
+    return spread(ix) | (spread(iy) << 1) | (spread(iz) << 2);
+}
+
+bool CellList::_isRowMajor() const
+{
+    return ordering == CellListOrdering::RowMajor && blocking == 1;
+}
+
+void CellList::_updateCellMaps()
+{
+    // cells have to be sorted again, the previous build does not help
+    changedStamp = -1;
+    historyValid = false;
+
+    if (_isRowMajor()) return;
+
+    const int3 nblocks = ncells / blocking;
+
+    // the cells are sorted by block first, then by their row-major id within the block
+    std::vector<std::pair<uint64_t, int>> codes(totcells);
+    std::vector<int> rowIds(totcells);
+
+    for (int iz = 0; iz < ncells.z; iz++)
+        for (int iy = 0; iy < ncells.y; iy++)
+            for (int ix = 0; ix < ncells.x; ix++)
+            {
+                const int rowId = (iz*ncells.y + iy)*ncells.x + ix;
+                const int bx = ix / blocking, by = iy / blocking, bz = iz / blocking;
+
+                const uint64_t blockCode = (ordering == CellListOrdering::Morton) ?
+                    mortonCode(bx, by, bz) : (bz*nblocks.y + by)*nblocks.x + bx;
+
+                const int inBlock = ((iz % blocking)*blocking + iy % blocking)*blocking + ix % blocking;
+
+                codes [rowId] = {blockCode, inBlock};
+                rowIds[rowId] = rowId;
+            }
+
+    std::sort(rowIds.begin(), rowIds.end(), [&codes] (int a, int b) {
+        return codes[a] < codes[b];
+    });
+
+    HostBuffer<int> hostRowToCell(totcells), hostCellToRow(totcells);
+    for (int cid = 0; cid < totcells; cid++)
+    {
+        hostCellToRow[cid] = rowIds[cid];
+        hostRowToCell[rowIds[cid]] = cid;
+    }
+
+    rowToCellMap.copy(hostRowToCell, 0);
+    cellToRowMap.copy(hostCellToRow, 0);
+    CUDA_Check( cudaStreamSynchronize(0) );
+
+    debug("%s uses %s ordering of the cells, by blocks of %d^3 cells", makeName().c_str(),
+          ordering == CellListOrdering::Morton ? "Morton" : "row-major", blocking);
+}
+
+void CellList::setOrdering(CellListOrdering ordering)
+{
+    this->ordering = ordering;
+    _updateCellMaps();
+}
+
+void CellList::setBlocking(int n)
+{
+    if (n < 1 || ncells.x % n != 0 || ncells.y % n != 0 || ncells.z % n != 0)
+        die("%s: cannot group %dx%dx%d cells by blocks of %d^3",
+            makeName().c_str(), ncells.x, ncells.y, ncells.z, n);
+
+    blocking = n;
+    _updateCellMaps();
+}
+
+int CellList::getBlocking() const
+{
+    return blocking;
+}
+
+void CellList::setBuildMethod(CellListBuild method)
+{
+    buildMethod = method;
+    tuningBuild = 0;
+    tuned = false;
+}
+
+CellListBuild CellList::getBuildMethod() const
+{
+    return buildMethod;
+}
+
+CellListOrdering CellList::getOrdering() const
+{
+    return ordering;
+}
+
+void CellList::setIncrementalBuild(float maxMovedFraction)
+{
+    if (maxMovedFraction < 0.0f || maxMovedFraction > 1.0f)
+        die("%s: the fraction of moved particles of the incremental builds must be in [0, 1], got %f",
+            makeName().c_str(), maxMovedFraction);
+
+    this->maxMovedFraction = maxMovedFraction;
+    historyValid = false;
+    fullBuildsLeft = 0;
+
+    // only the cell-lists built incrementally hold these
+    if (maxMovedFraction > 0.0f && movesCounted == nullptr)
+    {
+        CUDA_Check( cudaEventCreateWithFlags(&movesCounted, cudaEventDisableTiming) );
+        cellFill.resize_anew(totcells);
+        nMoved  .resize_anew(1);
+    }
+}
+
+float CellList::getIncrementalBuild() const
+{
+    return maxMovedFraction;
+}
+
 void CellList::build(cudaStream_t stream)
 {
     _updateExtraDataChannels(stream);
         
-    if (!_checkNeedBuild()) return;
+    if (!_checkNeedBuild())
+    {
+        binnedSize = -1;
+        return;
+    }
     
     debug("building %s", makeName().c_str());
+    PerfCounters::add("cell-list rebuilds: " + pv->name);
     
     _build(stream);
 }
@@ -416,19 +1319,36 @@ void CellList::gatherChannels(const std::vector<std::string>& channelNames, cuda
 }
 
 void CellList::clearChannels(const std::vector<std::string>& channelNames, cudaStream_t stream)
+{
+    ClearBatch batch;
+    clearChannels(channelNames, batch);
+    batch.run(stream);
+}
+
+void CellList::clearChannels(const std::vector<std::string>& channelNames, ClearBatch& batch)
 {
     for (const auto& channelName : channelNames) {
         debug2("%s : clearing channel '%s'", makeName().c_str(), channelName.c_str());
 
         if (channelName == ChannelNames::forces)
-            localPV->forces.clear(stream);
+            batch.add(&localPV->forces);
         else
-            localPV->extraPerParticle.getGenericData(channelName)->clearDevice(stream);
+            batch.add(localPV->extraPerParticle.getGenericData(channelName));
     }
 }
 
 LocalParticleVector* CellList::getLocalParticleVector() {return localPV;}
 
+int CellList::getNumBuilds() const {return nBuilds;}
+int CellList::getOrderSize() const {return order.size();}
+
+std::vector<GPUcontainer*> CellList::getContainers()
+{
+    auto containers = particlesDataContainer->getContainers();
+    containers.push_back(&order);
+    return containers;
+}
+
 std::string CellList::makeName() const
 {
     return "Cell List '" + pv->name + "' (rc " + std::to_string(rc) + ")";
@@ -462,7 +1382,11 @@ PrimaryCellList::~PrimaryCellList() = default;
 void PrimaryCellList::build(cudaStream_t stream)
 {
 	// Reqired here to avoid ptr swap if building didn't actually happen
-    if (!_checkNeedBuild()) return;
+    if (!_checkNeedBuild())
+    {
+        binnedSize = -1;
+        return;
+    }
 
     CellList::build(stream);
 
@@ -483,6 +1407,11 @@ void PrimaryCellList::build(cudaStream_t stream)
     particlesDataContainer->resize(newSize, stream);
 
     std::swap(pv->local()->coosvels, particlesDataContainer->coosvels);
+    if (pv->packedPositions)
+    {
+        std::swap(pv->local()->positions,      particlesDataContainer->positions);
+        std::swap(pv->local()->positionsStamp, particlesDataContainer->positionsStamp);
+    }
     _swapPersistentExtraData();
     
     pv->local()->resize(newSize, stream);
@@ -536,3 +1465,103 @@ std::string PrimaryCellList::makeName() const
 {
     return "Primary " + CellList::makeName();
 }
+
+
+//=================================================================================
+// Coarse cell-lists
+//=================================================================================
+
+CoarseCellList::CoarseCellList(ParticleVector *pv, PrimaryCellList *fine, int n, float3 localDomainSize) :
+        CellList(pv, fine->ncells / n, localDomainSize), fine(fine)
+{
+    fine->setBlocking(n);
+    localPV = fine->getLocalParticleVector();
+
+    debug("%s is derived from %dx%dx%d finer cells", makeName().c_str(), fine->ncells.x, fine->ncells.y, fine->ncells.z);
+}
+
+CoarseCellList::~CoarseCellList() = default;
+
+CellListInfo CoarseCellList::cellInfo()
+{
+    auto info = CellList::cellInfo();
+    info.order = fine->cellInfo().order;
+    return info;
+}
+
+void CoarseCellList::build(cudaStream_t stream)
+{
+    fine->build(stream);
+
+    if (fineBuildId == fine->getNumBuilds())
+    {
+        debug2("%s is already up-to-date, building skipped", makeName().c_str());
+        return;
+    }
+
+    debug("deriving %s", makeName().c_str());
+
+    const int n = fine->getBlocking();
+    const int nthreads = 128;
+
+    SAFE_KERNEL_LAUNCH(
+            CellListKernels::deriveCoarseCells,
+            getNblocks(totcells + 1, nthreads), nthreads, 0, stream,
+            totcells, n*n*n, fine->cellInfo().cellStarts, cellStarts.devPtr(), cellSizes.devPtr() );
+
+    _compactActiveCells(stream);
+
+    fineBuildId  = fine->getNumBuilds();
+    changedStamp = pv->cellListStamp;
+    nBuilds++;
+}
+
+void CoarseCellList::binBulk(cudaStream_t stream)
+{}
+
+CellListInfo CoarseCellList::beginExternalBinning(cudaStream_t stream)
+{
+    return fine->beginExternalBinning(stream);
+}
+
+void CoarseCellList::endExternalBinning(int nBinned)
+{
+    fine->endExternalBinning(nBinned);
+}
+
+void CoarseCellList::setOrdering(CellListOrdering ordering)
+{
+    CellList::setOrdering(ordering);
+    fine->setOrdering(ordering);
+    fineBuildId = -1;
+}
+
+void CoarseCellList::accumulateChannels(const std::vector<std::string>& channelNames, cudaStream_t stream)
+{}
+
+void CoarseCellList::gatherChannels(const std::vector<std::string>& channelNames, cudaStream_t stream)
+{
+    // the data is already in the particle vector, but still invalidate halo
+    if (!channelNames.empty())
+        pv->haloValid = false;
+}
+
+int CoarseCellList::getOrderSize() const
+{
+    return fine->getOrderSize();
+}
+
+std::vector<GPUcontainer*> CoarseCellList::getContainers()
+{
+    return {};
+}
+
+CellList* CoarseCellList::getFineList()
+{
+    return fine;
+}
+
+std::string CoarseCellList::makeName() const
+{
+    return "Coarse " + CellList::makeName();
+}
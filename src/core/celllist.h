@@ -5,10 +5,12 @@
 #include <core/logger.h>
 #include <core/pvs/particle_vector.h>
 #include <core/pvs/views/pv.h>
+#include <core/utils/clear_batch.h>
 #include <core/utils/cuda_common.h>
 
 #include <cstdint>
 #include <functional>
+#include <vector>
 
 
 enum class CellListsProjection
@@ -16,6 +18,32 @@ enum class CellListsProjection
     Clamp, NoClamp
 };
 
+/**
+ * Order in which the cells (and hence the particles) are stored.
+ * RowMajor: x is the fastest index, then y, then z.
+ * Morton:   cells follow the Z-order curve, neighbouring cells along
+ *           all the three axes are close in memory.
+ */
+enum class CellListOrdering
+{
+    RowMajor, Morton
+};
+
+/**
+ * How build() sorts the particles by cell.
+ * Atomics:   count the particles per cell with atomics, scan the counts and scatter the particles
+ *            to their slots; the order within a cell depends on the scheduling of the atomics.
+ * RadixSort: radix sort of the (cell id, particle id) pairs on the bits of the cell ids only,
+ *            the cell starts are found by binary search in the sorted ids. No atomics, and the sort
+ *            is stable: the particles of a cell keep their order, the build is deterministic.
+ * Auto:      time both methods on the first builds and keep the faster one,
+ *            again when the number of particles changed by more than a factor of 2
+ */
+enum class CellListBuild
+{
+    Atomics, RadixSort, Auto
+};
+
 
 class CellListInfo
 {
@@ -28,6 +56,14 @@ public:
 
     int *cellSizes, *cellStarts, *order;
 
+    /// Mapping between row-major and actual cell ids, nullptr for row-major ordering.
+    /// Device pointers, so encode() and decode() only work on device with space-filling curves
+    int *rowToCell{nullptr}, *cellToRow{nullptr};
+
+    /// Ids of the non-empty cells in increasing order and their number, device pointers.
+    /// nullptr if not compacted, all the cells are then considered, see activeCell()
+    int *activeCells{nullptr}, *nActiveCells{nullptr};
+
     CellListInfo(float3 h, float3 localDomainSize);
     CellListInfo(float rc, float3 localDomainSize);
 
@@ -35,18 +71,43 @@ public:
 // ==========================================================================================================================================
 // Common cell functions
 // ==========================================================================================================================================
+    __device__ __host__ inline bool isRowMajor() const
+    {
+        return rowToCell == nullptr;
+    }
+
     __device__ __host__ inline int encode(int ix, int iy, int iz) const
     {
-        return (iz*ncells.y + iy)*ncells.x + ix;
+        const int rowId = (iz*ncells.y + iy)*ncells.x + ix;
+
+        if (isRowMajor() || rowId < 0 || rowId >= totcells)
+            return rowId;
+        else
+            return rowToCell[rowId];
     }
 
     __device__ __host__ inline void decode(int cid, int& ix, int& iy, int& iz) const
     {
+        if (!isRowMajor() && cid >= 0 && cid < totcells)
+            cid = cellToRow[cid];
+
         ix = cid % ncells.x;
         iy = (cid / ncells.x) % ncells.y;
         iz = cid / (ncells.x * ncells.y);
     }
 
+    /**
+     * Id of the \p i-th non-empty cell, or -1 past the last one: kernels with one thread
+     * or warp per cell skip the empty ones this way, see CellList::getActiveCellsBound()
+     */
+    __device__ inline int activeCell(int i) const
+    {
+        if (activeCells == nullptr)
+            return i < totcells ? i : -1;
+
+        return i < *nActiveCells ? activeCells[i] : -1;
+    }
+
     __device__ __host__ inline int encode(int3 cid3) const
     {
         return encode(cid3.x, cid3.y, cid3.z);
@@ -83,6 +144,22 @@ public:
 
         return encode(id.x, id.y, id.z);
     }
+
+    /**
+     * Count the particle at \p coo in its cell if it stays in the subdomain,
+     * i.e. is neither marked nor outside: redistribution will take care of the others.
+     * See CellList::beginExternalBinning()
+     */
+    __device__ inline void binStaying(const float4 coo) const
+    {
+        if (Float3_int(coo).isMarked()) return;
+
+        const int3 id = getCellIdAlongAxes<CellListsProjection::NoClamp>(make_float3(coo));
+        if (id.x < 0 || id.x >= ncells.x  ||  id.y < 0 || id.y >= ncells.y  ||  id.z < 0 || id.z >= ncells.z)
+            return;
+
+        atomicAdd(cellSizes + encode(id), 1);
+    }
 #endif
 };
 
@@ -95,13 +172,59 @@ public:
 
     virtual ~CellList();
     
-    CellListInfo cellInfo();
+    virtual CellListInfo cellInfo();
 
     virtual void build(cudaStream_t stream);
 
+    /**
+     * Count the particles of the local particle vector per cell ahead of the next build(),
+     * which then only counts the particles appended since, e.g. by the redistribution.
+     * The particles present now must stay unchanged until the build: same order, cells and marks.
+     */
+    virtual void binBulk(cudaStream_t stream);
+
+    /**
+     * Same as binBulk(), but the counting is done by another kernel, e.g. by the integrator
+     * right after computing the new positions, with CellListInfo::binStaying().
+     * Clears the cell sizes; the returned info is to be passed to that kernel.
+     * endExternalBinning() has to be called once all the \p nBinned particles are counted.
+     */
+    virtual CellListInfo beginExternalBinning(cudaStream_t stream);
+    virtual void endExternalBinning(int nBinned);
+
+    /**
+     * Change the order of the cells. Forces the next build.
+     * Kernels relying on contiguous rows of cells have to check CellListInfo::isRowMajor()
+     */
+    virtual void setOrdering(CellListOrdering ordering);
+    CellListOrdering getOrdering() const;
+
+    /**
+     * Build from the previous build as long as at most \p maxMovedFraction of the particles changed cell,
+     * see _buildIncremental(); 0 (the default) to always build from scratch.
+     * When more particles moved, the next builds are full ones with the method of setBuildMethod(),
+     * before trying again. The counts of binBulk() or of an external binning are not used by the incremental builds
+     */
+    void setIncrementalBuild(float maxMovedFraction);
+    float getIncrementalBuild() const;
+
+    /**
+     * Store the cells by cubic blocks of \p n^3 cells, such that a cell-list with \p n times
+     * larger cells can be derived without sorting again, see CoarseCellList.
+     * The blocks follow the ordering of the cells, the cells within a block are row-major.
+     * The number of cells along each axis must be a multiple of \p n. Forces the next build
+     */
+    void setBlocking(int n);
+    int getBlocking() const;
+
+    /// see CellListBuild, Atomics by default
+    void setBuildMethod(CellListBuild method);
+    CellListBuild getBuildMethod() const;
+
     virtual void accumulateChannels(const std::vector<std::string>& channelNames, cudaStream_t stream);
     virtual void gatherChannels(const std::vector<std::string>& channelNames, cudaStream_t stream);
     void clearChannels(const std::vector<std::string>& channelNames, cudaStream_t stream);
+    void clearChannels(const std::vector<std::string>& channelNames, ClearBatch& batch);
 
     
     
@@ -123,26 +246,99 @@ public:
     }
     
     LocalParticleVector* getLocalParticleVector();
+
+    /**
+     * Number of threads or warps to launch over CellListInfo::activeCell():
+     * the number of non-empty cells of the last build if it already reached the host,
+     * e.g. always for the primary cell-lists, the total number of cells otherwise
+     */
+    int getActiveCellsBound();
+
+    /// number of times the cell-list was actually rebuilt
+    int getNumBuilds() const;
+
+    /// number of particles (before reordering) in the last build, i.e. size of the \c order array
+    virtual int getOrderSize() const;
+
+    /// @return buffers with sizes following the number of particles: reordering map and reordered data
+    virtual std::vector<GPUcontainer*> getContainers();
     
 protected:
     int changedStamp{-1};
+    int nBuilds{0};
+    int binnedSize{-1}; ///< number of particles already counted by binBulk() or externally, -1 if none
 
     DeviceBuffer<char> scanBuffer;
     DeviceBuffer<int> cellStarts, cellSizes, order;
 
+    CellListOrdering ordering{CellListOrdering::RowMajor};
+    int blocking{1};
+    DeviceBuffer<int> rowToCellMap, cellToRowMap;
+
+    /// state of the last build for the incremental builds, see _recordHistory()
+    float maxMovedFraction{0.0f};
+    bool historyValid{false};
+    int historyOrderSize{0};                 ///< size of the order at the last build
+    DeviceBuffer<int> historyStarts, historyCells;
+    DeviceBuffer<int> keptSlots, keptPrefix, cellFill;
+    DeviceBuffer<char> keptScanBuffer;
+
+    /// number of moved particles of the last incremental build, only read at the next build
+    static const int nFullBuildsAfterFallback = 10;
+    PinnedBuffer<int> nMoved;
+    cudaEvent_t movesCounted{nullptr};       ///< created by setIncrementalBuild()
+    int movesOf{0}, fullBuildsLeft{0};
+    bool movesPending{false};
+
+    CellListBuild buildMethod{CellListBuild::Atomics};
+    bool useRadixSort{false};                ///< method of the current build
+    DeviceBuffer<int> sortKeys, sortedKeys, sortIds, sortedIds;
+    DeviceBuffer<char> sortBuffer;
+
+    /// timing of the builds with CellListBuild::Auto, see _selectBuildMethod()
+    static const int nTuningBuilds = 6;
+    int tuningBuild{0}, tunedSize{0};
+    bool tuned{false};
+    std::vector<cudaEvent_t> tuningEvents;
+
+    DeviceBuffer<char> selectBuffer;
+    DeviceBuffer<int> activeCells;
+    PinnedBuffer<int> nActiveCells;
+    cudaEvent_t activeCellsCounted{nullptr}; ///< nActiveCells is on the host
+
+    /// table of the persistent channels for _reorderPersistentData()
+    PinnedBuffer<int> channelSizes;
+    PinnedBuffer<char*> channelSrc, channelDst;
+
     std::unique_ptr<LocalParticleVector> particlesDataContainer;
     LocalParticleVector *localPV; // will point to particlesDataContainer or pv->local() if Primary
     
     ParticleVector* pv;
 
     bool _checkNeedBuild() const;
+    bool _isRowMajor() const;
+    void _updateCellMaps();
     void _updateExtraDataChannels(cudaStream_t stream);
     void _computeCellSizes(cudaStream_t stream);
     void _computeCellStarts(cudaStream_t stream);
+    void _initActiveCells();
+    void _compactActiveCells(cudaStream_t stream);
     void _reorderData(cudaStream_t stream);
+    void _sortByCell(cudaStream_t stream);
+    void _gatherSorted(cudaStream_t stream);
     void _reorderPersistentData(cudaStream_t stream);
+
+    bool _useIncremental();
+    void _buildIncremental(cudaStream_t stream);
+    void _recordHistory(cudaStream_t stream);
+
+    int _selectBuildMethod();
+    void _finishTuning();
     
     void _build(cudaStream_t stream);
+
+    /// account the memory of the buffers under the name of the cell-list, see MemoryPool
+    void setOwner();
         
     void _accumulateForces(cudaStream_t stream);
     void _accumulateExtraData(const std::string& channelName, cudaStream_t stream);
@@ -174,4 +370,46 @@ protected:
     std::string makeName() const override;
 };
 
+/**
+ * Cell-list with cells made of n^3 cells of a finer cell-list, which does all the work:
+ * the fine list stores its cells by blocks (see CellList::setBlocking()), and every coarse
+ * cell is the contiguous range of particles of one block.
+ * Building only derives the cell starts from the fine ones, the particles, their order
+ * and the channels are those of the fine list, which must be a PrimaryCellList:
+ * the forces do not have to be accumulated back, and the interactions of both lists
+ * add up in the same particle vector
+ */
+class CoarseCellList : public CellList
+{
+public:
+
+    CoarseCellList(ParticleVector *pv, PrimaryCellList *fine, int n, float3 localDomainSize);
+    ~CoarseCellList();
+
+    CellListInfo cellInfo() override;
+
+    void build(cudaStream_t stream) override;
 
+    /// the fine list is binned for itself, the external binning is forwarded to it
+    void binBulk(cudaStream_t stream) override;
+    CellListInfo beginExternalBinning(cudaStream_t stream) override;
+    void endExternalBinning(int nBinned) override;
+
+    /// also applied to the blocks of the fine list
+    void setOrdering(CellListOrdering ordering) override;
+
+    void accumulateChannels(const std::vector<std::string>& channelNames, cudaStream_t stream) override;
+    void gatherChannels(const std::vector<std::string>& channelNames, cudaStream_t stream) override;
+
+    int getOrderSize() const override;
+    std::vector<GPUcontainer*> getContainers() override;
+
+    CellList* getFineList();
+
+protected:
+
+    PrimaryCellList *fine;
+    int fineBuildId{-1}; ///< CellList::getNumBuilds() of the fine list at the last derivation
+
+    std::string makeName() const override;
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <core/logger.h>
+#include <core/utils/memory_pool.h>
 
 #include <cstring>
 #include <cassert>
@@ -9,6 +10,7 @@
 #include <algorithm>
 #include <typeinfo>
 #include <cmath>
+#include <string>
 
 #include <cuda_runtime.h>
 
@@ -21,6 +23,13 @@ enum class ContainersSynch
     Asynch
 };
 
+/// Capacity allocated to hold \p n elements: 10% more plus a few elements, rounded up to 128
+inline int conservativeCapacity(int n)
+{
+    const int conservative_estimate = (int)ceil(1.1 * n + 10);
+    return 128 * ((conservative_estimate + 127) / 128);
+}
+
 /**
  * Interface of containers of device (GPU) data
  */
@@ -29,8 +38,10 @@ class GPUcontainer
 public:
     virtual int size() const = 0;                                      ///< @return number of stored elements
     virtual int datatype_size() const = 0;                             ///< @return sizeof( element )
+    virtual int getCapacity() const = 0;                               ///< @return number of elements that fit without reallocation
 
     virtual void* genericDevPtr() const = 0;                           ///< @return device pointer to the data
+    virtual void* genericHostPtr() const { return nullptr; }           ///< @return host pointer to the data, nullptr if the container has no host copy
 
     virtual void resize_anew(const int n) = 0;                         ///< Resize container, don't care about the data. @param n new size, must be >= 0
     virtual void resize     (const int n, cudaStream_t stream) = 0;    ///< Resize container, keep stored data
@@ -38,10 +49,27 @@ public:
                                                                        ///< @param stream data will be copied on that CUDA stream
 
     virtual void clearDevice(cudaStream_t stream) = 0;
+
+    /**
+     * Release the memory beyond the capacity that would be allocated for the current size, keep stored data.
+     * Old memory goes back to the MemoryPool, so it is safe to call while the GPU is busy,
+     * but all the pointers to the data retrieved before become invalid
+     *
+     * @param stream data will be copied on that CUDA stream
+     */
+    virtual void shrink(cudaStream_t stream) = 0;
+
+    /// name under which the memory is accounted in the MemoryPool, see #owner
+    virtual void setOwner(const std::string& name) { owner = name; }
+    const std::string& getOwner() const            { return owner; }
     
     virtual GPUcontainer* produce() const = 0;                         ///< Create a new instance of the concrete container implementation
 
     virtual ~GPUcontainer() = default;
+
+protected:
+    /// usually "<simulation object name>:<channel>"
+    std::string owner{"unnamed"};
 };
 
 //==================================================================================================================
@@ -51,8 +79,9 @@ public:
 /**
  * This container keeps data only on the device (GPU)
  *
- * Never releases any memory, keeps a buffer big enough to
- * store maximum number of elements it ever held
+ * Unless shrink() is called, never releases any memory, keeps a buffer big enough to
+ * store maximum number of elements it ever held.
+ * Memory comes from the MemoryPool, such that growing does not synchronize the device
  */
 template<typename T>
 class DeviceBuffer : public GPUcontainer
@@ -79,17 +108,21 @@ private:
 
         if (n < 0) die("Requested negative size %d", n);
         _size = n;
-        if (capacity >= n) return;
+        if (capacity >= n)
+        {
+            MemoryPool::device().setUsed(devptr, sizeof(T) * _size);
+            return;
+        }
 
-        const int conservative_estimate = (int)ceil(1.1 * n + 10);
-        capacity = 128 * ((conservative_estimate + 127) / 128);
+        capacity = conservativeCapacity(n);
 
-        CUDA_Check(cudaMalloc(&devptr, sizeof(T) * capacity));
+        devptr = (T*) MemoryPool::device().allocate(sizeof(T) * capacity, owner);
+        MemoryPool::device().setUsed(devptr, sizeof(T) * _size);
 
         if (copy && dold != nullptr)
             if (oldsize > 0) CUDA_Check(cudaMemcpyAsync(devptr, dold, sizeof(T) * oldsize, cudaMemcpyDeviceToDevice, stream));
 
-        CUDA_Check(cudaFree(dold));
+        MemoryPool::device().deallocate(dold);
 
         debug4("Allocating DeviceBuffer<%s> from %d x %d  to %d x %d",
                 typeid(T).name(),
@@ -119,6 +152,7 @@ public:
             capacity = b.capacity;
             _size = b._size;
             devptr = b.devptr;
+            owner = b.owner;
 
             b.capacity = 0;
             b._size = 0;
@@ -133,13 +167,14 @@ public:
     {
         if (devptr != nullptr)
         {
-            CUDA_Check(cudaFree(devptr));
+            MemoryPool::device().deallocate(devptr);
             debug4("Destroying DeviceBuffer<%s>", typeid(T).name());
         }
     }
 
     inline int datatype_size() const final { return sizeof(T); }
     inline int size()          const final { return _size; }
+    inline int getCapacity()   const final { return capacity; }
 
     inline void* genericDevPtr() const final { return (void*) devPtr(); }
 
@@ -148,6 +183,34 @@ public:
 
     inline GPUcontainer* produce() const final { return new DeviceBuffer<T>(); }
 
+    void shrink(cudaStream_t stream) final
+    {
+        const int newCapacity = _size > 0 ? conservativeCapacity(_size) : 0;
+        if (newCapacity >= capacity) return;
+
+        debug4("Shrinking DeviceBuffer<%s> from capacity %d to %d (size %d)",
+               typeid(T).name(), capacity, newCapacity, _size);
+
+        T * dold = devptr;
+        capacity = newCapacity;
+        devptr = nullptr;
+
+        if (capacity > 0)
+        {
+            devptr = (T*) MemoryPool::device().allocate(sizeof(T) * capacity, owner);
+            MemoryPool::device().setUsed(devptr, sizeof(T) * _size);
+            if (_size > 0) CUDA_Check( cudaMemcpyAsync(devptr, dold, sizeof(T) * _size, cudaMemcpyDeviceToDevice, stream) );
+        }
+
+        MemoryPool::device().deallocate(dold);
+    }
+
+    void setOwner(const std::string& name) final
+    {
+        GPUcontainer::setOwner(name);
+        MemoryPool::device().setOwner(devptr, owner);
+    }
+
     /// @return typed device pointer to data
     inline T* devPtr() const { return devptr; }
 
@@ -220,6 +283,7 @@ private:
     int capacity;   ///< Storage buffer size
     int _size;      ///< Number of elements stored now
     T * hostptr;    ///< Host pointer to data
+    std::string owner{"unnamed"};  ///< see GPUcontainer::setOwner()
 
     /**
      * Set #_size = \e n. If \e n > #capacity, allocate more memory
@@ -237,17 +301,21 @@ private:
 
         if (n < 0) die("Requested negative size %d", n);
         _size = n;
-        if (capacity >= n) return;
+        if (capacity >= n)
+        {
+            MemoryPool::host().setUsed(hostptr, sizeof(T) * _size);
+            return;
+        }
 
-        const int conservative_estimate = (int)ceil(1.1 * n + 10);
-        capacity = 128 * ((conservative_estimate + 127) / 128);
+        capacity = conservativeCapacity(n);
 
-        CUDA_Check(cudaHostAlloc(&hostptr, sizeof(T) * capacity, 0));
+        hostptr = (T*) MemoryPool::host().allocate(sizeof(T) * capacity, owner);
+        MemoryPool::host().setUsed(hostptr, sizeof(T) * _size);
 
         if (copy && hold != nullptr)
             if (oldsize > 0) memcpy(hostptr, hold, sizeof(T) * oldsize);
 
-        CUDA_Check(cudaFreeHost(hold));
+        MemoryPool::host().deallocate(hold);
 
         debug4("Allocating HostBuffer<%s> from %d x %d  to %d x %d",
                 typeid(T).name(),
@@ -272,6 +340,7 @@ public:
             capacity = b.capacity;
             _size = b._size;
             hostptr = b.hostptr;
+            owner = b.owner;
 
             b.capacity = 0;
             b._size = 0;
@@ -284,13 +353,19 @@ public:
     /// Release resources and report if debug level is high enough
     ~HostBuffer()
     {
-        CUDA_Check(cudaFreeHost(hostptr));
+        MemoryPool::host().deallocate(hostptr);
         debug4("Destroying HostBuffer<%s>", typeid(T).name());
     }
 
     inline int datatype_size() const { return sizeof(T); }
     inline int size()          const { return _size; }
 
+    void setOwner(const std::string& name)
+    {
+        owner = name;
+        MemoryPool::host().setOwner(hostptr, owner);
+    }
+
     inline T* hostPtr() const { return hostptr; }
     inline T* data()    const { return hostptr; } /// For uniformity with std::vector
 
@@ -364,7 +439,7 @@ public:
  *    Use downloadFromDevice() and uploadToDevice() MANUALLY to sync
  * \endrst
  *
- * Never releases any memory, keeps a buffer big enough to
+ * Unless shrink() is called, never releases any memory, keeps a buffer big enough to
  * store maximum number of elements it ever held
  */
 template<typename T>
@@ -395,13 +470,19 @@ private:
 
         if (n < 0) die("Requested negative size %d", n);
         _size = n;
-        if (capacity >= n) return;
+        if (capacity >= n)
+        {
+            MemoryPool::host()  .setUsed(hostptr, sizeof(T) * _size);
+            MemoryPool::device().setUsed(devptr,  sizeof(T) * _size);
+            return;
+        }
 
-        const int conservative_estimate = (int)ceil(1.1 * n + 10);
-        capacity = 128 * ((conservative_estimate + 127) / 128);
+        capacity = conservativeCapacity(n);
 
-        CUDA_Check(cudaHostAlloc(&hostptr, sizeof(T) * capacity, 0));
-        CUDA_Check(cudaMalloc(&devptr, sizeof(T) * capacity));
+        hostptr = (T*) MemoryPool::host()  .allocate(sizeof(T) * capacity, owner);
+        devptr  = (T*) MemoryPool::device().allocate(sizeof(T) * capacity, owner);
+        MemoryPool::host()  .setUsed(hostptr, sizeof(T) * _size);
+        MemoryPool::device().setUsed(devptr,  sizeof(T) * _size);
 
         if (copy && hold != nullptr && oldsize > 0)
         {
@@ -410,8 +491,8 @@ private:
             CUDA_Check( cudaStreamSynchronize(stream) );
         }
 
-        CUDA_Check(cudaFreeHost(hold));
-        CUDA_Check(cudaFree(dold));
+        MemoryPool::host()  .deallocate(hold);
+        MemoryPool::device().deallocate(dold);
 
         debug4("Allocating PinnedBuffer<%s> from %d x %d  to %d x %d",
                 typeid(T).name(),
@@ -429,6 +510,7 @@ public:
     PinnedBuffer (const PinnedBuffer& b) :
         capacity(0), _size(0), hostptr(nullptr), devptr(nullptr)
     {
+        owner = b.owner;
         this->copy(b);
     }
 
@@ -447,6 +529,7 @@ public:
             _size = b._size;
             hostptr = b.hostptr;
             devptr = b.devptr;
+            owner = b.owner;
 
             b.capacity = 0;
             b._size = 0;
@@ -462,22 +545,64 @@ public:
     {
         if (devptr != nullptr)
         {
-            CUDA_Check(cudaFreeHost(hostptr));
-            CUDA_Check(cudaFree(devptr));
+            MemoryPool::host()  .deallocate(hostptr);
+            MemoryPool::device().deallocate(devptr);
             debug4("Destroying PinnedBuffer<%s>", typeid(T).name());
         }
     }
 
     inline int datatype_size() const final { return sizeof(T); }
     inline int size()          const final { return _size; }
+    inline int getCapacity()   const final { return capacity; }
 
-    inline void* genericDevPtr() const final { return (void*) devPtr(); }
+    inline void* genericDevPtr()  const final { return (void*) devPtr(); }
+    inline void* genericHostPtr() const final { return (void*) hostPtr(); }
 
     inline void resize     (const int n, cudaStream_t stream) final { _resize(n, stream, true);  }
     inline void resize_anew(const int n)                      final { _resize(n, 0,      false); }
 
     inline GPUcontainer* produce() const final { return new PinnedBuffer<T>(); }
 
+    /// Both host and device data are kept
+    void shrink(cudaStream_t stream) final
+    {
+        const int newCapacity = _size > 0 ? conservativeCapacity(_size) : 0;
+        if (newCapacity >= capacity) return;
+
+        debug4("Shrinking PinnedBuffer<%s> from capacity %d to %d (size %d)",
+               typeid(T).name(), capacity, newCapacity, _size);
+
+        T * hold = hostptr;
+        T * dold = devptr;
+        capacity = newCapacity;
+        hostptr = nullptr;
+        devptr  = nullptr;
+
+        if (capacity > 0)
+        {
+            hostptr = (T*) MemoryPool::host()  .allocate(sizeof(T) * capacity, owner);
+            devptr  = (T*) MemoryPool::device().allocate(sizeof(T) * capacity, owner);
+            MemoryPool::host()  .setUsed(hostptr, sizeof(T) * _size);
+            MemoryPool::device().setUsed(devptr,  sizeof(T) * _size);
+
+            if (_size > 0)
+            {
+                memcpy(hostptr, hold, sizeof(T) * _size);
+                CUDA_Check( cudaMemcpyAsync(devptr, dold, sizeof(T) * _size, cudaMemcpyDeviceToDevice, stream) );
+            }
+        }
+
+        MemoryPool::host()  .deallocate(hold);
+        MemoryPool::device().deallocate(dold);
+    }
+
+    void setOwner(const std::string& name) final
+    {
+        GPUcontainer::setOwner(name);
+        MemoryPool::host()  .setOwner(hostptr, owner);
+        MemoryPool::device().setOwner(devptr,  owner);
+    }
+
     inline T* hostPtr() const { return hostptr; }  ///< @return typed host pointer to data
     inline T* data()    const { return hostptr; }  /// For uniformity with std::vector
     inline T* devPtr()  const { return devptr; }   ///< @return typed device pointer to data
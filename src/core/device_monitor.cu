@@ -0,0 +1,114 @@
+#include "device_monitor.h"
+
+#include <core/logger.h>
+#include <core/pvs/particle_vector.h>
+#include <core/pvs/views/pv.h>
+#include <core/utils/cuda_common.h>
+#include <core/utils/kernel_launch.h>
+
+namespace DeviceMonitorKernels
+{
+
+__global__ void checkParticles(PVview view, float maxDisplacement2, float dt, DeviceMonitorHandler monitor)
+{
+    const int pid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (pid >= view.size) return;
+
+    const float3 f = make_float3(view.forces[pid]);
+    if (!isfinite(f.x) || !isfinite(f.y) || !isfinite(f.z))
+        monitor.report(MonitorCheck::NaNForce);
+
+    if (maxDisplacement2 <= 0.0f) return;
+
+    // the integrators move the particles by u*dt in one step
+    const float3 u = make_float3(view.particles[2*pid + 1]);
+    if (!(dot(u, u) * dt*dt <= maxDisplacement2))
+        monitor.report(MonitorCheck::Displacement);
+}
+
+} // namespace DeviceMonitorKernels
+
+DeviceMonitor::DeviceMonitor(float maxDisplacement) :
+    maxDisplacement(maxDisplacement)
+{
+    const int n = static_cast<int>(MonitorCheck::Count);
+
+    CUDA_Check( cudaHostAlloc(&hostCounters, n * sizeof(int), cudaHostAllocMapped) );
+    CUDA_Check( cudaHostGetDevicePointer(&devCounters, hostCounters, 0) );
+    for (int i = 0; i < n; i++)
+        hostCounters[i] = 0;
+
+    CUDA_Check( cudaEventCreateWithFlags(&checked, cudaEventDisableTiming) );
+}
+
+DeviceMonitor::~DeviceMonitor()
+{
+    CUDA_Check( cudaEventDestroy(checked) );
+    CUDA_Check( cudaFreeHost(hostCounters) );
+}
+
+DeviceMonitorHandler DeviceMonitor::handler() const
+{
+    return {devCounters};
+}
+
+void DeviceMonitor::checkParticles(ParticleVector *pv, float dt, cudaStream_t stream)
+{
+    PVview view(pv, pv->local());
+    if (view.size == 0) return;
+
+    const int nthreads = 128;
+    SAFE_KERNEL_LAUNCH(
+            DeviceMonitorKernels::checkParticles,
+            getNblocks(view.size, nthreads), nthreads, 0, stream,
+            view, maxDisplacement * maxDisplacement, dt, handler() );
+}
+
+void DeviceMonitor::flush(cudaStream_t stream, int step)
+{
+    if (pending)
+    {
+        const cudaError_t status = cudaEventQuery(checked);
+        if (status == cudaErrorNotReady)
+            return;   // the next flush covers the checks enqueued meanwhile
+
+        CUDA_Check( status );
+        pending = false;
+        handle(checkedStep);
+    }
+
+    CUDA_Check( cudaEventRecord(checked, stream) );
+    pending = true;
+    checkedStep = step;
+}
+
+void DeviceMonitor::wait(int step)
+{
+    CUDA_Check( cudaDeviceSynchronize() );
+    pending = false;
+    handle(step);
+}
+
+void DeviceMonitor::handle(int step)
+{
+    const volatile int *counters = hostCounters;
+    int fresh[static_cast<int>(MonitorCheck::Count)];
+
+    for (int i = 0; i < static_cast<int>(MonitorCheck::Count); i++)
+    {
+        const int current = counters[i];
+        fresh[i] = current - reported[i];
+        reported[i] = current;
+    }
+
+    const int nInside       = fresh[static_cast<int>(MonitorCheck::InsideWall)];
+    const int nNaN          = fresh[static_cast<int>(MonitorCheck::NaNForce)];
+    const int nDisplacement = fresh[static_cast<int>(MonitorCheck::Displacement)];
+
+    if (nInside > 0)
+        warn("Device monitor: %d particles found inside the walls by step %d", nInside, step);
+
+    if (nNaN > 0 || nDisplacement > 0)
+        die("Device monitor: by step %d, %d particles had non-finite forces and %d moved further than %f in one step",
+            step, nNaN, nDisplacement, maxDisplacement);
+}
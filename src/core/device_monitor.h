@@ -0,0 +1,68 @@
+#pragma once
+
+#include <core/utils/cpu_gpu_defines.h>
+
+#include <cuda_runtime.h>
+#include <string>
+
+class ParticleVector;
+
+/// what the device checks report, one counter each
+enum class MonitorCheck
+{
+    InsideWall = 0, NaNForce, Displacement, Count
+};
+
+/**
+ * Device side of DeviceMonitor: the kernels increment the counter of a failed check.
+ * The counters live in mapped pinned memory, such that nothing is downloaded
+ */
+struct DeviceMonitorHandler
+{
+    int *counters {nullptr};
+
+    __D__ inline void report(MonitorCheck check) const
+    {
+        atomicAdd(counters + static_cast<int>(check), 1);
+    }
+};
+
+/**
+ * Sanity checks of the simulation that never synchronize the host with the device.
+ *
+ * The checking kernels only write to the mapped counters when a check fails.
+ * flush() closes the checks enqueued so far with an event and polls the event
+ * of the previous flush without waiting; a failure is thus noticed one or a few steps late.
+ * The particles inside the walls are reported, the NaN forces and the large displacements abort.
+ * The counters only grow, the host reports the increments since the last report
+ */
+class DeviceMonitor
+{
+public:
+    /// \p maxDisplacement of a particle within one step, not checked if not positive
+    DeviceMonitor(float maxDisplacement);
+    ~DeviceMonitor();
+
+    DeviceMonitorHandler handler() const;
+
+    /// check the local forces and displacements of \p pv, after the integration of a time step of \p dt
+    void checkParticles(ParticleVector *pv, float dt, cudaStream_t stream);
+
+    /// close the checks enqueued on \p stream and handle the previously closed ones if they are done
+    void flush(cudaStream_t stream, int step);
+
+    /// wait for all the enqueued checks and handle them
+    void wait(int step);
+
+private:
+    float maxDisplacement;
+
+    int *hostCounters {nullptr}, *devCounters {nullptr};
+    int reported[static_cast<int>(MonitorCheck::Count)] {};
+
+    cudaEvent_t checked;
+    bool pending {false};
+    int checkedStep {0};   ///< step of the last recorded event
+
+    void handle(int step);
+};
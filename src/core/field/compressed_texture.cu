@@ -0,0 +1,159 @@
+#include "interface.h"
+
+#include <core/containers.h>
+#include <core/logger.h>
+#include <core/utils/cuda_common.h>
+#include <core/utils/kernel_launch.h>
+
+#include <cuda_fp16.h>
+#include <texture_types.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace CompressedTextureKernels
+{
+
+/// One thread per grid node
+__global__ void toHalf(const float *field, int n, __half *out)
+{
+    const int nid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (nid >= n) return;
+
+    out[nid] = __float2half_rn(field[nid]);
+}
+
+/// One thread per grid node, read back in [-1, 1] by the texture units
+__global__ void toNormalized(const float *field, int n, float band, short *out)
+{
+    const int nid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (nid >= n) return;
+
+    const float v = min(max(field[nid] / band, -1.0f), 1.0f);
+    out[nid] = __float2int_rn(v * 32767.0f);
+}
+
+/**
+ * One thread per grid cell: compare the texture with the trilinear interpolation of the float grid values
+ * at a point inside the cell, away from the nodes and from the middle of the cell, where the 9 bit weights
+ * of the hardware filtering are exact. Only the points where the field is within \p band of zero count
+ */
+__global__ void maxInterpolationError(const float *field, int3 resolution, FieldDeviceHandler handler,
+                                      float3 h, float3 extendedDomainSize, float band, int *maxError)
+{
+    const int3 ncells = resolution - 1;
+    const int cid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (cid >= ncells.x * ncells.y * ncells.z) return;
+
+    const int3 id = make_int3(cid % ncells.x, (cid / ncells.x) % ncells.y, cid / (ncells.x * ncells.y));
+    const float3 lambda = make_float3(0.37f, 0.61f, 0.83f);
+
+    auto value = [&] (int dx, int dy, int dz) {
+        return field[ ((id.z+dz)*resolution.y + id.y+dy)*resolution.x + id.x+dx ];
+    };
+
+    const float sx00 = value(0, 0, 0) * (1 - lambda.x) + lambda.x * value(1, 0, 0);
+    const float sx01 = value(0, 0, 1) * (1 - lambda.x) + lambda.x * value(1, 0, 1);
+    const float sx10 = value(0, 1, 0) * (1 - lambda.x) + lambda.x * value(1, 1, 0);
+    const float sx11 = value(0, 1, 1) * (1 - lambda.x) + lambda.x * value(1, 1, 1);
+
+    const float sxy0 = sx00 * (1 - lambda.y) + lambda.y * sx10;
+    const float sxy1 = sx01 * (1 - lambda.y) + lambda.y * sx11;
+
+    const float reference = sxy0 * (1 - lambda.z) + lambda.z * sxy1;
+    if (fabsf(reference) >= band) return;
+
+    const float3 x = (make_float3(id) + lambda) * h - 0.5f * extendedDomainSize;
+    const float error = fabsf(handler(x) - reference);
+
+    // non negative floats compare as their bits
+    atomicMax(maxError, __float_as_int(error));
+}
+
+} // namespace CompressedTextureKernels
+
+void Field::setupCompressedTexture(const float *fieldDevPtr)
+{
+    const bool normalized = storage == FieldStorage::Normalized;
+
+    debug("setting up the %s 16 bit texture of field '%s'", normalized ? "normalized" : "half", name.c_str());
+
+    if (normalized && storageBand <= 0.0f)
+        die("Field '%s': the normalized storage needs a positive band, got %g", name.c_str(), storageBand);
+
+    const int n = resolution.x * resolution.y * resolution.z;
+    DeviceBuffer<short> data(n);
+
+    const int nthreads = 128;
+
+    if (normalized)
+        SAFE_KERNEL_LAUNCH(
+                CompressedTextureKernels::toNormalized,
+                getNblocks(n, nthreads), nthreads, 0, 0,
+                fieldDevPtr, n, storageBand, data.devPtr() );
+    else
+        SAFE_KERNEL_LAUNCH(
+                CompressedTextureKernels::toHalf,
+                getNblocks(n, nthreads), nthreads, 0, 0,
+                fieldDevPtr, n, (__half*) data.devPtr() );
+
+    auto chDesc = normalized ? cudaCreateChannelDesc<short>() : cudaCreateChannelDescHalf();
+    CUDA_Check( cudaMalloc3DArray(&fieldArray, &chDesc, make_cudaExtent(resolution.x, resolution.y, resolution.z)) );
+
+    cudaMemcpy3DParms copyParams = {};
+    copyParams.srcPtr   = make_cudaPitchedPtr((void*)data.devPtr(), resolution.x*sizeof(short), resolution.x, resolution.y);
+    copyParams.dstArray = fieldArray;
+    copyParams.extent   = make_cudaExtent(resolution.x, resolution.y, resolution.z);
+    copyParams.kind     = cudaMemcpyDeviceToDevice;
+
+    CUDA_Check( cudaMemcpy3D(&copyParams) );
+
+    cudaResourceDesc resDesc = {};
+    resDesc.resType         = cudaResourceTypeArray;
+    resDesc.res.array.array = fieldArray;
+
+    cudaTextureDesc texDesc = {};
+    texDesc.addressMode[0]   = cudaAddressModeWrap;
+    texDesc.addressMode[1]   = cudaAddressModeWrap;
+    texDesc.addressMode[2]   = cudaAddressModeWrap;
+    texDesc.filterMode       = cudaFilterModeLinear;
+    texDesc.readMode         = normalized ? cudaReadModeNormalizedFloat : cudaReadModeElementType;
+    texDesc.normalizedCoords = 0;
+
+    CUDA_Check( cudaCreateTextureObject(&fieldTex, &resDesc, &texDesc, nullptr) );
+
+    filtered   = true;
+    valueScale = normalized ? storageBand : 1.0f;
+
+    // accuracy against the float values, where the field matters
+    const float band = normalized ? storageBand : std::min({margin3.x, margin3.y, margin3.z});
+    const int3 ncells = resolution - 1;
+    const int totCells = ncells.x * ncells.y * ncells.z;
+
+    PinnedBuffer<int> maxError(1);
+    maxError.clear(0);
+
+    SAFE_KERNEL_LAUNCH(
+            CompressedTextureKernels::maxInterpolationError,
+            getNblocks(totCells, nthreads), nthreads, 0, 0,
+            fieldDevPtr, resolution, handler(), h, extendedDomainSize, band, maxError.devPtr() );
+
+    maxError.downloadFromDevice(0, ContainersSynch::Synch);
+
+    float error;
+    memcpy(&error, maxError.hostPtr(), sizeof(float));
+
+    const float minh = std::min({h.x, h.y, h.z});
+    const float tolerance = 0.05f * minh;
+
+    info("Field '%s': %s 16 bit texture of %.1f MB instead of %.1f MB, largest error %g (%.2g grid spacings) within %g of zero",
+         name.c_str(), normalized ? "normalized" : "half",
+         n * sizeof(short) / (1024.0*1024.0), n * sizeof(float) / (1024.0*1024.0),
+         error, error / minh, band);
+
+    if (error > tolerance)
+        warn("Field '%s': the 16 bit texture is off by up to %g, more than %g, consider the float storage%s",
+             name.c_str(), error, tolerance, normalized ? " or a narrower band" : "");
+
+    CUDA_Check( cudaDeviceSynchronize() );
+}
@@ -1,7 +1,9 @@
 #include "from_file.h"
 
+#include <algorithm>
 #include <fstream>
 #include <texture_types.h>
+#include <vector>
 #include <core/utils/kernel_launch.h>
 #include <core/utils/cuda_common.h>
 
@@ -163,33 +165,107 @@ static void readHeader(const std::string fileName, const MPI_Comm& comm, int3& s
     MPI_Check( MPI_Bcast(&endHeader_byte,   1, MPI_INT64_T,   0, comm) );
 }
 
-static void readSdf(const std::string fileName, const MPI_Comm& comm, int64_t fullSdfSize_byte, int64_t endHeader_byte, int nranks, int rank, std::vector<float>& fullSdfData)
+/**
+ * Contiguous ranges of the file along one dimension of size \p n
+ * covering the periodic range [start, start+size)
+ */
+struct FileRange
 {
-    // Read part and allgather
-    const int64_t readPerProc_byte = (fullSdfSize_byte + nranks - 1) / (int64_t)nranks;
-    std::vector<char> readBuffer(readPerProc_byte);
+    int fileStart, localStart, size;
+};
 
-    // Limits in bytes
-    const int64_t readStart = readPerProc_byte * rank + endHeader_byte;
-    const int64_t readEnd   = std::min( readStart + readPerProc_byte, fullSdfSize_byte + endHeader_byte);
+static std::vector<FileRange> periodicRanges(int start, int size, int n)
+{
+    std::vector<FileRange> ranges;
+
+    for (int covered = 0; covered < size; )
+    {
+        const int fileStart = ((start + covered) % n + n) % n;
+        const int count = std::min(n - fileStart, size - covered);
+
+        ranges.push_back({fileStart, covered, count});
+        covered += count;
+    }
+
+    return ranges;
+}
+
+/**
+ * Each rank only reads its piece [startId, startId+resolution) of the periodic sdf grid,
+ * with collective MPI-IO reads of subarrays, one per contiguous box of the file.
+ * All the ranks must perform the same number of collective reads, those with fewer boxes read nothing
+ */
+static void readSdfPiece(const std::string fileName, const MPI_Comm& comm, int64_t endHeader_byte,
+                         int3 sdfResolution, int3 startId, int3 resolution, PinnedBuffer<float>& localSdfData)
+{
+    localSdfData.resize_anew( resolution.x * resolution.y * resolution.z );
+    auto locSdfDataPtr = localSdfData.hostPtr();
+
+    const auto xr = periodicRanges(startId.x, resolution.x, sdfResolution.x);
+    const auto yr = periodicRanges(startId.y, resolution.y, sdfResolution.y);
+    const auto zr = periodicRanges(startId.z, resolution.z, sdfResolution.z);
+
+    struct Box { FileRange x, y, z; };
+    std::vector<Box> boxes;
+    for (auto& z : zr)
+        for (auto& y : yr)
+            for (auto& x : xr)
+                boxes.push_back({x, y, z});
+
+    int nBoxes = boxes.size(), maxBoxes;
+    MPI_Check( MPI_Allreduce(&nBoxes, &maxBoxes, 1, MPI_INT, MPI_MAX, comm) );
 
     MPI_File fh;
     MPI_Status status;
     MPI_Check( MPI_File_open(comm, fileName.c_str(), MPI_MODE_RDONLY, MPI_INFO_NULL, &fh) );  // TODO: MPI_Info
-    MPI_Check( MPI_File_read_at_all(fh, readStart, readBuffer.data(), readEnd - readStart, MPI_BYTE, &status) );
-    // TODO: check that we read just what we asked
-    // MPI_Get_count only return int though
 
-    fullSdfData.resize(readPerProc_byte * nranks / sizeof(float));  // May be bigger than fullSdfSize, to make gather easier
-    MPI_Check( MPI_Allgather(readBuffer.data(), readPerProc_byte, MPI_BYTE, fullSdfData.data(), readPerProc_byte, MPI_BYTE, comm) );
+    std::vector<float> readBuffer;
+    for (int b = 0; b < maxBoxes; b++)
+    {
+        if (b >= nBoxes)
+        {
+            MPI_Check( MPI_File_set_view(fh, endHeader_byte, MPI_FLOAT, MPI_FLOAT, "native", MPI_INFO_NULL) );
+            MPI_Check( MPI_File_read_all(fh, nullptr, 0, MPI_FLOAT, &status) );
+            continue;
+        }
+
+        const auto& box = boxes[b];
+        int sizes[3]    = { sdfResolution.z, sdfResolution.y, sdfResolution.x };
+        int subsizes[3] = { box.z.size,      box.y.size,      box.x.size      };
+        int starts[3]   = { box.z.fileStart, box.y.fileStart, box.x.fileStart };
+
+        MPI_Datatype fileType;
+        MPI_Check( MPI_Type_create_subarray(3, sizes, subsizes, starts, MPI_ORDER_C, MPI_FLOAT, &fileType) );
+        MPI_Check( MPI_Type_commit(&fileType) );
+
+        readBuffer.resize(box.x.size * box.y.size * box.z.size);
+        MPI_Check( MPI_File_set_view(fh, endHeader_byte, MPI_FLOAT, fileType, "native", MPI_INFO_NULL) );
+        MPI_Check( MPI_File_read_all(fh, readBuffer.data(), readBuffer.size(), MPI_FLOAT, &status) );
+        MPI_Check( MPI_Type_free(&fileType) );
+
+        for (int k = 0; k < box.z.size; k++)
+            for (int j = 0; j < box.y.size; j++)
+                for (int i = 0; i < box.x.size; i++)
+                {
+                    const int li = box.x.localStart + i;
+                    const int lj = box.y.localStart + j;
+                    const int lk = box.z.localStart + k;
+
+                    locSdfDataPtr[ (lk*resolution.y + lj)*resolution.x + li ] =
+                            readBuffer[ (k*box.y.size + j)*box.x.size + i ];
+                }
+    }
+
+    MPI_Check( MPI_File_close(&fh) );
 }
 
-static void prepareRelevantSdfPiece(const float* fullSdfData, float3 extendedDomainStart, float3 extendedDomainSize,
+static void prepareRelevantSdfPiece(const std::string fileName, const MPI_Comm& comm, int64_t endHeader_byte,
+                                    float3 extendedDomainStart, float3 extendedDomainSize,
                                     float3 initialSdfH, int3 initialSdfResolution,
                                     int3& resolution, float3& offset, PinnedBuffer<float>& localSdfData)
 {
     // Find your relevant chunk of data
-    // We cannot send big sdf files directly, so we'll carve a piece now
+    // We cannot read big sdf files entirely, so each rank reads its own piece
 
     const int margin = 3; // +2 from cubic interpolation, +1 from possible round-off errors
     const int3 startId = make_int3( floorf( extendedDomainStart                     / initialSdfH) ) - margin;
@@ -200,42 +276,41 @@ static void prepareRelevantSdfPiece(const float* fullSdfData, float3 extendedDom
 
     resolution = endId - startId;
 
-    localSdfData.resize( resolution.x * resolution.y * resolution.z, 0 );
-    auto locSdfDataPtr = localSdfData.hostPtr();
+    readSdfPiece(fileName, comm, endHeader_byte, initialSdfResolution, startId, resolution, localSdfData);
+}
 
-    for (int k = 0; k < resolution.z; k++)
-        for (int j = 0; j < resolution.y; j++)
-            for (int i = 0; i < resolution.x; i++)
-            {
-                const int origIx = (i+startId.x + initialSdfResolution.x) % initialSdfResolution.x;
-                const int origIy = (j+startId.y + initialSdfResolution.y) % initialSdfResolution.y;
-                const int origIz = (k+startId.z + initialSdfResolution.z) % initialSdfResolution.z;
+FieldFromFile::FieldFromFile(const YmrState *state, std::string name, std::string fieldFileName, float3 h,
+                             float narrowBand, bool gradientTexture, float3 margin,
+                             FieldStorage storage, float storageBand) :
+    Field(state, name, h, margin),
+    fieldFileName(fieldFileName),
+    narrowBand(narrowBand),
+    gradientTexture(gradientTexture)
+{
+    if (narrowBand > 0.0f && storage != FieldStorage::Float)
+        die("Field '%s': the narrow band is only stored in floats", name.c_str());
 
-                locSdfDataPtr[ (k*resolution.y + j)*resolution.x + i ] =
-                        fullSdfData[ (origIz*initialSdfResolution.y + origIy)*initialSdfResolution.x + origIx ];
-            }
+    this->storage = storage;
+    this->storageBand = storageBand;
 }
 
-FieldFromFile::FieldFromFile(const YmrState *state, std::string name, std::string fieldFileName, float3 h) :
-    Field(state, name, h),
-    fieldFileName(fieldFileName)
-{}
-
 FieldFromFile::~FieldFromFile() = default;
 
 FieldFromFile::FieldFromFile(FieldFromFile&&) = default;
 
 void FieldFromFile::setup(const MPI_Comm& comm)
 {
+    if (isSetup) return;
+    isSetup = true;
+
     info("Setting up field from %s", fieldFileName.c_str());
 
     const auto domain = state->domain;
     
     CUDA_Check( cudaDeviceSynchronize() );
 
-    int nranks, rank;
+    int rank;
     int ranks[3], periods[3], coords[3];
-    MPI_Check( MPI_Comm_size(comm, &nranks) );
     MPI_Check( MPI_Comm_rank(comm, &rank) );
     MPI_Check( MPI_Cart_get (comm, 3, ranks, periods, coords) );
 
@@ -249,10 +324,6 @@ void FieldFromFile::setup(const MPI_Comm& comm)
     readHeader(fieldFileName, comm, initialSdfResolution, initialSdfExtent, fullSdfSize_byte, endHeader_byte, rank);
     float3 initialSdfH = domain.globalSize / make_float3(initialSdfResolution-1);
 
-    // Read heavy data
-    std::vector<float> fullSdfData;
-    readSdf(fieldFileName, comm, fullSdfSize_byte, endHeader_byte, nranks, rank, fullSdfData);
-
     const float3 scale3 = domain.globalSize / initialSdfExtent;
     if ( fabs(scale3.x - scale3.y) > 1e-5 || fabs(scale3.x - scale3.z) > 1e-5 )
         die("Sdf size and domain size mismatch");
@@ -261,7 +332,7 @@ void FieldFromFile::setup(const MPI_Comm& comm)
     int3 resolutionBeforeInterpolation;
     float3 offset;
     PinnedBuffer<float> localData;
-    prepareRelevantSdfPiece(fullSdfData.data(), domain.globalStart - margin3, extendedDomainSize,
+    prepareRelevantSdfPiece(fieldFileName, comm, endHeader_byte, domain.globalStart - margin3, extendedDomainSize,
                             initialSdfH, initialSdfResolution,
                             resolutionBeforeInterpolation, offset, localData);
 
@@ -280,5 +351,11 @@ void FieldFromFile::setup(const MPI_Comm& comm)
             localData.devPtr(), resolutionBeforeInterpolation, initialSdfH,
             fieldRawData.devPtr(), resolution, h, offset, lenScalingFactor );
 
-    setupArrayTexture(fieldRawData.devPtr());
+    if (narrowBand > 0.0f)
+        setupNarrowBand(fieldRawData.devPtr(), narrowBand);
+    else
+        setupArrayTexture(fieldRawData.devPtr());
+
+    if (gradientTexture)
+        setupGradientTexture(fieldRawData.devPtr());
 }
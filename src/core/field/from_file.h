@@ -1,16 +1,24 @@
+#pragma once
+
 #include "interface.h"
 
 class FieldFromFile : public Field
 {
 public:    
-    FieldFromFile(const YmrState *state, std::string name, std::string fieldFileName, float3 h);
+    FieldFromFile(const YmrState *state, std::string name, std::string fieldFileName, float3 h,
+                  float narrowBand = 0.0f, bool gradientTexture = false, float3 margin = {5, 5, 5},
+                  FieldStorage storage = FieldStorage::Float, float storageBand = 0.0f);
     ~FieldFromFile();
 
     FieldFromFile(FieldFromFile&&);
     
+    /// reads the file once, the later calls do nothing, see SharedFields
     void setup(const MPI_Comm& comm) override;
     
 protected:
     
     std::string fieldFileName;
+    float narrowBand;  ///< if positive, only keep the field within this distance of zero, see setupNarrowBand()
+    bool gradientTexture; ///< precompute the normals, see setupGradientTexture()
+    bool isSetup {false};
 };
@@ -1,10 +1,30 @@
 #include "from_function.h"
 
+#include <core/logger.h>
+
+#include <algorithm>
+
 FieldFromFunction::FieldFromFunction(const YmrState *state, std::string name, FieldFunction func, float3 h) :
-    Field(state, name, h),
-    func(func)
+    FieldFromFunction(state, name,
+                      FieldBatchFunction([func](const std::vector<float3>& positions) {
+                          std::vector<float> values(positions.size());
+                          for (size_t i = 0; i < positions.size(); i++)
+                              values[i] = func(positions[i]);
+                          return values;
+                      }),
+                      h)
 {}
 
+FieldFromFunction::FieldFromFunction(const YmrState *state, std::string name, FieldBatchFunction func, float3 h,
+                                     int chunkSize) :
+    Field(state, name, h),
+    func(func),
+    chunkSize(chunkSize)
+{
+    if (chunkSize < 1)
+        die("Field '%s': evaluation chunks must have at least 1 point, got %d", name.c_str(), chunkSize);
+}
+
 FieldFromFunction::~FieldFromFunction() = default;
 
 FieldFromFunction::FieldFromFunction(FieldFromFunction&&) = default;
@@ -34,21 +54,39 @@ void FieldFromFunction::setup(const MPI_Comm& comm)
     
     PinnedBuffer<float> fieldRawData (resolution.x * resolution.y * resolution.z);
 
-    int3 i;
-    int id = 0;
-    for (i.z = 0; i.z < resolution.z; ++i.z) {
-        for (i.y = 0; i.y < resolution.y; ++i.y) {
-            for (i.x = 0; i.x < resolution.x; ++i.x) {
-                float3 r {i.x * h.x, i.y * h.y, i.z * h.z};
-                r -= extendedDomainSize*0.5f;
-                r  = domain.local2global(r);
-                r  = make_periodic(r, domain.globalSize);
-                
-                fieldRawData[id++] = func(r);
-            }
+    const int n = resolution.x * resolution.y * resolution.z;
+    std::vector<float3> positions;
+    positions.reserve(std::min(n, chunkSize));
+
+    // each rank only evaluates the grid of its own (extended) subdomain
+    for (int start = 0; start < n; start += chunkSize)
+    {
+        const int end = std::min(n, start + chunkSize);
+        positions.clear();
+
+        for (int id = start; id < end; id++)
+        {
+            const int3 i { id % resolution.x,
+                          (id / resolution.x) % resolution.y,
+                           id / (resolution.x * resolution.y) };
+
+            float3 r {i.x * h.x, i.y * h.y, i.z * h.z};
+            r -= extendedDomainSize*0.5f;
+            r  = domain.local2global(r);
+            r  = make_periodic(r, domain.globalSize);
+
+            positions.push_back(r);
         }
+
+        const auto values = func(positions);
+        if (values.size() != positions.size())
+            die("Field '%s': got %d values for %d points", name.c_str(), (int) values.size(), (int) positions.size());
+
+        std::copy(values.begin(), values.end(), fieldRawData.hostPtr() + start);
     }
 
+    computeNegativeBox(fieldRawData.hostPtr());
+
     fieldRawData.uploadToDevice(0);
     
     setupArrayTexture(fieldRawData.devPtr());
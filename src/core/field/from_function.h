@@ -1,20 +1,34 @@
 #include "interface.h"
 
 #include <functional>
+#include <vector>
 
 using FieldFunction = std::function<float(float3)>;
 
+/// values of the field at all the given points, in the same order
+using FieldBatchFunction = std::function<std::vector<float>(const std::vector<float3>&)>;
+
 class FieldFromFunction : public Field
 {
 public:    
     FieldFromFunction(const YmrState *state, std::string name, FieldFunction func, float3 h);
+
+    /**
+     * The grid is evaluated in chunks of up to \p chunkSize points, one call per chunk,
+     * such that expensive callers (e.g. python) can vectorize the evaluation
+     */
+    FieldFromFunction(const YmrState *state, std::string name, FieldBatchFunction func, float3 h,
+                      int chunkSize = defaultChunkSize);
     ~FieldFromFunction();
 
     FieldFromFunction(FieldFromFunction&&);
     
     void setup(const MPI_Comm& comm) override;
     
+    static constexpr int defaultChunkSize = 1 << 20;
+
 protected:
     
-    FieldFunction func;
+    FieldBatchFunction func;
+    int chunkSize;
 };
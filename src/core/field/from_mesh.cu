@@ -0,0 +1,221 @@
+#include "from_mesh.h"
+
+#include <core/logger.h>
+#include <core/mesh/bvh.h>
+#include <core/mesh/mesh.h>
+#include <core/utils/cuda_common.h>
+#include <core/utils/kernel_launch.h>
+
+namespace MeshFieldKernels
+{
+
+struct Triangle
+{
+    float3 v0, v1, v2;
+};
+
+__device__ inline Triangle readTriangle(const MeshView& mesh, const float4 *vertices, int trid, float3 shift)
+{
+    const int3 t = mesh.getTriangle(trid);
+    return { make_float3(vertices[t.x]) + shift,
+             make_float3(vertices[t.y]) + shift,
+             make_float3(vertices[t.z]) + shift };
+}
+
+__global__ void computeTriangleBoxes(const MeshView mesh, const float4 *vertices, float3 shift, AABB *boxes)
+{
+    const int trid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (trid >= mesh.ntriangles) return;
+
+    const auto t = readTriangle(mesh, vertices, trid, shift);
+    boxes[trid] = { fminf(fminf(t.v0, t.v1), t.v2), fmaxf(fmaxf(t.v0, t.v1), t.v2) };
+}
+
+/**
+ * One thread per leaf adds the area vector and the area-weighted centroid
+ * of its triangle to all the nodes up to the root.
+ * areaVectors and centroids must be cleared, centroids.w is the total area
+ */
+__global__ void accumulateDipoles(const MeshView mesh, const float4 *vertices, float3 shift, BVHView bvh,
+                                  float3 *areaVectors, float4 *centroids)
+{
+    const int i = blockIdx.x * blockDim.x + threadIdx.x;
+    if (i >= bvh.nLeaves) return;
+
+    int node = i + (bvh.nLeaves - 1);
+    const auto t = readTriangle(mesh, vertices, bvh.leafId(node), shift);
+
+    const float3 n = 0.5f * cross(t.v1 - t.v0, t.v2 - t.v0);
+    const float area = length(n);
+    const float3 c = (t.v0 + t.v1 + t.v2) * (1.0f / 3.0f);
+
+    for (; node >= 0; node = bvh.parents[node])
+    {
+        atomicAdd(areaVectors + node, n);
+        atomicAdd(centroids + node, area * c);
+        atomicAdd(&centroids[node].w, area);
+    }
+}
+
+/// Ericson, "Real-Time Collision Detection", 5.1.5
+__device__ inline float3 closestPointOnTriangle(float3 p, const Triangle& t)
+{
+    const float3 ab = t.v1 - t.v0;
+    const float3 ac = t.v2 - t.v0;
+    const float3 ap = p - t.v0;
+
+    const float d1 = dot(ab, ap), d2 = dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f) return t.v0;
+
+    const float3 bp = p - t.v1;
+    const float d3 = dot(ab, bp), d4 = dot(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3) return t.v1;
+
+    const float vc = d1*d4 - d3*d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+        return t.v0 + (d1 / (d1 - d3)) * ab;
+
+    const float3 cp = p - t.v2;
+    const float d5 = dot(ab, cp), d6 = dot(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6) return t.v2;
+
+    const float vb = d5*d2 - d1*d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+        return t.v0 + (d2 / (d2 - d6)) * ac;
+
+    const float va = d3*d6 - d5*d4;
+    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+        return t.v1 + ((d4 - d3) / ((d4 - d3) + (d5 - d6))) * (t.v2 - t.v1);
+
+    const float denom = 1.0f / (va + vb + vc);
+    return t.v0 + ab * (vb * denom) + ac * (vc * denom);
+}
+
+__device__ inline float boxDistance2(const AABB& box, float3 p)
+{
+    const float3 d = fmaxf(fmaxf(box.lo - p, p - box.hi), make_float3(0.0f));
+    return dot(d, d);
+}
+
+/// solid angle of the triangle seen from p (Van Oosterom and Strackee, 1983)
+__device__ inline float solidAngle(float3 p, const Triangle& t)
+{
+    const float3 a = t.v0 - p, b = t.v1 - p, c = t.v2 - p;
+    const float la = length(a), lb = length(b), lc = length(c);
+
+    const float det = dot(a, cross(b, c));
+    const float div = la*lb*lc + dot(a, b)*lc + dot(b, c)*la + dot(c, a)*lb;
+
+    return 2.0f * atan2f(det, div);
+}
+
+/// One thread per grid node
+__global__ void computeSdf(int3 resolution, float3 h, float3 extendedDomainSize,
+                           const MeshView mesh, const float4 *vertices, float3 shift, BVHView bvh,
+                           const float3 *areaVectors, const float4 *centroids, float sign, float *sdfs)
+{
+    // dipole approximation for the nodes further than beta times their radius
+    const float beta = 2.0f;
+    const float inv4Pi = 0.25f / M_PI;
+
+    const int nid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (nid >= resolution.x * resolution.y * resolution.z) return;
+
+    const int3 id = make_int3(nid % resolution.x, (nid / resolution.x) % resolution.y, nid / (resolution.x * resolution.y));
+    const float3 p = make_float3(id) * h - 0.5f * extendedDomainSize;
+
+    float best2 = 1e30f;
+    bvh.traverse(
+        [&] (const AABB& box) { return boxDistance2(box, p) < best2; },
+        [&] (int trid) {
+            const float3 d = closestPointOnTriangle(p, readTriangle(mesh, vertices, trid, shift)) - p;
+            best2 = fminf(best2, dot(d, d));
+        });
+
+    float winding = 0.0f;
+    bvh.traverseNodes(
+        [&] (int node) {
+            if (bvh.isLeaf(node))
+            {
+                winding += solidAngle(p, readTriangle(mesh, vertices, bvh.leafId(node), shift)) * inv4Pi;
+                return false;
+            }
+
+            const auto box = bvh.boxes[node];
+            const float4 ca = centroids[node];
+            const float3 c = make_float3(ca) / fmaxf(ca.w, 1e-20f);
+            const float radius = length(fmaxf(box.hi - c, c - box.lo));
+
+            const float3 r = c - p;
+            const float l = length(r);
+            if (l <= beta * radius) return true;
+
+            winding += dot(areaVectors[node], r) / (l*l*l) * inv4Pi;
+            return false;
+        });
+
+    const float dist = sqrtf(best2);
+    sdfs[nid] = sign * (winding > 0.5f ? dist : -dist);
+}
+
+} // namespace MeshFieldKernels
+
+FieldFromMesh::FieldFromMesh(const YmrState *state, std::string name, std::shared_ptr<Mesh> mesh, float3 h, bool inverted) :
+    Field(state, name, h),
+    mesh(mesh),
+    inverted(inverted)
+{}
+
+FieldFromMesh::~FieldFromMesh() = default;
+
+FieldFromMesh::FieldFromMesh(FieldFromMesh&&) = default;
+
+void FieldFromMesh::setup(const MPI_Comm& comm)
+{
+    info("Setting up field from a mesh of %d triangles", mesh->getNtriangles());
+
+    const auto domain = state->domain;
+    const int nthreads = 128;
+
+    CUDA_Check( cudaDeviceSynchronize() );
+
+    const int ntriangles = mesh->getNtriangles();
+    if (ntriangles == 0)
+        die("Field '%s' can not be computed from an empty mesh", name.c_str());
+
+    MeshView meshView(mesh.get());
+    const float4 *vertices = mesh->vertexCoordinates.devPtr();
+
+    // mesh is in global coordinates
+    const float3 shift = domain.global2local(make_float3(0.0f));
+
+    BoundingVolumeHierarchy bvh;
+    SAFE_KERNEL_LAUNCH(
+            MeshFieldKernels::computeTriangleBoxes,
+            getNblocks(ntriangles, nthreads), nthreads, 0, 0,
+            meshView, vertices, shift, bvh.leafBoxes(ntriangles) );
+
+    bvh.build(-0.5f * extendedDomainSize, 0.5f * extendedDomainSize, 0);
+
+    DeviceBuffer<float3> areaVectors(2*ntriangles - 1);
+    DeviceBuffer<float4> centroids  (2*ntriangles - 1);
+    areaVectors.clear(0);
+    centroids  .clear(0);
+
+    SAFE_KERNEL_LAUNCH(
+            MeshFieldKernels::accumulateDipoles,
+            getNblocks(ntriangles, nthreads), nthreads, 0, 0,
+            meshView, vertices, shift, bvh.getView(), areaVectors.devPtr(), centroids.devPtr() );
+
+    const int totNodes = resolution.x * resolution.y * resolution.z;
+    DeviceBuffer<float> fieldRawData(totNodes);
+
+    SAFE_KERNEL_LAUNCH(
+            MeshFieldKernels::computeSdf,
+            getNblocks(totNodes, nthreads), nthreads, 0, 0,
+            resolution, h, extendedDomainSize,
+            meshView, vertices, shift, bvh.getView(),
+            areaVectors.devPtr(), centroids.devPtr(), inverted ? -1.0f : 1.0f, fieldRawData.devPtr() );
+
+    setupArrayTexture(fieldRawData.devPtr());
+}
@@ -0,0 +1,31 @@
+#include "interface.h"
+
+#include <memory>
+
+class Mesh;
+
+/**
+ * Signed distance to a closed triangle mesh given in global coordinates,
+ * computed on the GPU on the grid of the local (extended) domain.
+ *
+ * The distance to the closest triangle is found through a bounding volume hierarchy,
+ * the sign is given by the generalized winding number of the mesh,
+ * approximated far from the BVH nodes by their dipole (Barill et al., "Fast winding numbers
+ * for soups and clouds", 2018), so that meshes do not need to be perfectly watertight.
+ * The field is positive inside the mesh and negative outside, the other way around with \p inverted
+ */
+class FieldFromMesh : public Field
+{
+public:    
+    FieldFromMesh(const YmrState *state, std::string name, std::shared_ptr<Mesh> mesh, float3 h, bool inverted = false);
+    ~FieldFromMesh();
+
+    FieldFromMesh(FieldFromMesh&&);
+    
+    void setup(const MPI_Comm& comm) override;
+    
+protected:
+    
+    std::shared_ptr<Mesh> mesh;
+    bool inverted;
+};
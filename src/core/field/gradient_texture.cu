@@ -0,0 +1,80 @@
+#include "interface.h"
+
+#include <core/containers.h>
+#include <core/logger.h>
+#include <core/utils/cuda_common.h>
+#include <core/utils/kernel_launch.h>
+
+#include <texture_types.h>
+
+namespace GradientTextureKernels
+{
+
+/// One thread per grid node, central differences wrapped around like the field texture
+__global__ void valuesAndNormals(const float *field, int3 resolution, float3 invh, float4 *out)
+{
+    const float zeroTolerance = 1e-10f;
+
+    const int nid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (nid >= resolution.x * resolution.y * resolution.z) return;
+
+    const int3 id = make_int3(nid % resolution.x, (nid / resolution.x) % resolution.y, nid / (resolution.x * resolution.y));
+
+    auto value = [&] (int3 d) {
+        const int3 j = (id + d + resolution) % resolution;
+        return field[ (j.z*resolution.y + j.y)*resolution.x + j.x ];
+    };
+
+    const float3 grad = 0.5f * invh * make_float3( value(make_int3(1, 0, 0)) - value(make_int3(-1,  0,  0)),
+                                                   value(make_int3(0, 1, 0)) - value(make_int3( 0, -1,  0)),
+                                                   value(make_int3(0, 0, 1)) - value(make_int3( 0,  0, -1)) );
+
+    const float norm2 = dot(grad, grad);
+    const float3 normal = norm2 < zeroTolerance ? make_float3(0.0f) : grad * rsqrtf(norm2);
+
+    out[nid] = make_float4(normal, field[nid]);
+}
+
+} // namespace GradientTextureKernels
+
+void Field::setupGradientTexture(const float *fieldDevPtr)
+{
+    debug("setting up the gradient texture of field '%s'", name.c_str());
+
+    const int n = resolution.x * resolution.y * resolution.z;
+    DeviceBuffer<float4> data(n);
+
+    const int nthreads = 128;
+    SAFE_KERNEL_LAUNCH(
+            GradientTextureKernels::valuesAndNormals,
+            getNblocks(n, nthreads), nthreads, 0, 0,
+            fieldDevPtr, resolution, invh, data.devPtr() );
+
+    auto chDesc = cudaCreateChannelDesc<float4>();
+    CUDA_Check( cudaMalloc3DArray(&gradientArray, &chDesc, make_cudaExtent(resolution.x, resolution.y, resolution.z)) );
+
+    cudaMemcpy3DParms copyParams = {};
+    copyParams.srcPtr   = make_cudaPitchedPtr((void*)data.devPtr(), resolution.x*sizeof(float4), resolution.x, resolution.y);
+    copyParams.dstArray = gradientArray;
+    copyParams.extent   = make_cudaExtent(resolution.x, resolution.y, resolution.z);
+    copyParams.kind     = cudaMemcpyDeviceToDevice;
+
+    CUDA_Check( cudaMemcpy3D(&copyParams) );
+
+    cudaResourceDesc resDesc = {};
+    resDesc.resType         = cudaResourceTypeArray;
+    resDesc.res.array.array = gradientArray;
+
+    // the normals tolerate the 9 bits of the hardware filtering, the values of the walls use fieldTex
+    cudaTextureDesc texDesc = {};
+    texDesc.addressMode[0]   = cudaAddressModeWrap;
+    texDesc.addressMode[1]   = cudaAddressModeWrap;
+    texDesc.addressMode[2]   = cudaAddressModeWrap;
+    texDesc.filterMode       = cudaFilterModeLinear;
+    texDesc.readMode         = cudaReadModeElementType;
+    texDesc.normalizedCoords = 0;
+
+    CUDA_Check( cudaCreateTextureObject(&gradientTex, &resDesc, &texDesc, nullptr) );
+
+    CUDA_Check( cudaDeviceSynchronize() );
+}
@@ -1,12 +1,14 @@
 #include "interface.h"
 
 #include <texture_types.h>
+#include <core/logger.h>
 #include <core/utils/cuda_common.h>
 
 
-Field::Field(const YmrState *state, std::string name, float3 hField) :
+Field::Field(const YmrState *state, std::string name, float3 hField, float3 margin) :
     YmrSimulationObject(state, name),
-    fieldArray(nullptr)
+    fieldArray(nullptr),
+    margin3(margin)
 {
     // We'll make sdf a bit bigger, so that particles that flew away
     // would also be correctly bounced back
@@ -14,6 +16,9 @@ Field::Field(const YmrState *state, std::string name, float3 hField) :
     resolution         = make_int3( ceilf(extendedDomainSize / hField) );
     h                  = extendedDomainSize / make_float3(resolution-1);
     invh               = 1.0f / h;
+
+    negativeLo = -0.5f * extendedDomainSize;
+    negativeHi =  0.5f * extendedDomainSize;
 }
 
 Field::~Field()
@@ -22,6 +27,11 @@ Field::~Field()
         CUDA_Check( cudaFreeArray(fieldArray) );
         CUDA_Check( cudaDestroyTextureObject(fieldTex) );
     }
+
+    if (gradientArray) {
+        CUDA_Check( cudaFreeArray(gradientArray) );
+        CUDA_Check( cudaDestroyTextureObject(gradientTex) );
+    }
 }
 
 Field::Field(Field&&) = default;
@@ -31,8 +41,51 @@ const FieldDeviceHandler& Field::handler() const
     return *(FieldDeviceHandler*)this;
 }
 
+void Field::getNegativeBox(float3& lo, float3& hi) const
+{
+    lo = negativeLo;
+    hi = negativeHi;
+}
+
+void Field::computeNegativeBox(const float *fieldHostPtr)
+{
+    int3 lo = resolution, hi = make_int3(-1);
+
+    int3 i;
+    int id = 0;
+    for (i.z = 0; i.z < resolution.z; ++i.z)
+        for (i.y = 0; i.y < resolution.y; ++i.y)
+            for (i.x = 0; i.x < resolution.x; ++i.x)
+                if (fieldHostPtr[id++] < 0.0f)
+                {
+                    lo = min(lo, i);
+                    hi = max(hi, i);
+                }
+
+    if (hi.x < 0)
+    {
+        negativeLo = make_float3( 1.0f);
+        negativeHi = make_float3(-1.0f);
+    }
+    else
+    {
+        // one more cell on each side: the neighbouring cells share the negative nodes
+        negativeLo = make_float3(lo - 1) * h - 0.5f * extendedDomainSize;
+        negativeHi = make_float3(hi + 1) * h - 0.5f * extendedDomainSize;
+    }
+
+    debug("Field '%s' may be negative in [%g %g %g] - [%g %g %g]", name.c_str(),
+          negativeLo.x, negativeLo.y, negativeLo.z, negativeHi.x, negativeHi.y, negativeHi.z);
+}
+
 void Field::setupArrayTexture(const float *fieldDevPtr)
 {
+    if (storage != FieldStorage::Float)
+    {
+        setupCompressedTexture(fieldDevPtr);
+        return;
+    }
+
     debug("setting up cuda array and texture object for field '%s'", name.c_str());
     
     // Prepare array to be transformed into texture
@@ -13,15 +13,30 @@
 template<typename T>
 T tex3D(cudaTextureObject_t t, float x, float y, float z)
 {
-    return 0.0f;
+    return T();
 }
 #endif
 
+/// how the grid values of a field are stored, see Field::setupArrayTexture()
+enum class FieldStorage
+{
+    Float,      ///< 32 bit floats, interpolated in software
+    Half,       ///< 16 bit floats, interpolated by the texture units
+    Normalized  ///< 16 bit integers of the field clamped to a band around zero, interpolated by the texture units
+};
+
 class FieldDeviceHandler
 {
 public:
     __D__ inline float operator()(float3 x) const
     {
+        if (filtered)
+        {
+            // texels are centered on the grid nodes
+            const float3 texcoord = (x + extendedDomainSize*0.5f) * invh + 0.5f;
+            return valueScale * tex3D<float>(fieldTex, texcoord.x, texcoord.y, texcoord.z);
+        }
+
         //https://en.wikipedia.org/wiki/Trilinear_interpolation
         float s000, s001, s010, s011, s100, s101, s110, s111;
         float sx00, sx01, sx10, sx11, sxy0, sxy1, sxyz;
@@ -30,6 +45,8 @@ public:
         float3 lambda = (x - (texcoord * h - extendedDomainSize*0.5f)) * invh;
         
         auto access = [this, &texcoord] (int dx, int dy, int dz) {
+            if (brickIds != nullptr)
+                return narrowBandValue(make_int3(texcoord) + make_int3(dx, dy, dz));
             return tex3D<float>(fieldTex, texcoord.x + dx, texcoord.y + dy, texcoord.z + dz);
         };
         
@@ -56,17 +73,65 @@ public:
         return sxyz;
     }
 
+    /// true if the normals are precomputed, see Field::setupGradientTexture()
+    __HD__ inline bool hasGradientTexture() const { return gradientTex != 0; }
+
+    /**
+     * Normalized gradient and value (in w) at \p x, trilinearly interpolated by the texture units
+     * in one fetch. Only valid if hasGradientTexture()
+     */
+    __D__ inline float4 valueAndNormal(float3 x) const
+    {
+        // texels are centered on the grid nodes
+        const float3 texcoord = (x + extendedDomainSize*0.5f) * invh + 0.5f;
+        return tex3D<float4>(gradientTex, texcoord.x, texcoord.y, texcoord.z);
+    }
+
+    /// narrow band bricks are cubes of brickSize^3 grid nodes
+    static constexpr int brickSize = 8;
+
+    /// ids of the bricks without data, far from the zero level set
+    enum BrickId { FarNegative = -1, FarPositive = -2 };
+
 protected:
 
+    /// value of the grid node \p id, periodic like the texture
+    __D__ inline float narrowBandValue(int3 id) const
+    {
+        id = (id % gridResolution + gridResolution) % gridResolution;
+
+        const int3 brick = id / brickSize;
+        const int3 loc   = id - brick * brickSize;
+        const int dataId = brickIds[ (brick.z*nBricks.y + brick.y)*nBricks.x + brick.x ];
+
+        if (dataId == FarNegative) return -bandWidth;
+        if (dataId == FarPositive) return  bandWidth;
+
+        return brickData[ ((dataId*brickSize + loc.z)*brickSize + loc.y)*brickSize + loc.x ];
+    }
+
     cudaTextureObject_t fieldTex;
+    cudaTextureObject_t gradientTex {0};
+
+    // 16 bit textures, interpolated by the hardware and scaled back, see FieldStorage
+    bool filtered {false};
+    float valueScale {1.0f};
+
     float3 h, invh, extendedDomainSize;
+
+    // narrow band representation, used instead of the texture when brickIds is set
+    const int   *brickIds  {nullptr};
+    const float *brickData {nullptr};
+    int3 gridResolution, nBricks;
+    float bandWidth;
 };
 
 
 class Field : public FieldDeviceHandler, public YmrSimulationObject
 {
 public:    
-    Field(const YmrState *state, std::string name, float3 h);
+    /// sampled on the local domain extended by \p margin on each side
+    Field(const YmrState *state, std::string name, float3 h, float3 margin = {5, 5, 5});
     virtual ~Field();
 
     Field(Field&&);
@@ -74,14 +139,60 @@ public:
     const FieldDeviceHandler& handler() const;
 
     virtual void setup(const MPI_Comm& comm) = 0;
+
+    /**
+     * Bounding box, in local coordinates, of the points where the field may be negative:
+     * known once the field is set up from grid values, the whole extended domain otherwise.
+     * Empty (lo > hi) if the field is nowhere negative
+     */
+    void getNegativeBox(float3& lo, float3& hi) const;
+
+    float3 getGridSpacing() const { return h; }
     
 protected:
 
     int3 resolution;
     
     cudaArray *fieldArray;
+    cudaArray *gradientArray {nullptr};
     
-    const float3 margin3{5, 5, 5};
+    const float3 margin3;
 
+    float3 negativeLo, negativeHi;
+
+    FieldStorage storage {FieldStorage::Float};
+    float storageBand {0.0f};   ///< clamping distance of FieldStorage::Normalized
+
+    /// texture of the grid values \p fieldDevPtr, in the precision of \c storage
     void setupArrayTexture(const float *fieldDevPtr);
+
+    /**
+     * 16 bit texture of the grid values, read through the hardware trilinear filtering.
+     * Checks at setup the error against the software interpolation of the float values,
+     * within \c storageBand of zero for FieldStorage::Normalized and within the margin for FieldStorage::Half
+     */
+    void setupCompressedTexture(const float *fieldDevPtr);
+
+    /**
+     * Set the box of getNegativeBox() from the grid values \p fieldHostPtr:
+     * the interpolated field is negative only in the cells with a negative node
+     */
+    void computeNegativeBox(const float *fieldHostPtr);
+
+    PinnedBuffer<int> narrowBandIds;
+    DeviceBuffer<float> narrowBandData;
+
+    /**
+     * Keep only the bricks of the grid where the field may be within \p band of zero,
+     * all the other bricks read as -band or +band depending on their sign.
+     * Replaces the texture, for fields whose values far from zero do not matter
+     */
+    void setupNarrowBand(const float *fieldDevPtr, float band);
+
+    /**
+     * Precompute the normalized gradient of the grid values \p fieldDevPtr on the grid nodes,
+     * stored along with the values in a texture of float4, see valueAndNormal().
+     * Takes four times the memory of the field itself
+     */
+    void setupGradientTexture(const float *fieldDevPtr);
 };
@@ -0,0 +1,103 @@
+#include "interface.h"
+
+#include <core/logger.h>
+#include <core/utils/cuda_common.h>
+#include <core/utils/kernel_launch.h>
+
+namespace NarrowBandKernels
+{
+
+const int activeBrick = 0;
+
+/// One thread per brick, mark the bricks with values within the band or changing sign
+__global__ void classifyBricks(const float *field, int3 resolution, int3 nBricks, float band, int *brickIds)
+{
+    const int bid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (bid >= nBricks.x * nBricks.y * nBricks.z) return;
+
+    const int B = FieldDeviceHandler::brickSize;
+    const int3 brick = make_int3(bid % nBricks.x, (bid / nBricks.x) % nBricks.y, bid / (nBricks.x * nBricks.y));
+    const int3 start = brick * B;
+    const int3 end   = min(start + B, resolution);
+
+    bool positive = false, negative = false, inBand = false;
+
+    for (int k = start.z; k < end.z; k++)
+        for (int j = start.y; j < end.y; j++)
+            for (int i = start.x; i < end.x; i++)
+            {
+                const float v = field[ (k*resolution.y + j)*resolution.x + i ];
+
+                positive = positive || v >= 0.0f;
+                negative = negative || v <  0.0f;
+                inBand   = inBand   || fabsf(v) < band;
+            }
+
+    if (inBand || (positive && negative))
+        brickIds[bid] = activeBrick;
+    else
+        brickIds[bid] = positive ? FieldDeviceHandler::FarPositive : FieldDeviceHandler::FarNegative;
+}
+
+/// One thread per grid node, copy the nodes of the kept bricks
+__global__ void gatherBricks(const float *field, int3 resolution, int3 nBricks, const int *brickIds, float *data)
+{
+    const int nid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (nid >= resolution.x * resolution.y * resolution.z) return;
+
+    const int B = FieldDeviceHandler::brickSize;
+    const int3 id = make_int3(nid % resolution.x, (nid / resolution.x) % resolution.y, nid / (resolution.x * resolution.y));
+    const int3 brick = id / B;
+    const int3 loc   = id - brick * B;
+
+    const int dataId = brickIds[ (brick.z*nBricks.y + brick.y)*nBricks.x + brick.x ];
+    if (dataId < 0) return;
+
+    data[ ((dataId*B + loc.z)*B + loc.y)*B + loc.x ] = field[nid];
+}
+
+} // namespace NarrowBandKernels
+
+void Field::setupNarrowBand(const float *fieldDevPtr, float band)
+{
+    const int nthreads = 128;
+    const int B = brickSize;
+
+    gridResolution = resolution;
+    nBricks = (resolution + B - 1) / B;
+    bandWidth = band;
+
+    const int totBricks = nBricks.x * nBricks.y * nBricks.z;
+    narrowBandIds.resize_anew(totBricks);
+
+    SAFE_KERNEL_LAUNCH(
+            NarrowBandKernels::classifyBricks,
+            getNblocks(totBricks, nthreads), nthreads, 0, 0,
+            fieldDevPtr, resolution, nBricks, band, narrowBandIds.devPtr() );
+
+    narrowBandIds.downloadFromDevice(0, ContainersSynch::Synch);
+
+    int nActive = 0;
+    for (auto& id : narrowBandIds)
+        if (id == NarrowBandKernels::activeBrick)
+            id = nActive++;
+
+    narrowBandIds.uploadToDevice(0);
+    narrowBandData.resize_anew(nActive * B*B*B);
+
+    const int totNodes = resolution.x * resolution.y * resolution.z;
+    SAFE_KERNEL_LAUNCH(
+            NarrowBandKernels::gatherBricks,
+            getNblocks(totNodes, nthreads), nthreads, 0, 0,
+            fieldDevPtr, resolution, nBricks, narrowBandIds.devPtr(), narrowBandData.devPtr() );
+
+    brickIds  = narrowBandIds.devPtr();
+    brickData = narrowBandData.devPtr();
+
+    info("Field '%s': narrow band of width %f keeps %d out of %d bricks (%.1f MB instead of %.1f MB)",
+         name.c_str(), band, nActive, totBricks,
+         nActive * B*B*B * sizeof(float) / (1024.0*1024.0),
+         totNodes * sizeof(float) / (1024.0*1024.0));
+
+    CUDA_Check( cudaDeviceSynchronize() );
+}
@@ -0,0 +1,38 @@
+#include "shared.h"
+
+#include <core/logger.h>
+
+#include <map>
+#include <utility>
+#include <vector>
+
+std::shared_ptr<FieldFromFile> SharedFields::fromFile(const YmrState *state, std::string fileName,
+                                                      float3 h, float narrowBand, bool gradientTexture, float3 margin,
+                                                      FieldStorage storage, float storageBand)
+{
+    using Key = std::pair< std::string, std::vector<float> >;
+
+    // never destroyed, only holds weak references
+    static auto *fields = new std::map< Key, std::weak_ptr<FieldFromFile> >;
+
+    const auto& domain = state->domain;
+    const Key key { fileName, { h.x, h.y, h.z, narrowBand, gradientTexture ? 1.0f : 0.0f,
+                                margin.x, margin.y, margin.z,
+                                (float) storage, storageBand,
+                                domain.globalStart.x, domain.globalStart.y, domain.globalStart.z,
+                                domain.localSize.x,   domain.localSize.y,   domain.localSize.z } };
+
+    auto& entry = (*fields)[key];
+    auto field = entry.lock();
+
+    if (field)
+        debug("Sharing the field read from '%s'", fileName.c_str());
+    else
+    {
+        field = std::make_shared<FieldFromFile>(state, "field_" + fileName, fileName, h,
+                                                narrowBand, gradientTexture, margin, storage, storageBand);
+        entry = field;
+    }
+
+    return field;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "from_file.h"
+
+#include <memory>
+#include <string>
+
+/**
+ * Fields read from files, shared by all the users of the same file with the same
+ * grid spacing, narrow band, gradient texture, margin and storage on the same local domain: one read and one device copy per rank.
+ * The users hold the field, it is freed with the last of them
+ */
+class SharedFields
+{
+public:
+    static std::shared_ptr<FieldFromFile> fromFile(const YmrState *state, std::string fileName,
+                                                   float3 h, float narrowBand = 0.0f,
+                                                   bool gradientTexture = false, float3 margin = {5, 5, 5},
+                                                   FieldStorage storage = FieldStorage::Float, float storageBand = 0.0f);
+};
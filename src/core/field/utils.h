@@ -1,5 +1,7 @@
 #pragma once
 
+#include "interface.h"
+
 #include <core/utils/cpu_gpu_defines.h>
 #include <core/utils/helper_math.h>
 
@@ -19,3 +21,32 @@ inline __D__ float3 computeGradient(const FieldHandler& field, float3 x, float h
 
     return (1.0f / (2.0f*h)) * diff;
 }
+
+/// normalized gradient of \p field at \p x, zero where the gradient vanishes
+template <typename FieldHandler>
+inline __D__ float3 computeNormal(const FieldHandler& field, float3 x, float h)
+{
+    const float zeroTolerance = 1e-10f;
+
+    const float3 grad = computeGradient(field, x, h);
+    if (dot(grad, grad) < zeroTolerance)
+        return make_float3(0.0f);
+
+    return normalize(grad);
+}
+
+/// one fetch of the precomputed normals if the field has them, finite differences otherwise
+inline __D__ float3 computeNormal(const FieldDeviceHandler& field, float3 x, float h)
+{
+    const float zeroTolerance = 1e-10f;
+
+    if (!field.hasGradientTexture())
+        return computeNormal<FieldDeviceHandler>(field, x, h);
+
+    // interpolated unit vectors are slightly shorter
+    const float3 grad = make_float3(field.valueAndNormal(x));
+    if (dot(grad, grad) < zeroTolerance)
+        return make_float3(0.0f);
+
+    return normalize(grad);
+}
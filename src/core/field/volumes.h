@@ -0,0 +1,89 @@
+#pragma once
+
+#include "interface.h"
+
+#include <core/containers.h>
+#include <core/domain.h>
+#include <core/utils/cuda_common.h>
+#include <core/utils/kernel_launch.h>
+
+#include <algorithm>
+#include <vector>
+
+/**
+ * Volumes of the regions of a field within the local domain, by the midpoint rule
+ * on a regular voxel grid: every voxel counts for the region of the field value at its center.
+ * Deterministic and converges with the voxel size, unlike the Monte-Carlo sampling;
+ * the default voxel is the grid spacing of the field, below which its interpolation carries no information.
+ *
+ * The regions are given by a \c Binner functor: <tt>int operator()(float value)</tt>
+ * returns the region of a field value in [0, nBins), or a negative number for none
+ */
+namespace FieldVolumes
+{
+
+/// the negative values, the inside of a region field
+struct NegativeBinner
+{
+    __D__ inline int operator()(float value) const { return value < 0.0f ? 0 : -1; }
+};
+
+namespace Kernels
+{
+template <class Binner>
+__global__ void countVoxels(int3 nVoxels, float3 lo, float3 voxel, FieldDeviceHandler field, Binner binner,
+                            unsigned long long int *counts)
+{
+    const long long int n = (long long int) nVoxels.x * nVoxels.y * nVoxels.z;
+
+    for (long long int i = threadIdx.x + blockIdx.x * (long long int) blockDim.x; i < n; i += blockDim.x * gridDim.x)
+    {
+        const int3 id { (int) (i % nVoxels.x),
+                        (int) ((i / nVoxels.x) % nVoxels.y),
+                        (int) (i / ((long long int) nVoxels.x * nVoxels.y)) };
+
+        const float3 r = lo + (make_float3(id) + 0.5f) * voxel;
+        const int bin = binner(field(r));
+
+        if (bin >= 0)
+            atomicAdd(counts + bin, 1ull);
+    }
+}
+} // namespace Kernels
+
+/**
+ * @return the local volume of each of the \p nBins regions of \p binner,
+ * with voxels of the field grid spacing divided by \p refinement
+ */
+template <class Binner>
+std::vector<double> computeVolumes(const Field& field, const DomainInfo& domain, Binner binner, int nBins,
+                                   int refinement, cudaStream_t stream)
+{
+    const float3 L = domain.localSize;
+    const float3 h = field.getGridSpacing() / (float) refinement;
+    const int3 nVoxels = make_int3(ceilf(L / h));
+    const float3 voxel = L / make_float3(nVoxels);
+
+    PinnedBuffer<unsigned long long int> counts(nBins);
+    counts.clearDevice(stream);
+
+    const long long int n = (long long int) nVoxels.x * nVoxels.y * nVoxels.z;
+    const int nthreads = 128;
+    const int nblocks = (int) std::min((n + nthreads - 1) / nthreads, 4096ll);
+
+    SAFE_KERNEL_LAUNCH(
+            Kernels::countVoxels,
+            nblocks, nthreads, 0, stream,
+            nVoxels, -0.5f * L, voxel, field.handler(), binner, counts.devPtr() );
+
+    counts.downloadFromDevice(stream, ContainersSynch::Synch);
+
+    const double voxelVolume = (double) voxel.x * voxel.y * voxel.z;
+    std::vector<double> volumes(nBins);
+    for (int i = 0; i < nBins; i++)
+        volumes[i] = voxelVolume * counts[i];
+
+    return volumes;
+}
+
+} // namespace FieldVolumes
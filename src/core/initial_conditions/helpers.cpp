@@ -1,5 +1,5 @@
 #include <functional>
-#include <random>
+#include <vector>
 
 #include <core/logger.h>
 #include <core/pvs/particle_vector.h>
@@ -7,98 +7,76 @@
 
 #include "helpers.h"
 
-using PositionFilter = std::function<bool(float3)>;
-
-static long genSeed(const MPI_Comm& comm, std::string name)
+UniformSampler::UniformSampler(float density, const DomainInfo& domain, uint64_t seed) :
+    seed(seed),
+    domain(domain)
 {
-    int rank;
-    std::hash<std::string> nameHash;
+    ncells = make_int3( ceilf(domain.localSize) );
+    h      = domain.localSize / make_float3(ncells);
+
+    // the cells are aligned on the global domain
+    globalCellStart = make_int3( floorf(domain.globalStart / h + 0.5f) );
+    globalNcells    = make_int3( floorf(domain.globalSize  / h + 0.5f) );
 
-    MPI_Check( MPI_Comm_rank(comm, &rank) );
-    return rank + nameHash(name);
+    wholeInCell = floor(density);
+    fracInCell  = density - wholeInCell;
 }
 
-static Particle genParticle(float3 h, int i, int j, int k, const DomainInfo& domain,
-                            std::uniform_real_distribution<float>& udistr, std::mt19937& gen)
+uint64_t genUniformSeed(const ParticleVector *pv)
 {
-    Particle p;
-    p.r.x = i*h.x - 0.5*domain.localSize.x + udistr(gen);
-    p.r.y = j*h.y - 0.5*domain.localSize.y + udistr(gen);
-    p.r.z = k*h.z - 0.5*domain.localSize.z + udistr(gen);
-
-    p.u.x = 0.0f * (udistr(gen) - 0.5);
-    p.u.y = 0.0f * (udistr(gen) - 0.5);
-    p.u.z = 0.0f * (udistr(gen) - 0.5);
-
-    return p;
+    std::hash<std::string> nameHash;
+    return nameHash(pv->name);
 }
 
 void addUniformParticles(float density, const MPI_Comm& comm, ParticleVector *pv, PositionFilter filterIn, cudaStream_t stream)
 {
     auto domain = pv->state->domain;
-
-    int3 ncells = make_int3( ceilf(domain.localSize) );
-    float3 h    = domain.localSize / make_float3(ncells);
-
-    int wholeInCell = floor(density);
-    float fracInCell = density - wholeInCell;
-
-    auto seed = genSeed(comm, pv->name);
-    std::mt19937 gen(seed);
-    std::uniform_real_distribution<float> udistr(0, 1);
-
-    double3 avgMomentum{0,0,0};
-    int mycount = 0;
-
-    for (int i = 0; i < ncells.x; i++) {
-        for (int j = 0; j < ncells.y; j++) {
-            for (int k = 0; k < ncells.z; k++) {
-
-                int nparts = wholeInCell;
-                if (udistr(gen) < fracInCell) nparts++;
-
-                for (int p = 0; p < nparts; p++) {
-
-                    auto part = genParticle(h, i, j, k, domain, udistr, gen);
-                    part.i1 = mycount;
-
-                    if (! filterIn(domain.local2global(part.r)))
-                        continue;
-
-                    pv->local()->resize(mycount+1,  stream);
-                    auto cooPtr = pv->local()->coosvels.hostPtr();
-
-                    cooPtr[mycount] = part;
-
-                    avgMomentum.x += part.u.x;
-                    avgMomentum.y += part.u.y;
-                    avgMomentum.z += part.u.z;
-
-                    mycount++;
-                }
-            }
+    UniformSampler sampler(density, domain, genUniformSeed(pv));
+
+    std::vector<Particle> particles;
+    particles.reserve( (size_t) sampler.totalCells() * (sampler.wholeInCell + 1) );
+
+    for (int cid = 0; cid < sampler.totalCells(); cid++)
+    {
+        const int3 cid3 = sampler.cell3D(cid);
+        const int nparts = sampler.nParticles(cid3);
+
+        for (int p = 0; p < nparts; p++)
+        {
+            Particle part;
+            part.r  = sampler.position(cid3, p);
+            part.u  = make_float3(0.0f);
+            part.i1 = particles.size();
+            part.i2 = 0;
+
+            if (filterIn(domain.local2global(part.r)))
+                particles.push_back(part);
         }
     }
 
-    avgMomentum.x /= mycount;
-    avgMomentum.y /= mycount;
-    avgMomentum.z /= mycount;
+    const int idOffset = getUniformIdOffset(comm, particles.size());
+    for (auto& part : particles)
+        part.i1 += idOffset;
 
-    auto cooPtr = pv->local()->coosvels.hostPtr();
+    auto lpv = pv->local();
+    lpv->resize_anew(particles.size());
+    std::copy(particles.begin(), particles.end(), lpv->coosvels.begin());
+    lpv->coosvels.uploadToDevice(stream);
 
-    for (auto& part : pv->local()->coosvels) {
-        part.u.x -= avgMomentum.x;
-        part.u.y -= avgMomentum.y;
-        part.u.z -= avgMomentum.z;
-    }
+    finalizeUniformParticles(pv, stream);
+}
 
-    int totalCount = 0; // TODO: int64!
-    MPI_Check( MPI_Exscan(&mycount, &totalCount, 1, MPI_INT, MPI_SUM, comm) );
-    for (auto& part : pv->local()->coosvels)
-        part.i1 += totalCount;
+int getUniformIdOffset(const MPI_Comm& comm, int count)
+{
+    int offset = 0; // TODO: int64!
+    MPI_Check( MPI_Exscan(&count, &offset, 1, MPI_INT, MPI_SUM, comm) );
+    return offset;
+}
 
-    pv->local()->coosvels.uploadToDevice(stream);
-    pv->local()->extraPerParticle.getData<Particle>(ChannelNames::oldParts)->copy(pv->local()->coosvels, stream);
+void finalizeUniformParticles(ParticleVector *pv, cudaStream_t stream)
+{
+    auto lpv = pv->local();
+    lpv->extraPerParticle.getData<Particle>(ChannelNames::oldParts)->copy(lpv->coosvels, stream);
 
-    debug2("Generated %d %s particles", pv->local()->size(), pv->name.c_str());
+    debug2("Generated %d %s particles", lpv->size(), pv->name.c_str());
 }
@@ -1,3 +1,10 @@
+#pragma once
+
+#include <core/domain.h>
+#include <core/utils/cpu_gpu_defines.h>
+#include <core/utils/helper_math.h>
+
+#include <cstdint>
 #include <functional>
 #include <mpi.h>
 
@@ -5,4 +12,86 @@ using PositionFilter = std::function<bool(float3)>;
 
 class ParticleVector;
 
-void addUniformParticles(float density, const MPI_Comm& comm, ParticleVector *pv, PositionFilter filterOut, cudaStream_t stream);
+/**
+ * Counter-based sampling of uniformly distributed particles.
+ *
+ * The random numbers of a cell only depend on the seed and on the index of the cell
+ * in the global domain, such that the same particles are generated on the host
+ * and on the device, whatever the domain decomposition
+ */
+struct UniformSampler
+{
+    uint64_t seed;
+
+    int3 ncells;          ///< local cells
+    int3 globalCellStart; ///< global index of the first local cell
+    int3 globalNcells;
+    float3 h;
+    DomainInfo domain;
+
+    int wholeInCell;
+    float fracInCell;
+
+    UniformSampler(float density, const DomainInfo& domain, uint64_t seed);
+
+    __HD__ static inline uint64_t mix(uint64_t x)
+    {
+        // splitmix64 finalizer
+        x += 0x9E3779B97F4A7C15ull;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+        return x ^ (x >> 31);
+    }
+
+    /// random number in [0, 1), \p counter-th of the cell
+    __HD__ inline float uniform01(uint64_t globalCellId, int counter) const
+    {
+        const uint64_t r = mix( mix(seed ^ globalCellId) + counter );
+        return (r >> 40) * (1.0f / (1 << 24));
+    }
+
+    __HD__ inline int totalCells() const
+    {
+        return ncells.x * ncells.y * ncells.z;
+    }
+
+    __HD__ inline int3 cell3D(int cid) const
+    {
+        return make_int3(cid % ncells.x, (cid / ncells.x) % ncells.y, cid / (ncells.x * ncells.y));
+    }
+
+    __HD__ inline uint64_t globalCellId(int3 cid) const
+    {
+        const int3 g = cid + globalCellStart;
+        return ((uint64_t) g.z * globalNcells.y + g.y) * globalNcells.x + g.x;
+    }
+
+    /// number of particles of the local cell \p cid before filtering
+    __HD__ inline int nParticles(int3 cid) const
+    {
+        return wholeInCell + (uniform01(globalCellId(cid), 0) < fracInCell ? 1 : 0);
+    }
+
+    /// local coordinates of the particle \p p of the local cell \p cid
+    __HD__ inline float3 position(int3 cid, int p) const
+    {
+        const uint64_t gid = globalCellId(cid);
+        const float3 u = make_float3( uniform01(gid, 3*p + 1),
+                                      uniform01(gid, 3*p + 2),
+                                      uniform01(gid, 3*p + 3) );
+
+        return -0.5f * domain.localSize + (make_float3(cid) + u) * h;
+    }
+};
+
+/// seed of the particles of \p pv, the same on all the ranks
+uint64_t genUniformSeed(const ParticleVector *pv);
+
+/// generate the particles on the host: the filter may be any function, e.g. from python
+void addUniformParticles(float density, const MPI_Comm& comm, ParticleVector *pv, PositionFilter filterIn, cudaStream_t stream);
+
+/// id of the first local particle out of \p count, such that the ids are unique across the ranks
+int getUniformIdOffset(const MPI_Comm& comm, int count);
+
+/// copy the new particles, up to date on the host and on the device, to the other buffers of \p pv
+void finalizeUniformParticles(ParticleVector *pv, cudaStream_t stream);
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "helpers.h"
+
+#include <core/containers.h>
+#include <core/logger.h>
+#include <core/pvs/particle_vector.h>
+#include <core/utils/cuda_common.h>
+#include <core/utils/kernel_launch.h>
+
+#include <extern/cub/cub/device/device_scan.cuh>
+
+namespace UniformICKernels
+{
+/**
+ * One thread per local cell. Without particles, only count the particles
+ * of each cell accepted by the filter, otherwise write them from offsets[cid]
+ */
+template<typename Filter>
+__global__ void generateParticles(UniformSampler sampler, Filter filterIn, int idOffset,
+                                  int *counts, const int *offsets, Particle *particles)
+{
+    const int cid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (cid >= sampler.totalCells()) return;
+
+    const int3 cid3 = sampler.cell3D(cid);
+    const int nparts = sampler.nParticles(cid3);
+    int n = 0;
+
+    for (int p = 0; p < nparts; p++)
+    {
+        const float3 r = sampler.position(cid3, p);
+        if (!filterIn(sampler.domain.local2global(r))) continue;
+
+        if (particles != nullptr)
+        {
+            const int pid = offsets[cid] + n;
+
+            Particle part;
+            part.r  = r;
+            part.u  = make_float3(0.0f);
+            part.i1 = idOffset + pid;
+            part.i2 = 0;
+
+            particles[pid] = part;
+        }
+        n++;
+    }
+
+    if (particles == nullptr)
+        counts[cid] = n;
+}
+} // namespace UniformICKernels
+
+/**
+ * Generate the particles on the device, the filter is a functor or a device lambda
+ * taking the global coordinates of the particle. Gives the same particles as
+ * addUniformParticles() with the same filter
+ */
+template<typename Filter>
+void addUniformParticlesGPU(float density, const MPI_Comm& comm, ParticleVector *pv, Filter filterIn, cudaStream_t stream)
+{
+    UniformSampler sampler(density, pv->state->domain, genUniformSeed(pv));
+
+    const int n = sampler.totalCells();
+    const int nthreads = 128;
+
+    DeviceBuffer<int> counts(n+1), offsets(n+1);
+    PinnedBuffer<int> total(1);
+    DeviceBuffer<char> scanBuffer;
+
+    counts.clear(stream);
+
+    SAFE_KERNEL_LAUNCH(
+            UniformICKernels::generateParticles,
+            getNblocks(n, nthreads), nthreads, 0, stream,
+            sampler, filterIn, 0, counts.devPtr(), nullptr, nullptr );
+
+    size_t bufSize = 0;
+    cub::DeviceScan::ExclusiveSum(nullptr, bufSize, counts.devPtr(), offsets.devPtr(), n+1, stream);
+    scanBuffer.resize_anew(bufSize);
+    cub::DeviceScan::ExclusiveSum(scanBuffer.devPtr(), bufSize, counts.devPtr(), offsets.devPtr(), n+1, stream);
+
+    CUDA_Check( cudaMemcpyAsync(total.hostPtr(), offsets.devPtr() + n, sizeof(int), cudaMemcpyDeviceToHost, stream) );
+    CUDA_Check( cudaStreamSynchronize(stream) );
+
+    const int idOffset = getUniformIdOffset(comm, total[0]);
+
+    auto lpv = pv->local();
+    lpv->resize_anew(total[0]);
+
+    SAFE_KERNEL_LAUNCH(
+            UniformICKernels::generateParticles,
+            getNblocks(n, nthreads), nthreads, 0, stream,
+            sampler, filterIn, idOffset, nullptr, offsets.devPtr(), lpv->coosvels.devPtr() );
+
+    lpv->coosvels.downloadFromDevice(stream, ContainersSynch::Synch);
+
+    finalizeUniformParticles(pv, stream);
+}
@@ -5,12 +5,18 @@
 #include <core/pvs/particle_vector.h>
 #include <core/rigid_kernels/quaternion.h>
 
+#include "helpers.h"
 #include "membrane_ic.h"
 
 MembraneIC::MembraneIC(PyTypes::VectorOfFloat7 com_q, float globalScale) :
     com_q(com_q), globalScale(globalScale)
 {}
 
+MembraneIC::MembraneIC(PyTypes::float3 spacing, bool randomOrientation, float globalScale) :
+    globalScale(globalScale),
+    lattice(new ObjectLattice{make_float3(spacing), randomOrientation})
+{}
+
 MembraneIC::~MembraneIC() = default;
 
 /**
@@ -28,7 +34,7 @@ MembraneIC::~MembraneIC() = default;
  * shifted to the COM and rotated according to Q.
  *
  * The RBCs with COM outside of an MPI process's domain will be discarded on
- * that process.
+ * that process. With a lattice, each process only generates its own RBCs.
  *
  * Set unique id to all the particles and also write unique cell ids into
  * 'ids' per-object channel
@@ -41,35 +47,25 @@ void MembraneIC::exec(const MPI_Comm& comm, ParticleVector* pv, cudaStream_t str
     if (ov == nullptr)
         die("RBCs can only be generated out of rbc object vectors");
 
-    // Local number of objects
-    int nObjs=0;
+    auto placements = lattice ? lattice->getLocal(domain, genUniformSeed(pv)) : getLocalPlacements(com_q, domain);
 
-    for (auto& entry : com_q)
-    {
-        float3 com = {entry[0], entry[1], entry[2]};
-        float4 q   = {entry[3], entry[4], entry[5], entry[6]};
+    const int nObjs = placements.size();
+    const int nvertices = ov->mesh->getNvertices();
+    ov->local()->resize_anew(nObjs * nvertices);
 
-        q = normalize(q);
+    for (int objId = 0; objId < nObjs; objId++)
+    {
+        const float3 com = domain.global2local(placements[objId].com);
+        const float4 q   = placements[objId].q;
 
-        if (domain.globalStart.x <= com.x && com.x < domain.globalStart.x + domain.localSize.x &&
-            domain.globalStart.y <= com.y && com.y < domain.globalStart.y + domain.localSize.y &&
-            domain.globalStart.z <= com.z && com.z < domain.globalStart.z + domain.localSize.z)
+        for (int i = 0; i < nvertices; i++)
         {
-            com = domain.global2local(com);
-            int oldSize = ov->local()->size();
-            ov->local()->resize(oldSize + ov->mesh->getNvertices(), stream);
-
-            for (int i=0; i<ov->mesh->getNvertices(); i++)
-            {
-                float3 r = rotate(f4tof3( ov->mesh->vertexCoordinates[i] * globalScale ), q) + com;
-                Particle p;
-                p.r = r;
-                p.u = make_float3(0);
-
-                ov->local()->coosvels[oldSize + i] = p;
-            }
+            float3 r = rotate(f4tof3( ov->mesh->vertexCoordinates[i] * globalScale ), q) + com;
+            Particle p;
+            p.r = r;
+            p.u = make_float3(0);
 
-            nObjs++;
+            ov->local()->coosvels[objId * nvertices + i] = p;
         }
     }
 
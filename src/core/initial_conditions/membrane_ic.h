@@ -1,9 +1,11 @@
 #pragma once
 
 #include "interface.h"
+#include "object_placement.h"
 
 #include <core/utils/pytypes.h>
 
+#include <memory>
 #include <string>
 
 /**
@@ -14,6 +16,9 @@ class MembraneIC : public InitialConditions
 public:
     MembraneIC(PyTypes::VectorOfFloat7 com_q, float globalScale = 1.0f);
 
+    /// place the membranes on a lattice, each rank only generates its own ones
+    MembraneIC(PyTypes::float3 spacing, bool randomOrientation, float globalScale = 1.0f);
+
     void exec(const MPI_Comm& comm, ParticleVector* pv, cudaStream_t stream) override;
 
     ~MembraneIC();
@@ -21,4 +26,5 @@ public:
 private:
     float globalScale;
     PyTypes::VectorOfFloat7 com_q;
+    std::unique_ptr<ObjectLattice> lattice;
 };
@@ -0,0 +1,76 @@
+#include "object_placement.h"
+#include "helpers.h"
+
+#include <core/logger.h>
+
+#include <cmath>
+
+static float uniform01(uint64_t seed, uint64_t counter)
+{
+    const uint64_t r = UniformSampler::mix( UniformSampler::mix(seed) + counter );
+    return (r >> 40) * (1.0f / (1 << 24));
+}
+
+/// uniformly distributed rotation, K. Shoemake, Graphics Gems III, 1992
+static float4 randomQuaternion(uint64_t seed, uint64_t nodeId)
+{
+    const float u1 = uniform01(seed, 3*nodeId + 0);
+    const float u2 = uniform01(seed, 3*nodeId + 1) * 2.0f * M_PI;
+    const float u3 = uniform01(seed, 3*nodeId + 2) * 2.0f * M_PI;
+
+    const float a = sqrtf(1.0f - u1);
+    const float b = sqrtf(u1);
+
+    return make_float4(a * sinf(u2), a * cosf(u2), b * sinf(u3), b * cosf(u3));
+}
+
+std::vector<ObjectPlacement> ObjectLattice::getLocal(const DomainInfo& domain, uint64_t seed) const
+{
+    if (spacing.x <= 0.0f || spacing.y <= 0.0f || spacing.z <= 0.0f)
+        die("Lattice spacing must be positive, got [%g %g %g]", spacing.x, spacing.y, spacing.z);
+
+    // the nodes are in the middle of the lattice cells, the spacing is adjusted to tile the domain
+    const int3 n = max( make_int3(1), make_int3( floorf(domain.globalSize / spacing + 1e-3f) ) );
+    const float3 h = domain.globalSize / make_float3(n);
+
+    // nodes of the local subdomain, with one of margin for the round-off
+    const int3 start = max( make_int3(0),  make_int3( floorf(domain.globalStart / h - 0.5f) ) );
+    const int3 end   = min( n, make_int3( ceilf((domain.globalStart + domain.localSize) / h - 0.5f) ) + 1 );
+
+    std::vector<ObjectPlacement> placements;
+
+    for (int iz = start.z; iz < end.z; iz++)
+        for (int iy = start.y; iy < end.y; iy++)
+            for (int ix = start.x; ix < end.x; ix++)
+            {
+                const float3 com = (make_float3(ix, iy, iz) + 0.5f) * h;
+                if (!domain.inSubDomain(com)) continue;
+
+                const uint64_t nodeId = ((uint64_t) iz * n.y + iy) * n.x + ix;
+                const float4 q = randomOrientation ? randomQuaternion(seed, nodeId) : make_float4(0.0f, 0.0f, 0.0f, 1.0f);
+
+                placements.push_back({com, normalize(q), -1});
+            }
+
+    debug("Lattice of [%d %d %d] objects, %d of them in the local subdomain",
+          n.x, n.y, n.z, (int) placements.size());
+
+    return placements;
+}
+
+std::vector<ObjectPlacement> getLocalPlacements(const PyTypes::VectorOfFloat7& com_q, const DomainInfo& domain)
+{
+    std::vector<ObjectPlacement> placements;
+
+    for (int i = 0; i < com_q.size(); i++)
+    {
+        auto& entry = com_q[i];
+        const float3 com = {entry[0], entry[1], entry[2]};
+        const float4 q   = {entry[3], entry[4], entry[5], entry[6]};
+
+        if (domain.inSubDomain(com))
+            placements.push_back({com, normalize(q), i});
+    }
+
+    return placements;
+}
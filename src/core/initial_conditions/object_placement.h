@@ -0,0 +1,33 @@
+#pragma once
+
+#include <core/domain.h>
+#include <core/utils/pytypes.h>
+
+#include <cstdint>
+#include <vector>
+
+/// position and orientation of one object to create in the local subdomain
+struct ObjectPlacement
+{
+    float3 com; ///< global coordinates
+    float4 q;   ///< normalized rotation quaternion
+    int srcId;  ///< index in the list of the user, -1 for the generated objects
+};
+
+/**
+ * Objects placed at the nodes of a regular lattice filling the whole domain.
+ *
+ * Every subdomain enumerates only the nodes it owns, and the orientation of an object
+ * only depends on the seed and on the global index of its node, such that
+ * the placement is independent of the domain decomposition
+ */
+struct ObjectLattice
+{
+    float3 spacing;
+    bool randomOrientation;
+
+    std::vector<ObjectPlacement> getLocal(const DomainInfo& domain, uint64_t seed) const;
+};
+
+/// keep the entries of \p com_q with the COM in the local subdomain
+std::vector<ObjectPlacement> getLocalPlacements(const PyTypes::VectorOfFloat7& com_q, const DomainInfo& domain);
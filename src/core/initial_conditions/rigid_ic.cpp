@@ -1,3 +1,4 @@
+#include "helpers.h"
 #include "rigid_ic.h"
 
 #include <random>
@@ -47,6 +48,11 @@ RigidIC::RigidIC(PyTypes::VectorOfFloat7 com_q, const PyTypes::VectorOfFloat3& c
         die("Incompatible sizes of initial positions and rotations");
 }
 
+RigidIC::RigidIC(PyTypes::float3 spacing, bool randomOrientation, const PyTypes::VectorOfFloat3& coords) :
+    coords(coords),
+    lattice(new ObjectLattice{make_float3(spacing), randomOrientation})
+{}
+
 RigidIC::~RigidIC() = default;
 
 
@@ -67,34 +73,33 @@ void RigidIC::exec(const MPI_Comm& comm, ParticleVector* pv, cudaStream_t stream
     if (ov == nullptr)
         die("Can only generate rigid object vector");
 
-    copyToPinnedBuffer(coords, ov->initialPositions, stream);
-    if (ov->objSize != ov->initialPositions.size())
-        die("Object size and XYZ initial conditions don't match in size for '%s': %d vs %d",
-            ov->name.c_str(), ov->objSize, ov->initialPositions.size());
+    auto frozen = coords;
+    ov->selectFrozenParticles(frozen);
+    copyToPinnedBuffer(frozen, ov->initialPositions, stream);
 
-    int nObjs=0;
-    HostBuffer<RigidMotion> motions;
+    auto domain = ov->state->domain;
+    auto placements = lattice ? lattice->getLocal(domain, genUniformSeed(pv)) : getLocalPlacements(com_q, domain);
 
-    for (int i=0; i<com_q.size(); i++)
+    const int nObjs = placements.size();
+    HostBuffer<RigidMotion> motions(nObjs);
+
+    for (int i = 0; i < nObjs; i++)
     {
-        auto& entry = com_q[i];
-        
+        auto& placement = placements[i];
+
         // Zero everything at first
         RigidMotion motion{};
         
-        motion.r = {entry[0], entry[1], entry[2]};
-        motion.q = make_rigidReal4( make_float4(entry[3], entry[4], entry[5], entry[6]) );
-        motion.q = normalize(motion.q);
+        motion.r = make_rigidReal3( domain.global2local(placement.com) );
+        motion.q = make_rigidReal4( placement.q );
         
-        if (i < comVelocities.size()) motion.vel = {comVelocities[i][0], comVelocities[i][1], comVelocities[i][2]};
-
-        if (ov->state->domain.inSubDomain(motion.r))
+        if (placement.srcId >= 0 && placement.srcId < comVelocities.size())
         {
-            motion.r = make_rigidReal3( ov->state->domain.global2local(make_float3(motion.r)) );
-            motions.resize(nObjs + 1);
-            motions[nObjs] = motion;
-            nObjs++;
+            auto& vel = comVelocities[placement.srcId];
+            motion.vel = {vel[0], vel[1], vel[2]};
         }
+
+        motions[i] = motion;
     }
 
     ov->local()->resize_anew(nObjs * ov->objSize);
@@ -1,21 +1,28 @@
 #pragma once
 
 #include "interface.h"
+#include "object_placement.h"
 
 #include <core/utils/pytypes.h>
 
+#include <memory>
+
 class RigidIC : public InitialConditions
 {
 private:
     PyTypes::VectorOfFloat3 coords;
     PyTypes::VectorOfFloat7 com_q;
     PyTypes::VectorOfFloat3 comVelocities;
+    std::unique_ptr<ObjectLattice> lattice;
 
 public:
     RigidIC(PyTypes::VectorOfFloat7 com_q, std::string xyzfname);
     RigidIC(PyTypes::VectorOfFloat7 com_q, const PyTypes::VectorOfFloat3& coords);
     RigidIC(PyTypes::VectorOfFloat7 com_q, const PyTypes::VectorOfFloat3& coords, const PyTypes::VectorOfFloat3& comVelocities);
 
+    /// place the objects on a lattice, each rank only generates its own ones
+    RigidIC(PyTypes::float3 spacing, bool randomOrientation, const PyTypes::VectorOfFloat3& coords);
+
     void exec(const MPI_Comm& comm, ParticleVector* pv, cudaStream_t stream) override;
 
     ~RigidIC();
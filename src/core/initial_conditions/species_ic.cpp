@@ -0,0 +1,46 @@
+#include "species_ic.h"
+
+#include <core/pvs/particle_vector.h>
+#include <core/utils/common.h>
+
+SpeciesIC::SpeciesIC(std::shared_ptr<InitialConditions> ic, SpeciesFunction species) :
+    ic(ic),
+    species(species)
+{}
+
+SpeciesIC::SpeciesIC(std::shared_ptr<InitialConditions> ic, std::function<int(PyTypes::float3)> pyspecies) :
+    SpeciesIC(ic,
+              [pyspecies](float3 r) {
+                  PyTypes::float3 pyr {r.x, r.y, r.z};
+                  return pyspecies(pyr);
+              })
+{}
+
+SpeciesIC::~SpeciesIC() = default;
+
+void SpeciesIC::exec(const MPI_Comm& comm, ParticleVector *pv, cudaStream_t stream)
+{
+    ic->exec(comm, pv, stream);
+
+    pv->requireDataPerParticle<int>(ChannelNames::species, ExtraDataManager::PersistenceMode::Persistent);
+
+    auto lpv = pv->local();
+    auto speciesData = lpv->extraPerParticle.getData<int>(ChannelNames::species);
+    const auto& domain = pv->state->domain;
+
+    lpv->coosvels.downloadFromDevice(stream, ContainersSynch::Synch);
+
+    for (int i = 0; i < lpv->size(); i++)
+    {
+        const float3 r = domain.local2global(lpv->coosvels[i].r);
+        const int s = species(r);
+
+        if (s < 0)
+            die("Species of the particles of '%s' must be non-negative, got %d at [%f %f %f]",
+                pv->name.c_str(), s, r.x, r.y, r.z);
+
+        (*speciesData)[i] = s;
+    }
+
+    speciesData->uploadToDevice(stream);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "interface.h"
+
+#include <core/utils/pytypes.h>
+
+#include <functional>
+#include <memory>
+
+/**
+ * Run another initial condition, then set the species of every particle from its position,
+ * see ChannelNames::species and BasicInteractionMultiSpecies.
+ * The species must be smaller than the size of the matrices of the interactions
+ */
+class SpeciesIC : public InitialConditions
+{
+public:
+    using SpeciesFunction = std::function<int(float3)>;
+
+    SpeciesIC(std::shared_ptr<InitialConditions> ic, SpeciesFunction species);
+    SpeciesIC(std::shared_ptr<InitialConditions> ic, std::function<int(PyTypes::float3)> species);
+    ~SpeciesIC();
+
+    void exec(const MPI_Comm& comm, ParticleVector *pv, cudaStream_t stream) override;
+
+private:
+    std::shared_ptr<InitialConditions> ic;
+    SpeciesFunction species;
+};
@@ -1,5 +1,5 @@
 #include "uniform_ic.h"
-#include "helpers.h"
+#include "helpers.impl.h"
 
 UniformIC::UniformIC(float density) :
     density(density)
@@ -22,6 +22,7 @@ UniformIC::~UniformIC() = default;
  * Here \f$ \rho \f$ is the target number density: #density
  *
  * Each particle will have a unique id across all MPI processes in Particle::i1.
+ * The particles are generated on the GPU and do not depend on the domain decomposition.
  *
  * \rst
  * .. note::
@@ -30,9 +31,9 @@ UniformIC::~UniformIC() = default;
  */
 void UniformIC::exec(const MPI_Comm& comm, ParticleVector *pv, cudaStream_t stream)
 {
-    auto filterInKeepAll = [](float3) {
+    auto filterInKeepAll = [] __device__ (float3) {
         return true;
     };
     
-    addUniformParticles(density, comm, pv, filterInKeepAll, stream);
+    addUniformParticlesGPU(density, comm, pv, filterInKeepAll, stream);
 }
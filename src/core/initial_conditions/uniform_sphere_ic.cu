@@ -1,7 +1,7 @@
 #include <core/pvs/particle_vector.h>
 
 #include "uniform_sphere_ic.h"
-#include "helpers.h"
+#include "helpers.impl.h"
 
 UniformSphereIC::UniformSphereIC(float density, float3 center, float radius, bool inside) :
     density(density),
@@ -18,7 +18,12 @@ UniformSphereIC::~UniformSphereIC() = default;
     
 void UniformSphereIC::exec(const MPI_Comm& comm, ParticleVector* pv, cudaStream_t stream)
 {
-    auto filterSphere = [this](float3 r) {
+    // device lambdas can not capture this
+    const float3 center = this->center;
+    const float radius  = this->radius;
+    const bool inside   = this->inside;
+
+    auto filterSphere = [center, radius, inside] __device__ (float3 r) {
         r -= center;
         bool is_inside = length(r) <= radius;
         
@@ -26,6 +31,6 @@ void UniformSphereIC::exec(const MPI_Comm& comm, ParticleVector* pv, cudaStream_
         else        return !is_inside;
     };
     
-    addUniformParticles(density, comm, pv, filterSphere, stream);
+    addUniformParticlesGPU(density, comm, pv, filterSphere, stream);
 }
 
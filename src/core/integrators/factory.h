@@ -1,11 +1,14 @@
 #pragma once
 
 #include "const_omega.h"
+#include "forcing_terms/andersen.h"
 #include "forcing_terms/const_dp.h"
+#include "forcing_terms/langevin.h"
 #include "forcing_terms/none.h"
 #include "forcing_terms/periodic_poiseuille.h"
 #include "oscillate.h"
 #include "rigid_vv.h"
+#include "sub_step.h"
 #include "sub_step_membrane.h"
 #include "translate.h"
 #include "vv.h"
@@ -18,21 +21,21 @@
 namespace IntegratorFactory
 {
 static std::shared_ptr<IntegratorVV<Forcing_None>>
-createVV(const YmrState *state, std::string name)
+createVV(const YmrState *state, std::string name, bool fusedBinning = false, bool fusedWallBounce = false)
 {
     Forcing_None forcing;
-    return std::make_shared<IntegratorVV<Forcing_None>> (state, name, forcing);
+    return std::make_shared<IntegratorVV<Forcing_None>> (state, name, forcing, fusedBinning, fusedWallBounce);
 }
 
 static std::shared_ptr<IntegratorVV<Forcing_ConstDP>>
-createVV_constDP(const YmrState *state, std::string name, PyTypes::float3 extraForce)
+createVV_constDP(const YmrState *state, std::string name, PyTypes::float3 extraForce, bool fusedBinning = false, bool fusedWallBounce = false)
 {
     Forcing_ConstDP forcing(make_float3(extraForce));
-    return std::make_shared<IntegratorVV<Forcing_ConstDP>> (state, name, forcing);
+    return std::make_shared<IntegratorVV<Forcing_ConstDP>> (state, name, forcing, fusedBinning, fusedWallBounce);
 }
 
 static std::shared_ptr<IntegratorVV<Forcing_PeriodicPoiseuille>>
-createVV_PeriodicPoiseuille(const YmrState *state, std::string name, float force, std::string direction)
+createVV_PeriodicPoiseuille(const YmrState *state, std::string name, float force, std::string direction, bool fusedBinning = false, bool fusedWallBounce = false)
 {
     Forcing_PeriodicPoiseuille::Direction dir;
     if      (direction == "x") dir = Forcing_PeriodicPoiseuille::Direction::x;
@@ -41,7 +44,29 @@ createVV_PeriodicPoiseuille(const YmrState *state, std::string name, float force
     else die("Direction can only be 'x' or 'y' or 'z'");
         
     Forcing_PeriodicPoiseuille forcing(force, dir);
-    return std::make_shared<IntegratorVV<Forcing_PeriodicPoiseuille>> (state, name, forcing);
+    return std::make_shared<IntegratorVV<Forcing_PeriodicPoiseuille>> (state, name, forcing, fusedBinning, fusedWallBounce);
+}
+
+static std::shared_ptr<IntegratorVV<Forcing_Andersen>>
+createVV_Andersen(const YmrState *state, std::string name, float kBT, float frequency, long seed,
+                  bool fusedBinning = false, bool fusedWallBounce = false)
+{
+    if (kBT < 0.0f || frequency < 0.0f)
+        die("Andersen thermostat '%s' needs a non negative temperature and frequency, got %g and %g", name.c_str(), kBT, frequency);
+
+    Forcing_Andersen forcing(kBT, frequency, seed);
+    return std::make_shared<IntegratorVV<Forcing_Andersen>> (state, name, forcing, fusedBinning, fusedWallBounce);
+}
+
+static std::shared_ptr<IntegratorVV<Forcing_Langevin>>
+createVV_Langevin(const YmrState *state, std::string name, float kBT, float gamma, long seed,
+                  bool fusedBinning = false, bool fusedWallBounce = false)
+{
+    if (kBT < 0.0f || gamma < 0.0f)
+        die("Langevin thermostat '%s' needs a non negative temperature and friction, got %g and %g", name.c_str(), kBT, gamma);
+
+    Forcing_Langevin forcing(kBT, gamma, seed);
+    return std::make_shared<IntegratorVV<Forcing_Langevin>> (state, name, forcing, fusedBinning, fusedWallBounce);
 }
 
 static std::shared_ptr<IntegratorConstOmega>
@@ -73,4 +98,11 @@ createSubStepMembrane(const YmrState *state, std::string name, int substeps, Int
 {
     return std::make_shared<IntegratorSubStepMembrane> (state, name, substeps, fastForces);
 }    
+
+static std::shared_ptr<IntegratorSubStep>
+createSubStep(const YmrState *state, std::string name, int substeps,
+              std::vector<Interaction*> fastForces, float maxDisplacement)
+{
+    return std::make_shared<IntegratorSubStep> (state, name, substeps, fastForces, maxDisplacement);
+}
 } // namespace IntegratorFactory
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <core/datatypes.h>
+#include <core/pvs/particle_vector.h>
+
+#include <core/utils/cpu_gpu_defines.h>
+#include <core/utils/helper_math.h>
+#include <core/utils/philox.h>
+
+#include <cmath>
+
+class ParticleVector;
+
+/**
+ * Andersen thermostat: at every step, every particle gets a new velocity from the Maxwell distribution
+ * at temperature kBT with probability 1 - exp(-frequency * dt). The forces are not modified,
+ * the velocities are resampled after the kick, see thermalize().
+ *
+ * The random numbers only depend on the particle id and on the step,
+ * the two threads integrating a particle thus draw the same
+ */
+class Forcing_Andersen
+{
+public:
+    Forcing_Andersen(float kBT, float frequency, long seed) :
+        kBT(kBT),
+        frequency(frequency),
+        key(Philox::makeKey(seed))
+    {}
+
+    void setup(ParticleVector* pv, float t)
+    {
+        const float dt = pv->state->dt;
+
+        step = pv->state->currentStep;
+        probability = 1.0f - expf(-frequency * dt);
+        sigma = sqrtf(kBT / pv->mass);
+    }
+
+    __D__ inline float3 operator()(float3 original, Particle p) const
+    {
+        return original;
+    }
+
+    /// resample the velocity \p p.u after the kick
+    __D__ inline void thermalize(Particle& p) const
+    {
+        const uint4 r = Philox::philox4x32(make_uint4((uint32_t) p.i1, (uint32_t) step, 0u, 1u), key);
+        if (Philox::toUniform01(r.x) > probability) return;
+
+        const float4 n = Philox::normal4(make_uint4((uint32_t) p.i1, (uint32_t) step, 0u, 2u), key);
+        p.u = sigma * make_float3(n.x, n.y, n.z);
+    }
+
+private:
+    float kBT, frequency;
+    uint2 key;
+
+    int step;
+    float probability, sigma;
+};
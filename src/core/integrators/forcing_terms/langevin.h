@@ -0,0 +1,59 @@
+#pragma once
+
+#include <core/datatypes.h>
+#include <core/pvs/particle_vector.h>
+
+#include <core/utils/cpu_gpu_defines.h>
+#include <core/utils/helper_math.h>
+#include <core/utils/philox.h>
+
+#include <cmath>
+
+class ParticleVector;
+
+/**
+ * Langevin thermostat applied exactly over one step after the kick, see thermalize():
+ * \f$ \mathbf{v} \leftarrow c \, \mathbf{v} + \sqrt{(1 - c^2) k_BT / m} \, \boldsymbol{\xi} \f$,
+ * with \f$ c = e^{-\gamma \delta t} \f$ and \f$ \boldsymbol{\xi} \f$ normally distributed.
+ * The velocities are rescaled towards the thermal ones at the rate gamma, the forces are not modified.
+ *
+ * The random numbers only depend on the particle id and on the step,
+ * the two threads integrating a particle thus draw the same
+ */
+class Forcing_Langevin
+{
+public:
+    Forcing_Langevin(float kBT, float gamma, long seed) :
+        kBT(kBT),
+        gamma(gamma),
+        key(Philox::makeKey(seed))
+    {}
+
+    void setup(ParticleVector* pv, float t)
+    {
+        const float dt = pv->state->dt;
+
+        step = pv->state->currentStep;
+        c = expf(-gamma * dt);
+        sigma = sqrtf((1.0f - c*c) * kBT / pv->mass);
+    }
+
+    __D__ inline float3 operator()(float3 original, Particle p) const
+    {
+        return original;
+    }
+
+    /// damp the velocity \p p.u after the kick and add the matching noise
+    __D__ inline void thermalize(Particle& p) const
+    {
+        const float4 n = Philox::normal4(make_uint4((uint32_t) p.i1, (uint32_t) step, 0u, 3u), key);
+        p.u = c * p.u + sigma * make_float3(n.x, n.y, n.z);
+    }
+
+private:
+    float kBT, gamma;
+    uint2 key;
+
+    int step;
+    float c, sigma;
+};
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <core/celllist.h>
 #include <core/utils/cuda_common.h>
 #include <core/datatypes.h>
 #include <core/pvs/particle_vector.h>
@@ -7,26 +8,20 @@
 
 
 /**
- * \code transform(Particle& p, const float3 f, const float invm, const float dt) \endcode
- *  is a callable that performs integration. It is called for
- *  every particle and should change velocity and coordinate
- *  of the Particle according to the chosen integration scheme.
- *
- * Will read from \c old_particles channel and write to ParticleVector::coosvels
+ * Integrate the particle of \p gid as in integrationKernel(),
+ * both threads of the pair hold the whole old particle \p pOld and the new one \p p
  */
 template<typename Transform>
-__global__ void integrationKernel(PVviewWithOldParticles pvView, const float dt, Transform transform)
+__device__ inline void integrateEntry(const PVviewWithOldParticles& pvView, const float dt, Transform& transform, int gid,
+                                      Particle& pOld, Particle& p)
 {
-    const int gid = blockIdx.x * blockDim.x + threadIdx.x;
     const int pid = gid / 2;
     const int sh  = gid % 2;  // sh = 0 loads coordinate, sh = 1 -- velocity
-    if (pid >= pvView.size) return;
 
     float4 val = readNoCache(pvView.old_particles + gid);
     Float3_int frc(pvView.forces[pid]);
 
     // Exchange coordinate and velocity with adjacent thread
-    Particle p;
     float4 othval;
     
     othval.x = warpShflXor(val.x, 1);
@@ -35,20 +30,122 @@ __global__ void integrationKernel(PVviewWithOldParticles pvView, const float dt,
     othval.w = warpShflXor(val.w, 1);
 
     // val is coordinate, othval is corresponding velocity
-    if (sh == 0)
-    {
-        p = Particle(val, othval);
-        transform(p, frc.v, pvView.invMass, dt);
-        val = p.r2Float4();
-    }
+    if (sh == 0) pOld = Particle(val, othval);
 
     // val is velocity, othval is coordinate
-    if (sh == 1)
+    if (sh == 1) pOld = Particle(othval, val);
+
+    p = pOld;
+    transform(p, frc.v, pvView.invMass, dt);
+}
+
+/// the part of \p p handled by the thread \p gid: coordinate if even, velocity otherwise
+__device__ inline float4 entryOf(const Particle& p, int gid)
+{
+    return (gid % 2 == 0) ? p.r2Float4() : p.u2Float4();
+}
+
+/**
+ * \code transform(Particle& p, const float3 f, const float invm, const float dt) \endcode
+ *  is a callable that performs integration. It is called for
+ *  every particle and should change velocity and coordinate
+ *  of the Particle according to the chosen integration scheme.
+ *
+ * Will read from \c old_particles channel and write to ParticleVector::coosvels
+ */
+template<typename Transform>
+__global__ void integrationKernel(PVviewWithOldParticles pvView, const float dt, Transform transform)
+{
+    const int gid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (gid / 2 >= pvView.size) return;
+
+    Particle pOld, p;
+    integrateEntry(pvView, dt, transform, gid, pOld, p);
+    writeNoCache(pvView.particles + gid, entryOf(p, gid));
+}
+
+/**
+ * Same as integrationKernel(), and counts the particles staying in the subdomain
+ * per cell of \p cinfo with the new coordinates, see CellList::beginExternalBinning()
+ */
+template<typename Transform>
+__global__ void integrationKernelBinned(PVviewWithOldParticles pvView, const float dt, Transform transform, CellListInfo cinfo)
+{
+    const int gid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (gid / 2 >= pvView.size) return;
+
+    Particle pOld, p;
+    integrateEntry(pvView, dt, transform, gid, pOld, p);
+
+    const float4 val = entryOf(p, gid);
+    writeNoCache(pvView.particles + gid, val);
+
+    if (gid % 2 == 0)
+        cinfo.binStaying(val);
+}
+
+/**
+ * Same as integrationKernel(), the new particles are then bounced with
+ * \code float3 bounce(Particle& p, const float3 rOld, const float mass, const float dt) \endcode
+ * returning the force exerted on the wall, see BounceKernels::FusedBounce.
+ * Both threads of a pair bounce the same particle, only the first one accounts the force in \p totalForce
+ */
+template<typename Transform, typename Bounce>
+__global__ void integrationKernelBounced(PVviewWithOldParticles pvView, const float dt, Transform transform,
+                                         Bounce bounce, double3 *totalForce)
+{
+    const int gid = blockIdx.x * blockDim.x + threadIdx.x;
+    const bool active = gid / 2 < pvView.size;
+
+    float3 force {0.f, 0.f, 0.f};
+
+    if (active)
     {
-        p = Particle(othval, val);
-        transform(p, frc.v, pvView.invMass, dt);
-        val = p.u2Float4();
+        Particle pOld, p;
+        integrateEntry(pvView, dt, transform, gid, pOld, p);
+
+        const float3 f = bounce(p, pOld.r, pvView.mass, dt);
+        if (gid % 2 == 0) force = f;
+
+        writeNoCache(pvView.particles + gid, entryOf(p, gid));
     }
 
+    force = warpReduce(force, [](float a, float b){return a+b;});
+
+    if ((__laneid() == 0) && (length(force) > 1e-8f))
+        atomicAdd(totalForce, make_double3(force));
+}
+
+/**
+ * Same as integrationKernel(), restricted to the particles of the boundary cells of \p cinfo
+ * (the outer layer of cells, those scanned by the redistribution), or to all the others.
+ * The cell of a particle is that of its old coordinate, from which the cell-list was built.
+ * With \p binned, also counts the staying particles as integrationKernelBinned()
+ */
+template<typename Transform>
+__global__ void integrationKernelSplit(PVviewWithOldParticles pvView, const float dt, Transform transform,
+                                       CellListInfo cinfo, bool boundary, bool binned)
+{
+    const int gid = blockIdx.x * blockDim.x + threadIdx.x;
+    const int pid = gid / 2;
+    if (pid >= pvView.size) return;
+
+    // both threads of the pair take the same branch
+    const float4 rOld = pvView.old_particles[2*pid];
+    const int3 cid3 = cinfo.getCellIdAlongAxes(make_float3(rOld));
+
+    const bool inBoundary = cid3.x == 0 || cid3.x == cinfo.ncells.x - 1 ||
+                            cid3.y == 0 || cid3.y == cinfo.ncells.y - 1 ||
+                            cid3.z == 0 || cid3.z == cinfo.ncells.z - 1;
+
+    if (inBoundary != boundary) return;
+
+    Particle pOld, p;
+    integrateEntry(pvView, dt, transform, gid, pOld, p);
+
+    const float4 val = entryOf(p, gid);
     writeNoCache(pvView.particles + gid, val);
+
+    if (binned && gid % 2 == 0)
+        cinfo.binStaying(val);
 }
@@ -8,3 +8,32 @@ Integrator::~Integrator() = default;
 
 void Integrator::setPrerequisites(ParticleVector *pv)
 {}
+
+std::string Integrator::getBatchKey() const
+{
+    return "";
+}
+
+void Integrator::stage2Batch(const std::vector<ParticleVector*>& pvs, cudaStream_t stream)
+{
+    for (auto pv : pvs)
+        stage2(pv, stream);
+}
+
+bool Integrator::setBinningCellList(ParticleVector *pv, CellList *cl)
+{
+    return false;
+}
+
+bool Integrator::setBouncingWall(ParticleVector *pv, Wall *wall)
+{
+    return false;
+}
+
+bool Integrator::setSplitCellList(ParticleVector *pv, CellList *cl)
+{
+    return false;
+}
+
+void Integrator::stage2Interior(ParticleVector *pv, cudaStream_t stream)
+{}
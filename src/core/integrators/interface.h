@@ -5,7 +5,12 @@
 
 #include "core/ymero_object.h"
 
+#include <string>
+#include <vector>
+
 class ParticleVector;
+class CellList;
+class Wall;
 
 /**
  * Integrate ParticleVectors
@@ -48,4 +53,57 @@ public:
      * Called from Simulation right after setup
      */
     virtual void setPrerequisites(ParticleVector *pv);
+
+    /**
+     * Integrators with the same non-empty key can perform stage2()
+     * of all their ParticleVectors at once, see stage2Batch()
+     * default: empty, never batched
+     */
+    virtual std::string getBatchKey() const;
+
+    /**
+     * Second integration stage of all the \p pvs at once;
+     * called by Simulation on the first integrator of the batch,
+     * all the \p pvs are integrated by integrators with the same batch key
+     * default: call stage2() of each ParticleVector
+     */
+    virtual void stage2Batch(const std::vector<ParticleVector*>& pvs, cudaStream_t stream);
+
+    /**
+     * Offer to count the particles of \p pv per cell of \p cl during stage2(),
+     * such that the next CellList::build() only counts the arrivals.
+     * Called from Simulation at setup; \p cl is nullptr if the particles of \p pv
+     * may move between the integration and the build, e.g. bounced from walls
+     * default: no binning
+     *
+     * @return true if stage2() will bin the particles of \p pv
+     */
+    virtual bool setBinningCellList(ParticleVector *pv, CellList *cl);
+
+    /**
+     * Offer to bounce the particles of \p pv from \p wall within stage2(), see Wall::fuseBounce().
+     * Called from Simulation at setup for the ParticleVectors with walls;
+     * \p wall is nullptr if \p pv is bounced from several walls
+     * default: no fused bounce
+     *
+     * @return true if stage2() will bounce the particles of \p pv
+     */
+    virtual bool setBouncingWall(ParticleVector *pv, Wall *wall);
+
+    /**
+     * Offer to split stage2() of \p pv along the cells of its primary cell-list \p cl:
+     * stage2() then only integrates the particles of the boundary cells, such that the
+     * redistribution can start, and stage2Interior() integrates the others meanwhile.
+     * Called from Simulation at setup, see Simulation::setEarlyRedistribution()
+     * default: no split
+     *
+     * @return true if stage2() of \p pv will be split
+     */
+    virtual bool setSplitCellList(ParticleVector *pv, CellList *cl);
+
+    /**
+     * Second part of a split stage2(), see setSplitCellList()
+     * default: nothing
+     */
+    virtual void stage2Interior(ParticleVector *pv, cudaStream_t stream);
 };
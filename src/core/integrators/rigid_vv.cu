@@ -37,7 +37,7 @@ void IntegratorVVRigid::stage1(ParticleVector *pv, cudaStream_t stream)
 
 
 /**
- * The function steps are as follows:
+ * The function steps are as follows, all fused in one kernel with a block per object:
  *
  * - Collect the forces from the particles to get total force and torque per object
  * - Integrate object's COM coordinate RigidMotion::r and quatertion orientation
@@ -58,32 +58,76 @@ void IntegratorVVRigid::stage2(ParticleVector *pv, cudaStream_t stream)
 
     ROVviewWithOldMotion ovView(ov, ov->local());
 
-    SAFE_KERNEL_LAUNCH(
-            RigidIntegrationKernels::collectRigidForces,
-            getNblocks(2*ovView.size, 128), 128, 0, stream,
-            ovView );
+    const int nthreads = 128;
 
     SAFE_KERNEL_LAUNCH(
-            RigidIntegrationKernels::integrateRigidMotion,
-            getNblocks(ovView.nObjects, 64), 64, 0, stream,
-            ovView, dt );
+            RigidIntegrationKernels::integrateRigidObjects,
+            ovView.nObjects, nthreads, 0, stream,
+            ovView, ov->initialPositions.devPtr(), dt );
 
-    SAFE_KERNEL_LAUNCH(
-            RigidIntegrationKernels::applyRigidMotion,
-            getNblocks(ovView.size, 128), 128, 0, stream,
-            ovView, ov->initialPositions.devPtr() );
+    invalidate(pv);
+}
+
+std::string IntegratorVVRigid::getBatchKey() const
+{
+    return "rigid_vv";
+}
+
+/**
+ * Same as stage2() for all the \p pvs in one launch,
+ * one block per object of all the rigid object vectors
+ */
+void IntegratorVVRigid::stage2Batch(const std::vector<ParticleVector*>& pvs, cudaStream_t stream)
+{
+    if (pvs.size() == 1)
+    {
+        stage2(pvs[0], stream);
+        return;
+    }
+
+    using RigidIntegrationKernels::RigidBatchEntry;
+
+    float dt = state->dt;
+    const int nthreads = 128;
+
+    batchEntries.resize_anew(pvs.size() * sizeof(RigidBatchEntry));
+    auto entries = reinterpret_cast<RigidBatchEntry*>(batchEntries.hostPtr());
+
+    int nBlocks = 0;
+    for (int i = 0; i < pvs.size(); i++)
+    {
+        auto ov = dynamic_cast<RigidObjectVector*> (pvs[i]);
+
+        entries[i].view       = ROVviewWithOldMotion(ov, ov->local());
+        entries[i].initial    = ov->initialPositions.devPtr();
+        entries[i].firstBlock = nBlocks;
+
+        nBlocks += entries[i].view.nObjects;
+    }
+
+    debug("Integrating %d rigid objects of %d object vectors in one batch, timestep is %f",
+          nBlocks, (int) pvs.size(), dt);
+
+    batchEntries.uploadToDevice(stream);
 
     SAFE_KERNEL_LAUNCH(
-            RigidIntegrationKernels::clearRigidForces,
-            getNblocks(ovView.nObjects, 64), 64, 0, stream,
-            ovView );
+            RigidIntegrationKernels::integrateRigidObjectsBatched,
+            nBlocks, nthreads, 0, stream,
+            (int) pvs.size(), reinterpret_cast<const RigidBatchEntry*>(batchEntries.devPtr()), dt );
+
+    for (auto pv : pvs)
+        invalidate(pv);
+}
+
+void IntegratorVVRigid::invalidate(ParticleVector *pv)
+{
+    auto ov = dynamic_cast<RigidObjectVector*> (pv);
 
     // PV may have changed, invalidate all
     pv->haloValid = false;
     pv->redistValid = false;
     pv->cellListStamp++;
 
-    // Extents are changed too
-    ov->local()->comExtentValid = false;
+    // the integration kernel computed the extents of the new positions
+    ov->local()->comExtentStamp = pv->cellListStamp;
 }
-
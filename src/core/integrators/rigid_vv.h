@@ -2,8 +2,14 @@
 
 #include "interface.h"
 
+#include <core/containers.h>
+
 /**
  * Integrate motion of the rigid bodies.
+ *
+ * The whole step is a single kernel with one block per object.
+ * All the rigid object vectors integrated with IntegratorVVRigid
+ * are batched into one launch, see stage2Batch()
  */
 class IntegratorVVRigid : public Integrator
 {
@@ -16,4 +22,12 @@ public:
     void stage2(ParticleVector *pv, cudaStream_t stream) override;
 
     void setPrerequisites(ParticleVector* pv) override;
+
+    std::string getBatchKey() const override;
+    void stage2Batch(const std::vector<ParticleVector*>& pvs, cudaStream_t stream) override;
+
+private:
+    PinnedBuffer<char> batchEntries;  ///< RigidIntegrationKernels::RigidBatchEntry
+
+    void invalidate(ParticleVector *pv);
 };
@@ -0,0 +1,214 @@
+#include "sub_step.h"
+
+#include "forcing_terms/none.h"
+#include "vv.h"
+
+#include <core/celllist.h>
+#include <core/interactions/interface.h>
+#include <core/interactions/membrane.h>
+#include <core/logger.h>
+#include <core/pvs/particle_vector.h>
+#include <core/utils/common.h>
+#include <core/utils/cuda_common.h>
+#include <core/utils/kernel_launch.h>
+#include <core/utils/make_unique.h>
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+
+namespace SubStepKernels
+{
+
+/// largest norm of the fast forces, i.e. forces minus slow forces; maxForce must be cleared
+__global__ void maxFastForce(int n, const Force *forces, const Force *slowForces, float *maxForce)
+{
+    const int gid = blockIdx.x * blockDim.x + threadIdx.x;
+
+    float f = 0.0f;
+    if (gid < n)
+        f = length(forces[gid].f - slowForces[gid].f);
+
+    f = warpReduce(f, [] (float a, float b) { return fmaxf(a, b); });
+
+    // non-negative floats compare like ints
+    if (__laneid() == 0)
+        atomicMax((int*) maxForce, __float_as_int(f));
+}
+
+} // namespace SubStepKernels
+
+IntegratorSubStep::IntegratorSubStep(const YmrState *state, std::string name, int substeps,
+                                     std::vector<Interaction*> fastForces, float maxDisplacement) :
+    Integrator(state, name),
+    fastForces(fastForces),
+    subIntegrator(new IntegratorVV<Forcing_None>(state, name + "_sub", Forcing_None())),
+    subState(*state),
+    maxSubsteps(substeps),
+    lastSubsteps(substeps),
+    maxDisplacement(maxDisplacement)
+{
+    if (fastForces.empty())
+        die("IntegratorSubStep '%s': needs at least one fast interaction", name.c_str());
+
+    if (substeps < 1)
+        die("IntegratorSubStep '%s': needs at least one sub-step, got %d", name.c_str(), substeps);
+
+    for (auto interaction : fastForces)
+        if (!interaction->getIntermediateOutputChannels().empty() || !interaction->getIntermediateInputChannels().empty())
+            die("IntegratorSubStep '%s': interaction '%s' has intermediate channels, it can not be sub-stepped",
+                name.c_str(), interaction->name.c_str());
+
+    debug("setup substep integrator '%s' for %s%d substeps with %d fast interactions",
+          name.c_str(), maxDisplacement > 0.0f ? "at most " : "", substeps, (int) fastForces.size());
+
+    subIntegrator->state = &subState;
+}
+
+IntegratorSubStep::~IntegratorSubStep() = default;
+
+void IntegratorSubStep::stage1(ParticleVector *pv, cudaStream_t stream)
+{}
+
+void IntegratorSubStep::computeFastForces(ParticleVector *pv, cudaStream_t stream)
+{
+    for (auto interaction : noCellListForces)
+        interaction->local(pv, pv, nullptr, nullptr, stream);
+
+    for (auto& entry : cellLists)
+    {
+        auto& fast = entry.second;
+        auto cl = fast.cl.get();
+
+        cl->build(stream);
+        cl->clearChannels(fast.channels, stream);
+
+        for (auto interaction : fast.interactions)
+            interaction->local(pv, pv, cl, cl, stream);
+
+        cl->accumulateChannels(fast.channels, stream);
+    }
+}
+
+/**
+ * Smallest n such that 0.5 * a * (dt/n)^2 < maxDisplacement,
+ * with a the largest fast acceleration at the end of the previous time step
+ */
+int IntegratorSubStep::chooseSubsteps(ParticleVector *pv, cudaStream_t stream)
+{
+    const int n = pv->local()->size();
+    const int nthreads = 128;
+
+    maxForce.clear(stream);
+
+    SAFE_KERNEL_LAUNCH(
+            SubStepKernels::maxFastForce,
+            getNblocks(n, nthreads), nthreads, 0, stream,
+            n, pv->local()->forces.devPtr(), slowForces.devPtr(), maxForce.devPtr() );
+
+    maxForce.downloadFromDevice(stream, ContainersSynch::Synch);
+
+    const float acceleration = maxForce[0] / pv->mass;
+    const float substeps = state->dt * sqrtf(acceleration / (2.0f * maxDisplacement));
+
+    return std::max(1, std::min(maxSubsteps, (int) ceilf(substeps)));
+}
+
+void IntegratorSubStep::stage2(ParticleVector *pv, cudaStream_t stream)
+{
+    const int substeps = lastSubsteps;
+
+    // save "slow forces" and previous positions
+    slowForces.copy(pv->local()->forces, stream);
+    previousPositions.copyFromDevice(pv->local()->coosvels, stream);
+
+    subState = *state;
+    subState.dt = state->dt / substeps;
+
+    // fast interactions see the sub-steps
+    std::vector<const YmrState*> savedStates;
+    for (auto interaction : fastForces)
+    {
+        savedStates.push_back(interaction->state);
+        interaction->state = &subState;
+    }
+
+    for (int substep = 0; substep < substeps; ++substep)
+    {
+        if (substep != 0)
+        {
+            pv->local()->forces.copy(slowForces, stream);
+            pv->cellListStamp++;
+        }
+
+        computeFastForces(pv, stream);
+
+        // the last fast forces give the number of sub-steps of the next time step
+        if (maxDisplacement > 0.0f && substep == substeps - 1)
+            lastSubsteps = chooseSubsteps(pv, stream);
+
+        subIntegrator->stage2(pv, stream);
+
+        subState.currentTime += subState.dt;
+    }
+
+    debug("Advanced '%s' in %d sub-steps, next step will use %d", pv->name.c_str(), substeps, lastSubsteps);
+
+    // restore previous positions into old_particles channel
+    pv->local()->extraPerParticle.getData<Particle>(ChannelNames::oldParts)->copy(previousPositions, stream);
+
+    for (int i = 0; i < fastForces.size(); i++)
+        fastForces[i]->state = savedStates[i];
+
+    // PV may have changed, invalidate all
+    pv->haloValid = false;
+    pv->redistValid = false;
+    pv->cellListStamp++;
+}
+
+/**
+ * Membrane interactions do not need cell-lists,
+ * the other fast interactions share one cell-list per cut-off radius
+ */
+void IntegratorSubStep::setPrerequisites(ParticleVector *pv)
+{
+    cellLists.clear();
+    noCellListForces.clear();
+
+    for (auto interaction : fastForces)
+    {
+        if (dynamic_cast<InteractionMembrane*>(interaction) != nullptr)
+        {
+            noCellListForces.push_back(interaction);
+            interaction->setPrerequisites(pv, pv, nullptr, nullptr);
+            continue;
+        }
+
+        auto& fast = cellLists[interaction->rc];
+        if (fast.cl == nullptr)
+            fast.cl = std::make_unique<CellList>(pv, interaction->rc, state->domain.localSize);
+
+        fast.interactions.push_back(interaction);
+        interaction->setPrerequisites(pv, pv, fast.cl.get(), fast.cl.get());
+    }
+
+    for (auto& entry : cellLists)
+    {
+        auto& fast = entry.second;
+
+        std::set<std::string> channels;
+        for (auto interaction : fast.interactions)
+            for (auto& channel : interaction->getFinalOutputChannels())
+                channels.insert(channel.name);
+
+        fast.channels.assign(channels.begin(), channels.end());
+
+        debug("IntegratorSubStep '%s': %d fast interactions share the cell-list of cut-off %g",
+              name.c_str(), (int) fast.interactions.size(), entry.first);
+    }
+}
+
+int IntegratorSubStep::getLastSubsteps() const
+{
+    return lastSubsteps;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "interface.h"
+
+#include <core/containers.h>
+#include <core/datatypes.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+class CellList;
+class Interaction;
+
+/**
+ * Multiple time stepping with two levels (RESPA):
+ * the forces computed by the simulation (slow forces) are kept constant over the time step,
+ * while the particle vector is advanced in sub-steps with the fast interactions recomputed at each of them.
+ *
+ * Unlike IntegratorSubStepMembrane, any self interaction can be fast:
+ * - membrane interactions are called without cell-lists;
+ * - other interactions share one cell-list per cut-off owned by the integrator,
+ *   rebuilt once at every sub-step. Only the local pairs are computed during the sub-steps,
+ *   as particles of the other ranks are not exchanged in between.
+ *
+ * With a positive maxDisplacement, the number of sub-steps is adapted at every step:
+ * it is the smallest one such that the largest fast acceleration of the previous time step
+ * moves a particle by less than maxDisplacement within one sub-step, bounded by the given number of sub-steps.
+ * This costs one reduction and one device-host synchronization per time step.
+ */
+class IntegratorSubStep : public Integrator
+{
+public:
+    IntegratorSubStep(const YmrState *state, std::string name, int substeps,
+                      std::vector<Interaction*> fastForces, float maxDisplacement = 0.0f);
+    ~IntegratorSubStep();
+
+    void stage1(ParticleVector *pv, cudaStream_t stream) override;
+    void stage2(ParticleVector *pv, cudaStream_t stream) override;
+
+    void setPrerequisites(ParticleVector *pv) override;
+
+    /// number of sub-steps of the last time step
+    int getLastSubsteps() const;
+
+private:
+
+    std::vector<Interaction*> fastForces;
+
+    /// cell-list of the fast interactions of one cut-off, with the union of their output channels
+    struct FastCellList
+    {
+        std::unique_ptr<CellList> cl;
+        std::vector<Interaction*> interactions;
+        std::vector<std::string> channels;
+    };
+
+    std::map<float, FastCellList> cellLists;        ///< by cut-off radius
+    std::vector<Interaction*> noCellListForces;     ///< membrane interactions
+
+    std::unique_ptr<Integrator> subIntegrator;
+    YmrState subState;
+
+    int maxSubsteps, lastSubsteps;
+    float maxDisplacement;
+
+    DeviceBuffer<Force> slowForces;
+    DeviceBuffer<Particle> previousPositions;
+    PinnedBuffer<float> maxForce{1};
+
+    void computeFastForces(ParticleVector *pv, cudaStream_t stream);
+    int chooseSubsteps(ParticleVector *pv, cudaStream_t stream);
+};
@@ -35,20 +35,36 @@ void IntegratorSubStepMembrane::stage1(ParticleVector *pv, cudaStream_t stream)
 
 void IntegratorSubStepMembrane::stage2(ParticleVector *pv, cudaStream_t stream)
 {
-    // save "slow forces"
-    slowForces.copy(pv->local()->forces, stream);
-    
     // save previous positions
     previousPositions.copyFromDevice(pv->local()->coosvels, stream);
 
-    // advance with internal vv integrator
-
     updateSubState();
 
+    // all the sub-steps in one launch when the membranes fit in shared memory
+    auto membrane = static_cast<InteractionMembrane*>(fastForces);
+
+    if (!membrane->advancePerObject(pv, substeps, subState.dt, stream))
+        advanceSubsteps(pv, stream);
+    
+    // restore previous positions into old_particles channel
+    pv->local()->extraPerParticle.getData<Particle>(ChannelNames::oldParts)->copy(previousPositions, stream);
+    
+    // PV may have changed, invalidate all
+    pv->haloValid = false;
+    pv->redistValid = false;
+    pv->cellListStamp++;
+}
+
+void IntegratorSubStepMembrane::advanceSubsteps(ParticleVector *pv, cudaStream_t stream)
+{
+    // save "slow forces"
+    slowForces.copy(pv->local()->forces, stream);
+
     // save fastForces state and reset it afterwards
     auto *savedStatePtr = fastForces->state;
     fastForces->state = &subState;
-    
+
+    // advance with internal vv integrator
     for (int substep = 0; substep < substeps; ++ substep) {
 
         if (substep != 0)
@@ -60,17 +76,9 @@ void IntegratorSubStepMembrane::stage2(ParticleVector *pv, cudaStream_t stream)
 
         subState.currentTime += subState.dt;
     }
-    
-    // restore previous positions into old_particles channel
-    pv->local()->extraPerParticle.getData<Particle>(ChannelNames::oldParts)->copy(previousPositions, stream);
 
     // restore state of fastForces
     fastForces->state = savedStatePtr;
-    
-    // PV may have changed, invalidate all
-    pv->haloValid = false;
-    pv->redistValid = false;
-    pv->cellListStamp++;
 }
 
 void IntegratorSubStepMembrane::setPrerequisites(ParticleVector *pv)
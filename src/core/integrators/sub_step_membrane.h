@@ -29,4 +29,7 @@ private:
     DeviceBuffer<Particle> previousPositions;
 
     void updateSubState();
+
+    /// one force and one integration launch per sub-step, when the membranes can not be advanced per object
+    void advanceSubsteps(ParticleVector *pv, cudaStream_t stream);
 };
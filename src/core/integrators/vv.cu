@@ -1,5 +1,6 @@
 #include "vv.h"
 
+#include <core/celllist.h>
 #include <core/utils/kernel_launch.h>
 #include <core/logger.h>
 #include <core/pvs/particle_vector.h>
@@ -7,14 +8,61 @@
 
 #include "integration_kernel.h"
 
+#include "forcing_terms/andersen.h"
 #include "forcing_terms/none.h"
 #include "forcing_terms/const_dp.h"
+#include "forcing_terms/langevin.h"
 #include "forcing_terms/periodic_poiseuille.h"
 
+#include <core/walls/common_kernels.h>
+#include <core/walls/simple_stationary_wall.h>
+#include <core/walls/stationary_walls/box.h>
+#include <core/walls/stationary_walls/cylinder.h>
+#include <core/walls/stationary_walls/mesh.h>
+#include <core/walls/stationary_walls/plane.h>
+#include <core/walls/stationary_walls/sdf.h>
+#include <core/walls/stationary_walls/sphere.h>
+
+/**
+ * The forcing terms providing \c thermalize(Particle&), e.g. the thermostats, also act on the velocity
+ * after the kick, within the integration kernel. The others only modify the force
+ */
+template<class ForcingTerm>
+__device__ inline auto thermalize(const ForcingTerm& forcingTerm, Particle& p, int) -> decltype(forcingTerm.thermalize(p))
+{
+    forcingTerm.thermalize(p);
+}
 
 template<class ForcingTerm>
-IntegratorVV<ForcingTerm>::IntegratorVV(const YmrState *state, std::string name, ForcingTerm forcingTerm) :
-    Integrator(state, name), forcingTerm(forcingTerm)
+__device__ inline void thermalize(const ForcingTerm& forcingTerm, Particle& p, long)
+{}
+
+/**
+ * Launch the integration fused with the bounce if \p wall is a stationary wall with the given checker
+ * @return false if the wall is of another type
+ */
+template<class InsideWallChecker, class Transform>
+static bool integrateBounced(Wall *wall, ParticleVector *pv, PVviewWithOldParticles pvView,
+                             float dt, Transform transform, cudaStream_t stream)
+{
+    auto stationary = dynamic_cast<SimpleStationaryWall<InsideWallChecker>*>(wall);
+    if (stationary == nullptr) return false;
+
+    const int nthreads = 128;
+    SAFE_KERNEL_LAUNCH(
+            integrationKernelBounced,
+            getNblocks(2*pvView.size, nthreads), nthreads, 0, stream,
+            pvView, dt, transform, stationary->getFusedBounce(pv), stationary->getFusedBounceForce() );
+
+    return true;
+}
+
+
+template<class ForcingTerm>
+IntegratorVV<ForcingTerm>::IntegratorVV(const YmrState *state, std::string name, ForcingTerm forcingTerm,
+                                        bool fusedBinning, bool fusedWallBounce) :
+    Integrator(state, name), forcingTerm(forcingTerm),
+    fusedBinning(fusedBinning), fusedWallBounce(fusedWallBounce)
 {}
 
 template<class ForcingTerm>
@@ -49,9 +97,26 @@ void IntegratorVV<ForcingTerm>::stage1(ParticleVector *pv, cudaStream_t stream)
  *   integration:
  *   \code float3 operator()(float3 f0, Particle p) const \endcode
  *
+ * - Optionally, a \c \_\_device\_\_ function called on the particle
+ *   after the velocity update, e.g. to apply a thermostat:
+ *   \code void thermalize(Particle& p) const \endcode
+ *
  */
 template<class ForcingTerm>
 void IntegratorVV<ForcingTerm>::stage2(ParticleVector *pv, cudaStream_t stream)
+{
+    const bool split = splitCellLists.find(pv) != splitCellLists.end();
+    integrate(pv, split ? Part::Boundary : Part::All, stream);
+}
+
+template<class ForcingTerm>
+void IntegratorVV<ForcingTerm>::stage2Interior(ParticleVector *pv, cudaStream_t stream)
+{
+    integrate(pv, Part::Interior, stream);
+}
+
+template<class ForcingTerm>
+void IntegratorVV<ForcingTerm>::integrate(ParticleVector *pv, Part part, cudaStream_t stream)
 {
     float t = state->currentTime;
     float dt = state->dt;
@@ -67,21 +132,77 @@ void IntegratorVV<ForcingTerm>::stage2(ParticleVector *pv, cudaStream_t stream)
         float3 modF = _fterm(f, p);
 
         p.u += modF*invm*dt;
+        thermalize(_fterm, p, 0);
         p.r += p.u*dt;
     };
 
     int nthreads = 128;
-    debug2("Integrating (stage 2) %d %s particles, timestep is %f", pv->local()->size(), pv->name.c_str(), dt);
+    debug2("Integrating (stage 2%s) %d %s particles, timestep is %f",
+           part == Part::All ? "" : part == Part::Boundary ? ", boundary cells" : ", interior cells",
+           pv->local()->size(), pv->name.c_str(), dt);
 
-    // New particles now become old
-    std::swap(pv->local()->coosvels, *pv->local()->extraPerParticle.getData<Particle>(ChannelNames::oldParts));
+    // New particles now become old; the interior is integrated from the same old particles
+    if (part != Part::Interior)
+        std::swap(pv->local()->coosvels, *pv->local()->extraPerParticle.getData<Particle>(ChannelNames::oldParts));
     PVviewWithOldParticles pvView(pv, pv->local());
 
     // Integrate from old to new
-    SAFE_KERNEL_LAUNCH(
-            integrationKernel,
-            getNblocks(2*pvView.size, nthreads), nthreads, 0, stream,
-            pvView, dt, st2 );
+    auto it = binningCellLists.find(pv);
+    auto wallIt = bouncingWalls.find(pv);
+
+    if (part != Part::All)
+    {
+        auto cl = splitCellLists[pv];
+        const bool binned = (it != binningCellLists.end());
+
+        // the boundary clears the counts, the interior closes the binning
+        auto cinfo = (binned && part == Part::Boundary) ? cl->beginExternalBinning(stream) : cl->cellInfo();
+
+        SAFE_KERNEL_LAUNCH(
+                integrationKernelSplit,
+                getNblocks(2*pvView.size, nthreads), nthreads, 0, stream,
+                pvView, dt, st2, cinfo, part == Part::Boundary, binned );
+
+        if (binned && part == Part::Interior)
+            cl->endExternalBinning(pvView.size);
+    }
+    else if (wallIt != bouncingWalls.end())
+    {
+        auto wall = wallIt->second;
+
+        const bool launched =
+            integrateBounced<StationaryWall_Sphere>   (wall, pv, pvView, dt, st2, stream) ||
+            integrateBounced<StationaryWall_Cylinder> (wall, pv, pvView, dt, st2, stream) ||
+            integrateBounced<StationaryWall_Plane>    (wall, pv, pvView, dt, st2, stream) ||
+            integrateBounced<StationaryWall_Box>      (wall, pv, pvView, dt, st2, stream) ||
+            integrateBounced<StationaryWall_SDF>      (wall, pv, pvView, dt, st2, stream) ||
+            integrateBounced<StationaryWall_Mesh>     (wall, pv, pvView, dt, st2, stream);
+
+        if (!launched)
+            die("Integrator '%s' cannot bounce '%s' from the wall '%s' of unknown type",
+                name.c_str(), pv->name.c_str(), wall->name.c_str());
+    }
+    else if (it == binningCellLists.end())
+    {
+        SAFE_KERNEL_LAUNCH(
+                integrationKernel,
+                getNblocks(2*pvView.size, nthreads), nthreads, 0, stream,
+                pvView, dt, st2 );
+    }
+    else
+    {
+        auto cl = it->second;
+        auto cinfo = cl->beginExternalBinning(stream);
+
+        SAFE_KERNEL_LAUNCH(
+                integrationKernelBinned,
+                getNblocks(2*pvView.size, nthreads), nthreads, 0, stream,
+                pvView, dt, st2, cinfo );
+
+        cl->endExternalBinning(pvView.size);
+    }
+
+    if (part == Part::Interior) return;
 
     // PV may have changed, invalidate all
     pv->haloValid = false;
@@ -89,6 +210,65 @@ void IntegratorVV<ForcingTerm>::stage2(ParticleVector *pv, cudaStream_t stream)
     pv->cellListStamp++;
 }
 
+template<class ForcingTerm>
+bool IntegratorVV<ForcingTerm>::setBinningCellList(ParticleVector *pv, CellList *cl)
+{
+    if (!fusedBinning) return false;
+
+    if (cl == nullptr)
+    {
+        warn("Integrator '%s' cannot bin '%s' in its cell-list: the particles may move after the integration",
+             name.c_str(), pv->name.c_str());
+        return false;
+    }
+
+    debug("Integrator '%s' will bin the particles of '%s' in the cell-list with rc = %f",
+          name.c_str(), pv->name.c_str(), cl->rc);
+    binningCellLists[pv] = cl;
+    return true;
+}
+
+template<class ForcingTerm>
+bool IntegratorVV<ForcingTerm>::setBouncingWall(ParticleVector *pv, Wall *wall)
+{
+    if (!fusedWallBounce) return false;
+
+    if (wall == nullptr)
+    {
+        warn("Integrator '%s' cannot bounce '%s': only a single wall per particle vector is supported",
+             name.c_str(), pv->name.c_str());
+        return false;
+    }
+
+    if (!wall->fuseBounce(pv))
+    {
+        warn("Integrator '%s' cannot bounce '%s' from the wall '%s': only stationary walls are supported",
+             name.c_str(), pv->name.c_str(), wall->name.c_str());
+        return false;
+    }
+
+    bouncingWalls[pv] = wall;
+    return true;
+}
+
+template<class ForcingTerm>
+bool IntegratorVV<ForcingTerm>::setSplitCellList(ParticleVector *pv, CellList *cl)
+{
+    if (bouncingWalls.find(pv) != bouncingWalls.end())
+        return false;
+
+    // the same kernel bins and splits along the cells
+    auto it = binningCellLists.find(pv);
+    if (it != binningCellLists.end() && it->second != cl)
+        return false;
+
+    debug("Integrator '%s' will integrate the boundary cells of '%s' first", name.c_str(), pv->name.c_str());
+    splitCellLists[pv] = cl;
+    return true;
+}
+
 template class IntegratorVV<Forcing_None>;
 template class IntegratorVV<Forcing_ConstDP>;
 template class IntegratorVV<Forcing_PeriodicPoiseuille>;
+template class IntegratorVV<Forcing_Andersen>;
+template class IntegratorVV<Forcing_Langevin>;
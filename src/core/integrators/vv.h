@@ -2,17 +2,39 @@
 
 #include "interface.h"
 
+#include <map>
+
 /**
  * Implementation of Velocity-Verlet integration in one step
+ *
+ * With \c fusedBinning, the same kernel also counts the particles per cell
+ * of the primary cell-list given by Simulation, see setBinningCellList().
+ * With \c fusedWallBounce, it bounces the particles from a stationary wall, see setBouncingWall().
+ * stage2() may be split in the boundary cells and the interior, see setSplitCellList()
  */
 template<class ForcingTerm>
 struct IntegratorVV : Integrator
 {
     ForcingTerm forcingTerm;
 
-    IntegratorVV(const YmrState *state, std::string name, ForcingTerm forcingTerm);
+    IntegratorVV(const YmrState *state, std::string name, ForcingTerm forcingTerm,
+                 bool fusedBinning = false, bool fusedWallBounce = false);
     ~IntegratorVV();
 
     void stage1(ParticleVector *pv, cudaStream_t stream) override;
     void stage2(ParticleVector *pv, cudaStream_t stream) override;
+    void stage2Interior(ParticleVector *pv, cudaStream_t stream) override;
+
+    bool setBinningCellList(ParticleVector *pv, CellList *cl) override;
+    bool setBouncingWall(ParticleVector *pv, Wall *wall) override;
+    bool setSplitCellList(ParticleVector *pv, CellList *cl) override;
+
+protected:
+    bool fusedBinning, fusedWallBounce;
+    std::map<ParticleVector*, CellList*> binningCellLists;
+    std::map<ParticleVector*, Wall*> bouncingWalls;
+    std::map<ParticleVector*, CellList*> splitCellLists;
+
+    enum class Part { All, Boundary, Interior };
+    void integrate(ParticleVector *pv, Part part, cudaStream_t stream);
 };
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "warp_aggregation.h"
+
 #include <core/pvs/views/pv.h>
 #include <core/utils/cpu_gpu_defines.h>
 
@@ -21,6 +23,14 @@ public:
         atomicAdd(view.densities + id, d);
     }
 
+#ifdef __CUDACC__
+    /// atomicAddToSrc() called by the whole warp for the same source particle, see warpAggregatedAtomicAdd()
+    __device__ inline void warpAtomicAddToSrc(bool interacting, float d, PVviewWithDensities& view, int id) const
+    {
+        warpAggregatedAtomicAdd(interacting, d, [&] (float s) { atomicAddToSrc(s, view, id); });
+    }
+#endif
+
     __D__ inline float get() const {return den;}
     __D__ inline void add(float d) {den += d;}
     
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "warp_aggregation.h"
+
 #include <core/datatypes.h>
 #include <core/pvs/views/pv.h>
 #include <core/utils/cpu_gpu_defines.h>
@@ -23,6 +25,14 @@ public:
         atomicAdd(view.forces + id, -f);
     }
 
+#ifdef __CUDACC__
+    /// atomicAddToSrc() called by the whole warp for the same source particle, see warpAggregatedAtomicAdd()
+    __device__ inline void warpAtomicAddToSrc(bool interacting, float3 f, PVview& view, int id) const
+    {
+        warpAggregatedAtomicAdd(interacting, f, [&] (float3 s) { atomicAddToSrc(s, view, id); });
+    }
+#endif
+
     __D__ inline float3 get() const {return frc;}
     __D__ inline void add(float3 f) {frc += f;}
     
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "warp_aggregation.h"
+
 #include <core/datatypes.h>
 #include <core/pvs/views/pv.h>
 #include <core/utils/cpu_gpu_defines.h>
@@ -12,33 +14,67 @@ struct ForceStress
     Stress stress;
 };
 
+#ifdef __CUDACC__
+__device__ inline ForceStress warpSum(ForceStress fs)
+{
+    fs.force     = warpSum(fs.force);
+    fs.stress.xx = warpSum(fs.stress.xx);
+    fs.stress.xy = warpSum(fs.stress.xy);
+    fs.stress.xz = warpSum(fs.stress.xz);
+    fs.stress.yy = warpSum(fs.stress.yy);
+    fs.stress.yz = warpSum(fs.stress.yz);
+    fs.stress.zz = warpSum(fs.stress.zz);
+    return fs;
+}
+#endif
+
+/**
+ * Accumulate the forces, and the stresses if \p withStress:
+ * without them, the atomics and the reductions are the ones of ForceAccumulator
+ */
 template <typename BasicView>
 class ForceStressAccumulator
 {
 public:
 
-    __D__ inline ForceStressAccumulator() :
+    __D__ inline ForceStressAccumulator(bool withStress = true) :
         frcStress({{0.f, 0.f, 0.f},
-                   {0.f, 0.f, 0.f, 0.f, 0.f, 0.f}})
+                   {0.f, 0.f, 0.f, 0.f, 0.f, 0.f}}),
+        withStress(withStress)
     {}
     
     __D__ inline void atomicAddToDst(const ForceStress& fs, PVviewWithStresses<BasicView>& view, int id) const
     {
-        atomicAdd(      view.forces   + id, fs.force );
-        atomicAddStress(view.stresses + id, fs.stress);
+        atomicAdd(view.forces + id, fs.force);
+        if (withStress)
+            atomicAddStress(view.stresses + id, fs.stress);
     }
 
     __D__ inline void atomicAddToSrc(const ForceStress& fs, PVviewWithStresses<BasicView>& view, int id) const
     {
-        atomicAdd(      view.forces   + id, -fs.force );
-        atomicAddStress(view.stresses + id,  fs.stress);
+        atomicAdd(view.forces + id, -fs.force);
+        if (withStress)
+            atomicAddStress(view.stresses + id, fs.stress);
     }
 
+#ifdef __CUDACC__
+    /// atomicAddToSrc() called by the whole warp for the same source particle, see warpAggregatedAtomicAdd()
+    __device__ inline void warpAtomicAddToSrc(bool interacting, const ForceStress& fs, PVviewWithStresses<BasicView>& view, int id) const
+    {
+        if (withStress)
+            warpAggregatedAtomicAdd(interacting, fs, [&] (const ForceStress& s) { atomicAddToSrc(s, view, id); });
+        else
+            warpAggregatedAtomicAdd(interacting, fs.force, [&] (float3 f) { atomicAdd(view.forces + id, -f); });
+    }
+#endif
+
     __D__ inline ForceStress get() const {return frcStress;}
 
     __D__ inline void add(const ForceStress& fs)
     {
         frcStress.force += fs.force;
+        if (!withStress) return;
+
         frcStress.stress.xx += fs.stress.xx;
         frcStress.stress.xy += fs.stress.xy;
         frcStress.stress.xz += fs.stress.xz;
@@ -49,6 +85,7 @@ public:
     
 private:
     ForceStress frcStress;
+    bool withStress;
 
     __D__ inline void atomicAddStress(Stress *dst, const Stress& s) const
     {
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <core/utils/cuda_common.h>
+
+#ifdef __CUDACC__
+
+/// below this number of contributing lanes, each of them adds to the source directly
+constexpr int warpAggregationMinLanes = 3;
+
+__device__ inline float warpSum(float v)
+{
+    return warpReduce(v, [] (float a, float b) { return a+b; });
+}
+
+__device__ inline float3 warpSum(float3 v)
+{
+    return warpReduce(v, [] (float a, float b) { return a+b; });
+}
+
+/**
+ * Add \p val of the \p interacting lanes of the warp to the same location with \p atomicAddFunc:
+ * the values are summed over the warp first and the sum is added by lane 0 only.
+ * Must be called by the whole warp; warpSum() has to be defined for the type of \p val
+ */
+template <typename T, typename AtomicAdd>
+__device__ inline void warpAggregatedAtomicAdd(bool interacting, T val, AtomicAdd atomicAddFunc)
+{
+    const int mask = warpBallot(interacting);
+
+    if (__popc(mask) < warpAggregationMinLanes)
+    {
+        if (interacting) atomicAddFunc(val);
+        return;
+    }
+
+    val = warpSum(interacting ? val : T{});
+
+    if (getLaneId<1>() == 0)
+        atomicAddFunc(val);
+}
+
+#endif
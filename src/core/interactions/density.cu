@@ -47,6 +47,26 @@ void BasicInteractionDensity::halo (ParticleVector *pv1, ParticleVector *pv2, Ce
     impl->halo(pv1, pv2, cl1, cl2, stream);
 }
 
+void BasicInteractionDensity::useNeighborList(float skin)
+{
+    impl->useNeighborList(skin);
+}
+
+void BasicInteractionDensity::useTiledKernels(bool enabled)
+{
+    impl->useTiledKernels(enabled);
+}
+
+bool BasicInteractionDensity::usePeriodicImages(bool enabled)
+{
+    return impl->usePeriodicImages(enabled);
+}
+
+void BasicInteractionDensity::setAutotuning(int nsamples, std::string fname)
+{
+    impl->setAutotuning(nsamples, fname);
+}
+
 
 template <class DensityKernel>
 InteractionDensity<DensityKernel>::InteractionDensity(const YmrState *state, std::string name, float rc,
@@ -56,7 +76,7 @@ InteractionDensity<DensityKernel>::InteractionDensity(const YmrState *state, std
 {
     using PairwiseDensityType = PairwiseDensity<DensityKernel>;
     
-    PairwiseDensityType density(rc, DensityKernel());
+    PairwiseDensityType density(rc, densityKernel);
     impl = std::make_unique<InteractionPair<PairwiseDensityType>> (state, name, rc, density);
 }
 
@@ -66,3 +86,4 @@ InteractionDensity<DensityKernel>::~InteractionDensity() = default;
 
 template class InteractionDensity<SimpleMDPDDensityKernel>;
 template class InteractionDensity<WendlandC2DensityKernel>;
+template class InteractionDensity<TabulatedWendlandC2DensityKernel>;
@@ -15,6 +15,11 @@ public:
     
     void local (ParticleVector *pv1, ParticleVector *pv2, CellList *cl1, CellList *cl2, cudaStream_t stream) override;
     void halo  (ParticleVector *pv1, ParticleVector *pv2, CellList *cl1, CellList *cl2, cudaStream_t stream) override;
+
+    void useNeighborList(float skin) override;
+    void useTiledKernels(bool enabled) override;
+    bool usePeriodicImages(bool enabled) override;
+    void setAutotuning(int nsamples, std::string fname) override;
         
 protected:
     BasicInteractionDensity(const YmrState *state, std::string name, float rc);
@@ -8,18 +8,21 @@
 
 #include <memory>
 
-InteractionDPD::InteractionDPD(const YmrState *state, std::string name, float rc, float a, float gamma, float kbt, float power, bool allocateImpl) :
+InteractionDPD::InteractionDPD(const YmrState *state, std::string name, float rc, float a, float gamma, float kbt, float power,
+                               bool counterRNG, bool allocateImpl) :
     Interaction(state, name, rc),
-    a(a), gamma(gamma), kbt(kbt), power(power)
+    a(a), gamma(gamma), kbt(kbt), power(power),
+    counterRNG(counterRNG)
 {
     if (allocateImpl) {
-        PairwiseDPD dpd(rc, a, gamma, kbt, state->dt, power);
+        PairwiseDPD dpd(rc, a, gamma, kbt, state->dt, power, counterRNG);
         impl = std::make_unique<InteractionPair<PairwiseDPD>> (state, name, rc, dpd);
     }
 }
 
-InteractionDPD::InteractionDPD(const YmrState *state, std::string name, float rc, float a, float gamma, float kbt, float power) :
-    InteractionDPD(state, name, rc, a, gamma, kbt, power, true)
+InteractionDPD::InteractionDPD(const YmrState *state, std::string name, float rc, float a, float gamma, float kbt, float power,
+                               bool counterRNG) :
+    InteractionDPD(state, name, rc, a, gamma, kbt, power, counterRNG, true)
 {}
 
 InteractionDPD::~InteractionDPD() = default;
@@ -48,6 +51,40 @@ void InteractionDPD::halo(ParticleVector *pv1, ParticleVector *pv2,
     impl->halo(pv1, pv2, cl1, cl2, stream);
 }
 
+void InteractionDPD::useNeighborList(float skin)
+{
+    impl->useNeighborList(skin);
+}
+
+void InteractionDPD::useTiledKernels(bool enabled)
+{
+    impl->useTiledKernels(enabled);
+}
+
+bool InteractionDPD::usePeriodicImages(bool enabled)
+{
+    return impl->usePeriodicImages(enabled);
+}
+
+const PairwiseDPDHandler* InteractionDPD::getSelfHandler(ParticleVector *pv)
+{
+    // the random numbers of the other generator are drawn on the host every step
+    auto pair = dynamic_cast<InteractionPair<PairwiseDPD>*>(impl.get());
+    if (pair == nullptr || !counterRNG) return nullptr;
+
+    return &pair->getHandler(pv, pv);
+}
+
+void InteractionDPD::setAutotuning(int nsamples, std::string fname)
+{
+    impl->setAutotuning(nsamples, fname);
+}
+
+void InteractionDPD::useCompressedStorage(bool enabled, bool validate)
+{
+    impl->useCompressedStorage(enabled, validate);
+}
+
 void InteractionDPD::setSpecificPair(ParticleVector *pv1, ParticleVector *pv2, 
                                      float a, float gamma, float kbt, float power)
 {
@@ -56,7 +93,7 @@ void InteractionDPD::setSpecificPair(ParticleVector *pv1, ParticleVector *pv2,
     if (kbt   == Default) kbt   = this->kbt;
     if (power == Default) power = this->power;
 
-    PairwiseDPD dpd(this->rc, a, gamma, kbt, state->dt, power);
+    PairwiseDPD dpd(this->rc, a, gamma, kbt, state->dt, power, counterRNG);
     auto ptr = static_cast< InteractionPair<PairwiseDPD>* >(impl.get());
     
     ptr->setSpecificPair(pv1->name, pv2->name, dpd);
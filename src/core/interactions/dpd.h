@@ -5,12 +5,15 @@
 #include <limits>
 #include <core/utils/pytypes.h>
 
+class PairwiseDPDHandler;
+
 class InteractionDPD : public Interaction
 {
 public:
     constexpr static float Default = std::numeric_limits<float>::infinity();
 
-    InteractionDPD(const YmrState *state, std::string name, float rc, float a, float gamma, float kbt, float power);
+    InteractionDPD(const YmrState *state, std::string name, float rc, float a, float gamma, float kbt, float power,
+                   bool counterRNG = false);
 
     ~InteractionDPD();
 
@@ -20,17 +23,33 @@ public:
     void local (ParticleVector *pv1, ParticleVector *pv2, CellList *cl1, CellList *cl2, cudaStream_t stream) override;
     void halo  (ParticleVector *pv1, ParticleVector *pv2, CellList *cl1, CellList *cl2, cudaStream_t stream) override;
 
+    void useNeighborList(float skin) override;
+    void useTiledKernels(bool enabled) override;
+    bool usePeriodicImages(bool enabled) override;
+    void setAutotuning(int nsamples, std::string fname) override;
+    void useCompressedStorage(bool enabled, bool validate) override;
+
+    /**
+     * Parameters of the forces between the particles of \p pv, set up for the current step.
+     * nullptr unless these are plain DPD forces with the counter-based random numbers, see PersistentStepper
+     */
+    const PairwiseDPDHandler* getSelfHandler(ParticleVector *pv);
+
     virtual void setSpecificPair(ParticleVector *pv1, ParticleVector *pv2, 
                                  float a   = Default, float gamma = Default,
                                  float kbt = Default, float power = Default);
     
 protected:
 
-    InteractionDPD(const YmrState *state, std::string name, float rc, float a, float gamma, float kbt, float power, bool allocateImpl);
+    InteractionDPD(const YmrState *state, std::string name, float rc, float a, float gamma, float kbt, float power,
+                   bool counterRNG, bool allocateImpl);
     
     std::unique_ptr<Interaction> impl;
     
     // Default values
     float a, gamma, kbt, power;
+
+    /// draw the random forces with Philox instead of the logistic map
+    bool counterRNG {false};
 };
 
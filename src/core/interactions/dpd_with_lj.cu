@@ -0,0 +1,106 @@
+#include "dpd_with_lj.h"
+#include "pairwise.impl.h"
+#include "pairwise_interactions/dpd.h"
+#include "pairwise_interactions/lj.h"
+#include "pairwise_interactions/lj_object_aware.h"
+#include "pairwise_interactions/sum.h"
+
+#include <core/celllist.h>
+#include <core/utils/make_unique.h>
+#include <core/pvs/particle_vector.h>
+
+#include <memory>
+
+using PairwiseDPDWithLJ            = PairwiseSum<PairwiseDPD, PairwiseLJ>;
+using PairwiseDPDWithLJObjectAware = PairwiseSum<PairwiseDPD, PairwiseLJObjectAware>;
+
+InteractionDPDWithLJ::InteractionDPDWithLJ(const YmrState *state, std::string name, float rc,
+                                           float a, float gamma, float kbt, float power,
+                                           float epsilon, float sigma, float maxForce, bool objectAware,
+                                           bool counterRNG) :
+    Interaction(state, name, rc),
+    objectAware(objectAware),
+    counterRNG(counterRNG)
+{
+    PairwiseDPD dpd(rc, a, gamma, kbt, state->dt, power, counterRNG);
+
+    if (objectAware) {
+        PairwiseLJObjectAware lj(rc, epsilon, sigma, maxForce);
+        PairwiseDPDWithLJObjectAware sum(dpd, lj);
+        impl = std::make_unique<InteractionPair<PairwiseDPDWithLJObjectAware>> (state, name, rc, sum);
+    }
+    else {
+        PairwiseLJ lj(rc, epsilon, sigma, maxForce);
+        PairwiseDPDWithLJ sum(dpd, lj);
+        impl = std::make_unique<InteractionPair<PairwiseDPDWithLJ>> (state, name, rc, sum);
+    }
+}
+
+InteractionDPDWithLJ::~InteractionDPDWithLJ() = default;
+
+void InteractionDPDWithLJ::setPrerequisites(ParticleVector *pv1, ParticleVector *pv2, CellList *cl1, CellList *cl2)
+{
+    impl->setPrerequisites(pv1, pv2, cl1, cl2);
+}
+
+std::vector<Interaction::InteractionChannel> InteractionDPDWithLJ::getFinalOutputChannels() const
+{
+    return impl->getFinalOutputChannels();
+}
+
+void InteractionDPDWithLJ::local(ParticleVector *pv1, ParticleVector *pv2,
+                                 CellList *cl1, CellList *cl2,
+                                 cudaStream_t stream)
+{
+    impl->local(pv1, pv2, cl1, cl2, stream);
+}
+
+void InteractionDPDWithLJ::halo(ParticleVector *pv1, ParticleVector *pv2,
+                                CellList *cl1, CellList *cl2,
+                                cudaStream_t stream)
+{
+    impl->halo(pv1, pv2, cl1, cl2, stream);
+}
+
+void InteractionDPDWithLJ::useNeighborList(float skin)
+{
+    impl->useNeighborList(skin);
+}
+
+void InteractionDPDWithLJ::useTiledKernels(bool enabled)
+{
+    impl->useTiledKernels(enabled);
+}
+
+bool InteractionDPDWithLJ::usePeriodicImages(bool enabled)
+{
+    return impl->usePeriodicImages(enabled);
+}
+
+void InteractionDPDWithLJ::setAutotuning(int nsamples, std::string fname)
+{
+    impl->setAutotuning(nsamples, fname);
+}
+
+void InteractionDPDWithLJ::useCompressedStorage(bool enabled, bool validate)
+{
+    impl->useCompressedStorage(enabled, validate);
+}
+
+void InteractionDPDWithLJ::setSpecificPair(ParticleVector *pv1, ParticleVector *pv2,
+                                           float a, float gamma, float kbt, float power,
+                                           float epsilon, float sigma, float maxForce)
+{
+    PairwiseDPD dpd(rc, a, gamma, kbt, state->dt, power, counterRNG);
+
+    if (objectAware) {
+        PairwiseLJObjectAware lj(rc, epsilon, sigma, maxForce);
+        auto ptr = static_cast< InteractionPair<PairwiseDPDWithLJObjectAware>* >(impl.get());
+        ptr->setSpecificPair(pv1->name, pv2->name, PairwiseDPDWithLJObjectAware(dpd, lj));
+    }
+    else {
+        PairwiseLJ lj(rc, epsilon, sigma, maxForce);
+        auto ptr = static_cast< InteractionPair<PairwiseDPDWithLJ>* >(impl.get());
+        ptr->setSpecificPair(pv1->name, pv2->name, PairwiseDPDWithLJ(dpd, lj));
+    }
+}
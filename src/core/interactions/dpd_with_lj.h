@@ -0,0 +1,42 @@
+#pragma once
+
+#include "interface.h"
+#include <memory>
+
+/**
+ * DPD and LJ forces between the same pairs of Particle Vectors,
+ * computed in one traversal of the cell-lists (see PairwiseSum)
+ */
+class InteractionDPDWithLJ : public Interaction
+{
+public:
+    InteractionDPDWithLJ(const YmrState *state, std::string name, float rc,
+                         float a, float gamma, float kbt, float power,
+                         float epsilon, float sigma, float maxForce, bool objectAware,
+                         bool counterRNG = false);
+
+    ~InteractionDPDWithLJ();
+
+    void setPrerequisites(ParticleVector *pv1, ParticleVector *pv2, CellList *cl1, CellList *cl2) override;
+    std::vector<InteractionChannel> getFinalOutputChannels() const override;
+    
+    void local (ParticleVector *pv1, ParticleVector *pv2, CellList *cl1, CellList *cl2, cudaStream_t stream) override;
+    void halo  (ParticleVector *pv1, ParticleVector *pv2, CellList *cl1, CellList *cl2, cudaStream_t stream) override;
+
+    void useNeighborList(float skin) override;
+    void useTiledKernels(bool enabled) override;
+    bool usePeriodicImages(bool enabled) override;
+    void setAutotuning(int nsamples, std::string fname) override;
+    void useCompressedStorage(bool enabled, bool validate) override;
+
+    virtual void setSpecificPair(ParticleVector *pv1, ParticleVector *pv2,
+                                 float a, float gamma, float kbt, float power,
+                                 float epsilon, float sigma, float maxForce);
+
+protected:
+    std::unique_ptr<Interaction> impl;
+    bool objectAware;
+
+    /// draw the random forces of the DPD part with Philox, see InteractionDPD
+    bool counterRNG;
+};
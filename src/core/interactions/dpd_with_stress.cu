@@ -9,10 +9,11 @@
 
 
 InteractionDPDWithStress::InteractionDPDWithStress(const YmrState *state, std::string name,
-                                                   float rc, float a, float gamma, float kbt, float power, float stressPeriod) :
-    InteractionDPD(state, name, rc, a, gamma, kbt, power, false)
+                                                   float rc, float a, float gamma, float kbt, float power, float stressPeriod,
+                                                   bool counterRNG) :
+    InteractionDPD(state, name, rc, a, gamma, kbt, power, counterRNG, false)
 {
-    PairwiseDPD dpd(rc, a, gamma, kbt, state->dt, power);
+    PairwiseDPD dpd(rc, a, gamma, kbt, state->dt, power, counterRNG);
     impl = std::make_unique<InteractionPair_withStress<PairwiseDPD>> (state, name, rc, stressPeriod, dpd);
 }
 
@@ -26,7 +27,7 @@ void InteractionDPDWithStress::setSpecificPair(ParticleVector *pv1, ParticleVect
     if (kbt   == Default) kbt   = this->kbt;
     if (power == Default) power = this->power;
 
-    PairwiseDPD dpd(this->rc, a, gamma, kbt, state->dt, power);
+    PairwiseDPD dpd(this->rc, a, gamma, kbt, state->dt, power, counterRNG);
     auto ptr = static_cast< InteractionPair_withStress<PairwiseDPD>* >(impl.get());
     
     ptr->setSpecificPair(pv1->name, pv2->name, dpd);
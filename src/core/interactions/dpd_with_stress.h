@@ -6,7 +6,8 @@ class InteractionDPDWithStress : public InteractionDPD
 {
 public:
     InteractionDPDWithStress(const YmrState *state, std::string name,
-                             float rc, float a, float gamma, float kbt, float power, float stressPeriod);
+                             float rc, float a, float gamma, float kbt, float power, float stressPeriod,
+                             bool counterRNG = false);
 
     ~InteractionDPDWithStress();    
     
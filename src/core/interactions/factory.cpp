@@ -124,13 +124,23 @@ static bool isJuelicher(const std::string& desc)
 }
 
 
+static MembranePrecision readPrecision(const std::string& desc)
+{
+    if (desc == "single") return MembranePrecision::Single;
+    if (desc == "mixed")  return MembranePrecision::Mixed;
+
+    die("Unknown membrane precision '%s', expected 'single' or 'mixed'", desc.c_str());
+    return MembranePrecision::Single;
+}
+
 std::shared_ptr<InteractionMembrane>
 InteractionFactory::createInteractionMembrane(const YmrState *state, std::string name,
                                               std::string shearDesc, std::string bendingDesc,
                                               const std::map<std::string, float>& parameters,
-                                              bool stressFree, float growUntil)
+                                              bool stressFree, float growUntil, std::string precisionDesc)
 {
     auto commonPrms = readCommonParameters(parameters);
+    auto precision  = readPrecision(precisionDesc);
     
     if (isWLC(shearDesc))
     {
@@ -140,14 +150,14 @@ InteractionFactory::createInteractionMembrane(const YmrState *state, std::string
         {
             auto bePrms = readKantorParameters(parameters);
             return std::make_shared<InteractionMembraneWLCKantor>
-                (state, name, commonPrms, shPrms, bePrms, stressFree, growUntil);
+                (state, name, commonPrms, shPrms, bePrms, stressFree, growUntil, precision);
         }
 
         if (isJuelicher(bendingDesc))
         {
             auto bePrms = readJuelicherParameters(parameters);
             return std::make_shared<InteractionMembraneWLCJuelicher>
-                (state, name, commonPrms, shPrms, bePrms, stressFree, growUntil);
+                (state, name, commonPrms, shPrms, bePrms, stressFree, growUntil, precision);
         }            
     }
 
@@ -159,14 +169,14 @@ InteractionFactory::createInteractionMembrane(const YmrState *state, std::string
         {
             auto bePrms = readKantorParameters(parameters);
             return std::make_shared<InteractionMembraneLimKantor>
-                (state, name, commonPrms, shPrms, bePrms, stressFree, growUntil);
+                (state, name, commonPrms, shPrms, bePrms, stressFree, growUntil, precision);
         }
 
         if (isJuelicher(bendingDesc))
         {
             auto bePrms = readJuelicherParameters(parameters);
             return std::make_shared<InteractionMembraneLimJuelicher>
-                (state, name, commonPrms, shPrms, bePrms, stressFree, growUntil);
+                (state, name, commonPrms, shPrms, bePrms, stressFree, growUntil, precision);
         }
     }
     
@@ -188,6 +198,11 @@ static bool isWendlandC2Density(const std::string& desc)
     return desc == "WendlandC2";
 }
 
+static bool isTabulatedWendlandC2Density(const std::string& desc)
+{
+    return desc == "WendlandC2_tabulated";
+}
+
 std::shared_ptr<BasicInteractionDensity>
 InteractionFactory::createPairwiseDensity(const YmrState *state, std::string name, float rc,
                                           const std::string& density)
@@ -206,6 +221,13 @@ InteractionFactory::createPairwiseDensity(const YmrState *state, std::string nam
                                 (state, name, rc, densityKernel);
     }
 
+    if (isTabulatedWendlandC2Density(density))
+    {
+        TabulatedWendlandC2DensityKernel densityKernel;
+        return std::make_shared<InteractionDensity<TabulatedWendlandC2DensityKernel>>
+                                (state, name, rc, densityKernel);
+    }
+
     die("Invalid density '%s'", density.c_str());
     return nullptr;
 }
@@ -252,33 +274,48 @@ allocatePairwiseSDPD(const YmrState *state, std::string name, float rc,
 }
 
 
-std::shared_ptr<BasicInteractionSDPD>
-InteractionFactory::createPairwiseSDPD(const YmrState *state, std::string name, float rc, float viscosity, float kBT,
-                                       const std::string& EOS, const std::string& density, bool stress,
-                                       const std::map<std::string, float>& parameters)
+template <typename DensityKernel>
+static std::shared_ptr<BasicInteractionSDPD>
+allocatePairwiseSDPDWithEOS(const YmrState *state, std::string name, float rc,
+                            const std::string& EOS, DensityKernel density,
+                            float viscosity, float kBT,
+                            bool stress, float stressPeriod,
+                            const std::map<std::string, float>& parameters)
 {
-    float stressPeriod = 0.f;
-
-    if (stress)
-        stressPeriod = readFloat(parameters, "stress_period");
-    
-    if (!isWendlandC2Density(density))
-        die("Invalid density '%s'", density.c_str());
-
-    WendlandC2DensityKernel densityKernel;
-    
     if (isLinearEOS(EOS))
     {
         auto pressure = readLinearPressureEOS(parameters);
-        return allocatePairwiseSDPD(state, name, rc, pressure, densityKernel, viscosity, kBT, stress, stressPeriod);
+        return allocatePairwiseSDPD(state, name, rc, pressure, density, viscosity, kBT, stress, stressPeriod);
     }
 
     if (isQuasiIncompressibleEOS(EOS))
     {
         auto pressure = readQuasiIncompressiblePressureEOS(parameters);
-        return allocatePairwiseSDPD(state, name, rc, pressure, densityKernel, viscosity, kBT, stress, stressPeriod);
+        return allocatePairwiseSDPD(state, name, rc, pressure, density, viscosity, kBT, stress, stressPeriod);
     }
 
     die("Invalid pressure parameter: '%s'", EOS.c_str());
     return nullptr;
 }
+
+std::shared_ptr<BasicInteractionSDPD>
+InteractionFactory::createPairwiseSDPD(const YmrState *state, std::string name, float rc, float viscosity, float kBT,
+                                       const std::string& EOS, const std::string& density, bool stress,
+                                       const std::map<std::string, float>& parameters)
+{
+    float stressPeriod = 0.f;
+
+    if (stress)
+        stressPeriod = readFloat(parameters, "stress_period");
+    
+    if (isWendlandC2Density(density))
+        return allocatePairwiseSDPDWithEOS(state, name, rc, EOS, WendlandC2DensityKernel(),
+                                           viscosity, kBT, stress, stressPeriod, parameters);
+
+    if (isTabulatedWendlandC2Density(density))
+        return allocatePairwiseSDPDWithEOS(state, name, rc, EOS, TabulatedWendlandC2DensityKernel(),
+                                           viscosity, kBT, stress, stressPeriod, parameters);
+
+    die("Invalid density '%s'", density.c_str());
+    return nullptr;
+}
@@ -15,7 +15,7 @@ std::shared_ptr<InteractionMembrane>
 createInteractionMembrane(const YmrState *state, std::string name,
                           std::string shearDesc, std::string bendingDesc,
                           const std::map<std::string, float>& parameters,
-                          bool stressFree, float growUntil);
+                          bool stressFree, float growUntil, std::string precision = "single");
 
 std::shared_ptr<BasicInteractionDensity>
 createPairwiseDensity(const YmrState *state, std::string name, float rc, const std::string& density);
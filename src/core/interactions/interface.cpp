@@ -1,5 +1,6 @@
 #include "interface.h"
 
+#include <core/logger.h>
 #include <core/utils/common.h>
 
 Interaction::Interaction(const YmrState *state, std::string name, float rc) :
@@ -27,4 +28,56 @@ std::vector<Interaction::InteractionChannel> Interaction::getFinalOutputChannels
     return {{ChannelNames::forces, alwaysActive}};
 }
 
+std::vector<std::string> Interaction::getHaloInputChannels() const
+{
+    return {};
+}
+
+void Interaction::useNeighborList(float skin)
+{
+    die("Interaction '%s' does not support neighbor lists", name.c_str());
+}
+
+void Interaction::useTiledKernels(bool enabled)
+{
+    die("Interaction '%s' does not support tiled kernels", name.c_str());
+}
+
+void Interaction::setAutotuning(int nsamples, std::string fname)
+{}
+
+void Interaction::useCompressedStorage(bool enabled, bool validate)
+{
+    die("Interaction '%s' does not support compressed storage", name.c_str());
+}
+
+void Interaction::useEarlyInterior(bool enabled)
+{
+    die("Interaction '%s' does not support the early computation of the interior", name.c_str());
+}
+
+bool Interaction::setInteriorMargin(ParticleVector *pv, CellList *cl, float margin)
+{
+    return false;
+}
+
+void Interaction::localInterior(ParticleVector *pv, CellList *cl, cudaStream_t stream)
+{}
+
+bool Interaction::usePeriodicImages(bool enabled)
+{
+    return false;
+}
+
+std::string Interaction::getBatchKey() const
+{
+    return "";
+}
+
+void Interaction::localBatch(const std::vector<BatchEntry>& entries, cudaStream_t stream)
+{
+    for (auto& e : entries)
+        e.interaction->local(e.pv1, e.pv2, e.cl1, e.cl2, stream);
+}
+
 const Interaction::ActivePredicate Interaction::alwaysActive = [](){return true;};
@@ -5,6 +5,7 @@
 #include <cuda_runtime.h>
 #include <functional>
 #include <mpi.h>
+#include <string>
 #include <vector>
 
 class CellList;
@@ -90,6 +91,100 @@ public:
      */
     virtual std::vector<InteractionChannel> getFinalOutputChannels() const;
 
+    /**
+     * describe the per-particle channels, not produced by any interaction, that the interaction
+     * reads from the halo, e.g. a persistent property of the particles
+     * default: nothing
+     */
+    virtual std::vector<std::string> getHaloInputChannels() const;
+
+    /**
+     * compute local self interactions with a Verlet neighbor list
+     * built with cut-off rc + \p skin instead of traversing the cell-lists
+     * default: not supported, die
+     */
+    virtual void useNeighborList(float skin);
+
+    /**
+     * compute local self interactions, and the local ones between
+     * particle vectors whose cell-lists have the same grid, with the
+     * warp-per-cell kernels staging the particles in shared memory
+     * default: not supported, die
+     */
+    virtual void useTiledKernels(bool enabled);
+
+    /**
+     * choose the kernel variants and launch configurations by timing them
+     * during the first \p nsamples launches of each candidate, store the results in \p fname
+     * default: nothing to tune
+     */
+    virtual void setAutotuning(int nsamples, std::string fname);
+
+    /**
+     * read the source particles of the external interactions from a compressed
+     * copy with 16-bit coordinates and FP16 velocities; if \p validate, report
+     * the error of the forces with respect to the full precision ones at every launch
+     * default: not supported, die
+     */
+    virtual void useCompressedStorage(bool enabled, bool validate);
+
+    /**
+     * compute the local self interactions of the interior of the subdomain in a separate pass,
+     * launched right after the local intermediate interactions, see localInterior()
+     * default: not supported, die
+     */
+    virtual void useEarlyInterior(bool enabled);
+
+    /**
+     * Prepare the split of the local self interactions of \p pv into the particles further than
+     * \p margin from the subdomain boundary, computed by localInterior(), and the others, computed by local().
+     * Called by the InteractionManager at setup when the intermediate channels of the interior of \p pv
+     * are complete without the halo; \p cl is the cell-list of \p pv
+     * default: no split
+     *
+     * @return true if the interior will be computed by localInterior()
+     */
+    virtual bool setInteriorMargin(ParticleVector *pv, CellList *cl, float margin);
+
+    /**
+     * compute the local self interactions of the interior, see setInteriorMargin()
+     * default: nothing to do
+     */
+    virtual void localInterior(ParticleVector *pv, CellList *cl, cudaStream_t stream);
+
+    /**
+     * compute the local interactions with the periodic images of the particles
+     * across the boundary of the domain, such that halo() has nothing left to compute;
+     * only valid if the subdomain is the whole periodic domain, i.e. on a single rank
+     * default: not supported, the halos are needed
+     *
+     * @return true if the periodic images are used
+     */
+    virtual bool usePeriodicImages(bool enabled);
+
+    /// arguments of one local() call of a batched launch, see localBatch()
+    struct BatchEntry
+    {
+        Interaction *interaction;
+        ParticleVector *pv1, *pv2;
+        CellList *cl1, *cl2;
+    };
+
+    /**
+     * Interactions with the same non-empty key can compute their local interactions
+     * in a single launch, see localBatch()
+     * default: empty, never batched
+     */
+    virtual std::string getBatchKey() const;
+
+    /**
+     * compute the local interactions of all the \p entries at once;
+     * called by the InteractionManager on the interaction of the first entry,
+     * all the interactions of the entries have the same batch key
+     * default: call local() of each entry
+     */
+    virtual void localBatch(const std::vector<BatchEntry>& entries, cudaStream_t stream);
+
     static const ActivePredicate alwaysActive;
     
 public:
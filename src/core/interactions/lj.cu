@@ -3,13 +3,18 @@
 #include "pairwise_interactions/lj.h"
 #include "pairwise_interactions/lj_object_aware.h"
 
+#include "utils/object_pairs.h"
+
 #include <core/celllist.h>
+#include <core/pvs/object_vector.h>
+#include <core/utils/kernel_launch.h>
 
 #include <memory>
 
 InteractionLJ::InteractionLJ(const YmrState *state, std::string name, float rc, float epsilon, float sigma, float maxForce, bool objectAware, bool allocate) :
     Interaction(state, name, rc),
-    objectAware(objectAware)
+    objectAware(objectAware),
+    defaultParameters{epsilon, sigma, maxForce}
 {
     if (!allocate) return;
 
@@ -43,6 +48,9 @@ void InteractionLJ::local(ParticleVector *pv1, ParticleVector *pv2,
                           CellList *cl1, CellList *cl2,
                           cudaStream_t stream)
 {
+    if (objectBroadphase && computeObjectPairs(pv1, pv2, true, stream))
+        return;
+
     impl->local(pv1, pv2, cl1, cl2, stream);
 }
 
@@ -50,12 +58,43 @@ void InteractionLJ::halo(ParticleVector *pv1, ParticleVector *pv2,
                          CellList *cl1, CellList *cl2,
                          cudaStream_t stream)
 {
+    if (objectBroadphase && computeObjectPairs(pv1, pv2, false, stream))
+        return;
+
     impl->halo(pv1, pv2, cl1, cl2, stream);
 }
 
+void InteractionLJ::useNeighborList(float skin)
+{
+    impl->useNeighborList(skin);
+}
+
+void InteractionLJ::useTiledKernels(bool enabled)
+{
+    impl->useTiledKernels(enabled);
+}
+
+bool InteractionLJ::usePeriodicImages(bool enabled)
+{
+    return impl->usePeriodicImages(enabled);
+}
+
+void InteractionLJ::setAutotuning(int nsamples, std::string fname)
+{
+    impl->setAutotuning(nsamples, fname);
+}
+
+void InteractionLJ::useCompressedStorage(bool enabled, bool validate)
+{
+    impl->useCompressedStorage(enabled, validate);
+}
+
 void InteractionLJ::setSpecificPair(ParticleVector* pv1, ParticleVector* pv2, 
                                     float epsilon, float sigma, float maxForce)
 {
+    specificParameters[{pv1->name, pv2->name}] = {epsilon, sigma, maxForce};
+    specificParameters[{pv2->name, pv1->name}] = {epsilon, sigma, maxForce};
+
     if (objectAware) {
         PairwiseLJObjectAware lj(rc, epsilon, sigma, maxForce);
         auto ptr = static_cast< InteractionPair<PairwiseLJObjectAware>* >(impl.get());
@@ -68,3 +107,54 @@ void InteractionLJ::setSpecificPair(ParticleVector* pv1, ParticleVector* pv2,
     }
 }
 
+
+void InteractionLJ::useObjectBroadphase(bool enabled)
+{
+    if (enabled && !objectAware)
+        die("Interaction '%s' must be object aware to use the object broadphase", name.c_str());
+
+    if (enabled) objectBroadphase = std::make_unique<ObjectPairsBroadphase>();
+    else         objectBroadphase.reset();
+}
+
+/**
+ * Local objects of \p pv1 with the local objects of \p pv2, or halo objects of \p pv1
+ * with local objects of \p pv2: the same pairs as the cell-lists version
+ */
+bool InteractionLJ::computeObjectPairs(ParticleVector *pv1, ParticleVector *pv2, bool local, cudaStream_t stream)
+{
+    auto ov1 = dynamic_cast<ObjectVector*>(pv1);
+    auto ov2 = dynamic_cast<ObjectVector*>(pv2);
+    if (ov1 == nullptr || ov2 == nullptr) return false;
+
+    auto dst = local ? ov1->local() : ov1->halo();
+    auto src = ov2->local();
+
+    ov1->findExtentAndCOM(stream, local ? ParticleVectorType::Local : ParticleVectorType::Halo);
+    ov2->findExtentAndCOM(stream, ParticleVectorType::Local);
+
+    OVview dstView(ov1, dst), srcView(ov2, src);
+
+    auto it = specificParameters.find({pv1->name, pv2->name});
+    const auto& p = it != specificParameters.end() ? it->second : defaultParameters;
+
+    PairwiseLJObjectAware lj(rc, p.epsilon, p.sigma, p.maxForce);
+    lj.setup(dst, src, nullptr, nullptr, state);
+
+    // halo objects stick out of the domain, the codes are clamped anyways
+    const float3 margin = make_float3(rc);
+    const int nPairs = objectBroadphase->find(dstView, srcView, local && ov1 == ov2, rc,
+                                              -0.5f * state->domain.localSize - margin,
+                                               0.5f * state->domain.localSize + margin, stream);
+
+    debug("Computing %s forces of '%s' - '%s' over %d pairs of objects",
+          local ? "local" : "halo", pv1->name.c_str(), pv2->name.c_str(), nPairs);
+
+    const int nthreads = 128;
+    SAFE_KERNEL_LAUNCH(
+            computeObjectPairInteractions,
+            nPairs, nthreads, 0, stream,
+            dstView, srcView, objectBroadphase->getPairs(), rc, lj.handler() );
+
+    return true;
+}
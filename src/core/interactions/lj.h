@@ -1,7 +1,12 @@
 #pragma once
 
 #include "interface.h"
+#include <map>
 #include <memory>
+#include <string>
+#include <utility>
+
+class ObjectPairsBroadphase;
 
 struct InteractionLJ : public Interaction
 {        
@@ -16,13 +21,38 @@ struct InteractionLJ : public Interaction
     void local (ParticleVector *pv1, ParticleVector *pv2, CellList *cl1, CellList *cl2, cudaStream_t stream) override;
     void halo  (ParticleVector *pv1, ParticleVector *pv2, CellList *cl1, CellList *cl2, cudaStream_t stream) override;
 
+    void useNeighborList(float skin) override;
+    void useTiledKernels(bool enabled) override;
+    bool usePeriodicImages(bool enabled) override;
+    void setAutotuning(int nsamples, std::string fname) override;
+    void useCompressedStorage(bool enabled, bool validate) override;
+
     virtual void setSpecificPair(ParticleVector* pv1, ParticleVector* pv2, 
                                  float epsilon, float sigma, float maxForce);
 
+    /**
+     * With \p enabled, the forces between two object vectors are computed per pair of objects
+     * closer than the cut-off, found from the bounding boxes of the objects, instead of with the cell-lists.
+     * Only for object aware interactions
+     */
+    virtual void useObjectBroadphase(bool enabled);
+
 protected:
     InteractionLJ(const YmrState *state, std::string name, float rc, float epsilon, float sigma, float maxForce, bool objectAware, bool allocate);
+
+    struct Parameters
+    {
+        float epsilon, sigma, maxForce;
+    };
+
+    /// @return false if \p pv1 and \p pv2 are not both object vectors
+    bool computeObjectPairs(ParticleVector *pv1, ParticleVector *pv2, bool local, cudaStream_t stream);
     
     std::unique_ptr<Interaction> impl;
     bool objectAware;
+
+    Parameters defaultParameters;
+    std::map<std::pair<std::string, std::string>, Parameters> specificParameters;
+    std::unique_ptr<ObjectPairsBroadphase> objectBroadphase;
 };
 
@@ -40,3 +40,9 @@ void InteractionLJWithStress::setSpecificPair(ParticleVector* pv1, ParticleVecto
         ptr->setSpecificPair(pv1->name, pv2->name, lj);
     }
 }
+
+void InteractionLJWithStress::useObjectBroadphase(bool enabled)
+{
+    if (enabled)
+        die("Interaction '%s' cannot compute the stresses with the object broadphase", name.c_str());
+}
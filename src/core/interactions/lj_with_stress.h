@@ -12,6 +12,9 @@ struct InteractionLJWithStress : public InteractionLJ
     void setSpecificPair(ParticleVector* pv1, ParticleVector* pv2, 
                          float epsilon, float sigma, float maxForce) override;
 
+    /// the stresses are only computed with the cell-lists
+    void useObjectBroadphase(bool enabled) override;
+
 protected:
     float stressPeriod;
 };
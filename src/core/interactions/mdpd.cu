@@ -11,18 +11,21 @@
 #include <memory>
 
 
-InteractionMDPD::InteractionMDPD(const YmrState *state, std::string name, float rc, float rd, float a, float b, float gamma, float kbt, float power, bool allocateImpl) :
+InteractionMDPD::InteractionMDPD(const YmrState *state, std::string name, float rc, float rd, float a, float b, float gamma, float kbt, float power,
+                                 int powerIntervals, bool allocateImpl) :
     Interaction(state, name, rc),
-    rd(rd), a(a), b(b), gamma(gamma), kbt(kbt), power(power)
+    rd(rd), a(a), b(b), gamma(gamma), kbt(kbt), power(power),
+    powerIntervals(powerIntervals)
 {
     if (allocateImpl) {
-        PairwiseMDPD mdpd(rc, rd, a, b, gamma, kbt, state->dt, power);
+        PairwiseMDPD mdpd(rc, rd, a, b, gamma, kbt, state->dt, power, powerIntervals);
         impl = std::make_unique<InteractionPair<PairwiseMDPD>> (state, name, rc, mdpd);
     }
 }
 
-InteractionMDPD::InteractionMDPD(const YmrState *state, std::string name, float rc, float rd, float a, float b, float gamma, float kbt, float power) :
-    InteractionMDPD(state, name, rc, rd, a, b, gamma, kbt, power, true)
+InteractionMDPD::InteractionMDPD(const YmrState *state, std::string name, float rc, float rd, float a, float b, float gamma, float kbt, float power,
+                                 int powerIntervals) :
+    InteractionMDPD(state, name, rc, rd, a, b, gamma, kbt, power, powerIntervals, true)
 {}
 
 InteractionMDPD::~InteractionMDPD() = default;
@@ -62,6 +65,41 @@ void InteractionMDPD::halo(ParticleVector *pv1, ParticleVector *pv2,
     impl->halo(pv1, pv2, cl1, cl2, stream);
 }
 
+void InteractionMDPD::useNeighborList(float skin)
+{
+    impl->useNeighborList(skin);
+}
+
+void InteractionMDPD::useTiledKernels(bool enabled)
+{
+    impl->useTiledKernels(enabled);
+}
+
+bool InteractionMDPD::usePeriodicImages(bool enabled)
+{
+    return impl->usePeriodicImages(enabled);
+}
+
+void InteractionMDPD::setAutotuning(int nsamples, std::string fname)
+{
+    impl->setAutotuning(nsamples, fname);
+}
+
+void InteractionMDPD::useEarlyInterior(bool enabled)
+{
+    impl->useEarlyInterior(enabled);
+}
+
+bool InteractionMDPD::setInteriorMargin(ParticleVector *pv, CellList *cl, float margin)
+{
+    return impl->setInteriorMargin(pv, cl, margin);
+}
+
+void InteractionMDPD::localInterior(ParticleVector *pv, CellList *cl, cudaStream_t stream)
+{
+    impl->localInterior(pv, cl, stream);
+}
+
 void InteractionMDPD::setSpecificPair(ParticleVector* pv1, ParticleVector* pv2, 
                                       float a, float b, float gamma, float kbt, float power)
 {
@@ -71,7 +109,7 @@ void InteractionMDPD::setSpecificPair(ParticleVector* pv1, ParticleVector* pv2,
     if (kbt   == Default) kbt   = this->kbt;
     if (power == Default) power = this->power;
 
-    PairwiseMDPD mdpd(this->rc, this->rd, a, b, gamma, kbt, state->dt, power);
+    PairwiseMDPD mdpd(this->rc, this->rd, a, b, gamma, kbt, state->dt, power, powerIntervals);
     auto ptr = static_cast< InteractionPair<PairwiseMDPD>* >(impl.get());
     
     ptr->setSpecificPair(pv1->name, pv2->name, mdpd);
@@ -9,7 +9,9 @@ class InteractionMDPD : public Interaction
 public:
     constexpr static float Default = std::numeric_limits<float>::infinity();
 
-    InteractionMDPD(const YmrState *state, std::string name, float rc, float rd, float a, float b, float gamma, float kbt, float power);
+    /// the weight function is tabulated with \p powerIntervals intervals if positive, see PairwiseMDPDHandler
+    InteractionMDPD(const YmrState *state, std::string name, float rc, float rd, float a, float b, float gamma, float kbt, float power,
+                    int powerIntervals = 0);
 
     ~InteractionMDPD();
 
@@ -21,17 +23,28 @@ public:
     void local (ParticleVector *pv1, ParticleVector *pv2, CellList *cl1, CellList *cl2, cudaStream_t stream) override;
     void halo  (ParticleVector *pv1, ParticleVector *pv2, CellList *cl1, CellList *cl2, cudaStream_t stream) override;
 
+    void useNeighborList(float skin) override;
+    void useTiledKernels(bool enabled) override;
+    bool usePeriodicImages(bool enabled) override;
+    void setAutotuning(int nsamples, std::string fname) override;
+
+    void useEarlyInterior(bool enabled) override;
+    bool setInteriorMargin(ParticleVector *pv, CellList *cl, float margin) override;
+    void localInterior(ParticleVector *pv, CellList *cl, cudaStream_t stream) override;
+
     virtual void setSpecificPair(ParticleVector *pv1, ParticleVector *pv2, 
                                  float a=Default, float b=Default, float gamma=Default,
                                  float kbt=Default, float power=Default);
         
 protected:
 
-    InteractionMDPD(const YmrState *state, std::string name, float rc, float rd, float a, float b, float gamma, float kbt, float power, bool allocateImpl);
+    InteractionMDPD(const YmrState *state, std::string name, float rc, float rd, float a, float b, float gamma, float kbt, float power,
+                    int powerIntervals, bool allocateImpl);
     
     std::unique_ptr<Interaction> impl;
     
     // Default values
     float rd, a, b, gamma, kbt, power;
+    int powerIntervals;
 };
 
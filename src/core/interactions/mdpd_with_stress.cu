@@ -10,11 +10,11 @@
 
 InteractionMDPDWithStress::InteractionMDPDWithStress(const YmrState *state, std::string name,
                                                      float rc, float rd, float a, float b, float gamma, float kbt, float power,
-                                                     float stressPeriod) :
-    InteractionMDPD(state, name, rc, rd, a, b, gamma, kbt, power, false),
+                                                     float stressPeriod, int powerIntervals) :
+    InteractionMDPD(state, name, rc, rd, a, b, gamma, kbt, power, powerIntervals, false),
     stressPeriod(stressPeriod)
 {
-    PairwiseMDPD mdpd(rc, rd, a, b, gamma, kbt, state->dt, power);
+    PairwiseMDPD mdpd(rc, rd, a, b, gamma, kbt, state->dt, power, powerIntervals);
     impl = std::make_unique<InteractionPair_withStress<PairwiseMDPD>> (state, name, rc, stressPeriod, mdpd);
 }
 
@@ -29,7 +29,7 @@ void InteractionMDPDWithStress::setSpecificPair(ParticleVector *pv1, ParticleVec
     if (kbt   == Default) kbt   = this->kbt;
     if (power == Default) power = this->power;
 
-    PairwiseMDPD mdpd(this->rc, this->rd, a, b, gamma, kbt, state->dt, power);
+    PairwiseMDPD mdpd(this->rc, this->rd, a, b, gamma, kbt, state->dt, power, powerIntervals);
     auto ptr = static_cast< InteractionPair_withStress<PairwiseMDPD>* >(impl.get());
     
     ptr->setSpecificPair(pv1->name, pv2->name, mdpd);
@@ -7,7 +7,7 @@ class InteractionMDPDWithStress : public InteractionMDPD
 public:
     InteractionMDPDWithStress(const YmrState *state, std::string name,
                               float rc, float rd, float a, float b, float gamma, float kbt, float power,
-                              float stressPeriod);
+                              float stressPeriod, int powerIntervals = 0);
 
     ~InteractionMDPDWithStress();    
     
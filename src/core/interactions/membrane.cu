@@ -7,26 +7,31 @@
 #include <core/utils/cuda_common.h>
 #include <core/utils/kernel_launch.h>
 
+#include <typeinfo>
+
 
 namespace InteractionMembraneKernels
 {
+/// every thread sums its triangles in the precision \c Sensitive
+template <class Sensitive>
 __global__ void computeAreaAndVolume(OVviewWithAreaVolume view, MeshView mesh)
 {
     int objId = blockIdx.x;
     int offset = objId * mesh.nvertices;
-    float2 a_v = make_float2(0.0f);
+    typename Sensitive::Scalar area = 0, volume = 0;
 
     for (int i = threadIdx.x; i < mesh.ntriangles; i += blockDim.x) {
-        int3 ids = mesh.triangles[i];
+        int3 ids = mesh.getTriangle(i);
 
-        auto v0 = make_real3(f4tof3( view.particles[ 2 * (offset + ids.x) ] ));
-        auto v1 = make_real3(f4tof3( view.particles[ 2 * (offset + ids.y) ] ));
-        auto v2 = make_real3(f4tof3( view.particles[ 2 * (offset + ids.z) ] ));
+        auto v0 = Sensitive::make3(f4tof3( view.particles[ 2 * (offset + ids.x) ] ));
+        auto v1 = Sensitive::make3(f4tof3( view.particles[ 2 * (offset + ids.y) ] ));
+        auto v2 = Sensitive::make3(f4tof3( view.particles[ 2 * (offset + ids.z) ] ));
 
-        a_v.x += triangleArea(v0, v1, v2);
-        a_v.y += triangleSignedVolume(v0, v1, v2);
+        area   += triangleArea(v0, v1, v2);
+        volume += triangleSignedVolume(v0, v1, v2);
     }
 
+    float2 a_v = make_float2(area, volume);
     a_v = warpReduce( a_v, [] (float a, float b) { return a+b; } );
 
     if (__laneid() == 0)
@@ -34,9 +39,10 @@ __global__ void computeAreaAndVolume(OVviewWithAreaVolume view, MeshView mesh)
 }
 } // namespace InteractionMembraneKernels
 
-InteractionMembrane::InteractionMembrane(const YmrState *state, std::string name) :
+InteractionMembrane::InteractionMembrane(const YmrState *state, std::string name, MembranePrecision precision) :
     Interaction(state, name, /* default cutoff rc */ 1.0),
-    impl(nullptr)
+    impl(nullptr),
+    precision(precision)
 {}
 
 InteractionMembrane::~InteractionMembrane() = default;
@@ -62,6 +68,50 @@ void InteractionMembrane::local(ParticleVector *pv1, ParticleVector *pv2, CellLi
     impl->local(pv1, pv2, cl1, cl2, stream);
 }
 
+std::string InteractionMembrane::getBatchKey() const
+{
+    if (impl.get() == nullptr) return "";
+    return std::string("membrane:") + typeid(*impl).name();
+}
+
+/**
+ * Same batch key means that all the implementations have the same type,
+ * the first one launches the kernel for all the membrane vectors
+ */
+void InteractionMembrane::localBatch(const std::vector<BatchEntry>& entries, cudaStream_t stream)
+{
+    if (entries.size() == 1)
+    {
+        local(entries[0].pv1, entries[0].pv2, entries[0].cl1, entries[0].cl2, stream);
+        return;
+    }
+
+    std::vector<InteractionMembraneImplBase::ImplEntry> implEntries;
+
+    for (auto& e : entries)
+    {
+        auto membrane = static_cast<InteractionMembrane*>(e.interaction);
+
+        membrane->batched = true;
+        membrane->precomputeQuantities(e.pv1, stream);
+        membrane->batched = false;
+
+        implEntries.push_back({membrane->impl.get(), e.pv1});
+    }
+
+    debug("Computing internal membrane forces of %d membrane vectors in one launch", (int) implEntries.size());
+
+    impl->computeBatch(implEntries, stream);
+}
+
+bool InteractionMembrane::advancePerObject(ParticleVector *pv1, int substeps, float dt, cudaStream_t stream)
+{
+    if (impl.get() == nullptr)
+        die("%s needs a concrete implementation, none was provided", name.c_str());
+
+    return impl->advancePerObject(pv1, substeps, dt, stream);
+}
+
 void InteractionMembrane::halo(ParticleVector *pv1, ParticleVector *pv2, CellList *cl1, CellList *cl2, cudaStream_t stream)
 {
     debug("Not computing internal membrane forces between local and halo membranes of '%s'",
@@ -83,12 +133,24 @@ void InteractionMembrane::precomputeQuantities(ParticleVector *pv1, cudaStream_t
 
     MembraneMeshView mesh(static_cast<MembraneMesh*>(ov->mesh.get()));
 
+    if (!batched && impl->computesAreaVolume(pv1))
+    {
+        debug("Areas and volumes of '%s' are computed with the forces", ov->name.c_str());
+        return;
+    }
+
     ov->local()
         ->extraPerObject.getData<float2>(ChannelNames::areaVolumes)
         ->clearDevice(stream);
     
     const int nthreads = 128;
-    SAFE_KERNEL_LAUNCH(InteractionMembraneKernels::computeAreaAndVolume,
-                       view.nObjects, nthreads, 0, stream,
-                       view, mesh);
+
+    if (precision == MembranePrecision::Mixed)
+        SAFE_KERNEL_LAUNCH(InteractionMembraneKernels::computeAreaAndVolume<SensitiveReal<double>>,
+                           view.nObjects, nthreads, 0, stream,
+                           view, mesh);
+    else
+        SAFE_KERNEL_LAUNCH(InteractionMembraneKernels::computeAreaAndVolume<SensitiveReal<float>>,
+                           view.nObjects, nthreads, 0, stream,
+                           view, mesh);
 }
@@ -1,8 +1,39 @@
 #pragma once
 
 #include "interface.h"
+#include "membrane/parameters.h"
+
 #include <memory>
 
+/**
+ * Interface of the concrete implementations of the membrane forces, see InteractionMembraneImpl
+ */
+class InteractionMembraneImplBase : public Interaction
+{
+public:
+    using Interaction::Interaction;
+
+    /// true if the force kernel computes the areas and volumes of the cells itself at this step
+    virtual bool computesAreaVolume(ParticleVector *pv1) = 0;
+
+    /// one membrane vector of a batch, with the implementation (of the same type) holding its parameters
+    struct ImplEntry
+    {
+        InteractionMembraneImplBase *impl;
+        ParticleVector *pv;
+    };
+
+    /// compute the forces of all the \p entries in one launch, areas and volumes are already computed
+    virtual void computeBatch(const std::vector<ImplEntry>& entries, cudaStream_t stream) = 0;
+
+    /**
+     * Advance the membranes of \p pv1 by \p substeps sub-steps of \p dt under these forces only,
+     * the forces already in \p pv1 kept constant, in one launch with one block per membrane.
+     * @return false if the membranes do not fit in the shared memory or the model needs per-vertex quantities
+     */
+    virtual bool advancePerObject(ParticleVector *pv1, int substeps, float dt, cudaStream_t stream) = 0;
+};
+
 /**
  * parent class for membrane interactions.
  * any derived class must allocate a concrete implementation for the forces @ref impl
@@ -11,7 +42,7 @@ class InteractionMembrane : public Interaction
 {
 public:
 
-    InteractionMembrane(const YmrState *state, std::string name);
+    InteractionMembrane(const YmrState *state, std::string name, MembranePrecision precision = MembranePrecision::Single);
     ~InteractionMembrane();
     
     void setPrerequisites(ParticleVector *pv1, ParticleVector *pv2, CellList *cl1, CellList *cl2) override;
@@ -19,14 +50,25 @@ public:
     void local (ParticleVector *pv1, ParticleVector *pv2, CellList *cl1, CellList *cl2, cudaStream_t stream) final;
     void halo  (ParticleVector *pv1, ParticleVector *pv2, CellList *cl1, CellList *cl2, cudaStream_t stream) final;
 
+    /// membrane interactions with the same triangle and dihedral models are batched together
+    std::string getBatchKey() const override;
+    void localBatch(const std::vector<BatchEntry>& entries, cudaStream_t stream) override;
+
+    /// see InteractionMembraneImplBase::advancePerObject(), used by IntegratorSubStepMembrane
+    bool advancePerObject(ParticleVector *pv1, int substeps, float dt, cudaStream_t stream);
+
 protected:
 
     /**
      * compute quantities used by the force kernels.
      * this is called before every force kernel (see implementation of @ref local)
-     * default: compute area and volume of each cell
+     * default: compute area and volume of each cell, unless the force kernel does it (see @ref InteractionMembraneImplBase)
      */
     virtual void precomputeQuantities(ParticleVector *pv1, cudaStream_t stream);
     
-    std::unique_ptr<Interaction> impl; ///< concrete implementation of forces
+    std::unique_ptr<InteractionMembraneImplBase> impl; ///< concrete implementation of forces
+
+    bool batched{false}; ///< areas and volumes are always needed before a batched launch
+
+    MembranePrecision precision; ///< of the sensitive terms, also used for the areas and volumes computed here
 };
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "interface.h"
+#include "membrane.h"
 #include "membrane/forces_kernels.h"
 #include "membrane/parameters.h"
 #include "utils/step_random_gen.h"
@@ -9,10 +10,13 @@
 #include <core/pvs/views/ov.h>
 #include <core/utils/cuda_common.h>
 #include <core/utils/kernel_launch.h>
+#include <core/utils/make_unique.h>
 
 #include <cmath>
+#include <cstring>
 #include <functional>
 #include <random>
+#include <type_traits>
 
 /**
  * Provide mapping from the model parameters to the parameters
@@ -60,7 +64,7 @@ static void rescaleParameters(CommonMembraneParameters& p, float scale)
  * Generic mplementation of RBC membrane forces
  */
 template <class TriangleInteraction, class DihedralInteraction>
-class InteractionMembraneImpl : public Interaction
+class InteractionMembraneImpl : public InteractionMembraneImplBase
 {
 public:
 
@@ -68,7 +72,7 @@ public:
                             typename TriangleInteraction::ParametersType triangleParams,
                             typename DihedralInteraction::ParametersType dihedralParams,
                             float growUntil, long seed = 42424242) :
-        Interaction(state, name, 1.0f),
+        InteractionMembraneImplBase(state, name, 1.0f),
         parameters(parameters),
         scaleFromTime( [growUntil] (float t) { return min(1.0f, 0.5f + 0.5f * (t / growUntil)); } ),
         dihedralParams(dihedralParams),
@@ -99,28 +103,213 @@ public:
         MembraneMeshView meshView(mesh);
 
         const int nthreads = 128;
-        const int nblocks  = getNblocks(view.size, nthreads);
 
         auto devParams = setParams(currentParams, stepGen, state);
 
         DihedralInteraction dihedralInteraction(dihedralParams, scale);
         TriangleInteraction triangleInteraction(triangleParams, mesh, scale);
 
-        SAFE_KERNEL_LAUNCH(MembraneForcesKernels::computeMembraneForces,
-                           nblocks, nthreads, 0, stream,
+        const size_t sharedBytes = MembraneForcesKernels::SharedMembrane::bytesPerVertex * meshView.nvertices;
+
+        if (usePerObjectKernel(view.nObjects, sharedBytes))
+        {
+            SAFE_KERNEL_LAUNCH(MembraneForcesKernels::computeMembraneForcesPerObject,
+                               view.nObjects, nthreads, sharedBytes, stream,
+                               triangleInteraction,
+                               dihedralInteraction, dihedralView,
+                               view, meshView, devParams);
+        }
+        else
+        {
+            const int nblocks = getNblocks(view.size, nthreads);
+
+            SAFE_KERNEL_LAUNCH(MembraneForcesKernels::computeMembraneForces,
+                               nblocks, nthreads, 0, stream,
+                               triangleInteraction,
+                               dihedralInteraction, dihedralView,
+                               view, meshView, devParams);
+        }
+
+    }
+
+    void halo(ParticleVector *pv1, ParticleVector *pv2, CellList *cl1, CellList *cl2, cudaStream_t stream) {}
+
+    void computeBatch(const std::vector<ImplEntry>& entries, cudaStream_t stream) override
+    {
+        using BatchEntry = MembraneForcesKernels::MembraneBatchEntry<TriangleInteraction, DihedralInteraction>;
+
+        std::vector<BatchEntry> batch;
+        int nVertices = 0;
+
+        for (auto& e : entries)
+        {
+            auto impl = static_cast<InteractionMembraneImpl*>(e.impl);
+            auto ov = dynamic_cast<MembraneVector *>(e.pv);
+
+            if (ov->objSize != ov->mesh->getNvertices())
+                die("Object size of '%s' (%d) and number of vertices (%d) mismatch",
+                    ov->name.c_str(), ov->objSize, ov->mesh->getNvertices());
+
+            if (ov->local()->nObjects == 0) continue;
+
+            batch.push_back(impl->makeBatchEntry(ov, nVertices));
+            nVertices += ov->local()->nObjects * ov->mesh->getNvertices();
+        }
+
+        if (batch.empty()) return;
+
+        batchEntries.resize_anew(batch.size() * sizeof(BatchEntry));
+        memcpy(batchEntries.hostPtr(), batch.data(), batch.size() * sizeof(BatchEntry));
+        batchEntries.uploadToDevice(stream);
+
+        const int nthreads = 128;
+
+        SAFE_KERNEL_LAUNCH(MembraneForcesKernels::computeMembraneForcesBatched,
+                           getNblocks(nVertices, nthreads), nthreads, 0, stream,
+                           (int) batch.size(), nVertices, (const BatchEntry*) batchEntries.devPtr());
+    }
+
+    bool advancePerObject(ParticleVector *pv1, int substeps, float dt, cudaStream_t stream) override
+    {
+        // e.g. the mean curvatures of the Juelicher bending would have to be recomputed at every sub-step
+        constexpr bool positionsOnly = std::is_same<typename DihedralInteraction::ViewType, OVview>::value;
+        if (!positionsOnly) return false;
+
+        auto ov = dynamic_cast<MembraneVector *>(pv1);
+
+        if (ov->objSize != ov->mesh->getNvertices())
+            die("Object size of '%s' (%d) and number of vertices (%d) mismatch",
+                ov->name.c_str(), ov->objSize, ov->mesh->getNvertices());
+
+        const size_t sharedBytes = MembraneForcesKernels::bytesPerVertexSubsteps * ov->mesh->getNvertices();
+        auto kernel = MembraneForcesKernels::advanceMembranesPerObject<TriangleInteraction, DihedralInteraction>;
+
+        queryDevice();
+        if (sharedBytes > maxSharedBytes) return false;
+
+        if (sharedBytes > substepsSharedBytesSet)
+        {
+            CUDA_Check( cudaFuncSetAttribute(kernel, cudaFuncAttributeMaxDynamicSharedMemorySize, sharedBytes) );
+            substepsSharedBytesSet = sharedBytes;
+        }
+
+        debug("Advancing %d cells of '%s' by %d sub-steps in one launch",
+              ov->local()->nObjects, ov->name.c_str(), substeps);
+
+        // the growth and the random forces are those of the beginning of the time step at every sub-step
+        auto currentParams = parameters;
+        float scale = scaleFromTime(state->currentTime);
+        rescaleParameters(currentParams, scale);
+
+        OVviewWithAreaVolume view(ov, ov->local());
+        typename DihedralInteraction::ViewType dihedralView(ov, ov->local());
+        auto mesh = static_cast<MembraneMesh *>(ov->mesh.get());
+        MembraneMeshView meshView(mesh);
+
+        auto devParams = setParams(currentParams, stepGen, state);
+
+        DihedralInteraction dihedralInteraction(dihedralParams, scale);
+        TriangleInteraction triangleInteraction(triangleParams, mesh, scale);
+
+        const int nthreads = 128;
+
+        SAFE_KERNEL_LAUNCH(MembraneForcesKernels::advanceMembranesPerObject,
+                           view.nObjects, nthreads, sharedBytes, stream,
                            triangleInteraction,
                            dihedralInteraction, dihedralView,
-                           view, meshView, devParams);
+                           view, meshView, devParams, substeps, dt);
 
+        return true;
     }
 
-    void halo(ParticleVector *pv1, ParticleVector *pv2, CellList *cl1, CellList *cl2, cudaStream_t stream) {}
+    /// the per-object kernel reduces the areas and volumes from its shared memory
+    bool computesAreaVolume(ParticleVector *pv1) override
+    {
+        auto ov = dynamic_cast<MembraneVector *>(pv1);
+        const size_t sharedBytes = MembraneForcesKernels::SharedMembrane::bytesPerVertex * ov->mesh->getNvertices();
+        return usePerObjectKernel(ov->local()->nObjects, sharedBytes);
+    }
     
 protected:
 
+    PinnedBuffer<char> batchEntries;
+
+    /// same parameters and views as in local(), for a batched launch
+    MembraneForcesKernels::MembraneBatchEntry<TriangleInteraction, DihedralInteraction>
+    makeBatchEntry(MembraneVector *ov, int startVertex)
+    {
+        auto currentParams = parameters;
+        float scale = scaleFromTime(state->currentTime);
+        rescaleParameters(currentParams, scale);
+
+        auto mesh = static_cast<MembraneMesh *>(ov->mesh.get());
+
+        return { TriangleInteraction(triangleParams, mesh, scale),
+                 DihedralInteraction(dihedralParams, scale),
+                 typename DihedralInteraction::ViewType(ov, ov->local()),
+                 OVviewWithAreaVolume(ov, ov->local()),
+                 MembraneMeshView(mesh),
+                 setParams(currentParams, stepGen, state),
+                 startVertex };
+    }
+
+    int maxSharedBytes{-1}, nMultiprocessors{0};
+    size_t sharedBytesSet{0}, substepsSharedBytesSet{0};
+
+    void queryDevice()
+    {
+        if (maxSharedBytes >= 0) return;
+
+        int device;
+        CUDA_Check( cudaGetDevice(&device) );
+        CUDA_Check( cudaDeviceGetAttribute(&maxSharedBytes,   cudaDevAttrMaxSharedMemoryPerBlockOptin, device) );
+        CUDA_Check( cudaDeviceGetAttribute(&nMultiprocessors, cudaDevAttrMultiProcessorCount,          device) );
+    }
+
+    /**
+     * One block per membrane when the vertices fit in the shared memory of a block,
+     * and there are enough membranes to occupy the whole device
+     */
+    bool usePerObjectKernel(int nObjects, size_t sharedBytes)
+    {
+        queryDevice();
+
+        if (sharedBytes > maxSharedBytes || nObjects < nMultiprocessors)
+            return false;
+
+        // above 48 KB, the kernel has to opt in for more dynamic shared memory
+        if (sharedBytes > sharedBytesSet)
+        {
+            auto kernel = MembraneForcesKernels::computeMembraneForcesPerObject<TriangleInteraction, DihedralInteraction>;
+            CUDA_Check( cudaFuncSetAttribute(kernel, cudaFuncAttributeMaxDynamicSharedMemorySize, sharedBytes) );
+            sharedBytesSet = sharedBytes;
+        }
+
+        return true;
+    }
+
     std::function< float(float) > scaleFromTime;
     CommonMembraneParameters parameters;
     typename DihedralInteraction::ParametersType dihedralParams;
     typename TriangleInteraction::ParametersType triangleParams;
     StepRandomGen stepGen;
 };
+
+/**
+ * Concrete implementation with the triangle model \c TriangleInteraction and the dihedral model \c DihedralInteraction,
+ * the latter and the constraints in the \p precision of the sensitive terms
+ */
+template <class TriangleInteraction, template <typename> class DihedralInteraction>
+static std::unique_ptr<InteractionMembraneImplBase>
+makeMembraneImpl(MembranePrecision precision, const YmrState *state, std::string name, CommonMembraneParameters parameters,
+                 typename TriangleInteraction::ParametersType triangleParams,
+                 typename DihedralInteraction<float>::ParametersType dihedralParams,
+                 float growUntil)
+{
+    if (precision == MembranePrecision::Mixed)
+        return std::make_unique<InteractionMembraneImpl<TriangleInteraction, DihedralInteraction<double>>>
+            (state, name, parameters, triangleParams, dihedralParams, growUntil);
+
+    return std::make_unique<InteractionMembraneImpl<TriangleInteraction, DihedralInteraction<float>>>
+        (state, name, parameters, triangleParams, dihedralParams, growUntil);
+}
@@ -9,19 +9,25 @@
 #include <core/utils/cuda_common.h>
 #include <core/utils/cuda_rng.h>
 
-__D__ inline real triangleArea(real3 v0, real3 v1, real3 v2)
+/// the geometric helpers work in the precision of their arguments, float3 or double3
+template <typename Real3>
+__D__ inline typename ScalarOf<Real3>::type triangleArea(Real3 v0, Real3 v1, Real3 v2)
 {
-    return 0.5_r * length(cross(v1 - v0, v2 - v0));
+    using Real = typename ScalarOf<Real3>::type;
+    return (Real) 0.5 * length(cross(v1 - v0, v2 - v0));
 }
 
-__D__ inline real triangleSignedVolume(real3 v0, real3 v1, real3 v2)
+template <typename Real3>
+__D__ inline typename ScalarOf<Real3>::type triangleSignedVolume(Real3 v0, Real3 v1, Real3 v2)
 {
-    return 0.1666666667_r *
+    using Real = typename ScalarOf<Real3>::type;
+    return (Real) (1.0 / 6.0) *
         (- v0.z*v1.y*v2.x + v0.z*v1.x*v2.y + v0.y*v1.z*v2.x
          - v0.x*v1.z*v2.y - v0.y*v1.x*v2.z + v0.x*v1.y*v2.z);
 }
 
-__D__ inline real supplementaryDihedralAngle(real3 v0, real3 v1, real3 v2, real3 v3)
+template <typename Real3>
+__D__ inline typename ScalarOf<Real3>::type supplementaryDihedralAngle(Real3 v0, Real3 v1, Real3 v2, Real3 v3)
 {
     //       v3
     //     /   \
@@ -32,12 +38,14 @@ __D__ inline real supplementaryDihedralAngle(real3 v0, real3 v1, real3 v2, real3
 
     // dihedral: 0123    
 
-    real3 n, k, nk;
+    using Real = typename ScalarOf<Real3>::type;
+
+    Real3 n, k, nk;
     n  = cross(v1 - v0, v2 - v0);
     k  = cross(v2 - v0, v3 - v0);
     nk = cross(n, k);
 
-    real theta = atan2(length(nk), dot(n, k));
+    Real theta = atan2(length(nk), dot(n, k));
     theta = dot(v2-v0, nk) < 0 ? theta : -theta;
     return theta;
 }
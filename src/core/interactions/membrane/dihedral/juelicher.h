@@ -8,13 +8,18 @@
 
 #include <cmath>
 
-class DihedralJuelicher : public VertexFetcherWithMeanCurvatures
+/// Juelicher bending and ADE, computed in the precision \c Real
+template <typename Real>
+class DihedralJuelicher : public VertexFetcherWithMeanCurvatures<Real>
 {
 public:    
 
     using ParametersType = JuelicherBendingParameters;
+    using typename VertexFetcherWithMeanCurvatures<Real>::Real3;
+    using typename VertexFetcherWithMeanCurvatures<Real>::VertexType;
+    using typename VertexFetcherWithMeanCurvatures<Real>::ViewType;
     
-    DihedralJuelicher(ParametersType p, real lscale) :
+    DihedralJuelicher(ParametersType p, float lscale) :
         scurv(0)
     {
         kb     = p.kb         * lscale*lscale;
@@ -29,10 +34,10 @@ public:
         scurv = getScurv(view, rbcId);
     }
     
-    __D__ inline real3 operator()(VertexType v0, VertexType v1, VertexType v2, VertexType v3, real3 &f1) const
+    __D__ inline Real3 operator()(VertexType v0, VertexType v1, VertexType v2, VertexType v3, Real3 &f1) const
     {
-        real3 f0;
-        real theta = supplementaryDihedralAngle(v0.r, v1.r, v2.r, v3.r);
+        Real3 f0;
+        Real theta = supplementaryDihedralAngle(v0.r, v1.r, v2.r, v3.r);
         
         f0  = force_len   (theta, v0,     v2        );
         f0 += force_theta (       v0, v1, v2, v3, f1);
@@ -43,15 +48,15 @@ public:
 
 private:
 
-    __D__ inline real3 force_len(real theta, VertexType v0, VertexType v2) const
+    __D__ inline Real3 force_len(Real theta, VertexType v0, VertexType v2) const
     {
-        real3 d = normalize(v0.r - v2.r);
+        Real3 d = normalize(v0.r - v2.r);
         return - ( kb * (v0.H + v2.H - 2 * H0) + kad_pi * scurv ) * theta * d;
     }
 
-    __D__ inline real3 force_theta(VertexType v0, VertexType v1, VertexType v2, VertexType v3, real3 &f1) const
+    __D__ inline Real3 force_theta(VertexType v0, VertexType v1, VertexType v2, VertexType v3, Real3 &f1) const
     {
-        real3 n, k, v20, v21, v23;
+        Real3 n, k, v20, v21, v23;
 
         v20 = v0.r - v2.r;
         v21 = v1.r - v2.r;
@@ -60,46 +65,46 @@ private:
         n = cross(v21, v20);
         k = cross(v20, v23);
 
-        real inv_lenn = rsqrt(dot(n,n));
-        real inv_lenk = rsqrt(dot(k,k));
+        Real inv_lenn = rsqrt(dot(n,n));
+        Real inv_lenk = rsqrt(dot(k,k));
 
-        real cotangent2n = dot(v20, v21) * inv_lenn;
-        real cotangent2k = dot(v23, v20) * inv_lenk;
+        Real cotangent2n = dot(v20, v21) * inv_lenn;
+        Real cotangent2k = dot(v23, v20) * inv_lenk;
     
-        real3 d1 = (dot(v20, v20)  * inv_lenn*inv_lenn) * n;
-        real3 d0 =
+        Real3 d1 = (dot(v20, v20)  * inv_lenn*inv_lenn) * n;
+        Real3 d0 =
             (-cotangent2n * inv_lenn) * n +
             (-cotangent2k * inv_lenk) * k;
 
-        real coef = kb * (v0.H + v2.H - 2*H0)  +  kad_pi * scurv;
+        Real coef = kb * (v0.H + v2.H - 2*H0)  +  kad_pi * scurv;
 
         f1 = -coef * d1;
         return -coef * d0;
     }
 
-    __D__ inline real3 force_area(VertexType v0, VertexType v1, VertexType v2) const
+    __D__ inline Real3 force_area(VertexType v0, VertexType v1, VertexType v2) const
     {
-        real coef =
-            0.6666667_r * kb     * (v0.H * v0.H + v1.H * v1.H + v2.H * v2.H - 3 * H0 * H0)
-            + 0.5_r     * kad_pi * scurv * scurv;
+        Real coef =
+            (Real) (2.0 / 3.0) * kb     * (v0.H * v0.H + v1.H * v1.H + v2.H * v2.H - 3 * H0 * H0)
+            + (Real) 0.5       * kad_pi * scurv * scurv;
 
-        real3 n  = normalize(cross(v1.r-v0.r, v2.r-v0.r));
-        real3 d0 = 0.5_r * cross(n, v2.r - v1.r);
+        Real3 n  = normalize(cross(v1.r-v0.r, v2.r-v0.r));
+        Real3 d0 = (Real) 0.5 * cross(n, v2.r - v1.r);
 
         return coef * d0;
     }
 
-    __D__ inline real getScurv(const ViewType& view, int rbcId) const
+    __D__ inline Real getScurv(const ViewType& view, int rbcId) const
     {
-        real totArea     = view.area_volumes[rbcId].x;
-        real totLenTheta = view.lenThetaTot [rbcId];
+        Real totArea     = view.area_volumes[rbcId].x;
+        Real totLenTheta = view.lenThetaTot [rbcId];
 
-        return (0.5_r * totLenTheta - DA0) / totArea;
+        return ((Real) 0.5 * totLenTheta - DA0) / totArea;
     }
 
     
 private:    
     
-    real kb, H0, kad_pi, DA0;
-    real scurv;
+    Real kb, H0, kad_pi, DA0;
+    Real scurv;
 };
@@ -8,15 +8,20 @@
 
 #include <cmath>
 
-class DihedralKantor : public VertexFetcher
+/// Kantor bending, computed in the precision \c Real
+template <typename Real>
+class DihedralKantor : public VertexFetcher<Real>
 {
 public:    
 
     using ParametersType = KantorBendingParameters;
+    using typename VertexFetcher<Real>::Real3;
+    using typename VertexFetcher<Real>::VertexType;
+    using typename VertexFetcher<Real>::ViewType;
     
-    DihedralKantor(ParametersType p, real lscale)        
+    DihedralKantor(ParametersType p, float lscale)        
     {
-        real theta0 = p.theta / 180.0 * M_PI;
+        Real theta0 = p.theta / 180.0 * M_PI;
         
         cost0kb = cos(theta0) * p.kb * lscale * lscale;
         sint0kb = sin(theta0) * p.kb * lscale * lscale;
@@ -25,36 +30,36 @@ public:
     __D__ inline void computeCommon(const ViewType& view, int rbcId)
     {}
     
-    __D__ inline real3 operator()(VertexType v0, VertexType v1, VertexType v2, VertexType v3, real3 &f1) const
+    __D__ inline Real3 operator()(VertexType v0, VertexType v1, VertexType v2, VertexType v3, Real3 &f1) const
     {
         return kantor(v1, v0, v2, v3, f1);
     }
     
 private:
 
-    __D__ inline real3 kantor(VertexType v1, VertexType v2, VertexType v3, VertexType v4, real3 &f1) const
+    __D__ inline Real3 kantor(VertexType v1, VertexType v2, VertexType v3, VertexType v4, Real3 &f1) const
     {
-        real3 ksi   = cross(v1 - v2, v1 - v3);
-        real3 dzeta = cross(v3 - v4, v2 - v4);
+        Real3 ksi   = cross(v1 - v2, v1 - v3);
+        Real3 dzeta = cross(v3 - v4, v2 - v4);
 
-        real overIksiI   = rsqrtf(dot(ksi, ksi));
-        real overIdzetaI = rsqrtf(dot(dzeta, dzeta));
+        Real overIksiI   = rsqrt(dot(ksi, ksi));
+        Real overIdzetaI = rsqrt(dot(dzeta, dzeta));
 
-        real cosTheta = dot(ksi, dzeta) * overIksiI * overIdzetaI;
-        real IsinThetaI2 = 1.0f - cosTheta*cosTheta;
+        Real cosTheta = dot(ksi, dzeta) * overIksiI * overIdzetaI;
+        Real IsinThetaI2 = (Real) 1.0 - cosTheta*cosTheta;
 
-        real rawST_1 = rsqrtf(max(IsinThetaI2, 1.0e-6f));
-        real sinTheta_1 = copysignf( rawST_1, dot(ksi - dzeta, v4 - v1) ); // because the normals look inside
-        real beta = cost0kb - cosTheta * sint0kb * sinTheta_1;
+        Real rawST_1 = rsqrt(max(IsinThetaI2, (Real) 1.0e-6));
+        Real sinTheta_1 = copysign( rawST_1, dot(ksi - dzeta, v4 - v1) ); // because the normals look inside
+        Real beta = cost0kb - cosTheta * sint0kb * sinTheta_1;
 
-        real b11 = -beta * cosTheta *  overIksiI   * overIksiI;
-        real b12 =  beta *             overIksiI   * overIdzetaI;
-        real b22 = -beta * cosTheta *  overIdzetaI * overIdzetaI;
+        Real b11 = -beta * cosTheta *  overIksiI   * overIksiI;
+        Real b12 =  beta *             overIksiI   * overIdzetaI;
+        Real b22 = -beta * cosTheta *  overIdzetaI * overIdzetaI;
 
         f1 = cross(ksi, v3 - v2)*b11 + cross(dzeta, v3 - v2)*b12;
         
         return cross(ksi, v1 - v3)*b11 + ( cross(ksi, v3 - v4) + cross(dzeta, v1 - v3) )*b12 + cross(dzeta, v3 - v4)*b22;
     }
 
-    real cost0kb, sint0kb;
+    Real cost0kb, sint0kb;
 };
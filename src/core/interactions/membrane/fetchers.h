@@ -3,27 +3,40 @@
 #include "real.h"
 #include <core/utils/cpu_gpu_defines.h>
 
+/// Vertices of the dihedral interactions, in the precision \c Real
+template <typename Real>
 class VertexFetcher
 {
 public:
-    using VertexType = real3;
+    using RealType   = Real;
+    using Real3      = typename SensitiveReal<Real>::Vec3;
+    using VertexType = Real3;
     using ViewType   = OVview;
 
     __D__ inline VertexType fetchVertex(const ViewType& view, int i) const
     {
         // 2 because of float4
-        return make_real3(Float3_int(view.particles[2 * i]).v);
+        return SensitiveReal<Real>::make3(Float3_int(view.particles[2 * i]).v);
+    }
+
+    /// same as above with the position \p r already known, e.g. from shared memory
+    __D__ inline VertexType fetchVertex(const ViewType& view, int i, real3 r) const
+    {
+        return SensitiveReal<Real>::make3(r);
     }
 };
 
-class VertexFetcherWithMeanCurvatures : public VertexFetcher
+template <typename Real>
+class VertexFetcherWithMeanCurvatures : public VertexFetcher<Real>
 {
 public:
 
+    using Real3 = typename VertexFetcher<Real>::Real3;
+
     struct VertexWithMeanCurvature
     {
-        real3 r;
-        real H;
+        Real3 r;
+        Real H;
     };
     
     using VertexType = VertexWithMeanCurvature;
@@ -31,7 +44,12 @@ public:
 
     __D__ inline VertexType fetchVertex(const ViewType& view, int i) const
     {
-        return {make_real3(Float3_int(view.particles[2 * i]).v),
-                real(view.vertexMeanCurvatures[i])};
+        return {SensitiveReal<Real>::make3(Float3_int(view.particles[2 * i]).v),
+                Real(view.vertexMeanCurvatures[i])};
+    }
+
+    __D__ inline VertexType fetchVertex(const ViewType& view, int i, real3 r) const
+    {
+        return {SensitiveReal<Real>::make3(r), Real(view.vertexMeanCurvatures[i])};
     }
 };
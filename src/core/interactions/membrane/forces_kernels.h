@@ -15,30 +15,54 @@ struct GPU_CommonMembraneParameters
     real seed, sigma_rnd;
 };
 
-__device__ inline real3 _fconstrainArea(real3 v1, real3 v2, real3 v3, real totArea,
+/// the constraints are computed in the precision of the vertices, float3 or double3
+template <typename Real3>
+__device__ inline Real3 _fconstrainArea(Real3 v1, Real3 v2, Real3 v3, typename ScalarOf<Real3>::type totArea,
                                         const GPU_CommonMembraneParameters& parameters)
 {
-    real3 x21 = v2 - v1;
-    real3 x32 = v3 - v2;
-    real3 x31 = v3 - v1;
+    using Real = typename ScalarOf<Real3>::type;
+
+    Real3 x21 = v2 - v1;
+    Real3 x32 = v3 - v2;
+    Real3 x31 = v3 - v1;
 
-    real3 normal = cross(x21, x31);
+    Real3 normal = cross(x21, x31);
 
-    real area = 0.5_r * length(normal);
-    real area_1 = 1.0_r / area;
+    Real area = (Real) 0.5 * length(normal);
+    Real area_1 = (Real) 1.0 / area;
 
-    real coef = -0.25_r * parameters.ka0 * (totArea - parameters.totArea0) * area_1;
+    Real coef = (Real) -0.25 * parameters.ka0 * (totArea - parameters.totArea0) * area_1;
 
     return coef * cross(normal, x32);
 }
 
-__device__ inline real3 _fconstrainVolume(real3 v1, real3 v2, real3 v3, real totVolume,
+template <typename Real3>
+__device__ inline Real3 _fconstrainVolume(Real3 v1, Real3 v2, Real3 v3, typename ScalarOf<Real3>::type totVolume,
                                           const GPU_CommonMembraneParameters& parameters)
 {
-    real coeff = parameters.kv0 * (totVolume - parameters.totVolume0);
+    using Real = typename ScalarOf<Real3>::type;
+
+    Real coeff = parameters.kv0 * (totVolume - parameters.totVolume0);
     return coeff * cross(v3, v2);
 }
 
+/// area and volume constraints of the triangle (\p r0, \p r1, \p r2), in the precision \c Sensitive
+template <class Sensitive>
+__device__ inline typename Sensitive::Vec3 _fconstraints(real3 r0, real3 r1, real3 r2, real totArea, real totVolume,
+                                                         const GPU_CommonMembraneParameters& parameters)
+{
+    const auto v0 = Sensitive::make3(r0);
+    const auto v1 = Sensitive::make3(r1);
+    const auto v2 = Sensitive::make3(r2);
+
+    return _fconstrainArea  (v0, v1, v2, (typename Sensitive::Scalar) totArea,   parameters)
+        +  _fconstrainVolume(v0, v1, v2, (typename Sensitive::Scalar) totVolume, parameters);
+}
+
+/// precision of the sensitive terms, the same as the dihedral interaction
+template <class DihedralInteraction>
+using SensitiveOf = SensitiveReal<typename DihedralInteraction::RealType>;
+
 
 __device__ inline real3 _fvisc(ParticleReal p1, ParticleReal p2,
                                const GPU_CommonMembraneParameters& parameters)
@@ -64,7 +88,7 @@ __device__ inline real3 _ffluct(real3 v1, real3 v2, int i1, int i2,
     return (mean0var1 * parameters.sigma_rnd / length(x21)) * x21;
 }
 
-template <class TriangleInteraction>
+template <class Sensitive, class TriangleInteraction>
 __device__ inline real3 bondTriangleForce(
         const TriangleInteraction& triangleInteraction,
         ParticleReal p, int locId, int rbcId,
@@ -73,11 +97,12 @@ __device__ inline real3 bondTriangleForce(
         const GPU_CommonMembraneParameters& parameters)
 {
     real3 f0 = make_real3(0.0_r);
+    auto fc = Sensitive::zero();
     const int startId = mesh.maxDegree * locId;
-    const int degree = mesh.degrees[locId];
+    const int degree = mesh.getDegree(locId);
 
     int idv0 = rbcId * mesh.nvertices + locId;
-    int idv1 = rbcId * mesh.nvertices + mesh.adjacent[startId];
+    int idv1 = rbcId * mesh.nvertices + mesh.getAdjacent(startId);
     auto p1 = fetchParticle(view, idv1);
 
     real totArea   = view.area_volumes[rbcId].x;
@@ -89,23 +114,23 @@ __device__ inline real3 bondTriangleForce(
         int i1 = startId + i;
         int i2 = startId + ((i+1) % degree);
         
-        int idv2 = rbcId * mesh.nvertices + mesh.adjacent[i2];
+        int idv2 = rbcId * mesh.nvertices + mesh.getAdjacent(i2);
 
         auto p2 = fetchParticle(view, idv2);
 
         auto eq = triangleInteraction.getEquilibriumDesc(mesh, i1, i2);
         
         f0 += triangleInteraction (p.r, p1.r, p2.r, eq)
-            + _fconstrainArea     (p.r, p1.r, p2.r, totArea,   parameters)
-            + _fconstrainVolume   (p.r, p1.r, p2.r, totVolume, parameters)
             + _fvisc              (p,   p1,                    parameters)
             + _ffluct             (p.r, p1.r, idv0, idv1,      parameters);
 
+        fc += _fconstraints<Sensitive>(p.r, p1.r, p2.r, totArea, totVolume, parameters);
+
         idv1 = idv2;
         p1   = p2;
     }
 
-    return f0;
+    return f0 + make_real3(fc);
 }
 
 template <class DihedralInteraction>
@@ -117,11 +142,11 @@ __device__ inline real3 dihedralForce(int locId, int rbcId,
     const int offset = rbcId * mesh.nvertices;
 
     const int startId = mesh.maxDegree * locId;
-    const int degree = mesh.degrees[locId];
+    const int degree = mesh.getDegree(locId);
 
     int idv0 = offset + locId;
-    int idv1 = offset + mesh.adjacent[startId];
-    int idv2 = offset + mesh.adjacent[startId+1];
+    int idv1 = offset + mesh.getAdjacent(startId);
+    int idv2 = offset + mesh.getAdjacent(startId+1);
 
     auto v0 = dihedralInteraction.fetchVertex(view, idv0);
     auto v1 = dihedralInteraction.fetchVertex(view, idv1);
@@ -134,15 +159,16 @@ __device__ inline real3 dihedralForce(int locId, int rbcId,
     //       V
     //       v1
 
-    real3 f0 = make_real3(0.0_r);
+    using Sensitive = SensitiveOf<DihedralInteraction>;
+    auto f0 = Sensitive::zero();
 
     dihedralInteraction.computeCommon(view, rbcId);
 
 #pragma unroll 2
     for (int i = 0; i < degree; i++)
     {
-        real3 f1 = make_real3(0.0_r);
-        int idv3 = offset + mesh.adjacent[startId + (i+2) % degree];
+        auto f1 = Sensitive::zero();
+        int idv3 = offset + mesh.getAdjacent(startId + (i+2) % degree);
 
         auto v3 = dihedralInteraction.fetchVertex(view, idv3);
 
@@ -153,7 +179,29 @@ __device__ inline real3 dihedralForce(int locId, int rbcId,
         v1   = v2  ; v2   = v3  ;
         idv1 = idv2; idv2 = idv3;
     }
-    return f0;
+    return make_real3(f0);
+}
+
+/// Total force on the vertex \p pid, one thread per vertex
+template <class TriangleInteraction, class DihedralInteraction>
+__device__ inline void vertexForce(int pid,
+                                   const TriangleInteraction& triangleInteraction,
+                                   DihedralInteraction& dihedralInteraction,
+                                   const typename DihedralInteraction::ViewType& dihedralView,
+                                   const OVviewWithAreaVolume& view,
+                                   const MembraneMeshView& mesh,
+                                   const GPU_CommonMembraneParameters& parameters)
+{
+    const int locId = pid % mesh.nvertices;
+    const int rbcId = pid / mesh.nvertices;
+
+    auto p = fetchParticle(view, pid);
+
+    real3 f;
+    f  = bondTriangleForce<SensitiveOf<DihedralInteraction>>(triangleInteraction, p, locId, rbcId, view, mesh, parameters);
+    f += dihedralForce(locId, rbcId, dihedralView, dihedralInteraction, mesh);
+
+    atomicAdd(view.forces + pid, make_float3(f));
 }
 
 template <class TriangleInteraction, class DihedralInteraction>
@@ -168,18 +216,363 @@ __global__ void computeMembraneForces(TriangleInteraction triangleInteraction,
     assert(view.objSize == mesh.nvertices);
 
     const int pid = threadIdx.x + blockDim.x * blockIdx.x;
-    const int locId = pid % mesh.nvertices;
-    const int rbcId = pid / mesh.nvertices;
-
     if (pid >= view.nObjects * mesh.nvertices) return;
 
-    auto p = fetchParticle(view, pid);
+    vertexForce(pid, triangleInteraction, dihedralInteraction, dihedralView, view, mesh, parameters);
+}
 
-    real3 f;
-    f  = bondTriangleForce(triangleInteraction, p, locId, rbcId, view, mesh, parameters);
-    f += dihedralForce(locId, rbcId, dihedralView, dihedralInteraction, mesh);
+//=================================================================================================================
+// Several membrane vectors with the same models in one launch
+//=================================================================================================================
 
-    atomicAdd(view.forces + pid, make_float3(f));
+/// Everything computeMembraneForces() needs for one membrane vector
+template <class TriangleInteraction, class DihedralInteraction>
+struct MembraneBatchEntry
+{
+    TriangleInteraction triangleInteraction;
+    DihedralInteraction dihedralInteraction;
+    typename DihedralInteraction::ViewType dihedralView;
+    OVviewWithAreaVolume view;
+    MembraneMeshView mesh;
+    GPU_CommonMembraneParameters parameters;
+
+    int startVertex;  ///< first thread of the grid working on this membrane vector
+};
+
+/**
+ * Same as computeMembraneForces(), for the vertices of all the \p entries.
+ * Batches hold few entries, a linear search is enough
+ */
+template <class TriangleInteraction, class DihedralInteraction>
+__global__ void computeMembraneForcesBatched(int nEntries, int nVertices,
+                                             const MembraneBatchEntry<TriangleInteraction, DihedralInteraction> *entries)
+{
+    const int gid = threadIdx.x + blockDim.x * blockIdx.x;
+    if (gid >= nVertices) return;
+
+    int e = 0;
+    while (e+1 < nEntries && gid >= entries[e+1].startVertex)
+        e++;
+
+    const auto& entry = entries[e];
+    auto dihedralInteraction = entry.dihedralInteraction;
+
+    vertexForce(gid - entry.startVertex,
+                entry.triangleInteraction, dihedralInteraction, entry.dihedralView,
+                entry.view, entry.mesh, entry.parameters);
+}
+
+//=================================================================================================================
+// One block per membrane, all the vertices in shared memory
+//=================================================================================================================
+
+/// Vertices of the membrane owned by the block, see computeMembraneForcesPerObject()
+struct SharedMembrane
+{
+    real3  *r, *u;
+    float3 *f;    ///< forces accumulated by the block
+
+    static constexpr int bytesPerVertex = 2 * sizeof(real3) + sizeof(float3);
+};
+
+/// Same as bondTriangleForce(), the neighbours are read from shared memory
+template <class Sensitive, class TriangleInteraction>
+__device__ inline real3 bondTriangleForceShared(
+        const TriangleInteraction& triangleInteraction,
+        int locId, int offset, real totArea, real totVolume,
+        const SharedMembrane& shared,
+        const MembraneMeshView& mesh,
+        const GPU_CommonMembraneParameters& parameters)
+{
+    real3 f0 = make_real3(0.0_r);
+    auto fc = Sensitive::zero();
+    const int startId = mesh.maxDegree * locId;
+    const int degree = mesh.getDegree(locId);
+
+    const ParticleReal p {shared.r[locId], shared.u[locId]};
+
+    int loc1 = mesh.getAdjacent(startId);
+    ParticleReal p1 {shared.r[loc1], shared.u[loc1]};
+
+#pragma unroll 2
+    for (int i = 0; i < degree; i++)
+    {
+        int i1 = startId + i;
+        int i2 = startId + ((i+1) % degree);
+
+        const int loc2 = mesh.getAdjacent(i2);
+        const ParticleReal p2 {shared.r[loc2], shared.u[loc2]};
+
+        auto eq = triangleInteraction.getEquilibriumDesc(mesh, i1, i2);
+
+        f0 += triangleInteraction (p.r, p1.r, p2.r, eq)
+            + _fvisc              (p,   p1,                    parameters)
+            + _ffluct             (p.r, p1.r, offset + locId, offset + loc1, parameters);
+
+        fc += _fconstraints<Sensitive>(p.r, p1.r, p2.r, totArea, totVolume, parameters);
+
+        loc1 = loc2;
+        p1   = p2;
+    }
+
+    return f0 + make_real3(fc);
+}
+
+/// Same as dihedralForce(), the forces on the neighbours go to shared memory
+template <class DihedralInteraction>
+__device__ inline real3 dihedralForceShared(int locId, int offset,
+                                             const typename DihedralInteraction::ViewType& view,
+                                             const DihedralInteraction& dihedralInteraction,
+                                             const SharedMembrane& shared,
+                                             const MembraneMeshView& mesh)
+{
+    const int startId = mesh.maxDegree * locId;
+    const int degree = mesh.getDegree(locId);
+
+    int loc1 = mesh.getAdjacent(startId);
+    int loc2 = mesh.getAdjacent(startId+1);
+
+    auto v0 = dihedralInteraction.fetchVertex(view, offset + locId, shared.r[locId]);
+    auto v1 = dihedralInteraction.fetchVertex(view, offset + loc1,  shared.r[loc1]);
+    auto v2 = dihedralInteraction.fetchVertex(view, offset + loc2,  shared.r[loc2]);
+
+    using Sensitive = SensitiveOf<DihedralInteraction>;
+    auto f0 = Sensitive::zero();
+
+#pragma unroll 2
+    for (int i = 0; i < degree; i++)
+    {
+        auto f1 = Sensitive::zero();
+        const int loc3 = mesh.getAdjacent(startId + (i+2) % degree);
+
+        auto v3 = dihedralInteraction.fetchVertex(view, offset + loc3, shared.r[loc3]);
+
+        f0 += dihedralInteraction(v0, v1, v2, v3, f1);
+
+        atomicAdd(shared.f + loc1, make_float3(f1));
+
+        v1   = v2  ; v2   = v3  ;
+        loc1 = loc2; loc2 = loc3;
+    }
+    return make_real3(f0);
+}
+
+/// Load the vertices of the membrane starting at \p offset to shared memory and clear their forces
+__device__ inline void loadSharedMembrane(const OVviewWithAreaVolume& view, int offset, int nv, const SharedMembrane& shared)
+{
+    for (int i = threadIdx.x; i < nv; i += blockDim.x)
+    {
+        auto p = fetchParticle(view, offset + i);
+        shared.r[i] = p.r;
+        shared.u[i] = p.u;
+        shared.f[i] = make_float3(0.0f);
+    }
+}
+
+/**
+ * Area and volume of the membrane in shared memory, reduced in the shared \p areaVolume.
+ * Every thread sums its triangles in the precision \c Sensitive.
+ * All the threads of the block must call it, and get the result after its final barrier
+ */
+template <class Sensitive>
+__device__ inline float2 sharedAreaVolume(const SharedMembrane& shared, const MembraneMeshView& mesh, float2& areaVolume)
+{
+    if (threadIdx.x == 0)
+        areaVolume = make_float2(0.0f);
+
+    __syncthreads();
+
+    typename Sensitive::Scalar area = 0, volume = 0;
+    for (int i = threadIdx.x; i < mesh.ntriangles; i += blockDim.x)
+    {
+        const int3 ids = mesh.getTriangle(i);
+        const auto v0 = Sensitive::make3(shared.r[ids.x]);
+        const auto v1 = Sensitive::make3(shared.r[ids.y]);
+        const auto v2 = Sensitive::make3(shared.r[ids.z]);
+
+        area   += triangleArea(v0, v1, v2);
+        volume += triangleSignedVolume(v0, v1, v2);
+    }
+
+    float2 a_v = make_float2(area, volume);
+    a_v = warpReduce( a_v, [] (float a, float b) { return a+b; } );
+
+    if (__laneid() == 0)
+        atomicAdd(&areaVolume, a_v);
+
+    __syncthreads();
+
+    return areaVolume;
+}
+
+/// Add the membrane forces of all the vertices in shared memory to shared.f
+template <class TriangleInteraction, class DihedralInteraction>
+__device__ inline void sharedMembraneForces(const TriangleInteraction& triangleInteraction,
+                                            const DihedralInteraction& dihedralInteraction,
+                                            const typename DihedralInteraction::ViewType& dihedralView,
+                                            int offset, float2 areaVolume,
+                                            const SharedMembrane& shared,
+                                            const MembraneMeshView& mesh,
+                                            const GPU_CommonMembraneParameters& parameters)
+{
+    for (int locId = threadIdx.x; locId < mesh.nvertices; locId += blockDim.x)
+    {
+        real3 f;
+        f  = bondTriangleForceShared<SensitiveOf<DihedralInteraction>>(triangleInteraction, locId, offset, areaVolume.x, areaVolume.y,
+                                                                        shared, mesh, parameters);
+        f += dihedralForceShared(locId, offset, dihedralView, dihedralInteraction, shared, mesh);
+
+        atomicAdd(shared.f + locId, make_float3(f));
+    }
+}
+
+/**
+ * Same forces as computeMembraneForces(), one block per membrane.
+ * Positions and velocities of the membrane are loaded once in shared memory,
+ * the contributions are summed there with shared atomics,
+ * and every vertex force is added to the global memory once at the end.
+ * The areas and volumes of the cells are also computed here, from the shared vertices.
+ *
+ * Requires SharedMembrane::bytesPerVertex * mesh.nvertices bytes of dynamic shared memory
+ */
+template <class TriangleInteraction, class DihedralInteraction>
+__global__ void computeMembraneForcesPerObject(TriangleInteraction triangleInteraction,
+                                               DihedralInteraction dihedralInteraction,
+                                               typename DihedralInteraction::ViewType dihedralView,
+                                               OVviewWithAreaVolume view,
+                                               MembraneMeshView mesh,
+                                               GPU_CommonMembraneParameters parameters)
+{
+    extern __shared__ char membraneMemory[];
+
+    const int rbcId = blockIdx.x;
+    const int nv = mesh.nvertices;
+    const int offset = rbcId * nv;
+
+    if (rbcId >= view.nObjects) return;
+
+    SharedMembrane shared;
+    shared.r = reinterpret_cast<real3*>(membraneMemory);
+    shared.u = shared.r + nv;
+    shared.f = reinterpret_cast<float3*>(shared.u + nv);
+
+    loadSharedMembrane(view, offset, nv, shared);
+
+    // Area and volume of the cell, replaces the separate reduction before the forces
+    __shared__ float2 areaVolume;
+    const float2 a_v = sharedAreaVolume<SensitiveOf<DihedralInteraction>>(shared, mesh, areaVolume);
+
+    // the dihedral interaction may read them from the global memory
+    if (threadIdx.x == 0)
+        view.area_volumes[rbcId] = a_v;
+
+    __syncthreads();
+
+    dihedralInteraction.computeCommon(dihedralView, rbcId);
+
+    sharedMembraneForces(triangleInteraction, dihedralInteraction, dihedralView, offset, a_v, shared, mesh, parameters);
+
+    __syncthreads();
+
+    // Other tasks (e.g. halo forces) may add to the same vertices concurrently
+    for (int i = threadIdx.x; i < nv; i += blockDim.x)
+        atomicAdd(view.forces + offset + i, shared.f[i]);
+}
+
+//=================================================================================================================
+// All the sub-steps of a time step in one launch, one block per membrane
+//=================================================================================================================
+
+/// bytes of dynamic shared memory per vertex of advanceMembranesPerObject(): the shared membrane and the slow force
+constexpr int bytesPerVertexSubsteps = SharedMembrane::bytesPerVertex + sizeof(float3);
+
+/**
+ * Advance every membrane by \p substeps velocity-Verlet sub-steps of \p dt under its own membrane forces,
+ * the slow forces already in view.forces kept constant, as IntegratorSubStepMembrane does
+ * with one force and one integration launch per sub-step.
+ *
+ * The block keeps its membrane in shared memory during all the sub-steps and writes it back once:
+ * the new coordinates and velocities, the slow plus the last membrane forces, areas and volumes.
+ * The dihedral interaction must only need the positions of the vertices, no other per-vertex quantity
+ * would be up to date after the first sub-step.
+ *
+ * Requires bytesPerVertexSubsteps * mesh.nvertices bytes of dynamic shared memory
+ */
+template <class TriangleInteraction, class DihedralInteraction>
+__global__ void advanceMembranesPerObject(TriangleInteraction triangleInteraction,
+                                          DihedralInteraction dihedralInteraction,
+                                          typename DihedralInteraction::ViewType dihedralView,
+                                          OVviewWithAreaVolume view,
+                                          MembraneMeshView mesh,
+                                          GPU_CommonMembraneParameters parameters,
+                                          int substeps, float dt)
+{
+    extern __shared__ char membraneMemory[];
+
+    const int rbcId = blockIdx.x;
+    const int nv = mesh.nvertices;
+    const int offset = rbcId * nv;
+
+    if (rbcId >= view.nObjects) return;
+
+    SharedMembrane shared;
+    shared.r = reinterpret_cast<real3*>(membraneMemory);
+    shared.u = shared.r + nv;
+    shared.f = reinterpret_cast<float3*>(shared.u + nv);
+    float3 *slowForces = shared.f + nv;
+
+    loadSharedMembrane(view, offset, nv, shared);
+
+    for (int i = threadIdx.x; i < nv; i += blockDim.x)
+        slowForces[i] = make_float3(view.forces[offset + i]);
+
+    __shared__ float2 areaVolume;
+    float2 a_v;
+
+    dihedralInteraction.computeCommon(dihedralView, rbcId);
+
+    for (int substep = 0; substep < substeps; substep++)
+    {
+        a_v = sharedAreaVolume<SensitiveOf<DihedralInteraction>>(shared, mesh, areaVolume);
+
+        sharedMembraneForces(triangleInteraction, dihedralInteraction, dihedralView, offset, a_v, shared, mesh, parameters);
+
+        __syncthreads();
+
+        const bool last = (substep == substeps - 1);
+
+        // every thread integrates the vertices it has computed
+        for (int i = threadIdx.x; i < nv; i += blockDim.x)
+        {
+            const float3 f = shared.f[i] + slowForces[i];
+            shared.u[i] += make_real3(f * view.invMass * dt);
+            shared.r[i] += shared.u[i] * dt;
+
+            if (!last) shared.f[i] = make_float3(0.0f);
+        }
+
+        __syncthreads();
+    }
+
+    if (threadIdx.x == 0)
+        view.area_volumes[rbcId] = a_v;
+
+    for (int i = threadIdx.x; i < nv; i += blockDim.x)
+    {
+        const int pid = offset + i;
+
+        Float3_int r(view.particles[2*pid + 0]);
+        Float3_int u(view.particles[2*pid + 1]);
+        r.v = make_float3(shared.r[i]);
+        u.v = make_float3(shared.u[i]);
+
+        view.particles[2*pid + 0] = r.toFloat4();
+        view.particles[2*pid + 1] = u.toFloat4();
+
+        Float3_int f(view.forces[pid]);
+        f.v = shared.f[i] + slowForces[i];
+        view.forces[pid] = f.toFloat4();
+    }
 }
 
 } // namespace MembraneInteractionKernels
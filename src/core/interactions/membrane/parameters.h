@@ -36,3 +36,10 @@ struct JuelicherBendingParameters
 {
     float kb, C0, kad, DA0;
 };
+
+/// Precision of the terms of the membrane forces sensitive to round-off: dihedrals, area and volume constraints
+enum class MembranePrecision
+{
+    Single,  ///< everything in single precision
+    Mixed    ///< the sensitive terms in double precision, bonds and triangles in single precision
+};
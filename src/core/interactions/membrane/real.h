@@ -2,20 +2,18 @@
 
 #include <core/datatypes.h>
 
-// #define RBC_FORCES_DOUBLE
-
-#ifdef RBC_FORCES_DOUBLE
-using real  = double;
-using real3 = double3;
-#else
+/**
+ * Precision of the bond, triangle, viscous and random terms of the membrane forces.
+ * The terms sensitive to round-off (dihedrals, area and volume constraints) are computed in the precision
+ * chosen at runtime for every membrane interaction, see MembranePrecision and SensitiveReal
+ */
 using real  = float;
 using real3 = float3;
-#endif // RBC_FORCES_DOUBLE
 
 template<typename T3>
 __D__ inline real3 make_real3(T3 v)
 {
-    return {v.x, v.y, v.z};
+    return {(real) v.x, (real) v.y, (real) v.z};
 }
 
 __D__ constexpr inline real3 make_real3(float a)
@@ -52,3 +50,32 @@ __D__ inline ParticleReal fetchParticle(View view, int i)
     Particle p(view.particles, i);
     return {make_real3(p.r), make_real3(p.u)};
 }
+
+/// 3-vector of the scalar \c Real
+template <typename Real> struct Vec3Of;
+template <> struct Vec3Of<float>  { using type = float3;  };
+template <> struct Vec3Of<double> { using type = double3; };
+
+/// scalar of the 3-vector \c Real3
+template <typename Real3> struct ScalarOf;
+template <> struct ScalarOf<float3>  { using type = float;  };
+template <> struct ScalarOf<double3> { using type = double; };
+
+/// Types of the terms computed in the precision \c Real
+template <typename Real>
+struct SensitiveReal
+{
+    using Scalar = Real;
+    using Vec3   = typename Vec3Of<Real>::type;
+
+    template<typename T3>
+    __D__ static inline Vec3 make3(T3 v)
+    {
+        return {(Real) v.x, (Real) v.y, (Real) v.z};
+    }
+
+    __D__ static inline Vec3 zero()
+    {
+        return {(Real) 0, (Real) 0, (Real) 0};
+    }
+};
@@ -4,43 +4,55 @@
 
 namespace InteractionMembraneJuelicherKernels
 {
-__device__ inline real compute_lenTheta(real3 v0, real3 v1, real3 v2, real3 v3)
+template <typename Real3>
+__device__ inline typename ScalarOf<Real3>::type compute_lenTheta(Real3 v0, Real3 v1, Real3 v2, Real3 v3)
 {
-    real len = length(v2 - v0);
-    real theta = supplementaryDihedralAngle(v0, v1, v2, v3);
+    auto len = length(v2 - v0);
+    auto theta = supplementaryDihedralAngle(v0, v1, v2, v3);
     return len * theta;
 }
 
+/**
+ * One block per membrane, one pass over its vertices: areas and mean curvatures of the vertices,
+ * total area, volume and length weighted dihedral angles of the membrane.
+ * The vertex loops see every triangle three times, in the orientation of the mesh.
+ * The totals are reduced within the block and written once, no clearing or global atomics needed.
+ * Everything is computed in the precision \c Sensitive of the dihedral terms
+ */
+template <class Sensitive>
 __global__ void computeAreasAndCurvatures(OVviewWithJuelicherQuants view, MembraneMeshView mesh)
 {
-    int rbcId = blockIdx.y;
-    int idv0  = blockIdx.x * blockDim.x + threadIdx.x;
-    int offset = rbcId * mesh.nvertices;
+    using Real  = typename Sensitive::Scalar;
+    using Real3 = typename Sensitive::Vec3;
 
-    real lenTheta = 0;
-    
-    if (idv0 < mesh.nvertices)
-    {        
+    const int rbcId = blockIdx.x;
+    const int offset = rbcId * mesh.nvertices;
+
+    Real lenThetaSum = 0, areaSum = 0, volumeSum = 0;
+
+    for (int idv0 = threadIdx.x; idv0 < mesh.nvertices; idv0 += blockDim.x)
+    {
         int startId = mesh.maxDegree * idv0;
-        int degree = mesh.degrees[idv0];
+        int degree = mesh.getDegree(idv0);
         
-        int idv1 = mesh.adjacent[startId];
-        int idv2 = mesh.adjacent[startId+1];
+        int idv1 = mesh.getAdjacent(startId);
+        int idv2 = mesh.getAdjacent(startId+1);
         
-        real3 v0 = fetchPosition(view, offset + idv0);
-        real3 v1 = fetchPosition(view, offset + idv1);
-        real3 v2 = fetchPosition(view, offset + idv2);
+        Real3 v0 = Sensitive::make3(fetchPosition(view, offset + idv0));
+        Real3 v1 = Sensitive::make3(fetchPosition(view, offset + idv1));
+        Real3 v2 = Sensitive::make3(fetchPosition(view, offset + idv2));
         
-        real area = 0;    
+        Real area = 0, lenTheta = 0;
         
 #pragma unroll 2
         for (int i = 0; i < degree; i++) {
             
-            int idv3 = mesh.adjacent[startId + (i+2) % degree];
-            real3 v3 = fetchPosition(view, offset + idv3);
+            int idv3 = mesh.getAdjacent(startId + (i+2) % degree);
+            Real3 v3 = Sensitive::make3(fetchPosition(view, offset + idv3));
             
-            area     += 0.3333333_r * triangleArea(v0, v1, v2);
-            lenTheta += compute_lenTheta(v0, v1, v2, v3);
+            area      += (Real) (1.0 / 3.0) * triangleArea(v0, v1, v2);
+            volumeSum += (Real) (1.0 / 3.0) * triangleSignedVolume(v0, v1, v2);
+            lenTheta  += compute_lenTheta(v0, v1, v2, v3);
             
             v1 = v2;
             v2 = v3;
@@ -48,17 +60,34 @@ __global__ void computeAreasAndCurvatures(OVviewWithJuelicherQuants view, Membra
         
         view.vertexAreas          [offset + idv0] = area;
         view.vertexMeanCurvatures [offset + idv0] = lenTheta / (4 * area);
+
+        areaSum     += area;
+        lenThetaSum += lenTheta;
     }
-    
-    lenTheta = warpReduce( lenTheta, [] (real a, real b) { return a+b; } );
 
+    Real3 sums {lenThetaSum, areaSum, volumeSum};
+    sums = warpReduce( sums, [] (Real a, Real b) { return a+b; } );
+
+    __shared__ Real3 warpSums[32];
     if (__laneid() == 0)
-        atomicAdd(&view.lenThetaTot[rbcId], (float) lenTheta);
+        warpSums[threadIdx.x / warpSize] = sums;
+
+    __syncthreads();
+
+    if (threadIdx.x == 0)
+    {
+        Real3 tot = Sensitive::zero();
+        for (int w = 0; w < (blockDim.x + warpSize - 1) / warpSize; w++)
+            tot += warpSums[w];
+
+        view.lenThetaTot [rbcId] = tot.x;
+        view.area_volumes[rbcId] = make_float2(tot.y, tot.z);
+    }
 }
 } // namespace InteractionMembraneJuelicherKernels
 
-InteractionMembraneJuelicher::InteractionMembraneJuelicher(const YmrState *state, std::string name) :
-    InteractionMembrane(state, name)
+InteractionMembraneJuelicher::InteractionMembraneJuelicher(const YmrState *state, std::string name, MembranePrecision precision) :
+    InteractionMembrane(state, name, precision)
 {}
 
 
@@ -78,26 +107,30 @@ void InteractionMembraneJuelicher::setPrerequisites(ParticleVector *pv1, Particl
 
 void InteractionMembraneJuelicher::precomputeQuantities(ParticleVector *pv1, cudaStream_t stream)
 {
-    InteractionMembrane::precomputeQuantities(pv1, stream);
-    
     auto ov = dynamic_cast<MembraneVector *>(pv1);
 
-    debug("Computing vertex areas and curvatures for %d cells of '%s'",
-          ov->local()->nObjects, ov->name.c_str());
+    if (ov->objSize != ov->mesh->getNvertices())
+        die("Object size of '%s' (%d) and number of vertices (%d) mismatch",
+            ov->name.c_str(), ov->objSize, ov->mesh->getNvertices());
 
-    ov->local()->extraPerObject.getData<float>(ChannelNames::lenThetaTot)->clear(stream);
+    // areas and volumes come with the curvatures, InteractionMembrane::precomputeQuantities() is not needed
+    debug("Computing vertex areas and curvatures, areas and volumes for %d cells of '%s'",
+          ov->local()->nObjects, ov->name.c_str());
 
     OVviewWithJuelicherQuants view(ov, ov->local());
 
     MembraneMeshView mesh(static_cast<MembraneMesh*>(ov->mesh.get()));
 
-    const int nthreads = 128;    
-
-    dim3 threads(nthreads, 1);
-    dim3 blocks(getNblocks(mesh.nvertices, nthreads), view.nObjects);
-        
-    SAFE_KERNEL_LAUNCH(
-        InteractionMembraneJuelicherKernels::computeAreasAndCurvatures,
-        blocks, threads, 0, stream,
-        view, mesh );
+    const int nthreads = 128;
+
+    if (precision == MembranePrecision::Mixed)
+        SAFE_KERNEL_LAUNCH(
+            InteractionMembraneJuelicherKernels::computeAreasAndCurvatures<SensitiveReal<double>>,
+            view.nObjects, nthreads, 0, stream,
+            view, mesh );
+    else
+        SAFE_KERNEL_LAUNCH(
+            InteractionMembraneJuelicherKernels::computeAreasAndCurvatures<SensitiveReal<float>>,
+            view.nObjects, nthreads, 0, stream,
+            view, mesh );
 }
@@ -7,7 +7,7 @@
 class InteractionMembraneJuelicher : public InteractionMembrane
 {
 public:
-    InteractionMembraneJuelicher(const YmrState *state, std::string name);
+    InteractionMembraneJuelicher(const YmrState *state, std::string name, MembranePrecision precision);
     
     ~InteractionMembraneJuelicher();
 
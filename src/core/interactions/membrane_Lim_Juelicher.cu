@@ -4,21 +4,19 @@
 #include "membrane/dihedral/juelicher.h"
 #include "membrane/triangle/lim.h"
 
-#include <core/utils/make_unique.h>
-
 InteractionMembraneLimJuelicher::InteractionMembraneLimJuelicher(const YmrState *state, std::string name,
                                                                  CommonMembraneParameters parameters,
                                                                  LimParameters limParams,
                                                                  JuelicherBendingParameters juelicherParams,
-                                                                 bool stressFree, float growUntil) :
-    InteractionMembraneJuelicher(state, name)
+                                                                 bool stressFree, float growUntil, MembranePrecision precision) :
+    InteractionMembraneJuelicher(state, name, precision)
 {
     if (stressFree)
-        impl = std::make_unique<InteractionMembraneImpl<TriangleLimForce<StressFreeState::Active>, DihedralJuelicher>>
-            (state, name, parameters, limParams, juelicherParams, growUntil);
+        impl = makeMembraneImpl<TriangleLimForce<StressFreeState::Active>, DihedralJuelicher>
+            (precision, state, name, parameters, limParams, juelicherParams, growUntil);
     else
-        impl = std::make_unique<InteractionMembraneImpl<TriangleLimForce<StressFreeState::Inactive>, DihedralJuelicher>>
-            (state, name, parameters, limParams, juelicherParams, growUntil);
+        impl = makeMembraneImpl<TriangleLimForce<StressFreeState::Inactive>, DihedralJuelicher>
+            (precision, state, name, parameters, limParams, juelicherParams, growUntil);
 }
 
 InteractionMembraneLimJuelicher::~InteractionMembraneLimJuelicher() = default;
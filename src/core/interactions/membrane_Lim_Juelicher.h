@@ -12,7 +12,7 @@ public:
                                     CommonMembraneParameters parameters,
                                     LimParameters limParams,
                                     JuelicherBendingParameters juelicherParams,
-                                    bool stressFree, float growUntil);
+                                    bool stressFree, float growUntil, MembranePrecision precision);
     
     ~InteractionMembraneLimJuelicher();
 };
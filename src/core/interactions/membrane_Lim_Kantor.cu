@@ -3,22 +3,19 @@
 #include "membrane/dihedral/kantor.h"
 #include "membrane/triangle/lim.h"
 
-#include <core/utils/make_unique.h>
-
 InteractionMembraneLimKantor::InteractionMembraneLimKantor(const YmrState *state, std::string name,
                                                            CommonMembraneParameters parameters,
                                                            LimParameters limParams,
                                                            KantorBendingParameters kantorParams,
-                                                           bool stressFree, float growUntil) :
-    InteractionMembrane(state, name)
+                                                           bool stressFree, float growUntil, MembranePrecision precision) :
+    InteractionMembrane(state, name, precision)
 {
     if (stressFree)
-        impl = std::make_unique<InteractionMembraneImpl<TriangleLimForce<StressFreeState::Active>, DihedralKantor>>
-            (state, name, parameters, limParams, kantorParams, growUntil);
+        impl = makeMembraneImpl<TriangleLimForce<StressFreeState::Active>, DihedralKantor>
+            (precision, state, name, parameters, limParams, kantorParams, growUntil);
     else
-        impl = std::make_unique<InteractionMembraneImpl<TriangleLimForce<StressFreeState::Inactive>, DihedralKantor>>
-            (state, name, parameters, limParams, kantorParams, growUntil);
-
+        impl = makeMembraneImpl<TriangleLimForce<StressFreeState::Inactive>, DihedralKantor>
+            (precision, state, name, parameters, limParams, kantorParams, growUntil);
 }
 
 InteractionMembraneLimKantor::~InteractionMembraneLimKantor() = default;
@@ -4,21 +4,19 @@
 #include "membrane/dihedral/juelicher.h"
 #include "membrane/triangle/wlc.h"
 
-#include <core/utils/make_unique.h>
-
 InteractionMembraneWLCJuelicher::InteractionMembraneWLCJuelicher(const YmrState *state, std::string name,
                                                                  CommonMembraneParameters parameters,
                                                                  WLCParameters wlcParams,
                                                                  JuelicherBendingParameters juelicherParams,
-                                                                 bool stressFree, float growUntil) :
-    InteractionMembraneJuelicher(state, name)
+                                                                 bool stressFree, float growUntil, MembranePrecision precision) :
+    InteractionMembraneJuelicher(state, name, precision)
 {
     if (stressFree)
-        impl = std::make_unique<InteractionMembraneImpl<TriangleWLCForce<StressFreeState::Active>, DihedralJuelicher>>
-            (state, name, parameters, wlcParams, juelicherParams, growUntil);
+        impl = makeMembraneImpl<TriangleWLCForce<StressFreeState::Active>, DihedralJuelicher>
+            (precision, state, name, parameters, wlcParams, juelicherParams, growUntil);
     else
-        impl = std::make_unique<InteractionMembraneImpl<TriangleWLCForce<StressFreeState::Inactive>, DihedralJuelicher>>
-            (state, name, parameters, wlcParams, juelicherParams, growUntil);
+        impl = makeMembraneImpl<TriangleWLCForce<StressFreeState::Inactive>, DihedralJuelicher>
+            (precision, state, name, parameters, wlcParams, juelicherParams, growUntil);
 }
 
 InteractionMembraneWLCJuelicher::~InteractionMembraneWLCJuelicher() = default;
@@ -12,7 +12,7 @@ public:
                                     CommonMembraneParameters parameters,
                                     WLCParameters wlcParams,
                                     JuelicherBendingParameters juelicherParams,
-                                    bool stressFree, float growUntil);
+                                    bool stressFree, float growUntil, MembranePrecision precision);
     
     ~InteractionMembraneWLCJuelicher();
 };
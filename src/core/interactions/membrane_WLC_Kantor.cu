@@ -3,22 +3,19 @@
 #include "membrane/dihedral/kantor.h"
 #include "membrane/triangle/wlc.h"
 
-#include <core/utils/make_unique.h>
-
 InteractionMembraneWLCKantor::InteractionMembraneWLCKantor(const YmrState *state, std::string name,
                                                            CommonMembraneParameters parameters,
                                                            WLCParameters wlcParams,
                                                            KantorBendingParameters kantorParams,
-                                                           bool stressFree, float growUntil) :
-    InteractionMembrane(state, name)
+                                                           bool stressFree, float growUntil, MembranePrecision precision) :
+    InteractionMembrane(state, name, precision)
 {
     if (stressFree)
-        impl = std::make_unique<InteractionMembraneImpl<TriangleWLCForce<StressFreeState::Active>, DihedralKantor>>
-            (state, name, parameters, wlcParams, kantorParams, growUntil);
+        impl = makeMembraneImpl<TriangleWLCForce<StressFreeState::Active>, DihedralKantor>
+            (precision, state, name, parameters, wlcParams, kantorParams, growUntil);
     else
-        impl = std::make_unique<InteractionMembraneImpl<TriangleWLCForce<StressFreeState::Inactive>, DihedralKantor>>
-            (state, name, parameters, wlcParams, kantorParams, growUntil);
-
+        impl = makeMembraneImpl<TriangleWLCForce<StressFreeState::Inactive>, DihedralKantor>
+            (precision, state, name, parameters, wlcParams, kantorParams, growUntil);
 }
 
 
@@ -10,7 +10,7 @@ class InteractionMembraneWLCKantor : public InteractionMembrane
 public:
     InteractionMembraneWLCKantor(const YmrState *state, std::string name,
                                  CommonMembraneParameters parameters, WLCParameters wlcParams, KantorBendingParameters kantorParams,
-                                 bool stressFree, float growUntil);
+                                 bool stressFree, float growUntil, MembranePrecision precision);
     
     ~InteractionMembraneWLCKantor();
 };
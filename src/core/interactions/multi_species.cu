@@ -0,0 +1,95 @@
+#include "multi_species.h"
+#include "pairwise.impl.h"
+#include "pairwise_interactions/multi_species.h"
+
+#include <core/celllist.h>
+#include <core/pvs/particle_vector.h>
+#include <core/utils/common.h>
+#include <core/utils/make_unique.h>
+
+#include <memory>
+
+BasicInteractionMultiSpecies::BasicInteractionMultiSpecies(const YmrState *state, std::string name, float rc) :
+    Interaction(state, name, rc)
+{}
+
+BasicInteractionMultiSpecies::~BasicInteractionMultiSpecies() = default;
+
+static void requireSpecies(ParticleVector *pv)
+{
+    // the particles whose species was never set are of species 0
+    const bool existed = pv->local()->extraPerParticle.checkChannelExists(ChannelNames::species);
+
+    pv->requireDataPerParticle<int>(ChannelNames::species, ExtraDataManager::PersistenceMode::Persistent);
+
+    if (!existed)
+        pv->local()->extraPerParticle.getData<int>(ChannelNames::species)->clear(defaultStream);
+}
+
+void BasicInteractionMultiSpecies::setPrerequisites(ParticleVector *pv1, ParticleVector *pv2, CellList *cl1, CellList *cl2)
+{
+    impl->setPrerequisites(pv1, pv2, cl1, cl2);
+
+    requireSpecies(pv1);
+    requireSpecies(pv2);
+
+    cl1->requireExtraDataPerParticle<int>(ChannelNames::species);
+    cl2->requireExtraDataPerParticle<int>(ChannelNames::species);
+}
+
+std::vector<Interaction::InteractionChannel> BasicInteractionMultiSpecies::getFinalOutputChannels() const
+{
+    return impl->getFinalOutputChannels();
+}
+
+std::vector<std::string> BasicInteractionMultiSpecies::getHaloInputChannels() const
+{
+    return {ChannelNames::species};
+}
+
+void BasicInteractionMultiSpecies::local(ParticleVector *pv1, ParticleVector *pv2, CellList *cl1, CellList *cl2, cudaStream_t stream)
+{
+    impl->local(pv1, pv2, cl1, cl2, stream);
+}
+
+void BasicInteractionMultiSpecies::halo (ParticleVector *pv1, ParticleVector *pv2, CellList *cl1, CellList *cl2, cudaStream_t stream)
+{
+    impl->halo(pv1, pv2, cl1, cl2, stream);
+}
+
+void BasicInteractionMultiSpecies::useNeighborList(float skin)
+{
+    impl->useNeighborList(skin);
+}
+
+void BasicInteractionMultiSpecies::useTiledKernels(bool enabled)
+{
+    impl->useTiledKernels(enabled);
+}
+
+bool BasicInteractionMultiSpecies::usePeriodicImages(bool enabled)
+{
+    return impl->usePeriodicImages(enabled);
+}
+
+void BasicInteractionMultiSpecies::setAutotuning(int nsamples, std::string fname)
+{
+    impl->setAutotuning(nsamples, fname);
+}
+
+
+InteractionDPDMultiSpecies::InteractionDPDMultiSpecies(const YmrState *state, std::string name, float rc,
+                                                       Matrix a, Matrix gamma, float kbt, Matrix power, bool counterRNG) :
+    BasicInteractionMultiSpecies(state, name, rc)
+{
+    PairwiseDPDMultiSpecies dpd(rc, a, gamma, kbt, state->dt, power, counterRNG);
+    impl = std::make_unique<InteractionPair<PairwiseDPDMultiSpecies>> (state, name, rc, dpd);
+}
+
+InteractionLJMultiSpecies::InteractionLJMultiSpecies(const YmrState *state, std::string name, float rc,
+                                                     Matrix epsilon, Matrix sigma, float maxForce) :
+    BasicInteractionMultiSpecies(state, name, rc)
+{
+    PairwiseLJMultiSpecies lj(rc, epsilon, sigma, maxForce);
+    impl = std::make_unique<InteractionPair<PairwiseLJMultiSpecies>> (state, name, rc, lj);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "interface.h"
+
+#include <memory>
+#include <vector>
+
+/**
+ * Pairwise interactions between particles of several species gathered in the same Particle Vectors.
+ * Every particle carries its species index in the persistent channel ChannelNames::species
+ * (0 if it was never set, see SpeciesIC), and the coefficients are given per pair of species.
+ * A single cell-list and a single traversal then cover all the species of a Particle Vector,
+ * instead of one Particle Vector, cell-list and launch per species and pair of species
+ */
+class BasicInteractionMultiSpecies : public Interaction
+{
+public:
+    using Matrix = std::vector<std::vector<float>>;
+
+    ~BasicInteractionMultiSpecies();
+
+    void setPrerequisites(ParticleVector *pv1, ParticleVector *pv2, CellList *cl1, CellList *cl2) override;
+    std::vector<InteractionChannel> getFinalOutputChannels() const override;
+    std::vector<std::string> getHaloInputChannels() const override;
+
+    void local (ParticleVector *pv1, ParticleVector *pv2, CellList *cl1, CellList *cl2, cudaStream_t stream) override;
+    void halo  (ParticleVector *pv1, ParticleVector *pv2, CellList *cl1, CellList *cl2, cudaStream_t stream) override;
+
+    void useNeighborList(float skin) override;
+    void useTiledKernels(bool enabled) override;
+    bool usePeriodicImages(bool enabled) override;
+    void setAutotuning(int nsamples, std::string fname) override;
+
+protected:
+    BasicInteractionMultiSpecies(const YmrState *state, std::string name, float rc);
+
+    std::unique_ptr<Interaction> impl;
+};
+
+/// DPD with a, gamma and the power of the weight per pair of species, see InteractionDPD
+class InteractionDPDMultiSpecies : public BasicInteractionMultiSpecies
+{
+public:
+    InteractionDPDMultiSpecies(const YmrState *state, std::string name, float rc,
+                               Matrix a, Matrix gamma, float kbt, Matrix power, bool counterRNG = false);
+};
+
+/// Repulsive LJ with epsilon and sigma per pair of species, see InteractionLJ
+class InteractionLJMultiSpecies : public BasicInteractionMultiSpecies
+{
+public:
+    InteractionLJMultiSpecies(const YmrState *state, std::string name, float rc,
+                              Matrix epsilon, Matrix sigma, float maxForce);
+};
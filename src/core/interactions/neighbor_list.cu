@@ -0,0 +1,285 @@
+#include "neighbor_list.h"
+
+#include <core/celllist.h>
+#include <core/logger.h>
+#include <core/pvs/views/pv.h>
+#include <core/utils/cuda_common.h>
+#include <core/utils/kernel_launch.h>
+
+#include <cmath>
+
+namespace NeighborListKernels
+{
+
+enum {INVALID = -1};
+
+/**
+ * Store all the particles closer than sqrt(rl2) to the particle \e dstId.
+ * Each pair is listed once: with the smaller id as a neighbor of the larger.
+ * If \p OnlyNew, only rows of the particles marked in \p isNew are built;
+ * they get as neighbors all the old particles and the new ones with smaller ids.
+ */
+template <bool OnlyNew>
+__global__ void buildRows(PVview view, CellListInfo cinfo, int3 span, float rl2, const int *isNew,
+                          int stride, int maxNeighbors, int *counts, int *neighbors, float4 *refPositions,
+                          int *maxCount)
+{
+    const int dstId = blockIdx.x * blockDim.x + threadIdx.x;
+    if (dstId >= view.size) return;
+    if (OnlyNew && !isNew[dstId]) return;
+
+    const float4 dstPos = readNoCache(view.positionPtr(dstId));
+    const float3 r = make_float3(dstPos);
+    const int3 cell0 = cinfo.getCellIdAlongAxes(r);
+
+    const int xlo = max(cell0.x - span.x, 0);
+    const int xhi = min(cell0.x + span.x, cinfo.ncells.x - 1);
+
+    int n = 0;
+    for (int cellZ = max(cell0.z - span.z, 0); cellZ <= min(cell0.z + span.z, cinfo.ncells.z - 1); cellZ++)
+        for (int cellY = max(cell0.y - span.y, 0); cellY <= min(cell0.y + span.y, cinfo.ncells.y - 1); cellY++)
+        {
+            // with row-major ordering the whole row is one range of particles
+            const int nranges = cinfo.isRowMajor() ? 1 : xhi - xlo + 1;
+
+            for (int range = 0; range < nranges; range++)
+            {
+                const int cidLo = cinfo.isRowMajor() ? cinfo.encode(xlo, cellY, cellZ) : cinfo.encode(xlo + range, cellY, cellZ);
+                const int cidHi = cinfo.isRowMajor() ? cinfo.encode(xhi, cellY, cellZ) : cidLo;
+
+                const int pstart = cinfo.cellStarts[cidLo];
+                const int pend   = cinfo.cellStarts[cidHi + 1];
+
+                for (int srcId = pstart; srcId < pend; srcId++)
+                {
+                    const bool candidate = OnlyNew ?
+                        (!isNew[srcId] || srcId < dstId) :
+                        (srcId < dstId);
+
+                    if (!candidate) continue;
+
+                    if (distance2(r, make_float3(*view.positionPtr(srcId))) < rl2)
+                    {
+                        if (n < maxNeighbors)
+                            neighbors[n*stride + dstId] = srcId;
+                        n++;
+                    }
+                }
+            }
+        }
+
+    counts[dstId] = min(n, maxNeighbors);
+    refPositions[dstId] = dstPos;
+    atomicMax(maxCount, n);
+}
+
+/**
+ * Move the list to the new order of particles given by the cell-list
+ * and flag the particles that were not yet in the list
+ */
+__global__ void remap(int nOld, int nIn, const int *order, const float4 *particles,
+                      int srcStride, const int *srcCounts, const int *srcNeighbors, const float4 *srcRefPositions,
+                      int dstStride, int *dstCounts, int *dstNeighbors, float4 *dstRefPositions, int *isNew)
+{
+    const int pid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (pid >= nIn) return;
+
+    const int newId = order[pid];
+    if (newId == INVALID) return;
+
+    if (pid >= nOld)
+    {
+        isNew[newId] = 1;
+        dstCounts[newId] = 0;
+        dstRefPositions[newId] = particles[2*newId];
+        return;
+    }
+
+    isNew[newId] = 0;
+    dstRefPositions[newId] = srcRefPositions[pid];
+
+    const int n = srcCounts[pid];
+    int m = 0;
+    for (int k = 0; k < n; k++)
+    {
+        const int nid = order[ srcNeighbors[k*srcStride + pid] ];
+        if (nid != INVALID)
+            dstNeighbors[(m++)*dstStride + newId] = nid;
+    }
+    dstCounts[newId] = m;
+}
+
+__global__ void checkDisplacement(PVview view, const float4 *refPositions, float maxDisplacement2, int *flag)
+{
+    const int pid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (pid >= view.size) return;
+
+    const float3 r    = make_float3(readNoCache(view.positionPtr(pid)));
+    const float3 rref = make_float3(refPositions[pid]);
+
+    if (distance2(r, rref) > maxDisplacement2)
+        *flag = 1;
+}
+
+} // namespace NeighborListKernels
+
+
+NeighborList::NeighborList(float rc, float skin) :
+    rc(rc), skin(skin), stats(2)
+{
+    if (skin < 0.0f)
+        die("Neighbor list skin must be non-negative, got %f", skin);
+}
+
+NeighborList::~NeighborList() = default;
+
+NeighborListView NeighborList::getView() const
+{
+    return {counts.size(), counts.devPtr(), neighbors.devPtr()};
+}
+
+int NeighborList::getNumRebuilds() const {return nRebuilds;}
+
+void NeighborList::update(CellList *cl, cudaStream_t stream)
+{
+    const int np = cl->getLocalParticleVector()->size();
+    const int buildId = cl->getNumBuilds();
+
+    if (np == 0)
+    {
+        nListed = -1;
+        return;
+    }
+
+    bool rebuild = (nListed < 0);
+
+    // Remapping is only possible from the order of the previous cell-list
+    // build, and only if no particle was inserted in the middle of the array
+    if (buildId == cellListBuildId)
+        rebuild = rebuild || (np != nListed);
+    else
+        rebuild = rebuild || (buildId != cellListBuildId + 1) || (cl->getOrderSize() < nListed);
+
+    if (!rebuild)
+    {
+        stats.clearDevice(stream);
+
+        if (buildId != cellListBuildId)
+            remap(cl, stream);
+
+        // This also catches any non-tracked change of order as a big displacement
+        rebuild = needRebuild(cl, stream);
+    }
+
+    if (rebuild)
+        build(cl, stream);
+
+    nListed = np;
+    cellListBuildId = buildId;
+}
+
+void NeighborList::estimateMaxNeighbors(CellList *cl)
+{
+    const int np = cl->getLocalParticleVector()->size();
+    const float volume = cl->localDomainSize.x * cl->localDomainSize.y * cl->localDomainSize.z;
+    const float rl = rc + skin;
+
+    // half of the neighbors within the sphere, with some margin
+    const float expected = 0.5f * (np / volume) * 4.0f / 3.0f * M_PI * rl*rl*rl;
+    maxNeighbors = (int) ceil(1.25f * expected) + 8;
+}
+
+void NeighborList::build(CellList *cl, cudaStream_t stream)
+{
+    auto view = cl->getView<PVview>();
+    const int np = view.size;
+    const float rl = rc + skin;
+    const int3 span = make_int3( ceilf(rl * cl->invh.x - 1e-6f),
+                                 ceilf(rl * cl->invh.y - 1e-6f),
+                                 ceilf(rl * cl->invh.z - 1e-6f) );
+
+    if (maxNeighbors == 0)
+        estimateMaxNeighbors(cl);
+
+    while (true)
+    {
+        counts      .resize_anew(np);
+        neighbors   .resize_anew(np * maxNeighbors);
+        refPositions.resize_anew(np);
+        stats.clearDevice(stream);
+
+        const int nthreads = 128;
+        SAFE_KERNEL_LAUNCH(
+            NeighborListKernels::buildRows<false>,
+            getNblocks(np, nthreads), nthreads, 0, stream,
+            view, cl->cellInfo(), span, rl*rl, nullptr,
+            np, maxNeighbors, counts.devPtr(), neighbors.devPtr(), refPositions.devPtr(),
+            stats.devPtr() + 1 );
+
+        stats.downloadFromDevice(stream);
+
+        if (stats[1] <= maxNeighbors) break;
+
+        debug("Neighbor list: %d neighbors per particle requested, only %d available, growing",
+              stats[1], maxNeighbors);
+        maxNeighbors = stats[1] + stats[1] / 8 + 8;
+    }
+
+    nRebuilds++;
+    debug2("Neighbor list rebuilt for %d particles (%d rebuilds so far)", np, nRebuilds);
+}
+
+void NeighborList::remap(CellList *cl, cudaStream_t stream)
+{
+    auto view = cl->getView<PVview>();
+    const int np  = view.size;
+    const int nIn = cl->getOrderSize();
+
+    counts_tmp      .resize_anew(np);
+    neighbors_tmp   .resize_anew(np * maxNeighbors);
+    refPositions_tmp.resize_anew(np);
+    isNew           .resize_anew(np);
+
+    const int nthreads = 128;
+    SAFE_KERNEL_LAUNCH(
+        NeighborListKernels::remap,
+        getNblocks(nIn, nthreads), nthreads, 0, stream,
+        nListed, nIn, cl->cellInfo().order, view.particles,
+        counts.size(), counts.devPtr(), neighbors.devPtr(), refPositions.devPtr(),
+        np, counts_tmp.devPtr(), neighbors_tmp.devPtr(), refPositions_tmp.devPtr(), isNew.devPtr() );
+
+    std::swap(counts,       counts_tmp);
+    std::swap(neighbors,    neighbors_tmp);
+    std::swap(refPositions, refPositions_tmp);
+
+    if (nIn > nListed)
+    {
+        const float rl = rc + skin;
+        const int3 span = make_int3( ceilf(rl * cl->invh.x - 1e-6f),
+                                     ceilf(rl * cl->invh.y - 1e-6f),
+                                     ceilf(rl * cl->invh.z - 1e-6f) );
+
+        SAFE_KERNEL_LAUNCH(
+            NeighborListKernels::buildRows<true>,
+            getNblocks(np, nthreads), nthreads, 0, stream,
+            view, cl->cellInfo(), span, rl*rl, isNew.devPtr(),
+            np, maxNeighbors, counts.devPtr(), neighbors.devPtr(), refPositions.devPtr(),
+            stats.devPtr() + 1 );
+    }
+}
+
+bool NeighborList::needRebuild(CellList *cl, cudaStream_t stream)
+{
+    auto view = cl->getView<PVview>();
+    const float maxDisplacement = 0.5f * skin;
+
+    const int nthreads = 128;
+    SAFE_KERNEL_LAUNCH(
+        NeighborListKernels::checkDisplacement,
+        getNblocks(view.size, nthreads), nthreads, 0, stream,
+        view, refPositions.devPtr(), maxDisplacement*maxDisplacement, stats.devPtr() );
+
+    stats.downloadFromDevice(stream);
+
+    return stats[0] != 0 || stats[1] > maxNeighbors;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <core/containers.h>
+
+#include <cuda_runtime.h>
+
+class CellList;
+
+/**
+ * GPU-compatible view of a NeighborList.
+ *
+ * Neighbors are stored in ELL format: k-th neighbor of particle i
+ * is at neighbors[k*stride + i], such that consecutive threads
+ * read consecutive addresses. Every pair is stored only once.
+ */
+struct NeighborListView
+{
+    int stride;
+    const int *counts, *neighbors;
+};
+
+/**
+ * Verlet list of the particles of one ParticleVector, built on top
+ * of its PrimaryCellList with the cut-off radius rc + skin.
+ *
+ * Particle ids are the ones of the cell-list. When the cell-list is
+ * rebuilt, the list is remapped to the new order of particles instead
+ * of being recomputed; particles that migrated from other ranks get
+ * their neighbors appended. The list is rebuilt from scratch only when
+ * some particle moved more than skin/2 since the last build.
+ */
+class NeighborList
+{
+public:
+    NeighborList(float rc, float skin);
+    ~NeighborList();
+
+    /// bring the list in sync with the current state of \p cl, rebuilding it if required
+    void update(CellList *cl, cudaStream_t stream);
+
+    NeighborListView getView() const;
+
+    int getNumRebuilds() const;
+
+private:
+    float rc, skin;
+
+    int maxNeighbors{0};
+    int nListed{-1};          ///< number of particles in the list, -1 if it was never built
+    int cellListBuildId{-1};  ///< CellList::getNumBuilds() at the moment of the last update
+    int nRebuilds{0};
+
+    DeviceBuffer<int> counts, neighbors;
+    DeviceBuffer<int> counts_tmp, neighbors_tmp;
+
+    // positions of the particles at the moment of the last rebuild
+    DeviceBuffer<float4> refPositions, refPositions_tmp;
+    DeviceBuffer<int> isNew;
+
+    // [0]: displacement exceeded skin/2, [1]: largest number of neighbors found
+    PinnedBuffer<int> stats;
+
+    void build(CellList *cl, cudaStream_t stream);
+    void remap(CellList *cl, cudaStream_t stream);
+    bool needRebuild(CellList *cl, cudaStream_t stream);
+
+    void estimateMaxNeighbors(CellList *cl);
+};
@@ -2,16 +2,25 @@
 
 #include "interface.h"
 
+#include "neighbor_list.h"
+#include "pairwise_interactions/compressed.h"
+#include "pairwise_interactions/packed_positions.h"
 #include "pairwise_kernels.h"
+#include "utils/kernel_tuner.h"
 
 #include <core/celllist.h>
+#include <core/containers.h>
 #include <core/pvs/object_vector.h>
 #include <core/pvs/particle_vector.h>
 #include <core/pvs/views/pv.h>
 #include <core/utils/cuda_common.h>
 #include <core/utils/kernel_launch.h>
+#include <core/utils/make_unique.h>
 
+#include <cmath>
 #include <map>
+#include <memory>
+#include <type_traits>
 
 /**
  * Implementation of short-range symmetric pairwise interactions
@@ -33,6 +42,12 @@ public:
      */
     void local(ParticleVector *pv1, ParticleVector *pv2, CellList *cl1, CellList *cl2, cudaStream_t stream) override
     {
+        if (periodicImages)
+        {
+            computeLocalPeriodic(pv1, pv2, cl1, cl2, stream);
+            return;
+        }
+
         // if (pv1->local()->size() < pv2->local()->size())
         computeLocal(pv1, pv2, cl1, cl2, stream);
         // else
@@ -51,9 +66,13 @@ public:
      * - Both are ParticleVector. Then if they are different, two _compute() calls
      *   are made such that halo1 \<-\> local2 and halo2 \<-\> local1. If \p pv1 and
      *   \p pv2 are the same, only one call is needed
+     *
+     * Nothing to compute with the periodic images, the local interactions covered the halo
      */
     void halo(ParticleVector *pv1, ParticleVector *pv2, CellList *cl1, CellList *cl2, cudaStream_t stream) override
     {
+        if (periodicImages) return;
+
         auto isov1 = dynamic_cast<ObjectVector *>(pv1) != nullptr;
         auto isov2 = dynamic_cast<ObjectVector *>(pv2) != nullptr;
 
@@ -88,18 +107,129 @@ public:
         intMap.insert({{pv2name, pv1name}, pair});
     }
 
+    void useNeighborList(float skin) override
+    {
+        if (skin < 0.0f)
+            die("Interaction '%s': neighbor list skin must be non-negative, got %f", name.c_str(), skin);
+
+        neighborListSkin = skin;
+        neighborLists.clear();
+    }
+
+    void useTiledKernels(bool enabled) override
+    {
+        tiledKernels = enabled;
+    }
+
+    void setAutotuning(int nsamples, std::string fname) override
+    {
+        tuner = std::make_unique<KernelTuner>(nsamples, fname);
+    }
+
+    void useEarlyInterior(bool enabled) override
+    {
+        earlyInterior = enabled;
+    }
+
+    bool setInteriorMargin(ParticleVector *pv, CellList *cl, float margin) override
+    {
+        if (!earlyInterior) return false;
+
+        if (neighborListSkin >= 0.0f)
+        {
+            warn("Interaction '%s' cannot compute the interior of '%s' early with neighbor lists",
+                 name.c_str(), pv->name.c_str());
+            return false;
+        }
+
+        debug("Interaction '%s' will compute the particles of '%s' further than %f from the boundary early",
+              name.c_str(), pv->name.c_str(), margin);
+        interiorMargins[cl] = margin;
+        return true;
+    }
+
+    /**
+     * Interface to computeSelf() for the interior cells, always with the tiled kernel:
+     * the cells are dense and far from the boundary
+     */
+    void localInterior(ParticleVector *pv, CellList *cl, cudaStream_t stream) override
+    {
+        computeSelf(pv, cl, getInteriorRegion(cl, true), true, stream);
+    }
+
+    bool usePeriodicImages(bool enabled) override
+    {
+        periodicImages = enabled;
+        return true;
+    }
+
+    /// parameters of the pair \p pv1 - \p pv2, set up for the current step
+    const typename PairwiseInteraction::HandlerType& getHandler(ParticleVector *pv1, ParticleVector *pv2)
+    {
+        auto& pair = getPairwiseInteraction(pv1->name, pv2->name);
+        pair.setup(pv1->local(), pv2->local(), nullptr, nullptr, state);
+        return pair.handler();
+    }
+
+    void useCompressedStorage(bool enabled, bool validate) override
+    {
+        if (enabled && !CompressionSupported::value)
+            die("Interaction '%s' does not support compressed storage: it needs more than coordinates and velocities",
+                name.c_str());
+
+        compressedStorage   = enabled;
+        validateCompression = enabled && validate;
+    }
+
 private:
 
     PairwiseInteraction defaultPair;
     std::map< std::pair<std::string, std::string>, PairwiseInteraction > intMap;
 
+    /// negative if neighbor lists are not used
+    float neighborListSkin{-1.0f};
+    std::map< CellList*, std::unique_ptr<NeighborList> > neighborLists;
+
+    bool tiledKernels{false};
+
+    /// the local interactions include the periodic images, see usePeriodicImages()
+    bool periodicImages{false};
+
+    bool earlyInterior{false};
+    /// distance from the boundary of the interior computed by localInterior(), per cell-list
+    std::map<CellList*, float> interiorMargins;
+
+    /// nullptr if the launch configurations are chosen by the heuristics
+    std::unique_ptr<KernelTuner> tuner;
+
+    /// kernel variants of the local self interactions
+    enum SelfVariant { Cells = 0, Tiled = 1 };
+
+    /// the variants of the external interactions are the numbers of threads per particle, or this one
+    enum ExternalVariant { ExternalTiled = 0 };
+
+    using CompressionSupported = std::integral_constant<bool,
+        std::is_same<typename PairwiseInteraction::ViewType,     PVview>  ::value &&
+        std::is_same<typename PairwiseInteraction::ParticleType, Particle>::value >;
+
+    /// read the source particles of the external interactions from their compressed copy
+    bool compressedStorage{false};
+    /// compare the forces with the full precision ones at every launch
+    bool validateCompression{false};
+
+    // separate buffers for local and halo, that may run concurrently
+    DeviceBuffer<uint4> compressedLocal, compressedHalo;
+    PinnedBuffer<Force> validationForces;
+
 private:
 
     /**
      * Convenience macro wrapper
      *
      * Select one of the available kernels for external interaction depending
-     * on the number of particles involved, report it and call
+     * on the number of threads per particle, report it and call.
+     * The launch configuration variant of external kernels is the number
+     * of threads per particle, see chooseExternalTpp()
      */
     #define DISPATCH_EXTERNAL(P1, P2, P3, TPP, INTERACTION_FUNCTION)                \
     do{ debug2("Dispatched to "#TPP" thread(s) per particle variant");              \
@@ -108,11 +238,231 @@ private:
                 getNblocks(TPP*dstView.size, nth), nth, 0, stream,                  \
                 dstView, cl2->cellInfo(), srcView, rc*rc, INTERACTION_FUNCTION); } while (0)
 
-    #define CHOOSE_EXTERNAL(P1, P2, P3, INTERACTION_FUNCTION)                                        \
-        do{  if (dstView.size < 1000  ) { DISPATCH_EXTERNAL(P1, P2, P3, 27, INTERACTION_FUNCTION); } \
-        else if (dstView.size < 10000 ) { DISPATCH_EXTERNAL(P1, P2, P3, 9,  INTERACTION_FUNCTION); } \
-        else if (dstView.size < 400000) { DISPATCH_EXTERNAL(P1, P2, P3, 3,  INTERACTION_FUNCTION); } \
-        else                            { DISPATCH_EXTERNAL(P1, P2, P3, 1,  INTERACTION_FUNCTION); } } while(0)
+    #define CHOOSE_EXTERNAL(P1, P2, P3, TPP, INTERACTION_FUNCTION)                         \
+        do{ switch (TPP) {                                                                  \
+            case 1:  DISPATCH_EXTERNAL(P1, P2, P3, 1,  INTERACTION_FUNCTION); break;        \
+            case 3:  DISPATCH_EXTERNAL(P1, P2, P3, 3,  INTERACTION_FUNCTION); break;        \
+            case 9:  DISPATCH_EXTERNAL(P1, P2, P3, 9,  INTERACTION_FUNCTION); break;        \
+            default: DISPATCH_EXTERNAL(P1, P2, P3, 27, INTERACTION_FUNCTION); break;        \
+        } } while(0)
+
+    /// Launch the external interaction kernel with \p tpp threads per particle
+    template <InteractionOut NeedDstAcc, InteractionOut NeedSrcAcc, InteractionMode Variant, class ViewType, class Handler>
+    void launchExternal(int tpp, int nth, ViewType dstView, CellList *cl2, ViewType srcView, Handler handler, cudaStream_t stream)
+    {
+        CHOOSE_EXTERNAL(NeedDstAcc, NeedSrcAcc, Variant, tpp, handler);
+    }
+
+    /// handler and view of the launches with up to date packed positions, see PackedPositionsFetcher
+    using PackedHandler = PackedPositionsFetcher<typename PairwiseInteraction::HandlerType>;
+    using PackedView    = typename PackedHandler::ViewType;
+
+    /// Same as launchExternal(), with the loads specialized for the packed positions when possible
+    template <InteractionOut NeedDstAcc, InteractionOut NeedSrcAcc, InteractionMode Variant>
+    void launchExternalSpecialized(int tpp, int nth, typename PairwiseInteraction::ViewType dstView, CellList *cl2,
+                                   typename PairwiseInteraction::ViewType srcView, PairwiseInteraction& pair, cudaStream_t stream)
+    {
+        if (PackedHandler::applicable(dstView, srcView))
+            launchExternal<NeedDstAcc, NeedSrcAcc, Variant>
+                (tpp, nth, PackedView(dstView), cl2, PackedView(srcView), PackedHandler(pair.handler()), stream);
+        else
+            launchExternal<NeedDstAcc, NeedSrcAcc, Variant>
+                (tpp, nth, dstView, cl2, srcView, pair.handler(), stream);
+    }
+
+    /// Launch computeExternalInteractionsTiled(), the cells of \p cl1 and \p cl2 must coincide
+    template <class ViewType, class Handler>
+    void launchExternalTiled(int nth, CellList *cl1, ViewType dstView, CellList *cl2, ViewType srcView, Handler handler, cudaStream_t stream)
+    {
+        using ParticleType = typename PairwiseInteraction::ParticleType;
+        const int warpsPerBlock = nth / 32;
+        const size_t shMemSize = nth * sizeof(ParticleType);
+
+        auto dstCinfo = cl1->cellInfo();
+        SAFE_KERNEL_LAUNCH(
+                           computeExternalInteractionsTiled<InteractionOut::NeedAcc COMMA InteractionOut::NeedAcc>,
+                           getNblocks(cl1->getActiveCellsBound(), warpsPerBlock), nth, shMemSize, stream,
+                           dstCinfo, dstView, cl2->cellInfo(), srcView, rc*rc, handler);
+    }
+
+    /// Launch the self interaction kernel chosen by \p config for the cells of \p region
+    template <class ViewType, class Handler>
+    void launchSelf(KernelLaunchConfig config, CellList *cl, ViewType view, Handler handler, CellRegion region, cudaStream_t stream)
+    {
+        auto cinfo = cl->cellInfo();
+
+        if (config.variant == SelfVariant::Tiled)
+        {
+            using ParticleType = typename PairwiseInteraction::ParticleType;
+            const int warpsPerBlock = config.nthreads / 32;
+            const size_t shMemSize = config.nthreads * sizeof(ParticleType);
+
+            SAFE_KERNEL_LAUNCH(
+                               computeSelfInteractionsTiled,
+                               getNblocks(cl->getActiveCellsBound(), warpsPerBlock), config.nthreads, shMemSize, stream,
+                               cinfo, view, rc*rc, handler, region);
+        }
+        else
+        {
+            SAFE_KERNEL_LAUNCH(
+                               computeSelfInteractions,
+                               getNblocks(view.size, config.nthreads), config.nthreads, 0, stream,
+                               cinfo, view, rc*rc, handler, region);
+        }
+    }
+
+    template <class ViewType, class Handler>
+    void launchSelfNeighborList(NeighborList *nlist, ViewType view, Handler handler, cudaStream_t stream)
+    {
+        const int nth = 128;
+        SAFE_KERNEL_LAUNCH(
+                           computeSelfInteractionsNeighborList,
+                           getNblocks(view.size, nth), nth, 0, stream,
+                           nlist->getView(), view, handler);
+    }
+
+    /**
+     * Compute the external interactions with the source particles read from
+     * a compressed copy of \p srcView, that is made in \p buffer
+     */
+    template <InteractionOut NeedDstAcc, InteractionOut NeedSrcAcc, InteractionMode Variant>
+    void computeExternalCompressed(KernelLaunchConfig config, PVview dstView, CellList *cl2, PVview srcView,
+                                   PairwiseInteraction& pair, DeviceBuffer<uint4>& buffer, cudaStream_t stream,
+                                   std::true_type supported)
+    {
+        using Handler = CompressedParticleFetcher<typename PairwiseInteraction::HandlerType>;
+
+        PVviewCompressed cdstView(dstView), csrcView(srcView);
+        csrcView.lo   = -0.5f * cl2->localDomainSize;
+        csrcView.step = cl2->localDomainSize / 65535.0f;
+
+        buffer.resize_anew(srcView.size);
+
+        const int nth = 128;
+        SAFE_KERNEL_LAUNCH(
+                           compressParticles,
+                           getNblocks(srcView.size, nth), nth, 0, stream,
+                           srcView, csrcView.lo, csrcView.step, buffer.devPtr() );
+
+        csrcView.compressed = buffer.devPtr();
+
+        if (validateCompression)
+            validateCompressed<Variant>(config, dstView, cl2, srcView, csrcView, pair, stream);
+
+        launchExternal<NeedDstAcc, NeedSrcAcc, Variant>
+            (config.variant, config.nthreads, cdstView, cl2, csrcView, Handler(pair.handler()), stream);
+    }
+
+    template <InteractionOut NeedDstAcc, InteractionOut NeedSrcAcc, InteractionMode Variant>
+    void computeExternalCompressed(KernelLaunchConfig config, typename PairwiseInteraction::ViewType dstView, CellList *cl2,
+                                   typename PairwiseInteraction::ViewType srcView,
+                                   PairwiseInteraction& pair, DeviceBuffer<uint4>& buffer, cudaStream_t stream,
+                                   std::false_type supported)
+    {
+        die("Interaction '%s' does not support compressed storage", name.c_str());
+    }
+
+    /**
+     * Compute the destination forces both in full precision and with the
+     * compressed source particles, report the largest difference.
+     * Synchronizes the stream.
+     */
+    template <InteractionMode Variant>
+    void validateCompressed(KernelLaunchConfig config, PVview dstView, CellList *cl2, PVview srcView, PVviewCompressed csrcView,
+                            PairwiseInteraction& pair, cudaStream_t stream)
+    {
+        using Handler = CompressedParticleFetcher<typename PairwiseInteraction::HandlerType>;
+        const int n = dstView.size;
+
+        validationForces.resize_anew(2*n);
+        validationForces.clearDevice(stream);
+
+        PVview refView = dstView;
+        refView.forces = reinterpret_cast<float4*>(validationForces.devPtr());
+
+        PVviewCompressed cmpView(dstView);
+        cmpView.forces = reinterpret_cast<float4*>(validationForces.devPtr() + n);
+
+        launchExternal<InteractionOut::NeedAcc, InteractionOut::NoAcc, Variant>
+            (config.variant, config.nthreads, refView, cl2, srcView,  pair.handler(), stream);
+        launchExternal<InteractionOut::NeedAcc, InteractionOut::NoAcc, Variant>
+            (config.variant, config.nthreads, cmpView, cl2, csrcView, Handler(pair.handler()), stream);
+
+        validationForces.downloadFromDevice(stream);
+
+        float maxError = 0.0f, maxForce = 0.0f;
+        for (int i = 0; i < n; i++)
+        {
+            const float3 ref = validationForces[i].f;
+            const float3 cmp = validationForces[i + n].f;
+            maxError = std::max(maxError, length(ref - cmp));
+            maxForce = std::max(maxForce, length(ref));
+        }
+
+        info("Interaction '%s': compressed storage force error for %d particles: max %g, relative to the largest force %g",
+             name.c_str(), n, maxError, maxForce > 0.0f ? maxError / maxForce : 0.0f);
+    }
+
+    /// Number of threads per particle of the external kernels, chosen by the number of destination particles
+    static int chooseExternalTpp(int ndst)
+    {
+        if      (ndst < 1000  ) return 27;
+        else if (ndst < 10000 ) return 9;
+        else if (ndst < 400000) return 3;
+        else                    return 1;
+    }
+
+    /**
+     * Choose the launch configuration: by the \p defaultConfig, or by the tuner if any.
+     * In the latter case, KernelTuner::end() has to be called after the launch.
+     */
+    KernelLaunchConfig getLaunchConfig(const std::string& kind, ParticleVector *pv1, ParticleVector *pv2, int ndst,
+                                       KernelLaunchConfig defaultConfig,
+                                       const std::vector<KernelLaunchConfig>& candidates, cudaStream_t stream)
+    {
+        if (!tuner) return defaultConfig;
+        return tuner->begin(getTuningKey(kind, pv1, pv2, ndst), candidates, stream);
+    }
+
+    void endLaunch(const std::string& kind, ParticleVector *pv1, ParticleVector *pv2, int ndst, cudaStream_t stream)
+    {
+        if (tuner) tuner->end(getTuningKey(kind, pv1, pv2, ndst), stream);
+    }
+
+    /// Best configuration depends on the problem size, tune separately for every power of 2
+    std::string getTuningKey(const std::string& kind, ParticleVector *pv1, ParticleVector *pv2, int ndst) const
+    {
+        const int sizeClass = (int) std::log2( (double) std::max(ndst, 1) );
+        return name + ":" + pv1->name + ":" + pv2->name + ":" + kind + ":" + std::to_string(sizeClass);
+    }
+
+    static std::vector<KernelLaunchConfig> getSelfCandidates()
+    {
+        return { {SelfVariant::Cells, 64}, {SelfVariant::Cells, 128},
+                 {SelfVariant::Tiled, 64}, {SelfVariant::Tiled, 128} };
+    }
+
+    /// computeExternalInteractionsTiled() is a candidate if \p withTiled
+    static std::vector<KernelLaunchConfig> getExternalCandidates(bool withTiled = false)
+    {
+        std::vector<KernelLaunchConfig> candidates;
+        for (int tpp : {1, 3, 9, 27})
+            for (int nthreads : {64, 128})
+                candidates.push_back({tpp, nthreads});
+
+        if (withTiled)
+            for (int nthreads : {64, 128})
+                candidates.push_back({ExternalVariant::ExternalTiled, nthreads});
+
+        return candidates;
+    }
+
+    /// the tiled external kernel needs the cells of both cell-lists to coincide
+    static bool sameGrid(const CellList *cl1, const CellList *cl2)
+    {
+        return cl1->ncells.x == cl2->ncells.x && cl1->ncells.y == cl2->ncells.y && cl1->ncells.z == cl2->ncells.z &&
+               cl1->h.x == cl2->h.x && cl1->h.y == cl2->h.y && cl1->h.z == cl2->h.z;
+    }
 
 
     /**
@@ -139,28 +489,23 @@ private:
      */
     void computeLocal(ParticleVector* pv1, ParticleVector* pv2, CellList* cl1, CellList* cl2, cudaStream_t stream)
     {
-        auto& pair = getPairwiseInteraction(pv1->name, pv2->name);
-        using ViewType = typename PairwiseInteraction::ViewType;
-
-        pair.setup(pv1->local(), pv2->local(), cl1, cl2, state);
-
         /*  Self interaction */
         if (pv1 == pv2)
         {
-            auto view = cl1->getView<ViewType>();
-            const int np = view.size;
-            debug("Computing internal forces for %s (%d particles)", pv1->name.c_str(), np);
-
-            const int nth = 128;
-
-            auto cinfo = cl1->cellInfo();
-            SAFE_KERNEL_LAUNCH(
-                               computeSelfInteractions,
-                               getNblocks(np, nth), nth, 0, stream,
-                               cinfo, view, rc*rc, pair.handler());
+            const bool split = interiorMargins.find(cl1) != interiorMargins.end();
+            computeSelf(pv1, cl1, split ? getInteriorRegion(cl1, false) : CellRegion(), false, stream);
         }
         else /*  External interaction */
         {
+            const bool needDst = needOutput(pv1);
+            const bool needSrc = needOutput(pv2);
+            if (!needDst && !needSrc) return;
+
+            auto& pair = getPairwiseInteraction(pv1->name, pv2->name);
+            using ViewType = typename PairwiseInteraction::ViewType;
+
+            pair.setup(pv1->local(), pv2->local(), cl1, cl2, state);
+
             const int np1 = pv1->local()->size();
             const int np2 = pv2->local()->size();
             debug("Computing external forces for %s - %s (%d - %d particles)", pv1->name.c_str(), pv2->name.c_str(), np1, np2);
@@ -168,10 +513,194 @@ private:
             auto dstView = cl1->getView<ViewType>();
             auto srcView = cl2->getView<ViewType>();
 
-            const int nth = 128;
-            if (np1 > 0 && np2 > 0)
-                CHOOSE_EXTERNAL(InteractionOut::NeedAcc, InteractionOut::NeedAcc, InteractionMode::RowWise, pair.handler());
+            if (np1 > 0 && np2 > 0 && (!needDst || !needSrc))
+            {
+                computeLocalOneSided(needDst, pv1, pv2, dstView, cl2, srcView, pair, stream);
+            }
+            else if (np1 > 0 && np2 > 0)
+            {
+                // the compressed sources are only read by the kernels with threads per particle
+                const bool withTiled = !compressedStorage && sameGrid(cl1, cl2);
+
+                const KernelLaunchConfig defaultConfig {(withTiled && tiledKernels) ? ExternalVariant::ExternalTiled : chooseExternalTpp(dstView.size), 128};
+                auto config = getLaunchConfig("local", pv1, pv2, dstView.size, defaultConfig, getExternalCandidates(withTiled), stream);
+                const int nth = config.nthreads;
+
+                if (compressedStorage)
+                    computeExternalCompressed<InteractionOut::NeedAcc, InteractionOut::NeedAcc, InteractionMode::RowWise>
+                        (config, dstView, cl2, srcView, pair, compressedLocal, stream, CompressionSupported{});
+                else if (config.variant == ExternalVariant::ExternalTiled)
+                {
+                    if (PackedHandler::applicable(dstView, srcView))
+                        launchExternalTiled(nth, cl1, PackedView(dstView), cl2, PackedView(srcView), PackedHandler(pair.handler()), stream);
+                    else
+                        launchExternalTiled(nth, cl1, dstView, cl2, srcView, pair.handler(), stream);
+                }
+                else
+                    launchExternalSpecialized<InteractionOut::NeedAcc, InteractionOut::NeedAcc, InteractionMode::RowWise>
+                        (config.variant, nth, dstView, cl2, srcView, pair, stream);
+
+                endLaunch("local", pv1, pv2, dstView.size, stream);
+            }
+        }
+    }
+
+    /**
+     * The forces and stresses of a static particle vector are never read, unless it asks for them,
+     * see ParticleVector::isStatic. The intermediate quantities are always needed
+     */
+    static bool needOutput(const ParticleVector *pv)
+    {
+        return isIntermediateInteraction<PairwiseInteraction>::value || !pv->isStatic || pv->staticForces;
+    }
+
+    /// local external interactions that only accumulate on the destination if \p needDst, on the source otherwise
+    void computeLocalOneSided(bool needDst, ParticleVector *pv1, ParticleVector *pv2,
+                              typename PairwiseInteraction::ViewType dstView, CellList *cl2,
+                              typename PairwiseInteraction::ViewType srcView,
+                              PairwiseInteraction& pair, cudaStream_t stream)
+    {
+        const KernelLaunchConfig defaultConfig {chooseExternalTpp(dstView.size), 128};
+        auto config = getLaunchConfig("local", pv1, pv2, dstView.size, defaultConfig, getExternalCandidates(), stream);
+        const int nth = config.nthreads;
+
+        if (compressedStorage)
+        {
+            if (needDst)
+                computeExternalCompressed<InteractionOut::NeedAcc, InteractionOut::NoAcc,   InteractionMode::RowWise>
+                    (config, dstView, cl2, srcView, pair, compressedLocal, stream, CompressionSupported{});
+            else
+                computeExternalCompressed<InteractionOut::NoAcc,   InteractionOut::NeedAcc, InteractionMode::RowWise>
+                    (config, dstView, cl2, srcView, pair, compressedLocal, stream, CompressionSupported{});
         }
+        else
+        {
+            if (needDst)
+                launchExternalSpecialized<InteractionOut::NeedAcc, InteractionOut::NoAcc,   InteractionMode::RowWise>
+                    (config.variant, nth, dstView, cl2, srcView, pair, stream);
+            else
+                launchExternalSpecialized<InteractionOut::NoAcc,   InteractionOut::NeedAcc, InteractionMode::RowWise>
+                    (config.variant, nth, dstView, cl2, srcView, pair, stream);
+        }
+
+        endLaunch("local", pv1, pv2, dstView.size, stream);
+    }
+
+    /**
+     * Compute the self interactions of the particles of \p pv in the cells of \p region,
+     * with the tiled kernel if \p forceTiled
+     */
+    void computeSelf(ParticleVector *pv, CellList *cl, CellRegion region, bool forceTiled, cudaStream_t stream)
+    {
+        if (!needOutput(pv)) return;
+
+        auto& pair = getPairwiseInteraction(pv->name, pv->name);
+        using ViewType = typename PairwiseInteraction::ViewType;
+
+        pair.setup(pv->local(), pv->local(), cl, cl, state);
+
+        auto view = cl->getView<ViewType>();
+        const int np = view.size;
+        debug("Computing internal forces for %s (%d particles)%s", pv->name.c_str(), np,
+              forceTiled ? ", interior" : "");
+
+        const int nth = 128;
+        const bool packed = PackedHandler::applicable(view, view);
+
+        auto nlist = getNeighborList(cl);
+        if (nlist != nullptr)
+        {
+            nlist->update(cl, stream);
+            if (packed) launchSelfNeighborList(nlist, PackedView(view), PackedHandler(pair.handler()), stream);
+            else        launchSelfNeighborList(nlist, view, pair.handler(), stream);
+            return;
+        }
+
+        const std::string kind = forceTiled ? "interior" : "local";
+        const KernelLaunchConfig defaultConfig {(tiledKernels || forceTiled) ? SelfVariant::Tiled : SelfVariant::Cells, nth};
+
+        KernelLaunchConfig config = defaultConfig;
+        if (!forceTiled)
+            config = getLaunchConfig(kind, pv, pv, np, defaultConfig, getSelfCandidates(), stream);
+
+        if (packed) launchSelf(config, cl, PackedView(view), PackedHandler(pair.handler()), region, stream);
+        else        launchSelf(config, cl, view, pair.handler(), region, stream);
+
+        if (!forceTiled)
+            endLaunch(kind, pv, pv, np, stream);
+    }
+
+    /**
+     * Compute the local interactions of computeLocal() with the periodic images of the source particles,
+     * see computeSelfInteractionsPeriodic(). Takes precedence over the neighbor lists, the tiled kernels
+     * and the compressed storage; the interior computed early by localInterior() is not affected
+     */
+    void computeLocalPeriodic(ParticleVector* pv1, ParticleVector* pv2, CellList* cl1, CellList* cl2, cudaStream_t stream)
+    {
+        if (cl2->ncells.x < 3 || cl2->ncells.y < 3 || cl2->ncells.z < 3)
+            die("Interaction '%s' needs at least 3 cells per dimension of '%s' to use the periodic images, got %d x %d x %d",
+                name.c_str(), pv2->name.c_str(), cl2->ncells.x, cl2->ncells.y, cl2->ncells.z);
+
+        auto& pair = getPairwiseInteraction(pv1->name, pv2->name);
+        using ViewType = typename PairwiseInteraction::ViewType;
+
+        pair.setup(pv1->local(), pv2->local(), cl1, cl2, state);
+
+        auto dstView = cl1->getView<ViewType>();
+        auto srcView = cl2->getView<ViewType>();
+
+        const int np1 = dstView.size;
+        const int np2 = srcView.size;
+        debug("Computing periodic forces for %s - %s (%d - %d particles)", pv1->name.c_str(), pv2->name.c_str(), np1, np2);
+
+        if (np1 == 0 || np2 == 0) return;
+
+        const int nth = 128;
+        const bool packed = PackedHandler::applicable(dstView, srcView);
+
+        if (pv1 == pv2)
+        {
+            const bool split = interiorMargins.find(cl1) != interiorMargins.end();
+            const CellRegion region = split ? getInteriorRegion(cl1, false) : CellRegion();
+
+            if (packed)
+                SAFE_KERNEL_LAUNCH(
+                        computeSelfInteractionsPeriodic,
+                        getNblocks(np1, nth), nth, 0, stream,
+                        cl1->cellInfo(), PackedView(dstView), rc*rc, PackedHandler(pair.handler()), region);
+            else
+                SAFE_KERNEL_LAUNCH(
+                        computeSelfInteractionsPeriodic,
+                        getNblocks(np1, nth), nth, 0, stream,
+                        cl1->cellInfo(), dstView, rc*rc, pair.handler(), region);
+        }
+        else
+        {
+            if (packed)
+                SAFE_KERNEL_LAUNCH(
+                        computeExternalInteractionsPeriodic,
+                        getNblocks(np1, nth), nth, 0, stream,
+                        PackedView(dstView), cl2->cellInfo(), PackedView(srcView), rc*rc, PackedHandler(pair.handler()));
+            else
+                SAFE_KERNEL_LAUNCH(
+                        computeExternalInteractionsPeriodic,
+                        getNblocks(np1, nth), nth, 0, stream,
+                        dstView, cl2->cellInfo(), srcView, rc*rc, pair.handler());
+        }
+    }
+
+    /// cells further than the interior margin of \p cl from the subdomain boundary if \p inside, the others otherwise
+    CellRegion getInteriorRegion(CellList *cl, bool inside) const
+    {
+        const float margin = interiorMargins.at(cl);
+
+        CellRegion region;
+        region.lo = make_int3( (int) std::ceil(margin * cl->invh.x),
+                               (int) std::ceil(margin * cl->invh.y),
+                               (int) std::ceil(margin * cl->invh.z) );
+        region.hi = cl->ncells - region.lo;
+        region.inside = inside;
+        return region;
     }
 
     /**
@@ -191,12 +720,69 @@ private:
         ViewType dstView(pv1, pv1->halo());
         auto srcView = cl2->getView<ViewType>();
         
-        const int nth = 128;
-        if (np1 > 0 && np2 > 0)
-            if (dynamic_cast<ObjectVector*>(pv1) == nullptr) // don't need forces for pure particle halo
-                CHOOSE_EXTERNAL(InteractionOut::NoAcc,   InteractionOut::NeedAcc, InteractionMode::Dilute, pair.handler() );
+        const bool needDstForces = dynamic_cast<ObjectVector*>(pv1) != nullptr; // don't need forces for pure particle halo
+        const bool needSrcForces = needOutput(pv2);
+
+        if (np1 > 0 && np2 > 0 && (needDstForces || needSrcForces))
+        {
+            const KernelLaunchConfig defaultConfig {chooseExternalTpp(dstView.size), 128};
+            auto config = getLaunchConfig("halo", pv1, pv2, dstView.size, defaultConfig, getExternalCandidates(), stream);
+            const int nth = config.nthreads;
+
+            if (compressedStorage)
+            {
+                if (needDstForces && !needSrcForces)
+                    computeExternalCompressed<InteractionOut::NeedAcc, InteractionOut::NoAcc,   InteractionMode::Dilute>
+                        (config, dstView, cl2, srcView, pair, compressedHalo, stream, CompressionSupported{});
+                else if (needDstForces)
+                    computeExternalCompressed<InteractionOut::NeedAcc, InteractionOut::NeedAcc, InteractionMode::Dilute>
+                        (config, dstView, cl2, srcView, pair, compressedHalo, stream, CompressionSupported{});
+                else
+                    computeExternalCompressed<InteractionOut::NoAcc,   InteractionOut::NeedAcc, InteractionMode::Dilute>
+                        (config, dstView, cl2, srcView, pair, compressedHalo, stream, CompressionSupported{});
+            }
             else
-                CHOOSE_EXTERNAL(InteractionOut::NeedAcc, InteractionOut::NeedAcc, InteractionMode::Dilute, pair.handler() );
+            {
+                if (needDstForces && !needSrcForces)
+                    launchExternalSpecialized<InteractionOut::NeedAcc, InteractionOut::NoAcc,   InteractionMode::Dilute>
+                        (config.variant, nth, dstView, cl2, srcView, pair, stream);
+                else if (needDstForces)
+                    launchExternalSpecialized<InteractionOut::NeedAcc, InteractionOut::NeedAcc, InteractionMode::Dilute>
+                        (config.variant, nth, dstView, cl2, srcView, pair, stream);
+                else
+                    launchExternalSpecialized<InteractionOut::NoAcc,   InteractionOut::NeedAcc, InteractionMode::Dilute>
+                        (config.variant, nth, dstView, cl2, srcView, pair, stream);
+            }
+
+            endLaunch("halo", pv1, pv2, dstView.size, stream);
+        }
+    }
+
+    /**
+     * Get the neighbor list associated with \p cl, create it if needed.
+     * Neighbor lists rely on the particles being reordered together with
+     * the cell-list, hence only work with PrimaryCellList.
+     *
+     * @return nullptr if neighbor lists are disabled or not applicable
+     */
+    NeighborList* getNeighborList(CellList *cl)
+    {
+        if (neighborListSkin < 0.0f) return nullptr;
+
+        auto it = neighborLists.find(cl);
+        if (it != neighborLists.end())
+            return it->second.get();
+
+        std::unique_ptr<NeighborList> nlist;
+        if (dynamic_cast<PrimaryCellList*>(cl) != nullptr)
+            nlist = std::make_unique<NeighborList>(rc, neighborListSkin);
+        else
+            warn("Interaction '%s' can only use neighbor lists with primary cell-lists, falling back to cell-lists",
+                 name.c_str());
+
+        auto ptr = nlist.get();
+        neighborLists[cl] = std::move(nlist);
+        return ptr;
     }
 
     PairwiseInteraction& getPairwiseInteraction(std::string pv1name, std::string pv2name)
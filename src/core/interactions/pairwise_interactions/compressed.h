@@ -0,0 +1,73 @@
+#pragma once
+
+#include "fetchers.h"
+
+#include <core/pvs/views/pv.h>
+#include <core/utils/cpu_gpu_defines.h>
+#include <core/utils/helper_math.h>
+#include <core/utils/quantization.h>
+
+#include <type_traits>
+
+/**
+ * Pack the particles of \p view into \p compressed, see PVviewCompressed.
+ * Coordinates are rounded to the closest point of the grid with spacing \p step
+ */
+static __global__ void compressParticles(PVview view, float3 lo, float3 step, uint4 *compressed)
+{
+    const int pid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (pid >= view.size) return;
+
+    const Particle p(view.particles, pid);
+    compressed[pid] = compressParticle(p, lo, step);
+}
+
+/**
+ * Handler wrapper that reads the source particles from the compressed
+ * storage of PVviewCompressed; the particles are decompressed in registers
+ * and the interaction itself is computed in full precision.
+ * Destination particles are read once per thread and use the full precision data.
+ * Velocities are always unpacked: they come with the same load as the coordinates.
+ *
+ * Only applicable to the handlers working with PVview and Particle.
+ */
+template <class Handler>
+class CompressedParticleFetcher : public Handler
+{
+public:
+
+    using ViewType     = PVviewCompressed;
+    using ParticleType = Particle;
+
+    static_assert(std::is_same<typename Handler::ViewType,     PVview>  ::value, "Compressed storage requires PVview");
+    static_assert(std::is_same<typename Handler::ParticleType, Particle>::value, "Compressed storage requires Particle");
+
+    CompressedParticleFetcher(const Handler& handler) :
+        Handler(handler)
+    {}
+
+    __D__ inline void readCoordinates(ParticleType& p, const ViewType& view, int id) const
+    {
+        if (view.compressed == nullptr)
+        {
+            Handler::readCoordinates(p, view, id);
+            return;
+        }
+
+        const uint4 c = view.compressed[id];
+        p.r = decompressCoordinates(c, view.lo, view.step);
+        p.i1 = c.w;
+    }
+
+    __D__ inline void readExtraData(ParticleType& p, const ViewType& view, int id) const
+    {
+        if (view.compressed == nullptr)
+        {
+            Handler::readExtraData(p, view, id);
+            return;
+        }
+
+        const uint4 c = view.compressed[id];
+        p.u = decompressVelocity(c);
+    }
+};
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <core/interactions/utils/tabulated_function.h>
+
 #include <cmath>
 
 class SimpleMDPDDensityKernel
@@ -7,7 +9,7 @@ class SimpleMDPDDensityKernel
 public:
     static constexpr float normalization = 15 / (2 * M_PI);
 
-    __D__ inline float operator()(float r, float inv_rc) const
+    __HD__ inline float operator()(float r, float inv_rc) const
     {
         float rm = (1.f - r * inv_rc) * inv_rc;
 
@@ -20,7 +22,7 @@ class WendlandC2DensityKernel
 public:
     static constexpr float normalization = 21.0 / (2.0 * M_PI);
 
-    __D__ inline float operator()(float r, float inv_rc) const
+    __HD__ inline float operator()(float r, float inv_rc) const
     {
         float r_ = r * inv_rc;
         float rm = 1.f - r_;
@@ -29,10 +31,40 @@ public:
         return normalization * rm2 * rm2 * (1 + 4 * r_);
     }
 
-    __D__ inline float derivative(float r, float inv_rc) const
+    __HD__ inline float derivative(float r, float inv_rc) const
     {
         float r_ = r * inv_rc;
         float rm = r_ - 1.f;
         return normalization * 20 * r_ * rm*rm*rm * inv_rc;
     }
 };
+
+/**
+ * WendlandC2DensityKernel and its derivative read from tables,
+ * see TabulatedFunctionHandler; r is assumed to be below rc
+ */
+class TabulatedWendlandC2DensityKernel
+{
+public:
+    static constexpr int defaultIntervals = 1024;
+
+    TabulatedWendlandC2DensityKernel(int nIntervals = defaultIntervals)
+    {
+        WendlandC2DensityKernel kernel;
+        w  = TabulatedFunctions::get("WendlandC2",            nIntervals, [kernel] (float x) { return kernel           (x, 1.0f); });
+        dw = TabulatedFunctions::get("WendlandC2_derivative", nIntervals, [kernel] (float x) { return kernel.derivative(x, 1.0f); });
+    }
+
+    __D__ inline float operator()(float r, float inv_rc) const
+    {
+        return w(r * inv_rc);
+    }
+
+    __D__ inline float derivative(float r, float inv_rc) const
+    {
+        return dw(r * inv_rc) * inv_rc;
+    }
+
+private:
+    TabulatedFunctionHandler w, dw;
+};
@@ -1,9 +1,11 @@
 #pragma once
 
 #include "fetchers.h"
+#include "random_force.h"
 
 #include <core/interactions/accumulators/force.h>
 #include <core/interactions/utils/step_random_gen.h>
+#include <core/utils/philox.h>
 #include <core/ymero_state.h>
 
 #include <random>
@@ -28,13 +30,14 @@ public:
     using ViewType     = PVview;
     using ParticleType = Particle;
     
-    PairwiseDPDHandler(float rc, float a, float gamma, float kbT, float dt, float power) :
+    PairwiseDPDHandler(float rc, float a, float gamma, float kbT, float dt, float power, bool counterRNG) :
         ParticleFetcherWithVelocity(rc),
         a(a),
         gamma(gamma),
-        power(power)
+        power(power),
+        counterRNG(counterRNG)
     {
-        sigma = sqrt(2 * gamma * kbT / dt);
+        sigma = RandomForceAmplitude(kbT, dt)(gamma);
         invrc = 1.0 / rc;
     }
     
@@ -53,7 +56,10 @@ public:
         const float3 du = dst.u - src.u;
         const float rdotv = dot(dr_r, du);
 
-        const float myrandnr = Logistic::mean0var1(seed, min(src.i1, dst.i1), max(src.i1, dst.i1));
+        // the counter-based numbers only depend on the pair and on the step
+        const float myrandnr = counterRNG ?
+            Philox::normal4(Philox::pairCounter(step, src.i1, dst.i1), key).x :
+            Logistic::mean0var1(seed, min(src.i1, dst.i1), max(src.i1, dst.i1));
 
         const float strength = a * argwr - (gamma * wr * rdotv + sigma * myrandnr) * wr;
 
@@ -67,6 +73,10 @@ protected:
     float a, gamma, sigma, power;
     float invrc;
     float seed;
+
+    bool counterRNG;
+    int step;
+    uint2 key;
 };
 
 class PairwiseDPD : public PairwiseDPDHandler
@@ -75,10 +85,13 @@ public:
 
     using HandlerType = PairwiseDPDHandler;
     
-    PairwiseDPD(float rc, float a, float gamma, float kbT, float dt, float power, long seed=42424242) :
-        PairwiseDPDHandler(rc, a, gamma, kbT, dt, power),
-        stepGen(seed)
-    {}
+    PairwiseDPD(float rc, float a, float gamma, float kbT, float dt, float power, bool counterRNG = false, long seed=42424242) :
+        PairwiseDPDHandler(rc, a, gamma, kbT, dt, power, counterRNG),
+        stepGen(seed),
+        amplitude(kbT, dt)
+    {
+        key = Philox::makeKey(seed);
+    }
 
     const HandlerType& handler() const
     {
@@ -88,9 +101,12 @@ public:
     void setup(LocalParticleVector* lpv1, LocalParticleVector* lpv2, CellList* cl1, CellList* cl2, const YmrState *state)
     {
         seed = stepGen.generate(state);
+        step = state->currentStep;
+        if (amplitude.update(state)) sigma = amplitude(gamma);
     }
 
 protected:
 
     StepRandomGen stepGen;
+    RandomForceAmplitude amplitude;
 };
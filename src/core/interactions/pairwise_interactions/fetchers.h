@@ -31,20 +31,24 @@ public:
         rc2(rc*rc)
     {}
 
-    __D__ inline ParticleType read(const ViewType& view, int id) const
+    template <class View>
+    __D__ inline ParticleType read(const View& view, int id) const
     {
         Particle p;
-        p.readCoordinate(view.particles, id);
+        view.readCoordinate(p, id);
         return p;
     }
 
-    __D__ inline ParticleType readNoCache(const ViewType& view, int id) const
+    template <class View>
+    __D__ inline ParticleType readNoCache(const View& view, int id) const
     {
-        return Particle(::readNoCache(view.particles + 2*id), make_float4(0.f, 0.f, 0.f, 0.f));
+        return Particle(::readNoCache(view.positionPtr(id)), make_float4(0.f, 0.f, 0.f, 0.f));
     }
     
-    __D__ inline void readCoordinates(ParticleType& p, const ViewType& view, int id) const { p.readCoordinate(view.particles, id); }
-    __D__ inline void readExtraData  (ParticleType& p, const ViewType& view, int id) const { /* no velocity here */ }
+    template <class View>
+    __D__ inline void readCoordinates(ParticleType& p, const View& view, int id) const { view.readCoordinate(p, id); }
+    template <class View>
+    __D__ inline void readExtraData  (ParticleType& p, const View& view, int id) const { /* no velocity here */ }
 
     __D__ inline bool withinCutoff(const ParticleType& src, const ParticleType& dst) const
     {
@@ -52,6 +56,9 @@ public:
     }
 
     __D__ inline float3 getPosition(const ParticleType& p) const {return p.r;}
+
+    /// move \p p to its periodic image, see computeSelfInteractionsPeriodic()
+    __D__ inline void shiftPosition(ParticleType& p, float3 shift) const {p.r += shift;}
     
 protected:
 
@@ -78,18 +85,22 @@ public:
         ParticleFetcher(rc)
     {}
 
-    __D__ inline ParticleType read(const ViewType& view, int id) const
+    template <class View>
+    __D__ inline ParticleType read(const View& view, int id) const
     {
         return {ParticleFetcher::read(view, id), view.mass};
     }
 
-    __D__ inline ParticleType readNoCache(const ViewType& view, int id) const
+    template <class View>
+    __D__ inline ParticleType readNoCache(const View& view, int id) const
     {
         return {ParticleFetcher::readNoCache(view, id), view.mass};
     }
 
-    __D__ inline void readCoordinates(ParticleType& p, const ViewType& view, int id) const { ParticleFetcher::readCoordinates(p.p, view, id); }
-    __D__ inline void readExtraData  (ParticleType& p, const ViewType& view, int id) const { p.m = view.mass; }
+    template <class View>
+    __D__ inline void readCoordinates(ParticleType& p, const View& view, int id) const { ParticleFetcher::readCoordinates(p.p, view, id); }
+    template <class View>
+    __D__ inline void readExtraData  (ParticleType& p, const View& view, int id) const { p.m = view.mass; }
 
     __D__ inline bool withinCutoff(const ParticleType& src, const ParticleType& dst) const
     {
@@ -97,6 +108,7 @@ public:
     }
 
     __D__ inline float3 getPosition(const ParticleType& p) const {return ParticleFetcher::getPosition(p.p);}
+    __D__ inline void shiftPosition(ParticleType& p, float3 shift) const {ParticleFetcher::shiftPosition(p.p, shift);}
 };
 
 /**
@@ -110,15 +122,24 @@ public:
         ParticleFetcher(rc)
     {}
 
-    __D__ inline ParticleType read(const ViewType& view, int id) const                     { return  Particle(view.particles, id); }
+    template <class View>
+    __D__ inline ParticleType read(const View& view, int id) const
+    {
+        Particle p;
+        view.readCoordinate(p, id);
+        p.readVelocity(view.particles, id);
+        return p;
+    }
 
-    __D__ inline ParticleType readNoCache(const ViewType& view, int id) const
+    template <class View>
+    __D__ inline ParticleType readNoCache(const View& view, int id) const
     {
-        return Particle(::readNoCache(view.particles + 2*id),
+        return Particle(::readNoCache(view.positionPtr(id)),
                         ::readNoCache(view.particles + 2*id + 1));
     }
 
-    __D__ inline void readExtraData  (ParticleType& p, const ViewType& view, int id) const { p.readVelocity  (view.particles, id); }
+    template <class View>
+    __D__ inline void readExtraData  (ParticleType& p, const View& view, int id) const { p.readVelocity  (view.particles, id); }
 };
 
 /**
@@ -141,24 +162,28 @@ public:
         ParticleFetcherWithVelocity(rc)
     {}
 
-    __D__ inline ParticleType read(const ViewType& view, int id) const
+    template <class View>
+    __D__ inline ParticleType read(const View& view, int id) const
     {
         return {ParticleFetcherWithVelocity::read(view, id),
                 view.densities[id]};
     }
 
-    __D__ inline ParticleType readNoCache(const ViewType& view, int id) const
+    template <class View>
+    __D__ inline ParticleType readNoCache(const View& view, int id) const
     {
         return {ParticleFetcherWithVelocity::readNoCache(view, id),
                 view.densities[id]};
     }
 
-    __D__ inline void readCoordinates(ParticleType& p, const ViewType& view, int id) const
+    template <class View>
+    __D__ inline void readCoordinates(ParticleType& p, const View& view, int id) const
     {
         ParticleFetcherWithVelocity::readCoordinates(p.p, view, id);
     }
     
-    __D__ inline void readExtraData  (ParticleType& p, const ViewType& view, int id) const
+    template <class View>
+    __D__ inline void readExtraData  (ParticleType& p, const View& view, int id) const
     {
         ParticleFetcherWithVelocity::readExtraData(p.p, view, id);
         p.d = view.densities[id];
@@ -170,4 +195,61 @@ public:
     }
 
     __D__ inline float3 getPosition(const ParticleType& p) const {return p.p.r;}
+    __D__ inline void shiftPosition(ParticleType& p, float3 shift) const {p.p.r += shift;}
+};
+
+/**
+ * fetcher of \p Fetcher that also reads the species index of the particles,
+ * see PVviewWithSpecies
+ */
+template <class Fetcher>
+class ParticleFetcherWithSpecies : public Fetcher
+{
+public:
+
+    struct ParticleWithSpecies
+    {
+        Particle p;
+        int s;
+    };
+
+    using ViewType     = PVviewWithSpecies;
+    using ParticleType = ParticleWithSpecies;
+
+    ParticleFetcherWithSpecies(float rc) :
+        Fetcher(rc)
+    {}
+
+    template <class View>
+    __D__ inline ParticleType read(const View& view, int id) const
+    {
+        return {Fetcher::read(view, id), view.species[id]};
+    }
+
+    template <class View>
+    __D__ inline ParticleType readNoCache(const View& view, int id) const
+    {
+        return {Fetcher::readNoCache(view, id), view.species[id]};
+    }
+
+    template <class View>
+    __D__ inline void readCoordinates(ParticleType& p, const View& view, int id) const
+    {
+        Fetcher::readCoordinates(p.p, view, id);
+    }
+
+    template <class View>
+    __D__ inline void readExtraData  (ParticleType& p, const View& view, int id) const
+    {
+        Fetcher::readExtraData(p.p, view, id);
+        p.s = view.species[id];
+    }
+
+    __D__ inline bool withinCutoff(const ParticleType& src, const ParticleType& dst) const
+    {
+        return Fetcher::withinCutoff(src.p, dst.p);
+    }
+
+    __D__ inline float3 getPosition(const ParticleType& p) const {return p.p.r;}
+    __D__ inline void shiftPosition(ParticleType& p, float3 shift) const {p.p.r += shift;}
 };
@@ -1,11 +1,15 @@
 #pragma once
 
 #include "fetchers.h"
+#include "random_force.h"
 
 #include <core/interactions/accumulators/force.h>
 #include <core/interactions/utils/step_random_gen.h>
+#include <core/interactions/utils/tabulated_function.h>
 #include <core/ymero_state.h>
 
+#include <cmath>
+#include <cstdio>
 #include <random>
 
 class CellList;
@@ -27,13 +31,22 @@ public:
     using ViewType     = PVviewWithDensities;
     using ParticleType = ParticleWithDensity;
     
-    PairwiseMDPDHandler(float rc, float rd, float a, float b, float gamma, float kbT, float dt, float power) :
+    /// the weight function is read from a table of \p powerIntervals intervals if it is positive
+    PairwiseMDPDHandler(float rc, float rd, float a, float b, float gamma, float kbT, float dt, float power, int powerIntervals = 0) :
         ParticleFetcherWithVelocityAndDensity(rc),
-        rd(rd), a(a), b(b), gamma(gamma), power(power)
+        rd(rd), a(a), b(b), gamma(gamma), power(power),
+        tabulatedPower(powerIntervals > 0)
     {
-        sigma = sqrt(2 * gamma * kbT / dt);
+        sigma = RandomForceAmplitude(kbT, dt)(gamma);
         invrc = 1.0 / rc;
         invrd = 1.0 / rd;
+
+        if (tabulatedPower)
+        {
+            char tableName[64];
+            snprintf(tableName, sizeof(tableName), "power_%.9g", power);
+            powerTable = TabulatedFunctions::get(tableName, powerIntervals, [power] (float x) { return std::pow(x, power); });
+        }
     }
 
     __D__ inline float3 operator()(const ParticleType dst, int dstId, const ParticleType src, int srcId) const
@@ -47,7 +60,7 @@ public:
         float argwr = 1.0f - rij * invrc;
         float argwd = max(1.0f - rij * invrd, 0.f);
 
-        float wr = fastPower(argwr, power);
+        float wr = tabulatedPower ? powerTable(argwr) : fastPower(argwr, power);
 
         float3 dr_r = dr * invrij;
         float3 du = dst.p.u - src.p.u;
@@ -67,6 +80,9 @@ protected:
     float a, b, gamma, sigma, power, rd;
     float invrc, invrd;
     float seed;
+
+    bool tabulatedPower;
+    TabulatedFunctionHandler powerTable;
 };
 
 class PairwiseMDPD : public PairwiseMDPDHandler
@@ -75,9 +91,11 @@ public:
 
     using HandlerType = PairwiseMDPDHandler;
     
-    PairwiseMDPD(float rc, float rd, float a, float b, float gamma, float kbT, float dt, float power, long seed = 42424242) :
-        PairwiseMDPDHandler(rc, rd, a, b, gamma, kbT, dt, power),
-        stepGen(seed)
+    PairwiseMDPD(float rc, float rd, float a, float b, float gamma, float kbT, float dt, float power,
+                 int powerIntervals = 0, long seed = 42424242) :
+        PairwiseMDPDHandler(rc, rd, a, b, gamma, kbT, dt, power, powerIntervals),
+        stepGen(seed),
+        amplitude(kbT, dt)
     {}
 
     const HandlerType& handler() const
@@ -88,9 +106,11 @@ public:
     void setup(LocalParticleVector *lpv1, LocalParticleVector *lpv2, CellList *cl1, CellList *cl2, const YmrState *state)
     {
         seed = stepGen.generate(state);
+        if (amplitude.update(state)) sigma = amplitude(gamma);
     }
 
 protected:
 
     StepRandomGen stepGen;
+    RandomForceAmplitude amplitude;
 };
@@ -0,0 +1,232 @@
+#pragma once
+
+#include "dpd.h"
+#include "fetchers.h"
+#include "random_force.h"
+
+#include <core/interactions/accumulators/force.h>
+#include <core/interactions/utils/step_random_gen.h>
+#include <core/logger.h>
+#include <core/utils/philox.h>
+#include <core/ymero_state.h>
+
+#include <vector>
+
+class CellList;
+class LocalParticleVector;
+
+/**
+ * Coefficients of every pair of species, stored by value in the handlers:
+ * they are passed with the kernel parameters and thus read from the constant memory.
+ * The matrices are symmetric, the caller checks that the species are below maxSpecies
+ */
+struct SpeciesPairs
+{
+    static const int maxSpecies = 8;
+
+    using Matrix = std::vector<std::vector<float>>;
+
+    /// size of the square \p m, or die if it is not square, empty or too large
+    static int checkedSize(const Matrix& m, const char *what)
+    {
+        const int n = m.size();
+        if (n < 1 || n > maxSpecies)
+            die("The matrix of '%s' must have 1 to %d rows, got %d", what, maxSpecies, n);
+
+        for (int i = 0; i < n; i++)
+        {
+            if ((int) m[i].size() != n)
+                die("The matrix of '%s' must be square, row %d has %d entries instead of %d",
+                    what, i, (int) m[i].size(), n);
+
+            for (int j = 0; j < i; j++)
+                if (m[i][j] != m[j][i])
+                    die("The matrix of '%s' must be symmetric, entries (%d, %d) and (%d, %d) differ",
+                        what, i, j, j, i);
+        }
+
+        return n;
+    }
+
+    __HD__ static inline int id(int s1, int s2) { return s1 * maxSpecies + s2; }
+};
+
+
+/**
+ * Same as PairwiseDPDHandler, with the coefficients given per pair of species
+ */
+class PairwiseDPDMultiSpeciesHandler : public ParticleFetcherWithSpecies<ParticleFetcherWithVelocity>
+{
+public:
+
+    using Fetcher = ParticleFetcherWithSpecies<ParticleFetcherWithVelocity>;
+
+    using ViewType     = Fetcher::ViewType;
+    using ParticleType = Fetcher::ParticleType;
+
+    PairwiseDPDMultiSpeciesHandler(float rc, const SpeciesPairs::Matrix& a, const SpeciesPairs::Matrix& gamma,
+                                   float kbT, float dt, const SpeciesPairs::Matrix& power, bool counterRNG) :
+        Fetcher(rc),
+        counterRNG(counterRNG)
+    {
+        const int n = SpeciesPairs::checkedSize(a, "a");
+        if (SpeciesPairs::checkedSize(gamma, "gamma") != n || SpeciesPairs::checkedSize(power, "power") != n)
+            die("The matrices of a, gamma and power must have the same size");
+
+        for (int i = 0; i < n; i++)
+            for (int j = 0; j < n; j++)
+            {
+                const int id = SpeciesPairs::id(i, j);
+                this->a    [id] = a[i][j];
+                this->gamma[id] = gamma[i][j];
+                this->sigma[id] = RandomForceAmplitude(kbT, dt)(gamma[i][j]);
+                this->power[id] = power[i][j];
+            }
+
+        invrc = 1.0 / rc;
+    }
+
+    __D__ inline float3 operator()(const ParticleType dst, int dstId, const ParticleType src, int srcId) const
+    {
+        const float3 dr = dst.p.r - src.p.r;
+        const float rij2 = dot(dr, dr);
+        if (rij2 > rc2) return make_float3(0.0f);
+
+        const int id = SpeciesPairs::id(dst.s, src.s);
+
+        const float invrij = rsqrtf(rij2);
+        const float rij = rij2 * invrij;
+        const float argwr = 1.0f - rij * invrc;
+        const float wr = fastPower(argwr, power[id]);
+
+        const float3 dr_r = dr * invrij;
+        const float3 du = dst.p.u - src.p.u;
+        const float rdotv = dot(dr_r, du);
+
+        const float myrandnr = counterRNG ?
+            Philox::normal4(Philox::pairCounter(step, src.p.i1, dst.p.i1), key).x :
+            Logistic::mean0var1(seed, min(src.p.i1, dst.p.i1), max(src.p.i1, dst.p.i1));
+
+        const float strength = a[id] * argwr - (gamma[id] * wr * rdotv + sigma[id] * myrandnr) * wr;
+
+        return dr_r * strength;
+    }
+
+    __D__ inline ForceAccumulator getZeroedAccumulator() const {return ForceAccumulator();}
+
+protected:
+
+    static const int maxPairs = SpeciesPairs::maxSpecies * SpeciesPairs::maxSpecies;
+
+    float a[maxPairs] {}, gamma[maxPairs] {}, sigma[maxPairs] {}, power[maxPairs] {};
+    float invrc;
+    float seed;
+
+    bool counterRNG;
+    int step;
+    uint2 key;
+};
+
+class PairwiseDPDMultiSpecies : public PairwiseDPDMultiSpeciesHandler
+{
+public:
+
+    using HandlerType = PairwiseDPDMultiSpeciesHandler;
+
+    PairwiseDPDMultiSpecies(float rc, const SpeciesPairs::Matrix& a, const SpeciesPairs::Matrix& gamma,
+                            float kbT, float dt, const SpeciesPairs::Matrix& power,
+                            bool counterRNG = false, long seed=42424242) :
+        PairwiseDPDMultiSpeciesHandler(rc, a, gamma, kbT, dt, power, counterRNG),
+        stepGen(seed),
+        amplitude(kbT, dt)
+    {
+        key = Philox::makeKey(seed);
+    }
+
+    const HandlerType& handler() const
+    {
+        return (const HandlerType&)(*this);
+    }
+
+    void setup(LocalParticleVector* lpv1, LocalParticleVector* lpv2, CellList* cl1, CellList* cl2, const YmrState *state)
+    {
+        seed = stepGen.generate(state);
+        step = state->currentStep;
+        if (amplitude.update(state))
+            for (int id = 0; id < maxPairs; id++)
+                sigma[id] = amplitude(gamma[id]);
+    }
+
+protected:
+
+    StepRandomGen stepGen;
+    RandomForceAmplitude amplitude;
+};
+
+
+/**
+ * Same as PairwiseLJ, with epsilon and sigma given per pair of species
+ */
+class PairwiseLJMultiSpecies : public ParticleFetcherWithSpecies<ParticleFetcher>
+{
+public:
+
+    using Fetcher = ParticleFetcherWithSpecies<ParticleFetcher>;
+
+    using ViewType     = Fetcher::ViewType;
+    using ParticleType = Fetcher::ParticleType;
+    using HandlerType  = PairwiseLJMultiSpecies;
+
+    PairwiseLJMultiSpecies(float rc, const SpeciesPairs::Matrix& epsilon, const SpeciesPairs::Matrix& sigma, float maxForce) :
+        Fetcher(rc),
+        maxForce(maxForce)
+    {
+        const int n = SpeciesPairs::checkedSize(epsilon, "epsilon");
+        if (SpeciesPairs::checkedSize(sigma, "sigma") != n)
+            die("The matrices of epsilon and sigma must have the same size");
+
+        for (int i = 0; i < n; i++)
+            for (int j = 0; j < n; j++)
+            {
+                const int id = SpeciesPairs::id(i, j);
+                sigma2      [id] = sigma[i][j] * sigma[i][j];
+                epsx24_sigma[id] = 24.0 * epsilon[i][j] / sigma[i][j];
+            }
+    }
+
+    __D__ inline float3 operator()(ParticleType dst, int dstId, ParticleType src, int srcId) const
+    {
+        const float3 dr = dst.p.r - src.p.r;
+        const float rij2 = dot(dr, dr);
+
+        if (rij2 > rc2) return make_float3(0.0f);
+
+        const int id = SpeciesPairs::id(dst.s, src.s);
+
+        const float rs2 = sigma2[id] / rij2;
+        const float rs4 = rs2*rs2;
+        const float rs8 = rs4*rs4;
+        const float rs14 = rs8*rs4*rs2;
+
+        const float IfI = epsx24_sigma[id] * (2*rs14 - rs8);
+
+        return dr * min(max(IfI, 0.0f), maxForce);
+    }
+
+    __D__ inline ForceAccumulator getZeroedAccumulator() const {return ForceAccumulator();}
+
+    const HandlerType& handler() const
+    {
+        return (const HandlerType&) (*this);
+    }
+
+    void setup(LocalParticleVector* pv1, LocalParticleVector* pv2, CellList* cl1, CellList* cl2, const YmrState *state)
+    {}
+
+private:
+
+    static const int maxPairs = SpeciesPairs::maxSpecies * SpeciesPairs::maxSpecies;
+
+    float sigma2[maxPairs] {}, epsx24_sigma[maxPairs] {};
+    float maxForce;
+};
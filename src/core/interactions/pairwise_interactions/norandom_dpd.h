@@ -1,6 +1,7 @@
 #pragma once
 
 #include "fetchers.h"
+#include "random_force.h"
 
 #include <core/interactions/accumulators/force.h>
 #include <core/ymero_state.h>
@@ -23,9 +24,10 @@ public:
         ParticleFetcherWithVelocity(rc),
         a(a),
         gamma(gamma),
-        power(power)
+        power(power),
+        amplitude(kbT, dt)
     {
-        sigma = sqrt(2 * gamma * kbT / dt);
+        sigma = amplitude(gamma);
         invrc = 1.0 / rc;
     }
 
@@ -59,11 +61,14 @@ public:
     }
     
     void setup(LocalParticleVector* lpv1, LocalParticleVector* lpv2, CellList* cl1, CellList* cl2, const YmrState *state)
-    {}
+    {
+        if (amplitude.update(state)) sigma = amplitude(gamma);
+    }
 
 protected:
 
     float a, gamma, sigma, power;
     float invrc;
+    RandomForceAmplitude amplitude;
 };
 
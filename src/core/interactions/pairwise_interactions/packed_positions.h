@@ -0,0 +1,29 @@
+#pragma once
+
+#include <core/pvs/views/pv.h>
+
+/**
+ * Handler wrapper for the launches where the packed positions of both the
+ * destination and the source particles are up to date (see LocalParticleVector::positions).
+ * The kernels then get views of type PVviewPackedPositions: the templated fetchers
+ * of \p Handler read the coordinates from the packed array without checking at run time
+ * whether it is available, and do not keep the fallback address live.
+ */
+template <class Handler>
+class PackedPositionsFetcher : public Handler
+{
+public:
+
+    using ViewType = PVviewPackedPositions<typename Handler::ViewType>;
+
+    PackedPositionsFetcher(const Handler& handler) :
+        Handler(handler)
+    {}
+
+    /// true if the views of a launch can be specialized for the packed positions
+    template <class View>
+    static bool applicable(const View& dstView, const View& srcView)
+    {
+        return dstView.positions != nullptr && srcView.positions != nullptr;
+    }
+};
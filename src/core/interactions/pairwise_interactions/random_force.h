@@ -0,0 +1,36 @@
+#pragma once
+
+#include <core/ymero_state.h>
+
+#include <cmath>
+
+/**
+ * Amplitude sqrt(2 * friction * kBT / dt) of the random forces of the DPD-like interactions.
+ * The time step of the state may change during the run, e.g. in the sub-steps of IntegratorSubStep:
+ * the amplitude is then computed again from the coefficients, never rescaled from its previous value,
+ * so that no rounding error builds up
+ */
+class RandomForceAmplitude
+{
+public:
+    RandomForceAmplitude(float kBT, float dt) :
+        kBT(kBT), dt(dt)
+    {}
+
+    /// amplitude for the friction coefficient \p friction at the current time step
+    float operator()(float friction) const
+    {
+        return sqrt(2 * friction * kBT / dt);
+    }
+
+    /// follow the time step of \p state, @return true if it changed since the last call
+    bool update(const YmrState *state)
+    {
+        if (state->dt == dt) return false;
+        dt = state->dt;
+        return true;
+    }
+
+private:
+    float kBT, dt;
+};
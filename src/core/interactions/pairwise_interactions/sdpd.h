@@ -3,6 +3,7 @@
 #include "fetchers.h"
 #include "pressure_EOS.h"
 #include "density_kernels.h"
+#include "random_force.h"
 
 #include <core/interactions/accumulators/force.h>
 #include <core/interactions/utils/step_random_gen.h>
@@ -13,41 +14,82 @@
 class CellList;
 class LocalParticleVector;
 
+/**
+ * The density only enters the forces through 1/d^2 and p(d)/d^2:
+ * they are evaluated once per fetched particle instead of once per pair
+ */
 template <typename PressureEOS, typename DensityKernel>
-class PairwiseSDPDHandler : public ParticleFetcherWithVelocityAndDensity
+class PairwiseSDPDHandler : public ParticleFetcherWithVelocity
 {
 public:
 
     static constexpr float zeta = 3 + 2;
+
+    struct ParticleWithPressure
+    {
+        Particle p;
+        float inv_dsq;   ///< 1 / d^2
+        float p_inv_dsq; ///< p(d) / d^2
+    };
     
     using ViewType     = PVviewWithDensities;
-    using ParticleType = ParticleWithDensity;
+    using ParticleType = ParticleWithPressure;
     
     PairwiseSDPDHandler(float rc, PressureEOS pressure, DensityKernel densityKernel, float viscosity, float kBT, float dt) :
-        ParticleFetcherWithVelocityAndDensity(rc),
+        ParticleFetcherWithVelocity(rc),
         pressure(pressure),
         densityKernel(densityKernel),
-        fRfact(sqrt(2 * zeta * viscosity * kBT / dt)),
+        fRfact(RandomForceAmplitude(kBT, dt)(zeta * viscosity)),
         fDfact(viscosity * zeta)
     {
         inv_rc = 1.0 / rc;
     }
 
+    template <class View>
+    __D__ inline ParticleType read(const View& view, int id) const
+    {
+        ParticleType p;
+        p.p = ParticleFetcherWithVelocity::read(view, id);
+        setDensity(p, view.densities[id]);
+        return p;
+    }
+
+    template <class View>
+    __D__ inline ParticleType readNoCache(const View& view, int id) const
+    {
+        ParticleType p;
+        p.p = ParticleFetcherWithVelocity::readNoCache(view, id);
+        setDensity(p, view.densities[id]);
+        return p;
+    }
+
+    template <class View>
+    __D__ inline void readCoordinates(ParticleType& p, const View& view, int id) const
+    {
+        ParticleFetcherWithVelocity::readCoordinates(p.p, view, id);
+    }
+    
+    template <class View>
+    __D__ inline void readExtraData  (ParticleType& p, const View& view, int id) const
+    {
+        ParticleFetcherWithVelocity::readExtraData(p.p, view, id);
+        setDensity(p, view.densities[id]);
+    }
+
+    __D__ inline bool withinCutoff(const ParticleType& src, const ParticleType& dst) const
+    {
+        return ParticleFetcherWithVelocity::withinCutoff(src.p, dst.p);
+    }
+
+    __D__ inline float3 getPosition(const ParticleType& p) const {return p.p.r;}
+    __D__ inline void shiftPosition(ParticleType& p, float3 shift) const {p.p.r += shift;}
+
     __D__ inline float3 operator()(const ParticleType dst, int dstId, const ParticleType src, int srcId) const
     {        
         float3 dr = dst.p.r - src.p.r;
         float rij2 = dot(dr, dr);
         if (rij2 > rc2) return make_float3(0.0f);
         
-        float di = dst.d;
-        float dj = src.d;
-        
-        float pi = pressure(di);
-        float pj = pressure(dj);
-
-        float inv_disq = 1.f / (di * di);
-        float inv_djsq = 1.f / (dj * dj);
-
         float inv_rij = rsqrtf(rij2);
         float rij = rij2 * inv_rij;
         float dWdr = densityKernel.derivative(rij, inv_rc);
@@ -58,8 +100,8 @@ public:
 
         float myrandnr = Logistic::mean0var1(seed, min(src.p.i1, dst.p.i1), max(src.p.i1, dst.p.i1));
 
-        float Aij = (inv_disq + inv_djsq) * dWdr;
-        float fC = - (inv_disq * pi + inv_djsq * pj) * dWdr;
+        float Aij = (dst.inv_dsq + src.inv_dsq) * dWdr;
+        float fC = - (dst.p_inv_dsq + src.p_inv_dsq) * dWdr;
         float fD = fDfact *        Aij * inv_rij  * erdotdu;
         float fR = fRfact * sqrtf(-Aij * inv_rij) * myrandnr;
         
@@ -70,6 +112,12 @@ public:
 
 protected:
 
+    __D__ inline void setDensity(ParticleType& p, float d) const
+    {
+        p.inv_dsq   = 1.f / (d * d);
+        p.p_inv_dsq = pressure(d) * p.inv_dsq;
+    }
+
     float inv_rc;
     float seed;
     PressureEOS pressure;
@@ -86,7 +134,8 @@ public:
     
     PairwiseSDPD(float rc, PressureEOS pressure, DensityKernel densityKernel, float viscosity, float kBT, float dt, long seed = 42424242) :
         PairwiseSDPDHandler<PressureEOS, DensityKernel>(rc, pressure, densityKernel, viscosity, kBT, dt),
-        stepGen(seed)
+        stepGen(seed),
+        amplitude(kBT, dt)
     {}
 
     const HandlerType& handler() const
@@ -97,9 +146,11 @@ public:
     void setup(LocalParticleVector *lpv1, LocalParticleVector *lpv2, CellList *cl1, CellList *cl2, const YmrState *state)
     {
         this->seed = stepGen.generate(state);
+        if (amplitude.update(state)) this->fRfact = amplitude(this->fDfact);
     }
 
 protected:
 
-    StepRandomGen stepGen;    
+    StepRandomGen stepGen;
+    RandomForceAmplitude amplitude;
 };
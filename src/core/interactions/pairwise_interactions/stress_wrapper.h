@@ -10,6 +10,10 @@
 class LocalParticleVector;
 class CellList;
 
+/**
+ * Forces and stresses of the wrapped handler; the stresses are only
+ * computed and accumulated if \p computeStress, same for the whole launch
+ */
 template<typename BasicPairwiseForceHandler>
 class PairwiseStressWrapperHandler : public BasicPairwiseForceHandler
 {
@@ -19,27 +23,36 @@ public:
     using ViewType      = PVviewWithStresses<BasicViewType>;
     using ParticleType  = typename BasicPairwiseForceHandler::ParticleType;
     
-    PairwiseStressWrapperHandler(BasicPairwiseForceHandler basicForceHandler) :
-        BasicPairwiseForceHandler(basicForceHandler)
+    PairwiseStressWrapperHandler(BasicPairwiseForceHandler basicForceHandler, bool computeStress = true) :
+        BasicPairwiseForceHandler(basicForceHandler),
+        computeStress(computeStress)
     {}
     
     __device__ inline ForceStress operator()(const ParticleType dst, int dstId, const ParticleType src, int srcId) const
     {        
-        float3 dr = getPosition(dst) - getPosition(src);
         float3 f  = BasicPairwiseForceHandler::operator()(dst, dstId, src, srcId);
-        Stress s;
-        
-        s.xx = 0.5f * dr.x * f.x;
-        s.xy = 0.5f * dr.x * f.y;
-        s.xz = 0.5f * dr.x * f.z;
-        s.yy = 0.5f * dr.y * f.y;
-        s.yz = 0.5f * dr.y * f.z;
-        s.zz = 0.5f * dr.z * f.z;        
+        Stress s {0.f, 0.f, 0.f, 0.f, 0.f, 0.f};
+
+        if (computeStress)
+        {
+            float3 dr = getPosition(dst) - getPosition(src);
+
+            s.xx = 0.5f * dr.x * f.x;
+            s.xy = 0.5f * dr.x * f.y;
+            s.xz = 0.5f * dr.x * f.z;
+            s.yy = 0.5f * dr.y * f.y;
+            s.yz = 0.5f * dr.y * f.z;
+            s.zz = 0.5f * dr.z * f.z;
+        }
 
         return {f, s};
     }
 
-    __D__ inline ForceStressAccumulator<BasicViewType> getZeroedAccumulator() const {return ForceStressAccumulator<BasicViewType>();}
+    __D__ inline ForceStressAccumulator<BasicViewType> getZeroedAccumulator() const {return ForceStressAccumulator<BasicViewType>(computeStress);}
+
+protected:
+
+    bool computeStress;
 };
 
 template<typename BasicPairwiseForce>
@@ -53,15 +66,17 @@ public:
     using ViewType     = typename HandlerType::ViewType;
     using ParticleType = typename HandlerType::ParticleType;
 
-    PairwiseStressWrapper(BasicPairwiseForce basicForce) :
+    /// the stresses are computed by the launches that follow a setup() with *\p computeStress true, always if nullptr
+    PairwiseStressWrapper(BasicPairwiseForce basicForce, const bool *computeStress = nullptr) :
         BasicPairwiseForce(basicForce),
-        basicForceWrapperHandler(basicForce.handler())
+        basicForceWrapperHandler(basicForce.handler()),
+        computeStress(computeStress)
     {}
 
     void setup(LocalParticleVector *lpv1, LocalParticleVector *lpv2, CellList *cl1, CellList *cl2, const YmrState *state)
     {
         BasicPairwiseForce::setup(lpv1, lpv2, cl1, cl2, state);
-        basicForceWrapperHandler = HandlerType(BasicPairwiseForce::handler());
+        basicForceWrapperHandler = HandlerType(BasicPairwiseForce::handler(), computeStress == nullptr || *computeStress);
     }
 
     const HandlerType& handler() const
@@ -71,4 +86,5 @@ public:
     
 protected:
     HandlerType basicForceWrapperHandler;
+    const bool *computeStress;
 };
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "type_traits.h"
+
+#include <core/utils/cpu_gpu_defines.h>
+
+#include <type_traits>
+#include <utility>
+
+class CellList;
+class LocalParticleVector;
+class YmrState;
+
+/**
+ * Handler computing the sum of two pairwise interactions in one traversal of the cell-lists.
+ * Both must work with the same view and particle types and produce the same
+ * accumulator; particles are fetched once with the data required by both.
+ */
+template <class Handler1, class Handler2>
+class PairwiseSumHandler
+{
+public:
+
+    using ViewType     = typename Handler1::ViewType;
+    using ParticleType = typename Handler1::ParticleType;
+
+    using OutputType      = decltype(std::declval<const Handler1>()(std::declval<ParticleType>(), 0, std::declval<ParticleType>(), 0));
+    using AccumulatorType = decltype(std::declval<const Handler1>().getZeroedAccumulator());
+
+    static_assert(std::is_same<ViewType,     typename Handler2::ViewType>    ::value, "Summed interactions must have the same view type");
+    static_assert(std::is_same<ParticleType, typename Handler2::ParticleType>::value, "Summed interactions must have the same particle type");
+
+    PairwiseSumHandler(const Handler1& h1, const Handler2& h2) :
+        h1(h1), h2(h2)
+    {}
+
+    template <class View>
+    __D__ inline ParticleType read(const View& view, int id) const
+    {
+        auto p = h1.read(view, id);
+        h2.readExtraData(p, view, id);
+        return p;
+    }
+
+    template <class View>
+    __D__ inline ParticleType readNoCache(const View& view, int id) const
+    {
+        auto p = h1.readNoCache(view, id);
+        h2.readExtraData(p, view, id);
+        return p;
+    }
+
+    template <class View>
+    __D__ inline void readCoordinates(ParticleType& p, const View& view, int id) const { h1.readCoordinates(p, view, id); }
+
+    template <class View>
+    __D__ inline void readExtraData(ParticleType& p, const View& view, int id) const
+    {
+        h1.readExtraData(p, view, id);
+        h2.readExtraData(p, view, id);
+    }
+
+    __D__ inline bool withinCutoff(const ParticleType& src, const ParticleType& dst) const
+    {
+        return h1.withinCutoff(src, dst) || h2.withinCutoff(src, dst);
+    }
+
+    __D__ inline float3 getPosition(const ParticleType& p) const {return h1.getPosition(p);}
+    __D__ inline void shiftPosition(ParticleType& p, float3 shift) const {h1.shiftPosition(p, shift);}
+
+    // each interaction discards the pairs beyond its own cut-off
+    __D__ inline OutputType operator()(const ParticleType dst, int dstId, const ParticleType src, int srcId) const
+    {
+        return h1(dst, dstId, src, srcId) + h2(dst, dstId, src, srcId);
+    }
+
+    __D__ inline AccumulatorType getZeroedAccumulator() const
+    {
+        return h1.getZeroedAccumulator();
+    }
+
+protected:
+
+    Handler1 h1;
+    Handler2 h2;
+};
+
+/**
+ * Sum of two pairwise interactions (see PairwiseSumHandler)
+ */
+template <class Pairwise1, class Pairwise2>
+class PairwiseSum
+{
+public:
+
+    using Handler1 = typename Pairwise1::HandlerType;
+    using Handler2 = typename Pairwise2::HandlerType;
+
+    using ViewType     = typename Handler1::ViewType;
+    using ParticleType = typename Handler1::ParticleType;
+    using HandlerType  = PairwiseSumHandler<Handler1, Handler2>;
+
+    PairwiseSum(const Pairwise1& p1, const Pairwise2& p2) :
+        p1(p1), p2(p2)
+    {}
+
+    /// returns a copy: the handlers are taken after setup()
+    HandlerType handler() const
+    {
+        return HandlerType(p1.handler(), p2.handler());
+    }
+
+    void setup(LocalParticleVector* lpv1, LocalParticleVector* lpv2, CellList* cl1, CellList* cl2, const YmrState *state)
+    {
+        p1.setup(lpv1, lpv2, cl1, cl2, state);
+        p2.setup(lpv1, lpv2, cl1, cl2, state);
+    }
+
+protected:
+
+    Pairwise1 p1;
+    Pairwise2 p2;
+};
+
+template <typename H1, typename H2>
+struct needSelfInteraction<PairwiseSumHandler<H1, H2>>
+{ static const bool value = needSelfInteraction<H1>::value || needSelfInteraction<H2>::value; };
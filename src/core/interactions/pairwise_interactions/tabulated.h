@@ -0,0 +1,65 @@
+#pragma once
+
+#include "fetchers.h"
+
+#include <core/interactions/accumulators/force.h>
+#include <core/ymero_state.h>
+
+class LocalParticleVector;
+class CellList;
+
+/**
+ * Pairwise force of magnitude F(r), given as a table of \p nPoints values
+ * sampled uniformly on [0, rc] and linearly interpolated; positive F is repulsive.
+ * Any force law thus runs as fast as the built-in ones, without a new handler
+ * and its template instantiations.
+ * The table lives in device memory owned by the interaction
+ */
+class PairwiseTabulated : public ParticleFetcher
+{
+public:
+
+    using ViewType     = PVview;
+    using ParticleType = Particle;
+    using HandlerType  = PairwiseTabulated;
+    
+    PairwiseTabulated(float rc, const float *table, int nPoints) :
+        ParticleFetcher(rc),
+        table(table),
+        nPoints(nPoints),
+        invDr((nPoints - 1) / rc)
+    {}
+
+    __D__ inline float3 operator()(ParticleType dst, int dstId, ParticleType src, int srcId) const
+    {
+        const float3 dr = dst.r - src.r;
+        const float rij2 = dot(dr, dr);
+
+        if (rij2 > rc2 || rij2 < 1e-12f) return make_float3(0.0f);
+
+        const float invr = rsqrtf(rij2);
+        const float s = rij2 * invr * invDr;
+
+        const int i = min((int) s, nPoints - 2);
+        const float w = s - i;
+        const float IfI = (1.0f - w) * table[i] + w * table[i+1];
+
+        return dr * (IfI * invr);
+    }
+
+    __D__ inline ForceAccumulator getZeroedAccumulator() const {return ForceAccumulator();}
+
+    const HandlerType& handler() const
+    {
+        return (const HandlerType&) (*this);
+    }
+    
+    void setup(LocalParticleVector* pv1, LocalParticleVector* pv2, CellList* cl1, CellList* cl2, const YmrState *state)
+    {}
+
+private:
+
+    const float *table;
+    int nPoints;
+    float invDr;
+};
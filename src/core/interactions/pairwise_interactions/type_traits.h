@@ -13,3 +13,12 @@ struct needSelfInteraction<WendlandC2DensityKernel>
 template <typename T>
 struct needSelfInteraction<PairwiseDensity<T>>
 { static const bool value = needSelfInteraction<T>::value; };
+
+/// the outputs of the intermediate interactions are read by the final ones, also on the static particle vectors
+template <typename T>
+struct isIntermediateInteraction
+{ static const bool value = false; };
+
+template <typename T>
+struct isIntermediateInteraction<PairwiseDensity<T>>
+{ static const bool value = true; };
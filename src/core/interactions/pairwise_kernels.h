@@ -1,5 +1,6 @@
 #pragma once
 
+#include "neighbor_list.h"
 #include "pairwise_interactions/type_traits.h"
 
 #include <core/celllist.h>
@@ -8,6 +9,7 @@
 
 #include <cassert>
 #include <type_traits>
+#include <utility>
 
 enum class InteractionWith
 {
@@ -24,6 +26,25 @@ enum class InteractionMode
     RowWise, Dilute
 };
 
+/**
+ * Restrict the self interaction kernels to a box of cells [lo, hi)
+ * or to its complement, see InteractionPair::localInterior().
+ * The default region contains all the cells
+ */
+struct CellRegion
+{
+    int3 lo {0, 0, 0}, hi {0, 0, 0};
+    bool inside {false}; ///< true: only the cells of the box, false: only the cells outside of it
+
+    __device__ inline bool contains(int3 cell) const
+    {
+        const bool inBox = cell.x >= lo.x && cell.x < hi.x &&
+                           cell.y >= lo.y && cell.y < hi.y &&
+                           cell.z >= lo.z && cell.z < hi.z;
+        return inBox == inside;
+    }
+};
+
 /**
  * Compute interactions between one destination particle and
  * all source particles in a given cell, defined by range of ids:
@@ -106,21 +127,23 @@ __device__ inline void computeCell(
  *        \code float3 interaction(const Particle dst, int dstId, const Particle src, int srcId) \endcode
  *        The return value is the force acting on the first particle.
  *        The second one experiences the opposite force.
+ * @param region only the destination particles in these cells are processed
  */
 template<typename Interaction>
 __launch_bounds__(128, 16)
 __global__ void computeSelfInteractions(
         CellListInfo cinfo, typename Interaction::ViewType view,
-        const float rc2, Interaction interaction)
+        const float rc2, Interaction interaction, CellRegion region)
 {
     const int dstId = blockIdx.x*blockDim.x + threadIdx.x;
     if (dstId >= view.size) return;
 
     const auto dstP = interaction.read(view, dstId);
 
-    auto accumulator = interaction.getZeroedAccumulator();
-
     const int3 cell0 = cinfo.getCellIdAlongAxes(interaction.getPosition(dstP));
+    if (!region.contains(cell0)) return;
+
+    auto accumulator = interaction.getZeroedAccumulator();
 
     for (int cellZ = cell0.z-1; cellZ <= cell0.z+1; cellZ++)
     {
@@ -128,6 +151,28 @@ __global__ void computeSelfInteractions(
         {
             if ( !(cellY >= 0 && cellY < cinfo.ncells.y && cellZ >= 0 && cellZ < cinfo.ncells.z) ) continue;
             if (cellY == cell0.y && cellZ > cell0.z) continue;
+
+            if (!cinfo.isRowMajor())
+            {
+                // cells of the row are not contiguous, go one by one
+                const bool midRow = (cellY == cell0.y && cellZ == cell0.z);
+                const int cellXend = min(midRow ? cell0.x : cell0.x+1, cinfo.ncells.x-1);
+
+                for (int cellX = max(cell0.x-1, 0); cellX <= cellXend; cellX++)
+                {
+                    const int cid = cinfo.encode(cellX, cellY, cellZ);
+                    const int pstart = cinfo.cellStarts[cid];
+                    const int pend   = cinfo.cellStarts[cid+1];
+
+                    if (midRow && cellX == cell0.x)
+                        computeCell<InteractionOut::NeedAcc, InteractionOut::NeedAcc, InteractionWith::Self>
+                            (pstart, pend, dstP, dstId, view, rc2, interaction, accumulator);
+                    else
+                        computeCell<InteractionOut::NeedAcc, InteractionOut::NeedAcc, InteractionWith::Other>
+                            (pstart, pend, dstP, dstId, view, rc2, interaction, accumulator);
+                }
+                continue;
+            }
             
             const int midCellId = cinfo.encode(cell0.x, cellY, cellZ);
             int rowStart  = max(midCellId-1, 0);
@@ -154,6 +199,294 @@ __global__ void computeSelfInteractions(
 }
 
 
+/**
+ * Compute interactions within a single ParticleVector, one warp per non-empty cell,
+ * see CellListInfo::activeCell().
+ *
+ * The warp takes up to warpSize particles of its cell, one per lane, and
+ * goes over half of the neighbouring cells like computeSelfInteractions().
+ * Source particles of each cell are staged by the warp in shared memory,
+ * warpSize at a time, such that each of them is read from global memory
+ * once per chunk of destination particles instead of once per thread.
+ *
+ * Requires warpSize * (blockDim.x / warpSize) * sizeof(Interaction::ParticleType)
+ * bytes of dynamic shared memory.
+ *
+ * @param cinfo cell-list data
+ * @param view view of the particles ordered by the cell-list
+ * @param rc2 squared cut-off distance
+ * @param interaction same as in computeSelfInteractions()
+ * @param region only the cells of the region are processed, same for the whole warp
+ */
+template<typename Interaction>
+__launch_bounds__(128, 16)
+__global__ void computeSelfInteractionsTiled(
+        CellListInfo cinfo, typename Interaction::ViewType view,
+        const float rc2, Interaction interaction, CellRegion region)
+{
+    using ParticleType = typename Interaction::ParticleType;
+    using OutputType   = typename std::decay< decltype(interaction(std::declval<ParticleType>(), 0, std::declval<ParticleType>(), 0)) >::type;
+
+    // Number of the cells of the half stencil, including the cell itself that is the last one
+    constexpr int nStencilCells = 14;
+    constexpr int selfStencilCell = nStencilCells - 1;
+
+    extern __shared__ char tileMemory[];
+
+    const int laneId = threadIdx.x % warpSize;
+    const int cid = cinfo.activeCell((blockIdx.x * blockDim.x + threadIdx.x) / warpSize);
+    if (cid < 0) return;
+
+    auto tile = reinterpret_cast<ParticleType*>(tileMemory) + (threadIdx.x / warpSize) * warpSize;
+
+    const int3 cell0 = cinfo.decode(cid);
+    if (!region.contains(cell0)) return;
+
+    const int dstStart = cinfo.cellStarts[cid];
+    const int dstEnd   = cinfo.cellStarts[cid+1];
+
+    for (int dstChunk = dstStart; dstChunk < dstEnd; dstChunk += warpSize)
+    {
+        const int dstId = dstChunk + laneId;
+        const bool validDst = dstId < dstEnd;
+
+        ParticleType dstP;
+        if (validDst)
+            dstP = interaction.read(view, dstId);
+
+        auto accumulator = interaction.getZeroedAccumulator();
+
+        for (int stencilId = 0; stencilId < nStencilCells; stencilId++)
+        {
+            // preceding cells in the z-y-x lexicographic order, same for the whole warp
+            const int3 cell = cell0 + make_int3(stencilId % 3 - 1, (stencilId / 3) % 3 - 1, stencilId / 9 - 1);
+
+            if ( !(cell.x >= 0 && cell.x < cinfo.ncells.x &&
+                   cell.y >= 0 && cell.y < cinfo.ncells.y &&
+                   cell.z >= 0 && cell.z < cinfo.ncells.z) ) continue;
+
+            const int srcCid   = cinfo.encode(cell);
+            const int srcStart = cinfo.cellStarts[srcCid];
+            const int srcEnd   = cinfo.cellStarts[srcCid+1];
+
+            for (int srcChunk = srcStart; srcChunk < srcEnd; srcChunk += warpSize)
+            {
+                const int nsrc = min(warpSize, srcEnd - srcChunk);
+
+                if (laneId < nsrc)
+                {
+                    ParticleType srcP;
+                    interaction.readCoordinates(srcP, view, srcChunk + laneId);
+                    interaction.readExtraData  (srcP, view, srcChunk + laneId);
+                    tile[laneId] = srcP;
+                }
+                __syncwarp();
+
+                // the whole warp goes over the same sources, their contributions are summed before the atomics
+                for (int j = 0; j < nsrc; j++)
+                {
+                    const int srcId = srcChunk + j;
+                    const ParticleType srcP = tile[j];
+
+                    bool interacting = validDst && interaction.withinCutoff(srcP, dstP);
+                    if (stencilId == selfStencilCell && dstId <= srcId) interacting = false;
+
+                    OutputType val {};
+                    if (interacting)
+                    {
+                        val = interaction(dstP, dstId, srcP, srcId);
+                        accumulator.add(val);
+                    }
+
+                    accumulator.warpAtomicAddToSrc(interacting, val, view, srcId);
+                }
+                __syncwarp();
+            }
+        }
+
+        if (validDst)
+        {
+            if (needSelfInteraction<Interaction>::value)
+                accumulator.add(interaction(dstP, dstId, dstP, dstId));
+
+            accumulator.atomicAddToDst(accumulator.get(), view, dstId);
+        }
+    }
+}
+
+/**
+ * Compute interactions within a single ParticleVector using a NeighborList
+ * instead of the cell-list traversal.
+ *
+ * Mapping is one thread per particle, each thread goes over the listed
+ * neighbors of its particle. Since every pair is stored once, forces
+ * of the source particles are updated atomically, like in computeSelfInteractions().
+ * Neighbors further than the cut-off are filtered by the interaction itself.
+ *
+ * @param nlist neighbor list in ELL format, ids correspond to the ones of \p view
+ * @param view view of the particles ordered by the cell-list
+ * @param interaction same as in computeSelfInteractions()
+ */
+template<typename Interaction>
+__launch_bounds__(128, 16)
+__global__ void computeSelfInteractionsNeighborList(
+        NeighborListView nlist, typename Interaction::ViewType view, Interaction interaction)
+{
+    const int dstId = blockIdx.x*blockDim.x + threadIdx.x;
+    if (dstId >= view.size) return;
+
+    const auto dstP = interaction.read(view, dstId);
+
+    auto accumulator = interaction.getZeroedAccumulator();
+
+    const int n = nlist.counts[dstId];
+    for (int k = 0; k < n; k++)
+    {
+        const int srcId = nlist.neighbors[k*nlist.stride + dstId];
+
+        typename Interaction::ParticleType srcP;
+        interaction.readCoordinates(srcP, view, srcId);
+
+        if (interaction.withinCutoff(srcP, dstP))
+        {
+            interaction.readExtraData(srcP, view, srcId);
+
+            auto val = interaction(dstP, dstId, srcP, srcId);
+
+            accumulator.add(val);
+            accumulator.atomicAddToSrc(val, view, srcId);
+        }
+    }
+
+    if (needSelfInteraction<Interaction>::value)
+        accumulator.add(interaction(dstP, dstId, dstP, dstId));
+
+    accumulator.atomicAddToDst(accumulator.get(), view, dstId);
+}
+
+/**
+ * Wrap \p cell, at most one cell outside of the grid of \p cinfo, into the grid.
+ * \p shift is then the offset from the particles of the wrapped cell to their periodic image at \p cell
+ */
+__device__ inline int3 wrapCellPeriodic(int3 cell, const CellListInfo& cinfo, float3& shift)
+{
+    shift = make_float3(0.0f);
+
+    if      (cell.x < 0)              { cell.x += cinfo.ncells.x; shift.x = -cinfo.localDomainSize.x; }
+    else if (cell.x >= cinfo.ncells.x) { cell.x -= cinfo.ncells.x; shift.x =  cinfo.localDomainSize.x; }
+
+    if      (cell.y < 0)              { cell.y += cinfo.ncells.y; shift.y = -cinfo.localDomainSize.y; }
+    else if (cell.y >= cinfo.ncells.y) { cell.y -= cinfo.ncells.y; shift.y =  cinfo.localDomainSize.y; }
+
+    if      (cell.z < 0)              { cell.z += cinfo.ncells.z; shift.z = -cinfo.localDomainSize.z; }
+    else if (cell.z >= cinfo.ncells.z) { cell.z -= cinfo.ncells.z; shift.z =  cinfo.localDomainSize.z; }
+
+    return cell;
+}
+
+/**
+ * Same as computeSelfInteractions(), the neighbouring cells beyond the boundary of a
+ * fully periodic domain are the cells of the opposite side: their particles interact through
+ * their periodic image, such that no halo is needed. The pairs only depend on the separation,
+ * hence the destination particle is moved by the opposite of the shift of the image instead.
+ *
+ * Only valid if the cell-list covers the whole periodic domain with at least 3 cells per dimension,
+ * the cells are traversed one by one.
+ */
+template<typename Interaction>
+__launch_bounds__(128, 16)
+__global__ void computeSelfInteractionsPeriodic(
+        CellListInfo cinfo, typename Interaction::ViewType view,
+        const float rc2, Interaction interaction, CellRegion region)
+{
+    const int dstId = blockIdx.x*blockDim.x + threadIdx.x;
+    if (dstId >= view.size) return;
+
+    const auto dstP = interaction.read(view, dstId);
+
+    const int3 cell0 = cinfo.getCellIdAlongAxes(interaction.getPosition(dstP));
+    if (!region.contains(cell0)) return;
+
+    auto accumulator = interaction.getZeroedAccumulator();
+
+    // half of the neighbouring cells, the other half is covered from the other side
+    for (int dz = -1; dz <= 1; dz++)
+        for (int dy = -1; dy <= 0; dy++)
+        {
+            if (dy == 0 && dz > 0) continue;
+            const bool midRow = (dy == 0 && dz == 0);
+
+            for (int dx = -1; dx <= (midRow ? 0 : 1); dx++)
+            {
+                float3 shift;
+                const int3 cell = wrapCellPeriodic(cell0 + make_int3(dx, dy, dz), cinfo, shift);
+
+                const int cid = cinfo.encode(cell.x, cell.y, cell.z);
+                const int pstart = cinfo.cellStarts[cid];
+                const int pend   = cinfo.cellStarts[cid+1];
+
+                if (midRow && dx == 0)
+                    computeCell<InteractionOut::NeedAcc, InteractionOut::NeedAcc, InteractionWith::Self>
+                        (pstart, pend, dstP, dstId, view, rc2, interaction, accumulator);
+                else
+                {
+                    auto imageP = dstP;
+                    interaction.shiftPosition(imageP, -shift);
+
+                    computeCell<InteractionOut::NeedAcc, InteractionOut::NeedAcc, InteractionWith::Other>
+                        (pstart, pend, imageP, dstId, view, rc2, interaction, accumulator);
+                }
+            }
+        }
+
+    if (needSelfInteraction<Interaction>::value)
+        accumulator.add(interaction(dstP, dstId, dstP, dstId));
+
+    accumulator.atomicAddToDst(accumulator.get(), view, dstId);
+}
+
+/**
+ * Same as computeExternalInteractions_1tpp() for the local particles of two ParticleVector,
+ * with the periodic images of the source cells beyond the boundary as in computeSelfInteractionsPeriodic().
+ * Both the destination and the source particles get their forces.
+ */
+template<typename Interaction>
+__launch_bounds__(128, 16)
+__global__ void computeExternalInteractionsPeriodic(
+        typename Interaction::ViewType dstView, CellListInfo srcCinfo,
+        typename Interaction::ViewType srcView,
+        const float rc2, Interaction interaction)
+{
+    const int dstId = blockIdx.x*blockDim.x + threadIdx.x;
+    if (dstId >= dstView.size) return;
+
+    const auto dstP = interaction.readNoCache(dstView, dstId);
+
+    auto accumulator = interaction.getZeroedAccumulator();
+
+    const int3 cell0 = srcCinfo.getCellIdAlongAxes(interaction.getPosition(dstP));
+
+    for (int dz = -1; dz <= 1; dz++)
+        for (int dy = -1; dy <= 1; dy++)
+            for (int dx = -1; dx <= 1; dx++)
+            {
+                float3 shift;
+                const int3 cell = wrapCellPeriodic(cell0 + make_int3(dx, dy, dz), srcCinfo, shift);
+
+                const int cid = srcCinfo.encode(cell.x, cell.y, cell.z);
+                const int pstart = srcCinfo.cellStarts[cid];
+                const int pend   = srcCinfo.cellStarts[cid+1];
+
+                auto imageP = dstP;
+                interaction.shiftPosition(imageP, -shift);
+
+                computeCell<InteractionOut::NeedAcc, InteractionOut::NeedAcc, InteractionWith::Other>
+                    (pstart, pend, imageP, dstId, srcView, rc2, interaction, accumulator);
+            }
+
+    accumulator.atomicAddToDst(accumulator.get(), dstView, dstId);
+}
+
 /**
  * Compute interactions between particle of two different ParticleVector.
  *
@@ -179,7 +512,8 @@ __global__ void computeSelfInteractions(
  * @tparam NeedSrcAcc if true, compute forces for source particles.
  *         One out of \p NeedDstAcc or \p NeedSrcAcc should be true.
  * @tparam Variant performance related parameter. \e true is better for
- * densely mixed stuff, \e false is better for halo
+ * densely mixed stuff, \e false is better for halo. Rows of cells are only
+ * merged for row-major cell-lists, see CellListInfo::isRowMajor()
  */
 template<InteractionOut NeedDstAcc, InteractionOut NeedSrcAcc, InteractionMode Variant, typename Interaction>
 __launch_bounds__(128, 16)
@@ -202,7 +536,7 @@ __global__ void computeExternalInteractions_1tpp(
 
     for (int cellZ = cell0.z-1; cellZ <= cell0.z+1; cellZ++)
         for (int cellY = cell0.y-1; cellY <= cell0.y+1; cellY++)
-            if (Variant == InteractionMode::RowWise)
+            if (Variant == InteractionMode::RowWise && srcCinfo.isRowMajor())
             {
                 if ( !(cellY >= 0 && cellY < srcCinfo.ncells.y && cellZ >= 0 && cellZ < srcCinfo.ncells.z) ) continue;
 
@@ -269,7 +603,7 @@ __global__ void computeExternalInteractions_3tpp(
     int cellZ = cell0.z + dircode;
 
     for (int cellY = cell0.y-1; cellY <= cell0.y+1; cellY++)
-        if (Variant == InteractionMode::RowWise)
+        if (Variant == InteractionMode::RowWise && srcCinfo.isRowMajor())
         {
             if ( !(cellY >= 0 && cellY < srcCinfo.ncells.y && cellZ >= 0 && cellZ < srcCinfo.ncells.z) ) continue;
 
@@ -336,7 +670,7 @@ __global__ void computeExternalInteractions_9tpp(
     int cellZ = cell0.z + dircode / 3 - 1;
     int cellY = cell0.y + dircode % 3 - 1;
 
-    if (Variant == InteractionMode::RowWise)
+    if (Variant == InteractionMode::RowWise && srcCinfo.isRowMajor())
     {
         if ( !(cellY >= 0 && cellY < srcCinfo.ncells.y && cellZ >= 0 && cellZ < srcCinfo.ncells.z) ) return;
 
@@ -418,3 +752,112 @@ __global__ void computeExternalInteractions_27tpp(
     if (NeedDstAcc == InteractionOut::NeedAcc)
         accumulator.atomicAddToDst(accumulator.get(), dstView, dstId);
 }
+
+/**
+ * Compute interactions between particles of two different ParticleVector
+ * whose cell-lists have the same grid, one warp per non-empty cell of the destination cell-list.
+ *
+ * Same as computeSelfInteractionsTiled(), over the 27 neighbouring cells:
+ * every pair is only seen from its destination particle, thus each of them is visited once.
+ * The cell ranges are found once per warp instead of once per thread and the source particles
+ * are staged in shared memory, read once per chunk of destination particles of the cell.
+ *
+ * Requires the same dynamic shared memory as computeSelfInteractionsTiled().
+ *
+ * @param dstCinfo cell-list data for the destination particles
+ * @param dstView view of the destination particles ordered by their cell-list
+ * @param srcCinfo cell-list data for the source particles, same grid as \p dstCinfo
+ * @param srcView view of the source particles ordered by their cell-list
+ */
+template<InteractionOut NeedDstAcc, InteractionOut NeedSrcAcc, typename Interaction>
+__launch_bounds__(128, 16)
+__global__ void computeExternalInteractionsTiled(
+        CellListInfo dstCinfo, typename Interaction::ViewType dstView,
+        CellListInfo srcCinfo, typename Interaction::ViewType srcView,
+        const float rc2, Interaction interaction)
+{
+    static_assert(NeedDstAcc == InteractionOut::NeedAcc || NeedSrcAcc == InteractionOut::NeedAcc,
+                  "External interactions should return at least some accelerations");
+
+    using ParticleType = typename Interaction::ParticleType;
+    using OutputType   = typename std::decay< decltype(interaction(std::declval<ParticleType>(), 0, std::declval<ParticleType>(), 0)) >::type;
+
+    constexpr int nStencilCells = 27;
+
+    extern __shared__ char tileMemory[];
+
+    const int laneId = threadIdx.x % warpSize;
+    const int cid = dstCinfo.activeCell((blockIdx.x * blockDim.x + threadIdx.x) / warpSize);
+    if (cid < 0) return;
+
+    auto tile = reinterpret_cast<ParticleType*>(tileMemory) + (threadIdx.x / warpSize) * warpSize;
+
+    const int3 cell0 = dstCinfo.decode(cid);
+
+    const int dstStart = dstCinfo.cellStarts[cid];
+    const int dstEnd   = dstCinfo.cellStarts[cid+1];
+
+    for (int dstChunk = dstStart; dstChunk < dstEnd; dstChunk += warpSize)
+    {
+        const int dstId = dstChunk + laneId;
+        const bool validDst = dstId < dstEnd;
+
+        ParticleType dstP;
+        if (validDst)
+            dstP = interaction.read(dstView, dstId);
+
+        auto accumulator = interaction.getZeroedAccumulator();
+
+        for (int stencilId = 0; stencilId < nStencilCells; stencilId++)
+        {
+            const int3 cell = cell0 + make_int3(stencilId % 3 - 1, (stencilId / 3) % 3 - 1, stencilId / 9 - 1);
+
+            if ( !(cell.x >= 0 && cell.x < srcCinfo.ncells.x &&
+                   cell.y >= 0 && cell.y < srcCinfo.ncells.y &&
+                   cell.z >= 0 && cell.z < srcCinfo.ncells.z) ) continue;
+
+            const int srcCid   = srcCinfo.encode(cell);
+            const int srcStart = srcCinfo.cellStarts[srcCid];
+            const int srcEnd   = srcCinfo.cellStarts[srcCid+1];
+
+            for (int srcChunk = srcStart; srcChunk < srcEnd; srcChunk += warpSize)
+            {
+                const int nsrc = min(warpSize, srcEnd - srcChunk);
+
+                if (laneId < nsrc)
+                {
+                    ParticleType srcP;
+                    interaction.readCoordinates(srcP, srcView, srcChunk + laneId);
+                    interaction.readExtraData  (srcP, srcView, srcChunk + laneId);
+                    tile[laneId] = srcP;
+                }
+                __syncwarp();
+
+                // the whole warp goes over the same sources, their contributions are summed before the atomics
+                for (int j = 0; j < nsrc; j++)
+                {
+                    const int srcId = srcChunk + j;
+                    const ParticleType srcP = tile[j];
+
+                    const bool interacting = validDst && interaction.withinCutoff(srcP, dstP);
+
+                    OutputType val {};
+                    if (interacting)
+                    {
+                        val = interaction(dstP, dstId, srcP, srcId);
+
+                        if (NeedDstAcc == InteractionOut::NeedAcc)
+                            accumulator.add(val);
+                    }
+
+                    if (NeedSrcAcc == InteractionOut::NeedAcc)
+                        accumulator.warpAtomicAddToSrc(interacting, val, srcView, srcId);
+                }
+                __syncwarp();
+            }
+        }
+
+        if (validDst && NeedDstAcc == InteractionOut::NeedAcc)
+            accumulator.atomicAddToDst(accumulator.get(), dstView, dstId);
+    }
+}
@@ -7,6 +7,11 @@
 #include <core/datatypes.h>
 #include <map>
 
+/**
+ * Pairwise interaction that also computes the stresses every stressPeriod.
+ * The same kernels run at every step, the stresses are only computed
+ * and accumulated at the stress steps, see PairwiseStressWrapperHandler
+ */
 template<class PairwiseInteraction>
 class InteractionPair_withStress : public Interaction
 {
@@ -16,8 +21,7 @@ public:
     InteractionPair_withStress(const YmrState *state, std::string name, float rc, float stressPeriod, PairwiseInteraction pair) :
         Interaction(state, name, rc),
         stressPeriod(stressPeriod),
-        interaction(state, name, rc, pair),
-        interactionWithStress(state, name, rc, PairwiseStressWrapper<PairwiseInteraction>(pair))
+        interaction(state, name, rc, PairwiseStressWrapper<PairwiseInteraction>(pair, &stressStep))
     {}
 
     ~InteractionPair_withStress() = default;
@@ -36,49 +40,51 @@ public:
 
     void local (ParticleVector *pv1, ParticleVector *pv2, CellList *cl1, CellList *cl2, cudaStream_t stream) override
     {
-        float t = state->currentTime;
-        
-        if (lastStressTime+stressPeriod <= t || lastStressTime == t)
-        {
-            debug("Executing interaction '%s' with stress", name.c_str());
-            
-            interactionWithStress.local(pv1, pv2, cl1, cl2, stream);
-            lastStressTime = t;
-        }
-        else
-        {
-            interaction.local(pv1, pv2, cl1, cl2, stream);
-        }
+        updateStressStep();
+        interaction.local(pv1, pv2, cl1, cl2, stream);
     }
     
     void halo(ParticleVector *pv1, ParticleVector *pv2, CellList *cl1, CellList *cl2, cudaStream_t stream) override
     {
-        float t = state->currentTime;
-    
-        if (lastStressTime+stressPeriod <= t || lastStressTime == t)
-        {
-            debug("Executing interaction '%s' with stress", name.c_str());
-
-            interactionWithStress.halo(pv1, pv2, cl1, cl2, stream);
-            lastStressTime = t;
-        }
-        else
-        {
-            interaction.halo(pv1, pv2, cl1, cl2, stream);
-        }
+        updateStressStep();
+        interaction.halo(pv1, pv2, cl1, cl2, stream);
     }
 
     void setSpecificPair(std::string pv1name, std::string pv2name, PairwiseInteraction pair)
     {
-        interaction.          setSpecificPair(pv1name, pv2name, pair);
-        interactionWithStress.setSpecificPair(pv1name, pv2name, PairwiseStressWrapper<PairwiseInteraction>(pair));
+        interaction.setSpecificPair(pv1name, pv2name, PairwiseStressWrapper<PairwiseInteraction>(pair, &stressStep));
+    }
+
+    void useNeighborList(float skin) override
+    {
+        interaction.useNeighborList(skin);
+    }
+
+    void useTiledKernels(bool enabled) override
+    {
+        interaction.useTiledKernels(enabled);
+    }
+
+    void setAutotuning(int nsamples, std::string fname) override
+    {
+        interaction.setAutotuning(nsamples, fname);
+    }
+
+    bool usePeriodicImages(bool enabled) override
+    {
+        return interaction.usePeriodicImages(enabled);
+    }
+
+    /// not supported: the particles are read together with the stresses
+    void useCompressedStorage(bool enabled, bool validate) override
+    {
+        interaction.useCompressedStorage(enabled, validate);
     }
 
     std::vector<InteractionChannel> getFinalOutputChannels() const override
     {
         auto activePredicateStress = [this]() {
-            float t = state->currentTime;
-            return (lastStressTime+stressPeriod <= t) || (lastStressTime == t);
+            return isStressStep();
         };
 
         return {{ChannelNames::forces, Interaction::alwaysActive},
@@ -89,6 +95,25 @@ private:
     float stressPeriod;
     float lastStressTime{-1e6};
 
-    InteractionPair<PairwiseInteraction> interaction;
-    InteractionPair<PairwiseStressWrapper<PairwiseInteraction>> interactionWithStress;
+    /// read by the handlers at every setup, see PairwiseStressWrapper
+    bool stressStep{true};
+
+    InteractionPair<PairwiseStressWrapper<PairwiseInteraction>> interaction;
+
+    bool isStressStep() const
+    {
+        float t = state->currentTime;
+        return (lastStressTime+stressPeriod <= t) || (lastStressTime == t);
+    }
+
+    void updateStressStep()
+    {
+        stressStep = isStressStep();
+
+        if (stressStep)
+        {
+            debug("Executing interaction '%s' with stress", name.c_str());
+            lastStressTime = state->currentTime;
+        }
+    }
 };
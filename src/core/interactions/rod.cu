@@ -0,0 +1,336 @@
+#include "rod.h"
+
+#include <core/pvs/object_vector.h>
+#include <core/pvs/views/ov.h>
+#include <core/utils/cuda_common.h>
+#include <core/utils/kernel_launch.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace RodForcesKernels
+{
+
+struct RodBatchEntry
+{
+    OVview view;
+    RodParameters params;
+    int firstRod;     ///< index of the first filament of the entry among all the filaments of the batch
+};
+
+static const int nBondsPerSegment = 15;
+
+/// particles of a segment, relative to its first centerline particle; the last 3 bonds have the rest length l0
+__constant__ int2 segmentBonds[nBondsPerSegment] = {
+    {0, 1}, {0, 2}, {0, 3}, {0, 4},
+    {5, 1}, {5, 2}, {5, 3}, {5, 4},
+    {1, 2}, {2, 3}, {3, 4}, {4, 1},
+    {0, 5}, {1, 3}, {2, 4}
+};
+
+/// positions and forces of one filament, in the shared memory of its warp or in the global memory
+template <bool Staged>
+struct RodAccessor
+{
+    const float4 *particles;
+    float4 *forces;
+    float3 *sharedPositions, *sharedForces;
+
+    __device__ inline float3 position(int i) const
+    {
+        if (Staged) return sharedPositions[i];
+        return f4tof3(particles[2*i]);
+    }
+
+    __device__ inline float3 velocity(int i) const
+    {
+        return f4tof3(particles[2*i + 1]);
+    }
+
+    __device__ inline void addForce(int i, float3 f) const
+    {
+        if (Staged) atomicAdd(sharedForces + i, f);
+        else        atomicAdd(forces + i, f);
+    }
+};
+
+/// harmonic bond between \p i and \p j, with the dissipation along the bond
+template <bool Staged>
+__device__ inline void bondForce(const RodAccessor<Staged>& rod, const RodParameters& params, int i, int j, float l0)
+{
+    const float3 dr = rod.position(j) - rod.position(i);
+    const float r2 = dot(dr, dr);
+    if (r2 < 1e-12f) return;
+
+    const float r = sqrtf(r2);
+    float magn = params.ks * (r - l0) / r;
+
+    if (params.gamma != 0.0f)
+    {
+        const float3 du = rod.velocity(j) - rod.velocity(i);
+        magn += params.gamma * dot(du, dr) / r2;
+    }
+
+    const float3 f = magn * dr;
+    rod.addForce(i,  f);
+    rod.addForce(j, -f);
+}
+
+/// harmonic energy of the angle between the centerline edges c1-c0 and c2-c1
+template <bool Staged>
+__device__ inline void bendingForce(const RodAccessor<Staged>& rod, const RodParameters& params, int c0, int c1, int c2)
+{
+    const float3 e0 = rod.position(c1) - rod.position(c0);
+    const float3 e1 = rod.position(c2) - rod.position(c1);
+
+    const float l0 = length(e0);
+    const float l1 = length(e1);
+    const float3 t0 = e0 / l0;
+    const float3 t1 = e1 / l1;
+
+    const float cost = min(max(dot(t0, t1), -1.0f), 1.0f);
+    const float3 d0 = t1 - cost * t0;
+    const float3 d1 = t0 - cost * t1;
+
+    // |d0| = |d1| = sin(theta), no well defined direction for aligned edges
+    const float sint = length(d0);
+    if (sint < 1e-6f) return;
+
+    const float magn = -params.kb * (acosf(cost) - params.theta0) / sint;
+
+    const float3 f0 =  magn / l0 * d0;
+    const float3 f2 = -magn / l1 * d1;
+
+    rod.addForce(c0, f0);
+    rod.addForce(c2, f2);
+    rod.addForce(c1, -(f0 + f2));
+}
+
+/**
+ * harmonic energy of the dihedral angle i-j-k-l,
+ * forces as in the proper dihedrals of GROMACS (Bekker 1996)
+ */
+template <bool Staged>
+__device__ inline void twistForce(const RodAccessor<Staged>& rod, const RodParameters& params, int i, int j, int k, int l)
+{
+    const float3 xj = rod.position(j);
+    const float3 xk = rod.position(k);
+
+    const float3 r_ij = rod.position(i) - xj;
+    const float3 r_kj = xk - xj;
+    const float3 r_kl = xk - rod.position(l);
+
+    const float3 m = cross(r_ij, r_kj);
+    const float3 n = cross(r_kj, r_kl);
+
+    const float m2 = dot(m, m);
+    const float n2 = dot(n, n);
+    const float kj2 = dot(r_kj, r_kj);
+    if (m2 < 1e-12f || n2 < 1e-12f || kj2 < 1e-12f) return;
+
+    const float cosp = min(max(dot(m, n) * rsqrtf(m2 * n2), -1.0f), 1.0f);
+    const float phi = copysignf(acosf(cosp), dot(r_ij, n));
+
+    const float twoPi = 2.0f * M_PI;
+    float dphi = phi - params.tau0;
+    dphi -= twoPi * rintf(dphi / twoPi);
+
+    const float ddphi = params.kt * dphi;
+    const float lkj = sqrtf(kj2);
+
+    const float3 fi = (-ddphi * lkj / m2) * m;
+    const float3 fl = ( ddphi * lkj / n2) * n;
+
+    const float p = dot(r_ij, r_kj) / kj2;
+    const float q = dot(r_kl, r_kj) / kj2;
+    const float3 s = p * fi - q * fl;
+
+    rod.addForce(i,  fi);
+    rod.addForce(j, -(fi - s));
+    rod.addForce(k, -(fl + s));
+    rod.addForce(l,  fl);
+}
+
+/**
+ * One warp per filament, of all the entries of the batch.
+ * With \c Staged, the warp copies the positions of its filament in its part of the shared memory,
+ * of 2 * \p stride float3, and accumulates the forces there before adding them to the global ones
+ */
+template <bool Staged>
+__global__ void computeRodForces(int nEntries, const RodBatchEntry *entries, int nRods, int stride)
+{
+    extern __shared__ float3 rodData[];
+
+    const int gid    = threadIdx.x + blockIdx.x * blockDim.x;
+    const int rodId  = gid / warpSize;
+    const int laneId = gid % warpSize;
+    if (rodId >= nRods) return;
+
+    int e = 0;
+    while (e + 1 < nEntries && entries[e+1].firstRod <= rodId) e++;
+
+    const OVview& view = entries[e].view;
+    const RodParameters& params = entries[e].params;
+
+    const int objSize   = view.objSize;
+    const int nSegments = (objSize - 1) / 5;
+    const int start     = (rodId - entries[e].firstRod) * objSize;
+
+    float3 *positions = rodData + 2 * stride * (threadIdx.x / warpSize);
+    float3 *forces    = positions + stride;
+
+    const RodAccessor<Staged> rod {view.particles + 2 * start, view.forces + start, positions, forces};
+
+    if (Staged)
+    {
+        for (int i = laneId; i < objSize; i += warpSize)
+        {
+            positions[i] = f4tof3(view.particles[2 * (start + i)]);
+            forces[i] = make_float3(0.0f);
+        }
+        __syncwarp();
+    }
+
+    const float lCross = 0.70710678f * params.l0;
+
+    for (int b = laneId; b < nSegments * nBondsPerSegment; b += warpSize)
+    {
+        const int segment = b / nBondsPerSegment;
+        const int bond    = b % nBondsPerSegment;
+        const int2 ids    = segmentBonds[bond];
+
+        bondForce(rod, params, 5 * segment + ids.x, 5 * segment + ids.y,
+                  bond >= nBondsPerSegment - 3 ? params.l0 : lCross);
+    }
+
+    for (int segment = laneId; segment < nSegments - 1; segment += warpSize)
+    {
+        const int c = 5 * segment;
+
+        if (params.kb != 0.0f)
+            bendingForce(rod, params, c, c + 5, c + 10);
+
+        if (params.kt != 0.0f)
+            twistForce(rod, params, c + 1, c, c + 10, c + 6);
+    }
+
+    if (Staged)
+    {
+        __syncwarp();
+        for (int i = laneId; i < objSize; i += warpSize)
+            atomicAdd(view.forces + start + i, forces[i]);
+    }
+}
+
+} // namespace RodForcesKernels
+
+InteractionRod::InteractionRod(const YmrState *state, std::string name, float l0, float ks, float kb,
+                               float theta0, float kt, float tau0, float gamma) :
+    Interaction(state, name, /* default cutoff rc */ 1.0),
+    parameters{l0, ks, kb, theta0, kt, tau0, gamma}
+{
+    if (l0 <= 0.0f)
+        die("Rod interaction '%s' needs a positive segment length, got %g", name.c_str(), l0);
+}
+
+InteractionRod::~InteractionRod() = default;
+
+void InteractionRod::setPrerequisites(ParticleVector *pv1, ParticleVector *pv2, CellList *cl1, CellList *cl2)
+{
+    if (pv1 != pv2)
+        die("Rod forces of '%s' can't be computed between two different particle vectors", name.c_str());
+
+    auto ov = dynamic_cast<ObjectVector*>(pv1);
+    if (ov == nullptr)
+        die("Rod forces of '%s' can only be computed with an ObjectVector, '%s' is not one",
+            name.c_str(), pv1->name.c_str());
+
+    if (ov->objSize < 6 || ov->objSize % 5 != 1)
+        die("Rod forces of '%s' need objects of 5n+1 particles with n >= 1, '%s' has objects of %d particles",
+            name.c_str(), ov->name.c_str(), ov->objSize);
+}
+
+void InteractionRod::local(ParticleVector *pv1, ParticleVector *pv2, CellList *cl1, CellList *cl2, cudaStream_t stream)
+{
+    computeForces({{this, pv1, pv2, cl1, cl2}}, stream);
+}
+
+void InteractionRod::halo(ParticleVector *pv1, ParticleVector *pv2, CellList *cl1, CellList *cl2, cudaStream_t stream)
+{
+    debug("Not computing rod forces between local and halo filaments of '%s'", pv1->name.c_str());
+}
+
+std::string InteractionRod::getBatchKey() const
+{
+    return "rod";
+}
+
+void InteractionRod::localBatch(const std::vector<BatchEntry>& entries, cudaStream_t stream)
+{
+    debug("Computing rod forces of %d filament vectors in one launch", (int) entries.size());
+    computeForces(entries, stream);
+}
+
+void InteractionRod::queryDevice()
+{
+    if (maxSharedBytes >= 0) return;
+
+    int device;
+    CUDA_Check( cudaGetDevice(&device) );
+    CUDA_Check( cudaDeviceGetAttribute(&maxSharedBytes, cudaDevAttrMaxSharedMemoryPerBlockOptin, device) );
+}
+
+void InteractionRod::computeForces(const std::vector<BatchEntry>& entries, cudaStream_t stream)
+{
+    using RodForcesKernels::RodBatchEntry;
+
+    std::vector<RodBatchEntry> batch;
+    int nRods = 0, stride = 0;
+
+    for (auto& e : entries)
+    {
+        auto rod = static_cast<InteractionRod*>(e.interaction);
+        auto ov  = static_cast<ObjectVector*>(e.pv1);
+
+        OVview view(ov, ov->local());
+        if (view.nObjects == 0) continue;
+
+        batch.push_back({view, rod->parameters, nRods});
+        nRods += view.nObjects;
+        stride = std::max(stride, view.objSize);
+    }
+
+    if (batch.empty()) return;
+
+    batchEntries.resize_anew(batch.size() * sizeof(RodBatchEntry));
+    memcpy(batchEntries.hostPtr(), batch.data(), batch.size() * sizeof(RodBatchEntry));
+    batchEntries.uploadToDevice(stream);
+
+    const int nthreads = 128;
+    const int nblocks  = getNblocks(nRods * 32, nthreads);
+    const size_t sharedBytes = 2 * stride * sizeof(float3) * (nthreads / 32);
+    auto devEntries = (const RodBatchEntry*) batchEntries.devPtr();
+
+    queryDevice();
+
+    if (sharedBytes <= maxSharedBytes)
+    {
+        // above 48 KB, the kernel has to opt in for more dynamic shared memory
+        if (sharedBytes > sharedBytesSet)
+        {
+            CUDA_Check( cudaFuncSetAttribute(RodForcesKernels::computeRodForces<true>,
+                                             cudaFuncAttributeMaxDynamicSharedMemorySize, sharedBytes) );
+            sharedBytesSet = sharedBytes;
+        }
+
+        SAFE_KERNEL_LAUNCH(RodForcesKernels::computeRodForces<true>,
+                           nblocks, nthreads, sharedBytes, stream,
+                           (int) batch.size(), devEntries, nRods, stride);
+    }
+    else
+    {
+        SAFE_KERNEL_LAUNCH(RodForcesKernels::computeRodForces<false>,
+                           nblocks, nthreads, 0, stream,
+                           (int) batch.size(), devEntries, nRods, stride);
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "interface.h"
+
+#include <core/containers.h>
+
+/// parameters of the bonded filaments, see InteractionRod
+struct RodParameters
+{
+    float l0;      ///< length of a segment
+    float ks;      ///< stiffness of the bonds
+    float kb;      ///< bending stiffness
+    float theta0;  ///< equilibrium angle between two consecutive segments
+    float kt;      ///< twisting stiffness
+    float tau0;    ///< equilibrium twist angle between two consecutive segments
+    float gamma;   ///< dissipation along the bonds
+};
+
+/**
+ * Internal forces of flagella-like filaments, made of objects of 5n+1 particles.
+ *
+ * Every one of the n segments of a filament is described by its centerline particle 5i,
+ * followed by 4 particles at the middle of the segment forming a square of side l0/sqrt(2)
+ * around the centerline, the last particle 5n ends the centerline.
+ * Every segment is held by 15 harmonic bonds of stiffness ks: its two centerline particles
+ * to the 4 ones of the square, the sides and the diagonals of the square, and the segment itself.
+ * Consecutive segments are bent with a harmonic energy of their angle, and twisted with
+ * a harmonic energy of the dihedral angle between the first particles of their squares.
+ *
+ * One warp computes all the forces of a filament, its particles are staged in the shared memory
+ * when a warp has enough of it. Only the local filaments are computed, the filaments are never split
+ * between ranks. All the filament vectors of the same kind of interaction are computed in one launch
+ */
+class InteractionRod : public Interaction
+{
+public:
+    InteractionRod(const YmrState *state, std::string name, float l0, float ks, float kb,
+                   float theta0, float kt, float tau0, float gamma);
+
+    ~InteractionRod();
+
+    void setPrerequisites(ParticleVector *pv1, ParticleVector *pv2, CellList *cl1, CellList *cl2) override;
+
+    void local(ParticleVector *pv1, ParticleVector *pv2, CellList *cl1, CellList *cl2, cudaStream_t stream) override;
+    void halo (ParticleVector *pv1, ParticleVector *pv2, CellList *cl1, CellList *cl2, cudaStream_t stream) override;
+
+    /// all the rod interactions are batched together, the parameters travel with every entry
+    std::string getBatchKey() const override;
+    void localBatch(const std::vector<BatchEntry>& entries, cudaStream_t stream) override;
+
+private:
+    RodParameters parameters;
+
+    PinnedBuffer<char> batchEntries;
+    int maxSharedBytes{-1};
+    size_t sharedBytesSet{0};
+
+    void queryDevice();
+    void computeForces(const std::vector<BatchEntry>& entries, cudaStream_t stream);
+};
@@ -56,6 +56,41 @@ void BasicInteractionSDPD::halo(ParticleVector *pv1, ParticleVector *pv2,
     impl->halo(pv1, pv2, cl1, cl2, stream);
 }
 
+void BasicInteractionSDPD::useNeighborList(float skin)
+{
+    impl->useNeighborList(skin);
+}
+
+void BasicInteractionSDPD::useTiledKernels(bool enabled)
+{
+    impl->useTiledKernels(enabled);
+}
+
+bool BasicInteractionSDPD::usePeriodicImages(bool enabled)
+{
+    return impl->usePeriodicImages(enabled);
+}
+
+void BasicInteractionSDPD::setAutotuning(int nsamples, std::string fname)
+{
+    impl->setAutotuning(nsamples, fname);
+}
+
+void BasicInteractionSDPD::useEarlyInterior(bool enabled)
+{
+    impl->useEarlyInterior(enabled);
+}
+
+bool BasicInteractionSDPD::setInteriorMargin(ParticleVector *pv, CellList *cl, float margin)
+{
+    return impl->setInteriorMargin(pv, cl, margin);
+}
+
+void BasicInteractionSDPD::localInterior(ParticleVector *pv, CellList *cl, cudaStream_t stream)
+{
+    impl->localInterior(pv, cl, stream);
+}
+
 
 
 
@@ -88,3 +123,6 @@ InteractionSDPD<PressureEOS, DensityKernel>::~InteractionSDPD() = default;
 
 template class InteractionSDPD<LinearPressureEOS, WendlandC2DensityKernel>;
 template class InteractionSDPD<QuasiIncompressiblePressureEOS, WendlandC2DensityKernel>;
+
+template class InteractionSDPD<LinearPressureEOS,              TabulatedWendlandC2DensityKernel>;
+template class InteractionSDPD<QuasiIncompressiblePressureEOS, TabulatedWendlandC2DensityKernel>;
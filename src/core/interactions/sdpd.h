@@ -17,6 +17,15 @@ public:
     
     void local (ParticleVector *pv1, ParticleVector *pv2, CellList *cl1, CellList *cl2, cudaStream_t stream) override;
     void halo  (ParticleVector *pv1, ParticleVector *pv2, CellList *cl1, CellList *cl2, cudaStream_t stream) override;
+
+    void useNeighborList(float skin) override;
+    void useTiledKernels(bool enabled) override;
+    bool usePeriodicImages(bool enabled) override;
+    void setAutotuning(int nsamples, std::string fname) override;
+
+    void useEarlyInterior(bool enabled) override;
+    bool setInteriorMargin(ParticleVector *pv, CellList *cl, float margin) override;
+    void localInterior(ParticleVector *pv, CellList *cl, cudaStream_t stream) override;
         
 protected:
     
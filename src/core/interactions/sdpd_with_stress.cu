@@ -34,3 +34,6 @@ InteractionSDPDWithStress<PressureEOS, DensityKernel>::
 
 template class InteractionSDPDWithStress<LinearPressureEOS, WendlandC2DensityKernel>;
 template class InteractionSDPDWithStress<QuasiIncompressiblePressureEOS, WendlandC2DensityKernel>;
+
+template class InteractionSDPDWithStress<LinearPressureEOS,              TabulatedWendlandC2DensityKernel>;
+template class InteractionSDPDWithStress<QuasiIncompressiblePressureEOS, TabulatedWendlandC2DensityKernel>;
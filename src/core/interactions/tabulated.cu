@@ -0,0 +1,89 @@
+#include "tabulated.h"
+#include "pairwise.impl.h"
+#include "pairwise_interactions/tabulated.h"
+
+#include <core/celllist.h>
+#include <core/utils/cuda_common.h>
+
+#include <algorithm>
+#include <memory>
+
+InteractionTabulated::InteractionTabulated(const YmrState *state, std::string name, float rc, std::vector<float> forces) :
+    Interaction(state, name, rc)
+{
+    auto tab = makeHandler(forces);
+    impl = std::make_unique<InteractionPair<PairwiseTabulated>> (state, name, rc, tab);
+}
+
+InteractionTabulated::~InteractionTabulated() = default;
+
+PairwiseTabulated InteractionTabulated::makeHandler(const std::vector<float>& forces)
+{
+    if (forces.size() < 2)
+        die("Tabulated interaction '%s' needs at least 2 values of the force, got %d", name.c_str(), (int) forces.size());
+
+    auto table = std::make_unique<PinnedBuffer<float>>(forces.size());
+    std::copy(forces.begin(), forces.end(), table->begin());
+    table->uploadToDevice(defaultStream);
+
+    PairwiseTabulated tab(rc, table->devPtr(), forces.size());
+    tables.push_back(std::move(table));
+
+    return tab;
+}
+
+void InteractionTabulated::setPrerequisites(ParticleVector *pv1, ParticleVector *pv2, CellList *cl1, CellList *cl2)
+{
+    impl->setPrerequisites(pv1, pv2, cl1, cl2);
+}
+
+std::vector<Interaction::InteractionChannel> InteractionTabulated::getFinalOutputChannels() const
+{
+    return impl->getFinalOutputChannels();
+}
+
+void InteractionTabulated::local(ParticleVector *pv1, ParticleVector *pv2,
+                                 CellList *cl1, CellList *cl2,
+                                 cudaStream_t stream)
+{
+    impl->local(pv1, pv2, cl1, cl2, stream);
+}
+
+void InteractionTabulated::halo(ParticleVector *pv1, ParticleVector *pv2,
+                                CellList *cl1, CellList *cl2,
+                                cudaStream_t stream)
+{
+    impl->halo(pv1, pv2, cl1, cl2, stream);
+}
+
+void InteractionTabulated::useNeighborList(float skin)
+{
+    impl->useNeighborList(skin);
+}
+
+void InteractionTabulated::useTiledKernels(bool enabled)
+{
+    impl->useTiledKernels(enabled);
+}
+
+bool InteractionTabulated::usePeriodicImages(bool enabled)
+{
+    return impl->usePeriodicImages(enabled);
+}
+
+void InteractionTabulated::setAutotuning(int nsamples, std::string fname)
+{
+    impl->setAutotuning(nsamples, fname);
+}
+
+void InteractionTabulated::useCompressedStorage(bool enabled, bool validate)
+{
+    impl->useCompressedStorage(enabled, validate);
+}
+
+void InteractionTabulated::setSpecificPair(ParticleVector* pv1, ParticleVector* pv2, std::vector<float> forces)
+{
+    auto tab = makeHandler(forces);
+    auto ptr = static_cast< InteractionPair<PairwiseTabulated>* >(impl.get());
+    ptr->setSpecificPair(pv1->name, pv2->name, tab);
+}
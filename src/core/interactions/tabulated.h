@@ -0,0 +1,44 @@
+#pragma once
+
+#include "interface.h"
+
+#include <core/containers.h>
+
+#include <memory>
+#include <vector>
+
+class PairwiseTabulated;
+
+/**
+ * Pairwise force given by a table of its magnitude on [0, rc], see PairwiseTabulated.
+ * The tables are sampled from an arbitrary force law at setup time
+ */
+struct InteractionTabulated : public Interaction
+{        
+    InteractionTabulated(const YmrState *state, std::string name, float rc, std::vector<float> forces);
+
+    ~InteractionTabulated();
+
+    void setPrerequisites(ParticleVector *pv1, ParticleVector *pv2, CellList *cl1, CellList *cl2) override;
+
+    std::vector<InteractionChannel> getFinalOutputChannels() const override;
+    
+    void local (ParticleVector *pv1, ParticleVector *pv2, CellList *cl1, CellList *cl2, cudaStream_t stream) override;
+    void halo  (ParticleVector *pv1, ParticleVector *pv2, CellList *cl1, CellList *cl2, cudaStream_t stream) override;
+
+    void useNeighborList(float skin) override;
+    void useTiledKernels(bool enabled) override;
+    bool usePeriodicImages(bool enabled) override;
+    void setAutotuning(int nsamples, std::string fname) override;
+    void useCompressedStorage(bool enabled, bool validate) override;
+
+    void setSpecificPair(ParticleVector* pv1, ParticleVector* pv2, std::vector<float> forces);
+
+protected:
+    std::unique_ptr<Interaction> impl;
+
+    /// the device tables referenced by the handlers, one per pair of parameters
+    std::vector< std::unique_ptr<PinnedBuffer<float>> > tables;
+
+    PairwiseTabulated makeHandler(const std::vector<float>& forces);
+};
@@ -0,0 +1,217 @@
+#include "kernel_tuner.h"
+
+#include <core/logger.h>
+#include <core/utils/cuda_common.h>
+
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <mpi.h>
+#include <sstream>
+
+static std::string getGpuModel()
+{
+    int device;
+    cudaDeviceProp prop;
+    CUDA_Check( cudaGetDevice(&device) );
+    CUDA_Check( cudaGetDeviceProperties(&prop, device) );
+    return prop.name;
+}
+
+//=================================================================================
+// Database
+//=================================================================================
+
+KernelTuningDatabase& KernelTuningDatabase::get(const std::string& fname)
+{
+    static std::map< std::string, std::unique_ptr<KernelTuningDatabase> > databases;
+
+    auto& ptr = databases[fname];
+    if (!ptr)
+        ptr.reset(new KernelTuningDatabase(fname));
+
+    return *ptr;
+}
+
+KernelTuningDatabase::KernelTuningDatabase(std::string fname) :
+    fname(fname),
+    gpuModel(getGpuModel())
+{
+    load();
+}
+
+bool KernelTuningDatabase::find(const std::string& key, KernelLaunchConfig& config) const
+{
+    auto it = entries.find(gpuModel + "\t" + key);
+    if (it == entries.end()) return false;
+
+    config = it->second;
+    return true;
+}
+
+void KernelTuningDatabase::insert(const std::string& key, KernelLaunchConfig config)
+{
+    entries[gpuModel + "\t" + key] = config;
+    save();
+}
+
+void KernelTuningDatabase::load()
+{
+    std::ifstream fin(fname);
+    if (!fin.good())
+    {
+        info("Kernel tuning file '%s' not found, all the kernels will be tuned", fname.c_str());
+        return;
+    }
+
+    std::string line;
+    while (std::getline(fin, line))
+    {
+        std::istringstream sline(line);
+        std::string model, key, variant, nthreads;
+
+        if (!std::getline(sline, model, '\t') || !std::getline(sline, key, '\t') ||
+            !std::getline(sline, variant, '\t') || !std::getline(sline, nthreads))
+        {
+            warn("Skipping malformed line in the kernel tuning file '%s': '%s'", fname.c_str(), line.c_str());
+            continue;
+        }
+
+        entries[model + "\t" + key] = {std::stoi(variant), std::stoi(nthreads)};
+    }
+
+    info("Read %d tuned kernel configurations from '%s'", (int) entries.size(), fname.c_str());
+}
+
+void KernelTuningDatabase::save() const
+{
+    int rank;
+    MPI_Check( MPI_Comm_rank(MPI_COMM_WORLD, &rank) );
+    if (rank != 0) return;
+
+    std::ofstream fout(fname);
+    if (!fout.good())
+    {
+        error("Could not write the kernel tuning file '%s'", fname.c_str());
+        return;
+    }
+
+    for (const auto& entry : entries)
+        fout << entry.first << '\t' << entry.second.variant << '\t' << entry.second.nthreads << '\n';
+}
+
+//=================================================================================
+// Tuner
+//=================================================================================
+
+KernelTuner::KernelTuner(int nsamples, std::string fname) :
+    nsamples(nsamples),
+    database(KernelTuningDatabase::get(fname))
+{
+    if (nsamples <= 0)
+        die("Kernel tuning needs a positive number of samples, got %d", nsamples);
+}
+
+KernelTuner::~KernelTuner()
+{
+    for (auto& entry : entries)
+    {
+        if (entry.second.tuned) continue;
+        CUDA_Check( cudaEventDestroy(entry.second.evStart) );
+        CUDA_Check( cudaEventDestroy(entry.second.evEnd) );
+    }
+}
+
+KernelLaunchConfig KernelTuner::begin(const std::string& key, const std::vector<KernelLaunchConfig>& candidates, cudaStream_t stream)
+{
+    auto it = entries.find(key);
+
+    if (it == entries.end())
+    {
+        Entry entry;
+
+        if (database.find(key, entry.best))
+        {
+            debug("Using stored launch configuration for '%s': variant %d, %d threads",
+                  key.c_str(), entry.best.variant, entry.best.nthreads);
+            entry.tuned = true;
+        }
+        else
+        {
+            entry.candidates = candidates;
+            entry.totalTime.resize(candidates.size(), 0.0f);
+            entry.nmeasured.resize(candidates.size(), 0);
+            CUDA_Check( cudaEventCreate(&entry.evStart) );
+            CUDA_Check( cudaEventCreate(&entry.evEnd) );
+        }
+
+        it = entries.insert({key, entry}).first;
+    }
+
+    auto& entry = it->second;
+    if (entry.pending)
+        collect(key, entry);
+
+    if (entry.tuned)
+        return entry.best;
+
+    // least measured candidate goes next
+    int next = 0;
+    for (int i = 0; i < entry.candidates.size(); i++)
+        if (entry.nmeasured[i] < entry.nmeasured[next])
+            next = i;
+
+    entry.current = next;
+    CUDA_Check( cudaEventRecord(entry.evStart, stream) );
+
+    return entry.candidates[next];
+}
+
+void KernelTuner::end(const std::string& key, cudaStream_t stream)
+{
+    auto it = entries.find(key);
+    if (it == entries.end() || it->second.tuned) return;
+
+    CUDA_Check( cudaEventRecord(it->second.evEnd, stream) );
+    it->second.pending = true;
+}
+
+void KernelTuner::collect(const std::string& key, Entry& entry)
+{
+    float ms;
+    CUDA_Check( cudaEventSynchronize(entry.evEnd) );
+    CUDA_Check( cudaEventElapsedTime(&ms, entry.evStart, entry.evEnd) );
+
+    entry.pending = false;
+    entry.totalTime[entry.current] += ms;
+    entry.nmeasured[entry.current]++;
+
+    for (auto n : entry.nmeasured)
+        if (n < nsamples) return;
+
+    int best = 0;
+    float bestTime = std::numeric_limits<float>::max();
+    for (int i = 0; i < entry.candidates.size(); i++)
+    {
+        const float avg = entry.totalTime[i] / entry.nmeasured[i];
+        debug("Tuning '%s': variant %d, %d threads: %f ms",
+              key.c_str(), entry.candidates[i].variant, entry.candidates[i].nthreads, avg);
+
+        if (avg < bestTime)
+        {
+            bestTime = avg;
+            best = i;
+        }
+    }
+
+    entry.best  = entry.candidates[best];
+    entry.tuned = true;
+
+    CUDA_Check( cudaEventDestroy(entry.evStart) );
+    CUDA_Check( cudaEventDestroy(entry.evEnd) );
+
+    info("Tuned '%s': variant %d with %d threads per block (%f ms)",
+         key.c_str(), entry.best.variant, entry.best.nthreads, bestTime);
+
+    database.insert(key, entry.best);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cuda_runtime.h>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * Launch configuration of a kernel family: which variant to use
+ * (meaning is up to the caller) and the number of threads per block
+ */
+struct KernelLaunchConfig
+{
+    int variant, nthreads;
+};
+
+/**
+ * Tuned launch configurations stored in a text file, one per line:
+ * GPU model, key, variant and number of threads, separated by tabs.
+ * One instance per file shared by all the tuners.
+ */
+class KernelTuningDatabase
+{
+public:
+    static KernelTuningDatabase& get(const std::string& fname);
+
+    bool find(const std::string& key, KernelLaunchConfig& config) const;
+
+    /// store the configuration and rewrite the file
+    void insert(const std::string& key, KernelLaunchConfig config);
+
+private:
+    KernelTuningDatabase(std::string fname);
+
+    void load();
+    void save() const;
+
+    std::string fname, gpuModel;
+    std::map<std::string, KernelLaunchConfig> entries; ///< key is "GPU model\tkey"
+};
+
+/**
+ * Pick the fastest out of several launch configurations of a kernel.
+ *
+ * For every key, each candidate is timed with CUDA events during the first
+ * launches, round-robin, until it has \c nsamples measurements; the best
+ * one is then used for all the subsequent launches and saved
+ * in the KernelTuningDatabase. Configurations found in the database are
+ * used right away without tuning.
+ *
+ * Timing results are only read at the next launch with the same key,
+ * so that tuning does not synchronize the streams.
+ */
+class KernelTuner
+{
+public:
+    KernelTuner(int nsamples, std::string fname);
+    ~KernelTuner();
+
+    /// @return configuration to use for the next launch; start timing it if needed
+    KernelLaunchConfig begin(const std::string& key, const std::vector<KernelLaunchConfig>& candidates, cudaStream_t stream);
+
+    /// stop timing the launch started by the last begin() with the same key
+    void end(const std::string& key, cudaStream_t stream);
+
+private:
+    struct Entry
+    {
+        std::vector<KernelLaunchConfig> candidates;
+        std::vector<float> totalTime;
+        std::vector<int> nmeasured;
+
+        bool tuned{false};
+        bool pending{false};
+        int current{0};
+        KernelLaunchConfig best;
+
+        cudaEvent_t evStart, evEnd;
+    };
+
+    int nsamples;
+    KernelTuningDatabase& database;
+    std::map<std::string, Entry> entries;
+
+    void collect(const std::string& key, Entry& entry);
+};
@@ -0,0 +1,90 @@
+#include "object_pairs.h"
+
+#include <core/logger.h>
+#include <core/utils/cuda_common.h>
+#include <core/utils/kernel_launch.h>
+
+namespace ObjectPairsKernels
+{
+
+/// both boxes are enlarged by half the cut-off: they overlap if closer than the cut-off
+__global__ void computeObjectBoxes(OVview view, float halfRc, AABB *boxes)
+{
+    const int objId = blockIdx.x * blockDim.x + threadIdx.x;
+    if (objId >= view.nObjects) return;
+
+    const auto box = view.comAndExtents[objId];
+    boxes[objId] = { box.low - halfRc, box.high + halfRc };
+}
+
+/// One thread per destination object
+__global__ void findPairs(OVview dst, BVHView bvh, float halfRc, bool self, int capacity, int *nPairs, int2 *pairs)
+{
+    const int dstId = blockIdx.x * blockDim.x + threadIdx.x;
+    if (dstId >= dst.nObjects) return;
+
+    const auto ext = dst.comAndExtents[dstId];
+    const AABB box { ext.low - halfRc, ext.high + halfRc };
+
+    bvh.traverse(
+        [&] (const AABB& other) {
+            return boxesOverlap(box, other);
+        },
+        [&] (int srcId) {
+            if (self && srcId <= dstId) return;
+
+            const int id = atomicAdd(nPairs, 1);
+            if (id < capacity) pairs[id] = make_int2(dstId, srcId);
+        });
+}
+
+} // namespace ObjectPairsKernels
+
+ObjectPairsBroadphase::ObjectPairsBroadphase()
+{
+    pairs.setOwner("object pairs");
+}
+
+int ObjectPairsBroadphase::find(const OVview& dst, const OVview& src, bool self, float rc,
+                                float3 domainLo, float3 domainHi, cudaStream_t stream)
+{
+    const int nthreads = 128;
+    const float halfRc = 0.5f * rc;
+
+    nPairs[0] = 0;
+    if (dst.nObjects == 0 || src.nObjects == 0) return 0;
+
+    SAFE_KERNEL_LAUNCH(
+            ObjectPairsKernels::computeObjectBoxes,
+            getNblocks(src.nObjects, nthreads), nthreads, 0, stream,
+            src, halfRc, bvh.leafBoxes(src.nObjects) );
+
+    bvh.build(domainLo, domainHi, stream);
+
+    // in a dense suspension an object has a dozen neighbours, the second pass is rare
+    if (pairs.size() == 0)
+        pairs.resize_anew(16 * dst.nObjects);
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        nPairs.clear(stream);
+
+        SAFE_KERNEL_LAUNCH(
+                ObjectPairsKernels::findPairs,
+                getNblocks(dst.nObjects, nthreads), nthreads, 0, stream,
+                dst, bvh.getView(), halfRc, self, pairs.size(), nPairs.devPtr(), pairs.devPtr() );
+
+        nPairs.downloadFromDevice(stream, ContainersSynch::Synch);
+        if (nPairs[0] <= pairs.size()) break;
+
+        pairs.resize_anew(nPairs[0]);
+    }
+
+    debug("Found %d candidate pairs among %d - %d objects", nPairs[0], dst.nObjects, src.nObjects);
+    return nPairs[0];
+}
+
+const int2* ObjectPairsBroadphase::getPairs() const
+{
+    return pairs.devPtr();
+}
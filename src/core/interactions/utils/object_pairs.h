@@ -0,0 +1,85 @@
+#pragma once
+
+#include <core/containers.h>
+#include <core/mesh/bvh.h>
+#include <core/pvs/views/ov.h>
+
+#include <cuda_runtime.h>
+
+/**
+ * Object-level broadphase of the interactions between two object vectors:
+ * finds the pairs of objects whose bounding boxes (ChannelNames::comExtents) are closer than the cut-off.
+ * The boxes of the source objects go in a BoundingVolumeHierarchy queried by one thread per destination object,
+ * the particle interactions then only run within the candidate pairs, see computeObjectPairInteractions()
+ */
+class ObjectPairsBroadphase
+{
+public:
+    ObjectPairsBroadphase();
+
+    /**
+     * Find the candidate pairs of \p dst and \p src objects, the extents must be up to date.
+     * With \p self, \p dst and \p src are the same objects and each pair is only found once.
+     * \p domainLo and \p domainHi bound the centers of the boxes for the hierarchy
+     *
+     * @return the number of pairs, downloaded to the host
+     */
+    int find(const OVview& dst, const OVview& src, bool self, float rc,
+             float3 domainLo, float3 domainHi, cudaStream_t stream);
+
+    /// (dst object, src object) ids of the pairs found by the last find()
+    const int2* getPairs() const;
+
+private:
+    BoundingVolumeHierarchy bvh;
+    PinnedBuffer<int> nPairs{1};
+    DeviceBuffer<int2> pairs;
+};
+
+#ifdef __CUDACC__
+/**
+ * One block per pair of objects. Every thread takes the destination particles close to the source box
+ * and goes over the source particles close to the destination box,
+ * the forces on both sides are accumulated like the external cell-list kernels
+ */
+template<typename Interaction>
+__global__ void computeObjectPairInteractions(OVview dstView, OVview srcView, const int2 *pairs, float rc, Interaction interaction)
+{
+    const int2 pair = pairs[blockIdx.x];
+
+    const auto dstBox = dstView.comAndExtents[pair.x];
+    const auto srcBox = srcView.comAndExtents[pair.y];
+
+    auto near = [rc] (float3 r, const LocalObjectVector::COMandExtent& box) {
+        return r.x > box.low.x - rc && r.x < box.high.x + rc &&
+               r.y > box.low.y - rc && r.y < box.high.y + rc &&
+               r.z > box.low.z - rc && r.z < box.high.z + rc;
+    };
+
+    const int dstStart = pair.x * dstView.objSize;
+    const int srcStart = pair.y * srcView.objSize;
+
+    for (int i = threadIdx.x; i < dstView.objSize; i += blockDim.x)
+    {
+        const int dstId = dstStart + i;
+        const auto dstP = interaction.read(dstView, dstId);
+        if (!near(interaction.getPosition(dstP), srcBox)) continue;
+
+        auto accumulator = interaction.getZeroedAccumulator();
+
+        for (int j = 0; j < srcView.objSize; j++)
+        {
+            const int srcId = srcStart + j;
+            const auto srcP = interaction.read(srcView, srcId);
+
+            if (!interaction.withinCutoff(srcP, dstP)) continue;
+
+            const auto f = interaction(dstP, dstId, srcP, srcId);
+            accumulator.add(f);
+            accumulator.atomicAddToSrc(f, srcView, srcId);
+        }
+
+        accumulator.atomicAddToDst(accumulator.get(), dstView, dstId);
+    }
+}
+#endif
@@ -0,0 +1,68 @@
+#include "tabulated_function.h"
+
+#include <core/containers.h>
+#include <core/logger.h>
+#include <core/utils/cuda_common.h>
+
+#include <map>
+#include <memory>
+#include <utility>
+
+namespace
+{
+class TabulatedFunction : public TabulatedFunctionHandler
+{
+public:
+    TabulatedFunction(int nIntervals, const std::function<float(float)>& f) :
+        data(nIntervals)
+    {
+        this->nIntervals = nIntervals;
+
+        const float h = 1.0f / nIntervals;
+        for (int i = 0; i < nIntervals; i++)
+        {
+            const float left  = f(i * h);
+            const float right = f((i+1) * h);
+            data[i] = make_float2(left, right - left);
+        }
+        data.uploadToDevice(defaultStream);
+
+        cudaResourceDesc resDesc = {};
+        resDesc.resType                = cudaResourceTypeLinear;
+        resDesc.res.linear.devPtr      = data.devPtr();
+        resDesc.res.linear.desc        = cudaCreateChannelDesc<float2>();
+        resDesc.res.linear.sizeInBytes = nIntervals * sizeof(float2);
+
+        cudaTextureDesc texDesc = {};
+        texDesc.addressMode[0]   = cudaAddressModeClamp;
+        texDesc.filterMode       = cudaFilterModePoint;
+        texDesc.readMode         = cudaReadModeElementType;
+        texDesc.normalizedCoords = 0;
+
+        CUDA_Check( cudaCreateTextureObject(&tex, &resDesc, &texDesc, nullptr) );
+        CUDA_Check( cudaStreamSynchronize(defaultStream) );
+    }
+
+private:
+    PinnedBuffer<float2> data;
+};
+}
+
+const TabulatedFunctionHandler& TabulatedFunctions::get(const std::string& name, int nIntervals,
+                                                        std::function<float(float)> f)
+{
+    // never destroyed: the CUDA context may be gone when the static objects are
+    static auto *tables = new std::map< std::pair<std::string, int>, std::unique_ptr<TabulatedFunction> >;
+
+    if (nIntervals < 1)
+        die("Tabulated function '%s' needs at least 1 interval, got %d", name.c_str(), nIntervals);
+
+    auto& ptr = (*tables)[{name, nIntervals}];
+    if (!ptr)
+    {
+        debug("Building the table of '%s' with %d intervals", name.c_str(), nIntervals);
+        ptr.reset(new TabulatedFunction(nIntervals, f));
+    }
+
+    return *ptr;
+}
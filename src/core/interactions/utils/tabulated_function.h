@@ -0,0 +1,50 @@
+#pragma once
+
+#include <core/utils/cpu_gpu_defines.h>
+#include <core/utils/helper_math.h>
+
+#include <functional>
+#include <string>
+
+#ifndef __NVCC__
+template<typename T>
+T tex1Dfetch(cudaTextureObject_t t, int i)
+{
+    return T();
+}
+#endif
+
+/**
+ * Function of x in [0, 1] sampled at nIntervals+1 uniform points and linearly interpolated.
+ * Every interval is stored as (value at the left end, increment), such that one texture
+ * fetch and one FMA replace the transcendental functions of the inner loops.
+ * The caller ensures that x is within [0, 1]
+ */
+class TabulatedFunctionHandler
+{
+public:
+    __D__ inline float operator()(float x) const
+    {
+        const float s = x * nIntervals;
+        const int i = min((int) s, nIntervals - 1);
+        const float2 entry = tex1Dfetch<float2>(tex, i);
+
+        return entry.x + (s - i) * entry.y;
+    }
+
+protected:
+    cudaTextureObject_t tex;
+    int nIntervals;
+};
+
+/**
+ * Device tables of the tabulated functions, shared by all the interactions:
+ * a table is built once per name and resolution, the name must thus uniquely describe the function.
+ * The tables are small and live until the end of the program
+ */
+class TabulatedFunctions
+{
+public:
+    static const TabulatedFunctionHandler& get(const std::string& name, int nIntervals,
+                                               std::function<float(float)> f);
+};
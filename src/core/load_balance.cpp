@@ -0,0 +1,96 @@
+#include "load_balance.h"
+
+#include <core/logger.h>
+
+#include <algorithm>
+#include <numeric>
+#include <string>
+
+LoadBalanceMonitor::LoadBalanceMonitor(MPI_Comm cartComm) :
+    cartComm(cartComm)
+{
+    int periods[3], coords[3], nranks;
+    MPI_Check( MPI_Cart_get(cartComm, 3, dims, periods, coords) );
+    MPI_Check( MPI_Comm_size(cartComm, &nranks) );
+
+    rankCoords.resize(3 * nranks);
+    for (int r = 0; r < nranks; r++)
+        MPI_Check( MPI_Cart_coords(cartComm, r, 3, rankCoords.data() + 3*r) );
+}
+
+void LoadBalanceMonitor::report(double localLoad, const DomainInfo& domain) const
+{
+    int rank, nranks;
+    MPI_Check( MPI_Comm_rank(cartComm, &rank) );
+    MPI_Check( MPI_Comm_size(cartComm, &nranks) );
+
+    std::vector<double> loads(nranks);
+    MPI_Check( MPI_Gather(&localLoad, 1, MPI_DOUBLE, loads.data(), 1, MPI_DOUBLE, 0, cartComm) );
+
+    if (rank != 0) return;
+
+    const int slowest = std::max_element(loads.begin(), loads.end()) - loads.begin();
+    info("Load imbalance (max / average) is %.3f, the most loaded rank is %d", imbalance(loads), slowest);
+
+    const float lengths[3] = {domain.globalSize.x, domain.globalSize.y, domain.globalSize.z};
+    const char axes[3] = {'x', 'y', 'z'};
+
+    for (int d = 0; d < 3; d++)
+    {
+        if (dims[d] == 1) continue;
+
+        std::vector<double> slabLoads(dims[d], 0.0);
+        for (int r = 0; r < nranks; r++)
+            slabLoads[rankCoords[3*r + d]] += loads[r];
+
+        std::string planes;
+        for (auto x : balancedPlanes(slabLoads, lengths[d]))
+            planes += " " + std::to_string(x);
+
+        info("Balanced planes along %c would be at:%s (now every %g)",
+             axes[d], planes.c_str(), lengths[d] / dims[d]);
+    }
+}
+
+std::vector<float> LoadBalanceMonitor::balancedPlanes(const std::vector<double>& slabLoads, float length)
+{
+    const int n = slabLoads.size();
+    std::vector<float> planes;
+    if (n < 2) return planes;
+
+    const double width = length / n;
+    const double total = std::accumulate(slabLoads.begin(), slabLoads.end(), 0.0);
+
+    // no load: nothing to balance
+    if (total <= 0)
+    {
+        for (int i = 1; i < n; i++) planes.push_back(i * width);
+        return planes;
+    }
+
+    // invert the piecewise linear cumulative load
+    int slab = 0;
+    double before = 0;
+    for (int i = 1; i < n; i++)
+    {
+        const double target = total * i / n;
+
+        while (slab < n-1 && before + slabLoads[slab] < target)
+            before += slabLoads[slab++];
+
+        const double fraction = slabLoads[slab] > 0 ? (target - before) / slabLoads[slab] : 0.0;
+        planes.push_back( (slab + std::min(fraction, 1.0)) * width );
+    }
+
+    return planes;
+}
+
+double LoadBalanceMonitor::imbalance(const std::vector<double>& loads)
+{
+    if (loads.empty()) return 1.0;
+
+    const double average = std::accumulate(loads.begin(), loads.end(), 0.0) / loads.size();
+    const double maximum = *std::max_element(loads.begin(), loads.end());
+
+    return average > 0 ? maximum / average : 1.0;
+}
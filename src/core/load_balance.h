@@ -0,0 +1,40 @@
+#pragma once
+
+#include "domain.h"
+
+#include <mpi.h>
+#include <vector>
+
+/**
+ * Measurement of the load imbalance between the ranks of the Cartesian grid.
+ *
+ * The subdomains are all of the same size (see createDomainInfo()),
+ * the halo exchangers and the cell-lists rely on it.
+ * This only tells how far the decomposition is from balanced,
+ * and where moving planes along each axis would have to go to balance the load.
+ */
+class LoadBalanceMonitor
+{
+public:
+    LoadBalanceMonitor(MPI_Comm cartComm);
+
+    /**
+     * Gather the loads of all the ranks and log the imbalance
+     * and the balanced planes on rank 0. Collective over cartComm
+     */
+    void report(double localLoad, const DomainInfo& domain) const;
+
+    /**
+     * Positions of the n-1 inner planes splitting [0, length) into n slabs of equal load,
+     * given the loads of n slabs of equal width and assuming uniform load within each of them
+     */
+    static std::vector<float> balancedPlanes(const std::vector<double>& slabLoads, float length);
+
+    /// maximum over average of the loads, 1 if balanced
+    static double imbalance(const std::vector<double>& loads);
+
+private:
+    MPI_Comm cartComm;
+    int dims[3];
+    std::vector<int> rankCoords;  ///< 3 coordinates per rank
+};
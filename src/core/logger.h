@@ -11,6 +11,10 @@
 
 #include <cstdio>
 #include <string>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
 
 #include <core/utils/stacktrace_explicit.h>
 
@@ -47,6 +51,11 @@
  * \endcode
  * has to be defined in one the objective file (typically main). Prior to any logging
  * a method init() must be called
+ *
+ * In the asynchronous mode, see setAsync(), the calling thread only formats the message
+ * into a lock-free ring buffer, and a background thread writes the buffer to the file.
+ * The number of messages per second of each logging call site may also be limited,
+ * see setRateLimit()
  */
 class Logger
 {
@@ -58,6 +67,8 @@ public:
     /// Flush and close file
     ~Logger()
     {
+        setAsync(false);
+
         if (fout != nullptr)
         {
             fflush(fout);
@@ -147,18 +158,21 @@ public:
         using namespace std::chrono;
 
         auto now   = system_clock::now();
-        auto now_c = system_clock::to_time_t(now);
-        auto ms = duration_cast<milliseconds>(now.time_since_epoch()) % 1000;
 
-        std::ostringstream tmout;
-        tmout << std::put_time(std::localtime(&now_c), "%T") << ':' << std::setfill('0') << std::setw(3) << ms.count();
+        // errors are never suppressed
+        if (importance > 1 && rateLimit > 0 && !_allowedBySite(fname, lnum, now))
+            return;
 
-        const int cappedLvl = std::min((int)lvl2text.size() - 1, importance);
-        std::string intro = tmout.str() + "   " + std::string("Rank %04d %7s at ")
-            + fname + ":" + std::to_string(lnum) + "  " +pattern + "\n";
+        if (async)
+        {
+            _push(importance, fname, lnum, now, pattern, args...);
+            return;
+        }
+
+        std::string intro = "%s" + _prefix(now, importance, fname, lnum) + pattern + "\n"; // shut up compiler warning
 
         FILE* ftmp = (fout != nullptr) ? fout : stdout;
-        fprintf(ftmp, intro.c_str(), rank, (cappedLvl >= 0 ? lvl2text[cappedLvl] : "").c_str(), args...);
+        fprintf(ftmp, intro.c_str(), "", args...);
 
 
         bool needToFlush = runtimeDebugLvl >= flushThreshold && COMPILE_DEBUG_LVL >= flushThreshold;
@@ -196,6 +210,8 @@ public:
     template<class ... Args>
     inline void _die(Args ... args)
     {
+        // write everything still in the ring buffer before the fatal message
+        setAsync(false);
         log<0>(args...);
         
         // print stacktrace
@@ -248,6 +264,54 @@ public:
         log<-1>(__FILE__, __LINE__, "Debug level requested %d, set to %d", debugLvl, runtimeDebugLvl);
     }
 
+    /**
+     * Switch to the asynchronous mode: the messages are formatted into a ring buffer
+     * and written by a background thread, which flushes the file every #flushPeriod.
+     * When the buffer is full, the calling threads wait for free space.
+     * Switching back to the synchronous mode writes all the pending messages.
+     *
+     * \rst
+     * .. attention::
+     *    The pending messages are lost if the process is killed by a signal
+     * \endrst
+     */
+    void setAsync(bool enabled)
+    {
+        if (enabled == async) return;
+
+        if (enabled)
+        {
+            if (ring == nullptr)
+                ring.reset(new RingRecord[ringCapacity]);
+
+            for (uint64_t i = 0; i < ringCapacity; i++)
+                ring[i].sequence.store(i, std::memory_order_relaxed);
+            head = 0;
+            tail = 0;
+
+            stopFlusher = false;
+            async = true;
+            flusher = std::thread([this] () { _flushLoop(); });
+        }
+        else
+        {
+            async = false;
+            stopFlusher = true;
+            flusher.join();
+        }
+    }
+
+    /**
+     * Only write the first \p maxPerSecond messages of each call site of every second,
+     * and later report how many were suppressed. Errors are never suppressed.
+     *
+     * @param maxPerSecond limit per call site, 0 to log everything
+     */
+    void setRateLimit(int maxPerSecond)
+    {
+        rateLimit = std::max(maxPerSecond, 0);
+    }
+
     /**
      * @param fname name of the current source file
      * @param lnum  line number of the source file
@@ -260,6 +324,158 @@ public:
     }
 
 private:
+
+    static constexpr int maxRecordLength  = 512;
+    static constexpr uint64_t ringCapacity = 4096;
+    static constexpr int nSites           = 1024;
+
+    /// one message of the ring buffer, the sequence tells whether it is free or ready
+    struct RingRecord
+    {
+        std::atomic<uint64_t> sequence;
+        std::chrono::system_clock::time_point time;
+        int importance;
+        const char *fname;
+        int lnum;
+        char text[maxRecordLength];
+    };
+
+    /// approximate number of messages of the call sites with the same hash in the current second
+    struct SiteCounter
+    {
+        std::atomic<int64_t> second {0};
+        std::atomic<int> count {0}, suppressed {0};
+    };
+
+    inline std::string _prefix(std::chrono::system_clock::time_point now, int importance, const char *fname, int lnum) const
+    {
+        using namespace std::chrono;
+
+        auto now_c = system_clock::to_time_t(now);
+        auto ms = duration_cast<milliseconds>(now.time_since_epoch()) % 1000;
+
+        std::ostringstream tmout;
+        tmout << std::put_time(std::localtime(&now_c), "%T") << ':' << std::setfill('0') << std::setw(3) << ms.count();
+
+        const int cappedLvl = std::min((int)lvl2text.size() - 1, importance);
+        char rankStr[32];
+        snprintf(rankStr, sizeof(rankStr), "Rank %04d %7s at ", rank, (cappedLvl >= 0 ? lvl2text[cappedLvl] : "").c_str());
+
+        return tmout.str() + "   " + rankStr + fname + ":" + std::to_string(lnum) + "  ";
+    }
+
+    /// lock-free multiple producers, see D. Vyukov's bounded MPMC queue
+    template<class ... Args>
+    inline void _push(int importance, const char *fname, int lnum, std::chrono::system_clock::time_point now,
+                      const char *pattern, Args... args) const
+    {
+        uint64_t pos = head.load(std::memory_order_relaxed);
+        RingRecord *record;
+
+        while (true)
+        {
+            record = &ring[pos % ringCapacity];
+            const uint64_t seq = record->sequence.load(std::memory_order_acquire);
+            const int64_t diff = (int64_t) seq - (int64_t) pos;
+
+            if (diff == 0)
+            {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                // full buffer, wait for the background thread rather than losing messages
+                std::this_thread::yield();
+                pos = head.load(std::memory_order_relaxed);
+            }
+            else
+                pos = head.load(std::memory_order_relaxed);
+        }
+
+        record->time = now;
+        record->importance = importance;
+        record->fname = fname;
+        record->lnum = lnum;
+
+        std::string intro = "%s" + std::string(pattern); // shut up compiler warning
+        snprintf(record->text, maxRecordLength, intro.c_str(), "", args...);
+
+        record->sequence.store(pos + 1, std::memory_order_release);
+    }
+
+    /// write the ready records, return how many
+    inline int _drain()
+    {
+        int n = 0;
+
+        while (true)
+        {
+            RingRecord& record = ring[tail % ringCapacity];
+            if (record.sequence.load(std::memory_order_acquire) != tail + 1)
+                break;
+
+            const std::string intro = _prefix(record.time, record.importance, record.fname, record.lnum);
+            fputs(intro.c_str(), fout);
+            fputs(record.text, fout);
+            fputc('\n', fout);
+
+            record.sequence.store(tail + ringCapacity, std::memory_order_release);
+            tail++;
+            n++;
+        }
+
+        return n;
+    }
+
+    inline void _flushLoop()
+    {
+        while (true)
+        {
+            const bool stopping = stopFlusher.load();
+            const int n = _drain();
+
+            auto now = std::chrono::system_clock::now();
+            if (now - lastFlushed > flushPeriod || stopping)
+            {
+                fflush(fout);
+                lastFlushed = now;
+            }
+
+            if (stopping) break;
+            if (n == 0) std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+    }
+
+    inline bool _allowedBySite(const char *fname, int lnum, std::chrono::system_clock::time_point now) const
+    {
+        const size_t hash = (reinterpret_cast<size_t>(fname) >> 3) * 31 + lnum;
+        SiteCounter& site = sites[hash % nSites];
+
+        const int64_t second = std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch()).count();
+        int64_t current = site.second.load(std::memory_order_relaxed);
+
+        if (current != second && site.second.compare_exchange_strong(current, second))
+        {
+            site.count = 0;
+            const int suppressed = site.suppressed.exchange(0);
+
+            if (suppressed > 0)
+            {
+                if (async)
+                    _push(2, fname, lnum, now, "%d similar messages were suppressed", suppressed);
+                else
+                    fprintf(fout, "%s%d similar messages were suppressed\n", _prefix(now, 2, fname, lnum).c_str(), suppressed);
+            }
+        }
+
+        if (site.count.fetch_add(1, std::memory_order_relaxed) < rateLimit)
+            return true;
+
+        site.suppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
     int runtimeDebugLvl;           ///< debug level defined at runtime through setDebugLvl
     const int flushThreshold = 8;  ///< value of debug level starting with which every message
                                    ///< will be flushed to disk immediately
@@ -272,6 +488,17 @@ private:
     FILE* fout = nullptr;
     int rank;
 
+    std::atomic<bool> async {false};
+    int rateLimit {0};
+
+    std::unique_ptr<RingRecord[]> ring;
+    mutable std::atomic<uint64_t> head {0};
+    uint64_t tail {0};
+    std::atomic<bool> stopFlusher {false};
+    std::thread flusher;
+
+    mutable std::array<SiteCounter, nSites> sites;
+
     /**
      * Messages will be prefixed with the line from this array depending on their importance level
      */
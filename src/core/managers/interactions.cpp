@@ -1,7 +1,9 @@
 #include "interactions.h"
 
 #include <core/celllist.h>
+#include <core/pvs/object_vector.h>
 
+#include <algorithm>
 #include <set>
 
 static void insertClist(CellList *cl, std::vector<CellList*>& clists)
@@ -37,6 +39,13 @@ void InteractionManager::add(Interaction *interaction, ParticleVector *pv1, Part
     if (cl1 != cl2)
         addChannels(cl2);
 
+    auto& haloInputChannels = intermediateOutput.empty() ? finalHaloInputChannels : intermediateHaloInputChannels;
+    for (const auto& name : interaction->getHaloInputChannels())
+    {
+        haloInputChannels[pv1].insert(name);
+        haloInputChannels[pv2].insert(name);
+    }
+
     insertClist(cl1, cellListMap[pv1]);
     insertClist(cl2, cellListMap[pv2]);
 
@@ -75,6 +84,28 @@ float InteractionManager::getMaxEffectiveCutoff() const
     return rcIntermediate + rcFinal;
 }
 
+size_t InteractionManager::getActiveChannelsKey() const
+{
+    size_t key = 0;
+    int bit = 0;
+
+    auto addActivity = [&key, &bit] (const std::map<CellList*, ChannelActivityList>& cellChannels) {
+        for (const auto& entry : cellChannels)
+            for (const auto& channel : entry.second)
+            {
+                if (channel.second())
+                    key ^= (size_t)1 << (bit % (8 * sizeof(size_t)));
+                bit++;
+            }
+    };
+
+    addActivity(cellIntermediateOutputChannels);
+    addActivity(cellIntermediateInputChannels);
+    addActivity(cellFinalChannels);
+
+    return key;
+}
+
 CellList* InteractionManager::getLargestCellListNeededForIntermediate(ParticleVector *pv) const
 {
     return _getLargestCellListNeeded(pv, cellIntermediateOutputChannels);
@@ -95,28 +126,75 @@ std::vector<std::string> InteractionManager::getExtraFinalChannels(ParticleVecto
     return _getExtraChannels(pv, cellFinalChannels);
 }
 
+std::vector<std::string> InteractionManager::getIntermediateHaloChannels(ParticleVector *pv) const
+{
+    auto it = intermediateHaloInputChannels.find(pv);
+    if (it == intermediateHaloInputChannels.end()) return {};
+    return {it->second.begin(), it->second.end()};
+}
+
+std::vector<std::string> InteractionManager::getFinalHaloChannels(ParticleVector *pv) const
+{
+    auto inputs = _getExtraChannels(pv, cellIntermediateInputChannels);
+    std::set<std::string> channels(inputs.begin(), inputs.end());
+
+    auto it = finalHaloInputChannels.find(pv);
+    if (it != finalHaloInputChannels.end())
+        channels.insert(it->second.begin(), it->second.end());
+
+    return {channels.begin(), channels.end()};
+}
+
 
 void InteractionManager::clearIntermediates(ParticleVector *pv, cudaStream_t stream)
 {
-    _clearChannels(pv, cellIntermediateOutputChannels, stream);
-    _clearChannels(pv, cellIntermediateInputChannels, stream);
+    ClearBatch batch;
+    clearIntermediates(pv, batch);
+    batch.run(stream);
 }
 
 void InteractionManager::clearFinal(ParticleVector *pv, cudaStream_t stream)
 {
-    _clearChannels(pv, cellFinalChannels, stream);
+    ClearBatch batch;
+    clearFinal(pv, batch);
+    batch.run(stream);
 }
 
 void InteractionManager::clearIntermediatesPV(ParticleVector *pv, LocalParticleVector *lpv, cudaStream_t stream) const
 {
-    _clearPVChannels(pv, lpv, cellIntermediateOutputChannels, stream);
-    _clearPVChannels(pv, lpv, cellIntermediateInputChannels, stream);
+    ClearBatch batch;
+    clearIntermediatesPV(pv, lpv, batch);
+    batch.run(stream);
 }
 
 void InteractionManager::clearFinalPV(ParticleVector *pv, LocalParticleVector *lpv, cudaStream_t stream) const
 {
-    _clearPVChannels(pv, lpv, cellFinalChannels, stream);
-    lpv->forces.clearDevice(stream);
+    ClearBatch batch;
+    clearFinalPV(pv, lpv, batch);
+    batch.run(stream);
+}
+
+void InteractionManager::clearIntermediates(ParticleVector *pv, ClearBatch& batch) const
+{
+    _clearChannels(pv, cellIntermediateOutputChannels, batch);
+    _clearChannels(pv, cellIntermediateInputChannels, batch);
+}
+
+void InteractionManager::clearFinal(ParticleVector *pv, ClearBatch& batch) const
+{
+    _clearChannels(pv, cellFinalChannels, batch);
+}
+
+void InteractionManager::clearIntermediatesPV(ParticleVector *pv, LocalParticleVector *lpv, ClearBatch& batch) const
+{
+    _clearPVChannels(pv, lpv, cellIntermediateOutputChannels, batch);
+    _clearPVChannels(pv, lpv, cellIntermediateInputChannels, batch);
+}
+
+void InteractionManager::clearFinalPV(ParticleVector *pv, LocalParticleVector *lpv, ClearBatch& batch) const
+{
+    _clearPVChannels(pv, lpv, cellFinalChannels, batch);
+    batch.add(&lpv->forces);
 }
 
 
@@ -146,6 +224,49 @@ void InteractionManager::executeLocalFinal(cudaStream_t stream)
     _executeLocal(finalInteractions, stream);
 }
 
+void InteractionManager::prepareEarlyInterior()
+{
+    for (auto& p : finalInteractions)
+    {
+        if (p.pv1 != p.pv2 || p.cl1 != p.cl2) continue;
+
+        auto pv = p.pv1;
+        auto cl = p.cl1;
+
+        if (dynamic_cast<ObjectVector*>(pv) != nullptr) continue;
+        if (dynamic_cast<PrimaryCellList*>(cl) == nullptr) continue;
+
+        bool sameCellList = true;
+        float rcIntermediate = 0.0f;
+
+        for (auto& q : intermediateInteractions)
+        {
+            if (q.pv1 == pv) sameCellList = sameCellList && q.cl1 == cl;
+            if (q.pv2 == pv) sameCellList = sameCellList && q.cl2 == cl;
+
+            if (q.pv1 == pv || q.pv2 == pv)
+                rcIntermediate = std::max(rcIntermediate, q.interaction->rc);
+        }
+
+        if (!sameCellList)
+        {
+            debug("Interior of '%s' can not be computed early by '%s': intermediate interactions use other cell-lists",
+                  pv->name.c_str(), p.interaction->name.c_str());
+            continue;
+        }
+
+        // source particles are within rc, their intermediate channels must have no halo contribution
+        if (p.interaction->setInteriorMargin(pv, cl, p.interaction->rc + rcIntermediate))
+            interiorInteractions.push_back(p);
+    }
+}
+
+void InteractionManager::executeLocalFinalInterior(cudaStream_t stream)
+{
+    for (auto& p : interiorInteractions)
+        p.interaction->localInterior(p.pv1, p.cl1, stream);
+}
+
 void InteractionManager::executeHaloIntermediate(cudaStream_t stream)
 {
     _executeHalo(intermediateInteractions, stream);
@@ -239,10 +360,36 @@ std::vector<std::string> InteractionManager::_getExtraChannels(ParticleVector *p
 }
 
 
+/**
+ * Interactions with a batch key are grouped, in the order of their first appearance,
+ * and each group is computed with one call to Interaction::localBatch()
+ */
 void InteractionManager::_executeLocal(std::vector<InteractionPrototype>& interactions, cudaStream_t stream)
 {
+    std::vector<std::string> keys;
+    std::map<std::string, std::vector<Interaction::BatchEntry>> batches;
+
     for (auto& p : interactions)
-        p.interaction->local(p.pv1, p.pv2, p.cl1, p.cl2, stream);
+    {
+        auto key = p.interaction->getBatchKey();
+
+        if (key.empty())
+        {
+            p.interaction->local(p.pv1, p.pv2, p.cl1, p.cl2, stream);
+            continue;
+        }
+
+        if (batches.find(key) == batches.end())
+            keys.push_back(key);
+
+        batches[key].push_back({p.interaction, p.pv1, p.pv2, p.cl1, p.cl2});
+    }
+
+    for (auto& key : keys)
+    {
+        auto& entries = batches[key];
+        entries[0].interaction->localBatch(entries, stream);
+    }
 }
 
 void InteractionManager::_executeHalo(std::vector<InteractionPrototype>& interactions, cudaStream_t stream)
@@ -300,18 +447,18 @@ std::vector<std::string> InteractionManager::_extractActiveChannels(ParticleVect
 
 void InteractionManager::_clearPVChannels(ParticleVector *pv, LocalParticleVector *lpv,
                                           const std::map<CellList*, ChannelActivityList>& cellChannels,
-                                          cudaStream_t stream) const
+                                          ClearBatch& batch) const
 {
     auto activeChannels = _extractActiveChannels(pv, cellChannels);
     
     for (const auto& channelName : activeChannels)
     {
         if (channelName == ChannelNames::forces) continue;
-        lpv->extraPerParticle.getGenericData(channelName)->clearDevice(stream);
+        batch.add(lpv->extraPerParticle.getGenericData(channelName));
     }
 }
 
-void InteractionManager::_clearChannels(ParticleVector *pv, const std::map<CellList*, ChannelActivityList>& cellChannels, cudaStream_t stream) const
+void InteractionManager::_clearChannels(ParticleVector *pv, const std::map<CellList*, ChannelActivityList>& cellChannels, ClearBatch& batch) const
 {
     auto clList = cellListMap.find(pv);
 
@@ -324,7 +471,7 @@ void InteractionManager::_clearChannels(ParticleVector *pv, const std::map<CellL
         
         if (it != cellChannels.end()) {
             auto activeChannels = _extractActiveChannels(it->second);
-            cl->clearChannels(activeChannels, stream);
+            cl->clearChannels(activeChannels, batch);
         }
     }
 }
@@ -3,12 +3,14 @@
 #include <core/interactions/interface.h>
 
 #include <map>
+#include <set>
 #include <string>
 #include <vector>
 
 class ParticleVector;
 class LocalParticleVector;
 class CellList;
+class ClearBatch;
 
 /**
  * Interaction manager.
@@ -27,12 +29,28 @@ public:
     void check() const;
 
     float getMaxEffectiveCutoff() const;
+
+    /// @return a key that changes whenever the set of active channels changes
+    size_t getActiveChannelsKey() const;
     
     CellList* getLargestCellListNeededForIntermediate(ParticleVector *pv) const;
     CellList* getLargestCellListNeededForFinal       (ParticleVector *pv) const;
 
     std::vector<std::string> getExtraIntermediateChannels(ParticleVector *pv) const;
     std::vector<std::string> getExtraFinalChannels       (ParticleVector *pv) const;    
+
+    /**
+     * Extra channels read from the halo of \p pv by the intermediate interactions,
+     * i.e. the properties of Interaction::getHaloInputChannels(), to send with the intermediate halo
+     */
+    std::vector<std::string> getIntermediateHaloChannels(ParticleVector *pv) const;
+
+    /**
+     * Extra channels read from the halo of \p pv by the final interactions, to send with the final halo:
+     * the intermediate channels of Interaction::getIntermediateInputChannels() and the properties
+     * of Interaction::getHaloInputChannels(). The intermediate channels nobody reads are not sent
+     */
+    std::vector<std::string> getFinalHaloChannels       (ParticleVector *pv) const;
     
     void clearIntermediates (ParticleVector *pv, cudaStream_t stream);
     void clearFinal         (ParticleVector *pv, cudaStream_t stream);
@@ -40,6 +58,12 @@ public:
     void clearIntermediatesPV (ParticleVector *pv, LocalParticleVector *lpv, cudaStream_t stream) const;
     void clearFinalPV         (ParticleVector *pv, LocalParticleVector *lpv, cudaStream_t stream) const;
 
+    /// same as above, the buffers are only added to \p batch, to be cleared together by ClearBatch::run()
+    void clearIntermediates   (ParticleVector *pv, ClearBatch& batch) const;
+    void clearFinal           (ParticleVector *pv, ClearBatch& batch) const;
+    void clearIntermediatesPV (ParticleVector *pv, LocalParticleVector *lpv, ClearBatch& batch) const;
+    void clearFinalPV         (ParticleVector *pv, LocalParticleVector *lpv, ClearBatch& batch) const;
+
     void accumulateIntermediates(cudaStream_t stream);
     void accumulateFinal(cudaStream_t stream);
 
@@ -48,6 +72,17 @@ public:
     void executeLocalIntermediate(cudaStream_t stream);
     void executeLocalFinal(cudaStream_t stream);
 
+    /**
+     * Offer the final self interactions to compute their interior early, see Interaction::setInteriorMargin().
+     * Only for the particle vectors with a primary cell-list used by all their intermediate interactions:
+     * the intermediate channels further than the intermediate cut-off from the boundary are then
+     * complete right after executeLocalIntermediate()
+     */
+    void prepareEarlyInterior();
+
+    /// final interactions of the interiors, only requires executeLocalIntermediate(), see prepareEarlyInterior()
+    void executeLocalFinalInterior(cudaStream_t stream);
+
     void executeHaloIntermediate(cudaStream_t stream);
     void executeHaloFinal(cudaStream_t stream);
 
@@ -59,6 +94,7 @@ private:
     std::map<CellList*, ChannelActivityList> cellIntermediateInputChannels;
     std::map<CellList*, ChannelActivityList> cellFinalChannels;
     std::map<ParticleVector*, std::vector<CellList*>> cellListMap;
+    std::map<ParticleVector*, std::set<std::string>> intermediateHaloInputChannels, finalHaloInputChannels;
     
     struct InteractionPrototype
     {
@@ -69,6 +105,7 @@ private:
 
     std::vector<InteractionPrototype> intermediateInteractions;
     std::vector<InteractionPrototype> finalInteractions;
+    std::vector<InteractionPrototype> interiorInteractions; ///< final interactions with the interior computed early
 
 private:
 
@@ -92,10 +129,10 @@ private:
     // clear ONLY PV channels
     void _clearPVChannels(ParticleVector *pv, LocalParticleVector *lpv,
                           const std::map<CellList*, ChannelActivityList>& cellChannels,
-                          cudaStream_t stream) const;
+                          ClearBatch& batch) const;
 
     // clear cell list channels
-    void _clearChannels     (ParticleVector *pv, const std::map<CellList*, ChannelActivityList>& cellChannels, cudaStream_t stream) const;    
+    void _clearChannels     (ParticleVector *pv, const std::map<CellList*, ChannelActivityList>& cellChannels, ClearBatch& batch) const;
     void _accumulateChannels(                    const std::map<CellList*, ChannelActivityList>& cellChannels, cudaStream_t stream) const;
     void _gatherChannels    (                    const std::map<CellList*, ChannelActivityList>& cellChannels, cudaStream_t stream) const;
 };
@@ -1,13 +1,14 @@
 #include "marching_cubes.h"
 
-#include <cstdint>
+#include <core/logger.h>
+#include <core/xdmf/xdmf.h>
 
 // inspired from https://github.com/nsf/mc
 
 namespace MarchingCubes
 {
 
-static constexpr uint64_t marchingCubeTris[256] =
+extern const uint64_t marchingCubeTris[256] =
     {0ULL, 33793ULL, 36945ULL, 159668546ULL,
      18961ULL, 144771090ULL, 5851666ULL, 595283255635ULL,
      20913ULL, 67640146ULL, 193993474ULL, 655980856339ULL,
@@ -184,4 +185,32 @@ void computeTriangles(DomainInfo domain, float3 resolution,
     }
 }
 
+void dumpTriangles2XDMF(std::string filename, const std::vector<Triangle>& triangles, float time, MPI_Comm comm)
+{
+    const long nVertices = 3 * triangles.size();
+    long vertexOffset = 0;
+    MPI_Check( MPI_Exscan(&nVertices, &vertexOffset, 1, MPI_LONG, MPI_SUM, comm) );
+
+    // triangle soup: the vertices of the triangles are not shared
+    auto positions    = std::make_shared<std::vector<float>>(3 * nVertices);
+    auto connectivity = std::make_shared<std::vector<int>>(nVertices);
+
+    for (long i = 0; i < triangles.size(); i++)
+    {
+        const float3 vs[3] = {triangles[i].a, triangles[i].b, triangles[i].c};
+
+        for (int j = 0; j < 3; j++)
+        {
+            const long id = 3*i + j;
+            (*positions)[3*id + 0] = vs[j].x;
+            (*positions)[3*id + 1] = vs[j].y;
+            (*positions)[3*id + 2] = vs[j].z;
+            (*connectivity)[id] = vertexOffset + id;
+        }
+    }
+
+    XDMF::TriangleMeshGrid grid(positions, connectivity, comm);
+    XDMF::write(filename, &grid, {}, time, comm);
+}
+
 } // namespace MarchingCubes
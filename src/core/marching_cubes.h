@@ -1,8 +1,13 @@
 #pragma once
 
+#include "containers.h"
 #include "domain.h"
 
+#include <cstdint>
+#include <cuda_runtime.h>
 #include <functional>
+#include <mpi.h>
+#include <string>
 #include <vector>
 
 namespace MarchingCubes
@@ -14,8 +19,53 @@ struct Triangle
     float3 a, b, c;
 };
 
+/// triangles of the 256 configurations of a cube: their number, then 4 bits per edge id
+extern const uint64_t marchingCubeTris[256];
+
 void computeTriangles(DomainInfo domain, float3 resolution,
                       const ImplicitSurfaceFunction& surface,
                       std::vector<Triangle>& triangles);
 
+/**
+ * Write the \p triangles of all the ranks of \p comm, in global coordinates,
+ * as one XDMF triangle mesh
+ */
+void dumpTriangles2XDMF(std::string filename, const std::vector<Triangle>& triangles, float time, MPI_Comm comm);
+
+/**
+ * Marching cubes on the GPU, for the isosurfaces of fields that live on the device.
+ *
+ * The field is given at the nodes of a uniform grid, x being the fastest index.
+ * One thread per cube finds its configuration and counts its triangles;
+ * the counts are scanned and each cube writes its triangles at its offset,
+ * such that the output is compact and ordered as the cubes.
+ * The triangles are the same as the ones of computeTriangles()
+ */
+class GPUMarchingCubes
+{
+public:
+    GPUMarchingCubes();
+
+    /**
+     * Extract the isosurface \p isoValue of \p field.
+     * @param field device array of the nNodes.x * nNodes.y * nNodes.z values
+     * @param h spacing of the nodes
+     * @param origin position of the first node, the triangles are in the same coordinates
+     * Waits for the number of triangles on the host
+     */
+    void compute(const float *field, int3 nNodes, float3 h, float3 origin, float isoValue, cudaStream_t stream);
+
+    int size() const;
+    const Triangle* devPtr() const;
+
+    /// blocking download of the triangles of the last compute()
+    void download(std::vector<Triangle>& triangles, cudaStream_t stream);
+
+private:
+    DeviceBuffer<int> counts, offsets;
+    DeviceBuffer<char> scanBuffer;
+    PinnedBuffer<Triangle> triangles;
+    PinnedBuffer<int> nTriangles{1};
+};
+
 } // namespace MarchingCubes
@@ -0,0 +1,149 @@
+#include "marching_cubes.h"
+
+#include <core/logger.h>
+#include <core/utils/cuda_common.h>
+#include <core/utils/kernel_launch.h>
+
+#include <extern/cub/cub/device/device_scan.cuh>
+
+namespace MarchingCubes
+{
+namespace GPUMarchingCubesKernels
+{
+
+__constant__ uint64_t triangleTable[256];
+
+/// corners of the two ends of each edge, corner k is at ( k&1, (k>>1)&1, (k>>2)&1 )
+__constant__ int edgeCorners[12][2] = {
+    {0, 1}, {2, 3}, {4, 5}, {6, 7},
+    {0, 2}, {1, 3}, {4, 6}, {5, 7},
+    {0, 4}, {1, 5}, {2, 6}, {3, 7}
+};
+
+__device__ inline float3 cornerOffset(int k)
+{
+    return make_float3(k & 1, (k >> 1) & 1, (k >> 2) & 1);
+}
+
+/**
+ * One thread per cube.
+ * Without triangles, only write the number of triangles of each cube to counts,
+ * otherwise write them starting from offsets[cubeId]
+ */
+__global__ void marchCubes(const float *field, int3 nNodes, float3 h, float3 origin, float isoValue,
+                           int *counts, const int *offsets, Triangle *triangles)
+{
+    const int cubeId = blockIdx.x * blockDim.x + threadIdx.x;
+    const int3 nCubes = nNodes - 1;
+    if (cubeId >= nCubes.x * nCubes.y * nCubes.z) return;
+
+    const int3 cid3 = make_int3( cubeId % nCubes.x,
+                                (cubeId / nCubes.x) % nCubes.y,
+                                 cubeId / (nCubes.x * nCubes.y) );
+
+    float vs[8];
+    int config = 0;
+
+#pragma unroll
+    for (int k = 0; k < 8; k++)
+    {
+        const int3 node = cid3 + make_int3(k & 1, (k >> 1) & 1, (k >> 2) & 1);
+        vs[k] = field[(node.z * nNodes.y + node.y) * nNodes.x + node.x] - isoValue;
+        config |= (vs[k] < 0.0f) << k;
+    }
+
+    const uint64_t tris = triangleTable[config];
+    const int nTriangles = tris & 0xF;
+
+    if (triangles == nullptr)
+    {
+        counts[cubeId] = nTriangles;
+        return;
+    }
+
+    const float3 r = origin + make_float3(cid3) * h;
+    Triangle *dst = triangles + offsets[cubeId];
+
+    auto edgeVertex = [&] (int edge) {
+        const int a = edgeCorners[edge][0];
+        const int b = edgeCorners[edge][1];
+        const float3 ra = cornerOffset(a);
+        const float3 rb = cornerOffset(b);
+
+        return r + h * (ra + (rb - ra) * vs[a] / (vs[a] - vs[b]));
+    };
+
+    for (int i = 0; i < nTriangles; i++)
+    {
+        const int offset = 4 + 12 * i;
+        Triangle t;
+        t.a = edgeVertex( (tris >> (offset + 0)) & 0xF );
+        t.b = edgeVertex( (tris >> (offset + 4)) & 0xF );
+        t.c = edgeVertex( (tris >> (offset + 8)) & 0xF );
+        dst[i] = t;
+    }
+}
+} // namespace GPUMarchingCubesKernels
+
+GPUMarchingCubes::GPUMarchingCubes()
+{
+    CUDA_Check( cudaMemcpyToSymbol(GPUMarchingCubesKernels::triangleTable, marchingCubeTris, sizeof(marchingCubeTris)) );
+}
+
+void GPUMarchingCubes::compute(const float *field, int3 nNodes, float3 h, float3 origin, float isoValue, cudaStream_t stream)
+{
+    const int3 nCubes = nNodes - 1;
+    const int n = nCubes.x * nCubes.y * nCubes.z;
+    const int nthreads = 128;
+
+    if (nCubes.x <= 0 || nCubes.y <= 0 || nCubes.z <= 0)
+        die("Marching cubes need at least 2 nodes along each direction, got [%d %d %d]",
+            nNodes.x, nNodes.y, nNodes.z);
+
+    counts .resize_anew(n + 1);
+    offsets.resize_anew(n + 1);
+    counts.clear(stream);
+
+    SAFE_KERNEL_LAUNCH(
+            GPUMarchingCubesKernels::marchCubes,
+            getNblocks(n, nthreads), nthreads, 0, stream,
+            field, nNodes, h, origin, isoValue,
+            counts.devPtr(), nullptr, nullptr );
+
+    size_t bufSize = 0;
+    cub::DeviceScan::ExclusiveSum(nullptr, bufSize, counts.devPtr(), offsets.devPtr(), n+1, stream);
+    scanBuffer.resize_anew(bufSize);
+    cub::DeviceScan::ExclusiveSum(scanBuffer.devPtr(), bufSize, counts.devPtr(), offsets.devPtr(), n+1, stream);
+
+    CUDA_Check( cudaMemcpyAsync(nTriangles.hostPtr(), offsets.devPtr() + n, sizeof(int),
+                                cudaMemcpyDeviceToHost, stream) );
+    CUDA_Check( cudaStreamSynchronize(stream) );
+
+    triangles.resize_anew(nTriangles[0]);
+
+    SAFE_KERNEL_LAUNCH(
+            GPUMarchingCubesKernels::marchCubes,
+            getNblocks(n, nthreads), nthreads, 0, stream,
+            field, nNodes, h, origin, isoValue,
+            nullptr, offsets.devPtr(), triangles.devPtr() );
+
+    debug2("Marching cubes extracted %d triangles out of %d cubes", nTriangles[0], n);
+}
+
+int GPUMarchingCubes::size() const
+{
+    return nTriangles[0];
+}
+
+const Triangle* GPUMarchingCubes::devPtr() const
+{
+    return triangles.devPtr();
+}
+
+void GPUMarchingCubes::download(std::vector<Triangle>& triangles, cudaStream_t stream)
+{
+    this->triangles.downloadFromDevice(stream, ContainersSynch::Synch);
+    triangles.assign(this->triangles.hostPtr(), this->triangles.hostPtr() + size());
+}
+
+} // namespace MarchingCubes
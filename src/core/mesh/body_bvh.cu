@@ -0,0 +1,51 @@
+#include "bvh.h"
+#include "mesh.h"
+
+#include <core/logger.h>
+#include <core/utils/cuda_common.h>
+#include <core/utils/kernel_launch.h>
+#include <core/utils/make_unique.h>
+
+namespace BodyBVHKernels
+{
+
+/// One thread per triangle of the mesh in its own frame
+__global__ void computeTriangleBoxes(MeshView mesh, const float4 *vertices, AABB *boxes)
+{
+    const int trid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (trid >= mesh.ntriangles) return;
+
+    const int3 triangle = mesh.getTriangle(trid);
+    const float3 v0 = f4tof3(vertices[triangle.x]);
+    const float3 v1 = f4tof3(vertices[triangle.y]);
+    const float3 v2 = f4tof3(vertices[triangle.z]);
+
+    boxes[trid] = { fminf(fminf(v0, v1), v2), fmaxf(fmaxf(v0, v1), v2) };
+}
+
+} // namespace BodyBVHKernels
+
+const BoundingVolumeHierarchy& Mesh::getBodyFrameBVH(cudaStream_t stream)
+{
+    if (bodyBVH) return *bodyBVH;
+
+    bodyBVH = std::make_unique<BoundingVolumeHierarchy>();
+
+    float3 lo = make_float3( 1e30f), hi = make_float3(-1e30f);
+    for (const auto& v : vertexCoordinates)
+    {
+        lo = fminf(lo, f4tof3(v));
+        hi = fmaxf(hi, f4tof3(v));
+    }
+
+    const int nthreads = 128;
+    SAFE_KERNEL_LAUNCH(
+            BodyBVHKernels::computeTriangleBoxes,
+            getNblocks(ntriangles, nthreads), nthreads, 0, stream,
+            MeshView(this), vertexCoordinates.devPtr(), bodyBVH->leafBoxes(ntriangles) );
+
+    bodyBVH->build(lo, hi, stream);
+
+    debug("Built the body frame BVH over the %d triangles of a mesh", ntriangles);
+    return *bodyBVH;
+}
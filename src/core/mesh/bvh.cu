@@ -0,0 +1,203 @@
+#include "bvh.h"
+
+#include <core/logger.h>
+#include <core/utils/cuda_common.h>
+#include <core/utils/kernel_launch.h>
+#include <core/utils/morton.h>
+
+#include <extern/cub/cub/device/device_radix_sort.cuh>
+
+namespace BVHKernels
+{
+
+__global__ void computeMortonCodes(int n, const AABB *boxes, float3 lo, float3 invSpan,
+                                   unsigned int *codes, int *ids)
+{
+    const int i = blockIdx.x * blockDim.x + threadIdx.x;
+    if (i >= n) return;
+
+    const auto box = boxes[i];
+    const float3 c = (0.5f * (box.lo + box.hi) - lo) * invSpan;
+
+    codes[i] = Morton::code(c);
+    ids[i] = i;
+}
+
+/**
+ * Length of the common prefix of the keys i and j, -1 if j is out of range.
+ * Duplicate codes are told apart by their position
+ */
+__device__ inline int delta(const unsigned int *codes, int n, int i, int j)
+{
+    if (j < 0 || j >= n) return -1;
+
+    const unsigned int ci = codes[i];
+    const unsigned int cj = codes[j];
+
+    if (ci == cj) return 32 + __clz(i ^ j);
+    return __clz(ci ^ cj);
+}
+
+/// One thread per internal node, see Karras 2012, figure 4
+__global__ void buildHierarchy(int n, const unsigned int *codes, int2 *children, int *parents)
+{
+    const int i = blockIdx.x * blockDim.x + threadIdx.x;
+    if (i >= n-1) return;
+
+    // direction of the range of keys covered by the node
+    const int d = (delta(codes, n, i, i+1) - delta(codes, n, i, i-1)) >= 0 ? 1 : -1;
+    const int deltaMin = delta(codes, n, i, i-d);
+
+    // upper bound of the length of the range, then binary search for the other end
+    int lmax = 2;
+    while (delta(codes, n, i, i + lmax*d) > deltaMin)
+        lmax *= 2;
+
+    int l = 0;
+    for (int t = lmax/2; t >= 1; t /= 2)
+        if (delta(codes, n, i, i + (l+t)*d) > deltaMin)
+            l += t;
+
+    const int j = i + l*d;
+    const int deltaNode = delta(codes, n, i, j);
+
+    // binary search for the split position
+    int s = 0;
+    for (int t = l; t > 1; )
+    {
+        t = (t+1) / 2;
+        if (delta(codes, n, i, i + (s+t)*d) > deltaNode)
+            s += t;
+    }
+
+    const int gamma = i + s*d + min(d, 0);
+
+    const int left  = (min(i, j) == gamma  ) ? gamma   + (n-1) : gamma;
+    const int right = (max(i, j) == gamma+1) ? gamma+1 + (n-1) : gamma+1;
+
+    children[i] = make_int2(left, right);
+    parents[left]  = i;
+    parents[right] = i;
+}
+
+/// boxes may have been written by another block, bypass L1
+__device__ inline AABB loadBox(const AABB *box)
+{
+    const float *p = (const float*) box;
+    return { make_float3(__ldcg(p+0), __ldcg(p+1), __ldcg(p+2)),
+             make_float3(__ldcg(p+3), __ldcg(p+4), __ldcg(p+5)) };
+}
+
+/**
+ * One thread per leaf walks up to the root.
+ * The first child reaching a node stops, the second one computes its box
+ */
+__global__ void fitBoxes(int n, const AABB *inputBoxes, const int *sortedIds,
+                         const int2 *children, const int *parents, AABB *boxes, int *flags)
+{
+    const int i = blockIdx.x * blockDim.x + threadIdx.x;
+    if (i >= n) return;
+
+    int node = i + (n-1);
+    boxes[node] = inputBoxes[sortedIds[i]];
+
+    if (n == 1) return;
+    node = parents[node];
+
+    while (node >= 0)
+    {
+        __threadfence();
+        if (atomicAdd(flags + node, 1) == 0) return;
+
+        const int2 ch = children[node];
+        const auto l = loadBox(boxes + ch.x);
+        const auto r = loadBox(boxes + ch.y);
+
+        boxes[node] = { fminf(l.lo, r.lo), fmaxf(l.hi, r.hi) };
+
+        node = parents[node];
+    }
+}
+
+} // namespace BVHKernels
+
+
+BoundingVolumeHierarchy::BoundingVolumeHierarchy()
+{
+    for (auto buf : {&inputBoxes, &boxes})
+        buf->setOwner("bvh:boxes");
+    children.setOwner("bvh:nodes");
+    for (auto buf : {&parents, &flags, &ids, &sortedIds})
+        buf->setOwner("bvh:nodes");
+    for (auto buf : {&codes, &sortedCodes})
+        buf->setOwner("bvh:codes");
+    sortBuffer.setOwner("bvh:sort");
+}
+
+AABB* BoundingVolumeHierarchy::leafBoxes(int n)
+{
+    nLeaves = n;
+    inputBoxes.resize_anew(n);
+    return inputBoxes.devPtr();
+}
+
+void BoundingVolumeHierarchy::build(float3 lo, float3 hi, cudaStream_t stream)
+{
+    const int n = nLeaves;
+    const int nthreads = 128;
+
+    boxes.resize_anew(max(2*n - 1, 0));
+    children.resize_anew(max(n - 1, 0));
+    parents.resize_anew(max(2*n - 1, 0));
+    flags.resize_anew(max(n - 1, 0));
+
+    if (n == 0) return;
+
+    codes      .resize_anew(n);
+    sortedCodes.resize_anew(n);
+    ids        .resize_anew(n);
+    sortedIds  .resize_anew(n);
+
+    const float3 span = fmaxf(hi - lo, make_float3(1e-6f));
+
+    SAFE_KERNEL_LAUNCH(
+            BVHKernels::computeMortonCodes,
+            getNblocks(n, nthreads), nthreads, 0, stream,
+            n, inputBoxes.devPtr(), lo, 1.0f / span, codes.devPtr(), ids.devPtr() );
+
+    size_t bufSize = 0;
+    cub::DeviceRadixSort::SortPairs(nullptr, bufSize,
+                                    codes.devPtr(), sortedCodes.devPtr(),
+                                    ids.devPtr(), sortedIds.devPtr(), n, 0, Morton::nbits, stream);
+    sortBuffer.resize_anew(bufSize);
+    cub::DeviceRadixSort::SortPairs(sortBuffer.devPtr(), bufSize,
+                                    codes.devPtr(), sortedCodes.devPtr(),
+                                    ids.devPtr(), sortedIds.devPtr(), n, 0, Morton::nbits, stream);
+
+    // root has no parent
+    CUDA_Check( cudaMemsetAsync(parents.devPtr(), 0xff, sizeof(int), stream) );
+    flags.clear(stream);
+
+    SAFE_KERNEL_LAUNCH(
+            BVHKernels::buildHierarchy,
+            getNblocks(n-1, nthreads), nthreads, 0, stream,
+            n, sortedCodes.devPtr(), children.devPtr(), parents.devPtr() );
+
+    SAFE_KERNEL_LAUNCH(
+            BVHKernels::fitBoxes,
+            getNblocks(n, nthreads), nthreads, 0, stream,
+            n, inputBoxes.devPtr(), sortedIds.devPtr(),
+            children.devPtr(), parents.devPtr(), boxes.devPtr(), flags.devPtr() );
+
+    debug2("Built a BVH over %d leaves", n);
+}
+
+int BoundingVolumeHierarchy::size() const
+{
+    return nLeaves;
+}
+
+BVHView BoundingVolumeHierarchy::getView() const
+{
+    return { nLeaves, boxes.devPtr(), children.devPtr(), sortedIds.devPtr(), parents.devPtr() };
+}
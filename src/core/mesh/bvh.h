@@ -0,0 +1,155 @@
+#pragma once
+
+#include <core/containers.h>
+#include <core/utils/cuda_common.h>
+
+#include <cuda_runtime.h>
+
+/// Axis-aligned bounding box
+struct AABB
+{
+    float3 lo, hi;
+};
+
+#ifdef __CUDACC__
+__device__ inline bool boxesOverlap(const AABB& a, const AABB& b)
+{
+    return a.lo.x <= b.hi.x && b.lo.x <= a.hi.x &&
+           a.lo.y <= b.hi.y && b.lo.y <= a.hi.y &&
+           a.lo.z <= b.hi.z && b.lo.z <= a.hi.z;
+}
+#endif
+
+/**
+ * Device view of a BoundingVolumeHierarchy.
+ *
+ * Nodes [0, nLeaves-1) are the internal nodes, the root is node 0,
+ * nodes [nLeaves-1, 2*nLeaves-1) are the leaves, sorted along the Morton curve.
+ * leafIds maps a sorted leaf back to the id of the box given to the builder.
+ */
+struct BVHView
+{
+    int nLeaves;
+    const AABB *boxes;     ///< 2*nLeaves - 1 boxes, internal nodes then leaves
+    const int2 *children;  ///< nLeaves - 1 pairs of child node ids
+    const int  *leafIds;   ///< nLeaves original ids of the sorted leaves
+    const int  *parents;   ///< 2*nLeaves - 1 parent node ids, -1 for the root
+
+#ifdef __CUDACC__
+    __device__ inline bool isLeaf(int node) const
+    {
+        return node >= nLeaves - 1;
+    }
+
+    /**
+     * Depth-first traversal of the hierarchy.
+     * Calls visit(leafId) for every leaf whose box passes overlaps(AABB),
+     * subtrees are skipped as soon as their box fails it.
+     */
+    template<typename Overlap, typename Visitor>
+    __device__ inline void traverse(Overlap overlaps, Visitor visit) const
+    {
+        // depth is at most 30 bits of the codes + 32 bits of the positions
+        constexpr int maxDepth = 64;
+        int stack[maxDepth];
+        int top = 0;
+
+        // with a single leaf, node 0 is the leaf itself
+        if (nLeaves <= 0) return;
+        stack[top++] = 0;
+
+        while (top > 0)
+        {
+            const int node = stack[--top];
+            if (!overlaps(boxes[node])) continue;
+
+            if (isLeaf(node))
+            {
+                visit(leafId(node));
+                continue;
+            }
+
+            const int2 ch = children[node];
+            if (top < maxDepth - 1)
+            {
+                stack[top++] = ch.x;
+                stack[top++] = ch.y;
+            }
+        }
+    }
+
+    /**
+     * Depth-first traversal giving the node ids.
+     * The children of an internal node are visited only if visitNode(node) returns true,
+     * the return value of the leaves is ignored
+     */
+    template<typename NodeVisitor>
+    __device__ inline void traverseNodes(NodeVisitor visitNode) const
+    {
+        constexpr int maxDepth = 64;
+        int stack[maxDepth];
+        int top = 0;
+
+        if (nLeaves <= 0) return;
+        stack[top++] = 0;
+
+        while (top > 0)
+        {
+            const int node = stack[--top];
+            if (!visitNode(node) || isLeaf(node)) continue;
+
+            const int2 ch = children[node];
+            if (top < maxDepth - 1)
+            {
+                stack[top++] = ch.x;
+                stack[top++] = ch.y;
+            }
+        }
+    }
+
+    /// id of the box given to the builder of the leaf \p node
+    __device__ inline int leafId(int node) const
+    {
+        return leafIds[node - (nLeaves - 1)];
+    }
+#endif
+};
+
+/**
+ * Linear bounding volume hierarchy (Karras, "Maximizing parallelism
+ * in the construction of BVHs, octrees, and k-d trees", 2012).
+ *
+ * The caller fills the leaf boxes on device (see leafBoxes()),
+ * build() sorts them along the Morton curve, builds the hierarchy
+ * with one thread per internal node and fits the boxes bottom-up.
+ * Everything stays on device and is rebuilt from scratch at every call,
+ * which is cheap compared to sweeping the cells around every primitive.
+ */
+class BoundingVolumeHierarchy
+{
+public:
+    BoundingVolumeHierarchy();
+
+    /// resize the leaf boxes to \p nLeaves and return the device pointer to fill
+    AABB* leafBoxes(int nLeaves);
+
+    /**
+     * Build the hierarchy over the boxes set with leafBoxes().
+     * The centers of the boxes are quantized within [\p lo, \p hi] for the Morton codes,
+     * boxes outside are clamped, which only degrades the quality of the tree
+     */
+    void build(float3 lo, float3 hi, cudaStream_t stream);
+
+    int size() const;
+    BVHView getView() const;
+
+private:
+    int nLeaves{0};
+
+    DeviceBuffer<AABB> inputBoxes, boxes;
+    DeviceBuffer<int2> children;
+    DeviceBuffer<int>  parents, flags;
+    DeviceBuffer<unsigned int> codes, sortedCodes;
+    DeviceBuffer<int> ids, sortedIds;
+    DeviceBuffer<char> sortBuffer;
+};
@@ -138,6 +138,19 @@ void MembraneMesh::findAdjacent()
     
     adjacent.uploadToDevice(defaultStream);
     degrees.uploadToDevice(defaultStream);
+
+    // halves the index traffic of the membrane kernels for the usual meshes
+    if (nvertices < MembraneMeshView::compactNotSet)
+    {
+        HostBuffer<uint16_t> compact(adjacent.size());
+        for (int i = 0; i < adjacent.size(); ++i)
+            compact[i] = adjacent[i] == NOT_SET ? MembraneMeshView::compactNotSet : adjacent[i];
+
+        adjacentCompact.copy(compact, defaultStream);
+        CUDA_Check( cudaStreamSynchronize(defaultStream) );
+    }
+    else
+        debug("Mesh with %d vertices, keeping the 32 bit adjacency", nvertices);
 }
 
 void MembraneMesh::_computeInitialQuantities(const PinnedBuffer<float4>& vertices)
@@ -223,6 +236,7 @@ MembraneMeshView::MembraneMeshView(const MembraneMesh *m) :
     maxDegree          (m->getMaxDegree()),
     adjacent           (m->adjacent.devPtr()),
     degrees            (m->degrees.devPtr()),
+    adjacentCompact    (m->adjacentCompact.size() > 0 ? m->adjacentCompact.devPtr() : nullptr),
     initialLengths     (m->initialLengths.devPtr()),
     initialAreas       (m->initialAreas.devPtr()),
     initialDotProducts (m->initialDotProducts.devPtr())
@@ -5,12 +5,17 @@
 #include <core/containers.h>
 #include <core/utils/pytypes.h>
 
+#include <cstdint>
+
 class MembraneMesh : public Mesh
 {
 public:
     PinnedBuffer<int> adjacent, degrees;
     PinnedBuffer<float> initialLengths, initialAreas, initialDotProducts;
 
+    /// 16 bit copy of adjacent on the device, empty if the mesh has too many vertices
+    DeviceBuffer<uint16_t> adjacentCompact;
+
     MembraneMesh();
 
     MembraneMesh(std::string initialMesh);
@@ -42,8 +47,27 @@ struct MembraneMeshView : public MeshView
     int maxDegree;
 
     int *adjacent, *degrees;
+    uint16_t *adjacentCompact;
     float *initialLengths, *initialAreas, *initialDotProducts;
 
     MembraneMeshView(const MembraneMesh *m);
+
+    /// number of neighbours of vertex \p v
+    __HD__ inline int getDegree(int v) const
+    {
+        return readOnly(degrees + v);
+    }
+
+    /// \p i is the position in the degree-padded adjacency, the padding is -1
+    __HD__ inline int getAdjacent(int i) const
+    {
+        if (adjacentCompact == nullptr)
+            return readOnly(adjacent + i);
+
+        const int id = readOnly(adjacentCompact + i);
+        return id == compactNotSet ? -1 : id;
+    }
+
+    enum { compactNotSet = 0xffff };
 };
 
@@ -1,8 +1,14 @@
 #include "mesh.h"
+#include "bvh.h"
 
 #include <core/utils/cuda_common.h>
 
+#include <algorithm>
+#include <cmath>
 #include <fstream>
+#include <numeric>
+#include <queue>
+#include <set>
 #include <vector>
 
 Mesh::Mesh()
@@ -12,6 +18,7 @@ Mesh::Mesh(std::string fname)
 {
     _readOff(fname);
     _check();
+    _reorderForLocality();
 
     vertexCoordinates.uploadToDevice(defaultStream);
     triangles.uploadToDevice(defaultStream);
@@ -34,6 +41,7 @@ Mesh::Mesh(const PyTypes::VectorOfFloat3& vertices, const PyTypes::VectorOfInt3&
         vertexCoordinates[i] = make_float4(vertices[i][0], vertices[i][1], vertices[i][2], 0.f);
 
     _check();
+    _reorderForLocality();
     
     vertexCoordinates.uploadToDevice(defaultStream);
     triangles.uploadToDevice(defaultStream);
@@ -50,6 +58,16 @@ Mesh::~Mesh() = default;
 const int& Mesh::getNtriangles() const {return ntriangles;}
 const int& Mesh::getNvertices()  const {return nvertices;}
 
+const std::vector<int>& Mesh::getOriginalIds() const {return originalIds;}
+
+float Mesh::getBodyRadius() const
+{
+    float r2 = 0.0f;
+    for (const auto& v : vertexCoordinates)
+        r2 = std::max(r2, dot(f4tof3(v), f4tof3(v)));
+    return std::sqrt(r2);
+}
+
 const int& Mesh::getMaxDegree() const {
     if (maxDegree < 0) die("maxDegree was not computed");
     return maxDegree;
@@ -62,9 +80,10 @@ PyTypes::VectorOfFloat3 Mesh::getVertices()
 
     for (int i = 0; i < getNvertices(); ++i) {
         auto r = vertexCoordinates[i];
-        ret[i][0] = r.x;
-        ret[i][1] = r.y;
-        ret[i][2] = r.z;
+        auto& v = ret[originalIds[i]];
+        v[0] = r.x;
+        v[1] = r.y;
+        v[2] = r.z;
     }
     return ret;
 }
@@ -76,9 +95,9 @@ PyTypes::VectorOfInt3 Mesh::getTriangles()
 
     for (int i = 0; i < getNtriangles(); ++i) {
         auto t = triangles[i];
-        ret[i][0] = t.x;
-        ret[i][1] = t.y;
-        ret[i][2] = t.z;
+        ret[i][0] = originalIds[t.x];
+        ret[i][1] = originalIds[t.y];
+        ret[i][2] = originalIds[t.z];
     }
     return ret;
 }
@@ -112,6 +131,80 @@ void Mesh::_check() const
     }
 }
 
+void Mesh::_reorderForLocality()
+{
+    std::vector<std::set<int>> neighbours(nvertices);
+    for (auto t : triangles) {
+        neighbours[t.x].insert({t.y, t.z});
+        neighbours[t.y].insert({t.z, t.x});
+        neighbours[t.z].insert({t.x, t.y});
+    }
+
+    auto byDegree = [&neighbours] (int a, int b) {
+        return neighbours[a].size() != neighbours[b].size() ?
+            neighbours[a].size() < neighbours[b].size() : a < b;
+    };
+
+    // Cuthill-McKee: breadth first from a vertex of lowest degree, neighbours by increasing degree
+    std::vector<int> starts(nvertices);
+    std::iota(starts.begin(), starts.end(), 0);
+    std::sort(starts.begin(), starts.end(), byDegree);
+
+    std::vector<int> order;
+    std::vector<bool> visited(nvertices, false);
+    order.reserve(nvertices);
+
+    for (auto start : starts) {
+        if (visited[start]) continue;
+
+        std::queue<int> front;
+        front.push(start);
+        visited[start] = true;
+
+        while (!front.empty()) {
+            int v = front.front();
+            front.pop();
+            order.push_back(v);
+
+            std::vector<int> next;
+            for (auto n : neighbours[v])
+                if (!visited[n]) next.push_back(n);
+
+            std::sort(next.begin(), next.end(), byDegree);
+            for (auto n : next) {
+                visited[n] = true;
+                front.push(n);
+            }
+        }
+    }
+
+    std::reverse(order.begin(), order.end());
+
+    originalIds = order;
+    std::vector<int> newIds(nvertices);
+    for (int i = 0; i < nvertices; ++i)
+        newIds[originalIds[i]] = i;
+
+    std::vector<float4> oldCoordinates(vertexCoordinates.begin(), vertexCoordinates.end());
+    for (int i = 0; i < nvertices; ++i)
+        vertexCoordinates[i] = oldCoordinates[originalIds[i]];
+
+    // the vertices of a triangle keep their cyclic order, hence the orientation
+    for (auto& t : triangles)
+        t = make_int3(newIds[t.x], newIds[t.y], newIds[t.z]);
+
+    auto firstVertex = [] (int3 t) { return std::min({t.x, t.y, t.z}); };
+    std::stable_sort(triangles.begin(), triangles.end(), [&firstVertex] (int3 a, int3 b) {
+        return firstVertex(a) < firstVertex(b);
+    });
+
+    int bandwidth = 0;
+    for (auto t : triangles)
+        bandwidth = std::max(bandwidth, std::max({t.x, t.y, t.z}) - firstVertex(t));
+
+    debug("Reordered the %d vertices of the mesh, the triangles span at most %d vertices", nvertices, bandwidth + 1);
+}
+
 void Mesh::_readOff(std::string fname)
 {
    std::ifstream fin(fname);
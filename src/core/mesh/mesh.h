@@ -1,8 +1,15 @@
 #pragma once
 
 #include <core/containers.h>
+#include <core/utils/cpu_gpu_defines.h>
+#include <core/utils/cuda_common.h>
 #include <core/utils/pytypes.h>
 
+#include <memory>
+#include <vector>
+
+class BoundingVolumeHierarchy;
+
 class Mesh
 {
 protected:
@@ -26,15 +33,40 @@ public:
     const int& getNvertices() const;
     const int& getMaxDegree() const;
 
+    /// vertices in the order of the input, the triangles refer to these indices
     PyTypes::VectorOfFloat3 getVertices();
     PyTypes::VectorOfInt3  getTriangles();
 
+    /// index in the input of each vertex of the mesh
+    const std::vector<int>& getOriginalIds() const;
+
+    /**
+     * BVH over the triangles in the frame of the mesh, built once on the first call.
+     * The leaf ids are the triangle ids, the boxes are tight: queries enlarge their own box instead.
+     * Only meaningful for objects that do not deform, i.e. rigid objects
+     */
+    const BoundingVolumeHierarchy& getBodyFrameBVH(cudaStream_t stream);
+
+    /// largest distance of the vertices to the origin of the mesh frame
+    float getBodyRadius() const;
+
 protected:
     // max degree of a vertex in mesh
     int maxDegree {-1};
     void _computeMaxDegree();
     void _check() const;
     void _readOff(std::string fname);
+
+    /**
+     * Renumber the vertices in Reverse Cuthill-McKee order and sort the triangles by their first vertex,
+     * such that the neighbours of a vertex are close in memory.
+     * The order only depends on the connectivity: meshes with the same faces are renumbered the same way
+     */
+    void _reorderForLocality();
+
+    std::vector<int> originalIds;
+
+    std::unique_ptr<BoundingVolumeHierarchy> bodyBVH;
 };
 
 
@@ -45,6 +77,13 @@ struct MeshView
     int3 *triangles;
 
     MeshView(const Mesh *m);
+
+    /// the connectivity is constant, read it through the read-only cache
+    __HD__ inline int3 getTriangle(int i) const
+    {
+        const int *t = reinterpret_cast<const int*>(triangles + i);
+        return make_int3(readOnly(t), readOnly(t+1), readOnly(t+2));
+    }
 };
 
 
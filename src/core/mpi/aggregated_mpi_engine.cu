@@ -0,0 +1,360 @@
+#include "aggregated_mpi_engine.h"
+#include "fragments_mapping.h"
+
+#include <core/logger.h>
+#include <core/utils/cuda_common.h>
+#include <core/utils/kernel_launch.h>
+#include <core/utils/timer.h>
+
+#include <algorithm>
+#include <cstdint>
+
+namespace AggregatedExchangeKernels
+{
+
+// One block per segment, vectorized if everything is aligned
+__global__ void copySegments(int nSegments, const AggregatedMPIExchangeEngine::CopySegment *segments)
+{
+    const int sid = blockIdx.x;
+    if (sid >= nSegments) return;
+
+    const auto s = segments[sid];
+    const bool aligned = ((uintptr_t)s.src % sizeof(int4) == 0) &&
+                         ((uintptr_t)s.dst % sizeof(int4) == 0) &&
+                         (s.size % sizeof(int4) == 0);
+
+    if (aligned)
+    {
+        const int n = s.size / sizeof(int4);
+        for (int i = threadIdx.x; i < n; i += blockDim.x)
+            ((int4*)s.dst)[i] = ((const int4*)s.src)[i];
+    }
+    else
+    {
+        for (int i = threadIdx.x; i < s.size; i += blockDim.x)
+            s.dst[i] = s.src[i];
+    }
+}
+
+} // namespace AggregatedExchangeKernels
+
+AggregatedMPIExchangeEngine::AggregatedMPIExchangeEngine(std::unique_ptr<ParticleExchanger> exchanger,
+                                                         MPI_Comm comm, bool gpuAwareMPI) :
+    exchanger(std::move(exchanger)),
+    gpuAwareMPI(gpuAwareMPI)
+{
+    MPI_Check( MPI_Comm_dup(comm, &haloComm) );
+
+    int dims[3], periods[3], coords[3];
+    MPI_Check( MPI_Cart_get (haloComm, 3, dims, periods, coords) );
+
+    for (int i = 0; i < nFragments; ++i)
+    {
+        int d[3] = { FragmentMapping::getDirx(i),
+                     FragmentMapping::getDiry(i),
+                     FragmentMapping::getDirz(i) };
+
+        int coordsNeigh[3];
+        for(int c = 0; c < 3; ++c)
+            coordsNeigh[c] = coords[c] + d[c];
+
+        MPI_Check( MPI_Cart_rank(haloComm, coordsNeigh, dir2rank + i) );
+
+        dir2sendTag[i] = i;
+        dir2recvTag[i] = FragmentMapping::getId(-d[0], -d[1], -d[2]);
+    }
+
+    sendOffsets.resize(nFragments + 1);
+    recvOffsets.resize(nFragments + 1);
+
+    for (auto buf : {&sendSizes, &recvSizes})
+        buf->setOwner("exchange:aggregated:sizes");
+    sendBuf.setOwner("exchange:aggregated:sendBuf");
+    recvBuf.setOwner("exchange:aggregated:recvBuf");
+    for (auto buf : {&gatherSegments, &scatterSegments})
+        buf->setOwner("exchange:aggregated:segments");
+}
+
+AggregatedMPIExchangeEngine::~AggregatedMPIExchangeEngine()
+{
+    MPI_Check( MPI_Comm_free(&haloComm) );
+}
+
+int AggregatedMPIExchangeEngine::nHelpers() const
+{
+    return exchanger->helpers.size();
+}
+
+bool AggregatedMPIExchangeEngine::isActive(int fragment) const
+{
+    return fragment != FragmentMapping::bulkId && dir2rank[fragment] >= 0;
+}
+
+void AggregatedMPIExchangeEngine::init(cudaStream_t stream)
+{
+    auto& helpers = exchanger->helpers;
+
+    for (int i = 0; i < helpers.size(); i++)
+        if (!exchanger->needExchange(i)) debug("Exchange of PV '%s' is skipped", helpers[i]->name.c_str());
+
+    postRecvSizes();
+
+    for (int i = 0; i < helpers.size(); i++)
+        if (exchanger->needExchange(i)) exchanger->prepareSizes(i, stream);
+
+    sendAllSizes();
+
+    for (int i = 0; i < helpers.size(); i++)
+        if (exchanger->needExchange(i)) exchanger->prepareData(i, stream);
+
+    postRecv();
+    send(stream);
+}
+
+void AggregatedMPIExchangeEngine::finalize(cudaStream_t stream)
+{
+    auto& helpers = exchanger->helpers;
+
+    wait(stream);
+
+    MPI_Check( MPI_Waitall(sendRequests.size(), sendRequests.data(), MPI_STATUSES_IGNORE) );
+
+    for (int i = 0; i < helpers.size(); i++)
+        if (exchanger->needExchange(i)) exchanger->combineAndUploadData(i, stream);
+
+    sendBuf.releaseStaging(stream);
+    recvBuf.releaseStaging(stream);
+
+    for (auto& helper : helpers)
+        helper->releaseStaging(stream);
+}
+
+std::vector<GPUcontainer*> AggregatedMPIExchangeEngine::getContainers()
+{
+    auto containers = exchanger->getContainers();
+    containers.push_back(&sendBuf);
+    containers.push_back(&recvBuf);
+    return containers;
+}
+
+void AggregatedMPIExchangeEngine::postRecvSizes()
+{
+    const int nh = nHelpers();
+
+    recvSizes.resize_anew(nFragments * nh);
+    recvSizes.clearHost();
+    sizeRequests.clear();
+
+    for (int i = 0; i < nFragments; i++)
+        if (isActive(i))
+        {
+            MPI_Request req;
+            MPI_Check( MPI_Irecv(recvSizes.hostPtr() + i*nh, nh, MPI_INT, dir2rank[i], dir2recvTag[i], haloComm, &req) );
+            sizeRequests.push_back(req);
+        }
+}
+
+/**
+ * Expects sendSizes of the helpers to be ON HOST
+ */
+void AggregatedMPIExchangeEngine::sendAllSizes()
+{
+    auto& helpers = exchanger->helpers;
+    const int nh = nHelpers();
+
+    sendSizes.resize_anew(nFragments * nh);
+    sendSizes.clearHost();
+
+    for (int h = 0; h < nh; h++)
+        if (exchanger->needExchange(h))
+            for (int i = 0; i < nFragments; i++)
+                sendSizes[i*nh + h] = helpers[h]->sendSizes[i];
+
+    // Do blocking send in hope that it will be immediate due to small size
+    for (int i = 0; i < nFragments; i++)
+        if (isActive(i))
+            MPI_Check( MPI_Send(sendSizes.hostPtr() + i*nh, nh, MPI_INT, dir2rank[i], dir2sendTag[i], haloComm) );
+}
+
+void AggregatedMPIExchangeEngine::postRecv()
+{
+    auto& helpers = exchanger->helpers;
+    const int nh = nHelpers();
+
+    mTimer tm;
+    tm.start();
+    MPI_Check( MPI_Waitall(sizeRequests.size(), sizeRequests.data(), MPI_STATUSES_IGNORE) );
+    debug("Waiting for the aggregated sizes took %f ms", tm.elapsed());
+
+    // Sizes and receive buffers of every helper, as if the messages were separate
+    for (int h = 0; h < nh; h++)
+    {
+        if (!exchanger->needExchange(h)) continue;
+
+        auto helper = helpers[h].get();
+        helper->recvSizes.clearHost();
+        for (int i = 0; i < nFragments; i++)
+            if (isActive(i))
+                helper->recvSizes[i] = recvSizes[i*nh + h];
+
+        helper->computeRecvOffsets();
+        helper->resizeRecvBuf();
+    }
+
+    // The aggregated buffer follows the fragments, then the helpers
+    recvOffsets[0] = 0;
+    for (int i = 0; i < nFragments; i++)
+    {
+        int size = 0;
+        if (isActive(i))
+            for (int h = 0; h < nh; h++)
+                if (exchanger->needExchange(h))
+                    size += helpers[h]->recvSizes[i] * helpers[h]->datumSize;
+
+        recvOffsets[i+1] = recvOffsets[i] + size;
+    }
+
+    recvBuf.resize_anew(recvOffsets[nFragments]);
+
+    std::vector<CopySegment> segments;
+    for (int i = 0; i < nFragments; i++)
+    {
+        if (!isActive(i)) continue;
+
+        int start = recvOffsets[i];
+        for (int h = 0; h < nh; h++)
+        {
+            if (!exchanger->needExchange(h)) continue;
+
+            auto helper = helpers[h].get();
+            const int bytes = helper->recvSizes[i] * helper->datumSize;
+            if (bytes == 0) continue;
+
+            segments.push_back({ recvBuf.devPtr() + start,
+                                 helper->recvBuf.devPtr() + helper->recvOffsets[i] * helper->datumSize,
+                                 bytes });
+            start += bytes;
+        }
+    }
+    setSegments(scatterSegments, segments);
+
+    recvRequests.clear();
+    for (int i = 0; i < nFragments; i++)
+    {
+        const int bytes = recvOffsets[i+1] - recvOffsets[i];
+        if (!isActive(i) || bytes == 0) continue;
+
+        auto ptr = gpuAwareMPI ? recvBuf.devPtr() : recvBuf.hostPtr();
+
+        MPI_Request req;
+        MPI_Check( MPI_Irecv(ptr + recvOffsets[i], bytes, MPI_BYTE, dir2rank[i], dir2recvTag[i], haloComm, &req) );
+        recvRequests.push_back(req);
+    }
+
+    debug("Posted aggregated receive of %d bytes in %d messages", recvOffsets[nFragments], (int) recvRequests.size());
+}
+
+/**
+ * Expects sendSizes and sendOffsets of the helpers to be ON HOST
+ * and their sendBuf data ON DEVICE
+ */
+void AggregatedMPIExchangeEngine::send(cudaStream_t stream)
+{
+    auto& helpers = exchanger->helpers;
+    const int nh = nHelpers();
+
+    // Layout of the aggregated buffer
+    sendOffsets[0] = 0;
+    for (int i = 0; i < nFragments; i++)
+    {
+        int size = 0;
+        if (isActive(i))
+            for (int h = 0; h < nh; h++)
+                if (exchanger->needExchange(h))
+                    size += helpers[h]->sendSizes[i] * helpers[h]->datumSize;
+
+        sendOffsets[i+1] = sendOffsets[i] + size;
+    }
+
+    sendBuf.resize_anew(sendOffsets[nFragments]);
+
+    std::vector<CopySegment> segments;
+    for (int i = 0; i < nFragments; i++)
+    {
+        if (!isActive(i)) continue;
+
+        int start = sendOffsets[i];
+        for (int h = 0; h < nh; h++)
+        {
+            if (!exchanger->needExchange(h)) continue;
+
+            auto helper = helpers[h].get();
+            const int bytes = helper->sendSizes[i] * helper->datumSize;
+            if (bytes == 0) continue;
+
+            segments.push_back({ helper->sendBuf.devPtr() + helper->sendOffsets[i] * helper->datumSize,
+                                 sendBuf.devPtr() + start,
+                                 bytes });
+            start += bytes;
+        }
+    }
+    setSegments(gatherSegments, segments);
+
+    copySegments(gatherSegments, stream);
+
+    if (gpuAwareMPI)
+        CUDA_Check( cudaStreamSynchronize(stream) );
+    else
+        sendBuf.downloadFromDevice(stream);
+
+    sendRequests.clear();
+    for (int i = 0; i < nFragments; i++)
+    {
+        const int bytes = sendOffsets[i+1] - sendOffsets[i];
+        if (!isActive(i) || bytes == 0) continue;
+
+        auto ptr = gpuAwareMPI ? sendBuf.devPtr() : sendBuf.hostPtr();
+
+        MPI_Request req;
+        MPI_Check( MPI_Isend(ptr + sendOffsets[i], bytes, MPI_BYTE, dir2rank[i], dir2sendTag[i], haloComm, &req) );
+        sendRequests.push_back(req);
+    }
+
+    debug("Sent aggregated %d bytes in %d messages", sendOffsets[nFragments], (int) sendRequests.size());
+}
+
+/**
+ * recvBuf of the helpers will contain all the data, ON DEVICE already
+ */
+void AggregatedMPIExchangeEngine::wait(cudaStream_t stream)
+{
+    mTimer tm;
+    tm.start();
+    MPI_Check( MPI_Waitall(recvRequests.size(), recvRequests.data(), MPI_STATUSES_IGNORE) );
+    debug("Completed aggregated receive, waiting took %f ms", tm.elapsed());
+
+    if (!gpuAwareMPI)
+        recvBuf.uploadToDevice(stream);
+
+    copySegments(scatterSegments, stream);
+}
+
+void AggregatedMPIExchangeEngine::setSegments(PinnedBuffer<CopySegment>& dst, const std::vector<CopySegment>& segments)
+{
+    dst.resize_anew(segments.size());
+    std::copy(segments.begin(), segments.end(), dst.begin());
+}
+
+void AggregatedMPIExchangeEngine::copySegments(PinnedBuffer<CopySegment>& segments, cudaStream_t stream)
+{
+    const int n = segments.size();
+    if (n == 0) return;
+
+    segments.uploadToDevice(stream);
+
+    const int nthreads = 128;
+    SAFE_KERNEL_LAUNCH(
+        AggregatedExchangeKernels::copySegments,
+        n, nthreads, 0, stream,
+        n, segments.devPtr() );
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "exchanger_interfaces.h"
+#include "exchange_helpers.h"
+
+#include <core/containers.h>
+
+#include <mpi.h>
+#include <string>
+#include <vector>
+
+/**
+ * MPI engine sending one message per neighbouring rank for all the helpers of the exchanger.
+ *
+ * MPIExchangeEngine communicates every helper (i.e. every ParticleVector) separately:
+ * with several ParticleVectors, each exchange is made of many small messages.
+ * Here, for each of the fragments:
+ * - the sizes of all the helpers are sent in one message;
+ * - the data of all the helpers are gathered on the GPU into one contiguous buffer,
+ *   sent in one message, and scattered back to the receive buffers of the helpers.
+ *
+ * The exchanger side (prepareSizes(), prepareData(), combineAndUploadData())
+ * is the same as with MPIExchangeEngine, so any ParticleExchanger can use it.
+ * All the ranks must agree on which helpers are exchanged (ParticleExchanger::needExchange()),
+ * skipped helpers are sent with zero sizes.
+ */
+class AggregatedMPIExchangeEngine : public ExchangeEngine
+{
+public:
+    AggregatedMPIExchangeEngine(std::unique_ptr<ParticleExchanger> exchanger, MPI_Comm comm, bool gpuAwareMPI);
+    ~AggregatedMPIExchangeEngine();
+
+    void init(cudaStream_t stream)     override;
+    void finalize(cudaStream_t stream) override;
+
+    std::vector<GPUcontainer*> getContainers() override;
+
+    /// piece of a buffer to gather or scatter, see AggregatedMPIExchangeEngine::copySegments()
+    struct CopySegment
+    {
+        const char *src;
+        char *dst;
+        int size;
+    };
+
+private:
+    std::unique_ptr<ParticleExchanger> exchanger;
+
+    static constexpr int nFragments = FragmentMapping::numFragments;
+
+    int dir2rank[nFragments];
+    int dir2sendTag[nFragments];
+    int dir2recvTag[nFragments];
+
+    MPI_Comm haloComm;
+    bool gpuAwareMPI;
+
+    /// sizes of all the helpers per fragment, [fragment * nHelpers + helper]
+    PinnedBuffer<int> sendSizes, recvSizes;
+
+    /// data of all the helpers, contiguous per fragment, staged through the StagingPool; offsets in bytes
+    StagedBuffer sendBuf, recvBuf;
+    std::vector<int> sendOffsets, recvOffsets;
+
+    PinnedBuffer<CopySegment> gatherSegments, scatterSegments;
+
+    std::vector<MPI_Request> sizeRequests, recvRequests, sendRequests;
+
+    int nHelpers() const;
+    bool isActive(int fragment) const;
+
+    void postRecvSizes();
+    void sendAllSizes();
+    void postRecv();
+    void send(cudaStream_t stream);
+    void wait(cudaStream_t stream);
+
+    void setSegments(PinnedBuffer<CopySegment>& dst, const std::vector<CopySegment>& segments);
+    void copySegments(PinnedBuffer<CopySegment>& segments, cudaStream_t stream);
+};
@@ -3,13 +3,18 @@
 #include <mpi.h>
 
 #include "exchanger_interfaces.h"
+#include "aggregated_mpi_engine.h"
+#include "ipc_engine.h"
 #include "mpi_engine.h"
+#include "neighbor_collective_engine.h"
 #include "single_node_engine.h"
 
 #include "particle_halo_exchanger.h"
+#include "particle_halo_extra_exchanger.h"
 #include "object_halo_exchanger.h"
 
 #include "particle_redistributor.h"
 #include "object_redistributor.h"
 #include "object_reverse_exchanger.h"
 #include "object_halo_extra_exchanger.h"
+#include "object_halo_static_exchanger.h"
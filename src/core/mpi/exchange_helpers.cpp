@@ -5,6 +5,11 @@ ExchangeHelper::ExchangeHelper(std::string name, int uniqueId) :
     datumSize(0),
     uniqueId(uniqueId)
 {
+    for (auto buf : {&recvSizes, &recvOffsets, &sendSizes, &sendOffsets})
+        buf->setOwner(name + ":exchange:offsets");
+    recvBuf.setOwner(name + ":exchange:recvBuf");
+    sendBuf.setOwner(name + ":exchange:sendBuf");
+
     recvSizes.  resize_anew(nBuffers);
     recvOffsets.resize_anew(nBuffers+1);
     
@@ -51,6 +56,17 @@ int ExchangeHelper::getUniqueId() const
     return uniqueId;
 }
 
+std::vector<GPUcontainer*> ExchangeHelper::getContainers()
+{
+    return {&sendBuf, &recvBuf};
+}
+
+void ExchangeHelper::releaseStaging(cudaStream_t stream)
+{
+    sendBuf.releaseStaging(stream);
+    recvBuf.releaseStaging(stream);
+}
+
 BufferOffsetsSizesWrap ExchangeHelper::wrapSendData()
 {
     return {nBuffers, sendBuf.devPtr(), sendOffsets.devPtr(), sendSizes.devPtr()};
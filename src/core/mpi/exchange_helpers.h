@@ -1,6 +1,7 @@
 #pragma once
 
 #include "fragments_mapping.h"
+#include "staging_pool.h"
 
 #include <mpi.h>
 #include <core/containers.h>
@@ -63,6 +64,15 @@ public:
     void resizeRecvBuf();
 
     int getUniqueId() const;
+
+    /// @return the bulk buffers #sendBuf and #recvBuf, see ShrinkPolicy
+    std::vector<GPUcontainer*> getContainers();
+
+    /**
+     * Give the host copies of #sendBuf and #recvBuf back to the StagingPool,
+     * called by the engines at the end of every exchange
+     */
+    void releaseStaging(cudaStream_t stream);
     
     /**
      * Wrap GPU data from #sendBuf, #sendSizes and #sendOffsets
@@ -82,11 +92,11 @@ public:
 
     PinnedBuffer<int>  recvSizes;    ///< Number of received elements per each neighbour
     PinnedBuffer<int>  recvOffsets;  ///< Starting indices for i-th neighbour
-    PinnedBuffer<char> recvBuf;      ///< Buffer keeping all the received data
+    StagedBuffer recvBuf;            ///< Buffer keeping all the received data, staged on the host through the StagingPool
 
     PinnedBuffer<int>  sendSizes;    ///< Number elements to send to each neighbour
     PinnedBuffer<int>  sendOffsets;  ///< Starting indices for i-th neighbour
-    PinnedBuffer<char> sendBuf;      ///< Buffer keeping all the data needs to be sent
+    StagedBuffer sendBuf;            ///< Buffer keeping all the data needs to be sent, staged on the host through the StagingPool
 
     std::vector<MPI_Request> recvRequests, sendRequests;
     std::vector<int> recvRequestIdxs;
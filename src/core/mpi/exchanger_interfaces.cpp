@@ -1,5 +1,27 @@
 #include "exchange_helpers.h"
 #include "exchanger_interfaces.h"
 
+#include <core/logger.h>
+
 ParticleExchanger::~ParticleExchanger() = default;
+
+bool ParticleExchanger::unpacksFragments() const
+{
+    return false;
+}
+
+void ParticleExchanger::combineAndUploadFragment(int id, int fragment, cudaStream_t stream)
+{
+    die("This exchanger cannot unpack the fragments separately");
+}
+
+std::vector<GPUcontainer*> ParticleExchanger::getContainers()
+{
+    std::vector<GPUcontainer*> containers;
+    for (auto& helper : helpers)
+        for (auto c : helper->getContainers())
+            containers.push_back(c);
+    return containers;
+}
+
 ExchangeEngine::~ExchangeEngine() = default;
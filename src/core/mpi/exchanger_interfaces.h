@@ -5,6 +5,7 @@
 #include <cuda_runtime.h>
 
 class ExchangeHelper;
+class GPUcontainer;
 
 /**
  * Interface for classes preparing and packing particles for exchange
@@ -71,6 +72,25 @@ public:
      * @return true if exchange is required, false - if not
      */
     virtual bool needExchange(int id) = 0;    
+
+    /**
+     * Exchangers able to unpack every fragment separately return true
+     * and implement combineAndUploadFragment(). The engines may then unpack each fragment
+     * as soon as it is received, instead of calling combineAndUploadData() once all arrived
+     */
+    virtual bool unpacksFragments() const;
+
+    /**
+     * Same as combineAndUploadData() for the data received in \p fragment only.
+     * Only called if unpacksFragments() is true
+     *
+     * @param id helper id that is filled with the received data
+     * @param fragment index of the fragment in the helper buffers
+     */
+    virtual void combineAndUploadFragment(int id, int fragment, cudaStream_t stream);
+
+    /// @return bulk buffers of all the helpers, see ExchangeHelper::getContainers()
+    std::vector<GPUcontainer*> getContainers();
 };
 
 
@@ -80,5 +100,9 @@ class ExchangeEngine
 public:
     virtual void init(cudaStream_t stream)     = 0;
     virtual void finalize(cudaStream_t stream) = 0;
+
+    /// @return buffers of the underlying exchanger, see ParticleExchanger::getContainers()
+    virtual std::vector<GPUcontainer*> getContainers() = 0;
+
     virtual ~ExchangeEngine();
 };
@@ -0,0 +1,432 @@
+#include "ipc_engine.h"
+
+#include <core/containers.h>
+#include <core/logger.h>
+#include <core/utils/timer.h>
+
+#include <algorithm>
+
+IPCExchangeEngine::IPCExchangeEngine(std::unique_ptr<ParticleExchanger> exchanger,
+                                     MPI_Comm comm, bool gpuAwareMPI) :
+    exchanger(std::move(exchanger)),
+    gpuAwareMPI(gpuAwareMPI)
+{
+    MPI_Check( MPI_Comm_dup(comm, &haloComm) );
+    MPI_Check( MPI_Comm_dup(comm, &handleComm) );
+    MPI_Check( MPI_Comm_dup(comm, &doneComm) );
+
+    int dims[3], periods[3], coords[3];
+    MPI_Check( MPI_Cart_get (haloComm, 3, dims, periods, coords) );
+
+    for (int i = 0; i < nFragments; ++i)
+    {
+        int d[3] = { FragmentMapping::getDirx(i),
+                     FragmentMapping::getDiry(i),
+                     FragmentMapping::getDirz(i) };
+
+        int coordsNeigh[3];
+        for(int c = 0; c < 3; ++c)
+            coordsNeigh[c] = coords[c] + d[c];
+
+        MPI_Check( MPI_Cart_rank(haloComm, coordsNeigh, dir2rank + i) );
+
+        dir2sendTag[i] = i;
+        dir2recvTag[i] = FragmentMapping::getId(-d[0], -d[1], -d[2]);
+    }
+
+    detectSameNode();
+}
+
+IPCExchangeEngine::~IPCExchangeEngine()
+{
+    for (auto& entry : channels)
+    {
+        auto& ch = entry.second;
+
+        for (auto& f : ch.fragments)
+        {
+            if (f.peer    != nullptr) CUDA_Check( cudaIpcCloseMemHandle(f.peer) );
+            if (f.staging != nullptr) CUDA_Check( cudaFree(f.staging) );
+            if (f.retired != nullptr) CUDA_Check( cudaFree(f.retired) );
+        }
+
+        if (ch.consumed != nullptr) CUDA_Check( cudaEventDestroy(ch.consumed) );
+    }
+
+    MPI_Check( MPI_Comm_free(&doneComm) );
+    MPI_Check( MPI_Comm_free(&handleComm) );
+    MPI_Check( MPI_Comm_free(&haloComm) );
+}
+
+/**
+ * A neighbour is reachable with IPC if it is another process of the same node,
+ * running on the same GPU or on a GPU with peer access from ours.
+ * Relies on all the ranks of the node seeing the same devices, as set up by YMeRo.
+ */
+void IPCExchangeEngine::detectSameNode()
+{
+    int myrank;
+    MPI_Check( MPI_Comm_rank(haloComm, &myrank) );
+
+    MPI_Comm shmComm;
+    MPI_Check( MPI_Comm_split_type(haloComm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &shmComm) );
+
+    int shmSize;
+    MPI_Check( MPI_Comm_size(shmComm, &shmSize) );
+
+    int myDevice;
+    CUDA_Check( cudaGetDevice(&myDevice) );
+
+    std::vector<int> devices(shmSize);
+    MPI_Check( MPI_Allgather(&myDevice, 1, MPI_INT, devices.data(), 1, MPI_INT, shmComm) );
+
+    MPI_Group haloGroup, shmGroup;
+    MPI_Check( MPI_Comm_group(haloComm, &haloGroup) );
+    MPI_Check( MPI_Comm_group(shmComm,  &shmGroup) );
+
+    int nIPC = 0;
+    for (int i = 0; i < nFragments; i++)
+    {
+        dir2ipc[i] = false;
+
+        if (i == FragmentMapping::bulkId || dir2rank[i] < 0 || dir2rank[i] == myrank)
+            continue;
+
+        int shmRank;
+        MPI_Check( MPI_Group_translate_ranks(haloGroup, 1, dir2rank + i, shmGroup, &shmRank) );
+        if (shmRank == MPI_UNDEFINED)
+            continue;
+
+        const int peerDevice = devices[shmRank];
+        int canAccess = 1;
+        if (peerDevice != myDevice)
+            CUDA_Check( cudaDeviceCanAccessPeer(&canAccess, myDevice, peerDevice) );
+
+        dir2ipc[i] = canAccess;
+        if (canAccess) nIPC++;
+    }
+
+    MPI_Check( MPI_Group_free(&shmGroup) );
+    MPI_Check( MPI_Group_free(&haloGroup) );
+    MPI_Check( MPI_Comm_free(&shmComm) );
+
+    debug("%d out of %d fragments will be exchanged with CUDA IPC", nIPC, nFragments - 1);
+}
+
+IPCExchangeEngine::IPCChannels& IPCExchangeEngine::getChannels(ExchangeHelper* helper)
+{
+    auto& ch = channels[helper];
+
+    if (ch.consumed == nullptr)
+        CUDA_Check( cudaEventCreateWithFlags(&ch.consumed, cudaEventDisableTiming) );
+
+    return ch;
+}
+
+int IPCExchangeEngine::recvTag(ExchangeHelper* helper, int fragment) const
+{
+    return helper->nBuffers * helper->getUniqueId() + dir2recvTag[fragment];
+}
+
+int IPCExchangeEngine::sendTag(ExchangeHelper* helper, int fragment) const
+{
+    return helper->nBuffers * helper->getUniqueId() + dir2sendTag[fragment];
+}
+
+void IPCExchangeEngine::init(cudaStream_t stream)
+{
+    auto& helpers = exchanger->helpers;
+
+    for (int i = 0; i < helpers.size(); i++)
+        if (!exchanger->needExchange(i)) debug("Exchange of PV '%s' is skipped", helpers[i]->name.c_str());
+
+    for (int i = 0; i < helpers.size(); i++)
+        if (exchanger->needExchange(i)) postRecvSize(helpers[i].get());
+
+    for (int i = 0; i < helpers.size(); i++)
+        if (exchanger->needExchange(i)) exchanger->prepareSizes(i, stream);
+
+    for (int i = 0; i < helpers.size(); i++)
+        if (exchanger->needExchange(i)) sendSizes(helpers[i].get());
+
+    for (int i = 0; i < helpers.size(); i++)
+        if (exchanger->needExchange(i)) exchanger->prepareData(i, stream);
+
+    for (int i = 0; i < helpers.size(); i++)
+        if (exchanger->needExchange(i)) postRecv(helpers[i].get());
+
+    for (int i = 0; i < helpers.size(); i++)
+        if (exchanger->needExchange(i)) send(helpers[i].get(), stream);
+}
+
+void IPCExchangeEngine::finalize(cudaStream_t stream)
+{
+    auto& helpers = exchanger->helpers;
+
+    for (int i = 0; i < helpers.size(); i++)
+        if (exchanger->needExchange(i)) wait(helpers[i].get(), stream);
+
+    for (int i = 0; i < helpers.size(); i++)
+        if (exchanger->needExchange(i))
+        {
+            auto helper = helpers[i].get();
+            auto& handleRequests = getChannels(helper).handleRequests;
+
+            MPI_Check( MPI_Waitall(helper->sendRequests.size(), helper->sendRequests.data(), MPI_STATUSES_IGNORE) );
+            MPI_Check( MPI_Waitall(handleRequests.size(), handleRequests.data(), MPI_STATUSES_IGNORE) );
+            handleRequests.clear();
+        }
+
+    for (int i = 0; i < helpers.size(); i++)
+        if (exchanger->needExchange(i)) exchanger->combineAndUploadData(i, stream);
+
+    for (auto& helper : helpers)
+        helper->releaseStaging(stream);
+}
+
+std::vector<GPUcontainer*> IPCExchangeEngine::getContainers()
+{
+    return exchanger->getContainers();
+}
+
+void IPCExchangeEngine::postRecvSize(ExchangeHelper* helper)
+{
+    auto nBuffers = helper->nBuffers;
+    auto bulkId   = helper->bulkId;
+    auto rSizes   = helper->recvSizes.hostPtr();
+
+    helper->recvRequests.clear();
+    helper->recvSizes.clearHost();
+
+    for (int i = 0; i < nBuffers; i++)
+        if (i != bulkId && dir2rank[i] >= 0)
+        {
+            MPI_Request req;
+            MPI_Check( MPI_Irecv(rSizes + i, 1, MPI_INT, dir2rank[i], recvTag(helper, i), haloComm, &req) );
+            helper->recvRequests.push_back(req);
+        }
+}
+
+/**
+ * Expects helper->sendSizes to be ON HOST
+ */
+void IPCExchangeEngine::sendSizes(ExchangeHelper* helper)
+{
+    auto nBuffers = helper->nBuffers;
+    auto bulkId   = helper->bulkId;
+    auto sSizes   = helper->sendSizes.hostPtr();
+
+    // Neighbours may only write into our staging buffers once they got the sizes
+    auto& ch = getChannels(helper);
+    if (ch.pendingConsumed)
+    {
+        CUDA_Check( cudaEventSynchronize(ch.consumed) );
+        ch.pendingConsumed = false;
+    }
+
+    // Do blocking send in hope that it will be immediate due to small size
+    for (int i = 0; i < nBuffers; i++)
+        if (i != bulkId && dir2rank[i] >= 0)
+            MPI_Check( MPI_Send(sSizes + i, 1, MPI_INT, dir2rank[i], sendTag(helper, i), haloComm) );
+}
+
+void IPCExchangeEngine::postRecv(ExchangeHelper* helper)
+{
+    std::string pvName = helper->name;
+
+    auto nBuffers = helper->nBuffers;
+    auto bulkId   = helper->bulkId;
+    auto rSizes   = helper->recvSizes.  hostPtr();
+    auto rOffsets = helper->recvOffsets.hostPtr();
+
+    mTimer tm;
+    tm.start();
+    MPI_Check( MPI_Waitall(helper->recvRequests.size(), helper->recvRequests.data(), MPI_STATUSES_IGNORE) );
+    debug("Waiting for sizes of '%s' took %f ms", pvName.c_str(), tm.elapsed());
+
+    helper->computeRecvOffsets();
+    helper->resizeRecvBuf();
+
+    auto& ch = getChannels(helper);
+
+    helper->recvRequests.clear();
+    helper->recvRequestIdxs.clear();
+    for (int i = 0; i < nBuffers; i++)
+    {
+        if (i == bulkId || dir2rank[i] < 0 || rSizes[i] == 0) continue;
+
+        const int bytes = rSizes[i] * helper->datumSize;
+        const int tag = recvTag(helper, i);
+        MPI_Request req;
+
+        if (dir2ipc[i])
+        {
+            auto& f = ch.fragments[i];
+
+            // The sender expects a new handle exactly in this case
+            if (bytes > f.capacity)
+            {
+                if (f.retired != nullptr) CUDA_Check( cudaFree(f.retired) );
+                f.retired = f.staging;
+
+                f.capacity = conservativeCapacity(bytes);
+                CUDA_Check( cudaMalloc(&f.staging, f.capacity) );
+                CUDA_Check( cudaIpcGetMemHandle(&f.outgoing.handle, f.staging) );
+                f.outgoing.capacity = f.capacity;
+
+                debug("Staging buffer of '%s' for fragment %d grew to %d bytes, sending the IPC handle to rank %d",
+                      pvName.c_str(), i, f.capacity, dir2rank[i]);
+
+                MPI_Check( MPI_Isend(&f.outgoing, sizeof(HandleMessage), MPI_BYTE, dir2rank[i], tag, handleComm, &req) );
+                ch.handleRequests.push_back(req);
+            }
+
+            MPI_Check( MPI_Irecv(nullptr, 0, MPI_BYTE, dir2rank[i], tag, doneComm, &req) );
+        }
+        else
+        {
+            auto ptr = gpuAwareMPI ? helper->recvBuf.devPtr() : helper->recvBuf.hostPtr();
+            MPI_Check( MPI_Irecv(ptr + rOffsets[i]*helper->datumSize, bytes, MPI_BYTE, dir2rank[i], tag, haloComm, &req) );
+        }
+
+        helper->recvRequests.push_back(req);
+        helper->recvRequestIdxs.push_back(i);
+    }
+
+    debug("Posted receive for %d %s entities", rOffsets[nBuffers], pvName.c_str());
+}
+
+/**
+ * helper->recvBuf will contain all the data, ON DEVICE already
+ */
+void IPCExchangeEngine::wait(ExchangeHelper* helper, cudaStream_t stream)
+{
+    auto rSizes   = helper->recvSizes.  hostPtr();
+    auto rOffsets = helper->recvOffsets.hostPtr();
+
+    auto& ch = getChannels(helper);
+    bool anyIPC = false;
+
+    double waitTime = 0;
+    mTimer tm;
+    for (int i = 0; i < helper->recvRequests.size(); i++)
+    {
+        int idx;
+        tm.start();
+        MPI_Check( MPI_Waitany(helper->recvRequests.size(), helper->recvRequests.data(), &idx, MPI_STATUS_IGNORE) );
+        waitTime += tm.elapsedAndReset();
+
+        const int from  = helper->recvRequestIdxs[idx];
+        const int bytes = rSizes[from] * helper->datumSize;
+        auto dst = helper->recvBuf.devPtr() + rOffsets[from]*helper->datumSize;
+
+        if (dir2ipc[from])
+        {
+            auto& f = ch.fragments[from];
+
+            CUDA_Check( cudaMemcpyAsync(dst, f.staging, bytes, cudaMemcpyDeviceToDevice, stream) );
+            anyIPC = true;
+
+            // the sender has switched to the new staging buffer before notifying
+            if (f.retired != nullptr)
+            {
+                CUDA_Check( cudaFree(f.retired) );
+                f.retired = nullptr;
+            }
+        }
+        else if (!gpuAwareMPI)
+        {
+            CUDA_Check( cudaMemcpyAsync(dst, helper->recvBuf.hostPtr() + rOffsets[from]*helper->datumSize,
+                                        bytes, cudaMemcpyHostToDevice, stream) );
+        }
+    }
+
+    if (anyIPC)
+    {
+        CUDA_Check( cudaEventRecord(ch.consumed, stream) );
+        ch.pendingConsumed = true;
+    }
+
+    debug("Completed receive for '%s', waiting took %f ms", helper->name.c_str(), waitTime);
+}
+
+/**
+ * Expects helper->sendSizes and helper->sendOffsets to be ON HOST
+ * helper->sendBuf data is ON DEVICE
+ */
+void IPCExchangeEngine::send(ExchangeHelper* helper, cudaStream_t stream)
+{
+    std::string pvName = helper->name;
+
+    auto nBuffers = helper->nBuffers;
+    auto bulkId   = helper->bulkId;
+    auto sSizes   = helper->sendSizes.  hostPtr();
+    auto sOffsets = helper->sendOffsets.hostPtr();
+
+    auto& ch = getChannels(helper);
+
+    // Peer copies and downloads first, all completed by one synchronization
+    for (int i = 0; i < nBuffers; i++)
+    {
+        if (i == bulkId || dir2rank[i] < 0 || sSizes[i] == 0) continue;
+
+        const int bytes = sSizes[i] * helper->datumSize;
+        auto src = helper->sendBuf.devPtr() + sOffsets[i]*helper->datumSize;
+
+        if (dir2ipc[i])
+        {
+            auto& f = ch.fragments[i];
+
+            if (bytes > f.peerCapacity)
+            {
+                HandleMessage msg;
+                MPI_Check( MPI_Recv(&msg, sizeof(HandleMessage), MPI_BYTE, dir2rank[i], sendTag(helper, i), handleComm, MPI_STATUS_IGNORE) );
+
+                if (f.peer != nullptr) CUDA_Check( cudaIpcCloseMemHandle(f.peer) );
+                CUDA_Check( cudaIpcOpenMemHandle((void**)&f.peer, msg.handle, cudaIpcMemLazyEnablePeerAccess) );
+                f.peerCapacity = msg.capacity;
+
+                if (bytes > f.peerCapacity)
+                    die("Staging buffer of '%s' on rank %d is too small: %d bytes, need %d",
+                        pvName.c_str(), dir2rank[i], f.peerCapacity, bytes);
+            }
+
+            CUDA_Check( cudaMemcpyAsync(f.peer, src, bytes, cudaMemcpyDeviceToDevice, stream) );
+        }
+        else if (!gpuAwareMPI)
+        {
+            CUDA_Check( cudaMemcpyAsync(helper->sendBuf.hostPtr() + sOffsets[i]*helper->datumSize, src,
+                                        bytes, cudaMemcpyDeviceToHost, stream) );
+        }
+    }
+
+    CUDA_Check( cudaStreamSynchronize(stream) );
+
+    int totSent = 0, totIPC = 0;
+    helper->sendRequests.clear();
+
+    for (int i = 0; i < nBuffers; i++)
+    {
+        if (i == bulkId || dir2rank[i] < 0 || sSizes[i] == 0) continue;
+
+        const int tag = sendTag(helper, i);
+        MPI_Request req;
+
+        if (dir2ipc[i])
+        {
+            MPI_Check( MPI_Isend(nullptr, 0, MPI_BYTE, dir2rank[i], tag, doneComm, &req) );
+            totIPC += sSizes[i];
+        }
+        else
+        {
+            auto ptr = gpuAwareMPI ? helper->sendBuf.devPtr() : helper->sendBuf.hostPtr();
+            MPI_Check( MPI_Isend(ptr + sOffsets[i]*helper->datumSize, sSizes[i] * helper->datumSize,
+                                 MPI_BYTE, dir2rank[i], tag, haloComm, &req) );
+        }
+
+        helper->sendRequests.push_back(req);
+        totSent += sSizes[i];
+    }
+
+    debug("Sent total %d '%s' entities, %d of them with CUDA IPC", totSent, pvName.c_str(), totIPC);
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "exchanger_interfaces.h"
+#include "exchange_helpers.h"
+#include "fragments_mapping.h"
+
+#include <cuda_runtime.h>
+#include <map>
+#include <mpi.h>
+#include <vector>
+
+/**
+ * Engine sending the data of the fragments whose neighbour lives on the same node
+ * directly from GPU to GPU with CUDA IPC, other fragments go through MPI as in MPIExchangeEngine.
+ *
+ * For each same-node fragment the receiver owns a staging buffer on its GPU,
+ * mapped by the sender with cudaIpcOpenMemHandle().
+ * The staging buffers only grow: both sides know the number of bytes of the fragment
+ * from the size messages, so the receiver sends a new IPC handle exactly when
+ * the sender has to wait for one, i.e. rarely.
+ * The sender copies its send buffer into the staging buffer (peer-to-peer through NVLink or PCIe)
+ * and notifies the receiver with an empty MPI message once the copy is completed.
+ *
+ * The receiver copies the staging buffer into the receive buffer of the helper,
+ * and completes this copy before sending the sizes of the next exchange,
+ * such that the sender never overwrites data still to be read.
+ *
+ * The sizes still go through MPI on the host, the exchanger side is the same as with MPIExchangeEngine.
+ * Neighbours on other nodes, or the rank itself with periodic boundaries, are exchanged with MPI.
+ */
+class IPCExchangeEngine : public ExchangeEngine
+{
+public:
+    IPCExchangeEngine(std::unique_ptr<ParticleExchanger> exchanger, MPI_Comm comm, bool gpuAwareMPI);
+    ~IPCExchangeEngine();
+
+    void init(cudaStream_t stream)     override;
+    void finalize(cudaStream_t stream) override;
+
+    std::vector<GPUcontainer*> getContainers() override;
+
+private:
+    std::unique_ptr<ParticleExchanger> exchanger;
+
+    static constexpr int nFragments = FragmentMapping::numFragments;
+
+    int dir2rank[nFragments];
+    int dir2sendTag[nFragments];
+    int dir2recvTag[nFragments];
+    bool dir2ipc[nFragments];  ///< true if the neighbour is reachable with CUDA IPC
+
+    MPI_Comm haloComm;
+    MPI_Comm handleComm, doneComm;  ///< IPC handles go from receiver to sender, notifications the other way
+    bool gpuAwareMPI;
+
+    /// sent to the sender when the staging buffer of a fragment is reallocated
+    struct HandleMessage
+    {
+        cudaIpcMemHandle_t handle;
+        int capacity;
+    };
+
+    struct IPCFragment
+    {
+        // receiving side
+        char *staging{nullptr};
+        char *retired{nullptr};  ///< previous staging buffer, freed once the sender switched to the new one
+        int capacity{0};
+        HandleMessage outgoing;
+
+        // sending side
+        char *peer{nullptr};
+        int peerCapacity{0};
+    };
+
+    struct IPCChannels
+    {
+        IPCFragment fragments[nFragments];
+        std::vector<MPI_Request> handleRequests;
+        cudaEvent_t consumed{nullptr};  ///< staging buffers are read, recorded in wait()
+        bool pendingConsumed{false};
+    };
+
+    std::map<ExchangeHelper*, IPCChannels> channels;
+
+    void detectSameNode();
+    IPCChannels& getChannels(ExchangeHelper* helper);
+
+    int recvTag (ExchangeHelper* helper, int fragment) const;
+    int sendTag (ExchangeHelper* helper, int fragment) const;
+
+    void postRecvSize(ExchangeHelper* helper);
+    void sendSizes(ExchangeHelper* helper);
+    void postRecv(ExchangeHelper* helper);
+    void wait(ExchangeHelper* helper, cudaStream_t stream);
+    void send(ExchangeHelper* helper, cudaStream_t stream);
+};
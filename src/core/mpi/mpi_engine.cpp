@@ -1,14 +1,20 @@
 #include "mpi_engine.h"
 #include "fragments_mapping.h"
 
+#include <core/utils/nvtx.h>
+#include <core/utils/perf_counters.h>
 #include <core/utils/timer.h>
 #include <core/logger.h>
 #include <algorithm>
 
 MPIExchangeEngine::MPIExchangeEngine(std::unique_ptr<ParticleExchanger> exchanger,
-                                     MPI_Comm comm, bool gpuAwareMPI) :
+                                     MPI_Comm comm, bool gpuAwareMPI, bool persistentSizes, int chunkSize,
+                                     bool adaptiveTransport) :
     nActiveNeighbours(FragmentMapping::numFragments - 1),
     gpuAwareMPI(gpuAwareMPI),
+    chunkSize(chunkSize),
+    adaptiveTransport(adaptiveTransport && gpuAwareMPI),
+    persistentSizes(persistentSizes),
     exchanger(std::move(exchanger))
 {
     MPI_Check( MPI_Comm_dup(comm, &haloComm) );
@@ -32,10 +38,51 @@ MPIExchangeEngine::MPIExchangeEngine(std::unique_ptr<ParticleExchanger> exchange
         dir2sendTag[i] = i;
         dir2recvTag[i] = FragmentMapping::getId(-d[0], -d[1], -d[2]);
     }
+
+    if (adaptiveTransport && !gpuAwareMPI)
+        warn("Adaptive transport needs GPU-aware MPI, all the messages are staged through the host");
+
+    if (this->adaptiveTransport)
+        detectIntraNode();
+}
+
+void MPIExchangeEngine::detectIntraNode()
+{
+    MPI_Comm shmComm;
+    MPI_Check( MPI_Comm_split_type(haloComm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &shmComm) );
+
+    MPI_Group haloGroup, shmGroup;
+    MPI_Check( MPI_Comm_group(haloComm, &haloGroup) );
+    MPI_Check( MPI_Comm_group(shmComm,  &shmGroup) );
+
+    for (int i = 0; i < FragmentMapping::numFragments; i++)
+    {
+        dir2intraNode[i] = false;
+        if (dir2rank[i] < 0) continue;
+
+        int shmRank;
+        MPI_Check( MPI_Group_translate_ranks(haloGroup, 1, dir2rank + i, shmGroup, &shmRank) );
+        dir2intraNode[i] = shmRank != MPI_UNDEFINED;
+    }
+
+    MPI_Check( MPI_Group_free(&shmGroup) );
+    MPI_Check( MPI_Group_free(&haloGroup) );
+    MPI_Check( MPI_Comm_free(&shmComm) );
+}
+
+int MPIExchangeEngine::transportClass(int fragment, int bytes) const
+{
+    return TransportTuner::getClass(bytes, dir2intraNode[fragment]);
 }
 
 MPIExchangeEngine::~MPIExchangeEngine()
 {
+    for (auto& entry : sizeRequests)
+        freeSizeRequests(entry.second);
+
+    for (auto& ev : chunkEvents)
+        CUDA_Check( cudaEventDestroy(ev) );
+
     MPI_Check( MPI_Comm_free(&haloComm) );
 }
 
@@ -47,52 +94,188 @@ void MPIExchangeEngine::init(cudaStream_t stream)
         if (!exchanger->needExchange(i)) debug("Exchange of PV '%s' is skipped", helpers[i]->name.c_str());
     
     // Post irecv for sizes
-    for (int i=0; i<helpers.size(); i++)
-        if (exchanger->needExchange(i)) postRecvSize(helpers[i].get());
+    {
+        NVTX::Range range("MPI exchange: post receive sizes", NVTX::Category::Halo);
+        for (int i=0; i<helpers.size(); i++)
+            if (exchanger->needExchange(i)) postRecvSize(helpers[i].get());
+    }
 
     // Derived class determines what to send
-    for (int i=0; i<helpers.size(); i++)
-        if (exchanger->needExchange(i)) exchanger->prepareSizes(i, stream);
+    {
+        NVTX::Range range("MPI exchange: prepare sizes", NVTX::Category::Halo);
+        for (int i=0; i<helpers.size(); i++)
+            if (exchanger->needExchange(i)) exchanger->prepareSizes(i, stream);
+    }
 
     // Send sizes
-    for (int i=0; i<helpers.size(); i++)
-        if (exchanger->needExchange(i)) sendSizes(helpers[i].get());
+    {
+        NVTX::Range range("MPI exchange: send sizes", NVTX::Category::Halo);
+        for (int i=0; i<helpers.size(); i++)
+            if (exchanger->needExchange(i)) sendSizes(helpers[i].get());
+    }
 
     // Derived class determines what to send
-    for (int i=0; i<helpers.size(); i++)
-        if (exchanger->needExchange(i)) exchanger->prepareData(i, stream);
+    {
+        NVTX::Range range("MPI exchange: pack", NVTX::Category::Halo);
+        for (int i=0; i<helpers.size(); i++)
+            if (exchanger->needExchange(i)) exchanger->prepareData(i, stream);
+    }
 
     // Post big data irecv (after prepereData cause it waits for the sizes)
-    for (int i=0; i<helpers.size(); i++)
-        if (exchanger->needExchange(i)) postRecv(helpers[i].get());
+    {
+        NVTX::Range range("MPI exchange: post receive", NVTX::Category::Halo);
+        for (int i=0; i<helpers.size(); i++)
+            if (exchanger->needExchange(i)) postRecv(helpers[i].get());
+    }
 
     // CUDA-aware MPI will work in a separate stream, need to synchro
     if (gpuAwareMPI) cudaStreamSynchronize(stream);
 
     // Send
-    for (int i=0; i<helpers.size(); i++)
-        if (exchanger->needExchange(i)) send(helpers[i].get(), stream);
+    {
+        NVTX::Range range("MPI exchange: send", NVTX::Category::Halo);
+        for (int i=0; i<helpers.size(); i++)
+            if (exchanger->needExchange(i)) send(helpers[i].get(), stream);
+    }
 }
 
 void MPIExchangeEngine::finalize(cudaStream_t stream)
 {
     auto& helpers = exchanger->helpers;
 
-    // Wait for the irecvs to finish
-    for (int i=0; i<helpers.size(); i++)
-        if (exchanger->needExchange(i)) wait(helpers[i].get(), stream);
+    const bool perFragment = exchanger->unpacksFragments();
+
+    // Wait for the irecvs to finish, unpack right away if possible
+    {
+        NVTX::Range range(perFragment ? "MPI exchange: wait and unpack" : "MPI exchange: wait", NVTX::Category::Halo);
+        for (int i=0; i<helpers.size(); i++)
+            if (exchanger->needExchange(i))
+            {
+                if (perFragment) waitAndUnpackFragments(i, stream);
+                else             wait(helpers[i].get(), stream);
+            }
+    }
 
     // Wait for completion of the previous sends
-	for (int i=0; i<helpers.size(); i++)
-		if (exchanger->needExchange(i))
-			MPI_Check( MPI_Waitall(
-					helpers[i]->sendRequests.size(),
-					helpers[i]->sendRequests.data(),
-					MPI_STATUSES_IGNORE) );
+    {
+        NVTX::Range range("MPI exchange: wait sends", NVTX::Category::Halo);
+        for (int i=0; i<helpers.size(); i++)
+            if (exchanger->needExchange(i))
+            {
+                if (adaptiveTransport)
+                    waitSends(helpers[i].get());
+                else
+                    MPI_Check( MPI_Waitall(
+                            helpers[i]->sendRequests.size(),
+                            helpers[i]->sendRequests.data(),
+                            MPI_STATUSES_IGNORE) );
+            }
+
+        // Persistent size sends are only completed here, the receiver got them long ago
+        if (persistentSizes)
+            for (int i=0; i<helpers.size(); i++)
+                if (exchanger->needExchange(i))
+                {
+                    auto& reqs = getSizeRequests(helpers[i].get()).send;
+                    MPI_Check( MPI_Waitall(reqs.size(), reqs.data(), MPI_STATUSES_IGNORE) );
+                }
+    }
 
     // Derived class unpack implementation
-    for (int i=0; i<helpers.size(); i++)
-        if (exchanger->needExchange(i)) exchanger->combineAndUploadData(i, stream);
+    if (!perFragment)
+    {
+        NVTX::Range range("MPI exchange: unpack", NVTX::Category::Halo);
+        for (int i=0; i<helpers.size(); i++)
+            if (exchanger->needExchange(i)) exchanger->combineAndUploadData(i, stream);
+    }
+
+    if (adaptiveTransport)
+        tuner.nextExchange();
+
+    // the host copies go back to the pool, for the exchanges of the other task phases
+    for (auto& helper : helpers)
+        helper->releaseStaging(stream);
+}
+
+/**
+ * Wait for the data sends of \p helper one by one,
+ * the latency of each is recorded for the transport of its class
+ */
+void MPIExchangeEngine::waitSends(ExchangeHelper* helper)
+{
+    auto& requests = helper->sendRequests;
+    const auto& samples = sendSamples[helper];
+
+    std::vector<int> completed(requests.size());
+    int nRemaining = requests.size();
+
+    while (nRemaining > 0)
+    {
+        int nCompleted;
+        MPI_Check( MPI_Waitsome(requests.size(), requests.data(), &nCompleted, completed.data(), MPI_STATUSES_IGNORE) );
+        const double now = MPI_Wtime();
+
+        for (int k = 0; k < nCompleted; k++)
+        {
+            const auto& s = samples[completed[k]];
+            tuner.record(s.cls, s.staged, 1e3 * (now - s.start));
+        }
+
+        nRemaining -= nCompleted;
+    }
+}
+
+std::vector<GPUcontainer*> MPIExchangeEngine::getContainers()
+{
+    return exchanger->getContainers();
+}
+
+MPIExchangeEngine::SizeRequests& MPIExchangeEngine::getSizeRequests(ExchangeHelper* helper)
+{
+    auto& reqs = sizeRequests[helper];
+
+    const int *rSizes = helper->recvSizes.hostPtr();
+    const int *sSizes = helper->sendSizes.hostPtr();
+
+    if (reqs.recvPtr == rSizes && reqs.sendPtr == sSizes)
+        return reqs;
+
+    if (reqs.recvPtr != nullptr)
+        debug("Size buffers of '%s' were reallocated, recreating persistent requests", helper->name.c_str());
+
+    freeSizeRequests(reqs);
+
+    auto nBuffers = helper->nBuffers;
+    auto bulkId   = helper->bulkId;
+
+    for (int i = 0; i < nBuffers; i++)
+        if (i != bulkId && dir2rank[i] >= 0)
+        {
+            MPI_Request req;
+
+            const int rtag = nBuffers * helper->getUniqueId() + dir2recvTag[i];
+            MPI_Check( MPI_Recv_init(helper->recvSizes.hostPtr() + i, 1, MPI_INT, dir2rank[i], rtag, haloComm, &req) );
+            reqs.recv.push_back(req);
+
+            const int stag = nBuffers * helper->getUniqueId() + dir2sendTag[i];
+            MPI_Check( MPI_Send_init(helper->sendSizes.hostPtr() + i, 1, MPI_INT, dir2rank[i], stag, haloComm, &req) );
+            reqs.send.push_back(req);
+        }
+
+    reqs.recvPtr = rSizes;
+    reqs.sendPtr = sSizes;
+
+    return reqs;
+}
+
+void MPIExchangeEngine::freeSizeRequests(SizeRequests& reqs)
+{
+    for (auto& req : reqs.recv) MPI_Check( MPI_Request_free(&req) );
+    for (auto& req : reqs.send) MPI_Check( MPI_Request_free(&req) );
+
+    reqs.recv.clear();
+    reqs.send.clear();
+    reqs.recvPtr = reqs.sendPtr = nullptr;
 }
 
 void MPIExchangeEngine::postRecvSize(ExchangeHelper* helper)
@@ -108,6 +291,16 @@ void MPIExchangeEngine::postRecvSize(ExchangeHelper* helper)
     helper->recvRequests.clear();
     helper->recvSizes.clearHost();
 
+    if (persistentSizes)
+    {
+        auto& reqs = getSizeRequests(helper).recv;
+        MPI_Check( MPI_Startall(reqs.size(), reqs.data()) );
+
+        // persistent handles stay valid after completion, waiting on a copy is fine
+        helper->recvRequests = reqs;
+        return;
+    }
+
     for (int i = 0; i < nBuffers; i++)
         if (i != bulkId && dir2rank[i] >= 0)
         {
@@ -130,6 +323,14 @@ void MPIExchangeEngine::sendSizes(ExchangeHelper* helper)
     auto bulkId   = helper->bulkId;
     auto sSizes   = helper->sendSizes.hostPtr();
 
+    // completed in finalize()
+    if (persistentSizes)
+    {
+        auto& reqs = getSizeRequests(helper).send;
+        MPI_Check( MPI_Startall(reqs.size(), reqs.data()) );
+        return;
+    }
+
     // Do blocking send in hope that it will be immediate due to small size
     for (int i = 0; i < nBuffers; i++)
         if (i != bulkId && dir2rank[i] >= 0)
@@ -180,28 +381,29 @@ void MPIExchangeEngine::postRecv(ExchangeHelper* helper)
     helper->resizeRecvBuf();
 
     // Now do the actual data recv
+    auto& chunks = recvChunks[helper];
+    chunks.clear();
     helper->recvRequests.clear();
     helper->recvRequestIdxs.clear();
     for (int i = 0; i < nBuffers; i++)
         if (i != bulkId && dir2rank[i] >= 0)
         {
-            MPI_Request req;
             const int tag = nBuffers * helper->getUniqueId() + dir2recvTag[i];
 
             debug3("Receiving %s entities from rank %d, %d entities (buffer %d, datum size %d)",
                    pvName.c_str(), dir2rank[i], rSizes[i], i, helper->datumSize);
 
-            if (rSizes[i] > 0)
+            // chunks of the same fragment have the same tag, MPI keeps them in order
+            for (const auto& chunk : splitIntoChunks(i, rOffsets[i]*helper->datumSize, rSizes[i]*helper->datumSize))
             {
-                auto ptr = gpuAwareMPI ? helper->recvBuf.devPtr() : helper->recvBuf.hostPtr();
-                
-                MPI_Check( MPI_Irecv(
-                        ptr + rOffsets[i]*helper->datumSize,
-                        rSizes[i]*helper->datumSize,
-                        MPI_BYTE, dir2rank[i], tag, haloComm, &req) );
+                auto ptr = chunk.staged ? helper->recvBuf.hostPtr() : helper->recvBuf.devPtr();
+
+                MPI_Request req;
+                MPI_Check( MPI_Irecv(ptr + chunk.offset, chunk.size, MPI_BYTE, dir2rank[i], tag, haloComm, &req) );
 
                 helper->recvRequests.push_back(req);
                 helper->recvRequestIdxs.push_back(i);
+                chunks.push_back(chunk);
             }
         }
 
@@ -233,6 +435,9 @@ void MPIExchangeEngine::wait(ExchangeHelper* helper, cudaStream_t stream)
         waitTime = tm.elapsed();
         if (!gpuAwareMPI)
             helper->recvBuf.uploadToDevice(stream);
+        else
+            for (const auto& chunk : recvChunks[helper])
+                if (chunk.staged) uploadChunk(helper, chunk, stream);
     }
     else
     {
@@ -244,13 +449,7 @@ void MPIExchangeEngine::wait(ExchangeHelper* helper, cudaStream_t stream)
             MPI_Check( MPI_Waitany(helper->recvRequests.size(), helper->recvRequests.data(), &idx, MPI_STATUS_IGNORE) );
             waitTime += tm.elapsedAndReset();
 
-            int from = helper->recvRequestIdxs[idx];
-
-            CUDA_Check( cudaMemcpyAsync(
-                            helper->recvBuf.devPtr()  + rOffsets[from]*helper->datumSize,
-                            helper->recvBuf.hostPtr() + rOffsets[from]*helper->datumSize,
-                            rSizes[from] * helper->datumSize,
-                            cudaMemcpyHostToDevice, stream) );
+            uploadChunk(helper, recvChunks[helper][idx], stream);
         }
     }
 
@@ -258,6 +457,79 @@ void MPIExchangeEngine::wait(ExchangeHelper* helper, cudaStream_t stream)
     debug("Completed receive for '%s', waiting took %f ms", helper->name.c_str(), waitTime);
 }
 
+/**
+ * Unpack every fragment of helper \p id as soon as it is received,
+ * such that the unpacking kernels of the first fragments run while the others are still in flight
+ */
+void MPIExchangeEngine::waitAndUnpackFragments(int id, cudaStream_t stream)
+{
+    auto helper = exchanger->helpers[id].get();
+    const auto& chunks = recvChunks[helper];
+
+    debug("Waiting to receive and unpack '%s' entities per fragment, GPU aware MPI is %s",
+        helper->name.c_str(), gpuAwareMPI ? "on" : "off");
+
+    // a fragment is unpacked once all its chunks arrived
+    std::vector<int> remaining(helper->nBuffers, 0);
+    for (const auto& chunk : chunks)
+        remaining[chunk.fragment]++;
+
+    double waitTime = 0;
+    mTimer tm;
+
+    for (int i = 0; i < helper->recvRequests.size(); i++)
+    {
+        int idx;
+        tm.start();
+        MPI_Check( MPI_Waitany(helper->recvRequests.size(), helper->recvRequests.data(), &idx, MPI_STATUS_IGNORE) );
+        waitTime += tm.elapsedAndReset();
+
+        const auto& chunk = chunks[idx];
+
+        if (chunk.staged)
+            uploadChunk(helper, chunk, stream);
+
+        if (--remaining[chunk.fragment] == 0)
+            exchanger->combineAndUploadFragment(id, chunk.fragment, stream);
+    }
+
+    debug("Completed receive and unpack for '%s', waiting took %f ms", helper->name.c_str(), waitTime);
+}
+
+std::vector<MPIExchangeEngine::Chunk> MPIExchangeEngine::splitIntoChunks(int fragment, int offset, int size) const
+{
+    std::vector<Chunk> chunks;
+    if (size == 0) return chunks;
+
+    // all the chunks of a fragment use the same transport, they are thus kept in order
+    const bool staged = adaptiveTransport ? tuner.staged(transportClass(fragment, size)) : !gpuAwareMPI;
+
+    const int step = chunkSize > 0 ? chunkSize : size;
+    for (int start = 0; start < size; start += step)
+        chunks.push_back({fragment, offset + start, std::min(step, size - start), staged});
+
+    return chunks;
+}
+
+void MPIExchangeEngine::uploadChunk(ExchangeHelper* helper, const Chunk& chunk, cudaStream_t stream)
+{
+    CUDA_Check( cudaMemcpyAsync(
+                    helper->recvBuf.devPtr()  + chunk.offset,
+                    helper->recvBuf.hostPtr() + chunk.offset,
+                    chunk.size, cudaMemcpyHostToDevice, stream) );
+}
+
+cudaEvent_t MPIExchangeEngine::getChunkEvent(int i)
+{
+    while (chunkEvents.size() <= i)
+    {
+        cudaEvent_t ev;
+        CUDA_Check( cudaEventCreateWithFlags(&ev, cudaEventDisableTiming) );
+        chunkEvents.push_back(ev);
+    }
+    return chunkEvents[i];
+}
+
 /**
  * Expects helper->sendSizes and helper->sendOffsets to be ON HOST
  * helper->sendBuf data is ON DEVICE
@@ -278,10 +550,12 @@ void MPIExchangeEngine::send(ExchangeHelper* helper, cudaStream_t stream)
     if (!gpuAwareMPI && singleCopy)
         helper->sendBuf.downloadFromDevice(stream);
 
-    MPI_Request req;
     int totSent = 0;
     helper->sendRequests.clear();
 
+    std::vector<Chunk> chunks;
+    std::vector<int> chunkTags;
+
     for (int i=0; i < nBuffers; i++)
         if (i != bulkId && dir2rank[i] >= 0)
         {
@@ -290,32 +564,68 @@ void MPIExchangeEngine::send(ExchangeHelper* helper, cudaStream_t stream)
 
             const int tag = nBuffers * helper->getUniqueId() + dir2sendTag[i];
 
-            // Send actual data
-            if (sSizes[i] > 0)
+            for (const auto& chunk : splitIntoChunks(i, sOffsets[i]*helper->datumSize, sSizes[i]*helper->datumSize))
             {
-                auto ptr = gpuAwareMPI ? helper->sendBuf.devPtr() : helper->sendBuf.hostPtr();
-                
-                if (!singleCopy && (!gpuAwareMPI))
-                {
-                    CUDA_Check( cudaMemcpyAsync(
-                                    helper->sendBuf.hostPtr() + sOffsets[i]*helper->datumSize,
-                                    helper->sendBuf.devPtr()  + sOffsets[i]*helper->datumSize,
-                                    sSizes[i] * helper->datumSize,
-                                    cudaMemcpyDeviceToHost, stream) );
-                    CUDA_Check( cudaStreamSynchronize(stream) );
-                }
-
-                MPI_Check( MPI_Isend(
-                        ptr + sOffsets[i]*helper->datumSize,
-                        sSizes[i] * helper->datumSize,
-                        MPI_BYTE, dir2rank[i], tag, haloComm, &req) );
-                helper->sendRequests.push_back(req);
+                chunks.push_back(chunk);
+                chunkTags.push_back(tag);
             }
 
             totSent += sSizes[i];
         }
 
-    debug("Sent total %d '%s' entities", totSent, pvName.c_str());
+    // Host staging of large buffers: all the chunk copies are queued first,
+    // such that chunk k+1 is downloaded while chunk k is in flight
+    const bool downloadedAll = !gpuAwareMPI && singleCopy;
+    const double start = MPI_Wtime();
+
+    for (int c = 0; c < chunks.size(); c++)
+        if (chunks[c].staged && !downloadedAll)
+        {
+            CUDA_Check( cudaMemcpyAsync(
+                            helper->sendBuf.hostPtr() + chunks[c].offset,
+                            helper->sendBuf.devPtr()  + chunks[c].offset,
+                            chunks[c].size,
+                            cudaMemcpyDeviceToHost, stream) );
+            CUDA_Check( cudaEventRecord(getChunkEvent(c), stream) );
+        }
+
+    auto& samples = sendSamples[helper];
+    samples.clear();
+
+    auto isend = [&] (int c) {
+        const auto& chunk = chunks[c];
+
+        if (chunk.staged && !downloadedAll)
+            CUDA_Check( cudaEventSynchronize(chunkEvents[c]) );
+
+        auto ptr = chunk.staged ? helper->sendBuf.hostPtr() : helper->sendBuf.devPtr();
+
+        MPI_Request req;
+        MPI_Check( MPI_Isend(
+                ptr + chunk.offset, chunk.size,
+                MPI_BYTE, dir2rank[chunk.fragment], chunkTags[c], haloComm, &req) );
+        helper->sendRequests.push_back(req);
+
+        if (adaptiveTransport)
+            samples.push_back({transportClass(chunk.fragment, sSizes[chunk.fragment] * helper->datumSize), chunk.staged, start});
+    };
+
+    // the direct chunks do not wait for any copy; a fragment has one transport, its chunks stay in order
+    for (int c = 0; c < chunks.size(); c++) if (!chunks[c].staged) isend(c);
+    for (int c = 0; c < chunks.size(); c++) if ( chunks[c].staged) isend(c);
+
+    debug("Sent total %d '%s' entities in %d messages", totSent, pvName.c_str(), (int) chunks.size());
+
+    if (PerfCounters::isEnabled())
+    {
+        long long totBytes = 0;
+        for (const auto& chunk : chunks)
+            totBytes += chunk.size;
+
+        PerfCounters::add("exchanged entities: " + pvName, totSent);
+        PerfCounters::add("exchanged bytes: "    + pvName, totBytes);
+        PerfCounters::add("exchanged messages: " + pvName, chunks.size());
+    }
 }
 
 
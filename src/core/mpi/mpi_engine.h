@@ -2,9 +2,12 @@
 
 #include "exchanger_interfaces.h"
 #include "exchange_helpers.h"
+#include "transport_tuner.h"
 
+#include <map>
 #include <mpi.h>
 #include <string>
+#include <vector>
 
 /**
  * Engine implementing MPI exchange logic.
@@ -23,16 +26,39 @@
  *     data and data themselves are received and stored in the ExchangeHelper
  *   - calls exchanger combineAndUploadData() that takes care
  *     of storing data from the ExchangeHelper to where is has to be
+ *
+ * If the exchanger unpacks the fragments separately (ParticleExchanger::unpacksFragments()),
+ * each fragment is unpacked with ParticleExchanger::combineAndUploadFragment()
+ * as soon as it is received (MPI_Waitany()), instead of after all of them.
+ *
+ * With \c persistentSizes, the size messages use persistent requests
+ * (MPI_Recv_init() and MPI_Send_init(), started with MPI_Startall()),
+ * created once per helper and only recreated if the size buffers are reallocated.
+ * The data messages keep using MPI_Irecv() and MPI_Isend(), as their size changes every time.
+ *
+ * With a positive \c chunkSize, fragments larger than that many bytes are sent in several messages.
+ * Without GPU-aware MPI, the chunks of large buffers are downloaded one after the other
+ * and each one is sent as soon as it is on the host, while the next ones are still being copied;
+ * on the receiving side each chunk is uploaded as soon as it is received.
+ * All the ranks must use the same chunk size.
+ *
+ * With \c adaptiveTransport and GPU-aware MPI, each fragment is either sent and received straight
+ * from the GPU buffers or staged through the host, depending on its size and whether the neighbour
+ * is on the same node, as chosen by a TransportTuner from the measured latencies of the sends.
+ * The two sides of a message choose independently, since GPU-aware MPI accepts any pair of buffers.
  */
 class MPIExchangeEngine : public ExchangeEngine
 {
 public:
-    MPIExchangeEngine(std::unique_ptr<ParticleExchanger> exchanger, MPI_Comm comm, bool gpuAwareMPI);
+    MPIExchangeEngine(std::unique_ptr<ParticleExchanger> exchanger, MPI_Comm comm, bool gpuAwareMPI,
+                      bool persistentSizes = false, int chunkSize = 0, bool adaptiveTransport = false);
     ~MPIExchangeEngine();
     
     void init(cudaStream_t stream)     override;
     void finalize(cudaStream_t stream) override;
 
+    std::vector<GPUcontainer*> getContainers() override;
+
 private:
     std::unique_ptr<ParticleExchanger> exchanger;
     
@@ -46,9 +72,55 @@ private:
     bool gpuAwareMPI;
     int singleCopyThreshold = 4000000;
 
+    /// part of a fragment sent in one message, offset and size in bytes
+    struct Chunk
+    {
+        int fragment, offset, size;
+        bool staged;  ///< goes through the host buffer
+    };
+
+    int chunkSize;  ///< maximum size of the data messages in bytes, no limit if 0
+    std::map<ExchangeHelper*, std::vector<Chunk>> recvChunks;  ///< one per receive request
+    std::vector<cudaEvent_t> chunkEvents;                      ///< completion of the chunk downloads
+
+    bool adaptiveTransport;
+    TransportTuner tuner;
+    bool dir2intraNode[FragmentMapping::numFragments];
+
+    /// transport and start time of a data send, one per send request
+    struct SendSample
+    {
+        int cls;
+        bool staged;
+        double start;
+    };
+    std::map<ExchangeHelper*, std::vector<SendSample>> sendSamples;
+
+    void detectIntraNode();
+    int transportClass(int fragment, int bytes) const;
+    void waitSends(ExchangeHelper* helper);
+
+    std::vector<Chunk> splitIntoChunks(int fragment, int offset, int size) const;
+    void uploadChunk(ExchangeHelper* helper, const Chunk& chunk, cudaStream_t stream);
+    cudaEvent_t getChunkEvent(int i);
+
+    /// persistent requests of the size messages of one helper
+    struct SizeRequests
+    {
+        const int *recvPtr{nullptr}, *sendPtr{nullptr};  ///< host buffers the requests were created for
+        std::vector<MPI_Request> recv, send;
+    };
+
+    bool persistentSizes;
+    std::map<ExchangeHelper*, SizeRequests> sizeRequests;
+
+    SizeRequests& getSizeRequests(ExchangeHelper* helper);
+    void freeSizeRequests(SizeRequests& reqs);
+
     void postRecvSize(ExchangeHelper* helper);
     void sendSizes(ExchangeHelper* helper);
     void postRecv(ExchangeHelper* helper);
     void wait(ExchangeHelper* helper, cudaStream_t stream);
+    void waitAndUnpackFragments(int id, cudaStream_t stream);
     void send(ExchangeHelper* helper, cudaStream_t stream);
 };
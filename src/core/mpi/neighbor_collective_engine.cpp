@@ -0,0 +1,215 @@
+#include "neighbor_collective_engine.h"
+#include "fragments_mapping.h"
+
+#include <core/logger.h>
+#include <core/utils/cuda_common.h>
+#include <core/utils/nvtx.h>
+#include <core/utils/perf_counters.h>
+
+#include <algorithm>
+#include <numeric>
+
+NeighborCollectiveEngine::NeighborCollectiveEngine(std::unique_ptr<ParticleExchanger> exchanger,
+                                                   MPI_Comm comm, bool gpuAwareMPI) :
+    exchanger(std::move(exchanger)),
+    gpuAwareMPI(gpuAwareMPI)
+{
+    constexpr int nFragments = FragmentMapping::numFragments;
+
+    int dims[3], periods[3], coords[3];
+    MPI_Check( MPI_Cart_get(comm, 3, dims, periods, coords) );
+
+    int dir2rank[nFragments], dir2recvTag[nFragments];
+
+    for (int i = 0; i < nFragments; ++i)
+    {
+        int d[3] = { FragmentMapping::getDirx(i),
+                     FragmentMapping::getDiry(i),
+                     FragmentMapping::getDirz(i) };
+
+        int coordsNeigh[3];
+        for (int c = 0; c < 3; ++c)
+            coordsNeigh[c] = coords[c] + d[c];
+
+        MPI_Check( MPI_Cart_rank(comm, coordsNeigh, dir2rank + i) );
+        dir2recvTag[i] = FragmentMapping::getId(-d[0], -d[1], -d[2]);
+    }
+
+    for (int i = 0; i < nFragments; ++i)
+        if (i != FragmentMapping::bulkId && dir2rank[i] >= 0)
+        {
+            sendFragments.push_back(i);
+            recvFragments.push_back(i);
+        }
+
+    // fragment i is received from the fragment dir2recvTag[i] of the sender,
+    // which sends its fragments in increasing order
+    std::sort(recvFragments.begin(), recvFragments.end(), [&dir2recvTag] (int a, int b) {
+        return dir2recvTag[a] < dir2recvTag[b];
+    });
+
+    std::vector<int> destinations, sources;
+    for (auto f : sendFragments) destinations.push_back(dir2rank[f]);
+    for (auto f : recvFragments) sources     .push_back(dir2rank[f]);
+
+    MPI_Check( MPI_Dist_graph_create_adjacent(comm,
+                                              sources.size(),      sources.data(),      MPI_UNWEIGHTED,
+                                              destinations.size(), destinations.data(), MPI_UNWEIGHTED,
+                                              MPI_INFO_NULL, 0, &graphComm) );
+
+    const int nEdges = sendFragments.size();
+    sendCounts.resize(nEdges);
+    sendDispls.resize(nEdges);
+    recvCounts.resize(nEdges);
+    recvDispls.resize(nEdges);
+}
+
+NeighborCollectiveEngine::~NeighborCollectiveEngine()
+{
+    MPI_Check( MPI_Comm_free(&graphComm) );
+}
+
+int NeighborCollectiveEngine::nHelpers() const
+{
+    return exchanger->helpers.size();
+}
+
+void NeighborCollectiveEngine::init(cudaStream_t stream)
+{
+    auto& helpers = exchanger->helpers;
+
+    {
+        NVTX::Range range("Neighbor exchange: prepare sizes", NVTX::Category::Halo);
+        for (int i = 0; i < nHelpers(); i++)
+            if (exchanger->needExchange(i)) exchanger->prepareSizes(i, stream);
+            else debug("Exchange of PV '%s' is skipped", helpers[i]->name.c_str());
+    }
+
+    {
+        NVTX::Range range("Neighbor exchange: sizes", NVTX::Category::Halo);
+        exchangeSizes();
+    }
+
+    {
+        NVTX::Range range("Neighbor exchange: pack", NVTX::Category::Halo);
+        for (int i = 0; i < nHelpers(); i++)
+            if (exchanger->needExchange(i)) exchanger->prepareData(i, stream);
+    }
+
+    // the collectives read the send buffers right away
+    if (gpuAwareMPI)
+        CUDA_Check( cudaStreamSynchronize(stream) );
+    else
+        for (int i = 0; i < nHelpers(); i++)
+            if (exchanger->needExchange(i)) helpers[i]->sendBuf.downloadFromDevice(stream);
+
+    {
+        NVTX::Range range("Neighbor exchange: post", NVTX::Category::Halo);
+        requests.resize(nHelpers());
+        for (int i = 0; i < nHelpers(); i++)
+            postData(i);
+    }
+}
+
+void NeighborCollectiveEngine::exchangeSizes()
+{
+    auto& helpers = exchanger->helpers;
+    const int nEdges = sendFragments.size();
+    const int nh = nHelpers();
+
+    sendSizes.assign(nEdges * nh, 0);
+    recvSizes.assign(nEdges * nh, 0);
+
+    for (int h = 0; h < nh; h++)
+    {
+        if (!exchanger->needExchange(h)) continue;
+
+        for (int e = 0; e < nEdges; e++)
+            sendSizes[e * nh + h] = helpers[h]->sendSizes[sendFragments[e]];
+    }
+
+    if (nh > 0)
+        MPI_Check( MPI_Neighbor_alltoall(sendSizes.data(), nh, MPI_INT,
+                                         recvSizes.data(), nh, MPI_INT, graphComm) );
+
+    for (int h = 0; h < nh; h++)
+    {
+        if (!exchanger->needExchange(h)) continue;
+
+        auto helper = helpers[h].get();
+        helper->recvSizes.clearHost();
+
+        for (int e = 0; e < nEdges; e++)
+            helper->recvSizes[recvFragments[e]] = recvSizes[e * nh + h];
+
+        helper->computeRecvOffsets();
+        helper->resizeRecvBuf();
+    }
+}
+
+void NeighborCollectiveEngine::postData(int id)
+{
+    auto helper = exchanger->helpers[id].get();
+    const bool active = exchanger->needExchange(id);
+    const int nEdges = sendFragments.size();
+    const int datumSize = helper->datumSize;
+
+    long long totBytes = 0;
+
+    for (int e = 0; e < nEdges; e++)
+    {
+        const int sf = sendFragments[e];
+        const int rf = recvFragments[e];
+
+        sendCounts[e] = active ? helper->sendSizes  [sf] * datumSize : 0;
+        sendDispls[e] = active ? helper->sendOffsets[sf] * datumSize : 0;
+        recvCounts[e] = active ? helper->recvSizes  [rf] * datumSize : 0;
+        recvDispls[e] = active ? helper->recvOffsets[rf] * datumSize : 0;
+
+        totBytes += sendCounts[e];
+    }
+
+    auto sendPtr = gpuAwareMPI ? helper->sendBuf.devPtr() : helper->sendBuf.hostPtr();
+    auto recvPtr = gpuAwareMPI ? helper->recvBuf.devPtr() : helper->recvBuf.hostPtr();
+
+    MPI_Check( MPI_Ineighbor_alltoallv(sendPtr, sendCounts.data(), sendDispls.data(), MPI_BYTE,
+                                       recvPtr, recvCounts.data(), recvDispls.data(), MPI_BYTE,
+                                       graphComm, &requests[id]) );
+
+    if (active && PerfCounters::isEnabled())
+    {
+        PerfCounters::add("exchanged bytes: "    + helper->name, totBytes);
+        PerfCounters::add("exchanged messages: " + helper->name, nEdges);
+    }
+}
+
+void NeighborCollectiveEngine::finalize(cudaStream_t stream)
+{
+    auto& helpers = exchanger->helpers;
+
+    {
+        NVTX::Range range("Neighbor exchange: wait", NVTX::Category::Halo);
+        MPI_Check( MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE) );
+    }
+
+    {
+        NVTX::Range range("Neighbor exchange: unpack", NVTX::Category::Halo);
+        for (int i = 0; i < nHelpers(); i++)
+        {
+            if (!exchanger->needExchange(i)) continue;
+
+            if (!gpuAwareMPI)
+                helpers[i]->recvBuf.uploadToDevice(stream);
+
+            exchanger->combineAndUploadData(i, stream);
+        }
+    }
+
+    for (auto& helper : helpers)
+        helper->releaseStaging(stream);
+}
+
+std::vector<GPUcontainer*> NeighborCollectiveEngine::getContainers()
+{
+    return exchanger->getContainers();
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "exchanger_interfaces.h"
+#include "exchange_helpers.h"
+
+#include <mpi.h>
+#include <vector>
+
+/**
+ * MPI engine relying on the neighbourhood collectives of a distributed graph topology
+ * built over the 26 neighbours of the cartesian communicator:
+ * - the sizes of all the helpers go in one MPI_Neighbor_alltoall();
+ * - the data of every helper go in one MPI_Ineighbor_alltoallv(), straight from the
+ *   helper buffers, the MPI implementation then schedules the messages itself.
+ *
+ * With few ranks per dimension, a neighbour may be reached in several directions:
+ * the graph then has several edges between the same ranks. The messages of such edges
+ * are matched in the order of the edges, hence the sources are listed in the order
+ * of the directions of the senders, see the constructor.
+ *
+ * The collectives are called for all the helpers, such that all the ranks must agree on
+ * which helpers are exchanged (ParticleExchanger::needExchange()); skipped helpers are
+ * sent with zero sizes. The fragments are unpacked once all are received.
+ */
+class NeighborCollectiveEngine : public ExchangeEngine
+{
+public:
+    NeighborCollectiveEngine(std::unique_ptr<ParticleExchanger> exchanger, MPI_Comm comm, bool gpuAwareMPI);
+    ~NeighborCollectiveEngine();
+
+    void init(cudaStream_t stream)     override;
+    void finalize(cudaStream_t stream) override;
+
+    std::vector<GPUcontainer*> getContainers() override;
+
+private:
+    std::unique_ptr<ParticleExchanger> exchanger;
+
+    MPI_Comm graphComm;
+    bool gpuAwareMPI;
+
+    std::vector<int> sendFragments; ///< fragment of each outgoing edge
+    std::vector<int> recvFragments; ///< fragment of each incoming edge
+
+    /// per edge and helper, [edge * nHelpers + helper]
+    std::vector<int> sendSizes, recvSizes;
+
+    std::vector<int> sendCounts, sendDispls, recvCounts, recvDispls;
+    std::vector<MPI_Request> requests;
+
+    int nHelpers() const;
+    void exchangeSizes();
+    void postData(int id);
+};
@@ -98,6 +98,50 @@ __global__ void getObjectHalos(const DomainInfo domain, const OVview view, const
     }
 }
 
+/**
+ * Surface mode: every particle within rc of the subdomain faces goes to the
+ * corresponding halos on its own, the objects are not kept together
+ */
+template <PackMode packMode>
+__global__ void getSurfaceHalos(const DomainInfo domain, const OVview view, const ParticlePacker packer,
+        const float rc, BufferOffsetsSizesWrap dataWrap, int *haloParticleIds = nullptr)
+{
+    const int pid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (pid >= view.size) return;
+
+    Particle p;
+    p.readCoordinate(view.particles, pid);
+
+    int dx = 0, dy = 0, dz = 0;
+
+    if (p.r.x < -0.5f*domain.localSize.x + rc) dx = -1;
+    if (p.r.y < -0.5f*domain.localSize.y + rc) dy = -1;
+    if (p.r.z < -0.5f*domain.localSize.z + rc) dz = -1;
+
+    if (p.r.x >  0.5f*domain.localSize.x - rc) dx = 1;
+    if (p.r.y >  0.5f*domain.localSize.y - rc) dy = 1;
+    if (p.r.z >  0.5f*domain.localSize.z - rc) dz = 1;
+
+    for (int ix = min(dx, 0); ix <= max(dx, 0); ++ix)
+        for (int iy = min(dy, 0); iy <= max(dy, 0); ++iy)
+            for (int iz = min(dz, 0); iz <= max(dz, 0); ++iz)
+            {
+                if (ix == 0 && iy == 0 && iz == 0) continue;
+                const int bufId = FragmentMapping::getId(ix, iy, iz);
+                const int dstId = atomicAdd(dataWrap.sizes + bufId, 1);
+
+                if (packMode == PackMode::Query) continue;
+
+                const float3 shift{ domain.localSize.x * ix,
+                                    domain.localSize.y * iy,
+                                    domain.localSize.z * iz };
+
+                const int myOffset = dataWrap.offsets[bufId] + dstId;
+                haloParticleIds[myOffset] = pid;
+                packer.packShift(pid, dataWrap.buffer + myOffset * packer.packedSize_byte, -shift);
+            }
+}
+
 __global__ static void unpackObject(const char *from, OVview view, ObjectPacker packer)
 {
     const int objId = blockIdx.x;
@@ -114,6 +158,29 @@ __global__ static void unpackObject(const char *from, OVview view, ObjectPacker
     srcAddr += view.objSize * packer.part.packedSize_byte;
     if (tid == 0) packer.obj.unpack(srcAddr, objId);
 }
+/**
+ * Unpack \p nReceived particles of the surface mode; the halo is padded
+ * to a whole number of objects with marked particles, which never interact
+ */
+__global__ static void unpackSurfaceParticles(const char *from, int nReceived, OVview view, ParticlePacker packer)
+{
+    const int pid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (pid >= view.size) return;
+
+    if (pid < nReceived)
+    {
+        packer.unpack(from + pid * packer.packedSize_byte, pid);
+    }
+    else
+    {
+        Particle p;
+        p.r  = make_float3(0.0f);
+        p.u  = make_float3(0.0f);
+        p.i1 = p.i2 = -1;
+        p.mark();
+        p.write2Float4(view.particles, pid);
+    }
+}
 } // namespace ObjectHaloExchangeKernels
 
 //===============================================================================================
@@ -125,11 +192,12 @@ bool ObjectHaloExchanger::needExchange(int id)
     return !objects[id]->haloValid;
 }
 
-void ObjectHaloExchanger::attach(ObjectVector *ov, float rc, const std::vector<std::string>& extraChannelNames)
+void ObjectHaloExchanger::attach(ObjectVector *ov, float rc, const std::vector<std::string>& extraChannelNames, bool surfaceOnly)
 {
     int id = objects.size();
     objects.push_back(ov);
     rcs.push_back(rc);
+    surfaceOnlyFlags.push_back(surfaceOnly);
 
     auto helper = std::make_unique<ExchangeHelper>(ov->name, id);
     helpers.push_back(std::move(helper));
@@ -141,7 +209,8 @@ void ObjectHaloExchanger::attach(ObjectVector *ov, float rc, const std::vector<s
         return std::find(extraChannelNames.begin(), extraChannelNames.end(), namedDesc.first) != extraChannelNames.end();
     });
     
-    info("Object vector %s (rc %f) was attached to halo exchanger", ov->name.c_str(), rc);
+    info("Object vector %s (rc %f) was attached to halo exchanger%s",
+         ov->name.c_str(), rc, surfaceOnly ? ", only the surface particles are sent" : "");
 }
 
 void ObjectHaloExchanger::prepareSizes(int id, cudaStream_t stream)
@@ -156,9 +225,29 @@ void ObjectHaloExchanger::prepareSizes(int id, cudaStream_t stream)
 
     OVview ovView(ov, ov->local());
     ObjectPacker packer(ov, ov->local(), packPredicates[id], stream);
-    helper->setDatumSize(packer.totalPackedSize_byte);
 
     helper->sendSizes.clear(stream);
+
+    if (surfaceOnlyFlags[id])
+    {
+        helper->setDatumSize(packer.part.packedSize_byte);
+
+        if (ovView.size > 0)
+        {
+            const int nthreads = 128;
+
+            SAFE_KERNEL_LAUNCH(
+                    ObjectHaloExchangeKernels::getSurfaceHalos<PackMode::Query>,
+                    getNblocks(ovView.size, nthreads), nthreads, 0, stream,
+                    ov->state->domain, ovView, packer.part, rc, helper->wrapSendData() );
+        }
+
+        helper->computeSendOffsets_Dev2Dev(stream);
+        return;
+    }
+
+    helper->setDatumSize(packer.totalPackedSize_byte);
+
     if (ovView.nObjects > 0)
     {
         const int nthreads = 256;
@@ -184,6 +273,27 @@ void ObjectHaloExchanger::prepareData(int id, cudaStream_t stream)
 
     OVview ovView(ov, ov->local());
     ObjectPacker packer(ov, ov->local(), packPredicates[id], stream);
+
+    if (surfaceOnlyFlags[id])
+    {
+        // 1 int per sent particle
+        helper->setDatumSize(packer.part.packedSize_byte);
+        origin->resize_anew(helper->sendOffsets[helper->nBuffers]);
+
+        if (ovView.size > 0)
+        {
+            const int nthreads = 128;
+
+            helper->resizeSendBuf();
+            helper->sendSizes.clearDevice(stream);
+            SAFE_KERNEL_LAUNCH(
+                    ObjectHaloExchangeKernels::getSurfaceHalos<PackMode::Pack>,
+                    getNblocks(ovView.size, nthreads), nthreads, 0, stream,
+                    ov->state->domain, ovView, packer.part, rc, helper->wrapSendData(), origin->devPtr() );
+        }
+        return;
+    }
+
     helper->setDatumSize(packer.totalPackedSize_byte);
 
     if (ovView.nObjects > 0)
@@ -209,6 +319,24 @@ void ObjectHaloExchanger::combineAndUploadData(int id, cudaStream_t stream)
 
     int totalRecvd = helper->recvOffsets[helper->nBuffers];
 
+    if (surfaceOnlyFlags[id])
+    {
+        const int nObjects = (totalRecvd + ov->objSize - 1) / ov->objSize;
+        ov->halo()->resize_anew(nObjects * ov->objSize);
+
+        OVview ovView(ov, ov->halo());
+        ObjectPacker packer(ov, ov->halo(), packPredicates[id], stream);
+
+        debug2("Received %d surface particles of '%s'", totalRecvd, ov->name.c_str());
+
+        const int nthreads = 128;
+        SAFE_KERNEL_LAUNCH(
+                ObjectHaloExchangeKernels::unpackSurfaceParticles,
+                getNblocks(ovView.size, nthreads), nthreads, 0, stream,
+                helper->recvBuf.devPtr(), totalRecvd, ovView, packer.part );
+        return;
+    }
+
     ov->halo()->resize_anew(totalRecvd * ov->objSize);
     OVview ovView(ov, ov->halo());
     ObjectPacker packer(ov, ov->halo(), packPredicates[id], stream);
@@ -235,6 +363,11 @@ PinnedBuffer<int>& ObjectHaloExchanger::getOrigins(int id)
     return *origins[id];
 }
 
+bool ObjectHaloExchanger::isSurfaceOnly(int id) const
+{
+    return surfaceOnlyFlags[id];
+}
+
 ObjectHaloExchanger::~ObjectHaloExchanger() = default;
 
 
@@ -10,19 +10,32 @@
 
 class ObjectVector;
 
+/**
+ * Send the objects close to the subdomain faces to the neighbouring ranks.
+ *
+ * By default whole objects are sent, as needed by the bouncers and the belonging checkers.
+ * With \p surfaceOnly in attach(), only the particles within rc of the faces are sent,
+ * each one on its own (the object id can be recovered from the global particle id).
+ * The offsets and the origins then count particles instead of objects,
+ * and the halo is padded to a whole number of objects with marked particles
+ */
 class ObjectHaloExchanger : public ParticleExchanger
 {
 public:
-    void attach(ObjectVector *ov, float rc, const std::vector<std::string>& extraChannelNames);
+    void attach(ObjectVector *ov, float rc, const std::vector<std::string>& extraChannelNames, bool surfaceOnly = false);
 
     PinnedBuffer<int>& getSendOffsets(int id);
     PinnedBuffer<int>& getRecvOffsets(int id);
     PinnedBuffer<int>& getOrigins    (int id);
 
+    /// true if only the surface particles of \p id are exchanged, see attach()
+    bool isSurfaceOnly(int id) const;
+
     virtual ~ObjectHaloExchanger();
 
 protected:
     std::vector<float> rcs;
+    std::vector<bool> surfaceOnlyFlags;
     std::vector<ObjectVector*> objects;
     std::vector<PackPredicate> packPredicates;
 
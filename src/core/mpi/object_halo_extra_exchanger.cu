@@ -59,6 +59,10 @@ void ObjectExtraExchanger::attach(ObjectVector *ov, const std::vector<std::strin
     int id = objects.size();
     objects.push_back(ov);
 
+    if (!extraChannelNames.empty() && entangledHaloExchanger->isSurfaceOnly(id))
+        die("Cannot exchange the extra channels of '%s' in the halo: only its surface particles are sent",
+            ov->name.c_str());
+
     auto helper = std::make_unique<ExchangeHelper>(ov->name, id);
     helpers.push_back(std::move(helper));
 
@@ -92,6 +96,9 @@ void ObjectExtraExchanger::prepareData(int id, cudaStream_t stream)
 
     int nObjects = helper->sendOffsets[helper->nBuffers];
 
+    // nothing to pack; the origins may also be per particle, see ObjectHaloExchanger::isSurfaceOnly()
+    if (packer.packedSize_byte == 0) return;
+
     const int nthreads = 128;
     
     SAFE_KERNEL_LAUNCH(
@@ -110,6 +117,8 @@ void ObjectExtraExchanger::combineAndUploadData(int id, cudaStream_t stream)
     OVview view(ov, ov->halo());
     ParticleExtraPacker packer(ov, ov->halo(), packPredicates[id], stream);
 
+    if (packer.packedSize_byte == 0) return;
+
     const int nthreads = 128;
     SAFE_KERNEL_LAUNCH(
             ObjectHaloExtraExchangeKernels::unpack,
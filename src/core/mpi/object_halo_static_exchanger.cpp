@@ -0,0 +1,235 @@
+#include "object_halo_static_exchanger.h"
+#include "object_halo_exchanger.h"
+#include "exchange_helpers.h"
+
+#include <core/logger.h>
+#include <core/pvs/object_vector.h>
+#include <core/utils/common.h>
+#include <core/utils/cuda_common.h>
+
+#include <algorithm>
+#include <cstring>
+
+ObjectStaticExchanger::ObjectStaticExchanger(ObjectHaloExchanger *entangledHaloExchanger) :
+    entangledHaloExchanger(entangledHaloExchanger)
+{}
+
+ObjectStaticExchanger::~ObjectStaticExchanger() = default;
+
+bool ObjectStaticExchanger::needExchange(int id)
+{
+    // same as the entangled exchanger, nothing to do without channels
+    return !channels[id]->names.empty() && !objects[id]->haloValid;
+}
+
+void ObjectStaticExchanger::attach(ObjectVector *ov, const std::vector<std::string>& staticChannelNames)
+{
+    int id = objects.size();
+    objects.push_back(ov);
+
+    auto helper = std::make_unique<ExchangeHelper>(ov->name + ":static", id);
+    helpers.push_back(std::move(helper));
+
+    auto ch = std::make_unique<StaticChannels>();
+    ch->lastSent.resize(FragmentMapping::numFragments);
+
+    auto& manager = ov->local()->extraPerObject;
+    for (const auto& name : staticChannelNames)
+    {
+        auto& desc = manager.getChannelDescOrDie(name);
+
+        if (desc.shiftTypeSize != 0)
+            die("Channel '%s' of object vector '%s' is shifted between the ranks and cannot be static in the halo",
+                name.c_str(), ov->name.c_str());
+
+        const int size = desc.container->datatype_size();
+        ch->names.push_back(name);
+        ch->sizes.push_back(size);
+        ch->totalSize += size;
+    }
+
+    ch->data    .setOwner(ov->name + ":exchange:static");
+    ch->haloData.setOwner(ov->name + ":exchange:static");
+    channels.push_back(std::move(ch));
+
+    if (!staticChannelNames.empty())
+        info("Object vector %s was attached to the static halo exchanger with %d channels",
+             ov->name.c_str(), (int) staticChannelNames.size());
+}
+
+void ObjectStaticExchanger::downloadChannels(ObjectVector *ov, LocalObjectVector *lov, StaticChannels& ch, cudaStream_t stream)
+{
+    const int n = lov->nObjects;
+    ch.data.resize_anew(n * ch.totalSize);
+
+    int offset = 0;
+    for (int c = 0; c < ch.names.size(); c++)
+    {
+        auto container = lov->extraPerObject.getGenericData(ch.names[c]);
+        CUDA_Check( cudaMemcpyAsync(ch.data.hostPtr() + offset, container->genericDevPtr(),
+                                    n * ch.sizes[c], cudaMemcpyDeviceToHost, stream) );
+        offset += n * ch.sizes[c];
+    }
+
+    CUDA_Check( cudaStreamSynchronize(stream) );
+}
+
+/**
+ * Expects the entangled exchanger to have packed its data already: its send offsets are on host,
+ * origins of the halo particles on device
+ */
+void ObjectStaticExchanger::prepareSizes(int id, cudaStream_t stream)
+{
+    auto ov = objects[id];
+    auto lov = ov->local();
+    auto helper = helpers[id].get();
+    auto& ch = *channels[id];
+
+    const auto& offsets = entangledHaloExchanger->getSendOffsets(id);
+    auto& origins       = entangledHaloExchanger->getOrigins(id);
+    auto ids            = lov->extraPerObject.getData<int>(ChannelNames::globalIds);
+
+    const int nSlots = offsets[helper->nBuffers];
+
+    helper->setDatumSize(sizeof(int) + ch.totalSize);
+    helper->sendSizes.clearHost();
+    ch.toSend.clear();
+
+    if (nSlots > 0)
+    {
+        // first particle of every halo object tells which object it is
+        ch.slotOrigins.resize_anew(nSlots);
+        CUDA_Check( cudaMemcpy2DAsync(ch.slotOrigins.hostPtr(), sizeof(int),
+                                      origins.devPtr(), ov->objSize * sizeof(int),
+                                      sizeof(int), nSlots, cudaMemcpyDeviceToHost, stream) );
+
+        ids->downloadFromDevice(stream, ContainersSynch::Asynch);
+        CUDA_Check( cudaStreamSynchronize(stream) );
+    }
+
+    for (int i = 0; i < helper->nBuffers; i++)
+    {
+        auto& last = ch.lastSent[i];
+        std::vector<int> current;
+
+        for (int slot = offsets[i]; slot < offsets[i+1]; slot++)
+        {
+            const int objId = ch.slotOrigins[slot] / ov->objSize;
+            const int gid   = (*ids)[objId];
+
+            current.push_back(gid);
+
+            if (!std::binary_search(last.begin(), last.end(), gid))
+            {
+                ch.toSend.push_back(objId);
+                helper->sendSizes[i]++;
+            }
+        }
+
+        std::sort(current.begin(), current.end());
+        last = std::move(current);
+    }
+
+    debug2("%d objects of '%s' entered the halo, sending their static data",
+           (int) ch.toSend.size(), ov->name.c_str());
+}
+
+void ObjectStaticExchanger::prepareData(int id, cudaStream_t stream)
+{
+    auto ov = objects[id];
+    auto lov = ov->local();
+    auto helper = helpers[id].get();
+    auto& ch = *channels[id];
+
+    helper->computeSendOffsets();
+    helper->resizeSendBuf();
+
+    if (ch.toSend.empty()) return;
+
+    downloadChannels(ov, lov, ch, stream);
+
+    auto ids = lov->extraPerObject.getData<int>(ChannelNames::globalIds);
+    const int n = lov->nObjects;
+    char *dst = helper->sendBuf.hostPtr();
+
+    for (auto objId : ch.toSend)
+    {
+        const int gid = (*ids)[objId];
+        memcpy(dst, &gid, sizeof(int));
+        dst += sizeof(int);
+
+        int offset = 0;
+        for (int c = 0; c < ch.names.size(); c++)
+        {
+            memcpy(dst, ch.data.hostPtr() + offset + objId * ch.sizes[c], ch.sizes[c]);
+            dst    += ch.sizes[c];
+            offset += n * ch.sizes[c];
+        }
+    }
+
+    // engines expect the data on device
+    helper->sendBuf.uploadToDevice(stream);
+}
+
+/**
+ * Expects the entangled exchanger to have unpacked the halo already, global ids included
+ */
+void ObjectStaticExchanger::combineAndUploadData(int id, cudaStream_t stream)
+{
+    auto ov = objects[id];
+    auto hlov = ov->halo();
+    auto helper = helpers[id].get();
+    auto& ch = *channels[id];
+
+    const int nReceived = helper->recvOffsets[helper->nBuffers];
+    if (nReceived > 0)
+        helper->recvBuf.downloadFromDevice(stream);
+
+    const char *src = helper->recvBuf.hostPtr();
+    for (int i = 0; i < nReceived; i++)
+    {
+        int gid;
+        memcpy(&gid, src, sizeof(int));
+        src += sizeof(int);
+
+        ch.cache[gid].assign(src, src + ch.totalSize);
+        src += ch.totalSize;
+    }
+
+    const int nHalo = hlov->nObjects;
+    auto ids = hlov->extraPerObject.getData<int>(ChannelNames::globalIds);
+    ids->downloadFromDevice(stream);
+
+    // objects that left the halo are forgotten
+    std::map<int, std::vector<char>> kept;
+    ch.haloData.resize_anew(nHalo * ch.totalSize);
+
+    for (int j = 0; j < nHalo; j++)
+    {
+        const int gid = (*ids)[j];
+        auto it = ch.cache.find(gid);
+        if (it == ch.cache.end())
+            die("Static halo data of object %d of '%s' were never received", gid, ov->name.c_str());
+
+        int offset = 0, inRecord = 0;
+        for (int c = 0; c < ch.names.size(); c++)
+        {
+            memcpy(ch.haloData.hostPtr() + offset + j * ch.sizes[c], it->second.data() + inRecord, ch.sizes[c]);
+            offset   += nHalo * ch.sizes[c];
+            inRecord += ch.sizes[c];
+        }
+
+        kept.insert(*it);
+    }
+
+    ch.cache = std::move(kept);
+
+    int offset = 0;
+    for (int c = 0; c < ch.names.size(); c++)
+    {
+        auto container = hlov->extraPerObject.getGenericData(ch.names[c]);
+        CUDA_Check( cudaMemcpyAsync(container->genericDevPtr(), ch.haloData.hostPtr() + offset,
+                                    nHalo * ch.sizes[c], cudaMemcpyHostToDevice, stream) );
+        offset += nHalo * ch.sizes[c];
+    }
+}
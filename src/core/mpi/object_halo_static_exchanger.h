@@ -0,0 +1,65 @@
+#pragma once
+
+#include "exchanger_interfaces.h"
+
+#include <core/containers.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+class LocalObjectVector;
+class ObjectVector;
+class ObjectHaloExchanger;
+
+/**
+ * Exchange of the per-object channels that do not change while the objects are in the halo,
+ * e.g. reference or persistent data.
+ *
+ * The channels are only sent for the objects that entered the halo of a fragment since the previous exchange,
+ * known from the global object ids sent through this fragment last time.
+ * The receiver keeps them by global id for as long as the object stays in its halo,
+ * and fills the halo channels from this cache for all the halo objects.
+ *
+ * Has to be used together with the entangled ObjectHaloExchanger, run right after it,
+ * which must exchange the global ids but not these channels.
+ * Works on the host: all the channels are per object, i.e. small.
+ */
+class ObjectStaticExchanger : public ParticleExchanger
+{
+public:
+    ObjectStaticExchanger(ObjectHaloExchanger *entangledHaloExchanger);
+    virtual ~ObjectStaticExchanger();
+
+    /// all the object vectors of the entangled exchanger must be attached, in the same order
+    void attach(ObjectVector *ov, const std::vector<std::string>& staticChannelNames);
+
+protected:
+    struct StaticChannels
+    {
+        std::vector<std::string> names;
+        std::vector<int> sizes;   ///< bytes per object of each channel
+        int totalSize {0};        ///< bytes per object of all the channels
+
+        std::vector<std::vector<int>> lastSent;  ///< sorted global ids sent per fragment in the last exchange
+        std::vector<int> toSend;                 ///< local ids of the objects to send, by fragment
+
+        PinnedBuffer<int>  slotOrigins;          ///< first particle of every halo object to send
+        PinnedBuffer<char> data;                 ///< host copy of the local channels, one after another
+        PinnedBuffer<char> haloData;             ///< same for the halo objects, filled from the cache
+
+        std::map<int, std::vector<char>> cache;  ///< static data of the halo objects by global id
+    };
+
+    std::vector<ObjectVector*> objects;
+    ObjectHaloExchanger *entangledHaloExchanger;
+    std::vector<std::unique_ptr<StaticChannels>> channels;
+
+    void prepareSizes(int id, cudaStream_t stream) override;
+    void prepareData (int id, cudaStream_t stream) override;
+    void combineAndUploadData(int id, cudaStream_t stream) override;
+    bool needExchange(int id) override;
+
+    void downloadChannels(ObjectVector *ov, LocalObjectVector *lov, StaticChannels& ch, cudaStream_t stream);
+};
@@ -22,6 +22,75 @@ __global__ void packObjectForces(OVview view, char *output, int datumSize)
         addr[pid] = view.forces[objId*view.objSize + pid];
 }
 
+/// halo objects of every fragment and layout of the sparse send buffer
+struct SparseFragments
+{
+    int objStarts[FragmentMapping::numFragments + 1];
+    int offsets  [FragmentMapping::numFragments];     ///< in records
+    int sparse   [FragmentMapping::numFragments];     ///< 0 if the fragment is sent dense
+};
+
+__device__ inline int getFragment(const SparseFragments& fragments, int objId)
+{
+    int fragment = 0;
+    while (fragments.objStarts[fragment+1] <= objId) fragment++;
+    return fragment;
+}
+
+/// same tolerance as atomicAddNonZero()
+__device__ inline bool isNonZero(float4 f)
+{
+    const float tol = 1e-7;
+    return fabs(f.x) > tol || fabs(f.y) > tol || fabs(f.z) > tol;
+}
+
+/// one block per halo object, counts the nonzero forces of every fragment in \p counts
+__global__ void countNonZeroForces(OVview view, SparseFragments fragments, int *counts)
+{
+    const int objId = blockIdx.x;
+    __shared__ int count;
+
+    if (threadIdx.x == 0) count = 0;
+    __syncthreads();
+
+    int myCount = 0;
+    for (int pid = threadIdx.x; pid < view.objSize; pid += blockDim.x)
+        if (isNonZero(view.forces[objId*view.objSize + pid])) myCount++;
+
+    if (myCount > 0) atomicAdd(&count, myCount);
+    __syncthreads();
+
+    if (threadIdx.x == 0 && count > 0)
+        atomicAdd(counts + getFragment(fragments, objId), count);
+}
+
+/**
+ * One block per halo object. The dense fragments get the forces of all the particles,
+ * the sparse ones a record with the force and the index of the particle in the fragment
+ * for every nonzero force, in any order; \p cursors must be zero
+ */
+__global__ void packSparseForces(OVview view, SparseFragments fragments, int *cursors, float4 *output)
+{
+    const int objId = blockIdx.x;
+    const int fragment = getFragment(fragments, objId);
+    const int start = (objId - fragments.objStarts[fragment]) * view.objSize;
+
+    float4 *addr = output + fragments.offsets[fragment];
+
+    for (int pid = threadIdx.x; pid < view.objSize; pid += blockDim.x)
+    {
+        const float4 f = view.forces[objId*view.objSize + pid];
+
+        if (!fragments.sparse[fragment])
+            addr[start + pid] = f;
+        else if (isNonZero(f))
+        {
+            const int slot = atomicAdd(cursors + fragment, 1);
+            addr[slot] = Float3_int(f4tof3(f), start + pid).toFloat4();
+        }
+    }
+}
+
 __global__ void packRigidForces(ROVview view, char *output, int datumSize)
 {
     const int objId = blockIdx.x;
@@ -64,6 +133,21 @@ __global__ void packExtraData(int objSize, int offsetPerObject, int byteSizePerO
 }
 
 
+/// surface mode of the halo exchanger: the halo particles are sent back one by one
+__global__ void packSurfaceData(int np, const float4 *forces, ParticleExtraPacker packer,
+                                int forceDatumSize, int datumSize, char *output)
+{
+    const int pid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (pid >= np) return;
+
+    char *dstAddr = output + pid * datumSize;
+
+    if (forceDatumSize > 0)
+        *((float4*) dstAddr) = forces[pid];
+
+    packer.pack(pid, dstAddr + forceDatumSize);
+}
+
 __device__ inline void atomicAddNonZero(float4 *dest, float3 v)
 {
     const float tol = 1e-7;
@@ -89,6 +173,18 @@ __global__ void addHaloForces(const char *recvBuffer, const int *origins,
     }
 }
 
+/// records of one fragment, \p origins are those of the fragment
+__global__ void addSparseForces(const float4 *records, int nRecords, bool dense, const int *origins, float4 *forces)
+{
+    const int i = blockIdx.x * blockDim.x + threadIdx.x;
+    if (i >= nRecords) return;
+
+    Float3_int record(records[i]);
+    const int dstId = origins[dense ? i : record.i];
+
+    atomicAddNonZero(forces + dstId, record.v);
+}
+
 __global__ void addRigidForces(const char *recvBuffer, int nrecvd, const int *origins,
                                ROVview view, int datumSize)
 {
@@ -125,10 +221,29 @@ __global__ void unpackAndAddExtraData(int objSize, int offsetPerObject, int byte
         packer.unpackAtomicAdd(srcAddr + pid * packer.packedSize_byte, dstId);
     }
 }
+
+__global__ void addSurfaceData(int np, const char *recvBuffer, const int *origins, float4 *forces,
+                               ParticleExtraPacker packer, int forceDatumSize, int datumSize)
+{
+    const int pid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (pid >= np) return;
+
+    const char *srcAddr = recvBuffer + pid * datumSize;
+    const int dstId = origins[pid];
+
+    if (forceDatumSize > 0)
+    {
+        Float3_int extraFrc( *((const float4*) srcAddr) );
+        atomicAddNonZero(forces + dstId, extraFrc.v);
+    }
+
+    packer.unpackAtomicAdd(srcAddr + forceDatumSize, dstId);
+}
 } // namespace ObjectReverseExchangerKernels
 
-ObjectReverseExchanger::ObjectReverseExchanger(ObjectHaloExchanger *entangledHaloExchanger) :
-    entangledHaloExchanger(entangledHaloExchanger)
+ObjectReverseExchanger::ObjectReverseExchanger(ObjectHaloExchanger *entangledHaloExchanger, bool sparseForces) :
+    entangledHaloExchanger(entangledHaloExchanger),
+    sparseForces(sparseForces)
 {}
 
 ObjectReverseExchanger::~ObjectReverseExchanger() = default;
@@ -168,13 +283,24 @@ void ObjectReverseExchanger::attach(ObjectVector *ov, std::vector<std::string> c
     });
 
     ParticleExtraPacker packer(ov, ov->local(), packPredicates[id], defaultStream);
-    int datumSize = getForceDatumSize(id);
-    datumSize += ov->objSize * packer.packedSize_byte;
-    
+    int datumSize = getForceDatumSize(id) + getParticlesPerDatum(id) * packer.packedSize_byte;
+
+    // the halo exchanger takes the objects first
+    const bool sparse = sparseForces && needExchForces && packer.packedSize_byte == 0 &&
+        dynamic_cast<RigidObjectVector*>(ov) == nullptr && !entangledHaloExchanger->isSurfaceOnly(id);
+
+    sparseIds.push_back(sparse);
+    nonZeroCounts.push_back(sparse ? std::make_unique<PinnedBuffer<int>>(FragmentMapping::numFragments) : nullptr);
+
+    if (sparse) datumSize = sizeof(Force);
+
     auto helper = std::make_unique<ExchangeHelper>(ov->name, id);
     helper->setDatumSize(datumSize);
     
     helpers.push_back(std::move(helper));    
+
+    if (sparse)
+        info("Sending back only the nonzero forces of the halo objects of '%s'", ov->name.c_str());
 }
 
 bool ObjectReverseExchanger::needExchange(int id)
@@ -184,6 +310,12 @@ bool ObjectReverseExchanger::needExchange(int id)
 
 void ObjectReverseExchanger::prepareSizes(int id, cudaStream_t stream)
 {
+    if (sparseIds[id])
+    {
+        prepareSparseSizes(id, stream);
+        return;
+    }
+
     auto  helper  = helpers[id].get();
     auto& offsets = entangledHaloExchanger->getRecvOffsets(id);
 
@@ -193,6 +325,12 @@ void ObjectReverseExchanger::prepareSizes(int id, cudaStream_t stream)
 
 void ObjectReverseExchanger::prepareData(int id, cudaStream_t stream)
 {
+    if (sparseIds[id])
+    {
+        prepareSparseData(id, stream);
+        return;
+    }
+
     auto ov = objects[id];
     auto helper = helpers[id].get();
     auto needExchForces = needForces[id];
@@ -206,7 +344,7 @@ void ObjectReverseExchanger::prepareData(int id, cudaStream_t stream)
     auto rov = dynamic_cast<RigidObjectVector*>(ov);
     
     int forceDatumSize = getForceDatumSize(id);
-    int datumSize = forceDatumSize + ov->objSize * packer.packedSize_byte;
+    int datumSize = forceDatumSize + getParticlesPerDatum(id) * packer.packedSize_byte;
     
     helper->setDatumSize(datumSize);
     helper->computeSendOffsets();
@@ -215,6 +353,22 @@ void ObjectReverseExchanger::prepareData(int id, cudaStream_t stream)
     const int nthreads = 128;
     int nObjects = ov->halo()->nObjects;
 
+    if (entangledHaloExchanger->isSurfaceOnly(id))
+    {
+        // the halo holds the received particles followed by the padding, see ObjectHaloExchanger
+        const int np = helper->sendOffsets[helper->nBuffers];
+
+        if (np > 0 && datumSize > 0)
+            SAFE_KERNEL_LAUNCH(
+                ObjectReverseExchangerKernels::packSurfaceData,
+                getNblocks(np, nthreads), nthreads, 0, stream,
+                np, (const float4*)ov->halo()->forces.devPtr(), packer,
+                forceDatumSize, datumSize, helper->sendBuf.devPtr() );
+
+        debug2("Will send back data for %d surface particles", np);
+        return;
+    }
+
     if (needExchForces)
     {
         if (rov != nullptr)
@@ -250,32 +404,190 @@ void ObjectReverseExchanger::prepareData(int id, cudaStream_t stream)
 }
 
 void ObjectReverseExchanger::combineAndUploadData(int id, cudaStream_t stream)
+{
+    auto helper = helpers[id].get();
+
+    if (sparseIds[id])
+    {
+        for (int i = 0; i < helper->nBuffers; i++)
+            addReceivedSparse(id, i, stream);
+        return;
+    }
+
+    addReceived(id, 0, helper->recvOffsets[helper->nBuffers], stream);
+}
+
+bool ObjectReverseExchanger::unpacksFragments() const
+{
+    return true;
+}
+
+void ObjectReverseExchanger::combineAndUploadFragment(int id, int fragment, cudaStream_t stream)
+{
+    auto helper = helpers[id].get();
+
+    if (sparseIds[id])
+        addReceivedSparse(id, fragment, stream);
+    else
+        addReceived(id, helper->recvOffsets[fragment], helper->recvSizes[fragment], stream);
+}
+
+/// halo objects of every fragment, as received by the entangled halo exchanger
+static ObjectReverseExchangerKernels::SparseFragments getFragments(const PinnedBuffer<int>& haloOffsets)
+{
+    ObjectReverseExchangerKernels::SparseFragments fragments;
+
+    for (int i = 0; i <= FragmentMapping::numFragments; i++)
+        fragments.objStarts[i] = haloOffsets[i];
+
+    return fragments;
+}
+
+/**
+ * Count the nonzero forces of every fragment of the halo on the device,
+ * the sizes are in records: nonzero forces of the sparse fragments, all the particles of the dense ones
+ */
+void ObjectReverseExchanger::prepareSparseSizes(int id, cudaStream_t stream)
+{
+    auto ov = objects[id];
+    auto helper = helpers[id].get();
+    auto& counts  = *nonZeroCounts[id];
+    auto& offsets = entangledHaloExchanger->getRecvOffsets(id);
+
+    OVview view(ov, ov->halo());
+    const auto fragments = getFragments(offsets);
+
+    counts.clear(stream);
+
+    const int nthreads = 128;
+    SAFE_KERNEL_LAUNCH(
+        ObjectReverseExchangerKernels::countNonZeroForces,
+        view.nObjects, nthreads, 0, stream,
+        view, fragments, counts.devPtr() );
+
+    counts.downloadFromDevice(stream, ContainersSynch::Synch);
+
+    int nSparse = 0, nDense = 0;
+    for (int i = 0; i < helper->nBuffers; i++)
+    {
+        const int total = (offsets[i+1] - offsets[i]) * ov->objSize;
+        const bool sparse = counts[i] <= maxSparseDensity * total;
+
+        helper->sendSizes[i] = sparse ? counts[i] : total;
+        nSparse += sparse ? counts[i] : 0;
+        nDense  += sparse ? 0 : total;
+    }
+
+    debug2("Will send back %d sparse and %d dense forces of the halo objects of '%s' instead of %d",
+           nSparse, nDense, ov->name.c_str(), view.nObjects * ov->objSize);
+}
+
+void ObjectReverseExchanger::prepareSparseData(int id, cudaStream_t stream)
+{
+    auto ov = objects[id];
+    auto helper = helpers[id].get();
+    auto& cursors = *nonZeroCounts[id];
+    auto& offsets = entangledHaloExchanger->getRecvOffsets(id);
+
+    helper->setDatumSize(sizeof(Force));
+    helper->computeSendOffsets();
+    helper->resizeSendBuf();
+
+    OVview view(ov, ov->halo());
+    auto fragments = getFragments(offsets);
+
+    for (int i = 0; i < helper->nBuffers; i++)
+    {
+        fragments.offsets[i] = helper->sendOffsets[i];
+        fragments.sparse[i]  = helper->sendSizes[i] != (offsets[i+1] - offsets[i]) * ov->objSize;
+    }
+
+    cursors.clearDevice(stream);
+
+    const int nthreads = 128;
+    SAFE_KERNEL_LAUNCH(
+        ObjectReverseExchangerKernels::packSparseForces,
+        view.nObjects, nthreads, 0, stream,
+        view, fragments, cursors.devPtr(), (float4*) helper->sendBuf.devPtr() );
+}
+
+/**
+ * The received fragment is dense if it has a record per particle of the objects
+ * sent to this neighbour by the entangled halo exchanger
+ */
+void ObjectReverseExchanger::addReceivedSparse(int id, int fragment, cudaStream_t stream)
+{
+    auto ov = objects[id];
+    auto helper = helpers[id].get();
+
+    const int nRecords = helper->recvSizes[fragment];
+    if (nRecords == 0) return;
+
+    auto& haloOffsets = entangledHaloExchanger->getSendOffsets(id);
+    const int objStart = haloOffsets[fragment];
+    const int nObjects = haloOffsets[fragment+1] - objStart;
+    const bool dense = nRecords == nObjects * ov->objSize;
+
+    debug("Updating %s forces of %d '%s' objects from %d records",
+          dense ? "dense" : "sparse", nObjects, ov->name.c_str(), nRecords);
+
+    const int nthreads = 128;
+    SAFE_KERNEL_LAUNCH(
+        ObjectReverseExchangerKernels::addSparseForces,
+        getNblocks(nRecords, nthreads), nthreads, 0, stream,
+        (const float4*) (helper->recvBuf.devPtr() + helper->recvOffsets[fragment] * sizeof(Force)),
+        nRecords, dense,
+        entangledHaloExchanger->getOrigins(id).devPtr() + objStart * ov->objSize,
+        (float4*)ov->local()->forces.devPtr() );
+}
+
+/**
+ * Add the data of the received objects \p start to \p start + \p nObjects to the local objects
+ */
+void ObjectReverseExchanger::addReceived(int id, int start, int nObjects, cudaStream_t stream)
 {
     auto ov = objects[id];
     auto helper = helpers[id].get();
     auto needExchForces = needForces[id];
     int objSize = ov->objSize;
     
-    int totalRecvd = helper->recvOffsets[helper->nBuffers];
+    if (nObjects == 0) return;
+
     auto& origins = entangledHaloExchanger->getOrigins(id);
 
-    debug("Updating data for %d '%s' objects", totalRecvd, ov->name.c_str());
+    debug("Updating data for %d '%s' objects", nObjects, ov->name.c_str());
 
     ParticleExtraPacker packer(ov, ov->local(), packPredicates[id], stream);
     int forceDatumSize = getForceDatumSize(id);
-    int datumSize = forceDatumSize + ov->objSize * packer.packedSize_byte;    
+    int datumSize = forceDatumSize + getParticlesPerDatum(id) * packer.packedSize_byte;
+
+    const char *recvBuffer = helper->recvBuf.devPtr() + start * datumSize;
     
     const int nthreads = 128;
 
+    if (entangledHaloExchanger->isSurfaceOnly(id))
+    {
+        // nObjects counts particles here, the origins are per sent particle
+        SAFE_KERNEL_LAUNCH(
+            ObjectReverseExchangerKernels::addSurfaceData,
+            getNblocks(nObjects, nthreads), nthreads, 0, stream,
+            nObjects, recvBuffer, origins.devPtr() + start,
+            (float4*)ov->local()->forces.devPtr(), packer,
+            forceDatumSize, datumSize );
+        return;
+    }
+
+    const int  *recvOrigins = origins.devPtr() + start * objSize;
+
     if (needExchForces)
     {
         auto rov = dynamic_cast<RigidObjectVector*>(ov);
 
         SAFE_KERNEL_LAUNCH(
             ObjectReverseExchangerKernels::addHaloForces,
-            totalRecvd, nthreads, 0, stream,
-            helper->recvBuf.devPtr(),                    /* source */
-            origins.devPtr(),                            /* destination ids here */
+            nObjects, nthreads, 0, stream,
+            recvBuffer,                                  /* source */
+            recvOrigins,                                 /* destination ids here */
             (float4*)ov->local()->forces.devPtr(),       /* add to */
             ov->objSize, datumSize );
 
@@ -284,10 +596,10 @@ void ObjectReverseExchanger::combineAndUploadData(int id, cudaStream_t stream)
                 ROVview view(rov, rov->local());
                 SAFE_KERNEL_LAUNCH(
                     ObjectReverseExchangerKernels::addRigidForces,
-                    getNblocks(totalRecvd, nthreads), nthreads, 0, stream,
-                    helper->recvBuf.devPtr(),  /* source */
-                    totalRecvd,
-                    origins.devPtr(),          /* destination ids here */
+                    getNblocks(nObjects, nthreads), nthreads, 0, stream,
+                    recvBuffer,                /* source */
+                    nObjects,
+                    recvOrigins,               /* destination ids here */
                     view, datumSize );         /* add to, packed size */
             }
     }
@@ -296,19 +608,22 @@ void ObjectReverseExchanger::combineAndUploadData(int id, cudaStream_t stream)
     {
         SAFE_KERNEL_LAUNCH(
             ObjectReverseExchangerKernels::unpackAndAddExtraData,
-            totalRecvd, nthreads, 0, stream,
+            nObjects, nthreads, 0, stream,
             objSize, forceDatumSize, datumSize,
-            origins.devPtr(),            /* destination ids here */
-            helper->recvBuf.devPtr(),    /* source */
+            recvOrigins,                 /* destination ids here */
+            recvBuffer,                  /* source */
             packer);
     }
-    
 }
 
 int ObjectReverseExchanger::getForceDatumSize(int id) const
 {    
     if (!needForces[id]) return 0;
 
+    // surface particles: no object, the rigid motions are not sent back
+    if (entangledHaloExchanger->isSurfaceOnly(id))
+        return sizeof(Force);
+
     auto ov = objects[id];
     int objSize = ov->objSize;
     int forcesSize = sizeof(Force) * objSize;  // forces per particle
@@ -318,3 +633,8 @@ int ObjectReverseExchanger::getForceDatumSize(int id) const
 
     return forcesSize;
 }
+
+int ObjectReverseExchanger::getParticlesPerDatum(int id) const
+{
+    return entangledHaloExchanger->isSurfaceOnly(id) ? 1 : objects[id]->objSize;
+}
@@ -5,16 +5,27 @@
 #include <core/containers.h>
 #include <core/pvs/extra_data/packers.h>
 
+#include <memory>
 #include <vector>
 #include <string>
 
 class ObjectVector;
 class ObjectHaloExchanger;
 
+/**
+ * Sends the forces and the extra channels of the halo objects back to their owners.
+ *
+ * With sparse forces, only the nonzero forces are sent for the object vectors sending back
+ * the forces of their particles and nothing else, i.e. neither rigid objects nor surface halos:
+ * a record of 16 bytes per nonzero force holds the force and the index of the particle in its fragment.
+ * The nonzero forces are counted on the device when preparing the sizes, which costs one synchronization.
+ * A fragment with more than maxSparseDensity nonzero forces is sent dense, as without sparse forces;
+ * the receiver tells them apart by their number of records
+ */
 class ObjectReverseExchanger : public ParticleExchanger
 {
 public:
-    ObjectReverseExchanger(ObjectHaloExchanger *entangledHaloExchanger);
+    ObjectReverseExchanger(ObjectHaloExchanger *entangledHaloExchanger, bool sparseForces = false);
     virtual ~ObjectReverseExchanger();
     
     void attach(ObjectVector *ov, std::vector<std::string> channelNames);
@@ -24,12 +35,27 @@ protected:
     ObjectHaloExchanger *entangledHaloExchanger;
     std::vector<PackPredicate> packPredicates;
     std::vector<bool> needForces;
-    
+
+    bool sparseForces;
+    static constexpr float maxSparseDensity = 0.5f;
+    std::vector<bool> sparseIds;                                   ///< the ids sending sparse forces
+    std::vector<std::unique_ptr<PinnedBuffer<int>>> nonZeroCounts; ///< per id and fragment, nullptr if not sparse
+
     
     void prepareSizes(int id, cudaStream_t stream) override;
     void prepareData (int id, cudaStream_t stream) override;
     void combineAndUploadData(int id, cudaStream_t stream) override;
     bool needExchange(int id) override;
 
+    bool unpacksFragments() const override;
+    void combineAndUploadFragment(int id, int fragment, cudaStream_t stream) override;
+
+    void addReceived(int id, int start, int nObjects, cudaStream_t stream);
+
+    void prepareSparseSizes(int id, cudaStream_t stream);
+    void prepareSparseData (int id, cudaStream_t stream);
+    void addReceivedSparse(int id, int fragment, cudaStream_t stream);
+
     int getForceDatumSize(int id) const;
+    int getParticlesPerDatum(int id) const;
 };
@@ -9,6 +9,9 @@
 #include <core/utils/cuda_common.h>
 #include <core/pvs/extra_data/packers.h>
 
+#include <extern/cub/cub/device/device_radix_sort.cuh>
+
+#include <algorithm>
 #include <unistd.h>
 
 
@@ -22,11 +25,12 @@ enum class PackMode
 /**
  * Get halos
  * @param cinfo
- * @param packer
+ * @param packer ParticlePacker or CompressedParticlePacker
  * @param dataWrap
+ * @param origins if not nullptr, receives the id of every packed particle, laid out as the buffer
  */
-template <PackMode packMode>
-__global__ void getHalos(const CellListInfo cinfo, const ParticlePacker packer, BufferOffsetsSizesWrap dataWrap)
+template <PackMode packMode, class Packer>
+__global__ void getHalos(const CellListInfo cinfo, const Packer packer, BufferOffsetsSizesWrap dataWrap, int *origins)
 {
     const int gid = blockIdx.x*blockDim.x + threadIdx.x;
     const int tid = threadIdx.x;
@@ -86,21 +90,30 @@ __global__ void getHalos(const CellListInfo cinfo, const ParticlePacker packer,
                                 cinfo.localDomainSize.y * dir.y,
                                 cinfo.localDomainSize.z * dir.z };
 
+            // slots may be smaller than the halo with speculative packing, the sizes are still counted
+            const int capacity = dataWrap.offsets[bufId+1] - dataWrap.offsets[bufId];
+
 #pragma unroll 3
             for (int i = 0; i < pend-pstart; i++)
             {
                 const int dstInd = myid   + i;
                 const int srcInd = pstart + i;
 
+                if (dstInd >= capacity) break;
+
                 auto bufferAddr = dataWrap.buffer + dataWrap.offsets[bufId]*packer.packedSize_byte;
 
                 packer.packShift(srcInd, bufferAddr + dstInd*packer.packedSize_byte, -shift);
+
+                if (origins != nullptr)
+                    origins[dataWrap.offsets[bufId] + dstInd] = srcInd;
             }
         }
     }
 }
 
-__global__ static void unpackParticles(ParticlePacker packer, const char *buffer, int np)
+template <class Packer>
+__global__ static void unpackParticles(Packer packer, const char *buffer, int np)
 {
     const int pid = blockIdx.x*blockDim.x + threadIdx.x;
     if (pid >= np) return;
@@ -108,11 +121,47 @@ __global__ static void unpackParticles(ParticlePacker packer, const char *buffer
     packer.unpack(buffer + pid*packer.packedSize_byte, pid);
 }
 
+/// the halo particles are just outside the local domain, the clamped cell is the boundary cell they are next to
+__global__ static void computeHaloKeys(const float4 *coosvels, int np, CellListInfo cinfo, int *keys, int *ids)
+{
+    const int pid = blockIdx.x*blockDim.x + threadIdx.x;
+    if (pid >= np) return;
+
+    Particle p;
+    p.readCoordinate(coosvels, pid);
+
+    keys[pid] = cinfo.getCellId(p.r);
+    ids [pid] = pid;
+}
+
+__global__ static void computeHaloSlots(const int *sortedIds, int np, int *slots)
+{
+    const int i = blockIdx.x*blockDim.x + threadIdx.x;
+    if (i >= np) return;
+
+    slots[sortedIds[i]] = i;
+}
+
+template <class Packer>
+__global__ static void unpackParticlesToSlots(Packer packer, const char *buffer, int np, const int *slots)
+{
+    const int pid = blockIdx.x*blockDim.x + threadIdx.x;
+    if (pid >= np) return;
+
+    packer.unpack(buffer + pid*packer.packedSize_byte, slots[pid]);
+}
+
 
 //===============================================================================================
 // Member functions
 //===============================================================================================
 
+ParticleHaloExchanger::ParticleHaloExchanger(bool speculativePacking, bool compression, bool sortedHalos) :
+    speculativePacking(speculativePacking),
+    compression(compression),
+    sortedHalos(sortedHalos)
+{}
+
 ParticleHaloExchanger::~ParticleHaloExchanger() = default;
 
 void ParticleHaloExchanger::attach(ParticleVector *pv, CellList *cl, const std::vector<std::string>& extraChannelNames)
@@ -125,6 +174,11 @@ void ParticleHaloExchanger::attach(ParticleVector *pv, CellList *cl, const std::
     helper->setDatumSize(sizeof(Particle));
 
     helpers.push_back(std::move(helper));
+    slotCapacities.push_back(std::vector<int>(FragmentMapping::numFragments, 0));
+    packedAhead.push_back(false);
+    sizesSlots.push_back(sizesMailbox.add<int>(FragmentMapping::numFragments));
+    origins.push_back(nullptr);
+    haloOrders.push_back(sortedHalos ? std::make_unique<HaloOrder>() : nullptr);
 
     packPredicates.push_back([extraChannelNames](const ExtraDataManager::NamedChannelDesc& namedDesc) {
         return std::find(extraChannelNames.begin(), extraChannelNames.end(), namedDesc.first) != extraChannelNames.end();
@@ -136,8 +190,77 @@ void ParticleHaloExchanger::attach(ParticleVector *pv, CellList *cl, const std::
     for (const auto& ch : extraChannelNames)
         msg_channels += "'" + ch + "' ";
     
-    info("Particle halo exchanger takes pv '%s' with celllist of rc = %g, %s",
-         pv->name.c_str(), cl->rc, msg_channels.c_str());
+    info("Particle halo exchanger takes pv '%s' with celllist of rc = %g, %s%s%s",
+         pv->name.c_str(), cl->rc, msg_channels.c_str(), compression ? " (compressed)" : "",
+         sortedHalos ? " (sorted by cell)" : "");
+}
+
+int ParticleHaloExchanger::getId(const ParticleVector *pv) const
+{
+    auto it = std::find(particles.begin(), particles.end(), pv);
+    return it == particles.end() ? -1 : std::distance(particles.begin(), it);
+}
+
+void ParticleHaloExchanger::keepOrigins(int id)
+{
+    if (!origins[id])
+        origins[id] = std::make_unique<DeviceBuffer<int>>();
+}
+
+DeviceBuffer<int>& ParticleHaloExchanger::getOrigins(int id)
+{
+    if (!origins[id])
+        die("The ids of the halo particles of '%s' are not kept", particles[id]->name.c_str());
+
+    return *origins[id];
+}
+
+PinnedBuffer<int>& ParticleHaloExchanger::getSendSizes(int id)
+{
+    return helpers[id]->sendSizes;
+}
+
+PinnedBuffer<int>& ParticleHaloExchanger::getSendOffsets(int id)
+{
+    return helpers[id]->sendOffsets;
+}
+
+CellList* ParticleHaloExchanger::getCellList(int id)
+{
+    return cellLists[id];
+}
+
+const int* ParticleHaloExchanger::getHaloSlots(int id) const
+{
+    if (!haloOrders[id]) return nullptr;
+    return haloOrders[id]->slots.devPtr();
+}
+
+/// resized to the send buffer, which must be sized already
+int* ParticleHaloExchanger::getOriginsPtr(int id)
+{
+    if (!origins[id]) return nullptr;
+
+    auto helper = helpers[id].get();
+    origins[id]->resize_anew(helper->sendOffsets[helper->nBuffers]);
+    return origins[id]->devPtr();
+}
+
+/**
+ * Grid of the compressed coordinates: the halo particles are packed
+ * in the frame of the receiver, so they are within one cell of its local domain.
+ * Two cells are kept as a margin for the particles not redistributed yet.
+ * All the ranks have the same local domain and cell-list, hence the same grid
+ */
+CompressedParticlePacker ParticleHaloExchanger::getCompressedPacker(int id, LocalParticleVector *lpv, cudaStream_t stream)
+{
+    auto cl = cellLists[id];
+
+    const float3 margin = 2.0f * cl->h;
+    const float3 lo     = -0.5f * cl->localDomainSize - margin;
+    const float3 step   = (cl->localDomainSize + 2.0f * margin) / 65535.0f;
+
+    return CompressedParticlePacker(particles[id], lpv, packPredicates[id], lo, step, stream);
 }
 
 void ParticleHaloExchanger::prepareSizes(int id, cudaStream_t stream)
@@ -152,7 +275,48 @@ void ParticleHaloExchanger::prepareSizes(int id, cudaStream_t stream)
     // LocalParticleVector *lpv = pv->local();
     
     helper->sendSizes.clear(stream);
-    ParticlePacker packer(pv, lpv, packPredicates[id], stream);
+    packedAhead[id] = false;
+
+    if (compression)
+        countHalos(id, getCompressedPacker(id, lpv, stream), stream);
+    else
+        countHalos(id, ParticlePacker(pv, lpv, packPredicates[id], stream), stream);
+
+    // the engines size all the due exchanges before using any size
+    bool lastDue = true;
+    for (int i = id+1; i < (int) particles.size(); i++)
+        if (needExchange(i)) lastDue = false;
+
+    if (lastDue) flushSizes(stream);
+}
+
+/// one synchronization for the sizes of all the counted helpers instead of one each
+void ParticleHaloExchanger::flushSizes(cudaStream_t stream)
+{
+    if (sizesPending.empty()) return;
+
+    sizesMailbox.post(stream);
+    sizesMailbox.wait();
+
+    for (auto id : sizesPending)
+    {
+        auto helper = helpers[id].get();
+
+        std::copy_n(sizesMailbox.hostPtr<int>(sizesSlots[id]), helper->nBuffers, helper->sendSizes.hostPtr());
+        helper->computeSendOffsets();
+        helper->sendOffsets.uploadToDevice(stream);
+    }
+
+    sizesPending.clear();
+}
+
+template <class Packer>
+void ParticleHaloExchanger::countHalos(int id, const Packer& packer, cudaStream_t stream)
+{
+    auto cl = cellLists[id];
+    auto helper = helpers[id].get();
+
+    LocalParticleVector *lpv = cl->getLocalParticleVector();
     helper->setDatumSize(packer.packedSize_byte);
 
     if (lpv->size() > 0)
@@ -162,15 +326,66 @@ void ParticleHaloExchanger::prepareSizes(int id, cudaStream_t stream)
         const int nthreads = 64;
         const dim3 nblocks = dim3(getNblocks(maxdim*maxdim, nthreads), 6, 1);
 
+        if (speculativePacking)
+        {
+            packSpeculatively(id, packer, nblocks, nthreads, stream);
+            return;
+        }
+
         SAFE_KERNEL_LAUNCH(
                 getHalos<PackMode::Query>,
                 nblocks, nthreads, 0, stream,
-                cl->cellInfo(), packer, helper->wrapSendData() );
+                cl->cellInfo(), packer, helper->wrapSendData(), nullptr );
 
-        helper->computeSendOffsets_Dev2Dev(stream);
+        sizesMailbox.collect(sizesSlots[id], helper->sendSizes.devPtr(), helper->nBuffers);
+        sizesPending.push_back(id);
     }
 }
 
+template <class Packer>
+void ParticleHaloExchanger::packSpeculatively(int id, const Packer& packer, dim3 nblocks, int nthreads, cudaStream_t stream)
+{
+    auto pv = particles[id];
+    auto cl = cellLists[id];
+    auto helper = helpers[id].get();
+    auto& capacities = slotCapacities[id];
+
+    const int nBuffers = helper->nBuffers;
+
+    helper->sendOffsets[0] = 0;
+    for (int i = 0; i < nBuffers; i++)
+        helper->sendOffsets[i+1] = helper->sendOffsets[i] + capacities[i];
+    helper->sendOffsets.uploadToDevice(stream);
+
+    helper->resizeSendBuf();
+
+    SAFE_KERNEL_LAUNCH(
+            getHalos<PackMode::Pack>,
+            nblocks, nthreads, 0, stream,
+            cl->cellInfo(), packer, helper->wrapSendData(), getOriginsPtr(id) );
+
+    helper->sendSizes.downloadFromDevice(stream);
+
+    bool fits = true;
+    for (int i = 0; i < nBuffers; i++)
+        if (helper->sendSizes[i] > capacities[i])
+        {
+            fits = false;
+            capacities[i] = conservativeCapacity(helper->sendSizes[i]);
+        }
+
+    if (fits)
+    {
+        packedAhead[id] = true;
+        return;
+    }
+
+    debug("Halo of '%s' overflowed the preallocated slots, packing again", pv->name.c_str());
+
+    helper->computeSendOffsets();
+    helper->sendOffsets.uploadToDevice(stream);
+}
+
 void ParticleHaloExchanger::prepareData(int id, cudaStream_t stream)
 {
     auto pv = particles[id];
@@ -183,21 +398,33 @@ void ParticleHaloExchanger::prepareData(int id, cudaStream_t stream)
     LocalParticleVector *lpv = cl->getLocalParticleVector();
     // LocalParticleVector *lpv = pv->local();
 
+    if (packedAhead[id]) return;
+
     if (lpv->size() > 0)
     {
-        const int maxdim = std::max({cl->ncells.x, cl->ncells.y, cl->ncells.z});
-        const int nthreads = 64;
-        const dim3 nblocks = dim3(getNblocks(maxdim*maxdim, nthreads), 6, 1);
+        if (compression)
+            packHalos(id, getCompressedPacker(id, lpv, stream), stream);
+        else
+            packHalos(id, ParticlePacker(pv, lpv, packPredicates[id], stream), stream);
+    }
+}
 
-        ParticlePacker packer(pv, lpv, packPredicates[id], stream);
+template <class Packer>
+void ParticleHaloExchanger::packHalos(int id, const Packer& packer, cudaStream_t stream)
+{
+    auto cl = cellLists[id];
+    auto helper = helpers[id].get();
 
-        helper->resizeSendBuf();
-        helper->sendSizes.clearDevice(stream);
-        SAFE_KERNEL_LAUNCH(
-                getHalos<PackMode::Pack>,
-                nblocks, nthreads, 0, stream,
-                cl->cellInfo(), packer, helper->wrapSendData() );
-    }
+    const int maxdim = std::max({cl->ncells.x, cl->ncells.y, cl->ncells.z});
+    const int nthreads = 64;
+    const dim3 nblocks = dim3(getNblocks(maxdim*maxdim, nthreads), 6, 1);
+
+    helper->resizeSendBuf();
+    helper->sendSizes.clearDevice(stream);
+    SAFE_KERNEL_LAUNCH(
+            getHalos<PackMode::Pack>,
+            nblocks, nthreads, 0, stream,
+            cl->cellInfo(), packer, helper->wrapSendData(), getOriginsPtr(id) );
 }
 
 void ParticleHaloExchanger::combineAndUploadData(int id, cudaStream_t stream)
@@ -210,8 +437,23 @@ void ParticleHaloExchanger::combineAndUploadData(int id, cudaStream_t stream)
 
     debug2("received %d particles from halo exchange", totalRecvd);
 
-    ParticlePacker packer(pv, pv->halo(), packPredicates[id], stream);
-    
+    if (compression)
+        unpackHalos(id, getCompressedPacker(id, pv->halo(), stream), stream);
+    else
+        unpackHalos(id, ParticlePacker(pv, pv->halo(), packPredicates[id], stream), stream);
+
+    pv->haloValid = true;
+}
+
+/**
+ * The compressed records are decoded straight into the halo, in the same pass as the extra channels
+ */
+template <class Packer>
+void ParticleHaloExchanger::unpackHalos(int id, const Packer& packer, cudaStream_t stream)
+{
+    auto helper = helpers[id].get();
+    int totalRecvd = helper->recvOffsets[helper->nBuffers];
+
     const int nthreads = 128;
 
     SAFE_KERNEL_LAUNCH(
@@ -219,7 +461,57 @@ void ParticleHaloExchanger::combineAndUploadData(int id, cudaStream_t stream)
             getNblocks(totalRecvd, nthreads), nthreads, 0, stream,
             packer, helper->recvBuf.devPtr(), totalRecvd );
 
-    pv->haloValid = true;
+    if (!haloOrders[id] || totalRecvd == 0) return;
+
+    sortHalo(id, stream);
+
+    SAFE_KERNEL_LAUNCH(
+            unpackParticlesToSlots,
+            getNblocks(totalRecvd, nthreads), nthreads, 0, stream,
+            packer, helper->recvBuf.devPtr(), totalRecvd, haloOrders[id]->slots.devPtr() );
+}
+
+/**
+ * Sort the ids of the halo particles, unpacked in the received order, by their cell keys
+ * and invert the sorted ids into the slots
+ */
+void ParticleHaloExchanger::sortHalo(int id, cudaStream_t stream)
+{
+    auto pv = particles[id];
+    auto cl = cellLists[id];
+    auto& order = *haloOrders[id];
+
+    const int n = pv->halo()->size();
+
+    debug2("Sorting %d halo particles of '%s' by cell", n, pv->name.c_str());
+
+    order.keys      .resize_anew(n);
+    order.sortedKeys.resize_anew(n);
+    order.ids       .resize_anew(n);
+    order.sortedIds .resize_anew(n);
+    order.slots     .resize_anew(n);
+
+    const int nthreads = 128;
+    SAFE_KERNEL_LAUNCH(
+            computeHaloKeys,
+            getNblocks(n, nthreads), nthreads, 0, stream,
+            (const float4*) pv->halo()->coosvels.devPtr(), n, cl->cellInfo(),
+            order.keys.devPtr(), order.ids.devPtr() );
+
+    int nbits = 1;
+    while ((1 << nbits) < cl->totcells) nbits++;
+
+    size_t bufSize = 0;
+    cub::DeviceRadixSort::SortPairs(nullptr, bufSize, order.keys.devPtr(), order.sortedKeys.devPtr(),
+                                    order.ids.devPtr(), order.sortedIds.devPtr(), n, 0, nbits, stream);
+    order.sortBuffer.resize_anew(bufSize);
+    cub::DeviceRadixSort::SortPairs(order.sortBuffer.devPtr(), bufSize, order.keys.devPtr(), order.sortedKeys.devPtr(),
+                                    order.ids.devPtr(), order.sortedIds.devPtr(), n, 0, nbits, stream);
+
+    SAFE_KERNEL_LAUNCH(
+            computeHaloSlots,
+            getNblocks(n, nthreads), nthreads, 0, stream,
+            order.sortedIds.devPtr(), n, order.slots.devPtr() );
 }
 
 bool ParticleHaloExchanger::needExchange(int id)
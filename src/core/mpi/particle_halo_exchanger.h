@@ -3,10 +3,37 @@
 #include "exchanger_interfaces.h"
 
 #include <core/pvs/extra_data/packers.h>
+#include <core/utils/scalar_mailbox.h>
 
 class ParticleVector;
 class CellList;
 
+/**
+ * Exchange of the halo particles, found in the boundary cells of the cell-lists.
+ *
+ * With speculative packing, the particles are packed already in prepareSizes(),
+ * into per-fragment slots of the send buffer sized from the largest halos seen so far.
+ * Counting and packing then take one traversal of the cell-list and one synchronization
+ * instead of two; prepareData() only packs again if some fragment overflowed its slot.
+ * The send offsets are then the starts of the slots and are not contiguous,
+ * which the MPI engines support but SingleNodeEngine does not.
+ *
+ * With compression, coordinates and velocities of the halo particles are sent
+ * in 16 bytes instead of sizeof(Particle), see CompressedParticlePacker;
+ * the extra channels are sent as they are. This is lossy: coordinates are quantized
+ * with a spacing of about the local domain size / 65535, velocities are in half precision.
+ *
+ * The ids of the packed particles can be kept, such that the channels updated later
+ * are sent for the same halo in the same order, see ParticleHaloExtraExchanger.
+ *
+ * With sorted halos, the received particles are sorted by the cell of the local cell-list
+ * they are next to, such that the neighbouring threads of the halo interaction kernels
+ * go through the same cells. The records are unpacked once in the received order to get the keys,
+ * and once more to their sorted slots; the channels received later go to the same slots, see getHaloSlots().
+ *
+ * Without speculative packing, the fragment sizes of all the particle vectors exchanged together
+ * are gathered in one ScalarMailbox, and downloaded with one synchronization after the last of them is counted.
+ */
 class ParticleHaloExchanger : public ParticleExchanger
 {
 private:
@@ -14,14 +41,63 @@ private:
     std::vector<ParticleVector*> particles;
     std::vector<PackPredicate> packPredicates;
 
+    bool speculativePacking;
+    std::vector<std::vector<int>> slotCapacities; ///< per helper and fragment, in particles
+    std::vector<bool> packedAhead;                ///< prepareSizes() already packed all the data
+
+    bool compression;
+    bool sortedHalos;
+
+    ScalarMailbox sizesMailbox {"halo sizes"};
+    std::vector<int> sizesSlots;   ///< per helper
+    std::vector<int> sizesPending; ///< helpers counted since the last flushSizes()
+
+    /// cell keys and sort of the received halo, see sortHalo()
+    struct HaloOrder
+    {
+        DeviceBuffer<int> keys, sortedKeys, ids, sortedIds;
+        DeviceBuffer<int> slots;   ///< of the received particles in the sorted halo
+        DeviceBuffer<char> sortBuffer;
+    };
+    std::vector<std::unique_ptr<HaloOrder>> haloOrders; ///< per helper, nullptr if not sorted
+
+    std::vector<std::unique_ptr<DeviceBuffer<int>>> origins; ///< per helper, nullptr if not kept
+    int* getOriginsPtr(int id);
+
     void prepareSizes(int id, cudaStream_t stream) override;
     void prepareData (int id, cudaStream_t stream) override;
     void combineAndUploadData(int id, cudaStream_t stream) override;
     bool needExchange(int id) override;
 
+    void sortHalo(int id, cudaStream_t stream);
+    void flushSizes(cudaStream_t stream);
+
+    CompressedParticlePacker getCompressedPacker(int id, LocalParticleVector *lpv, cudaStream_t stream);
+
+    template <class Packer> void countHalos (int id, const Packer& packer, cudaStream_t stream);
+    template <class Packer> void packHalos  (int id, const Packer& packer, cudaStream_t stream);
+    template <class Packer> void unpackHalos(int id, const Packer& packer, cudaStream_t stream);
+    template <class Packer> void packSpeculatively(int id, const Packer& packer, dim3 nblocks, int nthreads, cudaStream_t stream);
+
 public:
 
+    ParticleHaloExchanger(bool speculativePacking = false, bool compression = false, bool sortedHalos = false);
     ~ParticleHaloExchanger();
     
     void attach(ParticleVector *pv, CellList *cl, const std::vector<std::string>& extraChannelNames);
+
+    /// id of the attached \p pv, -1 if it is not attached
+    int getId(const ParticleVector *pv) const;
+
+    /// keep the ids of the particles packed for \p id, see getOrigins()
+    void keepOrigins(int id);
+
+    /// ids in the local particle vector of the cell-list of the packed particles, laid out as the send buffer
+    DeviceBuffer<int>& getOrigins(int id);
+    PinnedBuffer<int>& getSendSizes  (int id);
+    PinnedBuffer<int>& getSendOffsets(int id);
+    CellList* getCellList(int id);
+
+    /// slot in the halo of every received particle, in the received order; nullptr if the halo is not sorted
+    const int* getHaloSlots(int id) const;
 };
@@ -0,0 +1,139 @@
+#include "particle_halo_extra_exchanger.h"
+#include "particle_halo_exchanger.h"
+#include "exchange_helpers.h"
+
+#include <core/celllist.h>
+#include <core/logger.h>
+#include <core/pvs/extra_data/packers.h>
+#include <core/pvs/particle_vector.h>
+#include <core/utils/cuda_common.h>
+#include <core/utils/kernel_launch.h>
+
+#include <algorithm>
+
+namespace ParticleHaloExtraExchangeKernels
+{
+/// one block row per fragment, the source particles are at the same place in the entangled buffer
+__global__ void pack(const ParticleExtraPacker packer, const int *origins, const int *entangledOffsets,
+                     BufferOffsetsSizesWrap dataWrap)
+{
+    const int bufId = blockIdx.y;
+    const int i = blockIdx.x * blockDim.x + threadIdx.x;
+    if (i >= dataWrap.sizes[bufId]) return;
+
+    const int srcId = origins[entangledOffsets[bufId] + i];
+    packer.pack(srcId, dataWrap.buffer + (dataWrap.offsets[bufId] + i) * packer.packedSize_byte);
+}
+
+/// to the slots of the particles in the halo if it was sorted by the entangled exchanger
+__global__ void unpack(const char *from, int n, ParticleExtraPacker packer, const int *slots)
+{
+    const int pid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (pid >= n) return;
+
+    packer.unpack(from + pid * packer.packedSize_byte, slots != nullptr ? slots[pid] : pid);
+}
+} // namespace ParticleHaloExtraExchangeKernels
+
+
+ParticleHaloExtraExchanger::ParticleHaloExtraExchanger(ParticleHaloExchanger *entangledHaloExchanger) :
+    entangledHaloExchanger(entangledHaloExchanger)
+{}
+
+ParticleHaloExtraExchanger::~ParticleHaloExtraExchanger() = default;
+
+void ParticleHaloExtraExchanger::attach(ParticleVector *pv, const std::vector<std::string>& extraChannelNames)
+{
+    const int entangledId = entangledHaloExchanger->getId(pv);
+    if (entangledId < 0)
+        die("Cannot exchange the extra channels of '%s': its halo particles are not exchanged", pv->name.c_str());
+
+    int id = particles.size();
+    particles.push_back(pv);
+    entangledIds.push_back(entangledId);
+    entangledHaloExchanger->keepOrigins(entangledId);
+
+    auto helper = std::make_unique<ExchangeHelper>(pv->name, id);
+    helpers.push_back(std::move(helper));
+
+    packPredicates.push_back([extraChannelNames](const ExtraDataManager::NamedChannelDesc& namedDesc) {
+        return std::find(extraChannelNames.begin(), extraChannelNames.end(), namedDesc.first) != extraChannelNames.end();
+    });
+
+    std::string msg_channels;
+    for (const auto& ch : extraChannelNames)
+        msg_channels += "'" + ch + "' ";
+
+    info("Particle halo extra exchanger takes pv '%s' with extra channels: %s", pv->name.c_str(), msg_channels.c_str());
+}
+
+bool ParticleHaloExtraExchanger::needExchange(int id)
+{
+    return !particles[id]->haloValid;
+}
+
+void ParticleHaloExtraExchanger::prepareSizes(int id, cudaStream_t stream)
+{
+    auto helper = helpers[id].get();
+    const auto& sizes = entangledHaloExchanger->getSendSizes(entangledIds[id]);
+
+    for (int i = 0; i < helper->nBuffers; ++i)
+        helper->sendSizes[i] = sizes[i];
+}
+
+void ParticleHaloExtraExchanger::prepareData(int id, cudaStream_t stream)
+{
+    auto pv = particles[id];
+    auto helper = helpers[id].get();
+    const int entangledId = entangledIds[id];
+    auto lpv = entangledHaloExchanger->getCellList(entangledId)->getLocalParticleVector();
+
+    ParticleExtraPacker packer(pv, lpv, packPredicates[id], stream);
+
+    helper->setDatumSize(packer.packedSize_byte);
+    helper->computeSendOffsets();
+    helper->sendSizes  .uploadToDevice(stream);
+    helper->sendOffsets.uploadToDevice(stream);
+    helper->resizeSendBuf();
+
+    const int maxSize = *std::max_element(helper->sendSizes.hostPtr(), helper->sendSizes.hostPtr() + helper->nBuffers);
+
+    debug2("Packing the extra channels of %d halo particles of '%s'",
+           helper->sendOffsets[helper->nBuffers], pv->name.c_str());
+
+    if (packer.packedSize_byte == 0 || maxSize == 0) return;
+
+    const int nthreads = 128;
+    const dim3 nblocks(getNblocks(maxSize, nthreads), helper->nBuffers);
+
+    SAFE_KERNEL_LAUNCH(
+            ParticleHaloExtraExchangeKernels::pack,
+            nblocks, nthreads, 0, stream,
+            packer, entangledHaloExchanger->getOrigins(entangledId).devPtr(),
+            entangledHaloExchanger->getSendOffsets(entangledId).devPtr(), helper->wrapSendData() );
+}
+
+void ParticleHaloExtraExchanger::combineAndUploadData(int id, cudaStream_t stream)
+{
+    auto pv = particles[id];
+    auto helper = helpers[id].get();
+
+    const int totalRecvd = helper->recvOffsets[helper->nBuffers];
+    if (totalRecvd != pv->halo()->size())
+        die("Received the extra channels of %d halo particles of '%s', but the halo has %d particles",
+            totalRecvd, pv->name.c_str(), pv->halo()->size());
+
+    ParticleExtraPacker packer(pv, pv->halo(), packPredicates[id], stream);
+
+    if (packer.packedSize_byte > 0 && totalRecvd > 0)
+    {
+        const int nthreads = 128;
+        SAFE_KERNEL_LAUNCH(
+                ParticleHaloExtraExchangeKernels::unpack,
+                getNblocks(totalRecvd, nthreads), nthreads, 0, stream,
+                helper->recvBuf.devPtr(), totalRecvd, packer,
+                entangledHaloExchanger->getHaloSlots(entangledIds[id]) );
+    }
+
+    pv->haloValid = true;
+}
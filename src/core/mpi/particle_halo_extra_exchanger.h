@@ -0,0 +1,40 @@
+#pragma once
+
+#include "exchanger_interfaces.h"
+
+#include <core/pvs/extra_data/packers.h>
+
+#include <string>
+#include <vector>
+
+class ParticleVector;
+class ParticleHaloExchanger;
+
+/**
+ * Exchange of extra channels only, for the halo particles already sent by another
+ * ParticleHaloExchanger, e.g. the channels computed by the intermediate interactions.
+ * The particles are those of the last exchange of the entangled exchanger, in the same order:
+ * the positions are not sent again and the received channels go right to the halo,
+ * at the slots of the particles if the entangled exchanger sorted the halo.
+ * The particles must not be moved or sorted again in between
+ */
+class ParticleHaloExtraExchanger : public ParticleExchanger
+{
+public:
+    ParticleHaloExtraExchanger(ParticleHaloExchanger *entangledHaloExchanger);
+    ~ParticleHaloExtraExchanger();
+
+    /// \p pv must be attached to the entangled exchanger
+    void attach(ParticleVector *pv, const std::vector<std::string>& extraChannelNames);
+
+private:
+    std::vector<ParticleVector*> particles;
+    std::vector<int> entangledIds;
+    ParticleHaloExchanger *entangledHaloExchanger;
+    std::vector<PackPredicate> packPredicates;
+
+    void prepareSizes(int id, cudaStream_t stream) override;
+    void prepareData (int id, cudaStream_t stream) override;
+    void combineAndUploadData(int id, cudaStream_t stream) override;
+    bool needExchange(int id) override;
+};
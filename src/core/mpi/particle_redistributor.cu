@@ -3,6 +3,7 @@
 #include "particle_redistributor.h"
 
 #include <core/celllist.h>
+#include <core/logger.h>
 #include <core/mpi/valid_cell.h>
 #include <core/pvs/extra_data/packers.h>
 #include <core/pvs/particle_vector.h>
@@ -10,6 +11,9 @@
 #include <core/utils/cuda_common.h>
 #include <core/utils/kernel_launch.h>
 
+#include <algorithm>
+#include <vector>
+
 enum class PackMode
 {
     Query, Pack
@@ -35,14 +39,14 @@ inline __device__ bool hasToLeave(int3 dir) {
 }
 
 template <PackMode packMode>
-__global__ void getExitingParticles(CellListInfo cinfo, PVview view, ParticlePacker packer, BufferOffsetsSizesWrap dataWrap)
+__device__ void exitingParticlesOfCell(int gid, int variant, const CellListInfo& cinfo, const PVview& view,
+                                       const ParticlePacker& packer, const BufferOffsetsSizesWrap& dataWrap)
 {
-    const int gid = blockIdx.x*blockDim.x + threadIdx.x;
     int cid;
     int dx, dy, dz;
     const int3 ncells = cinfo.ncells;
 
-    bool valid = isValidCell(cid, dx, dy, dz, gid, blockIdx.y, cinfo);
+    bool valid = isValidCell(cid, dx, dy, dz, gid, variant, cinfo);
 
     if (!valid) return;
 
@@ -89,6 +93,48 @@ __global__ void getExitingParticles(CellListInfo cinfo, PVview view, ParticlePac
     }
 }
 
+template <PackMode packMode>
+__global__ void getExitingParticles(CellListInfo cinfo, PVview view, ParticlePacker packer, BufferOffsetsSizesWrap dataWrap)
+{
+    const int gid = blockIdx.x*blockDim.x + threadIdx.x;
+    exitingParticlesOfCell<packMode>(gid, blockIdx.y, cinfo, view, packer, dataWrap);
+}
+
+// One particle vector per blockIdx.z
+template <PackMode packMode>
+__global__ void getExitingParticlesBatched(const ParticleRedistributor::BatchEntry *entries)
+{
+    const int gid = blockIdx.x*blockDim.x + threadIdx.x;
+    const auto& e = entries[blockIdx.z];
+    exitingParticlesOfCell<packMode>(gid, blockIdx.y, e.cinfo, e.view, e.packer, e.dataWrap);
+}
+
+/// set \p escaped if a particle of the boundary cells is more than \p margin outside of the subdomain
+__global__ void checkEscaped(CellListInfo cinfo, PVview view, float margin, int *escaped)
+{
+    const int gid = blockIdx.x*blockDim.x + threadIdx.x;
+
+    int cid, dx, dy, dz;
+    if (!isValidCell(cid, dx, dy, dz, gid, blockIdx.y, cinfo)) return;
+
+    const int pstart = cinfo.cellStarts[cid];
+    const int pend   = cinfo.cellStarts[cid+1];
+
+    for (int srcId = pstart; srcId < pend; srcId++)
+    {
+        Particle p;
+        p.readCoordinate(view.particles, srcId);
+        if (p.isMarked()) continue;
+
+        const float3 out = fabs(p.r) - 0.5f * cinfo.localDomainSize;
+        if (out.x > margin || out.y > margin || out.z > margin)
+        {
+            *escaped = 1;
+            return;
+        }
+    }
+}
+
 __global__ static void unpackParticles(ParticlePacker packer, int startDstId, char* buffer, int np)
 {
     const int pid = blockIdx.x*blockDim.x + threadIdx.x;
@@ -102,11 +148,121 @@ __global__ static void unpackParticles(ParticlePacker packer, int startDstId, ch
 // Member functions
 //===============================================================================================
 
+ParticleRedistributor::ParticleRedistributor(bool batched) :
+    batched(batched)
+{
+    batch.setOwner("exchange:redistribution:batch");
+}
+
 bool ParticleRedistributor::needExchange(int id)
 {
     return !particles[id]->redistValid;
 }
 
+int ParticleRedistributor::firstDue()
+{
+    for (int id = 0; id < particles.size(); id++)
+        if (needExchange(id)) return id;
+    return -1;
+}
+
+template <PackMode packMode>
+static void launchBatched(const std::vector<ParticleRedistributor::BatchEntry>& entries, int maxdim,
+                          PinnedBuffer<ParticleRedistributor::BatchEntry>& batch, cudaStream_t stream)
+{
+    if (entries.empty()) return;
+
+    batch.resize_anew(entries.size());
+    std::copy(entries.begin(), entries.end(), batch.begin());
+    batch.uploadToDevice(stream);
+
+    const int nthreads = 64;
+    const dim3 nblocks = dim3(getNblocks(maxdim*maxdim, nthreads), 6, entries.size());
+
+    SAFE_KERNEL_LAUNCH(
+            ParticleRedistributorKernels::getExitingParticlesBatched<packMode>,
+            nblocks, nthreads, 0, stream,
+            batch.devPtr() );
+}
+
+/**
+ * Count the leaving particles of all the particle vectors due this step at once:
+ * one kernel and one synchronization instead of one per particle vector
+ */
+void ParticleRedistributor::prepareSizesBatched(cudaStream_t stream)
+{
+    std::vector<BatchEntry> entries;
+    int maxdim = 0;
+
+    for (int id = 0; id < particles.size(); id++)
+    {
+        if (!needExchange(id)) continue;
+
+        auto pv = particles[id];
+        auto cl = cellLists[id];
+        auto helper = helpers[id].get();
+
+        helper->sendSizes.clear(stream);
+
+        auto packer = ParticlePacker(pv, pv->local(), packPredicates[id], stream);
+        helper->setDatumSize(packer.packedSize_byte);
+
+        if (pv->local()->size() > 0)
+        {
+            entries.push_back({cl->cellInfo(), cl->getView<PVview>(), packer, helper->wrapSendData()});
+            maxdim = std::max({maxdim, cl->ncells.x, cl->ncells.y, cl->ncells.z});
+        }
+    }
+
+    debug2("Counting leaving particles of %d particle vectors at once", (int) entries.size());
+
+    launchBatched<PackMode::Query>(entries, maxdim, batch, stream);
+
+    for (int id = 0; id < particles.size(); id++)
+        if (needExchange(id))
+            mailbox.collect(sizesSlots[id], helpers[id]->sendSizes.devPtr(), helpers[id]->nBuffers);
+
+    mailbox.post(stream);
+    mailbox.wait();
+
+    for (int id = 0; id < particles.size(); id++)
+        if (needExchange(id))
+        {
+            auto helper = helpers[id].get();
+
+            std::copy_n(mailbox.hostPtr<int>(sizesSlots[id]), helper->nBuffers, helper->sendSizes.hostPtr());
+            helper->computeSendOffsets();
+            helper->sendOffsets.uploadToDevice(stream);
+        }
+}
+
+void ParticleRedistributor::prepareDataBatched(cudaStream_t stream)
+{
+    std::vector<BatchEntry> entries;
+    int maxdim = 0;
+
+    for (int id = 0; id < particles.size(); id++)
+    {
+        if (!needExchange(id)) continue;
+
+        auto pv = particles[id];
+        auto cl = cellLists[id];
+        auto helper = helpers[id].get();
+
+        if (pv->local()->size() == 0) continue;
+
+        helper->resizeSendBuf();
+        // Sizes will still remain on host, no need to download again
+        helper->sendSizes.clearDevice(stream);
+
+        auto packer = ParticlePacker(pv, pv->local(), packPredicates[id], stream);
+        entries.push_back({cl->cellInfo(), cl->getView<PVview>(), packer, helper->wrapSendData()});
+        maxdim = std::max({maxdim, cl->ncells.x, cl->ncells.y, cl->ncells.z});
+    }
+
+    launchBatched<PackMode::Pack>(entries, maxdim, batch, stream);
+}
+
 void ParticleRedistributor::attach(ParticleVector *pv, CellList *cl)
 {
     int id = particles.size();
@@ -120,6 +276,8 @@ void ParticleRedistributor::attach(ParticleVector *pv, CellList *cl)
     helper->setDatumSize(sizeof(Particle));
     
     helpers.push_back(std::move(helper));
+    sizesSlots  .push_back(mailbox.add<int>(FragmentMapping::numFragments));
+    escapedSlots.push_back(mailbox.add<int>());
 
     packPredicates.push_back([](const ExtraDataManager::NamedChannelDesc& namedDesc) {
         return namedDesc.second->persistence == ExtraDataManager::PersistenceMode::Persistent;
@@ -128,8 +286,71 @@ void ParticleRedistributor::attach(ParticleVector *pv, CellList *cl)
     info("Particle redistributor takes pv '%s'", pv->name.c_str());
 }
 
+void ParticleRedistributor::setSkin(float skin)
+{
+    this->skin = skin;
+}
+
+void ParticleRedistributor::deferIfInside(MPI_Comm comm, cudaStream_t stream)
+{
+    const int n = particles.size();
+    escaped.resize_anew(n);
+    escaped.clear(stream);
+
+    for (int id = 0; id < n; id++)
+    {
+        if (!needExchange(id)) continue;
+
+        auto pv = particles[id];
+        auto cl = cellLists[id];
+
+        if (pv->local()->size() == 0) continue;
+
+        const int maxdim = std::max({cl->ncells.x, cl->ncells.y, cl->ncells.z});
+        const int nthreads = 64;
+        const dim3 nblocks = dim3(getNblocks(maxdim*maxdim, nthreads), 6, 1);
+
+        SAFE_KERNEL_LAUNCH(
+                ParticleRedistributorKernels::checkEscaped,
+                nblocks, nthreads, 0, stream,
+                cl->cellInfo(), cl->getView<PVview>(), 0.5f * skin, escaped.devPtr() + id );
+    }
+
+    for (int id = 0; id < n; id++)
+        mailbox.collect(escapedSlots[id], escaped.devPtr() + id);
+
+    mailbox.post(stream);
+    mailbox.wait();
+
+    // a particle vector that is not due anywhere is never exchanged, whatever its flag says
+    std::vector<int> due(2*n);
+    for (int id = 0; id < n; id++)
+    {
+        due[2*id + 0] = needExchange(id);
+        due[2*id + 1] = *mailbox.hostPtr<int>(escapedSlots[id]);
+    }
+
+    MPI_Check( MPI_Allreduce(MPI_IN_PLACE, due.data(), due.size(), MPI_INT, MPI_MAX, comm) );
+
+    for (int id = 0; id < n; id++)
+    {
+        if (!due[2*id + 0] || due[2*id + 1]) continue;
+
+        particles[id]->redistValid = true;
+        nDeferred++;
+        debug2("Redistribution of '%s' is deferred, %d times so far", particles[id]->name.c_str(), nDeferred);
+    }
+}
+
 void ParticleRedistributor::prepareSizes(int id, cudaStream_t stream)
 {
+    // everything is done together with the first particle vector
+    if (batched)
+    {
+        if (id == firstDue()) prepareSizesBatched(stream);
+        return;
+    }
+
     auto pv = particles[id];
     auto cl = cellLists[id];
     auto helper = helpers[id].get();
@@ -158,6 +379,12 @@ void ParticleRedistributor::prepareSizes(int id, cudaStream_t stream)
 
 void ParticleRedistributor::prepareData(int id, cudaStream_t stream)
 {
+    if (batched)
+    {
+        if (id == firstDue()) prepareDataBatched(stream);
+        return;
+    }
+
     auto pv = particles[id];
     auto cl = cellLists[id];
     auto helper = helpers[id].get();
@@ -1,27 +1,81 @@
 #pragma once
 
 #include "exchanger_interfaces.h"
+#include "exchange_helpers.h"
 
+#include <core/celllist.h>
+#include <core/containers.h>
 #include <core/pvs/extra_data/packers.h>
+#include <core/pvs/views/pv.h>
+#include <core/utils/scalar_mailbox.h>
+
+#include <mpi.h>
 
 class ParticleVector;
-class CellList;
 
+/**
+ * Exchange of the particles that left the subdomain.
+ *
+ * In batched mode, the leaving particles of all the particle vectors due this step
+ * are counted by a single kernel, and packed by another single kernel. Their sizes are gathered
+ * in one ScalarMailbox and downloaded with one synchronization.
+ * Together with AggregatedMPIExchangeEngine this gives one message per neighbour.
+ *
+ * With a positive skin, the redistribution is deferred: the particles may stay up to skin/2
+ * outside of the subdomain, see deferIfInside(). The cell-lists then need cells larger
+ * than the cut-offs by skin/2, such that the halos still cover these particles.
+ */
 class ParticleRedistributor : public ParticleExchanger
 {
+public:
+    /// everything the kernel needs about one particle vector in batched mode
+    struct BatchEntry
+    {
+        CellListInfo cinfo;
+        PVview view;
+        ParticlePacker packer;
+        BufferOffsetsSizesWrap dataWrap;
+    };
+
 private:
     std::vector<ParticleVector*> particles;
     std::vector<CellList*> cellLists;
     std::vector<PackPredicate> packPredicates;
 
+    bool batched;
+    PinnedBuffer<BatchEntry> batch;
+
+    ScalarMailbox mailbox {"redistribution"};
+    std::vector<int> sizesSlots, escapedSlots;   ///< per particle vector
+
+    float skin {0.0f};
+    DeviceBuffer<int> escaped;  ///< per particle vector, whether a particle is further than skin/2 outside
+    int nDeferred {0};
+
+    int firstDue();
+    void prepareSizesBatched(cudaStream_t stream);
+    void prepareDataBatched (cudaStream_t stream);
+
     void prepareSizes(int id, cudaStream_t stream) override;
     void prepareData (int id, cudaStream_t stream) override;
     void combineAndUploadData(int id, cudaStream_t stream) override;
     bool needExchange(int id) override;
 
 public:
+    ParticleRedistributor(bool batched = false);
+
     void _prepareData(int id);
     void attach(ParticleVector* pv, CellList* cl);
 
+    void setSkin(float skin);
+
+    /**
+     * Mark the particle vectors due for redistribution that have no particle further than skin/2
+     * outside of the subdomain as redistributed, such that they are skipped until then.
+     * Checks the boundary cells on the device, then takes the same decision on all the ranks of
+     * \p comm with one reduction: the exchange engines expect the neighbours to agree. Synchronizes \p stream
+     */
+    void deferIfInside(MPI_Comm comm, cudaStream_t stream);
+
     ~ParticleRedistributor() = default;
 };
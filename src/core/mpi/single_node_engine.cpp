@@ -34,6 +34,14 @@ void SingleNodeEngine::finalize(cudaStream_t stream)
         
     for (int i = 0; i < helpers.size(); ++i)
         if (exchanger->needExchange(i)) exchanger->combineAndUploadData(i, stream);
+
+    for (auto& helper : helpers)
+        helper->releaseStaging(stream);
+}
+
+std::vector<GPUcontainer*> SingleNodeEngine::getContainers()
+{
+    return exchanger->getContainers();
 }
 
 
@@ -17,6 +17,8 @@ public:
     SingleNodeEngine(std::unique_ptr<ParticleExchanger> exchanger);
     void init(cudaStream_t stream)     override;
     void finalize(cudaStream_t stream) override;
+
+    std::vector<GPUcontainer*> getContainers() override;
     
     ~SingleNodeEngine() = default;
 
@@ -0,0 +1,175 @@
+#include "staging_pool.h"
+
+#include <core/logger.h>
+#include <core/utils/memory_pool.h>
+
+#include <algorithm>
+#include <cstring>
+
+StagingPool& StagingPool::get()
+{
+    // never destroyed, as the memory pools
+    static StagingPool *pool = new StagingPool();
+    return *pool;
+}
+
+StagingPool::Block* StagingPool::acquire(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    Block *best = nullptr, *largest = nullptr;
+
+    for (auto& b : blocks)
+    {
+        if (b->inUse) continue;
+
+        if (b->capacity >= bytes && (best == nullptr || b->capacity < best->capacity))
+            best = b.get();
+
+        if (largest == nullptr || b->capacity > largest->capacity)
+            largest = b.get();
+    }
+
+    if (best == nullptr)
+    {
+        if (largest == nullptr)
+        {
+            blocks.push_back(std::make_unique<Block>());
+            largest = blocks.back().get();
+            CUDA_Check( cudaEventCreateWithFlags(&largest->released, cudaEventDisableTiming) );
+        }
+
+        grow(largest, bytes);
+        best = largest;
+    }
+    else
+    {
+        // the previous holder may still copy from or to it
+        CUDA_Check( cudaEventSynchronize(best->released) );
+    }
+
+    best->inUse = true;
+    return best;
+}
+
+void StagingPool::release(Block *block, cudaStream_t stream)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    CUDA_Check( cudaEventRecord(block->released, stream) );
+    block->inUse = false;
+}
+
+size_t StagingPool::getPinnedBytes() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return pinnedBytes;
+}
+
+void StagingPool::grow(Block *block, size_t bytes)
+{
+    // the old memory is only reused by the memory pool once the device is idle
+    MemoryPool::host().deallocate(block->ptr);
+    pinnedBytes -= block->capacity;
+
+    block->capacity = conservativeCapacity((int) bytes);
+    block->ptr = (char*) MemoryPool::host().allocate(block->capacity, "exchange:staging");
+    pinnedBytes += block->capacity;
+
+    debug("Staging pool: grew a block to %zu bytes, %d blocks of %.2f MB in total",
+          block->capacity, (int) blocks.size(), pinnedBytes / (1024.0 * 1024.0));
+}
+
+
+StagedBuffer::StagedBuffer(StagedBuffer&& b)
+{
+    *this = std::move(b);
+}
+
+StagedBuffer& StagedBuffer::operator=(StagedBuffer&& b)
+{
+    if (this != &b)
+    {
+        dropStaging();
+
+        device     = std::move(b.device);
+        staging    = b.staging;
+        lastStream = b.lastStream;
+        owner      = b.owner;
+
+        b.staging = nullptr;
+    }
+
+    return *this;
+}
+
+StagedBuffer::~StagedBuffer()
+{
+    dropStaging();
+}
+
+void StagedBuffer::resize(const int n, cudaStream_t stream)
+{
+    const int oldSize = size();
+    device.resize(n, stream);
+
+    if (staging == nullptr || staging->capacity >= (size_t) n) return;
+
+    auto bigger = StagingPool::get().acquire(n);
+    memcpy(bigger->ptr, staging->ptr, oldSize);
+    dropStaging();
+    staging = bigger;
+}
+
+void StagedBuffer::resize_anew(const int n)
+{
+    device.resize_anew(n);
+
+    if (staging != nullptr && staging->capacity < (size_t) n)
+        dropStaging();
+}
+
+void StagedBuffer::setOwner(const std::string& name)
+{
+    GPUcontainer::setOwner(name);
+    device.setOwner(name);
+}
+
+char* StagedBuffer::hostPtr()
+{
+    if (staging == nullptr)
+        staging = StagingPool::get().acquire(size());
+
+    return staging->ptr;
+}
+
+void StagedBuffer::downloadFromDevice(cudaStream_t stream, ContainersSynch synch)
+{
+    debug4("GPU -> CPU (D2H) transfer of staged buffer '%s', size %d", owner.c_str(), size());
+
+    lastStream = stream;
+    if (size() > 0) CUDA_Check( cudaMemcpyAsync(hostPtr(), devPtr(), size(), cudaMemcpyDeviceToHost, stream) );
+    if (synch == ContainersSynch::Synch) CUDA_Check( cudaStreamSynchronize(stream) );
+}
+
+void StagedBuffer::uploadToDevice(cudaStream_t stream)
+{
+    debug4("CPU -> GPU (H2D) transfer of staged buffer '%s', size %d", owner.c_str(), size());
+
+    lastStream = stream;
+    if (size() > 0) CUDA_Check( cudaMemcpyAsync(devPtr(), hostPtr(), size(), cudaMemcpyHostToDevice, stream) );
+}
+
+void StagedBuffer::releaseStaging(cudaStream_t stream)
+{
+    lastStream = stream;
+    dropStaging();
+}
+
+void StagedBuffer::dropStaging()
+{
+    if (staging == nullptr) return;
+
+    StagingPool::get().release(staging, lastStream);
+    staging = nullptr;
+}
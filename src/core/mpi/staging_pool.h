@@ -0,0 +1,113 @@
+#pragma once
+
+#include <core/containers.h>
+
+#include <cuda_runtime.h>
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Pinned host memory through which the exchange engines stage the messages, shared by all the exchangers of the rank.
+ *
+ * A StagedBuffer only holds a block of the pool from its first host access in an exchange until the end
+ * of that exchange, see StagedBuffer::releaseStaging(). The exchanges that are never in flight together,
+ * e.g. the redistributions, the halo exchanges and the reverse exchanges of the different task phases,
+ * thus take turns on the same blocks: the pinned footprint is the one of the exchanges in flight at the same time
+ * instead of the sum of the largest messages every exchanger ever had, and no buffer is pinned with GPU-aware MPI.
+ *
+ * Blocks are only allocated (and registered by CUDA) when no free block is large enough, the largest free block
+ * is then replaced by a bigger one, and they are never returned. A released block is handed out again
+ * once the device is done with the copies issued before its release
+ */
+class StagingPool
+{
+public:
+    struct Block
+    {
+        char *ptr {nullptr};
+        size_t capacity {0};
+        bool inUse {false};
+        cudaEvent_t released;   ///< recorded at the release, after the copies from or to the block
+    };
+
+    static StagingPool& get();
+
+    /// a free block of at least \p bytes, ready to be written on the host
+    Block* acquire(size_t bytes);
+
+    /// give back \p block, the copies issued on \p stream before may still use it
+    void release(Block *block, cudaStream_t stream);
+
+    /// total pinned memory of the blocks
+    size_t getPinnedBytes() const;
+
+private:
+    StagingPool() = default;
+
+    std::vector<std::unique_ptr<Block>> blocks;
+    size_t pinnedBytes {0};
+
+    mutable std::mutex mutex;
+
+    void grow(Block *block, size_t bytes);
+};
+
+/**
+ * Device buffer of bytes, whose host copy comes from the StagingPool only while it is needed:
+ * from the first host access (hostPtr(), downloadFromDevice(), uploadToDevice()) until releaseStaging().
+ * The host data and pointers are lost with the release, or by a resize beyond the block
+ */
+class StagedBuffer : public GPUcontainer
+{
+public:
+    StagedBuffer() = default;
+
+    /// To enable \c std::swap()
+    StagedBuffer(StagedBuffer&& b);
+    StagedBuffer& operator=(StagedBuffer&& b);
+
+    ~StagedBuffer();
+
+    int datatype_size() const final { return sizeof(char); }
+    int size()          const final { return device.size(); }
+    int getCapacity()   const final { return device.getCapacity(); }
+
+    void* genericDevPtr() const final { return (void*) devPtr(); }
+
+    void resize     (const int n, cudaStream_t stream) final;
+    void resize_anew(const int n)                      final;
+
+    GPUcontainer* produce() const final { return new StagedBuffer(); }
+
+    void clearDevice(cudaStream_t stream) final { device.clearDevice(stream); }
+
+    /// Only the device data, the host copy belongs to the pool
+    void shrink(cudaStream_t stream) final { device.shrink(stream); }
+
+    void setOwner(const std::string& name) final;
+
+    char* devPtr() const { return device.devPtr(); }
+
+    /// @return the host copy, taken from the pool if not held yet
+    char* hostPtr();
+
+    /// Copy data from device to host, see PinnedBuffer::downloadFromDevice()
+    void downloadFromDevice(cudaStream_t stream, ContainersSynch synch = ContainersSynch::Synch);
+
+    /// Copy data from host to device
+    void uploadToDevice(cudaStream_t stream);
+
+    /// give the host copy back to the pool once the copies issued on \p stream are done
+    void releaseStaging(cudaStream_t stream);
+
+private:
+    DeviceBuffer<char> device;
+    StagingPool::Block *staging {nullptr};
+    cudaStream_t lastStream {0};   ///< of the last copy through the host copy
+
+    void dropStaging();
+};
@@ -0,0 +1,69 @@
+#include "transport_tuner.h"
+
+#include <core/logger.h>
+
+TransportTuner::TransportTuner(int warmup, int period) :
+    warmup(warmup),
+    period(period)
+{
+    if (warmup < 1 || period <= 2 * warmup)
+        die("Transport tuning needs a positive warmup shorter than half the period, got %d and %d", warmup, period);
+}
+
+int TransportTuner::getClass(int bytes, bool intraNode)
+{
+    int sizeClass = 0;
+    for (int limit = 4096; sizeClass < nSizeClasses - 1 && bytes >= limit; limit *= 16)
+        sizeClass++;
+
+    return sizeClass + (intraNode ? nSizeClasses : 0);
+}
+
+bool TransportTuner::exploring() const
+{
+    return exchange < 2 * warmup;
+}
+
+bool TransportTuner::staged(int cls) const
+{
+    if (exploring()) return exchange % 2 == 1;
+    return stats[cls].staged;
+}
+
+void TransportTuner::record(int cls, bool staged, double ms)
+{
+    if (!exploring()) return;
+
+    stats[cls].time [staged] += ms;
+    stats[cls].count[staged] ++;
+}
+
+void TransportTuner::decide()
+{
+    for (int cls = 0; cls < nClasses; cls++)
+    {
+        auto& s = stats[cls];
+
+        if (s.count[0] > 0 && s.count[1] > 0)
+        {
+            const double direct = s.time[0] / s.count[0];
+            const double staged = s.time[1] / s.count[1];
+            s.staged = staged < direct;
+
+            debug("Transport of the %s messages of class %d: direct %f ms, staged %f ms, choosing %s",
+                  cls >= nSizeClasses ? "intra-node" : "inter-node", cls % nSizeClasses,
+                  direct, staged, s.staged ? "staged" : "direct");
+        }
+
+        s.time [0] = s.time [1] = 0.0;
+        s.count[0] = s.count[1] = 0;
+    }
+}
+
+void TransportTuner::nextExchange()
+{
+    exchange++;
+
+    if (exchange == 2 * warmup) decide();
+    if (exchange == period)     exchange = 0;
+}
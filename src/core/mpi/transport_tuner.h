@@ -0,0 +1,45 @@
+#pragma once
+
+/**
+ * Chooses, per class of messages, between sending them straight from the GPU buffers
+ * (GPU-aware MPI) or staging them through the host buffers.
+ *
+ * A class is a range of message sizes and whether the neighbour is on the same node.
+ * Every \c period exchanges, the first 2 * \c warmup ones alternate between the two transports
+ * and record the latency of each message; each class then uses the fastest transport on average
+ * until the next evaluation. Classes without samples of both transports keep their choice
+ */
+class TransportTuner
+{
+public:
+    TransportTuner(int warmup = 5, int period = 1000);
+
+    static int getClass(int bytes, bool intraNode);
+
+    /// whether the messages of class \p cls are staged through the host in the current exchange
+    bool staged(int cls) const;
+
+    void record(int cls, bool staged, double ms);
+
+    /// to be called once every exchange is complete
+    void nextExchange();
+
+    static const int nSizeClasses = 4;  ///< below 4 KB, 64 KB, 1 MB and larger
+    static const int nClasses = 2 * nSizeClasses;
+
+private:
+    struct Stats
+    {
+        double time[2] {0.0, 0.0};      ///< sum of the latencies, direct and staged
+        int   count[2] {0, 0};
+        bool staged {false};
+    };
+
+    Stats stats[nClasses];
+
+    int warmup, period;
+    int exchange {0};                   ///< within the current period
+
+    bool exploring() const;
+    void decide();
+};
@@ -1,64 +1,70 @@
 #include "ellipsoid_belonging.h"
 
 #include <core/utils/kernel_launch.h>
+#include <core/utils/make_unique.h>
 #include <core/pvs/particle_vector.h>
 #include <core/pvs/rigid_ellipsoid_object_vector.h>
 #include <core/pvs/views/reov.h>
 #include <core/celllist.h>
 
+#include <core/rigid_kernels/ellipsoid_shell->h>
 #include <core/rigid_kernels/quaternion.h>
 #include <core/rigid_kernels/rigid_motion.h>
 
 
-__device__ inline float ellipsoidF(const float3 r, const float3 invAxes)
-{
-    return sqr(r.x * invAxes.x) + sqr(r.y * invAxes.y) + sqr(r.z * invAxes.z) - 1.0f;
-}
-
-__global__ void insideEllipsoid(REOVview reView, CellListInfo cinfo, PVview pvView, BelongingTags* tags)
+/**
+ * One thread per candidate cell of EllipsoidShell:
+ * the particles of the cells fully inside are tagged directly,
+ * the particles of the shell cells are checked against the analytic shape
+ */
+__global__ void insideEllipsoid(REOVview reView, int nCells, const ShellCell *cells,
+                                CellListInfo cinfo, PVview pvView, BelongingTags* tags)
 {
     const float tolerance = 5e-6f;
 
-    const int objId = blockIdx.x;
-    const int tid = threadIdx.x;
-    if (objId >= reView.nObjects) return;
+    const int gid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (gid >= nCells) return;
 
-    const int3 cidLow  = cinfo.getCellIdAlongAxes<CellListsProjection::Clamp>(reView.comAndExtents[objId].low  - 1.5f);
-    const int3 cidHigh = cinfo.getCellIdAlongAxes<CellListsProjection::Clamp>(reView.comAndExtents[objId].high + 2.5f);
+    const auto cell = cells[gid];
 
-    const int3 span = cidHigh - cidLow + make_int3(1,1,1);
-    const int totCells = span.x * span.y * span.z;
+    int pstart = cinfo.cellStarts[cell.cellId];
+    int pend   = cinfo.cellStarts[cell.cellId+1];
 
-    for (int i = tid; i < totCells; i += blockDim.x)
+    if (cell.inside)
     {
-        const int3 cid3 = make_int3( i % span.x, (i/span.x) % span.y, i / (span.x*span.y) ) + cidLow;
-        const int  cid = cinfo.encode(cid3);
-        if (cid >= cinfo.totcells) continue;
+        for (int pid = pstart; pid < pend; pid++)
+            tags[pid] = BelongingTags::Inside;
+        return;
+    }
 
-        int pstart = cinfo.cellStarts[cid];
-        int pend   = cinfo.cellStarts[cid+1];
+    auto motion = toSingleMotion(reView.motions[cell.objId]);
 
-        for (int pid = pstart; pid < pend; pid++)
-        {
-            const Particle p(pvView.particles, pid);
-            auto motion = toSingleMotion(reView.motions[objId]);
+    for (int pid = pstart; pid < pend; pid++)
+    {
+        const Particle p(pvView.particles, pid);
 
-            float3 coo = rotate(p.r - motion.r, invQ(motion.q));
+        float3 coo = rotate(p.r - motion.r, invQ(motion.q));
 
-            float v = ellipsoidF(coo, reView.invAxes);
+        float v = ellipsoidF(coo, reView.invAxes);
 
-//            if (fabs(v) <= tolerance)
-//                tags[pid] = BelongingTags::Boundary;
-            if (v <= tolerance)
-                tags[pid] = BelongingTags::Inside;
-        }
+//        if (fabs(v) <= tolerance)
+//            tags[pid] = BelongingTags::Boundary;
+        if (v <= tolerance)
+            tags[pid] = BelongingTags::Inside;
     }
 }
 
 
+EllipsoidBelongingChecker::EllipsoidBelongingChecker(const YmrState *state, std::string name) :
+    ObjectBelongingChecker_Common(state, name),
+    shell(std::make_unique<EllipsoidShell>())
+{}
+
+EllipsoidBelongingChecker::~EllipsoidBelongingChecker() = default;
+
 void EllipsoidBelongingChecker::tagInner(ParticleVector* pv, CellList* cl, cudaStream_t stream)
 {
-    int nthreads = 512;
+    int nthreads = 128;
 
     auto reov = dynamic_cast<RigidEllipsoidObjectVector*> (ov);
     if (reov == nullptr)
@@ -67,26 +73,27 @@ void EllipsoidBelongingChecker::tagInner(ParticleVector* pv, CellList* cl, cudaS
     tags.resize_anew(pv->local()->size());
     tags.clearDevice(stream);
 
-    ov->findExtentAndCOM(stream, ParticleVectorType::Local);
-    ov->findExtentAndCOM(stream, ParticleVectorType::Halo);
-
     auto view = REOVview(reov, reov->local());
     debug("Computing inside/outside tags for %d local ellipsoids '%s' and %d '%s' particles",
           view.nObjects, ov->name.c_str(), pv->local()->size(), pv->name.c_str());
 
+    shell->build(view, nullptr, cl->cellInfo(), 0.0f, true, stream);
+
     SAFE_KERNEL_LAUNCH(
             insideEllipsoid,
-            view.nObjects, nthreads, 0, stream,
-            view, cl->cellInfo(), cl->getView<PVview>(), tags.devPtr());
+            getNblocks(shell->size(), nthreads), nthreads, 0, stream,
+            view, shell->size(), shell->devPtr(), cl->cellInfo(), cl->getView<PVview>(), tags.devPtr());
 
     view = REOVview(reov, reov->halo());
     debug("Computing inside/outside tags for %d halo ellipsoids '%s' and %d '%s' particles",
           view.nObjects, ov->name.c_str(), pv->local()->size(), pv->name.c_str());
 
+    shell->build(view, nullptr, cl->cellInfo(), 0.0f, true, stream);
+
     SAFE_KERNEL_LAUNCH(
             insideEllipsoid,
-            view.nObjects, nthreads, 0, stream,
-            view, cl->cellInfo(), cl->getView<PVview>(), tags.devPtr());
+            getNblocks(shell->size(), nthreads), nthreads, 0, stream,
+            view, shell->size(), shell->devPtr(), cl->cellInfo(), cl->getView<PVview>(), tags.devPtr());
 }
 
 
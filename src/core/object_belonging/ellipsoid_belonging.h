@@ -2,12 +2,20 @@
 
 #include "object_belonging.h"
 
+#include <memory>
+
+class EllipsoidShell;
+
 class EllipsoidBelongingChecker : public ObjectBelongingChecker_Common
 {
 public:
-    using ObjectBelongingChecker_Common::ObjectBelongingChecker_Common;
+    EllipsoidBelongingChecker(const YmrState *state, std::string name);
 
     void tagInner(ParticleVector* pv, CellList* cl, cudaStream_t stream) override;
 
-    virtual ~EllipsoidBelongingChecker() = default;
+    virtual ~EllipsoidBelongingChecker();
+
+protected:
+    /// only the cells around the surfaces and inside the ellipsoids are processed
+    std::unique_ptr<EllipsoidShell> shell;
 };
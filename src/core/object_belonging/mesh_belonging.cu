@@ -4,11 +4,14 @@
 #include <core/pvs/particle_vector.h>
 #include <core/pvs/rigid_ellipsoid_object_vector.h>
 #include <core/pvs/views/ov.h>
+#include <core/pvs/views/rov.h>
 #include <core/celllist.h>
 
 #include <core/rigid_kernels/quaternion.h>
 #include <core/rigid_kernels/rigid_motion.h>
 
+#include <algorithm>
+
 namespace MeshBelongingKernels
 {
 
@@ -66,7 +69,7 @@ __device__ BelongingTags oneParticleInsideMesh(int pid, float3 r, int objId, con
 
     for (int i = __laneid(); i < mesh.ntriangles; i += warpSize)
     {
-        int3 trid = mesh.triangles[i];
+        int3 trid = mesh.getTriangle(i);
 
         float3 v0 = Particle(vertices, objId*mesh.nvertices + trid.x).r - com;
         float3 v1 = Particle(vertices, objId*mesh.nvertices + trid.y).r - com;
@@ -131,7 +134,8 @@ __global__ void insideMesh(const OVview ovView, const MeshView mesh, float4* ver
 #pragma unroll 3
         for (int pid = pstart; pid < pend; pid++)
         {
-            const Particle p(pvView.particles, pid);
+            Particle p;
+            pvView.readCoordinate(p, pid);
 
             auto tag = oneParticleInsideMesh(pid, p.r, objId, ovView.comAndExtents[objId].com, mesh, vertices);
 
@@ -142,15 +146,359 @@ __global__ void insideMesh(const OVview ovView, const MeshView mesh, float4* ver
     }
 }
 
+__device__ inline float component(float3 v, int axis)
+{
+    return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+}
+
+/// does the ray from \p r along the positive direction of \p axis cross the box
+__device__ inline bool rayHitsBox(const AABB& box, float3 r, int axis)
+{
+    for (int d = 0; d < 3; d++)
+    {
+        const float x = component(r, d);
+        if (d == axis)
+        {
+            if (component(box.hi, d) < x) return false;
+        }
+        else
+        {
+            if (x < component(box.lo, d) || x > component(box.hi, d)) return false;
+        }
+    }
+    return true;
+}
+
+/// One thread per triangle of all the objects, the boxes are enlarged by \p margin
+__global__ void computeTriangleBoxes(int nObjects, const MeshView mesh, const float4* vertices, float margin, AABB* boxes)
+{
+    const int gid = blockIdx.x * blockDim.x + threadIdx.x;
+    const int objId = gid / mesh.ntriangles;
+    const int trid  = gid % mesh.ntriangles;
+    if (objId >= nObjects) return;
+
+    const int3 triangle = mesh.getTriangle(trid);
+    const float3 v0 = Particle(vertices, objId*mesh.nvertices + triangle.x).r;
+    const float3 v1 = Particle(vertices, objId*mesh.nvertices + triangle.y).r;
+    const float3 v2 = Particle(vertices, objId*mesh.nvertices + triangle.z).r;
+
+    boxes[gid] = { fminf(fminf(v0, v1), v2) - margin, fmaxf(fmaxf(v0, v1), v2) + margin };
+}
+
+/// number of triangles of the hierarchy crossed by the ray from \p r along the positive direction of \p axis
+__device__ inline int rayCrossings(const BVHView& bvh, const MeshView& mesh, const float4* vertices, float3 r, int axis)
+{
+    const float3 ray = make_float3(axis == 0, axis == 1, axis == 2);
+    int counter = 0;
+
+    bvh.traverse(
+        [&] (const AABB& box) {
+            return rayHitsBox(box, r, axis);
+        },
+        [&] (int gid) {
+            const int objId = gid / mesh.ntriangles;
+            const int3 trid = mesh.getTriangle(gid % mesh.ntriangles);
+
+            const float3 v0 = Particle(vertices, objId*mesh.nvertices + trid.x).r;
+            const float3 v1 = Particle(vertices, objId*mesh.nvertices + trid.y).r;
+            const float3 v2 = Particle(vertices, objId*mesh.nvertices + trid.z).r;
+
+            if (doesRayIntersectTriangle(r, ray, v0, v1, v2))
+                counter++;
+        });
+
+    return counter;
+}
+
+__device__ inline bool boxContains(const AABB& box, float3 r)
+{
+    return box.lo.x <= r.x && r.x <= box.hi.x &&
+           box.lo.y <= r.y && r.y <= box.hi.y &&
+           box.lo.z <= r.z && r.z <= box.hi.z;
+}
+
+/// is \p r within one of the leaf boxes of the hierarchy, stops at the first one
+__device__ inline bool withinAnyLeaf(const BVHView& bvh, float3 r)
+{
+    bool found = false;
+
+    bvh.traverseNodes([&] (int node) {
+        if (found || !boxContains(bvh.boxes[node], r)) return false;
+        if (bvh.isLeaf(node)) found = true;
+        return true;
+    });
+
+    return found;
+}
+
+/**
+ * One thread per particle, 3 axis-aligned rays through the BVH.
+ * Particles inside none of the meshes exit at the root box
+ */
+__global__ void insideMeshBVH(PVview pvView, const MeshView mesh, const float4* vertices, BVHView bvh, BelongingTags* tags)
+{
+    const int pid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (pid >= pvView.size) return;
+
+    Particle p;
+    pvView.readCoordinate(p, pid);
+
+    constexpr int nRays = 3;
+    int intersecting = 0;
+
+    for (int axis = 0; axis < nRays; axis++)
+    {
+        // counter is odd if the particle is inside, majority vote as above
+        if ( (rayCrossings(bvh, mesh, vertices, p.r, axis) % 2) != 0 )
+            intersecting++;
+    }
+
+    // Only tag particles inside, default is outside anyways
+    if (intersecting > (nRays/2))
+        tags[pid] = BelongingTags::Inside;
+}
+
+/**
+ * Incremental version of insideMeshBVH() over the local and the halo objects at once,
+ * the leaf boxes being enlarged by the surface shell.
+ * A particle outside of all the boxes is farther than the shell from every surface: it could not cross any
+ * since the previous check and keeps \p knownSide. The others cast the rays through both hierarchies,
+ * the meshes do not overlap such that the crossings of all of them add up
+ */
+__global__ void insideMeshShellBVH(PVview pvView, const MeshView mesh,
+                                   const float4* localVertices, BVHView localBVH,
+                                   const float4* haloVertices,  BVHView haloBVH,
+                                   BelongingTags knownSide, BelongingTags* tags)
+{
+    const int pid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (pid >= pvView.size) return;
+
+    Particle p;
+    pvView.readCoordinate(p, pid);
+
+    if (!withinAnyLeaf(localBVH, p.r) && !withinAnyLeaf(haloBVH, p.r))
+    {
+        tags[pid] = knownSide;
+        return;
+    }
+
+    constexpr int nRays = 3;
+    int intersecting = 0;
+
+    for (int axis = 0; axis < nRays; axis++)
+    {
+        const int counter = rayCrossings(localBVH, mesh, localVertices, p.r, axis) +
+                            rayCrossings(haloBVH,  mesh, haloVertices,  p.r, axis);
+
+        if ( (counter % 2) != 0 )
+            intersecting++;
+    }
+
+    tags[pid] = intersecting > (nRays/2) ? BelongingTags::Inside : BelongingTags::Outside;
+}
+
+/**
+ * Same as insideMeshBVH() for rigid objects, with the BVH of the mesh in its own frame.
+ * One thread per particle and object, the rays are cast in the body frame
+ */
+__global__ void insideRigidMeshBVH(PVview pvView, ROVview rovView, const MeshView mesh, const float4* bodyVertices,
+                                   BVHView bvh, float bodyRadius, BelongingTags* tags)
+{
+    const int pid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (pid >= pvView.size) return;
+
+    Particle p;
+    pvView.readCoordinate(p, pid);
+
+    for (int objId = blockIdx.y; objId < rovView.nObjects; objId += gridDim.y)
+    {
+        const auto motion = toSingleMotion(rovView.motions[objId]);
+
+        const float3 dr = p.r - motion.r;
+        if (dot(dr, dr) > bodyRadius*bodyRadius) continue;
+
+        const float3 r = rotate(dr, invQ(motion.q));
+
+        constexpr int nRays = 3;
+        int intersecting = 0;
+
+        for (int axis = 0; axis < nRays; axis++)
+        {
+            const float3 ray = make_float3(axis == 0, axis == 1, axis == 2);
+            int counter = 0;
+
+            bvh.traverse(
+                [&] (const AABB& box) {
+                    return rayHitsBox(box, r, axis);
+                },
+                [&] (int trid) {
+                    const int3 triangle = mesh.getTriangle(trid);
+
+                    if (doesRayIntersectTriangle(r, ray,
+                                                 f4tof3(bodyVertices[triangle.x]),
+                                                 f4tof3(bodyVertices[triangle.y]),
+                                                 f4tof3(bodyVertices[triangle.z])))
+                        counter++;
+                });
+
+            if ( (counter % 2) != 0 )
+                intersecting++;
+        }
+
+        if (intersecting > (nRays/2))
+        {
+            tags[pid] = BelongingTags::Inside;
+            return;
+        }
+    }
+}
+
 } // namespace MeshBelongingKernels
 
+MeshBelongingChecker::MeshBelongingChecker(const YmrState *state, std::string name, bool useBVH, float surfaceShell) :
+    ObjectBelongingChecker_Common(state, name),
+    useBVH(useBVH),
+    surfaceShell(surfaceShell)
+{
+    if (surfaceShell < 0.0f)
+        die("Belonging checker '%s': the surface shell must be non-negative, got %f", name.c_str(), surfaceShell);
+
+    if (surfaceShell > 0.0f && !useBVH)
+        die("Belonging checker '%s': the incremental check within a surface shell needs the BVH", name.c_str());
+}
+
+bool MeshBelongingChecker::needsCellList() const
+{
+    return !useBVH;
+}
+
+void MeshBelongingChecker::tagInnerBVH(ParticleVector* pv, bool local, cudaStream_t stream)
+{
+    const int nthreads = 128;
+
+    auto lov = local ? ov->local() : ov->halo();
+    if (lov->nObjects == 0) return;
+
+    if (auto rov = dynamic_cast<RigidObjectVector*>(ov))
+    {
+        tagInnerRigidBVH(pv, rov, local, stream);
+        return;
+    }
+
+    auto vertices = lov->getMeshVertices(stream);
+    auto meshView = MeshView(ov->mesh.get());
+    const int totalTriangles = lov->nObjects * meshView.ntriangles;
+
+    debug("Computing inside/outside tags (against mesh BVH) for %d %s objects '%s' and %d '%s' particles",
+          lov->nObjects, local ? "local" : "halo", ov->name.c_str(), pv->local()->size(), pv->name.c_str());
+
+    SAFE_KERNEL_LAUNCH(
+            MeshBelongingKernels::computeTriangleBoxes,
+            getNblocks(totalTriangles, nthreads), nthreads, 0, stream,
+            lov->nObjects, meshView, (float4*)vertices->devPtr(), MeshBelongingKernels::tolerance, bvh.leafBoxes(totalTriangles) );
+
+    // halo objects stick out of the domain, the codes are clamped anyways
+    const float3 margin = make_float3(1.0f);
+    bvh.build(-0.5f * state->domain.localSize - margin, 0.5f * state->domain.localSize + margin, stream);
+
+    PVview view(pv, pv->local());
+
+    SAFE_KERNEL_LAUNCH(
+            MeshBelongingKernels::insideMeshBVH,
+            getNblocks(view.size, nthreads), nthreads, 0, stream,
+            view, meshView, (float4*)vertices->devPtr(), bvh.getView(), tags.devPtr() );
+}
+
+void MeshBelongingChecker::tagInnerRigidBVH(ParticleVector* pv, RigidObjectVector* rov, bool local, cudaStream_t stream)
+{
+    const int nthreads = 128;
+
+    ROVview rovView(rov, local ? rov->local() : rov->halo());
+    auto& mesh = rov->mesh;
+    const auto& bodyBVH = mesh->getBodyFrameBVH(stream);
+
+    debug("Computing inside/outside tags (against body frame mesh BVH) for %d %s objects '%s' and %d '%s' particles",
+          rovView.nObjects, local ? "local" : "halo", rov->name.c_str(), pv->local()->size(), pv->name.c_str());
+
+    PVview view(pv, pv->local());
+
+    const int maxObjectsPerGrid = 65535;
+    const dim3 nblocks(getNblocks(view.size, nthreads), std::min(rovView.nObjects, maxObjectsPerGrid));
+
+    SAFE_KERNEL_LAUNCH(
+            MeshBelongingKernels::insideRigidMeshBVH,
+            nblocks, nthreads, 0, stream,
+            view, rovView, MeshView(mesh.get()), mesh->vertexCoordinates.devPtr(), bodyBVH.getView(),
+            mesh->getBodyRadius(), tags.devPtr() );
+}
+
+BVHView MeshBelongingChecker::buildShellBVH(BoundingVolumeHierarchy& hierarchy, LocalObjectVector* lov, cudaStream_t stream)
+{
+    if (lov->nObjects == 0)
+        return {0, nullptr, nullptr, nullptr, nullptr};
+
+    const int nthreads = 128;
+    auto vertices = lov->getMeshVertices(stream);
+    auto meshView = MeshView(ov->mesh.get());
+    const int totalTriangles = lov->nObjects * meshView.ntriangles;
+
+    SAFE_KERNEL_LAUNCH(
+            MeshBelongingKernels::computeTriangleBoxes,
+            getNblocks(totalTriangles, nthreads), nthreads, 0, stream,
+            lov->nObjects, meshView, (float4*)vertices->devPtr(),
+            std::max(surfaceShell, MeshBelongingKernels::tolerance), hierarchy.leafBoxes(totalTriangles) );
+
+    const float3 margin = make_float3(1.0f + surfaceShell);
+    hierarchy.build(-0.5f * state->domain.localSize - margin, 0.5f * state->domain.localSize + margin, stream);
+
+    return hierarchy.getView();
+}
+
+void MeshBelongingChecker::tagInnerShell(ParticleVector* pv, cudaStream_t stream)
+{
+    const int nthreads = 128;
+
+    debug("Computing inside/outside tags (within a shell of %f around the meshes) for %d local and %d halo objects '%s' "
+          "and %d '%s' particles, known %s",
+          surfaceShell, ov->local()->nObjects, ov->halo()->nObjects, ov->name.c_str(),
+          pv->local()->size(), pv->name.c_str(), knownSide == BelongingTags::Inside ? "inside" : "outside");
+
+    const auto localView = buildShellBVH(bvh,     ov->local(), stream);
+    const auto haloView  = buildShellBVH(haloBVH, ov->halo(),  stream);
+
+    PVview view(pv, pv->local());
+
+    SAFE_KERNEL_LAUNCH(
+            MeshBelongingKernels::insideMeshShellBVH,
+            getNblocks(view.size, nthreads), nthreads, 0, stream,
+            view, MeshView(ov->mesh.get()),
+            (float4*)ov->local()->getMeshVertices(stream)->devPtr(), localView,
+            (float4*)ov->halo() ->getMeshVertices(stream)->devPtr(), haloView,
+            knownSide, tags.devPtr() );
+}
+
 void MeshBelongingChecker::tagInner(ParticleVector* pv, CellList* cl, cudaStream_t stream)
 {
     int nthreads = 128;
 
     tags.resize_anew(pv->local()->size());
+
+    // the rigid meshes are checked in their own frame, always entirely
+    if (sideKnown && surfaceShell > 0.0f && dynamic_cast<RigidObjectVector*>(ov) == nullptr)
+    {
+        tagInnerShell(pv, stream);
+        return;
+    }
+
     tags.clearDevice(stream);
 
+    if (useBVH)
+    {
+        tagInnerBVH(pv, true,  stream);
+        tagInnerBVH(pv, false, stream);
+        return;
+    }
+
     const int warpsPerObject = 1024;
 
     ov->findExtentAndCOM(stream, ParticleVectorType::Local);
@@ -2,12 +2,48 @@
 
 #include "object_belonging.h"
 
+#include <core/mesh/bvh.h>
+
+class LocalObjectVector;
+class RigidObjectVector;
+
+/**
+ * Inside-outside test against the triangle meshes of the objects, by ray parity.
+ *
+ * By default a BVH over the triangles is built at every check (the same BoundingVolumeHierarchy
+ * as the BVH broadphase of BounceFromMesh), and every particle casts 3 axis-aligned rays through it:
+ * the cost is about log(#triangles) per particle and no cell-list is needed,
+ * which makes frequent belonging corrections affordable.
+ * Otherwise every particle within the bounding box of an object is tested against all its triangles.
+ * The meshes of rigid objects do not deform: their BVH is built once in the frame of the mesh
+ * and the particles are brought to the frame of every nearby object.
+ *
+ * With a positive \c surfaceShell the corrections are incremental: after the first split, the particles farther than
+ * the shell from all the surfaces can not have changed side, they keep the side of the particle vector they belong to
+ * and only the particles within the shell are tested. The shell must be larger than the largest displacement of the
+ * particles relative to the membranes between two checks, i.e. about checkEvery * dt * vmax plus a tolerance.
+ * Rigid objects are always tested entirely.
+ */
 class MeshBelongingChecker : public ObjectBelongingChecker_Common
 {
 public:
-    using ObjectBelongingChecker_Common::ObjectBelongingChecker_Common;
+    MeshBelongingChecker(const YmrState *state, std::string name, bool useBVH = true, float surfaceShell = 0.0f);
 
     void tagInner(ParticleVector* pv, CellList* cl, cudaStream_t stream) override;
 
     virtual ~MeshBelongingChecker() = default;
+
+protected:
+    bool useBVH;
+    float surfaceShell;
+    BoundingVolumeHierarchy bvh, haloBVH;  ///< the halo one only for the incremental check
+
+    bool needsCellList() const override;
+
+    void tagInnerBVH(ParticleVector* pv, bool local, cudaStream_t stream);
+    void tagInnerRigidBVH(ParticleVector* pv, RigidObjectVector* rov, bool local, cudaStream_t stream);
+
+    /// hierarchy over the triangles of \p lov enlarged by the surface shell, an empty view without objects
+    BVHView buildShellBVH(BoundingVolumeHierarchy& hierarchy, LocalObjectVector* lov, cudaStream_t stream);
+    void tagInnerShell(ParticleVector* pv, cudaStream_t stream);
 };
@@ -7,6 +7,20 @@
 
 #include <core/celllist.h>
 
+#include <extern/cub/cub/device/device_partition.cuh>
+#include <extern/cub/cub/iterator/transform_input_iterator.cuh>
+
+namespace ObjectBelongingKernels
+{
+struct IsInside
+{
+    __host__ __device__ __forceinline__ bool operator()(const BelongingTags& tag) const
+    {
+        return tag == BelongingTags::Inside;
+    }
+};
+} // namespace ObjectBelongingKernels
+
 __global__ void copyInOut(
         PVview view,
         const BelongingTags* tags,
@@ -53,64 +67,70 @@ void ObjectBelongingChecker_Common::splitByBelonging(ParticleVector* src, Partic
         error("PV type of outer result of split (%s) is different from source (%s)",
               pvOut->name.c_str(), src->name.c_str());
 
+    sideKnown = splitPVs.find(src) != splitPVs.end();
+    knownSide = (src == pvIn) ? BelongingTags::Inside : BelongingTags::Outside;
+
+    if (needsCellList())
     {
         PrimaryCellList cl(src, 1.0f, state->domain.localSize);
         cl.build(stream);
         checkInner(src, &cl, stream);
     }
+    else
+    {
+        checkInner(src, nullptr, stream);
+    }
+
+    sideKnown = false;
 
     info("Splitting PV %s with respect to OV %s. Number of particles: in/out/total %d / %d / %d",
          src->name.c_str(), ov->name.c_str(), nInside[0], nOutside[0], src->local()->size());
 
-    // Need buffers because the source is the same as inside or outside
-    PinnedBuffer<Particle> bufIn(nInside[0]), bufOut(nOutside[0]);
+    // One partition of the source: the inner particles first, then the outer ones in reverse order.
+    // Device only and reused, the source may be the same as inside or outside
+    const int n = src->local()->size();
+    partitioned.resize_anew(n);
 
-    nInside. clearDevice(stream);
-    nOutside.clearDevice(stream);
-    tags.downloadFromDevice(stream);
-
-    PVview view(src, src->local());
-    const int nthreads = 128;
-    SAFE_KERNEL_LAUNCH(
-            copyInOut,
-            getNblocks(view.size, nthreads), nthreads, 0, stream,
-            view,
-            tags.devPtr(), bufIn.devPtr(), bufOut.devPtr(),
-            nInside.devPtr(), nOutside.devPtr() );
-
-    CUDA_Check( cudaStreamSynchronize(stream) );
-
-    if (pvIn  != nullptr)
+    if (n > 0)
     {
-        int oldSize = (src == pvIn) ? 0 : pvIn->local()->size();
-        pvIn->local()->resize(oldSize + nInside[0], stream);
+        ObjectBelongingKernels::IsInside isInside;
+        cub::TransformInputIterator<bool, ObjectBelongingKernels::IsInside, const BelongingTags*> flags(tags.devPtr(), isInside);
+
+        size_t bufSize = 0;
+        cub::DevicePartition::Flagged(nullptr, bufSize, src->local()->coosvels.devPtr(), flags,
+                                      partitioned.devPtr(), nInside.devPtr(), n, stream);
+        partitionBuffer.resize_anew(bufSize);
+        cub::DevicePartition::Flagged(partitionBuffer.devPtr(), bufSize, src->local()->coosvels.devPtr(), flags,
+                                      partitioned.devPtr(), nInside.devPtr(), n, stream);
+    }
 
-        if (nInside[0] > 0)
-            CUDA_Check( cudaMemcpyAsync(pvIn->local()->coosvels.devPtr() + oldSize,
-                    bufIn.devPtr(),
-                    nInside[0] * sizeof(Particle),
-                    cudaMemcpyDeviceToDevice, stream) );
+    // nInside and nOutside are already on the host from checkInner()
+    auto append = [&] (ParticleVector *pv, const Particle *from, int count) {
+        const int oldSize = (src == pv) ? 0 : pv->local()->size();
+        pv->local()->resize(oldSize + count, stream);
 
+        if (count > 0)
+            CUDA_Check( cudaMemcpyAsync(pv->local()->coosvels.devPtr() + oldSize, from,
+                                        count * sizeof(Particle), cudaMemcpyDeviceToDevice, stream) );
 
+        pv->cellListStamp++;
+    };
+
+    if (pvIn != nullptr)
+    {
+        append(pvIn, partitioned.devPtr(), nInside[0]);
         info("New size of inner PV %s is %d", pvIn->name.c_str(), pvIn->local()->size());
-        pvIn->cellListStamp++;
     }
 
     if (pvOut != nullptr)
     {
-        int oldSize = (src == pvOut) ? 0 : pvOut->local()->size();
-        pvOut->local()->resize(oldSize + nOutside[0], stream);
-
-        if (nOutside[0] > 0)
-            CUDA_Check( cudaMemcpyAsync(pvOut->local()->coosvels.devPtr() + oldSize,
-                    bufOut.devPtr(),
-                    nOutside[0] * sizeof(Particle),
-                    cudaMemcpyDeviceToDevice, stream) );
-
-
+        append(pvOut, partitioned.devPtr() + nInside[0], nOutside[0]);
         info("New size of outer PV %s is %d", pvOut->name.c_str(), pvOut->local()->size());
-        pvOut->cellListStamp++;
     }
+
+    // the particles of the destinations are all on their side from now on
+    if (pvIn  != nullptr) splitPVs.insert(pvIn);
+    if (pvOut != nullptr) splitPVs.insert(pvOut);
 }
 
 void ObjectBelongingChecker_Common::checkInner(ParticleVector* pv, CellList* cl, cudaStream_t stream)
@@ -150,3 +170,8 @@ ObjectVector* ObjectBelongingChecker_Common::getObjectVector()
 {
     return ov;
 }
+
+bool ObjectBelongingChecker_Common::needsCellList() const
+{
+    return true;
+}
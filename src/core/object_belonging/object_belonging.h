@@ -2,6 +2,9 @@
 
 #include "interface.h"
 #include <core/containers.h>
+#include <core/datatypes.h>
+
+#include <set>
 
 enum class BelongingTags
 {
@@ -33,7 +36,22 @@ protected:
     ObjectVector* ov;
 
     PinnedBuffer<BelongingTags> tags;
+
+    /**
+     * Set during every splitByBelonging() once its source went through a previous split:
+     * all its particles were then on \c knownSide, which tagInner() may rely upon
+     */
+    bool sideKnown {false};
+    BelongingTags knownSide {BelongingTags::Outside};
+    std::set<ParticleVector*> splitPVs;   ///< destinations of the previous splits
     PinnedBuffer<int> nInside{1}, nOutside{1};
 
+    /// source particles partitioned by splitByBelonging(), and the temporary storage of the partition
+    DeviceBuffer<Particle> partitioned;
+    DeviceBuffer<char> partitionBuffer;
+
     virtual void tagInner(ParticleVector* pv, CellList* cl, cudaStream_t stream) = 0;
+
+    /// if false, tagInner() may get a nullptr cell-list and splitByBelonging() does not build one
+    virtual bool needsCellList() const;
 };
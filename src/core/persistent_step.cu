@@ -0,0 +1,230 @@
+#include "persistent_step.h"
+
+#include <core/interactions/pairwise_interactions/dpd.h>
+#include <core/interactions/pairwise_kernels.h>
+#include <core/logger.h>
+#include <core/pvs/particle_vector.h>
+#include <core/utils/cuda_common.h>
+#include <core/utils/make_unique.h>
+#include <core/ymero_state.h>
+
+#include <algorithm>
+
+/// the DPD forces of the persistent kernel, whose step goes on on the device
+class PersistentDPDHandler : public PairwiseDPDHandler
+{
+public:
+    PersistentDPDHandler(const PairwiseDPDHandler& handler) :
+        PairwiseDPDHandler(handler)
+    {}
+
+    __D__ inline void setStep(int step) { this->step = step; }
+};
+
+namespace PersistentStepKernels
+{
+
+/**
+ * Exclusive scan of the cell sizes into the cell starts by one block, the sizes are cleared
+ * for the next binning. Every thread scans a contiguous chunk of cells
+ */
+__device__ void scanCells(CellListInfo cinfo)
+{
+    extern __shared__ int partial[];
+
+    const int chunk = (cinfo.totcells + blockDim.x - 1) / blockDim.x;
+    const int start = min(threadIdx.x * chunk, cinfo.totcells);
+    const int end   = min(start + chunk, cinfo.totcells);
+
+    int sum = 0;
+    for (int cid = start; cid < end; cid++)
+        sum += cinfo.cellSizes[cid];
+
+    partial[threadIdx.x] = sum;
+    __syncthreads();
+
+    if (threadIdx.x == 0)
+    {
+        int offset = 0;
+        for (int i = 0; i < blockDim.x; i++)
+        {
+            const int size = partial[i];
+            partial[i] = offset;
+            offset += size;
+        }
+        cinfo.cellStarts[cinfo.totcells] = offset;
+    }
+    __syncthreads();
+
+    int offset = partial[threadIdx.x];
+    for (int cid = start; cid < end; cid++)
+    {
+        cinfo.cellStarts[cid] = offset;
+        offset += cinfo.cellSizes[cid];
+        cinfo.cellSizes[cid] = 0;
+    }
+}
+
+__device__ inline float3 wrapPeriodic(float3 r, float3 L)
+{
+    if      (r.x <  -0.5f*L.x) r.x += L.x;
+    else if (r.x >=  0.5f*L.x) r.x -= L.x;
+
+    if      (r.y <  -0.5f*L.y) r.y += L.y;
+    else if (r.y >=  0.5f*L.y) r.y -= L.y;
+
+    if      (r.z <  -0.5f*L.z) r.z += L.z;
+    else if (r.z >=  0.5f*L.z) r.z -= L.z;
+
+    return r;
+}
+
+/**
+ * DPD force on \p dst from all the particles of the 27 neighbouring cells, the cells across
+ * the boundaries through their periodic images as in computeSelfInteractionsPeriodic()
+ */
+__device__ inline float3 dpdForce(const Particle& dst, int dstId, const Particle *sorted,
+                                  const CellListInfo& cinfo, const PersistentDPDHandler& handler)
+{
+    const int3 cell0 = cinfo.getCellIdAlongAxes(dst.r);
+    float3 f = make_float3(0.0f);
+
+    for (int dz = -1; dz <= 1; dz++)
+        for (int dy = -1; dy <= 1; dy++)
+            for (int dx = -1; dx <= 1; dx++)
+            {
+                float3 shift;
+                const int3 cell = wrapCellPeriodic(cell0 + make_int3(dx, dy, dz), cinfo, shift);
+
+                const int cid = cinfo.encode(cell.x, cell.y, cell.z);
+                const int pstart = cinfo.cellStarts[cid];
+                const int pend   = cinfo.cellStarts[cid+1];
+
+                Particle image = dst;
+                image.r -= shift;
+
+                for (int srcId = pstart; srcId < pend; srcId++)
+                    if (srcId != dstId)
+                        f += handler(image, dstId, sorted[srcId], srcId);
+            }
+
+    return f;
+}
+
+/**
+ * All the \p nsteps steps, every phase a grid-stride loop over the particles:
+ * count the particles per cell, scan the counts, sort the particles by cell into \p sorted,
+ * then compute the forces on the sorted particles and integrate them back into \p particles.
+ * The cell sizes must be zero at the launch. Launched cooperatively, with all the blocks resident
+ */
+__global__ void advance(CellListInfo cinfo, int n, Particle *particles, Particle *sorted, int *slots,
+                        PersistentDPDHandler handler, float invMass, float dt, int firstStep, int nsteps)
+{
+    auto grid = cg::this_grid();
+
+    const int tid    = blockIdx.x * blockDim.x + threadIdx.x;
+    const int stride = gridDim.x * blockDim.x;
+
+    for (int s = 0; s < nsteps; s++)
+    {
+        for (int pid = tid; pid < n; pid += stride)
+        {
+            const int cid = cinfo.getCellId(particles[pid].r);
+            slots[pid] = atomicAdd(cinfo.cellSizes + cid, 1);
+        }
+        grid.sync();
+
+        if (blockIdx.x == 0)
+            scanCells(cinfo);
+        grid.sync();
+
+        for (int pid = tid; pid < n; pid += stride)
+        {
+            const Particle p = particles[pid];
+            const int cid = cinfo.getCellId(p.r);
+            sorted[cinfo.cellStarts[cid] + slots[pid]] = p;
+        }
+        grid.sync();
+
+        handler.setStep(firstStep + s);
+
+        for (int pid = tid; pid < n; pid += stride)
+        {
+            Particle p = sorted[pid];
+            const float3 f = dpdForce(p, pid, sorted, cinfo, handler);
+
+            p.u += f * invMass * dt;
+            p.r  = wrapPeriodic(p.r + p.u * dt, cinfo.localDomainSize);
+
+            particles[pid] = p;
+        }
+        grid.sync();
+    }
+}
+
+} // namespace PersistentStepKernels
+
+PersistentStepper::PersistentStepper(const YmrState *state, ParticleVector *pv, const PairwiseDPDHandler& handler, float rc) :
+    state(state),
+    pv(pv),
+    handler(std::make_unique<PersistentDPDHandler>(handler)),
+    cinfo(rc, state->domain.localSize)
+{
+    if (cinfo.ncells.x < 3 || cinfo.ncells.y < 3 || cinfo.ncells.z < 3)
+        die("Persistent step mode needs at least 3 cells per dimension, got %d x %d x %d",
+            cinfo.ncells.x, cinfo.ncells.y, cinfo.ncells.z);
+
+    int device, cooperative, nSMs, blocksPerSM;
+    CUDA_Check( cudaGetDevice(&device) );
+    CUDA_Check( cudaDeviceGetAttribute(&cooperative, cudaDevAttrCooperativeLaunch, device) );
+    CUDA_Check( cudaDeviceGetAttribute(&nSMs, cudaDevAttrMultiProcessorCount, device) );
+
+    if (!cooperative)
+        die("Persistent step mode needs a device supporting cooperative launches");
+
+    CUDA_Check( cudaOccupancyMaxActiveBlocksPerMultiprocessor(&blocksPerSM, PersistentStepKernels::advance,
+                                                              nthreads, nthreads * sizeof(int)) );
+    maxBlocks = blocksPerSM * nSMs;
+
+    cellSizes .resize_anew(cinfo.totcells);
+    cellStarts.resize_anew(cinfo.totcells + 1);
+    cellSizes.clear(defaultStream);
+
+    this->cinfo.cellSizes  = cellSizes .devPtr();
+    this->cinfo.cellStarts = cellStarts.devPtr();
+
+    info("Persistent step mode for pv '%s': %d x %d x %d cells, up to %d resident blocks of %d threads",
+         pv->name.c_str(), cinfo.ncells.x, cinfo.ncells.y, cinfo.ncells.z, maxBlocks, nthreads);
+}
+
+PersistentStepper::~PersistentStepper() = default;
+
+void PersistentStepper::run(int nsteps, cudaStream_t stream)
+{
+    auto lpv = pv->local();
+    int n = lpv->size();
+    if (n == 0 || nsteps == 0) return;
+
+    sorted.resize_anew(n);
+    slots .resize_anew(n);
+
+    // the extra blocks would only wait at the synchronizations
+    int nblocks = std::min(maxBlocks, getNblocks(n, nthreads));
+
+    Particle *particles = lpv->coosvels.devPtr();
+    Particle *sortedPtr = sorted.devPtr();
+    int *slotsPtr = slots.devPtr();
+    float invMass = 1.0f / pv->mass;
+    float dt = state->dt;
+    int firstStep = state->currentStep;
+
+    debug("Advancing %d particles of pv '%s' by %d steps in one persistent kernel of %d blocks",
+          n, pv->name.c_str(), nsteps, nblocks);
+
+    void *args[] = { &cinfo, &n, &particles, &sortedPtr, &slotsPtr, handler.get(),
+                     &invMass, &dt, &firstStep, &nsteps };
+
+    CUDA_Check( cudaLaunchCooperativeKernel((void*) PersistentStepKernels::advance, nblocks, nthreads,
+                                            args, nthreads * sizeof(int), stream) );
+    CUDA_Check( cudaStreamSynchronize(stream) );
+}
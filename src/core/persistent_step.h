@@ -0,0 +1,50 @@
+#pragma once
+
+#include <core/celllist.h>
+#include <core/containers.h>
+
+#include <cuda_runtime.h>
+#include <memory>
+
+class ParticleVector;
+class PairwiseDPDHandler;
+class PersistentDPDHandler;
+class YmrState;
+
+/**
+ * Experimental step mode for tiny subdomains, where a step is dominated by the launches of short kernels.
+ *
+ * One cooperative kernel advances a DPD fluid by several steps, the step loop stays on the device:
+ * the phases of a step (binning of the particles, DPD forces and velocity-Verlet integration)
+ * are separated by grid-wide synchronizations. The kernel has its own row-major cell-list of cell size rc,
+ * the neighbours across the periodic boundaries interact through their images, such that no halo is needed.
+ *
+ * Only the simplest setup is supported, see Simulation::setPersistentStepMode(): a single rank and
+ * a single particle vector with a DPD interaction with itself, the counter-based random numbers
+ * follow the step on the device
+ */
+class PersistentStepper
+{
+public:
+    PersistentStepper(const YmrState *state, ParticleVector *pv, const PairwiseDPDHandler& handler, float rc);
+    ~PersistentStepper();
+
+    /**
+     * Advance the local particles of the particle vector by \p nsteps steps starting at the
+     * current step of the state, that is not updated. The particles end up sorted by cell, synchronous
+     */
+    void run(int nsteps, cudaStream_t stream);
+
+private:
+    const YmrState *state;
+    ParticleVector *pv;
+    std::unique_ptr<PersistentDPDHandler> handler;
+
+    CellListInfo cinfo;
+    DeviceBuffer<int> cellSizes, cellStarts;
+    DeviceBuffer<int> slots;              ///< of the particles in their cells
+    DeviceBuffer<Particle> sorted;
+
+    static const int nthreads = 128;
+    int maxBlocks;                        ///< that are resident on the device at once
+};
@@ -0,0 +1,187 @@
+#include "plugin_costs.h"
+
+#include <core/logger.h>
+
+#include <algorithm>
+#include <string>
+
+PluginCosts::PluginCosts(int reportEvery) :
+    reportEvery(reportEvery)
+{
+    if (reportEvery <= 0)
+        die("Plugin costs must be reported with a positive period, got %d", reportEvery);
+}
+
+PluginCosts::~PluginCosts()
+{
+    for (auto& call : pending)
+    {
+        freeEvents.push_back(call.start);
+        freeEvents.push_back(call.stop);
+    }
+
+    for (auto& event : freeEvents)
+        cudaEventDestroy(event);
+}
+
+int PluginCosts::add(std::string name, float budget, int period)
+{
+    if (budget < 0.0f || budget >= 1.0f)
+        die("Budget of plugin '%s' must be a fraction of the step time in [0, 1), got %g", name.c_str(), budget);
+
+    Entry entry;
+    entry.name   = name;
+    entry.budget = budget;
+    entry.period = std::max(period, 1);
+    entries.push_back(entry);
+
+    if (budget > 0.0f)
+        info("Plugin '%s' may take up to %g%% of the step time, by periods of %d steps",
+             name.c_str(), 100.0f * budget, entry.period);
+
+    return entries.size() - 1;
+}
+
+bool PluginCosts::active(int id, int step) const
+{
+    const auto& entry = entries[id];
+    if (entry.stretch == 1) return true;
+
+    // the period ending at a multiple of the longest hook period, e.g. with the dump
+    const int period = (step + entry.period - 1) / entry.period;
+    return period % entry.stretch == 0;
+}
+
+cudaEvent_t PluginCosts::getEvent()
+{
+    if (freeEvents.empty())
+    {
+        cudaEvent_t event;
+        CUDA_Check( cudaEventCreate(&event) );
+        return event;
+    }
+
+    auto event = freeEvents.back();
+    freeEvents.pop_back();
+    return event;
+}
+
+void PluginCosts::begin(int id, cudaStream_t stream)
+{
+    openStart = getEvent();
+    CUDA_Check( cudaEventRecord(openStart, stream) );
+    hostTimer.start();
+}
+
+void PluginCosts::end(int id, cudaStream_t stream)
+{
+    const double hostTime = hostTimer.elapsed();
+
+    auto stop = getEvent();
+    CUDA_Check( cudaEventRecord(stop, stream) );
+
+    pending.push_back({id, hostTime, openStart, stop});
+}
+
+/// add the calls the device is done with, the others stay pending
+void PluginCosts::collect()
+{
+    std::vector<Call> stillPending;
+
+    for (auto& call : pending)
+    {
+        const cudaError_t status = cudaEventQuery(call.stop);
+        if (status == cudaErrorNotReady)
+        {
+            stillPending.push_back(call);
+            continue;
+        }
+        CUDA_Check( status );
+
+        float deviceTime;
+        CUDA_Check( cudaEventElapsedTime(&deviceTime, call.start, call.stop) );
+
+        auto& entry = entries[call.id];
+        entry.cost += std::max(call.hostTime, (double) deviceTime);
+        entry.calls++;
+
+        freeEvents.push_back(call.start);
+        freeEvents.push_back(call.stop);
+    }
+
+    std::swap(pending, stillPending);
+}
+
+void PluginCosts::finishStep(int step, MPI_Comm comm)
+{
+    if (!windowStarted)
+    {
+        windowTimer.start();
+        windowStarted = true;
+    }
+
+    collect();
+
+    if ((step + 1) % reportEvery == 0)
+        report(step, comm);
+}
+
+void PluginCosts::report(int step, MPI_Comm comm)
+{
+    const int n = entries.size();
+
+    // the costs of the plugins, then the wall time of the window
+    std::vector<double> costs(n + 1);
+    for (int i = 0; i < n; i++)
+        costs[i] = entries[i].cost;
+    costs[n] = windowTimer.elapsedAndReset();
+
+    MPI_Check( MPI_Allreduce(MPI_IN_PLACE, costs.data(), costs.size(), MPI_DOUBLE, MPI_MAX, comm) );
+
+    int rank;
+    MPI_Check( MPI_Comm_rank(comm, &rank) );
+
+    const double window = std::max(costs[n], 1e-9);
+
+    std::string summary;
+    char line[256];
+
+    for (int i = 0; i < n; i++)
+    {
+        auto& entry = entries[i];
+        const double fraction = costs[i] / window;
+
+        snprintf(line, sizeof(line), "\n    %-32s %10.2f ms  %6.2f%%  %8lld calls",
+                 entry.name.c_str(), costs[i], 100.0 * fraction, entry.calls);
+        summary += line;
+
+        if (entry.stretch > 1)
+        {
+            snprintf(line, sizeof(line), "  runs 1 period out of %d", entry.stretch);
+            summary += line;
+        }
+
+        entry.cost  = 0;
+        entry.calls = 0;
+
+        if (entry.budget <= 0.0f) continue;
+
+        if (fraction > entry.budget)
+        {
+            entry.stretch *= 2;
+            if (rank == 0)
+                warn("Plugin '%s' took %.2f%% of the step time, above its budget of %.2f%%: it now runs 1 period of %d steps out of %d",
+                     entry.name.c_str(), 100.0 * fraction, 100.0f * entry.budget, entry.period, entry.stretch);
+        }
+        else if (entry.stretch > 1 && 2.0 * fraction < entry.budget)
+        {
+            entry.stretch /= 2;
+            if (rank == 0)
+                info("Plugin '%s' took %.2f%% of the step time, under half of its budget of %.2f%%: it now runs 1 period of %d steps out of %d",
+                     entry.name.c_str(), 100.0 * fraction, 100.0f * entry.budget, entry.period, entry.stretch);
+        }
+    }
+
+    if (rank == 0)
+        info("Plugin costs over the steps up to %d, %.1f ms of wall time, on the slowest rank:%s", step, costs[n], summary.c_str());
+}
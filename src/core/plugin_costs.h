@@ -0,0 +1,80 @@
+#pragma once
+
+#include <core/utils/timer.h>
+
+#include <cuda_runtime.h>
+#include <mpi.h>
+#include <string>
+#include <vector>
+
+/**
+ * Time spent in the hooks of every simulation plugin, and the optional budgets of the plugins.
+ *
+ * Every call of a hook is timed on the host and bracketed by two events on its stream;
+ * the cost of a call is the longest of the host time and of the device time between the events,
+ * the events are collected without waiting once the device has passed them.
+ * Every reportEvery steps the costs of the last steps are reduced over the ranks (the slowest rank counts),
+ * the master rank logs them as fractions of the wall time of these steps.
+ *
+ * A plugin with a budget exceeding it runs less often: its steps are split in periods of the longest
+ * period of its hooks (e.g. the dump period), and the plugin only runs one period out of #stretch,
+ * skipping all its hooks in the other ones. The stretch doubles whenever the budget is exceeded and
+ * halves when the cost falls under half of the budget. The decisions are taken on the reduced costs,
+ * the same on all the ranks
+ */
+class PluginCosts
+{
+public:
+    explicit PluginCosts(int reportEvery);
+    ~PluginCosts();
+
+    /**
+     * @param budget largest fraction of the step time the plugin may take, 0 for no limit
+     * @param period longest period of the hooks of the plugin
+     * @return the id of the plugin
+     */
+    int add(std::string name, float budget, int period);
+
+    /// whether plugin \p id runs at \p step, see the class description
+    bool active(int id, int step) const;
+
+    /// around every call of a hook of plugin \p id
+    void begin(int id, cudaStream_t stream);
+    void end  (int id, cudaStream_t stream);
+
+    /// once the step is complete, collective every reportEvery steps
+    void finishStep(int step, MPI_Comm comm);
+
+private:
+    struct Call
+    {
+        int id;
+        double hostTime;
+        cudaEvent_t start, stop;
+    };
+
+    struct Entry
+    {
+        std::string name;
+        float budget;
+        int period;
+        int stretch {1};
+        double cost {0};     ///< ms since the last report
+        long long calls {0};
+    };
+
+    int reportEvery;
+    std::vector<Entry> entries;
+
+    mTimer hostTimer;
+    cudaEvent_t openStart;   ///< of the hook being called
+    std::vector<Call> pending;
+    std::vector<cudaEvent_t> freeEvents;
+
+    mTimer windowTimer;
+    bool windowStarted {false};
+
+    cudaEvent_t getEvent();
+    void collect();
+    void report(int step, MPI_Comm comm);
+};
@@ -1,29 +1,250 @@
 #include "postproc.h"
 
 #include <core/logger.h>
+#include <core/utils/timer.h>
+#include <plugins/batched_transport.h>
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
 
 #include <vector>
 #include <mpi.h>
 
+/// executes the messages of one plugin in their order of arrival on its own thread
+struct Postprocess::Worker
+{
+    struct Message
+    {
+        std::vector<char> data;
+        MPI_Status status;
+    };
+
+    /// messages waiting before push() blocks
+    static const size_t maxQueued = 4;
+
+    PostprocessPlugin *plugin;
+    Cost *cost;   ///< only touched by the thread of the worker
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<Message> queue;
+    bool busy {false}, stopping {false};
+
+    std::thread thread;
+
+    Worker(PostprocessPlugin *plugin, Cost *cost) :
+        plugin(plugin),
+        cost(cost),
+        thread(&Worker::loop, this)
+    {}
+
+    ~Worker()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        cv.notify_all();
+        thread.join();
+    }
+
+    void push(std::vector<char>&& data, const MPI_Status& status)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this] () { return queue.size() < maxQueued; });
+        queue.push_back({std::move(data), status});
+        cv.notify_all();
+    }
+
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this] () { return queue.empty() && !busy; });
+    }
+
+    void loop()
+    {
+        while (true)
+        {
+            Message message;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [this] () { return stopping || !queue.empty(); });
+
+                // the remaining messages are executed before stopping
+                if (queue.empty()) return;
+
+                message = std::move(queue.front());
+                queue.pop_front();
+                busy = true;
+            }
+            cv.notify_all();
+
+            debug2("Postprocess worker of plugin '%s' is executing a message", plugin->name.c_str());
+            mTimer timer;
+            timer.start();
+
+            plugin->setReceivedData(std::move(message.data));
+            plugin->deserialize(message.status);
+
+            cost->time += timer.elapsed();
+            cost->messages++;
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                busy = false;
+            }
+            cv.notify_all();
+        }
+    }
+};
+
 Postprocess::Postprocess(MPI_Comm& comm, MPI_Comm& interComm) : comm(comm), interComm(interComm)
 {
     info("Postprocessing initialized");
 }
 
+Postprocess::~Postprocess()
+{
+    workers.clear();
+    plugins.clear();
+
+    for (auto& pluginComm : pluginComms)
+        MPI_Check( MPI_Comm_free(&pluginComm) );
+}
+
 void Postprocess::registerPlugin(std::shared_ptr<PostprocessPlugin> plugin)
 {
     info("New plugin registered: %s", plugin->name.c_str());
     plugins.push_back( std::move(plugin) );
 }
 
+void Postprocess::setBatchedMessages(bool enabled)
+{
+    batched = enabled;
+}
+
+void Postprocess::setThreaded(bool enabled)
+{
+    threaded = enabled;
+}
+
 void Postprocess::init()
 {
-    for (auto& pl : plugins)
+    if (threaded)
     {
+        int provided;
+        MPI_Check( MPI_Query_thread(&provided) );
+
+        if (provided < MPI_THREAD_MULTIPLE)
+        {
+            warn("MPI does not support MPI_THREAD_MULTIPLE, the postprocess plugins will run on the main thread");
+            threaded = false;
+        }
+    }
+
+    // the workers keep pointers into the costs
+    costs.resize(plugins.size());
+
+    for (int i = 0; i < plugins.size(); i++)
+    {
+        auto& pl = plugins[i];
         debug("Setup and handshake of %s", pl->name.c_str());
-        pl->setup(comm, interComm);
+
+        // the collectives of concurrent plugins must not mix
+        MPI_Comm pluginComm = comm;
+        if (threaded)
+        {
+            MPI_Check( MPI_Comm_dup(comm, &pluginComm) );
+            pluginComms.push_back(pluginComm);
+        }
+
+        pl->setup(pluginComm, interComm);
         pl->handshake();
+
+        if (threaded)
+            workers.push_back(std::make_unique<Worker>(pl.get(), &costs[i]));
+    }
+
+    if (threaded)
+        info("Postprocess executes the messages of %d plugins on as many threads", (int) plugins.size());
+}
+
+void Postprocess::_execute(int index, MPI_Status& status)
+{
+    auto& pl = plugins[index];
+
+    if (!threaded)
+    {
+        pl->recv();
+
+        mTimer timer;
+        timer.start();
+        pl->deserialize(status);
+
+        costs[index].time += timer.elapsed();
+        costs[index].messages++;
+        return;
+    }
+
+    std::vector<char> buffer;
+    pl->recv(buffer);
+    workers[index]->push(std::move(buffer), status);
+}
+
+void Postprocess::_execute(int index, const char *ptr, int size, MPI_Status& status)
+{
+    auto& pl = plugins[index];
+
+    if (!threaded)
+    {
+        mTimer timer;
+        timer.start();
+
+        pl->setReceivedData(ptr, size);
+        pl->deserialize(status);
+
+        costs[index].time += timer.elapsed();
+        costs[index].messages++;
+        return;
     }
+
+    workers[index]->push(std::vector<char>(ptr, ptr + size), status);
+}
+
+void Postprocess::_waitWorkers()
+{
+    for (auto& worker : workers)
+        worker->wait();
+}
+
+void Postprocess::_reportCosts() const
+{
+    // the slowest rank counts, as for the simulation plugins
+    std::vector<double> times(costs.size());
+    for (int i = 0; i < costs.size(); i++)
+        times[i] = costs[i].time;
+
+    MPI_Check( MPI_Allreduce(MPI_IN_PLACE, times.data(), times.size(), MPI_DOUBLE, MPI_MAX, comm) );
+
+    int rank;
+    MPI_Check( MPI_Comm_rank(comm, &rank) );
+    if (rank != 0) return;
+
+    std::string summary;
+    char line[256];
+    for (int i = 0; i < costs.size(); i++)
+    {
+        snprintf(line, sizeof(line), "\n    %-32s %10.1f ms  %8lld messages",
+                 plugins[i]->name.c_str(), times[i], costs[i].messages);
+        summary += line;
+    }
+
+    info("Postprocess plugins executed their messages in, on the slowest rank:%s", summary.c_str());
 }
 
 std::vector<int> findGloballyReady(std::vector<MPI_Request>& requests, std::vector<MPI_Status>& statuses, MPI_Comm comm)
@@ -62,6 +283,12 @@ void Postprocess::run()
     MPI_Request endReq;
     MPI_Check( MPI_Irecv(&dummy, 1, MPI_INT, rank, tag, interComm, &endReq) );
 
+    if (batched)
+    {
+        _runBatched(endReq, dummy);
+        return;
+    }
+
     std::vector<MPI_Request> requests;
     for (auto& pl : plugins)
         requests.push_back(pl->waitData());
@@ -85,14 +312,72 @@ void Postprocess::run()
                 for (int i=0; i<plugins.size(); i++)
                     MPI_Check( MPI_Cancel(requests.data() + i) );
                 
+                _waitWorkers();
+                _reportCosts();
                 return;
             }
         
             debug2("Postprocess got a request from plugin '%s', executing now", plugins[index]->name.c_str());
-            plugins[index]->recv();
-            plugins[index]->deserialize(statuses[index]);
+            _execute(index, statuses[index]);
             requests[index] = plugins[index]->waitData();
         }
     }
 }
 
+void Postprocess::_runBatched(MPI_Request endReq, const int& dummy)
+{
+    int rank;
+    MPI_Check( MPI_Comm_rank(comm, &rank) );
+
+    std::map<std::string, int> pluginsByName;
+    for (int i = 0; i < plugins.size(); i++)
+        pluginsByName[plugins[i]->name] = i;
+
+    int batchSize;
+    std::vector<char> batch;
+
+    auto waitBatch = [&] () {
+        MPI_Request req;
+        MPI_Check( MPI_Irecv(&batchSize, 1, MPI_INT, rank, BatchedSender::sizeTag, interComm, &req) );
+        return req;
+    };
+
+    std::vector<MPI_Request> requests = {waitBatch(), endReq};
+    std::vector<MPI_Status> statuses(requests.size());
+
+    info("Postprocess is listening to batches of messages now");
+    while (true)
+    {
+        auto readyIds = findGloballyReady(requests, statuses, comm);
+
+        for (auto index : readyIds)
+        {
+            if (index == 1)
+            {
+                if (dummy != -1)
+                    die("Something went terribly wrong");
+
+                info("Postprocess got a stopping message and will stop now");
+                MPI_Check( MPI_Cancel(requests.data()) );
+                _waitWorkers();
+                _reportCosts();
+                return;
+            }
+
+            batch.resize(batchSize);
+            MPI_Status status;
+            MPI_Check( MPI_Recv(batch.data(), batchSize, MPI_BYTE, rank, BatchedSender::dataTag, interComm, &status) );
+
+            forEachBatchedMessage(batch, [&] (const std::string& name, const char *ptr, int size) {
+                auto it = pluginsByName.find(name);
+                if (it == pluginsByName.end())
+                    die("Postprocess got a message for an unknown plugin '%s'", name.c_str());
+
+                debug2("Postprocess got a batched message from plugin '%s', executing now", name.c_str());
+                _execute(it->second, ptr, size, status);
+            });
+
+            requests[0] = waitBatch();
+        }
+    }
+}
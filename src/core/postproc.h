@@ -4,6 +4,17 @@
 #include <plugins/interface.h>
 #include <memory>
 
+/**
+ * Receives the messages of the simulation plugins and executes their postprocess side.
+ *
+ * In the threaded mode, every plugin deserializes and writes its messages on its own
+ * worker thread and its own duplicate of the communicator, such that the dumps of
+ * different plugins proceed concurrently while the collectives of each plugin keep
+ * the same order on all the ranks. The main thread only receives the messages;
+ * it blocks when a plugin is several messages behind, which brings the back-pressure
+ * to the simulation as without threads. The threaded mode needs MPI_THREAD_MULTIPLE,
+ * the messages are executed by the main thread when the MPI library does not provide it.
+ */
 class Postprocess
 {
 private:
@@ -12,11 +23,46 @@ private:
     std::vector< std::shared_ptr<PostprocessPlugin> > plugins;
     std::vector<MPI_Request> requests;
 
+    /// the messages of the plugins come in batches, see BatchedSender
+    bool batched{false};
+
+    bool threaded{false};
+    struct Worker;
+    std::vector< std::unique_ptr<Worker> > workers;
+    std::vector<MPI_Comm> pluginComms;
+
+    /// time spent executing the messages of every plugin, logged at the end of the run
+    struct Cost
+    {
+        double time {0};   ///< ms
+        long long messages {0};
+    };
+    std::vector<Cost> costs;
+
+    void _reportCosts() const;
+
+    void _runBatched(MPI_Request endReq, const int& dummy);
+
+    /// execute the message of plugin \p index that is announced by its waitData()
+    void _execute(int index, MPI_Status& status);
+
+    /// execute a message of plugin \p index taken from a batch
+    void _execute(int index, const char *ptr, int size, MPI_Status& status);
+
+    /// block until the workers executed all their messages
+    void _waitWorkers();
+
 public:
     Postprocess(MPI_Comm& comm, MPI_Comm& interComm);
+    ~Postprocess();
+
     void registerPlugin( std::shared_ptr<PostprocessPlugin> plugin );
     void run();
     void init();
+    void setBatchedMessages(bool enabled);
+
+    /// execute the messages of every plugin on its own thread, see the class description
+    void setThreaded(bool enabled);
     
     // TODO complete this
 //     void restart   (std::string folder);
@@ -0,0 +1,269 @@
+#include "checkpoint_writer.h"
+#include "restart_helpers.h"
+
+#include <core/logger.h>
+#include <core/utils/cuda_common.h>
+#include <core/utils/folders.h>
+#include <core/xdmf/xdmf.h>
+
+#include <cstdio>
+#include <fstream>
+#include <random>
+
+namespace CheckpointHelpers
+{
+void writeEntry(const CheckpointEntry& entry, MPI_Comm comm)
+{
+    XDMF::write(entry.filename, entry.grid.get(), entry.channels, comm);
+    RestartHelpers::make_symlink(comm, entry.path, entry.linkName, entry.filename);
+
+    if (!entry.indexBlocks.empty())
+    {
+        const long long localOffset = entry.grid->getGridDims()->getOffsets()[0];
+        SpatialIndex::write(entry.filename + ".index", comm, entry.domain, entry.indexBlocks, localOffset);
+        RestartHelpers::make_symlink(comm, entry.path, entry.linkName, entry.filename, ".index");
+    }
+}
+
+void writeManifest(MPI_Comm comm, std::string path, const std::map<std::string, std::string>& links)
+{
+    int rank;
+    MPI_Check( MPI_Comm_rank(comm, &rank) );
+    if (rank != 0) return;
+
+    // write aside and rename, such that the manifest is never partially written
+    const std::string fname = path + "/" + RestartHelpers::manifestName;
+    const std::string tmpName = fname + ".tmp";
+    {
+        std::ofstream fout(tmpName);
+        for (auto& link : links)
+            fout << link.first << " " << relativePath(link.second) << "\n";
+    }
+
+    if (std::rename(tmpName.c_str(), fname.c_str()) != 0)
+        error("Could not write the checkpoint manifest '%s'", fname.c_str());
+}
+
+static void fnv1a(unsigned long long& hash, const void *data, size_t bytes)
+{
+    auto ptr = (const unsigned char*) data;
+    for (size_t i = 0; i < bytes; i++)
+    {
+        hash ^= ptr[i];
+        hash *= 1099511628211ull;
+    }
+}
+
+unsigned long long hashEntry(const CheckpointEntry& entry)
+{
+    unsigned long long hash = 14695981039346656037ull;
+
+    auto dims = entry.grid->getGridDims();
+    size_t n = 1;
+    for (auto d : dims->getLocalSize()) n *= d;
+    fnv1a(hash, &n, sizeof(n));
+
+    if (auto vertexGrid = dynamic_cast<const XDMF::VertexGrid*>(entry.grid.get()))
+    {
+        auto positions = vertexGrid->getPositions();
+        fnv1a(hash, positions->data(), positions->size() * sizeof(float));
+    }
+
+    for (auto& channel : entry.channels)
+    {
+        fnv1a(hash, channel.name.data(), channel.name.size());
+        fnv1a(hash, channel.data, n * channel.nComponents() * channel.precision());
+    }
+
+    return hash;
+}
+
+bool stageEntry(const CheckpointEntry& entry, std::string folder)
+{
+    auto grid = entry.grid->makeSubfileGrid(MPI_COMM_SELF);
+    if (!grid) return false;
+
+    XDMF::write(folder + relativePath(entry.filename), grid.get(), entry.channels, MPI_COMM_SELF);
+    return true;
+}
+} // namespace CheckpointHelpers
+
+CheckpointWriter::CheckpointWriter(MPI_Comm comm, bool async, XDMF::Compression compression, bool incremental) :
+    async(async),
+    compression(compression),
+    incremental(incremental)
+{
+    if (async)
+    {
+        int provided;
+        MPI_Check( MPI_Query_thread(&provided) );
+
+        if (provided < MPI_THREAD_MULTIPLE)
+        {
+            warn("MPI does not support MPI_THREAD_MULTIPLE, checkpoints will be written synchronously");
+            this->async = false;
+        }
+    }
+
+    // the I/O thread must not mix its collectives with the ones of the simulation
+    MPI_Check( MPI_Comm_dup(comm, &this->comm) );
+
+    int leastPriority, greatestPriority;
+    CUDA_Check( cudaDeviceGetStreamPriorityRange(&leastPriority, &greatestPriority) );
+    CUDA_Check( cudaStreamCreateWithPriority(&downloadStream, cudaStreamNonBlocking, leastPriority) );
+}
+
+CheckpointWriter::~CheckpointWriter()
+{
+    wait();
+
+    CUDA_Check( cudaStreamDestroy(downloadStream) );
+    MPI_Check( MPI_Comm_free(&comm) );
+}
+
+bool CheckpointWriter::changed(CheckpointEntry& entry)
+{
+    const auto hash = hashEntry(entry);
+
+    auto it = versions.find(entry.linkName);
+    int localChanged = (it == versions.end() || it->second.hash != hash);
+    int globalChanged;
+    MPI_Check( MPI_Allreduce(&localChanged, &globalChanged, 1, MPI_INT, MPI_LOR, comm) );
+
+    if (globalChanged)
+    {
+        // never overwrite the version that is referenced, whatever the name given by the particle vector
+        if (it != versions.end() && it->second.filename == entry.filename)
+            entry.filename += "-alt";
+
+        versions[entry.linkName] = {entry.filename, hash};
+    }
+
+    return globalChanged;
+}
+
+void CheckpointWriter::add(CheckpointEntry&& entry)
+{
+    for (auto& channel : entry.channels)
+        channel.compression = compression;
+
+    if (!incremental)
+        versions[entry.linkName] = {entry.filename, 0};
+    else if (!changed(entry))
+    {
+        debug("Checkpoint file of '%s' did not change, keeping version %s",
+              entry.linkName.c_str(), versions[entry.linkName].filename.c_str());
+        return;
+    }
+
+    pending.push_back(std::move(entry));
+}
+
+void CheckpointWriter::flush()
+{
+    wait();
+
+    std::map<std::string, std::string> links;
+    std::string path;
+    for (auto& version : versions)
+        links[version.first] = version.second.filename;
+    for (auto& entry : pending)
+        path = entry.path;
+
+    if (!stagingFolder.empty() && !pending.empty())
+        stage(path, links);
+
+    if (!async)
+    {
+        for (auto& entry : pending)
+            CheckpointHelpers::writeEntry(entry, comm);
+        if (!pending.empty())
+            CheckpointHelpers::writeManifest(comm, path, links);
+        pending.clear();
+        return;
+    }
+
+    auto entries = std::make_shared<std::vector<CheckpointEntry>>(std::move(pending));
+    pending.clear();
+
+    if (entries->empty()) return;
+
+    debug("Writing %d checkpoint files in the background", (int) entries->size());
+
+    MPI_Comm ioComm = comm;
+    worker = std::thread([entries, ioComm, path, links] () {
+        for (auto& entry : *entries)
+            CheckpointHelpers::writeEntry(entry, ioComm);
+        CheckpointHelpers::writeManifest(ioComm, path, links);
+    });
+}
+
+void CheckpointWriter::wait()
+{
+    if (worker.joinable())
+        worker.join();
+}
+
+void CheckpointWriter::setStaging(std::string folder)
+{
+    stagingFolder = folder;
+}
+
+void CheckpointWriter::stage(std::string path, const std::map<std::string, std::string>& links)
+{
+    int rank;
+    MPI_Check( MPI_Comm_rank(comm, &rank) );
+    const std::string folder = RestartHelpers::getStagedFolder(stagingFolder, rank);
+
+    // a new identifier for every checkpoint, such that restarts never take the staged files of another one
+    unsigned long long id = 0;
+    if (rank == 0)
+    {
+        std::random_device rd;
+        id = ((unsigned long long) rd() << 32) | rd();
+    }
+    MPI_Check( MPI_Bcast(&id, 1, MPI_UNSIGNED_LONG_LONG, 0, comm) );
+
+    int good = createFoldersCollective(MPI_COMM_SELF, folder);
+    for (auto& entry : pending)
+        good = good && CheckpointHelpers::stageEntry(entry, folder);
+
+    // write aside and rename, such that the manifest only lists complete files
+    if (good)
+    {
+        const std::string fname = folder + RestartHelpers::stagedManifestName;
+        const std::string tmpName = fname + ".tmp";
+        {
+            std::ofstream fout(tmpName);
+            fout << id << "\n";
+            for (auto& link : links)
+                fout << link.first << " " << relativePath(link.second) << "\n";
+        }
+        good = std::rename(tmpName.c_str(), fname.c_str()) == 0;
+    }
+
+    int allGood;
+    MPI_Check( MPI_Allreduce(&good, &allGood, 1, MPI_INT, MPI_LAND, comm) );
+
+    if (!allGood)
+        warn("Could not stage the checkpoint in '%s' on every rank, restarts will read the checkpoint folder",
+             stagingFolder.c_str());
+
+    if (rank != 0) return;
+
+    const std::string record = path + "/" + RestartHelpers::stagingRecordName;
+    if (!allGood)
+    {
+        std::remove(record.c_str());
+        return;
+    }
+
+    const std::string tmpRecord = record + ".tmp";
+    {
+        std::ofstream fout(tmpRecord);
+        fout << stagingFolder << " " << id << "\n";
+    }
+
+    if (std::rename(tmpRecord.c_str(), record.c_str()) != 0)
+        error("Could not write the checkpoint staging record '%s'", record.c_str());
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include "spatial_index.h"
+
+#include <core/domain.h>
+#include <core/xdmf/grids.h>
+
+#include <cuda_runtime.h>
+#include <map>
+#include <memory>
+#include <mpi.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// One XDMF file, owning the memory its channels point to
+struct CheckpointEntry
+{
+    std::string filename;  ///< without extension
+    std::string path;      ///< folder of the symlink
+    std::string linkName;  ///< name of the symlink to the file, see RestartHelpers::make_symlink
+
+    std::unique_ptr<XDMF::Grid> grid;
+    std::vector<XDMF::Channel> channels;
+
+    /// local blocks of the spatial index of the particles, no index if empty, see SpatialIndex
+    std::vector<SpatialIndex::Block> indexBlocks;
+    DomainInfo domain;
+
+    /// keep \p data alive until the file is written and return its pointer for a channel
+    template<typename T>
+    T* keep(std::vector<T>&& data)
+    {
+        auto ptr = std::make_shared<std::vector<T>>(std::move(data));
+        storage.push_back(ptr);
+        return ptr->data();
+    }
+
+    /// keep a copy of \p n elements of \p data
+    template<typename T>
+    T* keepCopy(const T *data, int n)
+    {
+        return keep(std::vector<T>(data, data + n));
+    }
+
+    /// keep a copy of the elements of \p data taken in \p order
+    template<typename T>
+    T* keepPermuted(const T *data, const std::vector<int>& order)
+    {
+        std::vector<T> permuted(order.size());
+        for (size_t i = 0; i < order.size(); i++)
+            permuted[i] = data[order[i]];
+        return keep(std::move(permuted));
+    }
+
+private:
+    std::vector<std::shared_ptr<void>> storage;
+};
+
+/**
+ * Writes the XDMF checkpoint files of the particle vectors.
+ *
+ * The particle vectors download their data on the low priority stream()
+ * and give a host copy of it to add(); flush() then writes all the files added
+ * since the last flush. In the asynchronous mode the files are written
+ * by a background thread on a duplicate of the communicator and flush()
+ * returns right away, such that the simulation proceeds while the data goes
+ * to the disk. At most one checkpoint is in flight: the next flush(),
+ * wait() or the destructor first wait for the previous one to complete.
+ *
+ * The asynchronous mode needs MPI_THREAD_MULTIPLE, the writer falls back
+ * to writing synchronously when the MPI library does not provide it.
+ *
+ * In the incremental mode, the files identical to the version written
+ * at a previous checkpoint (e.g. frozen wall particles) are not written again:
+ * the link and the manifest keep referring to that version.
+ * The manifest (see RestartHelpers::getCheckpointFile()) lists the file
+ * of every link; it is updated once all the files of a checkpoint are written,
+ * such that it always refers to complete files
+ *
+ * In the staging mode (see setStaging()), flush() first writes every file of the checkpoint
+ * per rank into a node-local folder, synchronously but at the speed of the local disk,
+ * then drains the checkpoint to the checkpoint folder as usual, in the background
+ * in the asynchronous mode. Restarts read the staged files when every rank finds them,
+ * see RestartHelpers::getCheckpointSource()
+ */
+class CheckpointWriter
+{
+public:
+    /// the channels of all the files are written with \p compression
+    CheckpointWriter(MPI_Comm comm, bool async, XDMF::Compression compression = XDMF::Compression(),
+                     bool incremental = false);
+    ~CheckpointWriter();
+
+    bool isAsync() const { return async; }
+    cudaStream_t stream() const { return downloadStream; }
+
+    /// add a file to the current checkpoint
+    void add(CheckpointEntry&& entry);
+
+    /// write all the added files, in the background in the asynchronous mode
+    void flush();
+
+    /// block until the checkpoint in flight is on the disk
+    void wait();
+
+    /// also write the files per rank into the node-local \p folder, before the checkpoint folder
+    void setStaging(std::string folder);
+
+private:
+    MPI_Comm comm;
+    bool async;
+    XDMF::Compression compression;
+    cudaStream_t downloadStream;
+
+    bool incremental;
+
+    /// last version written for each link
+    struct Version
+    {
+        std::string filename;
+        unsigned long long hash;
+    };
+    std::map<std::string, Version> versions;
+
+    std::vector<CheckpointEntry> pending;
+    std::thread worker;
+
+    /// decide collectively whether the file of \p entry changed since its last version
+    bool changed(CheckpointEntry& entry);
+
+    /// node-local folder of the staged files, no staging if empty
+    std::string stagingFolder;
+
+    /// collectively write the pending files into the staging folder and record it in the checkpoint folder \p path
+    void stage(std::string path, const std::map<std::string, std::string>& links);
+};
+
+namespace CheckpointHelpers
+{
+/// write the file of \p entry now on \p comm, and its symlink
+void writeEntry(const CheckpointEntry& entry, MPI_Comm comm);
+
+/// on the master rank of \p comm, write the manifest of folder \p path with the files of \p links
+void writeManifest(MPI_Comm comm, std::string path, const std::map<std::string, std::string>& links);
+
+/// hash of the local data of \p entry: its channels and the positions of vertex grids
+unsigned long long hashEntry(const CheckpointEntry& entry);
+
+/// write the local data of \p entry alone into \p folder, false if its grid cannot be written per rank
+bool stageEntry(const CheckpointEntry& entry, std::string folder);
+}
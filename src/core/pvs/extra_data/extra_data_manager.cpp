@@ -59,6 +59,26 @@ int ExtraDataManager::shiftTypeSize(const std::string& name) const
     return desc.shiftTypeSize;
 }
 
+void ExtraDataManager::setOwner(const std::string& owner)
+{
+    this->owner = owner;
+
+    for (auto& entry : channelMap)
+        entry.second.container->setOwner(owner + ":" + entry.first);
+
+    channelSizes     .setOwner(owner + ":packer");
+    channelShiftTypes.setOwner(owner + ":packer");
+    channelPtrs      .setOwner(owner + ":packer");
+}
+
+std::vector<GPUcontainer*> ExtraDataManager::getContainers() const
+{
+    std::vector<GPUcontainer*> containers;
+    for (auto& entry : channelMap)
+        containers.push_back(entry.second.container.get());
+    return containers;
+}
+
 void ExtraDataManager::resize(int n, cudaStream_t stream)
 {
     for (auto& kv : channelMap)
@@ -72,6 +72,7 @@ public:
         info("Creating new channel '%s'", name.c_str());
 
         auto ptr = std::make_unique< PinnedBuffer<T> >(size);
+        ptr->setOwner(owner + ":" + name);
         channelMap[name].container = std::move(ptr);
         channelMap[name].dataType  = typeTokenize<T>();
 
@@ -160,6 +161,15 @@ public:
      */
     int shiftTypeSize(const std::string& name) const;
 
+    /**
+     * Account the memory of all the channels in the MemoryPool
+     * under the name "<owner>:<channel name>"
+     */
+    void setOwner(const std::string& owner);
+
+    /// @return containers of all the channels, e.g. to apply a ShrinkPolicy
+    std::vector<GPUcontainer*> getContainers() const;
+
     /// Resize all the channels, keep their data
     void resize(int n, cudaStream_t stream);
 
@@ -186,6 +196,9 @@ private:
      */
     std::vector<NamedChannelDesc> sortedChannels;
 
+    /// Prefix of the memory owner of the channels
+    std::string owner{"unnamed"};
+
     /// Helper buffers, used by a Packer
     PinnedBuffer<int>   channelSizes, channelShiftTypes;
 
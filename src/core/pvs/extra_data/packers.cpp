@@ -28,6 +28,16 @@ ParticleExtraPacker::ParticleExtraPacker(ParticleVector *pv, LocalParticleVector
     setAndUploadData(           manager,           needUpload, stream);
 }
 
+CompressedParticlePacker::CompressedParticlePacker(ParticleVector *pv, LocalParticleVector *lpv, PackPredicate predicate,
+                                                   float3 lo, float3 step, cudaStream_t stream) :
+    extra(pv, lpv, predicate, stream),
+    lo(lo), step(step)
+{
+    if (pv == nullptr || lpv == nullptr) return;
+
+    coosvels = reinterpret_cast<float4*>(lpv->coosvels.devPtr());
+    packedSize_byte = sizeof(uint4) + extra.packedSize_byte;
+}
 
 ObjectExtraPacker::ObjectExtraPacker(ObjectVector* ov, LocalObjectVector* lov, PackPredicate predicate, cudaStream_t stream)
 {
@@ -5,6 +5,10 @@
 #include <core/pvs/particle_vector.h>
 #include <core/pvs/object_vector.h>
 
+#ifdef __CUDACC__
+#include <core/utils/quantization.h>
+#endif
+
 /**
  * Class that uses DevicePacker to pack a single particle entity; always pack coordinates and velocities
  */
@@ -21,6 +25,50 @@ struct ParticleExtraPacker : public DevicePacker
     ParticleExtraPacker(ParticleVector *pv, LocalParticleVector *lpv, PackPredicate predicate, cudaStream_t stream);
 };
 
+/**
+ * Pack a single particle entity with coordinates and velocities compressed
+ * into 16 bytes (see quantization.h), followed by the extra channels as ParticleExtraPacker.
+ *
+ * Coordinates are quantized on the grid of spacing \c step starting at \c lo,
+ * after the shift: all the packed particles must lie in the grid box, others are clamped to it.
+ * The compression is lossy and drops Particle::i2, only meant for data the receiver
+ * can tolerate approximately, e.g. halo particles
+ */
+struct CompressedParticlePacker
+{
+    float4 *coosvels = nullptr;
+    ParticleExtraPacker extra;
+    float3 lo, step;
+    int packedSize_byte = 0;
+
+    CompressedParticlePacker(ParticleVector *pv, LocalParticleVector *lpv, PackPredicate predicate,
+                             float3 lo, float3 step, cudaStream_t stream);
+
+#ifdef __CUDACC__
+    inline __device__ void packShift(int srcId, char *dstAddr, float3 shift) const
+    {
+        Particle p(coosvels, srcId);
+        p.r += shift;
+
+        *((uint4*) dstAddr) = compressParticle(p, lo, step);
+        extra.packShift(srcId, dstAddr + sizeof(uint4), shift);
+    }
+
+    inline __device__ void unpack(const char *srcAddr, int dstId) const
+    {
+        const uint4 c = *((const uint4*) srcAddr);
+
+        Particle p;
+        p.r  = decompressCoordinates(c, lo, step);
+        p.u  = decompressVelocity(c);
+        p.i1 = c.w;
+        p.i2 = 0;
+        p.write2Float4(coosvels, dstId);
+
+        extra.unpack(srcAddr + sizeof(uint4), dstId);
+    }
+#endif /* __CUDACC__ */
+};
 
 /**
  * Class that uses DevicePacker to pack extra data per object
@@ -1,11 +1,17 @@
 #include "object_vector.h"
+#include "extra_data/packers.h"
 #include "views/ov.h"
 
 #include <core/utils/kernel_launch.h>
 #include <core/utils/cuda_common.h>
 #include <core/utils/folders.h>
+#include <core/utils/make_unique.h>
+#include <core/utils/morton.h>
 #include <core/xdmf/xdmf.h>
 
+#include <extern/cub/cub/device/device_radix_sort.cuh>
+
+#include "checkpoint_writer.h"
 #include "restart_helpers.h"
 
 namespace ObjectVectorKernels
@@ -42,6 +48,44 @@ __global__ void minMaxCom(OVview ovView)
         ovView.comAndExtents[objId] = {mycom / ovView.objSize, mymin, mymax};
 }
 
+__global__ void computeObjectKeys(OVview ovView, float3 lo, float3 invSpan, unsigned int *keys, int *ids)
+{
+    const int objId = threadIdx.x + blockDim.x * blockIdx.x;
+    if (objId >= ovView.nObjects) return;
+
+    const float3 c = (ovView.comAndExtents[objId].com - lo) * invSpan;
+
+    keys[objId] = Morton::code(c);
+    ids [objId] = objId;
+}
+
+/// One block per object, the object order[i] goes to the place i of the buffer
+__global__ void packInOrder(OVview ovView, ObjectPacker packer, const int *order, char *buffer)
+{
+    const int dstObjId = blockIdx.x;
+    const int srcObjId = order[dstObjId];
+
+    char *dstAddr = buffer + packer.totalPackedSize_byte * dstObjId;
+
+    for (int pid = threadIdx.x; pid < ovView.objSize; pid += blockDim.x)
+        packer.part.pack(srcObjId * ovView.objSize + pid, dstAddr + pid * packer.part.packedSize_byte);
+
+    dstAddr += ovView.objSize * packer.part.packedSize_byte;
+    if (threadIdx.x == 0) packer.obj.pack(srcObjId, dstAddr);
+}
+
+__global__ void unpackObjects(OVview ovView, ObjectPacker packer, const char *buffer)
+{
+    const int objId = blockIdx.x;
+    const char *srcAddr = buffer + packer.totalPackedSize_byte * objId;
+
+    for (int pid = threadIdx.x; pid < ovView.objSize; pid += blockDim.x)
+        packer.part.unpack(srcAddr + pid * packer.part.packedSize_byte, objId * ovView.objSize + pid);
+
+    srcAddr += ovView.objSize * packer.part.packedSize_byte;
+    if (threadIdx.x == 0) packer.obj.unpack(srcAddr, objId);
+}
+
 } // namespace ObjectVectorKernels
 
 void ObjectVector::findExtentAndCOM(cudaStream_t stream, ParticleVectorType type)
@@ -49,7 +93,7 @@ void ObjectVector::findExtentAndCOM(cudaStream_t stream, ParticleVectorType type
     bool isLocal = (type == ParticleVectorType::Local);
     auto lov = isLocal ? local() : halo();
 
-    if (lov->comExtentValid)
+    if (lov->comExtentStamp == cellListStamp)
     {
         debug("COM and extent computation for %s OV '%s' skipped",
               isLocal ? "local" : "halo", name.c_str());
@@ -64,6 +108,67 @@ void ObjectVector::findExtentAndCOM(cudaStream_t stream, ParticleVectorType type
             ObjectVectorKernels::minMaxCom,
             (ovView.nObjects*32 + nthreads-1)/nthreads, nthreads, 0, stream,
             ovView );
+
+    lov->comExtentStamp = cellListStamp;
+}
+
+void ObjectVector::reorderObjects(cudaStream_t stream)
+{
+    auto lov = local();
+    const int n = lov->nObjects;
+    if (n < 2) return;
+
+    debug("Reordering the %d local objects of '%s' along the Morton curve", n, name.c_str());
+
+    findExtentAndCOM(stream, ParticleVectorType::Local);
+
+    OVview ovView(this, lov);
+    const int nthreads = 128;
+
+    reorderKeys       .resize_anew(n);
+    reorderSortedKeys .resize_anew(n);
+    reorderIds        .resize_anew(n);
+    reorderSortedIds  .resize_anew(n);
+
+    const float3 lo = -0.5f * state->domain.localSize;
+
+    SAFE_KERNEL_LAUNCH(
+            ObjectVectorKernels::computeObjectKeys,
+            getNblocks(n, nthreads), nthreads, 0, stream,
+            ovView, lo, 1.0f / state->domain.localSize, reorderKeys.devPtr(), reorderIds.devPtr() );
+
+    // stable: objects with the same key keep their relative order
+    size_t bufSize = 0;
+    cub::DeviceRadixSort::SortPairs(nullptr, bufSize,
+                                    reorderKeys.devPtr(), reorderSortedKeys.devPtr(),
+                                    reorderIds.devPtr(), reorderSortedIds.devPtr(), n, 0, Morton::nbits, stream);
+    reorderSortBuffer.resize_anew(bufSize);
+    cub::DeviceRadixSort::SortPairs(reorderSortBuffer.devPtr(), bufSize,
+                                    reorderKeys.devPtr(), reorderSortedKeys.devPtr(),
+                                    reorderIds.devPtr(), reorderSortedIds.devPtr(), n, 0, Morton::nbits, stream);
+
+    // all the channels, the global ids of the objects among them
+    auto all = [] (const ExtraDataManager::NamedChannelDesc&) { return true; };
+    ObjectPacker packer(this, lov, all, stream);
+
+    reorderPackBuffer.resize_anew((size_t) n * packer.totalPackedSize_byte);
+
+    SAFE_KERNEL_LAUNCH(
+            ObjectVectorKernels::packInOrder,
+            n, nthreads, 0, stream,
+            ovView, packer, reorderSortedIds.devPtr(), reorderPackBuffer.devPtr() );
+
+    SAFE_KERNEL_LAUNCH(
+            ObjectVectorKernels::unpackObjects,
+            n, nthreads, 0, stream,
+            ovView, packer, reorderPackBuffer.devPtr() );
+
+    // same particles at other places
+    haloValid = false;
+    cellListStamp++;
+
+    // the centers of mass and extents were permuted with the objects
+    lov->comExtentStamp = cellListStamp;
 }
 
 void ObjectVector::_getRestartExchangeMap(MPI_Comm comm, const std::vector<Particle> &parts, std::vector<int>& map)
@@ -100,10 +205,10 @@ std::vector<int> ObjectVector::_restartParticleData(MPI_Comm comm, std::string p
 {
     CUDA_Check( cudaDeviceSynchronize() );
 
-    std::string filename = path + "/" + name + ".xmf";
-    info("Restarting object vector %s from file %s", name.c_str(), filename.c_str());
+    auto source = RestartHelpers::getCheckpointSource(comm, path, name);
+    info("Restarting object vector %s from file %s", name.c_str(), source.filename.c_str());
 
-    XDMF::readParticleData(filename, comm, this, objSize);
+    XDMF::readParticleData(source.filename, source.comm, this, objSize);
 
     std::vector<Particle> parts(local()->size());
     std::copy(local()->coosvels.begin(), local()->coosvels.end(), parts.begin());
@@ -142,48 +247,47 @@ static void splitCom(DomainInfo domain, const PinnedBuffer<LocalObjectVector::CO
     }
 }
 
-void ObjectVector::_extractPersistentExtraObjectData(std::vector<XDMF::Channel>& channels, const std::set<std::string>& blackList)
+void ObjectVector::_extractPersistentExtraObjectData(CheckpointEntry& entry, const std::set<std::string>& blackList)
 {
     auto& extraData = local()->extraPerObject;
-    _extractPersistentExtraData(extraData, channels, blackList);
+    _extractPersistentExtraData(extraData, entry, blackList);
 }
 
 void ObjectVector::_checkpointObjectData(MPI_Comm comm, std::string path)
 {
     CUDA_Check( cudaDeviceSynchronize() );
 
-    std::string filename = path + "/" + name + ".obj-" + getStrZeroPadded(restartIdx);
-    info("Checkpoint for object vector '%s', writing to file %s", name.c_str(), filename.c_str());
+    CheckpointEntry entry;
+    entry.filename = path + "/" + name + ".obj-" + getStrZeroPadded(restartIdx);
+    entry.path     = path;
+    entry.linkName = name + ".obj";
+    info("Checkpoint for object vector '%s', writing to file %s", name.c_str(), entry.filename.c_str());
 
     auto coms_extents = local()->extraPerObject.getData<LocalObjectVector::COMandExtent>(ChannelNames::comExtents);
 
-    coms_extents->downloadFromDevice(0, ContainersSynch::Synch);
+    coms_extents->downloadFromDevice(_checkpointStream(), ContainersSynch::Synch);
     
     auto positions = std::make_shared<std::vector<float>>();
 
     splitCom(state->domain, *coms_extents, *positions);
 
-    XDMF::VertexGrid grid(positions, comm);
+    entry.grid = std::make_unique<XDMF::VertexGrid>(positions, comm);
 
-    std::vector<XDMF::Channel> channels;
-
-    _extractPersistentExtraObjectData(channels);
+    _extractPersistentExtraObjectData(entry);
     
-    XDMF::write(filename, &grid, channels, comm);
-
-    RestartHelpers::make_symlink(comm, path, name + ".obj", filename);
+    _writeCheckpointEntry(std::move(entry), comm);
 
-    debug("Checkpoint for object vector '%s' successfully written", name.c_str());
+    debug("Checkpoint for object vector '%s' successfully taken", name.c_str());
 }
 
 void ObjectVector::_restartObjectData(MPI_Comm comm, std::string path, const std::vector<int>& map)
 {
     CUDA_Check( cudaDeviceSynchronize() );
 
-    std::string filename = path + "/" + name + ".obj.xmf";
-    info("Restarting object vector %s from file %s", name.c_str(), filename.c_str());
+    auto source = RestartHelpers::getCheckpointSource(comm, path, name + ".obj");
+    info("Restarting object vector %s from file %s", name.c_str(), source.filename.c_str());
 
-    XDMF::readObjectData(filename, comm, this);
+    XDMF::readObjectData(source.filename, source.comm, this);
 
     auto loc_ids = local()->extraPerObject.getData<int>(ChannelNames::globalIds);
     
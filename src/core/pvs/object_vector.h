@@ -15,7 +15,11 @@ protected:
 public:
     int nObjects = 0;
 
-    bool comExtentValid = false;
+    /**
+     * #ChannelNames::comExtents is valid while this matches ParticleVector::cellListStamp,
+     * see ObjectVector::findExtentAndCOM(). Reset by any resize, the objects may have changed
+     */
+    int comExtentStamp{-1};
 
     ExtraDataManager extraPerObject;
 
@@ -40,6 +44,7 @@ public:
             die("Incorrect number of particles in object: given %d, must be a multiple of %d", np, objSize);
 
         nObjects = np / objSize;
+        comExtentStamp = -1;
         LocalParticleVector::resize(np, stream);
 
         extraPerObject.resize(nObjects, stream);
@@ -51,11 +56,26 @@ public:
             die("Incorrect number of particles in object");
 
         nObjects = np / objSize;
+        comExtentStamp = -1;
         LocalParticleVector::resize_anew(np);
 
         extraPerObject.resize_anew(nObjects);
     }
 
+    void setOwner(const std::string& owner) override
+    {
+        LocalParticleVector::setOwner(owner);
+        extraPerObject.setOwner(owner + ":objects");
+    }
+
+    std::vector<GPUcontainer*> getContainers() override
+    {
+        auto containers = LocalParticleVector::getContainers();
+        for (auto c : extraPerObject.getContainers())
+            containers.push_back(c);
+        return containers;
+    }
+
     virtual PinnedBuffer<Particle>* getMeshVertices(cudaStream_t stream)
     {
         return &coosvels;
@@ -100,8 +120,23 @@ public:
                       new LocalObjectVector(this, objSize, 0) )
     {}
 
+    /**
+     * Fill #ChannelNames::comExtents of the local or halo objects.
+     * Computed at most once per #cellListStamp: the integrators, redistributors and halo exchanges
+     * that move or replace the objects invalidate it, the integrators that already reduce over each
+     * object may provide it directly and set LocalObjectVector::comExtentStamp
+     */
     void findExtentAndCOM(cudaStream_t stream, ParticleVectorType type);
 
+    /**
+     * Sort the local objects along the Morton curve of their centers of mass within the subdomain,
+     * such that the objects close in space are close in memory.
+     * All the per-particle and per-object channels are permuted with the objects in one pack and one unpack,
+     * the global ids of #ChannelNames::globalIds included: the dumps keep identifying the objects.
+     * Invalidates the cell-lists of the object vector
+     */
+    void reorderObjects(cudaStream_t stream);
+
     LocalObjectVector* local() { return static_cast<LocalObjectVector*>(_local); }
     LocalObjectVector* halo()  { return static_cast<LocalObjectVector*>(_halo);  }
 
@@ -128,12 +163,19 @@ protected:
     void _getRestartExchangeMap(MPI_Comm comm, const std::vector<Particle> &parts, std::vector<int>& map) override;
     std::vector<int> _restartParticleData(MPI_Comm comm, std::string path) override;
 
-    void _extractPersistentExtraObjectData(std::vector<XDMF::Channel>& channels, const std::set<std::string>& blackList = {});
+    void _extractPersistentExtraObjectData(CheckpointEntry& entry, const std::set<std::string>& blackList = {});
+
+    /// the particles of an object must stay contiguous
+    bool _hasSpatialCheckpointIndex() const override { return false; }
     
     virtual void _checkpointObjectData(MPI_Comm comm, std::string path);
     virtual void _restartObjectData(MPI_Comm comm, std::string path, const std::vector<int>& map);
     
 private:
+    DeviceBuffer<unsigned int> reorderKeys, reorderSortedKeys;
+    DeviceBuffer<int> reorderIds, reorderSortedIds;
+    DeviceBuffer<char> reorderSortBuffer, reorderPackBuffer;
+
     template<typename T>
     void requireDataPerObject(LocalObjectVector* lov, std::string name, ExtraDataManager::PersistenceMode persistence, size_t shiftDataSize)
     {
@@ -0,0 +1,107 @@
+#include "particle_editor.h"
+
+#include "extra_data/packers.h"
+#include "particle_vector.h"
+
+#include <core/logger.h>
+#include <core/utils/cuda_common.h>
+#include <core/utils/kernel_launch.h>
+
+#include <extern/cub/cub/device/device_scan.cuh>
+
+namespace ParticleEditorKernels
+{
+
+__global__ void flagKept(int n, const float4 *coosvels, int *keep)
+{
+    const int pid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (pid > n) return;
+
+    // one more entry, such that the exclusive scan ends with the total
+    if (pid == n)
+    {
+        keep[pid] = 0;
+        return;
+    }
+
+    Particle p;
+    p.readCoordinate(coosvels, pid);
+    keep[pid] = p.isMarked() ? 0 : 1;
+}
+
+__global__ void packKept(int n, const int *keep, const int *offsets, ParticlePacker packer, char *buffer)
+{
+    const int pid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (pid >= n || !keep[pid]) return;
+
+    packer.pack(pid, buffer + offsets[pid] * packer.packedSize_byte);
+}
+
+__global__ void unpackKept(int n, const char *buffer, ParticlePacker packer)
+{
+    const int pid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (pid >= n) return;
+
+    packer.unpack(buffer + pid * packer.packedSize_byte, pid);
+}
+
+} // namespace ParticleEditorKernels
+
+int ParticleEditor::append(LocalParticleVector *lpv, int nNew, cudaStream_t stream)
+{
+    if (nNew < 0) die("Tried to append %d < 0 particles", nNew);
+
+    const int oldSize = lpv->size();
+    if (nNew > 0)
+        lpv->resize(oldSize + nNew, stream);
+
+    return oldSize;
+}
+
+int ParticleEditor::removeMarked(ParticleVector *pv, LocalParticleVector *lpv, PackPredicate predicate, cudaStream_t stream)
+{
+    const int n = lpv->size();
+    if (n == 0) return 0;
+
+    const int nthreads = 128;
+
+    keep   .resize_anew(n+1);
+    offsets.resize_anew(n+1);
+
+    SAFE_KERNEL_LAUNCH(
+            ParticleEditorKernels::flagKept,
+            getNblocks(n+1, nthreads), nthreads, 0, stream,
+            n, (const float4*) lpv->coosvels.devPtr(), keep.devPtr() );
+
+    size_t bufSize = 0;
+    cub::DeviceScan::ExclusiveSum(nullptr, bufSize, keep.devPtr(), offsets.devPtr(), n+1, stream);
+    scanBuffer.resize_anew(bufSize);
+    cub::DeviceScan::ExclusiveSum(scanBuffer.devPtr(), bufSize, keep.devPtr(), offsets.devPtr(), n+1, stream);
+
+    CUDA_Check( cudaMemcpyAsync(nKept.hostPtr(), offsets.devPtr() + n, sizeof(int), cudaMemcpyDeviceToHost, stream) );
+    CUDA_Check( cudaStreamSynchronize(stream) );
+
+    const int newSize = nKept[0];
+    if (newSize == n) return 0;
+
+    ParticlePacker packer(pv, lpv, predicate, stream);
+    packed.resize_anew(newSize * packer.packedSize_byte);
+
+    SAFE_KERNEL_LAUNCH(
+            ParticleEditorKernels::packKept,
+            getNblocks(n, nthreads), nthreads, 0, stream,
+            n, keep.devPtr(), offsets.devPtr(), packer, packed.devPtr() );
+
+    // shrinking keeps the storage, the packer is rebuilt anyway to not rely on it
+    lpv->resize(newSize, stream);
+    packer = ParticlePacker(pv, lpv, predicate, stream);
+
+    SAFE_KERNEL_LAUNCH(
+            ParticleEditorKernels::unpackKept,
+            getNblocks(newSize, nthreads), nthreads, 0, stream,
+            newSize, packed.devPtr(), packer );
+
+    debug2("Removed %d marked particles of pv '%s', %d left", n - newSize, pv->name.c_str(), newSize);
+
+    return n - newSize;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "extra_data/device_packer.h"
+
+#include <core/containers.h>
+#include <core/datatypes.h>
+
+class ParticleVector;
+class LocalParticleVector;
+
+/**
+ * Batched insertion and removal of the particles of a LocalParticleVector,
+ * shared by the plugins and walls that add or delete particles.
+ *
+ * Insertion appends at the end: the buffers grow by conservative capacity steps,
+ * such that a steady inflow does not reallocate at every step.
+ * Removal compacts the particles marked with Particle::mark() on the device:
+ * a scan of the kept flags gives the destination of every particle,
+ * the particles are packed with all the requested channels and unpacked in place.
+ * The order of the kept particles is preserved.
+ *
+ * The scratch buffers are kept between the calls, one editor per user
+ */
+class ParticleEditor
+{
+public:
+    /**
+     * Make room for \p nNew particles at the end of \p lpv, keeping the stored data.
+     * The new entries of all the channels are left undefined
+     * @return index of the first new particle
+     */
+    int append(LocalParticleVector *lpv, int nNew, cudaStream_t stream);
+
+    /**
+     * Remove the marked particles of \p lpv. The coordinates, velocities and the extra channels
+     * selected by \p predicate are moved with the kept particles, the other channels
+     * (e.g. forces) are left undefined. Downloads the new size: synchronizes \p stream.
+     * The caller invalidates the cell-lists and halo of \p pv
+     * @return number of removed particles
+     */
+    int removeMarked(ParticleVector *pv, LocalParticleVector *lpv, PackPredicate predicate, cudaStream_t stream);
+
+private:
+    DeviceBuffer<int> keep, offsets;
+    PinnedBuffer<int> nKept{1};
+    DeviceBuffer<char> scanBuffer, packed;
+};
@@ -1,11 +1,16 @@
+#include <cstdio>
 #include <mpi.h>
 
 #include <core/xdmf/typeMap.h>
 #include <core/utils/folders.h>
+#include <core/utils/make_unique.h>
 #include <core/xdmf/xdmf.h>
 
+#include "checkpoint_writer.h"
 #include "particle_vector.h"
+#include "raw_checkpoint.h"
 #include "restart_helpers.h"
+#include "spatial_index.h"
 
 LocalParticleVector::LocalParticleVector(ParticleVector* pv, int n) : pv(pv)
 {
@@ -34,6 +39,23 @@ void LocalParticleVector::resize_anew(const int n)
     np = n;
 }
 
+void LocalParticleVector::setOwner(const std::string& owner)
+{
+    coosvels.        setOwner(owner + ":coosvels");
+    forces.          setOwner(owner + ":forces");
+    positions.       setOwner(owner + ":positions");
+    extraPerParticle.setOwner(owner);
+}
+
+std::vector<GPUcontainer*> LocalParticleVector::getContainers()
+{
+    auto containers = extraPerParticle.getContainers();
+    containers.push_back(&coosvels);
+    containers.push_back(&forces);
+    containers.push_back(&positions);
+    return containers;
+}
+
 LocalParticleVector::~LocalParticleVector() = default;
 
 
@@ -159,6 +181,9 @@ void ParticleVector::setCoordinates_vector(PyTypes::VectorOfFloat3& coordinates)
     }
     
     coosvels.uploadToDevice(0);
+
+    // cell-lists and packed positions are outdated
+    cellListStamp++;
 }
 
 void ParticleVector::setVelocities_vector(PyTypes::VectorOfFloat3& velocities)
@@ -197,6 +222,36 @@ void ParticleVector::setForces_vector(PyTypes::VectorOfFloat3& forces)
     local()->forces.copy(myforces, 0);
 }
 
+void ParticleVector::usePackedPositions(bool enabled)
+{
+    packedPositions = enabled;
+
+    if (!enabled)
+    {
+        for (auto lpv : {local(), halo()})
+        {
+            lpv->positions.resize_anew(0);
+            lpv->positions.shrink(0);
+            lpv->positionsStamp = -1;
+        }
+    }
+}
+
+
+void ParticleVector::setCheckpointWriter(CheckpointWriter *writer)
+{
+    checkpointWriter = writer;
+}
+
+void ParticleVector::setStatic(bool enabled)
+{
+    isStatic = enabled;
+}
+
+void ParticleVector::setRawCheckpoints(bool enabled)
+{
+    rawCheckpoints = enabled;
+}
 
 ParticleVector::~ParticleVector()
 { 
@@ -211,11 +266,14 @@ ParticleVector::ParticleVector(const YmrState *state, std::string name,  float m
     _local(local),
     _halo(halo)
 {
+    _local->setOwner(name + ":local");
+    _halo ->setOwner(name + ":halo");
+
     // usually old positions and velocities don't need to exchanged
     requireDataPerParticle<Particle> (ChannelNames::oldParts, ExtraDataManager::PersistenceMode::None);
 }
 
-static void splitPV(DomainInfo domain, LocalParticleVector *local,
+static void splitPV(DomainInfo domain, LocalParticleVector *local, const std::vector<int> *order,
                     std::vector<float> &positions, std::vector<float> &velocities, std::vector<int> &ids)
 {
     int n = local->size();
@@ -227,16 +285,18 @@ static void splitPV(DomainInfo domain, LocalParticleVector *local,
     
     for (int i = 0; i < n; i++)
     {
-        auto p = local->coosvels[i];
+        auto p = local->coosvels[order ? (*order)[i] : i];
         pos[i] = domain.local2global(p.r);
         vel[i] = p.u;
         ids[i] = p.i1;
     }
 }
 
-void ParticleVector::_extractPersistentExtraData(ExtraDataManager& extraData, std::vector<XDMF::Channel>& channels,
-                                                 const std::set<std::string>& blackList)
+void ParticleVector::_extractPersistentExtraData(ExtraDataManager& extraData, CheckpointEntry& entry,
+                                                 const std::set<std::string>& blackList, const std::vector<int> *order)
 {
+    auto stream = _checkpointStream();
+
     for (auto& namedChannelDesc : extraData.getSortedChannels())
     {        
         auto channelName = namedChannelDesc.first;
@@ -254,11 +314,13 @@ void ParticleVector::_extractPersistentExtraData(ExtraDataManager& extraData, st
             case DataType::TOKENIZE(ctype):                             \
             {                                                           \
                 auto buffer   = extraData.getData<ctype>(channelName);  \
-                buffer->downloadFromDevice(0, ContainersSynch::Synch);  \
+                buffer->downloadFromDevice(stream, ContainersSynch::Synch); \
+                auto data       = order ? entry.keepPermuted(buffer->data(), *order) : \
+                                          entry.keepCopy(buffer->data(), buffer->size()); \
                 auto type       = XDMF::getDataForm<ctype>();           \
                 auto numbertype = XDMF::getNumberType<ctype>();         \
                 auto datatype   = typeTokenize<ctype>();                \
-                channels.push_back(XDMF::Channel(channelName, buffer->data(), type, numbertype, datatype )); \
+                entry.channels.push_back(XDMF::Channel(channelName, data, type, numbertype, datatype )); \
             }                                                           \
             break;
 
@@ -269,41 +331,81 @@ void ParticleVector::_extractPersistentExtraData(ExtraDataManager& extraData, st
     }
 }
 
-void ParticleVector::_extractPersistentExtraParticleData(std::vector<XDMF::Channel>& channels, const std::set<std::string>& blackList)
+void ParticleVector::_extractPersistentExtraParticleData(CheckpointEntry& entry, const std::set<std::string>& blackList,
+                                                         const std::vector<int> *order)
 {
     auto& extraData = local()->extraPerParticle;
-    _extractPersistentExtraData(extraData, channels, blackList);
+    _extractPersistentExtraData(extraData, entry, blackList, order);
+}
+
+bool ParticleVector::_hasSpatialCheckpointIndex() const
+{
+    return true;
+}
+
+cudaStream_t ParticleVector::_checkpointStream() const
+{
+    return checkpointWriter ? checkpointWriter->stream() : 0;
+}
+
+void ParticleVector::_writeCheckpointEntry(CheckpointEntry&& entry, MPI_Comm comm)
+{
+    if (checkpointWriter)
+        checkpointWriter->add(std::move(entry));
+    else
+        CheckpointHelpers::writeEntry(entry, comm);
 }
 
 void ParticleVector::_checkpointParticleData(MPI_Comm comm, std::string path)
 {
+    if (rawCheckpoints)
+    {
+        _checkpointRawParticleData(comm, path);
+        return;
+    }
+
     CUDA_Check( cudaDeviceSynchronize() );
 
-    std::string filename = path + "/" + name + "-" + getStrZeroPadded(restartIdx);
-    info("Checkpoint for particle vector '%s', writing to file %s", name.c_str(), filename.c_str());
+    // restarts take the raw checkpoint first, it must not outlive the XDMF ones
+    int rank;
+    MPI_Check( MPI_Comm_rank(comm, &rank) );
+    if (rank == 0)
+        std::remove((path + "/" + name + RawCheckpoint::manifestExtension).c_str());
 
-    local()->coosvels.downloadFromDevice(0, ContainersSynch::Synch);
+    CheckpointEntry entry;
+    entry.filename = path + "/" + name + "-" + getStrZeroPadded(restartIdx);
+    entry.path     = path;
+    entry.linkName = name;
+    info("Checkpoint for particle vector '%s', writing to file %s", name.c_str(), entry.filename.c_str());
+
+    local()->coosvels.downloadFromDevice(_checkpointStream(), ContainersSynch::Synch);
+
+    // sort the particles by spatial blocks, such that restarts only read the blocks they need
+    std::vector<int> order;
+    const bool indexed = _hasSpatialCheckpointIndex();
+    if (indexed)
+    {
+        entry.indexBlocks = SpatialIndex::sortByBlocks(state->domain, local()->coosvels, order);
+        entry.domain = state->domain;
+    }
 
     auto positions = std::make_shared<std::vector<float>>();
     std::vector<float> velocities;
     std::vector<int> ids;
-    splitPV(state->domain, local(), *positions, velocities, ids);
+    splitPV(state->domain, local(), indexed ? &order : nullptr, *positions, velocities, ids);
 
-    XDMF::VertexGrid grid(positions, comm);
+    entry.grid = std::make_unique<XDMF::VertexGrid>(positions, comm);
 
-    std::vector<XDMF::Channel> channels;
-    channels.push_back(XDMF::Channel("velocity", velocities.data(),
-                                     XDMF::Channel::DataForm::Vector, XDMF::Channel::NumberType::Float, typeTokenize<float>() ));
-    channels.push_back(XDMF::Channel(ChannelNames::globalIds, ids.data(),
-                                     XDMF::Channel::DataForm::Scalar, XDMF::Channel::NumberType::Int, typeTokenize<int>() ));
+    entry.channels.push_back(XDMF::Channel("velocity", entry.keep(std::move(velocities)),
+                                           XDMF::Channel::DataForm::Vector, XDMF::Channel::NumberType::Float, typeTokenize<float>() ));
+    entry.channels.push_back(XDMF::Channel(ChannelNames::globalIds, entry.keep(std::move(ids)),
+                                           XDMF::Channel::DataForm::Scalar, XDMF::Channel::NumberType::Int, typeTokenize<int>() ));
 
-    _extractPersistentExtraParticleData(channels);
-    
-    XDMF::write(filename, &grid, channels, comm);
+    _extractPersistentExtraParticleData(entry, {}, indexed ? &order : nullptr);
 
-    RestartHelpers::make_symlink(comm, path, name, filename);
+    _writeCheckpointEntry(std::move(entry), comm);
 
-    debug("Checkpoint for particle vector '%s' successfully written", name.c_str());
+    debug("Checkpoint for particle vector '%s' successfully taken", name.c_str());
 }
 
 void ParticleVector::_getRestartExchangeMap(MPI_Comm comm, const std::vector<Particle> &parts, std::vector<int>& map)
@@ -331,14 +433,153 @@ void ParticleVector::_getRestartExchangeMap(MPI_Comm comm, const std::vector<Par
     }
 }
 
+void ParticleVector::_keepRestartLocalParticles(MPI_Comm comm)
+{
+    int dims[3], periods[3], coords[3];
+    MPI_Check( MPI_Cart_get(comm, 3, dims, periods, coords) );
+    const int3 rank3D = make_int3(coords[0], coords[1], coords[2]);
+
+    std::vector<int> kept;
+    for (int i = 0; i < local()->size(); i++)
+    {
+        const int3 procId3 = make_int3(floorf(local()->coosvels[i].r / state->domain.localSize));
+        if (procId3.x == rank3D.x && procId3.y == rank3D.y && procId3.z == rank3D.z)
+            kept.push_back(i);
+    }
+
+    // the data was just read on the host, compact it in place
+    for (int j = 0; j < kept.size(); j++)
+    {
+        auto p = local()->coosvels[kept[j]];
+        p.r = state->domain.global2local(p.r);
+        local()->coosvels[j] = p;
+    }
+
+    auto& extraData = local()->extraPerParticle;
+    for (auto& namedChannelDesc : extraData.getSortedChannels())
+    {
+        auto channelName = namedChannelDesc.first;
+        auto channelDesc = namedChannelDesc.second;
+
+        if (channelDesc->persistence != ExtraDataManager::PersistenceMode::Persistent)
+            continue;
+
+        switch(channelDesc->dataType) {
+
+#define SWITCH_ENTRY(ctype)                                             \
+            case DataType::TOKENIZE(ctype):                             \
+            {                                                           \
+                auto buffer = extraData.getData<ctype>(channelName);    \
+                for (int j = 0; j < kept.size(); j++)                   \
+                    (*buffer)[j] = (*buffer)[kept[j]];                  \
+                buffer->resize(kept.size(), 0);                         \
+                buffer->uploadToDevice(0);                              \
+            }                                                           \
+            break;
+
+            TYPE_TABLE(SWITCH_ENTRY);
+
+#undef SWITCH_ENTRY
+        };
+    }
+
+    local()->resize(kept.size(), 0);
+}
+
+std::vector<RawCheckpoint::Section> ParticleVector::_rawCheckpointSections()
+{
+    std::vector<RawCheckpoint::Section> sections = {{"coosvels", typeTokenize<Particle>(), &local()->coosvels}};
+
+    for (auto& namedChannelDesc : local()->extraPerParticle.getSortedChannels())
+    {
+        auto channelDesc = namedChannelDesc.second;
+        if (channelDesc->persistence == ExtraDataManager::PersistenceMode::Persistent)
+            sections.push_back({namedChannelDesc.first, channelDesc->dataType, channelDesc->container.get()});
+    }
+
+    return sections;
+}
+
+void ParticleVector::_checkpointRawParticleData(MPI_Comm comm, std::string path)
+{
+    CUDA_Check( cudaDeviceSynchronize() );
+
+    const std::string filename = path + "/" + name + "-" + getStrZeroPadded(restartIdx);
+    info("Raw checkpoint for particle vector '%s', writing to file %s", name.c_str(), filename.c_str());
+
+    RawCheckpoint::write(filename, comm, state->domain, local()->size(), _rawCheckpointSections());
+    RestartHelpers::make_symlink(comm, path, name, filename, RawCheckpoint::manifestExtension);
+
+    debug("Raw checkpoint for particle vector '%s' successfully taken", name.c_str());
+}
+
+void ParticleVector::_restartRawParticleData(MPI_Comm comm, std::string path, const RawCheckpoint::Manifest& manifest)
+{
+    RawCheckpoint::checkDecomposition(manifest, comm, state->domain, name);
+    info("Restarting particle vector %s from raw file %s", name.c_str(), manifest.dataFile.c_str());
+
+    // like the XDMF restarts, create the persistent channels of the checkpoint
+    for (auto& section : manifest.sections)
+    {
+        if (section.name == "coosvels" || local()->extraPerParticle.checkChannelExists(section.name))
+            continue;
+
+        switch(section.dataType) {
+
+#define SWITCH_ENTRY(ctype)                                                                     case DataType::TOKENIZE(ctype):                                                         requireDataPerParticle<ctype>(section.name, ExtraDataManager::PersistenceMode::Persistent);                 break;
+
+            TYPE_TABLE(SWITCH_ENTRY);
+
+#undef SWITCH_ENTRY
+
+            default:
+                die("Unknown data type of the channel '%s' of the raw checkpoint of '%s'",
+                    section.name.c_str(), name.c_str());
+        };
+    }
+
+    int rank;
+    MPI_Check( MPI_Comm_rank(comm, &rank) );
+    local()->resize_anew(manifest.counts[rank]);
+
+    RawCheckpoint::read(path, manifest, comm, _rawCheckpointSections());
+
+    // the XDMF restarts leave the particles on the host as well
+    local()->coosvels.downloadFromDevice(0, ContainersSynch::Synch);
+
+    info("Successfully read %d particles", local()->size());
+}
+
 std::vector<int> ParticleVector::_restartParticleData(MPI_Comm comm, std::string path)
 {
     CUDA_Check( cudaDeviceSynchronize() );
 
-    std::string filename = path + "/" + name + ".xmf";
-    info("Restarting particle vector %s from file %s", name.c_str(), filename.c_str());
+    RawCheckpoint::Manifest manifest;
+    if (RawCheckpoint::readManifest(path + "/" + name + RawCheckpoint::manifestExtension, comm, manifest))
+    {
+        _restartRawParticleData(comm, path, manifest);
+        return {};
+    }
+
+    auto source = RestartHelpers::getCheckpointSource(comm, path, name);
+    const std::string& filename = source.filename;
+    info("Restarting particle vector %s from %sfile %s", name.c_str(), source.staged ? "staged " : "", filename.c_str());
+
+    // with a spatial index, read only the blocks around the subdomain and skip the exchange
+    std::vector<std::pair<long long, long long>> ranges;
+    if (!source.staged && SpatialIndex::readRanges(SpatialIndex::indexFilename(filename), comm, state->domain, ranges))
+    {
+        XDMF::readParticleData(filename, comm, this, ranges);
+        _keepRestartLocalParticles(comm);
+
+        local()->coosvels.uploadToDevice(0);
+        CUDA_Check( cudaDeviceSynchronize() );
+
+        info("Successfully read %d particles using the spatial index", local()->coosvels.size());
+        return {};
+    }
 
-    XDMF::readParticleData(filename, comm, this);
+    XDMF::readParticleData(filename, source.comm, this);
 
     std::vector<Particle> parts(local()->size());
     std::copy(local()->coosvels.begin(), local()->coosvels.end(), parts.begin());
@@ -2,6 +2,7 @@
 
 #include <set>
 #include <string>
+#include <vector>
 
 #include <core/containers.h>
 #include <core/datatypes.h>
@@ -13,6 +14,10 @@
 
 namespace XDMF {struct Channel;}
 
+struct CheckpointEntry;
+class CheckpointWriter;
+namespace RawCheckpoint {struct Section; struct Manifest;}
+
 class ParticleVector;
 
 enum class ParticleVectorType {
@@ -29,11 +34,27 @@ public:
     DeviceBuffer<Force> forces;
     ExtraDataManager extraPerParticle;
 
+    /**
+     * Cached copy of the coordinates (and \c i1) of #coosvels, which stays the authoritative storage.
+     * Passes needing only positions read it in place of the full particles, i.e. half of the data.
+     * It costs 16 bytes per particle and 16 more bytes written per particle at each cell-list build.
+     * Only filled by the cell-lists for the particle vectors with ParticleVector::packedPositions,
+     * valid while #positionsStamp matches ParticleVector::cellListStamp, see PVview
+     */
+    DeviceBuffer<float4> positions;
+    int positionsStamp{-1};
+
     LocalParticleVector(ParticleVector* pv, int n=0);
 
     int size() { return np; }
     virtual void resize(const int n, cudaStream_t stream);
     virtual void resize_anew(const int n);
+
+    /// account the memory of all the buffers under "<owner>:<buffer name>", see MemoryPool
+    virtual void setOwner(const std::string& owner);
+
+    /// @return all the per-particle buffers, see ShrinkPolicy
+    virtual std::vector<GPUcontainer*> getContainers();
     
     virtual ~LocalParticleVector();
 
@@ -57,6 +78,18 @@ public:
 
     int cellListStamp{0};
 
+    /// keep a cached copy of the positions next to the particles, see LocalParticleVector::positions
+    bool packedPositions{false};
+    void usePackedPositions(bool enabled);
+
+    /**
+     * Static particles never move: they have no integrator, such that their cell-lists, halo and
+     * redistribution are only done once. The forces and stresses on them are not computed, unless #staticForces
+     */
+    bool isStatic{false};
+    bool staticForces{false};   ///< e.g. to measure the force on a wall, see WallForceCollectorPlugin
+    void setStatic(bool enabled);
+
     ParticleVector(const YmrState *state, std::string name, float mass, int n=0);
 
     LocalParticleVector* local() { return _local; }
@@ -65,6 +98,12 @@ public:
     void checkpoint(MPI_Comm comm, std::string path) override;
     void restart(MPI_Comm comm, std::string path) override;
 
+    /// give the checkpoint files to \p writer instead of writing them right away, see CheckpointWriter
+    void setCheckpointWriter(CheckpointWriter *writer);
+
+    /// write raw binary checkpoints straight from the device instead of XDMF files, see RawCheckpoint
+    void setRawCheckpoints(bool enabled);
+
     
     // Python getters / setters
     // Use default blocking stream
@@ -102,15 +141,34 @@ protected:
 
     virtual void _getRestartExchangeMap(MPI_Comm comm, const std::vector<Particle> &parts, std::vector<int>& map);
 
-    void _extractPersistentExtraData(ExtraDataManager& extraData, std::vector<XDMF::Channel>& channels, const std::set<std::string>& blackList);
-    void _extractPersistentExtraParticleData(std::vector<XDMF::Channel>& channels, const std::set<std::string>& blackList = {});
+    void _extractPersistentExtraData(ExtraDataManager& extraData, CheckpointEntry& entry, const std::set<std::string>& blackList,
+                                     const std::vector<int> *order = nullptr);
+    void _extractPersistentExtraParticleData(CheckpointEntry& entry, const std::set<std::string>& blackList = {},
+                                             const std::vector<int> *order = nullptr);
+
+    /// whether the particles may be reordered in the checkpoints to index them spatially, see SpatialIndex
+    virtual bool _hasSpatialCheckpointIndex() const;
+
+    cudaStream_t _checkpointStream() const;
+    void _writeCheckpointEntry(CheckpointEntry&& entry, MPI_Comm comm);
     
     virtual void _checkpointParticleData(MPI_Comm comm, std::string path);
     virtual std::vector<int> _restartParticleData(MPI_Comm comm, std::string path);    
 
+    /// keep the particles read in global coordinates that belong to the local subdomain
+    void _keepRestartLocalParticles(MPI_Comm comm);
+
+    /// the particles and their persistent channels, as stored in the raw checkpoints
+    std::vector<RawCheckpoint::Section> _rawCheckpointSections();
+    void _checkpointRawParticleData(MPI_Comm comm, std::string path);
+    void _restartRawParticleData(MPI_Comm comm, std::string path, const RawCheckpoint::Manifest& manifest);
+
     void advanceRestartIdx();
     int restartIdx = 0;
 
+    CheckpointWriter *checkpointWriter{nullptr};
+    bool rawCheckpoints{false};
+
 private:
 
     template<typename T>
@@ -0,0 +1,397 @@
+#include "raw_checkpoint.h"
+
+#include <core/logger.h>
+#include <core/utils/cuda_common.h>
+#include <core/utils/folders.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fcntl.h>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <unistd.h>
+
+#ifdef YMR_HAVE_CUFILE
+#include <cufile.h>
+#endif
+
+namespace RawCheckpoint
+{
+
+namespace
+{
+/// size of the host buffer of the transfers without GPUDirect Storage
+const size_t hostChunk = 64 * 1024 * 1024;
+
+const std::string formatName = "ymero-raw-1";
+
+size_t aligned(size_t bytes)
+{
+    return (bytes + alignment - 1) / alignment * alignment;
+}
+
+#ifdef YMR_HAVE_CUFILE
+bool gdsAvailable()
+{
+    static int status = -1;
+    if (status < 0)
+    {
+        const CUfileError_t err = cuFileDriverOpen();
+        status = (err.err == CU_FILE_SUCCESS);
+        if (!status)
+            warn("Could not open the GPUDirect Storage driver, raw checkpoints go through the host");
+    }
+    return status;
+}
+#endif
+
+/// a data file, written or read from device pointers
+class RawFile
+{
+public:
+    RawFile(std::string filename, bool writing) :
+        filename(filename)
+    {
+        const int flags = writing ? O_WRONLY : O_RDONLY;
+
+        fd = open(filename.c_str(), flags);
+        if (fd < 0)
+            die("Could not open the raw checkpoint file '%s'", filename.c_str());
+
+#ifdef YMR_HAVE_CUFILE
+        if (!gdsAvailable()) return;
+
+        directFd = open(filename.c_str(), flags | O_DIRECT);
+        if (directFd < 0) return;
+
+        CUfileDescr_t descr = {};
+        descr.handle.fd = directFd;
+        descr.type      = CU_FILE_HANDLE_TYPE_OPAQUE_FD;
+
+        if (cuFileHandleRegister(&handle, &descr).err == CU_FILE_SUCCESS)
+            direct = true;
+        else
+        {
+            debug("File '%s' does not support GPUDirect Storage, going through the host", filename.c_str());
+            close(directFd);
+            directFd = -1;
+        }
+#endif
+    }
+
+    ~RawFile()
+    {
+#ifdef YMR_HAVE_CUFILE
+        if (direct) cuFileHandleDeregister(handle);
+        if (directFd >= 0) close(directFd);
+#endif
+        close(fd);
+    }
+
+    void write(const void *devPtr, size_t bytes, off_t offset)
+    {
+        if (bytes == 0) return;
+
+#ifdef YMR_HAVE_CUFILE
+        if (direct)
+        {
+            for (size_t done = 0; done < bytes; )
+            {
+                const ssize_t res = cuFileWrite(handle, devPtr, bytes - done, offset + done, done);
+                if (res <= 0)
+                    die("Could not write the raw checkpoint file '%s' with GPUDirect Storage", filename.c_str());
+                done += res;
+            }
+            return;
+        }
+#endif
+
+        hostBuffer.resize(std::min(bytes, hostChunk));
+        for (size_t done = 0; done < bytes; )
+        {
+            const size_t chunk = std::min(bytes - done, hostChunk);
+            CUDA_Check( cudaMemcpy(hostBuffer.data(), (const char*)devPtr + done, chunk, cudaMemcpyDeviceToHost) );
+
+            for (size_t written = 0; written < chunk; )
+            {
+                const ssize_t res = pwrite(fd, hostBuffer.data() + written, chunk - written, offset + done + written);
+                if (res <= 0)
+                    die("Could not write the raw checkpoint file '%s'", filename.c_str());
+                written += res;
+            }
+            done += chunk;
+        }
+    }
+
+    void read(void *devPtr, size_t bytes, off_t offset)
+    {
+        if (bytes == 0) return;
+
+#ifdef YMR_HAVE_CUFILE
+        if (direct)
+        {
+            for (size_t done = 0; done < bytes; )
+            {
+                const ssize_t res = cuFileRead(handle, devPtr, bytes - done, offset + done, done);
+                if (res <= 0)
+                    die("Could not read the raw checkpoint file '%s' with GPUDirect Storage", filename.c_str());
+                done += res;
+            }
+            return;
+        }
+#endif
+
+        hostBuffer.resize(std::min(bytes, hostChunk));
+        for (size_t done = 0; done < bytes; )
+        {
+            const size_t chunk = std::min(bytes - done, hostChunk);
+
+            for (size_t nread = 0; nread < chunk; )
+            {
+                const ssize_t res = pread(fd, hostBuffer.data() + nread, chunk - nread, offset + done + nread);
+                if (res <= 0)
+                    die("Could not read the raw checkpoint file '%s', truncated?", filename.c_str());
+                nread += res;
+            }
+
+            CUDA_Check( cudaMemcpy((char*)devPtr + done, hostBuffer.data(), chunk, cudaMemcpyHostToDevice) );
+            done += chunk;
+        }
+    }
+
+    bool isDirect() const { return direct; }
+
+private:
+    std::string filename;
+    int fd {-1};
+    bool direct {false};
+
+#ifdef YMR_HAVE_CUFILE
+    int directFd {-1};
+    CUfileHandle_t handle;
+#endif
+
+    std::vector<char> hostBuffer;
+};
+
+std::string toJson(const Manifest& manifest)
+{
+    std::ostringstream out;
+    out << std::setprecision(9);
+
+    out << "{\n"
+        << "  \"format\": \"" << formatName << "\",\n"
+        << "  \"data\": \"" << manifest.dataFile << "\",\n"
+        << "  \"ranks\": [" << manifest.ranks.x << ", " << manifest.ranks.y << ", " << manifest.ranks.z << "],\n"
+        << "  \"globalSize\": [" << manifest.globalSize.x << ", " << manifest.globalSize.y << ", " << manifest.globalSize.z << "],\n"
+        << "  \"counts\": [";
+
+    for (size_t i = 0; i < manifest.counts.size(); i++)
+        out << (i ? ", " : "") << manifest.counts[i];
+
+    out << "],\n"
+        << "  \"sections\": [\n";
+
+    for (size_t i = 0; i < manifest.sections.size(); i++)
+    {
+        auto& s = manifest.sections[i];
+        out << "    {\"name\": \"" << s.name << "\", \"type\": \"" << dataTypeToString(s.dataType)
+            << "\", \"offset\": " << s.offset << "}" << (i + 1 < manifest.sections.size() ? "," : "") << "\n";
+    }
+
+    out << "  ]\n"
+        << "}\n";
+
+    return out.str();
+}
+
+/// parse the manifest as written by toJson(): the punctuation is dropped and the remaining tokens read in order
+bool fromJson(std::string json, Manifest& manifest)
+{
+    for (auto& c : json)
+        if (c == '{' || c == '}' || c == '[' || c == ']' || c == ',' || c == ':' || c == '"')
+            c = ' ';
+
+    std::istringstream in(json);
+    std::string key, format, type;
+
+    in >> key >> format;
+    if (key != "format" || format != formatName)
+        return false;
+
+    in >> key >> manifest.dataFile;
+    in >> key >> manifest.ranks.x >> manifest.ranks.y >> manifest.ranks.z;
+    in >> key >> manifest.globalSize.x >> manifest.globalSize.y >> manifest.globalSize.z;
+    in >> key;
+
+    manifest.counts.clear();
+    while (in >> key && key != "sections")
+        manifest.counts.push_back(std::stoll(key));
+
+    manifest.sections.clear();
+    Manifest::SectionInfo s;
+    while (in >> key >> s.name >> key >> type >> key >> s.offset)
+    {
+        s.dataType = stringToDataType(type);
+        manifest.sections.push_back(s);
+    }
+
+    return !manifest.sections.empty();
+}
+
+long long localOffset(const Manifest& manifest, int rank)
+{
+    long long offset = 0;
+    for (int r = 0; r < rank; r++)
+        offset += manifest.counts[r];
+    return offset;
+}
+} // anonymous namespace
+
+void write(std::string filename, MPI_Comm comm, const DomainInfo& domain, int n, const std::vector<Section>& sections)
+{
+    int rank, nranks;
+    int dims[3], periods[3], coords[3];
+    MPI_Check( MPI_Comm_rank(comm, &rank) );
+    MPI_Check( MPI_Comm_size(comm, &nranks) );
+    MPI_Check( MPI_Cart_get(comm, 3, dims, periods, coords) );
+
+    Manifest manifest;
+    manifest.dataFile   = relativePath(filename) + dataExtension;
+    manifest.ranks      = make_int3(dims[0], dims[1], dims[2]);
+    manifest.globalSize = domain.globalSize;
+    manifest.counts.resize(nranks);
+
+    const long long localCount = n;
+    MPI_Check( MPI_Allgather(&localCount, 1, MPI_LONG_LONG, manifest.counts.data(), 1, MPI_LONG_LONG, comm) );
+
+    long long total = 0;
+    for (auto c : manifest.counts) total += c;
+
+    size_t offset = 0;
+    for (auto& s : sections)
+    {
+        manifest.sections.push_back({s.name, s.dataType, (long long) offset});
+        offset += aligned(total * dataTypeToByteSize(s.dataType));
+    }
+
+    const std::string dataName = filename + dataExtension;
+    if (rank == 0)
+    {
+        const int fd = open(dataName.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+        if (fd < 0)
+            die("Could not create the raw checkpoint file '%s'", dataName.c_str());
+        close(fd);
+    }
+    MPI_Check( MPI_Barrier(comm) );
+
+    {
+        RawFile file(dataName, true);
+        const long long first = localOffset(manifest, rank);
+
+        for (size_t i = 0; i < sections.size(); i++)
+        {
+            const size_t size = dataTypeToByteSize(sections[i].dataType);
+            file.write(sections[i].container->genericDevPtr(), n * size, manifest.sections[i].offset + first * size);
+        }
+
+        debug("Wrote %d elements into the raw checkpoint '%s'%s", n, dataName.c_str(),
+              file.isDirect() ? " with GPUDirect Storage" : "");
+    }
+
+    // the manifest only refers to complete data
+    MPI_Check( MPI_Barrier(comm) );
+    if (rank != 0) return;
+
+    const std::string fname = filename + manifestExtension;
+    const std::string tmpName = fname + ".tmp";
+    {
+        std::ofstream fout(tmpName);
+        fout << toJson(manifest);
+    }
+
+    if (std::rename(tmpName.c_str(), fname.c_str()) != 0)
+        error("Could not write the raw checkpoint manifest '%s'", fname.c_str());
+}
+
+bool readManifest(std::string manifestFile, MPI_Comm comm, Manifest& manifest)
+{
+    int rank;
+    MPI_Check( MPI_Comm_rank(comm, &rank) );
+
+    std::string json;
+    int length = -1;
+    if (rank == 0)
+    {
+        std::ifstream fin(manifestFile);
+        if (fin.good())
+        {
+            std::stringstream buffer;
+            buffer << fin.rdbuf();
+            json = buffer.str();
+            length = json.size();
+        }
+    }
+
+    MPI_Check( MPI_Bcast(&length, 1, MPI_INT, 0, comm) );
+    if (length < 0) return false;
+
+    json.resize(length);
+    MPI_Check( MPI_Bcast(&json[0], length, MPI_CHAR, 0, comm) );
+
+    if (!fromJson(json, manifest))
+        die("Could not parse the raw checkpoint manifest '%s'", manifestFile.c_str());
+
+    return true;
+}
+
+void checkDecomposition(const Manifest& manifest, MPI_Comm comm, const DomainInfo& domain, std::string name)
+{
+    int nranks;
+    int dims[3], periods[3], coords[3];
+    MPI_Check( MPI_Comm_size(comm, &nranks) );
+    MPI_Check( MPI_Cart_get(comm, 3, dims, periods, coords) );
+
+    const bool sameRanks  = manifest.ranks.x == dims[0] && manifest.ranks.y == dims[1] && manifest.ranks.z == dims[2] &&
+                            (int) manifest.counts.size() == nranks;
+    const bool sameDomain = manifest.globalSize.x == domain.globalSize.x &&
+                            manifest.globalSize.y == domain.globalSize.y &&
+                            manifest.globalSize.z == domain.globalSize.z;
+
+    if (!sameRanks || !sameDomain)
+        die("The raw checkpoint of '%s' was written on %d x %d x %d ranks for the domain [%g %g %g], "
+            "it can only be restarted on the same decomposition (here %d x %d x %d ranks, domain [%g %g %g])",
+            name.c_str(), manifest.ranks.x, manifest.ranks.y, manifest.ranks.z,
+            manifest.globalSize.x, manifest.globalSize.y, manifest.globalSize.z,
+            dims[0], dims[1], dims[2], domain.globalSize.x, domain.globalSize.y, domain.globalSize.z);
+}
+
+void read(std::string folder, const Manifest& manifest, MPI_Comm comm, const std::vector<Section>& sections)
+{
+    int rank;
+    MPI_Check( MPI_Comm_rank(comm, &rank) );
+
+    const long long first = localOffset(manifest, rank);
+    const long long n     = manifest.counts[rank];
+
+    RawFile file(folder + "/" + manifest.dataFile, false);
+
+    for (auto& s : sections)
+    {
+        auto it = std::find_if(manifest.sections.begin(), manifest.sections.end(),
+                               [&s] (const Manifest::SectionInfo& info) { return info.name == s.name; });
+
+        if (it == manifest.sections.end() || it->dataType != s.dataType)
+            die("Raw checkpoint '%s' has no section '%s' of type %s",
+                manifest.dataFile.c_str(), s.name.c_str(), dataTypeToString(s.dataType).c_str());
+
+        const size_t size = dataTypeToByteSize(s.dataType);
+        file.read(s.container->genericDevPtr(), n * size, it->offset + first * size);
+    }
+
+    debug("Read %lld elements from the raw checkpoint '%s'%s", n, manifest.dataFile.c_str(),
+          file.isDirect() ? " with GPUDirect Storage" : "");
+}
+
+} // namespace RawCheckpoint
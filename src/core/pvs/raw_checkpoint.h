@@ -0,0 +1,77 @@
+#pragma once
+
+#include <core/containers.h>
+#include <core/domain.h>
+#include <core/utils/typeMap.h>
+
+#include <mpi.h>
+#include <string>
+#include <vector>
+
+/**
+ * Raw binary checkpoints of particle vectors, read and written directly between the device buffers and the file.
+ *
+ * The data file <filename>.raw holds one section per buffer, the sections are aligned to
+ * \c alignment bytes and store the elements of the ranks one after the other, in the order of the ranks.
+ * The elements are copied as they are on the device, the positions thus stay in local coordinates:
+ * a raw checkpoint can only be restarted on the same decomposition of the same domain.
+ * The small manifest <filename>.raw.json describes the decomposition, the number of elements of every rank
+ * and the sections, such that the file stays inspectable.
+ *
+ * When YMeRo is built with GPUDirect Storage (YMR_HAVE_CUFILE) and the file system supports it,
+ * the sections go through cuFile without any host copy; otherwise through one host buffer per section.
+ */
+namespace RawCheckpoint
+{
+const std::string dataExtension     = ".raw";
+const std::string manifestExtension = ".raw.json";
+
+const size_t alignment = 4096;
+
+/// one buffer of the checkpoint, with as many elements as particles
+struct Section
+{
+    std::string name;
+    DataType dataType;
+    GPUcontainer *container;
+};
+
+/// contents of a manifest
+struct Manifest
+{
+    std::string dataFile;             ///< relative to the folder of the manifest
+    int3 ranks;
+    float3 globalSize;
+    std::vector<long long> counts;    ///< number of elements of every rank
+
+    struct SectionInfo
+    {
+        std::string name;
+        DataType dataType;
+        long long offset;             ///< of the first element in the data file
+    };
+    std::vector<SectionInfo> sections;
+};
+
+/**
+ * Write the \p sections of the local \p n elements of all the ranks of \p comm, a cartesian communicator.
+ * Collective, the master rank writes the manifest. The device data must be ready
+ */
+void write(std::string filename, MPI_Comm comm, const DomainInfo& domain, int n, const std::vector<Section>& sections);
+
+/**
+ * Read the manifest \p manifestFile on the master rank of \p comm and broadcast it.
+ * @return false if there is no such file
+ */
+bool readManifest(std::string manifestFile, MPI_Comm comm, Manifest& manifest);
+
+/// die unless \p manifest was written on the decomposition of \p comm and \p domain
+void checkDecomposition(const Manifest& manifest, MPI_Comm comm, const DomainInfo& domain, std::string name);
+
+/**
+ * Read the local elements of the \p sections into their containers, that already have the right size.
+ * The section names must be in the manifest, collective
+ */
+void read(std::string folder, const Manifest& manifest, MPI_Comm comm, const std::vector<Section>& sections);
+
+} // namespace RawCheckpoint
@@ -1,5 +1,9 @@
 #include "restart_helpers.h"
 
+#include <core/utils/folders.h>
+
+#include <fstream>
+
 namespace RestartHelpers
 {
 
@@ -14,18 +18,71 @@ void copyShiftCoordinates(const DomainInfo &domain, const std::vector<Particle>
     }
 }
 
-void make_symlink(MPI_Comm comm, std::string path, std::string name, std::string fname)
+void make_symlink(MPI_Comm comm, std::string path, std::string name, std::string fname, std::string extension)
 {
     int rank;
     MPI_Check( MPI_Comm_rank(comm, &rank) );
 
     if (rank == 0) {
-        std::string lnname = path + "/" + name + ".xmf";
+        std::string lnname = path + "/" + name + extension;
         
-        std::string command = "ln -f " + fname + ".xmf " + lnname;
+        std::string command = "ln -f " + fname + extension + " " + lnname;
         if ( system(command.c_str()) != 0 )
             error("Could not create link for checkpoint file of PV '%s'", name.c_str());
     }    
 }
 
+std::string getCheckpointFile(std::string path, std::string name)
+{
+    std::ifstream fin(path + "/" + manifestName);
+
+    std::string link, fname;
+    while (fin >> link >> fname)
+        if (link == name)
+            return path + "/" + fname + ".xmf";
+
+    return path + "/" + name + ".xmf";
+}
+
+std::string getStagedFolder(std::string folder, int rank)
+{
+    return folder + "/rank" + getStrZeroPadded(rank) + "/";
+}
+
+CheckpointSource getCheckpointSource(MPI_Comm comm, std::string path, std::string name)
+{
+    int rank;
+    MPI_Check( MPI_Comm_rank(comm, &rank) );
+
+    std::string folder, stagedFile;
+    unsigned long long id, stagedId;
+    int valid = 0;
+
+    std::ifstream record(path + "/" + stagingRecordName);
+    if (record >> folder >> id)
+    {
+        const std::string stagedFolder = getStagedFolder(folder, rank);
+        std::ifstream fin(stagedFolder + stagedManifestName);
+
+        // the staging folder may hold the files left by another run
+        std::string link, fname;
+        if (fin >> stagedId && stagedId == id)
+            while (fin >> link >> fname)
+                if (link == name)
+                {
+                    stagedFile = stagedFolder + fname + ".xmf";
+                    valid = std::ifstream(stagedFile).good();
+                    break;
+                }
+    }
+
+    int allValid;
+    MPI_Check( MPI_Allreduce(&valid, &allValid, 1, MPI_INT, MPI_LAND, comm) );
+
+    if (allValid)
+        return {stagedFile, MPI_COMM_SELF, true};
+
+    return {getCheckpointFile(path, name), comm, false};
+}
+
 } // namespace RestartHelpers
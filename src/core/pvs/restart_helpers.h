@@ -1,6 +1,7 @@
 #pragma once
 
 #include <mpi.h>
+#include <string>
 #include <vector>
 
 #include "core/domain.h"
@@ -9,7 +10,40 @@
 namespace RestartHelpers
 {
 void copyShiftCoordinates(const DomainInfo &domain, const std::vector<Particle> &parts, LocalParticleVector *local);
-void make_symlink(MPI_Comm comm, std::string path, std::string name, std::string fname);
+void make_symlink(MPI_Comm comm, std::string path, std::string name, std::string fname, std::string extension = ".xmf");
+
+/// file of the checkpoint folder listing the file of every link, see CheckpointWriter
+const std::string manifestName = "_checkpoint.manifest";
+
+/**
+ * The .xmf file to restart \p name from: the one given by the manifest of \p path if any,
+ * which may be a version written at an earlier checkpoint, the link path/name.xmf otherwise
+ */
+std::string getCheckpointFile(std::string path, std::string name);
+
+/// file of the checkpoint folder giving the node-local staging folder of the last checkpoint, see CheckpointWriter::setStaging()
+const std::string stagingRecordName = "_checkpoint.staging";
+
+/// file of every per-rank staging folder listing the staged file of every link
+const std::string stagedManifestName = "_staged.manifest";
+
+/// per-rank subfolder of the staging folder \p folder, with a trailing slash
+std::string getStagedFolder(std::string folder, int rank);
+
+/// where to read a checkpoint file from, see getCheckpointSource()
+struct CheckpointSource
+{
+    std::string filename;  ///< .xmf file
+    MPI_Comm comm;         ///< communicator to read it with
+    bool staged;           ///< the file is node-local and holds only the data of this rank
+};
+
+/**
+ * Collective on \p comm. The node-local staged file of \p name if every rank of \p comm
+ * finds the files of the last checkpoint of the folder \p path in its staging folder,
+ * read on MPI_COMM_SELF; the file given by getCheckpointFile() on \p comm otherwise
+ */
+CheckpointSource getCheckpointSource(MPI_Comm comm, std::string path, std::string name);
 
 template<typename T>
 static void sendData(const std::vector<std::vector<T>> &sendBufs, std::vector<MPI_Request> &reqs, MPI_Comm comm)
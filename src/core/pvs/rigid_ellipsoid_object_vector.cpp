@@ -1,6 +1,9 @@
 #include "rigid_ellipsoid_object_vector.h"
 #include <core/utils/cuda_common.h>
 
+#include <algorithm>
+#include <cmath>
+
 static float3 inertia_tensor(float mass, int objsize, float3 axes)
 {
     return mass * objsize / 5.0f * make_float3
@@ -32,3 +35,10 @@ RigidEllipsoidObjectVector::RigidEllipsoidObjectVector(
 {}
 
 RigidEllipsoidObjectVector::~RigidEllipsoidObjectVector() = default;
+
+float RigidEllipsoidObjectVector::distanceToSurface(float3 r) const
+{
+    // the ellipsoid scaled by rho is at least (1 - rho) * min(axes) away from the ellipsoid
+    const float rho = length(r / axes);
+    return std::fabs(1.0f - rho) * std::min({axes.x, axes.y, axes.z});
+}
@@ -17,6 +17,10 @@ public:
                                const int nObjects = 0);
         
     virtual ~RigidEllipsoidObjectVector();
+
+protected:
+    /// lower bound of the distance to the ellipsoid, no mesh is needed
+    float distanceToSurface(float3 r) const override;
 };
 
 
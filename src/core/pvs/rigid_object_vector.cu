@@ -3,19 +3,25 @@
 
 #include <core/utils/kernel_launch.h>
 #include <core/utils/folders.h>
+#include <core/utils/make_unique.h>
 #include <core/rigid_kernels/integration.h>
 #include <core/xdmf/xdmf.h>
 #include <core/xdmf/typeMap.h>
 
+#include "checkpoint_writer.h"
 #include "restart_helpers.h"
 
+#include <algorithm>
+#include <cmath>
+
 RigidObjectVector::RigidObjectVector(const YmrState *state, std::string name, float partMass,
                                      float3 J, const int objSize,
                                      std::shared_ptr<Mesh> mesh, const int nObjects) :
     ObjectVector( state, name, partMass, objSize,
                   new LocalRigidObjectVector(this, objSize, nObjects),
                   new LocalRigidObjectVector(this, objSize, 0) ),
-    J(J)
+    J(J),
+    fullObjSize(objSize)
 {
     this->mesh = std::move(mesh);
 
@@ -41,6 +47,100 @@ RigidObjectVector::RigidObjectVector(const YmrState *state, std::string name, fl
     RigidObjectVector( state, name, partMass, make_float3(J), objSize, mesh, nObjects )
 {}
 
+namespace
+{
+/// Ericson, "Real-Time Collision Detection", 5.1.5
+float3 closestPointOnTriangle(float3 p, float3 a, float3 b, float3 c)
+{
+    const float3 ab = b - a, ac = c - a, ap = p - a;
+    const float d1 = dot(ab, ap), d2 = dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f) return a;
+
+    const float3 bp = p - b;
+    const float d3 = dot(ab, bp), d4 = dot(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3) return b;
+
+    const float vc = d1*d4 - d3*d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) return a + ab * (d1 / (d1 - d3));
+
+    const float3 cp = p - c;
+    const float d5 = dot(ab, cp), d6 = dot(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6) return c;
+
+    const float vb = d5*d2 - d1*d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) return a + ac * (d2 / (d2 - d6));
+
+    const float va = d3*d6 - d5*d4;
+    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+        return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+    const float denom = 1.0f / (va + vb + vc);
+    return a + ab * (vb * denom) + ac * (vc * denom);
+}
+} // anonymous namespace
+
+void RigidObjectVector::useSurfaceLayer(float thickness)
+{
+    surfaceLayer = thickness;
+}
+
+void RigidObjectVector::selectFrozenParticles(PyTypes::VectorOfFloat3& coords)
+{
+    if (objSize != coords.size())
+        die("Object size and XYZ initial conditions don't match in size for '%s': %d vs %d",
+            name.c_str(), objSize, (int) coords.size());
+
+    fullObjSize = objSize;
+    if (surfaceLayer <= 0.0f) return;
+
+    PyTypes::VectorOfFloat3 surface;
+    for (const auto& r : coords)
+        if (distanceToSurface(make_float3(r[0], r[1], r[2])) <= surfaceLayer)
+            surface.push_back(r);
+
+    if (surface.empty())
+        die("No frozen particle of '%s' is within %f of the surface", name.c_str(), surfaceLayer);
+
+    info("Rigid object vector '%s' stores %d of its %d particles per object, within %f of the surface",
+         name.c_str(), (int) surface.size(), fullObjSize, surfaceLayer);
+
+    coords = std::move(surface);
+    objSize = coords.size();
+    local()->setObjSize(objSize);
+    halo() ->setObjSize(objSize);
+}
+
+float RigidObjectVector::getObjectMass() const
+{
+    return fullObjSize * mass;
+}
+
+float RigidObjectVector::distanceToSurface(float3 r) const
+{
+    if (mesh == nullptr || mesh->getNtriangles() == 0)
+        die("Rigid object vector '%s' needs a mesh to select the particles of its surface layer", name.c_str());
+
+    float minDist2 = 1e30f;
+    for (const auto& t : mesh->triangles)
+    {
+        const float3 closest = closestPointOnTriangle(r,
+                                                      f4tof3(mesh->vertexCoordinates[t.x]),
+                                                      f4tof3(mesh->vertexCoordinates[t.y]),
+                                                      f4tof3(mesh->vertexCoordinates[t.z]));
+        minDist2 = std::min(minDist2, dot(r - closest, r - closest));
+    }
+
+    return std::sqrt(minDist2);
+}
+
+void LocalRigidObjectVector::setObjSize(int size)
+{
+    if (nObjects != 0)
+        die("The object size of '%s' can only change before the objects are created", pv->name.c_str());
+
+    objSize = size;
+}
+
 PinnedBuffer<Particle>* LocalRigidObjectVector::getMeshVertices(cudaStream_t stream)
 {
     auto ov = dynamic_cast<RigidObjectVector*>(pv);
@@ -119,12 +219,15 @@ void RigidObjectVector::_checkpointObjectData(MPI_Comm comm, std::string path)
 {
     CUDA_Check( cudaDeviceSynchronize() );
 
-    std::string filename = path + "/" + name + ".obj-" + getStrZeroPadded(restartIdx);
-    info("Checkpoint for rigid object vector '%s', writing to file %s", name.c_str(), filename.c_str());
+    CheckpointEntry entry;
+    entry.filename = path + "/" + name + ".obj-" + getStrZeroPadded(restartIdx);
+    entry.path     = path;
+    entry.linkName = name + ".obj";
+    info("Checkpoint for rigid object vector '%s', writing to file %s", name.c_str(), entry.filename.c_str());
 
     auto motions = local()->extraPerObject.getData<RigidMotion>(ChannelNames::motions);
 
-    motions->downloadFromDevice(0, ContainersSynch::Synch);
+    motions->downloadFromDevice(_checkpointStream(), ContainersSynch::Synch);
     
     auto positions = std::make_shared<std::vector<float>>();
     std::vector<RigidReal4> quaternion;
@@ -132,25 +235,23 @@ void RigidObjectVector::_checkpointObjectData(MPI_Comm comm, std::string path)
     
     splitMotions(state->domain, *motions, *positions, quaternion, vel, omega, force, torque);
 
-    XDMF::VertexGrid grid(positions, comm);    
+    entry.grid = std::make_unique<XDMF::VertexGrid>(positions, comm);
 
     auto rigidType = XDMF::getNumberType<RigidReal>();
 
-    std::vector<XDMF::Channel> channels = {
-        XDMF::Channel( "quaternion", quaternion .data(), XDMF::Channel::DataForm::Quaternion, rigidType, typeTokenize<RigidReal4>() ),
-        XDMF::Channel( "velocity",   vel        .data(), XDMF::Channel::DataForm::Vector,     rigidType, typeTokenize<RigidReal3>() ),
-        XDMF::Channel( "omega",      omega      .data(), XDMF::Channel::DataForm::Vector,     rigidType, typeTokenize<RigidReal3>() ),
-        XDMF::Channel( "force",      force      .data(), XDMF::Channel::DataForm::Vector,     rigidType, typeTokenize<RigidReal3>() ),
-        XDMF::Channel( "torque",     torque     .data(), XDMF::Channel::DataForm::Vector,     rigidType, typeTokenize<RigidReal3>() )
+    entry.channels = {
+        XDMF::Channel( "quaternion", entry.keep(std::move(quaternion)), XDMF::Channel::DataForm::Quaternion, rigidType, typeTokenize<RigidReal4>() ),
+        XDMF::Channel( "velocity",   entry.keep(std::move(vel       )), XDMF::Channel::DataForm::Vector,     rigidType, typeTokenize<RigidReal3>() ),
+        XDMF::Channel( "omega",      entry.keep(std::move(omega     )), XDMF::Channel::DataForm::Vector,     rigidType, typeTokenize<RigidReal3>() ),
+        XDMF::Channel( "force",      entry.keep(std::move(force     )), XDMF::Channel::DataForm::Vector,     rigidType, typeTokenize<RigidReal3>() ),
+        XDMF::Channel( "torque",     entry.keep(std::move(torque    )), XDMF::Channel::DataForm::Vector,     rigidType, typeTokenize<RigidReal3>() )
     };         
 
-    _extractPersistentExtraObjectData(channels, /* blacklist */ {ChannelNames::motions} );
+    _extractPersistentExtraObjectData(entry, /* blacklist */ {ChannelNames::motions} );
     
-    XDMF::write(filename, &grid, channels, comm);
-
-    RestartHelpers::make_symlink(comm, path, name + ".obj", filename);
+    _writeCheckpointEntry(std::move(entry), comm);
 
-    debug("Checkpoint for object vector '%s' successfully written", name.c_str());
+    debug("Checkpoint for object vector '%s' successfully taken", name.c_str());
 }
 
 static void shiftCoordinates(const DomainInfo& domain, std::vector<RigidMotion>& motions)
@@ -163,10 +264,10 @@ void RigidObjectVector::_restartObjectData(MPI_Comm comm, std::string path, cons
 {
     CUDA_Check( cudaDeviceSynchronize() );
 
-    std::string filename = path + "/" + name + ".obj.xmf";
-    info("Restarting rigid object vector %s from file %s", name.c_str(), filename.c_str());
+    auto source = RestartHelpers::getCheckpointSource(comm, path, name + ".obj");
+    info("Restarting rigid object vector %s from file %s", name.c_str(), source.filename.c_str());
 
-    XDMF::readRigidObjectData(filename, comm, this);
+    XDMF::readRigidObjectData(source.filename, source.comm, this);
 
     auto loc_ids     = local()->extraPerObject.getData<int>(ChannelNames::globalIds);
     auto loc_motions = local()->extraPerObject.getData<RigidMotion>(ChannelNames::motions);
@@ -15,6 +15,26 @@ public:
     PinnedBuffer<Particle>* getOldMeshVertices(cudaStream_t stream) override;
     DeviceBuffer<Force>* getMeshForces(cudaStream_t stream) override;
 
+    /// only while there are no objects, see RigidObjectVector::selectFrozenParticles()
+    void setObjSize(int size);
+
+    void setOwner(const std::string& owner) override
+    {
+        LocalObjectVector::setOwner(owner);
+        meshVertices   .setOwner(owner + ":meshVertices");
+        meshOldVertices.setOwner(owner + ":meshOldVertices");
+        meshForces     .setOwner(owner + ":meshForces");
+    }
+
+    std::vector<GPUcontainer*> getContainers() override
+    {
+        auto containers = LocalObjectVector::getContainers();
+        containers.push_back(&meshVertices);
+        containers.push_back(&meshOldVertices);
+        containers.push_back(&meshForces);
+        return containers;
+    }
+
 protected:
     PinnedBuffer<Particle> meshVertices;
     PinnedBuffer<Particle> meshOldVertices;
@@ -37,8 +57,31 @@ public:
     LocalRigidObjectVector* halo()  { return static_cast<LocalRigidObjectVector*>(_halo);  }
 
     virtual ~RigidObjectVector() = default;
-    
+
+    /**
+     * Only store the frozen particles within \p thickness of the surface of the objects.
+     * With a thickness above the cutoff radius the other particles, kept outside by the bouncers,
+     * cannot reach the interior ones; the dropped particles still count in the mass of the objects.
+     * Must be set before the initial conditions, a non-positive thickness keeps all the particles
+     */
+    void useSurfaceLayer(float thickness);
+
+    /**
+     * Called by the initial conditions with the frozen particles of one object in its frame.
+     * Drops the interior ones if a surface layer is used and reduces the object size accordingly
+     */
+    void selectFrozenParticles(PyTypes::VectorOfFloat3& coords);
+
+    /// mass of one object, including the interior particles that are not stored
+    float getObjectMass() const;
+
 protected:
+    /// distance to the surface of the objects of the point \p r given in their frame, the mesh by default
+    virtual float distanceToSurface(float3 r) const;
+
+    float surfaceLayer{-1.0f};
+    int fullObjSize;
+
     RigidObjectVector(const YmrState *state, std::string name, float partMass, float3 J, const int objSize,
                       std::shared_ptr<Mesh> mesh, const int nObjects = 0);
 
@@ -0,0 +1,210 @@
+#include "spatial_index.h"
+
+#include <core/logger.h>
+#include <core/utils/cuda_common.h>
+
+#include <cstdio>
+#include <cstring>
+
+namespace SpatialIndex
+{
+
+static const char magic[] = "YMR_SPATIAL_IDX";
+
+struct Header
+{
+    char magic[16];
+    int3 nblocks;
+    float3 globalSize;
+};
+
+static int3 getRanks3D(const DomainInfo& domain, int3& rank3D)
+{
+    rank3D = make_int3( floorf(domain.globalStart / domain.localSize + 0.5f) );
+    return make_int3( floorf(domain.globalSize / domain.localSize + 0.5f) );
+}
+
+std::vector<Block> sortByBlocks(const DomainInfo& domain, const PinnedBuffer<Particle>& particles, std::vector<int>& order)
+{
+    const int k = blocksPerRank;
+    const int nLocalBlocks = k*k*k;
+    const int n = particles.size();
+
+    int3 rank3D;
+    const int3 nblocks = getRanks3D(domain, rank3D) * k;
+    const float3 h = domain.localSize / k;
+
+    std::vector<Block> blocks(nLocalBlocks);
+    for (int b = 0; b < nLocalBlocks; b++)
+    {
+        const int3 loc = make_int3(b % k, (b / k) % k, b / (k*k));
+        const int3 g = rank3D * k + loc;
+
+        blocks[b].id = (g.z * nblocks.y + g.y) * nblocks.x + g.x;
+        blocks[b].count = 0;
+        blocks[b].lo = make_float3( 1e30f);
+        blocks[b].hi = make_float3(-1e30f);
+    }
+
+    // particles slightly out of the subdomain go to the boundary blocks,
+    // the bounding boxes keep track of them
+    std::vector<int> blockOf(n);
+    for (int i = 0; i < n; i++)
+    {
+        const float3 r = particles[i].r;
+        const int3 b3 = min( max( make_int3(floorf( (r + 0.5f * domain.localSize) / h )), make_int3(0) ), make_int3(k-1) );
+        const int b = (b3.z * k + b3.y) * k + b3.x;
+
+        const float3 rg = domain.local2global(r);
+        blockOf[i] = b;
+        blocks[b].count++;
+        blocks[b].lo = fminf(blocks[b].lo, rg);
+        blocks[b].hi = fmaxf(blocks[b].hi, rg);
+    }
+
+    long long offset = 0;
+    std::vector<long long> starts(nLocalBlocks);
+    for (int b = 0; b < nLocalBlocks; b++)
+    {
+        blocks[b].offset = starts[b] = offset;
+        offset += blocks[b].count;
+    }
+
+    order.resize(n);
+    for (int i = 0; i < n; i++)
+        order[ starts[blockOf[i]]++ ] = i;
+
+    return blocks;
+}
+
+void write(std::string filename, MPI_Comm comm, const DomainInfo& domain,
+           const std::vector<Block>& localBlocks, long long localOffset)
+{
+    int rank, size;
+    MPI_Check( MPI_Comm_rank(comm, &rank) );
+    MPI_Check( MPI_Comm_size(comm, &size) );
+
+    std::vector<Block> shifted = localBlocks;
+    for (auto& b : shifted)
+        b.offset += localOffset;
+
+    const int nLocal = shifted.size() * sizeof(Block);
+    std::vector<Block> all(rank == 0 ? shifted.size() * size : 0);
+
+    MPI_Check( MPI_Gather(shifted.data(), nLocal, MPI_BYTE, all.data(), nLocal, MPI_BYTE, 0, comm) );
+
+    if (rank != 0) return;
+
+    int3 rank3D;
+    Header header;
+    memset(&header, 0, sizeof(header));
+    strncpy(header.magic, magic, sizeof(header.magic));
+    header.nblocks    = getRanks3D(domain, rank3D) * blocksPerRank;
+    header.globalSize = domain.globalSize;
+
+    const int totBlocks = header.nblocks.x * header.nblocks.y * header.nblocks.z;
+    std::vector<Block> blocks(totBlocks);
+    for (int i = 0; i < totBlocks; i++)
+        blocks[i] = {i, 0, 0, make_float3(0.0f), make_float3(0.0f)};
+
+    for (auto& b : all)
+    {
+        if (b.id < 0 || b.id >= totBlocks)
+            die("Wrong block id %d while writing the spatial index '%s'", b.id, filename.c_str());
+        blocks[b.id] = b;
+    }
+
+    FILE *fout = fopen(filename.c_str(), "wb");
+    if (fout == nullptr)
+    {
+        error("Could not write the spatial index '%s'", filename.c_str());
+        return;
+    }
+
+    fwrite(&header, sizeof(header), 1, fout);
+    fwrite(blocks.data(), sizeof(Block), totBlocks, fout);
+    fclose(fout);
+}
+
+static bool readBlocks(std::string filename, const DomainInfo& domain, std::vector<Block>& blocks)
+{
+    FILE *fin = fopen(filename.c_str(), "rb");
+    if (fin == nullptr) return false;
+
+    Header header;
+    bool good = fread(&header, sizeof(header), 1, fin) == 1 &&
+        strncmp(header.magic, magic, sizeof(header.magic)) == 0;
+
+    if (good && length(header.globalSize - domain.globalSize) > 1e-3f * length(domain.globalSize))
+    {
+        warn("Spatial index '%s' was written for another domain, falling back to the global exchange", filename.c_str());
+        good = false;
+    }
+
+    if (good)
+    {
+        blocks.resize(header.nblocks.x * header.nblocks.y * header.nblocks.z);
+        good = fread(blocks.data(), sizeof(Block), blocks.size(), fin) == blocks.size();
+    }
+
+    fclose(fin);
+    return good;
+}
+
+bool readRanges(std::string filename, MPI_Comm comm, const DomainInfo& domain,
+                std::vector<std::pair<long long, long long>>& ranges)
+{
+    int rank;
+    MPI_Check( MPI_Comm_rank(comm, &rank) );
+
+    std::vector<Block> blocks;
+    int good = 0, nblocks = 0;
+
+    if (rank == 0)
+    {
+        good = readBlocks(filename, domain, blocks);
+        nblocks = blocks.size();
+    }
+
+    MPI_Check( MPI_Bcast(&good, 1, MPI_INT, 0, comm) );
+    if (!good) return false;
+
+    MPI_Check( MPI_Bcast(&nblocks, 1, MPI_INT, 0, comm) );
+    blocks.resize(nblocks);
+    MPI_Check( MPI_Bcast(blocks.data(), nblocks * sizeof(Block), MPI_BYTE, 0, comm) );
+
+    const float3 lo = domain.globalStart;
+    const float3 hi = domain.globalStart + domain.localSize;
+
+    ranges.clear();
+    for (auto& b : blocks)
+    {
+        if (b.count == 0) continue;
+
+        const bool overlaps = b.lo.x < hi.x && lo.x <= b.hi.x &&
+                              b.lo.y < hi.y && lo.y <= b.hi.y &&
+                              b.lo.z < hi.z && lo.z <= b.hi.z;
+        if (!overlaps) continue;
+
+        // neighbouring blocks of the same writer are contiguous in the file
+        if (!ranges.empty() && ranges.back().first + ranges.back().second == b.offset)
+            ranges.back().second += b.count;
+        else
+            ranges.push_back({b.offset, b.count});
+    }
+
+    debug("Spatial index '%s': reading %d ranges of the file", filename.c_str(), (int) ranges.size());
+    return true;
+}
+
+std::string indexFilename(std::string xmfFilename)
+{
+    const std::string ext = ".xmf";
+    if (xmfFilename.size() >= ext.size() &&
+        xmfFilename.compare(xmfFilename.size() - ext.size(), ext.size(), ext) == 0)
+        xmfFilename.resize(xmfFilename.size() - ext.size());
+
+    return xmfFilename + ".index";
+}
+
+} // namespace SpatialIndex
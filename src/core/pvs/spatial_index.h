@@ -0,0 +1,59 @@
+#pragma once
+
+#include <core/containers.h>
+#include <core/datatypes.h>
+#include <core/domain.h>
+
+#include <mpi.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Spatial index of the particles of a checkpoint file.
+ *
+ * Before writing, every rank sorts its particles into blocksPerRank^3 blocks
+ * of its subdomain; the index file <checkpoint>.index then gives for every block
+ * of the global domain the range of particles in the file and their bounding box.
+ * At restart, possibly on another number of ranks, every rank reads only the ranges
+ * of the blocks whose box overlaps its subdomain and keeps the particles
+ * inside it, which replaces the global exchange of the particles.
+ */
+namespace SpatialIndex
+{
+const int blocksPerRank = 4;
+
+struct Block
+{
+    int id;              ///< global block id
+    long long offset;    ///< first particle in the file
+    long long count;
+    float3 lo, hi;       ///< bounding box of the particles, global coordinates
+};
+
+/**
+ * Sort the \p particles (on the host, local coordinates) by local block.
+ * @param order filled with the ids of the particles in the sorted order
+ * @return the local blocks, with offsets relative to the first local particle
+ */
+std::vector<Block> sortByBlocks(const DomainInfo& domain, const PinnedBuffer<Particle>& particles, std::vector<int>& order);
+
+/**
+ * Write the index of all the ranks of \p comm, whose local particles start at \p localOffset in the file.
+ * Collective, the master rank writes the file
+ */
+void write(std::string filename, MPI_Comm comm, const DomainInfo& domain,
+           const std::vector<Block>& localBlocks, long long localOffset);
+
+/**
+ * Read the index and find the ranges [offset, count] of the file to read for the local subdomain.
+ * Collective, the master rank reads the file.
+ * @return false if there is no index file, or if it was written for another global domain
+ */
+bool readRanges(std::string filename, MPI_Comm comm, const DomainInfo& domain,
+                std::vector<std::pair<long long, long long>>& ranges);
+
+/// name of the index of the checkpoint \p xmfFilename
+std::string indexFilename(std::string xmfFilename);
+
+} // namespace SpatialIndex
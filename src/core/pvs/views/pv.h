@@ -14,6 +14,9 @@ struct PVview
     float4 *particles = nullptr;
     float4 *forces = nullptr;
 
+    /// packed coordinates, see LocalParticleVector::positions; nullptr if not up to date
+    const float4 *positions = nullptr;
+
     float mass = 0, invMass = 0;
 
     PVview(ParticleVector *pv = nullptr, LocalParticleVector *lpv = nullptr)
@@ -24,9 +27,53 @@ struct PVview
         particles = reinterpret_cast<float4*>(lpv->coosvels.devPtr());
         forces    = reinterpret_cast<float4*>(lpv->forces.devPtr());
 
+        if (lpv->positionsStamp == pv->cellListStamp && lpv->positions.size() >= size)
+            positions = lpv->positions.devPtr();
+
         mass = pv->mass;
         invMass = 1.0 / mass;
     }
+
+    /// @return address of the coordinates of particle \p pid, within #positions if available
+    __HD__ inline const float4* positionPtr(int pid) const
+    {
+        return positions != nullptr ? positions + pid : particles + 2*pid;
+    }
+
+    /// read only the coordinates of particle \p pid into \p p, see Particle::readCoordinate()
+    __HD__ inline void readCoordinate(Particle& p, int pid) const
+    {
+        const Float3_int tmp(*positionPtr(pid));
+        p.r  = tmp.v;
+        p.i1 = tmp.i;
+    }
+};
+
+
+/**
+ * \p BasicView whose packed #positions are known to be up to date:
+ * the coordinates are read from them without the run-time check of PVview::positionPtr().
+ * The fetchers of the pairwise interactions take the view type as a template parameter,
+ * such that they pick these functions at compile time, see PackedPositionsFetcher
+ */
+template <class BasicView>
+struct PVviewPackedPositions : public BasicView
+{
+    PVviewPackedPositions(const BasicView& view) :
+        BasicView(view)
+    {}
+
+    __HD__ inline const float4* positionPtr(int pid) const
+    {
+        return this->positions + pid;
+    }
+
+    __HD__ inline void readCoordinate(Particle& p, int pid) const
+    {
+        const Float3_int tmp(this->positions[pid]);
+        p.r  = tmp.v;
+        p.i1 = tmp.i;
+    }
 };
 
 
@@ -42,6 +89,26 @@ struct PVviewWithOldParticles : public PVview
     }
 };
 
+/**
+ * PVview with, in addition, a compressed copy of the particles (see CompressedParticleFetcher):
+ * 16-bit fixed point coordinates within the box [lo, lo + 65535*step], FP16 velocities
+ * and the lower part of the id, packed in one uint4 per particle.
+ * \c compressed is nullptr if only the full precision data is available.
+ */
+struct PVviewCompressed : public PVview
+{
+    const uint4 *compressed = nullptr;
+    float3 lo, step;
+
+    PVviewCompressed(ParticleVector *pv = nullptr, LocalParticleVector *lpv = nullptr) :
+        PVview(pv, lpv)
+    {}
+
+    PVviewCompressed(const PVview& view) :
+        PVview(view)
+    {}
+};
+
 struct PVviewWithDensities : public PVview
 {
     float *densities = nullptr;
@@ -54,6 +121,19 @@ struct PVviewWithDensities : public PVview
     }
 };
 
+/// species index of every particle, see ChannelNames::species
+struct PVviewWithSpecies : public PVview
+{
+    const int *species = nullptr;
+
+    PVviewWithSpecies(ParticleVector *pv = nullptr, LocalParticleVector *lpv = nullptr) :
+        PVview(pv, lpv)
+    {
+        if (lpv != nullptr)
+            species = lpv->extraPerParticle.getData<int>(ChannelNames::species)->devPtr();
+    }
+};
+
 template <typename BasicView> 
 struct PVviewWithStresses : public BasicView
 {
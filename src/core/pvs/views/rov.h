@@ -26,6 +26,10 @@ struct ROVview : public OVview
         // More fields
         J = rov->J;
         J_1 = 1.0 / J;
+
+        // the object may store only a surface layer of its particles
+        objMass = rov->getObjectMass();
+        invObjMass = 1.0 / objMass;
     }
 };
 
@@ -0,0 +1,324 @@
+#include "rank_placement.h"
+
+#include <core/logger.h>
+#include <core/mpi/fragments_mapping.h>
+#include <core/utils/helper_math.h>
+
+#include <algorithm>
+#include <limits>
+
+int3 chooseNodeBlock(int3 nranks3D, int nodeSize, float3 localSize)
+{
+    const float faceX = localSize.y * localSize.z;
+    const float faceY = localSize.x * localSize.z;
+    const float faceZ = localSize.x * localSize.y;
+
+    int3 best {0, 0, 0};
+    float bestCost = std::numeric_limits<float>::max();
+
+    for (int bx = 1; bx <= nranks3D.x; bx++)
+    {
+        if (nranks3D.x % bx != 0 || nodeSize % bx != 0) continue;
+
+        for (int by = 1; by <= nranks3D.y; by++)
+        {
+            if (nranks3D.y % by != 0 || (nodeSize / bx) % by != 0) continue;
+
+            const int bz = nodeSize / (bx * by);
+            if (bz > nranks3D.z || nranks3D.z % bz != 0) continue;
+
+            const float cost = (bx == nranks3D.x ? 0.0f : by * bz * faceX) +
+                               (by == nranks3D.y ? 0.0f : bx * bz * faceY) +
+                               (bz == nranks3D.z ? 0.0f : bx * by * faceZ);
+
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                best = {bx, by, bz};
+            }
+        }
+    }
+
+    return best;
+}
+
+/// rank of the Cartesian coordinates in the default (row-major) order of MPI_Cart_create
+static int cartesianKey(int3 coords, int3 nranks3D)
+{
+    return (coords.x * nranks3D.y + coords.y) * nranks3D.z + coords.z;
+}
+
+static int3 rowMajorCoords(int id, int3 dims)
+{
+    return { id / (dims.y * dims.z), (id / dims.z) % dims.y, id % dims.z };
+}
+
+/**
+ * Key of this rank in the node-aware order, -1 if the default placement has to be used
+ */
+static int nodeAwareKey(MPI_Comm comm, int3 nranks3D, float3 localSize)
+{
+    int rank;
+    MPI_Check( MPI_Comm_rank(comm, &rank) );
+
+    MPI_Comm shmComm;
+    MPI_Check( MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &shmComm) );
+
+    int shmRank, shmSize;
+    MPI_Check( MPI_Comm_rank(shmComm, &shmRank) );
+    MPI_Check( MPI_Comm_size(shmComm, &shmSize) );
+
+    // number the nodes by their first rank
+    MPI_Comm leadersComm;
+    MPI_Check( MPI_Comm_split(comm, shmRank == 0 ? 0 : MPI_UNDEFINED, rank, &leadersComm) );
+
+    int nodeId = 0;
+    if (leadersComm != MPI_COMM_NULL)
+    {
+        MPI_Check( MPI_Comm_rank(leadersComm, &nodeId) );
+        MPI_Check( MPI_Comm_free(&leadersComm) );
+    }
+    MPI_Check( MPI_Bcast(&nodeId, 1, MPI_INT, 0, shmComm) );
+    MPI_Check( MPI_Comm_free(&shmComm) );
+
+    int minSize, maxSize;
+    MPI_Check( MPI_Allreduce(&shmSize, &minSize, 1, MPI_INT, MPI_MIN, comm) );
+    MPI_Check( MPI_Allreduce(&shmSize, &maxSize, 1, MPI_INT, MPI_MAX, comm) );
+
+    if (minSize != maxSize)
+    {
+        warn("Nodes have from %d to %d ranks, node-aware placement requires the same number on all of them; "
+             "using the default placement", minSize, maxSize);
+        return -1;
+    }
+
+    const int3 block = chooseNodeBlock(nranks3D, shmSize, localSize);
+    if (block.x == 0)
+    {
+        warn("No block of %d ranks tiles the %d x %d x %d grid of ranks; using the default placement",
+             shmSize, nranks3D.x, nranks3D.y, nranks3D.z);
+        return -1;
+    }
+
+    info("Node-aware placement: each node holds a block of %d x %d x %d subdomains", block.x, block.y, block.z);
+
+    const int3 nodeGrid   { nranks3D.x / block.x, nranks3D.y / block.y, nranks3D.z / block.z };
+    const int3 nodeCoords = rowMajorCoords(nodeId,  nodeGrid);
+    const int3 inBlock    = rowMajorCoords(shmRank, block);
+
+    const int3 coords { nodeCoords.x * block.x + inBlock.x,
+                        nodeCoords.y * block.y + inBlock.y,
+                        nodeCoords.z * block.z + inBlock.z };
+
+    return cartesianKey(coords, nranks3D);
+}
+
+void createCartComm(MPI_Comm comm, int3 nranks3D, float3 localSize, bool nodeAware, MPI_Comm *cartComm)
+{
+    int ranksArr[] = {nranks3D.x, nranks3D.y, nranks3D.z};
+    int periods[] = {1, 1, 1};
+
+    const int key = nodeAware ? nodeAwareKey(comm, nranks3D, localSize) : -1;
+
+    // all the ranks took the same decision, the checks above are collective
+    if (key < 0)
+    {
+        int reorder = 1;
+        MPI_Check( MPI_Cart_create(comm, 3, ranksArr, periods, reorder, cartComm) );
+        return;
+    }
+
+    MPI_Comm ordered;
+    MPI_Check( MPI_Comm_split(comm, 0, key, &ordered) );
+
+    int reorder = 0;
+    MPI_Check( MPI_Cart_create(ordered, 3, ranksArr, periods, reorder, cartComm) );
+    MPI_Check( MPI_Comm_free(&ordered) );
+}
+
+void reportHaloLocality(MPI_Comm cartComm, float3 localSize, float rc)
+{
+    int dims[3], periods[3], coords[3];
+    MPI_Check( MPI_Cart_get(cartComm, 3, dims, periods, coords) );
+
+    MPI_Comm shmComm;
+    MPI_Check( MPI_Comm_split_type(cartComm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &shmComm) );
+
+    MPI_Group cartGroup, shmGroup;
+    MPI_Check( MPI_Comm_group(cartComm, &cartGroup) );
+    MPI_Check( MPI_Comm_group(shmComm,  &shmGroup) );
+
+    const float sizes[3] = {localSize.x, localSize.y, localSize.z};
+
+    // [0] within the node, [1] to other nodes
+    double volumes[2] = {0, 0};
+
+    for (int i = 0; i < FragmentMapping::numFragments; i++)
+    {
+        if (i == FragmentMapping::bulkId) continue;
+
+        const int3 dir = FragmentMapping::getDir(i);
+        const int d[3] = {dir.x, dir.y, dir.z};
+
+        int neighCoords[3];
+        double volume = 1;
+        for (int c = 0; c < 3; c++)
+        {
+            neighCoords[c] = coords[c] + d[c];
+            volume *= (d[c] == 0) ? sizes[c] : rc;
+        }
+
+        int neighRank, shmRank;
+        MPI_Check( MPI_Cart_rank(cartComm, neighCoords, &neighRank) );
+        MPI_Check( MPI_Group_translate_ranks(cartGroup, 1, &neighRank, shmGroup, &shmRank) );
+
+        volumes[shmRank == MPI_UNDEFINED ? 1 : 0] += volume;
+    }
+
+    MPI_Check( MPI_Group_free(&shmGroup) );
+    MPI_Check( MPI_Group_free(&cartGroup) );
+    MPI_Check( MPI_Comm_free(&shmComm) );
+
+    int rank;
+    MPI_Check( MPI_Comm_rank(cartComm, &rank) );
+
+    double total[2];
+    MPI_Check( MPI_Reduce(volumes, total, 2, MPI_DOUBLE, MPI_SUM, 0, cartComm) );
+
+    if (rank == 0)
+    {
+        const double all = total[0] + total[1];
+        info("Estimated halo bytes for cut-off %g: %.1f%% within the nodes, %.1f%% between the nodes",
+             rc, 100.0 * total[0] / all, 100.0 * total[1] / all);
+    }
+}
+
+/**
+ * Fraction of every load cell along one axis covered by every rank along that axis:
+ * the result has nranks rows of resolution entries
+ */
+static std::vector<double> axisOverlaps(int nranks, int resolution)
+{
+    std::vector<double> overlaps(nranks * resolution, 0.0);
+    for (int r = 0; r < nranks; r++)
+    {
+        // in units of load cells
+        const double lo = (double) r       * resolution / nranks;
+        const double hi = (double) (r + 1) * resolution / nranks;
+
+        for (int i = (int) lo; i < resolution && i < hi; i++)
+            overlaps[r * resolution + i] = std::min(hi, i + 1.0) - std::max(lo, (double) i);
+    }
+    return overlaps;
+}
+
+/// work of every rank of the grid \p dims from the load cells it covers, the total load per cell
+static std::vector<double> subdomainLoads(int3 dims, const std::vector<float>& load, int3 res)
+{
+    const auto wx = axisOverlaps(dims.x, res.x);
+    const auto wy = axisOverlaps(dims.y, res.y);
+    const auto wz = axisOverlaps(dims.z, res.z);
+
+    // contract one axis after the other: [i][j][k] -> [i][j][c] -> [i][b][c] -> [a][b][c]
+    std::vector<double> t1(res.x * res.y * dims.z, 0.0);
+    for (int ij = 0; ij < res.x * res.y; ij++)
+        for (int c = 0; c < dims.z; c++)
+            for (int k = 0; k < res.z; k++)
+                t1[ij * dims.z + c] += load[ij * res.z + k] * wz[c * res.z + k];
+
+    std::vector<double> t2(res.x * dims.y * dims.z, 0.0);
+    for (int i = 0; i < res.x; i++)
+        for (int b = 0; b < dims.y; b++)
+            for (int j = 0; j < res.y; j++)
+                for (int c = 0; c < dims.z; c++)
+                    t2[(i * dims.y + b) * dims.z + c] += t1[(i * res.y + j) * dims.z + c] * wy[b * res.y + j];
+
+    std::vector<double> loads(dims.x * dims.y * dims.z, 0.0);
+    for (int a = 0; a < dims.x; a++)
+        for (int i = 0; i < res.x; i++)
+            for (int bc = 0; bc < dims.y * dims.z; bc++)
+                loads[a * dims.y * dims.z + bc] += t2[i * dims.y * dims.z + bc] * wx[a * res.x + i];
+
+    return loads;
+}
+
+RankGridChoice chooseRankGrid(int nranks, float3 globalSize, float rc,
+                              const std::vector<float>& load, int3 loadResolution, int3 fixed)
+{
+    if (nranks <= 0)
+        die("Cannot split the domain among %d ranks", nranks);
+
+    // a uniform load is one cell
+    std::vector<float> cells = load;
+    int3 res = loadResolution;
+    if (cells.empty())
+    {
+        cells = {1.0f};
+        res = {1, 1, 1};
+    }
+
+    if (res.x <= 0 || res.y <= 0 || res.z <= 0 || (long) res.x * res.y * res.z != (long) cells.size())
+        die("The load estimate has %d values, but its resolution is %d x %d x %d",
+            (int) cells.size(), res.x, res.y, res.z);
+
+    // number of particles per load cell
+    const double cellVolume = (double) globalSize.x * globalSize.y * globalSize.z / cells.size();
+    for (auto& c : cells)
+        c *= cellVolume;
+
+    RankGridChoice best;
+    double bestHalo = std::numeric_limits<double>::max();
+    best.maxWork = std::numeric_limits<double>::max();
+
+    for (int nx = 1; nx <= nranks; nx++)
+    {
+        if (nranks % nx != 0 || (fixed.x > 0 && fixed.x != nx)) continue;
+
+        for (int ny = 1; ny <= nranks / nx; ny++)
+        {
+            if ((nranks / nx) % ny != 0 || (fixed.y > 0 && fixed.y != ny)) continue;
+
+            const int nz = nranks / (nx * ny);
+            if (fixed.z > 0 && fixed.z != nz) continue;
+
+            const int3 dims {nx, ny, nz};
+            const float3 L = globalSize / make_float3(dims);
+
+            // the halo grows the subdomain along the split axes only
+            const double volume   = (double) L.x * L.y * L.z;
+            const double extended = (double) (L.x + (nx > 1 ? 2*rc : 0.0f)) *
+                                             (L.y + (ny > 1 ? 2*rc : 0.0f)) *
+                                             (L.z + (nz > 1 ? 2*rc : 0.0f));
+            const double haloFraction = extended / volume - 1.0;
+
+            auto work = subdomainLoads(dims, cells, res);
+            double maxWork = 0, totalWork = 0;
+            for (auto& w : work)
+            {
+                w *= 1.0 + haloFraction;
+                maxWork = std::max(maxWork, w);
+                totalWork += w;
+            }
+
+            const double halo = totalWork * haloFraction / (1.0 + haloFraction);
+            const bool better = maxWork < best.maxWork * (1.0 - 1e-6) ||
+                                (maxWork <= best.maxWork * (1.0 + 1e-6) && halo < bestHalo);
+
+            if (better)
+            {
+                best.nranks3D = dims;
+                best.maxWork  = maxWork;
+                best.meanWork = totalWork / nranks;
+                best.haloFraction = haloFraction;
+                best.work = std::move(work);
+                bestHalo = halo;
+            }
+        }
+    }
+
+    if (best.nranks3D.x == 0)
+        die("No grid of %d ranks matches the imposed dimensions %d x %d x %d",
+            nranks, fixed.x, fixed.y, fixed.z);
+
+    return best;
+}
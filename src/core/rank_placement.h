@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cuda_runtime.h>
+#include <mpi.h>
+#include <vector>
+
+/**
+ * Placement of the ranks on the 3D Cartesian grid of subdomains.
+ *
+ * By default the grid follows the order of the ranks in the communicator,
+ * and the subdomains of a node form a slab or a line that often crosses
+ * the whole domain: most of the halos then go to other nodes.
+ * With node-aware placement, the ranks sharing a node (MPI_COMM_TYPE_SHARED)
+ * are mapped to a compact block of the grid, chosen to minimize the halo surface
+ * between the nodes, so that most of the 26 fragments stay within the node.
+ */
+
+/**
+ * Dimensions of the block of ranks of one node: its volume is \p nodeSize,
+ * it tiles the grid \p nranks3D and its surface towards other nodes,
+ * weighted by the face areas of the subdomains of size \p localSize, is minimal.
+ * Faces along an axis covered by a single block are periodic within the node and do not count.
+ * @return {0, 0, 0} if no block tiles the grid
+ */
+int3 chooseNodeBlock(int3 nranks3D, int nodeSize, float3 localSize);
+
+/**
+ * Create the periodic Cartesian communicator over \p comm.
+ * If \p nodeAware, place the ranks of the same node in a compact block, see chooseNodeBlock().
+ * Falls back to the default placement if the nodes have different numbers of ranks
+ * or if no block tiles the grid. Collective over \p comm
+ */
+void createCartComm(MPI_Comm comm, int3 nranks3D, float3 localSize, bool nodeAware, MPI_Comm *cartComm);
+
+/**
+ * Log on rank 0 which fraction of the halo stays within the nodes.
+ * The halo of each of the 26 fragments is estimated as the volume of the fragment
+ * of thickness \p rc, i.e. for a uniform particle density. Collective over \p cartComm
+ */
+void reportHaloLocality(MPI_Comm cartComm, float3 localSize, float rc);
+
+/// a grid of ranks chosen by chooseRankGrid() and its estimated cost
+struct RankGridChoice
+{
+    int3 nranks3D {0, 0, 0};
+    double maxWork  {0};    ///< of the most loaded rank, particles including the halo
+    double meanWork {0};
+    double haloFraction {0}; ///< received halo volume over the subdomain volume
+    std::vector<double> work; ///< of every rank, in the row-major order of the grid
+};
+
+/**
+ * Factorize \p nranks into a grid of subdomains of the domain \p globalSize
+ * minimizing the work of the most loaded rank: the particles of its subdomain and of its halo of width \p rc.
+ * The halo is only counted along the axes split among several ranks.
+ * The work is estimated from \p load, the coarse number density on a grid of \p loadResolution cells covering the domain
+ * in row-major order (x slowest), uniform if empty. The non-zero components of \p fixed are imposed.
+ * Among grids of equal worst work, the smaller total halo wins. Dies if no grid fits
+ */
+RankGridChoice chooseRankGrid(int nranks, float3 globalSize, float rc,
+                              const std::vector<float>& load = {}, int3 loadResolution = {0, 0, 0},
+                              int3 fixed = {0, 0, 0});
@@ -0,0 +1,134 @@
+#include "ellipsoid_shell.h"
+
+#include <core/logger.h>
+#include <core/utils/kernel_launch.h>
+
+#include <extern/cub/cub/device/device_scan.cuh>
+
+namespace EllipsoidShellKernels
+{
+
+/**
+ * One block per object goes over the cells of its box.
+ * Without cells, only count the candidate cells of each object,
+ * otherwise write them starting from offsets[objId]
+ */
+__global__ void collectShellCells(REOVview view, const RigidMotion *oldMotions, CellListInfo cinfo,
+                                  float margin, bool keepInside,
+                                  int *counts, const int *offsets, ShellCell *cells)
+{
+    const int objId = blockIdx.x;
+    const int tid = threadIdx.x;
+    if (objId >= view.nObjects) return;
+
+    __shared__ int nCells;
+    if (tid == 0) nCells = 0;
+    __syncthreads();
+
+    const auto motion = toSingleMotion(view.motions[objId]);
+
+    if (oldMotions != nullptr)
+    {
+        // surface points move by at most the COM displacement plus the rotation around it
+        const auto oldMotion = toSingleMotion(oldMotions[objId]);
+        const float maxAxis = fmaxf(view.axes.x, fmaxf(view.axes.y, view.axes.z));
+        const float4 dq = multiplyQ(motion.q, invQ(oldMotion.q));
+        const float angle = 2.0f * acosf(fminf(fabsf(dq.x), 1.0f));
+
+        margin += length(motion.r - oldMotion.r) + maxAxis * angle;
+    }
+
+    const float3 extent = ellipsoidHalfExtent(view.axes, motion.q) + margin;
+
+    const int3 cidLow  = cinfo.getCellIdAlongAxes<CellListsProjection::NoClamp>(motion.r - extent);
+    const int3 cidHigh = cinfo.getCellIdAlongAxes<CellListsProjection::NoClamp>(motion.r + extent);
+
+    // the box may be entirely out of the local domain, e.g. for halo objects
+    const int3 lo = max(cidLow,  make_int3(0));
+    const int3 hi = min(cidHigh, cinfo.ncells - 1);
+
+    const int3 span = max(hi - lo + make_int3(1,1,1), make_int3(0));
+    const int totCells = span.x * span.y * span.z;
+
+    for (int i = tid; i < totCells; i += blockDim.x)
+    {
+        const int3 cid3 = make_int3( i % span.x, (i/span.x) % span.y, i / (span.x*span.y) ) + lo;
+        const auto type = classifyCell(cid3, motion, view.axes, cinfo, margin);
+
+        if (type == ShellCellType::Outside) continue;
+        if (type == ShellCellType::Inside && !keepInside) continue;
+
+        const int id = atomicAggInc(&nCells);
+        if (cells != nullptr)
+            cells[offsets[objId] + id] = { objId, cinfo.encode(cid3), type == ShellCellType::Inside };
+    }
+
+    __syncthreads();
+
+    if (tid == 0 && cells == nullptr)
+        counts[objId] = nCells;
+}
+
+} // namespace EllipsoidShellKernels
+
+
+EllipsoidShell::EllipsoidShell()
+{
+    for (auto buf : {&counts, &offsets})
+        buf->setOwner("ellipsoid_shell:offsets");
+    scanBuffer.setOwner("ellipsoid_shell:scan");
+    cells.setOwner("ellipsoid_shell:cells");
+}
+
+void EllipsoidShell::build(const REOVview& view, const RigidMotion *oldMotions, CellListInfo cinfo,
+                           float margin, bool keepInside, cudaStream_t stream)
+{
+    const int nObjects = view.nObjects;
+    const int nthreads = 128;
+
+    nCells[0] = 0;
+    if (nObjects == 0)
+    {
+        cells.resize_anew(0);
+        return;
+    }
+
+    counts .resize_anew(nObjects + 1);
+    offsets.resize_anew(nObjects + 1);
+    counts.clear(stream);
+
+    SAFE_KERNEL_LAUNCH(
+            EllipsoidShellKernels::collectShellCells,
+            nObjects, nthreads, 0, stream,
+            view, oldMotions, cinfo, margin, keepInside,
+            counts.devPtr(), nullptr, nullptr );
+
+    size_t bufSize = 0;
+    cub::DeviceScan::ExclusiveSum(nullptr, bufSize, counts.devPtr(), offsets.devPtr(), nObjects+1, stream);
+    scanBuffer.resize_anew(bufSize);
+    cub::DeviceScan::ExclusiveSum(scanBuffer.devPtr(), bufSize, counts.devPtr(), offsets.devPtr(), nObjects+1, stream);
+
+    CUDA_Check( cudaMemcpyAsync(nCells.hostPtr(), offsets.devPtr() + nObjects, sizeof(int),
+                                cudaMemcpyDeviceToHost, stream) );
+    CUDA_Check( cudaStreamSynchronize(stream) );
+
+    cells.resize_anew(nCells[0]);
+
+    SAFE_KERNEL_LAUNCH(
+            EllipsoidShellKernels::collectShellCells,
+            nObjects, nthreads, 0, stream,
+            view, oldMotions, cinfo, margin, keepInside,
+            nullptr, offsets.devPtr(), cells.devPtr() );
+
+    debug2("Collected %d candidate cells around %d ellipsoids", nCells[0], nObjects);
+}
+
+int EllipsoidShell::size() const
+{
+    return nCells[0];
+}
+
+const ShellCell* EllipsoidShell::devPtr() const
+{
+    return cells.devPtr();
+}
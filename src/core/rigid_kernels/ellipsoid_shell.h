@@ -0,0 +1,100 @@
+#pragma once
+
+#include <core/celllist.h>
+#include <core/containers.h>
+#include <core/pvs/views/reov.h>
+#include <core/rigid_kernels/quaternion.h>
+#include <core/utils/cuda_common.h>
+
+#include <cuda_runtime.h>
+
+/// Candidate cell of an ellipsoid
+struct ShellCell
+{
+    int objId, cellId;
+    bool inside;  ///< the whole cell is inside the ellipsoid
+};
+
+#ifdef __CUDACC__
+__device__ inline float ellipsoidF(const float3 r, const float3 invAxes)
+{
+    return sqr(r.x * invAxes.x) + sqr(r.y * invAxes.y) + sqr(r.z * invAxes.z) - 1.0f;
+}
+
+enum class ShellCellType { Outside, Shell, Inside };
+
+/**
+ * Classify the cell \p cid3 with respect to the ellipsoid with \p axes put at \p motion,
+ * its surface grown by \p margin on both sides.
+ *
+ * The cell lies within a ball of radius d around its center,
+ * and the points at distance at most d of an ellipsoid with axes a
+ * are inside the ellipsoid with axes a+d, so the test is conservative:
+ * - Outside cells do not touch the grown surface;
+ * - Inside cells are within the ellipsoid shrunk by the margin;
+ * - Shell cells may be crossed by the surface.
+ */
+__device__ inline ShellCellType classifyCell(int3 cid3, const SingleRigidMotion& motion, float3 axes,
+                                             const CellListInfo& cinfo, float margin)
+{
+    const float3 center = (make_float3(cid3) + 0.5f) * cinfo.h - 0.5f*cinfo.localDomainSize - motion.r;
+    const float3 coo = rotate(center, invQ(motion.q));
+
+    const float d = 0.5f * length(cinfo.h) + margin;
+
+    if (ellipsoidF(coo, 1.0f / (axes + d)) > 0.0f)
+        return ShellCellType::Outside;
+
+    const float3 inner = axes - d;
+    if (inner.x > 0.0f && inner.y > 0.0f && inner.z > 0.0f && ellipsoidF(coo, 1.0f / inner) < 0.0f)
+        return ShellCellType::Inside;
+
+    return ShellCellType::Shell;
+}
+
+/// half sizes of the axis aligned box around the ellipsoid with \p axes rotated by \p q
+__device__ inline float3 ellipsoidHalfExtent(float3 axes, float4 q)
+{
+    const float3 ex = axes.x * rotate(make_float3(1, 0, 0), q);
+    const float3 ey = axes.y * rotate(make_float3(0, 1, 0), q);
+    const float3 ez = axes.z * rotate(make_float3(0, 0, 1), q);
+
+    return make_float3( sqrtf(sqr(ex.x) + sqr(ey.x) + sqr(ez.x)),
+                        sqrtf(sqr(ex.y) + sqr(ey.y) + sqr(ez.y)),
+                        sqrtf(sqr(ex.z) + sqr(ey.z) + sqr(ez.z)) );
+}
+#endif
+
+/**
+ * Cells of a cell-list that the surfaces of rigid ellipsoids may cross.
+ *
+ * The list is generated on the GPU at every build() from the analytic shape:
+ * the cells of the box around each ellipsoid are classified with classifyCell(),
+ * counted per object, scanned and gathered, so that the kernels only go over
+ * the cells close to the surface (and optionally the ones fully inside)
+ * instead of the whole bounding box.
+ */
+class EllipsoidShell
+{
+public:
+    EllipsoidShell();
+
+    /**
+     * Collect the candidate cells of all the objects of \p view, the surfaces grown by \p margin.
+     * If \p oldMotions is given, \p margin is additionally grown for each object
+     * by the largest displacement of its surface since the old motion.
+     * With \p keepInside, the cells fully inside are kept as well, with ShellCell::inside set.
+     * Waits for the number of cells on the host
+     */
+    void build(const REOVview& view, const RigidMotion *oldMotions, CellListInfo cinfo,
+               float margin, bool keepInside, cudaStream_t stream);
+
+    int size() const;
+    const ShellCell* devPtr() const;
+
+private:
+    DeviceBuffer<int> counts, offsets;
+    DeviceBuffer<char> scanBuffer;
+    DeviceBuffer<ShellCell> cells;
+    PinnedBuffer<int> nCells{1};
+};
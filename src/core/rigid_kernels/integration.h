@@ -49,14 +49,8 @@ static __global__ void collectRigidForces(ROVview ovView)
  * J is the diagonal moment of inertia tensor, J_1 is its inverse (simply 1/Jii)
  * Velocity-Verlet fused is used at the moment
  */
-static __global__ void integrateRigidMotion(ROVviewWithOldMotion ovView, const float dt)
+__device__ inline RigidMotion integrateMotion(RigidMotion motion, const ROVview& ovView, const float dt)
 {
-    const int objId = threadIdx.x + blockDim.x * blockIdx.x;
-    if (objId >= ovView.nObjects) return;
-
-    auto motion = ovView.motions[objId];
-    ovView.old_motions[objId] = motion;
-
     //**********************************************************************************
     // Rotation
     //**********************************************************************************
@@ -71,9 +65,6 @@ static __global__ void integrateRigidMotion(ROVviewWithOldMotion ovView, const f
     auto dw_dt = ovView.J_1 * (tau - cross(omega, ovView.J*omega));
     omega += dw_dt * dt;
 
-    // Only for output purposes
-    auto L = rotate(omega*ovView.J, motion.q);
-
     omega = rotate(omega, motion.q);
 
     // using OLD q and NEW w ?
@@ -100,17 +91,18 @@ static __global__ void integrateRigidMotion(ROVviewWithOldMotion ovView, const f
     motion.vel = vel;
     motion.r += vel*dt;
 
-    ovView.motions[objId] = motion;
-
-//    printf("obj  %d  r [%f %f %f]   v [%f %f %f],  f [%f %f %f],  t [%f %f %f],   \n"
-//            "    q [%f %f %f %f]   w [%f %f %f]   L [%f %f %f] \n\n", ovView.ids[objId],
-//            motion.r.x,  motion.r.y,  motion.r.z,
-//            motion.vel.x,  motion.vel.y,  motion.vel.z,
-//            motion.force.x,  motion.force.y,  motion.force.z,
-//            motion.torque.x, motion.torque.y, motion.torque.z ,
-//            motion.q.x,  motion.q.y,  motion.q.z, motion.q.w,
-//            motion.omega.x,  motion.omega.y,  motion.omega.z,
-//            L.x, L.y, L.z);
+    return motion;
+}
+
+static __global__ void integrateRigidMotion(ROVviewWithOldMotion ovView, const float dt)
+{
+    const int objId = threadIdx.x + blockDim.x * blockIdx.x;
+    if (objId >= ovView.nObjects) return;
+
+    auto motion = ovView.motions[objId];
+    ovView.old_motions[objId] = motion;
+
+    ovView.motions[objId] = integrateMotion(motion, ovView, dt);
 }
 
 /**
@@ -145,6 +137,166 @@ static __global__ void clearRigidForces(ROVview ovView)
     ovView.motions[objId].torque = {0,0,0};
 }
 
+/**
+ * Whole rigid step of the object \p objId by the calling block:
+ * collect the particle forces into the total force and torque,
+ * integrate the motion, rebuild the particles from \p initial and clear the force and torque.
+ * The force and torque already in the motion (e.g. from the bounce) are kept.
+ * Must be called by all the threads of the block
+ */
+__device__ inline void integrateRigidObject(const ROVviewWithOldMotion& ovView, const float4 * __restrict__ initial,
+                                            const int objId, const float dt)
+{
+    __shared__ RigidReal3 warpForces[32], warpTorques[32];
+    __shared__ RigidMotion newMotion;
+
+    const int tid = threadIdx.x;
+    const int wid = tid / warpSize;
+    const int nWarps = (blockDim.x + warpSize - 1) / warpSize;
+
+    RigidReal3 force {0,0,0};
+    RigidReal3 torque{0,0,0};
+    const float3 com = make_float3( ovView.motions[objId].r );
+
+    for (int i = tid; i < ovView.objSize; i += blockDim.x)
+    {
+        const int offset = (objId * ovView.objSize + i);
+
+        const float3 frc = make_float3(ovView.forces[offset]);
+        const float3 r   = make_float3(ovView.particles[offset*2]) - com;
+
+        force += frc;
+        torque += cross(r, frc);
+    }
+
+    force  = warpReduce( force,  [] (RigidReal a, RigidReal b) { return a+b; } );
+    torque = warpReduce( torque, [] (RigidReal a, RigidReal b) { return a+b; } );
+
+    if (__laneid() == 0)
+    {
+        warpForces [wid] = force;
+        warpTorques[wid] = torque;
+    }
+
+    __syncthreads();
+
+    if (wid == 0)
+    {
+        force  = tid < nWarps ? warpForces [tid] : RigidReal3{0,0,0};
+        torque = tid < nWarps ? warpTorques[tid] : RigidReal3{0,0,0};
+
+        force  = warpReduce( force,  [] (RigidReal a, RigidReal b) { return a+b; } );
+        torque = warpReduce( torque, [] (RigidReal a, RigidReal b) { return a+b; } );
+
+        if (tid == 0)
+        {
+            auto motion = ovView.motions[objId];
+            motion.force  += force;
+            motion.torque += torque;
+            ovView.old_motions[objId] = motion;
+
+            motion = integrateMotion(motion, ovView, dt);
+            newMotion = motion;
+
+            motion.force  = {0,0,0};
+            motion.torque = {0,0,0};
+            ovView.motions[objId] = motion;
+        }
+    }
+
+    __syncthreads();
+
+    const auto motion = toSingleMotion(newMotion);
+
+    // the extents and COM of the new positions come with the same pass, see ObjectVector::findExtentAndCOM
+    __shared__ float3 warpMins[32], warpMaxs[32], warpComs[32];
+
+    float3 mymin = make_float3( 1e+10f);
+    float3 mymax = make_float3(-1e+10f);
+    float3 mycom = make_float3(0);
+
+    for (int i = tid; i < ovView.objSize; i += blockDim.x)
+    {
+        const int pid = objId * ovView.objSize + i;
+        Particle p(ovView.particles, pid);
+
+        p.r = motion.r + rotate( f4tof3(initial[i]), motion.q );
+        p.u = motion.vel + cross(motion.omega, p.r - motion.r);
+
+        ovView.particles[2*pid]   = p.r2Float4();
+        ovView.particles[2*pid+1] = p.u2Float4();
+
+        mymin = fminf(mymin, p.r);
+        mymax = fmaxf(mymax, p.r);
+        mycom += p.r;
+    }
+
+    mycom = warpReduce( mycom, [] (float a, float b) { return a+b; } );
+    mymin = warpReduce( mymin, [] (float a, float b) { return fmin(a, b); } );
+    mymax = warpReduce( mymax, [] (float a, float b) { return fmax(a, b); } );
+
+    if (__laneid() == 0)
+    {
+        warpMins[wid] = mymin;
+        warpMaxs[wid] = mymax;
+        warpComs[wid] = mycom;
+    }
+
+    __syncthreads();
+
+    if (wid == 0)
+    {
+        mymin = tid < nWarps ? warpMins[tid] : make_float3( 1e+10f);
+        mymax = tid < nWarps ? warpMaxs[tid] : make_float3(-1e+10f);
+        mycom = tid < nWarps ? warpComs[tid] : make_float3(0);
+
+        mycom = warpReduce( mycom, [] (float a, float b) { return a+b; } );
+        mymin = warpReduce( mymin, [] (float a, float b) { return fmin(a, b); } );
+        mymax = warpReduce( mymax, [] (float a, float b) { return fmax(a, b); } );
+
+        if (tid == 0)
+            ovView.comAndExtents[objId] = {mycom / ovView.objSize, mymin, mymax};
+    }
+}
+
+/**
+ * Fused collectRigidForces, integrateRigidMotion, applyRigidMotion and clearRigidForces,
+ * one block per object; also fills the COM and extents of the moved objects
+ */
+static __global__ void integrateRigidObjects(ROVviewWithOldMotion ovView, const float4 * __restrict__ initial, const float dt)
+{
+    const int objId = blockIdx.x;
+    if (objId >= ovView.nObjects) return;
+
+    integrateRigidObject(ovView, initial, objId, dt);
+}
+
+/// One rigid object vector of a batched integration
+struct RigidBatchEntry
+{
+    ROVviewWithOldMotion view;
+    const float4 *initial;
+    int firstBlock;        ///< objects of the previous entries
+};
+
+/**
+ * Same as integrateRigidObjects() for the objects of several rigid object vectors,
+ * one block per object of all the entries
+ */
+static __global__ void integrateRigidObjectsBatched(int nEntries, const RigidBatchEntry * __restrict__ entries, const float dt)
+{
+    // few entries, linear search is fine
+    int entryId = 0;
+    while (entryId < nEntries-1 && entries[entryId+1].firstBlock <= blockIdx.x)
+        entryId++;
+
+    const auto& entry = entries[entryId];
+    const int objId = blockIdx.x - entry.firstBlock;
+    if (objId >= entry.view.nObjects) return;
+
+    integrateRigidObject(entry.view, entry.initial, objId, dt);
+}
+
 } // namespace RigidIntegrationKernels
 
 
@@ -2,29 +2,50 @@
 
 #include <core/bouncers/interface.h>
 #include <core/celllist.h>
+#include <core/device_monitor.h>
 #include <core/initial_conditions/interface.h>
+#include <core/integrators/forcing_terms/none.h>
 #include <core/integrators/interface.h>
+#include <core/integrators/vv.h>
+#include <core/interactions/dpd.h>
 #include <core/interactions/interface.h>
 #include <core/managers/interactions.h>
 #include <core/mpi/api.h>
+#include <core/persistent_step.h>
+#include <core/plugin_costs.h>
 #include <core/object_belonging/interface.h>
+#include <core/pvs/checkpoint_writer.h>
 #include <core/pvs/object_vector.h>
 #include <core/pvs/particle_vector.h>
+#include <core/rank_placement.h>
 #include <core/task_scheduler.h>
+#include <core/time_step_controller.h>
+#include <core/utils/checkpoint_interval.h>
+#include <core/utils/clear_batch.h>
 #include <core/utils/folders.h>
 #include <core/utils/make_unique.h>
+#include <core/utils/memory_pool.h>
+#include <core/utils/nvtx.h>
+#include <core/utils/preemption.h>
 #include <core/utils/restart_helpers.h>
+#include <core/utils/timer.h>
 #include <core/walls/interface.h>
 #include <core/ymero_state.h>
+#include <plugins/batched_transport.h>
+#include <plugins/body_forces.h>
 #include <plugins/interface.h>
+#include <plugins/sampling_pipeline.h>
 
 #include <algorithm>
+#include <cstdlib>
 #include <cuda_profiler_api.h>
 
 #define TASK_LIST(_)                                                    \
     _( checkpoint                          , "Checkpoint")              \
     _( cellLists                           , "Build cell-lists")        \
+    _( cellListsBulk                       , "Bin staying particles in cell-lists") \
     _( integration                         , "Integration")             \
+    _( integrationInterior                 , "Integration of the interiors") \
     _( partClearIntermediate               , "Particle clear intermediate") \
     _( partHaloIntermediateInit            , "Particle halo intermediate init") \
     _( partHaloIntermediateFinalize        , "Particle halo intermediate finalize") \
@@ -36,6 +57,7 @@
     _( partHaloFinalInit                   , "Particle halo final init") \
     _( partHaloFinalFinalize               , "Particle halo final finalize") \
     _( localForces                         , "Local forces")            \
+    _( localForcesInterior                 , "Local interior forces")   \
     _( haloForces                          , "Halo forces")             \
     _( accumulateInteractionFinal          , "Accumulate forces")       \
     _( objHaloFinalInit                    , "Object halo final init")  \
@@ -52,18 +74,25 @@
     _( objClearLocalForces                 , "Clear object local forces") \
     _( objLocalBounce                      , "Local object bounce")     \
     _( objHaloBounce                       , "Halo object bounce")      \
+    _( objBounce                           , "Local and halo object bounce") \
     _( correctObjBelonging                 , "Correct object belonging") \
     _( wallBounce                          , "Wall bounce")             \
     _( wallCheck                           , "Wall check")              \
+    _( deviceMonitor                       , "Device sanity checks")    \
+    _( timeStepControl                     , "Time step control")       \
     _( partRedistributeInit                , "Particle redistribute init") \
     _( partRedistributeFinalize            , "Particle redistribute finalize") \
     _( objRedistInit                       , "Object redistribute init") \
     _( objRedistFinalize                   , "Object redistribute finalize") \
+    _( objReorder                          , "Reorder objects")         \
     _( pluginsBeforeCellLists              , "Plugins: before cell lists") \
     _( pluginsBeforeForces                 , "Plugins: before forces")  \
+    _( pluginsBodyForces                   , "Plugins: body forces")    \
     _( pluginsSerializeSend                , "Plugins: serialize and send") \
+    _( pluginsFlushSend                    , "Plugins: send the batch") \
     _( pluginsBeforeIntegration            , "Plugins: before integration") \
     _( pluginsAfterIntegration             , "Plugins: after integration") \
+    _( pluginsSampling                     , "Plugins: fused sampling") \
     _( pluginsBeforeParticlesDistribution  , "Plugins: before particles distribution")
 
 
@@ -87,7 +116,9 @@ Simulation::Simulation(const MPI_Comm &cartComm, const MPI_Comm &interComm, YmrS
       gpuAwareMPI(gpuAwareMPI),
       scheduler(std::make_unique<TaskScheduler>()),
       tasks(std::make_unique<SimulationTasks>()),
-      interactionManager(std::make_unique<InteractionManager>())
+      interactionManager(std::make_unique<InteractionManager>()),
+      samplingPipeline(std::make_unique<SamplingPipeline>()),
+      bodyForces(std::make_unique<BodyForces>())
 {
     int nranks[3], periods[3], coords[3];
 
@@ -110,6 +141,14 @@ Simulation::Simulation(const MPI_Comm &cartComm, const MPI_Comm &interComm, YmrS
 
 Simulation::~Simulation()
 {
+    // the last checkpoint may still be in flight
+    checkpointWriter.reset();
+    batchedSender.reset();
+
+    waitWallSetups();
+    if (wallSetupComm != MPI_COMM_NULL)
+        MPI_Check( MPI_Comm_free(&wallSetupComm) );
+
     MPI_Check( MPI_Comm_free(&cartComm) );
 }
 
@@ -159,6 +198,8 @@ ObjectVector* Simulation::getOVbyNameOrDie(std::string name) const
 
 Wall* Simulation::getWallByNameOrDie(std::string name) const
 {
+    waitWallSetups();
+
     if (wallMap.find(name) == wallMap.end())
         die("No such wall: %s", name.c_str());
 
@@ -166,6 +207,16 @@ Wall* Simulation::getWallByNameOrDie(std::string name) const
     return it->second.get();
 }
 
+SamplingPipeline* Simulation::getSamplingPipeline() const
+{
+    return samplingPipeline.get();
+}
+
+BodyForces* Simulation::getBodyForces() const
+{
+    return bodyForces.get();
+}
+
 CellList* Simulation::gelCellList(ParticleVector* pv) const
 {
     auto clvecIt = cellListMap.find(pv);
@@ -235,7 +286,12 @@ void Simulation::registerParticleVector(std::shared_ptr<ParticleVector> pv, std:
 
     pvsCheckPointPrototype.push_back({pv.get(), checkpointEvery});
 
+    if (checkpointWriter)
+        pv->setCheckpointWriter(checkpointWriter.get());
+
     auto ov = dynamic_cast<ObjectVector*>(pv.get());
+    if (ov == nullptr)
+        pv->setRawCheckpoints(rawCheckpoints);
     if(ov != nullptr)
     {
         info("Registered object vector '%s', %d objects, %d particles", name.c_str(), ov->local()->nObjects, ov->local()->size());
@@ -258,9 +314,33 @@ void Simulation::registerWall(std::shared_ptr<Wall> wall, int every)
     checkWallPrototypes.push_back({wall.get(), every});
 
     // Let the wall know the particle vector associated with it
-    wall->setup(cartComm);
-    if (restartStatus != RestartStatus::Anew)
-        wall->restart(cartComm, restartFolder);
+    if (backgroundWallSetup)
+    {
+        // one wall after the other on the helper communicator, while the main thread goes on
+        auto wallPtr = wall.get();
+        auto previous = wallSetups;
+        const bool restarting = restartStatus != RestartStatus::Anew;
+        const std::string folder = restartFolder;
+
+        int device;
+        CUDA_Check( cudaGetDevice(&device) );
+
+        wallSetups = std::async(std::launch::async, [this, wallPtr, previous, restarting, folder, device] () {
+            if (previous.valid())
+                previous.wait();
+
+            CUDA_Check( cudaSetDevice(device) );
+            wallPtr->setup(wallSetupComm);
+            if (restarting)
+                wallPtr->restart(wallSetupComm, folder);
+        }).share();
+    }
+    else
+    {
+        wall->setup(cartComm);
+        if (restartStatus != RestartStatus::Anew)
+            wall->restart(cartComm, restartFolder);
+    }
 
     info("Registered wall '%s'", name.c_str());
 
@@ -356,9 +436,27 @@ void Simulation::setIntegrator(std::string integratorName, std::string pvName)
         integrator->stage1(pv, stream);
     });
 
-    integratorsStage2.push_back([integrator, pv] (cudaStream_t stream) {
-        integrator->stage2(pv, stream);
-    });
+    auto key = integrator->getBatchKey();
+    if (key.empty())
+    {
+        integratorsStage2.push_back([integrator, pv] (cudaStream_t stream) {
+            integrator->stage2(pv, stream);
+        });
+        return;
+    }
+
+    // the first integrator with this key performs the whole batch
+    bool newBatch = integratorBatches.find(key) == integratorBatches.end();
+    auto& batch = integratorBatches[key];
+    batch.push_back(pv);
+
+    if (newBatch)
+    {
+        auto batchPtr = &batch;
+        integratorsStage2.push_back([integrator, batchPtr] (cudaStream_t stream) {
+            integrator->stage2Batch(*batchPtr, stream);
+        });
+    }
 }
 
 void Simulation::setInteraction(std::string interactionName, std::string pv1Name, std::string pv2Name)
@@ -480,6 +578,43 @@ static void removeDuplicatedElements(std::vector<float>& v, float tolerance)
     v.resize( std::distance(v.begin(), it) );    
 }
 
+/**
+ * The largest and the smallest cut-offs share a single sort when the large cells can be split
+ * into n^3 cells of at least the smallest cut-off, n >= 2: the fine primary cell-list stores
+ * its cells by blocks, the coarse one is derived from it.
+ * The cut-offs in between keep their own cell-lists, unless the fine cells are large enough
+ */
+bool Simulation::prepareHierarchicalCellLists(ParticleVector *pv, const std::vector<float>& cutoffs)
+{
+    if (cutoffs.size() < 2) return false;
+
+    const float rcMax = cutoffs.front();
+    const float rcMin = cutoffs.back();
+    const auto& localSize = state->domain.localSize;
+
+    const CellListInfo coarse(rcMax, localSize);
+    const float hmin = std::min({coarse.h.x, coarse.h.y, coarse.h.z});
+    const int n = floorf(hmin / rcMin + 1e-6f);
+
+    if (n < 2) return false;
+
+    auto fine = std::make_unique<PrimaryCellList>(pv, coarse.ncells * n, localSize);
+    const float fineRc = fine->rc;
+
+    info("Cell-lists of pv '%s' with cut-offs %f and %f share one sort, by blocks of %d^3 cells",
+         pv->name.c_str(), rcMax, fineRc, n);
+
+    auto& clVec = cellListMap[pv];
+    clVec.push_back(std::make_unique<CoarseCellList>(pv, fine.get(), n, localSize));
+
+    for (size_t i = 1; i + 1 < cutoffs.size(); i++)
+        if (cutoffs[i] > fineRc + rcTolerance)
+            clVec.push_back(std::make_unique<CellList>(pv, cutoffs[i], localSize));
+
+    clVec.push_back(std::move(fine));
+    return true;
+}
+
 void Simulation::prepareCellLists()
 {
     info("Preparing cell-lists");
@@ -487,9 +622,10 @@ void Simulation::prepareCellLists()
     std::map<ParticleVector*, std::vector<float>> cutOffMap;
 
     // Deal with the cell-lists and interactions
+    // the particles up to half of the skin outside still have to see all their neighbours
     for (auto prototype : interactionPrototypes)
     {
-        float rc = prototype.rc;
+        float rc = prototype.rc + 0.5f * redistributionSkin;
         cutOffMap[prototype.pv1].push_back(rc);
         cutOffMap[prototype.pv2].push_back(rc);
     }
@@ -508,6 +644,9 @@ void Simulation::prepareCellLists()
         if (dynamic_cast<ObjectVector*>(pv) != nullptr)
             primary = false;
 
+        if (primary && prepareHierarchicalCellLists(pv, cutoffs))
+            continue;
+
         for (auto rc : cutoffs)
         {
             cellListMap[pv].push_back(primary ?
@@ -535,6 +674,46 @@ void Simulation::prepareCellLists()
                  std::make_unique<CellList>       (pvptr, defaultRc, state->domain.localSize));
         }
     }
+
+    for (auto& clVec : cellListMap)
+    {
+        auto pv = clVec.first;
+        auto it = cellListOrderingMap.find(pv->name);
+        if (it == cellListOrderingMap.end()) continue;
+
+        info("Cell-lists of pv '%s' use '%s' ordering of the cells", pv->name.c_str(), it->second.c_str());
+
+        for (auto& cl : clVec.second)
+            cl->setOrdering(it->second == "morton" ? CellListOrdering::Morton : CellListOrdering::RowMajor);
+    }
+
+    for (auto& clVec : cellListMap)
+    {
+        auto pv = clVec.first;
+        auto it = cellListIncrementalMap.find(pv->name);
+        if (it == cellListIncrementalMap.end()) continue;
+
+        info("Cell-lists of pv '%s' are built incrementally while at most %g of the particles change cell",
+             pv->name.c_str(), it->second);
+
+        for (auto& cl : clVec.second)
+            cl->setIncrementalBuild(it->second);
+    }
+
+    for (auto& clVec : cellListMap)
+    {
+        auto pv = clVec.first;
+        auto it = cellListBuildMap.find(pv->name);
+        if (it == cellListBuildMap.end()) continue;
+
+        info("Cell-lists of pv '%s' are built with method '%s'", pv->name.c_str(), it->second.c_str());
+
+        const auto method = it->second == "radix_sort" ? CellListBuild::RadixSort :
+                            it->second == "auto"       ? CellListBuild::Auto : CellListBuild::Atomics;
+
+        for (auto& cl : clVec.second)
+            cl->setBuildMethod(method);
+    }
 }
 
 // Choose a CL with smallest but bigger than rc cell
@@ -559,7 +738,7 @@ void Simulation::prepareInteractions()
 
     for (auto& prototype : interactionPrototypes)
     {
-        auto  rc = prototype.rc;
+        auto  rc = prototype.rc + 0.5f * redistributionSkin;
         auto pv1 = prototype.pv1;
         auto pv2 = prototype.pv2;
 
@@ -577,6 +756,101 @@ void Simulation::prepareInteractions()
 
         interactionManager->add(inter, pv1, pv2, cl1, cl2);
     }
+
+    if (kernelTuningSamples > 0)
+        for (auto& interaction : interactionMap)
+            interaction.second->setAutotuning(kernelTuningSamples, kernelTuningFname);
+
+    preparePeriodicImages();
+
+    interactionManager->prepareEarlyInterior();
+}
+
+/**
+ * With one rank, the interactions supporting it compute the local interactions with the periodic images.
+ * The particle halos are then only skipped for the PVs whose interactions all do:
+ * the object halos are still needed by the bouncers and the belonging checkers
+ */
+void Simulation::preparePeriodicImages()
+{
+    if (!virtualPeriodicImages) return;
+
+    if (nranks3D.x * nranks3D.y * nranks3D.z > 1)
+    {
+        warn("Virtual periodic images are only used with a single rank, the halos are exchanged as usual");
+        return;
+    }
+
+    std::set<Interaction*> withImages;
+    for (auto& interaction : interactionMap)
+        if (interaction.second->usePeriodicImages(true))
+            withImages.insert(interaction.second.get());
+        else
+            warn("Interaction '%s' does not support the periodic images, its particle vectors keep their halo",
+                 interaction.second->name.c_str());
+
+    std::set<ParticleVector*> needHalo;
+    for (auto& prototype : interactionPrototypes)
+        if (withImages.find(prototype.interaction) == withImages.end())
+        {
+            needHalo.insert(prototype.pv1);
+            needHalo.insert(prototype.pv2);
+        }
+
+    for (auto& pv : particleVectors)
+    {
+        if (dynamic_cast<ObjectVector*>(pv.get()) != nullptr) continue;
+        if (needHalo.find(pv.get()) != needHalo.end()) continue;
+
+        info("Particle vector '%s' interacts with its periodic images, its halo is not exchanged", pv->name.c_str());
+        periodicImagesPVs.insert(pv.get());
+    }
+}
+
+void Simulation::preparePersistentStepper()
+{
+    auto unsupported = [] (const char *reason) {
+        die("The persistent step mode only supports a single DPD fluid on a single rank: %s", reason);
+    };
+
+    if (nranks3D.x * nranks3D.y * nranks3D.z > 1) unsupported("more than one rank");
+    if (particleVectors.size() != 1)              unsupported("there must be exactly one particle vector");
+    if (!objectVectors.empty())                   unsupported("object vectors are not supported");
+    if (!wallMap.empty() || !bouncerMap.empty())  unsupported("walls and bouncers are not supported");
+    if (!belongingCheckerMap.empty())             unsupported("belonging checkers are not supported");
+    if (!plugins.empty())                         unsupported("plugins are not supported");
+    if (timeStepController)                       unsupported("the time step must be constant");
+
+    if (globalCheckpointEvery > 0 || checkpointInterval)
+        unsupported("the checkpoints are written by the task graph");
+
+    for (auto& prototype : pvsCheckPointPrototype)
+        if (prototype.checkpointEvery > 0)
+            unsupported("the checkpoints are written by the task graph");
+
+    auto pv = particleVectors[0].get();
+
+    if (interactionPrototypes.size() != 1 || interactionPrototypes[0].pv1 != pv || interactionPrototypes[0].pv2 != pv)
+        unsupported("the particle vector must have exactly one interaction, with itself");
+
+    auto& prototype = interactionPrototypes[0];
+    auto dpd = dynamic_cast<InteractionDPD*>(prototype.interaction);
+    auto handler = dpd != nullptr ? dpd->getSelfHandler(pv) : nullptr;
+
+    if (handler == nullptr)
+        unsupported("the interaction must be a plain DPD with the counter-based random numbers");
+
+    auto integratorIt = pvsIntegratorMap.find(pv->name);
+    auto integrator = integratorIt == pvsIntegratorMap.end() ? nullptr :
+        dynamic_cast<IntegratorVV<Forcing_None>*>(integratorMap[integratorIt->second].get());
+
+    if (integrator == nullptr)
+        unsupported("the particle vector must be integrated with velocity-Verlet without forcing");
+
+    persistentStepper = std::make_unique<PersistentStepper>(state, pv, *handler, prototype.rc);
+
+    info("Particle vector '%s' is advanced by %d steps per launch of the persistent kernel, the task graph is not executed",
+         pv->name.c_str(), persistentSteps);
 }
 
 void Simulation::prepareBouncers()
@@ -598,6 +872,14 @@ void Simulation::prepareBouncers()
 
         CellList *cl = clVec[0].get();
 
+        if (fusedObjectBounce)
+        {
+            fusedBouncers.push_back([bouncer, pv, cl] (cudaStream_t stream) {
+                bouncer->bounceLocalAndHalo(pv, cl, stream);
+            });
+            continue;
+        }
+
         regularBouncers.push_back([bouncer, pv, cl] (cudaStream_t stream) {
             bouncer->bounceLocal(pv, cl, stream);
         });
@@ -626,6 +908,24 @@ void Simulation::prepareWalls()
         wall->attach(pv, cl);
     }
 
+    // the integrators may bounce the particles themselves, from one wall only
+    std::map<ParticleVector*, std::vector<Wall*>> wallsOfPv;
+    for (auto& prototype : wallPrototypes)
+        if (!cellListMap[prototype.pv].empty())
+            wallsOfPv[prototype.pv].push_back(prototype.wall);
+
+    for (auto& entry : wallsOfPv)
+    {
+        auto pv = entry.first;
+        auto& walls = entry.second;
+
+        auto it = pvsIntegratorMap.find(pv->name);
+        if (it == pvsIntegratorMap.end()) continue;
+
+        auto integrator = integratorMap[it->second].get();
+        integrator->setBouncingWall(pv, walls.size() == 1 ? walls[0] : nullptr);
+    }
+
     for (auto& wall : wallMap)
     {
         auto wallPtr = wall.second.get();
@@ -638,6 +938,118 @@ void Simulation::prepareWalls()
     }
 }
 
+/// particle vectors moved by walls, bouncers or belonging corrections between the integration and the next build
+std::set<ParticleVector*> Simulation::getMovedAfterIntegration() const
+{
+    std::set<ParticleVector*> moved;
+
+    for (auto& prototype : wallPrototypes)
+        moved.insert(prototype.pv);
+
+    for (auto& prototype : bouncerPrototypes)
+        moved.insert(prototype.pv);
+
+    for (auto& prototype : belongingCorrectionPrototypes)
+    {
+        moved.insert(prototype.pvIn);
+        moved.insert(prototype.pvOut);
+    }
+
+    return moved;
+}
+
+/**
+ * The integrators may count the particles per cell of the primary cell-list
+ * while computing the new positions, only if nothing moves the particles until the build:
+ * no walls, bouncers or belonging corrections for that particle vector.
+ * Objects are compacted by their redistribution, hence never binned early
+ */
+void Simulation::prepareIntegratorBinning()
+{
+    // the particles outside that are not redistributed would not be binned
+    if (redistributionSkin > 0.0f)
+    {
+        debug("Integrators do not bin the particles with lazy redistribution");
+        return;
+    }
+
+    const auto movedAfterIntegration = getMovedAfterIntegration();
+
+    for (auto& entry : pvsIntegratorMap)
+    {
+        auto pv         = getPVbyNameOrDie(entry.first);
+        auto integrator = integratorMap[entry.second].get();
+
+        if (dynamic_cast<ObjectVector*>(pv) != nullptr) continue;
+
+        auto& clVec = cellListMap[pv];
+        if (clVec.empty()) continue;
+
+        CellList *cl = clVec[0].get();
+        const bool moved = movedAfterIntegration.find(pv) != movedAfterIntegration.end();
+
+        if (integrator->setBinningCellList(pv, moved ? nullptr : cl))
+        {
+            integratorBinnedCellLists.insert(cl);
+
+            // the binning is forwarded to the list doing the sort
+            if (auto coarse = dynamic_cast<CoarseCellList*>(cl))
+                integratorBinnedCellLists.insert(coarse->getFineList());
+        }
+    }
+}
+
+/**
+ * With early redistribution, the integrators may integrate the particles of the boundary cells first:
+ * the redistribution then starts while the interior is integrated, see Integrator::setSplitCellList().
+ * Nothing may read or move the integrated particles before the redistribution but the redistribution itself:
+ * no plugins after the integration or before the redistribution, no device monitor or time-step control,
+ * and no walls, bouncers or belonging corrections for the particle vector.
+ * The particle vectors must be sorted by their primary cell-list, which gives the boundary cells
+ */
+void Simulation::prepareIntegratorSplit()
+{
+    if (!earlyRedistribution) return;
+
+    auto disabled = [] (const char *reason) {
+        warn("Early redistribution is disabled: %s", reason);
+    };
+
+    if (deviceMonitorEvery > 0)   return disabled("the device monitor reads the particles after the integration");
+    if (timeStepController)       return disabled("the time-step control reads the particles after the integration");
+
+    for (auto& pl : plugins)
+        if (pl->getHookPeriod(SimulationPlugin::Hook::AfterIntegration).every != 0 ||
+            pl->getHookPeriod(SimulationPlugin::Hook::BeforeParticleDistribution).every != 0)
+            return disabled("plugins read the particles after the integration");
+
+    const auto movedAfterIntegration = getMovedAfterIntegration();
+
+    for (auto& entry : pvsIntegratorMap)
+    {
+        auto pv         = getPVbyNameOrDie(entry.first);
+        auto integrator = integratorMap[entry.second].get();
+
+        if (dynamic_cast<ObjectVector*>(pv) != nullptr) continue;
+        if (movedAfterIntegration.find(pv) != movedAfterIntegration.end()) continue;
+
+        auto& clVec = cellListMap[pv];
+        if (clVec.empty()) continue;
+
+        auto cl = dynamic_cast<PrimaryCellList*>(clVec[0].get());
+        if (cl == nullptr) continue;
+
+        if (integrator->setSplitCellList(pv, cl))
+        {
+            info("Particle vector '%s' is redistributed while the interior of its subdomain is integrated", pv->name.c_str());
+
+            integratorsInterior.push_back([integrator, pv] (cudaStream_t stream) {
+                integrator->stage2Interior(pv, stream);
+            });
+        }
+    }
+}
+
 void Simulation::preparePlugins()
 {
     info("Preparing plugins");
@@ -646,10 +1058,48 @@ void Simulation::preparePlugins()
         pl->setup(this, cartComm, interComm);
         pl->handshake();
     }
+
+    // the handshakes above are sent directly
+    if (batchedPluginMessages > 0 && interComm != MPI_COMM_NULL)
+    {
+        info("Plugin messages are sent in batches, up to %d in flight", batchedPluginMessages);
+        batchedSender = std::make_unique<BatchedSender>(interComm, batchedPluginMessages);
+        for (auto& pl : plugins)
+            pl->setBatchedSender(batchedSender.get());
+    }
     info("done Preparing plugins");
 }
 
 
+/// channels of \p a or \p b, in the order of \p a then \p b
+static std::vector<std::string> mergeChannels(std::vector<std::string> a, const std::vector<std::string>& b)
+{
+    for (const auto& name : b)
+        if (std::find(a.begin(), a.end(), name) == a.end())
+            a.push_back(name);
+    return a;
+}
+
+/// channels of \p a that are not in \p b
+static std::vector<std::string> subtractChannels(std::vector<std::string> a, const std::vector<std::string>& b)
+{
+    a.erase(std::remove_if(a.begin(), a.end(), [&b] (const std::string& name) {
+                return std::find(b.begin(), b.end(), name) != b.end();
+            }), a.end());
+    return a;
+}
+
+/// the environment variable YMERO_NEIGHBOR_COLLECTIVES overrides the setting, for A/B comparisons without editing the scripts
+static bool useNeighborCollectives(bool enabled)
+{
+    const char *env = getenv("YMERO_NEIGHBOR_COLLECTIVES");
+    if (env == nullptr) return enabled;
+
+    const bool useIt = std::string(env) != "0";
+    info("YMERO_NEIGHBOR_COLLECTIVES is set, neighbourhood collectives are %s", useIt ? "enabled" : "disabled");
+    return useIt;
+}
+
 std::vector<std::string> Simulation::getExtraDataToExchange(ObjectVector *ov)
 {
     std::set<std::string> channels;
@@ -677,16 +1127,55 @@ std::vector<std::string> Simulation::getExtraDataToExchange(ObjectVector *ov)
     return {channels.begin(), channels.end()};
 }
 
+/**
+ * The halo of \p ov holds loose particles when only its surface is exchanged:
+ * die if anything needs the whole halo objects
+ */
+void Simulation::checkSurfaceHalo(ObjectVector *ov, const std::vector<std::string>& extraIntermediate,
+                                  const std::vector<std::string>& staticChannels) const
+{
+    for (auto& entry : bouncerMap)
+        if (entry.second->getObjectVector() == ov)
+            die("Object vector '%s' cannot send only its surface to the halo: it is used by the bouncer '%s'",
+                ov->name.c_str(), entry.first.c_str());
+
+    for (auto& entry : belongingCheckerMap)
+        if (entry.second->getObjectVector() == ov)
+            die("Object vector '%s' cannot send only its surface to the halo: it is used by the belonging checker '%s'",
+                ov->name.c_str(), entry.first.c_str());
+
+    if (!extraIntermediate.empty())
+        die("Object vector '%s' cannot send only its surface to the halo: it has intermediate interactions",
+            ov->name.c_str());
+
+    if (!staticChannels.empty())
+        die("Object vector '%s' cannot send only its surface to the halo: it has static halo channels",
+            ov->name.c_str());
+}
+
 void Simulation::prepareEngines()
 {
-    auto partRedistImp                  = std::make_unique<ParticleRedistributor>();
-    auto partHaloFinalImp               = std::make_unique<ParticleHaloExchanger>();
-    auto partHaloIntermediateImp        = std::make_unique<ParticleHaloExchanger>();
+    const bool multiRank = nranks3D.x * nranks3D.y * nranks3D.z > 1;
+
+    // SingleNodeEngine needs contiguous send buffers
+    const bool speculative = speculativeHaloPacking && multiRank;
+
+    // nothing to gain from a lossy copy within the rank
+    const bool compressFinal        = compressedFinalHalo        && multiRank;
+    const bool compressIntermediate = compressedIntermediateHalo && multiRank;
+
+    auto partRedistImp                  = std::make_unique<ParticleRedistributor>(batchedRedistribution);
+    partRedistImp->setSkin(redistributionSkin);
+    partRedistributorImp = partRedistImp.get();
+    auto partHaloFinalImp               = std::make_unique<ParticleHaloExchanger>(speculative, compressFinal,        sortedHalos);
+    auto partHaloIntermediateImp        = std::make_unique<ParticleHaloExchanger>(speculative, compressIntermediate, sortedHalos);
+    auto partHaloFinalExtraImp          = std::make_unique<ParticleHaloExtraExchanger>(partHaloIntermediateImp.get());
     auto objRedistImp                   = std::make_unique<ObjectRedistributor>();        
     auto objHaloFinalImp                = std::make_unique<ObjectHaloExchanger>();
     auto objHaloIntermediateImp         = std::make_unique<ObjectExtraExchanger>  (objHaloFinalImp.get());
-    auto objHaloReverseIntermediateImp  = std::make_unique<ObjectReverseExchanger>(objHaloFinalImp.get());
-    auto objHaloReverseFinalImp         = std::make_unique<ObjectReverseExchanger>(objHaloFinalImp.get());
+    auto objHaloReverseIntermediateImp  = std::make_unique<ObjectReverseExchanger>(objHaloFinalImp.get(), sparseReverseForces);
+    auto objHaloReverseFinalImp         = std::make_unique<ObjectReverseExchanger>(objHaloFinalImp.get(), sparseReverseForces);
+    auto objHaloStaticImp               = std::make_unique<ObjectStaticExchanger> (objHaloFinalImp.get());
 
     debug("Attaching particle vectors to halo exchanger and redistributor");
     for (auto& pv : particleVectors)
@@ -702,27 +1191,60 @@ void Simulation::prepareEngines()
         auto extraInt = interactionManager->getExtraIntermediateChannels(pvPtr);
         auto extraOut = interactionManager->getExtraFinalChannels(pvPtr);
 
+        // only what the interactions read on the halo side, per phase
+        auto intermediateHalo = interactionManager->getIntermediateHaloChannels(pvPtr);
+        auto finalHalo        = interactionManager->getFinalHaloChannels(pvPtr);
+
         auto cl = cellListVec[0].get();
         auto ov = dynamic_cast<ObjectVector*>(pvPtr);
         
         if (ov == nullptr) {
             partRedistImp->attach(pvPtr, cl);
+
+            if (periodicImagesPVs.find(pvPtr) != periodicImagesPVs.end())
+                continue;
             
             if (clInt != nullptr)
-                partHaloIntermediateImp->attach(pvPtr, clInt, {});
+                partHaloIntermediateImp->attach(pvPtr, clInt, intermediateHalo);
 
-            if (clOut != nullptr)
-                partHaloFinalImp->attach(pvPtr, clOut, extraInt);            
+            // the intermediate halo particles did not move since, only the channels they do not have yet are sent
+            if (clOut != nullptr && clOut == clInt)
+                partHaloFinalExtraImp->attach(pvPtr, subtractChannels(finalHalo, intermediateHalo));
+            else if (clOut != nullptr)
+                partHaloFinalImp->attach(pvPtr, clOut, finalHalo);
         }
         else {
             objRedistImp->attach(ov);
 
-            auto extraToExchange = getExtraDataToExchange(ov);
+            // the objects go to the halo before the intermediate interactions, with all the properties;
+            // the intermediate channels read by the final interactions follow once computed
+            const auto finalProperties    = subtractChannels(finalHalo, extraInt);
+            const auto finalIntermediates = subtractChannels(finalHalo, finalProperties);
+
+            auto extraToExchange = mergeChannels(getExtraDataToExchange(ov), intermediateHalo);
+            extraToExchange = mergeChannels(extraToExchange, finalProperties);
+
+            // static channels go separately, the halo needs the ids to find them
+            auto it = staticHaloChannelsMap.find(ov->name);
+            auto staticChannels = it != staticHaloChannelsMap.end() ? it->second : std::vector<std::string>{};
+            if (!staticChannels.empty())
+            {
+                for (const auto& name : staticChannels)
+                    extraToExchange.erase(std::remove(extraToExchange.begin(), extraToExchange.end(), name), extraToExchange.end());
+
+                if (std::find(extraToExchange.begin(), extraToExchange.end(), ChannelNames::globalIds) == extraToExchange.end())
+                    extraToExchange.push_back(ChannelNames::globalIds);
+            }
             
-            objHaloFinalImp->attach(ov, cl->rc, extraToExchange); // always active because of bounce back; TODO: check if bounce back is active
+            const bool surfaceOnly = surfaceHaloObjects.find(ov->name) != surfaceHaloObjects.end();
+            if (surfaceOnly)
+                checkSurfaceHalo(ov, extraInt, staticChannels);
+
+            objHaloFinalImp->attach(ov, cl->rc, extraToExchange, surfaceOnly); // always active because of bounce back; TODO: check if bounce back is active
+            objHaloStaticImp->attach(ov, staticChannels);
             objHaloReverseFinalImp->attach(ov, extraOut);
 
-            objHaloIntermediateImp->attach(ov, extraInt);
+            objHaloIntermediateImp->attach(ov, finalIntermediates);
             objHaloReverseIntermediateImp->attach(ov, extraInt);
         }
     }
@@ -735,16 +1257,33 @@ void Simulation::prepareEngines()
         makeEngine = [this] (std::unique_ptr<ParticleExchanger> exch) {
             return std::make_unique<SingleNodeEngine> (std::move(exch));
         };
+    else if (aggregatedExchanges)
+        makeEngine = [this] (std::unique_ptr<ParticleExchanger> exch) {
+            return std::make_unique<AggregatedMPIExchangeEngine> (std::move(exch), cartComm, gpuAwareMPI);
+        };
+    else if (useNeighborCollectives(neighborCollectiveExchanges))
+        makeEngine = [this] (std::unique_ptr<ParticleExchanger> exch) {
+            return std::make_unique<NeighborCollectiveEngine> (std::move(exch), cartComm, gpuAwareMPI);
+        };
+    else if (intraNodeIPCExchanges)
+        makeEngine = [this] (std::unique_ptr<ParticleExchanger> exch) {
+            return std::make_unique<IPCExchangeEngine> (std::move(exch), cartComm, gpuAwareMPI);
+        };
     else
         makeEngine = [this] (std::unique_ptr<ParticleExchanger> exch) {
-            return std::make_unique<MPIExchangeEngine> (std::move(exch), cartComm, gpuAwareMPI);
+            return std::make_unique<MPIExchangeEngine> (std::move(exch), cartComm, gpuAwareMPI, persistentSizeRequests,
+                                                          exchangeChunkSize, adaptiveTransport);
         };
     
     partRedistributor            = makeEngine(std::move(partRedistImp));
     partHaloFinal                = makeEngine(std::move(partHaloFinalImp));
     partHaloIntermediate         = makeEngine(std::move(partHaloIntermediateImp));
+    partHaloFinalExtra           = makeEngine(std::move(partHaloFinalExtraImp));
     objRedistibutor              = makeEngine(std::move(objRedistImp));
     objHaloFinal                 = makeEngine(std::move(objHaloFinalImp));
+
+    if (!staticHaloChannelsMap.empty())
+        objHaloStatic            = makeEngine(std::move(objHaloStaticImp));
     objHaloIntermediate          = makeEngine(std::move(objHaloIntermediateImp));
     objHaloReverseIntermediate   = makeEngine(std::move(objHaloReverseIntermediateImp));
     objHaloReverseFinal          = makeEngine(std::move(objHaloReverseFinalImp));
@@ -773,9 +1312,34 @@ void Simulation::createTasks()
 
     if (globalCheckpointEvery > 0)
         scheduler->addTask(tasks->checkpoint,
-                           [this](cudaStream_t stream) { this->checkpoint(); },
+                           [this](cudaStream_t stream) {
+                               this->checkpoint();
+                               checkpointedThisStep = true;
+                           },
                            globalCheckpointEvery);
 
+    if (checkpointInterval)
+    {
+        if (globalCheckpointEvery > 0)
+            die("Adaptive checkpoints replace the fixed global checkpoint period, set the latter to 0");
+
+        // the decision only depends on the step, the same on all the ranks
+        scheduler->addTask(tasks->checkpoint,
+                           [this](cudaStream_t stream) {
+                               const int step = state->currentStep;
+                               if (!checkpointInterval->due(step))
+                               {
+                                   checkpointInterval->update(cartComm, step);
+                                   return;
+                               }
+
+                               const double start = MPI_Wtime();
+                               this->checkpoint();
+                               checkpointedThisStep = true;
+                               checkpointInterval->checkpointed(cartComm, step, MPI_Wtime() - start);
+                           });
+    }
+
     for (auto prototype : pvsCheckPointPrototype)
         if (prototype.checkpointEvery > 0 && globalCheckpointEvery == 0) {
             info("Will save checkpoint of particle vector '%s' every %d timesteps",
@@ -783,6 +1347,8 @@ void Simulation::createTasks()
 
             scheduler->addTask( tasks->checkpoint, [prototype, this] (cudaStream_t stream) {
                 prototype.pv->checkpoint(cartComm, checkpointFolder);
+                checkpointWriter->flush();
+                checkpointedThisStep = true;
             }, prototype.checkpointEvery );
         }
 
@@ -794,43 +1360,145 @@ void Simulation::createTasks()
             scheduler->addTask(tasks->cellLists, [clPtr] (cudaStream_t stream) { clPtr->build(stream); } );
         }
 
+    // Objects are compacted by their redistribution, only plain particle vectors keep their bulk in place
+    if (overlappedCellLists)
+        for (auto& clVec : cellListMap)
+        {
+            if (dynamic_cast<ObjectVector*>(clVec.first) != nullptr) continue;
+
+            for (auto& cl : clVec.second)
+            {
+                auto clPtr = cl.get();
+                if (integratorBinnedCellLists.find(clPtr) != integratorBinnedCellLists.end()) continue;
+
+                scheduler->addTask(tasks->cellListsBulk, [clPtr] (cudaStream_t stream) { clPtr->binBulk(stream); } );
+            }
+        }
+
     // Only particle forces, not object ones here
+    // All the channels of a task are cleared by one kernel, see ClearBatch
+    scheduler->addTask(tasks->partClearIntermediate, [this] (cudaStream_t stream) {
+        ClearBatch batch;
+        for (auto& pv : particleVectors)
+            interactionManager->clearIntermediates(pv.get(), batch);
+        batch.run(stream);
+    });
+
+    scheduler->addTask(tasks->partClearFinal, [this] (cudaStream_t stream) {
+        ClearBatch batch;
+        for (auto& pv : particleVectors)
+            interactionManager->clearFinal(pv.get(), batch);
+        batch.run(stream);
+    });
+
+    scheduler->addTask(tasks->pluginsFlushSend, [this] (cudaStream_t stream) {
+        if (batchedSender) batchedSender->flush();
+    });
+
+    scheduler->addTask(tasks->pluginsSampling, [this] (cudaStream_t stream) {
+        samplingPipeline->run(stream);
+    });
+
+    scheduler->addTask(tasks->pluginsBodyForces, [this] (cudaStream_t stream) {
+        bodyForces->run(stream);
+    });
+
+    // the periods of the plugins count the steps, the scheduler counts its runs since the first step
+    const int firstStep = state->currentStep;
+
+    // channels written by the force computation: the hooks before the forces that read none of them
+    // and write nothing run concurrently with the forces, in their own tasks
+    std::set<std::string> forceChannels {ChannelNames::forces};
     for (auto& pv : particleVectors)
     {
-        auto pvPtr = pv.get();
-        scheduler->addTask(tasks->partClearIntermediate,
-                           [this, pvPtr] (cudaStream_t stream) { interactionManager->clearIntermediates(pvPtr, stream); } );
-        scheduler->addTask(tasks->partClearFinal,
-                           [this, pvPtr] (cudaStream_t stream) { interactionManager->clearFinal(pvPtr, stream); } );
+        for (auto& channel : interactionManager->getExtraIntermediateChannels(pv.get())) forceChannels.insert(channel);
+        for (auto& channel : interactionManager->getExtraFinalChannels       (pv.get())) forceChannels.insert(channel);
     }
 
+    auto concurrentWithForces = [&forceChannels] (const SimulationPlugin::ChannelAccess& access) {
+        if (!access.declared || !access.writes.empty()) return false;
+
+        for (auto& channel : access.reads)
+            if (forceChannels.find(channel) != forceChannels.end()) return false;
+
+        return true;
+    };
+
+    if (pluginCostsEvery > 0)
+        pluginCosts = std::make_unique<PluginCosts>(pluginCostsEvery);
+    else if (!pluginBudgets.empty())
+        die("Plugin budgets need the plugin costs to be measured, see setPluginCostReport()");
+
+    const SimulationPlugin::Hook allHooks[] = {
+        SimulationPlugin::Hook::BeforeCellLists, SimulationPlugin::Hook::BeforeForces, SimulationPlugin::Hook::SerializeSend,
+        SimulationPlugin::Hook::BeforeIntegration, SimulationPlugin::Hook::AfterIntegration,
+        SimulationPlugin::Hook::BeforeParticleDistribution };
+
+    for (auto& budget : pluginBudgets)
+        if (std::find_if(plugins.begin(), plugins.end(),
+                         [&budget] (const std::shared_ptr<SimulationPlugin>& pl) { return pl->name == budget.first; }) == plugins.end())
+            die("Budget given to the plugin '%s', which is not registered", budget.first.c_str());
+
     for (auto& pl : plugins)
     {
         auto plPtr = pl.get();
 
-        scheduler->addTask(tasks->pluginsBeforeCellLists, [plPtr, this] (cudaStream_t stream) {
-            plPtr->beforeCellLists(stream);
-        });
+        int costId = -1;
+        if (pluginCosts)
+        {
+            int longestPeriod = 1;
+            for (auto hook : allHooks)
+                longestPeriod = std::max(longestPeriod, plPtr->getHookPeriod(hook).every);
 
-        scheduler->addTask(tasks->pluginsBeforeForces, [plPtr, this] (cudaStream_t stream) {
-            plPtr->beforeForces(stream);
-        });
+            auto budget = pluginBudgets.find(plPtr->name);
+            costId = pluginCosts->add(plPtr->name, budget == pluginBudgets.end() ? 0.0f : budget->second, longestPeriod);
+        }
 
-        scheduler->addTask(tasks->pluginsSerializeSend, [plPtr] (cudaStream_t stream) {
-            plPtr->serializeAndSend(stream);
-        });
+        auto beforeForcesTask = tasks->pluginsBeforeForces;
+        if (plPtr->getHookPeriod(SimulationPlugin::Hook::BeforeForces).every != 0 &&
+            concurrentWithForces(plPtr->getChannelAccess(SimulationPlugin::Hook::BeforeForces)))
+        {
+            // only the tasks moving the particles and the other hooks of the plugins are ordered against it
+            beforeForcesTask = scheduler->createTask("Plugin " + plPtr->name + ": before forces");
+            scheduler->addDependency(beforeForcesTask,
+                                     {tasks->integration, tasks->pluginsSerializeSend, tasks->pluginsBeforeIntegration},
+                                     {tasks->cellLists, tasks->pluginsBeforeForces});
 
-        scheduler->addTask(tasks->pluginsBeforeIntegration, [plPtr] (cudaStream_t stream) {
-            plPtr->beforeIntegration(stream);
-        });
+            debug("Plugin '%s' only reads coordinates before the forces, it runs concurrently with them", plPtr->name.c_str());
+        }
 
-        scheduler->addTask(tasks->pluginsAfterIntegration, [plPtr] (cudaStream_t stream) {
-            plPtr->afterIntegration(stream);
-        });
+        auto addHook = [&] (TaskScheduler::TaskID id, SimulationPlugin::Hook hook, TaskScheduler::Function func) {
+            const auto period = plPtr->getHookPeriod(hook);
+            if (period.every == 0) return;
 
-        scheduler->addTask(tasks->pluginsBeforeParticlesDistribution, [plPtr] (cudaStream_t stream) {
-            plPtr->beforeParticleDistribution(stream);
-        });
+            const int phase = ((period.phase - firstStep) % period.every + period.every) % period.every;
+            scheduler->addTask(id, [this, plPtr, func, costId] (cudaStream_t stream) {
+                if (pluginCosts && !pluginCosts->active(costId, state->currentStep)) return;
+
+                NVTX::Range range(plPtr->name, NVTX::Category::Plugin);
+                if (pluginCosts) pluginCosts->begin(costId, stream);
+                func(stream);
+                if (pluginCosts) pluginCosts->end(costId, stream);
+            }, period.every, phase);
+        };
+
+        addHook(tasks->pluginsBeforeCellLists, SimulationPlugin::Hook::BeforeCellLists,
+                [plPtr] (cudaStream_t stream) { plPtr->beforeCellLists(stream); });
+
+        addHook(beforeForcesTask, SimulationPlugin::Hook::BeforeForces,
+                [plPtr] (cudaStream_t stream) { plPtr->beforeForces(stream); });
+
+        addHook(tasks->pluginsSerializeSend, SimulationPlugin::Hook::SerializeSend,
+                [plPtr] (cudaStream_t stream) { plPtr->serializeAndSend(stream); });
+
+        addHook(tasks->pluginsBeforeIntegration, SimulationPlugin::Hook::BeforeIntegration,
+                [plPtr] (cudaStream_t stream) { plPtr->beforeIntegration(stream); });
+
+        addHook(tasks->pluginsAfterIntegration, SimulationPlugin::Hook::AfterIntegration,
+                [plPtr] (cudaStream_t stream) { plPtr->afterIntegration(stream); });
+
+        addHook(tasks->pluginsBeforeParticlesDistribution, SimulationPlugin::Hook::BeforeParticleDistribution,
+                [plPtr] (cudaStream_t stream) { plPtr->beforeParticleDistribution(stream); });
     }
 
 
@@ -846,14 +1514,19 @@ void Simulation::createTasks()
         });
 
         scheduler->addTask(tasks->partHaloFinalInit, [this] (cudaStream_t stream) {
-            partHaloFinal->init(stream);
+            partHaloFinal     ->init(stream);
+            partHaloFinalExtra->init(stream);
         });
 
         scheduler->addTask(tasks->partHaloFinalFinalize, [this] (cudaStream_t stream) {
-            partHaloFinal->finalize(stream);
+            partHaloFinal     ->finalize(stream);
+            partHaloFinalExtra->finalize(stream);
         });
 
         scheduler->addTask(tasks->partRedistributeInit, [this] (cudaStream_t stream) {
+            if (redistributionSkin > 0.0f)
+                partRedistributorImp->deferIfInside(cartComm, stream);
+
             partRedistributor->init(stream);
         });
 
@@ -878,6 +1551,11 @@ void Simulation::createTasks()
                            interactionManager->executeLocalFinal(stream);
                        });
 
+    scheduler->addTask(tasks->localForcesInterior,
+                       [this] (cudaStream_t stream) {
+                           interactionManager->executeLocalFinalInterior(stream);
+                       });
+
     scheduler->addTask(tasks->haloForces,
                        [this] (cudaStream_t stream) {
                            interactionManager->executeHaloFinal(stream);
@@ -905,27 +1583,48 @@ void Simulation::createTasks()
             integrator(stream);
         });
 
+    for (auto& integrator : integratorsInterior)
+        scheduler->addTask(tasks->integrationInterior, [integrator] (cudaStream_t stream) {
+            integrator(stream);
+        });
+
 
     // As there are no primary cell-lists for objects
     // we need to separately clear real obj forces and forces in the cell-lists
-    for (auto ov : objectVectors)
+    if (!objectVectors.empty())
     {
-        scheduler->addTask(tasks->objClearLocalIntermediate, [this, ov] (cudaStream_t stream) {
-            interactionManager->clearIntermediates(ov, stream);
-            interactionManager->clearIntermediatesPV(ov, ov->local(), stream);
+        scheduler->addTask(tasks->objClearLocalIntermediate, [this] (cudaStream_t stream) {
+            ClearBatch batch;
+            for (auto ov : objectVectors)
+            {
+                interactionManager->clearIntermediates(ov, batch);
+                interactionManager->clearIntermediatesPV(ov, ov->local(), batch);
+            }
+            batch.run(stream);
         });
 
-        scheduler->addTask(tasks->objClearHaloIntermediate, [this, ov] (cudaStream_t stream) {
-            interactionManager->clearIntermediatesPV(ov, ov->halo(), stream);
+        scheduler->addTask(tasks->objClearHaloIntermediate, [this] (cudaStream_t stream) {
+            ClearBatch batch;
+            for (auto ov : objectVectors)
+                interactionManager->clearIntermediatesPV(ov, ov->halo(), batch);
+            batch.run(stream);
         });
 
-        scheduler->addTask(tasks->objClearLocalForces, [this, ov] (cudaStream_t stream) {
-            interactionManager->clearFinalPV(ov, ov->local(), stream);
-            interactionManager->clearFinal(ov, stream);
+        scheduler->addTask(tasks->objClearLocalForces, [this] (cudaStream_t stream) {
+            ClearBatch batch;
+            for (auto ov : objectVectors)
+            {
+                interactionManager->clearFinalPV(ov, ov->local(), batch);
+                interactionManager->clearFinal(ov, batch);
+            }
+            batch.run(stream);
         });
 
-        scheduler->addTask(tasks->objClearHaloForces, [this, ov] (cudaStream_t stream) {
-            interactionManager->clearFinalPV(ov, ov->halo(), stream);
+        scheduler->addTask(tasks->objClearHaloForces, [this] (cudaStream_t stream) {
+            ClearBatch batch;
+            for (auto ov : objectVectors)
+                interactionManager->clearFinalPV(ov, ov->halo(), batch);
+            batch.run(stream);
         });
     }
 
@@ -939,6 +1638,11 @@ void Simulation::createTasks()
             bouncer(stream);
     });
 
+    for (auto& bouncer : fusedBouncers)
+        scheduler->addTask(tasks->objBounce, [bouncer, this] (cudaStream_t stream) {
+            bouncer(stream);
+    });
+
     for (auto& prototype : belongingCorrectionPrototypes)
     {
         auto checker = prototype.checker;
@@ -965,12 +1669,15 @@ void Simulation::createTasks()
             objHaloIntermediate->finalize(stream);
         });
 
+        // the static exchange relies on the objects just packed or unpacked by the final one
         scheduler->addTask(tasks->objHaloFinalInit, [this] (cudaStream_t stream) {
             objHaloFinal->init(stream);
+            if (objHaloStatic) objHaloStatic->init(stream);
         });
 
         scheduler->addTask(tasks->objHaloFinalFinalize, [this] (cudaStream_t stream) {
             objHaloFinal->finalize(stream);
+            if (objHaloStatic) objHaloStatic->finalize(stream);
         });
 
         scheduler->addTask(tasks->objReverseIntermediateInit, [this] (cudaStream_t stream) {
@@ -996,6 +1703,14 @@ void Simulation::createTasks()
         scheduler->addTask(tasks->objRedistFinalize, [this] (cudaStream_t stream) {
             objRedistibutor->finalize(stream);
         });
+
+        for (auto& entry : objectReorderingMap)
+        {
+            auto ov = getOVbyNameOrDie(entry.first);
+            scheduler->addTask(tasks->objReorder, [ov] (cudaStream_t stream) {
+                ov->reorderObjects(stream);
+            }, entry.second);
+        }
     }
 
     for (auto& wall : wallMap)
@@ -1006,14 +1721,37 @@ void Simulation::createTasks()
         });
     }
 
+    const bool checkWalls = std::any_of(checkWallPrototypes.begin(), checkWallPrototypes.end(),
+                                        [] (const CheckWallPrototype& prototype) { return prototype.every > 0; });
+
+    if (checkWalls || deviceMonitorEvery > 0)
+        deviceMonitor = std::make_unique<DeviceMonitor>(monitorMaxDisplacement);
+
     for (auto& prototype : checkWallPrototypes)
     {
         auto wall  = prototype.wall;
         auto every = prototype.every;
 
         if (every > 0)
-            scheduler->addTask(tasks->wallCheck, [this, wall] (cudaStream_t stream) { wall->check(stream); }, every);
+            scheduler->addTask(tasks->wallCheck, [this, wall] (cudaStream_t stream) {
+                wall->check(deviceMonitor->handler(), stream);
+                deviceMonitor->flush(stream, state->currentStep);
+            }, every);
     }
+
+    if (deviceMonitorEvery > 0)
+        scheduler->addTask(tasks->deviceMonitor, [this] (cudaStream_t stream) {
+            for (auto& pv : particleVectors)
+                deviceMonitor->checkParticles(pv.get(), state->dt, stream);
+            deviceMonitor->flush(stream, state->currentStep);
+        }, deviceMonitorEvery);
+
+    if (timeStepController)
+        scheduler->addTask(tasks->timeStepControl, [this] (cudaStream_t stream) {
+            timeStepController->clear(stream);
+            for (auto& pv : particleVectors)
+                timeStepController->sample(pv.get(), stream);
+        });
 }
 
 static void createTasksDummy(TaskScheduler *scheduler, SimulationTasks *tasks)
@@ -1039,10 +1777,12 @@ static void buildDependencies(TaskScheduler *scheduler, SimulationTasks *tasks)
     scheduler->addDependency(tasks->cellLists, {tasks->partClearFinal, tasks->partClearIntermediate, tasks->objClearLocalIntermediate}, {});
 
     
-    scheduler->addDependency(tasks->pluginsBeforeForces, {tasks->localForces, tasks->haloForces}, {tasks->partClearFinal});
+    scheduler->addDependency(tasks->pluginsBeforeForces, {tasks->localForces, tasks->localForcesInterior, tasks->haloForces}, {tasks->partClearFinal});
+    scheduler->addDependency(tasks->pluginsBodyForces, {tasks->localForces, tasks->localForcesInterior, tasks->haloForces}, {tasks->pluginsBeforeForces});
     scheduler->addDependency(tasks->pluginsSerializeSend, {tasks->pluginsBeforeIntegration, tasks->pluginsAfterIntegration}, {tasks->pluginsBeforeForces});
+    scheduler->addDependency(tasks->pluginsFlushSend, {tasks->pluginsBeforeIntegration, tasks->pluginsAfterIntegration}, {tasks->pluginsSerializeSend});
 
-    scheduler->addDependency(tasks->objClearHaloForces, {tasks->objHaloBounce}, {tasks->objHaloFinalFinalize});
+    scheduler->addDependency(tasks->objClearHaloForces, {tasks->objHaloBounce, tasks->objBounce}, {tasks->objHaloFinalFinalize});
 
     scheduler->addDependency(tasks->objReverseFinalInit, {}, {tasks->haloForces});
     scheduler->addDependency(tasks->objReverseFinalFinalize, {tasks->accumulateInteractionFinal}, {tasks->objReverseFinalInit});
@@ -1060,6 +1800,7 @@ static void buildDependencies(TaskScheduler *scheduler, SimulationTasks *tasks)
     scheduler->addDependency(tasks->gatherInteractionIntermediate, {}, {tasks->accumulateInteractionIntermediate, tasks->objReverseIntermediateFinalize});
 
     scheduler->addDependency(tasks->localForces, {}, {tasks->gatherInteractionIntermediate});
+    scheduler->addDependency(tasks->localForcesInterior, {}, {tasks->localIntermediate});
 
     scheduler->addDependency(tasks->objHaloIntermediateInit, {}, {tasks->gatherInteractionIntermediate});
     scheduler->addDependency(tasks->objHaloIntermediateFinalize, {}, {tasks->objHaloIntermediateInit});
@@ -1068,28 +1809,44 @@ static void buildDependencies(TaskScheduler *scheduler, SimulationTasks *tasks)
     scheduler->addDependency(tasks->partHaloFinalFinalize, {}, {tasks->partHaloFinalInit});
 
     scheduler->addDependency(tasks->haloForces, {}, {tasks->partHaloFinalFinalize, tasks->objHaloIntermediateFinalize});
-    scheduler->addDependency(tasks->accumulateInteractionFinal, {tasks->integration}, {tasks->haloForces, tasks->localForces});
+    scheduler->addDependency(tasks->accumulateInteractionFinal, {tasks->integration}, {tasks->haloForces, tasks->localForces, tasks->localForcesInterior});
 
     scheduler->addDependency(tasks->pluginsBeforeIntegration, {tasks->integration}, {tasks->accumulateInteractionFinal});
     scheduler->addDependency(tasks->wallBounce, {}, {tasks->integration});
     scheduler->addDependency(tasks->wallCheck, {tasks->partRedistributeInit}, {tasks->wallBounce});
+    scheduler->addDependency(tasks->deviceMonitor, {tasks->partRedistributeInit, tasks->objRedistInit},
+                             {tasks->integration, tasks->wallBounce, tasks->objLocalBounce, tasks->objHaloBounce, tasks->objBounce});
+    scheduler->addDependency(tasks->timeStepControl, {tasks->partRedistributeInit, tasks->objRedistInit},
+                             {tasks->integration, tasks->wallBounce, tasks->objLocalBounce, tasks->objHaloBounce, tasks->objBounce});
 
     scheduler->addDependency(tasks->objHaloFinalInit, {}, {tasks->integration, tasks->objRedistFinalize});
     scheduler->addDependency(tasks->objHaloFinalFinalize, {}, {tasks->objHaloFinalInit});
 
     scheduler->addDependency(tasks->objLocalBounce, {tasks->objHaloFinalFinalize}, {tasks->integration, tasks->objClearLocalForces});
     scheduler->addDependency(tasks->objHaloBounce, {}, {tasks->integration, tasks->objHaloFinalFinalize, tasks->objClearHaloForces});
+    scheduler->addDependency(tasks->objBounce, {},
+                             {tasks->integration, tasks->objHaloFinalFinalize, tasks->objClearLocalForces, tasks->objClearHaloForces});
+
+    scheduler->addDependency(tasks->pluginsAfterIntegration, {tasks->objLocalBounce, tasks->objHaloBounce, tasks->objBounce}, {tasks->integration, tasks->wallBounce});
 
-    scheduler->addDependency(tasks->pluginsAfterIntegration, {tasks->objLocalBounce, tasks->objHaloBounce}, {tasks->integration, tasks->wallBounce});
+    scheduler->addDependency(tasks->pluginsSampling, {tasks->pluginsBeforeParticlesDistribution, tasks->objRedistInit},
+                             {tasks->pluginsAfterIntegration});
 
     scheduler->addDependency(tasks->pluginsBeforeParticlesDistribution, {},
-                             {tasks->integration, tasks->wallBounce, tasks->objLocalBounce, tasks->objHaloBounce, tasks->pluginsAfterIntegration});
+                             {tasks->integration, tasks->wallBounce, tasks->objLocalBounce, tasks->objHaloBounce, tasks->objBounce, tasks->pluginsAfterIntegration});
     scheduler->addDependency(tasks->partRedistributeInit, {}, {tasks->pluginsBeforeParticlesDistribution});
     scheduler->addDependency(tasks->partRedistributeFinalize, {}, {tasks->partRedistributeInit});
+    scheduler->addDependency(tasks->cellListsBulk, {tasks->partRedistributeFinalize}, {tasks->partRedistributeInit});
+
+    // only the boundary cells of the split particle vectors are integrated before the redistribution starts;
+    // the received particles are appended once the interior is done
+    scheduler->addDependency(tasks->integrationInterior, {tasks->partRedistributeFinalize, tasks->cellListsBulk},
+                             {tasks->integration});
 
     scheduler->addDependency(tasks->objRedistInit, {}, {tasks->integration, tasks->wallBounce, tasks->objReverseFinalFinalize, tasks->pluginsAfterIntegration});
     scheduler->addDependency(tasks->objRedistFinalize, {}, {tasks->objRedistInit});
-    scheduler->addDependency(tasks->objClearLocalForces, {tasks->objLocalBounce}, {tasks->integration, tasks->objRedistFinalize});
+    scheduler->addDependency(tasks->objReorder, {tasks->objHaloFinalInit, tasks->objClearLocalForces}, {tasks->objRedistFinalize});
+    scheduler->addDependency(tasks->objClearLocalForces, {tasks->objLocalBounce, tasks->objBounce}, {tasks->integration, tasks->objRedistFinalize});
 
     scheduler->setHighPriority(tasks->objReverseFinalInit);
     scheduler->setHighPriority(tasks->partHaloIntermediateInit);
@@ -1104,68 +1861,368 @@ static void buildDependencies(TaskScheduler *scheduler, SimulationTasks *tasks)
     scheduler->setHighPriority(tasks->partHaloFinalFinalize);
     scheduler->setHighPriority(tasks->haloForces);
     scheduler->setHighPriority(tasks->pluginsSerializeSend);
+    scheduler->setHighPriority(tasks->pluginsFlushSend);
 
     scheduler->setHighPriority(tasks->objClearLocalForces);
     scheduler->setHighPriority(tasks->objLocalBounce);
-    
-    scheduler->compile();
-}
+
+    // These tasks only enqueue kernels and memsets (the clears are one kernel, see ClearBatch),
+    // their parameters only depend on the buffers and active channels
+    scheduler->setGraphCapturable(tasks->partClearIntermediate);
+    scheduler->setGraphCapturable(tasks->partClearFinal);
+    scheduler->setGraphCapturable(tasks->objClearLocalIntermediate);
+    scheduler->setGraphCapturable(tasks->objClearHaloIntermediate);
+    scheduler->setGraphCapturable(tasks->objClearLocalForces);
+    scheduler->setGraphCapturable(tasks->objClearHaloForces);
+    scheduler->setGraphCapturable(tasks->accumulateInteractionIntermediate);
+    scheduler->setGraphCapturable(tasks->accumulateInteractionFinal);
+
+    // These tasks post MPI requests
+    scheduler->setCommunicationTask(tasks->partHaloIntermediateInit);
+    scheduler->setCommunicationTask(tasks->partHaloFinalInit);
+    scheduler->setCommunicationTask(tasks->objHaloIntermediateInit);
+    scheduler->setCommunicationTask(tasks->objHaloFinalInit);
+    scheduler->setCommunicationTask(tasks->objReverseIntermediateInit);
+    scheduler->setCommunicationTask(tasks->objReverseFinalInit);
+    scheduler->setCommunicationTask(tasks->partRedistributeInit);
+    scheduler->setCommunicationTask(tasks->objRedistInit);
+
+    // These tasks wait for MPI requests, see setHostWorkers()
+    scheduler->setBlocking(tasks->partHaloIntermediateFinalize);
+    scheduler->setBlocking(tasks->partHaloFinalFinalize);
+    scheduler->setBlocking(tasks->objHaloIntermediateFinalize);
+    scheduler->setBlocking(tasks->objHaloFinalFinalize);
+    scheduler->setBlocking(tasks->objReverseIntermediateFinalize);
+    scheduler->setBlocking(tasks->objReverseFinalFinalize);
+    scheduler->setBlocking(tasks->partRedistributeFinalize);
+    scheduler->setBlocking(tasks->objRedistFinalize);
+
+    if (hostWorkers > 0)
+    {
+        int provided;
+        MPI_Check( MPI_Query_thread(&provided) );
+
+        if (provided < MPI_THREAD_MULTIPLE)
+            warn("MPI does not support MPI_THREAD_MULTIPLE, all the tasks will be dispatched from the main thread");
+        else
+            scheduler->setHostWorkers(hostWorkers);
+    }
+    
+    scheduler->compile();
+}
+
+/// log how long every phase of the setup took, over all the ranks of \p comm
+static void logSetupTimes(MPI_Comm comm, const std::vector<std::pair<std::string, double>>& phases)
+{
+    const int n = phases.size();
+    std::vector<double> local(n), minTimes(n), maxTimes(n), sumTimes(n);
+    for (int i = 0; i < n; i++)
+        local[i] = phases[i].second;
+
+    int rank, nranks;
+    MPI_Check( MPI_Comm_rank(comm, &rank) );
+    MPI_Check( MPI_Comm_size(comm, &nranks) );
+
+    MPI_Check( MPI_Reduce(local.data(), minTimes.data(), n, MPI_DOUBLE, MPI_MIN, 0, comm) );
+    MPI_Check( MPI_Reduce(local.data(), maxTimes.data(), n, MPI_DOUBLE, MPI_MAX, 0, comm) );
+    MPI_Check( MPI_Reduce(local.data(), sumTimes.data(), n, MPI_DOUBLE, MPI_SUM, 0, comm) );
+
+    if (rank != 0) return;
+
+    std::string report;
+    char line[256];
+    double total = 0;
+    for (int i = 0; i < n; i++)
+    {
+        snprintf(line, sizeof(line), "\n    %-24s min %10.1f ms   avg %10.1f ms   max %10.1f ms",
+                 phases[i].first.c_str(), minTimes[i], sumTimes[i] / nranks, maxTimes[i]);
+        report += line;
+        total += maxTimes[i];
+    }
+
+    info("Setup phases over %d ranks, %.1f ms in total on the slowest ranks:%s", nranks, total, report.c_str());
+}
 
 void Simulation::init()
 {
     info("Simulation initiated");
 
-    prepareCellLists();
+    std::vector<std::pair<std::string, double>> phaseTimes;
+    auto phase = [&phaseTimes] (std::string name, std::function<void()> setup) {
+        mTimer timer;
+        timer.start();
+        setup();
+        phaseTimes.push_back({name, timer.elapsed()});
+    };
 
-    prepareInteractions();
-    prepareBouncers();
-    prepareWalls();
+    for (auto& pv : particleVectors)
+        if (pv->isStatic && pvsIntegratorMap.find(pv->name) != pvsIntegratorMap.end())
+            die("Particle vector '%s' is static, it can not be integrated with '%s'",
+                pv->name.c_str(), pvsIntegratorMap[pv->name].c_str());
+
+    phase("Wall setup",          [this] () { waitWallSetups(); });
+    phase("Cell-lists",          [this] () { prepareCellLists(); });
+    phase("Interactions",        [this] () { prepareInteractions(); });
+    phase("Bouncers",            [this] () { prepareBouncers(); });
+    phase("Walls",               [this] () { prepareWalls(); });
+    phase("Integrator binning",  [this] () { prepareIntegratorBinning(); });
+    phase("Integrator split",    [this] () { prepareIntegratorSplit(); });
+    phase("Interaction checks",  [this] () { interactionManager->check(); });
+
+    phase("Checkpoint writer", [this] () {
+        checkpointWriter = std::make_unique<CheckpointWriter>(cartComm, asyncCheckpoints,
+                                                              XDMF::stringToCompression(checkpointCompression),
+                                                              incrementalCheckpoints);
+        if (!checkpointStagingFolder.empty())
+            checkpointWriter->setStaging(checkpointStagingFolder);
+        for (auto& pv : particleVectors)
+        {
+            pv->setCheckpointWriter(checkpointWriter.get());
+            if (dynamic_cast<ObjectVector*>(pv.get()) == nullptr)
+                pv->setRawCheckpoints(rawCheckpoints);
+        }
+    });
 
-    interactionManager->check();
+    phase("Halo locality", [this] () {
+        if (nranks3D.x * nranks3D.y * nranks3D.z > 1)
+            reportHaloLocality(cartComm, state->domain.localSize, getMaxEffectiveCutoff());
 
-    CUDA_Check( cudaDeviceSynchronize() );
+        CUDA_Check( cudaDeviceSynchronize() );
+    });
 
-    preparePlugins();
-    prepareEngines();
+    phase("Plugins",             [this] () { preparePlugins(); });
+    phase("Exchange engines",    [this] () { prepareEngines(); });
 
     info("Time-step is set to %f", getCurrentDt());
     
-    createTasks();
-    buildDependencies(scheduler.get(), tasks.get());
-    
-    // Initial preparation
-    scheduler->forceExec( tasks->objHaloFinalInit,     defaultStream );
-    scheduler->forceExec( tasks->objHaloFinalFinalize, defaultStream );
-    scheduler->forceExec( tasks->objClearHaloForces,   defaultStream );
-    scheduler->forceExec( tasks->objClearLocalForces,  defaultStream );
+    if (persistentSteps > 0)
+        phase("Persistent stepper", [this] () { preparePersistentStepper(); });
+
+    phase("Task graph", [this] () {
+        createTasks();
+        buildDependencies(scheduler.get(), tasks.get());
 
-    execSplitters();
+        if (taskGraphCapture)
+            scheduler->enableGraphCapture([this] () { return computeTaskGraphKey(); });
+    });
+
+    phase("Initial exchanges", [this] () {
+        scheduler->forceExec( tasks->objHaloFinalInit,     defaultStream );
+        scheduler->forceExec( tasks->objHaloFinalFinalize, defaultStream );
+        scheduler->forceExec( tasks->objClearHaloForces,   defaultStream );
+        scheduler->forceExec( tasks->objClearLocalForces,  defaultStream );
+    });
+
+    phase("Splitters",           [this] () { execSplitters(); });
+
+    logSetupTimes(cartComm, phaseTimes);
 }
 
 
 void Simulation::run(int nsteps)
 {
-    int begin = state->currentStep, end = state->currentStep + nsteps;
+    startRun(nsteps);
 
+    if (persistentStepper)
+        runPersistent(nsteps);
+    else
+        for (int i = 0; i < nsteps && !preempted; i++)
+        {
+            startStep();
+            finishStep();
+        }
+
+    finishRun(nsteps);
+}
+
+void Simulation::runPersistent(int nsteps)
+{
+    // the host only follows the steps, and checks for preemption between the launches
+    for (int done = 0; done < nsteps && !preempted; )
+    {
+        const int n = std::min(persistentSteps, nsteps - done);
+        persistentStepper->run(n, defaultStream);
+
+        state->currentTime += n * state->dt;
+        state->currentStep += n;
+        done += n;
+
+        checkPreemption();
+    }
+}
+
+void Simulation::startRun(int nsteps)
+{
     info("Will run %d iterations now", nsteps);
 
+    // buffers of the setup phase may have been migrated to the host
+    if (MemoryPool::device().getManagedBytes() > 0)
+    {
+        MemoryPool::device().prefetchToDevice(defaultStream);
+        CUDA_Check( cudaStreamSynchronize(defaultStream) );
+    }
+}
+
+void Simulation::startStep()
+{
+    if (persistentStepper)
+        die("The steps of the persistent step mode can only be executed by run()");
+
+    debug("===============================================================================\n"
+            "Timestep: %d, simulation time: %f", state->currentStep, state->currentTime);
+
+    scheduler->start();
+}
 
-    for (state->currentStep = begin; state->currentStep < end; state->currentStep++)
+bool Simulation::progressStep()
+{
+    return scheduler->progress();
+}
+
+void Simulation::finishStep()
+{
+    scheduler->finish();
+
+    if (pluginCosts)
+        pluginCosts->finishStep(state->currentStep, cartComm);
+
+    // the reduction of the maxima overlaps with the bookkeeping
+    if (timeStepController)
+        timeStepController->startReduction(cartComm);
+
+    shrinkBuffers();
+
+    if (memoryReportEvery > 0 && state->currentStep % memoryReportEvery == 0)
+        MemoryPool::device().logUsage();
+
+    if (loadBalanceReportEvery > 0 && state->currentStep % loadBalanceReportEvery == 0)
     {
-        debug("===============================================================================\n"
-                "Timestep: %d, simulation time: %f", state->currentStep, state->currentTime);
+        if (!loadBalanceMonitor)
+            loadBalanceMonitor = std::make_unique<LoadBalanceMonitor>(cartComm);
+        loadBalanceMonitor->report(getLocalLoad(), state->domain);
+    }
 
-        scheduler->run();
-        
-        state->currentTime += state->dt;
+    if (!taskProfileFname.empty() && !scheduler->isProfiling())
+    {
+        if (rank == 0)
+        {
+            scheduler->saveProfilingReport(taskProfileFname);
+            scheduler->saveProfilingJSON(taskProfileFname);
+            scheduler->saveDependencyGraph_GraphML(taskProfileFname);
+        }
+        taskProfileFname = "";
+    }
+
+    state->currentTime += state->dt;
+    state->currentStep++;
+
+    if (timeStepController)
+    {
+        state->dt = timeStepController->nextTimeStep(state->dt);
+        debug("Next time step: %g", state->dt);
     }
 
+    checkPreemption();
+}
+
+bool Simulation::isPreempted() const
+{
+    return preempted;
+}
+
+/**
+ * The reduction of the flags started at the end of the previous step had a whole step to complete.
+ * The signal is thus acted upon one step after it reached the last rank
+ */
+void Simulation::checkPreemption()
+{
+    if (preemptionFolder.empty() || preempted) return;
+
+    if (preemptionRequest != MPI_REQUEST_NULL)
+    {
+        MPI_Check( MPI_Wait(&preemptionRequest, MPI_STATUS_IGNORE) );
+
+        if (preemptionGlobal != 0)
+        {
+            preemptionCheckpoint();
+            preempted = true;
+            return;
+        }
+    }
+
+    preemptionLocal = Preemption::requested() ? 1 : 0;
+    MPI_Check( MPI_Iallreduce(&preemptionLocal, &preemptionGlobal, 1, MPI_INT, MPI_MAX, cartComm, &preemptionRequest) );
+}
+
+/**
+ * Only the state needed to continue: the time, the particle vectors and the object vectors.
+ * The particle vectors go through the raw checkpoints, the other simulation objects and the plugins are skipped
+ */
+void Simulation::preemptionCheckpoint()
+{
+    info("Preemption notice: writing the state at step %lld, time %f into folder %s",
+         (long long) state->currentStep, state->currentTime, preemptionFolder.c_str());
+
+    CUDA_Check( cudaDeviceSynchronize() );
+
+    // a regular checkpoint may still be written in the background
+    checkpointWriter->wait();
+    createFoldersCollective(cartComm, preemptionFolder);
+
+    if (rank == 0)
+        TextIO::write(preemptionFolder + "_simulation.state", state->currentTime, state->currentStep);
+
+    for (auto& pv : particleVectors)
+    {
+        const bool raw = dynamic_cast<ObjectVector*>(pv.get()) == nullptr;
+        if (raw) pv->setRawCheckpoints(true);
+
+        pv->checkpoint(cartComm, preemptionFolder);
+
+        if (raw) pv->setRawCheckpoints(rawCheckpoints);
+    }
+
+    checkpointWriter->flush();
+    checkpointWriter->wait();
+    CUDA_Check( cudaDeviceSynchronize() );
+
+    MPI_Check( MPI_Barrier(cartComm) );
+    info("Preemption checkpoint written, stopping the run");
+}
+
+void Simulation::finishRun(int nsteps)
+{
     // Finish the redistribution by rebuilding the cell-lists
     scheduler->forceExec( tasks->cellLists, defaultStream );
 
+    // the failures of the last steps are not reported yet
+    if (deviceMonitor)
+        deviceMonitor->wait(state->currentStep);
+
+    // the reduction started by the last step, the notice may arrive at the very end of the run
+    if (preemptionRequest != MPI_REQUEST_NULL)
+    {
+        MPI_Check( MPI_Wait(&preemptionRequest, MPI_STATUS_IGNORE) );
+
+        if (preemptionGlobal != 0 && !preempted)
+        {
+            preemptionCheckpoint();
+            preempted = true;
+        }
+    }
+
+    // the files of the last checkpoint must be complete when run() returns
+    checkpointWriter->wait();
+
     info("Finished with %d iterations", nsteps);
     MPI_Check( MPI_Barrier(cartComm) );
 
+    if (batchedSender)
+    {
+        batchedSender->flush();
+        batchedSender->wait();
+    }
+
     for (auto& pl : plugins)
         pl->finalize();
 
@@ -1217,6 +2274,7 @@ void Simulation::restart(std::string folder)
 	for (auto& handler : interactionMap)
 		handler.second->restart(cartComm, restartFolder);
 
+	waitWallSetups();
 	for (auto& handler : wallMap)
 		handler.second->restart(cartComm, restartFolder);
 
@@ -1240,6 +2298,10 @@ void Simulation::checkpoint()
         
     for (auto& pv : particleVectors)
         pv->checkpoint(cartComm, checkpointFolder);
+
+    // waits for the previous checkpoint to be written
+    if (checkpointWriter)
+        checkpointWriter->flush();
     
     for (auto& handler : bouncerMap)
         handler.second->checkpoint(cartComm, checkpointFolder);
@@ -1262,6 +2324,431 @@ void Simulation::checkpoint()
     CUDA_Check( cudaDeviceSynchronize() );
 }
 
+static void hashCombine(size_t& seed, size_t value)
+{
+    seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+static void hashLocalParticleVector(size_t& seed, LocalParticleVector *lpv)
+{
+    hashCombine(seed, lpv->size());
+    hashCombine(seed, (size_t) lpv->coosvels.devPtr());
+    hashCombine(seed, (size_t) lpv->forces.devPtr());
+
+    for (const auto& namedChannel : lpv->extraPerParticle.getSortedChannels())
+        hashCombine(seed, (size_t) namedChannel.second->container->genericDevPtr());
+}
+
+// Everything that the captured tasks bake into the graphs:
+// sizes and device pointers of all the particle buffers, cell-lists and active channels
+size_t Simulation::computeTaskGraphKey() const
+{
+    size_t key = 0;
+
+    for (auto& pv : particleVectors)
+    {
+        hashLocalParticleVector(key, pv->local());
+        hashLocalParticleVector(key, pv->halo());
+    }
+
+    for (auto& clVec : cellListMap)
+        for (auto& cl : clVec.second)
+        {
+            hashLocalParticleVector(key, cl->getLocalParticleVector());
+
+            auto cinfo = cl->cellInfo();
+            hashCombine(key, (size_t) cinfo.cellStarts);
+            hashCombine(key, (size_t) cinfo.order);
+        }
+
+    hashCombine(key, interactionManager->getActiveChannelsKey());
+
+    return key;
+}
+
+void Simulation::setTaskGraphCapture(bool enabled)
+{
+    taskGraphCapture = enabled;
+}
+
+void Simulation::startTaskProfiling(int nsteps, std::string fname)
+{
+    scheduler->startProfiling(nsteps);
+    taskProfileFname = fname;
+}
+
+void Simulation::setTaskSchedulingPolicy(std::string policy, int profileSteps)
+{
+    if      (policy == "priority")
+        scheduler->setSchedulingPolicy(TaskScheduler::SchedulingPolicy::Priority);
+    else if (policy == "critical_path")
+        scheduler->setSchedulingPolicy(TaskScheduler::SchedulingPolicy::CriticalPath, profileSteps);
+    else
+        die("Unknown task scheduling policy '%s', possible choices: 'priority', 'critical_path'", policy.c_str());
+
+    info("Using '%s' task scheduling policy", policy.c_str());
+}
+
+void Simulation::setKernelAutotuning(int nsamples, std::string fname)
+{
+    kernelTuningSamples = nsamples;
+    kernelTuningFname   = fname;
+}
+
+void Simulation::setMemoryReportPeriod(int every)
+{
+    if (every < 0)
+        die("Memory report period must be non-negative, got %d", every);
+
+    memoryReportEvery = every;
+}
+
+void Simulation::setPersistentSizeRequests(bool enabled)
+{
+    persistentSizeRequests = enabled;
+}
+
+void Simulation::setAggregatedExchanges(bool enabled)
+{
+    aggregatedExchanges = enabled;
+}
+
+void Simulation::setIntraNodeIPCExchanges(bool enabled)
+{
+    intraNodeIPCExchanges = enabled;
+}
+
+void Simulation::setNeighborCollectiveExchanges(bool enabled)
+{
+    neighborCollectiveExchanges = enabled;
+}
+
+void Simulation::setSpeculativeHaloPacking(bool enabled)
+{
+    speculativeHaloPacking = enabled;
+}
+
+void Simulation::setSortedHalos(bool enabled)
+{
+    sortedHalos = enabled;
+}
+
+void Simulation::setSparseReverseForces(bool enabled)
+{
+    sparseReverseForces = enabled;
+}
+
+void Simulation::setHaloCompression(bool final, bool intermediate)
+{
+    compressedFinalHalo        = final;
+    compressedIntermediateHalo = intermediate;
+}
+
+void Simulation::setExchangeChunkSize(int bytes)
+{
+    if (bytes < 0)
+        die("Exchange chunk size must be non-negative, got %d", bytes);
+
+    exchangeChunkSize = bytes;
+}
+
+void Simulation::setAdaptiveTransport(bool enabled)
+{
+    adaptiveTransport = enabled;
+}
+
+void Simulation::setVirtualPeriodicImages(bool enabled)
+{
+    virtualPeriodicImages = enabled;
+}
+
+void Simulation::setLazyRedistribution(float skin)
+{
+    if (skin < 0.0f)
+        die("Redistribution skin must be non-negative, got %f", skin);
+
+    redistributionSkin = skin;
+}
+
+void Simulation::setOverlappedCellLists(bool enabled)
+{
+    overlappedCellLists = enabled;
+}
+
+void Simulation::setFusedObjectBounce(bool enabled)
+{
+    fusedObjectBounce = enabled;
+}
+
+void Simulation::setAsyncCheckpoints(bool enabled)
+{
+    asyncCheckpoints = enabled;
+}
+
+void Simulation::setCheckpointCompression(std::string compression)
+{
+    // fail early on a wrong description
+    XDMF::stringToCompression(compression);
+    checkpointCompression = compression;
+}
+
+void Simulation::setIncrementalCheckpoints(bool enabled)
+{
+    incrementalCheckpoints = enabled;
+}
+
+void Simulation::setCheckpointStaging(std::string folder)
+{
+    checkpointStagingFolder = folder;
+}
+
+void Simulation::setRawCheckpoints(bool enabled)
+{
+    rawCheckpoints = enabled;
+}
+
+void Simulation::setPreemptionCheckpoint(std::string folder, int signal)
+{
+    if (folder.empty())
+        die("The preemption checkpoint needs a folder");
+
+    if (folder.back() != '/')
+        folder += '/';
+
+    preemptionFolder = folder;
+    Preemption::catchSignal(signal);
+
+    info("Will write the state into folder %s and stop on signal %d", folder.c_str(), signal);
+}
+
+void Simulation::setAdaptiveCheckpoints(float mtbf, float wallTimeLimit)
+{
+    checkpointInterval = std::make_unique<CheckpointInterval>(mtbf, wallTimeLimit);
+
+    info("Will choose the checkpoint interval for a mean time between failures of %g s and a wall-time limit of %g s",
+         mtbf, wallTimeLimit);
+}
+
+void Simulation::setHostWorkers(int nThreads)
+{
+    if (nThreads < 0)
+        die("Number of host workers must be non negative, got %d", nThreads);
+
+    hostWorkers = nThreads;
+}
+
+void Simulation::setBatchedPluginMessages(int nInflight)
+{
+    if (nInflight < 0)
+        die("Number of batches of plugin messages in flight must be non negative, got %d", nInflight);
+    batchedPluginMessages = nInflight;
+}
+
+void Simulation::setPluginCostReport(int every)
+{
+    if (every < 0)
+        die("Period of the plugin cost report must be non negative, got %d", every);
+
+    pluginCostsEvery = every;
+}
+
+void Simulation::setPluginBudget(std::string pluginName, float budget)
+{
+    pluginBudgets[pluginName] = budget;
+}
+
+void Simulation::setPersistentStepMode(int stepsPerLaunch)
+{
+    if (stepsPerLaunch < 0)
+        die("Number of steps per persistent launch must be non negative, got %d", stepsPerLaunch);
+
+    persistentSteps = stepsPerLaunch;
+}
+
+void Simulation::setBatchedRedistribution(bool enabled)
+{
+    batchedRedistribution = enabled;
+}
+
+void Simulation::setEarlyRedistribution(bool enabled)
+{
+    earlyRedistribution = enabled;
+}
+
+void Simulation::setStaticHaloChannels(std::string ovName, const std::vector<std::string>& channelNames)
+{
+    getOVbyNameOrDie(ovName);
+    staticHaloChannelsMap[ovName] = channelNames;
+}
+
+void Simulation::setSurfaceHalo(std::string ovName, bool enabled)
+{
+    getOVbyNameOrDie(ovName);
+
+    if (enabled) surfaceHaloObjects.insert(ovName);
+    else         surfaceHaloObjects.erase (ovName);
+}
+
+void Simulation::setDeviceMonitor(int every, float maxDisplacement)
+{
+    if (every < 0)
+        die("Device monitor period must be non-negative, got %d", every);
+
+    deviceMonitorEvery = every;
+    monitorMaxDisplacement = maxDisplacement;
+}
+
+void Simulation::setBackgroundWallSetup(bool enabled)
+{
+    if (!enabled)
+    {
+        waitWallSetups();
+        backgroundWallSetup = false;
+        return;
+    }
+
+    int provided;
+    MPI_Check( MPI_Query_thread(&provided) );
+
+    if (provided < MPI_THREAD_MULTIPLE)
+    {
+        warn("MPI does not support MPI_THREAD_MULTIPLE, the walls will be set up on the main thread");
+        return;
+    }
+
+    if (wallSetupComm == MPI_COMM_NULL)
+        MPI_Check( MPI_Comm_dup(cartComm, &wallSetupComm) );
+
+    backgroundWallSetup = true;
+}
+
+void Simulation::waitWallSetups() const
+{
+    if (wallSetups.valid())
+        wallSetups.wait();
+}
+
+void Simulation::setAdaptiveTimeStep(float dtMin, float dtMax, float maxDisplacement, float maxGrowth)
+{
+    timeStepController = std::make_unique<TimeStepController>(dtMin, dtMax, maxDisplacement, maxGrowth);
+}
+
+void Simulation::setLoadBalanceReportPeriod(int every)
+{
+    if (every < 0)
+        die("Load balance report period must be non-negative, got %d", every);
+
+    loadBalanceReportEvery = every;
+}
+
+/**
+ * Step times are not a usable measure: the exchanges make all the ranks wait
+ * for the slowest one. Count the particles to work on instead, halo included
+ */
+std::vector<double> Simulation::getTaskCategoryTimes() const
+{
+    return scheduler->getCategoryTimes();
+}
+
+double Simulation::getLocalLoad() const
+{
+    double load = 0;
+    for (auto& pv : particleVectors)
+        load += pv->local()->size() + pv->halo()->size();
+    return load;
+}
+
+void Simulation::setBufferShrinkPolicy(int nsteps, float threshold, bool atCheckpoint)
+{
+    shrinkPolicy = ShrinkPolicy(nsteps, threshold, atCheckpoint);
+}
+
+std::vector<GPUcontainer*> Simulation::getShrinkableContainers()
+{
+    std::vector<GPUcontainer*> containers;
+    auto append = [&containers] (const std::vector<GPUcontainer*>& cs) {
+        containers.insert(containers.end(), cs.begin(), cs.end());
+    };
+
+    for (auto& pv : particleVectors)
+    {
+        append(pv->local()->getContainers());
+        append(pv->halo() ->getContainers());
+    }
+
+    for (auto& clVec : cellListMap)
+        for (auto& cl : clVec.second)
+            append(cl->getContainers());
+
+    for (auto engine : {partRedistributor.get(), objRedistibutor.get(),
+                        partHaloIntermediate.get(), partHaloFinal.get(), partHaloFinalExtra.get(),
+                        objHaloIntermediate.get(), objHaloReverseIntermediate.get(),
+                        objHaloFinal.get(), objHaloReverseFinal.get(), objHaloStatic.get()})
+        if (engine != nullptr)
+            append(engine->getContainers());
+
+    return containers;
+}
+
+// Called between the time-steps, when no pointer to the buffers is held
+void Simulation::shrinkBuffers()
+{
+    const bool atCheckpoint = checkpointedThisStep && shrinkPolicy.shrinksAtCheckpoint();
+    checkpointedThisStep = false;
+
+    if (!atCheckpoint && !shrinkPolicy.hysteresisEnabled())
+        return;
+
+    auto containers = getShrinkableContainers();
+
+    if (atCheckpoint)
+    {
+        shrinkPolicy.shrinkAll(containers, defaultStream);
+        debug("Shrunk the particle and exchange buffers after checkpoint");
+    }
+    else
+        shrinkPolicy.update(containers, defaultStream);
+
+    // the next step may use the buffers on any stream
+    CUDA_Check( cudaStreamSynchronize(defaultStream) );
+}
+
+void Simulation::setCellListOrdering(std::string pvName, std::string ordering)
+{
+    if (ordering != "row_major" && ordering != "morton")
+        die("Unknown cell-list ordering '%s', possible choices: 'row_major', 'morton'", ordering.c_str());
+
+    getPVbyNameOrDie(pvName);
+    cellListOrderingMap[pvName] = ordering;
+}
+
+void Simulation::setCellListIncremental(std::string pvName, float maxMovedFraction)
+{
+    if (maxMovedFraction < 0.0f || maxMovedFraction > 1.0f)
+        die("Fraction of moved particles of the incremental cell-list builds must be in [0, 1], got %g", maxMovedFraction);
+
+    getPVbyNameOrDie(pvName);
+    cellListIncrementalMap[pvName] = maxMovedFraction;
+}
+
+void Simulation::setCellListBuild(std::string pvName, std::string method)
+{
+    if (method != "atomics" && method != "radix_sort" && method != "auto")
+        die("Unknown cell-list build method '%s', possible choices: 'atomics', 'radix_sort', 'auto'", method.c_str());
+
+    getPVbyNameOrDie(pvName);
+    cellListBuildMap[pvName] = method;
+}
+
+void Simulation::setObjectReordering(std::string ovName, int every)
+{
+    if (every <= 0)
+        die("Objects of '%s' must be reordered every positive number of steps, got %d", ovName.c_str(), every);
+
+    getOVbyNameOrDie(ovName);
+    objectReorderingMap[ovName] = every;
+}
+
 void Simulation::saveDependencyGraph_GraphML(std::string fname, bool current) const
 {
     if (rank != 0) return;
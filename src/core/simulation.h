@@ -3,12 +3,16 @@
 #include <core/containers.h>
 #include <core/datatypes.h>
 #include <core/domain.h>
+#include <core/load_balance.h>
 #include <core/logger.h>
 #include <core/mpi/exchanger_interfaces.h>
+#include <core/utils/shrink_policy.h>
 
 #include <functional>
+#include <future>
 #include <map>
 #include <memory>
+#include <set>
 #include <string>
 #include <tuple>
 #include <vector>
@@ -28,6 +32,16 @@ class InitialConditions;
 class Bouncer;
 class ObjectBelongingChecker;
 class SimulationPlugin;
+class CheckpointInterval;
+class CheckpointWriter;
+class BatchedSender;
+class SamplingPipeline;
+class BodyForces;
+class ParticleRedistributor;
+class PersistentStepper;
+class PluginCosts;
+class DeviceMonitor;
+class TimeStepController;
 struct SimulationTasks;
 
 class Simulation
@@ -74,6 +88,20 @@ public:
     void init();
     void run(int nsteps);
 
+    /**
+     * run() step by step, such that several simulations can share the GPU from one thread:
+     * startRun(), then for every step startStep(), progressStep() until it returns true
+     * and finishStep(), and finishRun() at the end
+     */
+    void startRun(int nsteps);
+    void startStep();
+    bool progressStep();
+    void finishStep();
+    void finishRun(int nsteps);
+
+    /// whether the run stopped on a preemption notice, see setPreemptionCheckpoint()
+    bool isPreempted() const;
+
     std::vector<ParticleVector*> getParticleVectors() const;
 
     ParticleVector* getPVbyName     (std::string name) const;
@@ -87,6 +115,12 @@ public:
 
     CellList* gelCellList(ParticleVector* pv) const;
 
+    /// shared per-particle sampling of the plugins, run after their afterIntegration()
+    SamplingPipeline* getSamplingPipeline() const;
+
+    /// shared constant forces and torques of the plugins, applied after their beforeForces()
+    BodyForces* getBodyForces() const;
+
     void startProfiler() const;
     void stopProfiler() const;
 
@@ -99,6 +133,55 @@ public:
     
     void saveDependencyGraph_GraphML(std::string fname, bool current) const;
 
+    void setTaskGraphCapture(bool enabled);
+    void startTaskProfiling(int nsteps, std::string fname);
+    void setTaskSchedulingPolicy(std::string policy, int profileSteps);
+
+    void setCellListOrdering(std::string pvName, std::string ordering);
+    void setCellListIncremental(std::string pvName, float maxMovedFraction);
+    void setCellListBuild(std::string pvName, std::string method);
+    void setObjectReordering(std::string ovName, int every);
+    void setKernelAutotuning(int nsamples, std::string fname);
+    void setMemoryReportPeriod(int every);
+    void setBufferShrinkPolicy(int nsteps, float threshold, bool atCheckpoint);
+    void setPersistentSizeRequests(bool enabled);
+    void setAggregatedExchanges(bool enabled);
+    void setIntraNodeIPCExchanges(bool enabled);
+    void setNeighborCollectiveExchanges(bool enabled);
+    void setSpeculativeHaloPacking(bool enabled);
+    void setSortedHalos(bool enabled);
+    void setSparseReverseForces(bool enabled);
+    void setHaloCompression(bool final, bool intermediate);
+    void setLoadBalanceReportPeriod(int every);
+    void setDeviceMonitor(int every, float maxDisplacement);
+    void setAdaptiveTimeStep(float dtMin, float dtMax, float maxDisplacement, float maxGrowth);
+    void setBackgroundWallSetup(bool enabled);
+
+    /// profiled time of the tasks of every NVTX::Category since the start, in ms, see startTaskProfiling()
+    std::vector<double> getTaskCategoryTimes() const;
+    void setStaticHaloChannels(std::string ovName, const std::vector<std::string>& channelNames);
+    void setSurfaceHalo(std::string ovName, bool enabled);
+    void setBatchedRedistribution(bool enabled);
+    void setEarlyRedistribution(bool enabled);
+    void setOverlappedCellLists(bool enabled);
+    void setFusedObjectBounce(bool enabled);
+    void setExchangeChunkSize(int bytes);
+    void setAdaptiveTransport(bool enabled);
+    void setVirtualPeriodicImages(bool enabled);
+    void setLazyRedistribution(float skin);
+    void setAsyncCheckpoints(bool enabled);
+    void setCheckpointCompression(std::string compression);
+    void setIncrementalCheckpoints(bool enabled);
+    void setCheckpointStaging(std::string folder);
+    void setRawCheckpoints(bool enabled);
+    void setPreemptionCheckpoint(std::string folder, int signal);
+    void setAdaptiveCheckpoints(float mtbf, float wallTimeLimit);
+    void setHostWorkers(int nThreads);
+    void setBatchedPluginMessages(int nInflight);
+    void setPersistentStepMode(int stepsPerLaunch);
+    void setPluginCostReport(int every);
+    void setPluginBudget(std::string pluginName, float budget);
+
 
 private:    
     const float rcTolerance = 1e-5;
@@ -117,15 +200,113 @@ private:
     std::unique_ptr<SimulationTasks> tasks;
 
     std::unique_ptr<InteractionManager> interactionManager;
+    std::unique_ptr<SamplingPipeline> samplingPipeline;
+    std::unique_ptr<BodyForces> bodyForces;
 
     bool gpuAwareMPI;
+    bool persistentSizeRequests {false};
+    bool aggregatedExchanges {false};
+    bool neighborCollectiveExchanges {false};
+    bool intraNodeIPCExchanges {false};
+    bool speculativeHaloPacking {false};
+    bool sortedHalos {false};
+    bool sparseReverseForces {false};
+    bool compressedFinalHalo {false}, compressedIntermediateHalo {false};
+    bool batchedRedistribution {false};
+    bool earlyRedistribution {false};
+    bool overlappedCellLists {false};
+    bool fusedObjectBounce {false};
+    int exchangeChunkSize {0};
+    bool adaptiveTransport {false};
+    bool virtualPeriodicImages {false};
+    float redistributionSkin {0.0f};  ///< particles may stay up to half of it outside, 0 if redistributed every step
+    std::set<ParticleVector*> periodicImagesPVs; ///< no interaction needs their halo, see setVirtualPeriodicImages()
+    bool taskGraphCapture {false};
+    std::string taskProfileFname;
+
+    int kernelTuningSamples {0};
+    std::string kernelTuningFname;
+
+    /// log the memory usage every this many steps, never if 0
+    int memoryReportEvery {0};
+
+    /// log the load imbalance between the ranks every this many steps, never if 0
+    int loadBalanceReportEvery {0};
+    std::unique_ptr<LoadBalanceMonitor> loadBalanceMonitor;
+
+    /// check the forces and displacements on the device every this many steps, never if 0; see DeviceMonitor
+    int deviceMonitorEvery {0};
+    float monitorMaxDisplacement {0.0f};
+    std::unique_ptr<DeviceMonitor> deviceMonitor; ///< also counts the particles inside the walls
+
+    /// read the SDF of the walls registered from now on on a helper thread, with its own communicator
+    bool backgroundWallSetup {false};
+    MPI_Comm wallSetupComm {MPI_COMM_NULL};
+    std::shared_future<void> wallSetups;   ///< completes with the setup of the last registered wall
+    void waitWallSetups() const;
+
+    /// adapts the time step after every step if set, see TimeStepController
+    std::unique_ptr<TimeStepController> timeStepController;
+
+    double getLocalLoad() const;
+
+    /// when to give back the memory of the particle and exchange buffers, see ShrinkPolicy
+    ShrinkPolicy shrinkPolicy;
+    bool checkpointedThisStep {false};
+
+    /// write the checkpoint files of the particle vectors in the background, see CheckpointWriter
+    bool asyncCheckpoints {false};
+    std::string checkpointCompression {"none"};
+    bool incrementalCheckpoints {false};
+    std::string checkpointStagingFolder;
+
+    /// raw checkpoints of the particle vectors that are not object vectors, see RawCheckpoint
+    bool rawCheckpoints {false};
+
+    /**
+     * On the preemption signal, the ranks agree at the end of a step through a non-blocking reduction
+     * overlapping with the next step, write the persistent state into preemptionFolder and stop the run
+     */
+    std::string preemptionFolder;
+    int preemptionLocal {0}, preemptionGlobal {0};
+    MPI_Request preemptionRequest {MPI_REQUEST_NULL};
+    bool preempted {false};
+
+    /// chooses the steps of the global checkpoints if set, instead of globalCheckpointEvery
+    std::unique_ptr<CheckpointInterval> checkpointInterval;
+
+    /// helper threads running the tasks that wait for MPI, see TaskScheduler::setHostWorkers()
+    int hostWorkers {0};
+
+    /// steps advanced by every launch of the persistent kernel, 0 to run the task graph, see PersistentStepper
+    int persistentSteps {0};
+    std::unique_ptr<PersistentStepper> persistentStepper;
+
+    /// time of the plugin hooks, reported every pluginCostsEvery steps if positive, see PluginCosts
+    int pluginCostsEvery {0};
+    std::map<std::string, float> pluginBudgets;  ///< fraction of the step time, by plugin name
+    std::unique_ptr<PluginCosts> pluginCosts;
+    std::unique_ptr<CheckpointWriter> checkpointWriter;
+
+    /// number of batches of plugin messages in flight, 0 to send them directly, see BatchedSender
+    int batchedPluginMessages {0};
+    std::unique_ptr<BatchedSender> batchedSender;
 
     using ExchangeEngineUniquePtr = std::unique_ptr<ExchangeEngine>;
 
     ExchangeEngineUniquePtr partRedistributor, objRedistibutor;
     ExchangeEngineUniquePtr partHaloIntermediate, partHaloFinal;
+    ExchangeEngineUniquePtr partHaloFinalExtra; ///< final channels of the intermediate halo, see ParticleHaloExtraExchanger
+    ParticleRedistributor *partRedistributorImp {nullptr}; ///< owned by partRedistributor, see setLazyRedistribution()
     ExchangeEngineUniquePtr objHaloIntermediate, objHaloReverseIntermediate;
     ExchangeEngineUniquePtr objHaloFinal, objHaloReverseFinal;
+    ExchangeEngineUniquePtr objHaloStatic;
+
+    /// per-object channels sent to the halo only when the objects enter it, see ObjectStaticExchanger
+    std::map<std::string, std::vector<std::string>> staticHaloChannelsMap;
+
+    /// object vectors of which only the particles within rc of the subdomain faces are sent to the halo
+    std::set<std::string> surfaceHaloObjects;
 
     std::map<std::string, int> pvIdMap;
     std::vector< std::shared_ptr<ParticleVector> > particleVectors;
@@ -144,6 +325,10 @@ private:
 
 
     std::map<ParticleVector*, std::vector< std::unique_ptr<CellList> >> cellListMap;
+    std::map<std::string, std::string> cellListOrderingMap;
+    std::map<std::string, float> cellListIncrementalMap; ///< largest fraction of moved particles of the incremental builds
+    std::map<std::string, std::string> cellListBuildMap;
+    std::map<std::string, int> objectReorderingMap; ///< period of ObjectVector::reorderObjects(), by object vector
 
     struct InteractionPrototype
     {
@@ -198,25 +383,47 @@ private:
     std::vector<PvsCheckPointPrototype>       pvsCheckPointPrototype;
 
     std::vector<std::function<void(cudaStream_t)>> integratorsStage1, integratorsStage2;
+    std::vector<std::function<void(cudaStream_t)>> integratorsInterior; ///< second part of the split stage2, see Integrator::setSplitCellList()
     std::vector<std::function<void(cudaStream_t)>> regularBouncers, haloBouncers;
+    std::vector<std::function<void(cudaStream_t)>> fusedBouncers; ///< local and halo objects at once, see setFusedObjectBounce()
 
     std::map<std::string, std::string> pvsIntegratorMap;
+    std::map<std::string, std::vector<ParticleVector*>> integratorBatches; ///< ParticleVectors integrated in one batch, by batch key
+    std::set<CellList*> integratorBinnedCellLists; ///< counted by the integrators during stage2, see Integrator::setBinningCellList()
 
     
     
 private:
 
     std::vector<std::string> getExtraDataToExchange(ObjectVector *ov);
+    void checkSurfaceHalo(ObjectVector *ov, const std::vector<std::string>& extraIntermediate,
+                          const std::vector<std::string>& staticChannels) const;
     
     void prepareCellLists();
+    bool prepareHierarchicalCellLists(ParticleVector *pv, const std::vector<float>& cutoffs);
     void prepareInteractions();
+    void preparePeriodicImages();
     void prepareBouncers();
     void prepareWalls();
+    std::set<ParticleVector*> getMovedAfterIntegration() const;
+    void prepareIntegratorBinning();
+    void prepareIntegratorSplit();
     void preparePlugins();
+    void preparePersistentStepper();
     void prepareEngines();
     
     void execSplitters();
 
+    /// all the buffers sized by the number of particles: particle vectors, cell-lists and exchange engines
+    std::vector<GPUcontainer*> getShrinkableContainers();
+    void shrinkBuffers();
+    void checkPreemption();
+    void preemptionCheckpoint();
+
+    void runPersistent(int nsteps);
+
     void createTasks();
+
+    size_t computeTaskGraphKey() const;
 };
 
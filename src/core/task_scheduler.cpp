@@ -2,18 +2,32 @@
 #include <unistd.h>
 #include <sstream>
 #include <fstream>
+#include <iomanip>
 
 #include <extern/pugixml/src/pugixml.hpp>
 
 #include <core/task_scheduler.h>
 #include <core/logger.h>
+#include <core/utils/cuda_common.h>
 #include <core/utils/make_unique.h>
+#include <core/utils/memory_pool.h>
+#include <core/utils/nvtx.h>
 
 TaskScheduler::TaskScheduler()
 {
     CUDA_Check( cudaDeviceGetStreamPriorityRange(&cudaPriorityLow, &cudaPriorityHigh) );
 }
 
+TaskScheduler::~TaskScheduler()
+{
+    stopHostWorkers();
+
+    for (auto& n : nodes)
+        destroyGraphs(n.get());
+
+    destroyEvents();
+}
+
 TaskScheduler::TaskID TaskScheduler::createTask(const std::string& label)
 {
     auto id = getTaskId(label);
@@ -24,6 +38,7 @@ TaskScheduler::TaskID TaskScheduler::createTask(const std::string& label)
     label2taskId[label] = id;
 
     Task task {label, id};
+    task.category = NVTX::categorize(label);
     tasks.push_back(task);
 
     return id;
@@ -65,7 +80,7 @@ TaskScheduler::Node* TaskScheduler::getNodeOrDie(TaskID id)
 }
 
 
-void TaskScheduler::addTask(TaskID id, TaskScheduler::Function task, int every)
+void TaskScheduler::addTask(TaskID id, TaskScheduler::Function task, int every, int phase)
 {
     if (id >= tasks.size() || id < 0)
         die("No such task with id %d", id);
@@ -73,7 +88,10 @@ void TaskScheduler::addTask(TaskID id, TaskScheduler::Function task, int every)
     if (every <= 0)
         die("What the fuck is this value %d???", every);
 
-    tasks[id].funcs.push_back({task, every});
+    if (phase < 0 || phase >= every)
+        die("Phase %d of a function of task '%s' must be in [0, %d)", phase, tasks[id].label.c_str(), every);
+
+    tasks[id].funcs.push_back({task, every, phase});
 }
 
 
@@ -94,6 +112,126 @@ void TaskScheduler::setHighPriority(TaskID id)
     tasks[id].priority = cudaPriorityHigh;
 }
 
+void TaskScheduler::setGraphCapturable(TaskID id)
+{
+    if (id >= tasks.size() || id < 0)
+        die("No such task with id %d", id);
+
+    tasks[id].capturable = true;
+}
+
+void TaskScheduler::setCommunicationTask(TaskID id)
+{
+    if (id >= tasks.size() || id < 0)
+        die("No such task with id %d", id);
+
+    tasks[id].communication = true;
+}
+
+void TaskScheduler::setBlocking(TaskID id)
+{
+    if (id >= tasks.size() || id < 0)
+        die("No such task with id %d", id);
+
+    tasks[id].blocking = true;
+}
+
+void TaskScheduler::setHostWorkers(int nThreads)
+{
+    if (nThreads < 0)
+        die("Number of host workers must be non negative, got %d", nThreads);
+
+    stopHostWorkers();
+
+    // the workers launch on the device of the scheduler
+    int device;
+    CUDA_Check( cudaGetDevice(&device) );
+
+    stopWorkers = false;
+    for (int i = 0; i < nThreads; i++)
+        workers.emplace_back(&TaskScheduler::workerLoop, this, device);
+
+    debug("Blocking tasks will run on %d host workers", nThreads);
+}
+
+void TaskScheduler::stopHostWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(workMutex);
+        stopWorkers = true;
+    }
+    workAvailable.notify_all();
+
+    for (auto& w : workers)
+        w.join();
+    workers.clear();
+}
+
+void TaskScheduler::workerLoop(int device)
+{
+    CUDA_Check( cudaSetDevice(device) );
+
+    while (true)
+    {
+        std::pair<Node*, cudaStream_t> work;
+        {
+            std::unique_lock<std::mutex> lock(workMutex);
+            workAvailable.wait(lock, [this] () { return stopWorkers || !workQueue.empty(); });
+
+            if (workQueue.empty()) return;
+
+            work = workQueue.front();
+            workQueue.pop_front();
+        }
+
+        auto node = work.first;
+        {
+            NVTX::Range range(tasks[node->id].label, tasks[node->id].category);
+            execNode(node, work.second);
+        }
+
+        if (profilingStepsLeft > 0)
+            CUDA_Check( cudaEventRecord(node->evEnd, work.second) );
+
+        node->hostDone = true;
+    }
+}
+
+void TaskScheduler::submitToWorker(Node *node, cudaStream_t stream)
+{
+    node->hostDone = false;
+    {
+        std::lock_guard<std::mutex> lock(workMutex);
+        workQueue.push_back({node, stream});
+    }
+    workAvailable.notify_one();
+}
+
+void TaskScheduler::setSchedulingPolicy(SchedulingPolicy policy, int profileSteps)
+{
+    this->policy = policy;
+    ranksValid = false;
+
+    if (policy == SchedulingPolicy::CriticalPath)
+    {
+        if (profiledSteps == 0 && !isProfiling())
+            startProfiling(profileSteps);
+        else if (!isProfiling())
+            computeRanks();
+    }
+}
+
+void TaskScheduler::enableGraphCapture(GraphKeyFunction key)
+{
+    useGraphs = true;
+    graphKey  = key;
+
+    for (auto& n : nodes)
+        destroyGraphs(n.get());
+
+    info("Capturable tasks will be replayed from CUDA graphs");
+}
+
 void TaskScheduler::forceExec(TaskID id, cudaStream_t stream)
 {
     if (id >= tasks.size() || id < 0)
@@ -101,13 +239,16 @@ void TaskScheduler::forceExec(TaskID id, cudaStream_t stream)
 
     debug("Forced execution of group %s", tasks[id].label.c_str());
 
-    for (auto& func_every : tasks[id].funcs)
-        func_every.first(stream);
+    for (auto& f : tasks[id].funcs)
+        f.func(stream);
 }
 
 
 void TaskScheduler::createNodes()
 {
+    for (auto& n : nodes)
+        destroyGraphs(n.get());
+    destroyEvents();
     nodes.clear();
 
     for (auto& t : tasks)
@@ -247,82 +388,147 @@ void TaskScheduler::compile()
     removeEmptyNodes();
 
     logDepsGraph();
+
+    ranksValid = false;
+    if (policy == SchedulingPolicy::CriticalPath && profiledSteps > 0 && !isProfiling())
+        computeRanks();
 }
 
 
 
 void TaskScheduler::run()
+{
+    start();
+    while (!progress());
+    finish();
+}
+
+void TaskScheduler::start()
 {
     // Kahn's algorithm
     // https://en.wikipedia.org/wiki/Topological_sorting
 
-    auto compareNodes = [] (Node* a, Node* b) {
+    const bool byRank = policy == SchedulingPolicy::CriticalPath && ranksValid;
+
+    auto compareNodes = [byRank] (Node* a, Node* b) {
+        // longer path to the end goes first
+        if (byRank)
+            return a->rank < b->rank;
+
         // lower number means higher priority
         return a->priority < b->priority;
     };
-    std::priority_queue<Node*, std::vector<Node*>, decltype(compareNodes)> S(compareNodes);
-    std::vector<std::pair<cudaStream_t, Node*>> workMap;
+    readyNodes = ReadyQueue(compareNodes);
+    runningNodes.clear();
 
     for (auto& n : nodes)
     {
         n->from = n->from_backup;
 
         if (n->from.empty())
-            S.push(n.get());
+            readyNodes.push(n.get());
     }
 
-    int completed = 0;
-    const int total = nodes.size();
+    nCompleted = 0;
 
-    while (true)
+    profilingRun = profilingStepsLeft > 0;
+    if (profilingRun)
+    {
+        createEvents();
+        CUDA_Check( cudaEventRecord(evStepStart, defaultStream) );
+    }
+}
+
+bool TaskScheduler::progress()
+{
+    launchReadyNodes();
+    pollRunningNodes();
+    launchReadyNodes();
+
+    return nCompleted == nodes.size();
+}
+
+void TaskScheduler::finish()
+{
+    while (!progress());
+
+    nExecutions++;
+    CUDA_Check( cudaDeviceSynchronize() );
+    MemoryPool::onDeviceSynchronized();
+
+    if (profilingRun)
+        collectProfile();
+}
+
+void TaskScheduler::resolve(Node *node)
+{
+    // Remove the dependencies resolved by a completed node
+    for (auto dep : node->to)
     {
-        // Check the status of all running kernels
-        while (completed < total && S.empty())
+        if (!dep->from.empty())
         {
-            for (auto streamNode_it = workMap.begin(); streamNode_it != workMap.end(); )
-            {
-                auto result = cudaStreamQuery(streamNode_it->first);
-                if ( result == cudaSuccess )
-                {
-                    auto node = streamNode_it->second;
-
-                    debug("Completed group %s ", tasks[node->id].label.c_str());
-
-                    // Return freed stream back to the corresponding queue
-                    node->streams->push(streamNode_it->first);
-
-                    // Remove resolved dependencies
-                    for (auto dep : node->to)
-                    {
-                        if (!dep->from.empty())
-                        {
-                            dep->from.remove(node);
-                            if (dep->from.empty())
-                                S.push(dep);
-                        }
-                    }
-
-                    // Remove task from the list of currently in progress
-                    completed++;
-                    streamNode_it = workMap.erase(streamNode_it);
-                }
-                else if (result == cudaErrorNotReady)
-                {
-                    streamNode_it++;
-                }
-                else
-                {
-                    error("Group '%s' raised an error",  tasks[streamNode_it->second->id].label.c_str());
-                    CUDA_Check( result );
-                }
-            }
+            dep->from.remove(node);
+            if (dep->from.empty())
+                readyNodes.push(dep);
         }
+    }
+
+    nCompleted++;
+}
 
-        if (completed == total)
-            break;
+void TaskScheduler::pollRunningNodes()
+{
+    // Check the status of all running kernels
+    for (auto streamNode_it = runningNodes.begin(); streamNode_it != runningNodes.end(); )
+    {
+        // the functions are still being called by a host worker
+        if (!streamNode_it->second->hostDone)
+        {
+            streamNode_it++;
+            continue;
+        }
 
-        Node* node = S.top();
-        S.pop();
+        auto result = cudaStreamQuery(streamNode_it->first);
+        if ( result == cudaSuccess )
+        {
+            auto node = streamNode_it->second;
+
+            debug("Completed group %s ", tasks[node->id].label.c_str());
+
+            // Return freed stream back to the corresponding queue
+            node->streams->push(streamNode_it->first);
+
+            resolve(node);
+
+            // Remove task from the list of currently in progress
+            streamNode_it = runningNodes.erase(streamNode_it);
+        }
+        else if (result == cudaErrorNotReady)
+        {
+            streamNode_it++;
+        }
+        else
+        {
+            error("Group '%s' raised an error",  tasks[streamNode_it->second->id].label.c_str());
+            CUDA_Check( result );
+        }
+    }
+}
+
+void TaskScheduler::launchReadyNodes()
+{
+    while (!readyNodes.empty())
+    {
+        Node* node = readyNodes.top();
+        readyNodes.pop();
+
+        // Nothing of the task is due at this run, it completes right away
+        // The profiled runs time all the tasks
+        if (!profilingRun && !hasDueFunctions(node))
+        {
+            resolve(node);
+            continue;
+        }
 
         cudaStream_t stream;
         if (node->streams->empty())
@@ -334,26 +540,446 @@ void TaskScheduler::run()
         }
 
         debug("Executing group %s on stream %lld with priority %d", tasks[node->id].label.c_str(), (int64_t)stream, node->priority);
-        workMap.push_back({stream, node});
+        runningNodes.push_back({stream, node});
 
-        for (auto& func_every : tasks[node->id].funcs)
-            if (nExecutions % func_every.second == 0)
-                func_every.first(stream);
+        if (profilingRun)
+        {
+            if (streamIds.find(stream) == streamIds.end())
+            {
+                const int newId = streamIds.size();
+                streamIds[stream] = newId;
+            }
+
+            node->streamId = streamIds[stream];
+            CUDA_Check( cudaEventRecord(node->evStart, stream) );
+        }
+
+        // the worker records the end event
+        if (tasks[node->id].blocking && !workers.empty())
+        {
+            submitToWorker(node, stream);
+            continue;
+        }
+
+        {
+            NVTX::Range range(tasks[node->id].label, tasks[node->id].category);
+            execNode(node, stream);
+        }
+
+        if (profilingRun)
+            CUDA_Check( cudaEventRecord(node->evEnd, stream) );
     }
+}
 
-    nExecutions++;
-    CUDA_Check( cudaDeviceSynchronize() );
+
+void TaskScheduler::execNode(Node *node, cudaStream_t stream)
+{
+    auto& task = tasks[node->id];
+
+    if (useGraphs && task.capturable)
+    {
+        execNodeGraph(node, stream);
+        return;
+    }
+
+    for (auto& f : task.funcs)
+        if (isDue(f))
+            f.func(stream);
 }
 
+bool TaskScheduler::isDue(const Task::ScheduledFunction& f) const
+{
+    return nExecutions % f.every == f.phase;
+}
 
-static void add_node(pugi::xml_node& graph, int id, std::string label)
+bool TaskScheduler::hasDueFunctions(const Node *node) const
+{
+    for (auto& f : tasks[node->id].funcs)
+        if (isDue(f))
+            return true;
+    return false;
+}
+
+void TaskScheduler::execNodeGraph(Node *node, cudaStream_t stream)
+{
+    auto& task = tasks[node->id];
+
+    // Graph is captured for one pattern of the active functions
+    // More than 64 functions per task won't fit into the mask, don't capture
+    uint64_t pattern = 0;
+    bool fits = task.funcs.size() <= 64;
+    for (int i = 0; i < task.funcs.size() && fits; i++)
+        if (isDue(task.funcs[i]))
+            pattern |= (uint64_t)1 << i;
+
+    if (!fits)
+    {
+        warn("Task '%s' has too many functions (%d) to be captured in a graph, will be launched as usual",
+             task.label.c_str(), task.funcs.size());
+        task.capturable = false;
+        execNode(node, stream);
+        return;
+    }
+
+    auto key = std::make_pair(pattern, graphKey ? graphKey() : (size_t) 0);
+    auto it = node->graphs.find(key);
+
+    if (it == node->graphs.end())
+    {
+        if (node->graphs.size() >= maxGraphsPerNode)
+        {
+            debug("Task '%s' has too many cached graphs, dropping them", task.label.c_str());
+            destroyGraphs(node);
+        }
+
+        debug("Capturing task '%s' into a CUDA graph, pattern %llx, key %llx",
+              task.label.c_str(), (unsigned long long) key.first, (unsigned long long) key.second);
+
+        cudaGraph_t graph;
+        CUDA_Check( cudaStreamBeginCapture(stream, cudaStreamCaptureModeThreadLocal) );
+
+        for (int i = 0; i < task.funcs.size(); i++)
+            if (pattern & ((uint64_t)1 << i))
+                task.funcs[i].func(stream);
+
+        auto status = cudaStreamEndCapture(stream, &graph);
+
+        if (status != cudaSuccess)
+        {
+            // Not critical, the task just didn't respect the capture rules
+            // Clear the error and fall back to the regular execution
+            cudaGetLastError();
+            warn("Task '%s' could not be captured into a CUDA graph (%s), will be launched as usual",
+                 task.label.c_str(), cudaGetErrorString(status));
+
+            task.capturable = false;
+            destroyGraphs(node);
+            execNode(node, stream);
+            return;
+        }
+
+        cudaGraphExec_t instance;
+        CUDA_Check( cudaGraphInstantiate(&instance, graph, nullptr, nullptr, 0) );
+        CUDA_Check( cudaGraphDestroy(graph) );
+
+        it = node->graphs.insert({key, instance}).first;
+    }
+
+    CUDA_Check( cudaGraphLaunch(it->second, stream) );
+}
+
+void TaskScheduler::destroyGraphs(Node *node)
+{
+    for (auto& entry : node->graphs)
+        CUDA_Check( cudaGraphExecDestroy(entry.second) );
+
+    node->graphs.clear();
+}
+
+
+void TaskScheduler::startProfiling(int nsteps)
+{
+    if (nsteps <= 0)
+        die("Number of profiled steps must be positive, got %d", nsteps);
+
+    profilingStepsLeft = nsteps;
+    profiledSteps = 0;
+    totalStepTime = 0;
+
+    profiles.clear();
+    profiles.resize(tasks.size());
+
+    info("Tasks will be profiled during the next %d steps", nsteps);
+}
+
+bool TaskScheduler::isProfiling() const
+{
+    return profilingStepsLeft > 0;
+}
+
+void TaskScheduler::createEvents()
+{
+    if (evStepStart == nullptr)
+        CUDA_Check( cudaEventCreate(&evStepStart) );
+
+    for (auto& n : nodes)
+    {
+        if (n->evStart == nullptr) CUDA_Check( cudaEventCreate(&n->evStart) );
+        if (n->evEnd   == nullptr) CUDA_Check( cudaEventCreate(&n->evEnd)   );
+    }
+
+    // tasks may have been created after the profiling request
+    if (profiles.size() < tasks.size())
+        profiles.resize(tasks.size());
+}
+
+void TaskScheduler::destroyEvents()
+{
+    if (evStepStart != nullptr)
+        CUDA_Check( cudaEventDestroy(evStepStart) );
+    evStepStart = nullptr;
+
+    for (auto& n : nodes)
+    {
+        if (n->evStart != nullptr) CUDA_Check( cudaEventDestroy(n->evStart) );
+        if (n->evEnd   != nullptr) CUDA_Check( cudaEventDestroy(n->evEnd)   );
+        n->evStart = n->evEnd = nullptr;
+    }
+}
+
+std::vector<double> TaskScheduler::getCategoryTimes() const
+{
+    std::vector<double> times(static_cast<int>(NVTX::Category::Other) + 1, 0.0);
+
+    for (int i = 0; i < profiles.size() && i < tasks.size(); i++)
+        times[static_cast<int>(tasks[i].category)] += profiles[i].totalTime;
+
+    return times;
+}
+
+void TaskScheduler::collectProfile()
+{
+    Node *last = nullptr;
+
+    for (auto& n : nodes)
+    {
+        CUDA_Check( cudaEventElapsedTime(&n->tStart, evStepStart, n->evStart) );
+        CUDA_Check( cudaEventElapsedTime(&n->tEnd,   evStepStart, n->evEnd)   );
+
+        if (last == nullptr || n->tEnd > last->tEnd)
+            last = n.get();
+    }
+
+    for (auto& n : nodes)
+    {
+        // The task was ready to go when all its dependencies were completed
+        float ready = 0.0f;
+        for (auto dep : n->from_backup)
+            ready = std::max(ready, dep->tEnd);
+
+        auto& prof = profiles[n->id];
+        const double duration = n->tEnd - n->tStart;
+
+        prof.nsamples++;
+        prof.totalTime  += duration;
+        prof.minTime     = std::min(prof.minTime, duration);
+        prof.maxTime     = std::max(prof.maxTime, duration);
+        prof.totalStart += n->tStart;
+        prof.totalWait  += std::max(0.0f, n->tStart - ready);
+        prof.streamUsage[n->streamId]++;
+    }
+
+    // Critical path: walk back from the task completed the last
+    // each time through the dependency that was completed the last
+    for (auto n = last; n != nullptr; )
+    {
+        profiles[n->id].onCriticalPath++;
+
+        Node *next = nullptr;
+        for (auto dep : n->from_backup)
+            if (next == nullptr || dep->tEnd > next->tEnd)
+                next = dep;
+        n = next;
+    }
+
+    totalStepTime += (last != nullptr) ? last->tEnd : 0.0f;
+    profiledSteps++;
+    profilingStepsLeft--;
+
+    if (profilingStepsLeft == 0)
+    {
+        info("Tasks profiling completed:\n%s", getProfilingReport().c_str());
+
+        if (policy == SchedulingPolicy::CriticalPath)
+            computeRanks();
+    }
+}
+
+void TaskScheduler::computeRanks()
+{
+    // rank(n) = time(n) + max rank(successors)
+    // Communication tasks additionally get the whole step time
+    // so that they always start before anything else that is ready
+    const double stepTime = profiledSteps > 0 ? totalStepTime / profiledSteps : 0.0;
+
+    std::function<double(Node*)> rankOf;
+    std::unordered_map<Node*, double> ranks;
+
+    rankOf = [&] (Node *n) -> double {
+        auto it = ranks.find(n);
+        if (it != ranks.end()) return it->second;
+
+        const auto& prof = profiles[n->id];
+        double r = prof.nsamples > 0 ? prof.totalTime / prof.nsamples : 0.0;
+
+        double maxNext = 0;
+        for (auto next : n->to)
+            maxNext = std::max(maxNext, rankOf(next));
+
+        r += maxNext;
+        ranks[n] = r;
+        return r;
+    };
+
+    for (auto& n : nodes)
+    {
+        n->rank = rankOf(n.get());
+        if (tasks[n->id].communication)
+            n->rank += stepTime;
+
+        debug("Task '%s' has rank %f", tasks[n->id].label.c_str(), n->rank);
+    }
+
+    ranksValid = true;
+}
+
+static int mostUsedStream(const std::map<int, int>& streamUsage)
+{
+    int best = -1, bestCount = 0;
+    for (auto& entry : streamUsage)
+        if (entry.second > bestCount)
+        {
+            best      = entry.first;
+            bestCount = entry.second;
+        }
+    return best;
+}
+
+std::string TaskScheduler::getProfilingReport() const
+{
+    if (profiledSteps == 0)
+        return "No profiling data available";
+
+    std::vector<const Node*> sorted;
+    for (auto& n : nodes)
+        if (profiles[n->id].nsamples > 0)
+            sorted.push_back(n.get());
+
+    std::sort(sorted.begin(), sorted.end(), [this] (const Node *a, const Node *b) {
+        return profiles[a->id].totalStart / profiles[a->id].nsamples <
+               profiles[b->id].totalStart / profiles[b->id].nsamples;
+    });
+
+    std::stringstream str;
+    str << "Profiled " << profiledSteps << " steps, average step time " << std::fixed << std::setprecision(4)
+        << totalStepTime / profiledSteps << " ms" << std::endl;
+    str << "All times are averages in ms; 'wait' is the time between the completion of all the dependencies and the start;" << std::endl;
+    str << "'critical' is the fraction of steps when the task was on the critical path" << std::endl;
+
+    str << std::setw(40) << std::left << "task" << std::right
+        << std::setw(10) << "start"
+        << std::setw(10) << "time"
+        << std::setw(10) << "min"
+        << std::setw(10) << "max"
+        << std::setw(10) << "wait"
+        << std::setw(8)  << "stream"
+        << std::setw(10) << "critical" << std::endl;
+
+    for (auto n : sorted)
+    {
+        const auto& prof = profiles[n->id];
+        const double ns = prof.nsamples;
+
+        str << std::setw(40) << std::left << tasks[n->id].label << std::right
+            << std::setw(10) << prof.totalStart / ns
+            << std::setw(10) << prof.totalTime  / ns
+            << std::setw(10) << prof.minTime
+            << std::setw(10) << prof.maxTime
+            << std::setw(10) << prof.totalWait  / ns
+            << std::setw(8)  << mostUsedStream(prof.streamUsage)
+            << std::setw(10) << prof.onCriticalPath / ns
+            << std::endl;
+    }
+
+    return str.str();
+}
+
+void TaskScheduler::saveProfilingReport(std::string fname) const
+{
+    auto filename = fname + ".txt";
+    std::ofstream fout(filename);
+
+    if (!fout.good())
+        die("Could not open file '%s' for writing", filename.c_str());
+
+    fout << getProfilingReport();
+}
+
+
+static std::string escapeJSON(const std::string& s)
+{
+    std::string res;
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\') res += '\\';
+        res += c;
+    }
+    return res;
+}
+
+void TaskScheduler::saveProfilingJSON(std::string fname) const
+{
+    auto filename = fname + ".json";
+    std::ofstream fout(filename);
+
+    if (!fout.good())
+        die("Could not open file '%s' for writing", filename.c_str());
+
+    const double stepTime = profiledSteps > 0 ? totalStepTime / profiledSteps : 0.0;
+
+    fout << "{" << std::endl
+         << "  \"steps\": " << profiledSteps << "," << std::endl
+         << "  \"step_time_ms\": " << stepTime << "," << std::endl
+         << "  \"tasks\": [";
+
+    bool first = true;
+    for (auto& n : nodes)
+    {
+        const auto& prof = profiles[n->id];
+        if (prof.nsamples == 0) continue;
+
+        const double ns = prof.nsamples;
+
+        fout << (first ? "" : ",") << std::endl
+             << "    { \"label\": \"" << escapeJSON(tasks[n->id].label) << "\""
+             << ", \"start_ms\": "  << prof.totalStart / ns
+             << ", \"time_ms\": "   << prof.totalTime  / ns
+             << ", \"min_ms\": "    << prof.minTime
+             << ", \"max_ms\": "    << prof.maxTime
+             << ", \"wait_ms\": "   << prof.totalWait  / ns
+             << ", \"stream\": "    << mostUsedStream(prof.streamUsage)
+             << ", \"critical\": "  << prof.onCriticalPath / ns
+             << " }";
+        first = false;
+    }
+
+    fout << std::endl << "  ]" << std::endl << "}" << std::endl;
+}
+
+template <typename T>
+static void add_data(pugi::xml_node& node, std::string key, T value)
+{
+    auto data = node.append_child("data");
+    data.append_attribute("key") = key.c_str();
+    data.text()                  = value;
+}
+
+static pugi::xml_node add_node(pugi::xml_node& graph, int id, std::string label)
 {
     auto node = graph.append_child("node");
     node.append_attribute("id") = std::to_string(id).c_str();
 
-    auto data = node.append_child("data");
-    data.append_attribute("key") = "label";
-    data.text()                  = label.c_str();
+    add_data(node, "label", label.c_str());
+    return node;
+}
+
+static void add_key(pugi::xml_node& root, std::string id, std::string type)
+{
+    auto key = root.append_child("key");
+    key.append_attribute("id")        = id.c_str();
+    key.append_attribute("for")       = "node";
+    key.append_attribute("attr.name") = id.c_str();
+    key.append_attribute("attr.type") = type.c_str();
 }
 
 static void add_edge(pugi::xml_node& graph, int sourceId, int targetId)
@@ -373,11 +999,18 @@ void TaskScheduler::saveDependencyGraph_GraphML(std::string fname) const
     root.append_attribute("xsi:schemaLocation") = "http://graphml.graphdrawing.org/xmlns "
                                                   "http://graphml.graphdrawing.org/xmlns/1.0/graphml.xsd";
 
-    auto key = root.append_child("key");
-    key.append_attribute("id")        = "label";
-    key.append_attribute("for")       = "node";
-    key.append_attribute("attr.name") = "label";
-    key.append_attribute("attr.type") = "string";
+    const bool withProfile = profiledSteps > 0;
+
+    add_key(root, "label", "string");
+
+    if (withProfile)
+    {
+        add_key(root, "start",    "double");
+        add_key(root, "time",     "double");
+        add_key(root, "wait",     "double");
+        add_key(root, "stream",   "int");
+        add_key(root, "critical", "double");
+    }
 
     auto graph = root.append_child("graph");
     graph.append_attribute("id")          = "Task graph";
@@ -385,7 +1018,21 @@ void TaskScheduler::saveDependencyGraph_GraphML(std::string fname) const
 
     // Nodes
     for (const auto& t : tasks)
-        add_node(graph, t.id, t.label);
+    {
+        auto node = add_node(graph, t.id, t.label);
+
+        if (withProfile && t.id < profiles.size() && profiles[t.id].nsamples > 0)
+        {
+            const auto& prof = profiles[t.id];
+            const double ns = prof.nsamples;
+
+            add_data(node, "start",    prof.totalStart / ns);
+            add_data(node, "time",     prof.totalTime  / ns);
+            add_data(node, "wait",     prof.totalWait  / ns);
+            add_data(node, "stream",   mostUsedStream(prof.streamUsage));
+            add_data(node, "critical", prof.onCriticalPath / ns);
+        }
+    }
 
     // Edges
     for (const auto& n : nodes) {
@@ -5,38 +5,148 @@
  *      Author: alexeedm
  */
 
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
 #include <string>
 #include <vector>
 #include <functional>
 #include <list>
+#include <map>
+#include <mutex>
 #include <queue>
+#include <thread>
 #include <unordered_map>
 #include <memory>
 
 #include <cuda_runtime.h>
 
+#include <core/utils/nvtx.h>
+
 class TaskScheduler
 {
 public:
     using TaskID = int;
     using Function = std::function<void(cudaStream_t)>;
+
+    /**
+     * Returns a key describing everything that is baked into a captured
+     * CUDA graph (device pointers, sizes, launch configurations, etc.)
+     * If the key changes, a new graph will be captured
+     */
+    using GraphKeyFunction = std::function<size_t()>;
     
     static const TaskID invalidTaskId = (TaskID) -1;
 
+    /**
+     * How to choose the next task among the ready ones:
+     * - Priority: high priority tasks first (see setHighPriority())
+     * - CriticalPath: tasks with the longest measured path to the
+     *   end of the step first; communication tasks go before all the others
+     */
+    enum class SchedulingPolicy
+    {
+        Priority, CriticalPath
+    };
+
     TaskScheduler();
+    ~TaskScheduler();
 
     TaskID createTask     (const std::string& label);
     TaskID getTaskId      (const std::string& label);
     TaskID getTaskIdOrDie (const std::string& label);
 
-    void addTask(TaskID id, Function task, int execEvery = 1);
+    /**
+     * Add a function to the task, executed every \p execEvery runs, at the runs
+     * where the number of previous runs modulo \p execEvery is \p execPhase.
+     * The tasks none of whose functions are due are skipped as a whole at that run,
+     * without taking a stream
+     */
+    void addTask(TaskID id, Function task, int execEvery = 1, int execPhase = 0);
     void addDependency(TaskID id, std::vector<TaskID> before, std::vector<TaskID> after);
     void setHighPriority(TaskID id);
 
+    /**
+     * Declare that all the functions of the task only enqueue work
+     * on the given stream: no host synchronization, no MPI,
+     * no host-side side effects and no per-step host parameters
+     * other than the ones reflected by the graph key.
+     * Only such tasks may be replayed from a CUDA graph
+     */
+    void setGraphCapturable(TaskID id);
+
+    /**
+     * Declare that the task starts communication (e.g. posts MPI requests),
+     * it will be started as early as possible with CriticalPath policy
+     */
+    void setCommunicationTask(TaskID id);
+
+    /**
+     * Declare that the functions of the task may block the host, e.g. wait for MPI requests
+     * or synchronize with the device. With host workers (see setHostWorkers()) the task
+     * runs on a helper thread, while the main thread keeps launching the other ready tasks
+     */
+    void setBlocking(TaskID id);
+
+    /**
+     * Run the blocking tasks on \p nThreads helper threads, 0 to run everything on the calling thread.
+     * The functions of the blocking tasks must then be safe to run concurrently with the other tasks,
+     * in particular with respect to MPI (MPI_THREAD_MULTIPLE)
+     */
+    void setHostWorkers(int nThreads);
+
+    /**
+     * Set the policy used to order the ready tasks.
+     * CriticalPath policy needs task timings: if there are none,
+     * the next \p profileSteps runs will be profiled first, and
+     * the Priority policy will be used meanwhile
+     */
+    void setSchedulingPolicy(SchedulingPolicy policy, int profileSteps = 50);
+
+    /**
+     * Replay capturable tasks from CUDA graphs instead of launching
+     * every kernel from the host. One graph is captured per distinct
+     * pattern of active functions (see \c execEvery of addTask())
+     * and per value of the \p key
+     */
+    void enableGraphCapture(GraphKeyFunction key);
+
     void compile();
     void run();
+
+    /**
+     * run() in three parts, for the callers interleaving several schedulers on one thread:
+     * start() makes the tasks without dependencies ready, every progress() launches the ready tasks
+     * and checks the running ones without waiting, it returns true once all of them completed.
+     * finish() waits for the remaining tasks and synchronizes the device
+     */
+    void start();
+    bool progress();
+    void finish();
+
     void saveDependencyGraph_GraphML(std::string fname) const;
 
+    /**
+     * Time every task with CUDA events during the next \p nsteps runs.
+     * Statistics are accumulated per task and are then available
+     * through getProfilingReport(), saveProfilingReport(), saveProfilingJSON() and
+     * saveDependencyGraph_GraphML() (as node attributes)
+     */
+    void startProfiling(int nsteps);
+    bool isProfiling() const;
+
+    std::string getProfilingReport() const;
+    void saveProfilingReport(std::string fname) const;
+
+    /// Same data as the report in \p fname.json, to be read by scripts
+    void saveProfilingJSON(std::string fname) const;
+
+    /// accumulated profiled time of the tasks of every NVTX::Category, in ms, indexed by the category
+    std::vector<double> getCategoryTimes() const;
+
     void forceExec(TaskID id, cudaStream_t stream);
 
 private:
@@ -46,11 +156,31 @@ private:
         std::string label;
         TaskID id;
         int priority;
+        bool capturable {false};
+        bool communication {false};
+        bool blocking {false};
+        NVTX::Category category {NVTX::Category::Other};
 
-        std::vector< std::pair<Function, int> > funcs;
+        struct ScheduledFunction
+        {
+            Function func;
+            int every, phase;
+        };
+        std::vector<ScheduledFunction> funcs;
         std::vector<TaskID> before, after;
     };
 
+    /// Accumulated timings of one task, all the times are in ms
+    struct TaskProfile
+    {
+        int nsamples {0};
+        double totalTime {0}, minTime {1e30}, maxTime {0};
+        double totalStart {0};   ///< start since the beginning of the step
+        double totalWait  {0};   ///< time between all dependencies completed and the start
+        int onCriticalPath {0};  ///< how many times the task was on the critical path
+        std::map<int, int> streamUsage;
+    };
+
     struct Node;
     struct Node
     {
@@ -60,11 +190,32 @@ private:
 
         int priority;
         std::queue<cudaStream_t>* streams;
+
+        // length of the longest path to the end of the step, in ms
+        double rank {0};
+
+        // pattern of active functions, graph key  -->  instantiated graph
+        std::map< std::pair<uint64_t, size_t>, cudaGraphExec_t > graphs;
+
+        // profiling of the current run, times are since the step beginning
+        cudaEvent_t evStart {nullptr}, evEnd {nullptr};
+        float tStart, tEnd;
+        int streamId;
+
+        // false while a host worker executes the task
+        std::atomic<bool> hostDone {true};
     };
 
     std::vector<Task> tasks;
     std::vector< std::unique_ptr<Node> > nodes;
 
+    // state of the current run, between start() and finish()
+    using ReadyQueue = std::priority_queue<Node*, std::vector<Node*>, std::function<bool(Node*, Node*)>>;
+    ReadyQueue readyNodes;
+    std::vector<std::pair<cudaStream_t, Node*>> runningNodes;
+    int nCompleted {0};
+    bool profilingRun {false};
+
     // Ordered sets of parallel work
     std::queue<cudaStream_t> streamsLo, streamsHi;
 
@@ -72,6 +223,21 @@ private:
 
     int nExecutions{0};
 
+    bool useGraphs {false};
+    GraphKeyFunction graphKey;
+
+    // drop all the graphs of a node if it accumulated that many
+    static const int maxGraphsPerNode = 16;
+
+    SchedulingPolicy policy {SchedulingPolicy::Priority};
+    bool ranksValid {false};
+
+    int profilingStepsLeft {0}, profiledSteps {0};
+    double totalStepTime {0};
+    cudaEvent_t evStepStart {nullptr};
+    std::vector<TaskProfile> profiles;
+    std::map<cudaStream_t, int> streamIds;
+
     std::unordered_map<std::string, TaskID> label2taskId;
 
     Node* getNode     (TaskID id);
@@ -81,4 +247,35 @@ private:
     void removeEmptyNodes();
     void logDepsGraph();
 
+    /// whether the function is due at the current run
+    bool isDue(const Task::ScheduledFunction& f) const;
+    /// whether any function of the task of \p node is due at the current run
+    bool hasDueFunctions(const Node *node) const;
+
+    // helper threads executing the blocking tasks
+    std::vector<std::thread> workers;
+    std::deque< std::pair<Node*, cudaStream_t> > workQueue;
+    std::mutex workMutex;
+    std::condition_variable workAvailable;
+    bool stopWorkers {false};
+
+    void stopHostWorkers();
+    void workerLoop(int device);
+
+    /// start the task of \p node on a host worker, see setHostWorkers()
+    void submitToWorker(Node *node, cudaStream_t stream);
+
+    void resolve(Node *node);
+    void pollRunningNodes();
+    void launchReadyNodes();
+
+    void execNode(Node *node, cudaStream_t stream);
+    void execNodeGraph(Node *node, cudaStream_t stream);
+    void destroyGraphs(Node *node);
+
+    void createEvents();
+    void destroyEvents();
+    void collectProfile();
+    void computeRanks();
+
 };
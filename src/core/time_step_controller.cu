@@ -0,0 +1,120 @@
+#include "time_step_controller.h"
+
+#include <core/logger.h>
+#include <core/pvs/particle_vector.h>
+#include <core/pvs/views/pv.h>
+#include <core/utils/cuda_common.h>
+#include <core/utils/kernel_launch.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace TimeStepControllerKernels
+{
+
+/// the squares are not negative, their int representations compare as the floats
+__global__ void maxima(PVview view, int *maxima)
+{
+    const int pid = blockIdx.x * blockDim.x + threadIdx.x;
+
+    float u2 = 0.0f, a2 = 0.0f;
+    if (pid < view.size)
+    {
+        const float3 u = make_float3(view.particles[2*pid + 1]);
+        const float3 a = make_float3(view.forces[pid]) * view.invMass;
+        u2 = dot(u, u);
+        a2 = dot(a, a);
+    }
+
+    u2 = warpReduce(u2, [] (float a, float b) { return fmaxf(a, b); });
+    a2 = warpReduce(a2, [] (float a, float b) { return fmaxf(a, b); });
+
+    if (__laneid() == 0)
+    {
+        atomicMax(maxima + 0, __float_as_int(u2));
+        atomicMax(maxima + 1, __float_as_int(a2));
+    }
+}
+
+} // namespace TimeStepControllerKernels
+
+TimeStepController::TimeStepController(float dtMin, float dtMax, float maxDisplacement, float maxGrowth) :
+    dtMin(dtMin), dtMax(dtMax), maxDisplacement(maxDisplacement), maxGrowth(maxGrowth)
+{
+    if (dtMin <= 0.0f || dtMax < dtMin)
+        die("Adaptive time step needs 0 < dt_min <= dt_max, got %g and %g", dtMin, dtMax);
+
+    if (maxDisplacement <= 0.0f)
+        die("Adaptive time step needs a positive maximum displacement, got %g", maxDisplacement);
+
+    if (maxGrowth < 1.0f)
+        die("Adaptive time step growth factor must be at least 1, got %g", maxGrowth);
+
+    CUDA_Check( cudaHostAlloc(&hostMaxima, 2 * sizeof(int), cudaHostAllocMapped) );
+    CUDA_Check( cudaHostGetDevicePointer(&devMaxima, hostMaxima, 0) );
+    hostMaxima[0] = hostMaxima[1] = 0;
+}
+
+TimeStepController::~TimeStepController()
+{
+    if (request != MPI_REQUEST_NULL)
+        MPI_Check( MPI_Wait(&request, MPI_STATUS_IGNORE) );
+
+    CUDA_Check( cudaFreeHost(hostMaxima) );
+}
+
+void TimeStepController::clear(cudaStream_t stream)
+{
+    CUDA_Check( cudaMemsetAsync(devMaxima, 0, 2 * sizeof(int), stream) );
+}
+
+void TimeStepController::sample(ParticleVector *pv, cudaStream_t stream)
+{
+    PVview view(pv, pv->local());
+    if (view.size == 0) return;
+
+    const int nthreads = 128;
+    SAFE_KERNEL_LAUNCH(
+            TimeStepControllerKernels::maxima,
+            getNblocks(view.size, nthreads), nthreads, 0, stream,
+            view, devMaxima );
+}
+
+void TimeStepController::startReduction(MPI_Comm comm)
+{
+    const volatile int *maxima = hostMaxima;
+    float local[2];
+    for (int i = 0; i < 2; i++)
+    {
+        const int bits = maxima[i];
+        local[i] = *reinterpret_cast<const float*>(&bits);
+    }
+
+    MPI_Check( MPI_Iallreduce(local, globalMaxima, 2, MPI_FLOAT, MPI_MAX, comm, &request) );
+}
+
+float TimeStepController::nextTimeStep(float dt)
+{
+    MPI_Check( MPI_Wait(&request, MPI_STATUS_IGNORE) );
+
+    const float umax = std::sqrt(globalMaxima[0]);
+    const float amax = std::sqrt(globalMaxima[1]);
+
+    if (!std::isfinite(umax) || !std::isfinite(amax))
+        die("Adaptive time step: non-finite velocities or forces, max |u| = %g, max |a| = %g", umax, amax);
+
+    float next = dtMax;
+    if (umax > 0.0f) next = std::min(next, maxDisplacement / umax);
+    if (amax > 0.0f) next = std::min(next, std::sqrt(2.0f * maxDisplacement / amax));
+
+    next = std::min(next, dt * maxGrowth);
+
+    if (next < dtMin)
+    {
+        warn("Adaptive time step: dt = %g would be needed for max |u| = %g and max |a| = %g, using dt_min = %g",
+             next, umax, amax, dtMin);
+        next = dtMin;
+    }
+
+    return next;
+}
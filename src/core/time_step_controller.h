@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cuda_runtime.h>
+#include <mpi.h>
+
+class ParticleVector;
+
+/**
+ * Adaptive time step from the largest velocity and acceleration of all the particles.
+ *
+ * After the integration, sample() reduces the maxima of the local particles into mapped pinned memory.
+ * Once the step is complete, startReduction() starts a non-blocking allreduce of the maxima over the ranks
+ * and nextTimeStep() completes it: the new dt is such that no particle moves further than maxDisplacement
+ * in one step, neither by its velocity nor by its acceleration, within [dtMin, dtMax];
+ * dt grows by at most the factor maxGrowth per step and decreases without limit
+ */
+class TimeStepController
+{
+public:
+    TimeStepController(float dtMin, float dtMax, float maxDisplacement, float maxGrowth);
+    ~TimeStepController();
+
+    /// clear the maxima of the previous step
+    void clear(cudaStream_t stream);
+
+    /// accumulate the velocities and accelerations of the local particles of \p pv
+    void sample(ParticleVector *pv, cudaStream_t stream);
+
+    /// the samples must be complete
+    void startReduction(MPI_Comm comm);
+
+    /// @return the time step following \p dt
+    float nextTimeStep(float dt);
+
+private:
+    float dtMin, dtMax, maxDisplacement, maxGrowth;
+
+    /// squared maximum velocity and acceleration, stored as int to be compared with atomicMax
+    int *hostMaxima {nullptr}, *devMaxima {nullptr};
+
+    float globalMaxima[2];
+    MPI_Request request {MPI_REQUEST_NULL};
+};
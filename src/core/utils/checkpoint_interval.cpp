@@ -0,0 +1,100 @@
+#include "checkpoint_interval.h"
+
+#include <core/logger.h>
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+CheckpointInterval::CheckpointInterval(double mtbf, double wallTimeLimit) :
+    mtbf(mtbf),
+    wallTimeLimit(wallTimeLimit),
+    startTime(MPI_Wtime()),
+    nextCheckpoint(INT_MAX),
+    nextPlan(INT_MIN)
+{
+    if (mtbf < 0 || wallTimeLimit < 0)
+        die("The mean time between failures and the wall-time limit must be non-negative, got %g and %g",
+            mtbf, wallTimeLimit);
+
+    if (mtbf == 0 && wallTimeLimit == 0)
+        die("Adaptive checkpoints need a mean time between failures or a wall-time limit");
+}
+
+void CheckpointInterval::update(MPI_Comm comm, int step)
+{
+    if (firstStep < 0)
+    {
+        firstStep = lastPlanStep = step;
+        lastPlanTime = MPI_Wtime();
+        nextPlan = step;
+    }
+
+    if (step >= nextPlan)
+        plan(comm, step);
+}
+
+void CheckpointInterval::checkpointed(MPI_Comm comm, int step, double cost)
+{
+    checkpointCost = cost;
+    checkpointTimeSincePlan += cost;
+    costKnown = true;
+    lastCheckpoint = step;
+
+    if (forDeadline)
+        deadlineDone = true;
+
+    plan(comm, step);
+
+    info("Checkpoint of step %d took %g s, the next one is at step %d%s",
+         step, cost, nextCheckpoint, forDeadline ? ", before the wall-time limit" : "");
+}
+
+void CheckpointInterval::plan(MPI_Comm comm, int step)
+{
+    const double now = MPI_Wtime();
+
+    if (step > lastPlanStep)
+        stepTime = (now - lastPlanTime - checkpointTimeSincePlan) / (step - lastPlanStep);
+
+    lastPlanStep = step;
+    lastPlanTime = now;
+    checkpointTimeSincePlan = 0;
+
+    // the slowest rank, and the latest clock for the deadline
+    double local[3] = {stepTime, checkpointCost, now - startTime};
+    double global[3];
+    MPI_Check( MPI_Allreduce(local, global, 3, MPI_DOUBLE, MPI_MAX, comm) );
+
+    const double dt = global[0], cost = global[1], elapsed = global[2];
+    const int origin = lastCheckpoint >= 0 ? lastCheckpoint : firstStep;
+
+    long long interval = INT_MAX;
+    if (!costKnown)
+        interval = warmupSteps;
+    else if (mtbf > 0 && dt > 0)
+    {
+        const double tau = cost < 2 * mtbf ? std::sqrt(2 * cost * mtbf) - cost : mtbf;
+        interval = std::max(1LL, (long long) std::llround(tau / dt));
+    }
+
+    nextCheckpoint = (int) std::min(origin + interval, (long long) INT_MAX);
+    forDeadline = false;
+
+    if (wallTimeLimit > 0 && !deadlineDone && dt > 0)
+    {
+        const double left = wallTimeLimit - elapsed - 2 * cost;
+        const long long lastSafeStep = step + (long long) std::floor(left / dt) - 1;
+
+        if (lastSafeStep < nextCheckpoint)
+        {
+            nextCheckpoint = (int) std::max((long long) step + 1, lastSafeStep);
+            forDeadline = true;
+        }
+    }
+
+    nextPlan = (int) std::min((long long) step + replanEvery, (long long) INT_MAX);
+
+    debug("Next checkpoint at step %d%s: checkpoint cost %g s, %g s per step",
+          nextCheckpoint, forDeadline ? ", before the wall-time limit" : "", cost, dt);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <mpi.h>
+
+/**
+ * Chooses the steps of the checkpoints from the measured cost of the checkpoints and of the time-steps.
+ *
+ * For a mean time between failures M and a checkpoint cost C, the interval is Daly's first order optimum
+ * sqrt(2 C M) - C, i.e. Young's sqrt(2 C M) when C is small, and M when C exceeds 2 M; it is converted
+ * into steps with the mean step time. Until the first checkpoint has been timed, it is written after
+ * warmupSteps steps. With a wall-time limit, a checkpoint is also scheduled such that it completes
+ * before the deadline, with a margin of one more checkpoint cost.
+ *
+ * The slowest rank counts: the costs are reduced over all the ranks by plan(), collective, only called
+ * at the checkpoints and every replanEvery steps such that the ranks agree on the steps without
+ * communicating at every step
+ */
+class CheckpointInterval
+{
+public:
+    /**
+     * @param mtbf mean time between failures in seconds, none if 0
+     * @param wallTimeLimit seconds from now after which the job is killed, none if 0
+     */
+    CheckpointInterval(double mtbf, double wallTimeLimit);
+
+    /// whether the checkpoint is to be written at \p step
+    bool due(int step) const { return step >= nextCheckpoint; }
+
+    /// plan again if it is time to, collective over \p comm
+    void update(MPI_Comm comm, int step);
+
+    /// the checkpoint of \p step took \p cost seconds on this rank, plan the next one. Collective
+    void checkpointed(MPI_Comm comm, int step, double cost);
+
+    static const int warmupSteps  = 100;
+    static const int replanEvery  = 1000;
+
+private:
+    double mtbf, wallTimeLimit;
+    double startTime;
+
+    int firstStep {-1};
+    int lastCheckpoint {-1};
+    int nextCheckpoint, nextPlan;
+
+    double checkpointCost {0};   ///< of the last checkpoint on this rank
+    bool costKnown {false};
+    bool forDeadline {false};    ///< the next checkpoint is the one before the deadline
+    bool deadlineDone {false};
+
+    int lastPlanStep {0};
+    double lastPlanTime {0}, checkpointTimeSincePlan {0};
+    double stepTime {0};         ///< on this rank, without the checkpoints
+
+    void plan(MPI_Comm comm, int step);
+};
@@ -0,0 +1,87 @@
+#include "clear_batch.h"
+
+#include <core/containers.h>
+#include <core/logger.h>
+#include <core/utils/cuda_common.h>
+#include <core/utils/kernel_launch.h>
+
+#include <algorithm>
+#include <cstdint>
+
+namespace ClearBatchKernels
+{
+
+struct Table
+{
+    char   *ptrs [ClearBatch::maxBuffers];
+    size_t bytes[ClearBatch::maxBuffers];
+};
+
+/**
+ * One row of blocks per buffer (blockIdx.y): the aligned part is zeroed by 16 byte words
+ * in a grid-stride loop, the unaligned head and tail bytes by the first block
+ */
+__global__ void clearBuffers(Table table)
+{
+    char *ptr = table.ptrs[blockIdx.y];
+    const size_t bytes = table.bytes[blockIdx.y];
+
+    const size_t head   = min(bytes, (sizeof(int4) - ((uintptr_t) ptr) % sizeof(int4)) % sizeof(int4));
+    const size_t nwords = (bytes - head) / sizeof(int4);
+    const size_t tail   = head + nwords * sizeof(int4);
+
+    int4 *words = (int4*) (ptr + head);
+
+    for (size_t i = blockIdx.x * blockDim.x + threadIdx.x; i < nwords; i += gridDim.x * blockDim.x)
+        words[i] = make_int4(0, 0, 0, 0);
+
+    if (blockIdx.x != 0) return;
+
+    if (threadIdx.x < head)          ptr[threadIdx.x] = 0;
+    if (tail + threadIdx.x < bytes)  ptr[tail + threadIdx.x] = 0;
+}
+
+} // namespace ClearBatchKernels
+
+void ClearBatch::add(GPUcontainer *container)
+{
+    add(container->genericDevPtr(), (size_t) container->size() * container->datatype_size());
+}
+
+void ClearBatch::add(void *devPtr, size_t bytes)
+{
+    if (bytes == 0) return;
+    entries.push_back({devPtr, bytes});
+}
+
+void ClearBatch::run(cudaStream_t stream)
+{
+    const int nthreads = 128;
+    const int maxBlocks = 256;
+
+    for (int first = 0; first < entries.size(); first += maxBuffers)
+    {
+        const int n = std::min((int) entries.size() - first, maxBuffers);
+
+        ClearBatchKernels::Table table;
+        size_t maxWords = 0;
+
+        for (int i = 0; i < n; i++)
+        {
+            table.ptrs [i] = (char*) entries[first + i].ptr;
+            table.bytes[i] = entries[first + i].bytes;
+            maxWords = std::max(maxWords, table.bytes[i] / sizeof(int4));
+        }
+
+        const int nblocks = std::min((size_t) maxBlocks, std::max((size_t) 1, (maxWords + nthreads - 1) / nthreads));
+
+        debug4("Clearing %d buffers in one launch", n);
+
+        SAFE_KERNEL_LAUNCH(
+                ClearBatchKernels::clearBuffers,
+                dim3(nblocks, n), nthreads, 0, stream,
+                table );
+    }
+
+    entries.clear();
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cuda_runtime.h>
+#include <cstddef>
+#include <vector>
+
+class GPUcontainer;
+
+/**
+ * Zeroes several device buffers with a single kernel launch instead of one memset each,
+ * e.g. all the channels cleared by a task of the step.
+ *
+ * The buffers are add()ed, then cleared together by run(): the table of the buffers is passed
+ * by value as the kernel argument, by chunks of maxBuffers per launch, so nothing is uploaded
+ * and the launch may be captured in a graph as the memsets were
+ */
+class ClearBatch
+{
+public:
+    static const int maxBuffers = 32;
+
+    void add(GPUcontainer *container);
+    void add(void *devPtr, size_t bytes);
+
+    /// clear all the added buffers on \p stream and forget them
+    void run(cudaStream_t stream);
+
+    bool empty() const { return entries.empty(); }
+
+private:
+    struct Entry
+    {
+        void *ptr;
+        size_t bytes;
+    };
+
+    std::vector<Entry> entries;
+};
@@ -5,11 +5,16 @@
 namespace ChannelNames
 {
 
+// coordinates and velocities of the particles, to declare the channel accesses of the plugins
+static const std::string positions   = "positions";
+static const std::string velocities  = "velocities";
+
 // per particle fields
 static const std::string forces      = "forces";
 static const std::string stresses    = "stresses";
 static const std::string densities   = "densities";
 static const std::string oldParts    = "old_particles";
+static const std::string species     = "species";
 
 // per object fields
 static const std::string motions     = "motions";
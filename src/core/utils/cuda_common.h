@@ -45,6 +45,17 @@ __host__ __device__ inline  T sqr(T val)
     return val*val;
 }
 
+/// load through the read-only data cache, \p ptr must not be written during the kernel
+template<typename T>
+__host__ __device__ inline  T readOnly(const T *ptr)
+{
+#if defined(__CUDA_ARCH__) && __CUDA_ARCH__ >= 350
+    return __ldg(ptr);
+#else
+    return *ptr;
+#endif
+}
+
 #ifdef __CUDACC__
 
 //=======================================================================================
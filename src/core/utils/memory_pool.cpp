@@ -0,0 +1,325 @@
+#include "memory_pool.h"
+
+#include "perf_counters.h"
+
+#include <core/logger.h>
+
+#include <algorithm>
+#include <cuda_runtime.h>
+
+MemoryPool& MemoryPool::device()
+{
+    // never destroyed: containers with static storage may outlive it
+    static MemoryPool *pool = new MemoryPool(Kind::Device);
+    return *pool;
+}
+
+MemoryPool& MemoryPool::host()
+{
+    static MemoryPool *pool = new MemoryPool(Kind::Host);
+    return *pool;
+}
+
+void MemoryPool::onDeviceSynchronized()
+{
+    device().barrier();
+    host()  .barrier();
+}
+
+MemoryPool::MemoryPool(Kind kind) :
+    kind(kind)
+{}
+
+void* MemoryPool::allocate(size_t bytes, const std::string& owner)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    void *ptr = nullptr;
+    const size_t requested = bytes;
+
+    // smallest cached block that fits, unless it wastes more than the request itself
+    auto it = freeBlocks.lower_bound(bytes);
+    if (caching && it != freeBlocks.end() && it->first <= 2 * bytes)
+    {
+        bytes = it->first;
+        ptr   = it->second;
+        freeBlocks.erase(it);
+    }
+    else
+    {
+        ptr = cudaAllocate(bytes);
+        PerfCounters::add(kind == Kind::Device ? "allocations from CUDA: device" : "allocations from CUDA: host");
+    }
+
+    // every growth of a container goes through here
+    PerfCounters::add(kind == Kind::Device ? "buffer reallocations: device" : "buffer reallocations: host");
+
+    allocations[ptr] = {bytes, requested, 0, owner, managed};
+
+    auto& u = usage[owner];
+    u.inUse     += bytes;
+    u.requested += requested;
+    u.peak = std::max(u.peak, u.inUse);
+
+    totalInUse += bytes;
+    totalPeak = std::max(totalPeak, totalInUse);
+
+    return ptr;
+}
+
+void MemoryPool::deallocate(void *ptr)
+{
+    if (ptr == nullptr) return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = allocations.find(ptr);
+    if (it == allocations.end())
+        die("Trying to release a pointer %p that was not allocated by the memory pool", ptr);
+
+    const size_t bytes = it->second.bytes;
+    auto& u = usage[it->second.owner];
+    u.inUse     -= bytes;
+    u.requested -= it->second.requested;
+    u.used      -= it->second.used;
+    totalInUse  -= bytes;
+    allocations.erase(it);
+
+    if (caching)
+        pending.push_back({bytes, ptr});
+    else
+        cudaRelease(ptr);
+}
+
+void MemoryPool::setUsed(void *ptr, size_t bytes)
+{
+    if (ptr == nullptr) return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = allocations.find(ptr);
+    if (it == allocations.end()) return;
+
+    auto& a = it->second;
+    auto& u = usage[a.owner];
+    u.used = u.used - a.used + bytes;
+    a.used = bytes;
+}
+
+void MemoryPool::setOwner(void *ptr, const std::string& owner)
+{
+    if (ptr == nullptr) return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = allocations.find(ptr);
+    if (it == allocations.end() || it->second.owner == owner) return;
+
+    auto& a = it->second;
+
+    auto& uold = usage[a.owner];
+    uold.inUse     -= a.bytes;
+    uold.requested -= a.requested;
+    uold.used      -= a.used;
+
+    auto& unew = usage[owner];
+    unew.inUse     += a.bytes;
+    unew.requested += a.requested;
+    unew.used      += a.used;
+    unew.peak = std::max(unew.peak, unew.inUse);
+
+    a.owner = owner;
+}
+
+void MemoryPool::setCaching(bool enabled)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (!enabled)
+        releaseCachedUnlocked();
+
+    caching = enabled;
+}
+
+bool MemoryPool::isCaching() const
+{
+    return caching;
+}
+
+void MemoryPool::setManaged(bool enabled)
+{
+    if (kind != Kind::Device)
+        die("Only the device memory pool can allocate managed memory");
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (enabled == managed) return;
+
+    if (enabled)
+    {
+        int device, concurrent;
+        CUDA_Check( cudaGetDevice(&device) );
+        CUDA_Check( cudaDeviceGetAttribute(&concurrent, cudaDevAttrConcurrentManagedAccess, device) );
+        if (!concurrent)
+            warn("The device does not support concurrent managed access, "
+                 "managed memory will not be able to exceed the GPU memory");
+    }
+
+    // cached blocks would be of the wrong kind
+    releaseCachedUnlocked();
+    managed = enabled;
+}
+
+bool MemoryPool::isManaged() const
+{
+    return managed;
+}
+
+void MemoryPool::prefetchToDevice(cudaStream_t stream)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    int device;
+    CUDA_Check( cudaGetDevice(&device) );
+
+    for (auto& entry : allocations)
+        if (entry.second.managed)
+            CUDA_Check( cudaMemPrefetchAsync(entry.first, entry.second.bytes, device, stream) );
+}
+
+size_t MemoryPool::getManagedBytes() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    size_t total = 0;
+    for (auto& entry : allocations)
+        if (entry.second.managed)
+            total += entry.second.bytes;
+    return total;
+}
+
+void MemoryPool::releaseCached()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    releaseCachedUnlocked();
+}
+
+std::map<std::string, MemoryPool::Usage> MemoryPool::getUsage() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return usage;
+}
+
+size_t MemoryPool::getCachedBytes() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    size_t total = 0;
+    for (auto& block : freeBlocks) total += block.first;
+    for (auto& block : pending)    total += block.first;
+    return total;
+}
+
+MemoryPool::Usage MemoryPool::getTotalUsage() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    Usage total;
+    for (auto& entry : usage)
+    {
+        total.requested += entry.second.requested;
+        total.used      += entry.second.used;
+    }
+    total.inUse = totalInUse;
+    total.peak  = totalPeak;
+    return total;
+}
+
+void MemoryPool::logUsage() const
+{
+    const char *kindStr = kind == Kind::Device ? "Device" : "Host";
+    const double MB = 1024.0 * 1024.0;
+
+    // slack: capacity over the size of the containers, and block over the capacity
+    auto report = [&](const std::string& owner, const Usage& u) {
+        info("%s memory of '%s': %.2f MB in use (%.2f MB at most), slack: %.2f MB by containers growth, %.2f MB by reused blocks",
+             kindStr, owner.c_str(), u.inUse / MB, u.peak / MB,
+             (u.requested - u.used) / MB, (u.inUse - u.requested) / MB);
+    };
+
+    for (auto& entry : getUsage())
+        if (entry.second.peak > 0)
+            report(entry.first, entry.second);
+
+    auto total = getTotalUsage();
+    info("%s memory in total: %.2f MB in use (%.2f MB at most), %.2f MB holding data, %.2f MB cached for reuse",
+         kindStr, total.inUse / MB, total.peak / MB, total.used / MB, getCachedBytes() / MB);
+}
+
+void MemoryPool::barrier()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (auto& block : pending)
+        freeBlocks.insert(block);
+    pending.clear();
+}
+
+void* MemoryPool::cudaAllocate(size_t bytes)
+{
+    void *ptr = nullptr;
+
+    auto tryAllocate = [&]() {
+        if (kind == Kind::Host)
+            return cudaHostAlloc(&ptr, bytes, 0);
+
+        return managed ?
+            cudaMallocManaged(&ptr, bytes) :
+            cudaMalloc(&ptr, bytes);
+    };
+
+    auto status = tryAllocate();
+
+    // cached blocks may be just what we miss
+    if (status == cudaErrorMemoryAllocation && (!freeBlocks.empty() || !pending.empty()))
+    {
+        cudaGetLastError();
+        debug("Out of memory allocating %zu bytes, releasing the cached blocks", bytes);
+
+        releaseCachedUnlocked();
+        status = tryAllocate();
+    }
+
+    CUDA_Check( status );
+
+    // pages stay on the GPU unless it runs out of memory
+    if (kind == Kind::Device && managed)
+    {
+        int device;
+        CUDA_Check( cudaGetDevice(&device) );
+        CUDA_Check( cudaMemAdvise(ptr, bytes, cudaMemAdviseSetPreferredLocation, device) );
+    }
+
+    return ptr;
+}
+
+void MemoryPool::cudaRelease(void *ptr)
+{
+    if (kind == Kind::Device)
+        CUDA_Check( cudaFree(ptr) );
+    else
+        CUDA_Check( cudaFreeHost(ptr) );
+}
+
+void MemoryPool::releaseCachedUnlocked()
+{
+    // pending blocks may still be in use
+    if (!pending.empty())
+        CUDA_Check( cudaDeviceSynchronize() );
+
+    for (auto& block : pending)    cudaRelease(block.second);
+    for (auto& block : freeBlocks) cudaRelease(block.second);
+
+    pending.clear();
+    freeBlocks.clear();
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cuda_runtime.h>
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Caching allocator of device or pinned host memory used by the containers.
+ *
+ * Released blocks are not returned to CUDA (cudaFree and cudaFreeHost
+ * synchronize the whole device), but kept for the later allocations.
+ * As the memory may still be used by the kernels or copies in flight,
+ * a released block only becomes available after the next call to
+ * onDeviceSynchronized(), i.e. when all the GPU work is known to be completed.
+ *
+ * Memory in use is accounted per owner, given by the containers.
+ * Besides the size of the blocks, the pool keeps what the containers
+ * requested (their capacity) and how much of it holds data (their size),
+ * to tell how much memory is lost to the growth policy of the containers.
+ *
+ * The device pool may also hand out managed memory (see setManaged()),
+ * such that the working set can exceed the GPU memory at the cost of page migrations.
+ */
+class MemoryPool
+{
+public:
+    enum class Kind { Device, Host };
+
+    struct Usage
+    {
+        size_t inUse{0};      ///< bytes of the blocks currently held by the owner
+        size_t peak{0};       ///< largest value of inUse since the start
+        size_t requested{0};  ///< bytes requested for these blocks, i.e. capacity of the containers
+        size_t used{0};       ///< bytes actually holding data, i.e. size of the containers
+    };
+
+    static MemoryPool& device();
+    static MemoryPool& host();
+
+    /// notify all the pools that the device is idle, so that released blocks are reusable
+    static void onDeviceSynchronized();
+
+    void* allocate(size_t bytes, const std::string& owner);
+    void  deallocate(void *ptr);
+
+    /// account \p bytes of the allocation \p ptr as holding data
+    void setUsed(void *ptr, size_t bytes);
+
+    /// move the accounting of the allocation \p ptr to another owner
+    void setOwner(void *ptr, const std::string& owner);
+
+    /// if disabled, every allocation and release goes to CUDA directly
+    void setCaching(bool enabled);
+    bool isCaching() const;
+
+    /**
+     * Allocate the new blocks with cudaMallocManaged, preferably located on the device.
+     * Only for the device pool; releases the cached blocks, synchronizes the device
+     */
+    void setManaged(bool enabled);
+    bool isManaged() const;
+
+    /// migrate all the managed blocks in use to the device, asynchronously on \p stream
+    void prefetchToDevice(cudaStream_t stream);
+
+    /// total size of the managed blocks in use
+    size_t getManagedBytes() const;
+
+    /// return all the unused cached blocks to CUDA, synchronizes the device
+    void releaseCached();
+
+    std::map<std::string, Usage> getUsage() const;
+    size_t getCachedBytes() const;
+
+    /// usage summed over all the owners; the peak is the one of the sum
+    Usage getTotalUsage() const;
+
+    /// print the usage per owner and the amount of cached memory
+    void logUsage() const;
+
+private:
+    MemoryPool(Kind kind);
+
+    Kind kind;
+    bool caching{true};
+    bool managed{false};
+
+    struct Allocation
+    {
+        size_t bytes, requested, used;
+        std::string owner;
+        bool managed; ///< the cache only holds blocks of the current mode, see setManaged()
+    };
+
+    std::unordered_map<void*, Allocation> allocations;
+    std::multimap<size_t, void*> freeBlocks;      ///< reusable blocks by size
+    std::vector<std::pair<size_t, void*>> pending; ///< released, may still be used by the GPU
+    std::map<std::string, Usage> usage;
+    size_t totalInUse{0}, totalPeak{0};
+
+    mutable std::mutex mutex;
+
+    void  barrier();
+    void* cudaAllocate(size_t bytes);
+    void  cudaRelease(void *ptr);
+    void  releaseCachedUnlocked();
+};
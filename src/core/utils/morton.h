@@ -0,0 +1,36 @@
+#pragma once
+
+#include <core/utils/cpu_gpu_defines.h>
+#include <core/utils/helper_math.h>
+
+/**
+ * 30 bits Morton codes of points, 10 bits per dimension
+ */
+namespace Morton
+{
+
+/// spread the 10 lower bits of v such that there are 2 zeros between them
+__D__ inline unsigned int expandBits(unsigned int v)
+{
+    v = (v * 0x00010001u) & 0xFF0000FFu;
+    v = (v * 0x00000101u) & 0x0F00F00Fu;
+    v = (v * 0x00000011u) & 0xC30C30C3u;
+    v = (v * 0x00000005u) & 0x49249249u;
+    return v;
+}
+
+__D__ inline unsigned int quantize(float x)
+{
+    return (unsigned int) fminf( fmaxf(x * 1024.0f, 0.0f), 1023.0f );
+}
+
+/// code of the point \p c given in [0, 1]^3, clamped to it
+__D__ inline unsigned int code(float3 c)
+{
+    return expandBits(quantize(c.x)) * 4 + expandBits(quantize(c.y)) * 2 + expandBits(quantize(c.z));
+}
+
+/// number of significant bits of the codes, for the radix sorts
+const int nbits = 30;
+
+} // namespace Morton
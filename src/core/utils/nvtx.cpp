@@ -0,0 +1,74 @@
+#include "nvtx.h"
+
+#include <nvtx3/nvToolsExt.h>
+
+#include <algorithm>
+#include <cctype>
+
+namespace NVTX
+{
+
+static bool enabled = false;
+
+void setEnabled(bool enabled)
+{
+    NVTX::enabled = enabled;
+}
+
+bool isEnabled()
+{
+    return enabled;
+}
+
+static uint32_t getColor(Category category)
+{
+    switch (category)
+    {
+        case Category::Force:     return 0xFF4CAF50;
+        case Category::Halo:      return 0xFF2196F3;
+        case Category::Bounce:    return 0xFFFF9800;
+        case Category::Plugin:    return 0xFF9C27B0;
+        case Category::Integrate: return 0xFFF44336;
+        default:                  return 0xFF9E9E9E;
+    }
+}
+
+Category categorize(const std::string& label)
+{
+    std::string lower = label;
+    std::transform(lower.begin(), lower.end(), lower.begin(), [] (unsigned char c) { return std::tolower(c); });
+
+    auto contains = [&lower] (const char *word) {
+        return lower.find(word) != std::string::npos;
+    };
+
+    // the exchanges are split into init and finalize tasks; "Halo forces" are forces, not communication
+    if (contains("plugin"))                                                      return Category::Plugin;
+    if (contains("bounce") || contains("belonging") || contains("wall check"))   return Category::Bounce;
+    if (contains("integrat"))                                                    return Category::Integrate;
+    if (contains("init") || contains("finalize") || contains("redistribut"))     return Category::Halo;
+    if (contains("force") || contains("intermediate") || contains("cell"))     return Category::Force;
+
+    return Category::Other;
+}
+
+void Range::push(const char *name, Category category)
+{
+    nvtxEventAttributes_t attributes = {0};
+    attributes.version       = NVTX_VERSION;
+    attributes.size          = NVTX_EVENT_ATTRIB_STRUCT_SIZE;
+    attributes.colorType     = NVTX_COLOR_ARGB;
+    attributes.color         = getColor(category);
+    attributes.messageType   = NVTX_MESSAGE_TYPE_ASCII;
+    attributes.message.ascii = name;
+
+    nvtxRangePushEx(&attributes);
+    pushed = true;
+}
+
+void Range::pop()
+{
+    nvtxRangePop();
+}
+
+} // namespace NVTX
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+
+/**
+ * Named ranges on the timeline of Nsight Systems.
+ *
+ * The ranges are only pushed when enabled with setEnabled(), otherwise
+ * a Range costs a branch. The color of a range tells the kind of work
+ */
+namespace NVTX
+{
+
+enum class Category
+{
+    Force, Halo, Bounce, Plugin, Integrate, Other
+};
+
+void setEnabled(bool enabled);
+bool isEnabled();
+
+/// guess the category of a scheduler task out of its label
+Category categorize(const std::string& label);
+
+/// scoped range, pushed by the constructor and popped by the destructor
+class Range
+{
+public:
+    Range(const char *name, Category category)
+    {
+        if (isEnabled()) push(name, category);
+    }
+
+    Range(const std::string& name, Category category) :
+        Range(name.c_str(), category)
+    {}
+
+    ~Range()
+    {
+        if (pushed) pop();
+    }
+
+    Range(const Range&) = delete;
+    Range& operator=(const Range&) = delete;
+
+private:
+    bool pushed {false};
+
+    void push(const char *name, Category category);
+    void pop();
+};
+
+} // namespace NVTX
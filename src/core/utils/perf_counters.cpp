@@ -0,0 +1,43 @@
+#include "perf_counters.h"
+
+#include <mutex>
+
+namespace PerfCounters
+{
+
+static bool enabled = false;
+static std::mutex mutex;
+static std::map<std::string, long long> counters;
+
+void setEnabled(bool enabled)
+{
+    PerfCounters::enabled = enabled;
+}
+
+bool isEnabled()
+{
+    return enabled;
+}
+
+void add(const std::string& name, long long value)
+{
+    if (!enabled) return;
+
+    // the checkpoints and the pools may allocate from other threads
+    std::lock_guard<std::mutex> lock(mutex);
+    counters[name] += value;
+}
+
+std::map<std::string, long long> get()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+void reset()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    counters.clear();
+}
+
+} // namespace PerfCounters
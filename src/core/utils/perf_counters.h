@@ -0,0 +1,27 @@
+#pragma once
+
+#include <map>
+#include <string>
+
+/**
+ * Process-wide named event counters, e.g. how many cell-lists were rebuilt
+ * or how many bytes were sent by an exchanger.
+ *
+ * The counters are accumulated over the steps until reset(), and only
+ * when enabled: otherwise add() costs a branch.
+ * The sources of the counters only call add() from the host, with values
+ * already known there, such that counting never adds a device synchronization
+ */
+namespace PerfCounters
+{
+
+void setEnabled(bool enabled);
+bool isEnabled();
+
+/// add \p value to the counter \p name, created if needed
+void add(const std::string& name, long long value = 1);
+
+std::map<std::string, long long> get();
+void reset();
+
+} // namespace PerfCounters
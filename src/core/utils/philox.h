@@ -0,0 +1,103 @@
+#pragma once
+
+#include <core/utils/cpu_gpu_defines.h>
+#include <core/utils/helper_math.h>
+
+#include <cmath>
+#include <cstdint>
+
+/**
+ * Philox4x32-10 counter-based generator, see
+ * J. K. Salmon, M. A. Moraes, R. O. Dror, D. E. Shaw (2011).
+ * Parallel random numbers: as easy as 1, 2, 3.
+ *
+ * The random numbers are a pure function of the counter and of the key,
+ * so that they do not depend on the order in which they are drawn
+ */
+namespace Philox
+{
+const static uint32_t M0 = 0xD2511F53;
+const static uint32_t M1 = 0xCD9E8D57;
+const static uint32_t W0 = 0x9E3779B9;
+const static uint32_t W1 = 0xBB67AE85;
+
+__HD__ inline uint32_t mulhilo(uint32_t a, uint32_t b, uint32_t& hi)
+{
+#ifdef __CUDA_ARCH__
+    hi = __umulhi(a, b);
+    return a * b;
+#else
+    const uint64_t prod = (uint64_t) a * b;
+    hi = prod >> 32;
+    return (uint32_t) prod;
+#endif
+}
+
+__HD__ inline uint4 philoxRound(uint4 c, uint2 k)
+{
+    uint32_t hi0, hi1;
+    const uint32_t lo0 = mulhilo(M0, c.x, hi0);
+    const uint32_t lo1 = mulhilo(M1, c.z, hi1);
+
+    return make_uint4(hi1 ^ c.y ^ k.x, lo1, hi0 ^ c.w ^ k.y, lo0);
+}
+
+/// 4 random 32-bit integers out of the counter \p c and the key \p k
+__HD__ inline uint4 philox4x32(uint4 c, uint2 k)
+{
+#pragma unroll
+    for (int i = 0; i < 9; i++)
+    {
+        c = philoxRound(c, k);
+        k.x += W0;
+        k.y += W1;
+    }
+
+    return philoxRound(c, k);
+}
+
+/// uniform in (0, 1], never 0 such that the log is finite
+__HD__ inline float toUniform01(uint32_t x)
+{
+    return ((x >> 8) + 1) * (1.0f / (1 << 24));
+}
+
+/// 2 independent normals with the Box-Muller transform
+__HD__ inline float2 boxMuller(uint32_t a, uint32_t b)
+{
+    const float r     = sqrtf(-2.0f * logf(toUniform01(a)));
+    const float theta = 2.0f * (float) M_PI * toUniform01(b);
+
+    float2 res;
+#ifdef __CUDA_ARCH__
+    sincosf(theta, &res.x, &res.y);
+#else
+    res.x = sinf(theta);
+    res.y = cosf(theta);
+#endif
+    return res * r;
+}
+
+/// 4 independent random numbers of zero mean and unit variance, normally distributed
+__HD__ inline float4 normal4(uint4 counter, uint2 key)
+{
+    const uint4 r = philox4x32(counter, key);
+    const float2 n0 = boxMuller(r.x, r.y);
+    const float2 n1 = boxMuller(r.z, r.w);
+
+    return make_float4(n0.x, n0.y, n1.x, n1.y);
+}
+
+/// the counter of the pair of particles (i, j) at the given step, symmetric in i and j
+__HD__ inline uint4 pairCounter(int step, int i, int j)
+{
+    return make_uint4((uint32_t) min(i, j), (uint32_t) max(i, j), (uint32_t) step, 0);
+}
+
+/// key out of a 64-bit seed
+__HD__ inline uint2 makeKey(uint64_t seed)
+{
+    return make_uint2((uint32_t) seed, (uint32_t) (seed >> 32));
+}
+
+} // namespace Philox
@@ -0,0 +1,36 @@
+#include "preemption.h"
+
+#include <core/logger.h>
+
+#include <csignal>
+#include <cstring>
+
+namespace Preemption
+{
+static volatile std::sig_atomic_t received = 0;
+
+static void handler(int)
+{
+    received = 1;
+}
+
+void catchSignal(int signal)
+{
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = handler;
+    sigemptyset(&action.sa_mask);
+
+    // the MPI calls interrupted by the signal are restarted
+    action.sa_flags = SA_RESTART;
+
+    if (sigaction(signal, &action, nullptr) != 0)
+        die("Could not catch signal %d: %s", signal, std::strerror(errno));
+}
+
+bool requested()
+{
+    return received != 0;
+}
+
+} // namespace Preemption
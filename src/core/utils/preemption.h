@@ -0,0 +1,15 @@
+#pragma once
+
+/**
+ * Notice of the preemption of the job, typically a SIGTERM some time before the kill.
+ * The handler only records that the signal was received, the simulation polls it, see Simulation::setPreemptionCheckpoint()
+ */
+namespace Preemption
+{
+/// catch \p signal from now on instead of its default action
+void catchSignal(int signal);
+
+/// whether one of the caught signals was received
+bool requested();
+
+} // namespace Preemption
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <core/datatypes.h>
+#include <core/utils/cpu_gpu_defines.h>
+#include <core/utils/helper_math.h>
+
+#include <cuda_fp16.h>
+
+/**
+ * Compressed storage of a particle in 16 bytes instead of sizeof(Particle):
+ * coordinates are rounded to the closest point of a grid with spacing \p step starting at \p lo,
+ * on 16 bits each, velocities are stored in half precision.
+ * Only the first id field (Particle::i1) is kept, Particle::i2 is lost.
+ *
+ * Layout is { x | y << 16, z | ux << 16, uy | uz << 16, i1 }
+ */
+
+static __device__ inline unsigned int quantize(float x, float lo, float step)
+{
+    return (unsigned int) fminf( fmaxf( rintf((x - lo) / step), 0.0f ), 65535.0f );
+}
+
+static __device__ inline uint4 compressParticle(const Particle& p, float3 lo, float3 step)
+{
+    const unsigned int x = quantize(p.r.x, lo.x, step.x);
+    const unsigned int y = quantize(p.r.y, lo.y, step.y);
+    const unsigned int z = quantize(p.r.z, lo.z, step.z);
+
+    const unsigned int ux = __half_as_ushort( __float2half_rn(p.u.x) );
+    const unsigned int uy = __half_as_ushort( __float2half_rn(p.u.y) );
+    const unsigned int uz = __half_as_ushort( __float2half_rn(p.u.z) );
+
+    return make_uint4( x | (y << 16), z | (ux << 16), uy | (uz << 16), (unsigned int) p.i1 );
+}
+
+static __device__ inline float3 decompressCoordinates(uint4 c, float3 lo, float3 step)
+{
+    return lo + step * make_float3(c.x & 0xffff, c.x >> 16, c.y & 0xffff);
+}
+
+static __device__ inline float3 decompressVelocity(uint4 c)
+{
+    return make_float3( __half2float(__ushort_as_half(c.y >> 16)),
+                        __half2float(__ushort_as_half(c.z & 0xffff)),
+                        __half2float(__ushort_as_half(c.z >> 16)) );
+}
@@ -0,0 +1,127 @@
+#include "scalar_mailbox.h"
+
+#include "perf_counters.h"
+
+#include <core/logger.h>
+#include <core/utils/cuda_common.h>
+#include <core/utils/kernel_launch.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace ScalarMailboxKernels
+{
+
+struct Gather
+{
+    const int *src;
+    int dst, n;
+};
+
+/// one block per collected source
+__global__ void gather(const Gather *gathers, int *words)
+{
+    const Gather g = gathers[blockIdx.x];
+
+    for (int i = threadIdx.x; i < g.n; i += blockDim.x)
+        words[g.dst + i] = g.src[i];
+}
+
+} // namespace ScalarMailboxKernels
+
+ScalarMailbox::ScalarMailbox(std::string name) :
+    name(name)
+{
+    gatherBuf.setOwner("mailbox:" + name);
+    CUDA_Check( cudaEventCreateWithFlags(&full, cudaEventDisableTiming) );
+}
+
+ScalarMailbox::~ScalarMailbox()
+{
+    if (hostWords != nullptr)
+        CUDA_Check( cudaFreeHost(hostWords) );
+
+    CUDA_Check( cudaEventDestroy(full) );
+}
+
+int ScalarMailbox::reserve(int n)
+{
+    if (posted)
+        die("Mailbox '%s' can't grow while a post is pending", name.c_str());
+
+    const int slot = offsets.size();
+    offsets.push_back(nWords);
+    nWords += n;
+
+    if (nWords <= capacity) return slot;
+
+    // slots are reserved at the setup, the reallocations are few
+    const int newCapacity = std::max(2 * capacity, std::max(nWords, 64));
+
+    int *newWords;
+    CUDA_Check( cudaHostAlloc(&newWords, newCapacity * sizeof(int), cudaHostAllocMapped) );
+    memset(newWords, 0, newCapacity * sizeof(int));
+
+    if (hostWords != nullptr)
+    {
+        memcpy(newWords, hostWords, capacity * sizeof(int));
+        CUDA_Check( cudaFreeHost(hostWords) );
+    }
+
+    hostWords = newWords;
+    capacity  = newCapacity;
+    CUDA_Check( cudaHostGetDevicePointer(&devWords, hostWords, 0) );
+
+    debug("Mailbox '%s' holds %d slots of %d words in total", name.c_str(), (int) offsets.size(), nWords);
+
+    return slot;
+}
+
+void ScalarMailbox::post(cudaStream_t stream)
+{
+    static_assert(sizeof(Gather) == sizeof(ScalarMailboxKernels::Gather), "the gathers must match the kernel");
+
+    if (posted)
+        die("Mailbox '%s' posted again before its values were read", name.c_str());
+
+    if (!gathers.empty())
+    {
+        gatherBuf.resize_anew(gathers.size());
+        std::copy(gathers.begin(), gathers.end(), gatherBuf.begin());
+        gatherBuf.uploadToDevice(stream);
+
+        const int nthreads = 32;
+        SAFE_KERNEL_LAUNCH(
+                ScalarMailboxKernels::gather,
+                gathers.size(), nthreads, 0, stream,
+                (const ScalarMailboxKernels::Gather*) gatherBuf.devPtr(), devWords );
+
+        gathers.clear();
+    }
+
+    CUDA_Check( cudaEventRecord(full, stream) );
+    posted = true;
+}
+
+bool ScalarMailbox::ready()
+{
+    if (!posted) return true;
+
+    const cudaError_t status = cudaEventQuery(full);
+    if (status == cudaErrorNotReady) return false;
+    CUDA_Check( status );
+
+    posted = false;
+    return true;
+}
+
+void ScalarMailbox::wait()
+{
+    if (ready()) return;
+
+    // the host really waits, as many times as a download would have
+    PerfCounters::add("mailbox synchronizations: " + name);
+
+    CUDA_Check( cudaEventSynchronize(full) );
+    posted = false;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <core/containers.h>
+
+#include <cuda_runtime.h>
+#include <string>
+#include <vector>
+
+/**
+ * Small values computed on the device and needed on the host, e.g. the sizes of the messages of an exchange
+ * or the numbers of collisions of a bounce, gathered in one block of mapped pinned memory.
+ *
+ * The slots are reserved with add(). Kernels may write a slot directly through devPtr(), which suits the values
+ * written once (e.g. a flag). Counters updated many times, typically atomically, stay on the device, as
+ * atomics across the bus are slow; collect() registers them and post() copies all of them into their slots
+ * with one kernel. post() then records one event for the whole mailbox: after wait(), or once ready() is true,
+ * the host reads every slot with hostPtr(). That is one synchronization for all the values of a phase instead of
+ * one download each, and none at all if they are only consumed later, e.g. in the next step.
+ */
+class ScalarMailbox
+{
+public:
+    explicit ScalarMailbox(std::string name);
+    ~ScalarMailbox();
+
+    ScalarMailbox(const ScalarMailbox&) = delete;
+    ScalarMailbox& operator=(const ScalarMailbox&) = delete;
+
+    /**
+     * Reserve \p n values of type T, not while a post is pending.
+     * The pointers to the slots given before become invalid
+     * @return the slot id
+     */
+    template <typename T>
+    int add(int n = 1)
+    {
+        static_assert(sizeof(T) % sizeof(int) == 0, "the mailbox holds values made of 32 bit words");
+        return reserve(n * (int) (sizeof(T) / sizeof(int)));
+    }
+
+    /// device address of \p slot, for the kernels
+    template <typename T>
+    T* devPtr(int slot) const
+    {
+        return (T*) (devWords + offsets[slot]);
+    }
+
+    /// host address of \p slot, valid after wait() or ready(), may be written before the kernels are launched
+    template <typename T>
+    T* hostPtr(int slot) const
+    {
+        return (T*) (hostWords + offsets[slot]);
+    }
+
+    /// copy \p n device values from \p src into \p slot at the next post()
+    template <typename T>
+    void collect(int slot, const T *src, int n = 1)
+    {
+        gathers.push_back({(const int*) src, offsets[slot], n * (int) (sizeof(T) / sizeof(int))});
+    }
+
+    /// gather the collected values after the work enqueued so far on \p stream, and mark the mailbox full then
+    void post(cudaStream_t stream);
+
+    /// whether the values of the last post() arrived, without blocking
+    bool ready();
+
+    /// block until the values of the last post() arrived
+    void wait();
+
+private:
+    struct Gather
+    {
+        const int *src;
+        int dst, n;     ///< in words
+    };
+
+    std::string name;
+
+    std::vector<int> offsets;   ///< of the slots, in words
+    int nWords {0}, capacity {0};
+    int *hostWords {nullptr}, *devWords {nullptr};
+
+    std::vector<Gather> gathers;
+    PinnedBuffer<Gather> gatherBuf;
+
+    cudaEvent_t full;
+    bool posted {false};
+
+    int reserve(int n);
+};
@@ -0,0 +1,51 @@
+#include "shrink_policy.h"
+
+#include <core/containers.h>
+#include <core/logger.h>
+
+ShrinkPolicy::ShrinkPolicy(int nsteps, float threshold, bool atCheckpoint) :
+    nsteps(nsteps),
+    threshold(threshold),
+    atCheckpoint(atCheckpoint)
+{
+    if (nsteps < 0)
+        die("Number of steps before shrinking the buffers must be non-negative, got %d", nsteps);
+
+    if (threshold <= 0.0f || threshold > 1.0f)
+        die("Shrink threshold must be in (0, 1], got %f", threshold);
+}
+
+void ShrinkPolicy::update(const std::vector<GPUcontainer*>& containers, cudaStream_t stream)
+{
+    if (!hysteresisEnabled()) return;
+
+    for (auto c : containers)
+    {
+        auto& counter = stepsBelow[c];
+
+        if (c->size() >= threshold * c->getCapacity())
+        {
+            counter = 0;
+            continue;
+        }
+
+        if (++counter < nsteps) continue;
+
+        const int oldCapacity = c->getCapacity();
+        c->shrink(stream);
+        counter = 0;
+
+        if (c->getCapacity() < oldCapacity)
+            debug2("Shrinking '%s' from %d to %d elements after %d steps below %.2f of the capacity",
+                   c->getOwner().c_str(), oldCapacity, c->getCapacity(), nsteps, threshold);
+    }
+}
+
+void ShrinkPolicy::shrinkAll(const std::vector<GPUcontainer*>& containers, cudaStream_t stream)
+{
+    for (auto c : containers)
+    {
+        c->shrink(stream);
+        stepsBelow[c] = 0;
+    }
+}
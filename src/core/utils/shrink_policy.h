@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cuda_runtime.h>
+#include <unordered_map>
+#include <vector>
+
+class GPUcontainer;
+
+/**
+ * Decides when the containers give back the memory they do not use.
+ *
+ * Containers only grow, so with the default policy a transient spike
+ * of their size (e.g. a dense clump of particles crossing a face of the domain)
+ * keeps the memory allocated for the rest of the simulation.
+ *
+ * With hysteresis enabled, a container is shrunk with GPUcontainer::shrink()
+ * once its size stayed below \c threshold times its capacity for
+ * \c nsteps consecutive calls of update(); a single step above the
+ * threshold restarts the count. That way buffers with sizes varying
+ * from step to step are not reallocated all the time.
+ *
+ * Independently, all the containers may be shrunk with shrinkAll(),
+ * e.g. after a checkpoint.
+ */
+class ShrinkPolicy
+{
+public:
+    /// never shrink
+    ShrinkPolicy() = default;
+
+    /**
+     * @param nsteps shrink after this many steps below the threshold, never if 0
+     * @param threshold fraction of the capacity, in (0, 1]
+     * @param atCheckpoint whether shrinkAll() has to be called after checkpoints
+     */
+    ShrinkPolicy(int nsteps, float threshold, bool atCheckpoint);
+
+    bool hysteresisEnabled() const { return nsteps > 0; }
+    bool shrinksAtCheckpoint() const { return atCheckpoint; }
+
+    /**
+     * Account one step of all the \p containers and shrink those that stayed
+     * below the threshold for long enough. Must be called when no one uses
+     * the pointers to their data, e.g. between the time-steps
+     */
+    void update(const std::vector<GPUcontainer*>& containers, cudaStream_t stream);
+
+    /// shrink all the \p containers regardless of their history
+    void shrinkAll(const std::vector<GPUcontainer*>& containers, cudaStream_t stream);
+
+private:
+    int nsteps{0};
+    float threshold{0.5f};
+    bool atCheckpoint{false};
+
+    /// number of consecutive steps below the threshold per container
+    std::unordered_map<const GPUcontainer*, int> stepsBelow;
+};
@@ -1,5 +1,8 @@
 #pragma once
 
+#include "velocity_field/none.h"
+
+#include <core/bounce_solver.h>
 #include <core/celllist.h>
 #include <core/pvs/views/pv.h>
 #include <core/utils/cuda_common.h>
@@ -31,6 +34,39 @@ __device__ inline float3 rescue(float3 candidate, float dt, float tol, int id, c
     return candidate;
 }
 
+/// particles with the SDF above this value are bounced
+constexpr float insideTolerance = 2e-6f;
+
+/**
+ * Bounce back of the particle \p p, which ended inside the wall moving from \p rOld:
+ * the new position is on the wall surface and the velocity is reflected
+ *
+ * @return the force exerted by the particle on the wall
+ */
+template <typename InsideWallChecker, typename VelocityField>
+__device__ inline float3 bounceInside(Particle& p, const float3 rOld, const float mass, const float dt,
+                                      const InsideWallChecker& checker, const VelocityField& velField)
+{
+    float3 dr = p.r - rOld;
+
+    const float alpha = solveLinSearch([=] (float lambda) {
+                                           return checker(rOld + dr*lambda) + insideTolerance;
+                                       });
+
+    float3 candidate = (alpha >= 0.0f) ? rOld + alpha * dr : rOld;
+    candidate = rescue(candidate, dt, insideTolerance, p.i1, checker);
+
+    float3 uWall = velField(p.r);
+    float3 unew = 2*uWall - p.u;
+
+    const float3 force = (p.u - unew) * (mass / dt);
+
+    p.r = candidate;
+    p.u = unew;
+
+    return force;
+}
+
 template <typename InsideWallChecker, typename VelocityField>
 __global__ void sdfBounce(PVviewWithOldParticles view, CellListInfo cinfo,
                           const int *wallCells, const int nWallCells, const float dt,
@@ -38,7 +74,6 @@ __global__ void sdfBounce(PVviewWithOldParticles view, CellListInfo cinfo,
                           const VelocityField velField,
                           double3 *totalForce)
 {
-    const float insideTolerance = 2e-6f;
     const int tid = blockIdx.x * blockDim.x + threadIdx.x;
 
     float3 localForce{0.f, 0.f, 0.f};
@@ -55,22 +90,8 @@ __global__ void sdfBounce(PVviewWithOldParticles view, CellListInfo cinfo,
             if (checker(p.r) <= -insideTolerance) continue;
 
             Particle pOld(view.old_particles, pid);
-            float3 dr = p.r - pOld.r;
 
-            const float alpha = solveLinSearch([=] (float lambda) {
-                                                   return checker(pOld.r + dr*lambda) + insideTolerance;
-                                               });
-
-            float3 candidate = (alpha >= 0.0f) ? pOld.r + alpha * dr : pOld.r;
-            candidate = rescue(candidate, dt, insideTolerance, p.i1, checker);
-
-            float3 uWall = velField(p.r);
-            float3 unew = 2*uWall - p.u;
-
-            localForce += (p.u - unew) * (view.mass / dt); // force exerted by the particle on the wall
-
-            p.r = candidate;
-            p.u = unew;
+            localForce += bounceInside(p, pOld.r, view.mass, dt, checker, velField);
                            
             p.write2Float4(view.particles, pid);
         }        
@@ -83,4 +104,28 @@ __global__ void sdfBounce(PVviewWithOldParticles view, CellListInfo cinfo,
 
 }
 
+/**
+ * Bounce from a stationary wall applied by the integration kernel to the new particles,
+ * see SimpleStationaryWall::fuseBounce().
+ * The SDF is only evaluated for the particles ending within reach of the wall
+ */
+template <typename InsideWallChecker>
+struct FusedBounce
+{
+    InsideWallChecker checker;
+    CellListInfo cinfo;      ///< cells of the deepFluid map
+    const char *deepFluid;   ///< per cell, 1 if the wall is out of reach within one step
+
+    /// @return the force exerted by the particle on the wall, zero if not bounced
+    __device__ inline float3 operator()(Particle& p, const float3 rOld, const float mass, const float dt) const
+    {
+        const int cid = cinfo.getCellId<CellListsProjection::NoClamp>(p.r);
+        if (cid >= 0 && deepFluid[cid]) return make_float3(0.f, 0.f, 0.f);
+
+        if (checker(p.r) <= -insideTolerance) return make_float3(0.f, 0.f, 0.f);
+
+        return bounceInside(p, rOld, mass, dt, checker, VelocityField_None());
+    }
+};
+
 } // namespace BounceKernels
@@ -2,14 +2,17 @@
 
 #include <memory>
 
+#include <core/logger.h>
 #include <core/utils/make_unique.h>
 #include <core/utils/pytypes.h>
 
 #include "interface.h"
 
+#include "rotating_sdf_wall.h"
 #include "simple_stationary_wall.h"
 #include "stationary_walls/box.h"
 #include "stationary_walls/cylinder.h"
+#include "stationary_walls/mesh.h"
 #include "stationary_walls/plane.h"
 #include "stationary_walls/sdf.h"
 #include "stationary_walls/sphere.h"
@@ -58,12 +61,27 @@ createPlaneWall(const YmrState *state, std::string name, PyTypes::float3 normal,
 }
 
 static std::shared_ptr<SimpleStationaryWall<StationaryWall_SDF>>
-createSDFWall(const YmrState *state, std::string name, std::string sdfFilename, PyTypes::float3 h)
+createSDFWall(const YmrState *state, std::string name, std::string sdfFilename, PyTypes::float3 h,
+              float narrowBand, bool gradientTexture, std::string storageDesc, float storageBand)
 {
-    StationaryWall_SDF sdf(state, sdfFilename, make_float3(h));
+    FieldStorage storage;
+    if      (storageDesc == "float")      storage = FieldStorage::Float;
+    else if (storageDesc == "half")       storage = FieldStorage::Half;
+    else if (storageDesc == "normalized") storage = FieldStorage::Normalized;
+    else die("Wall '%s': unknown SDF storage '%s', expected 'float', 'half' or 'normalized'",
+             name.c_str(), storageDesc.c_str());
+
+    StationaryWall_SDF sdf(state, sdfFilename, make_float3(h), narrowBand, gradientTexture, storage, storageBand);
     return std::make_shared<SimpleStationaryWall<StationaryWall_SDF>> (name, state, std::move(sdf));
 }
 
+static std::shared_ptr<SimpleStationaryWall<StationaryWall_Mesh>>
+createMeshWall(const YmrState *state, std::string name, std::shared_ptr<Mesh> mesh, PyTypes::float3 h, bool inside)
+{
+    StationaryWall_Mesh sdf(state, name, mesh, make_float3(h), inside);
+    return std::make_shared<SimpleStationaryWall<StationaryWall_Mesh>> (name, state, std::move(sdf));
+}
+
 // Moving walls
 
 static std::shared_ptr<WallWithVelocity<StationaryWall_Cylinder, VelocityField_Rotate>>
@@ -100,6 +118,15 @@ createMovingCylinderWall(const YmrState *state, std::string name, PyTypes::float
     return std::make_shared<WallWithVelocity<StationaryWall_Cylinder, VelocityField_Rotate>> (name, state, std::move(cylinder), std::move(rotate));
 }
 
+static std::shared_ptr<RotatingSDFWall>
+createRotatingSDFWall(const YmrState *state, std::string name, std::string sdfFilename,
+                      PyTypes::float3 center, PyTypes::float3 omega, PyTypes::float3 h)
+{
+    StationaryWall_RotatingSDF sdf(state, sdfFilename, make_float3(h), make_float3(center), make_float3(omega));
+    VelocityField_Rotate rotate(make_float3(omega), make_float3(center));
+    return std::make_shared<RotatingSDFWall> (name, state, std::move(sdf), std::move(rotate));
+}
+
 static std::shared_ptr<WallWithVelocity<StationaryWall_Plane, VelocityField_Translate>>
 createMovingPlaneWall(const YmrState *state, std::string name, PyTypes::float3 normal, PyTypes::float3 pointThrough, PyTypes::float3 velocity)
 {
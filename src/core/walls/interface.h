@@ -2,6 +2,7 @@
 
 #include "core/ymero_object.h"
 #include <core/containers.h>
+#include <core/device_monitor.h>
 #include <core/domain.h>
 #include <core/pvs/particle_vector.h>
 
@@ -33,7 +34,17 @@ public:
      */
     virtual void setPrerequisites(ParticleVector* pv) {}
 
-    virtual void check(cudaStream_t stream) = 0;
+    /**
+     * Let the integrator of \p pv bounce its particles from the wall within the integration kernel;
+     * bounce() then skips \p pv. Called from Simulation after attach()
+     * Default: not supported
+     *
+     * @return true if the bounce of \p pv is left to the integrator
+     */
+    virtual bool fuseBounce(ParticleVector* pv) { return false; }
+
+    /// report the particles inside the wall to \p monitor, without synchronizing the host
+    virtual void check(DeviceMonitorHandler monitor, cudaStream_t stream) = 0;
 };
 
 
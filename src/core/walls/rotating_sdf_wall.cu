@@ -0,0 +1,138 @@
+#include "rotating_sdf_wall.h"
+
+#include <core/celllist.h>
+#include <core/logger.h>
+#include <core/pvs/particle_vector.h>
+#include <core/utils/cuda_common.h>
+#include <core/utils/kernel_launch.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace RotatingSDFWallKernels
+{
+
+/**
+ * One thread per cell, for one orientation of the geometry: the cell is a boundary cell if the
+ * surface may be within reach of its corners, it is deep fluid if all its corners are far in the fluid.
+ * \p boundary accumulates with OR, \p deep with AND over the orientations
+ */
+__global__ void sweepCells(CellListInfo cinfo, float tolerance, RotatingSDFHandler checker, char *boundary, char *deep)
+{
+    const int cid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (cid >= cinfo.totcells) return;
+
+    int3 ind;
+    cinfo.decode(cid, ind.x, ind.y, ind.z);
+    const float3 cornerCoo = -0.5f*cinfo.localDomainSize + make_float3(ind)*cinfo.h;
+
+    int pos = 0, neg = 0;
+    for (int i=0; i<2; i++)
+        for (int j=0; j<2; j++)
+            for (int k=0; k<2; k++)
+            {
+                const float3 shift = make_float3(i ? cinfo.h.x : 0.0f, j ? cinfo.h.y : 0.0f, k ? cinfo.h.z : 0.0f);
+                const float s = checker(cornerCoo + shift);
+
+                if (s >  tolerance) pos++;
+                if (s < -tolerance) neg++;
+            }
+
+    if (pos != 8 && neg != 8) boundary[cid] = 1;
+    if (neg != 8)             deep[cid] = 0;
+}
+
+} // namespace RotatingSDFWallKernels
+
+RotatingSDFWall::RotatingSDFWall(std::string name, const YmrState *state,
+                                 StationaryWall_RotatingSDF&& sdf, VelocityField_Rotate&& rotate) :
+    WallWithVelocity<StationaryWall_RotatingSDF, VelocityField_Rotate>(name, state, std::move(sdf), std::move(rotate))
+{}
+
+void RotatingSDFWall::attach(ParticleVector *pv, CellList *cl)
+{
+    if (pv == frozen)
+    {
+        warn("Particle Vector '%s' declared as frozen for the wall '%s'. Bounce-back won't work",
+             pv->name.c_str(), name.c_str());
+        return;
+    }
+
+    if (dynamic_cast<PrimaryCellList*>(cl) == nullptr)
+        die("PVs should only be attached to walls with the primary cell-lists! "
+            "Invalid combination: wall %s, pv %s", name.c_str(), pv->name.c_str());
+
+    CUDA_Check( cudaDeviceSynchronize() );
+    particleVectors.push_back(pv);
+    cellLists.push_back(cl);
+
+    // between two sampled orientations the surface moves by at most halfGap
+    const float3 h = cl->h;
+    const float radius = insideWallChecker.getMaxLocalRadius();
+    const int nOrientations = std::min(4096, std::max(8, (int) std::ceil(M_PI * radius / std::min({h.x, h.y, h.z}))));
+    const float halfGap = M_PI * radius / nOrientations;
+
+    // About maximum distance a particle can cover in one step
+    const float tol = 0.25f;
+
+    PinnedBuffer<char> boundary(cl->totcells);
+    DeviceBuffer<char> deep(cl->totcells);
+    boundary.clearDevice(defaultStream);
+    CUDA_Check( cudaMemsetAsync(deep.devPtr(), 1, deep.size() * sizeof(char), defaultStream) );
+
+    const int nthreads = 128;
+    const float period = 2.0 * M_PI / std::fabs(insideWallChecker.getAngularVelocity());
+
+    for (int i = 0; i < nOrientations; i++)
+    {
+        insideWallChecker.setTime(i * period / nOrientations);
+
+        SAFE_KERNEL_LAUNCH(
+                RotatingSDFWallKernels::sweepCells,
+                getNblocks(cl->totcells, nthreads), nthreads, 0, defaultStream,
+                cl->cellInfo(), tol + halfGap, insideWallChecker.handler(),
+                boundary.devPtr(), deep.devPtr() );
+    }
+
+    insideWallChecker.setTime(state->currentTime);
+
+    boundary.downloadFromDevice(defaultStream, ContainersSynch::Synch);
+
+    const int nBoundary = std::count(boundary.begin(), boundary.end(), 1);
+    PinnedBuffer<int> ids(nBoundary);
+    for (int cid = 0, id = 0; cid < cl->totcells; cid++)
+        if (boundary[cid])
+            ids[id++] = cid;
+
+    debug("Found %d boundary cells of '%s' over a revolution sampled %d times",
+          ids.size(), pv->name.c_str(), nOrientations);
+
+    DeviceBuffer<int> bc;
+    bc.copyFromHost(ids, defaultStream);
+
+    boundaryCells .push_back(std::move(bc));
+    deepFluidCells.push_back(std::move(deep));
+    CUDA_Check( cudaDeviceSynchronize() );
+}
+
+void RotatingSDFWall::bounce(cudaStream_t stream)
+{
+    // the particles are bounced off the geometry at the end of the step
+    insideWallChecker.setTime(state->currentTime + state->dt);
+    WallWithVelocity<StationaryWall_RotatingSDF, VelocityField_Rotate>::bounce(stream);
+}
+
+void RotatingSDFWall::check(DeviceMonitorHandler monitor, cudaStream_t stream)
+{
+    insideWallChecker.setTime(state->currentTime + state->dt);
+    WallWithVelocity<StationaryWall_RotatingSDF, VelocityField_Rotate>::check(monitor, stream);
+}
+
+void RotatingSDFWall::sdfPerParticle(LocalParticleVector *lpv,
+                                     GPUcontainer *sdfs, GPUcontainer *gradients,
+                                     float gradientThreshold, cudaStream_t stream)
+{
+    insideWallChecker.setTime(state->currentTime);
+    WallWithVelocity<StationaryWall_RotatingSDF, VelocityField_Rotate>::sdfPerParticle(lpv, sdfs, gradients,
+                                                                                        gradientThreshold, stream);
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "stationary_walls/rotating_sdf.h"
+#include "velocity_field/rotate.h"
+#include "wall_with_velocity.h"
+
+/**
+ * Rigid SDF geometry rotating around a coordinate axis at constant angular velocity.
+ * The SDF grid is sampled once in the frame of the body and rotated at evaluation time.
+ *
+ * The boundary cells are those the surface crosses during a whole revolution,
+ * such that they never need to be recomputed. The frozen particles must be moved
+ * with the geometry by an integrator rotating at the same angular velocity, e.g. IntegratorConstOmega
+ */
+class RotatingSDFWall : public WallWithVelocity<StationaryWall_RotatingSDF, VelocityField_Rotate>
+{
+public:
+    RotatingSDFWall(std::string name, const YmrState *state,
+                    StationaryWall_RotatingSDF&& sdf, VelocityField_Rotate&& rotate);
+
+    void attach(ParticleVector *pv, CellList *cl) override;
+    void bounce(cudaStream_t stream) override;
+    void check(DeviceMonitorHandler monitor, cudaStream_t stream) override;
+
+    void sdfPerParticle(LocalParticleVector *lpv,
+                        GPUcontainer *sdfs, GPUcontainer *gradients,
+                        float gradientThreshold, cudaStream_t stream) override;
+};
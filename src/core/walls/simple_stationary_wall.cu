@@ -3,7 +3,9 @@
 #include "common_kernels.h"
 #include "stationary_walls/box.h"
 #include "stationary_walls/cylinder.h"
+#include "stationary_walls/mesh.h"
 #include "stationary_walls/plane.h"
+#include "stationary_walls/rotating_sdf.h"
 #include "stationary_walls/sdf.h"
 #include "stationary_walls/sphere.h"
 #include "velocity_field/none.h"
@@ -14,11 +16,13 @@
 #include <core/logger.h>
 #include <core/pvs/extra_data/packers.h>
 #include <core/pvs/object_vector.h>
+#include <core/pvs/particle_editor.h>
 #include <core/pvs/particle_vector.h>
 #include <core/pvs/views/ov.h>
 #include <core/utils/cuda_common.h>
 #include <core/utils/kernel_launch.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <fstream>
@@ -29,21 +33,22 @@
 //===============================================================================================
 
 template<typename InsideWallChecker>
-__global__ void collectRemaining(PVview view, float4 *remaining, int *nRemaining, InsideWallChecker checker)
+__global__ void markInner(PVview view, InsideWallChecker checker)
 {
     const float tolerance = 1e-6f;
 
     const int pid = blockIdx.x * blockDim.x + threadIdx.x;
     if (pid >= view.size) return;
 
-    Particle p(view.particles, pid);
+    Particle p;
+    p.readCoordinate(view.particles, pid);
 
     const float val = checker(p.r);
 
-    if (val <= -tolerance)
+    if (val > -tolerance)
     {
-        const int ind = atomicAggInc(nRemaining);
-        p.write2Float4(remaining, ind);
+        p.mark();
+        p.write2Float4(view.particles, pid);
     }
 }
 
@@ -154,12 +159,38 @@ __global__ void getBoundaryCells(PVview view, CellListInfo cinfo, int *nBoundary
     }
 }
 
+/// the whole cell is further than the distance covered in one step from the wall
+template<typename InsideWallChecker>
+__global__ void getDeepFluidCells(CellListInfo cinfo, char *deepFluid, InsideWallChecker checker)
+{
+    const float tol = 0.25f;
+
+    const int cid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (cid >= cinfo.totcells) return;
+
+    int3 ind;
+    cinfo.decode(cid, ind.x, ind.y, ind.z);
+    float3 cornerCoo = -0.5f*cinfo.localDomainSize + make_float3(ind)*cinfo.h;
+
+    bool deep = true;
+    for (int i=0; i<2; i++)
+        for (int j=0; j<2; j++)
+            for (int k=0; k<2; k++)
+            {
+                const float3 shift = make_float3(i ? cinfo.h.x : 0.0f, j ? cinfo.h.y : 0.0f, k ? cinfo.h.z : 0.0f);
+                deep = deep && checker(cornerCoo + shift) < -tol;
+            }
+
+    deepFluid[cid] = deep;
+}
+
 //===============================================================================================
 // Checking kernel
 //===============================================================================================
 
+/// particles within deep fluid cells are not checked
 template<typename InsideWallChecker>
-__global__ void checkInside(PVview view, int *nInside, const InsideWallChecker checker)
+__global__ void checkInside(PVview view, CellListInfo cinfo, const char *deepFluid, DeviceMonitorHandler monitor, const InsideWallChecker checker)
 {
 	const float checkTolerance = 1e-4f;
 
@@ -168,9 +199,12 @@ __global__ void checkInside(PVview view, int *nInside, const InsideWallChecker c
 
     Float3_int coo(view.particles[2*pid]);
 
+    const int cid = cinfo.getCellId<CellListsProjection::NoClamp>(coo.v);
+    if (cid >= 0 && deepFluid[cid]) return;
+
     float v = checker(coo.v);
 
-    if (v > checkTolerance) atomicAggInc(nInside);
+    if (v > checkTolerance) monitor.report(MonitorCheck::InsideWall);
 }
 
 //===============================================================================================
@@ -181,26 +215,18 @@ template<typename InsideWallChecker>
 __global__ void computeSdfPerParticle(PVview view, float gradientThreshold, float *sdfs, float3 *gradients, InsideWallChecker checker)
 {
     const float h = 0.25f;
-    const float zeroTolerance = 1e-10f;
 
     const int pid = blockIdx.x * blockDim.x + threadIdx.x;
     if (pid >= view.size) return;
 
     Particle p;
-    p.readCoordinate(view.particles, pid);
+    view.readCoordinate(p, pid);
 
     float sdf = checker(p.r);
     sdfs[pid] = sdf;
 
     if (gradients != nullptr && sdf > -gradientThreshold)
-    {
-        float3 grad = computeGradient(checker, p.r, h);
-
-        if (dot(grad, grad) < zeroTolerance)
-            gradients[pid] = make_float3(0, 0, 0);
-        else
-            gradients[pid] = normalize(grad);
-    }
+        gradients[pid] = computeNormal(checker, p.r, h);
 }
 
 
@@ -303,6 +329,14 @@ void SimpleStationaryWall<InsideWallChecker>::attach(ParticleVector *pv, CellLis
             view, cl->cellInfo(), nBoundaryCells.devPtr(), bc.devPtr(), insideWallChecker.handler() );
 
     boundaryCells.push_back(std::move(bc));
+
+    DeviceBuffer<char> deep(cl->totcells);
+    SAFE_KERNEL_LAUNCH(
+            getDeepFluidCells,
+            getNblocks(cl->totcells, nthreads), nthreads, 0, defaultStream,
+            cl->cellInfo(), deep.devPtr(), insideWallChecker.handler() );
+
+    deepFluidCells.push_back(std::move(deep));
     CUDA_Check( cudaDeviceSynchronize() );
 }
 
@@ -332,16 +366,18 @@ void SimpleStationaryWall<InsideWallChecker>::removeInner(ParticleVector *pv)
     if (ov == nullptr)
     {
         PVview view(pv, pv->local());
-        PinnedBuffer<Particle> tmp(view.size);
 
         SAFE_KERNEL_LAUNCH(
-                collectRemaining,
+                markInner,
                 getNblocks(view.size, nthreads), nthreads, 0, defaultStream,
-                view, (float4*)tmp.devPtr(), nRemaining.devPtr(), insideWallChecker.handler() );
+                view, insideWallChecker.handler() );
 
-        nRemaining.downloadFromDevice(defaultStream);
-        std::swap(pv->local()->coosvels, tmp);
-        pv->local()->resize(nRemaining[0], defaultStream);
+        PackPredicate packPredicate = [](const ExtraDataManager::NamedChannelDesc& namedDesc) {
+            return namedDesc.second->persistence == ExtraDataManager::PersistenceMode::Persistent;
+        };
+
+        ParticleEditor editor;
+        editor.removeMarked(pv, pv->local(), packPredicate, defaultStream);
     }
     else
     {
@@ -387,7 +423,14 @@ void SimpleStationaryWall<InsideWallChecker>::bounce(cudaStream_t stream)
 {
     float dt = this->state->dt;
 
-    bounceForce.clear(stream);
+    // the fused bounces were done by the integration of this step
+    if (fusedBounces.empty())
+        bounceForce.clear(stream);
+    else
+    {
+        bounceForce.copy(fusedBounceForce, stream);
+        fusedBounceForce.clear(stream);
+    }
     
     for (int i = 0; i < particleVectors.size(); i++)
     {
@@ -396,6 +439,8 @@ void SimpleStationaryWall<InsideWallChecker>::bounce(cudaStream_t stream)
         auto& bc = boundaryCells[i];
         auto  view = cl->getView<PVviewWithOldParticles>();
 
+        if (fusedBounces.find(pv) != fusedBounces.end()) continue;
+
         debug2("Bouncing %d %s particles, %d boundary cells",
                pv->local()->size(), pv->name.c_str(), bc.size());
 
@@ -414,24 +459,60 @@ void SimpleStationaryWall<InsideWallChecker>::bounce(cudaStream_t stream)
 }
 
 template<class InsideWallChecker>
-void SimpleStationaryWall<InsideWallChecker>::check(cudaStream_t stream)
+int SimpleStationaryWall<InsideWallChecker>::getAttachedIdOrDie(ParticleVector *pv) const
+{
+    for (int i = 0; i < particleVectors.size(); i++)
+        if (particleVectors[i] == pv)
+            return i;
+
+    die("Particle vector '%s' is not attached to the wall '%s'", pv->name.c_str(), name.c_str());
+    return -1;
+}
+
+template<class InsideWallChecker>
+bool SimpleStationaryWall<InsideWallChecker>::fuseBounce(ParticleVector *pv)
+{
+    // frozen particles are not bounced
+    if (std::find(particleVectors.begin(), particleVectors.end(), pv) == particleVectors.end())
+        return false;
+
+    if (fusedBounces.empty())
+        fusedBounceForce.clear(defaultStream);
+
+    fusedBounces.insert(pv);
+    info("Particles of '%s' will be bounced from the wall '%s' by their integrator",
+         pv->name.c_str(), name.c_str());
+    return true;
+}
+
+template<class InsideWallChecker>
+BounceKernels::FusedBounce<typename SimpleStationaryWall<InsideWallChecker>::CheckerHandler>
+SimpleStationaryWall<InsideWallChecker>::getFusedBounce(ParticleVector *pv)
+{
+    const int i = getAttachedIdOrDie(pv);
+    return { insideWallChecker.handler(), cellLists[i]->cellInfo(), deepFluidCells[i].devPtr() };
+}
+
+template<class InsideWallChecker>
+double3* SimpleStationaryWall<InsideWallChecker>::getFusedBounceForce()
+{
+    return fusedBounceForce.devPtr();
+}
+
+template<class InsideWallChecker>
+void SimpleStationaryWall<InsideWallChecker>::check(DeviceMonitorHandler monitor, cudaStream_t stream)
 {
     const int nthreads = 128;
     for (int i=0; i<particleVectors.size(); i++)
     {
         auto pv = particleVectors[i];
-        {
-            nInside.clearDevice(stream);
-            PVview view(pv, pv->local());
-            SAFE_KERNEL_LAUNCH(
-                    checkInside,
-                    getNblocks(view.size, nthreads), nthreads, 0, stream,
-                    view, nInside.devPtr(), insideWallChecker.handler() );
+        auto cl = cellLists[i];
 
-            nInside.downloadFromDevice(stream);
-
-            say("%d particles of %s are inside the wall %s", nInside[0], pv->name.c_str(), name.c_str());
-        }
+        PVview view(pv, pv->local());
+        SAFE_KERNEL_LAUNCH(
+                checkInside,
+                getNblocks(view.size, nthreads), nthreads, 0, stream,
+                view, cl->cellInfo(), deepFluidCells[i].devPtr(), monitor, insideWallChecker.handler() );
     }
 }
 
@@ -513,8 +594,10 @@ PinnedBuffer<double3>* SimpleStationaryWall<InsideWallChecker>::getCurrentBounce
 template class SimpleStationaryWall<StationaryWall_Sphere>;
 template class SimpleStationaryWall<StationaryWall_Cylinder>;
 template class SimpleStationaryWall<StationaryWall_SDF>;
+template class SimpleStationaryWall<StationaryWall_Mesh>;
 template class SimpleStationaryWall<StationaryWall_Plane>;
 template class SimpleStationaryWall<StationaryWall_Box>;
+template class SimpleStationaryWall<StationaryWall_RotatingSDF>;
 
 
 
@@ -4,10 +4,18 @@
 
 #include <core/containers.h>
 
+#include <set>
+#include <type_traits>
+
 class LocalParticleVector;
 class ParticleVector;
 class CellList;
 
+namespace BounceKernels
+{
+template <typename InsideWallChecker> struct FusedBounce;
+}
+
 template<class InsideWallChecker>
 class SimpleStationaryWall : public SDF_basedWall
 {
@@ -22,7 +30,7 @@ public:
     void removeInner(ParticleVector *pv) override;
     void attach(ParticleVector *pv, CellList *cl) override;
     void bounce(cudaStream_t stream) override;
-    void check(cudaStream_t stream) override;
+    void check(DeviceMonitorHandler monitor, cudaStream_t stream) override;
 
     void sdfPerParticle(LocalParticleVector *pv,
                         GPUcontainer *sdfs, GPUcontainer *gradients,
@@ -33,17 +41,32 @@ public:
 
     InsideWallChecker& getChecker() { return insideWallChecker; }
 
+    using CheckerHandler = typename std::decay<decltype(std::declval<const InsideWallChecker&>().handler())>::type;
+
+    bool fuseBounce(ParticleVector *pv) override;
+
+    /// to be applied by the integration kernel of \p pv, which must have been fused, see fuseBounce()
+    BounceKernels::FusedBounce<CheckerHandler> getFusedBounce(ParticleVector *pv);
+
+    /// accumulates the force exerted on the wall by the fused bounces, reported with the next bounce()
+    double3* getFusedBounceForce();
+
     PinnedBuffer<double3>* getCurrentBounceForce() override;
 
 protected:
 
     InsideWallChecker insideWallChecker;
 
-    ParticleVector *frozen;
+    ParticleVector *frozen {nullptr};
     std::vector<ParticleVector*> particleVectors;
     std::vector<CellList*> cellLists;
 
     std::vector<DeviceBuffer<int>> boundaryCells;
-    PinnedBuffer<int> nInside{1};
+    std::vector<DeviceBuffer<char>> deepFluidCells; ///< per cell, 1 if the wall is out of reach within one step
     PinnedBuffer<double3> bounceForce{1};
+
+    std::set<ParticleVector*> fusedBounces; ///< bounced by their integrators
+    DeviceBuffer<double3> fusedBounceForce{1};
+
+    int getAttachedIdOrDie(ParticleVector *pv) const;
 };
@@ -0,0 +1,21 @@
+#include "mesh.h"
+
+/**
+ * The wall is inside the mesh, so the sdf has to be positive there;
+ * with \p inside, the domain is inside the mesh instead
+ */
+StationaryWall_Mesh::StationaryWall_Mesh(const YmrState *state, std::string name, std::shared_ptr<Mesh> mesh, float3 sdfH, bool inside) :
+    impl(new FieldFromMesh(state, "field_"+name, mesh, sdfH, inside))
+{}
+
+StationaryWall_Mesh::StationaryWall_Mesh(StationaryWall_Mesh&&) = default;
+
+const FieldDeviceHandler& StationaryWall_Mesh::handler() const
+{
+    return impl->handler();
+}
+
+void StationaryWall_Mesh::setup(MPI_Comm& comm, DomainInfo domain)
+{
+    return impl->setup(comm);
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <core/field/from_mesh.h>
+#include <memory>
+
+class StationaryWall_Mesh
+{
+public:
+    StationaryWall_Mesh(const YmrState *state, std::string name, std::shared_ptr<Mesh> mesh, float3 sdfH, bool inside);
+    StationaryWall_Mesh(StationaryWall_Mesh&&);
+
+    void setup(MPI_Comm& comm, DomainInfo domain);
+
+    const FieldDeviceHandler& handler() const;
+
+private:
+    std::unique_ptr<FieldFromMesh> impl;
+};
@@ -0,0 +1,127 @@
+#include "rotating_sdf.h"
+
+#include <core/field/shared.h>
+#include <core/logger.h>
+#include <core/ymero_state.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+const float defaultMargin = 5.0f;
+
+int getAxis(float3 omega)
+{
+    const int nonZero = (omega.x != 0.0f) + (omega.y != 0.0f) + (omega.z != 0.0f);
+    if (nonZero != 1)
+        die("Rotating SDF walls only rotate around the x, y or z axis, got omega = [%g %g %g]",
+            omega.x, omega.y, omega.z);
+
+    return omega.x != 0.0f ? 0 : (omega.y != 0.0f ? 1 : 2);
+}
+
+inline float component(float3 v, int i)
+{
+    return i == 0 ? v.x : (i == 1 ? v.y : v.z);
+}
+
+/// largest distance from the axis through \p center of the corners of the local domain extended by the default margin
+float maxCornerRadius(const DomainInfo& domain, float3 center, int axis)
+{
+    const float3 half = 0.5f * domain.localSize + defaultMargin;
+
+    float maxR2 = 0.0f;
+    for (int i = 0; i < 8; i++)
+    {
+        const float3 corner = make_float3(i & 1 ? half.x : -half.x, i & 2 ? half.y : -half.y, i & 4 ? half.z : -half.z);
+        float3 d = corner - center;
+
+        if (axis == 0) d.x = 0.0f;
+        if (axis == 1) d.y = 0.0f;
+        if (axis == 2) d.z = 0.0f;
+
+        maxR2 = std::max(maxR2, dot(d, d));
+    }
+
+    return std::sqrt(maxR2);
+}
+
+/// radius of the largest cylinder around the axis fitting in the global domain
+float inscribedRadius(const DomainInfo& domain, float3 globalCenter, int axis)
+{
+    float r = 1e30f;
+    for (int i = 0; i < 3; i++)
+    {
+        if (i == axis) continue;
+
+        const float c = component(globalCenter, i), L = component(domain.globalSize, i);
+        if (c <= 0.0f || c >= L)
+            die("The rotation center of a rotating SDF wall must be inside the domain");
+
+        r = std::min(r, std::min(c, L - c));
+    }
+    return r;
+}
+
+/// margins of the field, such that it contains the body frame positions of the whole extended local domain
+float3 rotationMargin(const DomainInfo& domain, float3 globalCenter, int axis)
+{
+    const float3 center = domain.global2local(globalCenter);
+    const float radius = std::min(maxCornerRadius(domain, center, axis), inscribedRadius(domain, globalCenter, axis));
+
+    float m[3];
+    for (int i = 0; i < 3; i++)
+    {
+        const float reach = std::fabs(component(center, i)) + radius;
+        m[i] = i == axis ? defaultMargin : std::max(defaultMargin, reach - 0.5f * component(domain.localSize, i));
+    }
+
+    return make_float3(m[0], m[1], m[2]);
+}
+} // anonymous namespace
+
+StationaryWall_RotatingSDF::StationaryWall_RotatingSDF(const YmrState *state, std::string sdfFileName, float3 sdfH,
+                                                       float3 center, float3 omega) :
+    impl(SharedFields::fromFile(state, sdfFileName, sdfH, 0.0f, false,
+                                rotationMargin(state->domain, center, getAxis(omega)))),
+    omega(component(omega, getAxis(omega)))
+{
+    const int axis = getAxis(omega);
+    const auto& domain = state->domain;
+
+    rotatingHandler.center    = domain.global2local(center);
+    rotatingHandler.axis      = axis;
+    rotatingHandler.maxRadius = inscribedRadius(domain, center, axis);
+
+    maxLocalRadius = maxCornerRadius(domain, rotatingHandler.center, axis);
+
+    setTime(0.0f);
+}
+
+StationaryWall_RotatingSDF::StationaryWall_RotatingSDF(StationaryWall_RotatingSDF&&) = default;
+
+void StationaryWall_RotatingSDF::setup(MPI_Comm& comm, DomainInfo domain)
+{
+    impl->setup(comm);
+    rotatingHandler.field = impl->handler();
+}
+
+void StationaryWall_RotatingSDF::setTime(float t)
+{
+    // 2 pi periodic in double precision, the time grows large
+    const double angle = std::fmod((double) omega * t, 2.0 * M_PI);
+
+    rotatingHandler.cosine =  std::cos(angle);
+    rotatingHandler.sine   = -std::sin(angle);
+}
+
+const RotatingSDFHandler& StationaryWall_RotatingSDF::handler() const
+{
+    return rotatingHandler;
+}
+
+float StationaryWall_RotatingSDF::getMaxLocalRadius() const
+{
+    return maxLocalRadius;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <core/field/from_file.h>
+
+#include <memory>
+
+/**
+ * SDF of a rigid geometry rotating around a coordinate axis, evaluated in the frame of the body:
+ * the grid is sampled once and the current rotation is applied to the query points.
+ * All the coordinates are local, except for the center given in global coordinates
+ */
+struct RotatingSDFHandler
+{
+    FieldDeviceHandler field;
+    float3 center;
+    int axis;
+    float cosine, sine;   ///< of the rotation from the current frame to the body frame
+    float maxRadius;      ///< only read the body frame within this distance of the axis
+
+    __D__ inline float operator()(float3 x) const
+    {
+        const float3 d = x - center;
+
+        float a, b;
+        if (axis == 0) { a = d.y; b = d.z; }
+        if (axis == 1) { a = d.z; b = d.x; }
+        if (axis == 2) { a = d.x; b = d.y; }
+
+        float u = cosine * a - sine * b;
+        float v = sine * a + cosine * b;
+
+        // beyond the cylinder of the file, the distance to the geometry only grows
+        float excess = 0.0f;
+        const float r = sqrtf(u*u + v*v);
+        if (r > maxRadius)
+        {
+            excess = r - maxRadius;
+            u *= maxRadius / r;
+            v *= maxRadius / r;
+        }
+
+        float3 q = d;
+        if (axis == 0) { q.y = u; q.z = v; }
+        if (axis == 1) { q.z = u; q.x = v; }
+        if (axis == 2) { q.x = u; q.y = v; }
+
+        return field(center + q) - excess;
+    }
+};
+
+/**
+ * The body frame is the global frame at time 0, such that the SDF file describes the initial geometry.
+ * The field of every rank covers the body frame positions of all the points of its subdomain.
+ * The file is read periodically: only the cylinder around the axis inscribed in the domain is used
+ */
+class StationaryWall_RotatingSDF
+{
+public:
+    StationaryWall_RotatingSDF(const YmrState *state, std::string sdfFileName, float3 sdfH,
+                               float3 center, float3 omega);
+    StationaryWall_RotatingSDF(StationaryWall_RotatingSDF&&);
+
+    void setup(MPI_Comm& comm, DomainInfo domain);
+
+    /// rotate the geometry to its position at time \p t
+    void setTime(float t);
+
+    const RotatingSDFHandler& handler() const;
+
+    /// largest distance from the rotation axis of the points of the local domain, margins included
+    float getMaxLocalRadius() const;
+
+    float getAngularVelocity() const { return omega; }
+
+private:
+    std::shared_ptr<FieldFromFile> impl;
+    RotatingSDFHandler rotatingHandler;
+
+    float omega;
+    float maxLocalRadius;
+};
@@ -1,7 +1,12 @@
 #include "sdf.h"
 
-StationaryWall_SDF::StationaryWall_SDF(const YmrState *state, std::string sdfFileName, float3 sdfH) :
-    impl(new FieldFromFile(state, "field_"+sdfFileName, sdfFileName, sdfH))
+#include <core/field/shared.h>
+
+StationaryWall_SDF::StationaryWall_SDF(const YmrState *state, std::string sdfFileName, float3 sdfH,
+                                       float narrowBand, bool gradientTexture,
+                                       FieldStorage storage, float storageBand) :
+    impl(SharedFields::fromFile(state, sdfFileName, sdfH, narrowBand, gradientTexture,
+                                {5, 5, 5}, storage, storageBand))
 {}
 
 StationaryWall_SDF::StationaryWall_SDF(StationaryWall_SDF&&) = default;
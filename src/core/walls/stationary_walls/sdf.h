@@ -6,7 +6,9 @@
 class StationaryWall_SDF
 {
 public:
-    StationaryWall_SDF(const YmrState *state, std::string sdfFileName, float3 sdfH);
+    StationaryWall_SDF(const YmrState *state, std::string sdfFileName, float3 sdfH,
+                       float narrowBand = 0.0f, bool gradientTexture = false,
+                       FieldStorage storage = FieldStorage::Float, float storageBand = 0.0f);
     StationaryWall_SDF(StationaryWall_SDF&&);
 
     void setup(MPI_Comm& comm, DomainInfo domain);
@@ -14,5 +16,5 @@ public:
     const FieldDeviceHandler& handler() const;
 
 private:
-    std::unique_ptr<FieldFromFile> impl;
+    std::shared_ptr<FieldFromFile> impl;
 };
@@ -7,6 +7,7 @@
 class VelocityField_None
 {
 public:
+    static const bool timeDependent = false;
 
     void setup(float t, DomainInfo domain) {}
 
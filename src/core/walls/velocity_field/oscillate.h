@@ -11,6 +11,9 @@ class ParticleVector;
 class VelocityField_Oscillate
 {
 public:
+    /// the frozen particles follow the velocity at every step, see WallWithVelocity::bounce()
+    static const bool timeDependent = true;
+
     VelocityField_Oscillate(float3 vel, float period) :
         vel(vel), period(period)
     {
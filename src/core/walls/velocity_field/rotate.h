@@ -11,6 +11,8 @@ class ParticleVector;
 class VelocityField_Rotate
 {
 public:
+    static const bool timeDependent = false;
+
     VelocityField_Rotate(float3 omega, float3 center) :
         omega(omega), center(center)
     {}
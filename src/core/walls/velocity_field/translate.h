@@ -11,6 +11,8 @@ class ParticleVector;
 class VelocityField_Translate
 {
 public:
+    static const bool timeDependent = false;
+
     VelocityField_Translate(float3 vel) :
         vel(vel)
     {}
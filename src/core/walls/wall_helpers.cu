@@ -2,6 +2,7 @@
 
 #include <core/celllist.h>
 #include <core/logger.h>
+#include <core/marching_cubes.h>
 #include <core/pvs/particle_vector.h>
 #include <core/pvs/views/pv.h>
 #include <core/utils/cuda_common.h>
@@ -45,6 +46,32 @@ __global__ void collectFrozen(PVview view, const float *sdfs, float minVal, floa
     }
 }
 
+/// One thread per particle of each copy of the tile, keep the ones in the local domain
+__global__ void copyTiles(int tileParticles, const Particle *tile, float3 tileSize, int3 firstTile, int3 nTiles,
+                          DomainInfo domain, float4 *particles, int *nParticles)
+{
+    const int i = blockIdx.x * blockDim.x + threadIdx.x;
+    const int copy = i / tileParticles;
+    if (copy >= nTiles.x * nTiles.y * nTiles.z) return;
+
+    const int3 tileId = make_int3(copy % nTiles.x, (copy / nTiles.x) % nTiles.y, copy / (nTiles.x * nTiles.y)) + firstTile;
+
+    Particle p = tile[i % tileParticles];
+    const float3 r = make_float3(tileId) * tileSize + p.r - domain.globalStart;
+
+    if (r.x < 0.0f || r.x >= domain.localSize.x ||
+        r.y < 0.0f || r.y >= domain.localSize.y ||
+        r.z < 0.0f || r.z >= domain.localSize.z)
+        return;
+
+    p.r = r - 0.5f * domain.localSize;
+    p.u = make_float3(0.0f);
+    p.i1 = i;
+
+    const int ind = atomicAggInc(nParticles);
+    p.write2Float4(particles, ind);
+}
+
 __global__ void initRandomPositions(int n, float3 *positions, long seed, float3 localSize)
 {
     const int i = blockIdx.x * blockDim.x + threadIdx.x;
@@ -63,6 +90,15 @@ __global__ void initRandomPositions(int n, float3 *positions, long seed, float3
     positions[i] = r;
 }
 
+__global__ void initNodePositions(int3 nNodes, float3 h, float3 origin, float3 *positions)
+{
+    const int i = blockIdx.x * blockDim.x + threadIdx.x;
+    if (i >= nNodes.x * nNodes.y * nNodes.z) return;
+
+    const int3 node = make_int3(i % nNodes.x, (i / nNodes.x) % nNodes.y, i / (nNodes.x * nNodes.y));
+    positions[i] = origin + make_float3(node) * h;
+}
+
 __global__ void countInside(int n, const float *sdf, int *nInside, float threshold = 0.f)
 {
     const int i = blockIdx.x * blockDim.x + threadIdx.x;
@@ -153,6 +189,34 @@ void freezeParticlesInWalls(std::vector<SDF_basedWall*> walls, ParticleVector *p
 }
 
 
+void tileParticles(ParticleVector *pv, const PinnedBuffer<Particle>& tile, float3 tileSize, DomainInfo domain)
+{
+    const int3 firstTile = make_int3( floorf( domain.globalStart                     / tileSize) );
+    const int3 endTile   = make_int3( ceilf ((domain.globalStart + domain.localSize) / tileSize) );
+    const int3 nTiles = endTile - firstTile;
+
+    const int n = nTiles.x * nTiles.y * nTiles.z * tile.size();
+    const int nthreads = 128;
+
+    PinnedBuffer<int> nParticles(1);
+    nParticles.clear(defaultStream);
+
+    auto lpv = pv->local();
+    lpv->resize_anew(n);
+
+    SAFE_KERNEL_LAUNCH(
+        WallHelpersKernels::copyTiles,
+        getNblocks(n, nthreads), nthreads, 0, defaultStream,
+        tile.size(), tile.devPtr(), tileSize, firstTile, nTiles,
+        domain, (float4*)lpv->coosvels.devPtr(), nParticles.devPtr() );
+
+    nParticles.downloadFromDevice(defaultStream, ContainersSynch::Synch);
+    lpv->resize(nParticles[0], defaultStream);
+
+    info("Tiled %d times a box of %d particles, keeping %d particles in the local domain",
+         nTiles.x * nTiles.y * nTiles.z, tile.size(), nParticles[0]);
+}
+
 void dumpWalls2XDMF(std::vector<SDF_basedWall*> walls, float3 gridH, DomainInfo domain, std::string filename, MPI_Comm cartComm)
 {
     CUDA_Check( cudaDeviceSynchronize() );
@@ -188,6 +252,67 @@ void dumpWalls2XDMF(std::vector<SDF_basedWall*> walls, float3 gridH, DomainInfo
     XDMF::write(filename, &grid, std::vector<XDMF::Channel>{sdfCh}, cartComm);
 }
 
+void sdfOnNodes(std::vector<SDF_basedWall*> walls, int3 nNodes, float3 h, float3 origin,
+                DeviceBuffer<float>& sdfs, cudaStream_t stream)
+{
+    const int n = nNodes.x * nNodes.y * nNodes.z;
+
+    DeviceBuffer<float3> positions(n);
+    DeviceBuffer<float> wallSdfs(n);
+    sdfs.resize_anew(n);
+
+    const int nthreads = 128;
+    const int nblocks = getNblocks(n, nthreads);
+    const float initial = -1e5;
+
+    SAFE_KERNEL_LAUNCH(
+        WallHelpersKernels::initNodePositions,
+        nblocks, nthreads, 0, stream,
+        nNodes, h, origin, positions.devPtr());
+
+    SAFE_KERNEL_LAUNCH(
+        WallHelpersKernels::init_sdf,
+        nblocks, nthreads, 0, stream,
+        n, sdfs.devPtr(), initial);
+
+    for (auto& wall : walls)
+    {
+        wall->sdfPerPosition(&positions, &wallSdfs, stream);
+
+        SAFE_KERNEL_LAUNCH(
+            WallHelpersKernels::merge_sdfs,
+            nblocks, nthreads, 0, stream,
+            n, wallSdfs.devPtr(), sdfs.devPtr());
+    }
+}
+
+void dumpWallSurface2XDMF(std::vector<SDF_basedWall*> walls, float3 gridH, DomainInfo domain, std::string filename, MPI_Comm cartComm)
+{
+    CUDA_Check( cudaDeviceSynchronize() );
+
+    // the nodes span the whole subdomain, such that the surfaces of neighbouring ranks join
+    const int3 nCells = max( make_int3(1), make_int3( ceilf(domain.localSize / gridH - 1e-6f) ) );
+    const float3 h = domain.localSize / make_float3(nCells);
+    const float3 origin = -0.5f * domain.localSize;
+
+    DeviceBuffer<float> sdfs;
+    sdfOnNodes(walls, nCells + 1, h, origin, sdfs, defaultStream);
+
+    MarchingCubes::GPUMarchingCubes marchingCubes;
+    marchingCubes.compute(sdfs.devPtr(), nCells + 1, h, origin, 0.0f, defaultStream);
+
+    std::vector<MarchingCubes::Triangle> triangles;
+    marchingCubes.download(triangles, defaultStream);
+
+    for (auto& t : triangles)
+    {
+        t.a = domain.local2global(t.a);
+        t.b = domain.local2global(t.b);
+        t.c = domain.local2global(t.c);
+    }
+
+    MarchingCubes::dumpTriangles2XDMF(filename, triangles, 0.0f, cartComm);
+}
 
 double volumeInsideWalls(std::vector<SDF_basedWall*> walls, DomainInfo domain, MPI_Comm comm, long nSamplesPerRank)
 {
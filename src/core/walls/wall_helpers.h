@@ -3,6 +3,8 @@
 #include <vector>
 #include <string>
 #include <mpi.h>
+#include <core/containers.h>
+#include <core/datatypes.h>
 #include <core/domain.h>
 
 #include <cuda_runtime.h>
@@ -13,6 +15,26 @@ class ParticleVector;
 void freezeParticlesInWall(SDF_basedWall *wall, ParticleVector *pv, float minVal, float maxVal);
 void freezeParticlesInWalls(std::vector<SDF_basedWall*> walls, ParticleVector *pv, float minVal, float maxVal);
 
+/**
+ * Fill the local domain of \p pv with copies of the periodic \p tile of size \p tileSize,
+ * the tiles being aligned with the origin of the global domain.
+ * Particles of the tile are in [0, tileSize)
+ */
+void tileParticles(ParticleVector *pv, const PinnedBuffer<Particle>& tile, float3 tileSize, DomainInfo domain);
+
 void dumpWalls2XDMF(std::vector<SDF_basedWall*> walls, float3 gridH, DomainInfo domain, std::string filename, MPI_Comm cartComm);
 
+/**
+ * Merged SDF of the \p walls at the nodes of a grid of \p nNodes nodes spaced by \p h,
+ * the first node at \p origin in local coordinates; x is the fastest index
+ */
+void sdfOnNodes(std::vector<SDF_basedWall*> walls, int3 nNodes, float3 h, float3 origin,
+                DeviceBuffer<float>& sdfs, cudaStream_t stream);
+
+/**
+ * Write the zero isosurface of the merged SDF of the \p walls as an XDMF triangle mesh,
+ * extracted on the GPU by marching cubes over a grid of spacing close to \p gridH
+ */
+void dumpWallSurface2XDMF(std::vector<SDF_basedWall*> walls, float3 gridH, DomainInfo domain, std::string filename, MPI_Comm cartComm);
+
 double volumeInsideWalls(std::vector<SDF_basedWall*> walls, DomainInfo domain, MPI_Comm comm, long nSamplesPerRank);
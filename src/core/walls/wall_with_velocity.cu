@@ -4,6 +4,7 @@
 #include "stationary_walls/box.h"
 #include "stationary_walls/cylinder.h"
 #include "stationary_walls/plane.h"
+#include "stationary_walls/rotating_sdf.h"
 #include "stationary_walls/sdf.h"
 #include "stationary_walls/sphere.h"
 #include "velocity_field/oscillate.h"
@@ -78,6 +79,26 @@ void WallWithVelocity<InsideWallChecker, VelocityField>::attachFrozen(ParticleVe
     CUDA_Check( cudaDeviceSynchronize() );
 }
 
+template<class InsideWallChecker, class VelocityField>
+void WallWithVelocity<InsideWallChecker, VelocityField>::imposeFrozenVelocities(cudaStream_t stream)
+{
+    auto pv = this->frozen;
+    const int nthreads = 128;
+
+    // the halo is updated in place, the field is given in local coordinates: nothing is exchanged
+    for (auto lpv : {pv->local(), pv->halo()})
+    {
+        PVview view(pv, lpv);
+        SAFE_KERNEL_LAUNCH(
+                imposeVelField,
+                getNblocks(view.size, nthreads), nthreads, 0, stream,
+                view, velField.handler() );
+    }
+
+    // the secondary cell-lists hold copies of the velocities
+    pv->cellListStamp++;
+}
+
 template<class InsideWallChecker, class VelocityField>
 void WallWithVelocity<InsideWallChecker, VelocityField>::bounce(cudaStream_t stream)
 {
@@ -87,6 +108,9 @@ void WallWithVelocity<InsideWallChecker, VelocityField>::bounce(cudaStream_t str
     velField.setup(t, this->state->domain);
     this->bounceForce.clear(stream);
 
+    if (VelocityField::timeDependent && this->frozen != nullptr)
+        imposeFrozenVelocities(stream);
+
     for (int i=0; i < this->particleVectors.size(); i++)
     {
         auto  pv = this->particleVectors[i];
@@ -115,6 +139,7 @@ template class WallWithVelocity<StationaryWall_Sphere,   VelocityField_Rotate>;
 template class WallWithVelocity<StationaryWall_Cylinder, VelocityField_Rotate>;
 template class WallWithVelocity<StationaryWall_Plane,    VelocityField_Translate>;
 template class WallWithVelocity<StationaryWall_Plane,    VelocityField_Oscillate>;
+template class WallWithVelocity<StationaryWall_RotatingSDF, VelocityField_Rotate>;
 
 
 
@@ -21,6 +21,12 @@ public:
 
     void bounce(cudaStream_t stream) override;
 
+    /// the fused bounce assumes a wall at rest
+    bool fuseBounce(ParticleVector *pv) override { return false; }
+
 protected:
     VelocityField velField;
+
+    /// the velocities of static frozen particles only change with a time dependent velocity field
+    void imposeFrozenVelocities(cudaStream_t stream);
 };
@@ -2,10 +2,13 @@
 
 #include <core/logger.h>
 
+#include <stdexcept>
+
 namespace XDMF
 {
-Channel::Channel(std::string name, void* data, DataForm dataForm, NumberType numberType, DataType dataType) :
-    name(name), data(data), dataForm(dataForm), numberType(numberType), dataType(dataType)
+Channel::Channel(std::string name, void* data, DataForm dataForm, NumberType numberType, DataType dataType,
+                 Compression compression) :
+    name(name), data(data), dataForm(dataForm), numberType(numberType), dataType(dataType), compression(compression)
 {}
 
 int Channel::nComponents() const
@@ -109,4 +112,50 @@ Channel::NumberType infoToNumberType(std::string str, int precision)
     die("NumberType '%s' with precision %d is not supported for reading", str.c_str(), precision);
 }
 
+Compression stringToCompression(std::string str)
+{
+    Compression compression;
+
+    auto pos = str.find(':');
+    std::string filter = str.substr(0, pos);
+    std::string param  = pos == std::string::npos ? "" : str.substr(pos+1);
+
+    try
+    {
+        if (filter == "none" || filter == "")
+        {
+            compression.filter = Compression::Filter::None;
+        }
+        else if (filter == "mappable")
+        {
+            compression.filter   = Compression::Filter::None;
+            compression.mappable = true;
+        }
+        else if (filter == "deflate")
+        {
+            compression.filter = Compression::Filter::Deflate;
+            if (param != "") compression.deflateLevel = std::stoi(param);
+
+            if (compression.deflateLevel < 1 || compression.deflateLevel > 9)
+                die("Deflate level must be within [1, 9], got %d", compression.deflateLevel);
+        }
+        else if (filter == "zfp")
+        {
+            compression.filter = Compression::Filter::ZFP;
+            if (param != "") compression.zfpTolerance = std::stod(param);
+
+            if (compression.zfpTolerance <= 0.0)
+                die("ZFP tolerance must be positive, got %g", compression.zfpTolerance);
+        }
+        else
+            die("Unknown compression '%s', expected 'none', 'mappable', 'deflate[:level]' or 'zfp[:tolerance]'", str.c_str());
+    }
+    catch (const std::logic_error&)
+    {
+        die("Could not parse the parameter of the compression '%s'", str.c_str());
+    }
+
+    return compression;
+}
+
 } // namespace XDMF
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <map>
 #include <string>
 #include <hdf5.h>
 
@@ -7,6 +8,36 @@
 
 namespace XDMF
 {
+/**
+ * Layout of the HDF5 dataset of a channel.
+ * Without filter, the dataset is contiguous; otherwise it is chunked
+ * and every chunk is compressed, which needs HDF5 1.10.2 or newer for the parallel writes.
+ * ZFP is lossy and only applies to floating point channels, the other ones are deflated;
+ * it requires the H5Z-ZFP plugin at run time, deflate is used when it is not found.
+ * Mappable channels are uncompressed and contiguous, every dataset of their file starts on a multiple
+ * of mappableAlignment bytes and its offset is published in the .xmf, such that it can be memory-mapped
+ */
+struct Compression
+{
+    enum class Filter
+        {
+         None, Deflate, ZFP
+        } filter {Filter::None};
+
+    int deflateLevel {4};         ///< from 1 (fast) to 9 (small)
+    double zfpTolerance {1e-3};   ///< absolute error bound of ZFP
+
+    /// number of elements per chunk for 1D grids, 0 for the default; multi-dimensional grids use one chunk per rank
+    int chunkSize {0};
+
+    bool mappable {false};        ///< contiguous, aligned and with its offset in the .xmf
+};
+
+const size_t mappableAlignment = 4096;
+
+/// byte offsets in the HDF5 file of the contiguous datasets, by dataset name
+using DataSetOffsets = std::map<std::string, long long>;
+
 struct Channel
 {
     std::string name;
@@ -23,8 +54,11 @@ struct Channel
         } numberType;
 
     DataType dataType;
+
+    Compression compression;
         
-    Channel(std::string name, void *data, DataForm dataForm, NumberType numberType, DataType dataType);
+    Channel(std::string name, void *data, DataForm dataForm, NumberType numberType, DataType dataType,
+            Compression compression = Compression());
     int nComponents() const;
     int precision() const;
 };
@@ -42,4 +76,7 @@ int                         numberTypeToPrecision (Channel::NumberType dt);
 
 Channel::NumberType infoToNumberType(std::string str, int precision);
 
+/// parse "none", "mappable", "deflate[:level]" or "zfp[:tolerance]"
+Compression stringToCompression(std::string str);
+
 } // namespace XDMF
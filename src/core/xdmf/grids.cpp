@@ -3,6 +3,7 @@
 #include "hdf5_helpers.h"
 
 #include <core/logger.h>
+#include <core/utils/make_unique.h>
 
 namespace XDMF
 {
@@ -214,6 +215,16 @@ void VertexGrid::split_read_access(MPI_Comm comm, int chunk_size)
     dims.nlocal = nchunks_local * chunk_size;
     dims.offset = chunks_offset * chunk_size;
 }
+
+void VertexGrid::set_read_access(hsize_t offset, hsize_t n)
+{
+    if (offset + n > dims.nglobal)
+        die("Read range [%lld, %lld) is out of the %lld elements of the file",
+            (long long) offset, (long long) (offset + n), (long long) dims.nglobal);
+
+    dims.nlocal = n;
+    dims.offset = offset;
+}
     
 void VertexGrid::read_from_HDF5(hid_t file_id, MPI_Comm comm)
 {
@@ -223,6 +234,11 @@ void VertexGrid::read_from_HDF5(hid_t file_id, MPI_Comm comm)
         
     HDF5::readDataSet(file_id, getGridDims(), posCh);
 }
+
+std::unique_ptr<Grid> VertexGrid::makeSubfileGrid(MPI_Comm subComm) const
+{
+    return std::make_unique<VertexGrid>(positions, subComm);
+}
         
 VertexGrid::VertexGrid(std::shared_ptr<std::vector<float>> positions, MPI_Comm comm) :
     positions(positions), dims(positions->size() / 3, comm)
@@ -247,6 +263,8 @@ void TriangleMeshGrid::write_to_HDF5(hid_t file_id, MPI_Comm comm) const
 {
     VertexGrid::write_to_HDF5(file_id, comm);
 
+    if (!topologyFile.empty()) return;
+
     Channel triCh(triangleChannelName, (void*) triangles->data(),
                   Channel::DataForm::Triangle, Channel::NumberType::Int, typeTokenize<int>());        
 
@@ -260,6 +278,10 @@ TriangleMeshGrid::TriangleMeshGrid(std::shared_ptr<std::vector<float>> positions
         die("connectivity: expected size is multiple of 3; given %d\n", triangles->size());
 }
 
+TriangleMeshGrid::TriangleMeshGrid(std::shared_ptr<std::vector<float>> positions, long nTriangles, std::string topologyFile, MPI_Comm comm) :
+    VertexGrid(positions, comm), triangles(nullptr), dimsTriangles(nTriangles, comm), topologyFile(topologyFile)
+{}
+
 void TriangleMeshGrid::_writeTopology(pugi::xml_node& topoNode, std::string h5filename) const
 {
     topoNode.append_attribute("TopologyType") = "Triangle";
@@ -272,7 +294,7 @@ void TriangleMeshGrid::_writeTopology(pugi::xml_node& topoNode, std::string h5fi
     triangleNode.append_attribute("NumberType") = numberTypeToString(Channel::NumberType::Int).c_str();
     triangleNode.append_attribute("Precision") = std::to_string(numberTypeToPrecision(Channel::NumberType::Int)).c_str();
     triangleNode.append_attribute("Format") = "HDF";
-    triangleNode.text() = (h5filename + ":/" + triangleChannelName).c_str();
+    triangleNode.text() = ((topologyFile.empty() ? h5filename : topologyFile) + ":/" + triangleChannelName).c_str();
 
 }
 
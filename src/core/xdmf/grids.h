@@ -39,6 +39,12 @@ public:
     virtual void read_from_XMF(const pugi::xml_node &node, std::string &h5filename)         = 0;
     virtual void split_read_access(MPI_Comm comm, int chunk_size=1)                         = 0;
     virtual void read_from_HDF5(hid_t file_id, MPI_Comm comm)                               = 0;        
+
+    /**
+     * The same local data described on \p subComm, a subset of the ranks of the grid,
+     * to write a subfile (see XDMF::write()); nullptr if the grid can not be split
+     */
+    virtual std::unique_ptr<Grid> makeSubfileGrid(MPI_Comm subComm) const { return nullptr; }
         
     virtual ~Grid() = default;
 };
@@ -106,6 +112,11 @@ public:
     void read_from_XMF(const pugi::xml_node &node, std::string &h5filename)         override;
     void split_read_access(MPI_Comm comm, int chunk_size = 1)                       override;
     void read_from_HDF5(hid_t file_id, MPI_Comm comm)                               override;
+
+    /// read the \p n elements starting at \p offset of the file
+    void set_read_access(hsize_t offset, hsize_t n);
+
+    std::unique_ptr<Grid> makeSubfileGrid(MPI_Comm subComm) const override;
         
     VertexGrid(std::shared_ptr<std::vector<float>> positions, MPI_Comm comm);
         
@@ -124,14 +135,28 @@ public:
     std::shared_ptr<std::vector<int>> getTriangles() const;
         
     void write_to_HDF5(hid_t file_id, MPI_Comm comm) const override;
+
+    /// the connectivity refers to the global vertex ids, not supported
+    std::unique_ptr<Grid> makeSubfileGrid(MPI_Comm subComm) const override { return nullptr; }
                 
     TriangleMeshGrid(std::shared_ptr<std::vector<float>> positions, std::shared_ptr<std::vector<int>> triangles, MPI_Comm comm);
+
+    /**
+     * Grid with a shared topology: only the positions are written, the topology refers
+     * to the triangles of another grid, already written to \p topologyFile (relative to the xmf file),
+     * e.g. all the dumps of the same objects.
+     * \p nTriangles is the local number of triangles
+     */
+    TriangleMeshGrid(std::shared_ptr<std::vector<float>> positions, long nTriangles, std::string topologyFile, MPI_Comm comm);
         
 protected:
     const std::string triangleChannelName = "triangle";
     VertexGridDims dimsTriangles;
     std::shared_ptr<std::vector<int>> triangles;
 
+    /// h5 file of the triangles, empty if they are written with the positions
+    std::string topologyFile;
+
     void _writeTopology(pugi::xml_node& topoNode, std::string h5filename) const override;
 };
 
@@ -1,6 +1,8 @@
 #include "hdf5_helpers.h"
 
 #include <core/logger.h>
+
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 
@@ -45,9 +47,12 @@ static hid_t createFileAccess(MPI_Comm comm)
     return plist_id_access;
 }
         
-hid_t create(std::string filename, MPI_Comm comm)
+hid_t create(std::string filename, MPI_Comm comm, bool aligned)
 {
     hid_t access_id = createFileAccess(comm);
+    if (aligned)
+        H5Pset_alignment(access_id, 0, mappableAlignment);
+
     hid_t file_id   = H5Fcreate( filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, access_id );
     H5Pclose(access_id);
             
@@ -63,6 +68,99 @@ hid_t openReadOnly(std::string filename, MPI_Comm comm)
     return file_id;
 }
         
+// http://github.com/LLNL/H5Z-ZFP
+static const H5Z_filter_t zfpFilterId = 32013;
+static const unsigned int zfpModeAccuracy = 3;
+
+// elements per chunk of the 1D grids
+static const hsize_t defaultChunkSize = 1 << 16;
+
+static bool zfpAvailable()
+{
+    static const bool available = H5Zfilter_avail(zfpFilterId) > 0;
+    return available;
+}
+
+/**
+ * Chunk the dataset and set its filters as given by the channel.
+ * Multi-dimensional (uniform) grids get one chunk per rank, such that every rank
+ * compresses whole chunks; 1D grids have fixed size chunks.
+ * ZFP chunks keep one component, such that it only sees the spatial dimensions
+ */
+static hid_t createDataSetProperties(const GridDims* gridDims, const Channel& channel,
+                                     const std::vector<hsize_t>& localSize, const std::vector<hsize_t>& globalSize)
+{
+    hid_t dcpl_id = H5Pcreate(H5P_DATASET_CREATE);
+
+    const auto& compression = channel.compression;
+
+    // the space is reserved at creation and never filled, the file holds the raw values only
+    if (compression.mappable)
+    {
+        H5Pset_layout   (dcpl_id, H5D_CONTIGUOUS);
+        H5Pset_alloc_time(dcpl_id, H5D_ALLOC_TIME_EARLY);
+        H5Pset_fill_time(dcpl_id, H5D_FILL_TIME_NEVER);
+        return dcpl_id;
+    }
+
+    if (compression.filter == Compression::Filter::None || gridDims->globalEmpty())
+        return dcpl_id;
+
+#if !H5_VERSION_GE(1, 10, 2)
+    static bool warned = false;
+    if (!warned) warn("HDF5 is older than 1.10.2, compressed parallel writes are not supported, data will not be compressed");
+    warned = true;
+    return dcpl_id;
+#endif
+
+    const bool isFloat = channel.numberType == Channel::NumberType::Float ||
+                         channel.numberType == Channel::NumberType::Double;
+
+    bool useZfp = compression.filter == Compression::Filter::ZFP && isFloat;
+    if (useZfp && !zfpAvailable())
+    {
+        static bool warned = false;
+        if (!warned) warn("HDF5 ZFP filter is not available, falling back to deflate");
+        warned = true;
+        useZfp = false;
+    }
+
+    const int ndims = globalSize.size();
+    std::vector<hsize_t> chunk;
+
+    if (gridDims->getDims() > 1)
+    {
+        // all the ranks have the same local size
+        chunk = localSize;
+        for (int i = 0; i < ndims; i++)
+            chunk[i] = std::max<hsize_t>(chunk[i], 1);
+    }
+    else
+    {
+        const hsize_t n = compression.chunkSize > 0 ? compression.chunkSize : defaultChunkSize;
+        chunk = { std::min(n, globalSize[0]), globalSize[1] };
+    }
+
+    if (useZfp)
+        chunk.back() = 1;
+
+    H5Pset_chunk(dcpl_id, ndims, chunk.data());
+
+    if (useZfp)
+    {
+        unsigned int cd_values[4] = {zfpModeAccuracy, 0, 0, 0};
+        memcpy(cd_values + 2, &compression.zfpTolerance, sizeof(double));
+        H5Pset_filter(dcpl_id, zfpFilterId, H5Z_FLAG_MANDATORY, 4, cd_values);
+    }
+    else
+    {
+        H5Pset_shuffle(dcpl_id);
+        H5Pset_deflate(dcpl_id, compression.deflateLevel);
+    }
+
+    return dcpl_id;
+}
+
 void writeDataSet(hid_t file_id, const GridDims* gridDims, const Channel& channel)
 {
     debug2("Writing channel '%s'", channel.name.c_str());
@@ -84,7 +182,9 @@ void writeDataSet(hid_t file_id, const GridDims* gridDims, const Channel& channe
             
     hid_t filespace_simple = H5Screate_simple(ndims, globalSize.data(), nullptr);
 
-    hid_t dset_id = H5Dcreate(file_id, channel.name.c_str(), numberType, filespace_simple, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    hid_t dcpl_id = createDataSetProperties(gridDims, channel, localSize, globalSize);
+
+    hid_t dset_id = H5Dcreate(file_id, channel.name.c_str(), numberType, filespace_simple, H5P_DEFAULT, dcpl_id, H5P_DEFAULT);
     hid_t xfer_plist_id = H5Pcreate(H5P_DATASET_XFER);
 
     H5Pset_dxpl_mpio(xfer_plist_id, H5FD_MPIO_COLLECTIVE);
@@ -104,7 +204,9 @@ void writeDataSet(hid_t file_id, const GridDims* gridDims, const Channel& channe
 
     H5Sclose(mspace_id);
     H5Sclose(dspace_id);
+    H5Sclose(filespace_simple);
     H5Pclose(xfer_plist_id);
+    H5Pclose(dcpl_id);
     H5Dclose(dset_id);
 }
         
@@ -161,20 +263,61 @@ void close(hid_t file_id)
 {
     H5Fclose(file_id);
 }
+
+static herr_t addDataSetOffset(hid_t group_id, const char *name, const H5L_info_t *info, void *data)
+{
+    auto& offsets = *static_cast<DataSetOffsets*>(data);
+
+    hid_t obj_id = H5Oopen(group_id, name, H5P_DEFAULT);
+    if (obj_id < 0) return 0;
+
+    if (H5Iget_type(obj_id) == H5I_DATASET)
+    {
+        // undefined for the chunked and the empty datasets
+        haddr_t offset = H5Dget_offset(obj_id);
+        if (offset != HADDR_UNDEF)
+            offsets[name] = offset;
+    }
+
+    H5Oclose(obj_id);
+    return 0;
+}
+
+DataSetOffsets getDataSetOffsets(hid_t file_id)
+{
+    DataSetOffsets offsets;
+    hsize_t idx = 0;
+    H5Literate(file_id, H5_INDEX_NAME, H5_ITER_NATIVE, &idx, addDataSetOffset, &offsets);
+    return offsets;
+}
+
+static bool anyMappable(const std::vector<Channel>& channels)
+{
+    return std::any_of(channels.begin(), channels.end(),
+                       [] (const Channel& ch) { return ch.compression.mappable; });
+}
         
-void write(std::string filename, MPI_Comm comm, const Grid *grid, const std::vector<Channel>& channels)
+DataSetOffsets write(std::string filename, MPI_Comm comm, const Grid *grid, const std::vector<Channel>& channels)
 {
-    auto file_id = create(filename, comm);
+    const bool mappable = anyMappable(channels);
+
+    auto file_id = create(filename, comm, mappable);
     if (file_id < 0)
     {
         if (file_id < 0) error("HDF5 failed to write to file '%s'", filename.c_str());
-        return;
+        return {};
     }
             
     grid->write_to_HDF5(file_id, comm);
     writeData(file_id, grid->getGridDims(), channels);
+
+    // the metadata is the same on all the ranks
+    DataSetOffsets offsets;
+    if (mappable)
+        offsets = getDataSetOffsets(file_id);
             
     close(file_id);
+    return offsets;
 }
 
 void read(std::string filename, MPI_Comm comm, Grid *grid, std::vector<Channel>& channels)
@@ -13,7 +13,8 @@ namespace XDMF
 namespace HDF5
 {
 
-hid_t create(std::string filename, MPI_Comm comm);
+/// \p aligned files start every dataset on a multiple of mappableAlignment bytes
+hid_t create(std::string filename, MPI_Comm comm, bool aligned = false);
 hid_t openReadOnly(std::string filename, MPI_Comm comm);
 
 void writeDataSet(hid_t file_id, const GridDims* gridDims, const Channel& channel);
@@ -23,9 +24,15 @@ void readDataSet (hid_t file_id, const GridDims* gridDims, Channel& channel);
 void readData    (hid_t file_id, const GridDims* gridDims, std::vector<Channel>& channels);
 
 void close       (hid_t file_id);
-    
 
-void write(std::string filename, MPI_Comm comm, const Grid *grid, const std::vector<Channel>& channels);
+/// offsets of the contiguous datasets of the root group
+DataSetOffsets getDataSetOffsets(hid_t file_id);
+
+/**
+ * Write the grid and the channels, collective.
+ * @return the offsets of the datasets if any channel is mappable, nothing otherwise
+ */
+DataSetOffsets write(std::string filename, MPI_Comm comm, const Grid *grid, const std::vector<Channel>& channels);
 void read(std::string filename, MPI_Comm comm, Grid *grid, std::vector<Channel>& channels);
 
 } // namespace HDF5
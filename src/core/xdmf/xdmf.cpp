@@ -6,6 +6,8 @@
 
 #include <hdf5.h>
 
+#include <algorithm>
+
 #include <core/logger.h>
 #include <core/utils/timer.h>
 #include <core/utils/folders.h>
@@ -22,8 +24,9 @@ void write(std::string filename, const Grid* grid, const std::vector<Channel>& c
 
     mTimer timer;
     timer.start();
-    XMF::write(xmfFilename, relativePath(h5Filename), comm, grid, channels, time);
-    HDF5::write(h5Filename, comm, grid, channels);
+    // the offsets of the datasets are only known once they are written
+    auto offsets = HDF5::write(h5Filename, comm, grid, channels);
+    XMF::write(xmfFilename, relativePath(h5Filename), comm, grid, channels, time, offsets);
     info("Writing took %f ms", timer.elapsed());
 }
     
@@ -32,6 +35,76 @@ void write(std::string filename, const Grid* grid, const std::vector<Channel>& c
     write(filename, grid, channels, -1, comm);
 }
 
+static int countNodes(MPI_Comm comm)
+{
+    int rank, nodeRank, isLeader, nnodes;
+    MPI_Comm nodeComm;
+
+    MPI_Check( MPI_Comm_rank(comm, &rank) );
+    MPI_Check( MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &nodeComm) );
+    MPI_Check( MPI_Comm_rank(nodeComm, &nodeRank) );
+
+    isLeader = (nodeRank == 0);
+    MPI_Check( MPI_Allreduce(&isLeader, &nnodes, 1, MPI_INT, MPI_SUM, comm) );
+    MPI_Check( MPI_Comm_free(&nodeComm) );
+
+    return nnodes;
+}
+
+void write(std::string filename, const Grid* grid, const std::vector<Channel>& channels, float time, MPI_Comm comm,
+           int nSubfiles)
+{
+    int rank, size;
+    MPI_Check( MPI_Comm_rank(comm, &rank) );
+    MPI_Check( MPI_Comm_size(comm, &size) );
+
+    if (nSubfiles == subfilesPerNode)
+        nSubfiles = countNodes(comm);
+    nSubfiles = std::min(nSubfiles, size);
+
+    if (nSubfiles <= 1)
+    {
+        write(filename, grid, channels, time, comm);
+        return;
+    }
+
+    const int subfileId = (long long) rank * nSubfiles / size;
+
+    MPI_Comm subComm;
+    MPI_Check( MPI_Comm_split(comm, subfileId, rank, &subComm) );
+
+    auto subgrid = grid->makeSubfileGrid(subComm);
+    if (!subgrid)
+    {
+        MPI_Check( MPI_Comm_free(&subComm) );
+        warn("Grid of '%s' can not be split into subfiles, writing a single file", filename.c_str());
+        write(filename, grid, channels, time, comm);
+        return;
+    }
+
+    int subRank;
+    MPI_Check( MPI_Comm_rank(subComm, &subRank) );
+
+    std::string h5Filename  = filename + ".sub" + getStrZeroPadded(subfileId, 4) + ".h5";
+    std::string xmfFilename = filename + ".xmf";
+
+    info("Writing XDMF data to %s[.subNNNN.h5,.xmf] in %d subfiles", filename.c_str(), nSubfiles);
+
+    mTimer timer;
+    timer.start();
+
+    auto offsets = HDF5::write(h5Filename, subComm, subgrid.get(), channels);
+
+    std::string localGrid;
+    if (subRank == 0)
+        localGrid = XMF::gridToString(relativePath(h5Filename), subgrid.get(), channels, offsets);
+
+    XMF::writeSpatialCollection(xmfFilename, comm, localGrid, time);
+
+    MPI_Check( MPI_Comm_free(&subComm) );
+    info("Writing took %f ms", timer.elapsed());
+}
+
 static long getLocalNumElements(const GridDims *gridDims)
 {
     long n = 1;
@@ -265,6 +338,70 @@ void readParticleData(std::string filename, MPI_Comm comm, ParticleVector *pv, i
     readData(filename, comm, pv, chunk_size);
 }
 
+void readParticleData(std::string filename, MPI_Comm comm, ParticleVector *pv,
+                      const std::vector<std::pair<long long, long long>>& ranges)
+{
+    info("Reading XDMF data from %s, %d ranges", filename.c_str(), (int) ranges.size());
+
+    std::string h5filename;
+
+    auto positions = std::make_shared<std::vector<float>>();
+    std::vector<std::vector<char>> channelData;
+    std::vector<Channel> channels;
+
+    VertexGrid grid(positions, comm);
+
+    mTimer timer;
+    timer.start();
+    XMF::read(filename, comm, h5filename, &grid, channels);
+
+    h5filename = parentPath(filename) + h5filename;
+
+    long long nElements = 0;
+    for (auto& r : ranges) nElements += r.second;
+
+    channelData.resize(channels.size());
+    for (int i = 0; i < channels.size(); ++i) {
+        channelData[i].resize(nElements * channels[i].nComponents() * channels[i].precision());
+        channels[i].data = channelData[i].data();
+    }
+
+    // reads are collective, the ranks with fewer ranges do empty reads
+    int nRanges = ranges.size(), maxRanges = 0;
+    MPI_Check( MPI_Allreduce(&nRanges, &maxRanges, 1, MPI_INT, MPI_MAX, comm) );
+
+    auto file_id = HDF5::openReadOnly(h5filename, comm);
+    if (file_id < 0)
+        die("HDF5 failed to read from file '%s'", h5filename.c_str());
+
+    std::vector<float> allPositions;
+    allPositions.reserve(3 * nElements);
+
+    long long done = 0;
+    for (int r = 0; r < maxRanges; r++)
+    {
+        const long long offset = r < nRanges ? ranges[r].first  : 0;
+        const long long n      = r < nRanges ? ranges[r].second : 0;
+
+        grid.set_read_access(offset, n);
+        grid.read_from_HDF5(file_id, comm);
+        allPositions.insert(allPositions.end(), positions->begin(), positions->end());
+
+        auto rangeChannels = channels;
+        for (int i = 0; i < channels.size(); ++i)
+            rangeChannels[i].data = channelData[i].data() + done * channels[i].nComponents() * channels[i].precision();
+
+        HDF5::readData(file_id, grid.getGridDims(), rangeChannels);
+        done += n;
+    }
+
+    HDF5::close(file_id);
+    info("Reading took %f ms", timer.elapsed());
+
+    *positions = std::move(allPositions);
+    gatherFromChannels(channels, *positions, pv);
+}
+
     
 void readObjectData(std::string filename, MPI_Comm comm, ObjectVector *ov)
 {
@@ -14,7 +14,26 @@ namespace XDMF
 void write(std::string filename, const Grid* grid, const std::vector<Channel>& channels, float time, MPI_Comm comm);
 void write(std::string filename, const Grid* grid, const std::vector<Channel>& channels, MPI_Comm comm);
 
+/// one subfile per node, see write()
+const int subfilesPerNode = -1;
+
+/**
+ * Write the data into \p nSubfiles HDF5 files instead of a single shared one.
+ * The ranks are split into that many groups of consecutive ranks, each group writes
+ * <filename>.subNNNN.h5 on its own communicator, such that fewer ranks open each file.
+ * The master <filename>.xmf links the subfiles as a spatial collection.
+ * With nSubfiles \c subfilesPerNode, there is one subfile per shared memory node; with 0 or 1,
+ * or if the grid does not support it (see Grid::makeSubfileGrid()), this is the usual write().
+ * The subfiled output can be visualized but not read back with the read functions below.
+ */
+void write(std::string filename, const Grid* grid, const std::vector<Channel>& channels, float time, MPI_Comm comm,
+           int nSubfiles);
+
 void readParticleData(std::string filename, MPI_Comm comm, ParticleVector* pv, int chunk_size = 1);
+
+/// read only the \p ranges [offset, count] of the particles of the file, collective
+void readParticleData(std::string filename, MPI_Comm comm, ParticleVector* pv,
+                      const std::vector<std::pair<long long, long long>>& ranges);
 void readObjectData(std::string filename, MPI_Comm comm, ObjectVector *ov);
 void readRigidObjectData(std::string filename, MPI_Comm comm, RigidObjectVector *rov);
 }
@@ -3,6 +3,8 @@
 
 #include <core/logger.h>
 
+#include <sstream>
+
 namespace XDMF
 {
 namespace XMF
@@ -38,6 +40,37 @@ void writeData(pugi::xml_node node, std::string h5filename, const Grid* grid, co
         writeDataSet(node, h5filename, grid, channel);
 }
 
+/**
+ * Add the byte offset of its dataset to every HDF DataItem of the file \p h5filename.
+ * XDMF readers ignore Seek and Endian for HDF data, they only serve the memory-mapping readers
+ */
+static void publishOffsets(pugi::xml_node node, std::string h5filename, const DataSetOffsets& offsets)
+{
+    if (offsets.empty()) return;
+
+    const std::string prefix = h5filename + ":/";
+    const char *endian = H5Tget_order(H5T_NATIVE_FLOAT) == H5T_ORDER_LE ? "Little" : "Big";
+
+    for (auto child : node.children())
+    {
+        publishOffsets(child, h5filename, offsets);
+
+        if (std::string(child.name()) != "DataItem" || std::string(child.attribute("Format").value()) != "HDF")
+            continue;
+
+        std::string ref = child.text().as_string();
+        if (ref.compare(0, prefix.size(), prefix) != 0)
+            continue;
+
+        auto it = offsets.find(ref.substr(prefix.size()));
+        if (it == offsets.end())
+            continue;
+
+        child.append_attribute("Seek")   = std::to_string(it->second).c_str();
+        child.append_attribute("Endian") = endian;
+    }
+}
+
 static bool isMasterRank(MPI_Comm comm)
 {
     int rank;
@@ -45,7 +78,8 @@ static bool isMasterRank(MPI_Comm comm)
     return (rank == 0);
 }
         
-void write(std::string filename, std::string h5filename, MPI_Comm comm, const Grid *grid, const std::vector<Channel>& channels, float time)
+void write(std::string filename, std::string h5filename, MPI_Comm comm, const Grid *grid, const std::vector<Channel>& channels, float time,
+           const DataSetOffsets& offsets)
 {
     if (isMasterRank(comm)) {
         pugi::xml_document doc;
@@ -57,6 +91,7 @@ void write(std::string filename, std::string h5filename, MPI_Comm comm, const Gr
                 
         if (time > -1e-6) gridNode.append_child("Time").append_attribute("Value") = std::to_string(time).c_str();
         writeData(gridNode, h5filename, grid, channels);
+        publishOffsets(gridNode, h5filename, offsets);
                 
         doc.save_file(filename.c_str());
     }
@@ -64,6 +99,67 @@ void write(std::string filename, std::string h5filename, MPI_Comm comm, const Gr
     MPI_Check( MPI_Barrier(comm) );
 }
 
+std::string gridToString(std::string h5filename, const Grid* grid, const std::vector<Channel>& channels,
+                         const DataSetOffsets& offsets)
+{
+    pugi::xml_document doc;
+    auto gridNode = grid->write_to_XMF(doc, h5filename);
+    writeData(gridNode, h5filename, grid, channels);
+    publishOffsets(gridNode, h5filename, offsets);
+
+    std::ostringstream ss;
+    doc.save(ss, "  ", pugi::format_raw | pugi::format_no_declaration);
+    return ss.str();
+}
+
+void writeSpatialCollection(std::string filename, MPI_Comm comm, const std::string& localGrid, float time)
+{
+    int rank, size;
+    MPI_Check( MPI_Comm_rank(comm, &rank) );
+    MPI_Check( MPI_Comm_size(comm, &size) );
+
+    int localLength = localGrid.size();
+    std::vector<int> lengths(size), offsets(size+1, 0);
+    MPI_Check( MPI_Gather(&localLength, 1, MPI_INT, lengths.data(), 1, MPI_INT, 0, comm) );
+
+    for (int i = 0; i < size; i++)
+        offsets[i+1] = offsets[i] + lengths[i];
+
+    std::vector<char> allGrids(offsets[size]);
+    MPI_Check( MPI_Gatherv(localGrid.data(), localLength, MPI_CHAR,
+                           allGrids.data(), lengths.data(), offsets.data(), MPI_CHAR, 0, comm) );
+
+    if (rank == 0) {
+        pugi::xml_document doc;
+        auto root = doc.append_child("Xdmf");
+        root.append_attribute("Version") = "3.0";
+        auto domain = root.append_child("Domain");
+
+        auto collectionNode = domain.append_child("Grid");
+        collectionNode.append_attribute("Name") = "subfiles";
+        collectionNode.append_attribute("GridType") = "Collection";
+        collectionNode.append_attribute("CollectionType") = "Spatial";
+
+        if (time > -1e-6) collectionNode.append_child("Time").append_attribute("Value") = std::to_string(time).c_str();
+
+        for (int i = 0; i < size; i++)
+        {
+            if (lengths[i] == 0) continue;
+
+            pugi::xml_document fragment;
+            auto parseResult = fragment.load_buffer(allGrids.data() + offsets[i], lengths[i]);
+            if (!parseResult)
+                die("Could not parse the description of subfile from rank %d: %s", i, parseResult.description());
+
+            collectionNode.append_copy(fragment.first_child());
+        }
+
+        doc.save_file(filename.c_str());
+    }
+
+    MPI_Check( MPI_Barrier(comm) );
+}
+
 static Channel readDataSet(pugi::xml_node node)
 {
     auto infoNode = node.child("Information");
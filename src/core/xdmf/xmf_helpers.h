@@ -15,7 +15,20 @@ namespace XMF
 
 void writeDataSet(pugi::xml_node node, std::string h5filename, const Grid* grid, const Channel& channel);
 void writeData   (pugi::xml_node node, std::string h5filename, const Grid* grid, const std::vector<Channel>& channels);
-void write(std::string filename, std::string h5filename, MPI_Comm comm, const Grid* grid, const std::vector<Channel>& channels, float time);
+
+/// the HDF data items listed in \p offsets get their byte offset in the Seek attribute
+void write(std::string filename, std::string h5filename, MPI_Comm comm, const Grid* grid, const std::vector<Channel>& channels, float time,
+           const DataSetOffsets& offsets = {});
+
+/// XML description of the grid node with its channels, as written by write()
+std::string gridToString(std::string h5filename, const Grid* grid, const std::vector<Channel>& channels,
+                         const DataSetOffsets& offsets = {});
+
+/**
+ * Gather the grid descriptions of all the ranks of \p comm to its master rank
+ * and write them as a spatial collection; ranks without subfile give an empty string
+ */
+void writeSpatialCollection(std::string filename, MPI_Comm comm, const std::string& localGrid, float time);
 
 void read(std::string filename, MPI_Comm comm, std::string &h5filename, Grid *grid, std::vector<Channel> &channels);
 
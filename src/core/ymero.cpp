@@ -11,10 +11,15 @@
 #include <core/postproc.h>
 #include <core/pvs/object_vector.h>
 #include <core/pvs/particle_vector.h>
+#include <core/rank_placement.h>
 #include <core/simulation.h>
 #include <core/utils/cuda_common.h>
 #include <core/utils/folders.h>
 #include <core/utils/make_unique.h>
+#include <core/utils/memory_pool.h>
+#include <core/utils/nvtx.h>
+#include <core/utils/perf_counters.h>
+#include <core/utils/preemption.h>
 #include <core/version.h>
 #include <core/walls/interface.h>
 #include <core/walls/simple_stationary_wall.h>
@@ -23,13 +28,10 @@
 
 #include "ymero.h"
 
-static void createCartComm(MPI_Comm comm, int3 nranks3D, MPI_Comm *cartComm)
-{
-    int ranksArr[] = {nranks3D.x, nranks3D.y, nranks3D.z};
-    int periods[] = {1, 1, 1};
-    int reorder = 1;
-    MPI_Check(MPI_Cart_create(comm, 3, ranksArr, periods, reorder, cartComm));
-}
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
 
 /// Map intro-node ranks to different GPUs
 /// https://stackoverflow.com/a/40122688/3535276
@@ -57,8 +59,17 @@ static void selectIntraNodeGPU(const MPI_Comm& source)
     MPI_Check( MPI_Comm_free(&shmcomm) );
 }
 
+static bool parseRankPlacement(std::string placement)
+{
+    if (placement == "cartesian") return false;
+    if (placement == "node")      return true;
+
+    die("Unknown rank placement '%s', expected 'cartesian' or 'node'", placement.c_str());
+    return false;
+}
+
 void YMeRo::init(int3 nranks3D, float3 globalDomainSize, float dt, std::string logFileName, int verbosity,
-                 int checkpointEvery, std::string checkpointFolder, bool gpuAwareMPI)
+                 int checkpointEvery, std::string checkpointFolder, bool gpuAwareMPI, std::string rankPlacement)
 {
     int nranks;
     
@@ -75,12 +86,19 @@ void YMeRo::init(int3 nranks3D, float3 globalDomainSize, float dt, std::string l
 
     if (rank == 0) sayHello();    
 
+    this->checkpointEvery  = checkpointEvery;
+    this->checkpointFolder = checkpointFolder;
+    this->gpuAwareMPI      = gpuAwareMPI;
+
+    const bool nodeAware = parseRankPlacement(rankPlacement);
+    const float3 localDomainSize = globalDomainSize / make_float3(nranks3D);
+
     if (noPostprocess) {
         warn("No postprocess will be started now, use this mode for debugging. All the joint plugins will be turned off too.");
         
         selectIntraNodeGPU(comm);
 
-        createCartComm(comm, nranks3D, &cartComm);
+        createCartComm(comm, nranks3D, localDomainSize, nodeAware, &cartComm);
         state = std::make_shared<YmrState> (createDomainInfo(cartComm, globalDomainSize), dt);
         sim = std::make_unique<Simulation> (cartComm, MPI_COMM_NULL, getState(),
                                             checkpointEvery, checkpointFolder, gpuAwareMPI);
@@ -103,7 +121,7 @@ void YMeRo::init(int3 nranks3D, float3 globalDomainSize, float dt, std::string l
         MPI_Check( MPI_Comm_rank(compComm, &rank) );
         selectIntraNodeGPU(compComm);
 
-        createCartComm(compComm, nranks3D, &cartComm);
+        createCartComm(compComm, nranks3D, localDomainSize, nodeAware, &cartComm);
         state = std::make_shared<YmrState> (createDomainInfo(cartComm, globalDomainSize), dt);
         sim = std::make_unique<Simulation> (cartComm, interComm, getState(),
                                             checkpointEvery, checkpointFolder, gpuAwareMPI);
@@ -130,34 +148,39 @@ void YMeRo::initLogger(MPI_Comm comm, std::string logFileName, int verbosity)
 
 YMeRo::YMeRo(PyTypes::int3 nranks3D, PyTypes::float3 globalDomainSize, float dt,
              std::string logFileName, int verbosity, int checkpointEvery,
-             std::string checkpointFolder, bool gpuAwareMPI, bool noSplash) :
+             std::string checkpointFolder, bool gpuAwareMPI, bool noSplash,
+             std::string rankPlacement) :
     noSplash(noSplash)
 {
-    MPI_Init(nullptr, nullptr);
+    // asynchronous checkpoints write from a separate thread, see CheckpointWriter
+    int provided;
+    MPI_Init_thread(nullptr, nullptr, MPI_THREAD_MULTIPLE, &provided);
     MPI_Comm_dup(MPI_COMM_WORLD, &comm);
     initializedMpi = true;
 
-    init( make_int3(nranks3D), make_float3(globalDomainSize), dt, logFileName, verbosity, checkpointEvery, checkpointFolder, gpuAwareMPI);
+    init( make_int3(nranks3D), make_float3(globalDomainSize), dt, logFileName, verbosity, checkpointEvery, checkpointFolder, gpuAwareMPI, rankPlacement);
 }
 
 YMeRo::YMeRo(long commAdress, PyTypes::int3 nranks3D, PyTypes::float3 globalDomainSize, float dt,
              std::string logFileName, int verbosity, int checkpointEvery, 
-             std::string checkpointFolder, bool gpuAwareMPI, bool noSplash) :
+             std::string checkpointFolder, bool gpuAwareMPI, bool noSplash,
+             std::string rankPlacement) :
     noSplash(noSplash)
 {
     // see https://stackoverflow.com/questions/49259704/pybind11-possible-to-use-mpi4py
     MPI_Comm comm = *((MPI_Comm*) commAdress);
     MPI_Comm_dup(comm, &this->comm);
-    init( make_int3(nranks3D), make_float3(globalDomainSize), dt, logFileName, verbosity, checkpointEvery, checkpointFolder, gpuAwareMPI);    
+    init( make_int3(nranks3D), make_float3(globalDomainSize), dt, logFileName, verbosity, checkpointEvery, checkpointFolder, gpuAwareMPI, rankPlacement);    
 }
 
 YMeRo::YMeRo(MPI_Comm comm, PyTypes::int3 nranks3D, PyTypes::float3 globalDomainSize, float dt,
              std::string logFileName, int verbosity, int checkpointEvery,
-             std::string checkpointFolder, bool gpuAwareMPI, bool noSplash) :
+             std::string checkpointFolder, bool gpuAwareMPI, bool noSplash,
+             std::string rankPlacement) :
     noSplash(noSplash)
 {
     MPI_Comm_dup(comm, &this->comm);
-    init( make_int3(nranks3D), make_float3(globalDomainSize), dt, logFileName, verbosity, checkpointEvery, checkpointFolder, gpuAwareMPI);
+    init( make_int3(nranks3D), make_float3(globalDomainSize), dt, logFileName, verbosity, checkpointEvery, checkpointFolder, gpuAwareMPI, rankPlacement);
 }
 
 static void safeCommFree(MPI_Comm *comm)
@@ -168,11 +191,21 @@ static void safeCommFree(MPI_Comm *comm)
 
 YMeRo::~YMeRo()
 {
+    if (pendingRun.valid())
+        pendingRun.wait();
+
     debug("YMeRo coordinator is destroyed");
+
+    if (isComputeTask())
+        MemoryPool::device().logUsage();
     
     sim.reset();
+    replicas.clear();
     post.reset();
 
+    for (auto& c : replicaComms)
+        safeCommFree(&c);
+
     safeCommFree(&comm);
     safeCommFree(&cartComm);
     safeCommFree(&ioComm);
@@ -268,7 +301,7 @@ std::shared_ptr<YmrState> YMeRo::getYmrState()
     return state;
 }
 
-void YMeRo::dumpWalls2XDMF(std::vector<std::shared_ptr<Wall>> walls, PyTypes::float3 h, std::string filename)
+void YMeRo::dumpWalls2XDMF(std::vector<std::shared_ptr<Wall>> walls, PyTypes::float3 h, std::string filename, bool surface)
 {
     if (!isComputeTask()) return;
 
@@ -290,7 +323,10 @@ void YMeRo::dumpWalls2XDMF(std::vector<std::shared_ptr<Wall>> walls, PyTypes::fl
     auto path = parentPath(filename);
     if (path != filename)
         createFoldersCollective(sim->cartComm, path);
-    ::dumpWalls2XDMF(sdfWalls, make_float3(h), state->domain, filename, sim->cartComm);
+    if (surface)
+        ::dumpWallSurface2XDMF(sdfWalls, make_float3(h), state->domain, filename, sim->cartComm);
+    else
+        ::dumpWalls2XDMF(sdfWalls, make_float3(h), state->domain, filename, sim->cartComm);
 }
 
 double YMeRo::computeVolumeInsideWalls(std::vector<std::shared_ptr<Wall>> walls, long nSamplesPerRank)
@@ -315,11 +351,145 @@ double YMeRo::computeVolumeInsideWalls(std::vector<std::shared_ptr<Wall>> walls,
     return volumeInsideWalls(sdfWalls, state->domain, sim->cartComm, nSamplesPerRank);
 }
 
+static const char tileCacheMagic[] = "ymero_frozen_tile_v1";
+
+static bool readTileCache(std::string fname, float3 tileSize, float& effectiveCutoff, std::vector<Particle>& particles)
+{
+    std::ifstream file(fname, std::ios::binary);
+    if (!file.good()) return false;
+
+    char magic[sizeof(tileCacheMagic)];
+    float3 size;
+    int n;
+
+    file.read(magic, sizeof(magic));
+    file.read((char*)&size, sizeof(size));
+    file.read((char*)&effectiveCutoff, sizeof(effectiveCutoff));
+    file.read((char*)&n, sizeof(n));
+
+    if (!file.good() || std::string(magic) != tileCacheMagic)
+    {
+        warn("File '%s' is not a frozen tile, will equilibrate a new one", fname.c_str());
+        return false;
+    }
+
+    if (length(size - tileSize) > 1e-5f)
+    {
+        warn("Frozen tile '%s' has size %g x %g x %g instead of %g x %g x %g, will equilibrate a new one",
+             fname.c_str(), size.x, size.y, size.z, tileSize.x, tileSize.y, tileSize.z);
+        return false;
+    }
+
+    particles.resize(n);
+    file.read((char*)particles.data(), n * sizeof(Particle));
+
+    return file.good();
+}
+
+static void writeTileCache(std::string fname, float3 tileSize, float effectiveCutoff, const std::vector<Particle>& particles)
+{
+    std::ofstream file(fname, std::ios::binary);
+    if (!file.good())
+        die("Could not write the frozen tile to '%s'", fname.c_str());
+
+    const int n = particles.size();
+
+    file.write(tileCacheMagic, sizeof(tileCacheMagic));
+    file.write((const char*)&tileSize, sizeof(tileSize));
+    file.write((const char*)&effectiveCutoff, sizeof(effectiveCutoff));
+    file.write((const char*)&n, sizeof(n));
+    file.write((const char*)particles.data(), n * sizeof(Particle));
+}
+
+/**
+ * Rank 0 equilibrates a single periodic box of size \p tileSize on its own,
+ * or reads it from \p tileCache if it was saved there before, and broadcasts it.
+ * Particles of the tile are in [0, tileSize)
+ *
+ * @return effective cut-off radius of the interactions
+ */
+float YMeRo::makeFrozenTile(std::string pvName,
+                            std::vector<std::shared_ptr<Interaction>> interactions,
+                            std::shared_ptr<Integrator> integrator,
+                            float density, int nsteps,
+                            float3 tileSize, std::string tileCache,
+                            PinnedBuffer<Particle>& tile)
+{
+    int rank;
+    MPI_Check( MPI_Comm_rank(sim->cartComm, &rank) );
+
+    std::vector<Particle> particles;
+    float effectiveCutoff = 0;
+
+    if (rank == 0 && !(tileCache != "" && readTileCache(tileCache, tileSize, effectiveCutoff, particles)))
+    {
+        info("Equilibrating a frozen tile of size %g x %g x %g", tileSize.x, tileSize.y, tileSize.z);
+
+        MPI_Comm tileComm;
+        int dims[3] = {1, 1, 1}, periods[3] = {1, 1, 1};
+        MPI_Check( MPI_Cart_create(MPI_COMM_SELF, 3, dims, periods, 0, &tileComm) );
+
+        YmrState stateCpy = *getState();
+        state->domain = createDomainInfo(tileComm, tileSize);
+
+        {
+            Simulation tilesim(tileComm, MPI_COMM_NULL, getState());
+
+            auto pv = std::make_shared<ParticleVector>(getState(), pvName + "_tile", 1.0f);
+            auto ic = std::make_shared<UniformIC>(density);
+
+            tilesim.registerParticleVector(pv, ic, 0);
+            tilesim.registerIntegrator(integrator);
+            tilesim.setIntegrator(integrator->name, pv->name);
+
+            for (auto& interaction : interactions) {
+                tilesim.registerInteraction(interaction);
+                tilesim.setInteraction(interaction->name, pv->name, pv->name);
+            }
+
+            tilesim.init();
+            tilesim.run(nsteps);
+
+            effectiveCutoff = tilesim.getMaxEffectiveCutoff();
+
+            pv->local()->coosvels.downloadFromDevice(defaultStream, ContainersSynch::Synch);
+            for (auto p : pv->local()->coosvels)
+            {
+                p.r = state->domain.local2global(p.r);
+                particles.push_back(p);
+            }
+        }
+
+        *state = stateCpy;
+        MPI_Check( MPI_Comm_free(&tileComm) );
+
+        if (tileCache != "")
+        {
+            writeTileCache(tileCache, tileSize, effectiveCutoff, particles);
+            info("Saved the frozen tile to '%s'", tileCache.c_str());
+        }
+    }
+
+    int n = particles.size();
+    MPI_Check( MPI_Bcast(&n, 1, MPI_INT, 0, sim->cartComm) );
+    MPI_Check( MPI_Bcast(&effectiveCutoff, 1, MPI_FLOAT, 0, sim->cartComm) );
+
+    tile.resize_anew(n);
+    if (rank == 0)
+        std::copy(particles.begin(), particles.end(), tile.begin());
+
+    MPI_Check( MPI_Bcast(tile.hostPtr(), n * sizeof(Particle), MPI_BYTE, 0, sim->cartComm) );
+    tile.uploadToDevice(defaultStream);
+
+    return effectiveCutoff;
+}
+
 std::shared_ptr<ParticleVector> YMeRo::makeFrozenWallParticles(std::string pvName,
                                                                std::vector<std::shared_ptr<Wall>> walls,
                                                                std::vector<std::shared_ptr<Interaction>> interactions,
                                                                std::shared_ptr<Integrator> integrator,
-                                                               float density, int nsteps)
+                                                               float density, int nsteps,
+                                                               PyTypes::float3 tileSize, std::string tileCache)
 {
     if (!isComputeTask()) return nullptr;
 
@@ -347,28 +517,42 @@ std::shared_ptr<ParticleVector> YMeRo::makeFrozenWallParticles(std::string pvNam
     }
 
     YmrState stateCpy = *getState();
-    
-    Simulation wallsim(sim->cartComm, MPI_COMM_NULL, getState());
 
     float mass = 1.0;
     auto pv = std::make_shared<ParticleVector>(getState(), pvName, mass);
-    auto ic = std::make_shared<UniformIC>(density);
-    
-    wallsim.registerParticleVector(pv, ic, 0);
-    
-    wallsim.registerIntegrator(integrator);
-    
-    wallsim.setIntegrator (integrator->name,  pv->name);
+    float effectiveCutoff;
 
-    for (auto& interaction : interactions) {
-        wallsim.registerInteraction(interaction);        
-        wallsim.setInteraction(interaction->name, pv->name, pv->name);
+    const float3 tile = make_float3(tileSize);
+    if (tile.x > 0.0f && tile.y > 0.0f && tile.z > 0.0f)
+    {
+        PinnedBuffer<Particle> tileParts;
+        effectiveCutoff = makeFrozenTile(pvName, interactions, integrator, density, nsteps,
+                                         tile, tileCache, tileParts);
+
+        tileParticles(pv.get(), tileParts, tile, state->domain);
     }
-    
-    wallsim.init();
-    wallsim.run(nsteps);
+    else
+    {
+        Simulation wallsim(sim->cartComm, MPI_COMM_NULL, getState());
+
+        auto ic = std::make_shared<UniformIC>(density);
+
+        wallsim.registerParticleVector(pv, ic, 0);
+
+        wallsim.registerIntegrator(integrator);
+
+        wallsim.setIntegrator (integrator->name,  pv->name);
 
-    float effectiveCutoff = wallsim.getMaxEffectiveCutoff();
+        for (auto& interaction : interactions) {
+            wallsim.registerInteraction(interaction);
+            wallsim.setInteraction(interaction->name, pv->name, pv->name);
+        }
+
+        wallsim.init();
+        wallsim.run(nsteps);
+
+        effectiveCutoff = wallsim.getMaxEffectiveCutoff();
+    }
     
     const float wallThicknessTolerance = 0.2f;
     const float wallLevelSet = 0.0f;
@@ -379,6 +563,9 @@ std::shared_ptr<ParticleVector> YMeRo::makeFrozenWallParticles(std::string pvNam
     freezeParticlesInWalls(sdfWalls, pv.get(), wallLevelSet, wallLevelSet + wallThickness);
     info("\n");
 
+    // only the walls with velocity ever touch the frozen particles, they only change the velocities
+    pv->setStatic(true);
+
     sim->registerParticleVector(pv, nullptr);
 
     for (auto &wall : walls)
@@ -524,6 +711,530 @@ void YMeRo::saveDependencyGraph_GraphML(std::string fname, bool current) const
         sim->saveDependencyGraph_GraphML(fname, current);
 }
 
+void YMeRo::setTaskGraphCapture(bool enabled)
+{
+    if (initialized)
+        die("Task graph capture must be set before the first call to run()");
+
+    if (isComputeTask())
+        sim->setTaskGraphCapture(enabled);
+}
+
+void YMeRo::startTaskProfiling(int nsteps, std::string fname)
+{
+    if (isComputeTask())
+        sim->startTaskProfiling(nsteps, fname);
+}
+
+void YMeRo::setTaskSchedulingPolicy(std::string policy, int profileSteps)
+{
+    if (isComputeTask())
+        sim->setTaskSchedulingPolicy(policy, profileSteps);
+}
+
+void YMeRo::setCellListOrdering(ParticleVector *pv, std::string ordering)
+{
+    if (initialized)
+        die("Cell-list ordering must be set before the first call to run()");
+
+    if (isComputeTask())
+        sim->setCellListOrdering(pv->name, ordering);
+}
+
+void YMeRo::setCellListIncremental(ParticleVector *pv, float maxMovedFraction)
+{
+    if (initialized)
+        die("Incremental cell-list builds must be set before the first call to run()");
+
+    if (isComputeTask())
+        sim->setCellListIncremental(pv->name, maxMovedFraction);
+}
+
+void YMeRo::setCellListBuild(ParticleVector *pv, std::string method)
+{
+    if (initialized)
+        die("Cell-list build method must be set before the first call to run()");
+
+    if (isComputeTask())
+        sim->setCellListBuild(pv->name, method);
+}
+
+void YMeRo::setObjectReordering(ObjectVector *ov, int every)
+{
+    if (initialized)
+        die("Object reordering must be set before the first call to run()");
+
+    if (isComputeTask())
+        sim->setObjectReordering(ov->name, every);
+}
+
+void YMeRo::setKernelAutotuning(int nsamples, std::string fname)
+{
+    if (initialized)
+        die("Kernel autotuning must be set before the first call to run()");
+
+    if (isComputeTask())
+        sim->setKernelAutotuning(nsamples, fname);
+}
+
+void YMeRo::setPersistentSizeRequests(bool enabled)
+{
+    if (initialized)
+        die("Persistent MPI requests must be set before the first call to run()");
+
+    if (isComputeTask())
+        sim->setPersistentSizeRequests(enabled);
+}
+
+void YMeRo::setAggregatedExchanges(bool enabled)
+{
+    if (initialized)
+        die("Aggregated exchanges must be set before the first call to run()");
+
+    if (isComputeTask())
+        sim->setAggregatedExchanges(enabled);
+}
+
+void YMeRo::setIntraNodeIPCExchanges(bool enabled)
+{
+    if (initialized)
+        die("Intra-node IPC exchanges must be set before the first call to run()");
+
+    if (isComputeTask())
+        sim->setIntraNodeIPCExchanges(enabled);
+}
+
+void YMeRo::setNeighborCollectiveExchanges(bool enabled)
+{
+    if (initialized)
+        die("Neighbourhood collective exchanges must be set before the first call to run()");
+
+    if (isComputeTask())
+        sim->setNeighborCollectiveExchanges(enabled);
+}
+
+void YMeRo::setSpeculativeHaloPacking(bool enabled)
+{
+    if (initialized)
+        die("Speculative halo packing must be set before the first call to run()");
+
+    if (isComputeTask())
+        sim->setSpeculativeHaloPacking(enabled);
+}
+
+void YMeRo::setSortedHalos(bool enabled)
+{
+    if (initialized)
+        die("Sorted halos must be set before the first call to run()");
+
+    if (isComputeTask())
+        sim->setSortedHalos(enabled);
+}
+
+void YMeRo::setSparseReverseForces(bool enabled)
+{
+    if (initialized)
+        die("Sparse reverse forces must be set before the first call to run()");
+
+    if (isComputeTask())
+        sim->setSparseReverseForces(enabled);
+}
+
+void YMeRo::setHaloCompression(bool final, bool intermediate)
+{
+    if (initialized)
+        die("Halo compression must be set before the first call to run()");
+
+    if (isComputeTask())
+        sim->setHaloCompression(final, intermediate);
+}
+
+void YMeRo::setLoadBalanceReportPeriod(int every)
+{
+    if (isComputeTask())
+        sim->setLoadBalanceReportPeriod(every);
+}
+
+void YMeRo::setBatchedRedistribution(bool enabled)
+{
+    if (initialized)
+        die("Batched redistribution must be set before the first call to run()");
+
+    if (isComputeTask())
+        sim->setBatchedRedistribution(enabled);
+}
+
+void YMeRo::setEarlyRedistribution(bool enabled)
+{
+    if (initialized)
+        die("Early redistribution must be set before the first call to run()");
+
+    if (isComputeTask())
+        sim->setEarlyRedistribution(enabled);
+}
+
+void YMeRo::setOverlappedCellLists(bool enabled)
+{
+    if (initialized)
+        die("Overlapped cell-lists must be set before the first call to run()");
+
+    if (isComputeTask())
+        sim->setOverlappedCellLists(enabled);
+}
+
+void YMeRo::setFusedObjectBounce(bool enabled)
+{
+    if (initialized)
+        die("Fused object bounce must be set before the first call to run()");
+
+    if (isComputeTask())
+        sim->setFusedObjectBounce(enabled);
+}
+
+void YMeRo::setAsyncCheckpoints(bool enabled)
+{
+    if (initialized)
+        die("Asynchronous checkpoints must be set before the first call to run()");
+
+    if (isComputeTask())
+        sim->setAsyncCheckpoints(enabled);
+}
+
+void YMeRo::setBatchedPluginMessages(bool enabled, int nInflight)
+{
+    if (initialized)
+        die("Batched plugin messages must be set before the first call to run()");
+
+    if (enabled && nInflight < 1)
+        die("Batched plugin messages need at least 1 batch in flight, got %d", nInflight);
+
+    if (isComputeTask())
+        sim->setBatchedPluginMessages(enabled ? nInflight : 0);
+    else if (post)
+        post->setBatchedMessages(enabled);
+}
+
+void YMeRo::setThreadedPostprocess(bool enabled)
+{
+    if (initialized)
+        die("Threaded postprocess must be set before the first call to run()");
+
+    if (!isComputeTask() && post)
+        post->setThreaded(enabled);
+}
+
+void YMeRo::setCheckpointCompression(std::string compression)
+{
+    if (initialized)
+        die("Checkpoint compression must be set before the first call to run()");
+
+    if (isComputeTask())
+        sim->setCheckpointCompression(compression);
+}
+
+void YMeRo::setIncrementalCheckpoints(bool enabled)
+{
+    if (initialized)
+        die("Incremental checkpoints must be set before the first call to run()");
+
+    if (isComputeTask())
+        sim->setIncrementalCheckpoints(enabled);
+}
+
+void YMeRo::setCheckpointStaging(std::string folder)
+{
+    if (initialized)
+        die("Checkpoint staging must be set before the first call to run()");
+
+    if (isComputeTask())
+        sim->setCheckpointStaging(folder);
+}
+
+void YMeRo::setRawCheckpoints(bool enabled)
+{
+    if (initialized)
+        die("Raw checkpoints must be set before the first call to run()");
+
+    if (isComputeTask())
+        sim->setRawCheckpoints(enabled);
+}
+
+void YMeRo::setPreemptionCheckpoint(std::string folder, int signal)
+{
+    if (initialized)
+        die("The preemption checkpoint must be set before the first call to run()");
+
+    // the postprocess ranks must survive the signal as well
+    if (isComputeTask())
+        sim->setPreemptionCheckpoint(folder, signal);
+    else
+        Preemption::catchSignal(signal);
+}
+
+void YMeRo::setAdaptiveCheckpoints(float mtbf, float wallTimeLimit)
+{
+    if (initialized)
+        die("Adaptive checkpoints must be set before the first call to run()");
+
+    if (isComputeTask())
+        sim->setAdaptiveCheckpoints(mtbf, wallTimeLimit);
+}
+
+bool YMeRo::isPreempted() const
+{
+    return preempted;
+}
+
+void YMeRo::setHostWorkers(int nThreads)
+{
+    if (initialized)
+        die("Host workers must be set before the first call to run()");
+
+    if (isComputeTask())
+        sim->setHostWorkers(nThreads);
+}
+
+void YMeRo::setPersistentStepMode(int stepsPerLaunch)
+{
+    if (initialized)
+        die("The persistent step mode must be set before the first call to run()");
+
+    if (isComputeTask())
+        sim->setPersistentStepMode(stepsPerLaunch);
+}
+
+void YMeRo::setPluginCostReport(int every)
+{
+    if (initialized)
+        die("The plugin cost report must be set before the first call to run()");
+
+    if (isComputeTask())
+        sim->setPluginCostReport(every);
+}
+
+void YMeRo::setPluginBudget(std::string pluginName, float budget)
+{
+    if (initialized)
+        die("Plugin budgets must be set before the first call to run()");
+
+    if (isComputeTask())
+        sim->setPluginBudget(pluginName, budget);
+}
+
+void YMeRo::setReplicas(int nReplicas)
+{
+    if (initialized)
+        die("Replicas must be set before the first call to run()");
+
+    if (!replicas.empty())
+        die("Replicas can only be set once");
+
+    if (nReplicas < 1)
+        die("Expected at least one replica, got %d", nReplicas);
+
+    if (!noPostprocess)
+        die("Replicas are only supported without postprocess ranks");
+
+    if (nReplicas == 1)
+        return;
+
+    // the current simulation is the replica 0
+    replicas     .resize(nReplicas);
+    replicaStates.resize(nReplicas);
+
+    for (int i = 1; i < nReplicas; i++)
+    {
+        // own communicator, the messages of different replicas never match
+        MPI_Comm replicaComm;
+        MPI_Check( MPI_Comm_dup(cartComm, &replicaComm) );
+        replicaComms.push_back(replicaComm);
+
+        char suffix[32];
+        sprintf(suffix, "replica%03d/", i);
+
+        replicaStates[i] = std::make_shared<YmrState> (state->domain, state->dt);
+        replicas[i] = std::make_unique<Simulation> (replicaComm, MPI_COMM_NULL, replicaStates[i].get(),
+                                                    checkpointEvery, checkpointFolder + suffix, gpuAwareMPI);
+    }
+
+    info("Created %d replicas of the simulation", nReplicas);
+}
+
+void YMeRo::selectReplica(int index)
+{
+    if (replicas.empty())
+    {
+        if (index != 0)
+            die("There are no replicas, only the replica 0 can be selected");
+        return;
+    }
+
+    if (index < 0 || index >= replicas.size())
+        die("No replica %d, there are %d of them", index, (int) replicas.size());
+
+    std::swap(sim,   replicas     [currentReplica]);
+    std::swap(state, replicaStates[currentReplica]);
+
+    currentReplica = index;
+
+    std::swap(sim,   replicas     [currentReplica]);
+    std::swap(state, replicaStates[currentReplica]);
+}
+
+std::vector<Simulation*> YMeRo::getReplicas()
+{
+    if (replicas.empty())
+        return {sim.get()};
+
+    std::vector<Simulation*> all;
+    for (int i = 0; i < replicas.size(); i++)
+        all.push_back(i == currentReplica ? sim.get() : replicas[i].get());
+
+    return all;
+}
+
+void YMeRo::setExchangeChunkSize(int bytes)
+{
+    if (initialized)
+        die("Exchange chunk size must be set before the first call to run()");
+
+    if (isComputeTask())
+        sim->setExchangeChunkSize(bytes);
+}
+
+void YMeRo::setVirtualPeriodicImages(bool enabled)
+{
+    if (initialized)
+        die("Virtual periodic images must be set before the first call to run()");
+
+    if (isComputeTask())
+        sim->setVirtualPeriodicImages(enabled);
+}
+
+void YMeRo::setLazyRedistribution(float skin)
+{
+    if (initialized)
+        die("Lazy redistribution must be set before the first call to run()");
+
+    if (isComputeTask())
+        sim->setLazyRedistribution(skin);
+}
+
+void YMeRo::setDeviceMonitor(int every, float maxDisplacement)
+{
+    if (initialized)
+        die("Device monitor must be set before the first call to run()");
+
+    if (isComputeTask())
+        sim->setDeviceMonitor(every, maxDisplacement);
+}
+
+void YMeRo::setBackgroundWallSetup(bool enabled)
+{
+    if (initialized)
+        die("Background wall setup must be set before the first call to run()");
+
+    if (isComputeTask())
+        sim->setBackgroundWallSetup(enabled);
+}
+
+void YMeRo::setAdaptiveTimeStep(float dtMin, float dtMax, float maxDisplacement, float maxGrowth)
+{
+    if (initialized)
+        die("Adaptive time step must be set before the first call to run()");
+
+    if (isComputeTask())
+        sim->setAdaptiveTimeStep(dtMin, dtMax, maxDisplacement, maxGrowth);
+}
+
+void YMeRo::setAdaptiveTransport(bool enabled)
+{
+    if (initialized)
+        die("Adaptive transport must be set before the first call to run()");
+
+    if (isComputeTask())
+        sim->setAdaptiveTransport(enabled);
+}
+
+void YMeRo::setStaticHaloChannels(ObjectVector *ov, const std::vector<std::string>& channelNames)
+{
+    if (initialized)
+        die("Static halo channels must be set before the first call to run()");
+
+    if (isComputeTask())
+        sim->setStaticHaloChannels(ov->name, channelNames);
+}
+
+void YMeRo::setSurfaceHalo(ObjectVector *ov, bool enabled)
+{
+    if (initialized)
+        die("Surface halo must be set before the first call to run()");
+
+    if (isComputeTask())
+        sim->setSurfaceHalo(ov->name, enabled);
+}
+
+void YMeRo::setMemoryPooling(bool enabled)
+{
+    MemoryPool::device().setCaching(enabled);
+    MemoryPool::host()  .setCaching(enabled);
+}
+
+void YMeRo::setManagedMemory(bool enabled)
+{
+    if (isComputeTask())
+        MemoryPool::device().setManaged(enabled);
+}
+
+void YMeRo::setMemoryReportPeriod(int every)
+{
+    if (isComputeTask())
+        sim->setMemoryReportPeriod(every);
+}
+
+void YMeRo::setAsyncLogging(bool enabled, int maxPerSitePerSecond)
+{
+    logger.setAsync(enabled);
+    logger.setRateLimit(maxPerSitePerSecond);
+}
+
+void YMeRo::setBufferShrinkPolicy(int nsteps, float threshold, bool atCheckpoint)
+{
+    if (isComputeTask())
+        sim->setBufferShrinkPolicy(nsteps, threshold, atCheckpoint);
+}
+
+std::map<std::string, std::map<std::string, size_t>> YMeRo::getMemoryUsage() const
+{
+    std::map<std::string, std::map<std::string, size_t>> result;
+
+    auto add = [&result] (const std::string& owner, const MemoryPool::Usage& u) {
+        result[owner] = { {"current",  u.inUse},
+                          {"peak",     u.peak},
+                          {"capacity", u.requested},
+                          {"size",     u.used} };
+    };
+
+    for (auto& entry : MemoryPool::device().getUsage())
+        add(entry.first, entry.second);
+
+    add("total", MemoryPool::device().getTotalUsage());
+
+    return result;
+}
+
+void YMeRo::setPerfCounters(bool enabled)
+{
+    PerfCounters::setEnabled(enabled);
+}
+
+std::map<std::string, long long> YMeRo::getPerfCounters(bool reset) const
+{
+    auto counters = PerfCounters::get();
+    if (reset) PerfCounters::reset();
+    return counters;
+}
+
 void YMeRo::startProfiler()
 {
     if (isComputeTask())
@@ -536,16 +1247,66 @@ void YMeRo::stopProfiler()
         sim->stopProfiler();
 }
 
+void YMeRo::setNvtxRanges(bool enabled)
+{
+    NVTX::setEnabled(enabled);
+}
+
 void YMeRo::run(int nsteps)
+{
+    checkNoPendingRun();
+    runSteps(nsteps);
+}
+
+void YMeRo::runSteps(int nsteps)
 {
     if (isComputeTask())
     {
+        auto sims = getReplicas();
+
         if (!initialized)
         {
-            sim->init();
+            for (auto s : sims)
+                s->init();
             initialized = true;
         }
-        sim->run(nsteps);
+
+        if (sims.size() == 1)
+            sim->run(nsteps);
+        else
+        {
+            // step all the replicas together, the tasks of one wait for MPI or the host
+            // while the kernels of the others run
+            for (auto s : sims)
+                s->startRun(nsteps);
+
+            for (int i = 0; i < nsteps; i++)
+            {
+                for (auto s : sims)
+                    s->startStep();
+
+                bool done = false;
+                while (!done)
+                {
+                    done = true;
+                    for (auto s : sims)
+                        done = s->progressStep() && done;
+                }
+
+                bool anyPreempted = false;
+                for (auto s : sims)
+                {
+                    s->finishStep();
+                    anyPreempted = anyPreempted || s->isPreempted();
+                }
+
+                // only the current replica writes the preemption checkpoint
+                if (anyPreempted) break;
+            }
+
+            for (auto s : sims)
+                s->finishRun(nsteps);
+        }
     }
     else
     {
@@ -556,8 +1317,54 @@ void YMeRo::run(int nsteps)
         }
         post->run();
     }
+
+    // the postprocess ranks learn it as well
+    int localPreempted = isComputeTask() && sim->isPreempted() ? 1 : 0, anyPreempted = 0;
+    MPI_Check( MPI_Allreduce(&localPreempted, &anyPreempted, 1, MPI_INT, MPI_MAX, comm) );
+    preempted = anyPreempted != 0;
     
     MPI_Check( MPI_Barrier(comm) );
 }
 
+AsyncRun::AsyncRun(std::shared_future<void> result) :
+    result(result)
+{}
+
+bool AsyncRun::done() const
+{
+    return result.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+void AsyncRun::wait() const
+{
+    result.get();
+}
+
+void YMeRo::checkNoPendingRun() const
+{
+    if (pendingRun.valid() && pendingRun.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        die("The previous asynchronous run must be complete, wait for it first");
+}
+
+AsyncRun YMeRo::runAsync(int nsteps)
+{
+    checkNoPendingRun();
+
+    int provided;
+    MPI_Check( MPI_Query_thread(&provided) );
+    if (provided < MPI_THREAD_SERIALIZED)
+        die("Asynchronous runs call MPI from another thread, they need at least MPI_THREAD_SERIALIZED");
+
+    // the current device is per thread
+    int device;
+    CUDA_Check( cudaGetDevice(&device) );
+
+    pendingRun = std::async(std::launch::async, [this, nsteps, device] () {
+        CUDA_Check( cudaSetDevice(device) );
+        runSteps(nsteps);
+    }).share();
+
+    return AsyncRun(pendingRun);
+}
+
 
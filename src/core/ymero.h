@@ -3,8 +3,11 @@
 #include <core/logger.h>
 #include <core/utils/pytypes.h>
 
+#include <future>
+#include <map>
 #include <memory>
 #include <mpi.h>
+#include <vector>
 
 class YmrState;
 
@@ -22,20 +25,41 @@ class Wall;
 class SimulationPlugin;
 class PostprocessPlugin;
 
+struct Particle;
+template<typename T> class PinnedBuffer;
+
+/// run() in progress on its own thread, see YMeRo::runAsync()
+class AsyncRun
+{
+public:
+    AsyncRun(std::shared_future<void> result);
+
+    bool done() const;
+
+    /// block until the run is complete
+    void wait() const;
+
+private:
+    std::shared_future<void> result;
+};
+
 class YMeRo
 {
 public:
     YMeRo(PyTypes::int3 nranks3D, PyTypes::float3 globalDomainSize, float dt,
           std::string logFileName, int verbosity, int checkpointEvery=0,
-          std::string checkpointFolder="restart/", bool gpuAwareMPI=false, bool noSplash=false);
+          std::string checkpointFolder="restart/", bool gpuAwareMPI=false, bool noSplash=false,
+          std::string rankPlacement="cartesian");
 
     YMeRo(long commAddress, PyTypes::int3 nranks3D, PyTypes::float3 globalDomainSize, float dt,
           std::string logFileName, int verbosity, int checkpointEvery=0,
-          std::string checkpointFolder="restart/", bool gpuAwareMPI=false, bool noSplash=false);
+          std::string checkpointFolder="restart/", bool gpuAwareMPI=false, bool noSplash=false,
+          std::string rankPlacement="cartesian");
 
     YMeRo(MPI_Comm comm, PyTypes::int3 nranks3D, PyTypes::float3 globalDomainSize, float dt,
           std::string logFileName, int verbosity, int checkpointEvery=0,
-          std::string checkpointFolder="restart/", bool gpuAwareMPI=false, bool noSplash=false);
+          std::string checkpointFolder="restart/", bool gpuAwareMPI=false, bool noSplash=false,
+          std::string rankPlacement="cartesian");
 
     ~YMeRo();
     
@@ -44,9 +68,73 @@ public:
     bool isMasterTask() const;
     void startProfiler();
     void stopProfiler();
+    void setNvtxRanges(bool enabled);
     void saveDependencyGraph_GraphML(std::string fname, bool current) const;
+    void setTaskGraphCapture(bool enabled);
+    void startTaskProfiling(int nsteps, std::string fname);
+    void setTaskSchedulingPolicy(std::string policy, int profileSteps);
+    void setCellListOrdering(ParticleVector *pv, std::string ordering);
+    void setCellListIncremental(ParticleVector *pv, float maxMovedFraction);
+    void setCellListBuild(ParticleVector *pv, std::string method);
+    void setObjectReordering(ObjectVector *ov, int every);
+    void setKernelAutotuning(int nsamples, std::string fname);
+    void setPersistentSizeRequests(bool enabled);
+    void setAggregatedExchanges(bool enabled);
+    void setIntraNodeIPCExchanges(bool enabled);
+    void setNeighborCollectiveExchanges(bool enabled);
+    void setSpeculativeHaloPacking(bool enabled);
+    void setSortedHalos(bool enabled);
+    void setSparseReverseForces(bool enabled);
+    void setHaloCompression(bool final, bool intermediate);
+    void setLoadBalanceReportPeriod(int every);
+    void setStaticHaloChannels(ObjectVector *ov, const std::vector<std::string>& channelNames);
+    void setSurfaceHalo(ObjectVector *ov, bool enabled);
+    void setBatchedRedistribution(bool enabled);
+    void setEarlyRedistribution(bool enabled);
+    void setOverlappedCellLists(bool enabled);
+    void setFusedObjectBounce(bool enabled);
+    void setExchangeChunkSize(int bytes);
+    void setAdaptiveTransport(bool enabled);
+    void setVirtualPeriodicImages(bool enabled);
+    void setLazyRedistribution(float skin);
+    void setDeviceMonitor(int every, float maxDisplacement);
+    void setAdaptiveTimeStep(float dtMin, float dtMax, float maxDisplacement, float maxGrowth);
+    void setBackgroundWallSetup(bool enabled);
+    void setAsyncCheckpoints(bool enabled);
+    void setCheckpointCompression(std::string compression);
+    void setIncrementalCheckpoints(bool enabled);
+    void setCheckpointStaging(std::string folder);
+    void setRawCheckpoints(bool enabled);
+    void setPreemptionCheckpoint(std::string folder, int signal);
+    void setAdaptiveCheckpoints(float mtbf, float wallTimeLimit);
+    void setHostWorkers(int nThreads);
+    void setPersistentStepMode(int stepsPerLaunch);
+    void setPluginCostReport(int every);
+    void setPluginBudget(std::string pluginName, float budget);
+    void setReplicas(int nReplicas);
+    void selectReplica(int index);
+    void setBatchedPluginMessages(bool enabled, int nInflight);
+    void setThreadedPostprocess(bool enabled);
+    void setMemoryPooling(bool enabled);
+    void setManagedMemory(bool enabled);
+    void setMemoryReportPeriod(int every);
+    void setAsyncLogging(bool enabled, int maxPerSitePerSecond);
+    void setBufferShrinkPolicy(int nsteps, float threshold, bool atCheckpoint);
+    std::map<std::string, std::map<std::string, size_t>> getMemoryUsage() const;
+    void setPerfCounters(bool enabled);
+    std::map<std::string, long long> getPerfCounters(bool reset) const;
     
     void run(int niters);
+
+    /**
+     * Start run(\p niters) on a native thread and return right away.
+     * The coordinator must not be used until the run is complete, only the data of the
+     * previous runs may be read meanwhile; needs at least MPI_THREAD_SERIALIZED
+     */
+    AsyncRun runAsync(int niters);
+
+    /// whether the last run stopped on a preemption notice, on all the ranks, see setPreemptionCheckpoint()
+    bool isPreempted() const;
     
     void registerParticleVector         (const std::shared_ptr<ParticleVector>& pv,
                                          const std::shared_ptr<InitialConditions>& ic, int checkpointEvery);
@@ -69,14 +157,16 @@ public:
     const YmrState* getState() const;
     std::shared_ptr<YmrState> getYmrState();
 
-    void dumpWalls2XDMF(std::vector<std::shared_ptr<Wall>> walls, PyTypes::float3 h, std::string filename);
+    void dumpWalls2XDMF(std::vector<std::shared_ptr<Wall>> walls, PyTypes::float3 h, std::string filename, bool surface = false);
     double computeVolumeInsideWalls(std::vector<std::shared_ptr<Wall>> walls, long nSamplesPerRank = 100000);
     
     std::shared_ptr<ParticleVector> makeFrozenWallParticles(std::string pvName,
                                                             std::vector<std::shared_ptr<Wall>> walls,
                                                             std::vector<std::shared_ptr<Interaction>> interactions,
                                                             std::shared_ptr<Integrator> integrator,
-                                                            float density, int nsteps);
+                                                            float density, int nsteps,
+                                                            PyTypes::float3 tileSize = {0, 0, 0},
+                                                            std::string tileCache = "");
 
     std::shared_ptr<ParticleVector> makeFrozenRigidParticles(std::shared_ptr<ObjectBelongingChecker> checker,
                                                              std::shared_ptr<ObjectVector> shape,
@@ -93,9 +183,27 @@ public:
                                                                 int checkpointEvery=0);    
     
 private:
+    float makeFrozenTile(std::string pvName,
+                         std::vector<std::shared_ptr<Interaction>> interactions,
+                         std::shared_ptr<Integrator> integrator,
+                         float density, int nsteps,
+                         float3 tileSize, std::string tileCache,
+                         PinnedBuffer<Particle>& tile);
+
     std::unique_ptr<Simulation> sim;
     std::unique_ptr<Postprocess> post;
     std::shared_ptr<YmrState> state;
+
+    // independent replicas of the simulation, see setReplicas()
+    // the selected one is moved to sim and state, its entries here are empty
+    std::vector<std::unique_ptr<Simulation>> replicas;
+    std::vector<std::shared_ptr<YmrState>> replicaStates;
+    std::vector<MPI_Comm> replicaComms;
+    int currentReplica {0};
+
+    int checkpointEvery;
+    std::string checkpointFolder;
+    bool gpuAwareMPI;
     
     int rank;
     int computeTask;
@@ -104,6 +212,11 @@ private:
     
     bool initialized = false;
     bool initializedMpi = false;
+    bool preempted = false;
+
+    std::shared_future<void> pendingRun;
+    void checkNoPendingRun() const;
+    void runSteps(int niters);
 
     MPI_Comm comm      {MPI_COMM_NULL}; ///< base communicator (world)
     MPI_Comm cartComm  {MPI_COMM_NULL}; ///< cartesian communicator for simulation part; might be from comm if no postprocess
@@ -112,7 +225,10 @@ private:
     MPI_Comm interComm {MPI_COMM_NULL}; ///< intercommunicator between postprocess and simulation
 
     void init(int3 nranks3D, float3 globalDomainSize, float dt, std::string logFileName, int verbosity,
-              int checkpointEvery, std::string restartFolder, bool gpuAwareMPI);
+              int checkpointEvery, std::string restartFolder, bool gpuAwareMPI, std::string rankPlacement);
     void initLogger(MPI_Comm comm, std::string logFileName, int verbosity);
     void sayHello();
+
+    /// all the replicas, the selected one included, or only the simulation if there are no replicas
+    std::vector<Simulation*> getReplicas();
 };
@@ -1,20 +1,9 @@
 #include "add_force.h"
+#include "body_forces.h"
 
-#include <core/utils/kernel_launch.h>
 #include <core/pvs/particle_vector.h>
-#include <core/pvs/views/pv.h>
 #include <core/simulation.h>
 
-#include <core/utils/cuda_common.h>
-
-__global__ void addForce(PVview view, float3 force)
-{
-    int gid = blockIdx.x * blockDim.x + threadIdx.x;
-    if (gid >= view.size) return;
-
-    view.forces[gid] += make_float4(force, 0.0f);
-}
-
 AddForcePlugin::AddForcePlugin(const YmrState *state, std::string name, std::string pvName, float3 force) :
     SimulationPlugin(state, name), pvName(pvName), force(force)
 {}
@@ -24,16 +13,10 @@ void AddForcePlugin::setup(Simulation* simulation, const MPI_Comm& comm, const M
     SimulationPlugin::setup(simulation, comm, interComm);
 
     pv = simulation->getPVbyNameOrDie(pvName);
+    bodyForces = simulation->getBodyForces();
 }
 
 void AddForcePlugin::beforeForces(cudaStream_t stream)
 {
-    PVview view(pv, pv->local());
-    const int nthreads = 128;
-
-    SAFE_KERNEL_LAUNCH(
-            addForce,
-            getNblocks(view.size, nthreads), nthreads, 0, stream,
-            view, force );
+    bodyForces->addForce(pv, force);
 }
-
@@ -7,6 +7,7 @@
 #include <core/utils/folders.h>
 
 class ParticleVector;
+class BodyForces;
 
 class AddForcePlugin : public SimulationPlugin
 {
@@ -22,5 +23,6 @@ private:
     std::string pvName;
     ParticleVector* pv;
     float3 force;
+    BodyForces *bodyForces;
 };
 
@@ -7,6 +7,7 @@
 #include <core/utils/folders.h>
 
 class RigidObjectVector;
+class BodyForces;
 
 class AddTorquePlugin : public SimulationPlugin
 {
@@ -22,5 +23,6 @@ private:
     std::string rovName;
     RigidObjectVector* rov;
     float3 torque;
+    BodyForces *bodyForces;
 };
 
@@ -1,4 +1,5 @@
 #include "average_flow.h"
+#include "sampling_pipeline.h"
 
 #include "utils/sampling_helpers.h"
 #include "utils/simple_serializer.h"
@@ -13,21 +14,65 @@
 namespace AverageFlowKernels
 {
 
-__global__ void sample(
+/**
+ * Sampling for bins equal to the cells of the primary cell list of the pv:
+ * one thread per non-empty cell goes through its (contiguous) particles and adds them with
+ * one atomic per bin and per component, instead of one per particle.
+ * The particles that left their cell since the cell list was built are added one by one.
+ * The density is float or double, see ChannelsInfo::accumulated for the channels
+ */
+template <typename DensityType>
+__global__ void sampleByCells(
         PVview pvView, CellListInfo cinfo,
-        float* avgDensity,
+        DensityType* avgDensity,
         ChannelsInfo channelsInfo)
 {
-    const int pid = threadIdx.x + blockIdx.x*blockDim.x;
-    if (pid >= pvView.size) return;
-
-    Particle p(pvView.particles, pid);
+    const int cid = cinfo.activeCell(threadIdx.x + blockIdx.x*blockDim.x);
+    if (cid < 0) return;
+
+    const int start = cinfo.cellStarts[cid];
+    const int end   = start + cinfo.cellSizes[cid];
+
+    // bins follow the row-major order, the cells may not
+    int ix, iy, iz;
+    cinfo.decode(cid, ix, iy, iz);
+    const int binId = (iz * cinfo.ncells.y + iy) * cinfo.ncells.x + ix;
+
+    auto strayBin = [&] (int pid) {
+        const Particle p(pvView.particles, pid);
+        if (cinfo.getCellId(p.r) == cid) return -1;
+
+        const int3 b = cinfo.getCellIdAlongAxes(p.r);
+        return (b.z * cinfo.ncells.y + b.y) * cinfo.ncells.x + b.x;
+    };
+
+    float nOwn = 0;
+    for (int pid = start; pid < end; pid++)
+    {
+        const int bin = strayBin(pid);
+        if (bin < 0)
+            nOwn += 1;
+        else
+        {
+            atomicAdd(avgDensity + bin, (DensityType) 1);
+            SamplingHelpersKernels::sampleChannels(pid, bin, channelsInfo);
+        }
+    }
 
-    int cid = cinfo.getCellId(p.r);
+    if (nOwn == 0) return;
+    atomicAdd(avgDensity + binId, (DensityType) nOwn);
 
-    atomicAdd(avgDensity + cid, 1);
+    for (int i = 0; i < channelsInfo.n; i++)
+    {
+        float acc[6] = {0, 0, 0, 0, 0, 0};
+        for (int pid = start; pid < end; pid++)
+            if (strayBin(pid) < 0)
+                SamplingHelpersKernels::addChannelValue(i, pid, channelsInfo, acc);
 
-    SamplingHelpersKernels::sampleChannels(pid, cid, channelsInfo);
+        const int components = SamplingHelpersKernels::getNcomponents(channelsInfo.types[i]);
+        for (int c = 0; c < components; c++)
+            SamplingHelpersKernels::addToChannel(channelsInfo, i, components * binId + c, acc[c]);
+    }
 }
 
 } // namespace AverageFlowKernels
@@ -40,19 +85,63 @@ int Average3D::getNcomponents(Average3D::ChannelType type) const
     return components;
 }
 
+/// floats between the values of two consecutive particles
+static int getStride(Average3D::ChannelType type)
+{
+    switch (type)
+    {
+    case Average3D::ChannelType::Scalar:          return 1;
+    case Average3D::ChannelType::Vector_float3:   return 3;
+    case Average3D::ChannelType::Vector_float4:   return 4;
+    case Average3D::ChannelType::Vector_2xfloat4: return 8;
+    case Average3D::ChannelType::Tensor6:         return 6;
+    }
+    return 0;
+}
+
+void Average3D::addSamplingReducers(ParticleVector *pv, float3 domainSize, float3 shift, bool periodic)
+{
+    auto add = [&] (SamplingReducer reducer) {
+        reducer.shift           = shift;
+        reducer.periodic        = periodic;
+        reducer.doublePrecision = doublePrecision;
+        pipeline->add(pv, reducer);
+    };
+
+    auto output = [this] (DeviceBuffer<float>& perSample, PinnedBuffer<double>& accumulated) -> void* {
+        if (doublePrecision) return accumulated.devPtr();
+        return perSample.devPtr();
+    };
+
+    add( SamplingReducer::binned(SamplingReducer::Quantity::Ones, output(density, accumulated_density), binSize, domainSize) );
+
+    for (int i = 0; i < channelsInfo.n; i++)
+    {
+        const auto type = channelsInfo.types[i];
+        const float *data = channelsInfo.names[i] == "velocity" ?
+            (const float*) ((float4*)pv->local()->coosvels.devPtr() + 1) :
+            (const float*) pv->local()->extraPerParticle.getGenericPtr(channelsInfo.names[i]);
+
+        add( SamplingReducer::binnedChannel(data, getStride(type), getNcomponents(type),
+                                            output(channelsInfo.average[i], accumulated_average[i]), binSize, domainSize) );
+    }
+}
+
 Average3D::Average3D(const YmrState *state, std::string name,
                      std::vector<std::string> pvNames,
                      std::vector<std::string> channelNames, std::vector<Average3D::ChannelType> channelTypes,
-                     int sampleEvery, int dumpEvery, float3 binSize) :
+                     int sampleEvery, int dumpEvery, float3 binSize, bool doublePrecision, int3 reducedAxes) :
     SimulationPlugin(state, name), pvNames(pvNames),
     sampleEvery(sampleEvery), dumpEvery(dumpEvery), binSize(binSize),
-    nSamples(0)
+    nSamples(0), doublePrecision(doublePrecision), reducedAxes(reducedAxes)
 {
     channelsInfo.n = channelTypes.size();
     channelsInfo.types.resize_anew(channelsInfo.n);
     channelsInfo.average.resize(channelsInfo.n);
     channelsInfo.averagePtrs.resize_anew(channelsInfo.n);
     channelsInfo.dataPtrs.resize_anew(channelsInfo.n);
+    channelsInfo.accumulatedPtrs.resize_anew(channelsInfo.n);
+    channelsInfo.doublePrecision = doublePrecision;
 
     accumulated_average.resize(channelsInfo.n);
 
@@ -62,6 +151,12 @@ Average3D::Average3D(const YmrState *state, std::string name,
     channelsInfo.names = channelNames;
 }
 
+Average3D::~Average3D()
+{
+    if (reduceComm != MPI_COMM_NULL)
+        MPI_Comm_free(&reduceComm);
+}
+
 void Average3D::setup(Simulation* simulation, const MPI_Comm& comm, const MPI_Comm& interComm)
 {
     SimulationPlugin::setup(simulation, comm, interComm);
@@ -71,6 +166,12 @@ void Average3D::setup(Simulation* simulation, const MPI_Comm& comm, const MPI_Co
     
     // TODO: this should be reworked if the domains are allowed to have different size
     resolution = make_int3( floorf(state->domain.localSize / binSize) );
+
+    // one bin over the subdomain along the reduced axes, the GPU sums the particles along them
+    if (reducedAxes.x) resolution.x = 1;
+    if (reducedAxes.y) resolution.y = 1;
+    if (reducedAxes.z) resolution.z = 1;
+
     binSize = state->domain.localSize / make_float3(resolution);
 
     if (resolution.x <= 0 || resolution.y <= 0 || resolution.z <= 0)
@@ -97,32 +198,70 @@ void Average3D::setup(Simulation* simulation, const MPI_Comm& comm, const MPI_Co
         accumulated_average [i].clear(0);
         
         channelsInfo.averagePtrs[i] = channelsInfo.average[i].devPtr();
+        channelsInfo.accumulatedPtrs[i] = accumulated_average[i].devPtr();
 
         allChannels += ", " + channelsInfo.names[i];
     }
 
     channelsInfo.averagePtrs.uploadToDevice(0);
+    channelsInfo.accumulatedPtrs.uploadToDevice(0);
     channelsInfo.types.uploadToDevice(0);
 
     for (const auto& pvName : pvNames)
         pvs.push_back(simulation->getPVbyNameOrDie(pvName));
 
+    pipeline = simulation->getSamplingPipeline();
+
+    if (reducedAxes.x || reducedAxes.y || reducedAxes.z)
+    {
+        int remain[3] = {reducedAxes.x != 0, reducedAxes.y != 0, reducedAxes.z != 0};
+        MPI_Check( MPI_Cart_sub(simulation->cartComm, remain, &reduceComm) );
+
+        int reduceRank;
+        MPI_Check( MPI_Comm_rank(reduceComm, &reduceRank) );
+        MPI_Check( MPI_Comm_size(reduceComm, &nReducedRanks) );
+        isReduceRoot = (reduceRank == 0);
+    }
+
+    // bins matching the primary cell list: the particles are already sorted by bin
+    for (auto pv : pvs)
+    {
+        auto cl = dynamic_cast<PrimaryCellList*>(simulation->gelCellList(pv));
+        const bool matches = cl != nullptr &&
+            cl->ncells.x == resolution.x && cl->ncells.y == resolution.y && cl->ncells.z == resolution.z;
+
+        binCellLists.push_back(matches ? cl : nullptr);
+        if (matches)
+            debug("Plugin '%s' samples pv '%s' through its cell list", name.c_str(), pv->name.c_str());
+    }
+
     info("Plugin '%s' initialized for the %d PVs and channels %s, resolution %dx%dx%d",
          name.c_str(), pvs.size(), allChannels.c_str(),
          resolution.x, resolution.y, resolution.z);
 }
 
-void Average3D::sampleOnePv(ParticleVector *pv, cudaStream_t stream)
+void Average3D::sampleOnePv(ParticleVector *pv, CellList *cl, cudaStream_t stream)
 {
-    CellListInfo cinfo(binSize, state->domain.localSize);
+    if (cl == nullptr)
+    {
+        addSamplingReducers(pv, state->domain.localSize, make_float3(0.0f), false);
+        return;
+    }
+
     PVview pvView(pv, pv->local());
     ChannelsInfo gpuInfo(channelsInfo, pv, stream);
 
     const int nthreads = 128;
-    SAFE_KERNEL_LAUNCH
-        (AverageFlowKernels::sample,
-         getNblocks(pvView.size, nthreads), nthreads, 0, stream,
-         pvView, cinfo, density.devPtr(), gpuInfo);
+    if (doublePrecision)
+        SAFE_KERNEL_LAUNCH
+            (AverageFlowKernels::sampleByCells<double>,
+             getNblocks(cl->getActiveCellsBound(), nthreads), nthreads, 0, stream,
+             pvView, cl->cellInfo(), accumulated_density.devPtr(), gpuInfo);
+    else
+        SAFE_KERNEL_LAUNCH
+            (AverageFlowKernels::sampleByCells<float>,
+             getNblocks(cl->getActiveCellsBound(), nthreads), nthreads, 0, stream,
+             pvView, cl->cellInfo(), density.devPtr(), gpuInfo);
 }
 
 static void accumulateOneArray(int n, int components, const float *src, double *dst, cudaStream_t stream)
@@ -161,11 +300,13 @@ void Average3D::afterIntegration(cudaStream_t stream)
 
     debug2("Plugin %s is sampling now", name.c_str());
 
-    for (auto& pv : pvs) sampleOnePv(pv, stream);
+    for (int i = 0; i < pvs.size(); i++)
+        sampleOnePv(pvs[i], binCellLists[i], stream);
 
-    accumulateSampledAndClear(stream);
-    
-    nSamples++;
+    pipeline->onCompletion([this] (cudaStream_t stream) {
+        if (!doublePrecision) accumulateSampledAndClear(stream);
+        nSamples++;
+    });
 }
 
 void Average3D::scaleSampled(cudaStream_t stream)
@@ -191,7 +332,7 @@ void Average3D::scaleSampled(cudaStream_t stream)
     SAFE_KERNEL_LAUNCH(
             SamplingHelpersKernels::scaleDensity,
             getNblocks(ncells, nthreads), nthreads, 0, stream,
-            ncells, accumulated_density.devPtr(), 1.0 / (nSamples * binSize.x*binSize.y*binSize.z) );
+            ncells, accumulated_density.devPtr(), 1.0 / (nSamples * binSize.x*binSize.y*binSize.z * nReducedRanks) );
 
     accumulated_density.downloadFromDevice(stream, ContainersSynch::Synch);
     accumulated_density.clearDevice(stream);
@@ -203,13 +344,56 @@ void Average3D::serializeAndSend(cudaStream_t stream)
 {
     if (state->currentStep % dumpEvery != 0 || state->currentStep == 0) return;
     if (nSamples == 0) return;
-    
+
+    // the previous averages are sent straight from the host buffers
+    waitPrevSend();
+
+    if (reduceComm != MPI_COMM_NULL)
+        reduceAlongAxes(stream);
+
     scaleSampled(stream);
 
     debug2("Plugin '%s' is now packing the data", name.c_str());
-    waitPrevSend();
-    SimpleSerializer::serialize(sendBuffer, state->currentTime, accumulated_density, accumulated_average);
-    send(sendBuffer);
+
+    if (!isReduceRoot)
+    {
+        SimpleSerializer::serialize(sendBuffer, state->currentTime, std::vector<double>(), std::vector<std::vector<double>>());
+        send(sendBuffer);
+        return;
+    }
+
+    SimpleSerializer::serializeChunks(sendBuffer, sendChunks, state->currentTime, accumulated_density, accumulated_average);
+    send(sendChunks);
+}
+
+void Average3D::reduceAlongAxes(cudaStream_t stream)
+{
+    auto reduce = [&] (PinnedBuffer<double>& buffer) {
+        buffer.downloadFromDevice(stream, ContainersSynch::Synch);
+
+        if (isReduceRoot)
+        {
+            MPI_Check( MPI_Reduce(MPI_IN_PLACE, buffer.hostPtr(), buffer.size(), MPI_DOUBLE, MPI_SUM, 0, reduceComm) );
+            buffer.uploadToDevice(stream);
+        }
+        else
+            MPI_Check( MPI_Reduce(buffer.hostPtr(), nullptr, buffer.size(), MPI_DOUBLE, MPI_SUM, 0, reduceComm) );
+    };
+
+    // the sums, before the channels are divided by the density
+    reduce(accumulated_density);
+    for (auto& average : accumulated_average)
+        reduce(average);
+}
+
+SimulationPlugin::HookPeriod Average3D::getHookPeriod(Hook hook) const
+{
+    switch (hook)
+    {
+        case Hook::AfterIntegration:  return {sampleEvery, 0};
+        case Hook::SerializeSend:     return {dumpEvery, 0};
+        default:                      return {0, 0};
+    }
 }
 
 void Average3D::handshake()
@@ -219,7 +403,13 @@ void Average3D::handshake()
     for (auto t : channelsInfo.types)
         sizes.push_back(getNcomponents(t));
     
-    SimpleSerializer::serialize(sendBuffer, nranks3D, rank3D, resolution, binSize, sizes, channelsInfo.names);
+    // a reduced bin spans the whole domain
+    float3 h = binSize;
+    if (reducedAxes.x) h.x *= nranks3D.x;
+    if (reducedAxes.y) h.y *= nranks3D.y;
+    if (reducedAxes.z) h.z *= nranks3D.z;
+
+    SimpleSerializer::serialize(sendBuffer, nranks3D, rank3D, resolution, h, sizes, channelsInfo.names, reducedAxes);
     send(sendBuffer);
 }
 
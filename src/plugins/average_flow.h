@@ -8,6 +8,8 @@
 #include <vector>
 
 class ParticleVector;
+class CellList;
+class SamplingPipeline;
 
 class Average3D : public SimulationPlugin
 {
@@ -24,17 +26,34 @@ public:
         PinnedBuffer<ChannelType> types;
         PinnedBuffer<float*> averagePtrs, dataPtrs;
         std::vector<DeviceBuffer<float>> average;
+
+        /// sample straight into the double accumulators instead of average, see Average3D()
+        bool doublePrecision;
+        PinnedBuffer<double*> accumulatedPtrs;
     };
 
+    /**
+     * With \p doublePrecision, every sample is added to the double device accumulators directly,
+     * instead of being binned in float and then accumulated. Long averages then keep their precision,
+     * at the cost of double atomics.
+     *
+     * The axes set in \p reducedAxes are averaged over: the subdomain has a single bin along them,
+     * and at the dumps the sums are reduced over the ranks of the rank grid that only differ along these axes.
+     * Only the first of them sends its profile or plane, the others send empty grids
+     */
     Average3D(const YmrState *state, std::string name,
               std::vector<std::string> pvNames,
               std::vector<std::string> channelNames, std::vector<Average3D::ChannelType> channelTypes,
-              int sampleEvery, int dumpEvery, float3 binSize);
+              int sampleEvery, int dumpEvery, float3 binSize, bool doublePrecision = false,
+              int3 reducedAxes = make_int3(0, 0, 0));
+
+    ~Average3D();
 
     void setup(Simulation* simulation, const MPI_Comm& comm, const MPI_Comm& interComm) override;
     void handshake() override;
     void afterIntegration(cudaStream_t stream) override;
     void serializeAndSend(cudaStream_t stream) override;
+    HookPeriod getHookPeriod(Hook hook) const override;
 
     bool needPostproc() override { return true; }
 
@@ -45,12 +64,23 @@ protected:
     int3 resolution;
     float3 binSize;
     int3 rank3D, nranks3D;
+    bool doublePrecision;
+
+    int3 reducedAxes;
+    MPI_Comm reduceComm {MPI_COMM_NULL};   ///< the ranks along the reduced axes, MPI_COMM_NULL without any
+    int nReducedRanks {1};
+    bool isReduceRoot {true};
 
     DeviceBuffer<float>   density;
     PinnedBuffer<double>  accumulated_density;
     std::vector<char> sendBuffer;
+    std::vector<std::pair<const void*, int>> sendChunks;
 
     std::vector<ParticleVector*> pvs;
+    SamplingPipeline *pipeline;
+
+    /// primary cell lists of the pvs whose cells are the bins, nullptr for the others
+    std::vector<CellList*> binCellLists;
 
     HostChannelsInfo channelsInfo;
     std::vector<PinnedBuffer<double>> accumulated_average;
@@ -59,6 +89,13 @@ protected:
     void accumulateSampledAndClear(cudaStream_t stream);
     void scaleSampled(cudaStream_t stream);
 
-    void sampleOnePv(ParticleVector *pv, cudaStream_t stream);
+    /// add the accumulated sums of the ranks of #reduceComm on its first rank
+    void reduceAlongAxes(cudaStream_t stream);
+
+    /// bin the density and the channels of \p pv over a domain of size \p domainSize in the next run of the SamplingPipeline
+    void addSamplingReducers(ParticleVector *pv, float3 domainSize, float3 shift, bool periodic);
+
+    /// through the cell list \p cl if its cells are the bins, otherwise with the sampling pipeline
+    void sampleOnePv(ParticleVector *pv, CellList *cl, cudaStream_t stream);
 };
 
@@ -3,46 +3,22 @@
 #include "utils/sampling_helpers.h"
 #include "utils/simple_serializer.h"
 
-#include <core/celllist.h>
 #include <core/pvs/object_vector.h>
 #include <core/pvs/particle_vector.h>
-#include <core/pvs/views/pv.h>
 #include <core/rigid_kernels/rigid_motion.h>
 #include <core/simulation.h>
 #include <core/utils/cuda_common.h>
 #include <core/utils/kernel_launch.h>
 
-namespace AverageRelativeFlowKernels
-{
-__global__ void sampleRelative(
-        PVview pvView, CellListInfo cinfo,
-        float* avgDensity,
-        ChannelsInfo channelsInfo,
-        float3 relativePoint)
-{
-    const int pid = threadIdx.x + blockIdx.x*blockDim.x;
-    if (pid >= pvView.size) return;
-
-    Particle p(pvView.particles, pid);
-    p.r -= relativePoint;
-
-    int3 cid3 = cinfo.getCellIdAlongAxes<CellListsProjection::NoClamp>(p.r);
-    cid3 = (cid3 + cinfo.ncells) % cinfo.ncells;
-    const int cid = cinfo.encode(cid3);
-
-    atomicAdd(avgDensity + cid, 1);
-
-    SamplingHelpersKernels::sampleChannels(pid, cid, channelsInfo);
-}
-} // namespace AverageRelativeFlowKernels
+#include <algorithm>
 
 AverageRelative3D::AverageRelative3D(
     const YmrState *state, std::string name, std::vector<std::string> pvNames,
     std::vector<std::string> channelNames,
     std::vector<Average3D::ChannelType> channelTypes, int sampleEvery,
-    int dumpEvery, float3 binSize, std::string relativeOVname, int relativeID) :
+    int dumpEvery, float3 binSize, std::string relativeOVname, int relativeID, bool doublePrecision) :
     Average3D(state, name, pvNames, channelNames, channelTypes, sampleEvery,
-              dumpEvery, binSize),
+              dumpEvery, binSize, doublePrecision),
     relativeOVname(relativeOVname), relativeID(relativeID)
 {}
 
@@ -57,6 +33,7 @@ void AverageRelative3D::setup(Simulation* simulation, const MPI_Comm& comm, cons
     density.resize_anew(global_size);
     accumulated_density.resize_anew(global_size);
     density.clear(0);
+    accumulated_density.clear(0);
 
     localChannels.resize(channelsInfo.n);
 
@@ -67,10 +44,13 @@ void AverageRelative3D::setup(Simulation* simulation, const MPI_Comm& comm, cons
         channelsInfo.average[i].resize_anew(global_size);
         accumulated_average [i].resize_anew(global_size);
         channelsInfo.average[i].clear(0);
+        accumulated_average [i].clear(0);
         channelsInfo.averagePtrs[i] = channelsInfo.average[i].devPtr();
+        channelsInfo.accumulatedPtrs[i] = accumulated_average[i].devPtr();
     }
 
     channelsInfo.averagePtrs.uploadToDevice(0);
+    channelsInfo.accumulatedPtrs.uploadToDevice(0);
     channelsInfo.types.uploadToDevice(0);
 
     // Relative stuff
@@ -91,15 +71,8 @@ void AverageRelative3D::setup(Simulation* simulation, const MPI_Comm& comm, cons
 
 void AverageRelative3D::sampleOnePv(float3 relativeParam, ParticleVector *pv, cudaStream_t stream)
 {
-    CellListInfo cinfo(binSize, state->domain.globalSize);
-    PVview pvView(pv, pv->local());
-    ChannelsInfo gpuInfo(channelsInfo, pv, stream);
-
-    const int nthreads = 128;
-    SAFE_KERNEL_LAUNCH
-        (AverageRelativeFlowKernels::sampleRelative,
-         getNblocks(pvView.size, nthreads), nthreads, 0, stream,
-         pvView, cinfo, density.devPtr(), gpuInfo, relativeParam);
+    // periodic bins of the whole domain, centered on the relative object
+    addSamplingReducers(pv, state->domain.globalSize, relativeParam, true);
 }
 
 void AverageRelative3D::afterIntegration(cudaStream_t stream)
@@ -145,22 +118,44 @@ void AverageRelative3D::afterIntegration(cudaStream_t stream)
 
     for (auto& pv : pvs) sampleOnePv(relativeParams[0], pv, stream);
 
-    accumulateSampledAndClear(stream);
-    
     averageRelativeVelocity += relativeParams[1];
 
-    nSamples++;
+    pipeline->onCompletion([this] (cudaStream_t stream) {
+        if (!doublePrecision) accumulateSampledAndClear(stream);
+        nSamples++;
+    });
 }
 
 
+void AverageRelative3D::reduceAccumulated()
+{
+    // the density and all the channels go in one buffer, reduced at once
+    std::vector<PinnedBuffer<double>*> arrays {&accumulated_density};
+    for (auto& channel : accumulated_average)
+        arrays.push_back(&channel);
+
+    std::vector<double> all;
+    for (auto a : arrays)
+        all.insert(all.end(), a->hostPtr(), a->hostPtr() + a->size());
+
+    MPI_Check( MPI_Allreduce(MPI_IN_PLACE, all.data(), all.size(), MPI_DOUBLE, MPI_SUM, comm) );
+
+    size_t offset = 0;
+    for (auto a : arrays)
+    {
+        std::copy(all.begin() + offset, all.begin() + offset + a->size(), a->hostPtr());
+        offset += a->size();
+    }
+}
+
 void AverageRelative3D::extractLocalBlock()
 {
     static const double scale_by_density = -1.0;
+
+    reduceAccumulated();
     
     auto oneChannel = [this] (const PinnedBuffer<double>& channel, Average3D::ChannelType type, double scale, std::vector<double>& dest) {
 
-        MPI_Check( MPI_Allreduce(MPI_IN_PLACE, channel.hostPtr(), channel.size(), MPI_DOUBLE, MPI_SUM, comm) );
-
         int ncomponents = this->getNcomponents(type);
 
         int3 globalResolution = resolution * nranks3D;
@@ -222,13 +217,14 @@ void AverageRelative3D::serializeAndSend(cudaStream_t stream)
 
     CUDA_Check( cudaStreamSynchronize(stream) );
 
+    // the previous blocks are sent in place
+    waitPrevSend();
     extractLocalBlock();
     nSamples = 0;
 
 
     debug2("Plugin '%s' is now packing the data", name.c_str());
-    waitPrevSend();
-    SimpleSerializer::serialize(sendBuffer, state->currentTime, localDensity, localChannels);
-    send(sendBuffer);
+    SimpleSerializer::serializeChunks(sendBuffer, sendChunks, state->currentTime, localDensity, localChannels);
+    send(sendChunks);
 }
 
@@ -20,7 +20,7 @@ public:
                       std::vector<std::string> channelNames,
                       std::vector<Average3D::ChannelType> channelTypes,
                       int sampleEvery, int dumpEvery, float3 binSize,
-                      std::string relativeOVname, int relativeID);
+                      std::string relativeOVname, int relativeID, bool doublePrecision = false);
 
   void setup(Simulation *simulation, const MPI_Comm &comm,
              const MPI_Comm &interComm) override;
@@ -41,6 +41,7 @@ private:
     std::vector<std::vector<double>> localChannels;
     std::vector<double> localDensity;
 
+    void reduceAccumulated();
     void extractLocalBlock();
 
     void sampleOnePv(float3 relativeParam, ParticleVector *pv, cudaStream_t stream);
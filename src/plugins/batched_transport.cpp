@@ -0,0 +1,87 @@
+#include "batched_transport.h"
+
+#include <core/logger.h>
+
+#include <cstring>
+
+BatchedSender::BatchedSender(MPI_Comm interComm, int nInflight) :
+    interComm(interComm),
+    slots(nInflight)
+{
+    if (nInflight < 1)
+        die("Batched plugin messages need at least 1 batch in flight, got %d", nInflight);
+
+    MPI_Check( MPI_Comm_rank(interComm, &rank) );
+    _append(&nMessages, sizeof(int));
+}
+
+BatchedSender::~BatchedSender()
+{
+    wait();
+}
+
+void BatchedSender::_append(const void *ptr, int size)
+{
+    const size_t start = batch.size();
+    batch.resize(start + size);
+    memcpy(batch.data() + start, ptr, size);
+}
+
+void BatchedSender::add(const std::string& pluginName, const std::vector<std::pair<const void*, int>>& chunks)
+{
+    int size = 0;
+    for (auto& chunk : chunks)
+        size += chunk.second;
+
+    const int nameLength = pluginName.size();
+    _append(&nameLength, sizeof(int));
+    _append(pluginName.data(), nameLength);
+    _append(&size, sizeof(int));
+
+    for (auto& chunk : chunks)
+        if (chunk.second > 0)
+            _append(chunk.first, chunk.second);
+
+    nMessages++;
+}
+
+void BatchedSender::flush()
+{
+    if (nMessages == 0) return;
+
+    memcpy(batch.data(), &nMessages, sizeof(int));
+
+    auto& slot = slots[nextSlot];
+    nextSlot = (nextSlot + 1) % slots.size();
+
+    int done;
+    MPI_Check( MPI_Test(&slot.dataReq, &done, MPI_STATUS_IGNORE) );
+    if (!done && !warnedFull)
+    {
+        warn("The postprocess is %d batches of plugin messages behind, the simulation waits for it", (int) slots.size());
+        warnedFull = true;
+    }
+
+    MPI_Check( MPI_Wait(&slot.sizeReq, MPI_STATUS_IGNORE) );
+    MPI_Check( MPI_Wait(&slot.dataReq, MPI_STATUS_IGNORE) );
+
+    std::swap(slot.buffer, batch);
+    slot.size = slot.buffer.size();
+
+    debug2("Sending a batch of %d plugin messages (%d bytes)", nMessages, slot.size);
+    MPI_Check( MPI_Issend(&slot.size, 1, MPI_INT, rank, sizeTag, interComm, &slot.sizeReq) );
+    MPI_Check( MPI_Issend(slot.buffer.data(), slot.size, MPI_BYTE, rank, dataTag, interComm, &slot.dataReq) );
+
+    batch.clear();
+    nMessages = 0;
+    _append(&nMessages, sizeof(int));
+}
+
+void BatchedSender::wait()
+{
+    for (auto& slot : slots)
+    {
+        MPI_Check( MPI_Wait(&slot.sizeReq, MPI_STATUS_IGNORE) );
+        MPI_Check( MPI_Wait(&slot.dataReq, MPI_STATUS_IGNORE) );
+    }
+}
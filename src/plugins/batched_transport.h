@@ -0,0 +1,84 @@
+#pragma once
+
+#include <mpi.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Shared transport of the messages of the simulation plugins to the postprocess.
+ *
+ * Instead of one pair of sends per plugin and per message, the messages sent by
+ * all the plugins during a step are copied into one batch, sent by flush()
+ * at the end of the plugin tasks of the step. Up to nInflight batches may be
+ * in flight at the same time, such that the compute ranks only wait when the
+ * postprocess side falls that many steps behind.
+ *
+ * A batch is sent as its size (tag sizeTag) and its data (tag dataTag):
+ * the number of messages, then for every message the name of the plugin
+ * (int length and characters), the int size of the message and its bytes.
+ * See Postprocess::run() for the receiving side
+ */
+class BatchedSender
+{
+public:
+    static const int sizeTag = 424243;
+    static const int dataTag = 424244;
+
+    BatchedSender(MPI_Comm interComm, int nInflight);
+    ~BatchedSender();
+
+    /// copy the message of the plugin \p pluginName, made of the \p chunks [pointer, size in bytes]
+    void add(const std::string& pluginName, const std::vector<std::pair<const void*, int>>& chunks);
+
+    /// send the messages added since the last flush, if any
+    void flush();
+
+    /// block until all the batches are received
+    void wait();
+
+private:
+    struct Slot
+    {
+        std::vector<char> buffer;
+        int size{0};
+        MPI_Request sizeReq{MPI_REQUEST_NULL}, dataReq{MPI_REQUEST_NULL};
+    };
+
+    MPI_Comm interComm;
+    int rank;
+
+    std::vector<Slot> slots;
+    int nextSlot{0};
+
+    std::vector<char> batch;
+    int nMessages{0};
+
+    bool warnedFull{false};
+
+    void _append(const void *ptr, int size);
+};
+
+/// demultiplex a batch sent by BatchedSender and call \p process(name, data, size) for every message
+template <typename Process>
+void forEachBatchedMessage(const std::vector<char>& batch, Process process)
+{
+    const char *ptr = batch.data();
+    auto readInt = [&ptr] () {
+               int v = *((const int*) ptr);
+               ptr += sizeof(int);
+               return v;
+           };
+
+    const int nMessages = readInt();
+    for (int i = 0; i < nMessages; i++)
+    {
+        const int nameLength = readInt();
+        std::string name(ptr, ptr + nameLength);
+        ptr += nameLength;
+
+        const int size = readInt();
+        process(name, ptr, size);
+        ptr += size;
+    }
+}
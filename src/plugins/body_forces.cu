@@ -0,0 +1,102 @@
+#include "body_forces.h"
+
+#include <core/logger.h>
+#include <core/pvs/rigid_object_vector.h>
+#include <core/pvs/views/rov.h>
+#include <core/rigid_kernels/quaternion.h>
+#include <core/utils/cuda_common.h>
+#include <core/utils/kernel_launch.h>
+
+#include <algorithm>
+
+namespace BodyForcesKernels
+{
+
+/**
+ * One thread per particle and per object:
+ * adds \p force to the particles if \p hasForce, the torques to the objects of \p rovView if any
+ */
+__global__ void applyBodyForces(PVview pvView, bool hasForce, float3 force,
+                                ROVview rovView, float3 torque, BodyForces::MagneticTerms magnetic)
+{
+    const int gid = blockIdx.x * blockDim.x + threadIdx.x;
+
+    if (hasForce && gid < pvView.size)
+        pvView.forces[gid] += make_float4(force, 0.0f);
+
+    if (gid < rovView.nObjects)
+    {
+        const auto q = rovView.motions[gid].q;
+        float3 T = torque;
+
+        for (int i = 0; i < magnetic.n; i++)
+            T += cross(rotate(magnetic.moments[i], q), magnetic.fields[i]);
+
+        rovView.motions[gid].torque += T;
+    }
+}
+
+} // namespace BodyForcesKernels
+
+BodyForces::Terms& BodyForces::getTerms(ParticleVector *pv)
+{
+    for (auto& t : terms)
+        if (t.pv == pv) return t;
+
+    terms.push_back(Terms());
+    terms.back().pv = pv;
+    return terms.back();
+}
+
+void BodyForces::addForce(ParticleVector *pv, float3 force)
+{
+    auto& t = getTerms(pv);
+    t.hasForce = true;
+    t.force += force;
+}
+
+void BodyForces::addTorque(RigidObjectVector *rov, float3 torque)
+{
+    auto& t = getTerms(rov);
+    t.rov = rov;
+    t.hasTorque = true;
+    t.torque += torque;
+}
+
+void BodyForces::addMagneticTorque(RigidObjectVector *rov, float3 moment, float3 B)
+{
+    auto& t = getTerms(rov);
+    auto& m = t.magnetic;
+
+    if (m.n >= maxMagneticTerms)
+        die("At most %d magnetic fields can act on the objects '%s'", maxMagneticTerms, rov->name.c_str());
+
+    t.rov = rov;
+    t.hasTorque = true;
+    m.moments[m.n] = moment;
+    m.fields [m.n] = B;
+    m.n++;
+}
+
+void BodyForces::run(cudaStream_t stream)
+{
+    const int nthreads = 128;
+
+    for (auto& t : terms)
+    {
+        PVview  pvView (t.pv, t.pv->local());
+        ROVview rovView;
+        if (t.hasTorque)
+            rovView = ROVview(t.rov, t.rov->local());
+
+        const int n = std::max(t.hasForce ? pvView.size : 0, rovView.nObjects);
+        if (n == 0) continue;
+
+        SAFE_KERNEL_LAUNCH(
+                BodyForcesKernels::applyBodyForces,
+                getNblocks(n, nthreads), nthreads, 0, stream,
+                pvView, t.hasForce, t.force, rovView, t.torque, t.magnetic );
+    }
+
+    terms.clear();
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cuda_runtime.h>
+#include <vector>
+
+class ParticleVector;
+class RigidObjectVector;
+
+/**
+ * Shared body forces of the plugins.
+ *
+ * Instead of each launching a small kernel per particle vector, the plugins add()
+ * their constant forces and torques during their beforeForces() hook. Simulation then calls run()
+ * once all the hooks are done: it launches one kernel per particle vector
+ * which applies the sum of its forces to every particle and the sum of its torques,
+ * including the magnetic ones, to every rigid object.
+ * The terms are cleared by run(), they are added again at every step
+ */
+class BodyForces
+{
+public:
+    /// the same force on every particle of \p pv
+    void addForce(ParticleVector *pv, float3 force);
+
+    /// the same torque on every object of \p rov
+    void addTorque(RigidObjectVector *rov, float3 torque);
+
+    /// torque of the uniform field \p B on the magnetic \p moment of every object of \p rov, in the object frame
+    void addMagneticTorque(RigidObjectVector *rov, float3 moment, float3 B);
+
+    /// apply all the terms added since the last run
+    void run(cudaStream_t stream);
+
+    /// magnetic terms per rigid object vector per step, passed to the kernel by value
+    static const int maxMagneticTerms = 8;
+
+    struct MagneticTerms
+    {
+        int n {0};
+        float3 moments[maxMagneticTerms];
+        float3 fields [maxMagneticTerms];
+    };
+
+private:
+    struct Terms
+    {
+        ParticleVector *pv;
+        RigidObjectVector *rov {nullptr};
+
+        bool hasForce {false}, hasTorque {false};
+        float3 force  {0.0f, 0.0f, 0.0f};
+        float3 torque {0.0f, 0.0f, 0.0f};
+
+        MagneticTerms magnetic;
+    };
+
+    std::vector<Terms> terms;
+
+    Terms& getTerms(ParticleVector *pv);
+};
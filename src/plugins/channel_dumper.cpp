@@ -7,9 +7,15 @@
 
 #include <string>
 
-UniformCartesianDumper::UniformCartesianDumper(std::string name, std::string path) :
-        PostprocessPlugin(name), path(path)
-{   }
+UniformCartesianDumper::UniformCartesianDumper(std::string name, std::string path, XDMF::Compression compression,
+                                               std::string backend, int pyramidLevels) :
+        PostprocessPlugin(name), path(path), compression(compression),
+        backend(createOutputBackend(backend)),
+        pyramidLevels(pyramidLevels)
+{
+    if (pyramidLevels < 1)
+        die("Plugin '%s' needs at least one pyramid level, got %d", name.c_str(), pyramidLevels);
+}
 
 void UniformCartesianDumper::handshake()
 {
@@ -22,15 +28,41 @@ void UniformCartesianDumper::handshake()
     float3 h;
     std::vector<int> sizes;
     std::vector<std::string> names;
-    SimpleSerializer::deserialize(data, nranks3D, rank3D, resolution, h, sizes, names);
-        
-    int ranksArr[] = {nranks3D.x, nranks3D.y, nranks3D.z};
-    int periods[] = {0, 0, 0};
-    MPI_Check( MPI_Cart_create(comm, 3, ranksArr, periods, 0, &cartComm) );
-    grid = std::make_unique<XDMF::UniformGrid>(resolution, h, cartComm);
+    int3 reduced;
+    SimpleSerializer::deserialize(data, nranks3D, rank3D, resolution, h, sizes, names, reduced);
+
+    // with reduced axes, only the ranks at the start of these axes have data and write
+    writer = !( (reduced.x && rank3D.x != 0) || (reduced.y && rank3D.y != 0) || (reduced.z && rank3D.z != 0) );
+
+    if (reduced.x) nranks3D.x = 1;
+    if (reduced.y) nranks3D.y = 1;
+    if (reduced.z) nranks3D.z = 1;
+
+    MPI_Comm writersComm;
+    MPI_Check( MPI_Comm_split(comm, writer ? 0 : MPI_UNDEFINED, rank, &writersComm) );
+
+    if (writer)
+    {
+        int ranksArr[] = {nranks3D.x, nranks3D.y, nranks3D.z};
+        int periods[] = {0, 0, 0};
+        MPI_Check( MPI_Cart_create(writersComm, 3, ranksArr, periods, 0, &cartComm) );
+        MPI_Check( MPI_Comm_free(&writersComm) );
+        grid = std::make_unique<XDMF::UniformGrid>(resolution, h, cartComm);
+        localResolution = resolution;
+
+        for (int level = 1; level < pyramidLevels; level++)
+        {
+            const int factor = 1 << level;
+            if (resolution.x % factor != 0 || resolution.y % factor != 0 || resolution.z % factor != 0)
+                die("Plugin '%s': the local resolution %dx%dx%d cannot be coarsened %d times for pyramid level %d",
+                    name.c_str(), resolution.x, resolution.y, resolution.z, factor, level);
+
+            coarseGrids.push_back(std::make_unique<XDMF::UniformGrid>(resolution / factor, h * (float) factor, cartComm));
+        }
+    }
         
-    auto init_channel = [] (XDMF::Channel::DataForm dataForm, const std::string& str) {
-        return XDMF::Channel(str, nullptr, dataForm, XDMF::Channel::NumberType::Float, typeTokenize<float>());
+    auto init_channel = [this] (XDMF::Channel::DataForm dataForm, const std::string& str) {
+        return XDMF::Channel(str, nullptr, dataForm, XDMF::Channel::NumberType::Float, typeTokenize<float>(), compression);
     };
     
     // Density is a special channel which is always present
@@ -52,12 +84,50 @@ void UniformCartesianDumper::handshake()
     }
     
     // Create the required folder
-    createFoldersCollective(comm, parentPath(path));
+    if (backend->writesFiles())
+        createFoldersCollective(comm, parentPath(path));
 
     debug2("Plugin %s was set up to dump channels %s. Resolution is %dx%dx%d, path is %s", name.c_str(),
             allNames.c_str(), resolution.x, resolution.y, resolution.z, path.c_str());
 }
 
+/**
+ * Halve the resolution \p res of the \p fields, the first one being the density:
+ * the density is averaged over the 8 fine bins, the other fields are weighted by the fine density.
+ */
+static void coarsen(int3 res, const std::vector<int>& components, const std::vector<const float*>& fine,
+                    std::vector<std::vector<float>>& coarse)
+{
+    const int3 cres = res / 2;
+    const int ncoarse = cres.x * cres.y * cres.z;
+
+    coarse.resize(fine.size());
+    for (int f = 0; f < fine.size(); f++)
+        coarse[f].assign(ncoarse * components[f], 0.0f);
+
+    for (int iz = 0; iz < res.z; iz++)
+        for (int iy = 0; iy < res.y; iy++)
+            for (int ix = 0; ix < res.x; ix++)
+            {
+                const int fid = (iz * res.y + iy) * res.x + ix;
+                const int cid = ((iz/2) * cres.y + iy/2) * cres.x + ix/2;
+                const float d = fine[0][fid];
+
+                coarse[0][cid] += 0.125f * d;
+                for (int f = 1; f < fine.size(); f++)
+                    for (int c = 0; c < components[f]; c++)
+                        coarse[f][cid * components[f] + c] += d * fine[f][fid * components[f] + c];
+            }
+
+    for (int cid = 0; cid < ncoarse; cid++)
+    {
+        const float invMass = coarse[0][cid] > 0 ? 0.125f / coarse[0][cid] : 0.0f;
+        for (int f = 1; f < fine.size(); f++)
+            for (int c = 0; c < components[f]; c++)
+                coarse[f][cid * components[f] + c] *= invMass;
+    }
+}
+
 static void convert(const std::vector<double> &src, std::vector<float> &dst)
 {
     dst.resize(src.size());
@@ -69,6 +139,8 @@ void UniformCartesianDumper::deserialize(MPI_Status& stat)
 {
     TimeType t;
     SimpleSerializer::deserialize(data, t, recv_density, recv_containers);
+
+    if (!writer) return;
     
     debug2("Plugin '%s' will dump right now: simulation time %f, time stamp %d",
            name.c_str(), t, timeStamp);
@@ -86,7 +158,35 @@ void UniformCartesianDumper::deserialize(MPI_Status& stat)
     std::string tstr = std::to_string(timeStamp++);
     std::string fname = path + std::string(zeroPadding - tstr.length(), '0') + tstr;
         
-    XDMF::write(fname, grid.get(), channels, t, cartComm);
+    backend->write(fname, grid.get(), channels, t, cartComm);
+
+    // every level from the previous one, the channels of the dump being reused with their data replaced
+    std::vector<int> components;
+    std::vector<const float*> fine;
+    for (const auto& ch : channels)
+    {
+        components.push_back(ch.nComponents());
+        fine.push_back((const float*) ch.data);
+    }
+
+    auto levelChannels = channels;
+    auto res = localResolution;
+    std::vector<std::vector<float>> previous;
+
+    for (int level = 1; level < pyramidLevels; level++)
+    {
+        coarsen(res, components, fine, coarseData);
+
+        for (int f = 0; f < levelChannels.size(); f++)
+            levelChannels[f].data = coarseData[f].data();
+
+        backend->write(fname + "_l" + std::to_string(level), coarseGrids[level-1].get(), levelChannels, t, cartComm);
+
+        std::swap(previous, coarseData);
+        for (int f = 0; f < fine.size(); f++)
+            fine[f] = previous[f].data();
+        res = res / 2;
+    }
 }
 
 XDMF::Channel UniformCartesianDumper::getChannelOrDie(std::string chname) const
@@ -103,6 +203,9 @@ XDMF::Channel UniformCartesianDumper::getChannelOrDie(std::string chname) const
 
 std::vector<int> UniformCartesianDumper::getLocalResolution() const
 {
+    // the ranks without data along reduced axes hold an empty grid
+    if (!writer) return {0, 0, 0};
+
     std::vector<int> res;
     for (auto v : grid->getGridDims()->getLocalSize())
         res.push_back(v);
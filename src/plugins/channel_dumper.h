@@ -6,11 +6,19 @@
 
 #include <plugins/interface.h>
 #include <core/xdmf/xdmf.h>
+#include <plugins/utils/output_backend.h>
 
 class UniformCartesianDumper : public PostprocessPlugin
 {
 public:
-    UniformCartesianDumper(std::string name, std::string path);
+    /**
+     * \p backend: destination of the dumps, see createOutputBackend().
+     * With \p pyramidLevels > 1, every dump is followed by the grids coarsened 2, 4, ... times along each axis,
+     * written as <dump>_l1, <dump>_l2, ...: the coarse density is the mean of the 8 finer bins,
+     * the coarse channels their mean weighted by the density
+     */
+    UniformCartesianDumper(std::string name, std::string path, XDMF::Compression compression = XDMF::Compression(),
+                           std::string backend = "file", int pyramidLevels = 1);
 
     void deserialize(MPI_Status& stat) override;
     void handshake() override;
@@ -30,8 +38,16 @@ protected:
     std::vector<std::vector<float>> containers;
     
     std::string path;
+    XDMF::Compression compression;
+    std::unique_ptr<OutputBackend> backend;
     int timeStamp = 0;
     const int zeroPadding = 5;
 
+    int3 localResolution;
+    int pyramidLevels;
+    std::vector<std::unique_ptr<XDMF::UniformGrid>> coarseGrids;   ///< of the levels 1 to pyramidLevels-1
+    std::vector<std::vector<float>> coarseData;                     ///< density then the channels of one level
+
     MPI_Comm cartComm;
+    bool writer {true};    ///< false on the ranks sending empty grids along reduced axes, see Average3D
 };
@@ -3,11 +3,11 @@
 
 #include <core/field/from_function.h>
 #include <core/field/utils.h>
+#include <core/field/volumes.h>
 #include <core/pvs/particle_vector.h>
 #include <core/pvs/views/pv.h>
 #include <core/simulation.h>
 #include <core/utils/cuda_common.h>
-#include <core/utils/cuda_rng.h>
 #include <core/utils/kernel_launch.h>
 #include <core/utils/make_unique.h>
 
@@ -16,41 +16,23 @@ namespace DensityControlPluginKernels
 
 enum {INVALID_LEVEL=-1};
 
-__device__ int getLevelId(const FieldDeviceHandler& field, const float3& r,
-                           const DensityControlPlugin::LevelBounds& lb)
+/// level set of the field values, see FieldVolumes
+struct LevelBinner
 {
-    float l = field(r);
-    return (l > lb.lo && l < lb.hi) ?
-        (l - lb.lo) / lb.space :
-        INVALID_LEVEL;
-}
+    DensityControlPlugin::LevelBounds lb;
 
-__global__ void countInsideRegions(int nSamples, DomainInfo domain, FieldDeviceHandler field, DensityControlPlugin::LevelBounds lb,
-                                   float seed, unsigned long long int *nInsides)
-{
-    int i = threadIdx.x + blockIdx.x * blockDim.x;
-
-    if (i >= nSamples) return;
-    
-    float3 r {Saru::uniform01(seed, i - 2, i + 4242),
-              Saru::uniform01(seed, i - 3, i + 4343),
-              Saru::uniform01(seed, i - 4, i + 4444)};
-
-    r = domain.localSize * (r - 0.5f);
-
-    int levelId = getLevelId(field, r, lb);
-    
-    if (levelId != INVALID_LEVEL)
-        atomicAdd(&nInsides[levelId], 1);
-}
+    __device__ inline int operator()(float l) const
+    {
+        return (l > lb.lo && l < lb.hi) ?
+            (l - lb.lo) / lb.space :
+            INVALID_LEVEL;
+    }
+};
 
-__global__ void computeVolumes(int nLevels, int nSamples, const unsigned long long int *nInsides, double subdomainVolume, double *volumes)
+__device__ int getLevelId(const FieldDeviceHandler& field, const float3& r,
+                           const DensityControlPlugin::LevelBounds& lb)
 {
-    int i = threadIdx.x + blockIdx.x * blockDim.x;
-    if (i >= nLevels) return;
-
-    double v = subdomainVolume * (double) nInsides[i] / (double) nSamples;
-    volumes[i] = v;
+    return LevelBinner{lb}(field(r));
 }
 
 __global__ void collectSamples(PVview view, FieldDeviceHandler field, DensityControlPlugin::LevelBounds lb, unsigned long long int *nInsides)
@@ -138,7 +120,7 @@ void DensityControlPlugin::setup(Simulation *simulation, const MPI_Comm& comm, c
     densities .resize(nLevelSets);
     densities .assign(nLevelSets, 0.0f);
     
-    computeVolumes(defaultStream, 1000000);
+    computeVolumes(defaultStream);
 
     nInsides  .clearDevice(defaultStream);    
     forces    .clearDevice(defaultStream);
@@ -167,40 +149,18 @@ void DensityControlPlugin::serializeAndSend(cudaStream_t stream)
 }
 
 
-void DensityControlPlugin::computeVolumes(cudaStream_t stream, int MCnSamples)
+void DensityControlPlugin::computeVolumes(cudaStream_t stream)
 {
-    const int nthreads = 128;
-    float seed = 0.42424242f + rank * 17;
-    auto domain = state->domain;    
-    int nLevelSets = nInsides.size();
-
-    PinnedBuffer<double> localVolumes(nLevelSets);
-    
-    nInsides    .clearDevice(stream);
-    localVolumes.clearDevice(stream);
-    
-    SAFE_KERNEL_LAUNCH(
-        DensityControlPluginKernels::countInsideRegions,
-        getNblocks(MCnSamples, nthreads), nthreads, 0, stream,
-        MCnSamples, domain, spaceDecompositionField->handler(),
-        levelBounds, seed, nInsides.devPtr());
-
-    float3 L = domain.localSize;
-    double subdomainVolume = L.x * L.y * L.z;
+    const int nLevelSets = nInsides.size();
 
-    SAFE_KERNEL_LAUNCH(
-        DensityControlPluginKernels::computeVolumes,
-        getNblocks(localVolumes.size(), nthreads), nthreads, 0, stream,
-        localVolumes.size(), MCnSamples, nInsides.devPtr(),
-        subdomainVolume, localVolumes.devPtr());
+    auto localVolumes = FieldVolumes::computeVolumes(*spaceDecompositionField, state->domain,
+                                                     DensityControlPluginKernels::LevelBinner{levelBounds},
+                                                     nLevelSets, 1, stream);
 
     volumes.resize(nLevelSets);
     volumes.assign(nLevelSets, 0.0);
     
-    localVolumes.downloadFromDevice(stream);
-    
-    MPI_Check( MPI_Allreduce(localVolumes.hostPtr(), volumes.data(), volumes.size(), MPI_DOUBLE, MPI_SUM, comm) );
-    // std::copy(localVolumes.begin(), localVolumes.end(), volumes.begin());
+    MPI_Check( MPI_Allreduce(localVolumes.data(), volumes.data(), volumes.size(), MPI_DOUBLE, MPI_SUM, comm) );
 }
 
 void DensityControlPlugin::sample(cudaStream_t stream)
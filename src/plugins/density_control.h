@@ -5,6 +5,7 @@
 
 #include <core/containers.h>
 #include <core/datatypes.h>
+#include <core/field/from_function.h>
 
 #include <functional>
 #include <memory>
@@ -18,7 +19,7 @@ class DensityControlPlugin : public SimulationPlugin
 {
 public:
 
-    using RegionFunc = std::function<float(float3)>;
+    using RegionFunc = FieldBatchFunction;
     
     DensityControlPlugin(const YmrState *state, std::string name,
                          std::vector<std::string> pvNames, float targetDensity,
@@ -63,7 +64,7 @@ private:
     std::vector<char> sendBuffer;
 private:
 
-    void computeVolumes(cudaStream_t stream, int MCnSamples);
+    void computeVolumes(cudaStream_t stream);
     void sample(cudaStream_t stream);
     void updatePids(cudaStream_t stream);
     void applyForces(cudaStream_t stream);
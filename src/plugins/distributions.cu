@@ -0,0 +1,465 @@
+#include "distributions.h"
+#include "utils/simple_serializer.h"
+
+#include <core/celllist.h>
+#include <core/interactions/pairwise_kernels.h>
+#include <core/interactions/pairwise_interactions/fetchers.h>
+#include <core/pvs/particle_vector.h>
+#include <core/pvs/views/pv.h>
+#include <core/simulation.h>
+#include <core/utils/cuda_common.h>
+#include <core/utils/folders.h>
+#include <core/utils/kernel_launch.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace DistributionsKernels
+{
+
+/// the neighbor traversal needs an accumulator, the pairs are only counted
+struct NoAccumulator
+{
+    __device__ inline void add(float) {}
+    __device__ inline void atomicAddToSrc(float, PVview&, int) const {}
+};
+
+/// "interaction" of computeCell() adding \c weight to the shared bin of the distance of the pair
+class PairBinner : public ParticleFetcher
+{
+public:
+    using ViewType = PVview;
+
+    PairBinner(float rmax, int nbins) :
+        ParticleFetcher(rmax),
+        nbins(nbins),
+        invBinSize(nbins / rmax)
+    {}
+
+    __device__ inline float operator()(const ParticleType dst, int dstId, const ParticleType src, int srcId) const
+    {
+        const int bin = sqrtf(distance2(dst.r, src.r)) * invBinSize;
+        if (bin < nbins) atomicAdd(bins + bin, weight);
+        return 0.0f;
+    }
+
+    int nbins;
+    float invBinSize;
+
+    unsigned int *bins {nullptr};
+    unsigned int weight {1};
+};
+
+/**
+ * One thread per destination particle, going over the 27 cells of the source cell list around it.
+ * With InteractionWith::Self the sources are the destinations and every pair is visited once
+ */
+template <InteractionWith InteractWith>
+__global__ void binPairs(PVview dstView, CellListInfo cinfo, PVview srcView, float rmax2, PairBinner binner,
+                         unsigned int weight, unsigned long long *counts)
+{
+    extern __shared__ unsigned int bins[];
+
+    for (int i = threadIdx.x; i < binner.nbins; i += blockDim.x)
+        bins[i] = 0;
+    __syncthreads();
+
+    binner.bins   = bins;
+    binner.weight = weight;
+
+    const int dstId = blockIdx.x * blockDim.x + threadIdx.x;
+    if (dstId < dstView.size)
+    {
+        const auto dstP = binner.readNoCache(dstView, dstId);
+        const int3 cell0 = cinfo.getCellIdAlongAxes<CellListsProjection::NoClamp>(dstP.r);
+
+        NoAccumulator accumulator;
+
+        for (int cellZ = cell0.z-1; cellZ <= cell0.z+1; cellZ++)
+            for (int cellY = cell0.y-1; cellY <= cell0.y+1; cellY++)
+                for (int cellX = cell0.x-1; cellX <= cell0.x+1; cellX++)
+                {
+                    if ( !(cellX >= 0 && cellX < cinfo.ncells.x &&
+                           cellY >= 0 && cellY < cinfo.ncells.y &&
+                           cellZ >= 0 && cellZ < cinfo.ncells.z) ) continue;
+
+                    const int cid = cinfo.encode(cellX, cellY, cellZ);
+
+                    computeCell<InteractionOut::NoAcc, InteractionOut::NoAcc, InteractWith>
+                        (cinfo.cellStarts[cid], cinfo.cellStarts[cid+1], dstP, dstId, srcView,
+                         rmax2, binner, accumulator);
+                }
+    }
+    __syncthreads();
+
+    for (int i = threadIdx.x; i < binner.nbins; i += blockDim.x)
+        if (bins[i] != 0) atomicAdd(counts + i, (unsigned long long) bins[i]);
+}
+
+/// grid-stride over the particles, bins of the 3 components in shared memory
+__global__ void binVelocities(PVview view, float vmax, int nbins, unsigned long long *counts)
+{
+    extern __shared__ unsigned int bins[];
+
+    for (int i = threadIdx.x; i < 3*nbins; i += blockDim.x)
+        bins[i] = 0;
+    __syncthreads();
+
+    const float invBinSize = nbins / (2.0f * vmax);
+
+    for (int pid = blockIdx.x * blockDim.x + threadIdx.x; pid < view.size; pid += blockDim.x * gridDim.x)
+    {
+        Particle p;
+        p.readCoordinate(view.particles, pid);
+        if (p.isMarked()) continue;
+        p.readVelocity(view.particles, pid);
+
+        const float u[3] = {p.u.x, p.u.y, p.u.z};
+        for (int c = 0; c < 3; c++)
+        {
+            const int bin = min(nbins-1, max(0, (int) floorf((u[c] + vmax) * invBinSize)));
+            atomicAdd(bins + c*nbins + bin, 1u);
+        }
+    }
+    __syncthreads();
+
+    for (int i = threadIdx.x; i < 3*nbins; i += blockDim.x)
+        if (bins[i] != 0) atomicAdd(counts + i, (unsigned long long) bins[i]);
+}
+
+} // namespace DistributionsKernels
+
+/// the bins of a block live in the default 48 KB of shared memory
+static const int maxSharedBins = 48 * 1024 / sizeof(unsigned int);
+
+static void checkPeriods(std::string name, int sampleEvery, int dumpEvery)
+{
+    if (sampleEvery < 1 || dumpEvery % sampleEvery != 0)
+        die("Plugin '%s': dump_every (%d) must be a multiple of sample_every (%d)", name.c_str(), dumpEvery, sampleEvery);
+}
+
+RadialDistributionPlugin::RadialDistributionPlugin(const YmrState *state, std::string name, std::string pvName,
+                                                   float rmax, int nbins, int sampleEvery, int dumpEvery) :
+    SimulationPlugin(state, name),
+    pvName(pvName),
+    rmax(rmax),
+    nbins(nbins),
+    sampleEvery(sampleEvery),
+    dumpEvery(dumpEvery)
+{
+    if (rmax <= 0.0f)
+        die("Plugin '%s' needs a positive maximum distance, got %g", name.c_str(), rmax);
+
+    if (nbins < 1 || nbins > maxSharedBins)
+        die("Plugin '%s' needs between 1 and %d bins, got %d", name.c_str(), maxSharedBins, nbins);
+
+    checkPeriods(name, sampleEvery, dumpEvery);
+}
+
+RadialDistributionPlugin::~RadialDistributionPlugin() = default;
+
+void RadialDistributionPlugin::setup(Simulation *simulation, const MPI_Comm& comm, const MPI_Comm& interComm)
+{
+    SimulationPlugin::setup(simulation, comm, interComm);
+
+    pv = simulation->getPVbyNameOrDie(pvName);
+    cl = dynamic_cast<PrimaryCellList*>(simulation->gelCellList(pv));
+
+    if (cl == nullptr)
+        die("Plugin '%s' needs the primary cell list of pv '%s', does it interact with anything?",
+            name.c_str(), pvName.c_str());
+
+    // the halo only holds the particles within one cell of the boundary
+    if (rmax > cl->rc)
+        die("Plugin '%s': the maximum distance %g exceeds the cell size %g of pv '%s'",
+            name.c_str(), rmax, cl->rc, pvName.c_str());
+
+    counts.resize_anew(nbins);
+    counts.clear(defaultStream);
+
+    info("Plugin '%s' bins the pairs of pv '%s' up to %g in %d bins",
+         name.c_str(), pvName.c_str(), rmax, nbins);
+}
+
+void RadialDistributionPlugin::handshake()
+{
+    SimpleSerializer::serialize(sendBuffer, pvName, rmax, nbins, state->domain.globalSize);
+    send(sendBuffer);
+}
+
+void RadialDistributionPlugin::beforeIntegration(cudaStream_t stream)
+{
+    if (state->currentStep % sampleEvery != 0) return;
+
+    debug2("Plugin %s is sampling now", name.c_str());
+
+    // the particles have not moved since the cell lists and the halo were built
+    PVview local(pv, pv->local());
+    PVview halo (pv, pv->halo());
+    DistributionsKernels::PairBinner binner(rmax, nbins);
+
+    const int nthreads = 128;
+    const size_t shMemSize = nbins * sizeof(unsigned int);
+
+    // both orders of the local pairs, one order of the halo pairs: the neighbor rank counts the other
+    SAFE_KERNEL_LAUNCH(
+            DistributionsKernels::binPairs<InteractionWith::Self>,
+            getNblocks(local.size, nthreads), nthreads, shMemSize, stream,
+            local, cl->cellInfo(), local, rmax*rmax, binner, 2, counts.devPtr() );
+
+    SAFE_KERNEL_LAUNCH(
+            DistributionsKernels::binPairs<InteractionWith::Other>,
+            getNblocks(halo.size, nthreads), nthreads, shMemSize, stream,
+            halo, cl->cellInfo(), local, rmax*rmax, binner, 1, counts.devPtr() );
+
+    nLocalParticles.push_back(local.size);
+
+    if (state->currentStep % dumpEvery == 0 && state->currentStep != 0)
+    {
+        counts.downloadFromDevice(stream, ContainersSynch::Synch);
+        counts.clearDevice(stream);
+
+        savedTime = state->currentTime;
+        needToSend = true;
+    }
+}
+
+void RadialDistributionPlugin::serializeAndSend(cudaStream_t stream)
+{
+    if (!needToSend) return;
+
+    debug2("Plugin %s is sending now data", name.c_str());
+
+    std::vector<unsigned long long> window(counts.begin(), counts.end());
+
+    waitPrevSend();
+    SimpleSerializer::serialize(sendBuffer, savedTime, nLocalParticles, window);
+    send(sendBuffer);
+
+    nLocalParticles.clear();
+    needToSend = false;
+}
+
+SimulationPlugin::HookPeriod RadialDistributionPlugin::getHookPeriod(Hook hook) const
+{
+    switch (hook)
+    {
+        case Hook::BeforeIntegration:  return {sampleEvery, 0};
+        case Hook::SerializeSend:      return {dumpEvery, 0};
+        default:                       return {0, 0};
+    }
+}
+
+//=================================================================================
+
+RadialDistributionDumper::RadialDistributionDumper(std::string name, std::string path) :
+    PostprocessPlugin(name),
+    path(path)
+{}
+
+void RadialDistributionDumper::setup(const MPI_Comm& comm, const MPI_Comm& interComm)
+{
+    PostprocessPlugin::setup(comm, interComm);
+    activated = createFoldersCollective(comm, path);
+}
+
+void RadialDistributionDumper::handshake()
+{
+    auto req = waitData();
+    MPI_Check( MPI_Wait(&req, MPI_STATUS_IGNORE) );
+    recv();
+
+    SimpleSerializer::deserialize(data, pvName, rmax, nbins, globalSize);
+}
+
+void RadialDistributionDumper::deserialize(MPI_Status& stat)
+{
+    TimeType time;
+    std::vector<int> localSizes;
+    std::vector<unsigned long long> localCounts;
+
+    SimpleSerializer::deserialize(data, time, localSizes, localCounts);
+
+    std::vector<int> sizes(localSizes.size());
+    std::vector<unsigned long long> counts(localCounts.size());
+
+    MPI_Check( MPI_Reduce(localSizes.data(),  sizes.data(),  sizes.size(),  MPI_INT,                MPI_SUM, 0, comm) );
+    MPI_Check( MPI_Reduce(localCounts.data(), counts.data(), counts.size(), MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, comm) );
+
+    const int dumpId = nDumps++;
+    if (!activated || rank != 0) return;
+
+    // ideal gas number of ordered pairs: sum over the samples of N * N / V
+    const double volume = (double) globalSize.x * globalSize.y * globalSize.z;
+    double idealPairs = 0;
+    for (auto n : sizes)
+        idealPairs += (double) n * n / volume;
+
+    std::string fname = path + "/" + pvName + "_rdf_" + getStrZeroPadded(dumpId) + ".txt";
+    FILE *fout = fopen(fname.c_str(), "w");
+    if (!fout) die("Could not open file '%s'", fname.c_str());
+
+    fprintf(fout, "# time %g, %d samples\n", time, (int) sizes.size());
+    fprintf(fout, "# r, g(r)\n");
+
+    const double dr = rmax / nbins;
+    for (int i = 0; i < nbins; i++)
+    {
+        const double r0 = i * dr, r1 = r0 + dr;
+        const double shell = 4.0 / 3.0 * M_PI * (r1*r1*r1 - r0*r0*r0);
+        const double g = idealPairs > 0 ? counts[i] / (idealPairs * shell) : 0.0;
+
+        fprintf(fout, "%.6e %.6e\n", r0 + 0.5 * dr, g);
+    }
+
+    fclose(fout);
+}
+
+//=================================================================================
+
+VelocityDistributionPlugin::VelocityDistributionPlugin(const YmrState *state, std::string name, std::string pvName,
+                                                       float vmax, int nbins, int sampleEvery, int dumpEvery) :
+    SimulationPlugin(state, name),
+    pvName(pvName),
+    vmax(vmax),
+    nbins(nbins),
+    sampleEvery(sampleEvery),
+    dumpEvery(dumpEvery)
+{
+    if (vmax <= 0.0f)
+        die("Plugin '%s' needs a positive maximum velocity, got %g", name.c_str(), vmax);
+
+    if (nbins < 1 || 3 * nbins > maxSharedBins)
+        die("Plugin '%s' needs between 1 and %d bins, got %d", name.c_str(), maxSharedBins / 3, nbins);
+
+    checkPeriods(name, sampleEvery, dumpEvery);
+}
+
+VelocityDistributionPlugin::~VelocityDistributionPlugin() = default;
+
+void VelocityDistributionPlugin::setup(Simulation *simulation, const MPI_Comm& comm, const MPI_Comm& interComm)
+{
+    SimulationPlugin::setup(simulation, comm, interComm);
+
+    pv = simulation->getPVbyNameOrDie(pvName);
+
+    counts.resize_anew(3 * nbins);
+    counts.clear(defaultStream);
+
+    info("Plugin '%s' bins the velocities of pv '%s' within [%g, %g] in %d bins",
+         name.c_str(), pvName.c_str(), -vmax, vmax, nbins);
+}
+
+void VelocityDistributionPlugin::handshake()
+{
+    SimpleSerializer::serialize(sendBuffer, pvName, vmax, nbins);
+    send(sendBuffer);
+}
+
+void VelocityDistributionPlugin::afterIntegration(cudaStream_t stream)
+{
+    if (state->currentStep % sampleEvery != 0) return;
+
+    debug2("Plugin %s is sampling now", name.c_str());
+
+    PVview view(pv, pv->local());
+
+    const int nthreads = 128;
+    const int nblocks = std::min(getNblocks(view.size, nthreads), 1024);
+
+    SAFE_KERNEL_LAUNCH(
+            DistributionsKernels::binVelocities,
+            nblocks, nthreads, 3 * nbins * sizeof(unsigned int), stream,
+            view, vmax, nbins, counts.devPtr() );
+
+    if (state->currentStep % dumpEvery == 0 && state->currentStep != 0)
+    {
+        counts.downloadFromDevice(stream, ContainersSynch::Synch);
+        counts.clearDevice(stream);
+
+        savedTime = state->currentTime;
+        needToSend = true;
+    }
+}
+
+void VelocityDistributionPlugin::serializeAndSend(cudaStream_t stream)
+{
+    if (!needToSend) return;
+
+    debug2("Plugin %s is sending now data", name.c_str());
+
+    std::vector<unsigned long long> window(counts.begin(), counts.end());
+
+    waitPrevSend();
+    SimpleSerializer::serialize(sendBuffer, savedTime, window);
+    send(sendBuffer);
+
+    needToSend = false;
+}
+
+SimulationPlugin::HookPeriod VelocityDistributionPlugin::getHookPeriod(Hook hook) const
+{
+    switch (hook)
+    {
+        case Hook::AfterIntegration:  return {sampleEvery, 0};
+        case Hook::SerializeSend:     return {dumpEvery, 0};
+        default:                      return {0, 0};
+    }
+}
+
+//=================================================================================
+
+VelocityDistributionDumper::VelocityDistributionDumper(std::string name, std::string path) :
+    PostprocessPlugin(name),
+    path(path)
+{}
+
+void VelocityDistributionDumper::setup(const MPI_Comm& comm, const MPI_Comm& interComm)
+{
+    PostprocessPlugin::setup(comm, interComm);
+    activated = createFoldersCollective(comm, path);
+}
+
+void VelocityDistributionDumper::handshake()
+{
+    auto req = waitData();
+    MPI_Check( MPI_Wait(&req, MPI_STATUS_IGNORE) );
+    recv();
+
+    SimpleSerializer::deserialize(data, pvName, vmax, nbins);
+}
+
+void VelocityDistributionDumper::deserialize(MPI_Status& stat)
+{
+    TimeType time;
+    std::vector<unsigned long long> localCounts;
+
+    SimpleSerializer::deserialize(data, time, localCounts);
+
+    std::vector<unsigned long long> counts(localCounts.size());
+    MPI_Check( MPI_Reduce(localCounts.data(), counts.data(), counts.size(), MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, comm) );
+
+    const int dumpId = nDumps++;
+    if (!activated || rank != 0) return;
+
+    std::string fname = path + "/" + pvName + "_velocities_" + getStrZeroPadded(dumpId) + ".txt";
+    FILE *fout = fopen(fname.c_str(), "w");
+    if (!fout) die("Could not open file '%s'", fname.c_str());
+
+    // every component counts every particle of every sample once
+    double total = 0;
+    for (int i = 0; i < nbins; i++)
+        total += counts[i];
+
+    const double dv = 2.0 * vmax / nbins;
+    const double normalization = total > 0 ? 1.0 / (total * dv) : 0.0;
+
+    fprintf(fout, "# time %g, %.0f samples of particles\n", time, total);
+    fprintf(fout, "# v, pdf of vx, vy, vz\n");
+
+    for (int i = 0; i < nbins; i++)
+        fprintf(fout, "%.6e %.6e %.6e %.6e\n", -vmax + (i + 0.5) * dv,
+                counts[i] * normalization, counts[nbins + i] * normalization, counts[2*nbins + i] * normalization);
+
+    fclose(fout);
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "interface.h"
+
+#include <core/containers.h>
+
+#include <string>
+#include <vector>
+
+class ParticleVector;
+class CellList;
+
+/**
+ * Radial distribution function g(r) of the particles of a particle vector, up to \c rmax,
+ * which cannot exceed the cell size of its primary cell list.
+ *
+ * Every sampleEvery steps the pairs within rmax are binned on the GPU by a neighbor traversal
+ * of the cell list, see computeCell(): the local pairs and the pairs of the local and the halo particles,
+ * the latter being counted once on each of the two ranks. The blocks accumulate their pairs in shared memory.
+ * The counts stay on the device until the dump, every dumpEvery steps, only then they are sent
+ * and reduced over the ranks by the postprocess, together with the number of particles at every sample
+ */
+class RadialDistributionPlugin : public SimulationPlugin
+{
+public:
+    RadialDistributionPlugin(const YmrState *state, std::string name, std::string pvName,
+                             float rmax, int nbins, int sampleEvery, int dumpEvery);
+
+    ~RadialDistributionPlugin();
+
+    void setup(Simulation *simulation, const MPI_Comm& comm, const MPI_Comm& interComm) override;
+    void handshake() override;
+
+    void beforeIntegration(cudaStream_t stream) override;
+    void serializeAndSend(cudaStream_t stream) override;
+
+    HookPeriod getHookPeriod(Hook hook) const override;
+
+    bool needPostproc() override { return true; }
+
+private:
+    std::string pvName;
+    ParticleVector *pv;
+    CellList *cl;
+
+    float rmax;
+    int nbins;
+    int sampleEvery, dumpEvery;
+
+    PinnedBuffer<unsigned long long> counts;
+    std::vector<int> nLocalParticles;   ///< at every sample since the previous dump
+
+    TimeType savedTime {0};
+    bool needToSend {false};
+    std::vector<char> sendBuffer;
+};
+
+
+class RadialDistributionDumper : public PostprocessPlugin
+{
+public:
+    RadialDistributionDumper(std::string name, std::string path);
+
+    void setup(const MPI_Comm& comm, const MPI_Comm& interComm) override;
+    void handshake() override;
+    void deserialize(MPI_Status& stat) override;
+
+private:
+    std::string path;
+    bool activated {true};
+
+    std::string pvName;
+    float rmax;
+    int nbins;
+    float3 globalSize;
+    int nDumps {0};
+};
+
+
+/**
+ * Probability densities of the three components of the velocity of the particles of a particle vector,
+ * in \c nbins bins over [-vmax, vmax]; the particles faster than that fall in the first or the last bin.
+ *
+ * Every sampleEvery steps the blocks bin their particles in shared memory, then add their bins to the ones
+ * on the device. They are sent every dumpEvery steps and reduced over the ranks by the postprocess
+ */
+class VelocityDistributionPlugin : public SimulationPlugin
+{
+public:
+    VelocityDistributionPlugin(const YmrState *state, std::string name, std::string pvName,
+                               float vmax, int nbins, int sampleEvery, int dumpEvery);
+
+    ~VelocityDistributionPlugin();
+
+    void setup(Simulation *simulation, const MPI_Comm& comm, const MPI_Comm& interComm) override;
+    void handshake() override;
+
+    void afterIntegration(cudaStream_t stream) override;
+    void serializeAndSend(cudaStream_t stream) override;
+
+    HookPeriod getHookPeriod(Hook hook) const override;
+
+    bool needPostproc() override { return true; }
+
+private:
+    std::string pvName;
+    ParticleVector *pv;
+
+    float vmax;
+    int nbins;
+    int sampleEvery, dumpEvery;
+
+    PinnedBuffer<unsigned long long> counts;   ///< nbins for x, then for y, then for z
+
+    TimeType savedTime {0};
+    bool needToSend {false};
+    std::vector<char> sendBuffer;
+};
+
+
+class VelocityDistributionDumper : public PostprocessPlugin
+{
+public:
+    VelocityDistributionDumper(std::string name, std::string path);
+
+    void setup(const MPI_Comm& comm, const MPI_Comm& interComm) override;
+    void handshake() override;
+    void deserialize(MPI_Status& stat) override;
+
+private:
+    std::string path;
+    bool activated {true};
+
+    std::string pvName;
+    float vmax;
+    int nbins;
+    int nDumps {0};
+};
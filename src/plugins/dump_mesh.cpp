@@ -8,11 +8,29 @@
 #include <core/utils/cuda_common.h>
 #include <core/utils/folders.h>
 
+#include <cuda_fp16.h>
+
+#include <cstring>
 #include <regex>
 
-MeshPlugin::MeshPlugin(const YmrState *state, std::string name, std::string ovName, int dumpEvery) :
+// host conversions, FP16 values are stored as their bits
+static uint16_t floatToHalf(float x)
+{
+    const __half_raw h = __float2half_rn(x);
+    return h.x;
+}
+
+static float halfToFloat(uint16_t bits)
+{
+    __half_raw h;
+    h.x = bits;
+    return __half2float(__half(h));
+}
+
+MeshPlugin::MeshPlugin(const YmrState *state, std::string name, std::string ovName, int dumpEvery, bool halfPrecision) :
     SimulationPlugin(state, name), ovName(ovName),
-    dumpEvery(dumpEvery)
+    dumpEvery(dumpEvery),
+    halfPrecision(halfPrecision)
 {}
 
 void MeshPlugin::setup(Simulation* simulation, const MPI_Comm& comm, const MPI_Comm& interComm)
@@ -38,20 +56,71 @@ void MeshPlugin::serializeAndSend(cudaStream_t stream)
 
     debug2("Plugin %s is sending now data", name.c_str());
 
+    auto& mesh = ov->mesh;
+    const int nvertices = mesh->getNvertices();
+
+    // the previous message is sent straight from these vectors
+    waitPrevSend();
+
     vertices.clear();
-    vertices.reserve(srcVerts->size());
+    centers.clear();
+    halfVertices.clear();
 
-    for (auto& p : *srcVerts)
-        vertices.push_back(state->domain.local2global(p.r));
+    if (halfPrecision)
+    {
+        // FP16 is only precise enough for the vertices relative to their object
+        const int nObjects = srcVerts->size() / nvertices;
+        halfVertices.reserve(3 * srcVerts->size());
 
-    auto& mesh = ov->mesh;
+        for (int objId = 0; objId < nObjects; objId++)
+        {
+            const Particle *objVerts = srcVerts->hostPtr() + objId * nvertices;
+
+            float3 center {0.0f, 0.0f, 0.0f};
+            for (int i = 0; i < nvertices; i++)
+                center += objVerts[i].r;
+            center *= 1.0f / nvertices;
+
+            centers.push_back(state->domain.local2global(center));
+
+            for (int i = 0; i < nvertices; i++)
+            {
+                const float3 dr = objVerts[i].r - center;
+                halfVertices.push_back( floatToHalf(dr.x) );
+                halfVertices.push_back( floatToHalf(dr.y) );
+                halfVertices.push_back( floatToHalf(dr.z) );
+            }
+        }
+    }
+    else
+    {
+        vertices.reserve(srcVerts->size());
 
-    waitPrevSend();
-    SimpleSerializer::serialize(sendBuffer, ov->name,
-                                mesh->getNvertices(), mesh->getNtriangles(), mesh->triangles,
-                                vertices);
+        for (auto& p : *srcVerts)
+            vertices.push_back(state->domain.local2global(p.r));
+    }
+
+    // the dumper keeps the connectivity of the first dump
+    connectivity.clear();
+    if (!topologySent)
+        connectivity.assign(mesh->triangles.hostPtr(), mesh->triangles.hostPtr() + mesh->getNtriangles());
+    topologySent = true;
+
+    SimpleSerializer::serializeChunks(sendBuffer, sendChunks, ov->name, state->currentTime,
+                                      nvertices, mesh->getNtriangles(), connectivity,
+                                      vertices, centers, halfVertices);
+
+    send(sendChunks);
+}
 
-    send(sendBuffer);
+SimulationPlugin::HookPeriod MeshPlugin::getHookPeriod(Hook hook) const
+{
+    switch (hook)
+    {
+        case Hook::BeforeForces:
+        case Hook::SerializeSend:     return {dumpEvery, 0};
+        default:                      return {0, 0};
+    }
 }
 
 //=================================================================================
@@ -136,36 +205,122 @@ static void writePLY(
 }
 
 
-MeshDumper::MeshDumper(std::string name, std::string path) :
+MeshDumper::MeshDumper(std::string name, std::string path, std::string backend) :
                 PostprocessPlugin(name), path(path)
-{    }
+{
+    if (backend == "xdmf")
+        xdmf = true;
+    else if (backend != "file")
+        this->backend = createOutputBackend(backend);
+}
 
 void MeshDumper::setup(const MPI_Comm& comm, const MPI_Comm& interComm)
 {
     PostprocessPlugin::setup(comm, interComm);
-    activated = createFoldersCollective(comm, path);
+    if (!backend || backend->writesFiles())
+        activated = createFoldersCollective(comm, path);
+}
+
+void MeshDumper::_writeToBackend(std::string fname, int nvertices, int ntriangles, TimeType time)
+{
+    const long nObjects = vertices.size() / nvertices;
+    long objOffset = 0;
+    MPI_Check( MPI_Exscan(&nObjects, &objOffset, 1, MPI_LONG, MPI_SUM, comm) );
+
+    auto positions = std::make_shared<std::vector<float>>(3 * vertices.size());
+    memcpy(positions->data(), vertices.data(), vertices.size() * sizeof(float3));
+
+    // the triangles of the grid refer to the global vertex ids
+    auto triangles = std::make_shared<std::vector<int>>(3 * connectivity.size());
+    for (long i = 0; i < connectivity.size(); i++)
+    {
+        const int start = nvertices * (objOffset + i / ntriangles);
+        (*triangles)[3*i + 0] = start + connectivity[i].x;
+        (*triangles)[3*i + 1] = start + connectivity[i].y;
+        (*triangles)[3*i + 2] = start + connectivity[i].z;
+    }
+
+    XDMF::TriangleMeshGrid grid(positions, triangles, comm);
+    backend->write(fname, &grid, {}, time, comm);
+}
+
+void MeshDumper::_writeXDMF(std::string fname, std::string ovName, int nvertices, int ntriangles, TimeType time)
+{
+    const long nObjects = vertices.size() / nvertices;
+    long totObjects = 0;
+    MPI_Check( MPI_Allreduce(&nObjects, &totObjects, 1, MPI_LONG, MPI_SUM, comm) );
+
+    auto positions = std::make_shared<std::vector<float>>(3 * vertices.size());
+    memcpy(positions->data(), vertices.data(), vertices.size() * sizeof(float3));
+
+    // the triangles only depend on the number of objects, dumps of as many objects share them
+    if (totObjects != topologyObjects)
+    {
+        long objOffset = 0;
+        MPI_Check( MPI_Exscan(&nObjects, &objOffset, 1, MPI_LONG, MPI_SUM, comm) );
+
+        auto triangles = std::make_shared<std::vector<int>>(3 * nObjects * ntriangles);
+        for (long i = 0; i < nObjects * ntriangles; i++)
+        {
+            const int start = nvertices * (objOffset + i / ntriangles);
+            (*triangles)[3*i + 0] = start + connectivity[i % ntriangles].x;
+            (*triangles)[3*i + 1] = start + connectivity[i % ntriangles].y;
+            (*triangles)[3*i + 2] = start + connectivity[i % ntriangles].z;
+        }
+
+        topologyFile = ovName + "_topology_" + getStrZeroPadded(timeStamp - 1);
+        topologyObjects = totObjects;
+
+        debug2("Plugin %s writes the topology of %ld objects to %s",
+               name.c_str(), totObjects, topologyFile.c_str());
+
+        XDMF::TriangleMeshGrid topology(positions, triangles, comm);
+        XDMF::write(path + "/" + topologyFile, &topology, {}, time, comm);
+    }
+
+    XDMF::TriangleMeshGrid grid(positions, nObjects * ntriangles, topologyFile + ".h5", comm);
+    XDMF::write(fname, &grid, {}, time, comm);
 }
 
 void MeshDumper::deserialize(MPI_Status& stat)
 {
     std::string ovName;
+    TimeType time;
     int nvertices, ntriangles;
+    std::vector<int3> newConnectivity;
 
-    SimpleSerializer::deserialize(data, ovName, nvertices, ntriangles, connectivity, vertices);
+    SimpleSerializer::deserialize(data, ovName, time, nvertices, ntriangles, newConnectivity,
+                                  vertices, centers, halfVertices);
 
-    std::string tstr = std::to_string(timeStamp++);
-    std::string currentFname = path + "/" + ovName + "_" + std::string(5 - tstr.length(), '0') + tstr + ".ply";
+    if (!newConnectivity.empty())
+        connectivity.swap(newConnectivity);
 
-    if (activated)
+    if (!halfVertices.empty())
+    {
+        vertices.resize(halfVertices.size() / 3);
+        for (int i = 0; i < vertices.size(); i++)
+            vertices[i] = centers[i / nvertices] +
+                make_float3( halfToFloat(halfVertices[3*i + 0]),
+                             halfToFloat(halfVertices[3*i + 1]),
+                             halfToFloat(halfVertices[3*i + 2]) );
+    }
+
+    std::string tstr = std::to_string(timeStamp++);
+    std::string currentFname = path + "/" + ovName + "_" + std::string(5 - tstr.length(), '0') + tstr;
+
+    if (backend)
+        _writeToBackend(currentFname, nvertices, ntriangles, time);
+    else if (!activated)
+        return;
+    else if (xdmf)
+        _writeXDMF(currentFname, ovName, nvertices, ntriangles, time);
+    else
     {
         int nObjects = vertices.size() / nvertices;
-        writePLY(comm, currentFname,
+        writePLY(comm, currentFname + ".ply",
                 nvertices*nObjects, nvertices,
                 ntriangles*nObjects, ntriangles,
                 nObjects,
                 connectivity, vertices);
     }
 }
-
-
-
@@ -3,7 +3,9 @@
 #include <plugins/interface.h>
 #include <core/containers.h>
 #include <core/datatypes.h>
+#include <plugins/utils/output_backend.h>
 
+#include <cstdint>
 #include <vector>
 
 class ParticleVector;
@@ -15,20 +17,31 @@ class MeshPlugin : public SimulationPlugin
 private:
     std::string ovName;
     int dumpEvery;
+    bool halfPrecision;
 
+    /// the topology is the same for all the dumps, it is only sent with the first one
+    bool topologySent = false;
+
+    /// the vertices are sent in place, sendBuffer only holds the small parts of the message
     std::vector<char> sendBuffer;
+    std::vector<std::pair<const void*, int>> sendChunks;
+    std::vector<int3> connectivity;
     std::vector<float3> vertices;
+    std::vector<float3> centers;
+    std::vector<uint16_t> halfVertices;
     PinnedBuffer<Particle>* srcVerts;
 
     ObjectVector* ov;
 
 public:
-    MeshPlugin(const YmrState *state, std::string name, std::string ovName, int dumpEvery);
+    /// with \p halfPrecision the vertices are sent relative to the centers of their objects in FP16
+    MeshPlugin(const YmrState *state, std::string name, std::string ovName, int dumpEvery, bool halfPrecision = false);
 
     void setup(Simulation* simulation, const MPI_Comm& comm, const MPI_Comm& interComm) override;
 
     void beforeForces(cudaStream_t stream) override;
     void serializeAndSend(cudaStream_t stream) override;
+    HookPeriod getHookPeriod(Hook hook) const override;
 
     bool needPostproc() override { return true; }
 };
@@ -42,11 +55,30 @@ private:
     bool activated = true;
     int timeStamp = 0;
 
+    /// triangles of one object, received with the first dump
     std::vector<int3> connectivity;
     std::vector<float3> vertices;
+    std::vector<float3> centers;
+    std::vector<uint16_t> halfVertices;
+
+    /// ply files are written without a backend
+    std::unique_ptr<OutputBackend> backend;
+
+    /// XDMF files sharing the triangles of the topology file
+    bool xdmf = false;
+    std::string topologyFile;
+    long topologyObjects = -1;
+
+    void _writeToBackend(std::string fname, int nvertices, int ntriangles, TimeType time);
+    void _writeXDMF(std::string fname, std::string ovName, int nvertices, int ntriangles, TimeType time);
 
 public:
-    MeshDumper(std::string name, std::string path);
+    /**
+     * \p backend: "file" for ply files, "xdmf" for XDMF files where the triangles are written
+     * once per object vector and shared by all the dumps, or another destination
+     * of the meshes, see createOutputBackend()
+     */
+    MeshDumper(std::string name, std::string path, std::string backend = "file");
 
     void deserialize(MPI_Status& stat) override;
     void setup(const MPI_Comm& comm, const MPI_Comm& interComm) override;
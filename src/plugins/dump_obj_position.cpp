@@ -32,11 +32,19 @@ void ObjPositionsPlugin::afterIntegration(cudaStream_t stream)
 {
     if (state->currentStep % dumpEvery != 0 || state->currentStep == 0) return;
 
-    ids.copy(  *ov->local()->extraPerObject.getData<int>(ChannelNames::globalIds), stream);
-    coms.copy( *ov->local()->extraPerObject.getData<LocalObjectVector::COMandExtent>(ChannelNames::comExtents), stream);
+    auto& extraData = ov->local()->extraPerObject;
 
-    if (ov->local()->extraPerObject.checkChannelExists(ChannelNames::oldMotions))
-        motions.copy( *ov->local()->extraPerObject.getData<RigidMotion> (ChannelNames::oldMotions), stream);
+    std::vector<DumpPacker::Field> fields;
+    fields.push_back({extraData.getData<int>(ChannelNames::globalIds), 0});
+    fields.push_back({extraData.getData<LocalObjectVector::COMandExtent>(ChannelNames::comExtents), DumpPacker::comExtentShift});
+
+    hasMotions = extraData.checkChannelExists(ChannelNames::oldMotions);
+    if (hasMotions)
+        fields.push_back({extraData.getData<RigidMotion>(ChannelNames::oldMotions), 0});
+
+    // the previous dump is sent straight from the packed buffer
+    waitPrevSend();
+    packer.pack(state->domain, fields, 1, stream);
     
     savedTime = state->currentTime;
     needToSend = true;
@@ -48,16 +56,41 @@ void ObjPositionsPlugin::serializeAndSend(cudaStream_t stream)
 
     debug2("Plugin %s is sending now data", name.c_str());
 
+    // same layout as serializing the time and the vectors of ids, coms and motions
     waitPrevSend();
-    SimpleSerializer::serialize(sendBuffer, savedTime, state->domain, ids, coms, motions);
-    send(sendBuffer);
+    SimpleSerializer::serialize(sendBuffer, savedTime);
+
+    nObjects = packer.size();
+    nMotions = hasMotions ? nObjects : 0;
+
+    auto packed = packer.chunks();
+    std::vector<std::pair<const void*, int>> chunks = {
+        {sendBuffer.data(), (int) sendBuffer.size()},
+        {&nObjects, sizeof(int)}, packed[0],
+        {&nObjects, sizeof(int)}, packed[1],
+        {&nMotions, sizeof(int)} };
+
+    if (hasMotions)
+        chunks.push_back(packed[2]);
+
+    send(chunks);
     
     needToSend=false;
 }
 
+SimulationPlugin::HookPeriod ObjPositionsPlugin::getHookPeriod(Hook hook) const
+{
+    switch (hook)
+    {
+        case Hook::AfterIntegration:  return {dumpEvery, 0};
+        case Hook::SerializeSend:     return {1, 0};
+        default:                      return {0, 0};
+    }
+}
+
 //=================================================================================
 
-void writePositions(MPI_Comm comm, DomainInfo domain, MPI_File& fout, float curTime, std::vector<int>& ids,
+void writePositions(MPI_Comm comm, MPI_File& fout, float curTime, std::vector<int>& ids,
         std::vector<LocalObjectVector::COMandExtent> coms, std::vector<RigidMotion> motions)
 {
     int rank;
@@ -74,7 +107,6 @@ void writePositions(MPI_Comm comm, DomainInfo domain, MPI_File& fout, float curT
     for(int i = 0; i < np; ++i)
     {
         auto com = coms[i];
-        com.com = domain.local2global(com.com);
 
         ss << ids[i] << " " << curTime << "   "
                 << std::setw(10) << com.com.x << " "
@@ -161,15 +193,14 @@ void ObjPositionsDumper::handshake()
 void ObjPositionsDumper::deserialize(MPI_Status& stat)
 {
     TimeType curTime;
-    DomainInfo domain;
     std::vector<int> ids;
     std::vector<LocalObjectVector::COMandExtent> coms;
     std::vector<RigidMotion> motions;
 
-    SimpleSerializer::deserialize(data, curTime, domain, ids, coms, motions);
+    SimpleSerializer::deserialize(data, curTime, ids, coms, motions);
 
     if (activated)
-        writePositions(comm, domain, fout, curTime, ids, coms, motions);
+        writePositions(comm, fout, curTime, ids, coms, motions);
 }
 
 
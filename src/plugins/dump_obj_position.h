@@ -3,6 +3,7 @@
 #include <plugins/interface.h>
 #include <core/containers.h>
 #include <core/datatypes.h>
+#include <plugins/utils/dump_packing.h>
 
 #include <vector>
 
@@ -19,6 +20,7 @@ public:
 
     void afterIntegration(cudaStream_t stream) override;
     void serializeAndSend(cudaStream_t stream) override;
+    HookPeriod getHookPeriod(Hook hook) const override;
     void handshake() override;
 
     bool needPostproc() override { return true; }
@@ -28,9 +30,10 @@ private:
     int dumpEvery;
     bool needToSend = false;
     
-    HostBuffer<int> ids;
-    HostBuffer<LocalObjectVector::COMandExtent> coms;
-    HostBuffer<RigidMotion> motions;
+    /// ids, coms and optionally motions
+    DumpPacker packer;
+    bool hasMotions = false;
+    int nObjects = 0, nMotions = 0;
     TimeType savedTime = 0;
 
     std::vector<char> sendBuffer;
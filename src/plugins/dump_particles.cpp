@@ -1,18 +1,20 @@
 #include "dump_particles.h"
 #include "utils/simple_serializer.h"
 
-#include <core/pvs/particle_vector.h>
+#include <core/pvs/object_vector.h>
 #include <core/simulation.h>
 #include <core/utils/folders.h>
 
+#include <cstring>
+
 ParticleSenderPlugin::ParticleSenderPlugin(const YmrState *state, std::string name, std::string pvName, int dumpEvery,
                                            std::vector<std::string> channelNames,
-                                           std::vector<ChannelType> channelTypes) :
+                                           std::vector<ChannelType> channelTypes, int decimation,
+                                           DumpFilter filter) :
     SimulationPlugin(state, name), pvName(pvName),
-    dumpEvery(dumpEvery), channelNames(channelNames), channelTypes(channelTypes)
-{
-    channelData.resize(channelNames.size());
-}
+    dumpEvery(dumpEvery), decimation(decimation), filter(filter),
+    channelNames(channelNames), channelTypes(channelTypes)
+{}
 
 void ParticleSenderPlugin::setup(Simulation* simulation, const MPI_Comm& comm, const MPI_Comm& interComm)
 {
@@ -20,6 +22,9 @@ void ParticleSenderPlugin::setup(Simulation* simulation, const MPI_Comm& comm, c
 
     pv = simulation->getPVbyNameOrDie(pvName);
 
+    if (filter.type == DumpFilter::Type::Objects && dynamic_cast<ObjectVector*>(pv) == nullptr)
+        die("Plugin '%s': filter 'objects' needs an object vector, '%s' is not one", name.c_str(), pvName.c_str());
+
     info("Plugin %s initialized for the following particle vector: %s", name.c_str(), pvName.c_str());
 }
 
@@ -49,35 +54,71 @@ void ParticleSenderPlugin::beforeForces(cudaStream_t stream)
 {
     if (state->currentStep % dumpEvery != 0 || state->currentStep == 0) return;
 
-    particles.genericCopy(&pv->local()->coosvels, stream);
+    // the previous dump is sent straight from these buffers
+    waitPrevSend();
+
+    std::vector<DumpPacker::Field> fields;
+    fields.push_back({&pv->local()->coosvels, DumpPacker::particleShift});
 
-    for (int i = 0; i < channelNames.size(); ++i) {
-        auto name = channelNames[i];
-        auto srcContainer = pv->local()->extraPerParticle.getGenericData(name);
-        channelData[i].genericCopy(srcContainer, stream); 
+    for (auto& name : channelNames)
+        fields.push_back({pv->local()->extraPerParticle.getGenericData(name), 0});
+
+    int objSize = 0;
+    const int *objIds = nullptr;
+    if (filter.type == DumpFilter::Type::Objects)
+    {
+        auto ov = static_cast<ObjectVector*>(pv);
+        objSize = ov->objSize;
+        objIds  = ov->local()->extraPerObject.getData<int>(ChannelNames::globalIds)->devPtr();
     }
+
+    packer.pack(state->domain, fields, filter, decimation, stream, objSize, objIds);
 }
 
 void ParticleSenderPlugin::serializeAndSend(cudaStream_t stream)
 {
     if (state->currentStep % dumpEvery != 0 || state->currentStep == 0) return;
 
-    debug2("Plugin %s is sending now data", name.c_str());
-    
-    for (auto& p : particles)
-        p.r = state->domain.local2global(p.r);
+    debug2("Plugin %s is sending %d particles", name.c_str(), packer.size());
 
-    debug2("Plugin %s is packing now data consisting of %d particles", name.c_str(), particles.size());
-    waitPrevSend();
-    SimpleSerializer::serialize(sendBuffer, state->currentTime, particles, channelData);
-    send(sendBuffer);
+    header.time = state->currentTime;
+    header.n = packer.size();
+    header.padding = 0;
+
+    auto chunks = packer.chunks();
+    chunks.insert(chunks.begin(), std::make_pair((const void*) &header, (int) sizeof(header)));
+
+    send(chunks);
+}
+
+SimulationPlugin::HookPeriod ParticleSenderPlugin::getHookPeriod(Hook hook) const
+{
+    switch (hook)
+    {
+        case Hook::BeforeForces:
+        case Hook::SerializeSend:     return {dumpEvery, 0};
+        default:                      return {0, 0};
+    }
 }
 
+SimulationPlugin::ChannelAccess ParticleSenderPlugin::getChannelAccess(Hook hook) const
+{
+    if (hook != Hook::BeforeForces) return SimulationPlugin::getChannelAccess(hook);
 
+    // dumping e.g. the forces or the stresses keeps the hook before the forces
+    std::vector<std::string> reads {ChannelNames::positions, ChannelNames::velocities};
+    reads.insert(reads.end(), channelNames.begin(), channelNames.end());
+
+    return {true, reads, {}};
+}
 
 
-ParticleDumperPlugin::ParticleDumperPlugin(std::string name, std::string path) :
-    PostprocessPlugin(name), path(path), positions(new std::vector<float>())
+
+
+ParticleDumperPlugin::ParticleDumperPlugin(std::string name, std::string path, XDMF::Compression compression,
+                                           int nSubfiles, std::string backend) :
+    PostprocessPlugin(name), path(path), compression(compression),
+    backend(createOutputBackend(backend, nSubfiles)), positions(new std::vector<float>())
 {}
 
 void ParticleDumperPlugin::handshake()
@@ -89,10 +130,11 @@ void ParticleDumperPlugin::handshake()
     std::vector<int> sizes;
     std::vector<std::string> names;
     SimpleSerializer::deserialize(data, sizes, names);
+    channelSizes = sizes;
     
-    auto init_channel = [] (XDMF::Channel::DataForm dataForm, int sz, const std::string& str,
-                            XDMF::Channel::NumberType numberType = XDMF::Channel::NumberType::Float, DataType datatype = typeTokenize<float>()) {
-        return XDMF::Channel(str, nullptr, dataForm, numberType, datatype);
+    auto init_channel = [this] (XDMF::Channel::DataForm dataForm, int sz, const std::string& str,
+                                XDMF::Channel::NumberType numberType = XDMF::Channel::NumberType::Float, DataType datatype = typeTokenize<float>()) {
+        return XDMF::Channel(str, nullptr, dataForm, numberType, datatype, compression);
     };
 
     // Velocity and id are special channels which are always present
@@ -115,15 +157,15 @@ void ParticleDumperPlugin::handshake()
     }
     
     // Create the required folder
-    createFoldersCollective(comm, parentPath(path));
+    if (backend->writesFiles())
+        createFoldersCollective(comm, parentPath(path));
 
     debug2("Plugin '%s' was set up to dump channels %s. Path is %s", name.c_str(), allNames.c_str(), path.c_str());
 }
 
-static void unpack_particles(const std::vector<Particle> &particles, std::vector<float> &pos,
+static void unpack_particles(int n, const Particle *particles, std::vector<float> &pos,
                              std::vector<float> &vel, std::vector<int> &ids)
 {
-    int n = particles.size();
     pos.resize(3 * n);
     vel.resize(3 * n);
     ids.resize(n);
@@ -142,31 +184,49 @@ static void unpack_particles(const std::vector<Particle> &particles, std::vector
     }
 }
 
-float ParticleDumperPlugin::_recvAndUnpack()
+TimeType ParticleDumperPlugin::_recvAndUnpack()
 {
-    TimeType t;
-    int c = 0;
-    SimpleSerializer::deserialize(data, t, particles, channelData);
-        
-    unpack_particles(particles, *positions, velocities, ids);
+    using Header = ParticleSenderPlugin::Header;
+
+    Header header;
+    memcpy(&header, data.data(), sizeof(header));
+    const int n = header.n;
 
+    long expectedSize = sizeof(Header) + n * sizeof(Particle);
+    for (auto sz : channelSizes)
+        expectedSize += n * sz * sizeof(float);
+
+    if (expectedSize != data.size())
+        die("Plugin '%s' expected %ld bytes for %d particles, got %d", name.c_str(), expectedSize, n, (int) data.size());
+
+    char *ptr = data.data() + sizeof(Header);
+    unpack_particles(n, (const Particle*) ptr, *positions, velocities, ids);
+    ptr += n * sizeof(Particle);
+
+    int c = 0;
     channels[c++].data = velocities.data();
     channels[c++].data = ids.data();
-    
-    for (int i = 0; i < channelData.size(); i++)
-        channels[c++].data = channelData[i].data();    
+
+    // the other channels are written straight from the received message
+    for (auto sz : channelSizes)
+    {
+        channels[c++].data = ptr;
+        ptr += n * sz * sizeof(float);
+    }
+
+    return header.time;
 }
 
 void ParticleDumperPlugin::deserialize(MPI_Status& stat)
 {
     debug2("Plugin '%s' will dump right now", name.c_str());
 
-    float t = _recvAndUnpack();
+    TimeType t = _recvAndUnpack();
     
     std::string fname = path + getStrZeroPadded(timeStamp++, zeroPadding);
     
     XDMF::VertexGrid grid(positions, comm);
-    XDMF::write(fname, &grid, channels, t, comm);
+    backend->write(fname, &grid, channels, t, comm);
 }
 
 
@@ -8,27 +8,44 @@
 #include <core/datatypes.h>
 
 #include <core/xdmf/xdmf.h>
+#include <plugins/utils/dump_packing.h>
+#include <plugins/utils/output_backend.h>
 
 class ParticleVector;
 class CellList;
 
+/**
+ * Particles are sent without serialization, as one message with the chunks
+ * Header, n particles (global coordinates) and the n elements of each channel,
+ * packed on the device by a DumpPacker
+ */
 class ParticleSenderPlugin : public SimulationPlugin
 {
 public:
 
+    struct Header
+    {
+        TimeType time;
+        int n, padding;  ///< keep the following chunks aligned
+    };
+
     enum class ChannelType {
         Scalar, Vector, Tensor6
     };
     
+    /// only the particles selected by \p filter among every \p decimation-th are dumped
     ParticleSenderPlugin(const YmrState *state, std::string name, std::string pvName, int dumpEvery,
                          std::vector<std::string> channelNames,
-                         std::vector<ChannelType> channelTypes);
+                         std::vector<ChannelType> channelTypes, int decimation = 1,
+                         DumpFilter filter = DumpFilter());
 
     void setup(Simulation *simulation, const MPI_Comm& comm, const MPI_Comm& interComm) override;
     void handshake() override;
 
     void beforeForces(cudaStream_t stream) override;
     void serializeAndSend(cudaStream_t stream) override;
+    HookPeriod getHookPeriod(Hook hook) const override;
+    ChannelAccess getChannelAccess(Hook hook) const override;
 
     bool needPostproc() override { return true; }
     
@@ -36,13 +53,15 @@ protected:
     std::string pvName;
     ParticleVector *pv;
     
-    int dumpEvery;
+    int dumpEvery, decimation;
+    DumpFilter filter;
 
-    HostBuffer<Particle> particles;
     std::vector<std::string> channelNames;
     std::vector<ChannelType> channelTypes;
-    std::vector<HostBuffer<float>> channelData;
 
+    DumpPacker packer;
+
+    Header header;
     std::vector<char> sendBuffer;
 };
 
@@ -50,24 +69,31 @@ protected:
 class ParticleDumperPlugin : public PostprocessPlugin
 {
 public:
-    ParticleDumperPlugin(std::string name, std::string path);
+    /**
+     * \p nSubfiles: number of HDF5 files per dump, see XDMF::write()
+     * \p backend: destination of the dumps, see createOutputBackend()
+     */
+    ParticleDumperPlugin(std::string name, std::string path, XDMF::Compression compression = XDMF::Compression(),
+                         int nSubfiles = 0, std::string backend = "file");
 
     void deserialize(MPI_Status& stat) override;
     void handshake() override;
 
 protected:
 
-    float _recvAndUnpack();
+    /// the channels point to the received data, valid until the next recv()
+    TimeType _recvAndUnpack();
     
     int timeStamp = 0;
     const int zeroPadding = 5;
     std::string path;
+    XDMF::Compression compression;
+    std::unique_ptr<OutputBackend> backend;
 
-    std::vector<Particle> particles;
     std::vector<float> velocities;
     std::vector<int> ids;
     std::shared_ptr<std::vector<float>> positions;
 
     std::vector<XDMF::Channel> channels;
-    std::vector<std::vector<float>> channelData;
+    std::vector<int> channelSizes;
 };
@@ -34,8 +34,9 @@ void ParticleWithMeshSenderPlugin::handshake()
 
 
 
-ParticleWithMeshDumperPlugin::ParticleWithMeshDumperPlugin(std::string name, std::string path) :
-    ParticleDumperPlugin(name, path), allTriangles(new std::vector<int>())
+ParticleWithMeshDumperPlugin::ParticleWithMeshDumperPlugin(std::string name, std::string path, XDMF::Compression compression,
+                                                           std::string backend) :
+    ParticleDumperPlugin(name, path, compression, 0, backend), allTriangles(new std::vector<int>())
 {}
 
 void ParticleWithMeshDumperPlugin::handshake()
@@ -83,7 +84,7 @@ void ParticleWithMeshDumperPlugin::deserialize(MPI_Status& stat)
 {
     debug2("Plugin '%s' will dump right now", name.c_str());
 
-    float t = _recvAndUnpack();
+    TimeType t = _recvAndUnpack();
 
     int totNVertices = positions->size() / 3;    
 
@@ -92,5 +93,5 @@ void ParticleWithMeshDumperPlugin::deserialize(MPI_Status& stat)
     std::string fname = path + getStrZeroPadded(timeStamp++, zeroPadding);
     
     XDMF::TriangleMeshGrid grid(positions, allTriangles, comm);
-    XDMF::write(fname, &grid, channels, t, comm);
+    backend->write(fname, &grid, channels, t, comm);
 }
@@ -18,7 +18,8 @@ public:
 class ParticleWithMeshDumperPlugin : public ParticleDumperPlugin
 {
 public:
-    ParticleWithMeshDumperPlugin(std::string name, std::string path);
+    ParticleWithMeshDumperPlugin(std::string name, std::string path, XDMF::Compression compression = XDMF::Compression(),
+                                 std::string backend = "file");
 
     void handshake() override;
     void deserialize(MPI_Status& stat) override;
@@ -4,11 +4,12 @@
 
 #include <core/pvs/particle_vector.h>
 #include <core/simulation.h>
+#include <core/utils/common.h>
 #include <core/utils/folders.h>
 
-XYZPlugin::XYZPlugin(const YmrState *state, std::string name, std::string pvName, int dumpEvery) :
+XYZPlugin::XYZPlugin(const YmrState *state, std::string name, std::string pvName, int dumpEvery, int decimation) :
     SimulationPlugin(state, name), pvName(pvName),
-    dumpEvery(dumpEvery)
+    dumpEvery(dumpEvery), decimation(decimation)
 {}
 
 void XYZPlugin::setup(Simulation* simulation, const MPI_Comm& comm, const MPI_Comm& interComm)
@@ -24,7 +25,9 @@ void XYZPlugin::beforeForces(cudaStream_t stream)
 {
     if (state->currentStep % dumpEvery != 0 || state->currentStep == 0) return;
 
-    downloaded.copy(pv->local()->coosvels, stream);
+    // the previous dump is sent straight from the packed buffer
+    waitPrevSend();
+    packer.pack(state->domain, {{&pv->local()->coosvels, DumpPacker::particleShift}}, decimation, stream);
 }
 
 void XYZPlugin::serializeAndSend(cudaStream_t stream)
@@ -33,12 +36,29 @@ void XYZPlugin::serializeAndSend(cudaStream_t stream)
 
     debug2("Plugin %s is sending now data", name.c_str());
 
-    for (auto& p : downloaded)
-        p.r = state->domain.local2global(p.r);
-
+    // same layout as serializing the name and a vector of the particles
     waitPrevSend();
-    SimpleSerializer::serialize(sendBuffer, pv->name, downloaded);
-    send(sendBuffer);
+    SimpleSerializer::serialize(sendBuffer, pv->name, packer.size());
+
+    auto chunks = packer.chunks();
+    chunks.insert(chunks.begin(), std::make_pair((const void*) sendBuffer.data(), (int) sendBuffer.size()));
+    send(chunks);
+}
+
+SimulationPlugin::HookPeriod XYZPlugin::getHookPeriod(Hook hook) const
+{
+    switch (hook)
+    {
+        case Hook::BeforeForces:
+        case Hook::SerializeSend:     return {dumpEvery, 0};
+        default:                      return {0, 0};
+    }
+}
+
+SimulationPlugin::ChannelAccess XYZPlugin::getChannelAccess(Hook hook) const
+{
+    if (hook != Hook::BeforeForces) return SimulationPlugin::getChannelAccess(hook);
+    return {true, {ChannelNames::positions, ChannelNames::velocities}, {}};
 }
 
 //=================================================================================
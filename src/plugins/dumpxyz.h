@@ -3,6 +3,7 @@
 #include <plugins/interface.h>
 #include <core/containers.h>
 #include <core/datatypes.h>
+#include <plugins/utils/dump_packing.h>
 
 #include <vector>
 
@@ -13,21 +14,24 @@ class XYZPlugin : public SimulationPlugin
 {
 private:
     std::string pvName;
-    int dumpEvery;
+    int dumpEvery, decimation;
 
     std::vector<char> sendBuffer;
 
     ParticleVector* pv;
     
-    HostBuffer<Particle> downloaded;
+    DumpPacker packer;
 
 public:
-    XYZPlugin(const YmrState *state, std::string name, std::string pvNames, int dumpEvery);
+    /// only every \p decimation-th particle is dumped
+    XYZPlugin(const YmrState *state, std::string name, std::string pvNames, int dumpEvery, int decimation = 1);
 
     void setup(Simulation* simulation, const MPI_Comm& comm, const MPI_Comm& interComm) override;
 
     void beforeForces(cudaStream_t stream) override;
     void serializeAndSend(cudaStream_t stream) override;
+    HookPeriod getHookPeriod(Hook hook) const override;
+    ChannelAccess getChannelAccess(Hook hook) const override;
 
     bool needPostproc() override { return true; }
 };
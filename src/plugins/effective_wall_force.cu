@@ -0,0 +1,134 @@
+#include "effective_wall_force.h"
+
+#include <core/pvs/particle_vector.h>
+#include <core/pvs/views/pv.h>
+#include <core/simulation.h>
+#include <core/utils/cuda_common.h>
+#include <core/utils/cuda_rng.h>
+#include <core/utils/kernel_launch.h>
+#include <core/walls/simple_stationary_wall.h>
+
+#include <cmath>
+
+namespace ChannelNames
+{
+static const std::string      sdf =      "sdf";
+static const std::string grad_sdf = "grad_sdf";
+} // namespace ChannelNames
+
+namespace EffectiveWallForceKernels
+{
+
+struct Profile
+{
+    const float2 *table;
+    float lo, invStep;
+    int n;
+
+    /// (F_n, gamma) linearly interpolated, nothing below the table
+    __D__ inline float2 operator()(float sdf) const
+    {
+        const float x = (sdf - lo) * invStep;
+        if (x < 0.0f) return make_float2(0.0f);
+
+        const int i = min((int) x, n - 2);
+        const float t = min(x - i, 1.0f);
+
+        const float2 a = table[i], b = table[i+1];
+        return make_float2(a.x + t * (b.x - a.x), a.y + t * (b.y - a.y));
+    }
+};
+
+__global__ void effectiveForce(PVview view, const float *sdfs, const float3 *gradients, Profile profile,
+                               float kBT, float dt, float seed1, float seed2)
+{
+    const int pid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (pid >= view.size) return;
+
+    const float sdf = sdfs[pid];
+    if (sdf < profile.lo) return;
+
+    Particle p;
+    p.readVelocity(view.particles, pid);
+
+    const float2 fg = profile(sdf);
+    const float sigma = sqrtf(2.0f * max(fg.y, 0.0f) * kBT / dt);
+
+    const float2 r1 = Saru::normal2(seed1, pid, 0);
+    const float2 r2 = Saru::normal2(seed2, pid, 0);
+    const float3 xi = make_float3(r1.x, r1.y, r2.x);
+
+    const float3 f = -fg.x * gradients[pid] - fg.y * p.u + sigma * xi;
+    atomicAdd(view.forces + pid, f);
+}
+
+} // namespace EffectiveWallForceKernels
+
+EffectiveWallForcePlugin::EffectiveWallForcePlugin(const YmrState *state, std::string name,
+                                                   std::string pvName, std::string wallName,
+                                                   const std::vector<float3>& profile, float kBT) :
+    SimulationPlugin(state, name),
+    pvName(pvName),
+    wallName(wallName),
+    kBT(kBT),
+    table(tableSize)
+{
+    if (profile.size() < 2)
+        die("Plugin '%s' needs at least 2 entries in the wall force profile", name.c_str());
+
+    for (int i = 1; i < profile.size(); i++)
+        if (profile[i].x <= profile[i-1].x)
+            die("Plugin '%s': the SDF values of the wall force profile must be increasing", name.c_str());
+
+    lo = profile.front().x;
+    hi = profile.back().x;
+
+    // uniform resampling, the entries are usually the bins of a calibration run
+    int j = 0;
+    for (int i = 0; i < tableSize; i++)
+    {
+        const float d = lo + (hi - lo) * i / (tableSize - 1);
+        while (j + 2 < profile.size() && profile[j+1].x < d) j++;
+
+        const float3 a = profile[j], b = profile[j+1];
+        const float t = std::min(1.0f, std::max(0.0f, (d - a.x) / (b.x - a.x)));
+        table[i] = make_float2(a.y + t * (b.y - a.y), a.z + t * (b.z - a.z));
+    }
+
+    table.uploadToDevice(defaultStream);
+}
+
+void EffectiveWallForcePlugin::setup(Simulation* simulation, const MPI_Comm& comm, const MPI_Comm& interComm)
+{
+    SimulationPlugin::setup(simulation, comm, interComm);
+
+    pv = simulation->getPVbyNameOrDie(pvName);
+    wall = dynamic_cast<SDF_basedWall*>(simulation->getWallByNameOrDie(wallName));
+
+    if (wall == nullptr)
+        die("Effective wall force plugin '%s' can only work with SDF-based walls, but got wall '%s'",
+            name.c_str(), wallName.c_str());
+
+    pv->requireDataPerParticle<float>(ChannelNames::sdf, ExtraDataManager::PersistenceMode::None);
+    pv->requireDataPerParticle<float3>(ChannelNames::grad_sdf, ExtraDataManager::PersistenceMode::None);
+}
+
+void EffectiveWallForcePlugin::beforeIntegration(cudaStream_t stream)
+{
+    PVview view(pv, pv->local());
+
+    auto sdfs      = pv->local()->extraPerParticle.getData<float>(ChannelNames::sdf);
+    auto gradients = pv->local()->extraPerParticle.getData<float3>(ChannelNames::grad_sdf);
+
+    // the gradients are only needed within reach of the table
+    const float gradientThreshold = -lo + 0.1f;
+    wall->sdfPerParticle(pv->local(), sdfs, gradients, gradientThreshold, stream);
+
+    EffectiveWallForceKernels::Profile profile {table.devPtr(), lo, (tableSize - 1) / (hi - lo), tableSize};
+
+    const int nthreads = 128;
+    SAFE_KERNEL_LAUNCH(
+            EffectiveWallForceKernels::effectiveForce,
+            getNblocks(view.size, nthreads), nthreads, 0, stream,
+            view, sdfs->devPtr(), gradients->devPtr(), profile, kBT, state->dt, (float) drand48(), (float) drand48() );
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <plugins/interface.h>
+#include <core/containers.h>
+
+#include <string>
+#include <vector>
+
+class ParticleVector;
+class SDF_basedWall;
+
+/**
+ * Effective force of a stationary wall on the particles near it, replacing the frozen wall particles.
+ *
+ * The force is tabulated as a function of the SDF d of the particle, e.g. from a calibration run with frozen
+ * particles: a normal conservative part F_n(d) along the SDF gradient and a friction coefficient gamma(d),
+ * with the matching random force of the fluctuation-dissipation theorem at temperature kBT:
+ * F = -F_n(d) n - gamma(d) u + sqrt(2 gamma(d) kBT / dt) xi.
+ * The table is resampled uniformly, it vanishes below its smallest SDF and is clamped above its largest.
+ * The SDF and its gradient are sampled once per step for the particles within reach of the table
+ */
+class EffectiveWallForcePlugin : public SimulationPlugin
+{
+public:
+    /// \p profile holds (d, F_n, gamma) entries, by increasing d
+    EffectiveWallForcePlugin(const YmrState *state, std::string name,
+                             std::string pvName, std::string wallName,
+                             const std::vector<float3>& profile, float kBT);
+
+    void setup(Simulation* simulation, const MPI_Comm& comm, const MPI_Comm& interComm) override;
+    void beforeIntegration(cudaStream_t stream) override;
+
+    bool needPostproc() override { return false; }
+
+    static const int tableSize = 256;
+
+private:
+    std::string pvName, wallName;
+    ParticleVector* pv;
+    SDF_basedWall *wall;
+
+    float lo, hi, kBT;
+    PinnedBuffer<float2> table;   ///< (F_n, gamma) at lo + i * (hi - lo) / (tableSize - 1)
+};
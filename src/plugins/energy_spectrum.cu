@@ -0,0 +1,378 @@
+#include "energy_spectrum.h"
+#include "utils/simple_serializer.h"
+
+#include <core/simulation.h>
+#include <core/utils/cuda_common.h>
+#include <core/utils/folders.h>
+#include <core/utils/kernel_launch.h>
+
+#include <algorithm>
+#include <cmath>
+
+#define CUFFT_Check(command)                                            \
+    do {                                                                \
+        const cufftResult code = (command);                             \
+        if (code != CUFFT_SUCCESS) die("cuFFT error %d", (int) code);   \
+    } while (0)
+
+namespace EnergySpectrumKernels
+{
+
+/// mean velocity of the bins from the per-sample sums of Average3D, the empty bins are at rest
+__global__ void loadVelocity(int n, const float *density, const float *velocity, cufftDoubleComplex *field)
+{
+    const int id = blockIdx.x * blockDim.x + threadIdx.x;
+    if (id >= n) return;
+
+    const float d = density[id];
+    for (int c = 0; c < 3; c++)
+        field[c*n + id] = make_cuDoubleComplex(d > 0.5f ? velocity[3*id + c] / d : 0.0, 0.0);
+}
+
+/**
+ * Element \p i of the line \p line of the block along \p axis, the lines going over the two other axes
+ * then over the 3 components of the field
+ */
+__device__ inline int lineOffset(int3 r, int axis, int line, int i)
+{
+    const int size[3]   = {r.x, r.y, r.z};
+    const int stride[3] = {1, r.x, r.x * r.y};
+
+    const int b = axis == 0 ? 1 : 0;
+    const int c = axis == 2 ? 1 : 2;
+
+    const int perComponent = size[b] * size[c];
+    const int component = line / perComponent;
+    const int rem = line % perComponent;
+
+    return component * r.x * r.y * r.z + i * stride[axis] + (rem % size[b]) * stride[b] + (rem / size[b]) * stride[c];
+}
+
+/// lines along \p axis of the block, one after the other
+__global__ void gatherLines(const cufftDoubleComplex *block, int3 r, int axis, int lineSize, int nLines, cufftDoubleComplex *lines)
+{
+    const int id = blockIdx.x * blockDim.x + threadIdx.x;
+    if (id >= nLines * lineSize) return;
+
+    lines[id] = block[lineOffset(r, axis, id / lineSize, id % lineSize)];
+}
+
+__global__ void scatterLines(const cufftDoubleComplex *lines, int3 r, int axis, int lineSize, int nLines, cufftDoubleComplex *block)
+{
+    const int id = blockIdx.x * blockDim.x + threadIdx.x;
+    if (id >= nLines * lineSize) return;
+
+    block[lineOffset(r, axis, id / lineSize, id % lineSize)] = lines[id];
+}
+
+/**
+ * The chunk received from the rank p of the row holds its parts of the pencils of this rank:
+ * element i of the line j of p goes to position p * lineSize + i of the pencil j.
+ * With \p toPencils false, the reverse
+ */
+__global__ void reorderPencils(cufftDoubleComplex *chunks, int nRanks, int linesPerRank, int lineSize,
+                               cufftDoubleComplex *pencils, bool toPencils)
+{
+    const int id = blockIdx.x * blockDim.x + threadIdx.x;
+    if (id >= nRanks * linesPerRank * lineSize) return;
+
+    const int p   = id / (linesPerRank * lineSize);
+    const int rem = id % (linesPerRank * lineSize);
+    const int j = rem / lineSize;
+    const int i = rem % lineSize;
+
+    const int pencilId = j * (nRanks * lineSize) + p * lineSize + i;
+
+    if (toPencils) pencils[pencilId] = chunks[id];
+    else           chunks[id] = pencils[pencilId];
+}
+
+/// one thread per mode of the block, the shells of the block are summed in shared memory
+__global__ void binEnergy(const cufftDoubleComplex *field, int3 r, int3 offset, int3 N, float3 length,
+                          float dk, int nShells, double normalization, double *spectrum)
+{
+    extern __shared__ double shells[];
+
+    for (int i = threadIdx.x; i < nShells; i += blockDim.x)
+        shells[i] = 0;
+    __syncthreads();
+
+    const int n = r.x * r.y * r.z;
+    const int id = blockIdx.x * blockDim.x + threadIdx.x;
+
+    if (id < n)
+    {
+        const int3 g = offset + make_int3(id % r.x, (id / r.x) % r.y, id / (r.x * r.y));
+        const int3 m = make_int3(g.x <= N.x/2 ? g.x : g.x - N.x,
+                                 g.y <= N.y/2 ? g.y : g.y - N.y,
+                                 g.z <= N.z/2 ? g.z : g.z - N.z);
+
+        const float3 k = 2.0f * (float) M_PI * make_float3(m) / length;
+        const int shell = (int) (sqrtf(dot(k, k)) / dk + 0.5f);
+
+        double energy = 0;
+        for (int c = 0; c < 3; c++)
+        {
+            const cufftDoubleComplex u = field[c*n + id];
+            energy += u.x * u.x + u.y * u.y;
+        }
+
+        if (shell < nShells)
+            atomicAdd(shells + shell, energy * normalization);
+    }
+    __syncthreads();
+
+    for (int i = threadIdx.x; i < nShells; i += blockDim.x)
+        if (shells[i] != 0) atomicAdd(spectrum + i, shells[i]);
+}
+
+} // namespace EnergySpectrumKernels
+
+EnergySpectrumPlugin::EnergySpectrumPlugin(const YmrState *state, std::string name, std::vector<std::string> pvNames,
+                                           int sampleEvery, int dumpEvery, float3 binSize) :
+    Average3D(state, name, pvNames, {"velocity"}, {Average3D::ChannelType::Vector_2xfloat4},
+              sampleEvery, dumpEvery, binSize, false)
+{}
+
+EnergySpectrumPlugin::~EnergySpectrumPlugin()
+{
+    for (auto& ax : axes)
+        if (ax.rowComm != MPI_COMM_NULL)
+        {
+            cufftDestroy(ax.plan);
+            MPI_Comm_free(&ax.rowComm);
+        }
+}
+
+void EnergySpectrumPlugin::setup(Simulation* simulation, const MPI_Comm& comm, const MPI_Comm& interComm)
+{
+    Average3D::setup(simulation, comm, interComm);
+
+    globalResolution = resolution * nranks3D;
+
+    const int r[3]       = {resolution.x, resolution.y, resolution.z};
+    const int nranks[3]  = {nranks3D.x, nranks3D.y, nranks3D.z};
+    const int N[3]       = {globalResolution.x, globalResolution.y, globalResolution.z};
+
+    size_t bufferSize = 0;
+    for (int a = 0; a < 3; a++)
+    {
+        auto& ax = axes[a];
+
+        int remain[3] = {a == 0, a == 1, a == 2};
+        MPI_Check( MPI_Cart_sub(simulation->cartComm, remain, &ax.rowComm) );
+
+        ax.nRanks = nranks[a];
+        ax.nLines = 3 * (r[0] * r[1] * r[2] / r[a]);
+        ax.linesPerRank = (ax.nLines + ax.nRanks - 1) / ax.nRanks;
+
+        int n = N[a];
+        CUFFT_Check( cufftPlanMany(&ax.plan, 1, &n, nullptr, 1, n, nullptr, 1, n, CUFFT_Z2Z, ax.linesPerRank) );
+
+        bufferSize = std::max(bufferSize, (size_t) ax.nRanks * ax.linesPerRank * r[a]);
+    }
+
+    field        .resize_anew(3 * resolution.x * resolution.y * resolution.z);
+    pencils      .resize_anew(bufferSize);
+    transposeSend.resize_anew(bufferSize);
+    transposeRecv.resize_anew(bufferSize);
+
+    // the padding lines are transformed as well
+    pencils      .clear(defaultStream);
+    transposeSend.clear(defaultStream);
+    transposeRecv.clear(defaultStream);
+
+    const float3 length = state->domain.globalSize;
+    dk = 2.0f * (float) M_PI / std::max(length.x, std::max(length.y, length.z));
+
+    const float3 kmax = (float) M_PI * make_float3(globalResolution) / length;
+    nShells = (int) (std::sqrt(dot(kmax, kmax)) / dk) + 2;
+
+    spectrum.resize_anew(nShells);
+    spectrum.clear(defaultStream);
+
+    info("Plugin '%s' computes the energy spectrum of a %dx%dx%d grid in %d shells",
+         name.c_str(), globalResolution.x, globalResolution.y, globalResolution.z, nShells);
+}
+
+void EnergySpectrumPlugin::handshake()
+{
+    SimpleSerializer::serialize(sendBuffer, dk, nShells);
+    send(sendBuffer);
+}
+
+void EnergySpectrumPlugin::afterIntegration(cudaStream_t stream)
+{
+    if (state->currentStep % sampleEvery != 0 || state->currentStep == 0) return;
+
+    debug2("Plugin %s is sampling now", name.c_str());
+
+    for (int i = 0; i < pvs.size(); i++)
+        sampleOnePv(pvs[i], binCellLists[i], stream);
+
+    // all the compute ranks sample at the same step, the transposes are collective over the rows
+    pipeline->onCompletion([this] (cudaStream_t stream) {
+        loadVelocity(stream);
+        density.clear(stream);
+        channelsInfo.average[0].clear(stream);
+
+        for (int a = 0; a < 3; a++)
+            transposeAndTransform(a, stream);
+
+        computeSpectrum(stream);
+        nSpectra++;
+    });
+}
+
+void EnergySpectrumPlugin::loadVelocity(cudaStream_t stream)
+{
+    const int n = density.size();
+    const int nthreads = 128;
+
+    SAFE_KERNEL_LAUNCH(
+            EnergySpectrumKernels::loadVelocity,
+            getNblocks(n, nthreads), nthreads, 0, stream,
+            n, density.devPtr(), channelsInfo.average[0].devPtr(), field.devPtr() );
+}
+
+void EnergySpectrumPlugin::alltoall(const Axis& ax, int lineSize, cudaStream_t stream)
+{
+    const int chunkBytes = ax.linesPerRank * lineSize * sizeof(cufftDoubleComplex);
+
+    transposeSend.downloadFromDevice(stream, ContainersSynch::Synch);
+    MPI_Check( MPI_Alltoall(transposeSend.hostPtr(), chunkBytes, MPI_BYTE,
+                            transposeRecv.hostPtr(), chunkBytes, MPI_BYTE, ax.rowComm) );
+    transposeRecv.uploadToDevice(stream);
+}
+
+void EnergySpectrumPlugin::transposeAndTransform(int axis, cudaStream_t stream)
+{
+    const auto& ax = axes[axis];
+    const int lineSize = axis == 0 ? resolution.x : axis == 1 ? resolution.y : resolution.z;
+    const int nthreads = 128;
+
+    auto lines = [&] (bool gather, cufftDoubleComplex *buffer) {
+        if (gather)
+            SAFE_KERNEL_LAUNCH(
+                    EnergySpectrumKernels::gatherLines,
+                    getNblocks(ax.nLines * lineSize, nthreads), nthreads, 0, stream,
+                    field.devPtr(), resolution, axis, lineSize, ax.nLines, buffer );
+        else
+            SAFE_KERNEL_LAUNCH(
+                    EnergySpectrumKernels::scatterLines,
+                    getNblocks(ax.nLines * lineSize, nthreads), nthreads, 0, stream,
+                    buffer, resolution, axis, lineSize, ax.nLines, field.devPtr() );
+    };
+
+    auto reorder = [&] (cufftDoubleComplex *chunks, bool toPencils) {
+        SAFE_KERNEL_LAUNCH(
+                EnergySpectrumKernels::reorderPencils,
+                getNblocks(ax.nRanks * ax.linesPerRank * lineSize, nthreads), nthreads, 0, stream,
+                chunks, ax.nRanks, ax.linesPerRank, lineSize, pencils.devPtr(), toPencils );
+    };
+
+    CUFFT_Check( cufftSetStream(ax.plan, stream) );
+
+    // a single rank along the axis already holds the whole lines
+    if (ax.nRanks == 1)
+    {
+        lines(true, pencils.devPtr());
+        CUFFT_Check( cufftExecZ2Z(ax.plan, pencils.devPtr(), pencils.devPtr(), CUFFT_FORWARD) );
+        lines(false, pencils.devPtr());
+        return;
+    }
+
+    lines(true, transposeSend.devPtr());
+    alltoall(ax, lineSize, stream);
+    reorder(transposeRecv.devPtr(), true);
+
+    CUFFT_Check( cufftExecZ2Z(ax.plan, pencils.devPtr(), pencils.devPtr(), CUFFT_FORWARD) );
+
+    reorder(transposeSend.devPtr(), false);
+    alltoall(ax, lineSize, stream);
+    lines(false, transposeRecv.devPtr());
+}
+
+void EnergySpectrumPlugin::computeSpectrum(cudaStream_t stream)
+{
+    const int n = resolution.x * resolution.y * resolution.z;
+    const double ntot = (double) globalResolution.x * globalResolution.y * globalResolution.z;
+
+    // Parseval: the mean of u^2 / 2 over the bins is the sum of |u_k|^2 / (2 ntot^2) over the modes
+    const double normalization = 0.5 / (ntot * ntot * dk);
+
+    const int nthreads = 128;
+    SAFE_KERNEL_LAUNCH(
+            EnergySpectrumKernels::binEnergy,
+            getNblocks(n, nthreads), nthreads, nShells * sizeof(double), stream,
+            field.devPtr(), resolution, rank3D * resolution, globalResolution, state->domain.globalSize,
+            dk, nShells, normalization, spectrum.devPtr() );
+}
+
+void EnergySpectrumPlugin::serializeAndSend(cudaStream_t stream)
+{
+    if (state->currentStep % dumpEvery != 0 || state->currentStep == 0) return;
+    if (nSpectra == 0) return;
+
+    debug2("Plugin '%s' is now packing the data", name.c_str());
+
+    spectrum.downloadFromDevice(stream, ContainersSynch::Synch);
+    spectrum.clearDevice(stream);
+
+    std::vector<double> local(spectrum.begin(), spectrum.end());
+
+    waitPrevSend();
+    SimpleSerializer::serialize(sendBuffer, state->currentTime, nSpectra, local);
+    send(sendBuffer);
+
+    nSpectra = 0;
+}
+
+//=================================================================================
+
+EnergySpectrumDumper::EnergySpectrumDumper(std::string name, std::string path) :
+    PostprocessPlugin(name),
+    path(path)
+{}
+
+void EnergySpectrumDumper::setup(const MPI_Comm& comm, const MPI_Comm& interComm)
+{
+    PostprocessPlugin::setup(comm, interComm);
+    activated = createFoldersCollective(comm, path);
+}
+
+void EnergySpectrumDumper::handshake()
+{
+    auto req = waitData();
+    MPI_Check( MPI_Wait(&req, MPI_STATUS_IGNORE) );
+    recv();
+
+    SimpleSerializer::deserialize(data, dk, nShells);
+}
+
+void EnergySpectrumDumper::deserialize(MPI_Status& stat)
+{
+    TimeType time;
+    int nSpectra;
+    std::vector<double> local;
+
+    SimpleSerializer::deserialize(data, time, nSpectra, local);
+
+    std::vector<double> global(local.size());
+    MPI_Check( MPI_Reduce(local.data(), global.data(), global.size(), MPI_DOUBLE, MPI_SUM, 0, comm) );
+
+    const int dumpId = nDumps++;
+    if (!activated || rank != 0) return;
+
+    std::string fname = path + "/" + name + "_" + getStrZeroPadded(dumpId) + ".txt";
+    FILE *fout = fopen(fname.c_str(), "w");
+    if (!fout) die("Could not open file '%s'", fname.c_str());
+
+    fprintf(fout, "# time %g, mean of %d spectra\n", time, nSpectra);
+    fprintf(fout, "# k, E(k)\n");
+
+    for (int i = 0; i < nShells; i++)
+        fprintf(fout, "%.6e %.6e\n", i * dk, global[i] / nSpectra);
+
+    fclose(fout);
+}
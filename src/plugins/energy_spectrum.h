@@ -0,0 +1,82 @@
+#pragma once
+
+#include "average_flow.h"
+
+#include <core/containers.h>
+
+#include <cufft.h>
+#include <mpi.h>
+#include <string>
+#include <vector>
+
+/**
+ * Shell-averaged kinetic energy spectrum E(k) of the velocity field of particle vectors,
+ * without dumping the field.
+ *
+ * Every sampleEvery steps the velocity is binned like in Average3D, into the same per-sample buffers,
+ * then Fourier transformed on the GPU over the whole domain. The 3D transform is done axis by axis:
+ * the ranks of a row of the rank grid along the axis exchange their blocks with MPI_Alltoall,
+ * such that each of them holds complete lines (pencils) of the global grid, transform them with cuFFT
+ * and send them back. The energy of the modes is then binned by |k| in shells of width
+ * 2 pi / max(global domain size) and accumulated on the device.
+ * Only the local spectra are sent every dumpEvery steps, the postprocess adds them.
+ */
+class EnergySpectrumPlugin : public Average3D
+{
+public:
+    EnergySpectrumPlugin(const YmrState *state, std::string name, std::vector<std::string> pvNames,
+                         int sampleEvery, int dumpEvery, float3 binSize);
+
+    ~EnergySpectrumPlugin();
+
+    void setup(Simulation* simulation, const MPI_Comm& comm, const MPI_Comm& interComm) override;
+    void handshake() override;
+    void afterIntegration(cudaStream_t stream) override;
+    void serializeAndSend(cudaStream_t stream) override;
+
+private:
+    /// transposes and 1D transforms along one axis
+    struct Axis
+    {
+        MPI_Comm rowComm {MPI_COMM_NULL};
+        int nRanks;
+        int nLines;          ///< of the local block, over the 3 components
+        int linesPerRank;    ///< of the pencils, the lines of the block being padded to nRanks * linesPerRank
+        cufftHandle plan;
+    };
+
+    Axis axes[3];
+    int3 globalResolution;
+    float dk;
+    int nShells;
+
+    DeviceBuffer<cufftDoubleComplex> field, pencils;    ///< the 3 components one after the other
+    PinnedBuffer<cufftDoubleComplex> transposeSend, transposeRecv;
+
+    int nSpectra {0};
+    PinnedBuffer<double> spectrum;
+
+    void transposeAndTransform(int axis, cudaStream_t stream);
+    void alltoall(const Axis& ax, int lineSize, cudaStream_t stream);
+    void loadVelocity(cudaStream_t stream);
+    void computeSpectrum(cudaStream_t stream);
+};
+
+
+class EnergySpectrumDumper : public PostprocessPlugin
+{
+public:
+    EnergySpectrumDumper(std::string name, std::string path);
+
+    void setup(const MPI_Comm& comm, const MPI_Comm& interComm) override;
+    void handshake() override;
+    void deserialize(MPI_Status& stat) override;
+
+private:
+    std::string path;
+    bool activated {true};
+
+    float dk;
+    int nShells;
+    int nDumps {0};
+};
@@ -103,10 +103,8 @@ void ExchangePVSFluxPlanePlugin::beforeCellLists(cudaStream_t stream)
 
     numberCrossedParticles.downloadFromDevice(stream, ContainersSynch::Synch);
 
-    const int old_size2 = view2.size;
-    const int new_size2 = old_size2 + numberCrossedParticles[0];
-
-    pv2->local()->resize(new_size2, stream);
+    // the crossed particles are marked in pv1 and dropped by its next cell-list build
+    const int old_size2 = editor.append(pv2->local(), numberCrossedParticles[0], stream);
     numberCrossedParticles.clear(stream);
 
     view2 = PVview(pv2, pv2->local());
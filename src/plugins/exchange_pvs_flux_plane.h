@@ -3,6 +3,7 @@
 #include "interface.h"
 
 #include <core/containers.h>
+#include <core/pvs/particle_editor.h>
 
 #include <string>
 
@@ -24,5 +25,6 @@ private:
     float4 plane;
 
     PinnedBuffer<int> numberCrossedParticles;
+    ParticleEditor editor;
 };
 
@@ -10,22 +10,32 @@
 #include "outlet.h"
 #include "density_control.h"
 #include "displacement.h"
+#include "distributions.h"
 #include "dump_mesh.h"
 #include "dump_obj_position.h"
 #include "dump_particles.h"
 #include "dump_particles_with_mesh.h"
 #include "dumpxyz.h"
+#include "effective_wall_force.h"
+#include "energy_spectrum.h"
 #include "exchange_pvs_flux_plane.h"
 #include "force_saver.h"
+#include "gpu_callback.h"
 #include "impose_profile.h"
 #include "impose_velocity.h"
+#include "isosurface.h"
+#include "load_diagnostics.h"
 #include "magnetic_orientation.h"
 #include "membrane_extra_force.h"
+#include "object_shape.h"
 #include "particle_channel_saver.h"
+#include "perf_counters.h"
 #include "pin_object.h"
+#include "probes.h"
 #include "radial_velocity_control.h"
 #include "stats.h"
 #include "temperaturize.h"
+#include "tracer_correlator.h"
 #include "velocity_control.h"
 #include "velocity_inlet.h"
 #include "virial_pressure.h"
@@ -99,7 +109,7 @@ createAddTorquePlugin(bool computeTask, const YmrState *state, std::string name,
 
 static pair_shared< DensityControlPlugin, PostprocessDensityControl >
 createDensityControlPlugin(bool computeTask, const YmrState *state, std::string name, std::string fname, std::vector<ParticleVector*> pvs,
-                           float targetDensity, std::function<float(PyTypes::float3)> region, PyTypes::float3 resolution,
+                           float targetDensity, FieldBatchFunction region, PyTypes::float3 resolution,
                            float levelLo, float levelHi, float levelSpace, float Kp, float Ki, float Kd,
                            int tuneEvery, int dumpEvery, int sampleEvery)
 {
@@ -109,7 +119,7 @@ createDensityControlPlugin(bool computeTask, const YmrState *state, std::string
     
     auto simPl = computeTask ?
         std::make_shared<DensityControlPlugin> (state, name, pvNames, targetDensity,
-                                                [region](float3 r) {return region(PyTypes::float3(r.x, r.y, r.z));},
+                                                region,
                                                 make_float3(resolution), levelLo, levelHi, levelSpace,
                                                 Kp, Ki, Kd, tuneEvery, dumpEvery, sampleEvery) :
         nullptr;
@@ -123,7 +133,7 @@ createDensityControlPlugin(bool computeTask, const YmrState *state, std::string
 
 static pair_shared< DensityOutletPlugin, PostprocessPlugin >
 createDensityOutletPlugin(bool computeTask, const YmrState *state, std::string name, std::vector<ParticleVector*> pvs,
-                          float numberDensity, std::function<float(PyTypes::float3)> region, PyTypes::float3 resolution)
+                          float numberDensity, FieldBatchFunction region, PyTypes::float3 resolution)
 {
     std::vector<std::string> pvNames;
 
@@ -131,7 +141,7 @@ createDensityOutletPlugin(bool computeTask, const YmrState *state, std::string n
     
     auto simPl = computeTask ?
         std::make_shared<DensityOutletPlugin> (state, name, pvNames, numberDensity,
-                                               [region](float3 r) {return region(PyTypes::float3(r.x, r.y, r.z));},
+                                               region,
                                                make_float3(resolution) )
         : nullptr;
     return { simPl, nullptr };
@@ -139,7 +149,7 @@ createDensityOutletPlugin(bool computeTask, const YmrState *state, std::string n
 
 static pair_shared< RateOutletPlugin, PostprocessPlugin >
 createRateOutletPlugin(bool computeTask, const YmrState *state, std::string name, std::vector<ParticleVector*> pvs,
-                       float rate, std::function<float(PyTypes::float3)> region, PyTypes::float3 resolution)
+                       float rate, FieldBatchFunction region, PyTypes::float3 resolution)
 {
     std::vector<std::string> pvNames;
 
@@ -147,7 +157,7 @@ createRateOutletPlugin(bool computeTask, const YmrState *state, std::string name
     
     auto simPl = computeTask ?
         std::make_shared<RateOutletPlugin> (state, name, pvNames, rate,
-                                            [region](float3 r) {return region(PyTypes::float3(r.x, r.y, r.z));},
+                                            region,
                                             make_float3(resolution) )
         : nullptr;
     return { simPl, nullptr };
@@ -157,7 +167,8 @@ static pair_shared< Average3D, UniformCartesianDumper >
 createDumpAveragePlugin(bool computeTask, const YmrState *state, std::string name, std::vector<ParticleVector*> pvs,
                         int sampleEvery, int dumpEvery, PyTypes::float3 binSize,
                         std::vector< std::pair<std::string, std::string> > channels,
-                        std::string path)
+                        std::string path, std::string compression, std::string backend, bool doublePrecision,
+                        std::string reduceAxes, int pyramidLevels)
 {
     std::vector<std::string> names, pvNames;
     std::vector<Average3D::ChannelType> types;
@@ -165,12 +176,23 @@ createDumpAveragePlugin(bool computeTask, const YmrState *state, std::string nam
     extractChannelsInfos(channels, names, types);
         
     if (computeTask) extractPVsNames(pvs, pvNames);
+
+    int3 reduced = make_int3(0, 0, 0);
+    for (char axis : reduceAxes)
+    {
+        if      (axis == 'x') reduced.x = 1;
+        else if (axis == 'y') reduced.y = 1;
+        else if (axis == 'z') reduced.z = 1;
+        else die("Plugin '%s': cannot reduce along '%c', the axes are x, y and z", name.c_str(), axis);
+    }
+    if (reduced.x && reduced.y && reduced.z)
+        die("Plugin '%s' cannot reduce along all the axes", name.c_str());
         
     auto simPl  = computeTask ?
-        std::make_shared<Average3D> (state, name, pvNames, names, types, sampleEvery, dumpEvery, make_float3(binSize)) :
+        std::make_shared<Average3D> (state, name, pvNames, names, types, sampleEvery, dumpEvery, make_float3(binSize), doublePrecision, reduced) :
         nullptr;
 
-    auto postPl = computeTask ? nullptr : std::make_shared<UniformCartesianDumper> (name, path);
+    auto postPl = computeTask ? nullptr : std::make_shared<UniformCartesianDumper> (name, path, XDMF::stringToCompression(compression), backend, pyramidLevels);
 
     return { simPl, postPl };
 }
@@ -180,7 +202,7 @@ createDumpAverageRelativePlugin(bool computeTask, const YmrState *state, std::st
                                 ObjectVector* relativeToOV, int relativeToId,
                                 int sampleEvery, int dumpEvery, PyTypes::float3 binSize,
                                 std::vector< std::pair<std::string, std::string> > channels,
-                                std::string path)
+                                std::string path, std::string compression, std::string backend, bool doublePrecision)
 {
     std::vector<std::string> names, pvNames;
     std::vector<Average3D::ChannelType> types;
@@ -192,41 +214,47 @@ createDumpAverageRelativePlugin(bool computeTask, const YmrState *state, std::st
     auto simPl  = computeTask ?
         std::make_shared<AverageRelative3D> (state, name, pvNames,
                                              names, types, sampleEvery, dumpEvery,
-                                             make_float3(binSize), relativeToOV->name, relativeToId) :
+                                             make_float3(binSize), relativeToOV->name, relativeToId, doublePrecision) :
         nullptr;
 
-    auto postPl = computeTask ? nullptr : std::make_shared<UniformCartesianDumper> (name, path);
+    auto postPl = computeTask ? nullptr : std::make_shared<UniformCartesianDumper> (name, path, XDMF::stringToCompression(compression), backend);
 
     return { simPl, postPl };
 }
 
 static pair_shared< MeshPlugin, MeshDumper >
-createDumpMeshPlugin(bool computeTask, const YmrState *state, std::string name, ObjectVector* ov, int dumpEvery, std::string path)
+createDumpMeshPlugin(bool computeTask, const YmrState *state, std::string name, ObjectVector* ov, int dumpEvery, std::string path,
+                     std::string backend, bool halfPrecision)
 {
-    auto simPl  = computeTask ? std::make_shared<MeshPlugin> (state, name, ov->name, dumpEvery) : nullptr;
-    auto postPl = computeTask ? nullptr : std::make_shared<MeshDumper> (name, path);
+    auto simPl  = computeTask ? std::make_shared<MeshPlugin> (state, name, ov->name, dumpEvery, halfPrecision) : nullptr;
+    auto postPl = computeTask ? nullptr : std::make_shared<MeshDumper> (name, path, backend);
 
     return { simPl, postPl };
 }
 
 static pair_shared< ParticleSenderPlugin, ParticleDumperPlugin >
 createDumpParticlesPlugin(bool computeTask, const YmrState *state, std::string name, ParticleVector *pv, int dumpEvery,
-                          std::vector< std::pair<std::string, std::string> > channels, std::string path)
+                          std::vector< std::pair<std::string, std::string> > channels, std::string path,
+                          std::string compression, int subfiles, int decimation, std::string filter,
+                          std::string backend)
 {
     std::vector<std::string> names;
     std::vector<ParticleSenderPlugin::ChannelType> types;
 
     extractChannelInfos(channels, names, types);
         
-    auto simPl  = computeTask ? std::make_shared<ParticleSenderPlugin> (state, name, pv->name, dumpEvery, names, types) : nullptr;
-    auto postPl = computeTask ? nullptr : std::make_shared<ParticleDumperPlugin> (name, path);
+    auto simPl  = computeTask ? std::make_shared<ParticleSenderPlugin> (state, name, pv->name, dumpEvery, names, types, decimation,
+                                                                         stringToDumpFilter(filter)) : nullptr;
+    auto postPl = computeTask ? nullptr : std::make_shared<ParticleDumperPlugin> (name, path, XDMF::stringToCompression(compression),
+                                                                                  subfiles, backend);
 
     return { simPl, postPl };
 }
 
 static pair_shared< ParticleWithMeshSenderPlugin, ParticleWithMeshDumperPlugin >
 createDumpParticlesWithMeshPlugin(bool computeTask, const YmrState *state, std::string name, ObjectVector *ov, int dumpEvery,
-                                  std::vector< std::pair<std::string, std::string> > channels, std::string path)
+                                  std::vector< std::pair<std::string, std::string> > channels, std::string path,
+                                  std::string compression, std::string backend)
 {
     std::vector<std::string> names;
     std::vector<ParticleSenderPlugin::ChannelType> types;
@@ -234,15 +262,16 @@ createDumpParticlesWithMeshPlugin(bool computeTask, const YmrState *state, std::
     extractChannelInfos(channels, names, types);
         
     auto simPl  = computeTask ? std::make_shared<ParticleWithMeshSenderPlugin> (state, name, ov->name, dumpEvery, names, types) : nullptr;
-    auto postPl = computeTask ? nullptr : std::make_shared<ParticleWithMeshDumperPlugin> (name, path);
+    auto postPl = computeTask ? nullptr : std::make_shared<ParticleWithMeshDumperPlugin> (name, path, XDMF::stringToCompression(compression), backend);
 
     return { simPl, postPl };
 }
 
 static pair_shared< XYZPlugin, XYZDumper >
-createDumpXYZPlugin(bool computeTask, const YmrState *state, std::string name, ParticleVector* pv, int dumpEvery, std::string path)
+createDumpXYZPlugin(bool computeTask, const YmrState *state, std::string name, ParticleVector* pv, int dumpEvery, std::string path,
+                    int decimation)
 {
-    auto simPl  = computeTask ? std::make_shared<XYZPlugin> (state, name, pv->name, dumpEvery) : nullptr;
+    auto simPl  = computeTask ? std::make_shared<XYZPlugin> (state, name, pv->name, dumpEvery, decimation) : nullptr;
     auto postPl = computeTask ? nullptr : std::make_shared<XYZDumper> (name, path);
 
     return { simPl, postPl };
@@ -257,6 +286,43 @@ createDumpObjPosition(bool computeTask, const YmrState *state, std::string name,
     return { simPl, postPl };
 }
 
+static pair_shared< ObjectShapePlugin, ObjectShapeDumper >
+createObjectShapePlugin(bool computeTask, const YmrState *state, std::string name, ObjectVector* ov, int dumpEvery, std::string path)
+{
+    auto simPl  = computeTask ? std::make_shared<ObjectShapePlugin> (state, name, ov->name, dumpEvery) : nullptr;
+    auto postPl = computeTask ? nullptr : std::make_shared<ObjectShapeDumper> (name, path);
+
+    return { simPl, postPl };
+}
+
+static pair_shared< EnergySpectrumPlugin, EnergySpectrumDumper >
+createEnergySpectrumPlugin(bool computeTask, const YmrState *state, std::string name, std::vector<ParticleVector*> pvs,
+                           int sampleEvery, int dumpEvery, PyTypes::float3 binSize, std::string path)
+{
+    std::vector<std::string> pvNames;
+    if (computeTask) extractPVsNames(pvs, pvNames);
+
+    auto simPl  = computeTask ?
+        std::make_shared<EnergySpectrumPlugin> (state, name, pvNames, sampleEvery, dumpEvery, make_float3(binSize)) :
+        nullptr;
+
+    auto postPl = computeTask ? nullptr : std::make_shared<EnergySpectrumDumper> (name, path);
+
+    return { simPl, postPl };
+}
+
+static pair_shared< EffectiveWallForcePlugin, PostprocessPlugin >
+createEffectiveWallForcePlugin(bool computeTask, const YmrState *state, std::string name, ParticleVector *pv, Wall *wall,
+                               const PyTypes::VectorOfFloat3& profile, float kBT)
+{
+    std::vector<float3> entries;
+    for (auto& e : profile)
+        entries.push_back(make_float3(e[0], e[1], e[2]));
+
+    auto simPl = computeTask ? std::make_shared<EffectiveWallForcePlugin> (state, name, pv->name, wall->name, entries, kBT) : nullptr;
+    return { simPl, nullptr };
+}
+
 static pair_shared< ExchangePVSFluxPlanePlugin, PostprocessPlugin >
 createExchangePVSFluxPlanePlugin(bool computeTask, const YmrState *state, std::string name, ParticleVector *pv1, ParticleVector *pv2, PyTypes::float4 plane)
 {
@@ -273,6 +339,25 @@ createForceSaverPlugin(bool computeTask,  const YmrState *state, std::string nam
     return { simPl, nullptr };
 }
 
+static pair_shared< GPUCallbackPlugin, PostprocessPlugin >
+createGPUCallbackPlugin(bool computeTask, const YmrState *state, std::string name, ParticleVector *pv,
+                        std::string stage, int every, GPUCallbackPlugin::Callback callback,
+                        std::vector<std::string> channelNames)
+{
+    GPUCallbackPlugin::Stage stageType;
+
+    if      (stage == "before_forces")     stageType = GPUCallbackPlugin::Stage::BeforeForces;
+    else if (stage == "after_integration") stageType = GPUCallbackPlugin::Stage::AfterIntegration;
+    else die("Unknown stage '%s' of plugin '%s', expected 'before_forces' or 'after_integration'",
+             stage.c_str(), name.c_str());
+
+    auto simPl = computeTask ?
+        std::make_shared<GPUCallbackPlugin> (state, name, pv->name, channelNames, stageType, every, callback) :
+        nullptr;
+
+    return { simPl, nullptr };
+}
+
 static pair_shared< ImposeProfilePlugin, PostprocessPlugin >
 createImposeProfilePlugin(bool computeTask,  const YmrState *state, std::string name, ParticleVector* pv, 
                           PyTypes::float3 low, PyTypes::float3 high, PyTypes::float3 velocity, float kbt)
@@ -299,6 +384,27 @@ createImposeVelocityPlugin(bool computeTask,  const YmrState *state, std::string
     return { simPl, nullptr };
 }
 
+static pair_shared< IsosurfacePlugin, IsosurfaceDumper >
+createIsosurfacePlugin(bool computeTask, const YmrState *state, std::string name,
+                       PyTypes::float3 h, float isoValue, int dumpEvery, std::string path,
+                       std::vector<ParticleVector*> pvs, std::vector<Wall*> walls)
+{
+    std::vector<std::string> pvNames, wallNames;
+    if (computeTask)
+    {
+        extractPVsNames(pvs, pvNames);
+        for (auto wall : walls) wallNames.push_back(wall->name);
+    }
+
+    auto simPl = computeTask ?
+        std::make_shared<IsosurfacePlugin> (state, name, pvNames, wallNames, make_float3(h), isoValue, dumpEvery) :
+        nullptr;
+
+    auto postPl = computeTask ? nullptr : std::make_shared<IsosurfaceDumper> (name, path);
+
+    return { simPl, postPl };
+}
+
 static pair_shared< MagneticOrientationPlugin, PostprocessPlugin >
 createMagneticOrientationPlugin(bool computeTask, const YmrState *state, std::string name, RigidObjectVector *rov, PyTypes::float3 moment,
                                 std::function<PyTypes::float3(float)> magneticFunction)
@@ -338,6 +444,19 @@ createParticleDisplacementPlugin(bool computeTask, const YmrState *state, std::s
     return { simPl, nullptr };
 }
 
+static pair_shared< PerfCountersPlugin, PerfCountersDumper >
+createPerfCountersPlugin(bool computeTask, const YmrState *state, std::string name,
+                         std::vector<ParticleVector*> pvs, int every, std::string filename)
+{
+    std::vector<std::string> pvNames;
+    if (computeTask) extractPVsNames(pvs, pvNames);
+
+    auto simPl  = computeTask ? std::make_shared<PerfCountersPlugin> (state, name, pvNames, every) : nullptr;
+    auto postPl = computeTask ? nullptr : std::make_shared<PerfCountersDumper> (name, filename);
+
+    return { simPl, postPl };
+}
+
 static pair_shared< PinObjectPlugin, ReportPinObjectPlugin >
 createPinObjPlugin(bool computeTask, const YmrState *state, std::string name, ObjectVector* ov,
                    int dumpEvery, std::string path,
@@ -356,7 +475,7 @@ static pair_shared< SimulationVelocityControl, PostprocessVelocityControl >
 createVelocityControlPlugin(bool computeTask, const YmrState *state, std::string name, std::string filename, std::vector<ParticleVector*> pvs,
                             PyTypes::float3 low, PyTypes::float3 high,
                             int sampleEvery, int tuneEvery, int dumpEvery,
-                            PyTypes::float3 targetVel, float Kp, float Ki, float Kd)
+                            PyTypes::float3 targetVel, float Kp, float Ki, float Kd, bool lagged)
 {
     std::vector<std::string> pvNames;
     if (computeTask) extractPVsNames(pvs, pvNames);
@@ -364,7 +483,7 @@ createVelocityControlPlugin(bool computeTask, const YmrState *state, std::string
     auto simPl = computeTask ?
         std::make_shared<SimulationVelocityControl>(state, name, pvNames, make_float3(low), make_float3(high),
                                                     sampleEvery, tuneEvery, dumpEvery,
-                                                    make_float3(targetVel), Kp, Ki, Kd) :
+                                                    make_float3(targetVel), Kp, Ki, Kd, lagged) :
         nullptr;
 
     auto postPl = computeTask ?
@@ -377,7 +496,7 @@ createVelocityControlPlugin(bool computeTask, const YmrState *state, std::string
 static pair_shared< SimulationRadialVelocityControl, PostprocessRadialVelocityControl >
 createRadialVelocityControlPlugin(bool computeTask, const YmrState *state, std::string name, std::string filename, std::vector<ParticleVector*> pvs,
                                   float minRadius, float maxRadius, int sampleEvery, int tuneEvery, int dumpEvery,
-                                  PyTypes::float3 center, float targetVel, float Kp, float Ki, float Kd)
+                                  PyTypes::float3 center, float targetVel, float Kp, float Ki, float Kd, bool lagged)
 {
     std::vector<std::string> pvNames;
     if (computeTask) extractPVsNames(pvs, pvNames);
@@ -385,7 +504,7 @@ createRadialVelocityControlPlugin(bool computeTask, const YmrState *state, std::
     auto simPl = computeTask ?
         std::make_shared<SimulationRadialVelocityControl>(state, name, pvNames, minRadius, maxRadius, 
                                                           sampleEvery, tuneEvery, dumpEvery,
-                                                          make_float3(center), targetVel, Kp, Ki, Kd) :
+                                                          make_float3(center), targetVel, Kp, Ki, Kd, lagged) :
         nullptr;
 
     auto postPl = computeTask ?
@@ -395,11 +514,56 @@ createRadialVelocityControlPlugin(bool computeTask, const YmrState *state, std::
     return { simPl, postPl };
 }
 
+static pair_shared< LoadDiagnosticsPlugin, UniformCartesianDumper >
+createLoadDiagnosticsPlugin(bool computeTask, const YmrState *state, std::string name, int sampleEvery, int dumpEvery,
+                            std::string path, std::string compression, std::string backend)
+{
+    auto simPl  = computeTask ? std::make_shared<LoadDiagnosticsPlugin> (state, name, sampleEvery, dumpEvery) : nullptr;
+    auto postPl = computeTask ? nullptr : std::make_shared<UniformCartesianDumper> (name, path, XDMF::stringToCompression(compression), backend);
+
+    return { simPl, postPl };
+}
+
+static pair_shared< RadialDistributionPlugin, RadialDistributionDumper >
+createRadialDistributionPlugin(bool computeTask, const YmrState *state, std::string name, ParticleVector *pv,
+                               float rmax, int nbins, int sampleEvery, int dumpEvery, std::string path)
+{
+    auto simPl  = computeTask ? std::make_shared<RadialDistributionPlugin> (state, name, pv->name, rmax, nbins, sampleEvery, dumpEvery) : nullptr;
+    auto postPl = computeTask ? nullptr : std::make_shared<RadialDistributionDumper> (name, path);
+
+    return { simPl, postPl };
+}
+
+static pair_shared< VelocityDistributionPlugin, VelocityDistributionDumper >
+createVelocityDistributionPlugin(bool computeTask, const YmrState *state, std::string name, ParticleVector *pv,
+                                 float vmax, int nbins, int sampleEvery, int dumpEvery, std::string path)
+{
+    auto simPl  = computeTask ? std::make_shared<VelocityDistributionPlugin> (state, name, pv->name, vmax, nbins, sampleEvery, dumpEvery) : nullptr;
+    auto postPl = computeTask ? nullptr : std::make_shared<VelocityDistributionDumper> (name, path);
+
+    return { simPl, postPl };
+}
+
+static pair_shared< ProbesPlugin, ProbesDumper >
+createProbesPlugin(bool computeTask, const YmrState *state, std::string name, ParticleVector *pv,
+                   const PyTypes::VectorOfFloat3& probes, float radius, int sampleEvery, int dumpEvery, std::string path)
+{
+    std::vector<float3> points;
+    for (auto& p : probes)
+        points.push_back(make_float3(p[0], p[1], p[2]));
+
+    auto simPl  = computeTask ? std::make_shared<ProbesPlugin> (state, name, pv->name, points, radius, sampleEvery, dumpEvery) : nullptr;
+    auto postPl = computeTask ? nullptr : std::make_shared<ProbesDumper> (name, path);
+
+    return { simPl, postPl };
+}
+
 static pair_shared< SimulationStats, PostprocessStats >
-createStatsPlugin(bool computeTask, const YmrState *state, std::string name, std::string filename, int every)
+createStatsPlugin(bool computeTask, const YmrState *state, std::string name, std::string filename, int every,
+                  int samplesPerMessage, bool windowStatistics)
 {
-    auto simPl  = computeTask ? std::make_shared<SimulationStats> (state, name, every) : nullptr;
-    auto postPl = computeTask ? nullptr : std::make_shared<PostprocessStats> (name, filename);
+    auto simPl  = computeTask ? std::make_shared<SimulationStats> (state, name, every, samplesPerMessage) : nullptr;
+    auto postPl = computeTask ? nullptr : std::make_shared<PostprocessStats> (name, filename, windowStatistics);
 
     return { simPl, postPl };
 }
@@ -413,19 +577,28 @@ createTemperaturizePlugin(bool computeTask, const YmrState *state, std::string n
 
 static pair_shared< VirialPressurePlugin, VirialPressureDumper >
 createVirialPressurePlugin(bool computeTask, const YmrState *state, std::string name, ParticleVector *pv,
-                           std::function<float(PyTypes::float3)> region, PyTypes::float3 h,
+                           FieldBatchFunction region, PyTypes::float3 h,
                            int dumpEvery, std::string path)
 {
-    auto regionFunc = [region](float3 r) {
-                          return region(PyTypes::float3(r.x, r.y, r.z));
-                      };
     auto simPl  = computeTask ? std::make_shared<VirialPressurePlugin> (state, name, pv->name,
-                                                                        regionFunc, make_float3(h), dumpEvery)
+                                                                        region, make_float3(h), dumpEvery)
         : nullptr;
     auto postPl = computeTask ? nullptr : std::make_shared<VirialPressureDumper> (name, path);
     return { simPl, postPl };
 }
 
+static pair_shared< TracerCorrelatorPlugin, TracerCorrelatorDumper >
+createTracerCorrelatorPlugin(bool computeTask, const YmrState *state, std::string name, ParticleVector *pv,
+                             int nTracers, int stride, int sampleEvery, int dumpEvery,
+                             int blockSize, int nLevels, int averaging, std::string path)
+{
+    auto simPl  = computeTask ? std::make_shared<TracerCorrelatorPlugin> (state, name, pv->name, nTracers, stride,
+                                                                          sampleEvery, dumpEvery, blockSize, nLevels, averaging)
+        : nullptr;
+    auto postPl = computeTask ? nullptr : std::make_shared<TracerCorrelatorDumper> (name, path);
+    return { simPl, postPl };
+}
+
 static pair_shared< VelocityInletPlugin, PostprocessPlugin >
 createVelocityInletPlugin(bool computeTask, const YmrState *state, std::string name, ParticleVector *pv,
                           std::function<          float(PyTypes::float3)> implicitSurface,
@@ -462,7 +635,7 @@ createWallRepulsionPlugin(bool computeTask, const YmrState *state, std::string n
 
 static pair_shared< WallForceCollectorPlugin, WallForceDumperPlugin >
 createWallForceCollectorPlugin(bool computeTask, const YmrState *state, std::string name, Wall *wall, ParticleVector* pvFrozen,
-                               int sampleEvery, int dumpEvery, std::string filename)
+                               int sampleEvery, int dumpEvery, std::string filename, bool windowStatistics)
 {
     auto simPl = computeTask ?
         std::make_shared<WallForceCollectorPlugin> (state, name, wall->name, pvFrozen->name, sampleEvery, dumpEvery) :
@@ -470,7 +643,7 @@ createWallForceCollectorPlugin(bool computeTask, const YmrState *state, std::str
 
     auto postPl = computeTask ?
         nullptr :
-        std::make_shared<WallForceDumperPlugin> (name, filename);
+        std::make_shared<WallForceDumperPlugin> (name, filename, windowStatistics);
         
     return { simPl, postPl };
 }
@@ -0,0 +1,59 @@
+#include "gpu_callback.h"
+
+#include <core/pvs/particle_vector.h>
+#include <core/simulation.h>
+
+GPUCallbackPlugin::GPUCallbackPlugin(const YmrState *state, std::string name, std::string pvName,
+                                     std::vector<std::string> channelNames, Stage stage, int every, Callback callback) :
+    SimulationPlugin(state, name),
+    pvName(pvName),
+    channelNames(channelNames),
+    stage(stage),
+    every(every),
+    callback(callback)
+{}
+
+void GPUCallbackPlugin::setup(Simulation *simulation, const MPI_Comm& comm, const MPI_Comm& interComm)
+{
+    SimulationPlugin::setup(simulation, comm, interComm);
+
+    pv = simulation->getPVbyNameOrDie(pvName);
+
+    for (auto& channelName : channelNames)
+        if (!pv->local()->extraPerParticle.checkChannelExists(channelName))
+            die("Plugin '%s' needs the channel '%s' of pv '%s', which does not exist",
+                name.c_str(), channelName.c_str(), pvName.c_str());
+}
+
+void GPUCallbackPlugin::call(cudaStream_t stream)
+{
+    if (state->currentStep % every != 0) return;
+
+    auto lpv = pv->local();
+
+    GPUCallbackView view;
+    view.time      = state->currentTime;
+    view.step      = state->currentStep;
+    view.size      = lpv->size();
+    view.mass      = pv->mass;
+    view.particles = (uintptr_t) lpv->coosvels.devPtr();
+    view.forces    = (uintptr_t) lpv->forces.devPtr();
+    view.stream    = (uintptr_t) stream;
+
+    // the pointers may change at every step, after the redistribution
+    for (auto& channelName : channelNames)
+        view.channels[channelName] = (uintptr_t) lpv->extraPerParticle.getGenericData(channelName)->genericDevPtr();
+
+    debug2("Plugin '%s' calls its function on %d particles of pv '%s'", name.c_str(), view.size, pvName.c_str());
+    callback(view);
+}
+
+void GPUCallbackPlugin::beforeForces(cudaStream_t stream)
+{
+    if (stage == Stage::BeforeForces) call(stream);
+}
+
+void GPUCallbackPlugin::afterIntegration(cudaStream_t stream)
+{
+    if (stage == Stage::AfterIntegration) call(stream);
+}
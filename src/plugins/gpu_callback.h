@@ -0,0 +1,67 @@
+#pragma once
+
+#include <plugins/interface.h>
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+class ParticleVector;
+
+/// device data of the local particles given to the function of GPUCallbackPlugin
+struct GPUCallbackView
+{
+    TimeType time;
+    int step;
+
+    int size;
+    float mass;
+
+    uintptr_t particles;  ///< Particle*: coordinates and velocities, two float4 per particle
+    uintptr_t forces;     ///< Force*: one float4 per particle
+    std::map<std::string, uintptr_t> channels;  ///< requested extra channels of the particles
+
+    uintptr_t stream;     ///< cudaStream_t on which the kernels must be launched
+};
+
+/**
+ * Calls a user function at a given stage of the time-step, which launches its own kernels
+ * (e.g. CuPy or Numba) on the device data of the local particles of a ParticleVector.
+ * Custom forces or analysis then run on the GPU without host copies nor recompilation.
+ *
+ * The function is called on the host thread of the simulation and must only
+ * enqueue work on the given stream
+ */
+class GPUCallbackPlugin : public SimulationPlugin
+{
+public:
+    enum class Stage
+    {
+        BeforeForces, AfterIntegration
+    };
+
+    using Callback = std::function<void(const GPUCallbackView&)>;
+
+    GPUCallbackPlugin(const YmrState *state, std::string name, std::string pvName,
+                      std::vector<std::string> channelNames, Stage stage, int every, Callback callback);
+
+    void setup(Simulation *simulation, const MPI_Comm& comm, const MPI_Comm& interComm) override;
+
+    void beforeForces    (cudaStream_t stream) override;
+    void afterIntegration(cudaStream_t stream) override;
+
+    bool needPostproc() override { return false; }
+
+private:
+    std::string pvName;
+    ParticleVector *pv;
+    std::vector<std::string> channelNames;
+
+    Stage stage;
+    int every;
+    Callback callback;
+
+    void call(cudaStream_t stream);
+};
@@ -9,50 +9,61 @@
 
 namespace ImposeVelocityKernels
 {
-__global__ void addVelocity(PVview view, DomainInfo domain, float3 low, float3 high, float3 extraVel)
+__device__ inline bool isInside(float3 r, float3 low, float3 high)
+{
+    return low.x <= r.x && r.x <= high.x &&
+           low.y <= r.y && r.y <= high.y &&
+           low.z <= r.z && r.z <= high.z;
+}
+
+__global__ void addVelocity(PVview view, RegionCellsView cells, float3 low, float3 high, float3 extraVel)
 {
     int gid = blockIdx.x * blockDim.x + threadIdx.x;
-    if (gid >= view.size) return;
+    if (gid >= cells.size) return;
 
-    Particle p(view.particles, gid);
-    float3 gr = domain.local2global(p.r);
+    const int2 range = cells.particles(gid);
 
-    if (low.x <= gr.x && gr.x <= high.x &&
-        low.y <= gr.y && gr.y <= high.y &&
-        low.z <= gr.z && gr.z <= high.z)
+    for (int pid = range.x; pid < range.y; pid++)
     {
-        p.u += extraVel;
-        view.particles[2*gid+1] = p.u2Float4();
+        Particle p(view.particles, pid);
+
+        if (isInside(p.r, low, high))
+        {
+            p.u += extraVel;
+            view.particles[2*pid+1] = p.u2Float4();
+        }
     }
 }
 
-__global__ void averageVelocity(PVview view, DomainInfo domain, float3 low, float3 high, double3* totVel, int* nSamples)
+__global__ void averageVelocity(PVview view, RegionCellsView cells, float3 low, float3 high, double3* totVel, int* nSamples)
 {
     int gid = blockIdx.x * blockDim.x + threadIdx.x;
-    Particle p;
-
-    p.u = make_float3(0.f);
 
-    if (gid < view.size) {
+    float3 u = make_float3(0.0f);
+    int n = 0;
 
-        p.read(view.particles, gid);
-        float3 gr = domain.local2global(p.r);
+    if (gid < cells.size)
+    {
+        const int2 range = cells.particles(gid);
 
-        if (low.x <= gr.x && gr.x <= high.x &&
-            low.y <= gr.y && gr.y <= high.y &&
-            low.z <= gr.z && gr.z <= high.z)
-        {
-            atomicAggInc(nSamples);
-        }
-        else
+        for (int pid = range.x; pid < range.y; pid++)
         {
-            p.u = make_float3(0.0f);
+            Particle p(view.particles, pid);
+
+            if (isInside(p.r, low, high))
+            {
+                u += p.u;
+                n++;
+            }
         }
     }
-    
-    float3 u = warpReduce(p.u, [](float a, float b) { return a+b; });
-    if (__laneid() == 0 && dot(u, u) > 1e-8f)
+
+    u = warpReduce(u, [](float a, float b) { return a+b; });
+    n = warpReduce(n, [](int   a, int   b) { return a+b; });
+
+    if (__laneid() == 0 && n > 0)
     {
+        atomicAdd(nSamples, n);
         atomicAdd(&totVel[0].x, (double)u.x);
         atomicAdd(&totVel[0].y, (double)u.y);
         atomicAdd(&totVel[0].z, (double)u.z);
@@ -76,6 +87,19 @@ void ImposeVelocityPlugin::setup(Simulation* simulation, const MPI_Comm& comm, c
 
     for (auto& nm : pvNames)
         pvs.push_back(simulation->getPVbyNameOrDie(nm));
+
+    localLow  = state->domain.global2local(low);
+    localHigh = state->domain.global2local(high);
+
+    regionCells.resize(pvs.size());
+    for (int i = 0; i < pvs.size(); i++)
+    {
+        regionCells[i].setupBox(simulation->gelCellList(pvs[i]), localLow, localHigh, defaultStream);
+
+        if (!regionCells[i].valid())
+            warn("Plugin '%s' has no primary cell-list for PV '%s' and will visit all its particles",
+                 name.c_str(), pvs[i]->name.c_str());
+    }
 }
 
 void ImposeVelocityPlugin::afterIntegration(cudaStream_t stream)
@@ -87,11 +111,15 @@ void ImposeVelocityPlugin::afterIntegration(cudaStream_t stream)
         totVel.clearDevice(stream);
         nSamples.clearDevice(stream);
         
-        for (auto& pv : pvs)
+        for (int i = 0; i < pvs.size(); i++)
+        {
+            auto cells = regionCells[i].getView(pvs[i]->local()->size());
+
             SAFE_KERNEL_LAUNCH(
                     ImposeVelocityKernels::averageVelocity,
-                    getNblocks(pv->local()->size(), nthreads), nthreads, 0, stream,
-                    PVview(pv, pv->local()), state->domain, low, high, totVel.devPtr(), nSamples.devPtr() );
+                    getNblocks(cells.size, nthreads), nthreads, 0, stream,
+                    PVview(pvs[i], pvs[i]->local()), cells, localLow, localHigh, totVel.devPtr(), nSamples.devPtr() );
+        }
 
         totVel.downloadFromDevice(stream, ContainersSynch::Asynch);
         nSamples.downloadFromDevice(stream);
@@ -101,11 +129,15 @@ void ImposeVelocityPlugin::afterIntegration(cudaStream_t stream)
         debug("Current mean velocity measured by plugin '%s' is [%f %f %f]; as of %d particles",
               name.c_str(), avgVel.x, avgVel.y, avgVel.z, nSamples[0]);
 
-        for (auto& pv : pvs)
+        for (int i = 0; i < pvs.size(); i++)
+        {
+            auto cells = regionCells[i].getView(pvs[i]->local()->size());
+
             SAFE_KERNEL_LAUNCH(
                     ImposeVelocityKernels::addVelocity,
-                    getNblocks(pv->local()->size(), nthreads), nthreads, 0, stream,
-                    PVview(pv, pv->local()), state->domain, low, high, targetVel - avgVel);
+                    getNblocks(cells.size, nthreads), nthreads, 0, stream,
+                    PVview(pvs[i], pvs[i]->local()), cells, localLow, localHigh, targetVel - avgVel);
+        }
     }
 }
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <plugins/interface.h>
+#include <plugins/utils/region_cells.h>
 #include <core/containers.h>
 #include <vector>
 #include <string>
@@ -28,8 +29,12 @@ private:
     std::vector<ParticleVector*> pvs;
 
     float3 high, low;
+    float3 localHigh, localLow;
     float3 targetVel;
 
+    /// cells of the primary cell-list of each pv intersecting the box
+    std::vector<RegionCells> regionCells;
+
     int every;
 
     PinnedBuffer<int> nSamples{1};
@@ -1,4 +1,5 @@
 #include "interface.h"
+#include "batched_transport.h"
 
 Plugin::Plugin() = default;
 Plugin::~Plugin() = default;
@@ -39,6 +40,16 @@ void SimulationPlugin::beforeParticleDistribution (cudaStream_t stream) {}
 
 void SimulationPlugin::serializeAndSend (cudaStream_t stream) {}
 
+SimulationPlugin::HookPeriod SimulationPlugin::getHookPeriod(Hook hook) const
+{
+    return {1, 0};
+}
+
+SimulationPlugin::ChannelAccess SimulationPlugin::getChannelAccess(Hook hook) const
+{
+    return {false, {}, {}};
+}
+
 
 void SimulationPlugin::setup(Simulation* simulation, const MPI_Comm& comm, const MPI_Comm& interComm)
 {
@@ -71,8 +82,19 @@ void SimulationPlugin::send(const std::vector<char>& data)
     send(data.data(), data.size());
 }
 
+void SimulationPlugin::setBatchedSender(BatchedSender *sender)
+{
+    batchedSender = sender;
+}
+
 void SimulationPlugin::send(const void* data, int sizeInBytes)
 {
+    if (batchedSender)
+    {
+        batchedSender->add(name, {{data, sizeInBytes}});
+        return;
+    }
+
     // So that async Isend of the size works on
     // valid address
     localSendSize = sizeInBytes;
@@ -84,6 +106,43 @@ void SimulationPlugin::send(const void* data, int sizeInBytes)
     MPI_Check( MPI_Issend(data, sizeInBytes, MPI_BYTE, rank, 2*_tag()+1, interComm, &dataReq) );
 }
 
+void SimulationPlugin::send(const std::vector<std::pair<const void*, int>>& chunks)
+{
+    if (batchedSender)
+    {
+        batchedSender->add(name, chunks);
+        return;
+    }
+
+    waitPrevSend();
+
+    std::vector<int> lengths;
+    std::vector<MPI_Aint> addresses;
+    localSendSize = 0;
+
+    for (auto& chunk : chunks)
+    {
+        if (chunk.second == 0) continue;
+
+        MPI_Aint address;
+        MPI_Check( MPI_Get_address(chunk.first, &address) );
+        lengths  .push_back(chunk.second);
+        addresses.push_back(address);
+        localSendSize += chunk.second;
+    }
+
+    MPI_Datatype chunksType;
+    MPI_Check( MPI_Type_create_hindexed(lengths.size(), lengths.data(), addresses.data(), MPI_BYTE, &chunksType) );
+    MPI_Check( MPI_Type_commit(&chunksType) );
+
+    debug2("Plugin '%s' is sending the data (%d bytes in %d chunks)", name.c_str(), localSendSize, (int) lengths.size());
+    MPI_Check( MPI_Issend(&localSendSize, 1, MPI_INT, rank, 2*_tag(), interComm, &sizeReq) );
+    MPI_Check( MPI_Issend(MPI_BOTTOM, 1, chunksType, rank, 2*_tag()+1, interComm, &dataReq) );
+
+    // only marked for deallocation, the pending send keeps it alive
+    MPI_Check( MPI_Type_free(&chunksType) );
+}
+
 
 
 // PostprocessPlugin
@@ -97,25 +156,43 @@ PostprocessPlugin::~PostprocessPlugin() = default;
 MPI_Request PostprocessPlugin::waitData()
 {
     MPI_Request req;
-    MPI_Check( MPI_Irecv(&size, 1, MPI_INT, rank, 2*_tag(), interComm, &req) );
+    MPI_Check( MPI_Irecv(&recvSize, 1, MPI_INT, rank, 2*_tag(), interComm, &req) );
     return req;
 }
 
 void PostprocessPlugin::recv()
 {
-    data.resize(size);
+    recv(data);
+    size = data.size();
+}
+
+void PostprocessPlugin::recv(std::vector<char>& buffer)
+{
+    buffer.resize(recvSize);
     MPI_Status status;
     int count;
-    MPI_Check( MPI_Recv(data.data(), size, MPI_BYTE, rank, 2*_tag()+1, interComm, &status) );
+    MPI_Check( MPI_Recv(buffer.data(), recvSize, MPI_BYTE, rank, 2*_tag()+1, interComm, &status) );
     MPI_Check( MPI_Get_count(&status, MPI_BYTE, &count) );
 
-    if (count != size)
+    if (count != recvSize)
         error("Plugin '%s' was going to receive %d bytes, but actually got %d. That may be fatal",
-              name.c_str(), size, count);
+              name.c_str(), recvSize, count);
 
     debug3("Plugin '%s' has received the data (%d bytes)", name.c_str(), count);
 }
 
+void PostprocessPlugin::setReceivedData(const char *ptr, int size)
+{
+    this->size = size;
+    data.assign(ptr, ptr + size);
+}
+
+void PostprocessPlugin::setReceivedData(std::vector<char>&& buffer)
+{
+    data = std::move(buffer);
+    size = data.size();
+}
+
 void PostprocessPlugin::deserialize(MPI_Status& stat) {};
 
 void PostprocessPlugin::setup(const MPI_Comm& comm, const MPI_Comm& interComm)
@@ -2,11 +2,14 @@
 
 #include <mpi.h>
 #include <core/logger.h>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include "core/ymero_object.h"
 
 class Simulation;
+class BatchedSender;
 
 class Plugin
 {    
@@ -44,20 +47,64 @@ public:
 
     virtual void serializeAndSend (cudaStream_t stream);
 
+    /// the hooks above
+    enum class Hook
+    {
+        BeforeCellLists, BeforeForces, SerializeSend, BeforeIntegration, AfterIntegration, BeforeParticleDistribution
+    };
+
+    /// a hook is called at the steps with currentStep % every == phase, never if every is 0
+    struct HookPeriod
+    {
+        int every, phase;
+    };
+
+    /**
+     * Steps at which the task scheduler calls \p hook, such that it skips the steps where
+     * the hook would return right away. By default every hook is called at every step
+     */
+    virtual HookPeriod getHookPeriod(Hook hook) const;
+
+    /// particle vector channels touched by a hook, see getChannelAccess()
+    struct ChannelAccess
+    {
+        bool declared;                            ///< false if the hook may read or write anything
+        std::vector<std::string> reads, writes;   ///< ChannelNames::positions, ChannelNames::velocities or extra channels
+    };
+
+    /**
+     * Channels of the particle vectors that \p hook reads and writes. The task scheduler runs the declared
+     * hooks concurrently with the tasks touching none of their channels, e.g. the read-only diagnostics
+     * before the forces run together with the force computation.
+     * By default the hooks are undeclared and ordered against everything around them
+     */
+    virtual ChannelAccess getChannelAccess(Hook hook) const;
+
     virtual bool needPostproc() = 0;
 
     virtual void setup(Simulation *simulation, const MPI_Comm& comm, const MPI_Comm& interComm);
     virtual void finalize();    
 
+    /// send the next messages through \p sender instead of directly, nullptr to send directly
+    void setBatchedSender(BatchedSender *sender);
+
 protected:
     int localSendSize;
     MPI_Request sizeReq, dataReq;
+    BatchedSender *batchedSender{nullptr};
 
     int _tag();
     
     void waitPrevSend();
     void send(const std::vector<char>& data);
     void send(const void* data, int sizeInBytes);
+
+    /**
+     * Send the \p chunks [pointer, size in bytes] as one message, without packing them:
+     * the postprocess side receives their concatenation.
+     * The chunks must stay untouched until the next waitPrevSend()
+     */
+    void send(const std::vector<std::pair<const void*, int>>& chunks);
 };
 
 
@@ -71,17 +118,30 @@ public:
 
     MPI_Request waitData();
     void recv();
+
+    /// receive the message announced by waitData() into \p buffer, leaving the data of the plugin untouched
+    void recv(std::vector<char>& buffer);
     
     virtual void deserialize(MPI_Status& stat);
 
     virtual void setup(const MPI_Comm& comm, const MPI_Comm& interComm);    
 
+    /// take a message demultiplexed from a batch, see BatchedSender, as if it was received by recv()
+    void setReceivedData(const char *ptr, int size);
+
+    /// take a message received by recv(buffer), possibly on another thread
+    void setReceivedData(std::vector<char>&& buffer);
+
 protected:
 
     int _tag();
     
     std::vector<char> data;
-    int size;    
+    int size;
+
+private:
+    /// size announced by the pending waitData(), kept apart from the data that may be in use meanwhile
+    int recvSize;
 };
 
 
@@ -0,0 +1,181 @@
+#include "isosurface.h"
+#include "utils/simple_serializer.h"
+
+#include <core/pvs/particle_vector.h>
+#include <core/pvs/views/pv.h>
+#include <core/simulation.h>
+#include <core/utils/cuda_common.h>
+#include <core/utils/folders.h>
+#include <core/utils/kernel_launch.h>
+#include <core/walls/interface.h>
+#include <core/walls/wall_helpers.h>
+
+namespace IsosurfaceKernels
+{
+
+/// cloud-in-cell deposit of the particles on the nodes, each particle adds 1/cell volume to its 8 closest nodes
+__global__ void depositDensity(PVview view, int3 nNodes, float3 h, float3 origin, float *density)
+{
+    const int pid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (pid >= view.size) return;
+
+    Particle p;
+    p.readCoordinate(view.particles, pid);
+
+    const float3 s = (p.r - origin) / h;
+    const int3 node0 = make_int3( floorf(s) );
+    const float3 w1 = s - make_float3(node0);
+    const float3 w0 = 1.0f - w1;
+
+    const float invVolume = 1.0f / (h.x * h.y * h.z);
+
+#pragma unroll
+    for (int k = 0; k < 8; k++)
+    {
+        const int3 shift = make_int3(k & 1, (k >> 1) & 1, (k >> 2) & 1);
+        const int3 node = node0 + shift;
+
+        if (node.x < 0 || node.x >= nNodes.x ||
+            node.y < 0 || node.y >= nNodes.y ||
+            node.z < 0 || node.z >= nNodes.z)
+            continue;
+
+        const float w = (shift.x ? w1.x : w0.x) *
+                        (shift.y ? w1.y : w0.y) *
+                        (shift.z ? w1.z : w0.z);
+
+        atomicAdd(density + (node.z * nNodes.y + node.y) * nNodes.x + node.x, w * invVolume);
+    }
+}
+
+} // namespace IsosurfaceKernels
+
+IsosurfacePlugin::IsosurfacePlugin(const YmrState *state, std::string name,
+                                   std::vector<std::string> pvNames, std::vector<std::string> wallNames,
+                                   float3 gridH, float isoValue, int dumpEvery) :
+    SimulationPlugin(state, name),
+    pvNames(pvNames),
+    wallNames(wallNames),
+    gridH(gridH),
+    isoValue(isoValue),
+    dumpEvery(dumpEvery)
+{
+    if (pvNames.empty() == wallNames.empty())
+        die("Plugin '%s' needs either particle vectors or walls, exactly one of them", name.c_str());
+}
+
+void IsosurfacePlugin::setup(Simulation *simulation, const MPI_Comm& comm, const MPI_Comm& interComm)
+{
+    SimulationPlugin::setup(simulation, comm, interComm);
+
+    for (auto& pvName : pvNames)
+        pvs.push_back(simulation->getPVbyNameOrDie(pvName));
+
+    for (auto& wallName : wallNames)
+    {
+        auto wall = dynamic_cast<SDF_basedWall*>(simulation->getWallByNameOrDie(wallName));
+        if (wall == nullptr)
+            die("Plugin '%s' only supports sdf-based walls, '%s' is not", name.c_str(), wallName.c_str());
+        walls.push_back(wall);
+    }
+
+    const float3 localSize = state->domain.localSize;
+    const int3 nCells = max( make_int3(1), make_int3( ceilf(localSize / gridH - 1e-6f) ) );
+
+    nNodes = nCells + 1;
+    h      = localSize / make_float3(nCells);
+    origin = -0.5f * localSize;
+
+    info("Plugin '%s' extracts the isosurface %g of the %s on a grid of [%d %d %d] nodes",
+         name.c_str(), isoValue, pvs.empty() ? "walls SDF" : "number density",
+         nNodes.x, nNodes.y, nNodes.z);
+}
+
+void IsosurfacePlugin::computeDensity(cudaStream_t stream)
+{
+    const int nthreads = 128;
+
+    field.resize_anew(nNodes.x * nNodes.y * nNodes.z);
+    field.clear(stream);
+
+    // halo particles fill the nodes on the boundaries of the subdomain
+    for (auto pv : pvs)
+        for (auto lpv : {pv->local(), pv->halo()})
+        {
+            PVview view(pv, lpv);
+
+            SAFE_KERNEL_LAUNCH(
+                    IsosurfaceKernels::depositDensity,
+                    getNblocks(view.size, nthreads), nthreads, 0, stream,
+                    view, nNodes, h, origin, field.devPtr() );
+        }
+}
+
+void IsosurfacePlugin::afterIntegration(cudaStream_t stream)
+{
+    if (state->currentStep % dumpEvery != 0 || state->currentStep == 0) return;
+
+    // the previous triangles are sent in place
+    waitPrevSend();
+
+    if (walls.empty())
+        computeDensity(stream);
+    else
+        sdfOnNodes(walls, nNodes, h, origin, field, stream);
+
+    marchingCubes.compute(field.devPtr(), nNodes, h, origin, isoValue, stream);
+    marchingCubes.download(triangles, stream);
+
+    for (auto& t : triangles)
+    {
+        t.a = state->domain.local2global(t.a);
+        t.b = state->domain.local2global(t.b);
+        t.c = state->domain.local2global(t.c);
+    }
+}
+
+void IsosurfacePlugin::serializeAndSend(cudaStream_t stream)
+{
+    if (state->currentStep % dumpEvery != 0 || state->currentStep == 0) return;
+
+    debug2("Plugin '%s' is sending %d triangles", name.c_str(), (int) triangles.size());
+
+    SimpleSerializer::serializeChunks(sendBuffer, sendChunks, state->currentTime, triangles);
+    send(sendChunks);
+}
+
+SimulationPlugin::HookPeriod IsosurfacePlugin::getHookPeriod(Hook hook) const
+{
+    switch (hook)
+    {
+        case Hook::AfterIntegration:
+        case Hook::SerializeSend:     return {dumpEvery, 0};
+        default:                      return {0, 0};
+    }
+}
+
+//=================================================================================
+
+IsosurfaceDumper::IsosurfaceDumper(std::string name, std::string path) :
+    PostprocessPlugin(name),
+    path(path)
+{}
+
+void IsosurfaceDumper::setup(const MPI_Comm& comm, const MPI_Comm& interComm)
+{
+    PostprocessPlugin::setup(comm, interComm);
+    activated = createFoldersCollective(comm, parentPath(path));
+}
+
+void IsosurfaceDumper::deserialize(MPI_Status& stat)
+{
+    TimeType t;
+    SimpleSerializer::deserialize(data, t, triangles);
+
+    if (!activated) return;
+
+    std::string fname = path + getStrZeroPadded(timeStamp++, zeroPadding);
+    debug2("Plugin '%s' is writing %d triangles to '%s'", name.c_str(), (int) triangles.size(), fname.c_str());
+
+    MarchingCubes::dumpTriangles2XDMF(fname, triangles, t, comm);
+}
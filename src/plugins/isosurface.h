@@ -0,0 +1,78 @@
+#pragma once
+
+#include "interface.h"
+
+#include <core/containers.h>
+#include <core/marching_cubes.h>
+
+#include <string>
+#include <vector>
+
+class ParticleVector;
+class SDF_basedWall;
+
+/**
+ * Extract in situ an isosurface of a field sampled on a grid,
+ * triangulated on the GPU with marching cubes, see MarchingCubes::GPUMarchingCubes.
+ *
+ * The field is either the number density of the particle vectors
+ * (cloud-in-cell deposit of their local and halo particles on the nodes of the grid)
+ * or the merged SDF of the walls. The nodes span the whole subdomains,
+ * such that the surfaces of neighbouring ranks join.
+ * Only the triangles are sent, which is much smaller than the volume grid
+ */
+class IsosurfacePlugin : public SimulationPlugin
+{
+public:
+    IsosurfacePlugin(const YmrState *state, std::string name,
+                     std::vector<std::string> pvNames, std::vector<std::string> wallNames,
+                     float3 gridH, float isoValue, int dumpEvery);
+
+    void setup(Simulation *simulation, const MPI_Comm& comm, const MPI_Comm& interComm) override;
+
+    void afterIntegration(cudaStream_t stream) override;
+    void serializeAndSend(cudaStream_t stream) override;
+    HookPeriod getHookPeriod(Hook hook) const override;
+
+    bool needPostproc() override { return true; }
+
+private:
+    std::vector<std::string> pvNames, wallNames;
+    std::vector<ParticleVector*> pvs;
+    std::vector<SDF_basedWall*> walls;
+
+    float3 gridH;
+    float isoValue;
+    int dumpEvery;
+
+    int3 nNodes;
+    float3 h, origin;
+
+    DeviceBuffer<float> field;
+    MarchingCubes::GPUMarchingCubes marchingCubes;
+
+    std::vector<MarchingCubes::Triangle> triangles;
+    std::vector<char> sendBuffer;
+    std::vector<std::pair<const void*, int>> sendChunks;
+
+    void computeDensity(cudaStream_t stream);
+};
+
+
+class IsosurfaceDumper : public PostprocessPlugin
+{
+public:
+    IsosurfaceDumper(std::string name, std::string path);
+
+    void setup(const MPI_Comm& comm, const MPI_Comm& interComm) override;
+    void deserialize(MPI_Status& stat) override;
+
+private:
+    std::string path;
+    const int zeroPadding = 5;
+    int timeStamp = 0;
+
+    bool activated = true;
+
+    std::vector<MarchingCubes::Triangle> triangles;
+};
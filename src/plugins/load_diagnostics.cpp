@@ -0,0 +1,143 @@
+#include "load_diagnostics.h"
+#include "utils/simple_serializer.h"
+
+#include <core/pvs/object_vector.h>
+#include <core/pvs/particle_vector.h>
+#include <core/simulation.h>
+#include <core/utils/nvtx.h>
+#include <core/utils/perf_counters.h>
+
+#include <algorithm>
+
+namespace
+{
+/// names of the channels of the task times, in the order of NVTX::Category
+const std::vector<std::string> categoryChannels = {
+    "force_ms", "halo_ms", "bounce_ms", "plugin_ms", "integrate_ms", "other_ms"
+};
+
+const std::string bytesCounterPrefix = "exchanged bytes: ";
+} // anonymous namespace
+
+LoadDiagnosticsPlugin::LoadDiagnosticsPlugin(const YmrState *state, std::string name, int sampleEvery, int dumpEvery) :
+    SimulationPlugin(state, name),
+    sampleEvery(sampleEvery),
+    dumpEvery(dumpEvery)
+{
+    if (sampleEvery <= 0 || dumpEvery <= 0 || dumpEvery % sampleEvery != 0)
+        die("Plugin '%s': the dump period (%d) must be a positive multiple of the sampling period (%d)",
+            name.c_str(), dumpEvery, sampleEvery);
+}
+
+void LoadDiagnosticsPlugin::setup(Simulation *simulation, const MPI_Comm& comm, const MPI_Comm& interComm)
+{
+    SimulationPlugin::setup(simulation, comm, interComm);
+
+    this->simulation = simulation;
+    rank3D   = simulation->rank3D;
+    nranks3D = simulation->nranks3D;
+
+    pvs = simulation->getParticleVectors();
+    for (auto pv : pvs)
+        if (auto ov = dynamic_cast<ObjectVector*>(pv))
+            ovs.push_back(ov);
+
+    // the exchangers only count the bytes when the counters are enabled
+    PerfCounters::setEnabled(true);
+
+    windowStart    = state->currentStep;
+    exchangedBytes = getExchangedBytes();
+    categoryTimes  = simulation->getTaskCategoryTimes();
+    timer.start();
+
+    info("Plugin '%s' dumps the load of the ranks every %d steps", name.c_str(), dumpEvery);
+}
+
+void LoadDiagnosticsPlugin::handshake()
+{
+    // one bin per rank
+    const int3 resolution {1, 1, 1};
+    const float3 h = state->domain.localSize;
+
+    std::vector<std::string> names = {"particles", "objects", "exchanged_bytes", "step_ms"};
+    names.insert(names.end(), categoryChannels.begin(), categoryChannels.end());
+    const std::vector<int> sizes(names.size(), 1);
+
+    SimpleSerializer::serialize(sendBuffer, nranks3D, rank3D, resolution, h, sizes, names, make_int3(0, 0, 0));
+    send(sendBuffer);
+}
+
+long long LoadDiagnosticsPlugin::getExchangedBytes()
+{
+    long long total = 0;
+    for (auto& counter : PerfCounters::get())
+        if (counter.first.compare(0, bytesCounterPrefix.size(), bytesCounterPrefix) == 0)
+            total += counter.second;
+    return total;
+}
+
+void LoadDiagnosticsPlugin::afterIntegration(cudaStream_t stream)
+{
+    if (state->currentStep % sampleEvery != 0) return;
+
+    for (auto pv : pvs)
+        particles += pv->local()->size();
+
+    for (auto ov : ovs)
+        objects += ov->local()->nObjects;
+
+    nSamples++;
+}
+
+void LoadDiagnosticsPlugin::serializeAndSend(cudaStream_t stream)
+{
+    if (state->currentStep % dumpEvery != 0 || state->currentStep == 0) return;
+    if (nSamples == 0) return;
+
+    const int nsteps = std::max(1, state->currentStep - windowStart);
+    const double volume = (double) state->domain.localSize.x * state->domain.localSize.y * state->domain.localSize.z;
+
+    // the counters and the profiles may have been reset meanwhile
+    auto sinceWindowStart = [] (double current, double start) {
+        return current >= start ? current - start : current;
+    };
+
+    const long long bytes = getExchangedBytes();
+    const auto times = simulation->getTaskCategoryTimes();
+
+    std::vector<std::vector<double>> channels;
+    channels.push_back({particles / nSamples});
+    channels.push_back({objects   / nSamples});
+    channels.push_back({sinceWindowStart(bytes, exchangedBytes) / nsteps});
+    channels.push_back({timer.elapsedAndReset() / nsteps});
+
+    for (int i = 0; i < categoryChannels.size(); i++)
+    {
+        const double start = i < categoryTimes.size() ? categoryTimes[i] : 0.0;
+        channels.push_back({sinceWindowStart(times[i], start) / nsteps});
+    }
+
+    const std::vector<double> density = {particles / nSamples / volume};
+
+    debug2("Plugin '%s' is sending the load of the last %d steps", name.c_str(), nsteps);
+
+    waitPrevSend();
+    SimpleSerializer::serialize(sendBuffer, state->currentTime, density, channels);
+    send(sendBuffer);
+
+    nSamples  = 0;
+    particles = objects = 0;
+    windowStart    = state->currentStep;
+    exchangedBytes = bytes;
+    categoryTimes  = times;
+}
+
+SimulationPlugin::HookPeriod LoadDiagnosticsPlugin::getHookPeriod(Hook hook) const
+{
+    switch (hook)
+    {
+        case Hook::AfterIntegration:  return {sampleEvery, 0};
+        case Hook::SerializeSend:     return {dumpEvery, 0};
+        default:                      return {0, 0};
+    }
+}
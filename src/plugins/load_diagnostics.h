@@ -0,0 +1,54 @@
+#pragma once
+
+#include <plugins/interface.h>
+#include <core/utils/timer.h>
+
+#include <string>
+#include <vector>
+
+class ParticleVector;
+class ObjectVector;
+
+/**
+ * Per-rank measures of the load, averaged over windows of steps and dumped as a grid with one cell per rank
+ * by a UniformCartesianDumper, such that the imbalance can be looked at over the domain.
+ *
+ * Every \p sampleEvery steps, the local numbers of particles and objects are sampled.
+ * Every \p dumpEvery steps, the averages are sent with, per step of the window:
+ * the exchanged bytes (from the PerfCounters, enabled by the plugin), the host time
+ * and the GPU time of every category of tasks (only while the scheduler profiles the tasks)
+ */
+class LoadDiagnosticsPlugin : public SimulationPlugin
+{
+public:
+    LoadDiagnosticsPlugin(const YmrState *state, std::string name, int sampleEvery, int dumpEvery);
+
+    void setup(Simulation *simulation, const MPI_Comm& comm, const MPI_Comm& interComm) override;
+    void handshake() override;
+    void afterIntegration(cudaStream_t stream) override;
+    void serializeAndSend(cudaStream_t stream) override;
+    HookPeriod getHookPeriod(Hook hook) const override;
+
+    bool needPostproc() override { return true; }
+
+private:
+    int sampleEvery, dumpEvery;
+    int3 rank3D, nranks3D;
+
+    Simulation *simulation;
+    std::vector<ParticleVector*> pvs;
+    std::vector<ObjectVector*> ovs;
+
+    int nSamples {0};
+    double particles {0}, objects {0};
+
+    /// values at the beginning of the window
+    int windowStart {0};
+    long long exchangedBytes {0};
+    std::vector<double> categoryTimes;
+    mTimer timer;
+
+    std::vector<char> sendBuffer;
+
+    static long long getExchangedBytes();
+};
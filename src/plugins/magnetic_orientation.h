@@ -7,6 +7,7 @@
 #include <core/utils/folders.h>
 
 class RigidObjectVector;
+class BodyForces;
 
 class MagneticOrientationPlugin : public SimulationPlugin
 {
@@ -26,5 +27,6 @@ private:
     RigidObjectVector* rov;
     float3 moment;
     UniformMagneticFunc magneticFunction;
+    BodyForces *bodyForces;
 };
 
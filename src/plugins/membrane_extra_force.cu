@@ -23,17 +23,8 @@ __global__ void addForce(OVview view, const Force *forces)
 MembraneExtraForcePlugin::MembraneExtraForcePlugin(const YmrState *state, std::string name, std::string pvName, const PyTypes::VectorOfFloat3 &forces) :
     SimulationPlugin(state, name),
     pvName(pvName),
-    forces(forces.size())
-{
-    HostBuffer<Force> hostForces(forces.size());
-
-    for (int i = 0; i < forces.size(); ++i) {
-        auto f = forces[i];
-        hostForces.hostPtr()[i].f = make_float3(f[0], f[1], f[2]);
-    }
-    
-    this->forces.copy(hostForces, 0);
-}
+    inputForces(forces)
+{}
 
 void MembraneExtraForcePlugin::setup(Simulation *simulation, const MPI_Comm& comm, const MPI_Comm& interComm)
 {
@@ -42,6 +33,21 @@ void MembraneExtraForcePlugin::setup(Simulation *simulation, const MPI_Comm& com
     auto pv_ptr = simulation->getPVbyNameOrDie(pvName);
     if ( !(pv = dynamic_cast<MembraneVector*>(pv_ptr)) )
         die("MembraneExtraForcePlugin '%s' expects a MembraneVector (given '%s')", name.c_str(), pvName.c_str());
+
+    // the forces are given in the order of the input mesh, the mesh vertices may be renumbered
+    const auto& originalIds = pv->mesh->getOriginalIds();
+    if (originalIds.size() != inputForces.size())
+        die("MembraneExtraForcePlugin '%s' got %d forces for a mesh of %d vertices",
+            name.c_str(), (int) inputForces.size(), (int) originalIds.size());
+
+    HostBuffer<Force> hostForces(inputForces.size());
+
+    for (int i = 0; i < inputForces.size(); ++i) {
+        auto f = inputForces[originalIds[i]];
+        hostForces.hostPtr()[i].f = make_float3(f[0], f[1], f[2]);
+    }
+    
+    forces.copy(hostForces, 0);
 }
 
 void MembraneExtraForcePlugin::beforeForces(cudaStream_t stream)
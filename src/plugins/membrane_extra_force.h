@@ -25,6 +25,7 @@ public:
 private:
     std::string pvName;
     MembraneVector *pv;
+    PyTypes::VectorOfFloat3 inputForces;
     DeviceBuffer<Force> forces;
 };
 
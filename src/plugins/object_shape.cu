@@ -0,0 +1,327 @@
+#include "object_shape.h"
+#include "utils/simple_serializer.h"
+
+#include <core/interactions/membrane/common.h>
+#include <core/pvs/object_vector.h>
+#include <core/pvs/views/ov.h>
+#include <core/simulation.h>
+#include <core/utils/cuda_common.h>
+#include <core/utils/folders.h>
+#include <core/utils/kernel_launch.h>
+
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+namespace ObjectShapeKernels
+{
+
+enum Sums { XX = 0, XY, XZ, YY, YZ, ZZ, Area, Volume, NSums };
+
+/**
+ * Cyclic Jacobi rotations of the symmetric matrix \p a, which ends up diagonal;
+ * the columns of \p v are the eigenvectors
+ */
+__device__ inline void jacobiEigen(float a[3][3], float v[3][3])
+{
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            v[i][j] = (i == j) ? 1.0f : 0.0f;
+
+    const int maxSweeps = 16;
+    const float scale = a[0][0]*a[0][0] + a[1][1]*a[1][1] + a[2][2]*a[2][2] + 1e-30f;
+
+    for (int sweep = 0; sweep < maxSweeps; sweep++)
+    {
+        const float off = a[0][1]*a[0][1] + a[0][2]*a[0][2] + a[1][2]*a[1][2];
+        if (off < 1e-14f * scale) return;
+
+        for (int p = 0; p < 2; p++)
+            for (int q = p+1; q < 3; q++)
+            {
+                if (fabsf(a[p][q]) < 1e-30f) continue;
+
+                const float theta = (a[q][q] - a[p][p]) / (2.0f * a[p][q]);
+                const float t = copysignf(1.0f, theta) / (fabsf(theta) + sqrtf(theta*theta + 1.0f));
+                const float c = rsqrtf(t*t + 1.0f);
+                const float s = t * c;
+
+                for (int k = 0; k < 3; k++)
+                {
+                    const float akp = a[k][p], akq = a[k][q];
+                    a[k][p] = c * akp - s * akq;
+                    a[k][q] = s * akp + c * akq;
+                }
+                for (int k = 0; k < 3; k++)
+                {
+                    const float apk = a[p][k], aqk = a[q][k];
+                    a[p][k] = c * apk - s * aqk;
+                    a[q][k] = s * apk + c * aqk;
+                }
+                for (int k = 0; k < 3; k++)
+                {
+                    const float vkp = v[k][p], vkq = v[k][q];
+                    v[k][p] = c * vkp - s * vkq;
+                    v[k][q] = s * vkp + c * vkq;
+                }
+            }
+    }
+}
+
+/// the first thread of the block turns the sums into the shape
+__device__ inline ObjectShape finalize(const float *sums, int nParticles, int id, float3 com)
+{
+    ObjectShape shape;
+    shape.id = id;
+    shape.com = com;
+    shape.area   = sums[Area];
+    shape.volume = sums[Volume];
+
+    const float invN = 1.0f / nParticles;
+    for (int c = 0; c < 6; c++)
+        shape.gyration[c] = sums[c] * invN;
+
+    const float *g = shape.gyration;
+    float a[3][3] = { {g[0], g[1], g[2]},
+                      {g[1], g[3], g[4]},
+                      {g[2], g[4], g[5]} };
+    float v[3][3];
+    jacobiEigen(a, v);
+
+    // decreasing order of the eigenvalues
+    int order[3] = {0, 1, 2};
+    for (int i = 0; i < 2; i++)
+        for (int j = 0; j < 2-i; j++)
+            if (a[order[j]][order[j]] < a[order[j+1]][order[j+1]])
+            {
+                const int tmp = order[j]; order[j] = order[j+1]; order[j+1] = tmp;
+            }
+
+    float values[3];
+    for (int i = 0; i < 3; i++)
+    {
+        const int k = order[i];
+        values[i] = fmaxf(a[k][k], 0.0f);
+        shape.axes[i] = make_float3(v[0][k], v[1][k], v[2][k]);
+    }
+    shape.eigenvalues = make_float3(values[0], values[1], values[2]);
+
+    // the semi-axes are proportional to the square roots of the eigenvalues
+    const float L = sqrtf(values[0]), B = sqrtf(values[2]);
+    shape.deformation = (L + B) > 0.0f ? (L - B) / (L + B) : 0.0f;
+
+    return shape;
+}
+
+/// One block per object: the threads go over the particles, then over the triangles
+__global__ void computeShapes(OVview view, MeshView mesh, const float4 *vertices, ObjectShape *shapes)
+{
+    __shared__ float sums[NSums];
+
+    const int objId = blockIdx.x;
+    const float3 com = view.comAndExtents[objId].com;
+
+    if (threadIdx.x < NSums) sums[threadIdx.x] = 0.0f;
+    __syncthreads();
+
+    float xx = 0, xy = 0, xz = 0, yy = 0, yz = 0, zz = 0;
+    for (int i = threadIdx.x; i < view.objSize; i += blockDim.x)
+    {
+        const float3 r = f4tof3(view.particles[2 * (objId * view.objSize + i)]) - com;
+
+        xx += r.x * r.x;  xy += r.x * r.y;  xz += r.x * r.z;
+        yy += r.y * r.y;  yz += r.y * r.z;  zz += r.z * r.z;
+    }
+
+    float area = 0, volume = 0;
+    for (int i = threadIdx.x; i < mesh.ntriangles; i += blockDim.x)
+    {
+        const int3 ids = mesh.getTriangle(i);
+        const int offset = objId * mesh.nvertices;
+
+        const float3 v0 = f4tof3(vertices[2 * (offset + ids.x)]) - com;
+        const float3 v1 = f4tof3(vertices[2 * (offset + ids.y)]) - com;
+        const float3 v2 = f4tof3(vertices[2 * (offset + ids.z)]) - com;
+
+        area   += triangleArea(v0, v1, v2);
+        volume += triangleSignedVolume(v0, v1, v2);
+    }
+
+    const float local[NSums] = {xx, xy, xz, yy, yz, zz, area, volume};
+    for (int c = 0; c < NSums; c++)
+    {
+        const float sum = warpReduce(local[c], [] (float a, float b) { return a+b; });
+        if (__laneid() == 0) atomicAdd(sums + c, sum);
+    }
+    __syncthreads();
+
+    if (threadIdx.x == 0)
+        shapes[objId] = finalize(sums, view.objSize, view.ids[objId], com);
+}
+
+} // namespace ObjectShapeKernels
+
+ObjectShapePlugin::ObjectShapePlugin(const YmrState *state, std::string name, std::string ovName, int dumpEvery) :
+    SimulationPlugin(state, name),
+    ovName(ovName),
+    dumpEvery(dumpEvery)
+{
+    if (dumpEvery <= 0)
+        die("Plugin '%s' needs a positive dump period, got %d", name.c_str(), dumpEvery);
+}
+
+ObjectShapePlugin::~ObjectShapePlugin() = default;
+
+void ObjectShapePlugin::setup(Simulation *simulation, const MPI_Comm& comm, const MPI_Comm& interComm)
+{
+    SimulationPlugin::setup(simulation, comm, interComm);
+
+    ov = dynamic_cast<ObjectVector*>(simulation->getPVbyNameOrDie(ovName));
+    if (ov == nullptr)
+        die("Plugin '%s' needs an object vector, '%s' is not", name.c_str(), ovName.c_str());
+
+    if (!ov->mesh)
+        die("Plugin '%s' needs the objects of '%s' to have a mesh for their area and volume", name.c_str(), ovName.c_str());
+
+    info("Plugin '%s' computes the shapes of the objects of '%s' every %d steps", name.c_str(), ovName.c_str(), dumpEvery);
+}
+
+void ObjectShapePlugin::handshake()
+{
+    SimpleSerializer::serialize(sendBuffer, ovName);
+    send(sendBuffer);
+}
+
+void ObjectShapePlugin::afterIntegration(cudaStream_t stream)
+{
+    if (state->currentStep % dumpEvery != 0 || state->currentStep == 0) return;
+
+    auto lov = ov->local();
+    ov->findExtentAndCOM(stream, ParticleVectorType::Local);
+
+    OVview view(ov, lov);
+    MeshView mesh(ov->mesh.get());
+    auto vertices = lov->getMeshVertices(stream);
+
+    shapes.resize_anew(view.nObjects);
+
+    const int nthreads = 128;
+    SAFE_KERNEL_LAUNCH(
+            ObjectShapeKernels::computeShapes,
+            view.nObjects, nthreads, 0, stream,
+            view, mesh, reinterpret_cast<const float4*>(vertices->devPtr()), shapes.devPtr() );
+
+    shapes.downloadFromDevice(stream, ContainersSynch::Asynch);
+
+    savedTime = state->currentTime;
+    needToSend = true;
+}
+
+void ObjectShapePlugin::serializeAndSend(cudaStream_t stream)
+{
+    if (!needToSend) return;
+
+    debug2("Plugin %s is sending now data", name.c_str());
+
+    CUDA_Check( cudaStreamSynchronize(stream) );
+
+    std::vector<ObjectShape> table(shapes.begin(), shapes.end());
+    for (auto& s : table)
+        s.com = state->domain.local2global(s.com);
+
+    waitPrevSend();
+    SimpleSerializer::serialize(sendBuffer, savedTime, table);
+    send(sendBuffer);
+
+    needToSend = false;
+}
+
+SimulationPlugin::HookPeriod ObjectShapePlugin::getHookPeriod(Hook hook) const
+{
+    switch (hook)
+    {
+        case Hook::AfterIntegration:  return {dumpEvery, 0};
+        case Hook::SerializeSend:     return {dumpEvery, 0};
+        default:                      return {0, 0};
+    }
+}
+
+//=================================================================================
+
+ObjectShapeDumper::ObjectShapeDumper(std::string name, std::string path) :
+    PostprocessPlugin(name),
+    path(path)
+{}
+
+ObjectShapeDumper::~ObjectShapeDumper()
+{
+    if (activated)
+        MPI_Check( MPI_File_close(&fout) );
+}
+
+void ObjectShapeDumper::setup(const MPI_Comm& comm, const MPI_Comm& interComm)
+{
+    PostprocessPlugin::setup(comm, interComm);
+    activated = createFoldersCollective(comm, path);
+}
+
+void ObjectShapeDumper::handshake()
+{
+    auto req = waitData();
+    MPI_Check( MPI_Wait(&req, MPI_STATUS_IGNORE) );
+    recv();
+
+    std::string ovName;
+    SimpleSerializer::deserialize(data, ovName);
+
+    if (!activated) return;
+
+    // truncate the file of a previous run
+    auto fname = path + "/" + ovName + "_shapes.txt";
+    MPI_Check( MPI_File_open(comm, fname.c_str(), MPI_MODE_CREATE | MPI_MODE_DELETE_ON_CLOSE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fout) );
+    MPI_Check( MPI_File_close(&fout) );
+    MPI_Check( MPI_File_open(comm, fname.c_str(), MPI_MODE_WRONLY | MPI_MODE_CREATE, MPI_INFO_NULL, &fout) );
+}
+
+void ObjectShapeDumper::deserialize(MPI_Status& stat)
+{
+    TimeType time;
+    std::vector<ObjectShape> shapes;
+    SimpleSerializer::deserialize(data, time, shapes);
+
+    if (!activated) return;
+
+    std::stringstream ss;
+    ss.precision(6);
+
+    for (const auto& s : shapes)
+    {
+        ss << s.id << " " << time << "  "
+           << s.com.x << " " << s.com.y << " " << s.com.z << "  "
+           << s.area << " " << s.volume << " ";
+
+        for (int c = 0; c < 6; c++)
+            ss << " " << s.gyration[c];
+
+        ss << "  " << s.eigenvalues.x << " " << s.eigenvalues.y << " " << s.eigenvalues.z;
+
+        for (int i = 0; i < 3; i++)
+            ss << "  " << s.axes[i].x << " " << s.axes[i].y << " " << s.axes[i].z;
+
+        ss << "  " << s.deformation << "\n";
+    }
+
+    // the ranks append their lines one after the other
+    const std::string content = ss.str();
+
+    MPI_Offset offset = 0, size;
+    MPI_Check( MPI_File_get_size(fout, &size) );
+    MPI_Check( MPI_Barrier(comm) );
+
+    MPI_Offset len = content.size();
+    MPI_Check( MPI_Exscan(&len, &offset, 1, MPI_OFFSET, MPI_SUM, comm) );
+
+    MPI_Status status;
+    MPI_Check( MPI_File_write_at_all(fout, offset + size, content.c_str(), len, MPI_CHAR, &status) );
+    MPI_Check( MPI_Barrier(comm) );
+}
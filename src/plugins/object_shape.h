@@ -0,0 +1,77 @@
+#pragma once
+
+#include "interface.h"
+
+#include <core/containers.h>
+
+#include <mpi.h>
+#include <string>
+#include <vector>
+
+class ObjectVector;
+
+/// shape of one object, in global coordinates
+struct ObjectShape
+{
+    int id;
+    float3 com;
+    float area, volume;
+    float gyration[6];    ///< xx, xy, xz, yy, yz, zz of the gyration tensor
+    float3 eigenvalues;   ///< of the gyration tensor, in decreasing order
+    float3 axes[3];       ///< unit principal axes of the eigenvalues, the major one first
+    float deformation;    ///< Taylor deformation index (L - B) / (L + B) of the major and minor semi-axes
+};
+
+/**
+ * Shape statistics of the objects of an object vector, computed on the GPU every dumpEvery steps:
+ * gyration tensor of the particles of every object around its center of mass, its eigenvalues and
+ * principal axes, area and volume enclosed by the mesh and Taylor deformation index.
+ * One block per object reduces the particles and the triangles, its first thread diagonalizes the tensor.
+ * Only the table of ObjectShape is downloaded and sent to the postprocess.
+ *
+ * The inertia tensor of an object of N particles of mass m is N m (tr(G) I - G) for the gyration tensor G.
+ */
+class ObjectShapePlugin : public SimulationPlugin
+{
+public:
+    ObjectShapePlugin(const YmrState *state, std::string name, std::string ovName, int dumpEvery);
+    ~ObjectShapePlugin();
+
+    void setup(Simulation *simulation, const MPI_Comm& comm, const MPI_Comm& interComm) override;
+    void handshake() override;
+
+    void afterIntegration(cudaStream_t stream) override;
+    void serializeAndSend(cudaStream_t stream) override;
+
+    HookPeriod getHookPeriod(Hook hook) const override;
+
+    bool needPostproc() override { return true; }
+
+private:
+    std::string ovName;
+    ObjectVector *ov;
+    int dumpEvery;
+
+    PinnedBuffer<ObjectShape> shapes;
+    TimeType savedTime {0};
+    bool needToSend {false};
+
+    std::vector<char> sendBuffer;
+};
+
+
+class ObjectShapeDumper : public PostprocessPlugin
+{
+public:
+    ObjectShapeDumper(std::string name, std::string path);
+    ~ObjectShapeDumper();
+
+    void setup(const MPI_Comm& comm, const MPI_Comm& interComm) override;
+    void handshake() override;
+    void deserialize(MPI_Status& stat) override;
+
+private:
+    std::string path;
+    bool activated {true};
+    MPI_File fout;
+};
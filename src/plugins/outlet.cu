@@ -1,6 +1,7 @@
 #include "outlet.h"
 
 #include <core/field/from_function.h>
+#include <core/field/volumes.h>
 #include <core/pvs/particle_vector.h>
 #include <core/pvs/views/pv.h>
 #include <core/simulation.h>
@@ -9,40 +10,20 @@
 #include <core/utils/kernel_launch.h>
 #include <core/utils/make_unique.h>
 
-using AccumulatedIntType = unsigned long long int;
-
 namespace RegionOutletPluginKernels
 {
 
-__device__ inline bool isInsideRegion(const FieldDeviceHandler& field, const float3& r)
-{
-    return field(r) < 0.f;
-}
-
-__global__ void countInsideRegion(AccumulatedIntType nSamples, DomainInfo domain, FieldDeviceHandler field, float seed, AccumulatedIntType *nInside)
+__device__ inline bool isInsideRegion(const RegionOutletPlugin::RegionHandler& region, const float3& r)
 {
-    AccumulatedIntType tid = threadIdx.x + blockIdx.x * blockDim.x;
-    int countInside = 0;
-
-    for (AccumulatedIntType i = tid; i < nSamples; i += blockDim.x * gridDim.x)
-    {
-        float3 r {Saru::uniform01(seed, i - 2, i + 4242),
-                  Saru::uniform01(seed, i - 3, i + 4343),
-                  Saru::uniform01(seed, i - 4, i + 4444)};
-
-        r = domain.localSize * (r - 0.5f);
-
-        if (isInsideRegion(field, r))
-            ++countInside;
-    }
+    // most particles are away from the region: skip the 8 texture fetches of the field for them
+    if (r.x < region.lo.x || r.y < region.lo.y || r.z < region.lo.z ||
+        r.x > region.hi.x || r.y > region.hi.y || r.z > region.hi.z)
+        return false;
 
-    countInside = warpReduce(countInside, [](int a, int b) {return a+b;});
-
-    if (__laneid() == 0)
-        atomicAdd(nInside, (AccumulatedIntType) countInside);
+    return region.field(r) < 0.f;
 }
 
-__global__ void countParticlesInside(PVview view, FieldDeviceHandler field, int *nInside)
+__global__ void countParticlesInside(PVview view, RegionOutletPlugin::RegionHandler region, int *nInside)
 {
     int i = threadIdx.x + blockIdx.x * blockDim.x;
     int countInside = 0;
@@ -52,7 +33,7 @@ __global__ void countParticlesInside(PVview view, FieldDeviceHandler field, int
         Particle p;
         p.readCoordinate(view.particles, i);
         
-        if (!p.isMarked() && isInsideRegion(field, p.r))
+        if (!p.isMarked() && isInsideRegion(region, p.r))
             ++countInside;
     }
 
@@ -83,31 +64,15 @@ void RegionOutletPlugin::setup(Simulation *simulation, const MPI_Comm& comm, con
         pvs.push_back( simulation->getPVbyNameOrDie(pvName) );
 
     outletRegion->setup(comm);
+    outletRegion->getNegativeBox(regionLo, regionHi);
     
-    volume = computeVolume(1000000, udistr(gen));
+    volume = FieldVolumes::computeVolumes(*outletRegion, state->domain, FieldVolumes::NegativeBinner(),
+                                          1, 1, defaultStream)[0];
 }
 
-double RegionOutletPlugin::computeVolume(long long int nSamples, float seed) const
+RegionOutletPlugin::RegionHandler RegionOutletPlugin::regionHandler() const
 {
-    auto domain = state->domain;
-
-    double totVolume = domain.localSize.x * domain.localSize.y * domain.localSize.z;
-
-    PinnedBuffer<AccumulatedIntType> nInside(1);
-    nInside.clearDevice(defaultStream);
-
-    const int nthreads = 128;
-    const int nblocks = std::min(getNblocks(nSamples, nthreads), 1024);
-    
-    SAFE_KERNEL_LAUNCH(
-        RegionOutletPluginKernels::countInsideRegion,
-        nblocks, nthreads, 0, defaultStream,
-        nSamples, domain, outletRegion->handler(),
-        seed, nInside.devPtr());
-
-    nInside.downloadFromDevice(defaultStream);
-
-    return totVolume * (double) nInside[0] / (double) nSamples;
+    return {outletRegion->handler(), regionLo, regionHi};
 }
 
 void RegionOutletPlugin::countInsideParticles(cudaStream_t stream)
@@ -123,7 +88,7 @@ void RegionOutletPlugin::countInsideParticles(cudaStream_t stream)
         SAFE_KERNEL_LAUNCH(
             RegionOutletPluginKernels::countParticlesInside,
             getNblocks(view.size, nthreads), nthreads, 0, stream,
-            view, outletRegion->handler(), nParticlesInside.devPtr());        
+            view, regionHandler(), nParticlesInside.devPtr());        
     }    
 }
 
@@ -132,7 +97,7 @@ namespace DensityOutletPluginKernels
 {
 using namespace RegionOutletPluginKernels;
 
-__global__ void killParticles(PVview view, FieldDeviceHandler field, const int *nInside, float seed, float rhoTimesVolume)
+__global__ void killParticles(PVview view, RegionOutletPlugin::RegionHandler region, const int *nInside, float seed, float rhoTimesVolume)
 {
     int i = threadIdx.x + blockIdx.x * blockDim.x;
     if (i >= view.size) return;
@@ -140,7 +105,7 @@ __global__ void killParticles(PVview view, FieldDeviceHandler field, const int *
     Particle p;
     p.readCoordinate(view.particles, i);
         
-    if (p.isMarked() || !isInsideRegion(field, p.r)) return;
+    if (p.isMarked() || !isInsideRegion(region, p.r)) return;
 
     int n = *nInside;
 
@@ -180,7 +145,7 @@ void DensityOutletPlugin::beforeCellLists(cudaStream_t stream)
         SAFE_KERNEL_LAUNCH(
             DensityOutletPluginKernels::killParticles,
             getNblocks(view.size, nthreads), nthreads, 0, stream,
-            view, outletRegion->handler(), nParticlesInside.devPtr(), seed, rhoTimesVolume);        
+            view, regionHandler(), nParticlesInside.devPtr(), seed, rhoTimesVolume);        
     }
 }
 
@@ -190,7 +155,7 @@ namespace RateOutletPluginKernels
 {
 using namespace RegionOutletPluginKernels;
 
-__global__ void killParticles(PVview view, FieldDeviceHandler field, const int *nInside, float seed, float QTimesdt)
+__global__ void killParticles(PVview view, RegionOutletPlugin::RegionHandler region, const int *nInside, float seed, float QTimesdt)
 {
     int i = threadIdx.x + blockIdx.x * blockDim.x;
     if (i >= view.size) return;
@@ -198,7 +163,7 @@ __global__ void killParticles(PVview view, FieldDeviceHandler field, const int *
     Particle p;
     p.readCoordinate(view.particles, i);
         
-    if (p.isMarked() || !isInsideRegion(field, p.r)) return;
+    if (p.isMarked() || !isInsideRegion(region, p.r)) return;
 
     int n = *nInside;
 
@@ -238,6 +203,6 @@ void RateOutletPlugin::beforeCellLists(cudaStream_t stream)
         SAFE_KERNEL_LAUNCH(
             RateOutletPluginKernels::killParticles,
             getNblocks(view.size, nthreads), nthreads, 0, stream,
-            view, outletRegion->handler(), nParticlesInside.devPtr(), seed, QTimesdt);
+            view, regionHandler(), nParticlesInside.devPtr(), seed, QTimesdt);
     }
 }
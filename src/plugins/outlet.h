@@ -3,6 +3,7 @@
 #include "interface.h"
 
 #include <core/containers.h>
+#include <core/field/from_function.h>
 
 #include <functional>
 #include <memory>
@@ -12,12 +13,11 @@
 
 class ParticleVector;
 class CellList;
-class Field;
 
 class RegionOutletPlugin : public SimulationPlugin
 {
 public:
-    using RegionFunc = std::function<float(float3)>;
+    using RegionFunc = FieldBatchFunction;
     
     RegionOutletPlugin(const YmrState *state, std::string name, std::vector<std::string> pvNames,
                        RegionFunc region, float3 resolution);
@@ -28,9 +28,16 @@ public:
 
     bool needPostproc() override { return false; }
 
+    /// the region field with the box out of which it is positive, see Field::getNegativeBox()
+    struct RegionHandler
+    {
+        FieldDeviceHandler field;
+        float3 lo, hi;
+    };
+
 protected:
 
-    double computeVolume(long long int nSamples, float seed) const;
+    RegionHandler regionHandler() const;
     void countInsideParticles(cudaStream_t stream);
     
 protected:
@@ -41,6 +48,7 @@ protected:
     double volume;
 
     std::unique_ptr<Field> outletRegion;
+    float3 regionLo, regionHi;
 
     DeviceBuffer<int> nParticlesInside {1};
 
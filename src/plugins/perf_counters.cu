@@ -0,0 +1,225 @@
+#include "perf_counters.h"
+#include "utils/simple_serializer.h"
+
+#include <core/celllist.h>
+#include <core/pvs/particle_vector.h>
+#include <core/pvs/views/pv.h>
+#include <core/simulation.h>
+#include <core/utils/cuda_common.h>
+#include <core/utils/folders.h>
+#include <core/utils/kernel_launch.h>
+#include <core/utils/perf_counters.h>
+
+#include <map>
+
+namespace PerfCountersKernels
+{
+
+/// one thread per particle, each warp adds the neighbours counted by its threads at once
+__global__ void countPairs(CellListInfo cinfo, PVview view, unsigned long long *nPairs)
+{
+    const int pid = blockIdx.x * blockDim.x + threadIdx.x;
+    const float rc2 = cinfo.rc * cinfo.rc;
+    int n = 0;
+
+    if (pid < view.size)
+    {
+        Particle p;
+        p.readCoordinate(view.particles, pid);
+        const int3 cid3 = cinfo.getCellIdAlongAxes(p.r);
+
+        for (int dz = -1; dz <= 1; dz++)
+            for (int dy = -1; dy <= 1; dy++)
+                for (int dx = -1; dx <= 1; dx++)
+                {
+                    const int3 ncid3 = cid3 + make_int3(dx, dy, dz);
+                    if (ncid3.x < 0 || ncid3.x >= cinfo.ncells.x ||
+                        ncid3.y < 0 || ncid3.y >= cinfo.ncells.y ||
+                        ncid3.z < 0 || ncid3.z >= cinfo.ncells.z)
+                        continue;
+
+                    const int cid   = cinfo.encode(ncid3);
+                    const int start = cinfo.cellStarts[cid];
+                    const int end   = start + cinfo.cellSizes[cid];
+
+                    for (int j = start; j < end; j++)
+                    {
+                        if (j == pid) continue;
+
+                        Particle q;
+                        q.readCoordinate(view.particles, j);
+                        const float3 dr = p.r - q.r;
+
+                        if (dot(dr, dr) < rc2) n++;
+                    }
+                }
+    }
+
+    n = warpReduce(n, [] (int a, int b) { return a + b; });
+
+    if (__laneid() == 0 && n > 0)
+        atomicAdd(nPairs, (unsigned long long) n);
+}
+
+} // namespace PerfCountersKernels
+
+PerfCountersPlugin::PerfCountersPlugin(const YmrState *state, std::string name, std::vector<std::string> pvNames, int every) :
+    SimulationPlugin(state, name),
+    pvNames(pvNames),
+    every(every),
+    nPairs(1)
+{}
+
+PerfCountersPlugin::~PerfCountersPlugin() = default;
+
+void PerfCountersPlugin::setup(Simulation *simulation, const MPI_Comm& comm, const MPI_Comm& interComm)
+{
+    SimulationPlugin::setup(simulation, comm, interComm);
+    this->simulation = simulation;
+
+    for (auto& pvName : pvNames)
+        pvs.push_back(simulation->getPVbyNameOrDie(pvName));
+
+    PerfCounters::setEnabled(true);
+    PerfCounters::reset();
+
+    info("Plugin '%s' reports the performance counters every %d steps", name.c_str(), every);
+}
+
+void PerfCountersPlugin::countPairs(cudaStream_t stream)
+{
+    const int nthreads = 128;
+
+    for (auto pv : pvs)
+    {
+        auto cl = simulation->gelCellList(pv);
+        if (cl == nullptr)
+        {
+            warn("Plugin '%s' cannot count the pairs of '%s', it has no cell-list", name.c_str(), pv->name.c_str());
+            continue;
+        }
+
+        auto view = cl->getView<PVview>();
+
+        nPairs.clear(stream);
+        SAFE_KERNEL_LAUNCH(
+                PerfCountersKernels::countPairs,
+                getNblocks(view.size, nthreads), nthreads, 0, stream,
+                cl->cellInfo(), view, nPairs.devPtr() );
+        nPairs.downloadFromDevice(stream, ContainersSynch::Synch);
+
+        PerfCounters::add("interacting pairs: " + pv->name, nPairs[0]);
+        PerfCounters::add("particles: "         + pv->name, view.size);
+    }
+}
+
+void PerfCountersPlugin::beforeForces(cudaStream_t stream)
+{
+    // the cell-lists are up to date before the forces
+    if (state->currentStep % every != 0 || state->currentStep == 0) return;
+
+    countPairs(stream);
+}
+
+void PerfCountersPlugin::serializeAndSend(cudaStream_t stream)
+{
+    if (state->currentStep % every != 0 || state->currentStep == 0) return;
+
+    std::vector<std::string> names;
+    std::vector<long long> values;
+    for (auto& entry : PerfCounters::get())
+    {
+        names .push_back(entry.first);
+        values.push_back(entry.second);
+    }
+    PerfCounters::reset();
+
+    debug2("Plugin '%s' is sending %d counters", name.c_str(), (int) names.size());
+
+    waitPrevSend();
+    SimpleSerializer::serialize(sendBuffer, state->currentTime, state->currentStep, every, names, values);
+    send(sendBuffer);
+}
+
+SimulationPlugin::HookPeriod PerfCountersPlugin::getHookPeriod(Hook hook) const
+{
+    switch (hook)
+    {
+        case Hook::BeforeForces:
+        case Hook::SerializeSend:     return {every, 0};
+        default:                      return {0, 0};
+    }
+}
+
+//=================================================================================
+
+PerfCountersDumper::PerfCountersDumper(std::string name, std::string filename) :
+    PostprocessPlugin(name),
+    filename(filename)
+{}
+
+PerfCountersDumper::~PerfCountersDumper()
+{
+    if (fdump != nullptr) fclose(fdump);
+}
+
+void PerfCountersDumper::setup(const MPI_Comm& comm, const MPI_Comm& interComm)
+{
+    PostprocessPlugin::setup(comm, interComm);
+
+    if (rank == 0)
+    {
+        fdump = fopen(filename.c_str(), "w");
+        if (fdump == nullptr)
+            die("Plugin '%s' could not open the file '%s'", name.c_str(), filename.c_str());
+
+        fprintf(fdump, "# step time counter total per_step max_rank_per_step\n");
+    }
+}
+
+void PerfCountersDumper::deserialize(MPI_Status& stat)
+{
+    TimeType time;
+    int step, every;
+
+    // the ranks may not have the same counters, rank 0 merges them all
+    SimpleSerializer::deserialize(data, time, step, every);
+
+    int size = data.size();
+    std::vector<int> sizes(nranks), offsets(nranks + 1, 0);
+    MPI_Check( MPI_Gather(&size, 1, MPI_INT, sizes.data(), 1, MPI_INT, 0, comm) );
+
+    for (int i = 0; i < nranks; i++)
+        offsets[i+1] = offsets[i] + sizes[i];
+
+    std::vector<char> all(rank == 0 ? offsets[nranks] : 0);
+    MPI_Check( MPI_Gatherv(data.data(), size, MPI_BYTE, all.data(), sizes.data(), offsets.data(), MPI_BYTE, 0, comm) );
+
+    if (rank != 0) return;
+
+    struct Reduced { long long total {0}, max {0}; };
+    std::map<std::string, Reduced> reduced;
+
+    for (int i = 0; i < nranks; i++)
+    {
+        std::vector<char> msg(all.begin() + offsets[i], all.begin() + offsets[i+1]);
+        std::vector<std::string> names;
+        std::vector<long long> values;
+        TimeType t;
+        int s, e;
+        SimpleSerializer::deserialize(msg, t, s, e, names, values);
+
+        for (int k = 0; k < names.size(); k++)
+        {
+            auto& r = reduced[names[k]];
+            r.total += values[k];
+            r.max = std::max(r.max, values[k]);
+        }
+    }
+
+    for (auto& entry : reduced)
+        fprintf(fdump, "%d %g \"%s\" %lld %g %g\n", step, (double) time, entry.first.c_str(),
+                entry.second.total, (double) entry.second.total / every, (double) entry.second.max / every);
+
+    fflush(fdump);
+}
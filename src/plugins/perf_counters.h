@@ -0,0 +1,57 @@
+#pragma once
+
+#include "interface.h"
+
+#include <core/containers.h>
+
+#include <string>
+#include <vector>
+
+class ParticleVector;
+
+/**
+ * Periodically send the performance counters of the rank (see PerfCounters) and reset them.
+ *
+ * The counters are enabled when the plugin is set up. In addition, the plugin counts
+ * the pairs of particles closer than the cut-off of the cell-lists of the given
+ * particle vectors, i.e. the number of interactions evaluated by the pairwise forces
+ */
+class PerfCountersPlugin : public SimulationPlugin
+{
+public:
+    PerfCountersPlugin(const YmrState *state, std::string name, std::vector<std::string> pvNames, int every);
+    ~PerfCountersPlugin();
+
+    void setup(Simulation *simulation, const MPI_Comm& comm, const MPI_Comm& interComm) override;
+
+    void beforeForces(cudaStream_t stream) override;
+    void serializeAndSend(cudaStream_t stream) override;
+    HookPeriod getHookPeriod(Hook hook) const override;
+
+    bool needPostproc() override { return true; }
+
+private:
+    std::vector<std::string> pvNames;
+    std::vector<ParticleVector*> pvs;
+    Simulation *simulation;
+    int every;
+
+    PinnedBuffer<unsigned long long> nPairs;
+    std::vector<char> sendBuffer;
+
+    void countPairs(cudaStream_t stream);
+};
+
+class PerfCountersDumper : public PostprocessPlugin
+{
+public:
+    PerfCountersDumper(std::string name, std::string filename);
+    ~PerfCountersDumper();
+
+    void setup(const MPI_Comm& comm, const MPI_Comm& interComm) override;
+    void deserialize(MPI_Status& stat) override;
+
+private:
+    std::string filename;
+    FILE *fdump {nullptr};
+};
@@ -0,0 +1,284 @@
+#include "probes.h"
+#include "utils/simple_serializer.h"
+
+#include <core/celllist.h>
+#include <core/pvs/particle_vector.h>
+#include <core/pvs/views/pv.h>
+#include <core/simulation.h>
+#include <core/utils/common.h>
+#include <core/utils/cuda_common.h>
+#include <core/utils/folders.h>
+#include <core/utils/kernel_launch.h>
+
+#include <cmath>
+
+namespace ProbesKernels
+{
+
+/// Lucy kernel, not normalized
+__device__ inline float lucy(float q)
+{
+    const float s = 1.0f - q;
+    return (1.0f + 3.0f * q) * s * s * s;
+}
+
+/**
+ * One warp per probe: the lanes go over the particles of the cells covering the support of the probe,
+ * the particles being sorted by cell in the primary cell list
+ */
+__global__ void sampleProbes(PVview view, CellListInfo cinfo, int nProbes, const float3 *probes, float radius, float *samples)
+{
+    const int gid     = threadIdx.x + blockIdx.x * blockDim.x;
+    const int probeId = gid / warpSize;
+    const int laneId  = gid % warpSize;
+    if (probeId >= nProbes) return;
+
+    const float3 x = probes[probeId];
+    const int3 lo = cinfo.getCellIdAlongAxes(x - radius);
+    const int3 hi = cinfo.getCellIdAlongAxes(x + radius);
+
+    const float invRadius = 1.0f / radius;
+    float  w  = 0.0f;
+    float3 wu = make_float3(0.0f);
+
+    for (int iz = lo.z; iz <= hi.z; iz++)
+        for (int iy = lo.y; iy <= hi.y; iy++)
+            for (int ix = lo.x; ix <= hi.x; ix++)
+            {
+                const int cid   = cinfo.encode(ix, iy, iz);
+                const int start = cinfo.cellStarts[cid];
+                const int end   = start + cinfo.cellSizes[cid];
+
+                for (int i = start + laneId; i < end; i += warpSize)
+                {
+                    Particle p;
+                    p.readCoordinate(view.particles, i);
+
+                    const float q = length(p.r - x) * invRadius;
+                    if (q >= 1.0f || p.isMarked()) continue;
+
+                    p.readVelocity(view.particles, i);
+
+                    const float wi = lucy(q);
+                    w  += wi;
+                    wu += wi * p.u;
+                }
+            }
+
+    w  = warpReduce(w,  [] (float a, float b) { return a+b; });
+    wu = warpReduce(wu, [] (float a, float b) { return a+b; });
+
+    if (laneId == 0)
+    {
+        float *s = samples + ProbesPlugin::sampleSize * probeId;
+        s[0] = w;
+        s[1] = wu.x;  s[2] = wu.y;  s[3] = wu.z;
+    }
+}
+
+} // namespace ProbesKernels
+
+ProbesPlugin::ProbesPlugin(const YmrState *state, std::string name, std::string pvName,
+                           std::vector<float3> probes, float radius, int sampleEvery, int dumpEvery) :
+    SimulationPlugin(state, name),
+    pvName(pvName),
+    probes(probes),
+    radius(radius),
+    sampleEvery(sampleEvery),
+    dumpEvery(dumpEvery)
+{
+    if (probes.empty())
+        die("Plugin '%s' needs at least one probe", name.c_str());
+
+    if (radius <= 0.0f)
+        die("Plugin '%s' needs a positive kernel radius, got %g", name.c_str(), radius);
+
+    if (sampleEvery < 1 || dumpEvery % sampleEvery != 0)
+        die("Plugin '%s': dump_every (%d) must be a multiple of sample_every (%d)", name.c_str(), dumpEvery, sampleEvery);
+}
+
+ProbesPlugin::~ProbesPlugin() = default;
+
+void ProbesPlugin::setup(Simulation *simulation, const MPI_Comm& comm, const MPI_Comm& interComm)
+{
+    SimulationPlugin::setup(simulation, comm, interComm);
+
+    pv = simulation->getPVbyNameOrDie(pvName);
+    cl = dynamic_cast<PrimaryCellList*>(simulation->gelCellList(pv));
+
+    if (cl == nullptr)
+        die("Plugin '%s' needs the primary cell list of pv '%s', does it interact with anything?",
+            name.c_str(), pvName.c_str());
+
+    // the support of the probe intersects the subdomain
+    const auto& domain = state->domain;
+    const float3 reach = 0.5f * domain.localSize + radius;
+
+    std::vector<float3> local;
+    for (int i = 0; i < probes.size(); i++)
+    {
+        const float3 r = domain.global2local(probes[i]);
+        if (std::fabs(r.x) <= reach.x && std::fabs(r.y) <= reach.y && std::fabs(r.z) <= reach.z)
+        {
+            localIds.push_back(i);
+            local.push_back(r);
+        }
+    }
+
+    localProbes.resize_anew(local.size());
+    std::copy(local.begin(), local.end(), localProbes.hostPtr());
+    localProbes.uploadToDevice(defaultStream);
+
+    // samples at the dump step and at the sampling steps after the previous dump
+    samples.resize_anew((dumpEvery / sampleEvery + 1) * sampleSize * localIds.size());
+
+    info("Plugin '%s' probes pv '%s' at %d points, %d of them on this rank",
+         name.c_str(), pvName.c_str(), probes.size(), localIds.size());
+}
+
+void ProbesPlugin::handshake()
+{
+    SimpleSerializer::serialize(sendBuffer, pvName, probes, radius, pv->mass);
+    send(sendBuffer);
+}
+
+void ProbesPlugin::beforeForces(cudaStream_t stream)
+{
+    if (state->currentStep % sampleEvery != 0) return;
+
+    debug2("Plugin %s is sampling now", name.c_str());
+
+    const int nLocal = localIds.size();
+    PVview view(pv, pv->local());
+
+    const int nthreads = 128;
+
+    SAFE_KERNEL_LAUNCH(
+            ProbesKernels::sampleProbes,
+            getNblocks(nLocal * 32, nthreads), nthreads, 0, stream,
+            view, cl->cellInfo(), nLocal, localProbes.devPtr(), radius,
+            samples.devPtr() + nStored * sampleSize * nLocal );
+
+    times.push_back(state->currentTime);
+    nStored++;
+
+    if (state->currentStep % dumpEvery == 0 && state->currentStep != 0)
+    {
+        samples.downloadFromDevice(stream, ContainersSynch::Synch);
+        needToSend = true;
+    }
+}
+
+void ProbesPlugin::serializeAndSend(cudaStream_t stream)
+{
+    if (!needToSend) return;
+
+    debug2("Plugin %s is sending now data", name.c_str());
+
+    std::vector<float> stored(samples.begin(), samples.begin() + nStored * sampleSize * localIds.size());
+
+    waitPrevSend();
+    SimpleSerializer::serialize(sendBuffer, times, localIds, stored);
+    send(sendBuffer);
+
+    times.clear();
+    nStored = 0;
+    needToSend = false;
+}
+
+SimulationPlugin::HookPeriod ProbesPlugin::getHookPeriod(Hook hook) const
+{
+    switch (hook)
+    {
+        case Hook::BeforeForces:   return {sampleEvery, 0};
+        case Hook::SerializeSend:  return {dumpEvery, 0};
+        default:                   return {0, 0};
+    }
+}
+
+SimulationPlugin::ChannelAccess ProbesPlugin::getChannelAccess(Hook hook) const
+{
+    if (hook != Hook::BeforeForces) return SimulationPlugin::getChannelAccess(hook);
+    return {true, {ChannelNames::positions, ChannelNames::velocities}, {}};
+}
+
+//=================================================================================
+
+ProbesDumper::ProbesDumper(std::string name, std::string path) :
+    PostprocessPlugin(name),
+    path(path)
+{}
+
+ProbesDumper::~ProbesDumper()
+{
+    if (fout != nullptr) fclose(fout);
+}
+
+void ProbesDumper::setup(const MPI_Comm& comm, const MPI_Comm& interComm)
+{
+    PostprocessPlugin::setup(comm, interComm);
+    activated = createFoldersCollective(comm, path);
+}
+
+void ProbesDumper::handshake()
+{
+    auto req = waitData();
+    MPI_Check( MPI_Wait(&req, MPI_STATUS_IGNORE) );
+    recv();
+
+    std::string pvName;
+    std::vector<float3> probes;
+    SimpleSerializer::deserialize(data, pvName, probes, radius, mass);
+    nProbes = probes.size();
+
+    if (!activated || rank != 0) return;
+
+    std::string fname = path + "/" + pvName + "_probes.txt";
+    fout = fopen(fname.c_str(), "w");
+    if (!fout) die("Could not open file '%s'", fname.c_str());
+
+    fprintf(fout, "# Lucy kernel of radius %g, particle mass %g\n", radius, mass);
+    for (int i = 0; i < nProbes; i++)
+        fprintf(fout, "# probe %d: %g %g %g\n", i, probes[i].x, probes[i].y, probes[i].z);
+    fprintf(fout, "# time, then the number density and the velocity of every probe\n");
+}
+
+void ProbesDumper::deserialize(MPI_Status& stat)
+{
+    std::vector<TimeType> times;
+    std::vector<int> localIds;
+    std::vector<float> local;
+
+    SimpleSerializer::deserialize(data, times, localIds, local);
+
+    const int nSamples = times.size();
+    const int sampleSize = ProbesPlugin::sampleSize;
+
+    // the ranks sharing a probe add their partial sums
+    std::vector<double> sums(nSamples * nProbes * sampleSize, 0.0), global(sums.size());
+    for (int s = 0; s < nSamples; s++)
+        for (int i = 0; i < localIds.size(); i++)
+            for (int c = 0; c < sampleSize; c++)
+                sums[(s * nProbes + localIds[i]) * sampleSize + c] = local[(s * localIds.size() + i) * sampleSize + c];
+
+    MPI_Check( MPI_Reduce(sums.data(), global.data(), sums.size(), MPI_DOUBLE, MPI_SUM, 0, comm) );
+
+    if (fout == nullptr) return;
+
+    const double normalization = 105.0 / (16.0 * M_PI * radius * radius * radius);
+
+    for (int s = 0; s < nSamples; s++)
+    {
+        fprintf(fout, "%g", times[s]);
+        for (int i = 0; i < nProbes; i++)
+        {
+            const double *g = global.data() + (s * nProbes + i) * sampleSize;
+            const double invW = g[0] > 0.0 ? 1.0 / g[0] : 0.0;
+
+            fprintf(fout, " %.6e %.6e %.6e %.6e", g[0] * normalization, g[1] * invW, g[2] * invW, g[3] * invW);
+        }
+        fprintf(fout, "\n");
+    }
+
+    fflush(fout);
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "interface.h"
+
+#include <core/containers.h>
+
+#include <string>
+#include <vector>
+
+class ParticleVector;
+class CellList;
+
+/**
+ * Velocity and number density at a set of fixed points of the domain, interpolated from the particles
+ * around them with a Lucy kernel of support \c radius.
+ *
+ * Every rank keeps the probes whose support intersects its subdomain and sums the contributions
+ * of its own particles, found through the primary cell list of the particle vector; the partial sums
+ * of the ranks are added by the postprocess. Every sampleEvery steps the sums are stored on the device,
+ * only the samples of the local probes are sent, every dumpEvery steps
+ */
+class ProbesPlugin : public SimulationPlugin
+{
+public:
+    ProbesPlugin(const YmrState *state, std::string name, std::string pvName,
+                 std::vector<float3> probes, float radius, int sampleEvery, int dumpEvery);
+
+    ~ProbesPlugin();
+
+    void setup(Simulation *simulation, const MPI_Comm& comm, const MPI_Comm& interComm) override;
+    void handshake() override;
+
+    void beforeForces(cudaStream_t stream) override;
+    void serializeAndSend(cudaStream_t stream) override;
+
+    HookPeriod getHookPeriod(Hook hook) const override;
+    ChannelAccess getChannelAccess(Hook hook) const override;
+
+    bool needPostproc() override { return true; }
+
+    /// per probe and sample: sum of the weights and of the weighted velocities
+    static const int sampleSize = 4;
+
+private:
+    std::string pvName;
+    ParticleVector *pv;
+    CellList *cl;
+
+    std::vector<float3> probes;   ///< global coordinates
+    float radius;
+    int sampleEvery, dumpEvery;
+
+    std::vector<int> localIds;    ///< of the probes of this rank
+    PinnedBuffer<float3> localProbes;
+
+    int nStored {0};
+    std::vector<TimeType> times;
+    PinnedBuffer<float> samples;  ///< one row of sampleSize values per probe per stored sample
+
+    bool needToSend {false};
+    std::vector<char> sendBuffer;
+};
+
+
+class ProbesDumper : public PostprocessPlugin
+{
+public:
+    ProbesDumper(std::string name, std::string path);
+    ~ProbesDumper();
+
+    void setup(const MPI_Comm& comm, const MPI_Comm& interComm) override;
+    void handshake() override;
+    void deserialize(MPI_Status& stat) override;
+
+private:
+    std::string path;
+    bool activated {true};
+
+    int nProbes;
+    float radius, mass;
+    FILE *fout {nullptr};
+};
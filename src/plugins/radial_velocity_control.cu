@@ -16,62 +16,76 @@ __device__ inline bool validRadius(float r2, float minR2, float maxR2)
     return  minR2 < r2 && r2 < maxR2;
 }
 
-__global__ void addForce(PVview view, DomainInfo domain, float minRadiusSquare, float maxRadiusSquare,
+__global__ void addForce(PVview view, RegionCellsView cells, float minRadiusSquare, float maxRadiusSquare,
                          float3 center, float forceFactor)
 {
     int gid = blockIdx.x * blockDim.x + threadIdx.x;
-    if (gid >= view.size) return;
+    if (gid >= cells.size) return;
 
-    Particle p;
-    p.readCoordinate(view.particles, gid);
-    float3 r = domain.local2global(p.r);
-    r -= center;
-    float r2 = r.x * r.x + r.y * r.y;
+    const int2 range = cells.particles(gid);
 
-    if (!validRadius(r2, minRadiusSquare, maxRadiusSquare))
-        return;
+    for (int pid = range.x; pid < range.y; pid++)
+    {
+        Particle p;
+        p.readCoordinate(view.particles, pid);
+        float3 r = p.r - center;
+        float r2 = r.x * r.x + r.y * r.y;
 
-    float factor = forceFactor / r2;
-    
-    float3 force = {r.x * factor,
-                    r.y * factor,
-                    0.f};
-    
-    view.forces[gid] += make_float4(force, 0.0f);
+        if (!validRadius(r2, minRadiusSquare, maxRadiusSquare))
+            continue;
+
+        float factor = forceFactor / r2;
+
+        float3 force = {r.x * factor,
+                        r.y * factor,
+                        0.f};
+
+        view.forces[pid] += make_float4(force, 0.0f);
+    }
 }
 
-__global__ void sumVelocity(PVview view, DomainInfo domain, float minRadiusSquare, float maxRadiusSquare,
-                            float3 center, double *totVel, int *nSamples)
+/// add the radial velocities and the number of the particles in the shell to \p sums[0] and \p sums[1]
+__global__ void sumVelocity(PVview view, RegionCellsView cells, float minRadiusSquare, float maxRadiusSquare,
+                            float3 center, double *sums)
 {
     int gid = blockIdx.x * blockDim.x + threadIdx.x;
 
     float ur = 0.f;
+    int n = 0;
 
-    if (gid < view.size) {
-        
-        Particle p(view.particles, gid);
-        float3 r = domain.local2global(p.r);
-        r -= center;
+    if (gid < cells.size)
+    {
+        const int2 range = cells.particles(gid);
 
-        float r2 = r.x * r.x + r.y * r.y;
+        for (int pid = range.x; pid < range.y; pid++)
+        {
+            Particle p(view.particles, pid);
+            float3 r = p.r - center;
+
+            float r2 = r.x * r.x + r.y * r.y;
 
-        if (validRadius(r2, minRadiusSquare, maxRadiusSquare)) {
-            atomicAggInc(nSamples);
-            ur = r.x * p.u.x + r.y * p.u.y;
+            if (validRadius(r2, minRadiusSquare, maxRadiusSquare)) {
+                ur += r.x * p.u.x + r.y * p.u.y;
+                n++;
+            }
         }
     }
-    
+
     double urSum = warpReduce(ur, [](float a, float b) { return a+b; });
+    n = warpReduce(n, [](int a, int b) { return a+b; });
 
-    if (__laneid() == 0)
-        atomicAdd(totVel, urSum);
+    if (__laneid() == 0 && n > 0)
+    {
+        atomicAdd(sums + 0, urSum);
+        atomicAdd(sums + 1, (double) n);
+    }
 }
 
 } // namespace RadialVelocityControlKernels
 
 SimulationRadialVelocityControl::SimulationRadialVelocityControl(const YmrState *state, std::string name, std::vector<std::string> pvNames,
                                                                  float minRadius, float maxRadius, int sampleEvery, int tuneEvery, int dumpEvery,
-                                                                 float3 center, float targetVel, float Kp, float Ki, float Kd) :
+                                                                 float3 center, float targetVel, float Kp, float Ki, float Kd, bool lagged) :
     SimulationPlugin(state, name),
     pvNames(pvNames),
     minRadiusSquare(minRadius * minRadius),
@@ -83,8 +97,8 @@ SimulationRadialVelocityControl::SimulationRadialVelocityControl(const YmrState
     tuneEvery(tuneEvery),
     dumpEvery(dumpEvery), 
     force(0),
-    pid(0, Kp, Ki, Kd),
-    accumulatedTotVel(0)
+    lagged(lagged),
+    pid(0, Kp, Ki, Kd)
 {}
 
 SimulationRadialVelocityControl::~SimulationRadialVelocityControl() = default;
@@ -95,30 +109,57 @@ void SimulationRadialVelocityControl::setup(Simulation* simulation, const MPI_Co
 
     for (auto &pvName : pvNames)
         pvs.push_back(simulation->getPVbyNameOrDie(pvName));
+
+    reduction.setup(comm, defaultStream);
+
+    localCenter = state->domain.global2local(center);
+
+    regionCells.resize(pvs.size());
+    for (int i = 0; i < pvs.size(); i++)
+    {
+        regionCells[i].setupCylinder(simulation->gelCellList(pvs[i]), localCenter,
+                                     sqrtf(minRadiusSquare), sqrtf(maxRadiusSquare), defaultStream);
+
+        if (!regionCells[i].valid())
+            warn("Plugin '%s' has no primary cell-list for PV '%s' and will visit all its particles",
+                 name.c_str(), pvs[i]->name.c_str());
+    }
 }
 
 void SimulationRadialVelocityControl::beforeForces(cudaStream_t stream)
 {
-    for (auto &pv : pvs)
+    if (lagged)
+    {
+        if (reduction.test()) updateForce();
+    }
+    else if (reduction.pending())
+    {
+        reduction.wait();
+        updateForce();
+    }
+
+    for (int i = 0; i < pvs.size(); i++)
     {
-        PVview view(pv, pv->local());
+        PVview view(pvs[i], pvs[i]->local());
+        auto cells = regionCells[i].getView(view.size);
         const int nthreads = 128;
 
         SAFE_KERNEL_LAUNCH
             (RadialVelocityControlKernels::addForce,
-             getNblocks(view.size, nthreads), nthreads, 0, stream,
-             view, state->domain, minRadiusSquare, maxRadiusSquare, center, force );
+             getNblocks(cells.size, nthreads), nthreads, 0, stream,
+             view, cells, minRadiusSquare, maxRadiusSquare, localCenter, force );
     }
 }
 
-void SimulationRadialVelocityControl::sampleOnePv(ParticleVector *pv, cudaStream_t stream) {
-    PVview pvView(pv, pv->local());
+void SimulationRadialVelocityControl::sampleOnePv(int pvId, cudaStream_t stream) {
+    PVview pvView(pvs[pvId], pvs[pvId]->local());
+    auto cells = regionCells[pvId].getView(pvView.size);
     const int nthreads = 128;
  
     SAFE_KERNEL_LAUNCH
         (RadialVelocityControlKernels::sumVelocity,
-         getNblocks(pvView.size, nthreads), nthreads, 0, stream,
-         pvView, state->domain, minRadiusSquare, maxRadiusSquare, center, totVel.devPtr(), nSamples.devPtr());
+         getNblocks(cells.size, nthreads), nthreads, 0, stream,
+         pvView, cells, minRadiusSquare, maxRadiusSquare, localCenter, reduction.localDevPtr());
 }
 
 void SimulationRadialVelocityControl::afterIntegration(cudaStream_t stream)
@@ -127,30 +168,31 @@ void SimulationRadialVelocityControl::afterIntegration(cudaStream_t stream)
     {
         debug2("Velocity control %s is sampling now", name.c_str());
 
-        totVel.clearDevice(stream);
-        for (auto &pv : pvs)
-            sampleOnePv(pv, stream);
-        totVel.downloadFromDevice(stream);
-        accumulatedTotVel += totVel[0];
+        for (int i = 0; i < pvs.size(); i++)
+            sampleOnePv(i, stream);
     }
     
     if (state->currentStep % tuneEvery != 0 || state->currentStep == 0)
         return;
-    
-    nSamples.downloadFromDevice(stream);
-    nSamples.clearDevice(stream);
-    
-    long nSamples_loc, nSamples_tot = 0;
-    double totVel_tot = 0;  
 
-    nSamples_loc = nSamples[0];
-    
-    MPI_Check( MPI_Allreduce(&nSamples_loc,        &nSamples_tot, 1, MPI_LONG,   MPI_SUM, comm) );
-    MPI_Check( MPI_Allreduce(&accumulatedTotVel,   &totVel_tot,   1, MPI_DOUBLE, MPI_SUM, comm) );
+    // a lagged force may still be on its way
+    if (reduction.pending())
+    {
+        reduction.wait();
+        updateForce();
+    }
+
+    reduction.start(stream);
+}
+
+void SimulationRadialVelocityControl::updateForce()
+{
+    const auto& sums = reduction.result();
+    const double totVel_tot   = sums[0];
+    const double nSamples_tot = sums[1];
 
-    currentVel = nSamples_tot ? totVel_tot / nSamples_tot : 0.f;
+    currentVel = nSamples_tot > 0 ? totVel_tot / nSamples_tot : 0.f;
     force = pid.update(targetVel - currentVel);
-    accumulatedTotVel = 0;
 }
 
 void SimulationRadialVelocityControl::serializeAndSend(cudaStream_t stream)
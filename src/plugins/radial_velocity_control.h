@@ -1,7 +1,9 @@
 #pragma once
 
 #include "interface.h"
+#include "utils/deferred_allreduce.h"
 #include "utils/pid.h"
+#include "utils/region_cells.h"
 
 #include <core/containers.h>
 #include <core/datatypes.h>
@@ -15,7 +17,7 @@ class SimulationRadialVelocityControl : public SimulationPlugin
 public:
     SimulationRadialVelocityControl(const YmrState *state, std::string name, std::vector<std::string> pvNames,
                                     float minRadius, float maxRadius, int sampleEvery, int tuneEvery, int dumpEvery,
-                                    float3 center, float targetVel, float Kp, float Ki, float Kd);
+                                    float3 center, float targetVel, float Kp, float Ki, float Kd, bool lagged = false);
 
     ~SimulationRadialVelocityControl();
     
@@ -34,18 +36,22 @@ private:
 
     float currentVel, targetVel, force;
     float minRadiusSquare, maxRadiusSquare;
-    float3 center;
+    float3 center, localCenter;
 
-    PinnedBuffer<int> nSamples{1};
-    PinnedBuffer<double> totVel{1};
-    double accumulatedTotVel;
-    
+    bool lagged;
+
+    /// sum of the radial velocities and number of samples since the last tuning, see SimulationVelocityControl
+    DeferredAllreduce reduction{2};
+
+    /// cells of the primary cell-list of each pv intersecting the cylindrical shell
+    std::vector<RegionCells> regionCells;
 
     PidControl<float> pid;
     std::vector<char> sendBuffer;
 
 private:
-    void sampleOnePv(ParticleVector *pv, cudaStream_t stream);
+    void sampleOnePv(int pvId, cudaStream_t stream);
+    void updateForce();
 };
 
 class PostprocessRadialVelocityControl : public PostprocessPlugin
@@ -0,0 +1,252 @@
+#include "sampling_pipeline.h"
+
+#include <core/logger.h>
+#include <core/pvs/particle_vector.h>
+#include <core/pvs/views/pv.h>
+#include <core/utils/cuda_common.h>
+#include <core/utils/kernel_launch.h>
+
+#include <extern/cub/cub/block/block_reduce.cuh>
+
+namespace SamplingPipelineKernels
+{
+using Quantity  = SamplingReducer::Quantity;
+using Operation = SamplingReducer::Operation;
+
+const int nthreads = 128;
+using BlockReduce = cub::BlockReduce<float, nthreads>;
+
+__device__ inline void readQuantity(const SamplingReducer& red, const PVview& view,
+                                    int pid, const Particle& p, float *v)
+{
+    switch (red.quantity)
+    {
+    case Quantity::Ones:
+        v[0] = 1.0f;
+        break;
+
+    case Quantity::Velocity:
+        v[0] = p.u.x; v[1] = p.u.y; v[2] = p.u.z;
+        break;
+
+    case Quantity::Momentum:
+        v[0] = view.mass * p.u.x; v[1] = view.mass * p.u.y; v[2] = view.mass * p.u.z;
+        break;
+
+    case Quantity::KineticEnergy:
+        v[0] = 0.5f * view.mass * dot(p.u, p.u);
+        break;
+
+    case Quantity::Speed:
+        v[0] = length(p.u);
+        break;
+
+    case Quantity::Force:
+    {
+        const float3 f = make_float3(view.forces[pid]);
+        v[0] = f.x; v[1] = f.y; v[2] = f.z;
+        break;
+    }
+
+    case Quantity::Pressure:
+    {
+        const Stress s = ((const Stress*) red.data)[pid];
+        v[0] = (s.xx + s.yy + s.zz) / 3.0f;
+        break;
+    }
+
+    case Quantity::Channel:
+        for (int c = 0; c < red.nComponents; c++)
+            v[c] = red.data[red.stride * pid + c];
+        break;
+    }
+}
+
+__device__ inline int getBin(const SamplingReducer& red, float3 r)
+{
+    int3 b = make_int3( floorf((r - red.shift - red.lo) * red.invBinSize) );
+
+    if (red.periodic) b = (b % red.nBins + red.nBins) % red.nBins;
+    else              b = min( red.nBins - 1, max(make_int3(0), b) );
+
+    return (b.z * red.nBins.y + b.y) * red.nBins.x + b.x;
+}
+
+/**
+ * One thread per particle. All the threads of a block take part to the reductions,
+ * which issue one atomic per block and per component
+ */
+__global__ void fusedSample(PVview view, int nReducers, const SamplingReducer *reducers)
+{
+    __shared__ typename BlockReduce::TempStorage tmp;
+
+    const int pid = blockIdx.x * blockDim.x + threadIdx.x;
+    const bool valid = pid < view.size;
+
+    Particle p;
+    if (valid) p = Particle(view.particles, pid);
+
+    for (int i = 0; i < nReducers; i++)
+    {
+        const SamplingReducer& red = reducers[i];
+
+        float v[SamplingReducer::maxComponents] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+        const bool sampled = valid && (!red.useRegion || red.region(p.r) > 0);
+
+        if (sampled)
+            readQuantity(red, view, pid, p, v);
+
+        // the operation is the same for the whole block, so are the barriers
+        if (red.operation == Operation::Sum)
+        {
+            for (int c = 0; c < red.nComponents; c++)
+            {
+                const float s = BlockReduce(tmp).Sum(v[c]);
+                if (threadIdx.x == 0)
+                    atomicAdd((double*)red.output + c, (double)s);
+                __syncthreads();
+            }
+        }
+
+        if (red.operation == Operation::Max)
+        {
+            const float m = BlockReduce(tmp).Reduce(v[0], cub::Max());
+            // non-negative doubles compare like their bits
+            if (threadIdx.x == 0)
+                atomicMax((unsigned long long*)red.output, (unsigned long long) __double_as_longlong((double)m));
+            __syncthreads();
+        }
+
+        if (red.operation == Operation::Binned && sampled)
+        {
+            const int bin = getBin(red, p.r);
+            for (int c = 0; c < red.nComponents; c++)
+                if (red.doublePrecision)
+                    atomicAdd((double*)red.output + red.nComponents * bin + c, (double)v[c]);
+                else
+                    atomicAdd((float*)red.output + red.nComponents * bin + c, v[c]);
+        }
+    }
+}
+} // namespace SamplingPipelineKernels
+
+static int getNcomponents(SamplingReducer::Quantity quantity)
+{
+    using Quantity = SamplingReducer::Quantity;
+
+    if (quantity == Quantity::Velocity || quantity == Quantity::Momentum || quantity == Quantity::Force)
+        return 3;
+    return 1;
+}
+
+SamplingReducer SamplingReducer::sum(Quantity quantity, double *output)
+{
+    SamplingReducer red;
+    red.quantity    = quantity;
+    red.operation   = Operation::Sum;
+    red.nComponents = getNcomponents(quantity);
+    red.output      = output;
+    return red;
+}
+
+SamplingReducer SamplingReducer::max(Quantity quantity, double *output)
+{
+    if (getNcomponents(quantity) != 1)
+        die("Only scalar quantities can be reduced with a maximum");
+
+    SamplingReducer red;
+    red.quantity  = quantity;
+    red.operation = Operation::Max;
+    red.output    = output;
+    return red;
+}
+
+SamplingReducer SamplingReducer::binned(Quantity quantity, void *output, float3 binSize, float3 domainSize)
+{
+    SamplingReducer red;
+    red.quantity    = quantity;
+    red.operation   = Operation::Binned;
+    red.nComponents = getNcomponents(quantity);
+    red.output      = output;
+
+    // same bins as CellListInfo
+    red.nBins      = make_int3( ceilf(domainSize / binSize - 1e-6f) );
+    red.invBinSize = 1.0f / binSize;
+    red.lo         = -0.5f * domainSize;
+    return red;
+}
+
+SamplingReducer SamplingReducer::binnedChannel(const float *data, int stride, int nComponents,
+                                               void *output, float3 binSize, float3 domainSize)
+{
+    if (nComponents > maxComponents)
+        die("Channels of at most %d components can be sampled, got %d", maxComponents, nComponents);
+
+    auto red = binned(Quantity::Channel, output, binSize, domainSize);
+    red.data        = data;
+    red.stride      = stride;
+    red.nComponents = nComponents;
+    return red;
+}
+
+SamplingPipeline::SamplingPipeline() = default;
+SamplingPipeline::~SamplingPipeline() = default;
+
+void SamplingPipeline::add(ParticleVector *pv, const SamplingReducer& reducer)
+{
+    for (int i = 0; i < pvs.size(); i++)
+        if (pvs[i] == pv)
+        {
+            requests[i].push_back(reducer);
+            return;
+        }
+
+    pvs.push_back(pv);
+    requests.push_back({reducer});
+}
+
+void SamplingPipeline::onCompletion(std::function<void(cudaStream_t)> callback)
+{
+    callbacks.push_back(callback);
+}
+
+void SamplingPipeline::run(cudaStream_t stream)
+{
+    int total = 0;
+    for (auto& r : requests) total += r.size();
+
+    if (total > 0)
+    {
+        reducers.resize_anew(total);
+
+        int offset = 0;
+        for (auto& r : requests)
+            for (auto& red : r)
+                reducers[offset++] = red;
+
+        reducers.uploadToDevice(stream);
+
+        offset = 0;
+        for (int i = 0; i < pvs.size(); i++)
+        {
+            PVview view(pvs[i], pvs[i]->local());
+            const int nthreads = SamplingPipelineKernels::nthreads;
+
+            debug2("Sampling pv '%s' with %d reducers", pvs[i]->name.c_str(), (int) requests[i].size());
+
+            SAFE_KERNEL_LAUNCH(
+                SamplingPipelineKernels::fusedSample,
+                getNblocks(view.size, nthreads), nthreads, 0, stream,
+                view, (int) requests[i].size(), reducers.devPtr() + offset );
+
+            offset += requests[i].size();
+        }
+    }
+
+    for (auto& callback : callbacks)
+        callback(stream);
+
+    pvs.clear();
+    requests.clear();
+    callbacks.clear();
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <core/containers.h>
+#include <core/field/interface.h>
+
+#include <cuda_runtime.h>
+#include <functional>
+#include <vector>
+
+class ParticleVector;
+
+/**
+ * One per-particle reduction requested by a plugin, see SamplingPipeline.
+ * Plain data, such that the reducers of all the plugins are read by one kernel
+ */
+struct SamplingReducer
+{
+    static const int maxComponents = 6;
+
+    /// what is read for every particle
+    enum class Quantity
+    {
+        Ones, Velocity, Momentum, KineticEnergy, Speed, Force,
+        Pressure, ///< trace of the stresses in data, divided by 3
+        Channel   ///< nComponents floats of data, every stride floats
+    };
+
+    /// how it is reduced over the particles
+    enum class Operation
+    {
+        Sum,   ///< into nComponents doubles
+        Max,   ///< into one double, the values must be non-negative
+        Binned ///< summed into nComponents floats (or doubles) per bin
+    };
+
+    Quantity quantity;
+    Operation operation;
+    int nComponents {1};
+
+    const float *data {nullptr};
+    int stride {0};
+
+    void *output {nullptr};
+
+    /// Binned: bins of size 1/invBinSize from lo, the particles go to the bin of (r - shift),
+    /// clamped or wrapped around if periodic
+    float3 lo, invBinSize;
+    int3 nBins;
+    float3 shift {0.0f, 0.0f, 0.0f};
+    bool periodic {false};
+
+    /// Binned: the output is nComponents doubles per bin
+    bool doublePrecision {false};
+
+    /// only sample the particles where region is positive
+    bool useRegion {false};
+    FieldDeviceHandler region;
+
+    static SamplingReducer sum(Quantity quantity, double *output);
+    static SamplingReducer max(Quantity quantity, double *output);
+
+    /// bins of size \p binSize covering [-domainSize/2, domainSize/2]
+    /// the output has nComponents floats per bin, or doubles with doublePrecision
+    static SamplingReducer binned(Quantity quantity, void *output, float3 binSize, float3 domainSize);
+
+    /// same with a Channel of \p nComponents floats every \p stride floats
+    static SamplingReducer binnedChannel(const float *data, int stride, int nComponents,
+                                         void *output, float3 binSize, float3 domainSize);
+};
+
+/**
+ * Shared per-particle sampling of the plugins.
+ *
+ * Instead of launching their own kernel over all the particles of a particle vector,
+ * the plugins add() reducers during their afterIntegration() hook. Simulation then
+ * calls run() once all the hooks are done: it launches one kernel per particle vector
+ * which reads every particle once and applies all its reducers, then calls the
+ * completion callbacks of the plugins, e.g. to download or accumulate the results.
+ * The reducers must point to data that stays valid until run(), and their outputs
+ * must be cleared by the plugins
+ */
+class SamplingPipeline
+{
+public:
+    SamplingPipeline();
+    ~SamplingPipeline();
+
+    /// sample \p pv with \p reducer in the next run()
+    void add(ParticleVector *pv, const SamplingReducer& reducer);
+
+    /// call \p callback on the stream of the next run(), after all the reducers
+    void onCompletion(std::function<void(cudaStream_t)> callback);
+
+    /// fused sampling of the requests added since the last run
+    void run(cudaStream_t stream);
+
+private:
+    std::vector<ParticleVector*> pvs;
+    std::vector<std::vector<SamplingReducer>> requests;
+    std::vector<std::function<void(cudaStream_t)>> callbacks;
+
+    PinnedBuffer<SamplingReducer> reducers;
+};
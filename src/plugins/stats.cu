@@ -1,53 +1,22 @@
 #include "stats.h"
+#include "sampling_pipeline.h"
 #include "utils/simple_serializer.h"
 
 #include <core/datatypes.h>
 #include <core/pvs/particle_vector.h>
-#include <core/pvs/views/pv.h>
 #include <core/simulation.h>
 #include <core/utils/cuda_common.h>
-#include <core/utils/kernel_launch.h>
 
-namespace StatsKernels
-{
-using Stats::ReductionType;
-
-__global__ void totalMomentumEnergy(PVview view, ReductionType *momentum, ReductionType *energy, float* maxvel)
-{
-    int tid = blockIdx.x * blockDim.x + threadIdx.x;
-
-    float3 vel, myMomentum;
-    float myEnergy = 0.f, myMaxIvelI;
-    vel = myMomentum = make_float3(0.f);
-
-    if (tid < view.size)
-    {
-        vel        = make_float3(view.particles[2*tid+1]);
-        myMomentum = vel * view.mass;
-        myEnergy   = dot(vel, vel) * view.mass * 0.5f;
-    }
-    
-    myMomentum = warpReduce(myMomentum, [](float a, float b) { return a+b; });
-    myEnergy   = warpReduce(myEnergy,   [](float a, float b) { return a+b; });
-    
-    myMaxIvelI = warpReduce(length(vel), [](float a, float b) { return max(a, b); });
+#include <algorithm>
+#include <cmath>
 
-    if (__laneid() == 0)
-    {
-        atomicAdd(momentum+0, (ReductionType)myMomentum.x);
-        atomicAdd(momentum+1, (ReductionType)myMomentum.y);
-        atomicAdd(momentum+2, (ReductionType)myMomentum.z);
-        atomicAdd(energy,     (ReductionType)myEnergy);
-
-        atomicMax((int*)maxvel, __float_as_int(myMaxIvelI));
-    }
-}
-} // namespace StatsKernels
-    
-SimulationStats::SimulationStats(const YmrState *state, std::string name, int fetchEvery) :
+SimulationStats::SimulationStats(const YmrState *state, std::string name, int fetchEvery, int samplesPerMessage) :
     SimulationPlugin(state, name),
-    fetchEvery(fetchEvery)
+    fetchEvery(fetchEvery),
+    samples(Stats::nSampleComponents, samplesPerMessage)
 {
+    static_assert(sizeof(Stats::DeviceSample) == Stats::nSampleComponents * sizeof(double),
+                  "the samples must be made of doubles");
     timer.start();
 }
 
@@ -57,58 +26,96 @@ void SimulationStats::setup(Simulation *simulation, const MPI_Comm& comm, const
 {
     SimulationPlugin::setup(simulation, comm, interComm);
     pvs = simulation->getParticleVectors();
+    pipeline = simulation->getSamplingPipeline();
 }
 
 void SimulationStats::afterIntegration(cudaStream_t stream)
 {
     if (state->currentStep % fetchEvery != 0) return;
 
-    momentum.clear(stream);
-    energy  .clear(stream);
-    maxvel  .clear(stream);
+    auto devSample = (Stats::DeviceSample*) samples.nextSample(stream);
+
+    using Quantity = SamplingReducer::Quantity;
 
-    nparticles = 0;
+    int n = 0;
     for (auto& pv : pvs)
     {
-        PVview view(pv, pv->local());
-
-        SAFE_KERNEL_LAUNCH(
-                StatsKernels::totalMomentumEnergy,
-                getNblocks(view.size, 128), 128, 0, stream,
-                view, momentum.devPtr(), energy.devPtr(), maxvel.devPtr() );
+        pipeline->add(pv, SamplingReducer::sum(Quantity::Momentum,       devSample->momentum));
+        pipeline->add(pv, SamplingReducer::sum(Quantity::KineticEnergy, &devSample->energy));
+        pipeline->add(pv, SamplingReducer::max(Quantity::Speed,         &devSample->maxvel));
 
-        nparticles += view.size;
+        n += pv->local()->size();
     }
 
-    momentum.downloadFromDevice(stream, ContainersSynch::Asynch);
-    energy  .downloadFromDevice(stream, ContainersSynch::Asynch);
-    maxvel  .downloadFromDevice(stream);
+    realTimes .push_back(timer.elapsedAndReset() / (state->currentStep < fetchEvery ? 1.0f : fetchEvery));
+    steps     .push_back(state->currentStep);
+    nparticles.push_back(n);
 
-    needToDump = true;
+    const TimeType time = state->currentTime;
+    pipeline->onCompletion([this, time] (cudaStream_t stream) {
+        samples.commit(time);
+        needToDump = samples.full();
+    });
 }
 
 void SimulationStats::serializeAndSend(cudaStream_t stream)
 {
-    if (needToDump)
+    if (!needToDump) return;
+
+    std::vector<TimeType> times;
+    std::vector<double> values;
+    samples.download(stream, times, values);
+
+    waitPrevSend();
+    SimpleSerializer::serialize(sendBuffer, realTimes, times, steps, nparticles, values);
+    send(sendBuffer);
+
+    realTimes .clear();
+    steps     .clear();
+    nparticles.clear();
+    needToDump = false;
+}
+
+SimulationPlugin::HookPeriod SimulationStats::getHookPeriod(Hook hook) const
+{
+    switch (hook)
     {
-        float tm = timer.elapsedAndReset() / (state->currentStep < fetchEvery ? 1.0f : fetchEvery);
-        waitPrevSend();
-        SimpleSerializer::serialize(sendBuffer, tm, state->currentTime, state->currentStep, nparticles, momentum, energy, maxvel);
-        send(sendBuffer);
-        needToDump = false;
+        case Hook::AfterIntegration:  return {fetchEvery, 0};
+        case Hook::SerializeSend:     return {1, 0};
+        default:                      return {0, 0};
     }
 }
 
-PostprocessStats::PostprocessStats(std::string name, std::string filename) :
-        PostprocessPlugin(name)
+/// everything the ranks reduce, in one call
+struct ReducedStats
 {
-    if (std::is_same<Stats::ReductionType, float>::value)
-        mpiReductionType = MPI_FLOAT;
-    else if (std::is_same<Stats::ReductionType, double>::value)
-        mpiReductionType = MPI_DOUBLE;
-    else
-        die("Incompatible type");
+    Stats::ReductionType momentum[3], energy, maxvel;
+    float realTime;
+    int nparticles, minNparticles, maxNparticles;
+};
+
+static void reduceStats(void *in, void *inout, int *len, MPI_Datatype *type)
+{
+    auto a = (const ReducedStats*) in;
+    auto b = (ReducedStats*) inout;
+
+    for (int i = 0; i < *len; i++)
+    {
+        for (int c = 0; c < 3; c++)
+            b[i].momentum[c] += a[i].momentum[c];
+        b[i].energy        += a[i].energy;
+        b[i].maxvel         = std::max(a[i].maxvel,   b[i].maxvel);
+        b[i].realTime       = std::max(a[i].realTime, b[i].realTime);
+        b[i].nparticles    += a[i].nparticles;
+        b[i].minNparticles  = std::min(a[i].minNparticles, b[i].minNparticles);
+        b[i].maxNparticles  = std::max(a[i].maxNparticles, b[i].maxNparticles);
+    }
+}
 
+PostprocessStats::PostprocessStats(std::string name, std::string filename, bool windowStatistics) :
+        PostprocessPlugin(name),
+        windowStatistics(windowStatistics)
+{
     if (filename != "")
     {
         fdump = fopen(filename.c_str(), "w");
@@ -120,52 +127,106 @@ PostprocessStats::PostprocessStats(std::string name, std::string filename) :
 PostprocessStats::~PostprocessStats()
 {
     if (fdump != nullptr) fclose(fdump);
+
+    int finalized;
+    MPI_Check( MPI_Finalized(&finalized) );
+
+    if (!finalized && mpiReducedType != MPI_DATATYPE_NULL)
+    {
+        MPI_Check( MPI_Type_free(&mpiReducedType) );
+        MPI_Check( MPI_Op_free(&mpiReduceOp) );
+    }
+}
+
+void PostprocessStats::setup(const MPI_Comm& comm, const MPI_Comm& interComm)
+{
+    PostprocessPlugin::setup(comm, interComm);
+
+    MPI_Check( MPI_Type_contiguous(sizeof(ReducedStats), MPI_BYTE, &mpiReducedType) );
+    MPI_Check( MPI_Type_commit(&mpiReducedType) );
+    MPI_Check( MPI_Op_create(reduceStats, 1, &mpiReduceOp) );
+}
+
+void PostprocessStats::printSummary(const std::vector<TimeType>& times, const std::vector<int>& steps,
+                                    WindowStatistics& window)
+{
+    // components of the window: temperature, momentum, max velocity, time per step
+    printf("Stats of %d samples, timesteps %d to %d (simulation time %f to %f):\n",
+           window.size(), steps.front(), steps.back(), times.front(), times.back());
+    printf("\tOne timestep takes %.2f ms on average\n", window.mean(5));
+    printf("\tAverage momentum: [%e %e %e] +- [%e %e %e]\n",
+           window.mean(1), window.mean(2), window.mean(3),
+           sqrt(window.variance(1)), sqrt(window.variance(2)), sqrt(window.variance(3)));
+    printf("\tMax velocity magnitude: %f\n", window.max(4));
+    printf("\tTemperature: %.4f +- %.4f, min %.4f, max %.4f\n\n",
+           window.mean(0), sqrt(window.variance(0)), window.min(0), window.max(0));
 }
 
 void PostprocessStats::deserialize(MPI_Status& stat)
 {
-    TimeType currentTime;
-    float realTime;
-    int nparticles, currentTimeStep;
-    int maxNparticles, minNparticles;
+    std::vector<float> realTimes;
+    std::vector<TimeType> times;
+    std::vector<int> steps, nparticles;
+    std::vector<double> values;
+
+    SimpleSerializer::deserialize(data, realTimes, times, steps, nparticles, values);
 
-    std::vector<Stats::ReductionType> momentum, energy;
-    std::vector<float> maxvel;
+    const int nSamples = times.size();
+    std::vector<ReducedStats> local(nSamples), global(nSamples);
 
-    SimpleSerializer::deserialize(data, realTime, currentTime, currentTimeStep, nparticles, momentum, energy, maxvel);
+    for (int i = 0; i < nSamples; i++)
+    {
+        auto sample = (const Stats::DeviceSample*) values.data() + i;
+
+        for (int c = 0; c < 3; c++)
+            local[i].momentum[c] = sample->momentum[c];
+        local[i].energy        = sample->energy;
+        local[i].maxvel        = sample->maxvel;
+        local[i].realTime      = realTimes[i];
+        local[i].nparticles    = nparticles[i];
+        local[i].minNparticles = nparticles[i];
+        local[i].maxNparticles = nparticles[i];
+    }
 
-    MPI_Check( MPI_Reduce(&nparticles, &minNparticles, 1, MPI_INT, MPI_MIN, 0, comm) );
-    MPI_Check( MPI_Reduce(&nparticles, &maxNparticles, 1, MPI_INT, MPI_MAX, 0, comm) );
-    
-    MPI_Check( MPI_Reduce(rank == 0 ? MPI_IN_PLACE : &nparticles,     &nparticles,     1, MPI_INT,          MPI_SUM, 0, comm) );
-    MPI_Check( MPI_Reduce(rank == 0 ? MPI_IN_PLACE : energy.data(),   energy.data(),   1, mpiReductionType, MPI_SUM, 0, comm) );
-    MPI_Check( MPI_Reduce(rank == 0 ? MPI_IN_PLACE : momentum.data(), momentum.data(), 3, mpiReductionType, MPI_SUM, 0, comm) );
+    MPI_Check( MPI_Reduce(local.data(), global.data(), nSamples, mpiReducedType, mpiReduceOp, 0, comm) );
 
-    MPI_Check( MPI_Reduce(rank == 0 ? MPI_IN_PLACE : maxvel.data(),   maxvel.data(),   1, MPI_FLOAT,        MPI_MAX, 0, comm) );
+    if (rank != 0) return;
 
-    MPI_Check( MPI_Reduce(rank == 0 ? MPI_IN_PLACE : &realTime,       &realTime,       1, MPI_FLOAT,        MPI_MAX, 0, comm) );
+    WindowStatistics window(6);
 
-    if (rank == 0)
+    for (int i = 0; i < nSamples; i++)
     {
-        momentum[0] /= (double)nparticles;
-        momentum[1] /= (double)nparticles;
-        momentum[2] /= (double)nparticles;
-        const Stats::ReductionType temperature = energy[0] / ( (3/2.0)*nparticles );
-
-        printf("Stats at timestep %d (simulation time %f):\n", currentTimeStep, currentTime);
-        printf("\tOne timestep takes %.2f ms", realTime);
-        printf("\tNumber of particles (total, min/proc, max/proc): %d,  %d,  %d\n", nparticles, minNparticles, maxNparticles);
-        printf("\tAverage momentum: [%e %e %e]\n", momentum[0], momentum[1], momentum[2]);
-        printf("\tMax velocity magnitude: %f\n", maxvel[0]);
-        printf("\tTemperature: %.4f\n\n", temperature);
+        const auto& g = global[i];
 
-        if (fdump != nullptr)
+        Stats::ReductionType momentum[3];
+        for (int c = 0; c < 3; c++)
+            momentum[c] = g.momentum[c] / (double)g.nparticles;
+        const Stats::ReductionType temperature = g.energy / ( (3/2.0)*g.nparticles );
+
+        if (windowStatistics)
         {
-            fprintf(fdump, "%g %g %g %g %g %g %g\n", currentTime,
-                    temperature, momentum[0], momentum[1], momentum[2], maxvel[0], realTime);
-            fflush(fdump);
+            const double components[] = {temperature, momentum[0], momentum[1], momentum[2], g.maxvel, g.realTime};
+            window.add(components);
         }
+        else
+        {
+            printf("Stats at timestep %d (simulation time %f):\n", steps[i], times[i]);
+            printf("\tOne timestep takes %.2f ms", g.realTime);
+            printf("\tNumber of particles (total, min/proc, max/proc): %d,  %d,  %d\n",
+                   g.nparticles, g.minNparticles, g.maxNparticles);
+            printf("\tAverage momentum: [%e %e %e]\n", momentum[0], momentum[1], momentum[2]);
+            printf("\tMax velocity magnitude: %f\n", g.maxvel);
+            printf("\tTemperature: %.4f\n\n", temperature);
+        }
+
+        if (fdump != nullptr)
+            fprintf(fdump, "%g %g %g %g %g %g %g\n", times[i],
+                    temperature, momentum[0], momentum[1], momentum[2], g.maxvel, g.realTime);
     }
-}
 
+    if (windowStatistics && nSamples > 0)
+        printSummary(times, steps, window);
 
+    if (fdump != nullptr)
+        fflush(fdump);
+}
@@ -1,27 +1,39 @@
 #pragma once
 
 #include <plugins/interface.h>
+#include <plugins/utils/time_series.h>
 #include <core/containers.h>
 #include <core/datatypes.h>
 #include <core/utils/timer.h>
 
 class ParticleVector;
+class SamplingPipeline;
 
 namespace Stats
 {
 using ReductionType = double;
+
+/// all the reductions of a sample, computed by the SamplingPipeline into a TimeSeriesBuffer slot
+struct DeviceSample
+{
+    ReductionType momentum[3], energy, maxvel;
+};
+
+const int nSampleComponents = sizeof(DeviceSample) / sizeof(double);
 }
 
 class SimulationStats : public SimulationPlugin
 {
 public:
-    SimulationStats(const YmrState *state, std::string name, int fetchEvery);
+    /// the samples are sent by groups of \p samplesPerMessage
+    SimulationStats(const YmrState *state, std::string name, int fetchEvery, int samplesPerMessage = 1);
     ~SimulationStats();
 
     void setup(Simulation *simulation, const MPI_Comm& comm, const MPI_Comm& interComm) override;
     
     void afterIntegration(cudaStream_t stream) override;
     void serializeAndSend(cudaStream_t stream) override;
+    HookPeriod getHookPeriod(Hook hook) const override;
 
     bool needPostproc() override { return true; }
 
@@ -29,12 +41,13 @@ private:
     int fetchEvery;
     bool needToDump{false};
 
-    int nparticles;
-    PinnedBuffer<Stats::ReductionType> momentum{3}, energy{1};
-    PinnedBuffer<float> maxvel{1};
+    TimeSeriesBuffer samples;
+    std::vector<float> realTimes;
+    std::vector<int> steps, nparticles;
     std::vector<char> sendBuffer;
 
     std::vector<ParticleVector*> pvs;
+    SamplingPipeline *pipeline;
 
     mTimer timer;
 };
@@ -42,12 +55,20 @@ private:
 class PostprocessStats : public PostprocessPlugin
 {
 private:
-    MPI_Datatype mpiReductionType;
+    /// packed struct of all the reduced values and its reduction, such that the ranks reduce once per sample
+    MPI_Datatype mpiReducedType {MPI_DATATYPE_NULL};
+    MPI_Op mpiReduceOp {MPI_OP_NULL};
     FILE *fdump = nullptr;
 
+    /// report a summary of every message instead of all its samples
+    bool windowStatistics;
+
+    void printSummary(const std::vector<TimeType>& times, const std::vector<int>& steps, WindowStatistics& window);
+
 public:
-    PostprocessStats(std::string name, std::string filename = "");
+    PostprocessStats(std::string name, std::string filename = "", bool windowStatistics = false);
     ~PostprocessStats();
 
+    void setup(const MPI_Comm& comm, const MPI_Comm& interComm) override;
     void deserialize(MPI_Status& stat) override;
 };
@@ -0,0 +1,324 @@
+#include "tracer_correlator.h"
+#include "utils/simple_serializer.h"
+
+#include <core/pvs/particle_vector.h>
+#include <core/pvs/views/pv.h>
+#include <core/simulation.h>
+#include <core/utils/cuda_common.h>
+#include <core/utils/folders.h>
+#include <core/utils/kernel_launch.h>
+
+#include <algorithm>
+
+namespace TracerCorrelatorKernels
+{
+
+__global__ void saveOrigins(PVview view, float4 *origins)
+{
+    const int i = threadIdx.x + blockIdx.x * blockDim.x;
+    if (i >= view.size) return;
+
+    Particle p;
+    p.readCoordinate(view.particles, i);
+    origins[i] = p.r2Float4();
+}
+
+__global__ void gatherTracers(PVview view, const float4 *origins, int stride, int nTracers, double *samples)
+{
+    const int i = threadIdx.x + blockIdx.x * blockDim.x;
+    if (i >= view.size) return;
+
+    Particle p;
+    p.readCoordinate(view.particles, i);
+
+    if (p.isMarked() || p.i1 < 0 || p.i1 % stride != 0) return;
+
+    const int slot = p.i1 / stride;
+    if (slot >= nTracers) return;
+
+    p.readVelocity(view.particles, i);
+    const float3 dr = p.r - make_float3(origins[i]);
+
+    double *s = samples + TracerCorrelatorPlugin::sampleSize * slot;
+    s[0] = dr.x;  s[1] = dr.y;  s[2] = dr.z;
+    s[3] = p.u.x; s[4] = p.u.y; s[5] = p.u.z;
+    s[6] = 1.0;
+}
+
+/// what changes between two samples: the levels receiving a new value and their number of values so far
+struct Update
+{
+    int nUpdated;
+    int inserted[TracerCorrelatorPlugin::maxLevels];
+};
+
+/**
+ * One thread per tracer of this rank. Pushes the new sample in the level 0 and
+ * the averages of the completed blocks in the next levels, then correlates the new values
+ * with the history of their level. The lags of a level l > 0 below blockSize / averaging
+ * are already covered more finely by the level l-1
+ */
+__global__ void correlate(int nLocalSlots, int rank, int nranks, const double *samples,
+                          int blockSize, int nLevels, int averaging, Update update,
+                          float3 *history, float3 *sums,
+                          double *msd, double *vacf, double *counts)
+{
+    const int k = threadIdx.x + blockIdx.x * blockDim.x;
+    if (k >= nLocalSlots) return;
+
+    const double *s = samples + TracerCorrelatorPlugin::sampleSize * (rank + k * nranks);
+    if (s[6] == 0.0) return;
+
+    float3 r = make_float3(s[0], s[1], s[2]);
+    float3 u = make_float3(s[3], s[4], s[5]);
+
+    float3 *myHistory = history + 2 * k * nLevels * blockSize;
+    float3 *mySums    = sums    + 2 * k * nLevels;
+
+    for (int l = 0; l < update.nUpdated; l++)
+    {
+        if (l > 0)
+        {
+            r = mySums[2*(l-1) + 0] / averaging;
+            u = mySums[2*(l-1) + 1] / averaging;
+            mySums[2*(l-1) + 0] = make_float3(0.0f);
+            mySums[2*(l-1) + 1] = make_float3(0.0f);
+        }
+
+        float3 *level = myHistory + 2 * l * blockSize;
+        const int n = update.inserted[l];
+
+        const int head = n % blockSize;
+        level[2*head + 0] = r;
+        level[2*head + 1] = u;
+
+        const int first = l == 0 ? 0 : blockSize / averaging;
+        const int last  = min(n, blockSize - 1);
+
+        for (int j = first; j <= last; j++)
+        {
+            const int id = (n - j) % blockSize;
+            const float3 dr = r - level[2*id + 0];
+
+            const int bin = l * blockSize + j;
+            atomicAdd(msd    + bin, (double) dot(dr, dr));
+            atomicAdd(vacf   + bin, (double) dot(u, level[2*id + 1]));
+            atomicAdd(counts + bin, 1.0);
+        }
+
+        mySums[2*l + 0] += r;
+        mySums[2*l + 1] += u;
+    }
+}
+
+} // namespace TracerCorrelatorKernels
+
+TracerCorrelatorPlugin::TracerCorrelatorPlugin(const YmrState *state, std::string name, std::string pvName,
+                                               int nTracers, int stride, int sampleEvery, int dumpEvery,
+                                               int blockSize, int nLevels, int averaging) :
+    SimulationPlugin(state, name),
+    pvName(pvName),
+    nTracers(nTracers),
+    stride(stride),
+    sampleEvery(sampleEvery),
+    dumpEvery(dumpEvery),
+    blockSize(blockSize),
+    nLevels(nLevels),
+    averaging(averaging),
+    samples(sampleSize * nTracers)
+{
+    if (nTracers < 1 || stride < 1)
+        die("Plugin '%s' needs at least one tracer and a positive stride, got %d and %d", name.c_str(), nTracers, stride);
+
+    if (nLevels < 1 || nLevels > maxLevels)
+        die("Plugin '%s' supports 1 to %d levels, got %d", name.c_str(), maxLevels, nLevels);
+
+    if (averaging < 2 || blockSize < averaging || blockSize % averaging != 0)
+        die("Plugin '%s': the block size (%d) must be a multiple of the averaging (%d), itself at least 2",
+            name.c_str(), blockSize, averaging);
+}
+
+TracerCorrelatorPlugin::~TracerCorrelatorPlugin() = default;
+
+void TracerCorrelatorPlugin::setup(Simulation *simulation, const MPI_Comm& comm, const MPI_Comm& interComm)
+{
+    SimulationPlugin::setup(simulation, comm, interComm);
+
+    pv = simulation->getPVbyNameOrDie(pvName);
+
+    pv->requireDataPerParticle<float4>(originChannelName,
+                                       ExtraDataManager::PersistenceMode::Persistent,
+                                       sizeof(float4::x));
+
+    PVview view(pv, pv->local());
+    const int nthreads = 128;
+
+    SAFE_KERNEL_LAUNCH(
+            TracerCorrelatorKernels::saveOrigins,
+            getNblocks(view.size, nthreads), nthreads, 0, defaultStream,
+            view, pv->local()->extraPerParticle.getData<float4>(originChannelName)->devPtr() );
+
+    nLocalSlots = rank < nTracers ? (nTracers - rank + nranks - 1) / nranks : 0;
+
+    inserted   .assign(nLevels, 0);
+    accumulated.assign(nLevels, 0);
+
+    samples.setup(comm, defaultStream);
+    globalSamples.resize_anew(sampleSize * nTracers);
+
+    history.resize_anew(2 * nLocalSlots * nLevels * blockSize);
+    sums   .resize_anew(2 * nLocalSlots * nLevels);
+    sums   .clear(defaultStream);
+
+    correlations.resize_anew(3 * nLevels * blockSize);
+    correlations.clear(defaultStream);
+
+    info("Plugin '%s' correlates %d tracers of '%s', %d on this rank", name.c_str(), nTracers, pvName.c_str(), nLocalSlots);
+}
+
+void TracerCorrelatorPlugin::handshake()
+{
+    const float sampleDt = sampleEvery * state->dt;
+    SimpleSerializer::serialize(sendBuffer, pvName, sampleDt, blockSize, nLevels, averaging);
+    send(sendBuffer);
+}
+
+void TracerCorrelatorPlugin::correlate(cudaStream_t stream)
+{
+    const auto& global = samples.result();
+    std::copy(global.begin(), global.end(), globalSamples.hostPtr());
+    globalSamples.uploadToDevice(stream);
+
+    TracerCorrelatorKernels::Update update;
+    update.nUpdated = 1;
+    for (int l = 0; l < nLevels; l++)
+    {
+        update.inserted[l] = inserted[l];
+
+        if (l >= update.nUpdated) continue;
+
+        // the average of the level goes up when it has collected enough values
+        if (++accumulated[l] == averaging && l + 1 < nLevels)
+        {
+            accumulated[l] = 0;
+            update.nUpdated++;
+        }
+    }
+
+    const int nthreads = 128;
+    const int nBins = nLevels * blockSize;
+
+    SAFE_KERNEL_LAUNCH(
+            TracerCorrelatorKernels::correlate,
+            getNblocks(nLocalSlots, nthreads), nthreads, 0, stream,
+            nLocalSlots, rank, nranks, globalSamples.devPtr(),
+            blockSize, nLevels, averaging, update,
+            history.devPtr(), sums.devPtr(),
+            correlations.devPtr(), correlations.devPtr() + nBins, correlations.devPtr() + 2*nBins );
+
+    for (int l = 0; l < update.nUpdated; l++)
+        inserted[l]++;
+}
+
+void TracerCorrelatorPlugin::afterIntegration(cudaStream_t stream)
+{
+    if (state->currentStep % sampleEvery != 0) return;
+
+    // the previous sample is correlated once its reduction is done, one sample later
+    if (samples.pending())
+    {
+        samples.wait();
+        correlate(stream);
+    }
+
+    PVview view(pv, pv->local());
+    const int nthreads = 128;
+
+    SAFE_KERNEL_LAUNCH(
+            TracerCorrelatorKernels::gatherTracers,
+            getNblocks(view.size, nthreads), nthreads, 0, stream,
+            view, pv->local()->extraPerParticle.getData<float4>(originChannelName)->devPtr(),
+            stride, nTracers, samples.localDevPtr() );
+
+    samples.start(stream);
+
+    if (state->currentStep % dumpEvery == 0 && state->currentStep != 0)
+    {
+        correlations.downloadFromDevice(stream, ContainersSynch::Synch);
+        needToSend = true;
+    }
+}
+
+void TracerCorrelatorPlugin::serializeAndSend(cudaStream_t stream)
+{
+    if (!needToSend) return;
+
+    debug2("Plugin %s is sending now data", name.c_str());
+
+    waitPrevSend();
+    SimpleSerializer::serialize(sendBuffer, state->currentTime, correlations);
+    send(sendBuffer);
+
+    needToSend = false;
+}
+
+//=================================================================================
+
+TracerCorrelatorDumper::TracerCorrelatorDumper(std::string name, std::string path) :
+    PostprocessPlugin(name),
+    path(path)
+{}
+
+TracerCorrelatorDumper::~TracerCorrelatorDumper() = default;
+
+void TracerCorrelatorDumper::setup(const MPI_Comm& comm, const MPI_Comm& interComm)
+{
+    PostprocessPlugin::setup(comm, interComm);
+    activated = createFoldersCollective(comm, path);
+}
+
+void TracerCorrelatorDumper::handshake()
+{
+    auto req = waitData();
+    MPI_Check( MPI_Wait(&req, MPI_STATUS_IGNORE) );
+    recv();
+
+    std::string pvName;
+    SimpleSerializer::deserialize(data, pvName, sampleDt, blockSize, nLevels, averaging);
+
+    fname = path + "/" + pvName + "_correlations.txt";
+}
+
+void TracerCorrelatorDumper::deserialize(MPI_Status& stat)
+{
+    TimeType curTime;
+    std::vector<double> local;
+
+    SimpleSerializer::deserialize(data, curTime, local);
+
+    correlations.resize(local.size());
+    MPI_Check( MPI_Reduce(local.data(), correlations.data(), local.size(), MPI_DOUBLE, MPI_SUM, 0, comm) );
+
+    if (!activated || rank != 0) return;
+
+    // the whole table is rewritten: the correlations are accumulated from the start
+    FILE *fout = fopen(fname.c_str(), "w");
+    if (!fout) die("Could not open file '%s'", fname.c_str());
+
+    fprintf(fout, "# time %g\n# lag msd vacf samples\n", curTime);
+
+    const int nBins = nLevels * blockSize;
+    int scale = 1;
+    for (int l = 0; l < nLevels; l++, scale *= averaging)
+        for (int j = 0; j < blockSize; j++)
+        {
+            const int bin = l * blockSize + j;
+            const double n = correlations[2*nBins + bin];
+            if (n == 0.0) continue;
+
+            fprintf(fout, "%g %.6e %.6e %.0f\n", (double) sampleDt * scale * j,
+                    correlations[bin] / n, correlations[nBins + bin] / n, n);
+        }
+
+    fclose(fout);
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "interface.h"
+#include "utils/deferred_allreduce.h"
+
+#include <core/containers.h>
+
+#include <string>
+#include <vector>
+
+class ParticleVector;
+
+/**
+ * Mean square displacement and velocity autocorrelation of a subset of tracer particles,
+ * computed on the device with a multiple-tau correlator.
+ *
+ * The tracers are the particles of global ids 0, stride, 2*stride, ... below nTracers*stride.
+ * Their displacements are unwrapped with a persistent channel of the positions at setup,
+ * shifted with the particles when they change rank or wrap around the periodic domain.
+ * Every sampleEvery steps the positions and velocities of the tracers are gathered over
+ * the ranks, each rank then correlates its share of the tracers.
+ *
+ * The correlator has nLevels levels of blockSize lags: level l samples the averages of
+ * averaging^l successive samples, such that the lags span blockSize * averaging^(nLevels-1) samples.
+ * Only the accumulated correlations are sent to the postprocess, every dumpEvery steps
+ */
+class TracerCorrelatorPlugin : public SimulationPlugin
+{
+public:
+    TracerCorrelatorPlugin(const YmrState *state, std::string name, std::string pvName,
+                           int nTracers, int stride, int sampleEvery, int dumpEvery,
+                           int blockSize, int nLevels, int averaging);
+
+    ~TracerCorrelatorPlugin();
+
+    void setup(Simulation *simulation, const MPI_Comm& comm, const MPI_Comm& interComm) override;
+    void handshake() override;
+
+    void afterIntegration(cudaStream_t stream) override;
+    void serializeAndSend(cudaStream_t stream) override;
+
+    bool needPostproc() override { return true; }
+
+    static const int maxLevels = 16;
+
+    /// per tracer: (displacement, velocity, present)
+    static const int sampleSize = 7;
+
+private:
+    std::string pvName;
+    ParticleVector *pv;
+
+    int nTracers, stride, sampleEvery, dumpEvery;
+    int blockSize, nLevels, averaging;
+
+    int nLocalSlots;                   ///< tracers correlated by this rank: rank, rank + nranks, ...
+    std::vector<int> inserted, accumulated;
+
+    DeferredAllreduce samples;         ///< of all the tracers, summed over the ranks
+    PinnedBuffer<double> globalSamples;
+
+    DeviceBuffer<float3> history, sums;
+    PinnedBuffer<double> correlations; ///< msd, vacf and counts per lag
+
+    bool needToSend {false};
+    std::vector<char> sendBuffer;
+
+    const std::string originChannelName = "tracer_origins";
+
+    void correlate(cudaStream_t stream);
+};
+
+
+class TracerCorrelatorDumper : public PostprocessPlugin
+{
+public:
+    TracerCorrelatorDumper(std::string name, std::string path);
+    ~TracerCorrelatorDumper();
+
+    void setup(const MPI_Comm& comm, const MPI_Comm& interComm) override;
+    void handshake() override;
+    void deserialize(MPI_Status& stat) override;
+
+private:
+    std::string path, fname;
+    bool activated {true};
+
+    float sampleDt;
+    int blockSize, nLevels, averaging;
+    std::vector<double> correlations;
+};
@@ -0,0 +1,94 @@
+#include "deferred_allreduce.h"
+
+#include <core/logger.h>
+#include <core/utils/cuda_common.h>
+
+DeferredAllreduce::DeferredAllreduce(int n) :
+    local(n),
+    global(n, 0.0)
+{}
+
+DeferredAllreduce::~DeferredAllreduce()
+{
+    if (copied != nullptr)
+        CUDA_Check( cudaEventDestroy(copied) );
+}
+
+void DeferredAllreduce::setup(MPI_Comm comm, cudaStream_t stream)
+{
+    this->comm = comm;
+    CUDA_Check( cudaEventCreateWithFlags(&copied, cudaEventDisableTiming) );
+    local.clear(stream);
+}
+
+double* DeferredAllreduce::localDevPtr()
+{
+    return local.devPtr();
+}
+
+void DeferredAllreduce::start(cudaStream_t stream)
+{
+    if (stage != Stage::Idle)
+        die("Deferred reduction started while the previous one is not completed");
+
+    local.downloadFromDevice(stream, ContainersSynch::Asynch);
+    local.clearDevice(stream);
+    CUDA_Check( cudaEventRecord(copied, stream) );
+
+    stage = Stage::Copying;
+}
+
+bool DeferredAllreduce::pending() const
+{
+    return stage != Stage::Idle;
+}
+
+void DeferredAllreduce::startReduction()
+{
+    MPI_Check( MPI_Iallreduce(local.hostPtr(), global.data(), global.size(), MPI_DOUBLE, MPI_SUM, comm, &request) );
+    stage = Stage::Reducing;
+}
+
+bool DeferredAllreduce::test()
+{
+    if (stage == Stage::Copying)
+    {
+        const cudaError_t status = cudaEventQuery(copied);
+        if (status == cudaErrorNotReady) return false;
+        CUDA_Check( status );
+
+        startReduction();
+    }
+
+    if (stage == Stage::Reducing)
+    {
+        int done = 0;
+        MPI_Check( MPI_Test(&request, &done, MPI_STATUS_IGNORE) );
+        if (!done) return false;
+
+        stage = Stage::Idle;
+        return true;
+    }
+
+    return false;
+}
+
+void DeferredAllreduce::wait()
+{
+    if (stage == Stage::Copying)
+    {
+        CUDA_Check( cudaEventSynchronize(copied) );
+        startReduction();
+    }
+
+    if (stage == Stage::Reducing)
+    {
+        MPI_Check( MPI_Wait(&request, MPI_STATUS_IGNORE) );
+        stage = Stage::Idle;
+    }
+}
+
+const std::vector<double>& DeferredAllreduce::result() const
+{
+    return global;
+}
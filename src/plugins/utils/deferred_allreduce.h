@@ -0,0 +1,66 @@
+#pragma once
+
+#include <core/containers.h>
+
+#include <cuda_runtime.h>
+#include <mpi.h>
+#include <vector>
+
+/**
+ * Sum over the ranks of a few values accumulated on the device, without synchronizing the stream.
+ *
+ * The kernels of a plugin add their local contributions to localDevPtr().
+ * start() enqueues the copy of these values to the host and their reset on the device;
+ * the MPI reduction is started as soon as the copy is done, and the global sums are
+ * given by result() once test() or wait() completed it. The host is thus only blocked
+ * in wait(), which may be called as late as the sums are needed
+ */
+class DeferredAllreduce
+{
+public:
+    DeferredAllreduce(int n);
+    ~DeferredAllreduce();
+
+    DeferredAllreduce(const DeferredAllreduce&) = delete;
+    DeferredAllreduce& operator=(const DeferredAllreduce&) = delete;
+
+    void setup(MPI_Comm comm, cudaStream_t stream);
+
+    /// device values accumulated by the kernels, cleared by start()
+    double* localDevPtr();
+
+    /**
+     * copy the local values after the work enqueued so far on \p stream, and reset them;
+     * the previous reduction must be completed
+     */
+    void start(cudaStream_t stream);
+
+    /// a reduction was started and its result was not yet consumed by test() or wait()
+    bool pending() const;
+
+    /**
+     * make progress without blocking
+     * @return true once, when the sums of the last start() have just become available
+     */
+    bool test();
+
+    /// block until the sums of the last start() are available
+    void wait();
+
+    /// the global sums of the last completed reduction
+    const std::vector<double>& result() const;
+
+private:
+    enum class Stage { Idle, Copying, Reducing };
+
+    Stage stage {Stage::Idle};
+
+    PinnedBuffer<double> local;
+    std::vector<double> global;
+
+    MPI_Comm comm {MPI_COMM_NULL};
+    MPI_Request request {MPI_REQUEST_NULL};
+    cudaEvent_t copied {nullptr};
+
+    void startReduction();
+};
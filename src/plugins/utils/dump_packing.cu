@@ -0,0 +1,274 @@
+#include "dump_packing.h"
+
+#include <core/logger.h>
+#include <core/utils/cuda_common.h>
+#include <core/utils/kernel_launch.h>
+
+#include <extern/cub/cub/device/device_scan.cuh>
+
+#include <stdexcept>
+
+namespace DumpPackingKernels
+{
+
+/// uniform in [0, 1), same result for the same id whatever the rank or the step
+__device__ inline float hashToUnit(int id)
+{
+    unsigned int x = id;
+    x ^= x >> 16;  x *= 0x7feb352du;
+    x ^= x >> 15;  x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x * (1.0f / 4294967296.0f);
+}
+
+__global__ void selectParticles(int n, int decimation, DumpFilter filter, float3 shift, const float4 *coosvels,
+                                int objSize, const int *objIds, int *flags)
+{
+    const int pid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (pid >= n) return;
+
+    const Particle p(coosvels, pid);
+    bool keep = (pid % decimation == 0);
+
+    switch (filter.type)
+    {
+    case DumpFilter::Type::All:
+        break;
+
+    case DumpFilter::Type::Random:
+        keep = keep && hashToUnit(p.i1) < filter.fraction;
+        break;
+
+    case DumpFilter::Type::Region:
+    {
+        const float3 r = p.r + shift;
+        keep = keep &&
+            filter.lo.x <= r.x && r.x < filter.hi.x &&
+            filter.lo.y <= r.y && r.y < filter.hi.y &&
+            filter.lo.z <= r.z && r.z < filter.hi.z;
+        break;
+    }
+
+    case DumpFilter::Type::Speed:
+        keep = keep && dot(p.u, p.u) >= filter.minSpeed * filter.minSpeed;
+        break;
+
+    case DumpFilter::Type::Objects:
+        keep = keep && hashToUnit(objIds[pid / objSize]) < filter.fraction;
+        break;
+    }
+
+    flags[pid] = keep ? 1 : 0;
+}
+
+__global__ void scatterSelected(int n, const int *flags, const int *starts, int *selected)
+{
+    const int pid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (pid >= n) return;
+
+    if (flags[pid]) selected[starts[pid]] = pid;
+}
+
+/// One thread per word of the packed elements, \p selection may be null
+__global__ void packField(int nPacked, const int *selection, int decimation, int words, int shiftMask, float3 shift,
+                          const int *src, int *dst)
+{
+    const int tid = blockIdx.x * blockDim.x + threadIdx.x;
+    const int i = tid / words;
+    const int w = tid % words;
+    if (i >= nPacked) return;
+
+    const int srcId = selection ? selection[i] : i * decimation;
+    int v = src[srcId * words + w];
+
+    if ((shiftMask >> (w / 3)) & 1)
+    {
+        const int c = w % 3;
+        const float s = c == 0 ? shift.x : (c == 1 ? shift.y : shift.z);
+        v = __float_as_int(__int_as_float(v) + s);
+    }
+
+    dst[i * words + w] = v;
+}
+
+} // namespace DumpPackingKernels
+
+DumpFilter stringToDumpFilter(std::string str)
+{
+    DumpFilter filter;
+
+    auto pos = str.find(':');
+    std::string type  = str.substr(0, pos);
+    std::string param = pos == std::string::npos ? "" : str.substr(pos+1);
+
+    auto parseFraction = [&] () {
+        if (param != "") filter.fraction = std::stof(param);
+        if (filter.fraction <= 0.0f || filter.fraction > 1.0f)
+            die("Dump filter fraction must be within (0, 1], got %g", filter.fraction);
+    };
+
+    try
+    {
+        if (type == "all" || type == "")
+        {
+            filter.type = DumpFilter::Type::All;
+        }
+        else if (type == "random")
+        {
+            filter.type = DumpFilter::Type::Random;
+            parseFraction();
+        }
+        else if (type == "objects")
+        {
+            filter.type = DumpFilter::Type::Objects;
+            parseFraction();
+        }
+        else if (type == "speed")
+        {
+            filter.type = DumpFilter::Type::Speed;
+            filter.minSpeed = std::stof(param);
+        }
+        else if (type == "region")
+        {
+            float v[6];
+            size_t start = 0;
+            for (int i = 0; i < 6; i++)
+            {
+                size_t end = param.find(',', start);
+                if ((end == std::string::npos) != (i == 5))
+                    die("Dump filter region needs 6 coordinates, got '%s'", param.c_str());
+
+                v[i] = std::stof(param.substr(start, end - start));
+                start = end + 1;
+            }
+
+            filter.type = DumpFilter::Type::Region;
+            filter.lo = make_float3(v[0], v[1], v[2]);
+            filter.hi = make_float3(v[3], v[4], v[5]);
+        }
+        else
+            die("Unknown dump filter '%s', expected 'all', 'random:fraction', 'region:x0,y0,z0,x1,y1,z1', "
+                "'speed:min' or 'objects:fraction'", str.c_str());
+    }
+    catch (const std::logic_error&)
+    {
+        die("Could not parse the parameter of the dump filter '%s'", str.c_str());
+    }
+
+    return filter;
+}
+
+void DumpPacker::pack(const DomainInfo& domain, const std::vector<Field>& fields, int decimation, cudaStream_t stream)
+{
+    if (decimation < 1)
+        die("Dump decimation must be positive, got %d", decimation);
+
+    const int n = fields.empty() ? 0 : fields[0].container->size();
+    _pack(domain, fields, nullptr, (n + decimation - 1) / decimation, decimation, stream);
+}
+
+void DumpPacker::pack(const DomainInfo& domain, const std::vector<Field>& fields, const DumpFilter& filter, int decimation,
+                      cudaStream_t stream, int objSize, const int *objIds)
+{
+    if (filter.type == DumpFilter::Type::All)
+    {
+        pack(domain, fields, decimation, stream);
+        return;
+    }
+
+    if (decimation < 1)
+        die("Dump decimation must be positive, got %d", decimation);
+    if (filter.type == DumpFilter::Type::Objects && (objSize <= 0 || objIds == nullptr))
+        die("Dump filter 'objects' can only be used with object vectors");
+
+    auto particles = fields[0].container;
+    if (particles->datatype_size() != sizeof(Particle))
+        die("The first field of a filtered dump must be the particles");
+
+    const int n = particles->size();
+    const int nthreads = 128;
+    const float3 shift = domain.local2global(make_float3(0.0f));
+
+    flags.resize_anew(n + 1);
+    starts.resize_anew(n + 1);
+    selected.resize_anew(n);
+    flags.clear(stream);
+
+    SAFE_KERNEL_LAUNCH(
+            DumpPackingKernels::selectParticles,
+            getNblocks(n, nthreads), nthreads, 0, stream,
+            n, decimation, filter, shift, (const float4*) particles->genericDevPtr(),
+            objSize, objIds, flags.devPtr() );
+
+    size_t bufSize = 0;
+    cub::DeviceScan::ExclusiveSum(nullptr, bufSize, flags.devPtr(), starts.devPtr(), n + 1, stream);
+    scanBuffer.resize_anew(bufSize);
+    cub::DeviceScan::ExclusiveSum(scanBuffer.devPtr(), bufSize, flags.devPtr(), starts.devPtr(), n + 1, stream);
+
+    SAFE_KERNEL_LAUNCH(
+            DumpPackingKernels::scatterSelected,
+            getNblocks(n, nthreads), nthreads, 0, stream,
+            n, flags.devPtr(), starts.devPtr(), selected.devPtr() );
+
+    // the number of the selected particles sizes the packed buffer
+    CUDA_Check( cudaMemcpyAsync(starts.hostPtr() + n, starts.devPtr() + n, sizeof(int), cudaMemcpyDeviceToHost, stream) );
+    CUDA_Check( cudaStreamSynchronize(stream) );
+    const int nSelected = starts[n];
+
+    debug2("Dump filter kept %d particles out of %d", nSelected, n);
+
+    _pack(domain, fields, selected.devPtr(), nSelected, 1, stream);
+}
+
+/// pack the \p nElements elements given by \p selection, or every \p decimation-th element without it
+void DumpPacker::_pack(const DomainInfo& domain, const std::vector<Field>& fields, const int *selection, int nElements,
+                       int decimation, cudaStream_t stream)
+{
+    nPacked = nElements;
+    const int n = fields.empty() ? 0 : fields[0].container->size();
+
+    offsets.resize(fields.size());
+    words  .resize(fields.size());
+
+    int total = 0;
+    for (int f = 0; f < fields.size(); f++)
+    {
+        auto container = fields[f].container;
+
+        if (container->size() != n)
+            die("Dump fields must have the same size, got %d and %d", n, container->size());
+        if (container->datatype_size() % sizeof(int) != 0)
+            die("Dump fields must be made of 4-bytes words, got elements of %d bytes", container->datatype_size());
+
+        offsets[f] = total;
+        words[f] = container->datatype_size() / sizeof(int);
+        total += nPacked * words[f];
+    }
+
+    buffer.resize_anew(total);
+
+    const float3 shift = domain.local2global(make_float3(0.0f));
+    const int nthreads = 128;
+
+    for (int f = 0; f < fields.size(); f++)
+    {
+        const int nWords = nPacked * words[f];
+        if (nWords == 0) continue;
+
+        SAFE_KERNEL_LAUNCH(
+                DumpPackingKernels::packField,
+                getNblocks(nWords, nthreads), nthreads, 0, stream,
+                nPacked, selection, decimation, words[f], fields[f].shiftMask, shift,
+                (const int*) fields[f].container->genericDevPtr(), buffer.devPtr() + offsets[f] );
+    }
+
+    buffer.downloadFromDevice(stream, ContainersSynch::Asynch);
+}
+
+std::vector<std::pair<const void*, int>> DumpPacker::chunks() const
+{
+    std::vector<std::pair<const void*, int>> result;
+    for (int f = 0; f < offsets.size(); f++)
+        result.push_back({buffer.hostPtr() + offsets[f], (int) (nPacked * words[f] * sizeof(int))});
+    return result;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <core/containers.h>
+#include <core/datatypes.h>
+#include <core/domain.h>
+
+#include <cuda_runtime.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+/// Reduction of the particles of a dump, applied on the device before packing, see stringToDumpFilter()
+struct DumpFilter
+{
+    enum class Type
+    {
+        All,      ///< keep all the particles
+        Random,   ///< deterministic random subset, by hash of the particle ids
+        Region,   ///< particles inside a box
+        Speed,    ///< particles faster than a threshold
+        Objects   ///< deterministic random subset of whole objects, by hash of the object ids
+    };
+
+    Type type{Type::All};
+    float fraction{1.0f};        ///< Random, Objects: kept fraction
+    float3 lo{0, 0, 0};          ///< Region: box in global coordinates
+    float3 hi{0, 0, 0};
+    float minSpeed{0.0f};        ///< Speed
+};
+
+/// parse "all", "random:fraction", "region:x0,y0,z0,x1,y1,z1", "speed:min" or "objects:fraction"
+DumpFilter stringToDumpFilter(std::string str);
+
+/**
+ * Packs the data of a dump on the device before downloading it.
+ *
+ * All the fields (e.g. the particles and their channels) are copied into one
+ * device buffer, one after the other, keeping only every decimation-th element.
+ * The float3 given by the shift mask of a field are transformed to global
+ * coordinates on the way, such that the host gets the data ready to be sent
+ * with a single download and no loop over the elements
+ */
+class DumpPacker
+{
+public:
+    struct Field
+    {
+        const GPUcontainer *container;
+        int shiftMask;  ///< bit k: the float3 at the 4-bytes word 3k of the elements is a position
+    };
+
+    /// shift masks of the position fields
+    static const int particleShift = 1;        ///< Particle::r
+    static const int comExtentShift = 7;       ///< LocalObjectVector::COMandExtent com, low and high
+
+    /**
+     * Pack the \p fields, all of the same size, on \p stream and start the download.
+     * The host data is ready once the stream is synchronized
+     */
+    void pack(const DomainInfo& domain, const std::vector<Field>& fields, int decimation, cudaStream_t stream);
+
+    /**
+     * Same, keeping only the elements selected by \p filter among every \p decimation-th.
+     * The first field must be the particles.
+     * Filter DumpFilter::Type::Objects needs the size and the global ids of the
+     * (local) objects, on the device; it keeps or drops the objects as a whole
+     */
+    void pack(const DomainInfo& domain, const std::vector<Field>& fields, const DumpFilter& filter, int decimation,
+              cudaStream_t stream, int objSize = 0, const int *objIds = nullptr);
+
+    /// number of elements of each packed field
+    int size() const { return nPacked; }
+
+    /// host copy of the field \p id
+    template<typename T>
+    const T* field(int id) const
+    {
+        return (const T*) (buffer.hostPtr() + offsets[id]);
+    }
+
+    /// [pointer, size in bytes] of each field on the host, see SimulationPlugin::send()
+    std::vector<std::pair<const void*, int>> chunks() const;
+
+private:
+    int nPacked{0};
+    std::vector<int> offsets, words;
+    PinnedBuffer<int> buffer;
+
+    DeviceBuffer<int> flags, selected;
+    PinnedBuffer<int> starts;
+    DeviceBuffer<char> scanBuffer;
+
+    void _pack(const DomainInfo& domain, const std::vector<Field>& fields, const int *selection, int nElements,
+               int decimation, cudaStream_t stream);
+};
@@ -0,0 +1,124 @@
+#include "output_backend.h"
+#include "simple_serializer.h"
+
+#include <core/logger.h>
+#include <core/utils/make_unique.h>
+
+#include <fstream>
+
+FileOutputBackend::FileOutputBackend(int nSubfiles) :
+    nSubfiles(nSubfiles)
+{}
+
+void FileOutputBackend::write(std::string fname, const XDMF::Grid *grid, const std::vector<XDMF::Channel>& channels,
+                              TimeType time, MPI_Comm comm)
+{
+    XDMF::write(fname, grid, channels, time, comm, nSubfiles);
+}
+
+
+
+StreamOutputBackend::StreamOutputBackend(std::string portFile) :
+    portFile(portFile)
+{}
+
+StreamOutputBackend::~StreamOutputBackend()
+{
+    if (remote == MPI_COMM_NULL) return;
+
+    std::string end;
+    SimpleSerializer::serialize(buffer, end);
+    _send();
+
+    MPI_Check( MPI_Comm_disconnect(&remote) );
+}
+
+void StreamOutputBackend::_connect(MPI_Comm comm)
+{
+    int rank;
+    MPI_Check( MPI_Comm_rank(comm, &rank) );
+
+    std::vector<char> portName(MPI_MAX_PORT_NAME, '\0');
+    if (rank == 0)
+    {
+        std::ifstream fin(portFile);
+        std::string name;
+        if (!std::getline(fin, name) || name.empty())
+            die("Could not read the MPI port name of the analysis job from '%s'", portFile.c_str());
+
+        name.copy(portName.data(), MPI_MAX_PORT_NAME - 1);
+    }
+
+    info("Connecting to the analysis job on port '%s'", rank == 0 ? portName.data() : "");
+    MPI_Check( MPI_Comm_connect(portName.data(), MPI_INFO_NULL, 0, comm, &remote) );
+}
+
+void StreamOutputBackend::_send()
+{
+    int rank, remoteSize;
+    MPI_Check( MPI_Comm_rank(remote, &rank) );
+    MPI_Check( MPI_Comm_remote_size(remote, &remoteSize) );
+
+    MPI_Check( MPI_Send(buffer.data(), buffer.size(), MPI_BYTE, rank % remoteSize, streamTag, remote) );
+}
+
+static std::vector<long long> toLongLong(const std::vector<hsize_t>& v)
+{
+    return std::vector<long long>(v.begin(), v.end());
+}
+
+void StreamOutputBackend::write(std::string fname, const XDMF::Grid *grid, const std::vector<XDMF::Channel>& channels,
+                                TimeType time, MPI_Comm comm)
+{
+    if (remote == MPI_COMM_NULL)
+        _connect(comm);
+
+    auto dims = grid->getGridDims();
+    long long n = 1;
+    for (auto d : dims->getLocalSize()) n *= d;
+
+    std::vector<float> positions;
+    if (auto vertexGrid = dynamic_cast<const XDMF::VertexGrid*>(grid))
+        positions = *vertexGrid->getPositions();
+
+    std::vector<std::string> names;
+    std::vector<int> nComponents;
+    std::vector<std::vector<char>> data;
+
+    for (auto& channel : channels)
+    {
+        const char *ptr = (const char*) channel.data;
+        names      .push_back(channel.name);
+        nComponents.push_back(channel.nComponents());
+        data       .push_back(std::vector<char>(ptr, ptr + n * channel.nComponents() * channel.precision()));
+    }
+
+    SimpleSerializer::serialize(buffer, fname, time,
+                                toLongLong(dims->getLocalSize()), toLongLong(dims->getGlobalSize()), toLongLong(dims->getOffsets()),
+                                positions, names, nComponents, data);
+
+    debug2("Streaming dump '%s' to the analysis job (%d bytes)", fname.c_str(), (int) buffer.size());
+    _send();
+}
+
+
+
+std::unique_ptr<OutputBackend> createOutputBackend(std::string desc, int nSubfiles)
+{
+    auto pos = desc.find(':');
+    std::string type  = desc.substr(0, pos);
+    std::string param = pos == std::string::npos ? "" : desc.substr(pos+1);
+
+    if (type == "file" || type == "")
+        return std::make_unique<FileOutputBackend>(nSubfiles);
+
+    if (type == "stream")
+    {
+        if (param == "")
+            die("Output backend 'stream' needs the file with the MPI port name: 'stream:<port file>'");
+        return std::make_unique<StreamOutputBackend>(param);
+    }
+
+    die("Unknown output backend '%s', expected 'file' or 'stream:<port file>'", desc.c_str());
+    return nullptr;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <core/xdmf/xdmf.h>
+#include <core/ymero_state.h>
+
+#include <memory>
+#include <mpi.h>
+#include <string>
+#include <vector>
+
+/**
+ * Destination of the data of the postprocess dumpers.
+ *
+ * FileOutputBackend writes XDMF files (the default). StreamOutputBackend sends
+ * every dump in flight to a separate analysis job, which decides what to keep:
+ * nothing goes to the disk.
+ */
+class OutputBackend
+{
+public:
+    virtual ~OutputBackend() = default;
+
+    /// collective on \p comm, \p fname is the name of the dump without extension
+    virtual void write(std::string fname, const XDMF::Grid *grid, const std::vector<XDMF::Channel>& channels,
+                       TimeType time, MPI_Comm comm) = 0;
+
+    /// whether the dumps end up in files, i.e. the folders of the dumps are needed
+    virtual bool writesFiles() const = 0;
+};
+
+class FileOutputBackend : public OutputBackend
+{
+public:
+    /// \p nSubfiles: see XDMF::write()
+    FileOutputBackend(int nSubfiles = 0);
+
+    void write(std::string fname, const XDMF::Grid *grid, const std::vector<XDMF::Channel>& channels,
+               TimeType time, MPI_Comm comm) override;
+
+    bool writesFiles() const override { return true; }
+
+private:
+    int nSubfiles;
+};
+
+/**
+ * Streams the dumps to an analysis job over an MPI port.
+ *
+ * The analysis job opens a port (MPI_Open_port), writes its name to \p portFile and
+ * calls MPI_Comm_accept; the dumper connects at the first dump. Rank i of the dumper
+ * then sends each dump to the remote rank i % remoteSize, with tag streamTag,
+ * as one message serialized with SimpleSerializer:
+ * fname, time, local size, global size and offsets of the grid (std::vector<long long>),
+ * positions (std::vector<float>, empty if the grid has no vertices), channel names,
+ * channel number of components (std::vector<int>) and channel data (std::vector<std::vector<char>>).
+ * An empty fname ends the stream, before the dumper disconnects
+ */
+class StreamOutputBackend : public OutputBackend
+{
+public:
+    static const int streamTag = 4242;
+
+    StreamOutputBackend(std::string portFile);
+    ~StreamOutputBackend();
+
+    void write(std::string fname, const XDMF::Grid *grid, const std::vector<XDMF::Channel>& channels,
+               TimeType time, MPI_Comm comm) override;
+
+    bool writesFiles() const override { return false; }
+
+private:
+    std::string portFile;
+    MPI_Comm remote{MPI_COMM_NULL};
+    std::vector<char> buffer;
+
+    void _connect(MPI_Comm comm);
+    void _send();
+};
+
+/// parse "file" or "stream:<port file>"
+std::unique_ptr<OutputBackend> createOutputBackend(std::string desc, int nSubfiles = 0);
@@ -0,0 +1,120 @@
+#include "region_cells.h"
+
+#include <core/celllist.h>
+#include <core/logger.h>
+#include <core/utils/cuda_common.h>
+#include <core/utils/kernel_launch.h>
+
+namespace RegionCellsKernels
+{
+
+struct Box
+{
+    float3 low, high;
+
+    __device__ inline bool intersects(float3 botCell, float3 topCell) const
+    {
+        return low.x <= topCell.x && botCell.x <= high.x &&
+               low.y <= topCell.y && botCell.y <= high.y &&
+               low.z <= topCell.z && botCell.z <= high.z;
+    }
+};
+
+struct Cylinder
+{
+    float3 center;
+    float minR, maxR;
+
+    __device__ inline bool intersects(float3 botCell, float3 topCell) const
+    {
+        // closest and farthest points of the cell to the axis, in the xy plane
+        const float2 bot = make_float2(botCell.x - center.x, botCell.y - center.y);
+        const float2 top = make_float2(topCell.x - center.x, topCell.y - center.y);
+
+        const float2 closest  = make_float2( fmaxf(bot.x, fminf(0.0f, top.x)),
+                                             fmaxf(bot.y, fminf(0.0f, top.y)) );
+        const float2 farthest = make_float2( fmaxf(fabsf(bot.x), fabsf(top.x)),
+                                             fmaxf(fabsf(bot.y), fabsf(top.y)) );
+
+        return length(closest) <= maxR && length(farthest) >= minR;
+    }
+};
+
+template<bool QUERY, typename Region>
+__global__ void getRelevantCells(CellListInfo cinfo, Region region, int *relevantCells, int *nRelevantCells)
+{
+    const int cid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (cid >= cinfo.totcells) return;
+
+    int3 ind;
+    cinfo.decode(cid, ind.x, ind.y, ind.z);
+
+    // one cell of margin on each side
+    float3 botCell = -0.5f*cinfo.localDomainSize + make_float3(ind - 1)*cinfo.h;
+    float3 topCell = botCell + 3.0f*cinfo.h;
+
+    if (region.intersects(botCell, topCell))
+    {
+        int id = atomicAggInc(nRelevantCells);
+        if (!QUERY) relevantCells[id] = cid;
+    }
+}
+
+} // namespace RegionCellsKernels
+
+template<typename Region>
+void RegionCells::setup(CellList *cl, Region region, cudaStream_t stream)
+{
+    this->cl = dynamic_cast<PrimaryCellList*>(cl);
+    nCells = 0;
+
+    if (!valid()) return;
+
+    const int nthreads = 128;
+
+    nRelevantCells.clearDevice(stream);
+    SAFE_KERNEL_LAUNCH(
+            RegionCellsKernels::getRelevantCells<true>,
+            getNblocks(cl->totcells, nthreads), nthreads, 0, stream,
+            cl->cellInfo(), region, relevantCells.devPtr(), nRelevantCells.devPtr() );
+
+    nRelevantCells.downloadFromDevice(stream);
+    relevantCells.resize_anew(nRelevantCells[0]);
+    nRelevantCells.clearDevice(stream);
+
+    SAFE_KERNEL_LAUNCH(
+            RegionCellsKernels::getRelevantCells<false>,
+            getNblocks(cl->totcells, nthreads), nthreads, 0, stream,
+            cl->cellInfo(), region, relevantCells.devPtr(), nRelevantCells.devPtr() );
+
+    nRelevantCells.downloadFromDevice(stream);
+    nCells = nRelevantCells[0];
+
+    debug("%d out of %d cells intersect the region", nCells, cl->totcells);
+}
+
+void RegionCells::setupBox(CellList *cl, float3 low, float3 high, cudaStream_t stream)
+{
+    setup(cl, RegionCellsKernels::Box{low, high}, stream);
+}
+
+void RegionCells::setupCylinder(CellList *cl, float3 center, float minR, float maxR, cudaStream_t stream)
+{
+    setup(cl, RegionCellsKernels::Cylinder{center, minR, maxR}, stream);
+}
+
+RegionCellsView RegionCells::getView(int np) const
+{
+    RegionCellsView view;
+
+    if (valid())
+    {
+        view.size       = nCells;
+        view.cells      = relevantCells.devPtr();
+        view.cellStarts = cl->cellInfo().cellStarts;
+    }
+    else
+        view.size = np;
+
+    return view;
+}
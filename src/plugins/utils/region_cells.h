@@ -0,0 +1,71 @@
+#pragma once
+
+#include <core/containers.h>
+
+#include <cuda_runtime.h>
+
+class CellList;
+
+/**
+ * Particles visited by the threads of a kernel: the particles of one
+ * relevant cell per thread, or one particle per thread without cells
+ */
+struct RegionCellsView
+{
+    int size; ///< number of threads
+    const int *cells {nullptr};
+    const int *cellStarts {nullptr};
+
+    /// first and past the last particle of thread \p gid < size
+    __device__ inline int2 particles(int gid) const
+    {
+        if (cells == nullptr)
+            return make_int2(gid, gid+1);
+
+        const int cid = cells[gid];
+        return make_int2(cellStarts[cid], cellStarts[cid+1]);
+    }
+};
+
+/**
+ * Precomputed list of the cells of a cell list that intersect a region,
+ * as the relevant cells of ImposeProfilePlugin.
+ *
+ * The plugins acting on a small part of the domain only visit the particles
+ * of these cells instead of testing all of them, such that their cost scales
+ * with the size of the region. The cells are computed once, the region is
+ * grown by one cell in every direction to account for the particles which
+ * moved since the cell list was built.
+ *
+ * Only a PrimaryCellList keeps the particles of the particle vector itself
+ * sorted by cells: with any other cell list valid() is false and the plugins
+ * must visit all the particles
+ */
+class RegionCells
+{
+public:
+    /// cells of \p cl intersecting the box [low, high], in local coordinates
+    void setupBox(CellList *cl, float3 low, float3 high, cudaStream_t stream);
+
+    /// cells of \p cl intersecting minR < |r - center| < maxR in the xy plane, in local coordinates
+    void setupCylinder(CellList *cl, float3 center, float minR, float maxR, cudaStream_t stream);
+
+    bool valid() const { return cl != nullptr; }
+    CellList* cellList() const { return cl; }
+
+    int size() const { return nCells; }
+    const int* devPtr() const { return relevantCells.devPtr(); }
+
+    /// the relevant cells, or all the \p np particles if not valid()
+    RegionCellsView getView(int np) const;
+
+private:
+    CellList *cl {nullptr};
+    int nCells {0};
+
+    DeviceBuffer<int> relevantCells;
+    PinnedBuffer<int> nRelevantCells{1};
+
+    template<typename Region>
+    void setup(CellList *cl, Region region, cudaStream_t stream);
+};
@@ -11,6 +11,9 @@ struct ChannelsInfo
     Average3D::ChannelType *types;
     float **average, **data;
 
+    /// the double accumulators of the channels if the plugin samples into them directly, nullptr otherwise
+    double **accumulated;
+
     ChannelsInfo(Average3D::HostChannelsInfo& info, ParticleVector* pv, cudaStream_t stream)
     {
         for (int i=0; i<info.n; i++)
@@ -26,6 +29,7 @@ struct ChannelsInfo
         types = info.types.devPtr();
         average = info.averagePtrs.devPtr();
         data = info.dataPtrs.devPtr();
+        accumulated = info.doublePrecision ? info.accumulatedPtrs.devPtr() : nullptr;
     }
 };
 
@@ -33,27 +37,54 @@ struct ChannelsInfo
 namespace SamplingHelpersKernels
 {
 
-__device__ inline void sampleChannels(int pid, int cid, ChannelsInfo channelsInfo)
+__device__ inline int getNcomponents(Average3D::ChannelType type)
 {
-    for (int i=0; i<channelsInfo.n; i++)
-    {
-        if (channelsInfo.types[i] == Average3D::ChannelType::Scalar)
-            atomicAdd(channelsInfo.average[i] + cid, channelsInfo.data[i][pid]);
+    if (type == Average3D::ChannelType::Scalar)  return 1;
+    if (type == Average3D::ChannelType::Tensor6) return 6;
+    return 3;
+}
 
-        if (channelsInfo.types[i] == Average3D::ChannelType::Vector_float3)
-            atomicAdd(((float3*)channelsInfo.average[i]) + cid, ((float3*)channelsInfo.data[i])[pid]);
+/// add the components of the channel \p i of the particle \p pid to \p acc
+__device__ inline void addChannelValue(int i, int pid, ChannelsInfo channelsInfo, float *acc)
+{
+    const auto type = channelsInfo.types[i];
+    const float *data = channelsInfo.data[i];
 
-        if (channelsInfo.types[i] == Average3D::ChannelType::Vector_float4)
-            atomicAdd(((float3*)channelsInfo.average[i]) + cid, make_float3( ((float4*)channelsInfo.data[i])[pid] ));
+    if (type == Average3D::ChannelType::Scalar)
+        acc[0] += data[pid];
 
-        if (channelsInfo.types[i] == Average3D::ChannelType::Vector_2xfloat4)
-            atomicAdd(((float3*)channelsInfo.average[i]) + cid, make_float3( ((float4*)channelsInfo.data[i])[2*pid] ));
+    if (type == Average3D::ChannelType::Vector_float3)
+        for (int c = 0; c < 3; c++) acc[c] += data[3*pid + c];
 
-        if (channelsInfo.types[i] == Average3D::ChannelType::Tensor6)
-        {
-            atomicAdd(((float3*)channelsInfo.average[i]) + 2*cid + 0, ((float3*)channelsInfo.data[i])[2*pid + 0] );
-            atomicAdd(((float3*)channelsInfo.average[i]) + 2*cid + 1, ((float3*)channelsInfo.data[i])[2*pid + 1] );
-        }
+    if (type == Average3D::ChannelType::Vector_float4)
+        for (int c = 0; c < 3; c++) acc[c] += data[4*pid + c];
+
+    if (type == Average3D::ChannelType::Vector_2xfloat4)
+        for (int c = 0; c < 3; c++) acc[c] += data[8*pid + c];
+
+    if (type == Average3D::ChannelType::Tensor6)
+        for (int c = 0; c < 6; c++) acc[c] += data[6*pid + c];
+}
+
+/// add \p value to the component \p index of the channel \p i, in float or in double
+__device__ inline void addToChannel(ChannelsInfo channelsInfo, int i, int index, float value)
+{
+    if (channelsInfo.accumulated != nullptr)
+        atomicAdd(channelsInfo.accumulated[i] + index, (double)value);
+    else
+        atomicAdd(channelsInfo.average[i] + index, value);
+}
+
+__device__ inline void sampleChannels(int pid, int cid, ChannelsInfo channelsInfo)
+{
+    for (int i=0; i<channelsInfo.n; i++)
+    {
+        float acc[6] = {0, 0, 0, 0, 0, 0};
+        addChannelValue(i, pid, channelsInfo, acc);
+
+        const int components = getNcomponents(channelsInfo.types[i]);
+        for (int c = 0; c < components; c++)
+            addToChannel(channelsInfo, i, components * cid + c, acc[c]);
     }
 }
 
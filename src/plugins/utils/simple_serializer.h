@@ -4,6 +4,7 @@
 #include <string>
 #include <cstring>
 #include <vector>
+#include <utility>
 #include <type_traits>
 
 // Only POD types and std::vectors/HostBuffers/PinnedBuffers of POD and std::strings are supported
@@ -217,7 +218,95 @@ private:
 
     //============================================================================
 
+    /// gathered part of a message: the \p size bytes at \p ptr, or at \p offset of the header if ptr is nullptr
+    struct GatheredChunk
+    {
+        const void *ptr;
+        int offset, size;
+    };
+
+    struct Gather
+    {
+        std::vector<char>& header;
+        std::vector<GatheredChunk> chunks;
+    };
+
+    /// copy to the header, consecutive copies make one chunk
+    static void copyChunk(Gather& g, const void* data, int size)
+    {
+        if (size == 0) return;
+
+        if (g.chunks.empty() || g.chunks.back().ptr != nullptr)
+            g.chunks.push_back({nullptr, (int)g.header.size(), 0});
+
+        g.header.insert(g.header.end(), (const char*)data, (const char*)data + size);
+        g.chunks.back().size += size;
+    }
+
+    /// refer to the data in place, unless it is too small to be worth a separate chunk
+    static void referChunk(Gather& g, const void* data, int size)
+    {
+        if (size < minReferencedSize)
+            copyChunk(g, data, size);
+        else
+            g.chunks.push_back({data, 0, size});
+    }
+
+    /// Overload for the vectors of plain old data
+    template<typename Vec, EnableIfPod<ValType<Vec>> = nullptr>
+    static void gatherVec(Gather& g, const Vec& v)
+    {
+        const int sz = v.size();
+        copyChunk(g, &sz, sizeof(int));
+        referChunk(g, v.data(), v.size()*sizeof(ValType<Vec>));
+    }
+
+    /// Overload for the vectors of NON POD : other vectors or strings
+    template<typename Vec, EnableIfNonPod<ValType<Vec>> = nullptr>
+    static void gatherVec(Gather& g, const Vec& v)
+    {
+        const int sz = v.size();
+        copyChunk(g, &sz, sizeof(int));
+
+        for (auto& element : v)
+            gatherOne(g, element);
+    }
+
+    template<typename T> static void gatherOne(Gather& g, const std::vector <T>& v) { gatherVec(g, v); }
+    template<typename T> static void gatherOne(Gather& g, const HostBuffer  <T>& v) { gatherVec(g, v); }
+    template<typename T> static void gatherOne(Gather& g, const PinnedBuffer<T>& v) { gatherVec(g, v); }
+
+    static void gatherOne(Gather& g, const std::string& s)
+    {
+        const int sz = s.length();
+        copyChunk(g, &sz, sizeof(int));
+        copyChunk(g, s.c_str(), s.length());
+    }
+
+    template<typename T>
+    static void gatherOne(Gather& g, const T& v)
+    {
+        copyChunk(g, &v, sizeOfOne(v));
+    }
+
+    static void gather(Gather& g) {}
+
+    template<typename Arg, typename... OthArgs>
+    static void gather(Gather& g, const Arg& arg, const OthArgs&... othArgs)
+    {
+        gatherOne(g, arg);
+        gather(g, othArgs...);
+    }
+
+    //============================================================================
+
 public:
+    /// [pointer, size in bytes] parts of one message, see SimulationPlugin::send()
+    using Chunks = std::vector<std::pair<const void*, int>>;
+
+    /// vectors of POD smaller than this are copied by serializeChunks()
+    static constexpr int minReferencedSize = 1024;
+
     template<typename... Args>
     static void serialize(std::vector<char>& buf, const Args&... args)
     {
@@ -233,6 +322,27 @@ public:
     }
 
 
+    /**
+     * Scatter-gather variant of serialize(): describe the message as \p chunks instead of
+     * copying it in a single buffer. The vectors of POD are referred to in place, the container
+     * sizes, scalars and strings are copied to \p header. The concatenation of the chunks
+     * is byte to byte the buffer of serialize(), so the receiver deserialize()s it as usual.
+     * 
+     * \p header and all the arguments must stay untouched until the message is sent
+     */
+    template<typename... Args>
+    static void serializeChunks(std::vector<char>& header, Chunks& chunks, const Args&... args)
+    {
+        header.clear();
+        Gather g{header, {}};
+        gather(g, args...);
+
+        // the header does not move anymore
+        chunks.clear();
+        for (auto& c : g.chunks)
+            chunks.push_back({c.ptr != nullptr ? c.ptr : header.data() + c.offset, c.size});
+    }
+
     // Unsafe variants
     template<typename... Args>
     static void serialize(char* to, const Args&... args)
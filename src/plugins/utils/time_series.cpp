@@ -0,0 +1,84 @@
+#include "time_series.h"
+
+#include <core/logger.h>
+#include <core/utils/cuda_common.h>
+
+#include <algorithm>
+#include <limits>
+
+TimeSeriesBuffer::TimeSeriesBuffer(int nComponents, int capacity) :
+    nComponents(nComponents),
+    capacity(capacity),
+    samples(nComponents * capacity)
+{
+    if (capacity <= 0)
+        die("Time series must hold at least one sample, got %d", capacity);
+}
+
+double* TimeSeriesBuffer::nextSample(cudaStream_t stream)
+{
+    if (full())
+        die("Time series of %d samples is full, it must be downloaded first", capacity);
+
+    double *slot = samples.devPtr() + nSamples * nComponents;
+    CUDA_Check( cudaMemsetAsync(slot, 0, nComponents * sizeof(double), stream) );
+    return slot;
+}
+
+void TimeSeriesBuffer::commit(TimeType time)
+{
+    times.push_back(time);
+    nSamples++;
+}
+
+void TimeSeriesBuffer::download(cudaStream_t stream, std::vector<TimeType>& times, std::vector<double>& values)
+{
+    const int n = nSamples * nComponents;
+
+    if (n > 0)
+        CUDA_Check( cudaMemcpyAsync(samples.hostPtr(), samples.devPtr(), n * sizeof(double),
+                                    cudaMemcpyDeviceToHost, stream) );
+    CUDA_Check( cudaStreamSynchronize(stream) );
+
+    values.assign(samples.hostPtr(), samples.hostPtr() + n);
+    times.swap(this->times);
+
+    this->times.clear();
+    nSamples = 0;
+}
+
+//=================================================================================
+
+WindowStatistics::WindowStatistics(int nComponents) :
+    means(nComponents), m2(nComponents), mins(nComponents), maxs(nComponents)
+{
+    reset();
+}
+
+void WindowStatistics::add(const double *sample)
+{
+    n++;
+    for (int c = 0; c < means.size(); c++)
+    {
+        const double delta = sample[c] - means[c];
+        means[c] += delta / n;
+        m2[c]    += delta * (sample[c] - means[c]);
+
+        mins[c] = std::min(mins[c], sample[c]);
+        maxs[c] = std::max(maxs[c], sample[c]);
+    }
+}
+
+void WindowStatistics::reset()
+{
+    n = 0;
+    std::fill(means.begin(), means.end(), 0.0);
+    std::fill(m2   .begin(), m2   .end(), 0.0);
+    std::fill(mins .begin(), mins .end(),  std::numeric_limits<double>::max());
+    std::fill(maxs .begin(), maxs .end(), -std::numeric_limits<double>::max());
+}
+
+double WindowStatistics::variance(int component) const
+{
+    return n > 1 ? m2[component] / (n - 1) : 0.0;
+}
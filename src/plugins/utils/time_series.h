@@ -0,0 +1,70 @@
+#pragma once
+
+#include <core/containers.h>
+#include <core/datatypes.h>
+#include <core/ymero_state.h>
+
+#include <cuda_runtime.h>
+#include <vector>
+
+/**
+ * Device-side buffer of the samples of a plugin, of nComponents doubles each.
+ *
+ * The sampling kernels (e.g. the reducers of the SamplingPipeline) write
+ * every sample directly into the device slot given by nextSample(), such
+ * that nothing is downloaded until the buffer is full: download() then
+ * copies all the samples at once, to be shipped in one message.
+ * The slots are reused cyclically after every download
+ */
+class TimeSeriesBuffer
+{
+public:
+    TimeSeriesBuffer(int nComponents, int capacity);
+
+    /// cleared device slot of the next sample
+    double* nextSample(cudaStream_t stream);
+
+    /// the slot given by the last nextSample() holds a sample taken at \p time
+    void commit(TimeType time);
+
+    int size() const { return nSamples; }
+    bool full() const { return nSamples == capacity; }
+
+    /**
+     * Blocking download of the samples committed since the last download.
+     * @param times their times
+     * @param values nComponents values per sample, in the order of the samples
+     */
+    void download(cudaStream_t stream, std::vector<TimeType>& times, std::vector<double>& values);
+
+private:
+    int nComponents, capacity;
+    int nSamples {0};
+
+    PinnedBuffer<double> samples;
+    std::vector<TimeType> times;
+};
+
+/**
+ * Online mean, variance, min and max of a window of samples
+ * of nComponents values each (Welford's algorithm)
+ */
+class WindowStatistics
+{
+public:
+    WindowStatistics(int nComponents);
+
+    void add(const double *sample);
+    void reset();
+
+    int size() const { return n; }
+
+    double mean    (int component) const { return means[component]; }
+    double variance(int component) const;
+    double min     (int component) const { return mins [component]; }
+    double max     (int component) const { return maxs [component]; }
+
+private:
+    int n {0};
+    std::vector<double> means, m2, mins, maxs;
+};
@@ -19,41 +19,57 @@ inline __device__ bool is_inside(float3 r, float3 low, float3 high)
         low.z <= r.z && r.z <= high.z;
 }
 
-__global__ void addForce(PVview view, DomainInfo domain, float3 low, float3 high, float3 force)
+__global__ void addForce(PVview view, RegionCellsView cells, float3 low, float3 high, float3 force)
 {
     int gid = blockIdx.x * blockDim.x + threadIdx.x;
-    if (gid >= view.size) return;
+    if (gid >= cells.size) return;
 
-    Particle p;
-    p.readCoordinate(view.particles, gid);
-    float3 gr = domain.local2global(p.r);
+    const int2 range = cells.particles(gid);
 
-    if (is_inside(gr, low, high))
-        view.forces[gid] += make_float4(force, 0.0f);
+    for (int pid = range.x; pid < range.y; pid++)
+    {
+        Particle p;
+        p.readCoordinate(view.particles, pid);
+
+        if (is_inside(p.r, low, high))
+            view.forces[pid] += make_float4(force, 0.0f);
+    }
 }
 
-__global__ void sumVelocity(PVview view, DomainInfo domain, float3 low, float3 high, float3 *totVel, int *nSamples)
+/// add the velocities and the number of the particles in the box to \p sums[0..2] and \p sums[3]
+__global__ void sumVelocity(PVview view, RegionCellsView cells, float3 low, float3 high, double *sums)
 {
     int gid = blockIdx.x * blockDim.x + threadIdx.x;
-    Particle p;
-    
-    p.u = make_float3(0.0f);
 
-    if (gid < view.size) {
+    float3 u = make_float3(0.0f);
+    int n = 0;
 
-        p.read(view.particles, gid);
-        float3 gr = domain.local2global(p.r);
-
-        if (is_inside(gr, low, high))
-            atomicAggInc(nSamples);
-        else
-            p.u = make_float3(0.0f);
+    if (gid < cells.size)
+    {
+        const int2 range = cells.particles(gid);
+
+        for (int pid = range.x; pid < range.y; pid++)
+        {
+            Particle p(view.particles, pid);
+
+            if (is_inside(p.r, low, high))
+            {
+                u += p.u;
+                n++;
+            }
+        }
     }
 
-    float3 u = warpReduce(p.u, [](float a, float b) { return a+b; });
-    
-    if (__laneid() == 0 && dot(u, u) > 1e-8)
-        atomicAdd(totVel, u);
+    u = warpReduce(u, [](float a, float b) { return a+b; });
+    n = warpReduce(n, [](int   a, int   b) { return a+b; });
+
+    if (__laneid() == 0 && n > 0)
+    {
+        atomicAdd(sums + 0, (double) u.x);
+        atomicAdd(sums + 1, (double) u.y);
+        atomicAdd(sums + 2, (double) u.z);
+        atomicAdd(sums + 3, (double) n);
+    }
 }
 
 } // namespace VelocityControlKernels
@@ -61,7 +77,7 @@ __global__ void sumVelocity(PVview view, DomainInfo domain, float3 low, float3 h
 SimulationVelocityControl::SimulationVelocityControl(const YmrState *state, std::string name, std::vector<std::string> pvNames,
                                                      float3 low, float3 high,
                                                      int sampleEvery, int tuneEvery, int dumpEvery,
-                                                     float3 targetVel, float Kp, float Ki, float Kd) :
+                                                     float3 targetVel, float Kp, float Ki, float Kd, bool lagged) :
     SimulationPlugin(state, name),
     pvNames(pvNames),
     low(low),
@@ -72,8 +88,8 @@ SimulationVelocityControl::SimulationVelocityControl(const YmrState *state, std:
     tuneEvery(tuneEvery),
     dumpEvery(dumpEvery), 
     force(make_float3(0, 0, 0)),
-    pid(make_float3(0, 0, 0), Kp, Ki, Kd),
-    accumulatedTotVel({0,0,0})
+    lagged(lagged),
+    pid(make_float3(0, 0, 0), Kp, Ki, Kd)
 {}
 
 
@@ -83,30 +99,57 @@ void SimulationVelocityControl::setup(Simulation* simulation, const MPI_Comm& co
 
     for (auto &pvName : pvNames)
         pvs.push_back(simulation->getPVbyNameOrDie(pvName));
+
+    reduction.setup(comm, defaultStream);
+
+    localLow  = state->domain.global2local(low);
+    localHigh = state->domain.global2local(high);
+
+    regionCells.resize(pvs.size());
+    for (int i = 0; i < pvs.size(); i++)
+    {
+        regionCells[i].setupBox(simulation->gelCellList(pvs[i]), localLow, localHigh, defaultStream);
+
+        if (!regionCells[i].valid())
+            warn("Plugin '%s' has no primary cell-list for PV '%s' and will visit all its particles",
+                 name.c_str(), pvs[i]->name.c_str());
+    }
 }
 
 void SimulationVelocityControl::beforeForces(cudaStream_t stream)
 {
-    for (auto &pv : pvs)
+    if (lagged)
+    {
+        if (reduction.test()) updateForce();
+    }
+    else if (reduction.pending())
+    {
+        reduction.wait();
+        updateForce();
+    }
+
+    for (int i = 0; i < pvs.size(); i++)
     {
-        PVview view(pv, pv->local());
+        PVview view(pvs[i], pvs[i]->local());
+        auto cells = regionCells[i].getView(view.size);
         const int nthreads = 128;
 
         SAFE_KERNEL_LAUNCH
             (VelocityControlKernels::addForce,
-             getNblocks(view.size, nthreads), nthreads, 0, stream,
-             view, state->domain, low, high, force );
+             getNblocks(cells.size, nthreads), nthreads, 0, stream,
+             view, cells, localLow, localHigh, force );
     }
 }
 
-void SimulationVelocityControl::sampleOnePv(ParticleVector *pv, cudaStream_t stream) {
-    PVview pvView(pv, pv->local());
+void SimulationVelocityControl::sampleOnePv(int pvId, cudaStream_t stream) {
+    PVview pvView(pvs[pvId], pvs[pvId]->local());
+    auto cells = regionCells[pvId].getView(pvView.size);
     const int nthreads = 128;
  
     SAFE_KERNEL_LAUNCH
         (VelocityControlKernels::sumVelocity,
-         getNblocks(pvView.size, nthreads), nthreads, 0, stream,
-         pvView, state->domain, low, high, totVel.devPtr(), nSamples.devPtr());
+         getNblocks(cells.size, nthreads), nthreads, 0, stream,
+         pvView, cells, localLow, localHigh, reduction.localDevPtr());
 }
 
 void SimulationVelocityControl::afterIntegration(cudaStream_t stream)
@@ -115,30 +158,29 @@ void SimulationVelocityControl::afterIntegration(cudaStream_t stream)
     {
         debug2("Velocity control %s is sampling now", name.c_str());
 
-        totVel.clearDevice(stream);
-        for (auto &pv : pvs) sampleOnePv(pv, stream);
-        totVel.downloadFromDevice(stream);
-        accumulatedTotVel.x += totVel[0].x;
-        accumulatedTotVel.y += totVel[0].y;
-        accumulatedTotVel.z += totVel[0].z;
+        for (int i = 0; i < pvs.size(); i++) sampleOnePv(i, stream);
     }
     
     if (state->currentStep % tuneEvery != 0 || state->currentStep == 0) return;
-    
-    nSamples.downloadFromDevice(stream);
-    nSamples.clearDevice(stream);
-    
-    long nSamples_loc, nSamples_tot = 0;
-    double3 totVel_tot = make_double3(0,0,0);  
 
-    nSamples_loc = nSamples[0];
-    
-    MPI_Check( MPI_Allreduce(&nSamples_loc,        &nSamples_tot, 1, MPI_LONG,   MPI_SUM, comm) );
-    MPI_Check( MPI_Allreduce(&accumulatedTotVel,   &totVel_tot,   3, MPI_DOUBLE, MPI_SUM, comm) );
+    // a lagged force may still be on its way
+    if (reduction.pending())
+    {
+        reduction.wait();
+        updateForce();
+    }
+
+    reduction.start(stream);
+}
+
+void SimulationVelocityControl::updateForce()
+{
+    const auto& sums = reduction.result();
+    const double nSamples_tot = sums[3];
+    const double3 totVel_tot = make_double3(sums[0], sums[1], sums[2]);
 
-    currentVel = nSamples_tot ? make_float3(totVel_tot / nSamples_tot) : make_float3(0.f, 0.f, 0.f);
+    currentVel = nSamples_tot > 0 ? make_float3(totVel_tot / nSamples_tot) : make_float3(0.f, 0.f, 0.f);
     force = pid.update(targetVel - currentVel);
-    accumulatedTotVel = {0,0,0};
 }
 
 void SimulationVelocityControl::serializeAndSend(cudaStream_t stream)
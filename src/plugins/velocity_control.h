@@ -1,7 +1,9 @@
 #pragma once
 
 #include "interface.h"
+#include "utils/deferred_allreduce.h"
 #include "utils/pid.h"
+#include "utils/region_cells.h"
 
 #include <core/containers.h>
 #include <core/datatypes.h>
@@ -10,13 +12,21 @@
 
 class ParticleVector;
 
+/**
+ * Add a uniform force to the particles in a box, adapted by a PID controller
+ * such that their mean velocity reaches the target.
+ *
+ * The velocities are summed on the device and reduced over the ranks with DeferredAllreduce:
+ * the force of a tuning step is only waited for right before the next forces,
+ * or, if \p lagged, applied whenever it is available without ever blocking
+ */
 class SimulationVelocityControl : public SimulationPlugin
 {
 public:
     SimulationVelocityControl(const YmrState *state, std::string name, std::vector<std::string> pvNames,
                               float3 low, float3 high,
                               int sampleEvery, int tuneEvery, int dumpEvery,
-                              float3 targetVel, float Kp, float Ki, float Kd);
+                              float3 targetVel, float Kp, float Ki, float Kd, bool lagged = false);
 
     void setup(Simulation* simulation, const MPI_Comm& comm, const MPI_Comm& interComm) override;
 
@@ -32,18 +42,22 @@ private:
     std::vector<ParticleVector*> pvs;
 
     float3 high, low;
+    float3 localHigh, localLow;
     float3 currentVel, targetVel, force;
+    bool lagged;
 
-    PinnedBuffer<int> nSamples{1};
-    PinnedBuffer<float3> totVel{1};
-    double3 accumulatedTotVel;
-    
+    /// sum of the velocities and number of samples since the last tuning
+    DeferredAllreduce reduction{4};
+
+    /// cells of the primary cell-list of each pv intersecting the box
+    std::vector<RegionCells> regionCells;
 
     PidControl<float3> pid;
     std::vector<char> sendBuffer;
 
 private:
-    void sampleOnePv(ParticleVector *pv, cudaStream_t stream);
+    void sampleOnePv(int pvId, cudaStream_t stream);
+    void updateForce();
 };
 
 class PostprocessVelocityControl : public PostprocessPlugin
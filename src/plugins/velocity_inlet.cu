@@ -209,10 +209,7 @@ void VelocityInletPlugin::beforeCellLists(cudaStream_t stream)
         
     nNewParticles.downloadFromDevice(stream, ContainersSynch::Synch);
 
-    int oldSize = view.size;
-    int newSize = oldSize + nNewParticles[0];
-
-    pv->local()->resize(newSize, stream);
+    const int oldSize = editor.append(pv->local(), nNewParticles[0], stream);
 
     view = PVview(pv, pv->local());
 
@@ -3,6 +3,7 @@
 #include "interface.h"
 
 #include <core/containers.h>
+#include <core/pvs/particle_editor.h>
 
 #include <functional>
 #include <random>
@@ -43,6 +44,7 @@ private:
     DeviceBuffer<float> cumulativeFluxes, localFluxes;
     PinnedBuffer<int> nNewParticles {1};
     DeviceBuffer<int> workQueue; // contains id of triangle per new particle
+    ParticleEditor editor;
 
     std::mt19937 gen {42};
     std::uniform_real_distribution<float> dist {0.f, 1.f};
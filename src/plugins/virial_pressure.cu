@@ -1,41 +1,16 @@
 #include "virial_pressure.h"
+#include "sampling_pipeline.h"
 #include "utils/simple_serializer.h"
 
 #include <core/datatypes.h>
 #include <core/pvs/particle_vector.h>
-#include <core/pvs/views/pv.h>
 #include <core/simulation.h>
 #include <core/utils/folders.h>
 #include <core/utils/common.h>
 #include <core/utils/cuda_common.h>
-#include <core/utils/kernel_launch.h>
-
-namespace VirialPressureKernels
-{
-__global__ void totalPressure(PVview view, const Stress *stress, FieldDeviceHandler region, VirialPressure::ReductionType *pressure)
-{
-    int tid = blockIdx.x * blockDim.x + threadIdx.x;
-
-    VirialPressure::ReductionType P = 0;
-    Particle p;
-
-    if (tid < view.size) {
-        const Stress s = stress[tid];
-        p.readCoordinate(view.particles, tid);
-
-        if (region(p.r) > 0)
-            P = (s.xx + s.yy + s.zz) / 3.0;
-    }
-    
-    P = warpReduce(P, [](VirialPressure::ReductionType a, VirialPressure::ReductionType b) { return a+b; });
-
-    if (__laneid() == 0)
-        atomicAdd(pressure, P);
-}
-} // namespace VirialPressureKernels
 
 VirialPressurePlugin::VirialPressurePlugin(const YmrState *state, std::string name, std::string pvName,
-                                           FieldFunction func, float3 h, int dumpEvery) :
+                                           FieldBatchFunction func, float3 h, int dumpEvery) :
     SimulationPlugin(state, name),
     pvName(pvName),
     dumpEvery(dumpEvery),
@@ -51,6 +26,7 @@ void VirialPressurePlugin::setup(Simulation* simulation, const MPI_Comm& comm, c
     pv = simulation->getPVbyNameOrDie(pvName);
 
     region.setup(comm);
+    pipeline = simulation->getSamplingPipeline();
 
     info("Plugin %s initialized for the following particle vector: %s", name.c_str(), pvName.c_str());
 }
@@ -65,20 +41,22 @@ void VirialPressurePlugin::afterIntegration(cudaStream_t stream)
 {
     if (state->currentStep % dumpEvery != 0 || state->currentStep == 0) return;
 
-    PVview view(pv, pv->local());
     const Stress *stress = pv->local()->extraPerParticle.getData<Stress>(ChannelNames::stresses)->devPtr();
 
     localVirialPressure.clear(stream);
-    
-    SAFE_KERNEL_LAUNCH(
-        VirialPressureKernels::totalPressure,
-        getNblocks(view.size, 128), 128, 0, stream,
-        view, stress, region.handler(), localVirialPressure.devPtr() );
 
-    localVirialPressure.downloadFromDevice(stream, ContainersSynch::Synch);
-    
+    auto reducer = SamplingReducer::sum(SamplingReducer::Quantity::Pressure, localVirialPressure.devPtr());
+    reducer.data      = (const float*) stress;
+    reducer.useRegion = true;
+    reducer.region    = region.handler();
+    pipeline->add(pv, reducer);
+
     savedTime = state->currentTime;
-    needToSend = true;
+
+    pipeline->onCompletion([this] (cudaStream_t stream) {
+        localVirialPressure.downloadFromDevice(stream, ContainersSynch::Synch);
+        needToSend = true;
+    });
 }
 
 void VirialPressurePlugin::serializeAndSend(cudaStream_t stream)
@@ -94,6 +72,16 @@ void VirialPressurePlugin::serializeAndSend(cudaStream_t stream)
     needToSend = false;
 }
 
+SimulationPlugin::HookPeriod VirialPressurePlugin::getHookPeriod(Hook hook) const
+{
+    switch (hook)
+    {
+        case Hook::AfterIntegration:  return {dumpEvery, 0};
+        case Hook::SerializeSend:     return {1, 0};
+        default:                      return {0, 0};
+    }
+}
+
 //=================================================================================
 
 VirialPressureDumper::VirialPressureDumper(std::string name, std::string path) :
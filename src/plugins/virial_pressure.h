@@ -6,6 +6,7 @@
 #include "interface.h"
 
 class ParticleVector;
+class SamplingPipeline;
 
 namespace VirialPressure
 {
@@ -16,7 +17,7 @@ class VirialPressurePlugin : public SimulationPlugin
 {
 public:
     VirialPressurePlugin(const YmrState *state, std::string name, std::string pvName,
-                         FieldFunction func, float3 h, int dumpEvery);
+                         FieldBatchFunction func, float3 h, int dumpEvery);
 
     ~VirialPressurePlugin();
 
@@ -24,6 +25,7 @@ public:
 
     void afterIntegration(cudaStream_t stream) override;
     void serializeAndSend(cudaStream_t stream) override;
+    HookPeriod getHookPeriod(Hook hook) const override;
     void handshake() override;
 
     bool needPostproc() override { return true; }
@@ -41,6 +43,7 @@ private:
     std::vector<char> sendBuffer;
 
     ParticleVector *pv;
+    SamplingPipeline *pipeline;
 };
 
 
@@ -1,32 +1,14 @@
 #include "wall_force_collector.h"
+#include "sampling_pipeline.h"
 #include "utils/simple_serializer.h"
 
 #include <core/datatypes.h>
 #include <core/pvs/particle_vector.h>
-#include <core/pvs/views/pv.h>
 #include <core/simulation.h>
 #include <core/utils/cuda_common.h>
-#include <core/utils/kernel_launch.h>
 #include <core/walls/interface.h>
 
-namespace WallForceCollector
-{
-__global__ void totalForce(PVview view, double3 *totalForce)
-{
-    int tid = blockIdx.x * blockDim.x + threadIdx.x;
-
-    float3 f {0.f, 0.f, 0.f};
-    
-    if (tid < view.size)
-        f = make_float3(view.forces[tid]);
-
-    f = warpReduce(f, [](float a, float b) { return a + b; });
-
-    if (__laneid() == 0)
-        atomicAdd(totalForce, make_double3(f));
-}
-} //namespace WallForceCollector
-
+#include <cmath>
 
 WallForceCollectorPlugin::WallForceCollectorPlugin(const YmrState *state, std::string name,
                                                    std::string wallName, std::string frozenPvName,
@@ -35,7 +17,8 @@ WallForceCollectorPlugin::WallForceCollectorPlugin(const YmrState *state, std::s
     sampleEvery(sampleEvery),
     dumpEvery(dumpEvery),
     wallName(wallName),
-    frozenPvName(frozenPvName)
+    frozenPvName(frozenPvName),
+    samples(nSampleComponents, dumpEvery / sampleEvery + 2)
 {}
 
 WallForceCollectorPlugin::~WallForceCollectorPlugin() = default;
@@ -51,51 +34,50 @@ void WallForceCollectorPlugin::setup(Simulation *simulation, const MPI_Comm& com
         die("Plugin '%s' expects a SDF based wall (got '%s')\n", name.c_str(), wallName.c_str());
 
     pv = simulation->getPVbyNameOrDie(frozenPvName);
+    pv->staticForces = true;
 
     bounceForceBuffer = wall->getCurrentBounceForce();
+    pipeline = simulation->getSamplingPipeline();
 }
 
 void WallForceCollectorPlugin::afterIntegration(cudaStream_t stream)
 {   
     if (state->currentStep % sampleEvery == 0)
     {
-        pvForceBuffer.clear(stream);
-
-        PVview view(pv, pv->local());
-        const int nthreads = 128;
-
-        SAFE_KERNEL_LAUNCH(
-            WallForceCollector::totalForce,
-            getNblocks(view.size, nthreads), nthreads, 0, stream,
-            view, pvForceBuffer.devPtr() );
+        double *sample = samples.nextSample(stream);
 
-        pvForceBuffer     .downloadFromDevice(stream);
-        bounceForceBuffer->downloadFromDevice(stream);
+        pipeline->add(pv, SamplingReducer::sum(SamplingReducer::Quantity::Force, sample));
+        CUDA_Check( cudaMemcpyAsync(sample + 3, bounceForceBuffer->devPtr(), sizeof(double3),
+                                    cudaMemcpyDeviceToDevice, stream) );
 
-        totalForce += pvForceBuffer[0];
-        totalForce += (*bounceForceBuffer)[0];
-
-        ++nsamples;
+        const TimeType time = state->currentTime;
+        pipeline->onCompletion([this, time] (cudaStream_t stream) {
+            samples.commit(time);
+        });
     }
-    
-    needToDump = (state->currentStep % dumpEvery == 0 && nsamples > 0);
+
+    // the samples of this step are only counted once the pipeline ran
+    needToDump = (state->currentStep % dumpEvery == 0);
 }
 
 void WallForceCollectorPlugin::serializeAndSend(cudaStream_t stream)
 {
-    if (needToDump)
+    if (needToDump && samples.size() > 0)
     {
+        std::vector<TimeType> times;
+        std::vector<double> values;
+        samples.download(stream, times, values);
+
         waitPrevSend();
-        SimpleSerializer::serialize(sendBuffer, state->currentTime, nsamples, totalForce);
+        SimpleSerializer::serialize(sendBuffer, state->currentTime, values);
         send(sendBuffer);
         needToDump = false;
-        nsamples   = 0;
-        totalForce = make_double3(0, 0, 0);
     }
 }
 
-WallForceDumperPlugin::WallForceDumperPlugin(std::string name, std::string filename) :
-    PostprocessPlugin(name)
+WallForceDumperPlugin::WallForceDumperPlugin(std::string name, std::string filename, bool windowStatistics) :
+    PostprocessPlugin(name),
+    windowStatistics(windowStatistics)
 {
     fdump = fopen(filename.c_str(), "w");
     if (!fdump)
@@ -110,23 +92,35 @@ WallForceDumperPlugin::~WallForceDumperPlugin()
 void WallForceDumperPlugin::deserialize(MPI_Status& stat)
 {
     TimeType currentTime;
-    int nsamples;
-    double localForce[3], totalForce[3] = {0.0, 0.0, 0.0};
+    std::vector<double> values;
+
+    SimpleSerializer::deserialize(data, currentTime, values);
+
+    const int ncomp = WallForceCollectorPlugin::nSampleComponents;
+    const int nsamples = values.size() / ncomp;
 
-    SimpleSerializer::deserialize(data, currentTime, nsamples, localForce);
-    
-    MPI_Check( MPI_Reduce(localForce, totalForce, 3, MPI_DOUBLE, MPI_SUM, 0, comm) );
+    // frozen particles and bounce contributions of all the samples, reduced at once
+    std::vector<double> localForces(3*nsamples), totalForces(3*nsamples);
+    for (int i = 0; i < nsamples; i++)
+        for (int c = 0; c < 3; c++)
+            localForces[3*i + c] = values[ncomp*i + c] + values[ncomp*i + 3 + c];
 
-    if (rank == 0)
+    MPI_Check( MPI_Reduce(localForces.data(), totalForces.data(), 3*nsamples, MPI_DOUBLE, MPI_SUM, 0, comm) );
+
+    if (rank == 0 && fdump != nullptr)
     {
-        totalForce[0] /= (double)nsamples;
-        totalForce[1] /= (double)nsamples;
-        totalForce[2] /= (double)nsamples;
-
-        if (fdump != nullptr) {
-            fprintf(fdump, "%g %g %g %g\n", currentTime, totalForce[0], totalForce[1], totalForce[2]);
-            fflush(fdump);
-        }
+        WindowStatistics window(3);
+        for (int i = 0; i < nsamples; i++)
+            window.add(totalForces.data() + 3*i);
+
+        fprintf(fdump, "%g %g %g %g", currentTime, window.mean(0), window.mean(1), window.mean(2));
+
+        if (windowStatistics)
+            for (int c = 0; c < 3; c++)
+                fprintf(fdump, " %g %g %g", sqrt(window.variance(c)), window.min(c), window.max(c));
+
+        fprintf(fdump, "\n");
+        fflush(fdump);
     }
 }
 
@@ -1,12 +1,14 @@
 #pragma once
 
 #include <plugins/interface.h>
+#include <plugins/utils/time_series.h>
 #include <core/containers.h>
 #include <core/datatypes.h>
 #include <core/utils/timer.h>
 
 class ParticleVector;
 class SDF_basedWall;
+class SamplingPipeline;
 
 class WallForceCollectorPlugin : public SimulationPlugin
 {
@@ -16,6 +18,9 @@ public:
                              int sampleEvery, int dumpEvery);
     ~WallForceCollectorPlugin();
 
+    /// components of a sample: force on the frozen particles, then bounce force
+    static const int nSampleComponents = 6;
+
     void setup(Simulation *simulation, const MPI_Comm& comm, const MPI_Comm& interComm) override;
     
     void afterIntegration(cudaStream_t stream) override;
@@ -25,7 +30,6 @@ public:
 
 private:
     int sampleEvery, dumpEvery;
-    int nsamples {0};
     
     std::string wallName;
     std::string frozenPvName;
@@ -34,22 +38,26 @@ private:
 
     SDF_basedWall *wall;
     ParticleVector *pv;
+    SamplingPipeline *pipeline;
     
     PinnedBuffer<double3> *bounceForceBuffer {nullptr};
-    PinnedBuffer<double3> pvForceBuffer {1};
-    double3 totalForce {0.};
-    
+
+    /// all the samples between two dumps, downloaded at once
+    TimeSeriesBuffer samples;
+
     std::vector<char> sendBuffer;
 };
 
 class WallForceDumperPlugin : public PostprocessPlugin
 {
 public:
-    WallForceDumperPlugin(std::string name, std::string filename);
+    /// with \p windowStatistics, also dump the standard deviation, min and max of the force between two dumps
+    WallForceDumperPlugin(std::string name, std::string filename, bool windowStatistics = false);
     ~WallForceDumperPlugin();
 
     void deserialize(MPI_Status& stat) override;
 
 private:
     FILE *fdump {nullptr};
+    bool windowStatistics;
 };
@@ -14,7 +14,7 @@ import re
 
 from libymero import *
 
-__all__ = ["version", "tools"]
+__all__ = ["version", "tools", "xdmf"]
 
 
 # Global variable for the ymero coordination class
@@ -0,0 +1,86 @@
+"""
+Lazy access to the XDMF dumps written with the 'mappable' compression.
+
+The datasets of such dumps are contiguous and uncompressed, their byte offsets
+in the HDF5 files are published in the Seek attribute of the .xmf data items:
+they are memory-mapped with numpy instead of being read, such that only the
+slices that are accessed are ever loaded from the disk.
+"""
+
+import os
+import xml.etree.ElementTree as ET
+
+
+def _dtype(item):
+    import numpy as np
+
+    kinds = {'Float' : 'f', 'Int' : 'i', 'UInt' : 'u', 'Char' : 'i', 'UChar' : 'u'}
+    kind = kinds[item.get('NumberType', 'Float')]
+    precision = int(item.get('Precision', '4'))
+    order = '<' if item.get('Endian', 'Little') == 'Little' else '>'
+
+    return np.dtype(order + kind + str(precision))
+
+
+def _map_item(item, folder):
+    import numpy as np
+
+    if item.get('Format') != 'HDF' or item.get('Seek') is None:
+        return None
+
+    h5file, dataset = item.text.strip().split(':/')
+    shape = tuple(int(d) for d in item.get('Dimensions').split())
+
+    if 0 in shape:
+        return dataset, np.empty(shape, dtype=_dtype(item))
+
+    return dataset, np.memmap(os.path.join(folder, h5file), dtype=_dtype(item), mode='r',
+                              offset=int(item.get('Seek')), shape=shape)
+
+
+def _map_grid(grid, folder):
+    datasets = {}
+    for item in grid.iter('DataItem'):
+        mapped = _map_item(item, folder)
+        if mapped is not None:
+            datasets[mapped[0]] = mapped[1]
+    return datasets
+
+
+def read(filename):
+    """
+    Memory-map the datasets of one dump.
+
+    Args:
+        filename: the .xmf file of the dump
+
+    Returns:
+        a tuple (time, datasets), where datasets maps the name of every mappable dataset,
+        positions included, to a read-only numpy.memmap of shape given by the .xmf;
+        dumps written in subfiles give a list of such dictionaries, one per subfile.
+        time is None if the dump has none
+    """
+    folder = os.path.dirname(os.path.abspath(filename))
+    domain = ET.parse(filename).getroot().find('Domain')
+    grid = domain.find('Grid')
+
+    timeNode = grid.find('Time')
+    time = float(timeNode.get('Value')) if timeNode is not None else None
+
+    if grid.get('GridType') == 'Collection':
+        return time, [_map_grid(g, folder) for g in grid.findall('Grid')]
+
+    return time, _map_grid(grid, folder)
+
+
+def read_series(filenames):
+    """
+    Memory-map a time series of dumps without reading their data.
+
+    Args:
+        filenames: the .xmf files of the dumps, e.g. sorted(glob.glob('xdmf/avg_*.xmf'))
+
+    Returns:
+        the list of the (time, datasets) tuples of :py:func:`read`
+    """
+    return [read(f) for f in filenames]
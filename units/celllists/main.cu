@@ -7,18 +7,42 @@
 #include <cuda.h>
 #include <cassert>
 #include <algorithm>
+#include <memory>
+#include <vector>
 
 #include <core/pvs/particle_vector.h>
 #include <core/celllist.h>
 #include <core/logger.h>
 #include <core/initial_conditions/uniform_ic.h>
+#include <core/utils/make_unique.h>
 
 #include <gtest/gtest.h>
 
 Logger logger;
 bool verbose = false;
 
-void test_domain(float3 length, float rc, float density)
+/// shift one particle every 1/fraction by one cell along x, wrapping around the domain; \p reference follows them by id
+static void moveParticles(ParticleVector& pv, HostBuffer<Particle>& reference, float fraction, float3 h, float3 length, int step)
+{
+    auto& coosvels = pv.local()->coosvels;
+    coosvels.downloadFromDevice(0, ContainersSynch::Synch);
+
+    const int period = std::max(1, (int) (1.0f / fraction));
+    for (int i = 0; i < coosvels.size(); i++)
+    {
+        auto& p = coosvels[i];
+        if ((p.i1 + step) % period != 0) continue;
+
+        p.r.x += h.x;
+        if (p.r.x >= 0.5f * length.x) p.r.x -= length.x;
+        reference[p.i1] = p;
+    }
+
+    coosvels.uploadToDevice(0);
+}
+
+void test_domain(float3 length, float rc, float density, CellListOrdering ordering = CellListOrdering::RowMajor,
+                 float movedFraction = 0.0f)
 {
     bool success = true;
     float3 domainStart = -length / 2.0f;
@@ -28,6 +52,9 @@ void test_domain(float3 length, float rc, float density)
 
     ParticleVector dpds(&state, "dpd", 1.0f);
     CellList *cells = new PrimaryCellList(&dpds, rc, length);
+    cells->setOrdering(ordering);
+    if (movedFraction > 0.0f)
+        cells->setIncrementalBuild(1.0f);
 
     UniformIC ic(density);
     ic.exec(MPI_COMM_WORLD, &dpds, 0);
@@ -40,10 +67,17 @@ void test_domain(float3 length, float rc, float density)
 
     for (int i=0; i<50; i++)
     {
+        if (movedFraction > 0.0f && i > 0)
+            moveParticles(dpds, initial, movedFraction, cells->h, length, i);
+
         cells->build(0);
         dpds.cellListStamp++;
     }
 
+    // the last build was an incremental one
+    if (movedFraction > 0.0f)
+        ASSERT_TRUE(cells->movesPending);
+
     dpds.local()->coosvels.downloadFromDevice(0, ContainersSynch::Synch);
 
     HostBuffer<int> hcellsStart(cells->totcells+1);
@@ -52,6 +86,24 @@ void test_domain(float3 length, float rc, float density)
     hcellsStart.copy(cells->cellStarts, 0);
     hcellsSize. copy(cells->cellSizes, 0);
 
+    // cell ids computed on host: the cell maps only live on device
+    HostBuffer<int> hrowToCell;
+    if (ordering != CellListOrdering::RowMajor)
+        hrowToCell.copy(cells->rowToCellMap, 0);
+
+    CellListInfo rowMajorInfo = cells->cellInfo();
+    rowMajorInfo.rowToCell = rowMajorInfo.cellToRow = nullptr;
+
+    auto getCellId = [&] (float3 r, CellListsProjection projection) {
+        int cid = (projection == CellListsProjection::Clamp) ?
+            rowMajorInfo.getCellId<CellListsProjection::Clamp>  (r) :
+            rowMajorInfo.getCellId<CellListsProjection::NoClamp>(r);
+
+        if (cid >= 0 && ordering != CellListOrdering::RowMajor)
+            cid = hrowToCell[cid];
+        return cid;
+    };
+
     HostBuffer<int> cellscount(cells->totcells+1);
     for (int i=0; i<cells->totcells+1; i++)
         cellscount[i] = 0;
@@ -62,7 +114,7 @@ void test_domain(float3 length, float rc, float density)
         float3 coo{initial[pid].r.x, initial[pid].r.y, initial[pid].r.z};
         float3 vel{initial[pid].u.x, initial[pid].u.y, initial[pid].u.z};
 
-        int actCid = cells->getCellId(coo);
+        int actCid = getCellId(coo, CellListsProjection::Clamp);
         if (actCid >= 0)
         {
             cellscount[actCid]++;
@@ -100,7 +152,7 @@ void test_domain(float3 length, float rc, float density)
                 fabs(coo.x - cooDev.x), fabs(coo.y - cooDev.y), fabs(coo.z - cooDev.z),
                 fabs(vel.x - velDev.x), fabs(vel.y - velDev.y), fabs(vel.z - velDev.z) });
 
-            int actCid = cells->getCellId<CellListsProjection::NoClamp>(cooDev);
+            int actCid = getCellId(cooDev, CellListsProjection::NoClamp);
 
             if (cid != actCid || diff > 1e-5)
             {
@@ -117,6 +169,249 @@ void test_domain(float3 length, float rc, float density)
     ASSERT_TRUE(success);
 }
 
+/**
+ * \p cl has the same cells as \p reference, every particle of \p pv goes to a distinct slot of the same cell
+ * as in \p reference, with its data. With \p byId, the particles of a cell of \p cl are also sorted by id
+ */
+static void compareCells(CellList& cl, CellList& reference, ParticleVector& pv, bool byId = false)
+{
+    HostBuffer<int> starts, sizes, order, refStarts, refSizes, refOrder;
+    HostBuffer<Particle> particles;
+
+    starts   .copy(cl.cellStarts, 0);
+    sizes    .copy(cl.cellSizes,  0);
+    order    .copy(cl.order,      0);
+    refStarts.copy(reference.cellStarts, 0);
+    refSizes .copy(reference.cellSizes,  0);
+    refOrder .copy(reference.order,      0);
+    particles.copy(cl.particlesDataContainer->coosvels, 0);
+    pv.local()->coosvels.downloadFromDevice(0, ContainersSynch::Synch);
+
+    const int np = pv.local()->size();
+    const int totcells = reference.totcells;
+    for (int cid=0; cid < totcells+1; cid++)
+    {
+        ASSERT_EQ(sizes [cid], refSizes [cid]);
+        ASSERT_EQ(starts[cid], refStarts[cid]);
+    }
+
+    ASSERT_EQ(order.size(), refOrder.size());
+
+    auto cellOf = [&] (int slot) {
+        return (int) (std::upper_bound(refStarts.hostPtr(), refStarts.hostPtr() + totcells + 1, slot) - refStarts.hostPtr()) - 1;
+    };
+
+    std::vector<int> taken(np, 0);
+    for (int pid=0; pid < np; pid++)
+    {
+        const int slot = order[pid];
+        if (refOrder[pid] < 0)
+        {
+            ASSERT_LT(slot, 0);
+            continue;
+        }
+
+        ASSERT_GE(slot, 0);
+        ASSERT_LT(slot, np);
+        ASSERT_EQ(cellOf(slot), cellOf(refOrder[pid]));
+        ASSERT_EQ(taken[slot]++, 0);
+        ASSERT_EQ(particles[slot].i1, pv.local()->coosvels[pid].i1);
+    }
+
+    if (!byId) return;
+
+    std::vector<int> idOfSlot(np, -1);
+    for (int pid=0; pid < np; pid++)
+        if (order[pid] >= 0) idOfSlot[order[pid]] = pid;
+
+    for (int cid=0; cid < totcells; cid++)
+        for (int slot = starts[cid]+1; slot < starts[cid] + sizes[cid]; slot++)
+            ASSERT_LT(idOfSlot[slot-1], idOfSlot[slot]);
+}
+
+/// an incremental build gives the same cells as a full build, only the order within the cells may differ
+void test_incremental(float3 length, float rc, float density, float movedFraction,
+                      CellListOrdering ordering = CellListOrdering::RowMajor)
+{
+    DomainInfo domain{length, {0,0,0}, length};
+    float dt = 0; // dummy dt
+    YmrState state(domain, dt);
+
+    ParticleVector dpds(&state, "dpd", 1.0f);
+    CellList incremental(&dpds, rc, length), full(&dpds, rc, length);
+    incremental.setOrdering(ordering);
+    full       .setOrdering(ordering);
+    incremental.setIncrementalBuild(1.0f);
+
+    UniformIC ic(density);
+    ic.exec(MPI_COMM_WORLD, &dpds, 0);
+
+    const int np = dpds.local()->size();
+    HostBuffer<Particle> reference(np);
+    for (int i=0; i<np; i++)
+        reference[i] = dpds.local()->coosvels[i];
+
+    for (int step=0; step<5; step++)
+    {
+        if (step > 0)
+            moveParticles(dpds, reference, movedFraction, incremental.h, length, step);
+
+        incremental.build(0);
+        full       .build(0);
+        dpds.cellListStamp++;
+    }
+
+    ASSERT_TRUE(incremental.movesPending);
+
+    compareCells(incremental, full, dpds);
+}
+
+/// all the build methods give the cells of the atomics, the radix sort keeps the particles of a cell by id
+void test_build_method(float3 length, float rc, float density, CellListBuild method,
+                       CellListOrdering ordering = CellListOrdering::RowMajor)
+{
+    DomainInfo domain{length, {0,0,0}, length};
+    float dt = 0; // dummy dt
+    YmrState state(domain, dt);
+
+    ParticleVector dpds(&state, "dpd", 1.0f);
+    CellList tested(&dpds, rc, length), atomics(&dpds, rc, length);
+    tested .setOrdering(ordering);
+    atomics.setOrdering(ordering);
+    tested .setBuildMethod(method);
+    atomics.setBuildMethod(CellListBuild::Atomics);
+
+    UniformIC ic(density);
+    ic.exec(MPI_COMM_WORLD, &dpds, 0);
+
+    // past the timing builds of the automatic choice, which alternate the methods
+    for (int step=0; step < 2*CellList::nTuningBuilds; step++)
+    {
+        tested .build(0);
+        atomics.build(0);
+        dpds.cellListStamp++;
+
+        compareCells(tested, atomics, dpds, tested.useRadixSort);
+    }
+
+    if (method == CellListBuild::Auto)
+        ASSERT_TRUE(tested.tuned);
+}
+
+/// a coarse cell-list derived from the blocks of a fine one has the cells of a cell-list built directly
+void test_coarse(float3 length, float rcFine, int n, float density, CellListOrdering ordering = CellListOrdering::RowMajor)
+{
+    DomainInfo domain{length, {0,0,0}, length};
+    float dt = 0; // dummy dt
+    YmrState state(domain, dt);
+
+    ParticleVector dpds(&state, "dpd", 1.0f);
+    PrimaryCellList fine(&dpds, rcFine, length);
+    CoarseCellList coarse(&dpds, &fine, n, length);
+    CellList direct(&dpds, coarse.ncells, length);
+    coarse.setOrdering(ordering);
+    direct.setOrdering(ordering);
+
+    ASSERT_EQ(fine.getBlocking(), n);
+
+    UniformIC ic(density);
+    ic.exec(MPI_COMM_WORLD, &dpds, 0);
+
+    const int np = dpds.local()->size();
+    HostBuffer<Particle> reference(np);
+
+    for (int step=0; step<3; step++)
+    {
+        if (step > 0)
+            moveParticles(dpds, reference, 0.1f, fine.h, length, step);
+
+        coarse.build(0);
+        direct.build(0);
+        dpds.cellListStamp++;
+
+        HostBuffer<int> coarseStarts, coarseSizes, directStarts, directSizes;
+        HostBuffer<Particle> directParticles;
+
+        coarseStarts.copy(coarse.cellStarts, 0);
+        coarseSizes .copy(coarse.cellSizes,  0);
+        directStarts.copy(direct.cellStarts, 0);
+        directSizes .copy(direct.cellSizes,  0);
+        directParticles.copy(direct.particlesDataContainer->coosvels, 0);
+        dpds.local()->coosvels.downloadFromDevice(0, ContainersSynch::Synch);
+
+        ASSERT_EQ(coarse.totcells, direct.totcells);
+        ASSERT_EQ(coarse.getOrderSize(), direct.getOrderSize());
+
+        for (int cid=0; cid < direct.totcells; cid++)
+        {
+            ASSERT_EQ(coarseSizes [cid], directSizes [cid]);
+            ASSERT_EQ(coarseStarts[cid], directStarts[cid]);
+
+            // the same particles, in any order within the cell
+            std::vector<int> coarseIds, directIds;
+            for (int slot = directStarts[cid]; slot < directStarts[cid] + directSizes[cid]; slot++)
+            {
+                coarseIds.push_back(dpds.local()->coosvels[slot].i1);
+                directIds.push_back(directParticles[slot].i1);
+            }
+
+            std::sort(coarseIds.begin(), coarseIds.end());
+            std::sort(directIds.begin(), directIds.end());
+            ASSERT_EQ(coarseIds, directIds);
+        }
+    }
+}
+
+/// the compacted non-empty cells of a build are the cells of non-zero size, in increasing order
+void test_active_cells(float3 length, float rc, float density, bool primary, CellListBuild method,
+                       CellListOrdering ordering = CellListOrdering::RowMajor, float movedFraction = 0.0f)
+{
+    DomainInfo domain{length, {0,0,0}, length};
+    float dt = 0; // dummy dt
+    YmrState state(domain, dt);
+
+    ParticleVector dpds(&state, "dpd", 1.0f);
+    std::unique_ptr<CellList> cells;
+    if (primary) cells = std::make_unique<PrimaryCellList>(&dpds, rc, length);
+    else         cells = std::make_unique<CellList>       (&dpds, rc, length);
+
+    cells->setOrdering(ordering);
+    cells->setBuildMethod(method);
+    if (movedFraction > 0.0f)
+        cells->setIncrementalBuild(1.0f);
+
+    UniformIC ic(density);
+    ic.exec(MPI_COMM_WORLD, &dpds, 0);
+
+    const int np = dpds.local()->size();
+    HostBuffer<Particle> reference(np);
+
+    for (int step=0; step<3; step++)
+    {
+        if (movedFraction > 0.0f && step > 0)
+            moveParticles(dpds, reference, movedFraction, cells->h, length, step);
+
+        cells->build(0);
+        dpds.cellListStamp++;
+
+        HostBuffer<int> sizes, active;
+        sizes .copy(cells->cellSizes,   0);
+        active.copy(cells->activeCells, 0);
+        CUDA_Check( cudaDeviceSynchronize() );
+
+        std::vector<int> nonEmpty;
+        for (int cid=0; cid < cells->totcells; cid++)
+            if (sizes[cid] > 0) nonEmpty.push_back(cid);
+
+        ASSERT_NE(cells->cellInfo().activeCells, nullptr);
+        ASSERT_EQ(cells->getActiveCellsBound(), (int) nonEmpty.size());
+        ASSERT_EQ(cells->nActiveCells[0],       (int) nonEmpty.size());
+        ASSERT_LT((int) nonEmpty.size(), cells->totcells);
+
+        for (int i=0; i < nonEmpty.size(); i++)
+            ASSERT_EQ(active[i], nonEmpty[i]);
+    }
+}
 
 TEST (CELLLISTS, DomainVaries)
 {
@@ -144,6 +439,61 @@ TEST (CELLLISTS, DensityVaries)
     test_domain(domain, rc, 8.0);
 }
 
+TEST (CELLLISTS, MortonOrdering)
+{
+    float rc = 1.0, density = 7.5;
+
+    test_domain(make_float3(32, 32, 32), rc, density, CellListOrdering::Morton);
+    test_domain(make_float3(48, 20, 13), rc, density, CellListOrdering::Morton);
+}
+
+TEST (CELLLISTS, Incremental)
+{
+    float rc = 1.0, density = 7.5;
+
+    test_domain(make_float3(32, 32, 32), rc, density, CellListOrdering::RowMajor, 0.1f);
+    test_domain(make_float3(32, 32, 32), rc, density, CellListOrdering::Morton,   0.1f);
+
+    test_incremental(make_float3(32, 32, 32), rc, density, 0.1f);
+    test_incremental(make_float3(48, 20, 13), rc, density, 0.5f, CellListOrdering::Morton);
+}
+
+TEST (CELLLISTS, Coarse)
+{
+    float density = 7.5;
+
+    test_coarse(make_float3(32, 32, 32), 0.5f, 2, density);
+    test_coarse(make_float3(48, 20, 13), 0.5f, 2, density, CellListOrdering::Morton);
+    test_coarse(make_float3(24, 24, 12), 0.25f, 4, density);
+}
+
+TEST (CELLLISTS, ActiveCells)
+{
+    float3 domain = make_float3(32, 32, 32);
+    float rc = 1.0, density = 0.5;
+
+    test_active_cells(domain, rc, density, true,  CellListBuild::Atomics);
+    test_active_cells(domain, rc, density, false, CellListBuild::Atomics);
+    test_active_cells(domain, rc, density, true,  CellListBuild::RadixSort, CellListOrdering::Morton);
+    test_active_cells(domain, rc, density, false, CellListBuild::Atomics,   CellListOrdering::RowMajor, 0.1f);
+}
+
+TEST (CELLLISTS, RadixSortBuild)
+{
+    float rc = 1.0, density = 7.5;
+
+    test_build_method(make_float3(32, 32, 32), rc, density, CellListBuild::RadixSort);
+    test_build_method(make_float3(48, 20, 13), rc, density, CellListBuild::RadixSort, CellListOrdering::Morton);
+}
+
+TEST (CELLLISTS, AutoBuild)
+{
+    float rc = 1.0, density = 7.5;
+
+    test_build_method(make_float3(32, 32, 32), rc, density, CellListBuild::Auto);
+    test_build_method(make_float3(48, 20, 13), rc, density, CellListBuild::Auto, CellListOrdering::Morton);
+}
+
 int main(int argc, char **argv)
 {
     MPI_Init(&argc, &argv);
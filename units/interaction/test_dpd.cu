@@ -5,13 +5,23 @@
 #include <core/celllist.h>
 #include <core/logger.h>
 #include <core/containers.h>
+#include <core/interactions/multi_species.h>
 #include <core/interactions/pairwise.impl.h>
+#include <core/interactions/pairwise_interactions/lj.h>
 #include <core/interactions/pairwise_interactions/norandom_dpd.h>
+#include <core/interactions/pairwise_interactions/sum.h>
 #include <core/initial_conditions/uniform_ic.h>
+#include <core/utils/common.h>
+#include <core/utils/make_unique.h>
 
 #include <gtest/gtest.h>
 
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
 #include <unistd.h>
+#include <vector>
 
 Logger logger;
 
@@ -272,6 +282,330 @@ void execute(MPI_Comm comm, float3 length)
 
 }
 
+static std::vector<Force> computeSelfForces(Interaction *inter, ParticleVector *pv, CellList *cl)
+{
+    pv->local()->forces.clear(0);
+    inter->local(pv, pv, cl, cl, 0);
+
+    HostBuffer<Force> frcs;
+    frcs.copy(pv->local()->forces, 0);
+    CUDA_Check( cudaDeviceSynchronize() );
+
+    return std::vector<Force>(frcs.begin(), frcs.end());
+}
+
+/// forces on \p pv1 of its interaction with \p pv2
+static std::vector<Force> computePairForces(Interaction *inter, ParticleVector *pv1, ParticleVector *pv2,
+                                            CellList *cl1, CellList *cl2)
+{
+    pv1->local()->forces.clear(0);
+    pv2->local()->forces.clear(0);
+    inter->local(pv1, pv2, cl1, cl2, 0);
+
+    HostBuffer<Force> frcs;
+    frcs.copy(pv1->local()->forces, 0);
+    CUDA_Check( cudaDeviceSynchronize() );
+
+    return std::vector<Force>(frcs.begin(), frcs.end());
+}
+
+static double maxForceDifference(const std::vector<Force>& a, const std::vector<Force>& b)
+{
+    double linf = 0;
+    for (int i = 0; i < a.size(); i++)
+    {
+        linf = max(linf, (double) fabs(a[i].f.x - b[i].f.x));
+        linf = max(linf, (double) fabs(a[i].f.y - b[i].f.y));
+        linf = max(linf, (double) fabs(a[i].f.z - b[i].f.z));
+    }
+    return linf;
+}
+
+/**
+ * Particle Vectors of uniform densities with random velocities, each with its built primary cell-list:
+ * the setup shared by the tests of a variant of the pairwise interactions against a reference
+ */
+struct UniformSetup
+{
+    UniformSetup(MPI_Comm comm, float3 length, std::vector<float> densities, float rc = 1.0f) :
+        rc(rc),
+        domain{length, {0,0,0}, length},
+        state(domain, dt)
+    {
+        for (int i = 0; i < densities.size(); i++)
+        {
+            pvs.push_back(std::make_unique<ParticleVector>(&state, "dpd" + std::to_string(i), 1.0f));
+            auto pv = pvs.back().get();
+
+            UniformIC ic(densities[i]);
+            ic.exec(comm, pv, 0);
+
+            cells.push_back(std::make_unique<PrimaryCellList>(pv, rc, length));
+            cells.back()->build(0);
+
+            pv->local()->coosvels.downloadFromDevice(0);
+            for (auto& p : pv->local()->coosvels)
+                p.u = make_float3(drand48() - 0.5, drand48() - 0.5, drand48() - 0.5);
+            pv->local()->coosvels.uploadToDevice(0);
+        }
+    }
+
+    ParticleVector* pv(int i = 0) { return pvs[i].get(); }
+    CellList*       cl(int i = 0) { return cells[i].get(); }
+
+    /// the forces the variants are checked against
+    PairwiseNorandomDPD referenceDPD() const
+    {
+        return PairwiseNorandomDPD(rc, 50.0f, 20.0f, 1.0f, dt, 1.0f);
+    }
+
+    const float dt {0.002f};
+    const float rc;
+    DomainInfo domain;
+    YmrState state;
+
+    std::vector<std::unique_ptr<ParticleVector>> pvs;
+    std::vector<std::unique_ptr<CellList>> cells;
+};
+
+void executeNeighborList(MPI_Comm comm, float3 length)
+{
+    const float skin = 0.3f;
+    UniformSetup setup(comm, length, {4.5f});
+    auto pv = setup.pv();
+    auto cl = setup.cl();
+
+    InteractionPair<PairwiseNorandomDPD> cellInter (&setup.state, "dpd_cells", setup.rc, setup.referenceDPD());
+    InteractionPair<PairwiseNorandomDPD> nlistInter(&setup.state, "dpd_nlist", setup.rc, setup.referenceDPD());
+    nlistInter.useNeighborList(skin);
+
+    for (int step = 0; step < 5; step++)
+    {
+        auto ref = computeSelfForces(&cellInter,  pv, cl);
+        auto res = computeSelfForces(&nlistInter, pv, cl);
+
+        double linf = maxForceDifference(ref, res);
+        fprintf(stderr, "step %d: Linf norm: %f\n", step, linf);
+        ASSERT_LE(linf, 0.002);
+
+        // small displacements such that the list stays valid,
+        // particles get reordered by the cell-list
+        pv->local()->coosvels.downloadFromDevice(0);
+        for (auto& p : pv->local()->coosvels)
+        {
+            p.r += 0.02f * make_float3(drand48() - 0.5, drand48() - 0.5, drand48() - 0.5);
+            p.r = fmaxf(p.r, -0.4999f*length);
+            p.r = fminf(p.r,  0.4999f*length);
+        }
+        pv->local()->coosvels.uploadToDevice(0);
+
+        pv->cellListStamp++;
+        cl->build(0);
+    }
+
+    ASSERT_EQ(nlistInter.neighborLists[cl]->getNumRebuilds(), 1);
+}
+
+void executeTiled(MPI_Comm comm, float3 length, float density)
+{
+    UniformSetup setup(comm, length, {density});
+
+    InteractionPair<PairwiseNorandomDPD> cellInter (&setup.state, "dpd_cells", setup.rc, setup.referenceDPD());
+    InteractionPair<PairwiseNorandomDPD> tiledInter(&setup.state, "dpd_tiled", setup.rc, setup.referenceDPD());
+    tiledInter.useTiledKernels(true);
+
+    auto ref = computeSelfForces(&cellInter,  setup.pv(), setup.cl());
+    auto res = computeSelfForces(&tiledInter, setup.pv(), setup.cl());
+
+    double linf = maxForceDifference(ref, res);
+    fprintf(stderr, "Tiled kernel, density %g: Linf norm: %f\n", density, linf);
+    ASSERT_LE(linf, 0.01);
+}
+
+void executeSum(MPI_Comm comm, float3 length)
+{
+    const float rcLJ = 0.5f;
+    UniformSetup setup(comm, length, {8.0f});
+    auto pv = setup.pv();
+    auto cl = setup.cl();
+
+    auto dpdInt = setup.referenceDPD();
+    PairwiseLJ ljInt(rcLJ, 0.1f, 0.3f, 100.0f);
+
+    InteractionPair<PairwiseNorandomDPD> dpdInter(&setup.state, "dpd", setup.rc, dpdInt);
+    InteractionPair<PairwiseLJ> ljInter(&setup.state, "lj", rcLJ, ljInt);
+
+    // LJ goes first: velocities must still be fetched for DPD
+    using Sum = PairwiseSum<PairwiseLJ, PairwiseNorandomDPD>;
+    InteractionPair<Sum> sumInter(&setup.state, "sum", setup.rc, Sum(ljInt, dpdInt));
+
+    auto refDPD = computeSelfForces(&dpdInter, pv, cl);
+    auto refLJ  = computeSelfForces(&ljInter,  pv, cl);
+    auto res    = computeSelfForces(&sumInter, pv, cl);
+
+    for (int i = 0; i < refDPD.size(); i++)
+        refDPD[i].f += refLJ[i].f;
+
+    double linf = maxForceDifference(refDPD, res);
+    fprintf(stderr, "Sum of interactions: Linf norm: %f\n", linf);
+    ASSERT_LE(linf, 0.01);
+}
+
+void executeCompressed(MPI_Comm comm, float3 length)
+{
+    UniformSetup setup(comm, length, {4.0f, 3.0f});
+
+    InteractionPair<PairwiseNorandomDPD> fullInter      (&setup.state, "dpd_full",       setup.rc, setup.referenceDPD());
+    InteractionPair<PairwiseNorandomDPD> compressedInter(&setup.state, "dpd_compressed", setup.rc, setup.referenceDPD());
+    compressedInter.useCompressedStorage(true, false);
+
+    auto ref = computePairForces(&fullInter,       setup.pv(0), setup.pv(1), setup.cl(0), setup.cl(1));
+    auto res = computePairForces(&compressedInter, setup.pv(0), setup.pv(1), setup.cl(0), setup.cl(1));
+
+    double linf = maxForceDifference(ref, res);
+    fprintf(stderr, "Compressed storage: Linf norm: %f\n", linf);
+    ASSERT_LE(linf, 0.1);
+}
+
+/**
+ * Particles of two species in one Particle Vector against the same particles split in one
+ * Particle Vector per species, interacting with the coefficients of their pair of species.
+ * kbT is 0, the random forces of the two paths do not match
+ */
+void executeMultiSpecies(MPI_Comm comm, float3 length)
+{
+    const float rcLJ = 0.5f;
+    const float maxForce = 100.0f;
+
+    const BasicInteractionMultiSpecies::Matrix a     {{50.0f, 20.0f}, {20.0f, 30.0f}};
+    const BasicInteractionMultiSpecies::Matrix gamma {{20.0f, 10.0f}, {10.0f,  5.0f}};
+    const BasicInteractionMultiSpecies::Matrix power {{ 1.0f,  0.5f}, { 0.5f, 0.25f}};
+    const BasicInteractionMultiSpecies::Matrix eps   {{ 0.1f,  0.2f}, { 0.2f,  0.3f}};
+    const BasicInteractionMultiSpecies::Matrix sigma {{0.25f,  0.3f}, { 0.3f, 0.35f}};
+
+    UniformSetup setup(comm, length, {6.0f});
+    auto& state = setup.state;
+    const float rc = setup.rc;
+    const float dt = setup.dt;
+    auto all   = setup.pv();
+    auto cells = setup.cl();
+
+    InteractionDPDMultiSpecies dpdMulti(&state, "dpd_multi", rc,   a, gamma, 0.0f, power);
+    InteractionLJMultiSpecies  ljMulti (&state, "lj_multi",  rcLJ, eps, sigma, maxForce);
+    dpdMulti.setPrerequisites(all, all, cells, cells);
+    ljMulti .setPrerequisites(all, all, cells, cells);
+
+    // species 1 for every other particle, both species are everywhere
+    auto speciesData = all->local()->extraPerParticle.getData<int>(ChannelNames::species);
+    for (int i = 0; i < all->local()->size(); i++)
+        (*speciesData)[i] = all->local()->coosvels[i].i1 % 2;
+    speciesData->uploadToDevice(0);
+
+    ParticleVector pv0(&state, "species0", 1.0f), pv1(&state, "species1", 1.0f);
+    ParticleVector *split[2] = {&pv0, &pv1};
+
+    for (int s = 0; s < 2; s++)
+    {
+        std::vector<Particle> particles;
+        for (auto& p : all->local()->coosvels)
+            if (p.i1 % 2 == s) particles.push_back(p);
+
+        split[s]->local()->resize_anew(particles.size());
+        std::copy(particles.begin(), particles.end(), split[s]->local()->coosvels.begin());
+        split[s]->local()->coosvels.uploadToDevice(0);
+    }
+
+    PrimaryCellList cells0(&pv0, rc, length), cells1(&pv1, rc, length);
+    cells0.build(0);
+    cells1.build(0);
+
+    CellList* splitCells[2] = {&cells0, &cells1};
+
+    // forces of the split Particle Vectors, by particle id
+    auto computeSplit = [&](std::function<Interaction*(int, int)> makeInteraction) {
+        std::map<int, Force> forces;
+
+        pv0.local()->forces.clear(0);
+        pv1.local()->forces.clear(0);
+
+        for (int s1 = 0; s1 < 2; s1++)
+            for (int s2 = s1; s2 < 2; s2++)
+            {
+                std::unique_ptr<Interaction> inter(makeInteraction(s1, s2));
+                inter->local(split[s1], split[s2], splitCells[s1], splitCells[s2], 0);
+            }
+
+        for (int s = 0; s < 2; s++)
+        {
+            HostBuffer<Force> frcs;
+            frcs.copy(split[s]->local()->forces, 0);
+            split[s]->local()->coosvels.downloadFromDevice(0);
+
+            for (int i = 0; i < frcs.size(); i++)
+                forces[split[s]->local()->coosvels[i].i1] = frcs[i];
+        }
+
+        std::vector<Force> res;
+        for (auto& p : all->local()->coosvels)
+            res.push_back(forces[p.i1]);
+        return res;
+    };
+
+    auto refDPD = computeSplit([&](int s1, int s2) {
+        PairwiseNorandomDPD dpd(rc, a[s1][s2], gamma[s1][s2], 0.0f, dt, power[s1][s2]);
+        return new InteractionPair<PairwiseNorandomDPD>(&state, "dpd", rc, dpd);
+    });
+
+    auto refLJ = computeSplit([&](int s1, int s2) {
+        PairwiseLJ lj(rcLJ, eps[s1][s2], sigma[s1][s2], maxForce);
+        return new InteractionPair<PairwiseLJ>(&state, "lj", rcLJ, lj);
+    });
+
+    auto resDPD = computeSelfForces(&dpdMulti, all, cells);
+    auto resLJ  = computeSelfForces(&ljMulti,  all, cells);
+
+    double linfDPD = maxForceDifference(refDPD, resDPD);
+    double linfLJ  = maxForceDifference(refLJ,  resLJ);
+    fprintf(stderr, "Multi-species: DPD Linf norm: %f, LJ Linf norm: %f\n", linfDPD, linfLJ);
+    ASSERT_LE(linfDPD, 0.01);
+    ASSERT_LE(linfLJ,  0.01);
+}
+
+TEST(Interactions, multiSpecies)
+{
+    float3 length{7, 6, 5};
+    executeMultiSpecies(MPI_COMM_WORLD, length);
+}
+
+TEST(Interactions, compressed)
+{
+    float3 length{7, 6, 5};
+    executeCompressed(MPI_COMM_WORLD, length);
+}
+
+TEST(Interactions, sum)
+{
+    float3 length{7, 6, 5};
+    executeSum(MPI_COMM_WORLD, length);
+}
+
+TEST(Interactions, tiled)
+{
+    float3 length{7, 6, 5};
+
+    // more than a warp per cell
+    executeTiled(MPI_COMM_WORLD, length, 40.0);
+
+    // most of the cells are empty, the kernel only goes through the others
+    executeTiled(MPI_COMM_WORLD, length, 0.5);
+}
+
+TEST(Interactions, neighborList)
+{
+    float3 length{10, 12, 14};
+    executeNeighborList(MPI_COMM_WORLD, length);
+}
+
 TEST(Interactions, smallDomain)
 {
     float3 length{3, 4, 5};
@@ -0,0 +1,47 @@
+#include <core/load_balance.h>
+#include <core/logger.h>
+
+#include <gtest/gtest.h>
+
+Logger logger;
+
+TEST(LoadBalance, UniformLoadKeepsPlanes)
+{
+    auto planes = LoadBalanceMonitor::balancedPlanes({2.0, 2.0, 2.0, 2.0}, 8.0f);
+
+    ASSERT_EQ(planes.size(), 3);
+    for (int i = 0; i < 3; i++)
+        ASSERT_NEAR(planes[i], 2.0f * (i+1), 1e-5f);
+
+    ASSERT_DOUBLE_EQ(LoadBalanceMonitor::imbalance({2.0, 2.0, 2.0, 2.0}), 1.0);
+}
+
+TEST(LoadBalance, PlanesMoveTowardsLoad)
+{
+    // 3/4 of the load in the first half
+    auto planes = LoadBalanceMonitor::balancedPlanes({3.0, 1.0}, 2.0f);
+
+    ASSERT_EQ(planes.size(), 1);
+    ASSERT_NEAR(planes[0], 2.0f / 3.0f, 1e-5f);
+
+    // empty slabs are skipped over
+    planes = LoadBalanceMonitor::balancedPlanes({0.0, 2.0, 0.0}, 3.0f);
+
+    ASSERT_EQ(planes.size(), 2);
+    ASSERT_NEAR(planes[0], 1.0f + 1.0f / 3.0f, 1e-5f);
+    ASSERT_NEAR(planes[1], 1.0f + 2.0f / 3.0f, 1e-5f);
+
+    ASSERT_DOUBLE_EQ(LoadBalanceMonitor::imbalance({3.0, 1.0}), 1.5);
+}
+
+int main(int argc, char **argv)
+{
+    MPI_Init(&argc, &argv);
+    logger.init(MPI_COMM_WORLD, "load_balance.log", 9);
+
+    testing::InitGoogleTest(&argc, argv);
+    auto ret = RUN_ALL_TESTS();
+
+    MPI_Finalize();
+    return ret;
+}
@@ -0,0 +1,106 @@
+#include <core/containers.h>
+#include <core/logger.h>
+#include <core/utils/cuda_common.h>
+#include <core/utils/kernel_launch.h>
+#include <core/utils/scalar_mailbox.h>
+
+#include <gtest/gtest.h>
+#include <vector>
+
+Logger logger;
+
+__global__ void countValues(int n, int *counter, int2 *pairs, int *flag)
+{
+    const int i = blockIdx.x * blockDim.x + threadIdx.x;
+    if (i >= n) return;
+
+    atomicAdd(counter, 1);
+    atomicAdd(&pairs[i % 3].x, i);
+    atomicAdd(&pairs[i % 3].y, 1);
+
+    if (i == n-1) *flag = 42;
+}
+
+TEST(MAILBOX, OnePostForAllSlots)
+{
+    const int n = 1000;
+    ScalarMailbox mailbox("test");
+
+    const int counterSlot = mailbox.add<int>();
+    const int pairsSlot   = mailbox.add<int2>(3);
+    const int flagSlot    = mailbox.add<int>();
+
+    DeviceBuffer<int>  counter(1);
+    DeviceBuffer<int2> pairs(3);
+    counter.clear(0);
+    pairs  .clear(0);
+    *mailbox.hostPtr<int>(flagSlot) = 0;
+
+    SAFE_KERNEL_LAUNCH(
+            countValues,
+            getNblocks(n, 128), 128, 0, 0,
+            n, counter.devPtr(), pairs.devPtr(), mailbox.devPtr<int>(flagSlot) );
+
+    mailbox.collect(counterSlot, counter.devPtr());
+    mailbox.collect(pairsSlot,   pairs.devPtr(), 3);
+    mailbox.post(0);
+    mailbox.wait();
+
+    ASSERT_EQ(*mailbox.hostPtr<int>(counterSlot), n);
+    ASSERT_EQ(*mailbox.hostPtr<int>(flagSlot),    42);
+
+    auto pairsBack = mailbox.hostPtr<int2>(pairsSlot);
+    for (int r = 0; r < 3; r++)
+    {
+        int sum = 0, count = 0;
+        for (int i = r; i < n; i += 3)
+        {
+            sum += i;
+            count++;
+        }
+
+        ASSERT_EQ(pairsBack[r].x, sum);
+        ASSERT_EQ(pairsBack[r].y, count);
+    }
+
+    ASSERT_TRUE(mailbox.ready());
+}
+
+TEST(MAILBOX, SlotsKeptWhenGrowing)
+{
+    ScalarMailbox mailbox("test_grow");
+
+    const int first = mailbox.add<int>();
+    *mailbox.hostPtr<int>(first) = 7;
+
+    // past the initial capacity, the mailbox is reallocated
+    std::vector<int> slots;
+    for (int i = 0; i < 100; i++)
+        slots.push_back(mailbox.add<int>());
+
+    PinnedBuffer<int> values(slots.size());
+    for (int i = 0; i < values.size(); i++)
+        values[i] = 10 * i;
+    values.uploadToDevice(0);
+
+    for (int i = 0; i < slots.size(); i++)
+        mailbox.collect(slots[i], values.devPtr() + i);
+    mailbox.post(0);
+    mailbox.wait();
+
+    ASSERT_EQ(*mailbox.hostPtr<int>(first), 7);
+    for (int i = 0; i < slots.size(); i++)
+        ASSERT_EQ(*mailbox.hostPtr<int>(slots[i]), 10 * i);
+}
+
+int main(int argc, char **argv)
+{
+    MPI_Init(&argc, &argv);
+    logger.init(MPI_COMM_WORLD, "mailbox.log", 9);
+
+    testing::InitGoogleTest(&argc, argv);
+    auto ret = RUN_ALL_TESTS();
+
+    MPI_Finalize();
+    return ret;
+}
@@ -0,0 +1,164 @@
+#include <core/containers.h>
+#include <core/logger.h>
+#include <core/utils/memory_pool.h>
+#include <core/utils/shrink_policy.h>
+
+#include <gtest/gtest.h>
+
+Logger logger;
+
+TEST(MemoryPool, ReuseAfterSynchronization)
+{
+    auto& pool = MemoryPool::device();
+    const size_t bytes = 1 << 20;
+
+    void *a = pool.allocate(bytes, "test_reuse");
+    pool.deallocate(a);
+
+    // the block might still be used by the GPU
+    void *b = pool.allocate(bytes, "test_reuse");
+    ASSERT_NE(a, b);
+    pool.deallocate(b);
+
+    CUDA_Check( cudaDeviceSynchronize() );
+    MemoryPool::onDeviceSynchronized();
+
+    void *c = pool.allocate(bytes, "test_reuse");
+    ASSERT_TRUE(c == a || c == b);
+    pool.deallocate(c);
+}
+
+TEST(MemoryPool, UsagePerOwner)
+{
+    auto& pool = MemoryPool::device();
+
+    {
+        DeviceBuffer<float> buf1, buf2;
+        buf1.setOwner("test_owner1");
+        buf2.setOwner("test_owner2");
+
+        buf1.resize_anew(1000);
+        buf2.resize_anew(100000);
+
+        auto usage = pool.getUsage();
+        ASSERT_GE(usage["test_owner1"].inUse, 1000   * sizeof(float));
+        ASSERT_GE(usage["test_owner2"].inUse, 100000 * sizeof(float));
+    }
+
+    auto usage = pool.getUsage();
+    ASSERT_EQ(usage["test_owner1"].inUse, 0);
+    ASSERT_EQ(usage["test_owner2"].inUse, 0);
+    ASSERT_GE(usage["test_owner2"].peak, 100000 * sizeof(float));
+}
+
+TEST(MemoryPool, OwnerAndSlack)
+{
+    auto& pool = MemoryPool::device();
+
+    PinnedBuffer<int> buf(1000);
+    buf.setOwner("test_slack");
+
+    auto usage = pool.getUsage();
+    ASSERT_GE(usage["test_slack"].inUse, 1000 * sizeof(int));
+    ASSERT_GE(usage["test_slack"].requested, 1000 * sizeof(int));
+    ASSERT_EQ(usage["test_slack"].used, 1000 * sizeof(int));
+
+    // shrinking the size does not release memory but shows up as slack
+    buf.resize_anew(10);
+    usage = pool.getUsage();
+    ASSERT_EQ(usage["test_slack"].used, 10 * sizeof(int));
+    ASSERT_GE(usage["test_slack"].requested - usage["test_slack"].used, 990 * sizeof(int));
+}
+
+TEST(MemoryPool, NoCaching)
+{
+    auto& pool = MemoryPool::device();
+    pool.setCaching(false);
+
+    void *a = pool.allocate(1 << 20, "test_nocache");
+    pool.deallocate(a);
+    ASSERT_EQ(pool.getCachedBytes(), 0);
+
+    pool.setCaching(true);
+}
+
+TEST(MemoryPool, Managed)
+{
+    auto& pool = MemoryPool::device();
+    pool.setManaged(true);
+
+    {
+        DeviceBuffer<int> buf(1000);
+        ASSERT_GE(pool.getManagedBytes(), 1000 * sizeof(int));
+
+        // managed memory is accessible from the host
+        CUDA_Check( cudaDeviceSynchronize() );
+        buf.devPtr()[10] = 42;
+
+        pool.prefetchToDevice(0);
+        HostBuffer<int> hbuf;
+        hbuf.copy(buf, 0);
+        CUDA_Check( cudaStreamSynchronize(0) );
+        ASSERT_EQ(hbuf[10], 42);
+    }
+
+    pool.setManaged(false);
+    ASSERT_EQ(pool.getManagedBytes(), 0);
+}
+
+TEST(MemoryPool, ShrinkKeepsData)
+{
+    PinnedBuffer<int> buf(100000);
+    for (int i = 0; i < buf.size(); i++)
+        buf[i] = i;
+    buf.uploadToDevice(0);
+
+    buf.resize(100, 0);
+    buf.shrink(0);
+    ASSERT_EQ(buf.size(), 100);
+    ASSERT_LT(buf.getCapacity(), 1000);
+
+    buf.clearHost();
+    buf.downloadFromDevice(0);
+    for (int i = 0; i < buf.size(); i++)
+        ASSERT_EQ(buf[i], i);
+}
+
+TEST(MemoryPool, ShrinkPolicyHysteresis)
+{
+    const int nsteps = 5;
+    ShrinkPolicy policy(nsteps, 0.5f, false);
+
+    DeviceBuffer<float> buf(100000);
+    std::vector<GPUcontainer*> containers {&buf};
+    const int capacity = buf.getCapacity();
+
+    // a step above the threshold restarts the count
+    buf.resize(10, 0);
+    for (int i = 0; i < nsteps-1; i++)
+        policy.update(containers, 0);
+
+    buf.resize(100000, 0);
+    policy.update(containers, 0);
+    buf.resize(10, 0);
+
+    for (int i = 0; i < nsteps-1; i++)
+        policy.update(containers, 0);
+    ASSERT_EQ(buf.getCapacity(), capacity);
+
+    policy.update(containers, 0);
+    ASSERT_LT(buf.getCapacity(), capacity);
+    ASSERT_EQ(buf.size(), 10);
+}
+
+int main(int argc, char **argv)
+{
+    MPI_Init(&argc, &argv);
+    logger.init(MPI_COMM_WORLD, "memory_pool.log", 9);
+
+    testing::InitGoogleTest(&argc, argv);
+    auto ret = RUN_ALL_TESTS();
+
+    MPI_Finalize();
+    return ret;
+}
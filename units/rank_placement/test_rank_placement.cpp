@@ -0,0 +1,55 @@
+#include <core/logger.h>
+#include <core/rank_placement.h>
+
+#include <gtest/gtest.h>
+
+Logger logger;
+
+TEST(RankPlacement, CubicBlockForCubicSubdomains)
+{
+    const int3 block = chooseNodeBlock({8, 8, 8}, 8, {32.0f, 32.0f, 32.0f});
+
+    ASSERT_EQ(block.x, 2);
+    ASSERT_EQ(block.y, 2);
+    ASSERT_EQ(block.z, 2);
+}
+
+TEST(RankPlacement, BlockAcrossWholeAxisIsFree)
+{
+    // covering the 2 ranks along z keeps those faces within the node
+    const int3 block = chooseNodeBlock({4, 4, 2}, 4, {32.0f, 32.0f, 32.0f});
+
+    ASSERT_EQ(block.x * block.y * block.z, 4);
+    ASSERT_EQ(block.z, 2);
+}
+
+TEST(RankPlacement, FlatSubdomainsStackAlongTheirLargeFaces)
+{
+    // large faces are normal to z: neighbours along z share the most halo
+    const int3 block = chooseNodeBlock({4, 4, 4}, 4, {64.0f, 64.0f, 8.0f});
+
+    ASSERT_EQ(block.x, 1);
+    ASSERT_EQ(block.y, 1);
+    ASSERT_EQ(block.z, 4);
+}
+
+TEST(RankPlacement, NoTilingBlock)
+{
+    const int3 block = chooseNodeBlock({3, 3, 3}, 2, {32.0f, 32.0f, 32.0f});
+
+    ASSERT_EQ(block.x, 0);
+    ASSERT_EQ(block.y, 0);
+    ASSERT_EQ(block.z, 0);
+}
+
+int main(int argc, char **argv)
+{
+    MPI_Init(&argc, &argv);
+    logger.init(MPI_COMM_WORLD, "rank_placement.log", 9);
+
+    testing::InitGoogleTest(&argc, argv);
+    auto ret = RUN_ALL_TESTS();
+
+    MPI_Finalize();
+    return ret;
+}
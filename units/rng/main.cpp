@@ -1,10 +1,12 @@
 #include <core/logger.h>
 #include <core/interactions/utils/step_random_gen.h>
+#include <core/utils/philox.h>
 
 #include <cmath>
 #include <cstdio>
 #include <gtest/gtest.h>
 #include <random>
+#include <vector>
 
 Logger logger;
 
@@ -81,6 +83,75 @@ TEST (RNG, autoCorrelationGenFromMT)
     ASSERT_LE(abs(corr), 1e-3);
 }
 
+TEST (RNG, philoxKnownAnswers)
+{
+    // reference values of Random123
+    uint4 r0 = Philox::philox4x32(make_uint4(0, 0, 0, 0), make_uint2(0, 0));
+    ASSERT_EQ(r0.x, 0x6627e8d5u);
+    ASSERT_EQ(r0.y, 0xe169c58du);
+    ASSERT_EQ(r0.z, 0xbc57ac4cu);
+    ASSERT_EQ(r0.w, 0x9b00dbd8u);
+
+    uint4 r1 = Philox::philox4x32(make_uint4(0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff), make_uint2(0xffffffff, 0xffffffff));
+    ASSERT_EQ(r1.x, 0x408f276du);
+    ASSERT_EQ(r1.y, 0x41c83b0eu);
+    ASSERT_EQ(r1.z, 0xa20bc7c6u);
+    ASSERT_EQ(r1.w, 0x6d5451fdu);
+}
+
+TEST (RNG, philoxNormalMoments)
+{
+    const uint2 key = Philox::makeKey(424242);
+    const int n = 250000;
+
+    real sum[4] = {0}, sum2[4] = {0}, sum4 = 0, cross = 0;
+
+    for (int i = 0; i < n; i++)
+    {
+        float4 v = Philox::normal4(Philox::pairCounter(7, i, i+1), key);
+        float vs[4] = {v.x, v.y, v.z, v.w};
+
+        for (int k = 0; k < 4; k++)
+        {
+            sum [k] += vs[k];
+            sum2[k] += vs[k] * vs[k];
+        }
+        sum4  += (real) v.x * v.x * v.x * v.x;
+        cross += (real) v.x * v.z;
+    }
+
+    for (int k = 0; k < 4; k++)
+    {
+        ASSERT_LE(std::abs(sum [k] / n),       1e-2);
+        ASSERT_LE(std::abs(sum2[k] / n - 1.0), 1e-2);
+    }
+
+    // kurtosis of the normal distribution, and no correlation between the components
+    ASSERT_LE(std::abs(sum4  / n - 3.0), 5e-2);
+    ASSERT_LE(std::abs(cross / n),       1e-2);
+}
+
+TEST (RNG, philoxIndependentOfOrder)
+{
+    // each rank computes its pairs in its own order, the numbers only depend on (step, i, j)
+    const uint2 key = Philox::makeKey(42);
+    const int n = 1000, step = 13;
+
+    std::vector<float> forward(n), backward(n);
+    for (int i = 0; i < n; i++)
+        forward[i] = Philox::normal4(Philox::pairCounter(step, i, 3*i + 1), key).x;
+
+    for (int i = n-1; i >= 0; i--)
+        backward[i] = Philox::normal4(Philox::pairCounter(step, 3*i + 1, i), key).x;
+
+    for (int i = 0; i < n; i++)
+        ASSERT_EQ(forward[i], backward[i]);
+
+    // another step gives other numbers
+    ASSERT_NE(Philox::normal4(Philox::pairCounter(step,   0, 1), key).x,
+              Philox::normal4(Philox::pairCounter(step+1, 0, 1), key).x);
+}
+
 int main(int argc, char **argv)
 {
     testing::InitGoogleTest(&argc, argv);
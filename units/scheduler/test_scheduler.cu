@@ -3,6 +3,7 @@
 #include <vector>
 #include <algorithm>
 
+#include <core/containers.h>
 #include <core/logger.h>
 #include <core/task_scheduler.h>
 
@@ -132,6 +133,46 @@ TEST(Scheduler, Benchmark)
     EXPECT_LE(tus, 500.0);
 }
 
+__global__ void addValue(int n, int *data, int value)
+{
+    const int i = blockIdx.x * blockDim.x + threadIdx.x;
+    if (i < n) data[i] += value;
+}
+
+TEST(Scheduler, GraphCapture)
+{
+    TaskScheduler scheduler;
+
+    const int n = 100;
+    PinnedBuffer<int> data(n);
+    data.clear(0);
+
+    auto A = scheduler.createTask("A");
+    auto B = scheduler.createTask("B");
+
+    scheduler.addTask(A, [&](cudaStream_t s){ addValue<<<1, 128, 0, s>>>(n, data.devPtr(), 1); });
+    scheduler.addTask(A, [&](cudaStream_t s){ addValue<<<1, 128, 0, s>>>(n, data.devPtr(), 10); }, 2);
+    scheduler.addTask(B, [&](cudaStream_t s){ addValue<<<1, 128, 0, s>>>(n, data.devPtr(), 100); });
+
+    scheduler.addDependency(B, {}, {A});
+    scheduler.setGraphCapturable(A);
+    scheduler.setGraphCapturable(B);
+
+    scheduler.compile();
+    scheduler.enableGraphCapture(nullptr);
+
+    const int nruns = 5;
+    for (int i = 0; i < nruns; i++)
+        scheduler.run();
+
+    data.downloadFromDevice(0);
+
+    // second function of A is executed at runs 0, 2, 4
+    const int expected = nruns * 1 + 3 * 10 + nruns * 100;
+    for (int i = 0; i < n; i++)
+        ASSERT_EQ(data[i], expected);
+}
+
 int main(int argc, char **argv)
 {
     int provided;
@@ -90,6 +90,29 @@ TEST(Serializer, Mixed)
 
 }
 
+TEST(Serializer, ChunksSameAsBuffer)
+{
+    float s1 = 1;
+    std::vector<double> s2(1000, 3.14), s3{1, 2};
+    std::vector<std::string> s4{"density", "velocity"};
+    PinnedBuffer<int> s5(500);
+    for (int i = 0; i < s5.size(); i++) s5[i] = i;
+
+    std::vector<char> buf, header, gathered;
+    SimpleSerializer::Chunks chunks;
+
+    SimpleSerializer::serialize      (buf,            s1,s2,s3,s4,s5);
+    SimpleSerializer::serializeChunks(header, chunks, s1,s2,s3,s4,s5);
+
+    // the large vectors are not copied
+    myassert(header.size() < buf.size() - s2.size()*sizeof(double) - s5.size()*sizeof(int) + 1, "large vectors copied");
+
+    for (auto& c : chunks)
+        gathered.insert(gathered.end(), (const char*)c.first, (const char*)c.first + c.second);
+
+    myassert(gathered == buf, "gathered chunks differ from the serialized buffer");
+}
+
 int main(int argc, char **argv)
 {
     MPI_Init(&argc, &argv);